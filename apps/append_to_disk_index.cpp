@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <omp.h>
+#include <boost/program_options.hpp>
+
+#include "utils.h"
+#include "disk_utils.h"
+#include "program_options_utils.hpp"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+    std::string data_type, dist_fn, data_path, index_path_prefix;
+    uint32_t num_threads, L;
+    float alpha;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "append_to_disk_index", "Add points to a built disk index without rebuilding it.")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+
+        // Required parameters
+        po::options_description required_configs("Required");
+        required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                                       program_options_utils::DISK_DATA_TYPE_DESCRIPTION);
+        required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                                       program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
+        required_configs.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                                       program_options_utils::INDEX_PATH_PREFIX_DESCRIPTION);
+        required_configs.add_options()("data_path", po::value<std::string>(&data_path)->required(),
+                                       "Input data file in bin format with the points to add");
+
+        // Optional parameters
+        po::options_description optional_configs("Optional");
+        optional_configs.add_options()("num_threads,T",
+                                       po::value<uint32_t>(&num_threads)->default_value(omp_get_num_procs()),
+                                       program_options_utils::NUMBER_THREADS_DESCRIPTION);
+        optional_configs.add_options()("Lbuild,L", po::value<uint32_t>(&L)->default_value(100),
+                                       program_options_utils::GRAPH_BUILD_COMPLEXITY);
+        optional_configs.add_options()("alpha", po::value<float>(&alpha)->default_value(1.2f),
+                                       program_options_utils::GRAPH_BUILD_ALPHA);
+
+        // Merge required and optional parameters
+        desc.add(required_configs).add(optional_configs);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    diskann::Metric metric;
+    if (dist_fn == std::string("l2"))
+        metric = diskann::Metric::L2;
+    else if (dist_fn == std::string("cosine"))
+        metric = diskann::Metric::COSINE;
+    else
+    {
+        std::cout << "Error. Only l2 and cosine distance functions are supported" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("int8"))
+            return diskann::append_to_disk_index<int8_t>(index_path_prefix, data_path, metric, L, alpha, num_threads);
+        else if (data_type == std::string("uint8"))
+            return diskann::append_to_disk_index<uint8_t>(index_path_prefix, data_path, metric, L, alpha, num_threads);
+        else if (data_type == std::string("float"))
+            return diskann::append_to_disk_index<float>(index_path_prefix, data_path, metric, L, alpha, num_threads);
+        else if (data_type == std::string("fp16"))
+            return diskann::append_to_disk_index<diskann::float16>(index_path_prefix, data_path, metric, L, alpha,
+                                                                   num_threads);
+        else if (data_type == std::string("bf16"))
+            return diskann::append_to_disk_index<diskann::bfloat16>(index_path_prefix, data_path, metric, L, alpha,
+                                                                    num_threads);
+        else
+        {
+            diskann::cerr << "Error. Unsupported data type" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << std::string(e.what()) << std::endl;
+        diskann::cerr << "Appending to the index failed." << std::endl;
+        return -1;
+    }
+}
@@ -5,6 +5,7 @@
 #include <boost/program_options.hpp>
 
 #include "utils.h"
+#include "build_profiler.h"
 #include "disk_utils.h"
 #include "math_utils.h"
 #include "index.h"
@@ -20,7 +21,24 @@ int main(int argc, char **argv)
     uint32_t num_threads, R, L, disk_PQ, build_PQ, QD, Lf, filter_threshold;
     float B, M;
     bool append_reorder_data = false;
+    bool separate_reorder_data = false;
     bool use_opq = false;
+    bool reorder_layout = false;
+    bool fast_scan_pq = false;
+    bool inline_pq_codes = false;
+    uint32_t sector_len = 0;
+    bool pack_nbr_ids = false;
+    uint32_t pq_centers = 0;
+    bool native_mips = false;
+    float entry_layer_sample_rate = 0;
+    uint32_t num_entry_centroids = 0;
+    bool minibatch_kmeans = false;
+    float partition_balance = 0;
+    float dedup_radius = -1;
+    bool gpu_build = false;
+    bool label_layout = false;
+    bool resume = false;
+    std::string only_shards, build_report;
 
     po::options_description desc{
         program_options_utils::make_program_description("build_disk_index", "Build a disk-based index.")};
@@ -31,7 +49,7 @@ int main(int argc, char **argv)
         // Required parameters
         po::options_description required_configs("Required");
         required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
-                                       program_options_utils::DATA_TYPE_DESCRIPTION);
+                                       program_options_utils::DISK_DATA_TYPE_DESCRIPTION);
         required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
                                        program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
         required_configs.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
@@ -63,6 +81,10 @@ int main(int argc, char **argv)
         optional_configs.add_options()("append_reorder_data", po::bool_switch()->default_value(false),
                                        "Include full precision data in the index. Use only in "
                                        "conjuction with compressed data on SSD.");
+        optional_configs.add_options()("separate_reorder_data",
+                                       po::bool_switch(&separate_reorder_data)->default_value(false),
+                                       "With --append_reorder_data, write the full precision data to a file of its "
+                                       "own next to the index, which is only read to rerank the results.");
         optional_configs.add_options()("build_PQ_bytes", po::value<uint32_t>(&build_PQ)->default_value(0),
                                        program_options_utils::BUIlD_GRAPH_PQ_BYTES);
         optional_configs.add_options()("use_opq", po::bool_switch()->default_value(false),
@@ -76,8 +98,76 @@ int main(int argc, char **argv)
         optional_configs.add_options()("filter_threshold,F", po::value<uint32_t>(&filter_threshold)->default_value(0),
                                        "Threshold to break up the existing nodes to generate new graph "
                                        "internally where each node has a maximum F labels.");
+        optional_configs.add_options()("reorder_layout", po::bool_switch(&reorder_layout)->default_value(false),
+                                       "Renumber nodes in BFS order of the graph before writing the disk layout so "
+                                       "that nodes sharing a sector are graph neighbors. Search results are mapped "
+                                       "back to the original ids.");
+        optional_configs.add_options()("label_layout", po::bool_switch(&label_layout)->default_value(false),
+                                       "As reorder_layout, with the nodes grouped by the rarest of their labels "
+                                       "first, so that filtered searches read sectors of nodes that pass their "
+                                       "filter. Needs --label_file.");
+        optional_configs.add_options()("inline_pq_codes", po::bool_switch(&inline_pq_codes)->default_value(false),
+                                       "Store the PQ codes of the neighbors of each node in the node, so that search "
+                                       "scores them from the sectors it reads instead of the in-memory PQ data. "
+                                       "Nodes grow by R times the PQ bytes.");
+        optional_configs.add_options()("sector_len", po::value<uint32_t>(&sector_len)->default_value(0),
+                                       "Length in bytes of the sectors the disk index is laid out in and read in: "
+                                       "512, 1024, 2048 or 4096. Shorter sectors waste less of each read on small "
+                                       "nodes, on drives with 512 byte logical blocks. 0 uses the default 4096.");
+        optional_configs.add_options()("pack_nbr_ids", po::bool_switch(&pack_nbr_ids)->default_value(false),
+                                       "Bit-pack the neighbor ids in the disk nodes, in as many bits as the point "
+                                       "count needs instead of 32, so that a larger R fits in the same sector.");
+        optional_configs.add_options()("pq_centers", po::value<uint32_t>(&pq_centers)->default_value(0),
+                                       "Centroids per chunk of the in-memory PQ codes: a power of two from 256 to "
+                                       "65536. Above 256 the codes take 2 bytes, so the search_DRAM_budget fits half "
+                                       "as many chunks, each quantized more finely. 0 uses the default 256.");
+        optional_configs.add_options()("native_mips", po::bool_switch(&native_mips)->default_value(false),
+                                       "With --dist_fn mips, build the graph and PQ codes for inner products on the "
+                                       "vectors as they are, instead of for L2 on a copy of the data with an extra "
+                                       "dimension. Saves that pass over the data and a dimension on every distance.");
+        optional_configs.add_options()("fast_scan_pq", po::bool_switch(&fast_scan_pq)->default_value(false),
+                                       "Use 4-bit (16 centroid) PQ codes for the in-memory compressed vectors. Fits "
+                                       "twice as many chunks into the search_DRAM_budget and scores them with SIMD "
+                                       "lookup tables.");
+        optional_configs.add_options()("entry_layer_sample_rate",
+                                       po::value<float>(&entry_layer_sample_rate)->default_value(0),
+                                       "Build a small Vamana graph over this fraction of the points (e.g. 0.001) that "
+                                       "searches use to pick their start points instead of the medoid. 0 disables it.");
+        optional_configs.add_options()("num_entry_centroids",
+                                       po::value<uint32_t>(&num_entry_centroids)->default_value(0),
+                                       "Cluster the data into this many k-means centroids (e.g. 4096) and start each "
+                                       "search from the medoids of the centroids closest to the query. 0 keeps the "
+                                       "medoids of the build.");
+        optional_configs.add_options()("minibatch_kmeans", po::bool_switch(&minibatch_kmeans)->default_value(false),
+                                       "When the build is split into partitions to fit the RAM budget, cluster with "
+                                       "mini-batch k-means that stops once it converges, and keep the centers when "
+                                       "retrying with more partitions.");
+        optional_configs.add_options()("partition_balance", po::value<float>(&partition_balance)->default_value(0),
+                                       "When the build is split into partitions to fit the RAM budget, keep each "
+                                       "partition within this fraction of their average size (e.g. 0.1), so that "
+                                       "they take about as long to build. 0 does not balance them.");
+        optional_configs.add_options()("dedup_radius", po::value<float>(&dedup_radius)->default_value(-1),
+                                       "Collapse points within this L2 distance of another point into a single node "
+                                       "before the build, found by hashing the points with random hyperplanes. "
+                                       "Search returns every point of a node it finds. 0 collapses exact duplicates "
+                                       "only; negative values keep every point. Not with --label_file.");
+        optional_configs.add_options()("gpu_build", po::bool_switch(&gpu_build)->default_value(false),
+                                       "Build the graph, or the graph of each partition, on the GPU from the exact "
+                                       "nearest neighbors of the points, in builds with CUDA. L2 only, and not with "
+                                       "--label_file or --build_PQ_bytes; otherwise the graph is built on the CPU.");
+        optional_configs.add_options()("resume", po::bool_switch(&resume)->default_value(false),
+                                       "Resume an interrupted build with the same parameters, skipping the stages "
+                                       "and shards it completed.");
+        optional_configs.add_options()("only_shards", po::value<std::string>(&only_shards)->default_value(""),
+                                       "Only build these shards of a graph that is split to fit the build RAM "
+                                       "budget, e.g. 0,2,5-7, so that they can be built on several machines. 'none' "
+                                       "only prepares the data and the partition. A final run with --resume instead "
+                                       "merges the shards and writes the index.");
         optional_configs.add_options()("label_type", po::value<std::string>(&label_type)->default_value("uint"),
                                        program_options_utils::LABEL_TYPE_DESCRIPTION);
+        optional_configs.add_options()("build_report", po::value<std::string>(&build_report)->default_value(""),
+                                       "Writes the wall time, CPU utilization, peak RSS and bytes read and written "
+                                       "of each stage of the build to this file as JSON.");
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs);
@@ -109,12 +199,20 @@ int main(int argc, char **argv)
         metric = diskann::Metric::INNER_PRODUCT;
     else if (dist_fn == std::string("cosine"))
         metric = diskann::Metric::COSINE;
+    else if (dist_fn == std::string("hamming") && data_type == std::string("uint8"))
+        metric = diskann::Metric::HAMMING;
     else
     {
-        std::cout << "Error. Only l2 and mips distance functions are supported" << std::endl;
+        std::cout << "Error. Only l2, mips, cosine and, for uint8, hamming distance functions are supported"
+                  << std::endl;
         return -1;
     }
 
+    if (separate_reorder_data && !append_reorder_data)
+    {
+        std::cout << "Error: --separate_reorder_data requires --append_reorder_data." << std::endl;
+        return -1;
+    }
     if (append_reorder_data)
     {
         if (disk_PQ == 0)
@@ -136,8 +234,39 @@ int main(int argc, char **argv)
     std::string params = std::string(std::to_string(R)) + " " + std::string(std::to_string(L)) + " " +
                          std::string(std::to_string(B)) + " " + std::string(std::to_string(M)) + " " +
                          std::string(std::to_string(num_threads)) + " " + std::string(std::to_string(disk_PQ)) + " " +
-                         std::string(std::to_string(append_reorder_data)) + " " +
-                         std::string(std::to_string(build_PQ)) + " " + std::string(std::to_string(QD));
+                         std::string(std::to_string(separate_reorder_data ? 2 : (int)append_reorder_data)) + " " +
+                         std::string(std::to_string(build_PQ)) + " " + std::string(std::to_string(QD)) + " " +
+                         std::string(std::to_string(inline_pq_codes)) + " " + std::string(std::to_string(sector_len)) +
+                         " " + std::string(std::to_string(pack_nbr_ids)) + " " +
+                         std::string(std::to_string(pq_centers)) + " " + std::string(std::to_string(native_mips)) +
+                         " " + std::string(std::to_string(partition_balance)) + " " +
+                         std::string(std::to_string(dedup_radius)) + " " + std::string(std::to_string(gpu_build)) +
+                         " " + std::string(std::to_string(label_layout));
+
+    // writes the report once the build is done, whichever way main returns
+    struct BuildReport
+    {
+        std::string path;
+        ~BuildReport()
+        {
+            if (path.empty())
+                return;
+            diskann::BuildProfiler::set_enabled(false);
+            try
+            {
+                diskann::BuildProfiler::write_json(path);
+                diskann::cout << "Wrote the build report to " << path << std::endl;
+            }
+            catch (const std::exception &e)
+            {
+                diskann::cerr << e.what() << std::endl;
+            }
+        }
+    } report{build_report};
+    if (!build_report.empty())
+        diskann::BuildProfiler::set_enabled(true);
+    // the whole build, declared after the report so that it ends first
+    diskann::BuildProfiler::Stage build_stage("build");
 
     try
     {
@@ -146,15 +275,29 @@ int main(int argc, char **argv)
             if (data_type == std::string("int8"))
                 return diskann::build_disk_index<int8_t>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
                                                          metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                         universal_label, filter_threshold, Lf);
+                                                         universal_label, filter_threshold, Lf, reorder_layout,
+                                                         fast_scan_pq, entry_layer_sample_rate, num_entry_centroids,
+                                                         minibatch_kmeans, resume, only_shards);
             else if (data_type == std::string("uint8"))
                 return diskann::build_disk_index<uint8_t, uint16_t>(
                     data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
-                    use_filters, label_file, universal_label, filter_threshold, Lf);
+                    use_filters, label_file, universal_label, filter_threshold, Lf, reorder_layout, fast_scan_pq,
+                    entry_layer_sample_rate, num_entry_centroids, minibatch_kmeans, resume, only_shards);
             else if (data_type == std::string("float"))
                 return diskann::build_disk_index<float, uint16_t>(
                     data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
-                    use_filters, label_file, universal_label, filter_threshold, Lf);
+                    use_filters, label_file, universal_label, filter_threshold, Lf, reorder_layout, fast_scan_pq,
+                    entry_layer_sample_rate, num_entry_centroids, minibatch_kmeans, resume, only_shards);
+            else if (data_type == std::string("fp16"))
+                return diskann::build_disk_index<diskann::float16, uint16_t>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, reorder_layout, fast_scan_pq,
+                    entry_layer_sample_rate, num_entry_centroids, minibatch_kmeans, resume, only_shards);
+            else if (data_type == std::string("bf16"))
+                return diskann::build_disk_index<diskann::bfloat16, uint16_t>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, reorder_layout, fast_scan_pq,
+                    entry_layer_sample_rate, num_entry_centroids, minibatch_kmeans, resume, only_shards);
             else
             {
                 diskann::cerr << "Error. Unsupported data type" << std::endl;
@@ -166,15 +309,31 @@ int main(int argc, char **argv)
             if (data_type == std::string("int8"))
                 return diskann::build_disk_index<int8_t>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
                                                          metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                         universal_label, filter_threshold, Lf);
+                                                         universal_label, filter_threshold, Lf, reorder_layout,
+                                                         fast_scan_pq, entry_layer_sample_rate, num_entry_centroids,
+                                                         minibatch_kmeans, resume, only_shards);
             else if (data_type == std::string("uint8"))
                 return diskann::build_disk_index<uint8_t>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
                                                           metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                          universal_label, filter_threshold, Lf);
+                                                          universal_label, filter_threshold, Lf, reorder_layout,
+                                                          fast_scan_pq, entry_layer_sample_rate, num_entry_centroids,
+                                                          minibatch_kmeans, resume, only_shards);
             else if (data_type == std::string("float"))
                 return diskann::build_disk_index<float>(data_path.c_str(), index_path_prefix.c_str(), params.c_str(),
                                                         metric, use_opq, codebook_prefix, use_filters, label_file,
-                                                        universal_label, filter_threshold, Lf);
+                                                        universal_label, filter_threshold, Lf, reorder_layout,
+                                                        fast_scan_pq, entry_layer_sample_rate, num_entry_centroids,
+                                                        minibatch_kmeans, resume, only_shards);
+            else if (data_type == std::string("fp16"))
+                return diskann::build_disk_index<diskann::float16>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, reorder_layout, fast_scan_pq,
+                    entry_layer_sample_rate, num_entry_centroids, minibatch_kmeans, resume, only_shards);
+            else if (data_type == std::string("bf16"))
+                return diskann::build_disk_index<diskann::bfloat16>(
+                    data_path.c_str(), index_path_prefix.c_str(), params.c_str(), metric, use_opq, codebook_prefix,
+                    use_filters, label_file, universal_label, filter_threshold, Lf, reorder_layout, fast_scan_pq,
+                    entry_layer_sample_rate, num_entry_centroids, minibatch_kmeans, resume, only_shards);
             else
             {
                 diskann::cerr << "Error. Unsupported data type" << std::endl;
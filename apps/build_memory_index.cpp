@@ -17,6 +17,7 @@
 #endif
 
 #include "memory_mapper.h"
+#include "memory_policy.h"
 #include "ann_exception.h"
 #include "index_factory.h"
 
@@ -24,10 +25,12 @@ namespace po = boost::program_options;
 
 int main(int argc, char **argv)
 {
-    std::string data_type, dist_fn, data_path, index_path_prefix, label_file, universal_label, label_type;
-    uint32_t num_threads, R, L, Lf, build_PQ_bytes;
-    float alpha;
-    bool use_pq_build, use_opq;
+    std::string data_type, dist_fn, data_path, index_path_prefix, label_file, universal_label, label_type, huge_pages,
+        numa_placement;
+    uint32_t num_threads, R, L, Lf, build_PQ_bytes, build_SQ_bits, build_PCA_dims, num_lock_stripes, build_passes,
+        first_pass_threads, locality_clusters;
+    float alpha, first_pass_alpha;
+    bool use_pq_build, use_opq, flat_graph_store, precompute_norms, build_from_disk;
 
     po::options_description desc{
         program_options_utils::make_program_description("build_memory_index", "Build a memory-based DiskANN index.")};
@@ -61,6 +64,14 @@ int main(int argc, char **argv)
                                        program_options_utils::BUIlD_GRAPH_PQ_BYTES);
         optional_configs.add_options()("use_opq", po::bool_switch()->default_value(false),
                                        program_options_utils::USE_OPQ);
+        optional_configs.add_options()("build_SQ_bits", po::value<uint32_t>(&build_SQ_bits)->default_value(0),
+                                       "Build and search on vectors scalar quantized to 8 or 4 bits per dimension "
+                                       "instead of full precision; exclusive with build_PQ_bytes. 0 (default) "
+                                       "disables it.");
+        optional_configs.add_options()("build_PCA_dims", po::value<uint32_t>(&build_PCA_dims)->default_value(0),
+                                       "Build and search on the projections of the vectors on this many principal "
+                                       "components instead of full precision; exclusive with build_PQ_bytes and "
+                                       "build_SQ_bits. 0 (default) disables it.");
         optional_configs.add_options()("label_file", po::value<std::string>(&label_file)->default_value(""),
                                        program_options_utils::LABEL_FILE);
         optional_configs.add_options()("universal_label", po::value<std::string>(&universal_label)->default_value(""),
@@ -70,6 +81,38 @@ int main(int argc, char **argv)
                                        program_options_utils::FILTERED_LBUILD);
         optional_configs.add_options()("label_type", po::value<std::string>(&label_type)->default_value("uint"),
                                        program_options_utils::LABEL_TYPE_DESCRIPTION);
+        optional_configs.add_options()("flat_graph_store", po::bool_switch()->default_value(false),
+                                       "Keep the graph in one fixed-stride array of (R + slack + 1) slots per node "
+                                       "instead of a vector per node during build.");
+        optional_configs.add_options()("num_lock_stripes",
+                                       po::value<uint32_t>(&num_lock_stripes)->default_value(0),
+                                       "Number of neighbour-list locks shared by all points during build. "
+                                       "0 (default) allocates one lock per point.");
+        optional_configs.add_options()("precompute_norms", po::bool_switch(&precompute_norms)->default_value(false),
+                                       "Keep the norm of every vector and compute l2 and cosine distances from the "
+                                       "norms and one inner product. float, fp16 and bf16 data only.");
+        optional_configs.add_options()("build_from_disk", po::bool_switch(&build_from_disk)->default_value(false),
+                                       "Keep only the build_PQ_bytes or build_SQ_bits codes in memory and page the "
+                                       "full vectors in from an aligned copy of data_path, written next to it, for "
+                                       "pruning. Needs build_PQ_bytes or build_SQ_bits.");
+        optional_configs.add_options()("build_passes", po::value<uint32_t>(&build_passes)->default_value(1),
+                                       "Number of passes over all points when building the graph. All passes but "
+                                       "the last use first_pass_alpha.");
+        optional_configs.add_options()("first_pass_alpha", po::value<float>(&first_pass_alpha)->default_value(1.0f),
+                                       "Alpha of all build passes but the last.");
+        optional_configs.add_options()("first_pass_threads",
+                                       po::value<uint32_t>(&first_pass_threads)->default_value(0),
+                                       "Threads of all build passes but the last, at most num_threads. 0 (default) "
+                                       "uses num_threads.");
+        optional_configs.add_options()("locality_clusters",
+                                       po::value<uint32_t>(&locality_clusters)->default_value(0),
+                                       "Insert the points grouped by the nearest of this many sampled pivots (e.g. "
+                                       "256) so that threads work on nearby points. 0 (default) inserts them in "
+                                       "order.");
+        optional_configs.add_options()("huge_pages", po::value<std::string>(&huge_pages)->default_value("auto"),
+                                       program_options_utils::HUGE_PAGES);
+        optional_configs.add_options()("numa", po::value<std::string>(&numa_placement)->default_value("first_touch"),
+                                       program_options_utils::NUMA_PLACEMENT);
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs);
@@ -84,6 +127,11 @@ int main(int argc, char **argv)
         po::notify(vm);
         use_pq_build = (build_PQ_bytes > 0);
         use_opq = vm["use_opq"].as<bool>();
+        flat_graph_store = vm["flat_graph_store"].as<bool>();
+        diskann::MemoryPolicy memory_policy;
+        memory_policy.huge_pages = diskann::parse_huge_page_mode(huge_pages);
+        memory_policy.numa = diskann::parse_numa_placement(numa_placement);
+        diskann::set_memory_policy(memory_policy);
     }
     catch (const std::exception &ex)
     {
@@ -104,10 +152,14 @@ int main(int argc, char **argv)
     {
         metric = diskann::Metric::COSINE;
     }
+    else if ((dist_fn == std::string("hamming")) && (data_type == std::string("uint8")))
+    {
+        metric = diskann::Metric::HAMMING;
+    }
     else
     {
         std::cout << "Unsupported distance function. Currently only L2/ Inner "
-                     "Product/Cosine are supported."
+                     "Product/Cosine/Hamming are supported."
                   << std::endl;
         return -1;
     }
@@ -125,6 +177,8 @@ int main(int argc, char **argv)
                                       .with_alpha(alpha)
                                       .with_saturate_graph(false)
                                       .with_num_threads(num_threads)
+                                      .with_num_passes(build_passes, first_pass_alpha, first_pass_threads)
+                                      .with_locality_clusters(locality_clusters)
                                       .build();
 
         auto filter_params = diskann::IndexFilterParamsBuilder()
@@ -136,8 +190,10 @@ int main(int argc, char **argv)
                           .with_metric(metric)
                           .with_dimension(data_dim)
                           .with_max_points(data_num)
-                          .with_data_load_store_strategy(diskann::DataStoreStrategy::MEMORY)
-                          .with_graph_load_store_strategy(diskann::GraphStoreStrategy::MEMORY)
+                          .with_data_load_store_strategy(build_from_disk ? diskann::DataStoreStrategy::MMAP_BUILD
+                                                                         : diskann::DataStoreStrategy::MEMORY)
+                          .with_graph_load_store_strategy(flat_graph_store ? diskann::GraphStoreStrategy::FLAT
+                                                                           : diskann::GraphStoreStrategy::MEMORY)
                           .with_data_type(data_type)
                           .with_label_type(label_type)
                           .is_dynamic_index(false)
@@ -146,6 +202,10 @@ int main(int argc, char **argv)
                           .is_use_opq(use_opq)
                           .is_pq_dist_build(use_pq_build)
                           .with_num_pq_chunks(build_PQ_bytes)
+                          .with_num_sq_bits(build_SQ_bits)
+                          .with_num_pca_dims(build_PCA_dims)
+                          .with_num_lock_stripes(num_lock_stripes)
+                          .is_precompute_norms(precompute_norms)
                           .build();
 
         auto index_factory = diskann::IndexFactory(config);
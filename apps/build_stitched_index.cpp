@@ -5,6 +5,7 @@
 #include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <mutex>
 #include <random>
 #include <string>
 #include <tuple>
@@ -53,7 +54,7 @@ inline size_t random(size_t range_from, size_t range_to)
  */
 void handle_args(int argc, char **argv, std::string &data_type, path &input_data_path, path &final_index_path_prefix,
                  path &label_data_path, std::string &universal_label, uint32_t &num_threads, uint32_t &R, uint32_t &L,
-                 uint32_t &stitched_R, float &alpha)
+                 uint32_t &stitched_R, float &alpha, double &build_dram_budget)
 {
     po::options_description desc{
         program_options_utils::make_program_description("build_stitched_index", "Build a stitched DiskANN index.")};
@@ -88,6 +89,11 @@ void handle_args(int argc, char **argv, std::string &data_type, path &input_data
                                        program_options_utils::UNIVERSAL_LABEL);
         optional_configs.add_options()("stitched_R", po::value<uint32_t>(&stitched_R)->default_value(100),
                                        "Degree to prune final graph down to");
+        optional_configs.add_options()("build_DRAM_budget,M",
+                                       po::value<double>(&build_dram_budget)->default_value(0),
+                                       "RAM budget in GB for a streaming build that reads the points of each label "
+                                       "from the base file and writes the stitched graph as it is pruned; 0 builds "
+                                       "it in memory from per-label files");
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs);
@@ -109,20 +115,17 @@ void handle_args(int argc, char **argv, std::string &data_type, path &input_data
 }
 
 /*
- * Custom index save to write the in-memory index to disk.
- * Also writes required files for diskANN API -
+ * Writes the files the diskANN API needs alongside the graph -
  *  1. labels_to_medoids
  *  2. universal_label
  *  3. data (redundant for static indices)
  *  4. labels (redundant for static indices)
  */
-void save_full_index(path final_index_path_prefix, path input_data_path, uint64_t final_index_size,
-                     std::vector<std::vector<uint32_t>> stitched_graph,
-                     tsl::robin_map<std::string, uint32_t> entry_points, std::string universal_label,
-                     path label_data_path)
+void save_index_aux_files(path final_index_path_prefix, path input_data_path,
+                          const tsl::robin_map<std::string, uint32_t> &entry_points, std::string universal_label,
+                          path label_data_path)
 {
     // aux. file 1
-    auto saving_index_timer = std::chrono::high_resolution_clock::now();
     std::ifstream original_label_data_stream;
     original_label_data_stream.exceptions(std::ios::badbit | std::ios::failbit);
     original_label_data_stream.open(label_data_path, std::ios::binary);
@@ -161,6 +164,19 @@ void save_full_index(path final_index_path_prefix, path input_data_path, uint64_
         universal_label_writer << universal_label << std::endl;
         universal_label_writer.close();
     }
+}
+
+/*
+ * Custom index save to write the in-memory index to disk, with the files of
+ * save_index_aux_files.
+ */
+void save_full_index(path final_index_path_prefix, path input_data_path, uint64_t final_index_size,
+                     std::vector<std::vector<uint32_t>> stitched_graph,
+                     tsl::robin_map<std::string, uint32_t> entry_points, std::string universal_label,
+                     path label_data_path)
+{
+    auto saving_index_timer = std::chrono::high_resolution_clock::now();
+    save_index_aux_files(final_index_path_prefix, input_data_path, entry_points, universal_label, label_data_path);
 
     // main index
     uint64_t index_num_frozen_points = 0, index_num_edges = 0;
@@ -227,29 +243,41 @@ stitch_indices_return_values stitch_label_indices(
     std::vector<std::vector<uint32_t>> stitched_graph(total_number_of_points);
 
     auto stitching_index_timer = std::chrono::high_resolution_clock::now();
-    for (const auto &lbl : all_labels)
+    std::vector<std::string> labels(all_labels.begin(), all_labels.end());
+    for (const auto &lbl : labels)
+    {
+        uint32_t curr_label_entry_point = (uint32_t)random(0, labels_to_number_of_points[lbl] - 1);
+        label_entry_points[lbl] = label_id_to_orig_id_map[lbl][curr_label_entry_point];
+    }
+
+    // labels are loaded and merged concurrently; a point's neighbors are
+    // guarded by one of a fixed set of locks
+    const size_t NUM_STITCH_LOCKS = 65536;
+    std::vector<std::mutex> stitch_locks(NUM_STITCH_LOCKS);
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : final_index_size)
+    for (int64_t i = 0; i < (int64_t)labels.size(); i++)
     {
+        const std::string &lbl = labels[i];
         path curr_label_index_path(final_index_path_prefix + "_" + lbl);
         std::vector<std::vector<uint32_t>> curr_label_index;
         uint64_t curr_label_index_size;
-        uint32_t curr_label_entry_point;
 
         std::tie(curr_label_index, curr_label_index_size) =
-            diskann::load_label_index(curr_label_index_path, labels_to_number_of_points[lbl]);
-        curr_label_entry_point = (uint32_t)random(0, curr_label_index.size());
-        label_entry_points[lbl] = label_id_to_orig_id_map[lbl][curr_label_entry_point];
+            diskann::load_label_index(curr_label_index_path, labels_to_number_of_points.at(lbl));
+        const std::vector<uint32_t> &orig_ids = label_id_to_orig_id_map.at(lbl);
 
         for (uint32_t node_point = 0; node_point < curr_label_index.size(); node_point++)
         {
-            uint32_t original_point_id = label_id_to_orig_id_map[lbl][node_point];
+            uint32_t original_point_id = orig_ids[node_point];
+            std::lock_guard<std::mutex> guard(stitch_locks[original_point_id % NUM_STITCH_LOCKS]);
+            std::vector<uint32_t> &curr_point_neighbors = stitched_graph[original_point_id];
             for (auto &node_neighbor : curr_label_index[node_point])
             {
-                uint32_t original_neighbor_id = label_id_to_orig_id_map[lbl][node_neighbor];
-                std::vector<uint32_t> curr_point_neighbors = stitched_graph[original_point_id];
+                uint32_t original_neighbor_id = orig_ids[node_neighbor];
                 if (std::find(curr_point_neighbors.begin(), curr_point_neighbors.end(), original_neighbor_id) ==
                     curr_point_neighbors.end())
                 {
-                    stitched_graph[original_point_id].push_back(original_neighbor_id);
+                    curr_point_neighbors.push_back(original_neighbor_id);
                     final_index_size += sizeof(uint32_t);
                 }
             }
@@ -336,10 +364,11 @@ int main(int argc, char **argv)
     std::string universal_label;
     uint32_t num_threads, R, L, stitched_R;
     float alpha;
+    double build_dram_budget;
 
     auto index_timer = std::chrono::high_resolution_clock::now();
     handle_args(argc, argv, data_type, input_data_path, final_index_path_prefix, label_data_path, universal_label,
-                num_threads, R, L, stitched_R, alpha);
+                num_threads, R, L, stitched_R, alpha, build_dram_budget);
 
     path labels_file_to_use = final_index_path_prefix + "_label_formatted.txt";
     path labels_map_file = final_index_path_prefix + "_labels_map.txt";
@@ -354,6 +383,32 @@ int main(int argc, char **argv)
     std::tie(point_ids_to_labels, labels_to_number_of_points, all_labels) =
         diskann::parse_label_file(labels_file_to_use, universal_label);
 
+    // 3-6 in a single streaming pass under the RAM budget
+    if (build_dram_budget > 0)
+    {
+        tsl::robin_map<std::string, uint32_t> label_entry_points;
+        if (data_type == "uint8")
+            diskann::build_stitched_index_streaming<uint8_t>(input_data_path, final_index_path_prefix,
+                                                             point_ids_to_labels, all_labels, R, L, alpha, stitched_R,
+                                                             num_threads, build_dram_budget, label_entry_points);
+        else if (data_type == "int8")
+            diskann::build_stitched_index_streaming<int8_t>(input_data_path, final_index_path_prefix,
+                                                            point_ids_to_labels, all_labels, R, L, alpha, stitched_R,
+                                                            num_threads, build_dram_budget, label_entry_points);
+        else if (data_type == "float")
+            diskann::build_stitched_index_streaming<float>(input_data_path, final_index_path_prefix,
+                                                           point_ids_to_labels, all_labels, R, L, alpha, stitched_R,
+                                                           num_threads, build_dram_budget, label_entry_points);
+        else
+            throw;
+        save_index_aux_files(final_index_path_prefix, input_data_path, label_entry_points, universal_label,
+                             labels_file_to_use);
+
+        std::chrono::duration<double> index_time = std::chrono::high_resolution_clock::now() - index_timer;
+        std::cout << "pruned/stitched graph generated in " << index_time.count() << " seconds" << std::endl;
+        return 0;
+    }
+
     // 3. for each label, make a separate data file
     tsl::robin_map<std::string, std::vector<uint32_t>> label_id_to_orig_id_map;
     uint32_t total_number_of_points = (uint32_t)point_ids_to_labels.size();
@@ -42,6 +42,10 @@ int main(int argc, char *argv[])
     uint32_t num_threads;
     uint32_t l_search;
 
+    diskann::ResultCacheParameters cache_params;
+    diskann::BatchingParameters batching_params;
+    diskann::AdmissionParameters admission_params;
+    diskann::UpdateParameters update_params;
     po::options_description desc{"Arguments"};
     try
     {
@@ -59,6 +63,43 @@ int main(int argc, char *argv[])
                            "distance function <l2/mips>");
         desc.add_options()("tags_file", po::value<std::string>(&tags_file)->default_value(std::string()),
                            "Tags file location");
+        desc.add_options()("result_cache_size", po::value<size_t>(&cache_params.capacity)->default_value(0),
+                           "Serve repeated queries from a cache of this many results (0 disables it)");
+        desc.add_options()("result_cache_ttl", po::value<uint32_t>(&cache_params.ttl_seconds)->default_value(0),
+                           "Seconds a cached result is served for (0 until it is evicted)");
+        desc.add_options()("result_cache_quantization",
+                           po::value<float>(&cache_params.quantization_step)->default_value(0.0f),
+                           "Round query coordinates to multiples of this step before looking them up, so that "
+                           "near-duplicate queries share results (0 matches exact queries only)");
+        desc.add_options()("batch_size", po::value<uint32_t>(&batching_params.max_batch_size)->default_value(0),
+                           "Search concurrent queries in batches of up to this many (0 searches each on its own)");
+        desc.add_options()("batch_wait_us", po::value<uint32_t>(&batching_params.max_wait_us)->default_value(200),
+                           "Microseconds a query waits for others to fill its batch");
+        desc.add_options()("batch_dispatchers",
+                           po::value<uint32_t>(&batching_params.num_dispatchers)->default_value(1),
+                           "Threads that search batches");
+        desc.add_options()("max_in_flight",
+                           po::value<uint32_t>(&admission_params.max_in_flight)->default_value(0),
+                           "Reject queries with 503 while this many are being searched (0 admits all)");
+        desc.add_options()("degrade_in_flight",
+                           po::value<uint32_t>(&admission_params.degrade_in_flight)->default_value(0),
+                           "Scale down the Ls of queries while more than this many are being searched (0 never "
+                           "does)");
+        desc.add_options()("max_points", po::value<uint32_t>(&update_params.max_points)->default_value(0),
+                           "Take inserts and deletes at /insert and /delete, up to this many points in all (0 "
+                           "serves the index read-only). The index must have been built with tags.");
+        desc.add_options()("max_degree,R", po::value<uint32_t>(&update_params.max_degree)->default_value(64),
+                           "Maximum graph degree of inserted points");
+        desc.add_options()("insert_l", po::value<uint32_t>(&update_params.insert_l)->default_value(100),
+                           "Build complexity of inserted points");
+        desc.add_options()("alpha", po::value<float>(&update_params.alpha)->default_value(1.2f),
+                           "Alpha of inserted points");
+        desc.add_options()("insert_threads",
+                           po::value<uint32_t>(&update_params.num_threads)->default_value(0),
+                           "Threads inserting each batch (0 for one per core)");
+        desc.add_options()("consolidate_after",
+                           po::value<uint32_t>(&update_params.consolidate_after)->default_value(0),
+                           "Consolidate deletes once this many points are deleted (0 never does)");
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
         if (vm.count("help"))
@@ -87,19 +128,22 @@ int main(int argc, char *argv[])
     if (data_type == std::string("float"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::InMemorySearch<float>(data_file, index_file, tags_file, metric, num_threads, l_search));
+            new diskann::InMemorySearch<float>(data_file, index_file, tags_file, metric, num_threads, l_search,
+                                               update_params));
         g_inMemorySearch.push_back(std::move(searcher));
     }
     else if (data_type == std::string("int8"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::InMemorySearch<int8_t>(data_file, index_file, tags_file, metric, num_threads, l_search));
+            new diskann::InMemorySearch<int8_t>(data_file, index_file, tags_file, metric, num_threads, l_search,
+                                                update_params));
         g_inMemorySearch.push_back(std::move(searcher));
     }
     else if (data_type == std::string("uint8"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::InMemorySearch<uint8_t>(data_file, index_file, tags_file, metric, num_threads, l_search));
+            new diskann::InMemorySearch<uint8_t>(data_file, index_file, tags_file, metric, num_threads, l_search,
+                                                 update_params));
         g_inMemorySearch.push_back(std::move(searcher));
     }
     else
@@ -107,6 +151,13 @@ int main(int argc, char *argv[])
         std::cerr << "Unsupported data type " << argv[2] << std::endl;
     }
 
+    for (auto &searcher : g_inMemorySearch)
+    {
+        searcher->enable_result_cache(cache_params);
+        searcher->enable_batching(batching_params);
+        searcher->enable_admission_control(admission_params);
+    }
+
     while (1)
     {
         try
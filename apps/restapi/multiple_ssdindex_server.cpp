@@ -17,6 +17,8 @@ namespace po = boost::program_options;
 
 std::unique_ptr<Server> g_httpServer(nullptr);
 std::vector<std::unique_ptr<diskann::BaseSearch>> g_ssdSearch;
+uint32_t g_shardThreads = 0;
+uint32_t g_shardDeadlineMs = 0;
 
 void setup(const utility::string_t &address, const std::string &typestring)
 {
@@ -25,7 +27,7 @@ void setup(const utility::string_t &address, const std::string &typestring)
 
     std::cout << "Attempting to start server on " << uri.to_string() << std::endl;
 
-    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_ssdSearch, typestring));
+    g_httpServer = std::unique_ptr<Server>(new Server(uri, g_ssdSearch, typestring, g_shardThreads, g_shardDeadlineMs));
     std::cout << "Created a server object" << std::endl;
 
     g_httpServer->open().wait();
@@ -37,11 +39,31 @@ void teardown(const utility::string_t &address)
     g_httpServer->close().wait();
 }
 
+// With shared_scratch_threads, the indices search with the scratch and IO
+// contexts of one search host instead of num_threads of their own each
+template <typename T>
+void load_indices(const std::vector<std::pair<std::string, std::string>> &index_tag_paths,
+                  const uint32_t num_nodes_to_cache, const uint32_t num_threads, const diskann::Metric metric,
+                  const uint32_t shared_scratch_threads, const uint32_t max_dims, const uint64_t memory_quota)
+{
+    std::shared_ptr<diskann::SSDSearchHost<T>> host;
+    if (shared_scratch_threads > 0)
+        host = std::make_shared<diskann::SSDSearchHost<T>>(shared_scratch_threads, max_dims);
+    for (auto &index_tag : index_tag_paths)
+    {
+        auto searcher = std::unique_ptr<diskann::BaseSearch>(
+            new diskann::PQFlashSearch<T>(index_tag.first, num_nodes_to_cache, num_threads, index_tag.second, metric,
+                                          false, false, host, memory_quota));
+        g_ssdSearch.push_back(std::move(searcher));
+    }
+}
+
 int main(int argc, char *argv[])
 {
     std::string data_type, index_prefix_paths, address, dist_fn, tags_file;
     uint32_t num_nodes_to_cache;
     uint32_t num_threads;
+    uint32_t shared_scratch_threads, max_dims, index_memory_mb;
 
     po::options_description desc{"Arguments"};
     try
@@ -60,6 +82,21 @@ int main(int argc, char *argv[])
                            "distance function <l2/mips>");
         desc.add_options()("tags_file", po::value<std::string>(&tags_file)->default_value(std::string()),
                            "Tags file location");
+        desc.add_options()("shard_threads", po::value<uint32_t>(&g_shardThreads)->default_value(0),
+                           "Threads that search the indices of a query concurrently (defaults to one per core)");
+        desc.add_options()("shard_deadline_ms", po::value<uint32_t>(&g_shardDeadlineMs)->default_value(0),
+                           "Answer a query with the results of the indices that finished within this many "
+                           "milliseconds, marking the response partial (0 waits for all of them)");
+        desc.add_options()("shared_scratch_threads", po::value<uint32_t>(&shared_scratch_threads)->default_value(0),
+                           "Search all indices with one pool of this many scratch spaces and IO contexts, which "
+                           "also caps the searches running at once over all of them, instead of num_threads of "
+                           "each index's own (0 keeps them apart)");
+        desc.add_options()("max_dims", po::value<uint32_t>(&max_dims)->default_value(0),
+                           "Largest dimension of the indices, which the shared scratch is sized for; needed with "
+                           "--shared_scratch_threads");
+        desc.add_options()("index_memory_mb", po::value<uint32_t>(&index_memory_mb)->default_value(0),
+                           "Memory quota of each index, in MB. Indices that need more fail to load, and the node "
+                           "cache of each is cut to what fits (0 for no quota)");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -118,33 +155,21 @@ int main(int argc, char *argv[])
     index_in.close();
     tags_in.close();
 
-    if (data_type == std::string("float"))
+    if (shared_scratch_threads > 0 && max_dims == 0)
     {
-        for (auto &index_tag : index_tag_paths)
-        {
-            auto searcher = std::unique_ptr<diskann::BaseSearch>(new diskann::PQFlashSearch<float>(
-                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric));
-            g_ssdSearch.push_back(std::move(searcher));
-        }
+        std::cerr << "--shared_scratch_threads needs --max_dims" << std::endl;
+        exit(-1);
     }
+    const uint64_t memory_quota = (uint64_t)index_memory_mb * 1024 * 1024;
+    if (data_type == std::string("float"))
+        load_indices<float>(index_tag_paths, num_nodes_to_cache, num_threads, metric, shared_scratch_threads,
+                            max_dims, memory_quota);
     else if (data_type == std::string("int8"))
-    {
-        for (auto &index_tag : index_tag_paths)
-        {
-            auto searcher = std::unique_ptr<diskann::BaseSearch>(new diskann::PQFlashSearch<int8_t>(
-                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric));
-            g_ssdSearch.push_back(std::move(searcher));
-        }
-    }
+        load_indices<int8_t>(index_tag_paths, num_nodes_to_cache, num_threads, metric, shared_scratch_threads,
+                             max_dims, memory_quota);
     else if (data_type == std::string("uint8"))
-    {
-        for (auto &index_tag : index_tag_paths)
-        {
-            auto searcher = std::unique_ptr<diskann::BaseSearch>(new diskann::PQFlashSearch<uint8_t>(
-                index_tag.first.c_str(), num_nodes_to_cache, num_threads, index_tag.second.c_str(), metric));
-            g_ssdSearch.push_back(std::move(searcher));
-        }
-    }
+        load_indices<uint8_t>(index_tag_paths, num_nodes_to_cache, num_threads, metric, shared_scratch_threads,
+                              max_dims, memory_quota);
     else
     {
         std::cerr << "Unsupported data type " << data_type << std::endl;
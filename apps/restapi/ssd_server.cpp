@@ -42,7 +42,11 @@ int main(int argc, char *argv[])
     std::string data_type, index_path_prefix, address, dist_fn, tags_file;
     uint32_t num_nodes_to_cache;
     uint32_t num_threads;
+    bool numa_replicas, lazy_load;
 
+    diskann::ResultCacheParameters cache_params;
+    diskann::BatchingParameters batching_params;
+    diskann::AdmissionParameters admission_params;
     po::options_description desc{"Arguments"};
     try
     {
@@ -60,6 +64,34 @@ int main(int argc, char *argv[])
                            "distance function <l2/mips>");
         desc.add_options()("tags_file", po::value<std::string>(&tags_file)->default_value(std::string()),
                            "Tags file location");
+        desc.add_options()("numa_replicas", po::bool_switch(&numa_replicas)->default_value(false),
+                           "Load one copy of the index per NUMA node and serve each query from the copy on the "
+                           "node it runs on");
+        desc.add_options()("lazy_load", po::bool_switch(&lazy_load)->default_value(false),
+                           "Start serving before the PQ codes and the node cache are in memory, at a higher "
+                           "latency until they are");
+        desc.add_options()("result_cache_size", po::value<size_t>(&cache_params.capacity)->default_value(0),
+                           "Serve repeated queries from a cache of this many results (0 disables it)");
+        desc.add_options()("result_cache_ttl", po::value<uint32_t>(&cache_params.ttl_seconds)->default_value(0),
+                           "Seconds a cached result is served for (0 until it is evicted)");
+        desc.add_options()("result_cache_quantization",
+                           po::value<float>(&cache_params.quantization_step)->default_value(0.0f),
+                           "Round query coordinates to multiples of this step before looking them up, so that "
+                           "near-duplicate queries share results (0 matches exact queries only)");
+        desc.add_options()("batch_size", po::value<uint32_t>(&batching_params.max_batch_size)->default_value(0),
+                           "Search concurrent queries in batches of up to this many (0 searches each on its own)");
+        desc.add_options()("batch_wait_us", po::value<uint32_t>(&batching_params.max_wait_us)->default_value(200),
+                           "Microseconds a query waits for others to fill its batch");
+        desc.add_options()("batch_dispatchers",
+                           po::value<uint32_t>(&batching_params.num_dispatchers)->default_value(1),
+                           "Threads that search batches");
+        desc.add_options()("max_in_flight",
+                           po::value<uint32_t>(&admission_params.max_in_flight)->default_value(0),
+                           "Reject queries with 503 while this many are being searched (0 admits all)");
+        desc.add_options()("degrade_in_flight",
+                           po::value<uint32_t>(&admission_params.degrade_in_flight)->default_value(0),
+                           "Scale down the Ls of queries while more than this many are being searched (0 never "
+                           "does)");
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
         if (vm.count("help"))
@@ -89,19 +121,22 @@ int main(int argc, char *argv[])
     if (data_type == std::string("float"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::PQFlashSearch<float>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric));
+            new diskann::PQFlashSearch<float>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file,
+                                              metric, numa_replicas, lazy_load));
         g_ssdSearch.push_back(std::move(searcher));
     }
     else if (data_type == std::string("int8"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::PQFlashSearch<int8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric));
+            new diskann::PQFlashSearch<int8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file,
+                                               metric, numa_replicas, lazy_load));
         g_ssdSearch.push_back(std::move(searcher));
     }
     else if (data_type == std::string("uint8"))
     {
         auto searcher = std::unique_ptr<diskann::BaseSearch>(
-            new diskann::PQFlashSearch<uint8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file, metric));
+            new diskann::PQFlashSearch<uint8_t>(index_path_prefix, num_nodes_to_cache, num_threads, tags_file,
+                                                metric, numa_replicas, lazy_load));
         g_ssdSearch.push_back(std::move(searcher));
     }
     else
@@ -110,6 +145,13 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    for (auto &searcher : g_ssdSearch)
+    {
+        searcher->enable_result_cache(cache_params);
+        searcher->enable_batching(batching_params);
+        searcher->enable_admission_control(admission_params);
+    }
+
     while (1)
     {
         try
@@ -7,23 +7,40 @@
 #include "index.h"
 #include "disk_utils.h"
 #include "math_utils.h"
+#include "memory_policy.h"
 #include "memory_mapper.h"
 #include "partition.h"
 #include "pq_flash_index.h"
+#include "rabitq_distance.h"
 #include "timer.h"
 #include "percentile_stats.h"
 #include "program_options_utils.hpp"
+#include "search_trace.h"
 
 #ifndef _WINDOWS
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include "linux_aligned_file_reader.h"
+#include "mmap_aligned_file_reader.h"
+#include "striped_aligned_file_reader.h"
+#ifdef USE_IO_URING
+#include "io_uring_aligned_file_reader.h"
+#endif
+#ifdef USE_SPDK
+#include "spdk_aligned_file_reader.h"
+#endif
+#ifdef USE_REMOTE_STORAGE
+#include "remote_aligned_file_reader.h"
+#endif
 #else
 #ifdef USE_BING_INFRA
 #include "bing_aligned_file_reader.h"
 #else
 #include "windows_aligned_file_reader.h"
+#ifdef USE_IORING
+#include "windows_ioring_aligned_file_reader.h"
+#endif
 #endif
 #endif
 
@@ -47,13 +64,78 @@ void print_stats(std::string category, std::vector<float> percentiles, std::vect
     diskann::cout << std::endl;
 }
 
+std::shared_ptr<AlignedFileReader> create_reader(const std::string &io_backend, const std::string &disk_index_file,
+                                                 const uint32_t aio_busy_poll_us = 0)
+{
+    std::shared_ptr<AlignedFileReader> reader = nullptr;
+#ifdef _WINDOWS
+#ifndef USE_BING_INFRA
+#ifdef USE_IORING
+    if (io_backend == "ioring")
+        reader.reset(new WindowsIoRingAlignedFileReader());
+    else
+#endif
+        reader.reset(new WindowsAlignedFileReader());
+#else
+    reader.reset(new diskann::BingAlignedFileReader());
+#endif
+#else
+#ifdef USE_REMOTE_STORAGE
+    // an index in an object store is fetched from there, whatever the backend
+    if (RemoteAlignedFileReader::is_remote(disk_index_file))
+    {
+        reader.reset(new RemoteAlignedFileReader());
+        return reader;
+    }
+#endif
+    // an index striped by stripe_disk_index is read with aio from all its
+    // stripes, whatever the backend
+    if (StripedAlignedFileReader::is_striped(disk_index_file))
+    {
+        reader.reset(new StripedAlignedFileReader());
+        return reader;
+    }
+    if (io_backend == "mmap")
+    {
+        reader.reset(new MmapAlignedFileReader());
+        return reader;
+    }
+#ifdef USE_SPDK
+    if (io_backend == "spdk")
+    {
+        reader.reset(new SpdkAlignedFileReader());
+        return reader;
+    }
+#endif
+#ifdef USE_IO_URING
+    if (io_backend == "io_uring" || io_backend == "io_uring_sqpoll")
+        reader.reset(new IoUringAlignedFileReader(io_backend == "io_uring_sqpoll"));
+    else
+#endif
+        reader.reset(new LinuxAlignedFileReader(aio_busy_poll_us));
+#endif
+    return reader;
+}
+
 template <typename T, typename LabelT = uint32_t>
 int search_disk_index(diskann::Metric &metric, const std::string &index_path_prefix,
                       const std::string &result_output_prefix, const std::string &query_file, std::string &gt_file,
                       const uint32_t num_threads, const uint32_t recall_at, const uint32_t beamwidth,
                       const uint32_t num_nodes_to_cache, const uint32_t search_io_limit,
                       const std::vector<uint32_t> &Lvec, const float fail_if_recall_below,
-                      const std::vector<std::string> &query_filters, const bool use_reorder_data = false)
+                      const std::vector<std::string> &query_filters, const bool use_reorder_data = false,
+                      const std::string &io_backend = "aio", const bool pipelined_search = false,
+                      const uint32_t search_batch_size = 1, const uint32_t adaptive_max_beamwidth = 0,
+                      const uint32_t early_stop_hops = 0, const uint32_t dynamic_cache_mb = 0,
+                      const bool sector_cache = false, const bool score_colocated = false,
+                      const bool numa_replicas = false,
+                      const uint32_t filter_scan_max_points = diskann::defaults::FILTER_SCAN_MAX_POINTS,
+                      const float filter_post_min_fraction = diskann::defaults::FILTER_POST_FILTER_MIN_FRACTION,
+                      const std::string &stats_file = "", const bool io_profile = false,
+                      const uint32_t slow_read_us = 0, const uint32_t speculative_reads = 0,
+                      const uint32_t max_wasted_speculative_reads = 0, const bool use_rabitq = false,
+                      const std::string &cache_file = "", const std::string &access_trace = "",
+                      const uint32_t aio_busy_poll_us = 0, const std::string &delete_list = "")
 {
     diskann::cout << "Search parameters: #threads: " << num_threads << ", ";
     if (beamwidth <= 0)
@@ -98,38 +180,91 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
         calc_recall_flag = true;
     }
 
-    std::shared_ptr<AlignedFileReader> reader = nullptr;
-#ifdef _WINDOWS
-#ifndef USE_BING_INFRA
-    reader.reset(new WindowsAlignedFileReader());
-#else
-    reader.reset(new diskann::BingAlignedFileReader());
-#endif
-#else
-    reader.reset(new LinuxAlignedFileReader());
-#endif
-
-    std::unique_ptr<diskann::PQFlashIndex<T, LabelT>> _pFlashIndex(
-        new diskann::PQFlashIndex<T, LabelT>(reader, metric));
-
-    int res = _pFlashIndex->load(num_threads, index_path_prefix.c_str());
-
-    if (res != 0)
+    // With numa_replicas every NUMA node gets its own copy of the in-memory
+    // parts of the index (PQ codes, caches, centroids) and its own file reader,
+    // all loaded from a thread pinned to the node. Search threads are pinned
+    // too and only use the replica of their node.
+    const uint32_t num_replicas = numa_replicas ? diskann::get_num_numa_nodes() : 1;
+    const uint32_t threads_per_replica = (uint32_t)DIV_ROUND_UP(num_threads, num_replicas);
+    std::vector<std::unique_ptr<diskann::PQFlashIndex<T, LabelT>>> replicas(num_replicas);
+    std::vector<int> load_results(num_replicas, 0);
+    auto load_replica = [&](uint32_t replica) {
+        std::shared_ptr<AlignedFileReader> reader =
+            create_reader(io_backend, index_path_prefix + "_disk.index", aio_busy_poll_us);
+        replicas[replica].reset(new diskann::PQFlashIndex<T, LabelT>(reader, metric));
+        if (use_rabitq)
+        {
+            std::unique_ptr<diskann::RaBitQDistance<T>> rabitq(new diskann::RaBitQDistance<T>());
+            rabitq->load_pivot_data(rabitq->get_pivot_data_filename(index_path_prefix), 0);
+            replicas[replica]->set_quantizer(std::move(rabitq));
+        }
+        load_results[replica] = replicas[replica]->load(threads_per_replica, index_path_prefix.c_str());
+        if (load_results[replica] != 0)
+            return;
+        if (pipelined_search)
+            replicas[replica]->set_pipelined_search(true);
+        if (adaptive_max_beamwidth > 0 || early_stop_hops > 0)
+            replicas[replica]->set_adaptive_search(adaptive_max_beamwidth, early_stop_hops);
+        if (speculative_reads > 0)
+            replicas[replica]->set_speculative_reads(speculative_reads, max_wasted_speculative_reads);
+        if (dynamic_cache_mb > 0)
+            replicas[replica]->set_dynamic_cache_budget((uint64_t)dynamic_cache_mb * 1024 * 1024);
+        if (score_colocated)
+            replicas[replica]->set_score_colocated_nodes(true);
+    };
+    if (num_replicas > 1)
     {
-        return res;
+        diskann::cout << "Loading one replica of the index on each of " << num_replicas << " NUMA nodes" << std::endl;
+        diskann::run_on_each_numa_node(load_replica);
     }
+    else
+    {
+        load_replica(0);
+    }
+    for (int res : load_results)
+    {
+        if (res != 0)
+            return res;
+    }
+    std::unique_ptr<diskann::PQFlashIndex<T, LabelT>> &_pFlashIndex = replicas[0];
 
+    // a saved cache is restored as it is, without picking the nodes again
+    const bool restore_cache = !cache_file.empty() && file_exists(cache_file);
     std::vector<uint32_t> node_list;
-    diskann::cout << "Caching " << num_nodes_to_cache << " nodes around medoid(s)" << std::endl;
-    _pFlashIndex->cache_bfs_levels(num_nodes_to_cache, node_list);
+    if (!restore_cache)
+    {
+        diskann::cout << "Caching " << num_nodes_to_cache << " nodes around medoid(s)" << std::endl;
+        _pFlashIndex->cache_bfs_levels(num_nodes_to_cache, node_list);
+    }
     // if (num_nodes_to_cache > 0)
     //     _pFlashIndex->generate_cache_list_from_sample_queries(warmup_query_file, 15, 6, num_nodes_to_cache,
     //     num_threads, node_list);
-    _pFlashIndex->load_cache_list(node_list);
+    auto load_replica_cache = [&](uint32_t replica) {
+        replicas[replica]->set_sector_cache_mode(sector_cache);
+        if (restore_cache)
+            replicas[replica]->load_cache(cache_file);
+        else
+            replicas[replica]->load_cache_list(node_list);
+        if (!query_filters.empty())
+            replicas[replica]->set_filter_planner(filter_scan_max_points, filter_post_min_fraction);
+        if (!delete_list.empty())
+            replicas[replica]->load_delete_list(delete_list);
+    };
+    if (num_replicas > 1)
+        diskann::run_on_each_numa_node(load_replica_cache);
+    else
+        load_replica_cache(0);
+    if (!cache_file.empty() && !restore_cache)
+        _pFlashIndex->save_cache(cache_file);
     node_list.clear();
     node_list.shrink_to_fit();
 
     omp_set_num_threads(num_threads);
+    if (num_replicas > 1)
+    {
+#pragma omp parallel num_threads((int)num_threads)
+        diskann::pin_thread_to_numa_node((uint32_t)omp_get_thread_num() / threads_per_replica);
+    }
 
     uint64_t warmup_L = 20;
     uint64_t warmup_num = 0, warmup_dim = 0, warmup_aligned_dim = 0;
@@ -173,6 +308,27 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
         diskann::cout << "..done" << std::endl;
     }
 
+    // sample the reads of the searches only, not those of loading and warmup
+    if (io_profile)
+    {
+        for (auto &replica : replicas)
+        {
+            replica->reader->enable_io_metrics();
+            if (replica->reader->get_io_metrics() == nullptr)
+                diskann::cerr << "The " << io_backend << " reader does not profile its reads" << std::endl;
+            else if (slow_read_us > 0)
+                replica->reader->get_io_metrics()->set_slow_read_alert(slow_read_us);
+        }
+    }
+
+    // record the searches only; each replica records the queries it serves
+    if (!access_trace.empty())
+    {
+        for (uint32_t replica = 0; replica < num_replicas; replica++)
+            replicas[replica]->set_access_trace(num_replicas > 1 ? access_trace + "_" + std::to_string(replica)
+                                                                 : access_trace);
+    }
+
     diskann::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
     diskann::cout.precision(2);
 
@@ -193,9 +349,20 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
     std::vector<std::vector<uint32_t>> query_result_ids(Lvec.size());
     std::vector<std::vector<float>> query_result_dists(Lvec.size());
 
+    std::ofstream stats_out;
+    if (!stats_file.empty())
+    {
+        const bool new_file = !file_exists(stats_file);
+        stats_out.open(stats_file, std::ios::app);
+        if (new_file)
+            stats_out << "L,beamwidth,threads,qps,mean_latency_us,p50_latency_us,p99_latency_us,p999_latency_us,"
+                         "mean_ios,mean_cmps,recall\n";
+    }
+
     uint32_t optimized_beamwidth = 2;
 
     double best_recall = 0.0;
+    uint64_t total_spec_reads = 0, total_spec_hits = 0;
 
     for (uint32_t test_id = 0; test_id < Lvec.size(); test_id++)
     {
@@ -224,31 +391,57 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
         std::vector<uint64_t> query_result_ids_64(recall_at * query_num);
         auto s = std::chrono::high_resolution_clock::now();
 
-#pragma omp parallel for schedule(dynamic, 1)
-        for (int64_t i = 0; i < (int64_t)query_num; i++)
+        if (search_batch_size > 1 && !filtered_search && !use_reorder_data)
         {
-            if (!filtered_search)
+            int64_t num_batches = (int64_t)DIV_ROUND_UP(query_num, search_batch_size);
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int64_t b = 0; b < num_batches; b++)
             {
-                _pFlashIndex->cached_beam_search(query + (i * query_aligned_dim), recall_at, L,
-                                                 query_result_ids_64.data() + (i * recall_at),
-                                                 query_result_dists[test_id].data() + (i * recall_at),
-                                                 optimized_beamwidth, use_reorder_data, stats + i);
+                uint64_t first = (uint64_t)b * search_batch_size;
+                uint64_t batch_nq = std::min<uint64_t>(search_batch_size, query_num - first);
+                auto &index = replicas[diskann::get_current_numa_node() % num_replicas];
+                index->batch_cached_beam_search(query + (first * query_aligned_dim), batch_nq, query_aligned_dim,
+                                                recall_at, L, query_result_ids_64.data() + (first * recall_at),
+                                                query_result_dists[test_id].data() + (first * recall_at),
+                                                optimized_beamwidth, stats + first);
             }
-            else
+        }
+        else
+        {
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int64_t i = 0; i < (int64_t)query_num; i++)
             {
-                LabelT label_for_search;
-                if (query_filters.size() == 1)
-                { // one label for all queries
-                    label_for_search = _pFlashIndex->get_converted_label(query_filters[0]);
+                auto &index = replicas[diskann::get_current_numa_node() % num_replicas];
+                if (!filtered_search)
+                {
+                    index->cached_beam_search(query + (i * query_aligned_dim), recall_at, L,
+                                              query_result_ids_64.data() + (i * recall_at),
+                                              query_result_dists[test_id].data() + (i * recall_at),
+                                              optimized_beamwidth, use_reorder_data, stats + i);
                 }
                 else
-                { // one label for each query
-                    label_for_search = _pFlashIndex->get_converted_label(query_filters[i]);
+                {
+                    // one filter for all queries, or one for each query
+                    const std::string &raw_filter = query_filters.size() == 1 ? query_filters[0] : query_filters[i];
+                    if (diskann::is_label_filter_expression(raw_filter))
+                    {
+                        // a boolean filter such as "a&b|c&!d"
+                        index->cached_beam_search(query + (i * query_aligned_dim), recall_at, L,
+                                                  query_result_ids_64.data() + (i * recall_at),
+                                                  query_result_dists[test_id].data() + (i * recall_at),
+                                                  optimized_beamwidth, index->get_converted_filter(raw_filter),
+                                                  use_reorder_data, stats + i);
+                    }
+                    else
+                    {
+                        LabelT label_for_search = _pFlashIndex->get_converted_label(raw_filter);
+                        index->cached_beam_search(query + (i * query_aligned_dim), recall_at, L,
+                                                  query_result_ids_64.data() + (i * recall_at),
+                                                  query_result_dists[test_id].data() + (i * recall_at),
+                                                  optimized_beamwidth, true, label_for_search, use_reorder_data,
+                                                  stats + i);
+                    }
                 }
-                _pFlashIndex->cached_beam_search(
-                    query + (i * query_aligned_dim), recall_at, L, query_result_ids_64.data() + (i * recall_at),
-                    query_result_dists[test_id].data() + (i * recall_at), optimized_beamwidth, true, label_for_search,
-                    use_reorder_data, stats + i);
             }
         }
         auto e = std::chrono::high_resolution_clock::now();
@@ -287,9 +480,57 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
         }
         else
             diskann::cout << std::endl;
+
+        if (stats_out.is_open())
+        {
+            auto total_us = [](const diskann::QueryStats &stats) { return stats.total_us; };
+            stats_out << L << "," << optimized_beamwidth << "," << num_threads << "," << qps << "," << mean_latency
+                      << "," << diskann::get_percentile_stats<float>(stats, query_num, 0.5, total_us) << ","
+                      << diskann::get_percentile_stats<float>(stats, query_num, 0.99, total_us) << "," << latency_999
+                      << "," << mean_ios << ",,";
+            if (calc_recall_flag)
+                stats_out << recall;
+            stats_out << std::endl;
+        }
+        for (int64_t i = 0; i < (int64_t)query_num; i++)
+        {
+            total_spec_reads += stats[i].n_spec_reads;
+            total_spec_hits += stats[i].n_spec_hits;
+        }
         delete[] stats;
     }
 
+    if (speculative_reads > 0)
+    {
+        diskann::cout << "Speculative reads: " << total_spec_reads << ", used by the next hop: " << total_spec_hits
+                      << std::endl;
+    }
+
+    if (io_profile)
+    {
+        diskann::IOMetrics io_metrics;
+        for (auto &replica : replicas)
+        {
+            if (replica->reader->get_io_metrics() != nullptr)
+                io_metrics.add(*replica->reader->get_io_metrics());
+        }
+        auto print_series = [&](const char *name, diskann::IOMetrics::Series series) {
+            const diskann::LatencyHistogram &histogram = io_metrics.histogram(series);
+            diskann::cout << std::setw(22) << name << std::setw(12) << histogram.value_at_quantile(0.5)
+                          << std::setw(12) << histogram.value_at_quantile(0.99) << std::setw(12)
+                          << histogram.value_at_quantile(0.999) << std::setw(12) << histogram.max() << std::endl;
+        };
+        diskann::cout << "IO profile of " << io_metrics.histogram(diskann::IOMetrics::LATENCY_US).count()
+                      << " reads:" << std::endl;
+        diskann::cout << std::setw(22) << "" << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12)
+                      << "p99.9" << std::setw(12) << "max" << std::endl;
+        print_series("Read latency (us)", diskann::IOMetrics::LATENCY_US);
+        print_series("Device queue depth", diskann::IOMetrics::DEVICE_DEPTH);
+        print_series("Context queue depth", diskann::IOMetrics::CONTEXT_DEPTH);
+        if (slow_read_us > 0)
+            diskann::cout << "Reads over " << slow_read_us << "us: " << io_metrics.num_slow_reads() << std::endl;
+    }
+
     diskann::cout << "Done searching. Now saving results " << std::endl;
     uint64_t test_id = 0;
     for (auto L : Lvec)
@@ -313,10 +554,19 @@ int search_disk_index(diskann::Metric &metric, const std::string &index_path_pre
 int main(int argc, char **argv)
 {
     std::string data_type, dist_fn, index_path_prefix, result_path_prefix, query_file, gt_file, filter_label,
-        label_type, query_filters_file;
+        label_type, query_filters_file, io_backend, huge_pages, numa_placement, trace_file, stats_file,
+        cache_file, access_trace, delete_list;
     uint32_t num_threads, K, W, num_nodes_to_cache, search_io_limit;
     std::vector<uint32_t> Lvec;
     bool use_reorder_data = false;
+    bool pipelined_search = false, sector_cache = false, score_colocated = false, numa_replicas = false;
+    bool io_profile = false;
+    uint32_t slow_read_us = 0, aio_busy_poll_us = 0;
+    uint32_t speculative_reads = 0, max_wasted_speculative_reads = 0;
+    bool use_rabitq = false;
+    uint32_t filter_scan_max_points;
+    float filter_post_min_fraction;
+    uint32_t search_batch_size = 1, adaptive_max_beamwidth = 0, early_stop_hops = 0, dynamic_cache_mb = 0;
     float fail_if_recall_below = 0.0f;
 
     po::options_description desc{
@@ -328,7 +578,7 @@ int main(int argc, char **argv)
         // Required parameters
         po::options_description required_configs("Required");
         required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
-                                       program_options_utils::DATA_TYPE_DESCRIPTION);
+                                       program_options_utils::DISK_DATA_TYPE_DESCRIPTION);
         required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
                                        program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
         required_configs.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
@@ -372,6 +622,92 @@ int main(int argc, char **argv)
         optional_configs.add_options()("fail_if_recall_below",
                                        po::value<float>(&fail_if_recall_below)->default_value(0.0f),
                                        program_options_utils::FAIL_IF_RECALL_BELOW);
+        optional_configs.add_options()("pipelined_search", po::bool_switch(&pipelined_search)->default_value(false),
+                                       "Linux only. Overlap each beam's SSD reads with processing of cached nodes and "
+                                       "expand sectors as they complete.  Default value: false");
+        optional_configs.add_options()("adaptive_max_beamwidth",
+                                       po::value<uint32_t>(&adaptive_max_beamwidth)->default_value(0),
+                                       "If non-zero, the beam width of each query starts at -W and adapts per hop "
+                                       "up to this value.  Default value: 0 (fixed beam width)");
+        optional_configs.add_options()("early_stop_hops", po::value<uint32_t>(&early_stop_hops)->default_value(0),
+                                       "If non-zero, stop a query once its top-K has not changed for this many "
+                                       "hops.  Default value: 0 (disabled)");
+        optional_configs.add_options()("speculative_reads", po::value<uint32_t>(&speculative_reads)->default_value(0),
+                                       "Per hop, also read up to this many of the best unexpanded nodes beyond the "
+                                       "beam, so the next hop finds them in memory.  Default value: 0 (off)");
+        optional_configs.add_options()("max_wasted_speculative_reads",
+                                       po::value<uint32_t>(&max_wasted_speculative_reads)->default_value(0),
+                                       "Stop the speculative reads of a query once this many went unused.  "
+                                       "Default value: 0 (no limit)");
+        optional_configs.add_options()("rabitq", po::bool_switch(&use_rabitq)->default_value(false),
+                                       "Score candidates with the RaBitQ codes made by generate_rabitq instead of "
+                                       "the PQ codes, and skip the full-precision reads of candidates whose error "
+                                       "bound rules them out of the top K.  Not with --search_batch_size > 1");
+        optional_configs.add_options()("cache_file", po::value<std::string>(&cache_file)->default_value(""),
+                                       "Restore the node cache from this file if it exists, instead of picking "
+                                       "--num_nodes_to_cache nodes, and otherwise save the cache there once it is "
+                                       "built.  Default value: none");
+        optional_configs.add_options()("delete_list", po::value<std::string>(&delete_list)->default_value(""),
+                                       "Never return the points whose ids are in this .bin file of uint32 ids "
+                                       "with one dimension; they are still used to navigate the graph.  The "
+                                       "ground truth should leave them out.  Default value: none");
+        optional_configs.add_options()("access_trace", po::value<std::string>(&access_trace)->default_value(""),
+                                       "Record the nodes expanded by each query, for every value of L in turn, "
+                                       "to this file, for apps/utils/simulate_cache.  With --numa_replicas, each "
+                                       "replica records to the file name followed by _<replica>.  Default value: none");
+        optional_configs.add_options()("sector_cache", po::bool_switch(&sector_cache)->default_value(false),
+                                       "Keep the nodes cached by --num_nodes_to_cache as whole on-disk sectors in a "
+                                       "single (huge page backed) arena.  Default value: false");
+        optional_configs.add_options()("score_colocated", po::bool_switch(&score_colocated)->default_value(false),
+                                       "Also score the nodes that share a sector with each expanded node.  Useful "
+                                       "for indices built with --reorder_layout.  Default value: false");
+        optional_configs.add_options()("dynamic_cache_mb", po::value<uint32_t>(&dynamic_cache_mb)->default_value(0),
+                                       "Size in MB of a node cache that is populated from SSD reads while "
+                                       "searching, in addition to --num_nodes_to_cache.  Default value: 0");
+        optional_configs.add_options()("search_batch_size",
+                                       po::value<uint32_t>(&search_batch_size)->default_value(1),
+                                       "Number of queries each thread searches in lockstep, sharing one SSD read "
+                                       "submission per round. Ignored for filtered and reorder searches.  Default "
+                                       "value: 1");
+        optional_configs.add_options()("io_backend", po::value<std::string>(&io_backend)->default_value("aio"),
+                                       "I/O backend for SSD reads {aio, io_uring, io_uring_sqpoll, spdk, mmap} on "
+                                       "Linux, {aio, ioring} on Windows. io_uring backends require a build with "
+                                       "-DIO_URING=ON, spdk one with -DSPDK=ON, ioring one with -DIORING=ON. mmap "
+                                       "maps the index into memory.  Default value: aio");
+        optional_configs.add_options()("aio_busy_poll_us", po::value<uint32_t>(&aio_busy_poll_us)->default_value(0),
+                                       "With io_backend aio on Linux, spin for up to this many microseconds on the "
+                                       "completion ring, in user space, before sleeping in io_getevents. Trades a "
+                                       "busy core per search thread for the wakeup latency.  Default value: 0 (off)");
+        optional_configs.add_options()("numa_replicas", po::bool_switch(&numa_replicas)->default_value(false),
+                                       "Load one copy of the in-memory parts of the index per NUMA node, pin the "
+                                       "search threads and route each query to the replica of its node.  Default "
+                                       "value: false");
+        optional_configs.add_options()(
+            "filter_scan_max_points",
+            po::value<uint32_t>(&filter_scan_max_points)->default_value(diskann::defaults::FILTER_SCAN_MAX_POINTS),
+            "Filters that at most this many points match are answered by scanning those points instead of a graph "
+            "search. 0 never scans.  Default value: 0");
+        optional_configs.add_options()("filter_post_min_fraction",
+                                       po::value<float>(&filter_post_min_fraction)
+                                           ->default_value(diskann::defaults::FILTER_POST_FILTER_MIN_FRACTION),
+                                       "Filters that at least this fraction of the points match run an unfiltered "
+                                       "search with a larger L and drop the results that do not match. Values above "
+                                       "1 never post-filter.  Default value: 2");
+        optional_configs.add_options()("huge_pages", po::value<std::string>(&huge_pages)->default_value("auto"),
+                                       program_options_utils::HUGE_PAGES);
+        optional_configs.add_options()("numa", po::value<std::string>(&numa_placement)->default_value("first_touch"),
+                                       program_options_utils::NUMA_PLACEMENT);
+        optional_configs.add_options()("trace_file", po::value<std::string>(&trace_file)->default_value(""),
+                                       "Traces the hops of the searches and writes the last events of each thread "
+                                       "to this file as Chrome trace JSON, for chrome://tracing or Perfetto");
+        optional_configs.add_options()("stats_file", po::value<std::string>(&stats_file)->default_value(""),
+                                       program_options_utils::STATS_FILE);
+        optional_configs.add_options()("io_profile", po::bool_switch(&io_profile)->default_value(false),
+                                       "Samples the latency and queue depth of the reads of the searches and "
+                                       "prints their percentiles. Only the aio reader samples them");
+        optional_configs.add_options()("slow_read_us", po::value<uint32_t>(&slow_read_us)->default_value(0),
+                                       "With --io_profile, warns about and counts the reads slower than this many "
+                                       "microseconds. Default value: 0 (off)");
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs);
@@ -384,6 +720,10 @@ int main(int argc, char **argv)
             return 0;
         }
         po::notify(vm);
+        diskann::MemoryPolicy memory_policy;
+        memory_policy.huge_pages = diskann::parse_huge_page_mode(huge_pages);
+        memory_policy.numa = diskann::parse_numa_placement(numa_placement);
+        diskann::set_memory_policy(memory_policy);
         if (vm["use_reorder_data"].as<bool>())
             use_reorder_data = true;
     }
@@ -406,10 +746,14 @@ int main(int argc, char **argv)
     {
         metric = diskann::Metric::COSINE;
     }
+    else if ((dist_fn == std::string("hamming")) && (data_type == std::string("uint8")))
+    {
+        metric = diskann::Metric::HAMMING;
+    }
     else
     {
         std::cout << "Unsupported distance function. Currently only L2/ Inner "
-                     "Product/Cosine are supported."
+                     "Product/Cosine/Hamming are supported."
                   << std::endl;
         return -1;
     }
@@ -420,6 +764,12 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (use_rabitq && (metric != diskann::Metric::L2 || search_batch_size > 1))
+    {
+        std::cout << "Error: --rabitq needs --dist_fn l2 and --search_batch_size 1." << std::endl;
+        return -1;
+    }
+
     if (use_reorder_data && data_type != std::string("float"))
     {
         std::cout << "Error: Reorder data for reordering currently only "
@@ -428,6 +778,48 @@ int main(int argc, char **argv)
         return -1;
     }
 
+#ifndef _WINDOWS
+    if (io_backend != "aio" && io_backend != "io_uring" && io_backend != "io_uring_sqpoll" && io_backend != "spdk" &&
+        io_backend != "mmap")
+    {
+        std::cerr << "Unsupported io_backend. Use aio, io_uring, io_uring_sqpoll, spdk or mmap" << std::endl;
+        return -1;
+    }
+#else
+    if (io_backend != "aio" && io_backend != "ioring")
+    {
+        std::cerr << "Unsupported io_backend. Use aio or ioring" << std::endl;
+        return -1;
+    }
+#if defined(USE_BING_INFRA) || !defined(USE_IORING)
+    if (io_backend == "ioring")
+    {
+        std::cerr << "io_backend ioring requires a build with -DIORING=ON" << std::endl;
+        return -1;
+    }
+#else
+    if (io_backend == "ioring" && !WindowsIoRingAlignedFileReader::is_supported())
+    {
+        std::cerr << "io_backend ioring requires Windows 11 or Windows Server 2022 or later" << std::endl;
+        return -1;
+    }
+#endif
+#endif
+#if !defined(_WINDOWS) && !defined(USE_IO_URING)
+    if (io_backend == "io_uring" || io_backend == "io_uring_sqpoll")
+    {
+        std::cerr << "io_backend " << io_backend << " requires a build with -DIO_URING=ON" << std::endl;
+        return -1;
+    }
+#endif
+#if !defined(_WINDOWS) && !defined(USE_SPDK)
+    if (io_backend == "spdk")
+    {
+        std::cerr << "io_backend spdk requires a build with -DSPDK=ON" << std::endl;
+        return -1;
+    }
+#endif
+
     if (filter_label != "" && query_filters_file != "")
     {
         std::cerr << "Only one of filter_label and query_filters_file should be provided" << std::endl;
@@ -444,6 +836,29 @@ int main(int argc, char **argv)
         query_filters = read_file_to_vector_of_strings(query_filters_file);
     }
 
+    // writes the trace once the searches are done, whichever way main returns
+    struct TraceDump
+    {
+        std::string path;
+        ~TraceDump()
+        {
+            if (path.empty())
+                return;
+            diskann::SearchTrace::set_enabled(false);
+            try
+            {
+                diskann::SearchTrace::write_chrome_trace(path);
+                diskann::cout << "Wrote the search trace to " << path << std::endl;
+            }
+            catch (const std::exception &e)
+            {
+                diskann::cerr << e.what() << std::endl;
+            }
+        }
+    } trace_dump{trace_file};
+    if (!trace_file.empty())
+        diskann::SearchTrace::set_enabled(true);
+
     try
     {
         if (!query_filters.empty() && label_type == "ushort")
@@ -451,18 +866,51 @@ int main(int argc, char **argv)
             if (data_type == std::string("float"))
                 return search_disk_index<float, uint16_t>(
                     metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
-                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data);
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
             else if (data_type == std::string("int8"))
                 return search_disk_index<int8_t, uint16_t>(
                     metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
-                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data);
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
             else if (data_type == std::string("uint8"))
                 return search_disk_index<uint8_t, uint16_t>(
                     metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
-                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data);
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
+            else if (data_type == std::string("fp16"))
+                return search_disk_index<diskann::float16, uint16_t>(
+                    metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
+            else if (data_type == std::string("bf16"))
+                return search_disk_index<diskann::bfloat16, uint16_t>(
+                    metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
             else
             {
-                std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
+                std::cerr << "Unsupported data type. Use float, int8, uint8, fp16 or bf16" << std::endl;
                 return -1;
             }
         }
@@ -471,18 +919,54 @@ int main(int argc, char **argv)
             if (data_type == std::string("float"))
                 return search_disk_index<float>(metric, index_path_prefix, result_path_prefix, query_file, gt_file,
                                                 num_threads, K, W, num_nodes_to_cache, search_io_limit, Lvec,
-                                                fail_if_recall_below, query_filters, use_reorder_data);
+                                                fail_if_recall_below, query_filters, use_reorder_data, io_backend,
+                                                pipelined_search, search_batch_size, adaptive_max_beamwidth,
+                                                early_stop_hops, dynamic_cache_mb, sector_cache, score_colocated,
+                                                numa_replicas, filter_scan_max_points, filter_post_min_fraction,
+                                                stats_file, io_profile, slow_read_us, speculative_reads,
+                                                max_wasted_speculative_reads, use_rabitq, cache_file, access_trace,
+                                                aio_busy_poll_us, delete_list);
             else if (data_type == std::string("int8"))
                 return search_disk_index<int8_t>(metric, index_path_prefix, result_path_prefix, query_file, gt_file,
                                                  num_threads, K, W, num_nodes_to_cache, search_io_limit, Lvec,
-                                                 fail_if_recall_below, query_filters, use_reorder_data);
+                                                 fail_if_recall_below, query_filters, use_reorder_data, io_backend,
+                                                 pipelined_search, search_batch_size, adaptive_max_beamwidth,
+                                                 early_stop_hops, dynamic_cache_mb, sector_cache, score_colocated,
+                                                 numa_replicas, filter_scan_max_points, filter_post_min_fraction,
+                                                 stats_file, io_profile, slow_read_us, speculative_reads,
+                                                 max_wasted_speculative_reads, use_rabitq, cache_file, access_trace,
+                                                 aio_busy_poll_us, delete_list);
             else if (data_type == std::string("uint8"))
                 return search_disk_index<uint8_t>(metric, index_path_prefix, result_path_prefix, query_file, gt_file,
                                                   num_threads, K, W, num_nodes_to_cache, search_io_limit, Lvec,
-                                                  fail_if_recall_below, query_filters, use_reorder_data);
+                                                  fail_if_recall_below, query_filters, use_reorder_data, io_backend,
+                                                  pipelined_search, search_batch_size, adaptive_max_beamwidth,
+                                                  early_stop_hops, dynamic_cache_mb, sector_cache, score_colocated,
+                                                  numa_replicas, filter_scan_max_points, filter_post_min_fraction,
+                                                  stats_file, io_profile, slow_read_us, speculative_reads,
+                                                  max_wasted_speculative_reads, use_rabitq, cache_file, access_trace,
+                                                  aio_busy_poll_us, delete_list);
+            else if (data_type == std::string("fp16"))
+                return search_disk_index<diskann::float16>(
+                    metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
+            else if (data_type == std::string("bf16"))
+                return search_disk_index<diskann::bfloat16>(
+                    metric, index_path_prefix, result_path_prefix, query_file, gt_file, num_threads, K, W,
+                    num_nodes_to_cache, search_io_limit, Lvec, fail_if_recall_below, query_filters, use_reorder_data,
+                    io_backend, pipelined_search, search_batch_size, adaptive_max_beamwidth, early_stop_hops,
+                    dynamic_cache_mb, sector_cache, score_colocated, numa_replicas, filter_scan_max_points,
+                    filter_post_min_fraction, stats_file, io_profile, slow_read_us, speculative_reads,
+                    max_wasted_speculative_reads, use_rabitq, cache_file, access_trace, aio_busy_poll_us,
+                    delete_list);
             else
             {
-                std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
+                std::cerr << "Unsupported data type. Use float, int8, uint8, fp16 or bf16" << std::endl;
                 return -1;
             }
         }
@@ -19,6 +19,7 @@
 
 #include "index.h"
 #include "memory_mapper.h"
+#include "memory_policy.h"
 #include "utils.h"
 #include "program_options_utils.hpp"
 #include "index_factory.h"
@@ -30,7 +31,13 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
                         const std::string &query_file, const std::string &truthset_file, const uint32_t num_threads,
                         const uint32_t recall_at, const bool print_all_recalls, const std::vector<uint32_t> &Lvec,
                         const bool dynamic, const bool tags, const bool show_qps_per_thread,
-                        const std::vector<std::string> &query_filters, const float fail_if_recall_below)
+                        const std::vector<std::string> &query_filters, const float fail_if_recall_below,
+                        const bool mmap_load, const bool compressed_graph, const float entry_layer_sample_rate,
+                        const uint32_t sq_bits,
+                        const uint32_t pca_dims, const bool quantized_rerank, const uint32_t quantized_rerank_factor,
+                        const uint32_t interleave, const bool gpu_search, const std::string &optimized_layout,
+                        const std::string &budget_model, const float budget_target_recall,
+                        const std::string &stats_file)
 {
     using TagT = uint32_t;
     // Load the query file
@@ -68,14 +75,24 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
         }
     }
 
-    const size_t num_frozen_pts = diskann::get_graph_num_frozen_points(index_path);
+    // the optimized layout records the frozen points, and the graph it
+    // replaces need not be there
+    const bool load_layout = optimized_layout == "load";
+    const size_t num_frozen_pts = load_layout ? 0 : diskann::get_graph_num_frozen_points(index_path);
+
+    diskann::GraphStoreStrategy graph_strategy = diskann::GraphStoreStrategy::MEMORY;
+    if (mmap_load)
+        graph_strategy = diskann::GraphStoreStrategy::MMAP;
+    else if (compressed_graph)
+        graph_strategy = diskann::GraphStoreStrategy::COMPRESSED;
 
     auto config = diskann::IndexConfigBuilder()
                       .with_metric(metric)
                       .with_dimension(query_dim)
                       .with_max_points(0)
-                      .with_data_load_store_strategy(diskann::DataStoreStrategy::MEMORY)
-                      .with_graph_load_store_strategy(diskann::GraphStoreStrategy::MEMORY)
+                      .with_data_load_store_strategy(mmap_load ? diskann::DataStoreStrategy::MMAP
+                                                               : diskann::DataStoreStrategy::MEMORY)
+                      .with_graph_load_store_strategy(graph_strategy)
                       .with_data_type(diskann_type_to_name<T>())
                       .with_label_type(diskann_type_to_name<LabelT>())
                       .with_tag_type(diskann_type_to_name<TagT>())
@@ -85,16 +102,63 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
                       .is_pq_dist_build(false)
                       .is_use_opq(false)
                       .with_num_pq_chunks(0)
+                      .with_num_sq_bits(sq_bits)
+                      .with_num_pca_dims(pca_dims)
+                      .is_quantized_rerank(quantized_rerank)
+                      .with_quantized_rerank_factor(quantized_rerank_factor)
                       .with_num_frozen_pts(num_frozen_pts)
                       .build();
 
     auto index_factory = diskann::IndexFactory(config);
-    auto index = index_factory.create_instance();
-    index->load(index_path.c_str(), num_threads, *(std::max_element(Lvec.begin(), Lvec.end())));
+    // the typed index searches without the type dispatch of AbstractIndex
+    auto index = index_factory.create_typed_instance<T, TagT, LabelT>();
+    const uint32_t max_L = *(std::max_element(Lvec.begin(), Lvec.end()));
+    if (load_layout)
+        index->load_optimized_layout(index_path.c_str(), num_threads, max_L);
+    else
+        index->load(index_path.c_str(), num_threads, max_L);
     std::cout << "Index loaded" << std::endl;
 
-    if (metric == diskann::FAST_L2)
+    if (metric == diskann::FAST_L2 && !load_layout)
+    {
         index->optimize_index_layout();
+        if (optimized_layout == "save")
+            index->save_optimized_layout(index_path.c_str());
+    }
+    if (entry_layer_sample_rate > 0)
+        index->build_entry_layer(entry_layer_sample_rate);
+
+    // plain searches can be run on a copy of the index on the GPU
+    const bool plain_search = !filtered_search && !tags && metric != diskann::FAST_L2;
+    bool on_gpu = false;
+    if (gpu_search && plain_search)
+    {
+        on_gpu = index->load_to_gpu();
+        std::cout << (on_gpu ? "Searching on the GPU" : "No GPU search in this build or for this metric") << std::endl;
+    }
+
+    // searches at the L and K of the model take the hops it predicts they need
+    if (!budget_model.empty())
+    {
+        diskann::SearchBudgetModel model;
+        if (budget_target_recall > 0)
+        {
+            if (!calc_recall_flag)
+            {
+                std::cerr << "Training a search budget model needs the ground truth" << std::endl;
+                return -1;
+            }
+            model = index->train_search_budget_model(query, query_num, query_aligned_dim, gt_ids, gt_dim, recall_at,
+                                                     Lvec[0], budget_target_recall);
+            model.save(budget_model);
+        }
+        else
+        {
+            model = diskann::SearchBudgetModel::load(budget_model);
+        }
+        index->set_search_budget_model(&model);
+        std::cout << "Search budget for L=" << model.L << " and K=" << model.K << std::endl;
+    }
 
     std::cout << "Using " << num_threads << " threads to search" << std::endl;
     std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
@@ -142,6 +206,16 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
         query_result_tags.resize(recall_at * query_num);
     }
 
+    std::ofstream stats_out;
+    if (!stats_file.empty())
+    {
+        const bool new_file = !file_exists(stats_file);
+        stats_out.open(stats_file, std::ios::app);
+        if (new_file)
+            stats_out << "L,beamwidth,threads,qps,mean_latency_us,p50_latency_us,p99_latency_us,p999_latency_us,"
+                         "mean_ios,mean_cmps,recall\n";
+    }
+
     double best_recall = 0.0;
 
     for (uint32_t test_id = 0; test_id < Lvec.size(); test_id++)
@@ -157,19 +231,44 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
         query_result_dists[test_id].resize(recall_at * query_num);
         std::vector<T *> res = std::vector<T *>();
 
+        // plain searches can be run interleaved, several queries per thread,
+        // or on the GPU
+        const bool batch = (interleave > 1 || on_gpu) && plain_search;
+
         auto s = std::chrono::high_resolution_clock::now();
         omp_set_num_threads(num_threads);
+        if (batch)
+        {
+            if (on_gpu)
+                index->batch_search_on_gpu(query, query_num, query_aligned_dim, recall_at, L,
+                                           query_result_ids[test_id].data(), query_result_dists[test_id].data());
+            else
+                index->batch_search(query, query_num, query_aligned_dim, recall_at, L,
+                                    query_result_ids[test_id].data(), query_result_dists[test_id].data(), num_threads,
+                                    interleave);
+            // queries finish together, so only their mean latency is known
+            std::chrono::duration<double> batch_diff = std::chrono::high_resolution_clock::now() - s;
+            std::fill(latency_stats.begin(), latency_stats.end(),
+                      (float)(batch_diff.count() * 1000000 * num_threads / (std::max)(query_num, (size_t)1)));
+            std::fill(cmp_stats.begin(), cmp_stats.end(), 0);
+        }
 #pragma omp parallel for schedule(dynamic, 1)
-        for (int64_t i = 0; i < (int64_t)query_num; i++)
+        for (int64_t i = 0; i < (batch ? 0 : (int64_t)query_num); i++)
         {
             auto qs = std::chrono::high_resolution_clock::now();
             if (filtered_search && !tags)
             {
                 std::string raw_filter = query_filters.size() == 1 ? query_filters[0] : query_filters[i];
 
-                auto retval = index->search_with_filters(query + i * query_aligned_dim, raw_filter, recall_at, L,
-                                                         query_result_ids[test_id].data() + i * recall_at,
-                                                         query_result_dists[test_id].data() + i * recall_at);
+                uint32_t *ids = query_result_ids[test_id].data() + i * recall_at;
+                float *dists = query_result_dists[test_id].data() + i * recall_at;
+                auto retval = diskann::is_label_filter_expression(raw_filter)
+                                  ? index->search_with_filters(query + i * query_aligned_dim,
+                                                               index->get_converted_filter(raw_filter), recall_at, L,
+                                                               ids, dists)
+                                  : index->search_with_filters(query + i * query_aligned_dim,
+                                                               index->get_converted_label(raw_filter), recall_at, L,
+                                                               ids, dists);
                 cmp_stats[i] = retval.second;
             }
             else if (metric == diskann::FAST_L2)
@@ -249,6 +348,21 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
             best_recall = std::max(recall, best_recall);
         }
         std::cout << std::endl;
+
+        if (stats_out.is_open())
+        {
+            stats_out << L << ",," << num_threads << "," << query_num / diff.count() << "," << mean_latency << ","
+                      << latency_stats[(uint64_t)(0.5 * query_num)] << ","
+                      << latency_stats[(uint64_t)(0.99 * query_num)] << ","
+                      << latency_stats[(uint64_t)(0.999 * query_num)] << ",,";
+            if (tags && !filtered_search)
+                stats_out << ",";
+            else
+                stats_out << avg_cmps << ",";
+            if (!recalls.empty())
+                stats_out << recalls.back();
+            stats_out << std::endl;
+        }
     }
 
     std::cout << "Done searching. Now saving results " << std::endl;
@@ -278,11 +392,14 @@ int search_memory_index(diskann::Metric &metric, const std::string &index_path,
 int main(int argc, char **argv)
 {
     std::string data_type, dist_fn, index_path_prefix, result_path, query_file, gt_file, filter_label, label_type,
-        query_filters_file;
-    uint32_t num_threads, K;
+        query_filters_file, huge_pages, numa_placement, optimized_layout, stats_file, budget_model;
+    uint32_t num_threads, K, sq_bits, pca_dims, quantized_rerank_factor, interleave;
     std::vector<uint32_t> Lvec;
-    bool print_all_recalls, dynamic, tags, show_qps_per_thread;
+    bool print_all_recalls, dynamic, tags, show_qps_per_thread, mmap_load, compressed_graph, quantized_rerank,
+        gpu_search;
     float fail_if_recall_below = 0.0f;
+    float entry_layer_sample_rate = 0.0f;
+    float budget_target_recall = 0.0f;
 
     po::options_description desc{
         program_options_utils::make_program_description("search_memory_index", "Searches in-memory DiskANN indexes")};
@@ -331,6 +448,53 @@ int main(int argc, char **argv)
         optional_configs.add_options()("fail_if_recall_below",
                                        po::value<float>(&fail_if_recall_below)->default_value(0.0f),
                                        program_options_utils::FAIL_IF_RECALL_BELOW);
+        optional_configs.add_options()("mmap_load", po::bool_switch(&mmap_load),
+                                       "Map the files written by apps/utils/create_mmap_index instead of reading "
+                                       "the index into memory. Only for static indices.");
+        optional_configs.add_options()("compressed_graph", po::bool_switch(&compressed_graph),
+                                       "Keep the graph in memory with delta-coded adjacency lists, decoded as the "
+                                       "search reads them. Only for static indices.");
+        optional_configs.add_options()("entry_layer_sample_rate",
+                                       po::value<float>(&entry_layer_sample_rate)->default_value(0.0f),
+                                       "Build a Vamana graph over this fraction of the points (e.g. 0.001) after "
+                                       "loading and use it to pick per-query start points. Only for static indices.");
+        optional_configs.add_options()("sq_bits", po::value<uint32_t>(&sq_bits)->default_value(0),
+                                       "Search on vectors scalar quantized to 8 or 4 bits per dimension, as built "
+                                       "with build_SQ_bits. 0 (default) searches full precision vectors.");
+        optional_configs.add_options()("pca_dims", po::value<uint32_t>(&pca_dims)->default_value(0),
+                                       "Search on the projections of the vectors on this many principal "
+                                       "components, as built with build_PCA_dims. 0 (default) searches full "
+                                       "precision vectors.");
+        optional_configs.add_options()("quantized_rerank", po::bool_switch(&quantized_rerank),
+                                       "Re-rank the final candidates of a quantized search with full precision "
+                                       "distances.");
+        optional_configs.add_options()("quantized_rerank_factor",
+                                       po::value<uint32_t>(&quantized_rerank_factor)
+                                           ->default_value(diskann::defaults::QUANTIZED_RERANK_FACTOR),
+                                       "With quantized_rerank, the number of candidates re-ranked as a multiple of K.");
+        optional_configs.add_options()("interleave", po::value<uint32_t>(&interleave)->default_value(1),
+                                       "Search this many queries at a time on each thread, switching between them "
+                                       "while their neighbours are fetched from memory. 4 to 8 helps on indices much "
+                                       "larger than the caches. Only for searches without filters or tags.");
+        optional_configs.add_options()("gpu", po::bool_switch(&gpu_search),
+                                       "In builds with CUDA, copy the index to the GPU and search all the queries "
+                                       "there, thousands at a time. L2 and mips only, without filters or tags.");
+        optional_configs.add_options()("budget_model", po::value<std::string>(&budget_model)->default_value(""),
+                                       "Stop searches without filters at the L and K of this search budget model "
+                                       "once they have taken the hops it predicts they need.");
+        optional_configs.add_options()("budget_target_recall",
+                                       po::value<float>(&budget_target_recall)->default_value(0),
+                                       "Train the budget_model on the queries and ground truth for the first L and "
+                                       "K, to this mean recall (0 to 1), save it and search with it.");
+        optional_configs.add_options()("optimized_layout",
+                                       po::value<std::string>(&optimized_layout)->default_value("none"),
+                                       "With fast_l2: 'save' writes the optimized layout to index_path_prefix.opt "
+                                       "after building it, and 'load' searches on that file alone, without reading "
+                                       "the data and graph files. With mmap_load, the file is mapped.");
+        optional_configs.add_options()("huge_pages", po::value<std::string>(&huge_pages)->default_value("auto"),
+                                       program_options_utils::HUGE_PAGES);
+        optional_configs.add_options()("numa", po::value<std::string>(&numa_placement)->default_value("first_touch"),
+                                       program_options_utils::NUMA_PLACEMENT);
 
         // Output controls
         po::options_description output_controls("Output controls");
@@ -340,6 +504,8 @@ int main(int argc, char **argv)
         output_controls.add_options()("print_qps_per_thread", po::bool_switch(&show_qps_per_thread),
                                       "Print overall QPS divided by the number of threads in "
                                       "the output table");
+        output_controls.add_options()("stats_file", po::value<std::string>(&stats_file)->default_value(""),
+                                      program_options_utils::STATS_FILE);
 
         // Merge required and optional parameters
         desc.add(required_configs).add(optional_configs).add(output_controls);
@@ -352,6 +518,10 @@ int main(int argc, char **argv)
             return 0;
         }
         po::notify(vm);
+        diskann::MemoryPolicy memory_policy;
+        memory_policy.huge_pages = diskann::parse_huge_page_mode(huge_pages);
+        memory_policy.numa = diskann::parse_numa_placement(numa_placement);
+        diskann::set_memory_policy(memory_policy);
     }
     catch (const std::exception &ex)
     {
@@ -376,11 +546,15 @@ int main(int argc, char **argv)
     {
         metric = diskann::Metric::FAST_L2;
     }
+    else if ((dist_fn == std::string("hamming")) && (data_type == std::string("uint8")))
+    {
+        metric = diskann::Metric::HAMMING;
+    }
     else
     {
         std::cout << "Unsupported distance function. Currently only l2/ cosine are "
-                     "supported in general, and mips/fast_l2 only for floating "
-                     "point data."
+                     "supported in general, mips/fast_l2 only for floating "
+                     "point data and hamming only for uint8 data."
                   << std::endl;
         return -1;
     }
@@ -391,6 +565,36 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (dynamic && mmap_load)
+    {
+        std::cerr << "Memory-mapped loading is only supported for static indices" << std::endl;
+        return -1;
+    }
+
+    if (compressed_graph && (dynamic || mmap_load))
+    {
+        std::cerr << "The compressed graph is only supported for static indices loaded into memory" << std::endl;
+        return -1;
+    }
+
+    if (optimized_layout != "none" && optimized_layout != "save" && optimized_layout != "load")
+    {
+        std::cerr << "optimized_layout must be none, save or load" << std::endl;
+        return -1;
+    }
+
+    if (optimized_layout != "none" && (dynamic || metric != diskann::Metric::FAST_L2))
+    {
+        std::cerr << "The optimized layout is only used for static indices with fast_l2" << std::endl;
+        return -1;
+    }
+
+    if (dynamic && entry_layer_sample_rate > 0)
+    {
+        std::cerr << "Entry layer is only supported for static indices" << std::endl;
+        return -1;
+    }
+
     if (fail_if_recall_below < 0.0 || fail_if_recall_below >= 100.0)
     {
         std::cerr << "fail_if_recall_below parameter must be between 0 and 100%" << std::endl;
@@ -421,19 +625,28 @@ int main(int argc, char **argv)
             {
                 return search_memory_index<int8_t, uint16_t>(
                     metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
-                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below);
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, mmap_load,
+                    compressed_graph, entry_layer_sample_rate, sq_bits, pca_dims, quantized_rerank,
+                    quantized_rerank_factor, interleave, gpu_search, optimized_layout, budget_model,
+                    budget_target_recall, stats_file);
             }
             else if (data_type == std::string("uint8"))
             {
                 return search_memory_index<uint8_t, uint16_t>(
                     metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
-                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below);
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, mmap_load,
+                    compressed_graph, entry_layer_sample_rate, sq_bits, pca_dims, quantized_rerank,
+                    quantized_rerank_factor, interleave, gpu_search, optimized_layout, budget_model,
+                    budget_target_recall, stats_file);
             }
             else if (data_type == std::string("float"))
             {
-                return search_memory_index<float, uint16_t>(metric, index_path_prefix, result_path, query_file, gt_file,
-                                                            num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                            show_qps_per_thread, query_filters, fail_if_recall_below);
+                return search_memory_index<float, uint16_t>(
+                    metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, mmap_load,
+                    compressed_graph, entry_layer_sample_rate, sq_bits, pca_dims, quantized_rerank,
+                    quantized_rerank_factor, interleave, gpu_search, optimized_layout, budget_model,
+                    budget_target_recall, stats_file);
             }
             else
             {
@@ -445,21 +658,30 @@ int main(int argc, char **argv)
         {
             if (data_type == std::string("int8"))
             {
-                return search_memory_index<int8_t>(metric, index_path_prefix, result_path, query_file, gt_file,
-                                                   num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                   show_qps_per_thread, query_filters, fail_if_recall_below);
+                return search_memory_index<int8_t>(
+                    metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, mmap_load,
+                    compressed_graph, entry_layer_sample_rate, sq_bits, pca_dims, quantized_rerank,
+                    quantized_rerank_factor, interleave, gpu_search, optimized_layout, budget_model,
+                    budget_target_recall, stats_file);
             }
             else if (data_type == std::string("uint8"))
             {
-                return search_memory_index<uint8_t>(metric, index_path_prefix, result_path, query_file, gt_file,
-                                                    num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                    show_qps_per_thread, query_filters, fail_if_recall_below);
+                return search_memory_index<uint8_t>(
+                    metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, mmap_load,
+                    compressed_graph, entry_layer_sample_rate, sq_bits, pca_dims, quantized_rerank,
+                    quantized_rerank_factor, interleave, gpu_search, optimized_layout, budget_model,
+                    budget_target_recall, stats_file);
             }
             else if (data_type == std::string("float"))
             {
-                return search_memory_index<float>(metric, index_path_prefix, result_path, query_file, gt_file,
-                                                  num_threads, K, print_all_recalls, Lvec, dynamic, tags,
-                                                  show_qps_per_thread, query_filters, fail_if_recall_below);
+                return search_memory_index<float>(
+                    metric, index_path_prefix, result_path, query_file, gt_file, num_threads, K, print_all_recalls,
+                    Lvec, dynamic, tags, show_qps_per_thread, query_filters, fail_if_recall_below, mmap_load,
+                    compressed_graph, entry_layer_sample_rate, sq_bits, pca_dims, quantized_rerank,
+                    quantized_rerank_factor, interleave, gpu_search, optimized_layout, budget_model,
+                    budget_target_recall, stats_file);
             }
             else
             {
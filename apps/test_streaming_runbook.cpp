@@ -0,0 +1,717 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <omp.h>
+#include <boost/program_options.hpp>
+
+#include "abstract_index.h"
+#include "index_factory.h"
+#include "timer.h"
+#include "utils.h"
+#include "program_options_utils.hpp"
+
+namespace po = boost::program_options;
+
+// Runs a runbook of timed phases against a dynamic index, in the manner of the
+// BigANN streaming track. Each line of the runbook is a phase, whose
+// operations run concurrently:
+//
+//   insert <start> <end>   inserts points [start, end) of the data file
+//   delete <start> <end>   lazily deletes points [start, end)
+//   consolidate            consolidates the deletes made in earlier phases
+//   search                 searches all the queries, alone in its phase, and
+//                          measures their recall against the active points
+//
+// While a phase updates the index, search threads run the queries in a loop,
+// so that each phase reports the throughput of its updates and the latency
+// of the searches they slow down. Blank lines and lines starting with # are
+// skipped.
+namespace
+{
+enum class OpKind
+{
+    INSERT,
+    DELETE,
+    CONSOLIDATE,
+    SEARCH
+};
+
+struct Operation
+{
+    OpKind kind;
+    size_t start = 0;
+    size_t end = 0;
+};
+
+struct Phase
+{
+    size_t line;
+    std::vector<Operation> ops;
+};
+
+struct PhaseStats
+{
+    double seconds = 0;
+    size_t inserted = 0;
+    double insert_seconds = 0;
+    size_t deleted = 0;
+    double delete_seconds = 0;
+    size_t released = 0;
+    double consolidate_seconds = 0;
+    // of the searches that ran in the phase, in microseconds
+    std::vector<float> latencies;
+    double recall = -1;
+};
+
+void runbook_error(size_t line, const std::string &message)
+{
+    throw diskann::ANNException("Runbook line " + std::to_string(line) + ": " + message, -1, __FUNCSIG__, __FILE__,
+                                __LINE__);
+}
+
+// Parses the runbook and checks it against the num_points points of the data
+// file: points are inserted once, and deleted once while active. Returns the
+// most slots the index holds at once, deleted points keeping theirs until a
+// consolidation in a later phase.
+std::vector<Phase> parse_runbook(const std::string &runbook_path, size_t num_points, size_t &max_slots)
+{
+    std::ifstream runbook(runbook_path);
+    if (!runbook.is_open())
+        throw diskann::ANNException("Cannot open runbook " + runbook_path, -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    // 0: not inserted yet, 1: active, 2: deleted
+    std::vector<uint8_t> state(num_points, 0);
+    size_t slots = 0, pending_deletes = 0;
+    max_slots = 0;
+
+    std::vector<Phase> phases;
+    std::string text;
+    for (size_t line = 1; std::getline(runbook, text); line++)
+    {
+        std::istringstream tokens(text);
+        std::string word;
+        Phase phase;
+        phase.line = line;
+        while (tokens >> word)
+        {
+            if (word[0] == '#')
+                break;
+            Operation op;
+            if (word == "insert" || word == "delete")
+            {
+                op.kind = word == "insert" ? OpKind::INSERT : OpKind::DELETE;
+                if (!(tokens >> op.start >> op.end) || op.start >= op.end || op.end > num_points)
+                    runbook_error(line, word + " needs a range of points of the data file");
+            }
+            else if (word == "consolidate")
+                op.kind = OpKind::CONSOLIDATE;
+            else if (word == "search")
+                op.kind = OpKind::SEARCH;
+            else
+                runbook_error(line, "unknown operation " + word);
+            phase.ops.push_back(op);
+        }
+        if (phase.ops.empty())
+            continue;
+
+        bool searches = false, consolidates = false;
+        size_t inserted = 0, deleted = 0;
+        for (const auto &op : phase.ops)
+        {
+            searches = searches || op.kind == OpKind::SEARCH;
+            consolidates = consolidates || op.kind == OpKind::CONSOLIDATE;
+            if (op.kind != OpKind::DELETE)
+                continue;
+            for (size_t i = op.start; i < op.end; i++)
+            {
+                if (state[i] != 1)
+                    runbook_error(line, "deletes point " + std::to_string(i) + ", which is not active");
+                state[i] = 2;
+            }
+            deleted += op.end - op.start;
+        }
+        if (searches && phase.ops.size() > 1)
+            runbook_error(line, "search runs in a phase of its own");
+        for (const auto &op : phase.ops)
+        {
+            if (op.kind != OpKind::INSERT)
+                continue;
+            for (size_t i = op.start; i < op.end; i++)
+            {
+                if (state[i] != 0)
+                    runbook_error(line, "inserts point " + std::to_string(i) + " again");
+                state[i] = 1;
+            }
+            inserted += op.end - op.start;
+        }
+
+        // a consolidation may release the slots of the deletes of its phase
+        // or not, and inserts may take slots before it releases any
+        slots += inserted;
+        max_slots = (std::max)(max_slots, slots);
+        if (consolidates)
+        {
+            slots -= pending_deletes;
+            pending_deletes = 0;
+        }
+        pending_deletes += deleted;
+        phases.push_back(phase);
+    }
+    return phases;
+}
+
+// Reads points [start, start + count) of the data file into data, count rows
+// of aligned_dim with the padding zeroed
+template <typename T>
+void read_points(std::ifstream &reader, size_t start, size_t count, size_t dim, size_t aligned_dim, T *data)
+{
+    reader.seekg(2 * sizeof(uint32_t) + start * dim * sizeof(T), std::ios::beg);
+    for (size_t i = 0; i < count; i++)
+    {
+        reader.read((char *)(data + i * aligned_dim), dim * sizeof(T));
+        std::fill(data + i * aligned_dim + dim, data + (i + 1) * aligned_dim, (T)0);
+    }
+}
+
+// Exact nearest neighbours of the queries among the active points, streamed
+// from the data file; ids are point indices, nearest first
+template <typename T>
+void compute_step_groundtruth(const std::string &data_path, size_t dim, const std::vector<uint8_t> &active,
+                              const std::vector<float> &queries, size_t num_queries, uint32_t K, diskann::Metric metric,
+                              std::vector<uint32_t> &gt_ids, std::vector<float> &gt_dists)
+{
+    const size_t block_size = 65536;
+    std::ifstream reader(data_path, std::ios::binary);
+    std::vector<T> block(block_size * dim);
+    std::vector<std::priority_queue<std::pair<float, uint32_t>>> best(num_queries);
+
+    for (size_t start = 0; start < active.size(); start += block_size)
+    {
+        const size_t count = (std::min)(block_size, active.size() - start);
+        read_points(reader, start, count, dim, dim, block.data());
+#pragma omp parallel for schedule(dynamic, 16)
+        for (int64_t q = 0; q < (int64_t)num_queries; q++)
+        {
+            const float *query = queries.data() + q * dim;
+            auto &heap = best[q];
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!active[start + i])
+                    continue;
+                const T *point = block.data() + i * dim;
+                float dist = 0;
+                if (metric == diskann::Metric::INNER_PRODUCT)
+                {
+                    for (size_t d = 0; d < dim; d++)
+                        dist -= query[d] * (float)point[d];
+                }
+                else
+                {
+                    for (size_t d = 0; d < dim; d++)
+                        dist += (query[d] - (float)point[d]) * (query[d] - (float)point[d]);
+                }
+                if (heap.size() < K)
+                    heap.emplace(dist, (uint32_t)(start + i));
+                else if (dist < heap.top().first)
+                {
+                    heap.pop();
+                    heap.emplace(dist, (uint32_t)(start + i));
+                }
+            }
+        }
+    }
+
+    gt_ids.assign(num_queries * K, std::numeric_limits<uint32_t>::max());
+    gt_dists.assign(num_queries * K, std::numeric_limits<float>::max());
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        for (size_t pos = best[q].size(); pos > 0; pos--)
+        {
+            gt_ids[q * K + pos - 1] = best[q].top().second;
+            gt_dists[q * K + pos - 1] = best[q].top().first;
+            best[q].pop();
+        }
+    }
+}
+
+// Searches query, writing the point indices of its K results, UINT32_MAX past
+// those found, and returns the latency in microseconds
+template <typename T>
+float search_query(diskann::AbstractIndex &index, const T *query, uint32_t K, uint32_t L, uint32_t *tags,
+                   uint32_t *results)
+{
+    std::vector<T *> no_vectors;
+    diskann::Timer timer;
+    const size_t found = index.search_with_tags(query, K, L, tags, (float *)nullptr, no_vectors);
+    const float latency = timer.elapsed_us_fractional();
+    for (size_t i = 0; i < K; i++)
+        results[i] = i < found ? tags[i] - 1 : std::numeric_limits<uint32_t>::max();
+    return latency;
+}
+
+float percentile(std::vector<float> &values, double p)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[(std::min)(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+template <typename T>
+void insert_range(diskann::AbstractIndex &index, const std::string &data_path, size_t start, size_t end, size_t dim,
+                  uint32_t insert_threads, PhaseStats &stats)
+{
+    const size_t block_size = 65536;
+    const size_t aligned_dim = ROUND_UP(dim, 8);
+    std::ifstream reader(data_path, std::ios::binary);
+    T *data = nullptr;
+    diskann::alloc_aligned((void **)&data, (std::min)(block_size, end - start) * aligned_dim * sizeof(T),
+                           8 * sizeof(T));
+    size_t num_failed = 0;
+    for (size_t block_start = start; block_start < end; block_start += block_size)
+    {
+        const size_t count = (std::min)(block_size, end - block_start);
+        read_points(reader, block_start, count, dim, aligned_dim, data);
+        diskann::Timer timer;
+#pragma omp parallel for num_threads((int32_t)insert_threads) schedule(dynamic) reduction(+ : num_failed)
+        for (int64_t i = 0; i < (int64_t)count; i++)
+        {
+            if (index.insert_point(data + i * aligned_dim, (uint32_t)(1 + block_start + i)) != 0)
+                num_failed++;
+        }
+        stats.insert_seconds += timer.elapsed_seconds();
+    }
+    diskann::aligned_free(data);
+    stats.inserted += end - start - num_failed;
+    if (num_failed > 0)
+        std::cerr << num_failed << " of " << end - start << " inserts failed" << std::endl;
+}
+
+void delete_range(diskann::AbstractIndex &index, size_t start, size_t end, PhaseStats &stats)
+{
+    std::vector<uint32_t> tags(end - start), failed_tags;
+    std::iota(tags.begin(), tags.end(), (uint32_t)(1 + start));
+    diskann::Timer timer;
+    index.lazy_delete(tags, failed_tags);
+    stats.delete_seconds += timer.elapsed_seconds();
+    stats.deleted += tags.size() - failed_tags.size();
+    if (!failed_tags.empty())
+        std::cerr << failed_tags.size() << " of " << tags.size() << " deletes failed" << std::endl;
+}
+
+void consolidate(diskann::AbstractIndex &index, const diskann::IndexWriteParameters &delete_params,
+                 size_t consolidate_slice_size, PhaseStats &stats)
+{
+    diskann::Timer timer;
+    while (true)
+    {
+        auto report = consolidate_slice_size == 0
+                          ? index.consolidate_deletes(delete_params)
+                          : index.consolidate_deletes_slice(delete_params, consolidate_slice_size);
+        stats.released += report._slots_released;
+        if (report._status == diskann::consolidation_report::status_code::SUCCESS)
+            break;
+        if (report._status == diskann::consolidation_report::status_code::LOCK_FAIL)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        else if (report._status != diskann::consolidation_report::status_code::IN_PROGRESS)
+            throw diskann::ANNException("Consolidating deletes failed", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    stats.consolidate_seconds += timer.elapsed_seconds();
+}
+
+std::string describe(const Phase &phase)
+{
+    std::string text;
+    for (const auto &op : phase.ops)
+    {
+        if (!text.empty())
+            text += ", ";
+        switch (op.kind)
+        {
+        case OpKind::INSERT:
+            text += "insert " + std::to_string(op.start) + "-" + std::to_string(op.end);
+            break;
+        case OpKind::DELETE:
+            text += "delete " + std::to_string(op.start) + "-" + std::to_string(op.end);
+            break;
+        case OpKind::CONSOLIDATE:
+            text += "consolidate";
+            break;
+        case OpKind::SEARCH:
+            text += "search";
+            break;
+        }
+    }
+    return text;
+}
+} // namespace
+
+template <typename T>
+int run_runbook(diskann::Metric metric, const std::string &data_path, const std::string &query_file,
+                const std::string &runbook_path, const std::string &gt_prefix, const uint32_t K, const uint32_t Ls,
+                const uint32_t R, const uint32_t L, const float alpha, const uint32_t insert_threads,
+                const uint32_t consolidate_threads, const uint32_t search_threads, size_t max_points,
+                const float start_point_norm, const uint32_t num_start_pts, const size_t consolidate_slice_size)
+{
+    size_t num_points, dim;
+    diskann::get_bin_metadata(data_path, num_points, dim);
+    size_t max_slots;
+    std::vector<Phase> phases = parse_runbook(runbook_path, num_points, max_slots);
+    if (max_points == 0)
+        max_points = max_slots;
+    if (max_points < max_slots)
+    {
+        std::cerr << "The runbook holds up to " << max_slots << " points at once, more than max_points " << max_points
+                  << std::endl;
+        return -1;
+    }
+    diskann::cout << "Runbook of " << phases.size() << " phases over " << num_points << " points of " << dim
+                  << " dimensions, up to " << max_slots << " in the index at once" << std::endl;
+
+    T *queries = nullptr;
+    size_t num_queries, query_dim, query_aligned_dim;
+    diskann::load_aligned_bin<T>(query_file, queries, num_queries, query_dim, query_aligned_dim);
+    if (query_dim != dim)
+    {
+        std::cerr << "The queries have " << query_dim << " dimensions, the data " << dim << std::endl;
+        diskann::aligned_free(queries);
+        return -1;
+    }
+    std::vector<float> float_queries(num_queries * dim);
+    for (size_t q = 0; q < num_queries; q++)
+        for (size_t d = 0; d < dim; d++)
+            float_queries[q * dim + d] = (float)queries[q * query_aligned_dim + d];
+
+    auto write_params = diskann::IndexWriteParametersBuilder(L, R)
+                            .with_alpha(alpha)
+                            .with_num_threads(insert_threads)
+                            .build();
+    auto delete_params = diskann::IndexWriteParametersBuilder(L, R)
+                             .with_alpha(alpha)
+                             .with_num_threads(consolidate_threads)
+                             .build();
+    // a query scratch for every thread that may search or insert at once
+    size_t max_inserts = 0;
+    for (const auto &phase : phases)
+        max_inserts = (std::max)(max_inserts, (size_t)std::count_if(phase.ops.begin(), phase.ops.end(),
+                                                                    [](const Operation &op) {
+                                                                        return op.kind == OpKind::INSERT;
+                                                                    }));
+    auto search_params = diskann::IndexSearchParams(
+        Ls, (uint32_t)(max_inserts * insert_threads + consolidate_threads + search_threads));
+    auto index_config = diskann::IndexConfigBuilder()
+                            .with_metric(metric)
+                            .with_dimension(dim)
+                            .with_max_points(max_points)
+                            .is_dynamic_index(true)
+                            .is_enable_tags(true)
+                            .is_concurrent_consolidate(true)
+                            .with_num_pq_chunks(0)
+                            .is_pq_dist_build(false)
+                            .with_num_frozen_pts(num_start_pts)
+                            .with_tag_type(diskann_type_to_name<uint32_t>())
+                            .with_label_type(diskann_type_to_name<uint32_t>())
+                            .with_data_type(diskann_type_to_name<T>())
+                            .with_index_write_params(write_params)
+                            .with_index_search_params(search_params)
+                            .with_data_load_store_strategy(diskann::DataStoreStrategy::MEMORY)
+                            .with_graph_load_store_strategy(diskann::GraphStoreStrategy::MEMORY)
+                            .build();
+    auto index = diskann::IndexFactory(index_config).create_instance();
+    index->set_start_points_at_random(static_cast<T>(start_point_norm));
+
+    std::vector<uint8_t> active(num_points, 0);
+    std::vector<PhaseStats> all_stats(phases.size());
+    std::vector<uint32_t> tags(search_threads * K);
+    double first_recall = -1;
+    for (size_t p = 0; p < phases.size(); p++)
+    {
+        const Phase &phase = phases[p];
+        PhaseStats &stats = all_stats[p];
+        diskann::Timer phase_timer;
+
+        if (phase.ops[0].kind == OpKind::SEARCH)
+        {
+            std::vector<uint32_t> results(num_queries * K);
+            stats.latencies.resize(num_queries);
+#pragma omp parallel for num_threads((int32_t)search_threads) schedule(dynamic, 1)
+            for (int64_t q = 0; q < (int64_t)num_queries; q++)
+            {
+                uint32_t *thread_tags = tags.data() + omp_get_thread_num() * K;
+                stats.latencies[q] = search_query(*index, queries + q * query_aligned_dim, K, Ls, thread_tags,
+                                                  results.data() + q * K);
+            }
+            stats.seconds = phase_timer.elapsed_seconds();
+
+            std::vector<uint32_t> gt_ids;
+            std::vector<float> gt_dists;
+            size_t gt_dim = K;
+            if (gt_prefix.empty())
+            {
+                compute_step_groundtruth<T>(data_path, dim, active, float_queries, num_queries, K, metric, gt_ids,
+                                            gt_dists);
+            }
+            else
+            {
+                uint32_t *file_ids = nullptr;
+                float *file_dists = nullptr;
+                size_t gt_num;
+                const std::string gt_file = gt_prefix + std::to_string(p + 1) + ".bin";
+                diskann::load_truthset(gt_file, file_ids, file_dists, gt_num, gt_dim);
+                if (gt_num != num_queries || gt_dim < K)
+                {
+                    throw diskann::ANNException("Ground truth " + gt_file + " does not have " + std::to_string(K) +
+                                                    " neighbours of each query",
+                                                -1, __FUNCSIG__, __FILE__, __LINE__);
+                }
+                gt_ids.assign(file_ids, file_ids + gt_num * gt_dim);
+                if (file_dists != nullptr)
+                    gt_dists.assign(file_dists, file_dists + gt_num * gt_dim);
+                delete[] file_ids;
+                delete[] file_dists;
+            }
+            stats.recall = diskann::calculate_recall((uint32_t)num_queries, gt_ids.data(),
+                                                     gt_dists.empty() ? nullptr : gt_dists.data(), (uint32_t)gt_dim,
+                                                     results.data(), K, K);
+            if (first_recall < 0)
+                first_recall = stats.recall;
+        }
+        else
+        {
+            // the updates of the phase, each on a thread of its own, with
+            // searches running until all are done
+            std::atomic<bool> updating(true);
+            std::vector<std::vector<float>> search_latencies(search_threads);
+            std::vector<std::thread> searchers;
+            for (uint32_t t = 0; t < search_threads; t++)
+            {
+                searchers.emplace_back([&, t]() {
+                    std::vector<uint32_t> results(K);
+                    for (size_t q = t % num_queries; updating.load(std::memory_order_relaxed); q = (q + search_threads) % num_queries)
+                    {
+                        search_latencies[t].push_back(search_query(*index, queries + q * query_aligned_dim, K, Ls,
+                                                                   tags.data() + t * K, results.data()));
+                    }
+                });
+            }
+
+            std::vector<PhaseStats> op_stats(phase.ops.size());
+            std::vector<std::future<void>> updates;
+            for (size_t o = 0; o < phase.ops.size(); o++)
+            {
+                const Operation op = phase.ops[o];
+                PhaseStats &op_stat = op_stats[o];
+                updates.emplace_back(std::async(std::launch::async, [&, op]() {
+                    if (op.kind == OpKind::INSERT)
+                        insert_range<T>(*index, data_path, op.start, op.end, dim, insert_threads, op_stat);
+                    else if (op.kind == OpKind::DELETE)
+                        delete_range(*index, op.start, op.end, op_stat);
+                    else
+                        consolidate(*index, delete_params, consolidate_slice_size, op_stat);
+                }));
+            }
+            std::exception_ptr failure;
+            for (auto &update : updates)
+            {
+                try
+                {
+                    update.get();
+                }
+                catch (...)
+                {
+                    failure = std::current_exception();
+                }
+            }
+            stats.seconds = phase_timer.elapsed_seconds();
+            updating = false;
+            for (auto &searcher : searchers)
+                searcher.join();
+            if (failure)
+                std::rethrow_exception(failure);
+
+            for (const auto &op_stat : op_stats)
+            {
+                stats.inserted += op_stat.inserted;
+                stats.insert_seconds += op_stat.insert_seconds;
+                stats.deleted += op_stat.deleted;
+                stats.delete_seconds += op_stat.delete_seconds;
+                stats.released += op_stat.released;
+                stats.consolidate_seconds += op_stat.consolidate_seconds;
+            }
+            for (auto &latencies : search_latencies)
+                stats.latencies.insert(stats.latencies.end(), latencies.begin(), latencies.end());
+            for (const auto &op : phase.ops)
+            {
+                if (op.kind == OpKind::INSERT || op.kind == OpKind::DELETE)
+                    std::fill(active.begin() + op.start, active.begin() + op.end, op.kind == OpKind::INSERT);
+            }
+        }
+
+        diskann::cout << "Phase " << p + 1 << " (line " << phase.line << "): " << describe(phase) << " in "
+                      << stats.seconds << "s";
+        if (stats.inserted > 0)
+            diskann::cout << ", " << stats.inserted / stats.insert_seconds << " inserts/s";
+        if (stats.deleted > 0)
+            diskann::cout << ", " << stats.deleted / stats.delete_seconds << " deletes/s";
+        if (stats.consolidate_seconds > 0)
+            diskann::cout << ", " << stats.released << " slots released in " << stats.consolidate_seconds << "s";
+        if (stats.recall >= 0)
+            diskann::cout << ", recall@" << K << " " << stats.recall << " (drift " << stats.recall - first_recall
+                          << ")";
+        diskann::cout << std::endl;
+    }
+    diskann::aligned_free(queries);
+
+    std::cout << std::endl
+              << std::setw(6) << "Phase" << std::setw(14) << "Inserts/s" << std::setw(14) << "Deletes/s"
+              << std::setw(16) << "Consolidate(s)" << std::setw(12) << "Searches" << std::setw(12) << "QPS"
+              << std::setw(14) << "p50(us)" << std::setw(14) << "p99(us)" << std::setw(12) << "Recall" << std::endl;
+    for (size_t p = 0; p < all_stats.size(); p++)
+    {
+        PhaseStats &stats = all_stats[p];
+        const size_t searches = stats.latencies.size();
+        std::cout << std::setw(6) << p + 1 << std::setw(14)
+                  << (stats.inserted > 0 ? stats.inserted / stats.insert_seconds : 0) << std::setw(14)
+                  << (stats.deleted > 0 ? stats.deleted / stats.delete_seconds : 0) << std::setw(16)
+                  << stats.consolidate_seconds << std::setw(12) << searches << std::setw(12)
+                  << (stats.seconds > 0 ? searches / stats.seconds : 0) << std::setw(14)
+                  << percentile(stats.latencies, 0.5) << std::setw(14) << percentile(stats.latencies, 0.99);
+        if (stats.recall >= 0)
+            std::cout << std::setw(12) << stats.recall;
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, dist_fn, data_path, query_file, runbook_path, gt_prefix;
+    uint32_t K, Ls, R, L, insert_threads, consolidate_threads, search_threads, num_start_pts;
+    float alpha, start_point_norm;
+    size_t max_points, consolidate_slice_size;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "test_streaming_runbook", "Runs a runbook of concurrent inserts, deletes, consolidations and searches")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+
+        // Required parameters
+        po::options_description required_configs("Required");
+        required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                                       program_options_utils::DATA_TYPE_DESCRIPTION);
+        required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                                       program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
+        required_configs.add_options()("data_path", po::value<std::string>(&data_path)->required(),
+                                       program_options_utils::INPUT_DATA_PATH);
+        required_configs.add_options()("query_file", po::value<std::string>(&query_file)->required(),
+                                       program_options_utils::QUERY_FILE_DESCRIPTION);
+        required_configs.add_options()("runbook", po::value<std::string>(&runbook_path)->required(),
+                                       "Runbook of the phases to run, one per line; see "
+                                       "workflows/dynamic_index.md");
+        required_configs.add_options()("start_point_norm", po::value<float>(&start_point_norm)->required(),
+                                       "Set the start point to a random point on a sphere of this radius");
+
+        // Optional parameters
+        po::options_description optional_configs("Optional");
+        optional_configs.add_options()("recall_at,K", po::value<uint32_t>(&K)->default_value(10),
+                                       program_options_utils::NUMBER_OF_RESULTS_DESCRIPTION);
+        optional_configs.add_options()("search_list", po::value<uint32_t>(&Ls)->default_value(100),
+                                       "Size of the search list of the queries");
+        optional_configs.add_options()("gt_prefix", po::value<std::string>(&gt_prefix)->default_value(""),
+                                       "Ground truth of the search phases in files <gt_prefix><phase>.bin, phases "
+                                       "counted from 1, with point indices of the data file as ids. Computed by "
+                                       "brute force over the active points if not given.");
+        optional_configs.add_options()("max_degree,R", po::value<uint32_t>(&R)->default_value(64),
+                                       program_options_utils::MAX_BUILD_DEGREE);
+        optional_configs.add_options()("Lbuild,L", po::value<uint32_t>(&L)->default_value(100),
+                                       program_options_utils::GRAPH_BUILD_COMPLEXITY);
+        optional_configs.add_options()("alpha", po::value<float>(&alpha)->default_value(1.2f),
+                                       program_options_utils::GRAPH_BUILD_ALPHA);
+        optional_configs.add_options()("insert_threads",
+                                       po::value<uint32_t>(&insert_threads)->default_value(omp_get_num_procs() / 2),
+                                       "Number of threads of each insert (defaults to omp_get_num_procs()/2)");
+        optional_configs.add_options()(
+            "consolidate_threads", po::value<uint32_t>(&consolidate_threads)->default_value(omp_get_num_procs() / 2),
+            "Number of threads of each consolidation (defaults to omp_get_num_procs()/2)");
+        optional_configs.add_options()("search_threads", po::value<uint32_t>(&search_threads)->default_value(1),
+                                       "Number of threads searching during updates and in search phases");
+        optional_configs.add_options()("max_points", po::value<uint64_t>(&max_points)->default_value(0),
+                                       "Capacity of the index; defaults to the most points the runbook holds at "
+                                       "once");
+        optional_configs.add_options()(
+            "num_start_points",
+            po::value<uint32_t>(&num_start_pts)->default_value(diskann::defaults::NUM_FROZEN_POINTS_DYNAMIC),
+            "Set the number of random start (frozen) points to use when inserting and searching");
+        optional_configs.add_options()("consolidate_slice_size",
+                                       po::value<uint64_t>(&consolidate_slice_size)->default_value(0),
+                                       "Consolidate deletes this many locations at a time. 0 (default) "
+                                       "consolidates in one pass.");
+
+        // Merge required and optional parameters
+        desc.add(required_configs).add(optional_configs);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    diskann::Metric metric;
+    if (dist_fn == std::string("l2"))
+        metric = diskann::Metric::L2;
+    else if (dist_fn == std::string("mips"))
+        metric = diskann::Metric::INNER_PRODUCT;
+    else
+    {
+        std::cerr << "Invalid distance function. Supported functions are l2 and mips" << std::endl;
+        return -1;
+    }
+    if (search_threads == 0 || K == 0 || Ls < K)
+    {
+        std::cerr << "search_threads and recall_at must be positive, and search_list at least recall_at" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("float"))
+            return run_runbook<float>(metric, data_path, query_file, runbook_path, gt_prefix, K, Ls, R, L, alpha,
+                                      insert_threads, consolidate_threads, search_threads, max_points,
+                                      start_point_norm, num_start_pts, consolidate_slice_size);
+        else if (data_type == std::string("int8"))
+            return run_runbook<int8_t>(metric, data_path, query_file, runbook_path, gt_prefix, K, Ls, R, L, alpha,
+                                       insert_threads, consolidate_threads, search_threads, max_points,
+                                       start_point_norm, num_start_pts, consolidate_slice_size);
+        else if (data_type == std::string("uint8"))
+            return run_runbook<uint8_t>(metric, data_path, query_file, runbook_path, gt_prefix, K, Ls, R, L, alpha,
+                                        insert_threads, consolidate_threads, search_threads, max_points,
+                                        start_point_norm, num_start_pts, consolidate_slice_size);
+        std::cerr << "Invalid data type. Supported types are int8, uint8 and float" << std::endl;
+        return -1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -87,7 +87,7 @@ std::string get_save_filename(const std::string &save_path, size_t active_window
 
 template <typename T, typename TagT, typename LabelT>
 void insert_next_batch(diskann::AbstractIndex &index, size_t start, size_t end, size_t insert_threads, T *data,
-                       size_t aligned_dim, std::vector<std::vector<LabelT>> &pts_to_labels)
+                       size_t dim, size_t aligned_dim, std::vector<std::vector<LabelT>> &pts_to_labels)
 {
     try
     {
@@ -95,24 +95,42 @@ void insert_next_batch(diskann::AbstractIndex &index, size_t start, size_t end,
         std::cout << std::endl << "Inserting from " << start << " to " << end << std::endl;
 
         size_t num_failed = 0;
-#pragma omp parallel for num_threads((int32_t)insert_threads) schedule(dynamic) reduction(+ : num_failed)
-        for (int64_t j = start; j < (int64_t)end; j++)
+        if (pts_to_labels.empty())
         {
-            int insert_result = -1;
-            if (pts_to_labels.size() > 0)
+            // unfiltered points go through the batched insert, which expects
+            // unpadded vectors
+            std::vector<T> points((end - start) * dim);
+            std::vector<TagT> tags(end - start);
+            for (size_t j = 0; j < end - start; j++)
             {
-                insert_result = index.insert_point(&data[(j - start) * aligned_dim], 1 + static_cast<TagT>(j),
-                                                   pts_to_labels[j - start]);
+                memcpy(points.data() + j * dim, data + j * aligned_dim, dim * sizeof(T));
+                tags[j] = 1 + static_cast<TagT>(start + j);
             }
-            else
+
+            omp_set_num_threads((int32_t)insert_threads);
+            std::vector<int> insert_retvals;
+            index.insert_points(points.data(), tags.data(), end - start, insert_retvals);
+            for (size_t j = 0; j < end - start; j++)
             {
-                insert_result = index.insert_point(&data[(j - start) * aligned_dim], 1 + static_cast<TagT>(j));
+                if (insert_retvals[j] != 0)
+                {
+                    std::cerr << "Insert failed " << start + j << std::endl;
+                    num_failed++;
+                }
             }
-
-            if (insert_result != 0)
+        }
+        else
+        {
+#pragma omp parallel for num_threads((int32_t)insert_threads) schedule(dynamic) reduction(+ : num_failed)
+            for (int64_t j = start; j < (int64_t)end; j++)
             {
-                std::cerr << "Insert failed " << j << std::endl;
-                num_failed++;
+                int insert_result = index.insert_point(&data[(j - start) * aligned_dim], 1 + static_cast<TagT>(j),
+                                                       pts_to_labels[j - start]);
+                if (insert_result != 0)
+                {
+                    std::cerr << "Insert failed " << j << std::endl;
+                    num_failed++;
+                }
             }
         }
         const double elapsedSeconds = insert_timer.elapsed() / 1000000.0;
@@ -131,7 +149,7 @@ void insert_next_batch(diskann::AbstractIndex &index, size_t start, size_t end,
 
 template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t>
 void delete_and_consolidate(diskann::AbstractIndex &index, diskann::IndexWriteParameters &delete_params, size_t start,
-                            size_t end)
+                            size_t end, size_t consolidate_slice_size)
 {
     try
     {
@@ -140,7 +158,23 @@ void delete_and_consolidate(diskann::AbstractIndex &index, diskann::IndexWritePa
             index.lazy_delete(static_cast<TagT>(1 + i));
         std::cout << "lazy delete done." << std::endl;
 
-        auto report = index.consolidate_deletes(delete_params);
+        auto consolidate = [&]() {
+            if (consolidate_slice_size == 0)
+                return index.consolidate_deletes(delete_params);
+
+            // repair the graph one slice at a time so inserts and searches are
+            // never blocked for a full pass
+            auto report = index.consolidate_deletes_slice(delete_params, consolidate_slice_size);
+            while (report._status == diskann::consolidation_report::status_code::IN_PROGRESS)
+            {
+                std::cout << "\r" << report._locations_remaining << " locations left to consolidate" << std::flush;
+                report = index.consolidate_deletes_slice(delete_params, consolidate_slice_size);
+            }
+            std::cout << std::endl;
+            return report;
+        };
+
+        auto report = consolidate();
         while (report._status != diskann::consolidation_report::status_code::SUCCESS)
         {
             int wait_time = 5;
@@ -161,7 +195,7 @@ void delete_and_consolidate(diskann::AbstractIndex &index, diskann::IndexWritePa
                 exit(-1);
             }
             std::this_thread::sleep_for(std::chrono::seconds(wait_time));
-            report = index.consolidate_deletes(delete_params);
+            report = consolidate();
         }
         auto points_processed = report._active_points + report._slots_released;
         auto deletion_rate = points_processed / report._time;
@@ -185,7 +219,8 @@ void build_incremental_index(const std::string &data_path, const uint32_t L, con
                              const uint32_t insert_threads, const uint32_t consolidate_threads,
                              size_t max_points_to_insert, size_t active_window, size_t consolidate_interval,
                              const float start_point_norm, uint32_t num_start_pts, const std::string &save_path,
-                             const std::string &label_file, const std::string &universal_label, const uint32_t Lf)
+                             const std::string &label_file, const std::string &universal_label, const uint32_t Lf,
+                             const size_t consolidate_slice_size)
 {
     const uint32_t C = 500;
     const bool saturate_graph = false;
@@ -236,6 +271,7 @@ void build_incremental_index(const std::string &data_path, const uint32_t L, con
                             .is_enable_tags(true)
                             .is_use_opq(false)
                             .is_filtered(has_labels)
+                            .is_concurrent_consolidate(consolidate_slice_size > 0)
                             .with_num_pq_chunks(0)
                             .is_pq_dist_build(false)
                             .with_num_frozen_pts(num_start_pts)
@@ -290,8 +326,8 @@ void build_incremental_index(const std::string &data_path, const uint32_t L, con
 
     auto insert_task = std::async(std::launch::async, [&]() {
         load_aligned_bin_part(data_path, data, 0, active_window);
-        insert_next_batch<T, TagT, LabelT>(*index, (size_t)0, active_window, params.num_threads, data, aligned_dim,
-                                           pts_to_labels);
+        insert_next_batch<T, TagT, LabelT>(*index, (size_t)0, active_window, params.num_threads, data, dim,
+                                           aligned_dim, pts_to_labels);
     });
     insert_task.wait();
 
@@ -301,7 +337,7 @@ void build_incremental_index(const std::string &data_path, const uint32_t L, con
         auto end = std::min(start + consolidate_interval, max_points_to_insert);
         auto insert_task = std::async(std::launch::async, [&]() {
             load_aligned_bin_part(data_path, data, start, end - start);
-            insert_next_batch<T, TagT, LabelT>(*index, start, end, params.num_threads, data, aligned_dim,
+            insert_next_batch<T, TagT, LabelT>(*index, start, end, params.num_threads, data, dim, aligned_dim,
                                                pts_to_labels);
         });
         insert_task.wait();
@@ -314,7 +350,8 @@ void build_incremental_index(const std::string &data_path, const uint32_t L, con
             auto end_del = start - active_window;
 
             delete_tasks.emplace_back(std::async(std::launch::async, [&]() {
-                delete_and_consolidate<T, TagT, LabelT>(*index, delete_params, (size_t)start_del, (size_t)end_del);
+                delete_and_consolidate<T, TagT, LabelT>(*index, delete_params, (size_t)start_del, (size_t)end_del,
+                                                        consolidate_slice_size);
             }));
         }
     }
@@ -333,7 +370,7 @@ int main(int argc, char **argv)
     std::string data_type, dist_fn, data_path, index_path_prefix, label_file, universal_label, label_type;
     uint32_t insert_threads, consolidate_threads, R, L, num_start_pts, Lf, unique_labels_supported;
     float alpha, start_point_norm;
-    size_t max_points_to_insert, active_window, consolidate_interval;
+    size_t max_points_to_insert, active_window, consolidate_interval, consolidate_slice_size;
 
     po::options_description desc{program_options_utils::make_program_description("test_streaming_scenario",
                                                                                  "Test insert deletes & consolidate")};
@@ -399,6 +436,10 @@ int main(int argc, char **argv)
         optional_configs.add_options()("label_type", po::value<std::string>(&label_type)->default_value("uint"),
                                        "Storage type of Labels <uint/ushort>, default value is uint which "
                                        "will consume memory 4 bytes per filter");
+        optional_configs.add_options()("consolidate_slice_size",
+                                       po::value<uint64_t>(&consolidate_slice_size)->default_value(0),
+                                       "Consolidate deletes incrementally, this many locations at a time, "
+                                       "alongside inserts. 0 (default) consolidates in one pass.");
         optional_configs.add_options()("unique_labels_supported",
                                        po::value<uint32_t>(&unique_labels_supported)->default_value(0),
                                        "Number of unique labels supported by the dynamic index.");
@@ -463,14 +504,14 @@ int main(int argc, char **argv)
                 build_incremental_index<uint8_t, uint32_t, uint16_t>(
                     data_path, L, R, alpha, insert_threads, consolidate_threads, max_points_to_insert, active_window,
                     consolidate_interval, start_point_norm, num_start_pts, index_path_prefix, label_file,
-                    universal_label, Lf);
+                    universal_label, Lf, consolidate_slice_size);
             }
             else if (label_type == std::string("uint"))
             {
                 build_incremental_index<uint8_t, uint32_t, uint32_t>(
                     data_path, L, R, alpha, insert_threads, consolidate_threads, max_points_to_insert, active_window,
                     consolidate_interval, start_point_norm, num_start_pts, index_path_prefix, label_file,
-                    universal_label, Lf);
+                    universal_label, Lf, consolidate_slice_size);
             }
         }
         else if (data_type == std::string("int8"))
@@ -480,14 +521,14 @@ int main(int argc, char **argv)
                 build_incremental_index<int8_t, uint32_t, uint16_t>(
                     data_path, L, R, alpha, insert_threads, consolidate_threads, max_points_to_insert, active_window,
                     consolidate_interval, start_point_norm, num_start_pts, index_path_prefix, label_file,
-                    universal_label, Lf);
+                    universal_label, Lf, consolidate_slice_size);
             }
             else if (label_type == std::string("uint"))
             {
                 build_incremental_index<int8_t, uint32_t, uint32_t>(
                     data_path, L, R, alpha, insert_threads, consolidate_threads, max_points_to_insert, active_window,
                     consolidate_interval, start_point_norm, num_start_pts, index_path_prefix, label_file,
-                    universal_label, Lf);
+                    universal_label, Lf, consolidate_slice_size);
             }
         }
         else if (data_type == std::string("float"))
@@ -497,14 +538,14 @@ int main(int argc, char **argv)
                 build_incremental_index<float, uint32_t, uint16_t>(
                     data_path, L, R, alpha, insert_threads, consolidate_threads, max_points_to_insert, active_window,
                     consolidate_interval, start_point_norm, num_start_pts, index_path_prefix, label_file,
-                    universal_label, Lf);
+                    universal_label, Lf, consolidate_slice_size);
             }
             else if (label_type == std::string("uint"))
             {
                 build_incremental_index<float, uint32_t, uint32_t>(
                     data_path, L, R, alpha, insert_threads, consolidate_threads, max_points_to_insert, active_window,
                     consolidate_interval, start_point_norm, num_start_pts, index_path_prefix, label_file,
-                    universal_label, Lf);
+                    universal_label, Lf, consolidate_slice_size);
             }
         }
     }
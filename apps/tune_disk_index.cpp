@@ -0,0 +1,379 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "common_includes.h"
+#include <boost/program_options.hpp>
+
+#include "disk_utils.h"
+#include "percentile_stats.h"
+#include "pq_flash_index.h"
+#include "program_options_utils.hpp"
+#include "utils.h"
+
+#ifndef _WINDOWS
+#include "linux_aligned_file_reader.h"
+#else
+#ifdef USE_BING_INFRA
+#include "bing_aligned_file_reader.h"
+#else
+#include "windows_aligned_file_reader.h"
+#endif
+#endif
+
+namespace po = boost::program_options;
+
+// Searching the query sample with one configuration
+struct Measurement
+{
+    uint32_t num_nodes_to_cache;
+    uint32_t beamwidth;
+    uint32_t L;
+    double qps;
+    double mean_latency_us;
+    double p99_latency_us;
+    double mean_ios;
+    double recall;
+};
+
+struct TuningTarget
+{
+    // 0 for none; at least one of the two is set
+    float recall;
+    float p99_latency_us;
+
+    bool met_by(const Measurement &m) const
+    {
+        return (recall <= 0 || m.recall >= recall) && (p99_latency_us <= 0 || m.p99_latency_us <= p99_latency_us);
+    }
+
+    // With a recall target the fastest configuration that reaches it wins,
+    // otherwise the most accurate one within the latency target. Ties go to
+    // the smaller cache.
+    bool better(const Measurement &a, const Measurement &b) const
+    {
+        if (recall > 0)
+        {
+            if (a.qps != b.qps)
+                return a.qps > b.qps;
+        }
+        else if (a.recall != b.recall)
+        {
+            return a.recall > b.recall;
+        }
+        else if (a.qps != b.qps)
+        {
+            return a.qps > b.qps;
+        }
+        return a.num_nodes_to_cache < b.num_nodes_to_cache;
+    }
+};
+
+std::shared_ptr<AlignedFileReader> create_reader()
+{
+#ifdef _WINDOWS
+#ifndef USE_BING_INFRA
+    return std::shared_ptr<AlignedFileReader>(new WindowsAlignedFileReader());
+#else
+    return std::shared_ptr<AlignedFileReader>(new diskann::BingAlignedFileReader());
+#endif
+#else
+    return std::shared_ptr<AlignedFileReader>(new LinuxAlignedFileReader());
+#endif
+}
+
+template <typename T>
+Measurement measure(diskann::PQFlashIndex<T> &index, const T *query, size_t query_num, size_t query_aligned_dim,
+                    uint32_t *gt_ids, float *gt_dists, size_t gt_dim, uint32_t K, uint32_t L, uint32_t W,
+                    uint32_t num_threads)
+{
+    std::vector<uint64_t> ids_64(K * query_num);
+    std::vector<uint32_t> ids(K * query_num);
+    std::vector<float> dists(K * query_num);
+    std::vector<diskann::QueryStats> stats(query_num);
+
+    auto s = std::chrono::high_resolution_clock::now();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (int64_t i = 0; i < (int64_t)query_num; i++)
+    {
+        index.cached_beam_search(query + i * query_aligned_dim, K, L, ids_64.data() + i * K, dists.data() + i * K, W,
+                                 false, stats.data() + i);
+    }
+    std::chrono::duration<double> diff = std::chrono::high_resolution_clock::now() - s;
+    diskann::convert_types<uint64_t, uint32_t>(ids_64.data(), ids.data(), query_num, K);
+
+    auto total_us = [](const diskann::QueryStats &stats) { return stats.total_us; };
+    Measurement m;
+    m.beamwidth = W;
+    m.L = L;
+    m.qps = query_num / diff.count();
+    m.mean_latency_us = diskann::get_mean_stats<float>(stats.data(), query_num, total_us);
+    m.p99_latency_us = diskann::get_percentile_stats<float>(stats.data(), query_num, 0.99f, total_us);
+    m.mean_ios = diskann::get_mean_stats<uint32_t>(stats.data(), query_num,
+                                                   [](const diskann::QueryStats &stats) { return stats.n_ios; });
+    m.recall = diskann::calculate_recall((uint32_t)query_num, gt_ids, gt_dists, (uint32_t)gt_dim, ids.data(), K, K);
+    return m;
+}
+
+// Searches the query sample with every cache size and beam width, each over
+// the L values in increasing order until one meets the recall target or one
+// misses the latency target, as larger L only costs more. Writes the best
+// configuration that meets the targets to config_file.
+template <typename T>
+int tune_disk_index(diskann::Metric metric, const std::string &index_path_prefix, const std::string &query_file,
+                    const std::string &gt_file, const std::string &cache_sample_file, const uint32_t K,
+                    std::vector<uint32_t> cache_sizes, std::vector<uint32_t> beamwidths, std::vector<uint32_t> Lvec,
+                    const TuningTarget &target, const uint32_t num_threads, const std::string &config_file)
+{
+    T *query = nullptr;
+    uint32_t *gt_ids = nullptr;
+    float *gt_dists = nullptr;
+    size_t query_num, query_dim, query_aligned_dim, gt_num, gt_dim;
+    diskann::load_aligned_bin<T>(query_file, query, query_num, query_dim, query_aligned_dim);
+    diskann::load_truthset(gt_file, gt_ids, gt_dists, gt_num, gt_dim);
+    if (gt_num != query_num || gt_dim < K)
+    {
+        diskann::cerr << "Error. The ground truth must have at least K results for each query" << std::endl;
+        return -1;
+    }
+
+    std::sort(cache_sizes.begin(), cache_sizes.end());
+    std::sort(beamwidths.begin(), beamwidths.end());
+    std::sort(Lvec.begin(), Lvec.end());
+    Lvec.erase(std::remove_if(Lvec.begin(), Lvec.end(), [K](uint32_t L) { return L < K; }), Lvec.end());
+    if (Lvec.empty())
+    {
+        diskann::cerr << "Error. No search list size is at least K" << std::endl;
+        return -1;
+    }
+
+    // The nodes the sample visits most, most visited first, so the cache list
+    // of every smaller cache size is a prefix of this one
+    std::vector<uint32_t> node_list;
+    if (cache_sizes.back() > 0)
+    {
+        std::shared_ptr<AlignedFileReader> reader = create_reader();
+        diskann::PQFlashIndex<T> index(reader, metric);
+        if (index.load(num_threads, index_path_prefix.c_str()) != 0)
+            return -1;
+        index.generate_cache_list_from_sample_queries(cache_sample_file, 15, 6, cache_sizes.back(), num_threads,
+                                                      node_list);
+    }
+
+    diskann::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    diskann::cout.precision(2);
+    diskann::cout << std::setw(12) << "Cache" << std::setw(12) << "Beamwidth" << std::setw(6) << "L" << std::setw(16)
+                  << "QPS" << std::setw(16) << "Mean Latency" << std::setw(16) << "99 Latency" << std::setw(12)
+                  << "Mean IOs" << std::setw(12) << "Recall@" + std::to_string(K) << std::endl;
+
+    std::vector<Measurement> measurements;
+    for (uint32_t num_nodes_to_cache : cache_sizes)
+    {
+        std::shared_ptr<AlignedFileReader> reader = create_reader();
+        diskann::PQFlashIndex<T> index(reader, metric);
+        if (index.load(num_threads, index_path_prefix.c_str()) != 0)
+            return -1;
+        std::vector<uint32_t> cache_list(node_list.begin(),
+                                         node_list.begin() + std::min<size_t>(num_nodes_to_cache, node_list.size()));
+        index.load_cache_list(cache_list);
+
+        // warms up the page cache and the device
+        measure(index, query, query_num, query_aligned_dim, gt_ids, gt_dists, gt_dim, K, Lvec.back(),
+                beamwidths.back(), num_threads);
+
+        for (uint32_t W : beamwidths)
+        {
+            for (uint32_t L : Lvec)
+            {
+                Measurement m =
+                    measure(index, query, query_num, query_aligned_dim, gt_ids, gt_dists, gt_dim, K, L, W, num_threads);
+                m.num_nodes_to_cache = num_nodes_to_cache;
+                measurements.push_back(m);
+                diskann::cout << std::setw(12) << m.num_nodes_to_cache << std::setw(12) << m.beamwidth << std::setw(6)
+                              << m.L << std::setw(16) << m.qps << std::setw(16) << m.mean_latency_us << std::setw(16)
+                              << m.p99_latency_us << std::setw(12) << m.mean_ios << std::setw(12) << m.recall
+                              << std::endl;
+                if ((target.recall > 0 && m.recall >= target.recall) ||
+                    (target.p99_latency_us > 0 && m.p99_latency_us > target.p99_latency_us))
+                    break;
+            }
+        }
+    }
+    diskann::aligned_free(query);
+    delete[] gt_ids;
+    delete[] gt_dists;
+
+    const Measurement *best = nullptr;
+    for (const Measurement &m : measurements)
+    {
+        if (target.met_by(m) && (best == nullptr || target.better(m, *best)))
+            best = &m;
+    }
+    if (best == nullptr)
+    {
+        diskann::cerr << "No configuration meets the target. Try larger search lists, beam widths or caches."
+                      << std::endl;
+        return -1;
+    }
+
+    std::ofstream out(config_file);
+    out << "{\n"
+        << "  \"num_nodes_to_cache\": " << best->num_nodes_to_cache << ",\n"
+        << "  \"beamwidth\": " << best->beamwidth << ",\n"
+        << "  \"search_list\": " << best->L << ",\n"
+        << "  \"num_threads\": " << num_threads << ",\n"
+        << "  \"recall_at\": " << K << ",\n"
+        << "  \"recall\": " << best->recall << ",\n"
+        << "  \"qps\": " << best->qps << ",\n"
+        << "  \"mean_latency_us\": " << best->mean_latency_us << ",\n"
+        << "  \"p99_latency_us\": " << best->p99_latency_us << "\n"
+        << "}\n";
+    out.close();
+    diskann::cout << "Recommended: --num_nodes_to_cache " << best->num_nodes_to_cache << " --beamwidth "
+                  << best->beamwidth << " --search_list " << best->L << ", written to " << config_file << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, dist_fn, index_path_prefix, query_file, gt_file, cache_sample_file, config_file;
+    uint32_t num_threads, K;
+    std::vector<uint32_t> cache_sizes, beamwidths, Lvec;
+    TuningTarget target;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "tune_disk_index", "Finds the cache size, beam width and search list size of an on-disk index that best "
+                           "meet a recall or latency target on a sample of queries")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+
+        // Required parameters
+        po::options_description required_configs("Required");
+        required_configs.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                                       program_options_utils::DISK_DATA_TYPE_DESCRIPTION);
+        required_configs.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                                       program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
+        required_configs.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                                       program_options_utils::INDEX_PATH_PREFIX_DESCRIPTION);
+        required_configs.add_options()("query_file", po::value<std::string>(&query_file)->required(),
+                                       "Sample of the queries to serve, in binary format");
+        required_configs.add_options()("gt_file", po::value<std::string>(&gt_file)->required(),
+                                       "Ground truth of the query sample, in binary format");
+        required_configs.add_options()("recall_at,K", po::value<uint32_t>(&K)->required(),
+                                       program_options_utils::NUMBER_OF_RESULTS_DESCRIPTION);
+
+        // Optional parameters
+        po::options_description optional_configs("Optional");
+        optional_configs.add_options()("target_recall", po::value<float>(&target.recall)->default_value(0.0f),
+                                       "Recall@K to reach, in percent. The fastest configuration that reaches it is "
+                                       "recommended.  Default value: 0 (none)");
+        optional_configs.add_options()("target_p99_latency_us",
+                                       po::value<float>(&target.p99_latency_us)->default_value(0.0f),
+                                       "99th percentile latency in microseconds not to exceed. Without a recall "
+                                       "target, the most accurate configuration within it is recommended.  Default "
+                                       "value: 0 (none)");
+        optional_configs.add_options()("num_nodes_to_cache",
+                                       po::value<std::vector<uint32_t>>(&cache_sizes)
+                                           ->multitoken()
+                                           ->default_value({0, 10000, 100000}, "0 10000 100000"),
+                                       "Cache sizes to try, in nodes. The nodes the query sample visits most are "
+                                       "cached");
+        optional_configs.add_options()(
+            "beamwidth,W",
+            po::value<std::vector<uint32_t>>(&beamwidths)->multitoken()->default_value({2, 4, 8}, "2 4 8"),
+            "Beam widths to try");
+        optional_configs.add_options()("search_list,L",
+                                       po::value<std::vector<uint32_t>>(&Lvec)->multitoken()->default_value(
+                                           {10, 20, 30, 40, 50, 70, 100, 150, 200, 300}, "10 20 30 ... 300"),
+                                       "Search list sizes to try");
+        optional_configs.add_options()("cache_sample_file",
+                                       po::value<std::string>(&cache_sample_file)->default_value(""),
+                                       "Queries whose searches choose the nodes to cache.  Default value: the query "
+                                       "sample");
+        optional_configs.add_options()("num_threads,T",
+                                       po::value<uint32_t>(&num_threads)->default_value(omp_get_num_procs()),
+                                       program_options_utils::NUMBER_THREADS_DESCRIPTION);
+        optional_configs.add_options()("config_file", po::value<std::string>(&config_file)->default_value(""),
+                                       "JSON file the recommended configuration is written to.  Default value: "
+                                       "<index_path_prefix>_search_config.json");
+
+        // Merge required and optional parameters
+        desc.add(required_configs).add(optional_configs);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    diskann::Metric metric;
+    if (dist_fn == std::string("mips"))
+        metric = diskann::Metric::INNER_PRODUCT;
+    else if (dist_fn == std::string("l2"))
+        metric = diskann::Metric::L2;
+    else if (dist_fn == std::string("cosine"))
+        metric = diskann::Metric::COSINE;
+    else
+    {
+        std::cout << "Unsupported distance function. Currently only L2/ Inner "
+                     "Product/Cosine are supported."
+                  << std::endl;
+        return -1;
+    }
+
+    if (target.recall <= 0 && target.p99_latency_us <= 0)
+    {
+        std::cerr << "Set --target_recall, --target_p99_latency_us or both" << std::endl;
+        return -1;
+    }
+    if (cache_sizes.empty() || beamwidths.empty() || Lvec.empty())
+    {
+        std::cerr << "Give at least one cache size, beam width and search list size" << std::endl;
+        return -1;
+    }
+    if (cache_sample_file.empty())
+        cache_sample_file = query_file;
+    if (config_file.empty())
+        config_file = index_path_prefix + "_search_config.json";
+
+    try
+    {
+        if (data_type == std::string("float"))
+            return tune_disk_index<float>(metric, index_path_prefix, query_file, gt_file, cache_sample_file, K,
+                                          cache_sizes, beamwidths, Lvec, target, num_threads, config_file);
+        else if (data_type == std::string("int8"))
+            return tune_disk_index<int8_t>(metric, index_path_prefix, query_file, gt_file, cache_sample_file, K,
+                                           cache_sizes, beamwidths, Lvec, target, num_threads, config_file);
+        else if (data_type == std::string("uint8"))
+            return tune_disk_index<uint8_t>(metric, index_path_prefix, query_file, gt_file, cache_sample_file, K,
+                                            cache_sizes, beamwidths, Lvec, target, num_threads, config_file);
+        else if (data_type == std::string("fp16"))
+            return tune_disk_index<diskann::float16>(metric, index_path_prefix, query_file, gt_file,
+                                                     cache_sample_file, K, cache_sizes, beamwidths, Lvec, target,
+                                                     num_threads, config_file);
+        else if (data_type == std::string("bf16"))
+            return tune_disk_index<diskann::bfloat16>(metric, index_path_prefix, query_file, gt_file,
+                                                      cache_sample_file, K, cache_sizes, beamwidths, Lvec, target,
+                                                      num_threads, config_file);
+        else
+        {
+            std::cerr << "Unsupported data type. Use float, int8, uint8, fp16 or bf16" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << std::string(e.what()) << std::endl;
+        diskann::cerr << "Index tuning failed." << std::endl;
+        return -1;
+    }
+}
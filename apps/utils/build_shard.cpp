@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <iostream>
+#include <string>
+
+#include "disk_utils.h"
+#include "utils.h"
+
+// Builds one shard of a disk index build whose graph is split to fit the RAM
+// budget, from the job file the partitioning step wrote next to the shard, so
+// that the shards can be built by separate processes or machines.
+int main(int argc, char **argv)
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::cout << "Usage:\n"
+                  << argv[0] << "  datatype<int8/uint8/float/fp16/bf16>  <shard_job_file>  [num_threads]" << std::endl;
+        exit(-1);
+    }
+
+    const std::string data_type(argv[1]);
+    try
+    {
+        diskann::ShardBuildJob job = diskann::load_shard_job(argv[2]);
+        if (argc == 4)
+            job.num_threads = (uint32_t)std::atoi(argv[3]);
+
+        if (data_type == std::string("float"))
+            diskann::build_shard<float>(job);
+        else if (data_type == std::string("int8"))
+            diskann::build_shard<int8_t>(job);
+        else if (data_type == std::string("uint8"))
+            diskann::build_shard<uint8_t>(job);
+        else if (data_type == std::string("fp16"))
+            diskann::build_shard<diskann::float16>(job);
+        else if (data_type == std::string("bf16"))
+            diskann::build_shard<diskann::bfloat16>(job);
+        else
+        {
+            std::cerr << "Unsupported data type. Use float/int8/uint8/fp16/bf16" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Shard build failed: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <boost/program_options.hpp>
+
+#include "compressed_file.h"
+#include "utils.h"
+#include "program_options_utils.hpp"
+
+namespace po = boost::program_options;
+
+// Compresses an index file for shipping, or restores the original of one.
+// Loaders of in-memory graph, data, tags and PQ code files read compressed
+// files in place of the originals, so a compressed file can be deployed under
+// the original name.
+int main(int argc, char **argv)
+{
+    std::string codec, input_file, output_file;
+    uint64_t block_size;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "compress_index_file", "Compresses an index file into blocks that loaders decompress in parallel")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+        desc.add_options()("codec", po::value<std::string>(&codec)->required(),
+                           "graph (delta and varint coded adjacency lists, for the graph file of an in-memory "
+                           "index), zstd (any file, such as data or _pq_compressed.bin files; needs a build with "
+                           "-DZSTD=ON) or decompress (restores the original of a compressed file)");
+        desc.add_options()("input_file", po::value<std::string>(&input_file)->required(), "File to convert");
+        desc.add_options()("output_file", po::value<std::string>(&output_file)->required(), "File to write");
+        desc.add_options()("block_size",
+                           po::value<uint64_t>(&block_size)->default_value(diskann::defaults::COMPRESSED_BLOCK_SIZE),
+                           "Bytes of the input compressed into each block");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    try
+    {
+        if (codec == std::string("graph"))
+            diskann::CompressedFile::compress(input_file, output_file, diskann::BlockCodec::GraphVarint, block_size);
+        else if (codec == std::string("zstd"))
+            diskann::CompressedFile::compress(input_file, output_file, diskann::BlockCodec::Zstd, block_size);
+        else if (codec == std::string("decompress"))
+            diskann::CompressedFile::decompress(input_file, output_file);
+        else
+        {
+            std::cerr << "Unsupported codec. Use graph/zstd/decompress" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -13,9 +13,9 @@
 #include <random>
 #include <limits>
 #include <cstring>
-#include <queue>
+#include <future>
 #include <omp.h>
-#include <mkl.h>
+#include "blas_compat.h"
 #include <boost/program_options.hpp>
 #include <unordered_map>
 #include <tsl/robin_map.h>
@@ -28,11 +28,18 @@
 #endif
 #include "filter_utils.h"
 #include "utils.h"
+#ifdef USE_CUDA
+#include "gpu_math_utils.h"
+#endif
 
 // WORKS FOR UPTO 2 BILLION POINTS (as we use INT INSTEAD OF UNSIGNED)
 
 #define PARTSIZE 10000000
 #define ALIGNMENT 512
+// Distances are computed for tiles of at least MIN_TILE_POINTS base points
+// and at most TILE_FLOATS distances at a time
+#define TILE_FLOATS (1 << 26)
+#define MIN_TILE_POINTS 1024
 
 // custom types (for readability)
 typedef tsl::robin_set<std::string> label_set;
@@ -45,17 +52,6 @@ template <class T> T div_round_up(const T numerator, const T denominator)
     return (numerator % denominator == 0) ? (numerator / denominator) : 1 + (numerator / denominator);
 }
 
-using pairIF = std::pair<size_t, float>;
-struct cmpmaxstruct
-{
-    bool operator()(const pairIF &l, const pairIF &r)
-    {
-        return l.second < r.second;
-    };
-};
-
-using maxPQIFCS = std::priority_queue<pairIF, std::vector<pairIF>, cmpmaxstruct>;
-
 template <class T> T *aligned_malloc(const size_t n, const size_t alignment)
 {
 #ifdef _WINDOWS
@@ -123,127 +119,117 @@ void inner_prod_to_points(const size_t dim,
         delete[] ones_vec;
 }
 
-void exact_knn(const size_t dim, const size_t k,
-               size_t *const closest_points,     // k * num_queries preallocated, col
-                                                 // major, queries columns
-               float *const dist_closest_points, // k * num_queries
-                                                 // preallocated, Dist to
-                                                 // corresponding closes_points
-               size_t npoints,
-               float *points_in, // points in Col major
-               size_t nqueries, float *queries_in,
-               diskann::Metric metric = diskann::Metric::L2) // queries in Col major
+// Hamming distances of bit-packed uint8 vectors, given as floats of their bytes
+void hamming_to_points(const size_t dim,
+                       float *dist_matrix, // Col Major, cols are queries, rows are points
+                       size_t npoints, const float *const points, size_t nqueries, const float *const queries)
 {
-    float *points_l2sq = new float[npoints];
-    float *queries_l2sq = new float[nqueries];
-    compute_l2sq(points_l2sq, points_in, npoints, dim);
-    compute_l2sq(queries_l2sq, queries_in, nqueries, dim);
-
-    float *points = points_in;
-    float *queries = queries_in;
+    std::vector<uint8_t> point_bytes(npoints * dim), query_bytes(nqueries * dim);
+    for (size_t i = 0; i < npoints * dim; i++)
+        point_bytes[i] = (uint8_t)points[i];
+    for (size_t i = 0; i < nqueries * dim; i++)
+        query_bytes[i] = (uint8_t)queries[i];
+    diskann::DistanceHammingUInt8 distance;
+#pragma omp parallel for schedule(static, 1)
+    for (int64_t q = 0; q < (int64_t)nqueries; q++)
+    {
+        for (size_t p = 0; p < npoints; p++)
+            dist_matrix[q * npoints + p] =
+                distance.compare(point_bytes.data() + p * dim, query_bytes.data() + q * dim, (uint32_t)dim);
+    }
+}
 
-    if (metric == diskann::Metric::COSINE)
-    { // we convert cosine distance as
-      // normalized L2 distnace
-        points = new float[npoints * dim];
-        queries = new float[nqueries * dim];
+// Scales the num_points rows of data to unit norm, so that cosine distances
+// can be computed as L2 ones
+void normalize_rows(float *const data, const int64_t num_points, const uint64_t dim)
+{
+    float *norms = new float[num_points];
+    compute_l2sq(norms, data, num_points, dim);
 #pragma omp parallel for schedule(static, 4096)
-        for (int64_t i = 0; i < (int64_t)npoints; i++)
+    for (int64_t i = 0; i < num_points; i++)
+    {
+        float norm = std::sqrt(norms[i]);
+        if (norm == 0)
         {
-            float norm = std::sqrt(points_l2sq[i]);
-            if (norm == 0)
-            {
-                norm = std::numeric_limits<float>::epsilon();
-            }
-            for (uint32_t j = 0; j < dim; j++)
-            {
-                points[i * dim + j] = points_in[i * dim + j] / norm;
-            }
+            norm = std::numeric_limits<float>::epsilon();
         }
-
-#pragma omp parallel for schedule(static, 4096)
-        for (int64_t i = 0; i < (int64_t)nqueries; i++)
+        for (uint32_t j = 0; j < dim; j++)
         {
-            float norm = std::sqrt(queries_l2sq[i]);
-            if (norm == 0)
-            {
-                norm = std::numeric_limits<float>::epsilon();
-            }
-            for (uint32_t j = 0; j < dim; j++)
-            {
-                queries[i * dim + j] = queries_in[i * dim + j] / norm;
-            }
+            data[i * dim + j] /= norm;
         }
-        // recalculate norms after normalizing, they should all be one.
-        compute_l2sq(points_l2sq, points, npoints, dim);
-        compute_l2sq(queries_l2sq, queries, nqueries, dim);
     }
+    delete[] norms;
+}
 
-    std::cout << "Going to compute " << k << " NNs for " << nqueries << " queries over " << npoints << " points in "
-              << dim << " dimensions using";
-    if (metric == diskann::Metric::INNER_PRODUCT)
-        std::cout << " MIPS ";
-    else if (metric == diskann::Metric::COSINE)
-        std::cout << " Cosine ";
-    else
-        std::cout << " L2 ";
-    std::cout << "distance fn. " << std::endl;
-
-    size_t q_batch_size = (1 << 9);
-    float *dist_matrix = new float[(size_t)q_batch_size * (size_t)npoints];
+// The k nearest points found so far for a query, as a max-heap on distance:
+// its front is the farthest of them, so a new distance is compared with it
+// alone.
+using knn_heap = std::vector<std::pair<float, uint32_t>>;
+
+// Merges the npoints points of a part, with ids start_id onwards, into the
+// heaps of the queries. The distances are computed a tile of points and a
+// batch of queries at a time, so at most TILE_FLOATS of them are ever in
+// memory, and each tile is scanned into the heaps while it is in cache.
+// Points whose tag is 0 are skipped.
+void exact_knn(const size_t dim, const size_t k, std::vector<knn_heap> &heaps, size_t npoints,
+               float *points, // points row major
+               const float *const points_l2sq, size_t start_id, size_t nqueries,
+               float *queries, // queries row major
+               const float *const queries_l2sq, const std::vector<uint32_t> &location_to_tag,
+               diskann::Metric metric = diskann::Metric::L2)
+{
+    const size_t q_batch_size = std::min(nqueries, (size_t)(TILE_FLOATS / MIN_TILE_POINTS));
+    const size_t tile_size = std::min(npoints, (size_t)(TILE_FLOATS / q_batch_size));
+    float *dist_matrix = new float[tile_size * q_batch_size];
 
-    for (size_t b = 0; b < div_round_up(nqueries, q_batch_size); ++b)
+    for (size_t q_b = 0; q_b < nqueries; q_b += q_batch_size)
     {
-        int64_t q_b = b * q_batch_size;
-        int64_t q_e = ((b + 1) * q_batch_size > nqueries) ? nqueries : (b + 1) * q_batch_size;
-
-        if (metric == diskann::Metric::L2 || metric == diskann::Metric::COSINE)
-        {
-            distsq_to_points(dim, dist_matrix, npoints, points, points_l2sq, q_e - q_b,
-                             queries + (ptrdiff_t)q_b * (ptrdiff_t)dim, queries_l2sq + q_b);
-        }
-        else
+        const size_t q_e = std::min(nqueries, q_b + q_batch_size);
+        for (size_t tile_start = 0; tile_start < npoints; tile_start += tile_size)
         {
-            inner_prod_to_points(dim, dist_matrix, npoints, points, q_e - q_b,
-                                 queries + (ptrdiff_t)q_b * (ptrdiff_t)dim);
-        }
-        std::cout << "Computed distances for queries: [" << q_b << "," << q_e << ")" << std::endl;
-
-#pragma omp parallel for schedule(dynamic, 16)
-        for (long long q = q_b; q < q_e; q++)
-        {
-            maxPQIFCS point_dist;
-            for (size_t p = 0; p < k; p++)
-                point_dist.emplace(p, dist_matrix[(ptrdiff_t)p + (ptrdiff_t)(q - q_b) * (ptrdiff_t)npoints]);
-            for (size_t p = k; p < npoints; p++)
+            const size_t cur_tile_size = std::min(tile_size, npoints - tile_start);
+            float *tile_points = points + (ptrdiff_t)tile_start * (ptrdiff_t)dim;
+            if (metric == diskann::Metric::L2 || metric == diskann::Metric::COSINE)
+            {
+                distsq_to_points(dim, dist_matrix, cur_tile_size, tile_points, points_l2sq + tile_start, q_e - q_b,
+                                 queries + (ptrdiff_t)q_b * (ptrdiff_t)dim, queries_l2sq + q_b);
+            }
+            else if (metric == diskann::Metric::HAMMING)
             {
-                if (point_dist.top().second > dist_matrix[(ptrdiff_t)p + (ptrdiff_t)(q - q_b) * (ptrdiff_t)npoints])
-                    point_dist.emplace(p, dist_matrix[(ptrdiff_t)p + (ptrdiff_t)(q - q_b) * (ptrdiff_t)npoints]);
-                if (point_dist.size() > k)
-                    point_dist.pop();
+                hamming_to_points(dim, dist_matrix, cur_tile_size, tile_points, q_e - q_b,
+                                  queries + (ptrdiff_t)q_b * (ptrdiff_t)dim);
             }
-            for (ptrdiff_t l = 0; l < (ptrdiff_t)k; ++l)
+            else
             {
-                closest_points[(ptrdiff_t)(k - 1 - l) + (ptrdiff_t)q * (ptrdiff_t)k] = point_dist.top().first;
-                dist_closest_points[(ptrdiff_t)(k - 1 - l) + (ptrdiff_t)q * (ptrdiff_t)k] = point_dist.top().second;
-                point_dist.pop();
+                inner_prod_to_points(dim, dist_matrix, cur_tile_size, tile_points, q_e - q_b,
+                                     queries + (ptrdiff_t)q_b * (ptrdiff_t)dim);
+            }
+
+#pragma omp parallel for schedule(dynamic, 16)
+            for (int64_t q = (int64_t)q_b; q < (int64_t)q_e; q++)
+            {
+                knn_heap &heap = heaps[q];
+                const float *dists = dist_matrix + (ptrdiff_t)(q - q_b) * (ptrdiff_t)cur_tile_size;
+                for (size_t p = 0; p < cur_tile_size; p++)
+                {
+                    if (heap.size() == k && dists[p] >= heap.front().first)
+                        continue;
+                    const size_t id = start_id + tile_start + p;
+                    if (!location_to_tag.empty() && location_to_tag[id] == 0)
+                        continue;
+                    if (heap.size() == k)
+                    {
+                        std::pop_heap(heap.begin(), heap.end());
+                        heap.pop_back();
+                    }
+                    heap.emplace_back(dists[p], (uint32_t)id);
+                    std::push_heap(heap.begin(), heap.end());
+                }
             }
-            assert(std::is_sorted(dist_closest_points + (ptrdiff_t)q * (ptrdiff_t)k,
-                                  dist_closest_points + (ptrdiff_t)(q + 1) * (ptrdiff_t)k));
         }
-        std::cout << "Computed exact k-NN for queries: [" << q_b << "," << q_e << ")" << std::endl;
     }
 
     delete[] dist_matrix;
-
-    delete[] points_l2sq;
-    delete[] queries_l2sq;
-
-    if (metric == diskann::Metric::COSINE)
-    {
-        delete[] points;
-        delete[] queries;
-    }
 }
 
 template <typename T> inline int get_num_parts(const char *filename)
@@ -334,6 +320,15 @@ inline void save_groundtruth_as_one_file(const std::string filename, int32_t *da
     std::cout << "Finished writing truthset" << std::endl;
 }
 
+// A part of the base file, converted to float and normalized for cosine
+struct base_part
+{
+    float *data = nullptr;
+    float *l2sq = nullptr;
+    size_t npts = 0;
+    size_t dim = 0;
+};
+
 template <typename T>
 std::vector<std::vector<std::pair<uint32_t, float>>> processUnfilteredParts(const std::string &base_file,
                                                                             size_t &nqueries, size_t &npoints,
@@ -341,38 +336,103 @@ std::vector<std::vector<std::pair<uint32_t, float>>> processUnfilteredParts(cons
                                                                             const diskann::Metric &metric,
                                                                             std::vector<uint32_t> &location_to_tag)
 {
-    float *base_data = nullptr;
     int num_parts = get_num_parts<T>(base_file.c_str());
-    std::vector<std::vector<std::pair<uint32_t, float>>> res(nqueries);
+
+    if (metric == diskann::Metric::COSINE)
+        normalize_rows(query_data, nqueries, dim);
+    float *queries_l2sq = new float[nqueries];
+    compute_l2sq(queries_l2sq, query_data, nqueries, dim);
+
+    std::cout << "Going to compute " << k << " NNs for " << nqueries << " queries in " << dim << " dimensions using";
+    if (metric == diskann::Metric::INNER_PRODUCT)
+        std::cout << " MIPS ";
+    else if (metric == diskann::Metric::COSINE)
+        std::cout << " Cosine ";
+    else if (metric == diskann::Metric::HAMMING)
+        std::cout << " Hamming ";
+    else
+        std::cout << " L2 ";
+    std::cout << "distance fn. " << std::endl;
+
+    bool use_gpu = false;
+#ifdef USE_CUDA
+    use_gpu = math_utils::gpu::num_devices() > 0 && metric != diskann::Metric::HAMMING;
+    if (use_gpu)
+        std::cout << "Using " << math_utils::gpu::num_devices() << " CUDA device(s)." << std::endl;
+#endif
+    // the CPU keeps a heap per query, the GPU sorted lists
+    std::vector<knn_heap> heaps(use_gpu ? 0 : nqueries);
+    std::vector<float> knn_dists(use_gpu ? nqueries * k : 0, std::numeric_limits<float>::max());
+    std::vector<uint32_t> knn_ids(use_gpu ? nqueries * k : 0, std::numeric_limits<uint32_t>::max());
+
+    // the next part is read while the current one is searched
+    auto load_part = [&](int part_num) {
+        base_part part;
+        load_bin_as_float<T>(base_file.c_str(), part.data, part.npts, part.dim, part_num);
+        if (metric == diskann::Metric::COSINE)
+            normalize_rows(part.data, part.npts, part.dim);
+        if (!use_gpu)
+        {
+            part.l2sq = new float[part.npts];
+            compute_l2sq(part.l2sq, part.data, part.npts, part.dim);
+        }
+        return part;
+    };
+    std::future<base_part> next_part = std::async(std::launch::async, load_part, 0);
+
     for (int p = 0; p < num_parts; p++)
     {
         size_t start_id = p * PARTSIZE;
-        load_bin_as_float<T>(base_file.c_str(), base_data, npoints, dim, p);
-
-        size_t *closest_points_part = new size_t[nqueries * k];
-        float *dist_closest_points_part = new float[nqueries * k];
+        base_part part = next_part.get();
+        if (p + 1 < num_parts)
+            next_part = std::async(std::launch::async, load_part, p + 1);
+        npoints = part.npts;
 
-        auto part_k = k < npoints ? k : npoints;
-        exact_knn(dim, part_k, closest_points_part, dist_closest_points_part, npoints, base_data, nqueries, query_data,
-                  metric);
-
-        for (size_t i = 0; i < nqueries; i++)
+        if (use_gpu)
         {
-            for (size_t j = 0; j < part_k; j++)
+#ifdef USE_CUDA
+            std::vector<uint8_t> excluded;
+            if (!location_to_tag.empty())
             {
-                if (!location_to_tag.empty())
-                    if (location_to_tag[closest_points_part[i * k + j] + start_id] == 0)
-                        continue;
-
-                res[i].push_back(std::make_pair((uint32_t)(closest_points_part[i * part_k + j] + start_id),
-                                                dist_closest_points_part[i * part_k + j]));
+                excluded.resize(npoints);
+                for (size_t i = 0; i < npoints; i++)
+                    excluded[i] = location_to_tag[start_id + i] == 0;
             }
+            math_utils::gpu::update_knn(part.data, npoints, (uint32_t)start_id, dim, query_data, nqueries, k,
+                                        metric == diskann::Metric::INNER_PRODUCT,
+                                        excluded.empty() ? nullptr : excluded.data(), knn_dists.data(),
+                                        knn_ids.data());
+#endif
+        }
+        else
+        {
+            exact_knn(dim, k, heaps, npoints, part.data, part.l2sq, start_id, nqueries, query_data, queries_l2sq,
+                      location_to_tag, metric);
         }
+        std::cout << "Computed exact k-NN over points [" << start_id << "," << start_id + npoints << ")"
+                  << std::endl;
 
-        delete[] closest_points_part;
-        delete[] dist_closest_points_part;
+        delete[] part.l2sq;
+        diskann::aligned_free(part.data);
+    }
+    delete[] queries_l2sq;
 
-        diskann::aligned_free(base_data);
+    std::vector<std::vector<std::pair<uint32_t, float>>> res(nqueries);
+    for (size_t i = 0; i < nqueries; i++)
+    {
+        if (use_gpu)
+        {
+            for (size_t j = 0; j < k; j++)
+            {
+                if (knn_ids[i * k + j] != std::numeric_limits<uint32_t>::max())
+                    res[i].push_back(std::make_pair(knn_ids[i * k + j], knn_dists[i * k + j]));
+            }
+        }
+        else
+        {
+            for (auto &entry : heaps[i])
+                res[i].push_back(std::make_pair(entry.second, entry.first));
+        }
     }
     return res;
 };
@@ -550,9 +610,13 @@ int main(int argc, char **argv)
     {
         metric = diskann::Metric::COSINE;
     }
+    else if (dist_fn == std::string("hamming") && data_type == std::string("uint8"))
+    {
+        metric = diskann::Metric::HAMMING;
+    }
     else
     {
-        std::cerr << "Unsupported distance function. Use l2/mips/cosine." << std::endl;
+        std::cerr << "Unsupported distance function. Use l2/mips/cosine, or hamming for uint8." << std::endl;
         return -1;
     }
 
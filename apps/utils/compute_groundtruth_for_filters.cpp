@@ -15,7 +15,7 @@
 #include <cstring>
 #include <queue>
 #include <omp.h>
-#include <mkl.h>
+#include "blas_compat.h"
 #include <boost/program_options.hpp>
 #include <unordered_map>
 #include <tsl/robin_map.h>
@@ -34,6 +34,10 @@
 
 #define PARTSIZE 10000000
 #define ALIGNMENT 512
+// Filtered ground truth computes distances for at most TILE_FLOATS query and
+// point pairs at a time, and reads blocks of at least MIN_TILE_POINTS points
+#define TILE_FLOATS (1 << 26)
+#define MIN_TILE_POINTS 1024
 
 // custom types (for readability)
 typedef tsl::robin_set<std::string> label_set;
@@ -588,53 +592,284 @@ int aux_main(const std::string &base_file, const std::string &label_file, const
     return 0;
 }
 
-void load_truthset(const std::string &bin_file, uint32_t *&ids, float *&dists, size_t &npts, size_t &dim)
+// Scales the num_points rows of data to unit norm, so that cosine distances
+// can be computed as L2 ones
+void normalize_rows(float *const data, const int64_t num_points, const uint64_t dim)
 {
-    size_t read_blk_size = 64 * 1024 * 1024;
-    cached_ifstream reader(bin_file, read_blk_size);
-    diskann::cout << "Reading truthset file " << bin_file.c_str() << " ..." << std::endl;
-    size_t actual_file_size = reader.get_file_size();
+    float *norms = new float[num_points];
+    compute_l2sq(norms, data, num_points, dim);
+#pragma omp parallel for schedule(static, 4096)
+    for (int64_t i = 0; i < num_points; i++)
+    {
+        float norm = std::sqrt(norms[i]);
+        if (norm == 0)
+        {
+            norm = std::numeric_limits<float>::epsilon();
+        }
+        for (uint32_t j = 0; j < dim; j++)
+        {
+            data[i * dim + j] /= norm;
+        }
+    }
+    delete[] norms;
+}
 
-    int npts_i32, dim_i32;
-    reader.read((char *)&npts_i32, sizeof(int));
-    reader.read((char *)&dim_i32, sizeof(int));
-    npts = (uint32_t)npts_i32;
-    dim = (uint32_t)dim_i32;
+// The k nearest points found so far for a query, as a max-heap on distance:
+// its front is the farthest of them, so a new distance is compared with it
+// alone.
+using knn_heap = std::vector<std::pair<float, uint32_t>>;
 
-    diskann::cout << "Metadata: #pts = " << npts << ", #dims = " << dim << "... " << std::endl;
+// The labels of a line of the label file: a comma separated list, before any
+// tab, as parse_label_file_into_vec reads them
+inline void parse_label_line(const std::string &line, std::vector<std::string> &labels)
+{
+    labels.clear();
+    std::string token;
+    std::istringstream iss(line);
+    getline(iss, token, '\t');
+    std::istringstream new_iss(token);
+    while (getline(new_iss, token, ','))
+    {
+        token.erase(std::remove(token.begin(), token.end(), '\n'), token.end());
+        token.erase(std::remove(token.begin(), token.end(), '\r'), token.end());
+        labels.push_back(token);
+    }
+}
 
-    int truthset_type = -1; // 1 means truthset has ids and distances, 2 means
-                            // only ids, -1 is error
-    size_t expected_file_size_with_dists = 2 * npts * dim * sizeof(uint32_t) + 2 * sizeof(uint32_t);
+// Ground truth for queries with a filter label each, in one pass over the
+// base file instead of a base and query file per label. The base vectors and
+// their labels are read a block at a time. A posting list per query label
+// holds the points of the block with that label, and points with the
+// universal label match every query. The queries of each label are compared
+// with the points of its list only, a tile at a time, and each query keeps
+// its k nearest so far in a heap. Memory is bounded by the queries, the heaps
+// and one block, which is sized from ram_budget_gb if it is set.
+template <typename T>
+int filtered_single_pass(const std::string &base_file, const std::string &label_file, const std::string &query_file,
+                         const std::string &gt_file, size_t k, const std::string &universal_label,
+                         const diskann::Metric &metric, const std::vector<std::string> &query_filters,
+                         const std::string &tags_file, double ram_budget_gb)
+{
+    size_t nqueries, dim;
+    float *query_data = nullptr;
+    load_bin_as_float<T>(query_file.c_str(), query_data, nqueries, dim, 0);
+    if (query_filters.size() != nqueries)
+    {
+        throw diskann::ANNException("Found " + std::to_string(query_filters.size()) + " query filters for " +
+                                        std::to_string(nqueries) + " queries",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    const bool tags_enabled = tags_file.empty() ? false : true;
+    std::vector<uint32_t> location_to_tag = diskann::loadTags(tags_file, base_file);
+    if (metric == diskann::Metric::COSINE)
+        normalize_rows(query_data, nqueries, dim);
 
-    if (actual_file_size == expected_file_size_with_dists)
-        truthset_type = 1;
+    // the queries of each filter label, gathered into a matrix per label
+    tsl::robin_map<std::string, uint32_t> label_ids;
+    std::vector<std::vector<uint32_t>> label_queries;
+    for (size_t q = 0; q < nqueries; q++)
+    {
+        auto iter = label_ids.find(query_filters[q]);
+        if (iter == label_ids.end())
+        {
+            iter = label_ids.insert({query_filters[q], (uint32_t)label_queries.size()}).first;
+            label_queries.emplace_back();
+        }
+        label_queries[iter->second].push_back((uint32_t)q);
+    }
+    const size_t num_labels = label_queries.size();
+    std::vector<std::vector<float>> label_query_data(num_labels), label_query_l2sq(num_labels);
+    for (size_t l = 0; l < num_labels; l++)
+    {
+        label_query_data[l].resize(label_queries[l].size() * dim);
+        label_query_l2sq[l].resize(label_queries[l].size());
+        for (size_t j = 0; j < label_queries[l].size(); j++)
+            std::memcpy(label_query_data[l].data() + j * dim, query_data + (size_t)label_queries[l][j] * dim,
+                        dim * sizeof(float));
+        compute_l2sq(label_query_l2sq[l].data(), label_query_data[l].data(), label_queries[l].size(), dim);
+    }
+    diskann::aligned_free(query_data);
+
+    std::ifstream base_reader;
+    base_reader.exceptions(std::ios::failbit | std::ios::badbit);
+    base_reader.open(base_file, std::ios::binary);
+    int npts_i32, ndims_i32;
+    base_reader.read((char *)&npts_i32, sizeof(int));
+    base_reader.read((char *)&ndims_i32, sizeof(int));
+    const size_t npoints = (size_t)npts_i32;
+    if ((size_t)ndims_i32 != dim)
+    {
+        throw diskann::ANNException("Base vectors have " + std::to_string(ndims_i32) + " dimensions, queries " +
+                                        std::to_string(dim),
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    std::ifstream label_reader(label_file);
+    if (label_reader.fail())
+        throw diskann::ANNException("Failed to open label file " + label_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    // A block takes its vectors as read and as float, the vectors gathered
+    // for a label, their norms and ids; the rest is the heaps, the queries
+    // and the distances of a tile
+    size_t block_size = PARTSIZE;
+    if (ram_budget_gb > 0)
+    {
+        const double fixed_bytes = (double)nqueries * (k * sizeof(knn_heap::value_type) + 2 * dim * sizeof(float)) +
+                                   (double)TILE_FLOATS * sizeof(float);
+        const double point_bytes = (double)dim * (sizeof(T) + 2 * sizeof(float)) + 4 * sizeof(uint32_t);
+        const double block_bytes = ram_budget_gb * 1024 * 1024 * 1024 - fixed_bytes;
+        block_size = (size_t)std::max((double)MIN_TILE_POINTS, std::min((double)PARTSIZE, block_bytes / point_bytes));
+    }
+    block_size = std::max((size_t)1, std::min(block_size, npoints));
+    std::cout << "Computing filtered ground truth for " << nqueries << " queries with " << num_labels
+              << " distinct filters over " << npoints << " points, in blocks of " << block_size << " points"
+              << std::endl;
+
+    std::vector<knn_heap> heaps(nqueries);
+    T *block_T = new T[block_size * dim];
+    float *block_data = aligned_malloc<float>(block_size * dim, ALIGNMENT);
+    float *block_l2sq = new float[block_size];
+    float *gathered = aligned_malloc<float>(block_size * dim, ALIGNMENT);
+    float *gathered_l2sq = new float[block_size];
+    std::vector<uint32_t> gathered_ids(block_size);
+    float *dist_matrix = new float[TILE_FLOATS];
+
+    std::string line;
+    std::vector<std::string> point_labels;
+    for (size_t start_id = 0; start_id < npoints; start_id += block_size)
+    {
+        const size_t cur_block_size = std::min(block_size, npoints - start_id);
+        base_reader.read((char *)block_T, cur_block_size * dim * sizeof(T));
+#pragma omp parallel for schedule(static, 32768)
+        for (int64_t i = 0; i < (int64_t)(cur_block_size * dim); i++)
+            block_data[i] = (float)block_T[i];
+        if (metric == diskann::Metric::COSINE)
+            normalize_rows(block_data, cur_block_size, dim);
+        compute_l2sq(block_l2sq, block_data, cur_block_size, dim);
+
+        // the points of the block that match each query label
+        std::vector<std::vector<uint32_t>> postings(num_labels);
+        std::vector<uint32_t> universal_points;
+        std::vector<uint32_t> matched;
+        for (size_t i = 0; i < cur_block_size; i++)
+        {
+            if (!std::getline(label_reader, line))
+            {
+                throw diskann::ANNException("Label file " + label_file + " has fewer lines than the " +
+                                                std::to_string(npoints) + " base points",
+                                            -1, __FUNCSIG__, __FILE__, __LINE__);
+            }
+            if (!location_to_tag.empty() && location_to_tag[start_id + i] == 0)
+                continue;
+            parse_label_line(line, point_labels);
+            bool universal = false;
+            matched.clear();
+            for (const std::string &label : point_labels)
+            {
+                if (!universal_label.empty() && label == universal_label)
+                    universal = true;
+                auto iter = label_ids.find(label);
+                if (iter != label_ids.end())
+                    matched.push_back(iter->second);
+            }
+            if (universal)
+            {
+                universal_points.push_back((uint32_t)i);
+                continue;
+            }
+            for (uint32_t label : matched)
+                postings[label].push_back((uint32_t)i);
+        }
 
-    size_t expected_file_size_just_ids = npts * dim * sizeof(uint32_t) + 2 * sizeof(uint32_t);
+        for (size_t l = 0; l < num_labels; l++)
+        {
+            std::vector<uint32_t> &posting = postings[l];
+            posting.insert(posting.end(), universal_points.begin(), universal_points.end());
+            const size_t num_matched = posting.size();
+            if (num_matched == 0)
+                continue;
+#pragma omp parallel for schedule(static, 4096)
+            for (int64_t j = 0; j < (int64_t)num_matched; j++)
+            {
+                std::memcpy(gathered + j * dim, block_data + (size_t)posting[j] * dim, dim * sizeof(float));
+                gathered_l2sq[j] = block_l2sq[posting[j]];
+                gathered_ids[j] = (uint32_t)(start_id + posting[j]);
+            }
 
-    if (actual_file_size == expected_file_size_just_ids)
-        truthset_type = 2;
+            const std::vector<uint32_t> &queries = label_queries[l];
+            const size_t tile_size = std::max((size_t)1, (size_t)TILE_FLOATS / queries.size());
+            for (size_t tile_start = 0; tile_start < num_matched; tile_start += tile_size)
+            {
+                const size_t cur_tile_size = std::min(tile_size, num_matched - tile_start);
+                float *tile_points = gathered + tile_start * dim;
+                if (metric == diskann::Metric::L2 || metric == diskann::Metric::COSINE)
+                {
+                    distsq_to_points(dim, dist_matrix, cur_tile_size, tile_points, gathered_l2sq + tile_start,
+                                     queries.size(), label_query_data[l].data(), label_query_l2sq[l].data());
+                }
+                else
+                {
+                    inner_prod_to_points(dim, dist_matrix, cur_tile_size, tile_points, queries.size(),
+                                         label_query_data[l].data());
+                }
 
-    if (truthset_type == -1)
-    {
-        std::stringstream stream;
-        stream << "Error. File size mismatch. File should have bin format, with "
-                  "npts followed by ngt followed by npts*ngt ids and optionally "
-                  "followed by npts*ngt distance values; actual size: "
-               << actual_file_size << ", expected: " << expected_file_size_with_dists << " or "
-               << expected_file_size_just_ids;
-        diskann::cout << stream.str();
-        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+#pragma omp parallel for schedule(dynamic, 16)
+                for (int64_t j = 0; j < (int64_t)queries.size(); j++)
+                {
+                    knn_heap &heap = heaps[queries[j]];
+                    const float *dists = dist_matrix + (ptrdiff_t)j * (ptrdiff_t)cur_tile_size;
+                    for (size_t p = 0; p < cur_tile_size; p++)
+                    {
+                        if (heap.size() == k && dists[p] >= heap.front().first)
+                            continue;
+                        if (heap.size() == k)
+                        {
+                            std::pop_heap(heap.begin(), heap.end());
+                            heap.pop_back();
+                        }
+                        heap.emplace_back(dists[p], gathered_ids[tile_start + p]);
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                }
+            }
+        }
+        std::cout << "Computed filtered k-NN over points [" << start_id << "," << start_id + cur_block_size << ")"
+                  << std::endl;
     }
 
-    ids = new uint32_t[npts * dim];
-    reader.read((char *)ids, npts * dim * sizeof(uint32_t));
+    delete[] dist_matrix;
+    delete[] gathered_l2sq;
+    diskann::aligned_free(gathered);
+    delete[] block_l2sq;
+    diskann::aligned_free(block_data);
+    delete[] block_T;
 
-    if (truthset_type == 1)
+    int32_t *closest_points = new int32_t[nqueries * k];
+    float *dist_closest_points = new float[nqueries * k];
+    for (size_t i = 0; i < nqueries; i++)
     {
-        dists = new float[npts * dim];
-        reader.read((char *)dists, npts * dim * sizeof(float));
+        knn_heap &heap = heaps[i];
+        std::sort_heap(heap.begin(), heap.end());
+        for (size_t j = 0; j < k; j++)
+        {
+            if (j >= heap.size())
+            {
+                closest_points[i * k + j] = 0;
+                dist_closest_points[i * k + j] = std::numeric_limits<float>::max();
+                continue;
+            }
+            closest_points[i * k + j] =
+                (int32_t)(tags_enabled ? location_to_tag[heap[j].second] : heap[j].second);
+            dist_closest_points[i * k + j] =
+                metric == diskann::Metric::INNER_PRODUCT ? -heap[j].first : heap[j].first;
+        }
+        if (heap.size() < k)
+            std::cout << "WARNING: found less than k GT entries for query " << i << std::endl;
     }
+
+    save_groundtruth_as_one_file(gt_file, closest_points, dist_closest_points, nqueries, k);
+    delete[] closest_points;
+    delete[] dist_closest_points;
+    return 0;
 }
 
 int main(int argc, char **argv)
@@ -642,6 +877,7 @@ int main(int argc, char **argv)
     std::string data_type, dist_fn, base_file, query_file, gt_file, tags_file, label_file, filter_label,
         universal_label, filter_label_file;
     uint64_t K;
+    double ram_budget_gb = 0;
 
     try
     {
@@ -674,6 +910,9 @@ int main(int argc, char **argv)
         desc.add_options()("filter_label_file",
                            po::value<std::string>(&filter_label_file)->default_value(std::string("")),
                            "Filter file for Queries for Filtered Search ");
+        desc.add_options()("ram_budget_gb", po::value<double>(&ram_budget_gb)->default_value(0),
+                           "Memory budget in GB for the ground truth of a filter_label_file, which sizes the blocks "
+                           "the base file is read in; 0 reads blocks of up to 10M points");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -755,103 +994,17 @@ int main(int argc, char **argv)
     }
     else
     { // Each query has its own filter label
-        // Split up data and query bins into label specific ones
-        tsl::robin_map<std::string, uint32_t> labels_to_number_of_points;
-        tsl::robin_map<std::string, uint32_t> labels_to_number_of_queries;
-
-        label_set all_labels;
-        for (size_t i = 0; i < filter_labels.size(); i++)
-        {
-            std::string label = filter_labels[i];
-            all_labels.insert(label);
-
-            if (labels_to_number_of_queries.find(label) == labels_to_number_of_queries.end())
-            {
-                labels_to_number_of_queries[label] = 0;
-            }
-            labels_to_number_of_queries[label] += 1;
-        }
-
-        size_t npoints;
-        std::vector<std::vector<std::string>> point_to_labels;
-        parse_label_file_into_vec(npoints, label_file, point_to_labels);
-        std::vector<label_set> point_ids_to_labels(point_to_labels.size());
-        std::vector<label_set> query_ids_to_labels(filter_labels.size());
-
-        for (size_t i = 0; i < point_to_labels.size(); i++)
-        {
-            for (size_t j = 0; j < point_to_labels[i].size(); j++)
-            {
-                std::string label = point_to_labels[i][j];
-                if (all_labels.find(label) != all_labels.end())
-                {
-                    point_ids_to_labels[i].insert(point_to_labels[i][j]);
-                    if (labels_to_number_of_points.find(label) == labels_to_number_of_points.end())
-                    {
-                        labels_to_number_of_points[label] = 0;
-                    }
-                    labels_to_number_of_points[label] += 1;
-                }
-            }
-        }
-
-        for (size_t i = 0; i < filter_labels.size(); i++)
-        {
-            query_ids_to_labels[i].insert(filter_labels[i]);
-        }
-
-        tsl::robin_map<std::string, std::vector<uint32_t>> label_id_to_orig_id;
-        tsl::robin_map<std::string, std::vector<uint32_t>> label_query_id_to_orig_id;
-
-        if (data_type == std::string("float"))
-        {
-            label_id_to_orig_id = diskann::generate_label_specific_vector_files_compat<float>(
-                base_file, labels_to_number_of_points, point_ids_to_labels, all_labels);
-
-            label_query_id_to_orig_id = diskann::generate_label_specific_vector_files_compat<float>(
-                query_file, labels_to_number_of_queries, query_ids_to_labels,
-                all_labels); // query_filters acts like query_ids_to_labels
-        }
-        else if (data_type == std::string("int8"))
-        {
-            label_id_to_orig_id = diskann::generate_label_specific_vector_files_compat<int8_t>(
-                base_file, labels_to_number_of_points, point_ids_to_labels, all_labels);
-
-            label_query_id_to_orig_id = diskann::generate_label_specific_vector_files_compat<int8_t>(
-                query_file, labels_to_number_of_queries, query_ids_to_labels,
-                all_labels); // query_filters acts like query_ids_to_labels
-        }
-        else if (data_type == std::string("uint8"))
-        {
-            label_id_to_orig_id = diskann::generate_label_specific_vector_files_compat<uint8_t>(
-                base_file, labels_to_number_of_points, point_ids_to_labels, all_labels);
-
-            label_query_id_to_orig_id = diskann::generate_label_specific_vector_files_compat<uint8_t>(
-                query_file, labels_to_number_of_queries, query_ids_to_labels,
-                all_labels); // query_filters acts like query_ids_to_labels
-        }
-        else
-        {
-            diskann::cerr << "Invalid data type" << std::endl;
-            return -1;
-        }
-
-        // Generate label specific ground truths
-
         try
         {
-            for (const auto &label : all_labels)
-            {
-                std::string filtered_base_file = base_file + "_" + label;
-                std::string filtered_query_file = query_file + "_" + label;
-                std::string filtered_gt_file = gt_file + "_" + label;
-                if (data_type == std::string("float"))
-                    aux_main<float>(filtered_base_file, "", filtered_query_file, filtered_gt_file, K, "", metric, "");
-                if (data_type == std::string("int8"))
-                    aux_main<int8_t>(filtered_base_file, "", filtered_query_file, filtered_gt_file, K, "", metric, "");
-                if (data_type == std::string("uint8"))
-                    aux_main<uint8_t>(filtered_base_file, "", filtered_query_file, filtered_gt_file, K, "", metric, "");
-            }
+            if (data_type == std::string("float"))
+                filtered_single_pass<float>(base_file, label_file, query_file, gt_file, K, universal_label, metric,
+                                            filter_labels, tags_file, ram_budget_gb);
+            if (data_type == std::string("int8"))
+                filtered_single_pass<int8_t>(base_file, label_file, query_file, gt_file, K, universal_label, metric,
+                                             filter_labels, tags_file, ram_budget_gb);
+            if (data_type == std::string("uint8"))
+                filtered_single_pass<uint8_t>(base_file, label_file, query_file, gt_file, K, universal_label, metric,
+                                              filter_labels, tags_file, ram_budget_gb);
         }
         catch (const std::exception &e)
         {
@@ -859,61 +1012,5 @@ int main(int argc, char **argv)
             diskann::cerr << "Compute GT failed." << std::endl;
             return -1;
         }
-
-        // Combine the label specific ground truths to produce a single GT file
-
-        uint32_t *gt_ids = nullptr;
-        float *gt_dists = nullptr;
-        size_t gt_num, gt_dim;
-
-        std::vector<std::vector<int32_t>> final_gt_ids;
-        std::vector<std::vector<float>> final_gt_dists;
-
-        uint32_t query_num = 0;
-        for (const auto &lbl : all_labels)
-        {
-            query_num += labels_to_number_of_queries[lbl];
-        }
-
-        for (uint32_t i = 0; i < query_num; i++)
-        {
-            final_gt_ids.push_back(std::vector<int32_t>(K));
-            final_gt_dists.push_back(std::vector<float>(K));
-        }
-
-        for (const auto &lbl : all_labels)
-        {
-            std::string filtered_gt_file = gt_file + "_" + lbl;
-            load_truthset(filtered_gt_file, gt_ids, gt_dists, gt_num, gt_dim);
-
-            for (uint32_t i = 0; i < labels_to_number_of_queries[lbl]; i++)
-            {
-                uint32_t orig_query_id = label_query_id_to_orig_id[lbl][i];
-                for (uint64_t j = 0; j < K; j++)
-                {
-                    final_gt_ids[orig_query_id][j] = label_id_to_orig_id[lbl][gt_ids[i * K + j]];
-                    final_gt_dists[orig_query_id][j] = gt_dists[i * K + j];
-                }
-            }
-        }
-
-        int32_t *closest_points = new int32_t[query_num * K];
-        float *dist_closest_points = new float[query_num * K];
-
-        for (uint32_t i = 0; i < query_num; i++)
-        {
-            for (uint32_t j = 0; j < K; j++)
-            {
-                closest_points[i * K + j] = final_gt_ids[i][j];
-                dist_closest_points[i * K + j] = final_gt_dists[i][j];
-            }
-        }
-
-        save_groundtruth_as_one_file(gt_file, closest_points, dist_closest_points, query_num, K);
-
-        // cleanup artifacts
-        std::cout << "Cleaning up artifacts..." << std::endl;
-        tsl::robin_set<std::string> paths_to_clean{gt_file, base_file, query_file};
-        clean_up_artifacts(paths_to_clean, all_labels);
     }
 }
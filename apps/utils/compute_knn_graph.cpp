@@ -0,0 +1,179 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <fstream>
+#include <boost/program_options.hpp>
+
+#include "utils.h"
+#include "index.h"
+#include "index_factory.h"
+#include "pq_flash_index.h"
+#include "program_options_utils.hpp"
+#include "timer.h"
+
+#ifdef _WINDOWS
+#include "windows_aligned_file_reader.h"
+#else
+#include "linux_aligned_file_reader.h"
+#endif
+
+namespace po = boost::program_options;
+
+// writes the graph as compute_groundtruth writes a truthset: the number of
+// points and K as int32, then the ids and then the distances, K per point
+static void save_knn_graph(const std::string &output_file, const uint32_t *ids, const float *dists,
+                           const size_t num_points, const size_t K)
+{
+    std::ofstream writer(output_file, std::ios::binary | std::ios::out);
+    const int npts_i32 = (int)num_points, K_i32 = (int)K;
+    writer.write((char *)&npts_i32, sizeof(int));
+    writer.write((char *)&K_i32, sizeof(int));
+    writer.write((char *)ids, num_points * K * sizeof(uint32_t));
+    writer.write((char *)dists, num_points * K * sizeof(float));
+    diskann::cout << "Wrote the " << K << " nearest neighbours of " << num_points << " points to " << output_file
+                  << std::endl;
+}
+
+template <typename T>
+int compute_knn_graph(const std::string &index_type, diskann::Metric metric, const std::string &index_path_prefix,
+                      const std::string &output_file, const uint32_t K, const uint32_t L, const uint32_t beamwidth,
+                      const uint32_t num_threads)
+{
+    std::vector<uint32_t> ids;
+    std::vector<float> dists;
+    size_t num_points;
+    diskann::Timer timer;
+    if (index_type == "disk")
+    {
+#ifdef _WINDOWS
+        std::shared_ptr<AlignedFileReader> reader(new WindowsAlignedFileReader());
+#else
+        std::shared_ptr<AlignedFileReader> reader(new LinuxAlignedFileReader());
+#endif
+        diskann::PQFlashIndex<T> index(reader, metric);
+        if (index.load(num_threads, index_path_prefix.c_str()) != 0)
+            throw diskann::ANNException("Could not load the index " + index_path_prefix, -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        num_points = index.knn_self_join(K, L, beamwidth, num_threads, ids, dists);
+    }
+    else
+    {
+        size_t dim;
+        diskann::get_bin_metadata(index_path_prefix + ".data", num_points, dim);
+        auto config = diskann::IndexConfigBuilder()
+                          .with_metric(metric)
+                          .with_dimension(dim)
+                          .with_max_points(0)
+                          .with_data_load_store_strategy(diskann::DataStoreStrategy::MEMORY)
+                          .with_graph_load_store_strategy(diskann::GraphStoreStrategy::MEMORY)
+                          .with_data_type(diskann_type_to_name<T>())
+                          .with_label_type(diskann_type_to_name<uint32_t>())
+                          .with_tag_type(diskann_type_to_name<uint32_t>())
+                          .is_dynamic_index(false)
+                          .is_enable_tags(false)
+                          .is_concurrent_consolidate(false)
+                          .is_pq_dist_build(false)
+                          .is_use_opq(false)
+                          .with_num_pq_chunks(0)
+                          .with_num_frozen_pts(diskann::get_graph_num_frozen_points(index_path_prefix))
+                          .build();
+        auto index = diskann::IndexFactory(config).create_typed_instance<T>();
+        index->load(index_path_prefix.c_str(), num_threads, L);
+        omp_set_num_threads(num_threads);
+
+        num_points = index->get_num_points();
+        ids.resize(num_points * K);
+        dists.resize(num_points * K);
+        index->knn_self_join(K, L, ids.data(), dists.data());
+    }
+    diskann::cout << "Self-join took " << timer.elapsed_seconds() << "s" << std::endl;
+
+    save_knn_graph(output_file, ids.data(), dists.data(), num_points, K);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, dist_fn, index_type, index_path_prefix, output_file;
+    uint32_t K, L, beamwidth, num_threads;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "compute_knn_graph", "Writes the approximate K nearest neighbours of every point of an index")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+        desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                           program_options_utils::DATA_TYPE_DESCRIPTION);
+        desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                           program_options_utils::DISTANCE_FUNCTION_DESCRIPTION);
+        desc.add_options()("index_type", po::value<std::string>(&index_type)->default_value("memory"),
+                           "memory for an index of build_memory_index, disk for one of build_disk_index");
+        desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                           program_options_utils::INDEX_PATH_PREFIX_DESCRIPTION);
+        desc.add_options()("output_file", po::value<std::string>(&output_file)->required(),
+                           "The kNN graph, in the format of the ground truth files of compute_groundtruth");
+        desc.add_options()("K", po::value<uint32_t>(&K)->required(), "Neighbours per point");
+        desc.add_options()("search_list,L", po::value<uint32_t>(&L)->required(),
+                           "List size of the search for each point; more than K");
+        desc.add_options()("beamwidth,W", po::value<uint32_t>(&beamwidth)->default_value(2),
+                           "Nodes each search of a disk index reads at a time");
+        desc.add_options()("num_threads,T",
+                           po::value<uint32_t>(&num_threads)->default_value(omp_get_num_procs()),
+                           "Threads to search with; defaults to the number of logical cores");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    if (index_type != "memory" && index_type != "disk")
+    {
+        std::cerr << "index_type must be memory or disk" << std::endl;
+        return -1;
+    }
+    diskann::Metric metric;
+    if (dist_fn == std::string("l2"))
+        metric = diskann::Metric::L2;
+    else if (dist_fn == std::string("mips"))
+        metric = diskann::Metric::INNER_PRODUCT;
+    else if (dist_fn == std::string("cosine"))
+        metric = diskann::Metric::COSINE;
+    else if (dist_fn == std::string("hamming") && data_type == std::string("uint8"))
+        metric = diskann::Metric::HAMMING;
+    else
+    {
+        std::cerr << "Unsupported distance function. Use l2, mips or cosine, or hamming for uint8" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("int8"))
+            return compute_knn_graph<int8_t>(index_type, metric, index_path_prefix, output_file, K, L, beamwidth,
+                                             num_threads);
+        else if (data_type == std::string("uint8"))
+            return compute_knn_graph<uint8_t>(index_type, metric, index_path_prefix, output_file, K, L, beamwidth,
+                                              num_threads);
+        else if (data_type == std::string("float"))
+            return compute_knn_graph<float>(index_type, metric, index_path_prefix, output_file, K, L, beamwidth,
+                                            num_threads);
+        std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
+        return -1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        diskann::cerr << "Computing the kNN graph failed." << std::endl;
+        return -1;
+    }
+}
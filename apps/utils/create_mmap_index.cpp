@@ -0,0 +1,86 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <boost/program_options.hpp>
+
+#include "utils.h"
+#include "index_factory.h"
+#include "program_options_utils.hpp"
+
+namespace po = boost::program_options;
+
+// Rewrites the graph and data files of a saved in-memory index into the page
+// aligned layout that Index::load() maps in place when the index is configured
+// with DataStoreStrategy::MMAP and GraphStoreStrategy::MMAP. The tags, labels
+// and delete list of the index are used as they are.
+template <typename T> int create_mmap_index(const std::string &index_path_prefix)
+{
+    size_t npts, dim;
+    diskann::get_bin_metadata(index_path_prefix + ".data", npts, dim);
+
+    // the distance metric only affects how queries are preprocessed; the rows
+    // are stored as they were saved
+    auto data_store =
+        diskann::IndexFactory::construct_datastore<T>(diskann::DataStoreStrategy::MEMORY, npts, dim, diskann::L2);
+    auto num_points = data_store->load(index_path_prefix + ".data");
+    data_store->save_mmap(index_path_prefix + ".mmap.data", num_points);
+
+    auto graph_store = diskann::IndexFactory::construct_graphstore(diskann::GraphStoreStrategy::FLAT, npts, 0);
+    auto [nodes_read, start, num_frozen_pts] = graph_store->load(index_path_prefix, npts);
+    graph_store->store_mmap(index_path_prefix + ".mmap.graph", nodes_read, num_frozen_pts, start);
+
+    diskann::cout << "Wrote " << index_path_prefix << ".mmap.data and " << index_path_prefix << ".mmap.graph for "
+                  << nodes_read << " nodes" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, index_path_prefix;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "create_mmap_index", "Converts a saved in-memory index for memory-mapped loading")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+        desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                           program_options_utils::DATA_TYPE_DESCRIPTION);
+        desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                           program_options_utils::INDEX_PATH_PREFIX_DESCRIPTION);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("int8"))
+            return create_mmap_index<int8_t>(index_path_prefix);
+        else if (data_type == std::string("uint8"))
+            return create_mmap_index<uint8_t>(index_path_prefix);
+        else if (data_type == std::string("float"))
+            return create_mmap_index<float>(index_path_prefix);
+        else
+        {
+            std::cerr << "Unsupported type. Use float/int8/uint8" << std::endl;
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << std::string(e.what()) << std::endl;
+        diskann::cerr << "Index conversion failed." << std::endl;
+        return -1;
+    }
+}
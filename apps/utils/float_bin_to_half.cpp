@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <iostream>
+#include "utils.h"
+
+template <typename T>
+void block_convert(std::ofstream &writer, T *write_buf, std::ifstream &reader, float *read_buf, size_t npts,
+                   size_t ndims)
+{
+    reader.read((char *)read_buf, npts * ndims * sizeof(float));
+
+    for (size_t i = 0; i < npts * ndims; i++)
+    {
+        write_buf[i] = T(read_buf[i]);
+    }
+    writer.write((char *)write_buf, npts * ndims * sizeof(T));
+}
+
+template <typename T> int convert(std::ifstream &reader, std::ofstream &writer, size_t npts, size_t ndims)
+{
+    size_t blk_size = 131072;
+    size_t nblks = ROUND_UP(npts, blk_size) / blk_size;
+
+    auto read_buf = new float[blk_size * ndims];
+    auto write_buf = new T[blk_size * ndims];
+
+    for (size_t i = 0; i < nblks; i++)
+    {
+        size_t cblk_size = std::min(npts - i * blk_size, blk_size);
+        block_convert(writer, write_buf, reader, read_buf, cblk_size, ndims);
+        std::cout << "Block #" << i << " written" << std::endl;
+    }
+
+    delete[] read_buf;
+    delete[] write_buf;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4 || (std::string(argv[1]) != "fp16" && std::string(argv[1]) != "bf16"))
+    {
+        std::cout << "Usage: " << argv[0] << "  <fp16/bf16>  input_float_bin  output_bin" << std::endl;
+        exit(-1);
+    }
+
+    std::ifstream reader(argv[2], std::ios::binary);
+    uint32_t npts_u32;
+    uint32_t ndims_u32;
+    reader.read((char *)&npts_u32, sizeof(uint32_t));
+    reader.read((char *)&ndims_u32, sizeof(uint32_t));
+    size_t npts = npts_u32;
+    size_t ndims = ndims_u32;
+    std::cout << "Dataset: #pts = " << npts << ", # dims = " << ndims << std::endl;
+
+    std::ofstream writer(argv[3], std::ios::binary);
+    writer.write((char *)(&npts_u32), sizeof(uint32_t));
+    writer.write((char *)(&ndims_u32), sizeof(uint32_t));
+
+    if (std::string(argv[1]) == "fp16")
+        convert<diskann::float16>(reader, writer, npts, ndims);
+    else
+        convert<diskann::bfloat16>(reader, writer, npts, ndims);
+
+    writer.close();
+    reader.close();
+}
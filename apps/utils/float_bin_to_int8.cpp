@@ -4,19 +4,16 @@
 #include <iostream>
 #include "utils.h"
 
-void block_convert(std::ofstream &writer, int8_t *write_buf, std::ifstream &reader, float *read_buf, size_t npts,
-                   size_t ndims, float bias, float scale)
+void block_convert(int8_t *write_buf, const float *read_buf, size_t npts, size_t ndims, float bias, float scale)
 {
-    reader.read((char *)read_buf, npts * ndims * sizeof(float));
-
-    for (size_t i = 0; i < npts; i++)
+#pragma omp parallel for schedule(static, 4096)
+    for (int64_t i = 0; i < (int64_t)npts; i++)
     {
         for (size_t d = 0; d < ndims; d++)
         {
             write_buf[d + i * ndims] = (int8_t)((read_buf[d + i * ndims] - bias) * (254.0 / scale));
         }
     }
-    writer.write((char *)write_buf, npts * ndims);
 }
 
 int main(int argc, char **argv)
@@ -32,6 +29,7 @@ int main(int argc, char **argv)
     uint32_t ndims_u32;
     reader.read((char *)&npts_u32, sizeof(uint32_t));
     reader.read((char *)&ndims_u32, sizeof(uint32_t));
+    reader.close();
     size_t npts = npts_u32;
     size_t ndims = ndims_u32;
     std::cout << "Dataset: #pts = " << npts << ", # dims = " << ndims << std::endl;
@@ -47,17 +45,20 @@ int main(int argc, char **argv)
 
     writer.write((char *)(&npts_u32), sizeof(uint32_t));
     writer.write((char *)(&ndims_u32), sizeof(uint32_t));
+    writer.close();
 
+    // both files are streamed once, so they bypass the page cache
     for (size_t i = 0; i < nblks; i++)
     {
         size_t cblk_size = std::min(npts - i * blk_size, blk_size);
-        block_convert(writer, write_buf, reader, read_buf, cblk_size, ndims, bias, scale);
+        read_file_parallel(argv[1], (char *)read_buf, 2 * sizeof(uint32_t) + i * blk_size * ndims * sizeof(float),
+                           cblk_size * ndims * sizeof(float), 0, true);
+        block_convert(write_buf, read_buf, cblk_size, ndims, bias, scale);
+        write_file_parallel(argv[2], (char *)write_buf, 2 * sizeof(uint32_t) + i * blk_size * ndims,
+                            cblk_size * ndims, 0, true);
         std::cout << "Block #" << i << " written" << std::endl;
     }
 
     delete[] read_buf;
     delete[] write_buf;
-
-    writer.close();
-    reader.close();
 }
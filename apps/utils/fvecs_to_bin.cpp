@@ -4,29 +4,16 @@
 #include <iostream>
 #include "utils.h"
 
-// Convert float types
-void block_convert_float(std::ifstream &reader, std::ofstream &writer, float *read_buf, float *write_buf, size_t npts,
-                         size_t ndims)
+// Drops the dimension before each vector of a block of npts vectors of
+// datasize bytes per coordinate
+void block_convert(const uint8_t *read_buf, uint8_t *write_buf, size_t npts, size_t ndims, size_t datasize)
 {
-    reader.read((char *)read_buf, npts * (ndims * sizeof(float) + sizeof(uint32_t)));
-    for (size_t i = 0; i < npts; i++)
+    const size_t in_row = ndims * datasize + sizeof(uint32_t);
+#pragma omp parallel for schedule(static, 4096)
+    for (int64_t i = 0; i < (int64_t)npts; i++)
     {
-        memcpy(write_buf + i * ndims, (read_buf + i * (ndims + 1)) + 1, ndims * sizeof(float));
+        memcpy(write_buf + i * ndims * datasize, read_buf + i * in_row + sizeof(uint32_t), ndims * datasize);
     }
-    writer.write((char *)write_buf, npts * ndims * sizeof(float));
-}
-
-// Convert byte types
-void block_convert_byte(std::ifstream &reader, std::ofstream &writer, uint8_t *read_buf, uint8_t *write_buf,
-                        size_t npts, size_t ndims)
-{
-    reader.read((char *)read_buf, npts * (ndims * sizeof(uint8_t) + sizeof(uint32_t)));
-    for (size_t i = 0; i < npts; i++)
-    {
-        memcpy(write_buf + i * ndims, (read_buf + i * (ndims + sizeof(uint32_t))) + sizeof(uint32_t),
-               ndims * sizeof(uint8_t));
-    }
-    writer.write((char *)write_buf, npts * ndims * sizeof(uint8_t));
 }
 
 int main(int argc, char **argv)
@@ -55,9 +42,10 @@ int main(int argc, char **argv)
 
     uint32_t ndims_u32;
     reader.read((char *)&ndims_u32, sizeof(uint32_t));
-    reader.seekg(0, std::ios::beg);
+    reader.close();
     size_t ndims = (size_t)ndims_u32;
-    size_t npts = fsize / ((ndims * datasize) + sizeof(uint32_t));
+    size_t in_row = (ndims * datasize) + sizeof(uint32_t);
+    size_t npts = fsize / in_row;
     std::cout << "Dataset: #pts = " << npts << ", # dims = " << ndims << std::endl;
 
     size_t blk_size = 131072;
@@ -68,28 +56,23 @@ int main(int argc, char **argv)
     int32_t ndims_s32 = (int32_t)ndims;
     writer.write((char *)&npts_s32, sizeof(int32_t));
     writer.write((char *)&ndims_s32, sizeof(int32_t));
+    writer.close();
 
+    // both files are streamed once, so they bypass the page cache
     size_t chunknpts = std::min(npts, blk_size);
-    uint8_t *read_buf = new uint8_t[chunknpts * ((ndims * datasize) + sizeof(uint32_t))];
+    uint8_t *read_buf = new uint8_t[chunknpts * in_row];
     uint8_t *write_buf = new uint8_t[chunknpts * ndims * datasize];
 
     for (size_t i = 0; i < nblks; i++)
     {
         size_t cblk_size = std::min(npts - i * blk_size, blk_size);
-        if (datasize == sizeof(float))
-        {
-            block_convert_float(reader, writer, (float *)read_buf, (float *)write_buf, cblk_size, ndims);
-        }
-        else
-        {
-            block_convert_byte(reader, writer, read_buf, write_buf, cblk_size, ndims);
-        }
+        read_file_parallel(argv[2], (char *)read_buf, i * blk_size * in_row, cblk_size * in_row, 0, true);
+        block_convert(read_buf, write_buf, cblk_size, ndims, datasize);
+        write_file_parallel(argv[3], (char *)write_buf, 2 * sizeof(int32_t) + i * blk_size * ndims * datasize,
+                            cblk_size * ndims * datasize, 0, true);
         std::cout << "Block #" << i << " written" << std::endl;
     }
 
     delete[] read_buf;
     delete[] write_buf;
-
-    reader.close();
-    writer.close();
 }
@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "rabitq_distance.h"
+#include "utils.h"
+
+template <typename T> void generate_rabitq(const std::string &data_path, const std::string &index_prefix_path)
+{
+    diskann::RaBitQDistance<T> quantizer;
+    diskann::generate_rabitq_data<T>(data_path, quantizer.get_pivot_data_filename(index_prefix_path),
+                                     quantizer.get_quantized_vectors_filename(index_prefix_path));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4)
+    {
+        std::cout << "Usage: \n"
+                  << argv[0]
+                  << "  <data_type[float/uint8/int8]>  <data_file[.bin]>  <index_prefix_path>\n"
+                     "Writes the RaBitQ codes of the points that search_disk_index --rabitq scores "
+                     "candidates with. data_file must be the base file of the index."
+                  << std::endl;
+        return -1;
+    }
+    const std::string data_path(argv[2]);
+    const std::string index_prefix_path(argv[3]);
+    if (std::string(argv[1]) == std::string("float"))
+        generate_rabitq<float>(data_path, index_prefix_path);
+    else if (std::string(argv[1]) == std::string("int8"))
+        generate_rabitq<int8_t>(data_path, index_prefix_path);
+    else if (std::string(argv[1]) == std::string("uint8"))
+        generate_rabitq<uint8_t>(data_path, index_prefix_path);
+    else
+    {
+        std::cout << "Error. wrong file type" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdio>
+#include <boost/program_options.hpp>
+
+#include "utils.h"
+#include "disk_utils.h"
+#include "program_options_utils.hpp"
+
+namespace po = boost::program_options;
+
+// Reads the graph back from the disk index at index_path_prefix, reports its
+// weakly reachable nodes and, unless analyse_only, adds edges to them and
+// writes the disk layout again
+template <typename T>
+int repair_graph(const std::string &index_path_prefix, const uint32_t min_in_degree, const uint32_t max_hops,
+                 uint32_t max_degree, const uint32_t L, const bool analyse_only)
+{
+    const std::string disk_index_path = index_path_prefix + "_disk.index";
+    const std::string mem_index_path = index_path_prefix + "_repair_mem.index";
+    const std::string data_path = mem_index_path + ".data";
+    if (file_exists(disk_index_path + ".stripes"))
+        diskann::cout << "The disk index is striped; stripe it again after the repair" << std::endl;
+
+    const std::vector<uint64_t> meta = diskann::load_disk_index_metadata(disk_index_path);
+    if (max_degree == 0)
+    {
+        // the width of the nodes on disk, so that the layout keeps its size
+        max_degree = (uint32_t)((meta[3] - meta[1] * sizeof(T)) / sizeof(uint32_t) - 1);
+    }
+
+    diskann::disk_index_to_mem_index<T>(disk_index_path, mem_index_path);
+    const uint64_t num_added = diskann::repair_graph_connectivity<T>(
+        mem_index_path, data_path, disk_index_path + "_medoids.bin", min_in_degree, max_hops, max_degree, L,
+        !analyse_only);
+    if (num_added > 0)
+    {
+        diskann::create_disk_layout<T>(data_path, mem_index_path, disk_index_path, "", false, "",
+                                       diskann::get_disk_sector_len(meta));
+    }
+    std::remove(mem_index_path.c_str());
+    std::remove(data_path.c_str());
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string data_type, index_path_prefix;
+    uint32_t min_in_degree, max_hops, max_degree, L;
+    bool analyse_only = false;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "repair_graph", "Adds edges to the weakly reachable nodes of a disk index graph")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+        desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                           program_options_utils::DATA_TYPE_DESCRIPTION);
+        desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                           program_options_utils::INDEX_PATH_PREFIX_DESCRIPTION);
+        desc.add_options()("min_in_degree", po::value<uint32_t>(&min_in_degree)->default_value(2),
+                           "Nodes with fewer in-edges get more");
+        desc.add_options()("max_hops", po::value<uint32_t>(&max_hops)->default_value(8),
+                           "Nodes more hops than this from the medoids get an edge from a node closer to them");
+        desc.add_options()("max_degree", po::value<uint32_t>(&max_degree)->default_value(0),
+                           "Neighbors a node may have after the repair; 0 for the width of the nodes on disk");
+        desc.add_options()("search_list,L", po::value<uint32_t>(&L)->default_value(64),
+                           "List size of the searches for the nodes to add edges from");
+        desc.add_options()("analyse_only", po::bool_switch(&analyse_only)->default_value(false),
+                           "Only report the weakly reachable nodes");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    try
+    {
+        if (data_type == std::string("int8"))
+            return repair_graph<int8_t>(index_path_prefix, min_in_degree, max_hops, max_degree, L, analyse_only);
+        else if (data_type == std::string("uint8"))
+            return repair_graph<uint8_t>(index_path_prefix, min_in_degree, max_hops, max_degree, L, analyse_only);
+        else if (data_type == std::string("float"))
+            return repair_graph<float>(index_path_prefix, min_in_degree, max_hops, max_degree, L, analyse_only);
+        std::cerr << "Unsupported data type. Use float or int8 or uint8" << std::endl;
+        return -1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        diskann::cerr << "Graph repair failed." << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,437 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+// Replays the access traces of search_disk_index --access_trace against node
+// caches of several policies and sizes, and reports the hit rate of each and
+// the reads per query left for SSD, to size the cache of a disk index and
+// pick its policy before buying the memory for it.
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "utils.h"
+#include "pq_flash_index.h"
+#include "program_options_utils.hpp"
+
+#ifdef _WINDOWS
+#include "windows_aligned_file_reader.h"
+#else
+#include "linux_aligned_file_reader.h"
+#endif
+
+namespace po = boost::program_options;
+
+// the nodes expanded by the queries of a trace
+struct AccessTrace
+{
+    uint64_t header[diskann::TRACE_NUM_FIELDS];
+    // the nodes of all queries, in order; query q expanded
+    // nodes[offsets[q]] to nodes[offsets[q + 1] - 1]
+    std::vector<uint32_t> nodes;
+    std::vector<uint64_t> offsets;
+
+    uint64_t num_queries() const
+    {
+        return offsets.size() - 1;
+    }
+};
+
+void load_trace(const std::string &filename, AccessTrace &trace)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open())
+        throw diskann::ANNException("Could not open access trace " + filename, -1, __FUNCSIG__, __FILE__, __LINE__);
+    in.seekg(0, std::ios::end);
+    const uint64_t file_size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (file_size < sizeof(trace.header))
+        throw diskann::ANNException("Access trace " + filename + " is truncated", -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    in.read((char *)trace.header, sizeof(trace.header));
+
+    // the ids and counts are all uint32_t, so this bounds the nodes
+    trace.nodes.reserve((file_size - sizeof(trace.header)) / sizeof(uint32_t));
+    trace.offsets.assign(1, 0);
+    uint32_t count;
+    while (in.read((char *)&count, sizeof(count)))
+    {
+        const uint64_t begin = trace.nodes.size();
+        trace.nodes.resize(begin + count);
+        if (!in.read((char *)(trace.nodes.data() + begin), count * sizeof(uint32_t)))
+            throw diskann::ANNException("Access trace " + filename + " is truncated", -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        trace.offsets.push_back(trace.nodes.size());
+    }
+    for (auto node : trace.nodes)
+    {
+        if (node >= trace.header[diskann::TRACE_NUM_POINTS])
+            throw diskann::ANNException("Access trace " + filename + " has a node id out of range", -1, __FUNCSIG__,
+                                        __FILE__, __LINE__);
+    }
+}
+
+// What a cache entry holds: a node, or with sector_mode the sectors of the
+// nodes that share them, as set_sector_cache_mode() caches them.
+struct CacheGeometry
+{
+    bool sector_mode;
+    uint64_t nnodes_per_sector;
+    uint64_t entry_bytes;
+
+    CacheGeometry(const AccessTrace &trace, bool sector_mode)
+        : sector_mode(sector_mode), nnodes_per_sector(trace.header[diskann::TRACE_NNODES_PER_SECTOR])
+    {
+        entry_bytes = sector_mode
+                          ? trace.header[diskann::TRACE_SECTORS_PER_NODE] * trace.header[diskann::TRACE_SECTOR_LEN]
+                          : trace.header[diskann::TRACE_MAX_NODE_LEN];
+    }
+
+    uint32_t key(uint32_t node) const
+    {
+        return sector_mode && nnodes_per_sector > 0 ? (uint32_t)(node / nnodes_per_sector) : node;
+    }
+
+    // the distinct keys of nodes, in the order they first appear
+    std::vector<uint32_t> keys(const std::vector<uint32_t> &nodes) const
+    {
+        std::vector<uint32_t> result;
+        std::unordered_set<uint32_t> seen;
+        for (auto node : nodes)
+        {
+            if (seen.insert(key(node)).second)
+                result.push_back(key(node));
+        }
+        return result;
+    }
+};
+
+// evicts the entry used least recently
+class LRUCache
+{
+  public:
+    explicit LRUCache(uint64_t capacity) : _capacity(capacity)
+    {
+    }
+
+    bool access(uint32_t key)
+    {
+        auto iter = _entries.find(key);
+        if (iter != _entries.end())
+        {
+            _order.splice(_order.begin(), _order, iter->second);
+            return true;
+        }
+        if (_capacity == 0)
+            return false;
+        if (_entries.size() == _capacity)
+        {
+            _entries.erase(_order.back());
+            _order.pop_back();
+        }
+        _order.push_front(key);
+        _entries[key] = _order.begin();
+        return false;
+    }
+
+  private:
+    uint64_t _capacity;
+    // most recent first
+    std::list<uint32_t> _order;
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> _entries;
+};
+
+// evicts the entry used least often since it was cached, the least recently
+// used of those on a tie
+class LFUCache
+{
+  public:
+    explicit LFUCache(uint64_t capacity) : _capacity(capacity)
+    {
+    }
+
+    bool access(uint32_t key)
+    {
+        _tick++;
+        auto iter = _entries.find(key);
+        if (iter != _entries.end())
+        {
+            _order.erase(std::make_tuple(iter->second.first, iter->second.second, key));
+            iter->second = std::make_pair(iter->second.first + 1, _tick);
+            _order.insert(std::make_tuple(iter->second.first, _tick, key));
+            return true;
+        }
+        if (_capacity == 0)
+            return false;
+        if (_entries.size() == _capacity)
+        {
+            _entries.erase(std::get<2>(*_order.begin()));
+            _order.erase(_order.begin());
+        }
+        _entries[key] = std::make_pair((uint64_t)1, _tick);
+        _order.insert(std::make_tuple((uint64_t)1, _tick, key));
+        return false;
+    }
+
+  private:
+    uint64_t _capacity;
+    uint64_t _tick = 0;
+    // (uses, last use, key), the next to evict first
+    std::set<std::tuple<uint64_t, uint64_t, uint32_t>> _order;
+    // key -> (uses, last use)
+    std::unordered_map<uint32_t, std::pair<uint64_t, uint64_t>> _entries;
+};
+
+// holds the first capacity keys of a list fixed up front, as load_cache_list()
+// does
+class StaticCache
+{
+  public:
+    StaticCache(const std::vector<uint32_t> &keys, uint64_t capacity)
+    {
+        const uint64_t size = (std::min)((uint64_t)keys.size(), capacity);
+        for (uint64_t i = 0; i < size; i++)
+            _entries.insert(keys[i]);
+    }
+
+    bool access(uint32_t key)
+    {
+        return _entries.find(key) != _entries.end();
+    }
+
+  private:
+    std::unordered_set<uint32_t> _entries;
+};
+
+template <typename CacheT> uint64_t count_hits(const AccessTrace &trace, const CacheGeometry &geometry, CacheT &cache)
+{
+    uint64_t hits = 0;
+    for (auto node : trace.nodes)
+        hits += cache.access(geometry.key(node)) ? 1 : 0;
+    return hits;
+}
+
+// the keys of the nodes of a trace, most accessed first
+std::vector<uint32_t> rank_by_accesses(const AccessTrace &trace, const CacheGeometry &geometry)
+{
+    std::unordered_map<uint32_t, uint64_t> counts;
+    for (auto node : trace.nodes)
+        counts[geometry.key(node)]++;
+    std::vector<std::pair<uint64_t, uint32_t>> ranked;
+    ranked.reserve(counts.size());
+    for (auto &entry : counts)
+        ranked.emplace_back(entry.second, entry.first);
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    std::vector<uint32_t> keys(ranked.size());
+    for (size_t i = 0; i < ranked.size(); i++)
+        keys[i] = ranked[i].second;
+    return keys;
+}
+
+// the nodes search_disk_index caches with --num_nodes_to_cache num_nodes, in
+// the order cache_bfs_levels() picks them
+template <typename T>
+std::vector<uint32_t> bfs_nodes(const std::string &index_path_prefix, const AccessTrace &trace, uint64_t num_nodes)
+{
+#ifdef _WINDOWS
+    std::shared_ptr<AlignedFileReader> reader(new WindowsAlignedFileReader());
+#else
+    std::shared_ptr<AlignedFileReader> reader(new LinuxAlignedFileReader());
+#endif
+    // the metric does not change the graph that is walked
+    diskann::PQFlashIndex<T> index(reader, diskann::Metric::L2);
+    // cache_bfs_levels() holds a search scratch while read_nodes() borrows
+    // another
+    if (index.load(2, index_path_prefix.c_str()) != 0)
+        throw diskann::ANNException("Could not load the index " + index_path_prefix, -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    if (index.get_num_points() != trace.header[diskann::TRACE_NUM_POINTS])
+        throw diskann::ANNException("The access trace was not recorded on " + index_path_prefix, -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+    std::vector<uint32_t> node_list;
+    index.cache_bfs_levels(num_nodes, node_list);
+    return node_list;
+}
+
+int simulate_cache(const std::string &trace_file, const std::string &sample_trace_file,
+                   const std::vector<double> &cache_sizes_mb, const std::vector<std::string> &policies,
+                   const bool sector_mode, const std::string &index_path_prefix, const std::string &data_type)
+{
+    AccessTrace trace;
+    load_trace(trace_file, trace);
+    const uint64_t num_queries = trace.num_queries();
+    if (num_queries == 0)
+    {
+        diskann::cerr << "The access trace " << trace_file << " has no queries" << std::endl;
+        return -1;
+    }
+    const CacheGeometry geometry(trace, sector_mode);
+
+    std::vector<uint64_t> capacities;
+    for (auto mb : cache_sizes_mb)
+        capacities.push_back((uint64_t)(mb * 1024 * 1024 / geometry.entry_bytes));
+    const uint64_t max_capacity = *std::max_element(capacities.begin(), capacities.end());
+
+    // the static caches rank the keys once, and take a prefix for each size
+    std::vector<uint32_t> sample_keys, bfs_keys;
+    for (auto &policy : policies)
+    {
+        if (policy == "sample" && sample_trace_file.empty())
+        {
+            diskann::cout << "No --sample_trace_file: the sample policy ranks the nodes by the accesses of the "
+                             "trace itself, a bound no sample can beat"
+                          << std::endl;
+            sample_keys = rank_by_accesses(trace, geometry);
+        }
+        else if (policy == "sample")
+        {
+            AccessTrace sample;
+            load_trace(sample_trace_file, sample);
+            if (!std::equal(sample.header, sample.header + diskann::TRACE_NUM_FIELDS, trace.header))
+                throw diskann::ANNException("The sample trace was recorded on another index", -1, __FUNCSIG__,
+                                            __FILE__, __LINE__);
+            sample_keys = rank_by_accesses(sample, geometry);
+        }
+        else if (policy == "bfs")
+        {
+            const uint64_t num_nodes =
+                sector_mode && geometry.nnodes_per_sector > 0 ? max_capacity * geometry.nnodes_per_sector
+                                                              : max_capacity;
+            std::vector<uint32_t> nodes;
+            if (data_type == "float")
+                nodes = bfs_nodes<float>(index_path_prefix, trace, num_nodes);
+            else if (data_type == "int8")
+                nodes = bfs_nodes<int8_t>(index_path_prefix, trace, num_nodes);
+            else if (data_type == "uint8")
+                nodes = bfs_nodes<uint8_t>(index_path_prefix, trace, num_nodes);
+            else
+                throw diskann::ANNException("The bfs policy needs --data_type int8/uint8/float", -1, __FUNCSIG__,
+                                            __FILE__, __LINE__);
+            bfs_keys = geometry.keys(nodes);
+            if (bfs_keys.size() < max_capacity)
+                diskann::cout << "cache_bfs_levels() caches at most 10% of the points, so the bfs caches hold at "
+                                 "most "
+                              << bfs_keys.size() << " entries" << std::endl;
+        }
+        else if (policy != "lru" && policy != "lfu")
+        {
+            throw diskann::ANNException("Unknown cache policy " + policy + ", use lru/lfu/bfs/sample", -1,
+                                        __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+
+    diskann::cout << num_queries << " queries expanded " << (double)trace.nodes.size() / num_queries
+                  << " nodes each; a cache entry holds " << (sector_mode ? "the sectors of a node" : "a node")
+                  << " in " << geometry.entry_bytes << " bytes" << std::endl;
+
+    diskann::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    diskann::cout.precision(2);
+    diskann::cout << std::setw(12) << "Cache (MB)" << std::setw(12) << "Entries";
+    for (auto &policy : policies)
+        diskann::cout << std::setw(14) << (policy + " hit%") << std::setw(14) << (policy + " I/Os/q");
+    diskann::cout << std::endl;
+
+    for (size_t s = 0; s < capacities.size(); s++)
+    {
+        diskann::cout << std::setw(12) << cache_sizes_mb[s] << std::setw(12) << capacities[s];
+        for (auto &policy : policies)
+        {
+            uint64_t hits;
+            if (policy == "lru")
+            {
+                LRUCache cache(capacities[s]);
+                hits = count_hits(trace, geometry, cache);
+            }
+            else if (policy == "lfu")
+            {
+                LFUCache cache(capacities[s]);
+                hits = count_hits(trace, geometry, cache);
+            }
+            else
+            {
+                StaticCache cache(policy == "bfs" ? bfs_keys : sample_keys, capacities[s]);
+                hits = count_hits(trace, geometry, cache);
+            }
+            const uint64_t misses = trace.nodes.size() - hits;
+            diskann::cout << std::setw(14) << (trace.nodes.empty() ? 0.0 : 100.0 * hits / trace.nodes.size())
+                          << std::setw(14) << (double)misses / num_queries;
+        }
+        diskann::cout << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string trace_file, sample_trace_file, index_path_prefix, data_type;
+    std::vector<double> cache_sizes_mb;
+    std::vector<std::string> policies;
+    bool sector_mode = false;
+
+    po::options_description desc{"Arguments"};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+        desc.add_options()("trace_file", po::value<std::string>(&trace_file)->required(),
+                           "Access trace of search_disk_index --access_trace to replay");
+        desc.add_options()("cache_sizes_mb", po::value<std::vector<double>>(&cache_sizes_mb)->multitoken()->required(),
+                           "Cache sizes to simulate, in MB");
+        desc.add_options()("policies",
+                           po::value<std::vector<std::string>>(&policies)->multitoken()->default_value(
+                               std::vector<std::string>{"lru", "lfu", "sample"}, "lru lfu sample"),
+                           "Cache policies to simulate: lru and lfu, which are filled by the searches, and bfs and "
+                           "sample, which are fixed before them like --num_nodes_to_cache");
+        desc.add_options()("sample_trace_file", po::value<std::string>(&sample_trace_file)->default_value(""),
+                           "Access trace of sample queries; the sample policy caches the nodes they expanded most. "
+                           "Without it, the nodes expanded most by --trace_file itself are cached");
+        desc.add_options()("sector_cache", po::bool_switch(&sector_mode)->default_value(false),
+                           "Cache the sectors of the nodes, as search_disk_index --sector_cache does, so a hit on "
+                           "a node also serves the other nodes of its sector");
+        desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->default_value(""),
+                           "Path prefix of the index the trace was recorded on, for the bfs policy");
+        desc.add_options()("data_type", po::value<std::string>(&data_type)->default_value(""),
+                           program_options_utils::DATA_TYPE_DESCRIPTION);
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    if (std::find(policies.begin(), policies.end(), "bfs") != policies.end() && index_path_prefix.empty())
+    {
+        std::cerr << "The bfs policy needs --index_path_prefix and --data_type" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        return simulate_cache(trace_file, sample_trace_file, cache_sizes_mb, policies, sector_mode,
+                              index_path_prefix, data_type);
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << std::string(e.what()) << std::endl;
+        diskann::cerr << "Cache simulation failed." << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <boost/program_options.hpp>
+
+#include "striped_aligned_file_reader.h"
+#include "program_options_utils.hpp"
+
+namespace po = boost::program_options;
+
+// Splits the _disk.index file written by create_disk_layout() into stripes,
+// one per drive, which search_disk_index then reads in parallel.
+int main(int argc, char **argv)
+{
+    std::string disk_index_file;
+    std::vector<std::string> stripe_files;
+    uint64_t stripe_sectors;
+    bool truncate_original = false;
+
+    po::options_description desc{program_options_utils::make_program_description(
+        "stripe_disk_index", "Stripes a disk index over several files, one per NVMe drive")};
+    try
+    {
+        desc.add_options()("help,h", "Print information on arguments");
+        desc.add_options()("disk_index_file", po::value<std::string>(&disk_index_file)->required(),
+                           "The <index_path_prefix>_disk.index file to stripe");
+        desc.add_options()("stripe_files", po::value<std::vector<std::string>>(&stripe_files)->multitoken()->required(),
+                           "Files to write the stripes to, each on a different drive");
+        desc.add_options()("stripe_sectors",
+                           po::value<uint64_t>(&stripe_sectors)->default_value(diskann::defaults::STRIPE_SECTORS),
+                           "4 KB sectors per stripe unit");
+        desc.add_options()("truncate_original", po::bool_switch(&truncate_original)->default_value(false),
+                           "Cut the disk index file down to its first sector, the only part still read from it");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    try
+    {
+        StripedAlignedFileReader::stripe_file(disk_index_file, stripe_files, stripe_sectors, truncate_original);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
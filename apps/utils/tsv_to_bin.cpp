@@ -4,64 +4,105 @@
 #include <iostream>
 #include "utils.h"
 
-void block_convert_float(std::ifstream &reader, std::ofstream &writer, size_t npts, size_t ndims)
-{
-    auto read_buf = new float[npts * (ndims + 1)];
-
-    auto cursor = read_buf;
-    float val;
+// the input is read and parsed this many bytes at a time
+#define TSV_WINDOW_SIZE (64 * 1024 * 1024)
 
-    for (size_t i = 0; i < npts; i++)
+// Parses the ndims values of a line that ends at line_end into out, and
+// returns false if it has fewer
+template <typename T> bool parse_line(const char *line, const char *line_end, T *out, size_t ndims)
+{
+    char *next;
+    for (size_t d = 0; d < ndims; d++)
     {
-        for (size_t d = 0; d < ndims; ++d)
-        {
-            reader >> val;
-            *cursor = val;
-            cursor++;
-        }
+        if (std::is_floating_point<T>::value)
+            out[d] = (T)strtof(line, &next);
+        else
+            out[d] = (T)strtol(line, &next, 10);
+        if (next == line || next > line_end)
+            return false;
+        line = next;
     }
-    writer.write((char *)read_buf, npts * ndims * sizeof(float));
-    delete[] read_buf;
+    return true;
 }
 
-void block_convert_int8(std::ifstream &reader, std::ofstream &writer, size_t npts, size_t ndims)
+// Converts the first npts lines of the text file in_file into the bin file
+// out_file. The text is read a window at a time, and the lines of a window are
+// parsed by all threads.
+template <typename T> void convert(const std::string &in_file, const std::string &out_file, size_t npts, size_t ndims)
 {
-    auto read_buf = new int8_t[npts * (ndims + 1)];
+    std::ofstream writer(out_file, std::ios::binary);
+    auto npts_u32 = (uint32_t)npts;
+    auto ndims_u32 = (uint32_t)ndims;
+    writer.write((char *)&npts_u32, sizeof(uint32_t));
+    writer.write((char *)&ndims_u32, sizeof(uint32_t));
+    writer.close();
 
-    auto cursor = read_buf;
-    int val;
+    const size_t in_size = get_file_size(in_file);
+    // the unfinished line of the previous window, then the window, then a
+    // terminator for strtof
+    std::vector<char> text;
+    size_t carry = 0, in_off = 0, pts_done = 0;
+    std::vector<size_t> line_starts, line_ends;
+    std::vector<T> block;
 
-    for (size_t i = 0; i < npts; i++)
+    while (pts_done < npts && in_off < in_size)
     {
-        for (size_t d = 0; d < ndims; ++d)
+        const size_t bytes = std::min((size_t)TSV_WINDOW_SIZE, in_size - in_off);
+        text.resize(carry + bytes + 1);
+        read_file_parallel(in_file, text.data() + carry, in_off, bytes, 0, true);
+        in_off += bytes;
+        const size_t len = carry + bytes;
+        text[len] = '\0';
+
+        // lines end at a newline, or at the end of the file; blank ones are
+        // skipped
+        line_starts.clear();
+        line_ends.clear();
+        size_t line_start = 0;
+        while (line_start < len && pts_done + line_starts.size() < npts)
         {
-            reader >> val;
-            *cursor = (int8_t)val;
-            cursor++;
+            const char *newline = (const char *)memchr(text.data() + line_start, '\n', len - line_start);
+            if (newline == nullptr && in_off < in_size)
+                break;
+            const size_t line_end = newline == nullptr ? len : newline - text.data();
+            for (size_t c = line_start; c < line_end; c++)
+            {
+                if (!isspace((unsigned char)text[c]))
+                {
+                    line_starts.push_back(line_start);
+                    line_ends.push_back(line_end);
+                    break;
+                }
+            }
+            line_start = line_end + 1;
         }
-    }
-    writer.write((char *)read_buf, npts * ndims * sizeof(uint8_t));
-    delete[] read_buf;
-}
-
-void block_convert_uint8(std::ifstream &reader, std::ofstream &writer, size_t npts, size_t ndims)
-{
-    auto read_buf = new uint8_t[npts * (ndims + 1)];
 
-    auto cursor = read_buf;
-    int val;
-
-    for (size_t i = 0; i < npts; i++)
-    {
-        for (size_t d = 0; d < ndims; ++d)
+        const int64_t nlines = (int64_t)line_starts.size();
+        block.resize(nlines * ndims);
+        std::atomic<bool> short_line(false);
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int64_t l = 0; l < nlines; l++)
         {
-            reader >> val;
-            *cursor = (uint8_t)val;
-            cursor++;
+            if (!parse_line(text.data() + line_starts[l], text.data() + line_ends[l], block.data() + l * ndims, ndims))
+                short_line = true;
         }
+        if (short_line)
+            throw diskann::ANNException("A line of " + in_file + " has fewer than " + std::to_string(ndims) +
+                                            " values",
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+
+        write_file_parallel(out_file, (const char *)block.data(), 2 * sizeof(uint32_t) + pts_done * ndims * sizeof(T),
+                            nlines * ndims * sizeof(T), 0, true);
+        pts_done += nlines;
+        std::cout << pts_done << " points written" << std::endl;
+
+        carry = line_start < len ? len - line_start : 0;
+        memmove(text.data(), text.data() + len - carry, carry);
     }
-    writer.write((char *)read_buf, npts * ndims * sizeof(uint8_t));
-    delete[] read_buf;
+
+    if (pts_done < npts)
+        throw diskann::ANNException(in_file + " has only " + std::to_string(pts_done) + " points", -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
 }
 
 int main(int argc, char **argv)
@@ -84,38 +125,24 @@ int main(int argc, char **argv)
     size_t ndims = atoi(argv[4]);
     size_t npts = atoi(argv[5]);
 
-    std::ifstream reader(argv[2], std::ios::binary | std::ios::ate);
-    //  size_t          fsize = reader.tellg();
-    reader.seekg(0, std::ios::beg);
-    reader.seekg(0, std::ios::beg);
-
-    size_t blk_size = 131072;
-    size_t nblks = ROUND_UP(npts, blk_size) / blk_size;
-    std::cout << "# blks: " << nblks << std::endl;
-    std::ofstream writer(argv[3], std::ios::binary);
-    auto npts_u32 = (uint32_t)npts;
-    auto ndims_u32 = (uint32_t)ndims;
-    writer.write((char *)&npts_u32, sizeof(uint32_t));
-    writer.write((char *)&ndims_u32, sizeof(uint32_t));
-
-    for (size_t i = 0; i < nblks; i++)
+    try
     {
-        size_t cblk_size = std::min(npts - i * blk_size, blk_size);
         if (std::string(argv[1]) == std::string("float"))
         {
-            block_convert_float(reader, writer, cblk_size, ndims);
+            convert<float>(argv[2], argv[3], npts, ndims);
         }
         else if (std::string(argv[1]) == std::string("int8"))
         {
-            block_convert_int8(reader, writer, cblk_size, ndims);
+            convert<int8_t>(argv[2], argv[3], npts, ndims);
         }
         else if (std::string(argv[1]) == std::string("uint8"))
         {
-            block_convert_uint8(reader, writer, cblk_size, ndims);
+            convert<uint8_t>(argv[2], argv[3], npts, ndims);
         }
-        std::cout << "Block #" << i << " written" << std::endl;
     }
-
-    reader.close();
-    writer.close();
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
 }
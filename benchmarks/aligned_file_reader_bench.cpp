@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#ifndef _WINDOWS
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_utils.h"
+#include "linux_aligned_file_reader.h"
+#include "utils.h"
+#ifdef USE_IO_URING
+#include "io_uring_aligned_file_reader.h"
+#endif
+
+namespace
+{
+const uint64_t READ_SIZE = 4096;
+const uint64_t FILE_SIZE = 1ULL << 30;
+
+// The file to read: DISKANN_BENCH_READ_FILE if set, which should sit on the
+// SSD of interest and be at least FILE_SIZE bytes, or else a file of
+// FILE_SIZE bytes written to the temporary directory once per run
+const std::string &read_file()
+{
+    static const std::string path = [] {
+        const char *env = std::getenv("DISKANN_BENCH_READ_FILE");
+        if (env != nullptr)
+            return std::string(env);
+        const std::string temp_path = "/tmp/diskann_bench_read_file.bin";
+        std::ofstream out(temp_path, std::ios::binary);
+        const std::vector<uint8_t> block = diskann::bench::random_vector<uint8_t>(1 << 20);
+        for (uint64_t written = 0; written < FILE_SIZE; written += block.size())
+            out.write((const char *)block.data(), block.size());
+        return temp_path;
+    }();
+    return path;
+}
+
+// Batches of state.range(0) random READ_SIZE reads, the queue depth, issued
+// through one AlignedFileReader::read() call, as a beam of the disk search
+template <typename Reader> void BM_AlignedFileReaderRead(benchmark::State &state)
+{
+    const uint64_t depth = state.range(0);
+    std::unique_ptr<AlignedFileReader> reader(new Reader());
+    reader->open(read_file());
+    reader->register_thread();
+    IOContext &ctx = reader->get_ctx();
+
+    char *buf = nullptr;
+    diskann::alloc_aligned((void **)&buf, depth * READ_SIZE, READ_SIZE);
+    std::vector<uint64_t> blocks = diskann::bench::random_vector<uint64_t>(1 << 16);
+    std::vector<AlignedRead> reads(depth);
+    size_t next = 0;
+
+    for (auto _ : state)
+    {
+        for (uint64_t i = 0; i < depth; i++, next++)
+        {
+            const uint64_t offset = (blocks[next % blocks.size()] % (FILE_SIZE / READ_SIZE)) * READ_SIZE;
+            reads[i] = AlignedRead(offset, READ_SIZE, buf + i * READ_SIZE);
+        }
+        reader->read(reads, ctx);
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+    state.SetBytesProcessed(state.iterations() * depth * READ_SIZE);
+
+    reader->deregister_all_threads();
+    reader->close();
+    diskann::aligned_free(buf);
+}
+
+BENCHMARK_TEMPLATE(BM_AlignedFileReaderRead, LinuxAlignedFileReader)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(128)
+    ->UseRealTime();
+#ifdef USE_IO_URING
+BENCHMARK_TEMPLATE(BM_AlignedFileReaderRead, IoUringAlignedFileReader)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(128)
+    ->UseRealTime();
+#endif
+} // namespace
+
+#endif
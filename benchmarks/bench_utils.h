@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "half_precision.h"
+
+namespace diskann
+{
+namespace bench
+{
+// n random values of T from a fixed seed, so that every run of a benchmark
+// works on the same data: floats in [-1, 1), integers over their whole range
+template <typename T> std::vector<T> random_vector(size_t n, uint32_t seed = 42)
+{
+    std::mt19937 gen(seed);
+    std::vector<T> values(n);
+    if constexpr (std::is_integral<T>::value)
+    {
+        std::uniform_int_distribution<int64_t> dist((int64_t)std::numeric_limits<T>::min(),
+                                                    (int64_t)std::numeric_limits<T>::max());
+        for (auto &v : values)
+            v = (T)dist(gen);
+    }
+    else
+    {
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        for (auto &v : values)
+            v = T(dist(gen));
+    }
+    return values;
+}
+} // namespace bench
+} // namespace diskann
@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstring>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_utils.h"
+#include "in_mem_data_store.h"
+#include "utils.h"
+
+namespace
+{
+const uint32_t NUM_POINTS = 100000;
+
+// InMemDataStore::get_distance() from a query to a batch of state.range(1)
+// random points of a store of NUM_POINTS points of state.range(0) dimensions,
+// as in the expansion of a node during an in-memory search
+template <typename T, diskann::Metric M> void BM_DataStoreBatchDistance(benchmark::State &state)
+{
+    const size_t dim = state.range(0);
+    const uint32_t batch = (uint32_t)state.range(1);
+
+    diskann::InMemDataStore<T> store(NUM_POINTS, dim,
+                                     std::unique_ptr<diskann::Distance<T>>(diskann::get_distance_function<T>(M)));
+    store.populate_data(diskann::bench::random_vector<T>(NUM_POINTS * dim, 1).data(), NUM_POINTS);
+
+    // queries are padded to the aligned dimension, as the search scratch holds them
+    const size_t aligned_dim = store.get_aligned_dim();
+    T *query = nullptr;
+    diskann::alloc_aligned((void **)&query, aligned_dim * sizeof(T), 8 * sizeof(T));
+    std::memset((void *)query, 0, aligned_dim * sizeof(T));
+    const std::vector<T> query_values = diskann::bench::random_vector<T>(dim, 2);
+    std::memcpy((void *)query, query_values.data(), dim * sizeof(T));
+
+    std::vector<uint32_t> locations = diskann::bench::random_vector<uint32_t>(batch, 3);
+    for (auto &location : locations)
+        location %= NUM_POINTS;
+    std::vector<float> distances(batch);
+
+    for (auto _ : state)
+    {
+        store.get_distance(query, locations.data(), batch, distances.data(), nullptr);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    diskann::aligned_free(query);
+}
+
+BENCHMARK_TEMPLATE(BM_DataStoreBatchDistance, float, diskann::Metric::L2)
+    ->ArgsProduct({{100, 128, 768}, {32, 64, 128}});
+BENCHMARK_TEMPLATE(BM_DataStoreBatchDistance, float, diskann::Metric::INNER_PRODUCT)
+    ->ArgsProduct({{100, 128, 768}, {32, 64, 128}});
+BENCHMARK_TEMPLATE(BM_DataStoreBatchDistance, int8_t, diskann::Metric::L2)->ArgsProduct({{100, 128}, {32, 64, 128}});
+BENCHMARK_TEMPLATE(BM_DataStoreBatchDistance, uint8_t, diskann::Metric::L2)->ArgsProduct({{100, 128}, {32, 64, 128}});
+} // namespace
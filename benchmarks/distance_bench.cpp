@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_utils.h"
+#include "distance.h"
+
+namespace
+{
+// Distance<T>::compare between two vectors of state.range(0) elements, as
+// picked by get_distance_function() for this CPU
+template <typename T, diskann::Metric M> void BM_DistanceCompare(benchmark::State &state)
+{
+    const uint32_t dim = (uint32_t)state.range(0);
+    std::unique_ptr<diskann::Distance<T>> distance(diskann::get_distance_function<T>(M));
+    const std::vector<T> a = diskann::bench::random_vector<T>(dim, 1);
+    const std::vector<T> b = diskann::bench::random_vector<T>(dim, 2);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(distance->compare(a.data(), b.data(), dim));
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * 2 * dim * sizeof(T));
+}
+
+#define DISKANN_DISTANCE_BENCHMARK(T, M) BENCHMARK_TEMPLATE(BM_DistanceCompare, T, M)->Arg(96)->Arg(128)->Arg(768)
+
+DISKANN_DISTANCE_BENCHMARK(float, diskann::Metric::L2);
+DISKANN_DISTANCE_BENCHMARK(float, diskann::Metric::INNER_PRODUCT);
+DISKANN_DISTANCE_BENCHMARK(float, diskann::Metric::COSINE);
+DISKANN_DISTANCE_BENCHMARK(int8_t, diskann::Metric::L2);
+DISKANN_DISTANCE_BENCHMARK(int8_t, diskann::Metric::COSINE);
+DISKANN_DISTANCE_BENCHMARK(uint8_t, diskann::Metric::L2);
+DISKANN_DISTANCE_BENCHMARK(uint8_t, diskann::Metric::COSINE);
+DISKANN_DISTANCE_BENCHMARK(diskann::float16, diskann::Metric::L2);
+DISKANN_DISTANCE_BENCHMARK(diskann::float16, diskann::Metric::INNER_PRODUCT);
+DISKANN_DISTANCE_BENCHMARK(diskann::float16, diskann::Metric::COSINE);
+DISKANN_DISTANCE_BENCHMARK(diskann::bfloat16, diskann::Metric::L2);
+DISKANN_DISTANCE_BENCHMARK(diskann::bfloat16, diskann::Metric::INNER_PRODUCT);
+DISKANN_DISTANCE_BENCHMARK(diskann::bfloat16, diskann::Metric::COSINE);
+} // namespace
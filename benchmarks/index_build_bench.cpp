@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_utils.h"
+#include "index.h"
+
+namespace
+{
+const size_t NUM_POINTS = 10000;
+const size_t DIM = 128;
+const uint32_t L = 75;
+
+// Single threaded in-memory build of NUM_POINTS random points with degree
+// state.range(0) and alpha state.range(1) / 10. occlude_list() is private to
+// Index, so it is measured through the build, where it prunes the candidates
+// of every inserted point and of every neighbor that overflows its degree.
+void BM_IndexBuild(benchmark::State &state)
+{
+    const uint32_t degree = (uint32_t)state.range(0);
+    const float alpha = (float)state.range(1) / 10;
+    const std::vector<float> data = diskann::bench::random_vector<float>(NUM_POINTS * DIM);
+    auto write_params = std::make_shared<diskann::IndexWriteParameters>(
+        diskann::IndexWriteParametersBuilder(L, degree).with_alpha(alpha).with_num_threads(1).build());
+    auto search_params = std::make_shared<diskann::IndexSearchParams>(L, 1);
+
+    std::unique_ptr<diskann::Index<float>> index;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        index.reset();
+        index.reset(new diskann::Index<float>(diskann::Metric::L2, DIM, NUM_POINTS, write_params, search_params));
+        state.ResumeTiming();
+        index->build(data.data(), NUM_POINTS, std::vector<uint32_t>());
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_POINTS);
+}
+
+BENCHMARK(BM_IndexBuild)->ArgsProduct({{32, 64}, {10, 12}})->Unit(benchmark::kMillisecond)->Iterations(3);
+} // namespace
@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <benchmark/benchmark.h>
+
+#include "bench_utils.h"
+#include "neighbor.h"
+
+namespace
+{
+const size_t NUM_CANDIDATES = 4096;
+
+// Inserting NUM_CANDIDATES neighbors at random distances into a queue of
+// capacity state.range(0), the search list size L
+void BM_NeighborQueueInsert(benchmark::State &state)
+{
+    const size_t capacity = state.range(0);
+    const std::vector<float> distances = diskann::bench::random_vector<float>(NUM_CANDIDATES);
+    diskann::NeighborPriorityQueue queue(capacity);
+    for (auto _ : state)
+    {
+        queue.clear();
+        for (uint32_t i = 0; i < NUM_CANDIDATES; i++)
+            queue.insert(diskann::Neighbor(i, distances[i]));
+        benchmark::DoNotOptimize(queue.size());
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_CANDIDATES);
+}
+
+// The pattern of a search: expand the closest unexpanded node and insert
+// R = 64 neighbors of it, until every node in the queue is expanded
+void BM_NeighborQueueSearch(benchmark::State &state)
+{
+    const size_t capacity = state.range(0);
+    const uint32_t degree = 64;
+    const std::vector<float> distances = diskann::bench::random_vector<float>(NUM_CANDIDATES);
+    diskann::NeighborPriorityQueue queue(capacity);
+    size_t inserted = 0;
+    for (auto _ : state)
+    {
+        queue.clear();
+        queue.insert(diskann::Neighbor(0, distances[0]));
+        uint32_t next = 1;
+        while (queue.has_unexpanded_node() && next + degree <= NUM_CANDIDATES)
+        {
+            benchmark::DoNotOptimize(queue.closest_unexpanded());
+            for (uint32_t i = 0; i < degree; i++, next++)
+                queue.insert(diskann::Neighbor(next, distances[next]));
+        }
+        inserted += next;
+    }
+    state.SetItemsProcessed(inserted);
+}
+
+BENCHMARK(BM_NeighborQueueInsert)->Arg(10)->Arg(50)->Arg(100)->Arg(200);
+BENCHMARK(BM_NeighborQueueSearch)->Arg(10)->Arg(50)->Arg(100)->Arg(200);
+} // namespace
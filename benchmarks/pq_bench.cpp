@@ -0,0 +1,77 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <benchmark/benchmark.h>
+
+#include "bench_utils.h"
+#include "pq.h"
+
+namespace
+{
+const uint32_t NUM_POINTS = 1 << 20;
+
+// The PQ codes of NUM_POINTS points of nchunks chunks, the table of distances
+// of a query to each centroid of each chunk and n_ids random ids to look up,
+// as the disk search holds them for the neighbors of one node
+struct PQLookupData
+{
+    PQLookupData(size_t nchunks, size_t n_ids)
+        : all_coords(diskann::bench::random_vector<uint8_t>(NUM_POINTS * nchunks, 1)),
+          pq_dists(diskann::bench::random_vector<float>(256 * nchunks, 2)), ids(n_ids), coords(n_ids * nchunks),
+          dists(n_ids)
+    {
+        const std::vector<uint32_t> random_ids = diskann::bench::random_vector<uint32_t>(n_ids, 3);
+        for (size_t i = 0; i < n_ids; i++)
+            ids[i] = random_ids[i] % NUM_POINTS;
+    }
+
+    std::vector<uint8_t> all_coords;
+    std::vector<float> pq_dists;
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t> coords;
+    std::vector<float> dists;
+};
+
+// state.range(0) is the number of chunks, state.range(1) the number of ids
+void BM_AggregateCoords(benchmark::State &state)
+{
+    const size_t nchunks = state.range(0), n_ids = state.range(1);
+    PQLookupData data(nchunks, n_ids);
+    for (auto _ : state)
+    {
+        diskann::aggregate_coords(data.ids.data(), n_ids, data.all_coords.data(), nchunks, data.coords.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * n_ids);
+}
+
+void BM_PQDistLookup(benchmark::State &state)
+{
+    const size_t nchunks = state.range(0), n_ids = state.range(1);
+    PQLookupData data(nchunks, n_ids);
+    diskann::aggregate_coords(data.ids.data(), n_ids, data.all_coords.data(), nchunks, data.coords.data());
+    for (auto _ : state)
+    {
+        diskann::pq_dist_lookup(data.coords.data(), n_ids, nchunks, data.pq_dists.data(), data.dists.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * n_ids);
+}
+
+void BM_GatherPQDistLookup(benchmark::State &state)
+{
+    const size_t nchunks = state.range(0), n_ids = state.range(1);
+    PQLookupData data(nchunks, n_ids);
+    for (auto _ : state)
+    {
+        diskann::gather_pq_dist_lookup(data.ids.data(), n_ids, data.all_coords.data(), nchunks, data.pq_dists.data(),
+                                       data.dists.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * n_ids);
+}
+
+BENCHMARK(BM_AggregateCoords)->ArgsProduct({{16, 32, 64}, {32, 64, 128}});
+BENCHMARK(BM_PQDistLookup)->ArgsProduct({{16, 32, 64}, {32, 64, 128}});
+BENCHMARK(BM_GatherPQDistLookup)->ArgsProduct({{16, 32, 64}, {32, 64, 128}});
+} // namespace
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -31,6 +32,19 @@ template <typename data_t> class AbstractDataStore
     // points, so that the store can discard the empty locations before saving.
     virtual size_t save(const std::string &filename, const location_t num_pts) = 0;
 
+    // Memory-mapped variant of load(): the file written by save_mmap() already
+    // holds the vectors in their aligned in-memory layout, so the store reads
+    // them in place and the pages are shared with other processes mapping the
+    // same file. Stores that cannot be backed by a mapping throw.
+    DISKANN_DLLEXPORT virtual location_t load_mmap(const std::string &filename);
+    DISKANN_DLLEXPORT virtual size_t save_mmap(const std::string &filename, const location_t num_pts);
+    // populate_data() of the vectors of filename without holding them in
+    // memory: writes them to mmap_file as save_mmap() would, a batch at a time,
+    // and maps it for random access, so that they are paged in as they are
+    // read. Stores that cannot be backed by a mapping throw.
+    DISKANN_DLLEXPORT virtual location_t populate_data_mmap(const std::string &filename,
+                                                            const std::string &mmap_file);
+
     DISKANN_DLLEXPORT virtual location_t capacity() const;
 
     DISKANN_DLLEXPORT virtual size_t get_dims() const;
@@ -41,6 +55,9 @@ template <typename data_t> class AbstractDataStore
     // align the dimension by padding zeros.
     virtual size_t get_aligned_dim() const = 0;
 
+    // bytes held for the vectors of the store, at its capacity
+    virtual size_t memory_size() const = 0;
+
     // populate the store with vectors (either from a pointer or bin file),
     // potentially after pre-processing the vectors if the metric deems so
     // e.g., normalizing vectors for cosine distance over floating-point vectors
@@ -48,6 +65,14 @@ template <typename data_t> class AbstractDataStore
     virtual void populate_data(const data_t *vectors, const location_t num_pts) = 0;
     virtual void populate_data(const std::string &filename, const size_t offset) = 0;
 
+    // Like populate_data(vectors, num_pts), but reads the vectors in place
+    // while they are in the store's layout, keeping owner alive for as long
+    // as it does. The vectors are copied before the store changes them.
+    // Returns false, leaving the store unchanged, if the store cannot use them
+    // in place.
+    DISKANN_DLLEXPORT virtual bool use_external_data(const data_t *vectors, const location_t num_pts,
+                                                     std::shared_ptr<const void> owner);
+
     // save the first num_pts many vectors back to bin file
     // note: cannot undo the pre-processing done in populate data
     virtual void extract_data_to_bin(const std::string &filename, const location_t num_pts) = 0;
@@ -93,6 +118,18 @@ template <typename data_t> class AbstractDataStore
     virtual void get_distance(const data_t *preprocessed_query, const std::vector<location_t> &ids,
                               std::vector<float> &distances, AbstractScratch<data_t> *scratch_space) const = 0;
     virtual float get_distance(const location_t loc1, const location_t loc2) const = 0;
+    // distances[i] = get_distance(locations[i], loc), for the rows of distances
+    // robust pruning needs. Stores override it to batch the comparisons.
+    virtual void get_distances_to(const location_t loc, const location_t *locations, const uint32_t location_count,
+                                  float *distances) const;
+    // get_distance(query, loc) if it is at most bound, and otherwise any
+    // value above bound, which stores with bounded kernels find without
+    // computing the distance in full (see Distance<T>::compare_with_bound)
+    virtual float get_distance_with_bound(const data_t *query, const location_t loc, const float bound) const;
+    // get_distances_to(), with distances[i] held to bounds[i] as above
+    virtual void get_distances_to_with_bound(const location_t loc, const location_t *locations,
+                                             const uint32_t location_count, const float *bounds,
+                                             float *distances) const;
 
     // stats of the data stored in store
     // Returns the point in the dataset that is closest to the mean of all points
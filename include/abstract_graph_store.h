@@ -5,11 +5,56 @@
 
 #include <string>
 #include <vector>
+#include "ann_exception.h"
 #include "types.h"
 
 namespace diskann
 {
 
+// Read-only view of one node's out-neighbours. It points into the graph
+// store and is invalidated by the next change to that node's neighbours, so
+// copy it if it has to outlive the node's lock.
+class NeighbourList
+{
+  public:
+    NeighbourList(const location_t *data, size_t size) : _data(data), _size(size)
+    {
+    }
+
+    NeighbourList(const std::vector<location_t> &neighbours) : _data(neighbours.data()), _size(neighbours.size())
+    {
+    }
+
+    const location_t *begin() const
+    {
+        return _data;
+    }
+    const location_t *end() const
+    {
+        return _data + _size;
+    }
+    const location_t *data() const
+    {
+        return _data;
+    }
+    size_t size() const
+    {
+        return _size;
+    }
+    bool empty() const
+    {
+        return _size == 0;
+    }
+    location_t operator[](size_t i) const
+    {
+        return _data[i];
+    }
+
+  private:
+    const location_t *_data;
+    size_t _size;
+};
+
 class AbstractGraphStore
 {
   public:
@@ -23,11 +68,34 @@ class AbstractGraphStore
     // returns tuple of <nodes_read, start, num_frozen_points>
     virtual std::tuple<uint32_t, uint32_t, size_t> load(const std::string &index_path_prefix,
                                                         const size_t num_points) = 0;
+    // Writes num_points lists, the last num_fz_points of them those of the
+    // frozen points. A non-zero frozen_location says the frozen points live
+    // there rather than right after the others; they are still written last,
+    // with the ids that refer to them changed to match.
     virtual int store(const std::string &index_path_prefix, const size_t num_points, const size_t num_fz_points,
-                      const uint32_t start) = 0;
+                      const uint32_t start, const size_t frozen_location = 0) = 0;
+
+    // Memory-mapped variants of load() and store() for stores whose in-memory
+    // layout can be written to and used straight from a file.
+    virtual std::tuple<uint32_t, uint32_t, size_t> load_mmap(const std::string &filename)
+    {
+        throw ANNException("ERROR: this graph store cannot be loaded from a memory-mapped file", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    }
+    virtual int store_mmap(const std::string &filename, const size_t num_points, const size_t num_fz_points,
+                           const uint32_t start)
+    {
+        throw ANNException("ERROR: this graph store cannot be saved as a memory-mapped file", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    }
 
     // not synchronised, user should use lock when necvessary.
-    virtual const std::vector<location_t> &get_neighbours(const location_t i) const = 0;
+    virtual NeighbourList get_neighbours(const location_t i) const = 0;
+    // Hints that the neighbours of i are about to be read; searches call it
+    // ahead of get_neighbours() to overlap the load with other work
+    virtual void prefetch_neighbours(const location_t i) const
+    {
+    }
     virtual void add_neighbour(const location_t i, location_t neighbour_id) = 0;
     virtual void clear_neighbours(const location_t i) = 0;
     virtual void swap_neighbours(const location_t a, location_t b) = 0;
@@ -42,6 +110,9 @@ class AbstractGraphStore
     // set during load
     virtual size_t get_max_range_of_graph() = 0;
 
+    // bytes held for the adjacency lists
+    virtual size_t memory_size() const = 0;
+
     // Total internal points _max_points + _num_frozen_points
     size_t get_total_points()
     {
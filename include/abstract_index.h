@@ -16,18 +16,23 @@ struct consolidation_report
         SUCCESS = 0,
         FAIL = 1,
         LOCK_FAIL = 2,
-        INCONSISTENT_COUNT_ERROR = 3
+        INCONSISTENT_COUNT_ERROR = 3,
+        // a slice of an incremental consolidation was processed, more remain
+        IN_PROGRESS = 4
     };
     status_code _status;
     size_t _active_points, _max_points, _empty_slots, _slots_released, _delete_set_size, _num_calls_to_process_delete;
     double _time;
+    // locations an incremental consolidation has yet to process
+    size_t _locations_remaining;
 
     consolidation_report(status_code status, size_t active_points, size_t max_points, size_t empty_slots,
                          size_t slots_released, size_t delete_set_size, size_t num_calls_to_process_delete,
-                         double time_secs)
+                         double time_secs, size_t locations_remaining = 0)
         : _status(status), _active_points(active_points), _max_points(max_points), _empty_slots(empty_slots),
           _slots_released(slots_released), _delete_set_size(delete_set_size),
-          _num_calls_to_process_delete(num_calls_to_process_delete), _time(time_secs)
+          _num_calls_to_process_delete(num_calls_to_process_delete), _time(time_secs),
+          _locations_remaining(locations_remaining)
     {
     }
 };
@@ -55,6 +60,9 @@ class AbstractIndex
     virtual void load(const char *index_file, uint32_t num_threads, uint32_t search_l) = 0;
 #endif
 
+    // sizes the query scratch for searches with L up to max_search_l
+    virtual void reserve_search_l(uint32_t max_search_l) = 0;
+
     // For FastL2 search on optimized layout
     template <typename data_type>
     void search_with_optimized_layout(const data_type *query, size_t K, size_t L, uint32_t *indices);
@@ -86,6 +94,12 @@ class AbstractIndex
     // insert point for unfiltered index build. do not use with filtered index
     template <typename data_type, typename tag_type> int insert_point(const data_type *point, const tag_type tag);
 
+    // insert num_points consecutive points in one batch for unfiltered index build.
+    // insert_retvals[i] is 0 if point i was inserted and -1 otherwise.
+    template <typename data_type, typename tag_type>
+    size_t insert_points(const data_type *points, const tag_type *tags, const size_t num_points,
+                         std::vector<int> &insert_retvals);
+
     // delete point with tag, or return -1 if point can not be deleted
     template <typename tag_type> int lazy_delete(const tag_type &tag);
 
@@ -99,8 +113,21 @@ class AbstractIndex
 
     virtual consolidation_report consolidate_deletes(const IndexWriteParameters &parameters) = 0;
 
+    // repairs the graph around lazily deleted points a slice of at most
+    // max_locations locations at a time; call until it returns SUCCESS
+    virtual consolidation_report consolidate_deletes_slice(const IndexWriteParameters &parameters,
+                                                           const size_t max_locations) = 0;
+
     virtual void optimize_index_layout() = 0;
 
+    // persist the optimized layout, and load an index for search on it alone
+    virtual void save_optimized_layout(const char *filename) = 0;
+    virtual void load_optimized_layout(const char *filename, uint32_t num_threads, uint32_t search_l) = 0;
+
+    // builds a Vamana graph over a sample of the points that unfiltered
+    // searches use to pick their start points; static indices only
+    virtual void build_entry_layer(float sample_rate) = 0;
+
     // memory should be allocated for vec before calling this function
     template <typename tag_type, typename data_type> int get_vector_by_tag(tag_type &tag, data_type *vec);
 
@@ -115,6 +142,8 @@ class AbstractIndex
                                                                float *distances) = 0;
     virtual int _insert_point(const DataType &data_point, const TagType tag, Labelvector &labels) = 0;
     virtual int _insert_point(const DataType &data_point, const TagType tag) = 0;
+    virtual size_t _insert_points(const DataType &points, const TagType &tags, const size_t num_points,
+                                  std::vector<int> &insert_retvals) = 0;
     virtual int _lazy_delete(const TagType &tag) = 0;
     virtual void _lazy_delete(TagVector &tags, TagVector &failed_tags) = 0;
     virtual void _get_active_tags(TagRobinSet &active_tags) = 0;
@@ -23,6 +23,9 @@ struct IOContext
     HANDLE fhandle = NULL;
     HANDLE iocp = NULL;
     std::vector<OVERLAPPED> reqs;
+    // the ring of WindowsIoRingAlignedFileReader, which leaves the fields
+    // above unset
+    void *ring = nullptr;
 };
 #else
 #include "IDiskPriorityIO.h"
@@ -70,6 +73,11 @@ struct IOContext
 #include "tsl/robin_map.h"
 #include "utils.h"
 
+namespace diskann
+{
+class IOMetrics;
+}
+
 // NOTE :: all 3 fields must be 512-aligned
 struct AlignedRead
 {
@@ -94,21 +102,80 @@ class AlignedFileReader
 {
   protected:
     tsl::robin_map<std::thread::id, IOContext> ctx_map;
+    // contexts from create_ctx(), which belong to no thread
+    std::vector<IOContext> owned_ctxs;
     std::mutex ctx_mut;
 
   public:
-    // returns the thread-specific context
-    // returns (io_context_t)(-1) if thread is not registered
+    // returns the thread-specific context, registering the calling thread
+    // first if it has none
     virtual IOContext &get_ctx() = 0;
 
     virtual ~AlignedFileReader(){};
 
+    // Creates a context that belongs to no thread, for an owner such as a
+    // per-query scratch object that uses it from one thread at a time and
+    // from any thread. It needs no register_thread(), and is released by
+    // deregister_all_threads(). Readers without such contexts hand out the
+    // calling thread's.
+    virtual IOContext create_ctx()
+    {
+        return get_ctx();
+    }
+
+    // whether read() takes contexts from create_ctx() of other readers of
+    // this class, as SSDSearchHost shares them between the indices it hosts
+    virtual bool has_file_independent_ctx()
+    {
+        return false;
+    }
     // register thread-id for a context
     virtual void register_thread() = 0;
     // de-register thread-id for a context
     virtual void deregister_thread() = 0;
+    // releases the contexts of all threads and those from create_ctx()
     virtual void deregister_all_threads() = 0;
 
+    // Forgets the contexts of all threads and those from create_ctx() in a
+    // child process forked after they were created, where they are the
+    // parent's: aio contexts are not inherited, and rings or connections
+    // inherited are still in the parent's use. The file stays open. Those who
+    // held the contexts create new ones. Readers whose contexts hold state of
+    // their own in the child release it.
+    virtual void reset_after_fork()
+    {
+        std::unique_lock<std::mutex> lk(ctx_mut);
+        ctx_map.clear();
+        owned_ctxs.clear();
+    }
+
+    // optionally pin a caller-owned buffer that reads on ctx will land in
+    // (e.g. io_uring fixed buffers); no-op for readers that do not use it
+    virtual void register_buffer(IOContext &ctx, void *buf, size_t len)
+    {
+    }
+
+    // start sampling the latency and queue depth of the reads that follow into
+    // get_io_metrics(); no-op for readers that do not sample them
+    virtual void enable_io_metrics()
+    {
+    }
+
+    // the IO metrics of the reader, or nullptr if it does not sample them or
+    // enable_io_metrics() was not called
+    virtual diskann::IOMetrics *get_io_metrics()
+    {
+        return nullptr;
+    }
+
+    // the opened file in memory (read-only), for readers that serve reads
+    // from a mapping: callers may read sectors there in place instead of
+    // through read(). nullptr for readers that do real I/O.
+    virtual char *mapped_data()
+    {
+        return nullptr;
+    }
+
     // Open & close ops
     // Blocking calls
     virtual void open(const std::string &fname) = 0;
@@ -118,6 +185,30 @@ class AlignedFileReader
     // NOTE :: blocking call
     virtual void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false) = 0;
 
+#ifndef _WINDOWS
+    // Non-blocking counterpart of read() used for pipelined search. Readers
+    // that return true from supports_async_reads() implement both calls below.
+    virtual bool supports_async_reads()
+    {
+        return false;
+    }
+
+    // queue read_reqs on ctx and return without waiting; completions are
+    // identified by the index of the request in read_reqs
+    virtual void submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx)
+    {
+        throw diskann::ANNException("submit_reads not supported by this reader", -1);
+    }
+
+    // wait for at least min_completions (and at most max_completions) of the
+    // reads outstanding on ctx and append their request indices to completed
+    virtual void reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                            std::vector<uint64_t> &completed)
+    {
+        throw diskann::ANNException("reap_reads not supported by this reader", -1);
+    }
+#endif
+
 #ifdef USE_BING_INFRA
     // wait for completion of one request in a batch of requests
     virtual void wait(IOContext &ctx, int &completedIndex) = 0;
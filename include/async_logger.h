@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <streambuf>
+
+#include "windows_customizations.h"
+
+// Messages below this severity are compiled out of the DISKANN_LOG macros:
+// 0 for debug, 1 for info (the default), 2 for warning and 3 for error.
+#ifndef DISKANN_MIN_LOG_SEVERITY
+#define DISKANN_MIN_LOG_SEVERITY 1
+#endif
+
+namespace diskann
+{
+enum class LogSeverity
+{
+    Debug = 0,
+    Info,
+    Warning,
+    Error
+};
+
+// A logger for hot paths that never blocks the threads that log. Each thread
+// formats its messages straight into a ring buffer of its own, and a
+// background thread writes the rings out every few milliseconds, or at once
+// for errors. A message that finds its ring full is dropped and counted, and
+// the number dropped is reported with the next messages written. Messages
+// longer than MESSAGE_SIZE are truncated.
+//
+// Use the macros, which skip formatting the message when it is not logged:
+//
+//     DISKANN_LOG(Info) << "Loaded " << n << " points";
+//     DISKANN_LOG_EVERY_MS(Warning, 1000) << "Found fewer than " << K << " results";
+//
+// Messages go to diskann::cout, and warnings and errors to diskann::cerr, one
+// line each; everything logged is written by the time the process exits.
+class AsyncLogger
+{
+  public:
+    static const uint32_t MESSAGE_SIZE = 256;
+    static const uint32_t MESSAGES_PER_THREAD = 1024;
+
+    static bool enabled(LogSeverity severity)
+    {
+        return (int)severity >= _min_severity.load(std::memory_order_relaxed);
+    }
+
+    // drops messages below severity at run time, on top of
+    // DISKANN_MIN_LOG_SEVERITY
+    DISKANN_DLLEXPORT static void set_min_severity(LogSeverity severity);
+
+    // where the background thread writes each message, instead of
+    // diskann::cout and diskann::cerr
+    DISKANN_DLLEXPORT static void set_sink(std::function<void(LogSeverity, const char *)> sink);
+
+    // writes out everything logged so far before returning
+    DISKANN_DLLEXPORT static void flush();
+
+    // messages dropped because the ring of their thread was full
+    DISKANN_DLLEXPORT static uint64_t num_dropped();
+
+    // true at most once every interval_ms across the threads sharing next_us,
+    // the time the next message is due
+    DISKANN_DLLEXPORT static bool rate_limit(std::atomic<uint64_t> &next_us, uint64_t interval_ms);
+
+  private:
+    DISKANN_DLLEXPORT static std::atomic<int> _min_severity;
+};
+
+// A message being formatted into the ring of its thread, and published to the
+// background thread when it goes out of scope.
+class LogMessage
+{
+  public:
+    DISKANN_DLLEXPORT explicit LogMessage(LogSeverity severity);
+    DISKANN_DLLEXPORT ~LogMessage();
+
+    std::ostream &stream()
+    {
+        return _stream;
+    }
+
+  private:
+    // writes into a fixed slot, dropping what does not fit
+    class SlotBuf : public std::streambuf
+    {
+      public:
+        void set(char *begin, size_t size)
+        {
+            setp(begin, begin + size);
+        }
+        size_t length() const
+        {
+            return pptr() - pbase();
+        }
+
+      protected:
+        int_type overflow(int_type c) override
+        {
+            return traits_type::not_eof(c);
+        }
+    };
+
+    LogSeverity _severity;
+    void *_slot;
+    SlotBuf _buf;
+    std::ostream _stream;
+
+    LogMessage(const LogMessage &) = delete;
+    LogMessage &operator=(const LogMessage &) = delete;
+};
+
+// turns the stream expression of the macros into void so that it can be a
+// branch of ?:
+struct LogVoidify
+{
+    void operator&(std::ostream &)
+    {
+    }
+};
+} // namespace diskann
+
+#define DISKANN_LOG_IS_ON(severity)                                                                                   \
+    ((int)diskann::LogSeverity::severity >= DISKANN_MIN_LOG_SEVERITY &&                                               \
+     diskann::AsyncLogger::enabled(diskann::LogSeverity::severity))
+
+#define DISKANN_LOG(severity)                                                                                         \
+    !DISKANN_LOG_IS_ON(severity)                                                                                      \
+        ? (void)0                                                                                                     \
+        : diskann::LogVoidify() & diskann::LogMessage(diskann::LogSeverity::severity).stream()
+
+// logs at most once every interval_ms from this line of code
+#define DISKANN_LOG_EVERY_MS(severity, interval_ms)                                                                   \
+    !(DISKANN_LOG_IS_ON(severity) && [&]() {                                                                          \
+        static std::atomic<uint64_t> next_us{0};                                                                      \
+        return diskann::AsyncLogger::rate_limit(next_us, (interval_ms));                                              \
+    }())                                                                                                              \
+        ? (void)0                                                                                                     \
+        : diskann::LogVoidify() & diskann::LogMessage(diskann::LogSeverity::severity).stream()
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+// The BLAS and LAPACK routines used here (cblas_sgemm, cblas_sdot,
+// cblas_snrm2 and LAPACKE_sgesdd) come from Intel MKL, which only exists for
+// x86. AArch64 builds link OpenBLAS instead (CMake defines DISKANN_OPENBLAS),
+// and this header maps the two MKL names used besides those onto it.
+#ifdef DISKANN_OPENBLAS
+#include <cblas.h>
+#include <lapacke.h>
+
+#ifndef MKL_INT
+#define MKL_INT blasint
+#endif
+
+inline void mkl_set_num_threads(int num_threads)
+{
+    openblas_set_num_threads(num_threads);
+}
+#else
+#include "mkl.h"
+#endif
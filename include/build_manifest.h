@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Record of the stages of a build that have completed, kept in a small text
+// file next to the index so that a build restarted after a crash or
+// preemption can skip them.
+//
+// A stage is recorded together with the files it produced and their sizes,
+// and only counts as done while all of them are still there with those sizes.
+// The file also holds a key describing the build (its input and parameters);
+// a manifest written for a different key is ignored. Every update rewrites
+// the file through a temporary file and a rename, so it is never left half
+// written.
+class BuildManifest
+{
+  public:
+    // Loads the manifest at path if resume is set and it was written for the
+    // same build_key; starts from an empty one otherwise. Nothing is written
+    // until a stage is recorded.
+    DISKANN_DLLEXPORT BuildManifest(const std::string &path, const std::string &build_key, bool resume);
+
+    // True if stage completed and its artifacts are intact
+    DISKANN_DLLEXPORT bool is_done(const std::string &stage) const;
+
+    // True if begin() was called for stage but it did not complete
+    DISKANN_DLLEXPORT bool in_progress(const std::string &stage) const;
+
+    // The artifacts recorded for stage
+    DISKANN_DLLEXPORT std::vector<std::string> artifacts(const std::string &stage) const;
+
+    // Records that stage is about to modify earlier artifacts in place, for
+    // stages that cannot simply be rerun if interrupted.
+    DISKANN_DLLEXPORT void begin(const std::string &stage);
+
+    // Records stage as completed with the given output files, which must
+    // exist.
+    DISKANN_DLLEXPORT void mark_done(const std::string &stage, const std::vector<std::string> &artifacts = {});
+
+    // Records the current sizes of the artifacts of completed stages, after a
+    // later stage rewrote them
+    DISKANN_DLLEXPORT void refresh(const std::vector<std::string> &stages);
+
+    // Forgets stages so that they run again
+    DISKANN_DLLEXPORT void invalidate(const std::vector<std::string> &stages);
+
+    // Deletes the manifest file, once the build has finished
+    DISKANN_DLLEXPORT void remove();
+
+    const std::string &build_key() const
+    {
+        return _build_key;
+    }
+
+    bool resume() const
+    {
+        return _resume;
+    }
+
+  private:
+    struct Stage
+    {
+        bool done = false;
+        // path and size of each artifact
+        std::vector<std::pair<std::string, uint64_t>> artifacts;
+    };
+
+    void save() const;
+
+    std::string _path;
+    std::string _build_key;
+    bool _resume;
+    std::map<std::string, Stage> _stages;
+};
+
+// Parses a list of shard ids such as "0,2,5-7". "none" selects no shard.
+DISKANN_DLLEXPORT std::vector<uint32_t> parse_shard_list(const std::string &list);
+} // namespace diskann
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Resources used by each stage of a build: wall and CPU time, the peak
+// resident memory, and the bytes read and written, both through the file
+// APIs and, where the OS reports it, from storage. Stages are scoped with
+// BuildProfiler::Stage and nest; a stage opened while another is open is
+// recorded as its child, and its usage counts towards the parent too.
+//
+// Profiling is off by default and costs nothing then. It is process wide and
+// meant for one build at a time, as the usage is that of the whole process.
+class BuildProfiler
+{
+  public:
+    DISKANN_DLLEXPORT static void set_enabled(bool enable);
+
+    static bool enabled()
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    // forgets the stages recorded so far
+    DISKANN_DLLEXPORT static void clear();
+
+    // The completed stages in the order they began, as JSON:
+    // {"num_cpus": ..., "per_stage_peak_rss": ..., "stages": [{"name": ...,
+    // "parent": ..., "wall_seconds": ..., "cpu_seconds": ...,
+    // "cpu_utilization": ..., "peak_rss_bytes": ..., "bytes_read": ...,
+    // "bytes_written": ..., "storage_bytes_read": ...,
+    // "storage_bytes_written": ...}, ...]}
+    // cpu_utilization is the share of all cores busy over the stage. Without
+    // per_stage_peak_rss (the OS cannot reset the peak), peak_rss_bytes is
+    // the peak of the process up to the end of the stage.
+    DISKANN_DLLEXPORT static void write_json(std::ostream &out);
+    DISKANN_DLLEXPORT static void write_json(const std::string &path);
+
+    // Records the usage from its construction to its destruction as a stage
+    // of the given name, if profiling is enabled when it is constructed
+    class Stage
+    {
+      public:
+        DISKANN_DLLEXPORT explicit Stage(const std::string &name);
+        DISKANN_DLLEXPORT ~Stage();
+
+      private:
+        int64_t _index;
+
+        Stage(const Stage &) = delete;
+        Stage &operator=(const Stage &) = delete;
+    };
+
+  private:
+    DISKANN_DLLEXPORT static std::atomic<bool> _enabled;
+};
+} // namespace diskann
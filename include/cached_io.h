@@ -2,15 +2,21 @@
 // Licensed under the MIT license.
 
 #pragma once
+#include <cassert>
 #include <cstring>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <sstream>
 
 #include "logger.h"
 #include "ann_exception.h"
+#include "parallel_io.h"
 
-// sequential cached reads
+// sequential cached reads. While the caller consumes one cache_size block of
+// the file, the next is read ahead on another thread, and reads larger than
+// the cache go to the file directly with parallel_file_io(). A MemoryBinFile
+// is read from memory without a cache.
 class cached_ifstream
 {
   public:
@@ -19,18 +25,29 @@ class cached_ifstream
     }
     cached_ifstream(const std::string &filename, uint64_t cacheSize) : cache_size(cacheSize), cur_off(0)
     {
-        reader.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         this->open(filename, cache_size);
     }
     ~cached_ifstream()
     {
+        if (prefetch.valid())
+            prefetch.wait();
         delete[] cache_buf;
+        delete[] prefetch_buf;
         reader.close();
     }
 
     void open(const std::string &filename, uint64_t cacheSize)
     {
         this->cur_off = 0;
+        this->filename = filename;
+        this->memory_file = diskann::MemoryBinFile::find(filename);
+        if (memory_file != nullptr)
+        {
+            fsize = memory_file->size();
+            file_off = 0;
+            return;
+        }
+        reader.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
         try
         {
@@ -42,7 +59,11 @@ class cached_ifstream
             cacheSize = (std::min)(cacheSize, fsize);
             this->cache_size = cacheSize;
             cache_buf = new char[cacheSize];
+            prefetch_buf = new char[cacheSize];
             reader.read(cache_buf, cacheSize);
+            cache_len = cacheSize;
+            file_off = cacheSize;
+            start_prefetch();
             diskann::cout << "Opened: " << filename.c_str() << ", size: " << fsize << ", cache_size: " << cacheSize
                           << std::endl;
         }
@@ -59,65 +80,121 @@ class cached_ifstream
 
     void read(char *read_buf, uint64_t n_bytes)
     {
-        assert(cache_buf != nullptr);
         assert(read_buf != nullptr);
+        if (memory_file != nullptr)
+        {
+            memory_file->read(read_buf, file_off, n_bytes);
+            file_off += n_bytes;
+            return;
+        }
+        assert(cache_buf != nullptr);
 
-        if (n_bytes <= (cache_size - cur_off))
+        uint64_t cached_bytes = cache_len - cur_off;
+        if (n_bytes - (std::min)(n_bytes, cached_bytes) > fsize - file_off)
         {
-            // case 1: cache contains all data
-            memcpy(read_buf, cache_buf + cur_off, n_bytes);
-            cur_off += n_bytes;
+            std::stringstream stream;
+            stream << "Reading beyond end of file" << std::endl;
+            stream << "n_bytes: " << n_bytes << " cached_bytes: " << cached_bytes << " fsize: " << fsize
+                   << " current pos:" << file_off << std::endl;
+            diskann::cout << stream.str() << std::endl;
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
         }
-        else
+
+        try
         {
-            // case 2: cache contains some data
-            uint64_t cached_bytes = cache_size - cur_off;
-            if (n_bytes - cached_bytes > fsize - reader.tellg())
+            while (true)
             {
-                std::stringstream stream;
-                stream << "Reading beyond end of file" << std::endl;
-                stream << "n_bytes: " << n_bytes << " cached_bytes: " << cached_bytes << " fsize: " << fsize
-                       << " current pos:" << reader.tellg() << std::endl;
-                diskann::cout << stream.str() << std::endl;
-                throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
-            }
-            memcpy(read_buf, cache_buf + cur_off, cached_bytes);
+                // case 1: cache contains (the rest of the) data
+                uint64_t bytes = (std::min)(n_bytes, cache_len - cur_off);
+                memcpy(read_buf, cache_buf + cur_off, bytes);
+                cur_off += bytes;
+                read_buf += bytes;
+                n_bytes -= bytes;
+                if (n_bytes == 0)
+                    return;
 
-            // go to disk and fetch more data
-            reader.read(read_buf + cached_bytes, n_bytes - cached_bytes);
-            // reset cur off
-            cur_off = cache_size;
+                // case 2: data continues past the cache. Whole blocks past
+                // the one read ahead go directly into read_buf.
+                if (n_bytes > 2 * cache_size)
+                {
+                    uint64_t bytes_ahead = prefetch.get();
+                    memcpy(read_buf, prefetch_buf, bytes_ahead);
+                    read_buf += bytes_ahead;
+                    n_bytes -= bytes_ahead;
+                    file_off += bytes_ahead;
 
-            uint64_t size_left = fsize - reader.tellg();
-
-            if (size_left >= cache_size)
-            {
-                reader.read(cache_buf, cache_size);
-                cur_off = 0;
+                    uint64_t direct_bytes = (n_bytes / cache_size - 1) * cache_size;
+                    parallel_file_io(filename, read_buf, file_off, direct_bytes, false);
+                    read_buf += direct_bytes;
+                    n_bytes -= direct_bytes;
+                    file_off += direct_bytes;
+                    start_prefetch();
+                }
+                next_block();
             }
-            // note that if size_left < cache_size, then cur_off = cache_size,
-            // so subsequent reads will all be directly from file
+        }
+        catch (std::system_error &e)
+        {
+            throw diskann::FileException(filename, e, __FUNCSIG__, __FILE__, __LINE__);
         }
     }
 
   private:
-    // underlying ifstream
+    // reads the block at file_off into prefetch_buf on another thread
+    void start_prefetch()
+    {
+        uint64_t off = file_off;
+        uint64_t len = (std::min)(cache_size, fsize - off);
+        prefetch = std::async(std::launch::async, [this, off, len] {
+            if (len > 0)
+            {
+                reader.seekg(off, std::ios::beg);
+                reader.read(prefetch_buf, len);
+            }
+            return len;
+        });
+    }
+
+    // makes the block read ahead the cache, and starts reading the next one
+    void next_block()
+    {
+        cache_len = prefetch.get();
+        file_off += cache_len;
+        std::swap(cache_buf, prefetch_buf);
+        cur_off = 0;
+        start_prefetch();
+    }
+
+    std::string filename;
+    // underlying ifstream, used by the prefetch thread
     std::ifstream reader;
     // # bytes to cache in one shot read
     uint64_t cache_size = 0;
-    // underlying buf for cache
+    // underlying buf for cache, and the one the next block is read into
     char *cache_buf = nullptr;
+    char *prefetch_buf = nullptr;
+    // bytes of the file in cache_buf
+    uint64_t cache_len = 0;
     // offset into cache_buf for cur_pos
     uint64_t cur_off = 0;
+    // offset in the file of the block after cache_buf
+    uint64_t file_off = 0;
+    // read of that block, returning its size
+    std::future<uint64_t> prefetch;
     // file size
     uint64_t fsize = 0;
+    // the file, if it is in memory; file_off is then the read position
+    const diskann::MemoryBinFile *memory_file = nullptr;
 };
 
-// sequential cached writes
+// sequential cached writes. A full cache is written out on another thread
+// while the caller fills a second one, and writes larger than the cache go to
+// the file directly with write_file_parallel().
 class cached_ofstream
 {
   public:
-    cached_ofstream(const std::string &filename, uint64_t cache_size) : cache_size(cache_size), cur_off(0)
+    cached_ofstream(const std::string &filename, uint64_t cache_size)
+        : filename(filename), cache_size(cache_size), cur_off(0)
     {
         writer.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
@@ -126,6 +203,7 @@ class cached_ofstream
             assert(writer.is_open());
             assert(cache_size > 0);
             cache_buf = new char[cache_size];
+            write_behind_buf = new char[cache_size];
             diskann::cout << "Opened: " << filename.c_str() << ", cache_size: " << cache_size << std::endl;
         }
         catch (std::system_error &e)
@@ -142,15 +220,18 @@ class cached_ofstream
     void close()
     {
         // dump any remaining data in memory
-        if (cur_off > 0)
+        if (cache_buf != nullptr)
         {
             this->flush_cache();
+            wait_for_write();
         }
 
         if (cache_buf != nullptr)
         {
             delete[] cache_buf;
+            delete[] write_behind_buf;
             cache_buf = nullptr;
+            write_behind_buf = nullptr;
         }
 
         if (writer.is_open())
@@ -166,51 +247,95 @@ class cached_ofstream
     void write(char *write_buf, uint64_t n_bytes)
     {
         assert(cache_buf != nullptr);
-        if (n_bytes <= (cache_size - cur_off))
+        while (n_bytes > 0)
         {
-            // case 1: cache can take all data
-            memcpy(cache_buf + cur_off, write_buf, n_bytes);
-            cur_off += n_bytes;
-        }
-        else
-        {
-            // case 2: cache cant take all data
-            // go to disk and write existing cache data
-            writer.write(cache_buf, cur_off);
-            fsize += cur_off;
-            // write the new data to disk
-            writer.write(write_buf, n_bytes);
-            fsize += n_bytes;
-            // memset all cache data and reset cur_off
-            memset(cache_buf, 0, cache_size);
-            cur_off = 0;
+            // case 1: cache can take (the rest of the) data
+            uint64_t bytes = (std::min)(n_bytes, cache_size - cur_off);
+            memcpy(cache_buf + cur_off, write_buf, bytes);
+            cur_off += bytes;
+            write_buf += bytes;
+            n_bytes -= bytes;
+            if (cur_off < cache_size)
+                return;
+
+            // case 2: hand the full cache to the writer, and write whole
+            // blocks past it directly from write_buf
+            flush_cache();
+            if (n_bytes > cache_size)
+            {
+                wait_for_write();
+                uint64_t direct_bytes = n_bytes / cache_size * cache_size;
+                try
+                {
+                    writer.flush();
+                    write_file_parallel(filename, write_buf, pos, direct_bytes);
+                    pos += direct_bytes;
+                    writer.seekp(pos, std::ios::beg);
+                }
+                catch (std::system_error &e)
+                {
+                    throw diskann::FileException(filename, e, __FUNCSIG__, __FILE__, __LINE__);
+                }
+                fsize += direct_bytes;
+                write_buf += direct_bytes;
+                n_bytes -= direct_bytes;
+            }
         }
     }
 
+    // hands the data in the cache to the writer thread
     void flush_cache()
     {
         assert(cache_buf != nullptr);
-        writer.write(cache_buf, cur_off);
-        fsize += cur_off;
-        memset(cache_buf, 0, cache_size);
+        wait_for_write();
+        if (cur_off == 0)
+            return;
+        std::swap(cache_buf, write_behind_buf);
+        uint64_t len = cur_off;
+        pending_write = std::async(std::launch::async, [this, len] { writer.write(write_behind_buf, len); });
+        fsize += len;
+        pos += len;
         cur_off = 0;
     }
 
     void reset()
     {
         flush_cache();
+        wait_for_write();
         writer.seekp(0);
+        pos = 0;
     }
 
   private:
-    // underlying ofstream
+    // waits for the writer thread, and rethrows its error
+    void wait_for_write()
+    {
+        if (!pending_write.valid())
+            return;
+        try
+        {
+            pending_write.get();
+        }
+        catch (std::system_error &e)
+        {
+            throw diskann::FileException(filename, e, __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+
+    std::string filename;
+    // underlying ofstream, used by the writer thread
     std::ofstream writer;
     // # bytes to cache for one shot write
     uint64_t cache_size = 0;
-    // underlying buf for cache
+    // underlying buf for cache, and the one being written out
     char *cache_buf = nullptr;
+    char *write_behind_buf = nullptr;
     // offset into cache_buf for cur_pos
     uint64_t cur_off = 0;
+    // write of write_behind_buf
+    std::future<void> pending_write;
+    // offset in the file the cache starts at
+    uint64_t pos = 0;
 
     // file size
     uint64_t fsize = 0;
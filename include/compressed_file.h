@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "defaults.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// How the blocks of a CompressedFile are encoded
+enum class BlockCodec : uint32_t
+{
+    // For graph files written by InMemGraphStore::save_graph(): each adjacency
+    // list as its degree, its smallest neighbour and the gaps between its
+    // sorted neighbours, all in varints. Lists come back sorted.
+    GraphVarint = 1,
+    // zstd, for PQ codes, data and other files; needs a build with USE_ZSTD
+    Zstd = 2
+};
+
+// A file stored as independently compressed blocks of its bytes, to shrink
+// index files that are fetched from object storage before they are loaded.
+// read_file_parallel() and get_bin_metadata() see through it, so the loaders
+// of bin, PQ and graph files take either form; the blocks a read covers are
+// decompressed on all threads straight into the caller's buffer.
+//
+// Layout: a header, the blocks, and a table with the offset of each block in
+// the original file and in this one.
+class CompressedFile
+{
+  public:
+    // Reads the header and block table of path.
+    DISKANN_DLLEXPORT explicit CompressedFile(const std::string &path);
+
+    // whether path is a compressed file rather than a raw one
+    DISKANN_DLLEXPORT static bool is_compressed(const std::string &path);
+
+    // Compresses in_file into out_file with codec, in blocks of about
+    // block_size bytes of in_file.
+    DISKANN_DLLEXPORT static void compress(const std::string &in_file, const std::string &out_file, BlockCodec codec,
+                                           uint64_t block_size = defaults::COMPRESSED_BLOCK_SIZE);
+
+    // Writes the original of the compressed file in_file to out_file.
+    DISKANN_DLLEXPORT static void decompress(const std::string &in_file, const std::string &out_file);
+
+    // size of the original file
+    uint64_t size() const
+    {
+        return _size;
+    }
+
+    BlockCodec codec() const
+    {
+        return _codec;
+    }
+
+    // Reads len bytes at offset of the original file into buf, decompressing
+    // the blocks over them on num_threads threads (all OpenMP threads if 0).
+    DISKANN_DLLEXPORT void read(char *buf, uint64_t offset, uint64_t len, uint32_t num_threads = 0) const;
+
+  private:
+    struct Block
+    {
+        uint64_t original_offset;
+        uint64_t offset;
+        uint64_t bytes;
+    };
+
+    std::string _path;
+    BlockCodec _codec;
+    uint64_t _size = 0;
+    // in original order, followed by an empty block at the end of the file
+    std::vector<Block> _blocks;
+};
+} // namespace diskann
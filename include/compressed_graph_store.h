@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include "abstract_graph_store.h"
+
+namespace diskann
+{
+// Read-only graph store for static indices that keeps the adjacency lists
+// compressed. Each list is sorted and written as its degree (uint16), its
+// smallest id (uint32) and the gaps between consecutive ids, in blocks of 8
+// gaps that share one bit width: a width byte w followed by the 8 gaps in
+// exactly w bytes. Gaps between neighbours are far smaller than the ids, so a
+// list takes a fraction of the 4 bytes per neighbour of the other stores.
+//
+// get_neighbours() decodes the list into a buffer of the calling thread, a
+// fixed 8-lane unpack and prefix sum per block, so the list it returns is
+// only valid until the thread's next get_neighbours(). Lists come back sorted
+// rather than in the order they were saved in.
+//
+// The lists are compressed as load() reads them, and store() writes them
+// out uncompressed again. Every change to a list throws.
+class CompressedGraphStore : public AbstractGraphStore
+{
+  public:
+    CompressedGraphStore(const size_t total_pts, const size_t reserve_graph_degree);
+
+    // returns tuple of <nodes_read, start, num_frozen_points>
+    virtual std::tuple<uint32_t, uint32_t, size_t> load(const std::string &index_path_prefix,
+                                                        const size_t num_points) override;
+    virtual int store(const std::string &index_path_prefix, const size_t num_points, const size_t num_frozen_points,
+                      const uint32_t start, const size_t frozen_location = 0) override;
+
+    virtual NeighbourList get_neighbours(const location_t i) const override;
+    virtual void prefetch_neighbours(const location_t i) const override;
+    virtual void add_neighbour(const location_t i, location_t neighbour_id) override;
+    virtual void clear_neighbours(const location_t i) override;
+    virtual void swap_neighbours(const location_t a, location_t b) override;
+
+    virtual void set_neighbours(const location_t i, std::vector<location_t> &neighbors) override;
+
+    // new nodes have no neighbours
+    virtual size_t resize_graph(const size_t new_size) override;
+    virtual void clear_graph() override;
+
+    virtual size_t get_max_range_of_graph() override;
+    virtual uint32_t get_max_observed_degree() override;
+    virtual size_t memory_size() const override;
+
+  private:
+    [[noreturn]] void throw_read_only() const;
+
+    // _lists[_offsets[i] .. _offsets[i + 1]) holds the list of node i, empty
+    // for a node without neighbours; _lists is padded so that the decoder can
+    // read 8 bytes past any gap
+    std::vector<uint8_t> _lists;
+    std::vector<uint64_t> _offsets;
+
+    size_t _max_range_of_graph = 0;
+    uint32_t _max_observed_degree = 0;
+};
+
+} // namespace diskann
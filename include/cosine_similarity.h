@@ -3,9 +3,6 @@
 
 #pragma once
 
-#include <immintrin.h>
-#include <smmintrin.h>
-#include <tmmintrin.h>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
@@ -18,11 +18,131 @@ const uint32_t NUM_FROZEN_POINTS_DYNAMIC = 1;
 
 // In-mem index related limits
 const float GRAPH_SLACK_FACTOR = 1.3f;
+// Memory-mapped in-mem index files start with a header padded to this size so
+// that the vectors and adjacency lists after it are page aligned.
+const uint64_t MMAP_HEADER_SIZE = 4096;
+// DataStoreStrategy::MMAP_BUILD copies the base file to its mapped file, and
+// SQ training reads it, in batches of about this many bytes
+const uint64_t MMAP_BUILD_BATCH_SIZE = 64 * 1024 * 1024;
+
+// Loading and saving: reads and writes larger than one chunk are split across
+// threads, and graph files are decoded one window at a time
+const uint64_t PARALLEL_READ_CHUNK_SIZE = 16 * 1024 * 1024;
+const uint64_t GRAPH_LOAD_WINDOW_SIZE = 256 * 1024 * 1024;
+// Compressed index files are compressed in blocks of about this many bytes
+const uint64_t COMPRESSED_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// Searches of a dynamic index expand lazily deleted points only in their
+// first this many hops; the default never skips them
+const uint32_t TOMBSTONE_HOP_LIMIT = 0xFFFFFFFF;
+
+// Hops a search takes before a SearchBudgetModel predicts how many more it
+// needs
+const uint32_t SEARCH_BUDGET_WARMUP_HOPS = 10;
+
+// Index::insert_points links a batch in rounds of at most this fraction of
+// the points already in the index (and at least one point per thread)
+const float INSERT_BATCH_ROUND_FRACTION = 0.02f;
+
+// Index::link() makes this many passes over the points, all but the last
+// with FIRST_PASS_ALPHA. With LOCALITY_CLUSTERS > 0 it visits the points
+// grouped by the nearest of that many sampled pivots instead of in order.
+const uint32_t BUILD_NUM_PASSES = 1;
+const float FIRST_PASS_ALPHA = 1.0f;
+const uint32_t LOCALITY_CLUSTERS = 0;
+
+// generate_label_indices builds the index of a label with all threads once it
+// has this many points per thread, and smaller ones concurrently
+const uint32_t LABEL_INDEX_MIN_POINTS_PER_THREAD = 10000;
+
+// Number of neighbour-list locks shared by all points; 0 keeps one lock per point
+const uint32_t NUM_LOCK_STRIPES = 0;
+
+// A store that has to grow reserves address space for this many times the
+// new capacity, so that the next resizes extend it in place
+const uint32_t STORE_GROWTH_RESERVE = 4;
+
+// Batched distance computations prefetch the vector this many ids ahead of
+// the ones being compared
+const uint32_t DISTANCE_PREFETCH_AHEAD = 8;
+
+// Entry layer: a Vamana graph over a random sample of the points that is
+// searched first to pick per-query start points. It holds at least
+// ENTRY_LAYER_MIN_POINTS points and is skipped for indices not much larger.
+const float ENTRY_LAYER_SAMPLE_RATE = 0.001f;
+const uint32_t ENTRY_LAYER_MIN_POINTS = 256;
+const uint32_t ENTRY_LAYER_NUM_SEEDS = 4;
+const uint32_t ENTRY_LAYER_SEARCH_LIST_SIZE = 32;
+
+// Entry centroids: k-means over this many sampled points per center picks
+// the medoids a disk search starts from
+const uint32_t ENTRY_CENTROIDS_SAMPLES_PER_CENTROID = 64;
+const uint32_t ENTRY_CENTROIDS_KMEANS_REPS = 12;
+
+// Searches track visited points with a 2-byte stamp per point in graphs of
+// up to this many points, and with a hash table sized from L and R above it
+const uint64_t VISITED_ARRAY_MAX_POINTS = 4 * 1024 * 1024;
+
+// Searches on a quantized store re-rank this many times K of their best
+// candidates with full precision distances
+const uint32_t QUANTIZED_RERANK_FACTOR = 3;
+
+// A PCA projected store learns its components from at most this many
+// evenly spaced points
+const uint32_t PCA_TRAINING_SAMPLE_SIZE = 100000;
+
+// Filtered searches check labels with a bitmap index instead of scanning the
+// labels of each point once points have this many labels on average
+const uint32_t LABEL_BITMAP_MIN_AVG_LABELS = 8;
+
+// Filtered disk searches scan the points of filters that at most this many
+// points match, and post-filter an unfiltered search for filters that at least
+// this fraction of the points match; 0 and values above 1 turn them off
+const uint32_t FILTER_SCAN_MAX_POINTS = 0;
+const float FILTER_POST_FILTER_MIN_FRACTION = 2.0f;
+
+// Nodes of the optimized in-memory layout take whole cache lines of this size
+const uint64_t CACHE_LINE_SIZE = 64;
+
+// Write-ahead log of a dynamic index: the writer commits a group every this
+// many microseconds unless each operation waits for its commit, or at once
+// when this many bytes are pending. Recovery replays inserts in batches of
+// up to WAL_REPLAY_BATCH_SIZE points.
+const uint32_t WAL_GROUP_COMMIT_US = 1000;
+const uint64_t WAL_GROUP_COMMIT_BYTES = 4 * 1024 * 1024;
+const uint32_t WAL_REPLAY_BATCH_SIZE = 4096;
 
 // SSD Index related limits
 const uint64_t MAX_GRAPH_DEGREE = 512;
 const uint64_t SECTOR_LEN = 4096;
 const uint64_t MAX_N_SECTOR_READS = 128;
+// Nodes each thread reads at a time when loading the static cache, in
+// load_cache_list and cache_bfs_levels.
+const uint64_t CACHE_READ_BLOCK_SIZE = 1024;
+// Size in sectors of the per-query buffer for speculative reads
+// (PQFlashIndex::set_speculative_reads), half of it for each of two hops.
+const uint64_t MAX_SPECULATIVE_SECTORS = 32;
+// Size in sectors of the per-query buffer into which the last hop of a search
+// with use_reorder_data also reads the full-precision vectors to rerank.
+const uint64_t MAX_REORDER_PREFETCH_SECTORS = 64;
+// Sectors of a disk index in each stripe unit when it is striped over several
+// drives. Only reads that cross a unit boundary are split between drives.
+const uint64_t STRIPE_SECTORS = 16;
+// Sectors in each block of a remote disk index, the unit it is fetched and
+// cached in. An object store returns 64 KB about as fast as 4 KB, and nodes
+// close in the graph are often close on disk.
+const uint64_t REMOTE_BLOCK_SECTORS = 16;
+// Blocks read ahead of each run of missed blocks, in the same ranged GET.
+const uint64_t REMOTE_READAHEAD_BLOCKS = 1;
+// Size of the read-through cache of a remote disk index, in RAM or in a file
+// on a local drive.
+const uint64_t REMOTE_CACHE_MB = 1024;
+// Ranged GETs a context of a remote reader keeps in flight at a time.
+const uint32_t REMOTE_MAX_CONNECTIONS = 32;
+
+// PQFlashIndex::knn_self_join() searches for this many consecutive nodes at a
+// time, so that the sectors they share are read once
+const uint64_t KNN_SELF_JOIN_BATCH_SIZE = 64;
 
 // following constants should always be specified, but are useful as a
 // sensible default at cli / python boundaries
@@ -0,0 +1,164 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cached_io.h"
+#include "defaults.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+class SectorFile;
+
+// The file that holds the reorder data of the disk index at disk_index_file
+// when it is kept apart from the graph, so that the graph sectors stay dense
+// and the full-precision vectors are only read to rerank.
+inline std::string get_disk_index_vectors_file(const std::string &disk_index_file)
+{
+    return disk_index_file + "_vectors";
+}
+
+// Whether a disk index can be laid out in sectors of sector_len bytes: a
+// power of two that direct I/O can read, from 512 bytes up to
+// defaults::SECTOR_LEN, so that the metadata fills whole sectors.
+inline bool is_valid_sector_len(uint64_t sector_len)
+{
+    return sector_len >= 512 && sector_len <= defaults::SECTOR_LEN && (sector_len & (sector_len - 1)) == 0;
+}
+
+// Bits of each neighbor id of a disk index of npts points when the ids are
+// bit-packed: enough for ids up to npts - 1
+inline uint32_t get_packed_id_bits(uint64_t npts)
+{
+    uint32_t bits = 1;
+    while (bits < 32 && ((uint64_t)1 << bits) < npts)
+        bits++;
+    return bits;
+}
+
+// Bytes taken by n ids packed into bits bits each: whole 32-bit words, and one
+// more that unpack_ids() may read past the last id
+inline uint64_t get_packed_ids_len(uint64_t n, uint32_t bits)
+{
+    return ((n * bits + 31) / 32 + 1) * sizeof(uint32_t);
+}
+
+// Packs the n ids into consecutive bits-bit fields of packed, lowest bits
+// first. packed must hold get_packed_ids_len(n, bits) zeroed bytes.
+DISKANN_DLLEXPORT void pack_ids(const uint32_t *ids, uint64_t n, uint32_t bits, uint32_t *packed);
+
+// Unpacks n ids written by pack_ids(), 8 at a time with AVX2 gathers.
+DISKANN_DLLEXPORT void unpack_ids(const uint32_t *packed, uint64_t n, uint32_t bits, uint32_t *ids);
+
+// Writes the sector layout of a disk index, as described in
+// create_disk_layout(), from adjacency lists handed to it in node order. The
+// coordinates of each node are read from base_file alongside, so a graph can
+// be laid out as it is produced without first being saved as an in-memory
+// index.
+//
+// Nodes are buffered into blocks of sectors that are assembled by all threads
+// and written with large direct (O_DIRECT on Linux) writes, each overlapping
+// the assembly of the next block. Nothing is opened or allocated until the
+// first nodes are added.
+class DiskLayoutWriter
+{
+  public:
+    // coord_size is the size in bytes of one coordinate of base_file. Graph
+    // nodes hold at most width neighbors. If reorder_data_file is given, its
+    // float vectors are appended after the graph sectors, or with
+    // separate_reorder_data written in the same sectors to the file named by
+    // get_disk_index_vectors_file(output_file). If nbr_codes_file is given,
+    // each node also holds the PQ codes from that file of its neighbors,
+    // after their ids. Nodes and reorder data are laid out in sectors of
+    // sector_len bytes, see is_valid_sector_len(); sectors smaller than
+    // defaults::SECTOR_LEN waste less of each read on small nodes. With
+    // pack_nbr_ids, the neighbor ids are bit-packed into
+    // get_packed_id_bits() bits each, so that more of them fit in a sector.
+    DISKANN_DLLEXPORT DiskLayoutWriter(const std::string &base_file, size_t coord_size, const std::string &output_file,
+                                       uint32_t width, const std::string &reorder_data_file = std::string(""),
+                                       bool separate_reorder_data = false,
+                                       const std::string &nbr_codes_file = std::string(""),
+                                       uint64_t sector_len = defaults::SECTOR_LEN, bool pack_nbr_ids = false);
+    DISKANN_DLLEXPORT ~DiskLayoutWriter();
+
+    DiskLayoutWriter(const DiskLayoutWriter &) = delete;
+    DiskLayoutWriter &operator=(const DiskLayoutWriter &) = delete;
+
+    // Adds the next num_nodes nodes of the graph. Node i has nnbrs[i]
+    // neighbors starting at nbrs + i * stride; lists longer than the width
+    // are truncated.
+    DISKANN_DLLEXPORT void add_nodes(const uint32_t *nnbrs, const uint32_t *nbrs, size_t stride, uint64_t num_nodes);
+
+    // Writes the remaining sectors, the reorder data and the metadata sector.
+    // Every point of the base file must have been added.
+    DISKANN_DLLEXPORT void finish(uint64_t medoid, uint64_t num_frozen_pts = 0, uint64_t frozen_loc = 0);
+
+    bool finished() const
+    {
+        return _finished;
+    }
+
+    uint64_t num_points() const
+    {
+        return _npts;
+    }
+
+  private:
+    // opens the files and allocates the buffers, on the first nodes added
+    void open();
+    void flush_block();
+    void write_async(const char *buf, uint64_t len);
+    void wait_for_write();
+
+    std::string _base_file;
+    std::string _output_file;
+    cached_ifstream _base_reader;
+    std::ifstream _reorder_data_reader;
+    std::unique_ptr<SectorFile> _file;
+
+    uint64_t _npts = 0;
+    uint64_t _ndims = 0;
+    size_t _coord_size = 0;
+    uint32_t _width = 0;
+    uint64_t _sector_len = defaults::SECTOR_LEN;
+    // bits of each packed neighbor id, 0 if they are stored as uint32s, and
+    // the bytes of the neighbor ids of a node
+    uint32_t _nbr_id_bits = 0;
+    uint64_t _nbr_ids_len = 0;
+    uint64_t _max_node_len = 0;
+    uint64_t _nnodes_per_sector = 0;
+    uint64_t _nsectors_per_node = 0;
+    uint64_t _ndims_reorder = 0;
+    bool _separate_reorder_data = false;
+    std::string _nbr_codes_file;
+    uint64_t _nbr_code_len = 0;
+    // the PQ codes of all points, loaded by open() when nodes hold them
+    std::unique_ptr<uint8_t[]> _nbr_codes;
+
+    // nodes and sectors per block
+    uint64_t _block_nodes = 0;
+    uint64_t _block_sectors = 0;
+
+    // nodes waiting in the current block
+    uint64_t _staged = 0;
+    uint64_t _nodes_added = 0;
+    std::vector<uint32_t> _staged_nnbrs;
+    std::vector<uint32_t> _staged_nbrs;
+    std::vector<char> _coords;
+
+    // two sector buffers, one being written while the other is assembled
+    char *_sector_bufs[2] = {nullptr, nullptr};
+    uint32_t _cur_buf = 0;
+    std::future<void> _pending_write;
+    uint64_t _write_offset = 0;
+    bool _finished = false;
+};
+} // namespace diskann
@@ -42,6 +42,8 @@ const uint32_t WARMUP_L = 20;
 const uint32_t NUM_KMEANS_REPS = 12;
 
 template <typename T, typename LabelT> class PQFlashIndex;
+class DiskLayoutWriter;
+class BuildManifest;
 
 DISKANN_DLLEXPORT double get_memory_budget(const std::string &mem_budget_str);
 DISKANN_DLLEXPORT double get_memory_budget(double search_ram_budget_in_gb);
@@ -61,19 +63,68 @@ DISKANN_DLLEXPORT T *load_warmup(const std::string &cache_warmup_file, uint64_t
                                  uint64_t warmup_aligned_dim);
 #endif
 
+// Merges the graphs built on overlapping shards into one graph of degree at
+// most max_degree, saved as an in-memory index at output_vamana. If
+// disk_layout is given, the merged graph is instead handed to it node by node
+// and output_vamana is not written.
 DISKANN_DLLEXPORT int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suffix,
                                    const std::string &idmaps_prefix, const std::string &idmaps_suffix,
                                    const uint64_t nshards, uint32_t max_degree, const std::string &output_vamana,
                                    const std::string &medoids_file, bool use_filters = false,
-                                   const std::string &labels_to_medoids_file = std::string(""));
+                                   const std::string &labels_to_medoids_file = std::string(""),
+                                   DiskLayoutWriter *disk_layout = nullptr);
 
 DISKANN_DLLEXPORT void extract_shard_labels(const std::string &in_label_file, const std::string &shard_ids_bin,
                                             const std::string &shard_label_file);
 
+// Everything needed to build the graph of one shard of
+// build_merged_vamana_index. The partitioning step writes one per shard, at
+// shard_prefix + "_job.txt", so that shards can be built by separate
+// processes or on other machines sharing the files; merge_shards then
+// collects their graphs.
+struct ShardBuildJob
+{
+    // shard_prefix + "_ids_uint32.bin" holds the ids of the shard's points in
+    // base_file, and the graph is saved at shard_prefix + "_mem.index"
+    std::string shard_prefix;
+    std::string base_file;
+    std::string label_file; // labels of base_file, for filtered builds
+    std::string universal_label;
+    diskann::Metric metric = diskann::Metric::L2;
+    uint32_t L = 0;
+    uint32_t R = 0;
+    uint32_t Lf = 0;
+    uint32_t num_threads = 0;
+    size_t build_pq_bytes = 0;
+    bool use_opq = false;
+    bool use_filters = false;
+    // build the graph with build_graph_on_gpu() where it can
+    bool use_gpu = false;
+    // key of the manifest the shard records its completion in
+    std::string build_key;
+};
+
+DISKANN_DLLEXPORT void save_shard_job(const std::string &job_file, const ShardBuildJob &job);
+DISKANN_DLLEXPORT ShardBuildJob load_shard_job(const std::string &job_file);
+
+// Builds and saves the graph of a shard, unless its manifest says it is built
+template <typename T> DISKANN_DLLEXPORT void build_shard(const ShardBuildJob &job);
+
 template <typename T>
 DISKANN_DLLEXPORT std::string preprocess_base_file(const std::string &infile, const std::string &indexPrefix,
                                                    diskann::Metric &distMetric);
 
+// Builds the Vamana graph of base_file at mem_index_path, in one go if it fits
+// in ram_budget and otherwise by merging graphs built on overlapping shards.
+// In the second case a given disk_layout receives the merged graph instead of
+// mem_index_path; disk_layout->finished() tells which happened.
+// A given manifest records the partition and the shards built, so that a
+// resumed build reuses them. If only_shards is set ("0,2,5-7", or "none" for
+// just the partition), only those shards are built and nothing is merged.
+// partition_balance > 0 balances the shards to within that fraction of the
+// average size (see partition_with_ram_budget()).
+// With gpu_build, graphs without filters or PQ distances are built by
+// build_graph_on_gpu() when a device is present.
 template <typename T, typename LabelT = uint32_t>
 DISKANN_DLLEXPORT int build_merged_vamana_index(std::string base_file, diskann::Metric _compareMetric, uint32_t L,
                                                 uint32_t R, double sampling_rate, double ram_budget,
@@ -82,7 +133,12 @@ DISKANN_DLLEXPORT int build_merged_vamana_index(std::string base_file, diskann::
                                                 uint32_t num_threads, bool use_filters = false,
                                                 const std::string &label_file = std::string(""),
                                                 const std::string &labels_to_medoids_file = std::string(""),
-                                                const std::string &universal_label = "", const uint32_t Lf = 0);
+                                                const std::string &universal_label = "", const uint32_t Lf = 0,
+                                                const bool minibatch_kmeans = false,
+                                                DiskLayoutWriter *disk_layout = nullptr,
+                                                BuildManifest *manifest = nullptr,
+                                                const std::string &only_shards = std::string(""),
+                                                const float partition_balance = 0, const bool gpu_build = false);
 
 template <typename T, typename LabelT>
 DISKANN_DLLEXPORT uint32_t optimize_beamwidth(std::unique_ptr<diskann::PQFlashIndex<T, LabelT>> &_pFlashIndex,
@@ -98,11 +154,150 @@ DISKANN_DLLEXPORT int build_disk_index(
     bool use_filters = false,
     const std::string &label_file = std::string(""), // default is empty string for no label_file
     const std::string &universal_label = "", const uint32_t filter_threshold = 0,
-    const uint32_t Lf = 0); // default is empty string for no universal label
+    const uint32_t Lf = 0, // default is empty string for no universal label
+    const bool reorder_layout = false,
+    const bool fast_scan_pq = false, // 4-bit (16-centroid) in-memory PQ codes scored with the fast-scan kernel
+    const float entry_layer_sample_rate = 0, // > 0 builds an entry layer over this fraction of the points
+    const uint32_t num_entry_centroids = 0, // > 0 replaces the medoids with this many k-means entry points
+    const bool minibatch_kmeans = false,    // mini-batch k-means when partitioning to fit the RAM budget
+    const bool resume = false,              // skip the stages recorded as done by an interrupted build
+    const std::string &only_shards = "");   // build only these shards of the graph, see build_merged_vamana_index
+
+// build_disk_index() on the num_points vectors of dim coordinates at data
+// rather than on a data file. The vectors are read in place through a
+// MemoryBinFile registered for the length of the build, so they are neither
+// written out nor copied, except where the build transforms them (MIPS and
+// cosine) or partitions them into shards. data may be memory the caller
+// holds or a mapping of a file; it is only read.
+template <typename T, typename LabelT = uint32_t>
+DISKANN_DLLEXPORT int build_disk_index_from_memory(const T *data, size_t num_points, size_t dim,
+                                                   const char *indexFilePath, const char *indexBuildParameters,
+                                                   diskann::Metric compareMetric, bool use_opq = false,
+                                                   const std::string &codebook_prefix = "", bool use_filters = false,
+                                                   const std::string &label_file = std::string(""),
+                                                   const std::string &universal_label = "",
+                                                   const uint32_t filter_threshold = 0, const uint32_t Lf = 0);
+
+// Builds an in-memory Vamana graph over a random sample of about sample_rate
+// of the points in data_file and saves it at entry_layer_path, with the
+// sampled row ids in entry_layer_path + "_ids.bin". PQFlashIndex searches it
+// to choose per-query start points instead of scanning the centroids.
+template <typename T>
+DISKANN_DLLEXPORT void build_disk_entry_layer(const std::string &data_file, const std::string &entry_layer_path,
+                                              const double sample_rate, const uint32_t num_threads);
+
+// Runs k-means with num_centroids centers over a sample of data_file and
+// writes, for every non-empty cluster, its center to centroids_path and the
+// sampled row closest to the center to medoids_path. PQFlashIndex starts each
+// search from the medoids of the centers closest to the query.
+template <typename T>
+DISKANN_DLLEXPORT void build_disk_entry_centroids(const std::string &data_file, const std::string &medoids_path,
+                                                  const std::string &centroids_path, const uint32_t num_centroids);
+
+// Renumbers the nodes of the Vamana graph in mem_index_file in BFS order from
+// its entry point and rewrites the file in that order, so that nodes packed
+// into one sector by create_disk_layout() are mostly graph neighbors.
+// new_to_old[i] receives the original id of new node i.
+//
+// With labels_file, the formatted labels of the nodes (one line of comma
+// separated integer labels per node), the nodes are first grouped by the
+// rarest of their labels, so that the sectors a filtered search for a label
+// reads hold mostly nodes that pass it. The groups follow each other in the
+// order the BFS reaches them, and each is in BFS order within itself.
+DISKANN_DLLEXPORT void reorder_graph_for_locality(const std::string &mem_index_file, std::vector<uint32_t> &new_to_old,
+                                                  const std::string &labels_file = std::string(""));
+
+// Reports the nodes of the Vamana graph in mem_index_file that are weakly
+// reachable: those with fewer than min_in_degree in-edges, and those more
+// than max_hops hops from its start and the ids in medoids_file, if it
+// exists. With repair, each of them gets edges from the nodes closest to it
+// that a greedy search for it with list size L visits, preferring nodes
+// within max_hops - 1 hops, until it has min_in_degree in-edges and is within
+// max_hops. No node gets more than max_degree neighbors, the width of the
+// graph if 0; a full node drops its longest redundant edge instead, one to a
+// node another of its neighbors links to as well. Distances are L2 between the rows of data_file, the
+// vectors of the graph as stored in a disk index. The graph is rewritten in
+// place. Returns the number of edges added.
+template <typename T>
+DISKANN_DLLEXPORT uint64_t repair_graph_connectivity(const std::string &mem_index_file, const std::string &data_file,
+                                                     const std::string &medoids_file, const uint32_t min_in_degree,
+                                                     const uint32_t max_hops, uint32_t max_degree, const uint32_t L,
+                                                     const bool repair);
+
+// Writes the rows of the .bin file in_file to out_file in the order given by
+// new_to_old, using a bounded amount of memory.
+template <typename T>
+DISKANN_DLLEXPORT void permute_bin_rows(const std::string &in_file, const std::string &out_file,
+                                        const std::vector<uint32_t> &new_to_old);
+
+// Collapses the exact and near-duplicate rows of the .bin file base_file:
+// rows hashed into the same bucket by random hyperplanes, and within radius
+// (L2) of an earlier row of the bucket, are represented by that row. A radius
+// of 0 collapses exact duplicates only. out_file receives the representative
+// rows in their order, which become the nodes of the index, and
+// duplicates_file the node of every row of base_file. Returns the number of
+// nodes.
+template <typename T>
+DISKANN_DLLEXPORT size_t collapse_duplicates(const std::string &base_file, const std::string &out_file,
+                                             const std::string &duplicates_file, const float radius);
+
+DISKANN_DLLEXPORT void permute_text_lines(const std::string &in_file, const std::string &out_file,
+                                          const std::vector<uint32_t> &new_to_old);
+
+DISKANN_DLLEXPORT void remap_ids_in_text_file(const std::string &file, const std::vector<uint32_t> &old_to_new,
+                                              bool first_token_is_id);
 
 template <typename T>
 DISKANN_DLLEXPORT void create_disk_layout(const std::string base_file, const std::string mem_index_file,
                                           const std::string output_file,
-                                          const std::string reorder_data_file = std::string(""));
+                                          const std::string reorder_data_file = std::string(""),
+                                          const bool separate_reorder_data = false,
+                                          const std::string nbr_codes_file = std::string(""),
+                                          const uint64_t sector_len = defaults::SECTOR_LEN,
+                                          const bool pack_nbr_ids = false);
+
+// The values of the metadata sector of the disk index at disk_index_path, as
+// written by create_disk_layout()
+DISKANN_DLLEXPORT std::vector<uint64_t> load_disk_index_metadata(const std::string &disk_index_path);
+
+// The number of PQ chunks of the neighbor codes stored in the nodes of a disk
+// index with metadata meta, or 0 if its nodes hold none
+DISKANN_DLLEXPORT uint64_t get_inline_pq_chunks(const std::vector<uint64_t> &meta);
+
+// The length of the sectors the nodes of a disk index with metadata meta are
+// laid out in
+DISKANN_DLLEXPORT uint64_t get_disk_sector_len(const std::vector<uint64_t> &meta);
+
+// The bits of each neighbor id in the nodes of a disk index with metadata
+// meta, or 0 if they are not packed
+DISKANN_DLLEXPORT uint64_t get_packed_nbr_id_bits(const std::vector<uint64_t> &meta);
+
+// Writes the graph and the full precision vectors of the disk index at
+// disk_index_path as an in-memory index at mem_index_path, which Index::load()
+// reads. With add_frozen_point, a disk index without a frozen point gets a
+// copy of its medoid as one, as dynamic indices require. Returns the number
+// of points written, including any frozen point.
+template <typename T>
+DISKANN_DLLEXPORT uint64_t disk_index_to_mem_index(const std::string &disk_index_path,
+                                                   const std::string &mem_index_path,
+                                                   const bool add_frozen_point = false);
+
+// Number of centers and chunks of the PQ pivots file at pq_pivots_path, and
+// whether it has an OPQ rotation
+DISKANN_DLLEXPORT void get_pq_pivots_metadata(const std::string &pq_pivots_path, uint32_t &num_centers,
+                                              uint32_t &num_chunks, bool &use_opq);
+
+// Adds the points of new_data_file to the full precision disk index at
+// index_prefix without rebuilding it. The graph is read back from the disk
+// index, the new points are inserted into it by search and prune with list
+// size L and the given alpha, along with their reverse edges, and only the
+// sectors whose nodes changed are rewritten in place. The new points get the
+// ids following those of the base, and are compressed with the existing PQ
+// pivots. Indices with filters, frozen points, PQ compressed disk vectors or
+// reorder data are not supported.
+template <typename T>
+DISKANN_DLLEXPORT int append_to_disk_index(const std::string &index_prefix, const std::string &new_data_file,
+                                           const diskann::Metric compareMetric, const uint32_t L, const float alpha,
+                                           const uint32_t num_threads);
 
 } // namespace diskann
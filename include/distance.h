@@ -1,5 +1,6 @@
 #pragma once
 #include "windows_customizations.h"
+#include "half_precision.h"
 #include <cstring>
 
 namespace diskann
@@ -9,7 +10,10 @@ enum Metric
     L2 = 0,
     INNER_PRODUCT = 1,
     COSINE = 2,
-    FAST_L2 = 3
+    FAST_L2 = 3,
+    // on uint8 vectors of packed bits, eight dimensions to a byte: the number
+    // of bits that differ
+    HAMMING = 4
 };
 
 template <typename T> class Distance
@@ -26,6 +30,12 @@ template <typename T> class Distance
     DISKANN_DLLEXPORT virtual float compare(const T *a, const T *b, const float normA, const float normB,
                                             uint32_t length) const;
 
+    // compare(a, b, length) if it is at most bound, and otherwise any value
+    // above bound. The L2 kernels add up the distance blockwise and return
+    // as soon as the partial sum exceeds the bound; within the bound the
+    // result is that of compare() to the bit. Other metrics compare in full.
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const T *a, const T *b, uint32_t length, float bound) const;
+
     // For MIPS, normalization adds an extra dimension to the vectors.
     // This function lets callers know if the normalization process
     // changes the dimension.
@@ -87,6 +97,8 @@ class DistanceL2Int8 : public Distance<int8_t>
     {
     }
     DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t size) const;
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const int8_t *a, const int8_t *b, uint32_t length,
+                                                       float bound) const;
 };
 
 // AVX implementations. Borrowed from HNSW code.
@@ -120,6 +132,8 @@ class DistanceL2Float : public Distance<float>
 #else
     DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t size) const __attribute__((hot));
 #endif
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const float *a, const float *b, uint32_t length,
+                                                       float bound) const;
 };
 
 class AVXDistanceL2Float : public Distance<float>
@@ -156,6 +170,48 @@ class DistanceL2UInt8 : public Distance<uint8_t>
     {
     }
     DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t size) const;
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const uint8_t *a, const uint8_t *b, uint32_t length,
+                                                       float bound) const;
+};
+
+// Cosine and inner product on bytes, vectorized with AVX2 where the build
+// enables it; the integer sums are exact either way.
+class DistanceCosineUInt8 : public Distance<uint8_t>
+{
+  public:
+    DistanceCosineUInt8() : Distance<uint8_t>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+class DistanceInnerProductInt8 : public Distance<int8_t>
+{
+  public:
+    DistanceInnerProductInt8() : Distance<int8_t>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+};
+
+class DistanceInnerProductUInt8 : public Distance<uint8_t>
+{
+  public:
+    DistanceInnerProductUInt8() : Distance<uint8_t>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+// Hamming distance on bit-packed vectors of length bytes, with the popcounts
+// by nibble lookup under AVX2 and vcnt on NEON
+class DistanceHammingUInt8 : public Distance<uint8_t>
+{
+  public:
+    DistanceHammingUInt8() : Distance<uint8_t>(diskann::Metric::HAMMING)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
 };
 
 template <typename T> class DistanceInnerProduct : public Distance<T>
@@ -230,6 +286,294 @@ class AVXNormalizedCosineDistanceFloat : public Distance<float>
                                                     float *scratch_query_vector) override;
 };
 
+// AVX-512 implementations. get_distance_function() picks them at run time on
+// CPUs that support them; the binary itself only needs AVX2. Tails are masked,
+// so unlike the AVX2 versions they accept any length.
+class AVX512DistanceL2Float : public Distance<float>
+{
+  public:
+    AVX512DistanceL2Float() : Distance<float>(diskann::Metric::L2)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const;
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const float *a, const float *b, uint32_t length,
+                                                       float bound) const;
+};
+
+class AVX512DistanceInnerProductFloat : public Distance<float>
+{
+  public:
+    AVX512DistanceInnerProductFloat() : Distance<float>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const;
+};
+
+class AVX512DistanceCosineFloat : public Distance<float>
+{
+  public:
+    AVX512DistanceCosineFloat() : Distance<float>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const;
+};
+
+class AVX512NormalizedCosineDistanceFloat : public AVXNormalizedCosineDistanceFloat
+{
+  private:
+    AVX512DistanceInnerProductFloat _innerProduct512;
+
+  public:
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const
+    {
+        return 1.0f + _innerProduct512.compare(a, b, length);
+    }
+};
+
+// AVX-512 VNNI byte kernels: bytes are widened to int16 and multiplied and
+// accumulated into int32 with vpdpwssd, so results match the scalar versions
+// exactly.
+class AVX512VNNIDistanceL2Int8 : public Distance<int8_t>
+{
+  public:
+    AVX512VNNIDistanceL2Int8() : Distance<int8_t>(diskann::Metric::L2)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const int8_t *a, const int8_t *b, uint32_t length,
+                                                       float bound) const;
+};
+
+class AVX512VNNIDistanceCosineInt8 : public Distance<int8_t>
+{
+  public:
+    AVX512VNNIDistanceCosineInt8() : Distance<int8_t>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+};
+
+class AVX512VNNIDistanceL2UInt8 : public Distance<uint8_t>
+{
+  public:
+    AVX512VNNIDistanceL2UInt8() : Distance<uint8_t>(diskann::Metric::L2)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const uint8_t *a, const uint8_t *b, uint32_t length,
+                                                       float bound) const;
+};
+
+class AVX512VNNIDistanceCosineUInt8 : public Distance<uint8_t>
+{
+  public:
+    AVX512VNNIDistanceCosineUInt8() : Distance<uint8_t>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+class AVX512VNNIDistanceInnerProductInt8 : public Distance<int8_t>
+{
+  public:
+    AVX512VNNIDistanceInnerProductInt8() : Distance<int8_t>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+};
+
+class AVX512VNNIDistanceInnerProductUInt8 : public Distance<uint8_t>
+{
+  public:
+    AVX512VNNIDistanceInnerProductUInt8() : Distance<uint8_t>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+// Hamming distance with AVX-512 VPOPCNTDQ, 64 bytes per popcount
+class AVX512DistanceHammingUInt8 : public Distance<uint8_t>
+{
+  public:
+    AVX512DistanceHammingUInt8() : Distance<uint8_t>(diskann::Metric::HAMMING)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+// SVE implementations for the AArch64 CPUs that have it (Graviton3,
+// Neoverse V1 and V2), built from distance_sve.cpp when the compiler supports
+// SVE (which defines DISKANN_HAS_SVE) and picked by get_distance_function()
+// at run time. The loops are predicated, so they accept any length, and the
+// byte kernels accumulate with sdot and udot, exactly as the scalar versions.
+class SVEDistanceL2Float : public Distance<float>
+{
+  public:
+    SVEDistanceL2Float() : Distance<float>(diskann::Metric::L2)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const;
+    DISKANN_DLLEXPORT virtual float compare_with_bound(const float *a, const float *b, uint32_t length,
+                                                       float bound) const;
+};
+
+class SVEDistanceInnerProductFloat : public Distance<float>
+{
+  public:
+    SVEDistanceInnerProductFloat() : Distance<float>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const;
+};
+
+class SVEDistanceCosineFloat : public Distance<float>
+{
+  public:
+    SVEDistanceCosineFloat() : Distance<float>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const float *a, const float *b, uint32_t length) const;
+};
+
+class SVEDistanceL2Int8 : public Distance<int8_t>
+{
+  public:
+    SVEDistanceL2Int8() : Distance<int8_t>(diskann::Metric::L2)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+};
+
+class SVEDistanceInnerProductInt8 : public Distance<int8_t>
+{
+  public:
+    SVEDistanceInnerProductInt8() : Distance<int8_t>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+};
+
+class SVEDistanceCosineInt8 : public Distance<int8_t>
+{
+  public:
+    SVEDistanceCosineInt8() : Distance<int8_t>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const int8_t *a, const int8_t *b, uint32_t length) const;
+};
+
+class SVEDistanceL2UInt8 : public Distance<uint8_t>
+{
+  public:
+    SVEDistanceL2UInt8() : Distance<uint8_t>(diskann::Metric::L2)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+class SVEDistanceInnerProductUInt8 : public Distance<uint8_t>
+{
+  public:
+    SVEDistanceInnerProductUInt8() : Distance<uint8_t>(diskann::Metric::INNER_PRODUCT)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+class SVEDistanceCosineUInt8 : public Distance<uint8_t>
+{
+  public:
+    SVEDistanceCosineUInt8() : Distance<uint8_t>(diskann::Metric::COSINE)
+    {
+    }
+    DISKANN_DLLEXPORT virtual float compare(const uint8_t *a, const uint8_t *b, uint32_t length) const;
+};
+
+// Distances on float16 and bfloat16 vectors (T is one of the two). Each
+// class picks its kernel once, in the constructor: AVX-512 where the CPU has
+// it, with AVX-512 BF16 dot products for bfloat16 inner product and cosine
+// when available, and AVX2 otherwise (F16C conversions for float16), or NEON
+// on AArch64. All accumulate in float and accept any length.
+template <typename T> class DistanceL2Half : public Distance<T>
+{
+  public:
+    DISKANN_DLLEXPORT DistanceL2Half();
+    DISKANN_DLLEXPORT virtual float compare(const T *a, const T *b, uint32_t length) const
+    {
+        return _kernel(a, b, length);
+    }
+
+  private:
+    float (*_kernel)(const T *, const T *, uint32_t);
+};
+
+template <typename T> class DistanceInnerProductHalf : public Distance<T>
+{
+  public:
+    DISKANN_DLLEXPORT DistanceInnerProductHalf();
+    // negated, as for the other inner product distances
+    DISKANN_DLLEXPORT virtual float compare(const T *a, const T *b, uint32_t length) const
+    {
+        return -_kernel(a, b, length);
+    }
+
+  private:
+    float (*_kernel)(const T *, const T *, uint32_t);
+};
+
+template <typename T> class DistanceCosineHalf : public Distance<T>
+{
+  public:
+    DISKANN_DLLEXPORT DistanceCosineHalf();
+    DISKANN_DLLEXPORT virtual float compare(const T *a, const T *b, uint32_t length) const
+    {
+        return _kernel(a, b, length);
+    }
+
+  private:
+    float (*_kernel)(const T *, const T *, uint32_t);
+};
+
 template <typename T> Distance<T> *get_distance_function(Metric m);
 
+// A distance kernel compiled for one vector length, called directly instead
+// of through Distance<T>::compare.
+template <typename T> using FixedDimDistanceFn = float (*)(const T *a, const T *b);
+
+// Returns the fixed-length kernel computing the same distance as
+// get_distance_function<T>(m) on vectors of exactly dim elements (the aligned
+// dimension), or nullptr if none is compiled for this type, metric and
+// length. Kernels exist for float L2 and inner product on the common
+// embedding sizes 96, 100 (padded to 104), 128, 384, 768 and 1536.
+template <typename T> FixedDimDistanceFn<T> get_fixed_dim_distance_function(Metric m, uint32_t dim);
+
+// A fixed-length kernel with the contract of Distance<T>::compare_with_bound.
+template <typename T> using FixedDimBoundedDistanceFn = float (*)(const T *a, const T *b, float bound);
+
+// Returns the bounded counterpart of get_fixed_dim_distance_function(m, dim),
+// which within the bound agrees with it to the bit, or nullptr. Kernels
+// exist for float L2 on the same lengths.
+template <typename T>
+FixedDimBoundedDistanceFn<T> get_fixed_dim_bounded_distance_function(Metric m, uint32_t dim);
+
+// Computes the distances from query to the four vectors points[0..3], all of
+// the given length, into distances[0..3].
+template <typename T>
+using Batch4DistanceFn = void (*)(const T *query, const T *const *points, uint32_t length, float *distances);
+
+// Returns the four-point kernel computing the same distance as
+// get_distance_function<T>(m), or nullptr if none is compiled for this type
+// and metric. Kernels exist for float L2 and inner product.
+template <typename T> Batch4DistanceFn<T> get_batch4_distance_function(Metric m);
+
+// Computes the distance from a float query to a vector of T, both of the
+// given length, without rounding the query to T.
+template <typename T> using MixedDistanceFn = float (*)(const float *query, const T *b, uint32_t length);
+
+// Returns the kernel computing the distance of get_distance_function<T>(m)
+// between a float query and a vector of T, or nullptr if none exists for
+// this type and metric. Kernels exist for int8 and uint8 with L2, cosine and
+// inner product.
+template <typename T> MixedDistanceFn<T> get_mixed_distance_function(Metric m);
+
 } // namespace diskann
@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tsl/robin_map.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// A concurrent, fixed-budget cache of on-disk node records keyed by their
+// starting sector. Unlike the static nhood/coord caches of PQFlashIndex it is
+// filled while serving: every record read from SSD is offered to it, and a
+// TinyLFU admission filter (a count-min sketch of recent accesses, halved
+// periodically so it follows a drifting workload) only lets a record in if it
+// has been requested more often than the CLOCK victim it would replace.
+//
+// The cache is split into shards, each guarded by its own mutex, so threads
+// that touch different sectors rarely contend.
+class DynamicSectorCache
+{
+  public:
+    // budget_bytes bounds the memory used for cached records; each entry holds
+    // entry_len bytes (the read size of one node record).
+    DISKANN_DLLEXPORT DynamicSectorCache(uint64_t budget_bytes, uint64_t entry_len, uint32_t num_shards = 64);
+    DISKANN_DLLEXPORT ~DynamicSectorCache();
+
+    // copies the record starting at sector into out and returns true on a hit;
+    // hits and misses both count towards the sector's admission frequency
+    DISKANN_DLLEXPORT bool lookup(uint64_t sector, char *out);
+
+    // offers a record just read from disk for admission
+    DISKANN_DLLEXPORT void admit(uint64_t sector, const char *data);
+
+    DISKANN_DLLEXPORT uint64_t capacity() const;
+    // bytes of the records, the index and the admission sketch
+    DISKANN_DLLEXPORT uint64_t memory_size() const;
+    DISKANN_DLLEXPORT uint64_t num_hits() const;
+    DISKANN_DLLEXPORT uint64_t num_misses() const;
+
+  private:
+    struct Shard;
+
+    Shard &shard_for(uint64_t sector);
+
+    uint64_t _entry_len;
+    uint64_t _capacity = 0;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+};
+} // namespace diskann
@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Runs the parallel loops of the build and maintenance phases of the indices
+// (Index::link(), prune_all_neighbors(), consolidate_deletes() and
+// PQFlashIndex::generate_cache_list_from_sample_queries()). A service can
+// implement it over its own thread pool, so that index builds share its cores
+// instead of starting OpenMP threads of their own next to it.
+class Executor
+{
+  public:
+    virtual ~Executor() = default;
+
+    // Calls body(begin, end) on ranges of at most grain items that together
+    // cover [0, count), on up to max_threads threads at once (0 for as many
+    // as the executor has) including the calling one, and returns once all
+    // of them ran. If body throws, the ranges not started yet are skipped and
+    // the first exception is rethrown. body must not depend on the thread it
+    // runs on.
+    virtual void parallel_for(uint64_t count, uint64_t grain, const std::function<void(uint64_t, uint64_t)> &body,
+                              uint32_t max_threads = 0) = 0;
+};
+
+// Each thread of a loop starts on its own block of the range and takes grain
+// items at a time from its front; a thread done with its block takes the back
+// half of what is left of another's. Loops called at once from several
+// threads share the workers, and a loop called from within a body runs on the
+// calling worker along with any that are idle.
+class WorkStealingExecutor : public Executor
+{
+  public:
+    // num_threads counts the thread calling parallel_for(), so num_threads - 1
+    // workers are started (0 for one thread per core)
+    DISKANN_DLLEXPORT WorkStealingExecutor(uint32_t num_threads = 0);
+    DISKANN_DLLEXPORT ~WorkStealingExecutor();
+
+    DISKANN_DLLEXPORT void parallel_for(uint64_t count, uint64_t grain,
+                                        const std::function<void(uint64_t, uint64_t)> &body,
+                                        uint32_t max_threads = 0) override;
+
+    uint32_t get_num_threads() const
+    {
+        return (uint32_t)_workers.size() + 1;
+    }
+
+  private:
+    struct Loop;
+    void run_worker();
+
+    std::mutex _lock;
+    std::condition_variable _cv;
+    // loops with blocks no thread has joined yet
+    std::list<std::shared_ptr<Loop>> _loops;
+    bool _stopping = false;
+    std::vector<std::thread> _workers;
+};
+
+// The executor of indices that were not given one: a WorkStealingExecutor
+// with one thread per core, started on first use
+DISKANN_DLLEXPORT std::shared_ptr<Executor> get_default_executor();
+} // namespace diskann
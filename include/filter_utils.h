@@ -54,6 +54,22 @@ template <typename T>
 DISKANN_DLLEXPORT void generate_label_indices(path input_data_path, path final_index_path_prefix, label_set all_labels,
                                               unsigned R, unsigned L, float alpha, unsigned num_threads);
 
+// Builds the graph of a stitched index within about memory_budget_gb of RAM
+// and saves it to final_index_path_prefix. The vectors of each label are read
+// from the memory-mapped base file by id, the label graphs are built
+// concurrently while their estimated footprints fit the budget, and their
+// edges are spilled to files by range of source points. The ranges are then
+// merged one at a time: their edges deduplicated, the neighbours of every
+// point pruned to stitched_R, and the adjacency lists appended to the graph.
+// label_entry_points gets the start point of each label graph.
+template <typename T>
+DISKANN_DLLEXPORT void build_stitched_index_streaming(path input_data_path, path final_index_path_prefix,
+                                                      const std::vector<label_set> &point_ids_to_labels,
+                                                      label_set all_labels, unsigned R, unsigned L, float alpha,
+                                                      unsigned stitched_R, unsigned num_threads,
+                                                      double memory_budget_gb,
+                                                      tsl::robin_map<std::string, uint32_t> &label_entry_points);
+
 DISKANN_DLLEXPORT load_label_index_return_values load_label_index(path label_index_path,
                                                                   uint32_t label_number_of_points);
 
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <memory>
+#include "abstract_graph_store.h"
+#include "memory_policy.h"
+
+namespace diskann
+{
+class MemoryMapper;
+
+// Graph store that keeps every adjacency list in one contiguous array with a
+// fixed stride of (max degree + 1) uint32 slots per node: the first slot holds
+// the degree and the rest the neighbour ids. There is no per-node allocation,
+// and the array is backed by huge pages where the OS provides them, so a
+// neighbour lookup during search is a single offset computation.
+//
+// The stride is fixed at construction from reserve_graph_degree (or grown by
+// load() to fit the graph on disk); setting or adding more neighbours than it
+// holds throws.
+//
+// store_mmap() writes the array as is after a page-sized header, and
+// load_mmap() maps such a file and uses it in place. A mapped graph is copied
+// into private memory before its first modification, which is not
+// synchronised, so a mapped store must only be searched concurrently.
+class FlatGraphStore : public AbstractGraphStore
+{
+  public:
+    FlatGraphStore(const size_t total_pts, const size_t reserve_graph_degree);
+    ~FlatGraphStore();
+
+    // returns tuple of <nodes_read, start, num_frozen_points>
+    virtual std::tuple<uint32_t, uint32_t, size_t> load(const std::string &index_path_prefix,
+                                                        const size_t num_points) override;
+    virtual int store(const std::string &index_path_prefix, const size_t num_points, const size_t num_frozen_points,
+                      const uint32_t start, const size_t frozen_location = 0) override;
+    virtual std::tuple<uint32_t, uint32_t, size_t> load_mmap(const std::string &filename) override;
+    virtual int store_mmap(const std::string &filename, const size_t num_points, const size_t num_frozen_points,
+                           const uint32_t start) override;
+
+    virtual NeighbourList get_neighbours(const location_t i) const override;
+    virtual void prefetch_neighbours(const location_t i) const override;
+    virtual void add_neighbour(const location_t i, location_t neighbour_id) override;
+    virtual void clear_neighbours(const location_t i) override;
+    virtual void swap_neighbours(const location_t a, location_t b) override;
+
+    virtual void set_neighbours(const location_t i, std::vector<location_t> &neighbors) override;
+
+    virtual size_t resize_graph(const size_t new_size) override;
+    virtual void clear_graph() override;
+
+    virtual size_t get_max_range_of_graph() override;
+    virtual uint32_t get_max_observed_degree() override;
+    virtual size_t memory_size() const override;
+
+  private:
+    uint32_t *node_slots(const location_t i) const
+    {
+        return _graph + (size_t)i * _stride;
+    }
+
+    // replaces the array with one of num_nodes x stride slots, keeping the
+    // adjacency lists of the first min(num_nodes, current nodes) nodes. With
+    // reserve_nodes, the array has room for that many nodes where the OS can
+    // reserve it.
+    void reallocate(size_t num_nodes, size_t stride, size_t reserve_nodes = 0);
+    void free_graph();
+    void detach_mapping()
+    {
+        if (_mapping != nullptr)
+            reallocate(_num_nodes, _stride);
+    }
+
+    uint32_t *_graph = nullptr;
+    size_t _num_nodes = 0;
+    size_t _stride = 0;
+    // owns _graph unless it is mapped
+    LargeBuffer _buffer;
+    // set when _graph points into a file written by store_mmap()
+    std::unique_ptr<MemoryMapper> _mapping;
+
+    size_t _max_range_of_graph = 0;
+    uint32_t _max_observed_degree = 0;
+};
+
+} // namespace diskann
@@ -0,0 +1,167 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aligned_file_reader.h"
+#include "index.h"
+#include "pq_flash_index.h"
+#include "tsl/robin_map.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+struct FreshDiskIndexParameters
+{
+    // graph of the in-memory delta that takes the inserts
+    uint32_t delta_R = 64;
+    uint32_t delta_L = 100;
+    float delta_alpha = 1.2f;
+    // points the delta is allocated for; it grows past this if needed
+    size_t delta_capacity = 1000000;
+
+    // a merge starts in the background once the delta holds this many
+    // points; 0 only merges when start_merge() or merge() is called
+    size_t merge_threshold = 0;
+    // list size and alpha for linking the delta into the disk index graph
+    uint32_t merge_L = 100;
+    float merge_alpha = 1.2f;
+
+    // threads for building and merging, and for searching each disk index
+    // (0 for all cores)
+    uint32_t num_threads = 0;
+    // nodes around the entry point cached in memory for each disk index
+    uint64_t num_nodes_to_cache = 0;
+};
+
+// A disk index that takes inserts and deletes, in the manner of FreshDiskANN.
+//
+// Inserts go to a dynamic in-memory Index (the delta) and are searchable as
+// soon as insert() returns. Deletes are kept in a list that is applied to the
+// results of the disk index at query time. A merge folds the delta and the
+// deletes into a new disk index: the graph of the current one is read back,
+// the deleted points are removed from it and their neighbors repaired, the
+// delta points are inserted, and the result is laid out on disk next to the
+// current index with PQ codes from the original pivots. Searches keep using
+// the current disk index and the delta being merged, which no longer takes
+// inserts, until the new index replaces them in one step.
+//
+// Points are identified by uint32 ids. Those of the original index are its
+// point ids; inserting an id that is already present replaces the point. The
+// delta is only in memory, so points inserted since the last merge are lost
+// if the process ends without merging. Only the L2 metric is supported, on
+// disk indices with full precision vectors and without filters.
+template <typename T> class FreshDiskIndex
+{
+  public:
+    // Opens the disk index at index_prefix, as built by build_disk_index(), or
+    // the latest merge of it. make_reader creates the file reader of each disk
+    // index; the platform's default reader is used if it is empty.
+    DISKANN_DLLEXPORT FreshDiskIndex(const std::string &index_prefix, const FreshDiskIndexParameters &params,
+                                     std::function<std::shared_ptr<AlignedFileReader>()> make_reader = nullptr);
+
+    // Waits for a running merge
+    DISKANN_DLLEXPORT ~FreshDiskIndex();
+
+    FreshDiskIndex(const FreshDiskIndex &) = delete;
+    FreshDiskIndex &operator=(const FreshDiskIndex &) = delete;
+
+    // Inserts point with the given id, replacing any point with that id.
+    // Returns 0 on success.
+    DISKANN_DLLEXPORT int insert(const T *point, const uint32_t id);
+
+    // Deletes the point with the given id, if there is one
+    DISKANN_DLLEXPORT void lazy_delete(const uint32_t id);
+
+    // Writes the ids and distances of up to K nearest points to query and
+    // returns their number. L and beam_width are used for the disk index,
+    // L for the deltas as well.
+    DISKANN_DLLEXPORT size_t search(const T *query, const uint64_t K, const uint32_t L, const uint32_t beam_width,
+                                    uint32_t *ids, float *distances, QueryStats *stats = nullptr);
+
+    // Starts a merge on a background thread. Returns false if one is already
+    // running or there is nothing to merge.
+    DISKANN_DLLEXPORT bool start_merge();
+
+    // Merges on the calling thread, after any running merge
+    DISKANN_DLLEXPORT void merge();
+
+    // Waits for a merge started by start_merge(), and rethrows its error
+    DISKANN_DLLEXPORT void wait_for_merge();
+
+    // Points inserted and not yet merged
+    DISKANN_DLLEXPORT size_t get_delta_size();
+
+    // Deletes and replacements not yet merged
+    DISKANN_DLLEXPORT size_t get_num_pending_deletes();
+
+    // Merges completed since the index was built
+    DISKANN_DLLEXPORT uint64_t get_generation();
+
+  private:
+    using Delta = Index<T, uint32_t, uint32_t>;
+
+    // a disk index and the id of each of its nodes
+    struct DiskGeneration
+    {
+        uint64_t number = 0;
+        std::string prefix;
+        std::shared_ptr<AlignedFileReader> reader;
+        std::unique_ptr<PQFlashIndex<T>> index;
+        // ids of the nodes of merged indices; the original index maps its
+        // results itself
+        std::vector<uint32_t> ids;
+    };
+
+    // a delta that no longer takes inserts, waiting to be merged
+    struct FrozenDelta
+    {
+        std::shared_ptr<Delta> index;
+        // deletes with a later sequence number also apply to it
+        uint64_t sequence;
+    };
+
+    std::string generation_prefix(uint64_t number) const;
+    std::shared_ptr<DiskGeneration> open_generation(uint64_t number);
+    std::shared_ptr<Delta> create_delta();
+    void merge_deltas();
+    std::shared_ptr<DiskGeneration> build_generation(const std::shared_ptr<DiskGeneration> &disk,
+                                                     const std::vector<FrozenDelta> &deltas,
+                                                     const tsl::robin_map<uint32_t, uint64_t> &deletes);
+
+    std::string _index_prefix;
+    FreshDiskIndexParameters _params;
+    std::function<std::shared_ptr<AlignedFileReader>()> _make_reader;
+    uint32_t _num_threads;
+    size_t _dim = 0;
+    std::vector<T> _medoid;
+
+    // guards the indices and the deletes. Searches, inserts and deletes hold
+    // it shared; a merge holds it exclusively only to swap the indices.
+    std::shared_timed_mutex _state_lock;
+    std::shared_ptr<DiskGeneration> _disk;
+    std::shared_ptr<Delta> _delta;
+    std::vector<FrozenDelta> _frozen_deltas;
+
+    // sequence number of the latest delete or replacement of each id not yet
+    // merged into the disk index
+    std::mutex _deletes_lock;
+    tsl::robin_map<uint32_t, uint64_t> _deletes;
+    uint64_t _sequence = 0;
+
+    // one merge at a time
+    std::mutex _merge_lock;
+    std::thread _merge_thread;
+    std::atomic<bool> _merging{false};
+    std::exception_ptr _merge_error;
+};
+} // namespace diskann
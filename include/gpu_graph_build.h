@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "distance.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Builds a graph over the points of the .bin file data_file on the GPU, in the
+// manner of CAGRA, and saves it at graph_file in the format Index::save()
+// saves graphs in, so that merge_shards() and create_disk_layout() take it as
+// they take a graph built by Index::build().
+//
+// The exact knn_degree nearest neighbors of every point, and its R / 2 nearest
+// points of a random sample, are found on the devices with
+// math_utils::gpu::update_knn(); the sampled points link clusters that the
+// nearest neighbors alone leave apart. Each list is then cut down to R
+// neighbors by the robust prune of Vamana with alpha, its reverse edges are
+// added and the lists that overflow are pruned again, on num_threads CPU
+// threads. The medoid is the entry point, and nodes left unreachable from it
+// get edges from their nearest reachable nodes, as repair_graph_connectivity()
+// gives them.
+//
+// Only L2 is supported. Returns false, having written nothing, for other
+// metrics, or in builds without CUDA or on hosts without a device; the caller
+// then builds the graph on the CPU.
+template <typename T>
+DISKANN_DLLEXPORT bool build_graph_on_gpu(const std::string &data_file, const diskann::Metric metric,
+                                          const uint32_t R, const uint32_t knn_degree, const float alpha,
+                                          const uint32_t num_threads, const std::string &graph_file);
+} // namespace diskann
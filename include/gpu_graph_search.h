@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace diskann
+{
+// A copy of a graph and its vectors in the memory of a CUDA device, searched
+// thousands of queries at a time for offline batch jobs. Index::load_to_gpu()
+// makes one, and Index::batch_search_on_gpu() searches it. Built with
+// -DCUDA=ON (which defines USE_CUDA) only.
+//
+// Each query is searched by one warp, with the greedy search of
+// Index::search(): a list of the L closest candidates in shared memory, the
+// closest unexpanded one expanded at a time, and the neighbors not yet seen,
+// tracked in a hash table per query in device memory, scored by the warp
+// together, a dimension per lane. The queries are split into batches that fit
+// in device memory; while one batch is searched, the queries of the next are
+// copied to the device and the results of the last copied back, on a second
+// stream.
+class GpuGraphSearcher
+{
+  public:
+    // The longest list of candidates the kernel keeps, in shared memory
+    static const uint32_t MAX_L = 1024;
+
+    // num_points vectors of dim floats, row major, and their neighbors,
+    // max_degree per point, padded with UINT32_MAX. Searches start from
+    // start_points. Points with excluded[i] set, if excluded is given, are
+    // traversed but never returned. Distances are squared L2, or the negated
+    // inner product if inner_product is set. Throws ANNException on CUDA
+    // errors, including when the copy does not fit in device memory.
+    GpuGraphSearcher(const float *vectors, size_t num_points, size_t dim, const uint32_t *graph, uint32_t max_degree,
+                     const std::vector<uint32_t> &start_points, const uint8_t *excluded, bool inner_product);
+    ~GpuGraphSearcher();
+    GpuGraphSearcher(const GpuGraphSearcher &) = delete;
+    GpuGraphSearcher &operator=(const GpuGraphSearcher &) = delete;
+
+    // Searches num_queries queries of dim floats, row major, with lists of L
+    // candidates, and writes the K closest points found for each, closest
+    // first, to ids and dists (num_queries * K, row major). Slots beyond the
+    // points found hold UINT32_MAX and FLT_MAX.
+    void search(const float *queries, size_t num_queries, size_t K, uint32_t L, uint32_t *ids, float *dists);
+
+    // bytes of device memory held by the copy
+    size_t device_bytes() const;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+} // namespace diskann
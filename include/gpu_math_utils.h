@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CUDA versions of the k-means kernels in math_utils.h, built with -DCUDA=ON
+// (which defines USE_CUDA). math_utils::compute_closest_centers and
+// kmeans::kmeanspp_selecting_pivots call them when a device is present, so PQ
+// and OPQ pivot training, PQ encoding and partitioning use the GPU without
+// changes to their callers or outputs. compute_groundtruth uses update_knn().
+namespace math_utils
+{
+namespace gpu
+{
+// The largest k compute_closest_centers() supports on the device; callers
+// fall back to the CPU above it.
+const size_t MAX_K = 16;
+
+// True if the library was built with CUDA and a device is visible. Logs the
+// device used the first time it is called.
+bool is_available();
+
+// the number of devices update_knn() spreads its queries over; 0 without CUDA
+// or a device
+size_t num_devices();
+
+// Same contract as math_utils::compute_closest_centers without the inverted
+// index: writes the ids of the k closest of the num_centers centers to each of
+// the num_points points to closest_centers (num_points * k, row major, closest
+// first). pts_norms_squared may be null. Points are streamed to the device in
+// blocks that fit its free memory. Throws ANNException on CUDA errors.
+void compute_closest_centers(const float *data, size_t num_points, size_t dim, const float *centers,
+                             size_t num_centers, size_t k, uint32_t *closest_centers,
+                             const float *pts_norms_squared = nullptr);
+
+// k-means++ seeding as in kmeans::kmeanspp_selecting_pivots, with the points
+// and their distances to the picked pivots kept on the device. Returns false
+// without picking anything if the points do not fit in device memory.
+bool kmeanspp_selecting_pivots(const float *data, size_t num_points, size_t dim, float *pivot_data,
+                               size_t num_centers);
+
+// Exact k nearest neighbours, a part of the points at a time: merges the
+// num_points points, with ids id_offset onwards, into the k nearest lists of
+// the num_queries queries. knn_dists and knn_ids hold the lists (num_queries
+// * k, row major, ascending), with FLT_MAX and UINT32_MAX in unused slots,
+// and are updated in place. Distances are squared L2, or the negated inner
+// product if inner_product is set. Points with excluded[i] set, if excluded
+// is given, are skipped. The queries are split across all devices, which
+// each stream the points through in tiles, with the copy of a tile
+// overlapping the work on the one before. Throws ANNException on CUDA errors.
+void update_knn(const float *points, size_t num_points, uint32_t id_offset, size_t dim, const float *queries,
+                size_t num_queries, size_t k, bool inner_product, const uint8_t *excluded, float *knn_dists,
+                uint32_t *knn_ids);
+} // namespace gpu
+} // namespace math_utils
@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace diskann
+{
+// 16-bit floating point storage types. Vectors are kept in 2 bytes per
+// dimension on disk and in memory; all arithmetic goes through float, which
+// both types convert to and from implicitly, so generic code that does
+// (float)x or T(f) works unchanged. Distance kernels read the raw bits.
+
+// IEEE 754 binary16: 1 sign, 5 exponent, 10 mantissa bits.
+struct float16
+{
+    uint16_t bits = 0;
+
+    float16() = default;
+
+    float16(float f) : bits(from_float(f))
+    {
+    }
+
+    operator float() const
+    {
+        return to_float(bits);
+    }
+
+    static uint16_t from_float(float f)
+    {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+        const uint32_t sign = (x >> 16) & 0x8000;
+        const uint32_t abs = x & 0x7fffffff;
+
+        if (abs >= 0x7f800000) // inf or nan
+            return (uint16_t)(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+        if (abs >= 0x477ff000) // rounds to a value above the largest half
+            return (uint16_t)(sign | 0x7c00);
+        if (abs < 0x33000000) // below half the smallest subnormal
+            return (uint16_t)sign;
+
+        const int32_t exp = (int32_t)(abs >> 23) - 127 + 15;
+        uint32_t h, rem, halfway;
+        if (exp > 0)
+        {
+            h = ((uint32_t)exp << 10) | ((abs >> 13) & 0x3ff);
+            rem = abs & 0x1fff;
+            halfway = 0x1000;
+        }
+        else
+        {
+            // subnormal half: shift the implicit bit into the mantissa
+            const uint32_t mant = (abs & 0x7fffff) | 0x800000;
+            const uint32_t shift = (uint32_t)(14 - exp);
+            h = mant >> shift;
+            rem = mant & ((1u << shift) - 1);
+            halfway = 1u << (shift - 1);
+        }
+        // round to nearest even; a carry out of the mantissa bumps the exponent
+        if (rem > halfway || (rem == halfway && (h & 1)))
+            h++;
+        return (uint16_t)(sign | h);
+    }
+
+    static float to_float(uint16_t h)
+    {
+        const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        const uint32_t exp = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+        uint32_t x;
+        if (exp == 0x1f)
+        {
+            x = sign | 0x7f800000 | (mant << 13);
+        }
+        else if (exp != 0)
+        {
+            x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+        }
+        else if (mant == 0)
+        {
+            x = sign;
+        }
+        else
+        {
+            // subnormal half: normalize
+            uint32_t e = 127 - 15 + 1;
+            while (!(mant & 0x400))
+            {
+                mant <<= 1;
+                e--;
+            }
+            x = sign | (e << 23) | ((mant & 0x3ff) << 13);
+        }
+        float f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+};
+
+// bfloat16: the upper half of an IEEE 754 binary32.
+struct bfloat16
+{
+    uint16_t bits = 0;
+
+    bfloat16() = default;
+
+    bfloat16(float f) : bits(from_float(f))
+    {
+    }
+
+    operator float() const
+    {
+        return to_float(bits);
+    }
+
+    static uint16_t from_float(float f)
+    {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+        if ((x & 0x7fffffff) > 0x7f800000) // keep nans quiet
+            return (uint16_t)((x >> 16) | 0x40);
+        // round to nearest even
+        x += 0x7fff + ((x >> 16) & 1);
+        return (uint16_t)(x >> 16);
+    }
+
+    static float to_float(uint16_t b)
+    {
+        uint32_t x = (uint32_t)b << 16;
+        float f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+};
+
+static_assert(sizeof(float16) == 2, "float16 must be 2 bytes");
+static_assert(sizeof(bfloat16) == 2, "bfloat16 must be 2 bytes");
+} // namespace diskann
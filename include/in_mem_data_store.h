@@ -16,24 +16,42 @@
 #include "natural_number_map.h"
 #include "natural_number_set.h"
 #include "aligned_file_reader.h"
+#include "memory_policy.h"
 
 namespace diskann
 {
+class MemoryMapper;
+
 template <typename data_t> class InMemDataStore : public AbstractDataStore<data_t>
 {
   public:
-    InMemDataStore(const location_t capacity, const size_t dim, std::unique_ptr<Distance<data_t>> distance_fn);
+    // With precompute_norms, the store keeps the norm of every vector and
+    // computes L2 and cosine distances from them and one inner product, for
+    // float, float16 and bfloat16 data, and cosine on bytes, whose metric does
+    // not preprocess the vectors. It is ignored otherwise.
+    InMemDataStore(const location_t capacity, const size_t dim, std::unique_ptr<Distance<data_t>> distance_fn,
+                   const bool precompute_norms = false);
     virtual ~InMemDataStore();
 
     virtual location_t load(const std::string &filename) override;
     virtual size_t save(const std::string &filename, const location_t num_points) override;
+    virtual location_t load_mmap(const std::string &filename) override;
+    virtual size_t save_mmap(const std::string &filename, const location_t num_points) override;
+    // get_distances_to() then asks for the pages of all its vectors before
+    // reading any of them
+    virtual location_t populate_data_mmap(const std::string &filename, const std::string &mmap_file) override;
 
     virtual size_t get_aligned_dim() const override;
+    virtual size_t memory_size() const override;
 
     // Populate internal data from unaligned data while doing alignment and any
     // normalization that is required.
     virtual void populate_data(const data_t *vectors, const location_t num_pts) override;
     virtual void populate_data(const std::string &filename, const size_t offset) override;
+    // Uses vectors in place if they fill the store, are not padded, need no
+    // preprocessing for the metric and are aligned like the store's buffer
+    virtual bool use_external_data(const data_t *vectors, const location_t num_pts,
+                                   std::shared_ptr<const void> owner) override;
 
     virtual void extract_data_to_bin(const std::string &filename, const location_t num_pts) override;
 
@@ -49,6 +67,13 @@ template <typename data_t> class InMemDataStore : public AbstractDataStore<data_
 
     virtual float get_distance(const data_t *preprocessed_query, const location_t loc) const override;
     virtual float get_distance(const location_t loc1, const location_t loc2) const override;
+    virtual void get_distances_to(const location_t loc, const location_t *locations, const uint32_t location_count,
+                                  float *distances) const override;
+    virtual float get_distance_with_bound(const data_t *preprocessed_query, const location_t loc,
+                                          const float bound) const override;
+    virtual void get_distances_to_with_bound(const location_t loc, const location_t *locations,
+                                             const uint32_t location_count, const float *bounds,
+                                             float *distances) const override;
 
     virtual void get_distance(const data_t *preprocessed_query, const location_t *locations,
                               const uint32_t location_count, float *distances,
@@ -72,7 +97,37 @@ template <typename data_t> class InMemDataStore : public AbstractDataStore<data_
 #endif
 
   private:
+    void free_data();
+    // load_mmap() of filename; with random_access, the pages are read when
+    // touched instead of all at once
+    location_t map_file(const std::string &filename, const bool random_access);
+    // copies mapped or external vectors into owned memory before the store is
+    // modified
+    void detach_mapping();
+    // moves _data into a new buffer of new_capacity points, keeping the
+    // vectors that fit
+    void reallocate_data(const location_t new_capacity);
+
+    // <a, b> with the inner product kernels
+    float inner_product(const data_t *a, const data_t *b) const;
+    // squared norm for L2, norm for cosine
+    float compute_norm(const data_t *vector) const;
+    float distance_from_norms(const float inner_product, const float norm_a, const float norm_b) const;
+    // recomputes the norms of [first, first + count), if they are kept
+    void update_norms(const location_t first, const location_t count);
+    void get_distances_from_norms(const data_t *query, const location_t *locations, const uint32_t location_count,
+                                  float *distances) const;
+
     data_t *_data = nullptr;
+    // owns _data unless it is mapped or external
+    LargeBuffer _buffer;
+    // set when _data points into a mapped file written by save_mmap()
+    std::unique_ptr<MemoryMapper> _mapping;
+    // set when the mapping is read in random order, by populate_data_mmap()
+    bool _paged_mapping = false;
+    // set when _data points to vectors given to use_external_data(), which
+    // are never written through _data
+    std::shared_ptr<const void> _external_owner;
 
     size_t _aligned_dim;
 
@@ -81,9 +136,21 @@ template <typename data_t> class InMemDataStore : public AbstractDataStore<data_
     // computations during search and compute norms of vectors internally without
     // have to copy data back and forth.
     std::unique_ptr<Distance<data_t>> _distance_fn;
-
-    // in case we need to save vector norms for optimization
-    std::shared_ptr<float[]> _pre_computed_norms;
+    // unrolled kernel for _aligned_dim when one exists, used in place of
+    // _distance_fn->compare()
+    FixedDimDistanceFn<data_t> _fixed_dim_distance_fn = nullptr;
+    // bounded counterpart of _fixed_dim_distance_fn, set along with it for L2
+    FixedDimBoundedDistanceFn<data_t> _fixed_dim_bounded_fn = nullptr;
+    // compares a query with four vectors per call in batched get_distance()
+    Batch4DistanceFn<data_t> _batch4_distance_fn = nullptr;
+
+    // norms of the vectors by location, if the store keeps them, and the
+    // inner product kernels the distances are then computed with
+    bool _use_norms = false;
+    std::vector<float> _norms;
+    std::unique_ptr<Distance<data_t>> _ip_distance_fn;
+    FixedDimDistanceFn<data_t> _fixed_dim_ip_fn = nullptr;
+    Batch4DistanceFn<data_t> _batch4_ip_fn = nullptr;
 };
 
 } // namespace diskann
\ No newline at end of file
@@ -17,9 +17,10 @@ class InMemGraphStore : public AbstractGraphStore
     virtual std::tuple<uint32_t, uint32_t, size_t> load(const std::string &index_path_prefix,
                                                         const size_t num_points) override;
     virtual int store(const std::string &index_path_prefix, const size_t num_points, const size_t num_frozen_points,
-                      const uint32_t start) override;
+                      const uint32_t start, const size_t frozen_location = 0) override;
 
-    virtual const std::vector<location_t> &get_neighbours(const location_t i) const override;
+    virtual NeighbourList get_neighbours(const location_t i) const override;
+    virtual void prefetch_neighbours(const location_t i) const override;
     virtual void add_neighbour(const location_t i, location_t neighbour_id) override;
     virtual void clear_neighbours(const location_t i) override;
     virtual void swap_neighbours(const location_t a, location_t b) override;
@@ -31,6 +32,7 @@ class InMemGraphStore : public AbstractGraphStore
 
     virtual size_t get_max_range_of_graph() override;
     virtual uint32_t get_max_observed_degree() override;
+    virtual size_t memory_size() const override;
 
   protected:
     virtual std::tuple<uint32_t, uint32_t, size_t> load_impl(const std::string &filename, size_t expected_num_points);
@@ -39,7 +41,7 @@ class InMemGraphStore : public AbstractGraphStore
 #endif
 
     int save_graph(const std::string &index_path_prefix, const size_t active_points, const size_t num_frozen_points,
-                   const uint32_t start);
+                   const uint32_t start, const size_t frozen_location = 0);
 
   private:
     size_t _max_range_of_graph = 0;
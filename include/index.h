@@ -10,7 +10,9 @@
 #endif
 
 #include "distance.h"
+#include "executor.h"
 #include "locking.h"
+#include "location_tag_map.h"
 #include "natural_number_map.h"
 #include "natural_number_set.h"
 #include "neighbor.h"
@@ -20,10 +22,16 @@
 #include "scratch.h"
 #include "in_mem_data_store.h"
 #include "in_mem_graph_store.h"
+#include "label_bitmap.h"
+#include "label_filter.h"
+#include "memory_policy.h"
+#include "memory_usage.h"
 #include "abstract_index.h"
 
 #include "quantized_distance.h"
 #include "pq_data_store.h"
+#include "write_ahead_log.h"
+#include "search_budget.h"
 
 #define OVERHEAD_FACTOR 1.1
 #define EXPAND_IF_FULL 0
@@ -42,13 +50,26 @@ inline double estimate_ram_usage(size_t size, uint32_t dim, uint32_t datasize, u
     return OVERHEAD_FACTOR * (size_of_data + size_of_graph + size_of_locks + size_of_outer_vector);
 }
 
+class GpuGraphSearcher;
+
+// The state of a search that returns its results a page at a time, from
+// Index::begin_paged_search(). It owns a query scratch, whose candidate list
+// and visited set carry over from one page to the next.
+template <typename T> struct IndexSearchCursor
+{
+    std::unique_ptr<InMemQueryScratch<T>> scratch;
+    std::vector<uint32_t> init_ids;
+    uint32_t L = 0;
+    tsl::robin_set<uint32_t> returned;
+};
+
 template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> class Index : public AbstractIndex
 {
     /**************************************************************************
      *
      * Public functions acquire one or more of _update_lock, _consolidate_lock,
      * _tag_lock, _delete_lock before calling protected functions which DO NOT
-     * acquire these locks. They might acquire locks on _locks[i]
+     * acquire these locks. They might acquire locks on get_lock(i)
      *
      **************************************************************************/
 
@@ -66,7 +87,8 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
                             const size_t num_frozen_pts = 0, const bool dynamic_index = false,
                             const bool enable_tags = false, const bool concurrent_consolidate = false,
                             const bool pq_dist_build = false, const size_t num_pq_chunks = 0,
-                            const bool use_opq = false, const bool filtered_index = false);
+                            const bool use_opq = false, const bool filtered_index = false,
+                            const bool precompute_norms = false);
 
     DISKANN_DLLEXPORT ~Index();
 
@@ -83,10 +105,26 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     DISKANN_DLLEXPORT void load(const char *index_file, uint32_t num_threads, uint32_t search_l);
 #endif
 
+    // Sizes every query scratch, with the set of points it visits, for
+    // searches with L up to max_search_l, so that they do not allocate. load()
+    // does this for its search_l; callers that vary L across requests declare
+    // the largest here before serving them. Waits for searches in progress to
+    // return their scratch.
+    DISKANN_DLLEXPORT void reserve_search_l(uint32_t max_search_l);
+
     // get some private variables
     DISKANN_DLLEXPORT size_t get_num_points();
     DISKANN_DLLEXPORT size_t get_max_points();
 
+    // The neighbours of location and the start point, for callers that take
+    // over a built graph without saving it
+    DISKANN_DLLEXPORT void get_neighbours(const uint32_t location, std::vector<uint32_t> &neighbours);
+    DISKANN_DLLEXPORT uint32_t get_start_point();
+
+    // Bytes held by the index, by component. Waits for the searches and
+    // updates in progress, and blocks new ones while it measures.
+    DISKANN_DLLEXPORT MemoryUsage get_memory_usage();
+
     DISKANN_DLLEXPORT bool detect_common_filters(uint32_t point_id, bool search_invocation,
                                                  const std::vector<LabelT> &incoming_labels);
 
@@ -100,6 +138,15 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // Batch build from a data array, which must pad vectors to aligned_dim
     DISKANN_DLLEXPORT void build(const T *data, const size_t num_points_to_load, const std::vector<TagT> &tags);
 
+    // Like the build above, but without copying data when the data store can
+    // read it in place (see AbstractDataStore::use_external_data()), in which
+    // case the index keeps data_owner alive for as long as it uses data. An
+    // index without frozen points, built with max_points equal to
+    // num_points_to_load, of vectors that are not padded and are aligned to
+    // 8 elements qualifies unless its metric normalizes vectors.
+    DISKANN_DLLEXPORT void build(const T *data, const size_t num_points_to_load, const std::vector<TagT> &tags,
+                                 std::shared_ptr<const void> data_owner);
+
     // Based on filter params builds a filtered or unfiltered index
     DISKANN_DLLEXPORT void build(const std::string &data_file, const size_t num_points_to_load,
                                  IndexFilterParams &filter_params);
@@ -114,6 +161,9 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // Get converted integer label from string to int map (_label_map)
     DISKANN_DLLEXPORT LabelT get_converted_label(const std::string &raw_label);
 
+    // Converts a filter of raw labels, in the syntax of parse_label_filter()
+    DISKANN_DLLEXPORT LabelFilter<LabelT> get_converted_filter(const std::string &filter);
+
     // Set starting point of an index before inserting any points incrementally.
     // The data count should be equal to _num_frozen_pts * _aligned_dim.
     DISKANN_DLLEXPORT void set_start_points(const T *data, size_t data_count);
@@ -122,18 +172,115 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // to have higher consistency between index builds.
     DISKANN_DLLEXPORT void set_start_points_at_random(T radius, uint32_t random_seed = 0);
 
-    // For FastL2 search on a static index, we interleave the data with graph
+    // Builds a small Vamana graph over about sample_rate of the points.
+    // Unfiltered searches query it first and also start from the closest
+    // sampled points, which saves the early hops away from the medoid.
+    // Only for static indices; rebuild it after reloading the index.
+    DISKANN_DLLEXPORT void build_entry_layer(float sample_rate = defaults::ENTRY_LAYER_SAMPLE_RATE);
+
+    // For search on a static index, we interleave the data with graph. Each
+    // node holds its vector, its norm (for FastL2) and its adjacency list in
+    // a stride of whole cache lines, so one node is one contiguous fetch. The
+    // layout is allocated under the memory policy, on huge pages if enabled.
+    // The graph store is released, so searches must use the functions below.
     DISKANN_DLLEXPORT void optimize_index_layout();
 
-    // For FastL2 search on optimized layout
+    // Writes the optimized layout to filename + ".opt": a header followed by
+    // the nodes exactly as they are in memory.
+    DISKANN_DLLEXPORT void save_optimized_layout(const char *filename);
+
+    // Loads an index saved by save() and save_optimized_layout() for search
+    // on the optimized layout alone. The layout takes the place of the data
+    // and graph files, which are not read, so serving never holds both. It is
+    // mapped with the MMAP load strategy and read into memory otherwise; the
+    // tags, labels and delete set are loaded as by load().
+    DISKANN_DLLEXPORT void load_optimized_layout(const char *filename, uint32_t num_threads, uint32_t search_l);
+
+    // For search on optimized layout
     DISKANN_DLLEXPORT void search_with_optimized_layout(const T *query, size_t K, size_t L, uint32_t *indices);
 
+    // Search on optimized layout for the K nearest points that match filter
+    // (all points if it is null or empty), writing their locations, and their
+    // distances and tags unless those are null. Tags require an index with
+    // tags. Returns the number of results.
+    template <typename IdType>
+    DISKANN_DLLEXPORT size_t search_with_optimized_layout(const T *query, const size_t K, const uint32_t L,
+                                                          IdType *indices, float *distances, TagT *tags = nullptr,
+                                                          const LabelFilter<LabelT> *filter = nullptr);
+
     // Added search overload that takes L as parameter, so that we
     // can customize L on a per-query basis without tampering with "Parameters"
     template <typename IDType>
     DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> search(const T *query, const size_t K, const uint32_t L,
                                                            IDType *indices, float *distances = nullptr);
 
+    // Searches num_queries queries, query i starting at queries + i *
+    // query_stride, and writes the K results of query i at indices and
+    // distances + i * K. Queries are handed out to num_threads threads (0 for
+    // all cores) one at a time. Once optimize_index_layout() has been called,
+    // the queries are searched on the optimized layout and interleave is
+    // ignored. Otherwise, with interleave > 1, each thread instead takes
+    // that many queries at a time and runs each as a state machine, switching
+    // to the next query after issuing prefetches for the adjacency list or
+    // neighbour vectors its next step needs. This hides much of the memory
+    // latency of indices larger than the caches; 4 to 8 queries usually
+    // suffice. Interleaved searches use scratch spaces of their own,
+    // interleave per thread.
+    template <typename IdType>
+    DISKANN_DLLEXPORT void batch_search(const T *queries, const size_t num_queries, const size_t query_stride,
+                                        const size_t K, const uint32_t L, IdType *indices, float *distances = nullptr,
+                                        const uint32_t num_threads = 0, const uint32_t interleave = 1);
+
+    // Copies the graph and the vectors, as floats, to the current CUDA device
+    // for batch_search_on_gpu(), replacing any earlier copy. The copy does not
+    // follow later inserts and deletes; call it again after them. Returns
+    // false, copying nothing, in builds without CUDA, without a device, for
+    // metrics other than L2 and inner product, or on the optimized layout.
+    DISKANN_DLLEXPORT bool load_to_gpu();
+
+    // Frees the copy made by load_to_gpu()
+    DISKANN_DLLEXPORT void release_gpu();
+
+    // batch_search() on the copy made by load_to_gpu(), for offline jobs of
+    // many queries: each query is searched by a warp of the device, thousands
+    // at a time, and the results of one batch are copied back while the next
+    // is searched. Searches start from the start point and frozen points,
+    // traverse lazily deleted points without returning them, and compare full
+    // precision vectors; they do not use the entry layer or quantized vectors,
+    // so results may differ slightly from search(). L is at most
+    // GpuGraphSearcher::MAX_L. Without a copy, runs batch_search().
+    template <typename IdType>
+    DISKANN_DLLEXPORT void batch_search_on_gpu(const T *queries, const size_t num_queries, const size_t query_stride,
+                                               const size_t K, const uint32_t L, IdType *indices,
+                                               float *distances = nullptr);
+
+    // Starts a search of query whose results are read a page at a time with
+    // next_page(). Each page searches with a list of L candidates beyond the
+    // results already returned, resuming from the list and visited set the
+    // previous page left; candidates that fell out of the shorter list of an
+    // earlier page are not revisited.
+    DISKANN_DLLEXPORT std::unique_ptr<IndexSearchCursor<T>> begin_paged_search(const T *query, const uint32_t L);
+
+    // Writes the locations and distances of up to K more results of cursor,
+    // closest first, and returns their number, which is below K only once the
+    // search has reached every point it can
+    DISKANN_DLLEXPORT size_t next_page(IndexSearchCursor<T> &cursor, const size_t K, uint32_t *indices,
+                                       float *distances = nullptr);
+
+    // Finds the points within range of query: those at a distance of at most
+    // range, or with an inner product of at least range under INNER_PRODUCT.
+    // Searches with a list of min_l_search candidates, and while the whole
+    // list is within range and holds fewer than max_results points, searches
+    // again with a list twice as long, up to max_l_search. Writes the
+    // locations and distances of the closest max_results found, and their
+    // tags if tags is given, which requires an index with tags. With filter,
+    // only points that match it are returned. Returns the number of results.
+    DISKANN_DLLEXPORT size_t range_search(const T *query, const float range, const uint32_t min_l_search,
+                                          const uint32_t max_l_search, const size_t max_results,
+                                          std::vector<uint32_t> &indices, std::vector<float> &distances,
+                                          std::vector<TagT> *tags = nullptr,
+                                          const LabelFilter<LabelT> *filter = nullptr);
+
     // Initialize space for res_vectors before calling.
     DISKANN_DLLEXPORT size_t search_with_tags(const T *query, const uint64_t K, const uint32_t L, TagT *tags,
                                               float *distances, std::vector<T *> &res_vectors, bool use_filters = false,
@@ -145,15 +292,73 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
                                                                         const size_t K, const uint32_t L,
                                                                         IndexType *indices, float *distances);
 
+    // Filter support search with a boolean filter over labels. Only points
+    // that match it are visited, starting from the start points of the
+    // labels of its most selective clause.
+    template <typename IndexType>
+    DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> search_with_filters(const T *query,
+                                                                        const LabelFilter<LabelT> &filter,
+                                                                        const size_t K, const uint32_t L,
+                                                                        IndexType *indices, float *distances);
+
     // Will fail if tag already in the index or if tag=0.
     DISKANN_DLLEXPORT int insert_point(const T *point, const TagT tag);
 
     // Will fail if tag already in the index or if tag=0.
     DISKANN_DLLEXPORT int insert_point(const T *point, const TagT tag, const std::vector<LabelT> &label);
 
+    // Inserts num_points consecutive vectors of points with the given tags.
+    // Locations are reserved in one step, the points are linked in parallel
+    // rounds, and the reverse edges of each round are added once per
+    // destination node. insert_retvals[i] is set to what insert_point would
+    // return for point i. Returns the number of points inserted. Not
+    // supported for filtered indices.
+    DISKANN_DLLEXPORT size_t insert_points(const T *points, const TagT *tags, const size_t num_points,
+                                           std::vector<int> &insert_retvals);
+
+    // Adds num_points consecutive vectors of points to a built index without
+    // tags, at locations get_num_points() onwards, linking them like
+    // insert_points. The index must have room for them.
+    DISKANN_DLLEXPORT void append_points(const T *points, const size_t num_points);
+
     // call this before issuing deletions to sets relevant flags
     DISKANN_DLLEXPORT int enable_delete();
 
+    // Searches navigate through lazily deleted points, but never return them,
+    // during their first hop_limit hops and skip them afterwards.
+    DISKANN_DLLEXPORT void set_tombstone_hop_limit(const uint32_t hop_limit);
+
+    // Unfiltered search() and search_with_tags() calls at the L and K of
+    // model stop once their hops reach its budget; null turns it off. Keeps a
+    // copy of model. Not safe alongside searches.
+    DISKANN_DLLEXPORT void set_search_budget_model(const SearchBudgetModel *model);
+
+    // Fits a SearchBudgetModel for searches at L and K on num_queries sample
+    // queries (query_stride elements apart) and gt, the locations of their
+    // gt_dim nearest points, nearest first. For each query, the fewest hops
+    // reaching the recall@K of its full search are regressed on its features
+    // after warmup_hops hops. The multiplier is then the least at which the
+    // mean recall@K of the sample reaches target_recall, or that of the full
+    // searches if lower. Does not set the model.
+    DISKANN_DLLEXPORT SearchBudgetModel train_search_budget_model(
+        const T *queries, const size_t num_queries, const size_t query_stride, const uint32_t *gt,
+        const size_t gt_dim, const size_t K, const uint32_t L, const float target_recall,
+        const uint32_t warmup_hops = defaults::SEARCH_BUDGET_WARMUP_HOPS);
+
+    // Writes the K nearest other points of each point 0 .. get_num_points() - 1
+    // to knn_ids, and their distances as search() reports them to knn_dists,
+    // K per point, nearest first, searching with list size L. Points are
+    // searched in breadth-first order from the start point, each starting from
+    // itself, so that the searches running at a time read much the same
+    // neighbourhoods. Rows with fewer than K neighbours end in ids of -1. Not
+    // for indices with lazy deletes that are not compacted yet.
+    DISKANN_DLLEXPORT void knn_self_join(const size_t K, const uint32_t L, uint32_t *knn_ids, float *knn_dists);
+
+    // Runs the parallel loops of link(), prune_all_neighbors() and
+    // consolidate_deletes() on executor instead of the default one. Their
+    // thread counts still cap how many of its threads a loop uses.
+    DISKANN_DLLEXPORT void set_executor(std::shared_ptr<Executor> executor);
+
     // Record deleted point now and restructure graph later. Return -1 if tag
     // not found, 0 if OK.
     DISKANN_DLLEXPORT int lazy_delete(const TagT &tag);
@@ -162,12 +367,48 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // if tag not found.
     DISKANN_DLLEXPORT void lazy_delete(const std::vector<TagT> &tags, std::vector<TagT> &failed_tags);
 
+    // Lazily deletes every live point with label (the universal label does
+    // not match) and appends their tags to deleted_tags. The points are found
+    // by a parallel scan of the labels under a shared _tag_lock, which only
+    // the marking of the points found takes exclusively. If consolidate_params
+    // is given, consolidate_deletes(*consolidate_params) follows. Needs a
+    // filtered index with tags. Returns the number of points deleted.
+    DISKANN_DLLEXPORT size_t lazy_delete_by_label(const LabelT &label, std::vector<TagT> &deleted_tags,
+                                                  const IndexWriteParameters *consolidate_params = nullptr);
+
+    // As lazy_delete_by_label, for the live points whose tag satisfies
+    // predicate. predicate is called from several threads at once.
+    DISKANN_DLLEXPORT size_t lazy_delete_if(const std::function<bool(const TagT &)> &predicate,
+                                            std::vector<TagT> &deleted_tags,
+                                            const IndexWriteParameters *consolidate_params = nullptr);
+
+    // Makes inserts and lazy deletes durable without saving the index: each
+    // one is appended to the log at path, and save() empties the log once the
+    // files it wrote are synced. To recover, load the last save and open its
+    // log; the operations already in the log are applied to the index first,
+    // and their number is returned. Needs tags; call before other updates.
+    DISKANN_DLLEXPORT size_t open_write_ahead_log(const std::string &path,
+                                                  const WriteAheadLogOptions &options = WriteAheadLogOptions());
+
+    // syncs and closes the log; later updates are not logged
+    DISKANN_DLLEXPORT void close_write_ahead_log();
+
     // Call after a series of lazy deletions
     // Returns number of live points left after consolidation
+    // Only the neighbour lists with an edge to a deleted point are repaired.
     // If _conc_consolidates is set in the ctor, then this call can be invoked
     // alongside inserts and lazy deletes, else it acquires _update_lock
     DISKANN_DLLEXPORT consolidation_report consolidate_deletes(const IndexWriteParameters &parameters);
 
+    // Incremental form of consolidate_deletes for indices built with
+    // concurrent_consolidate. The first call takes over the current delete set;
+    // each call then repairs the neighbour lists of at most max_locations
+    // locations and returns IN_PROGRESS, until the last slice releases the
+    // deleted locations and returns SUCCESS. Deleted points stay in the graph,
+    // and can be traversed by searches, until then.
+    DISKANN_DLLEXPORT consolidation_report consolidate_deletes_slice(const IndexWriteParameters &parameters,
+                                                                     const size_t max_locations);
+
     DISKANN_DLLEXPORT void prune_all_neighbors(const uint32_t max_degree, const uint32_t max_occlusion,
                                                const float alpha);
 
@@ -213,6 +454,8 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
 
     virtual int _insert_point(const DataType &data_point, const TagType tag) override;
     virtual int _insert_point(const DataType &data_point, const TagType tag, Labelvector &labels) override;
+    virtual size_t _insert_points(const DataType &points, const TagType &tags, const size_t num_points,
+                                  std::vector<int> &insert_retvals) override;
 
     virtual int _lazy_delete(const TagType &tag) override;
 
@@ -255,10 +498,49 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // with iterate_to_fixed_point.
     std::vector<uint32_t> get_init_ids();
 
-    // The query to use is placed in scratch->aligned_query
+    // Appends the locations of the entry layer points closest to query, if an
+    // entry layer was built. Caller must hold _update_lock.
+    void add_entry_layer_seeds(const T *query, std::vector<uint32_t> &init_ids);
+
+    // with _quantized_rerank, keeps only the best _quantized_rerank_factor * K
+    // candidates a search left in scratch, ordered by full precision distance
+    void rerank_candidates(InMemQueryScratch<T> *scratch, const size_t K);
+
+    // The query to use is placed in scratch->aligned_query. With label_filter,
+    // use_filter visits the points that match it instead of those that share
+    // a label with filters.
+    // A budget, if given, stops the search once its hops reach budget->max_hops.
     std::pair<uint32_t, uint32_t> iterate_to_fixed_point(InMemQueryScratch<T> *scratch, const uint32_t Lindex,
                                                          const std::vector<uint32_t> &init_ids, bool use_filter,
-                                                         const std::vector<LabelT> &filters, bool search_invocation);
+                                                         const std::vector<LabelT> &filters, bool search_invocation,
+                                                         const LabelFilter<LabelT> *label_filter = nullptr,
+                                                         SearchBudget *budget = nullptr);
+
+    // search() under budget, which may be null
+    template <typename IdType>
+    std::pair<uint32_t, uint32_t> search_with_budget(const T *query, const size_t K, const uint32_t L,
+                                                     IdType *indices, float *distances, SearchBudget *budget);
+
+    // Sets budget to follow _search_budget_model and returns it if the model
+    // is for searches at L and K, else returns null
+    SearchBudget *search_budget_for(const uint32_t L, const size_t K, SearchBudget &budget);
+
+    // The unfiltered search of iterate_to_fixed_point for the queries in
+    // scratches, advancing each query by one select, expand or score step in
+    // turn
+    void iterate_to_fixed_point_interleaved(const std::vector<InMemQueryScratch<T> *> &scratches,
+                                            const uint32_t Lsize, const std::vector<std::vector<uint32_t>> &init_ids);
+
+    // writes the first K candidates in scratch that are neither frozen nor
+    // deleted points to indices and distances, and returns their number
+    template <typename IdType>
+    size_t copy_search_results(InMemQueryScratch<T> *scratch, const size_t K, IdType *indices, float *distances);
+
+    bool point_matches_filter(uint32_t point_id, const LabelFilter<LabelT> &filter);
+
+    // adds the medoids of the labels of the most selective clause of filter
+    // to init_ids; throws if none of them has one
+    void add_filter_start_points(const LabelFilter<LabelT> &filter, std::vector<uint32_t> &init_ids);
 
     void search_for_point_and_prune(int location, uint32_t Lindex, std::vector<uint32_t> &pruned_list,
                                     InMemQueryScratch<T> *scratch, bool use_filter = false,
@@ -283,9 +565,47 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
 
     void inter_insert(uint32_t n, std::vector<uint32_t> &pruned_list, InMemQueryScratch<T> *scratch);
 
+    // add reverse links from the pruned lists of all the nodes in sources,
+    // locking and pruning each destination node once.
+    void batch_inter_insert(const uint32_t *sources, const std::vector<uint32_t> *pruned_lists,
+                            const size_t num_sources);
+
+    // links points whose vectors are set at locations, in rounds small
+    // relative to the nd_before points already in the index
+    void link_inserted_points(const std::vector<uint32_t> &locations, const size_t nd_before);
+
+    // set the out-neighbours of a newly inserted point, skipping neighbours
+    // deleted by a concurrent consolidation.
+    void set_inserted_point_neighbours(const uint32_t location, const std::vector<uint32_t> &pruned_list);
+
     // Acquire exclusive _update_lock before calling
     void link();
 
+    // _executor, or the default executor if none was set
+    std::shared_ptr<Executor> get_executor();
+
+    // Reorders the points of visit_order, but not the frozen points at its
+    // end, by the nearest of num_clusters pivots sampled among them
+    void order_for_locality(std::vector<uint32_t> &visit_order, uint32_t num_clusters);
+
+    // Rebuilds _tombstones for the current _max_points from _delete_set and
+    // _consolidating_set. Acquire exclusive _update_lock before calling
+    void reset_tombstones();
+
+    inline bool is_tombstone(const uint32_t location) const
+    {
+        return (_tombstones[location >> 6].load(std::memory_order_relaxed) >> (location & 63)) & 1;
+    }
+
+    inline void set_tombstone(const uint32_t location, const bool deleted)
+    {
+        const uint64_t bit = (uint64_t)1 << (location & 63);
+        if (deleted)
+            _tombstones[location >> 6].fetch_or(bit, std::memory_order_relaxed);
+        else
+            _tombstones[location >> 6].fetch_and(~bit, std::memory_order_relaxed);
+    }
+
     // Acquire exclusive _tag_lock and _delete_lock before calling
     int reserve_location();
 
@@ -305,21 +625,55 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     DISKANN_DLLEXPORT void compact_data();
     DISKANN_DLLEXPORT void compact_frozen_point();
 
+    // Lazily deletes the live points for which matches(location, tag) holds,
+    // as lazy_delete_by_label and lazy_delete_if
+    size_t lazy_delete_matching(const std::function<bool(uint32_t, const TagT &)> &matches,
+                                std::vector<TagT> &deleted_tags, const IndexWriteParameters *consolidate_params);
+
+    // true if a neighbour of loc is tombstoned; may be true for a location
+    // with nothing to repair, never false for one with something
+    bool has_deleted_neighbour(const uint32_t loc);
+
     // Remove deleted nodes from adjacency list of node loc
     // Replace removed neighbors with second order neighbors.
-    // Also acquires _locks[i] for i = loc and out-neighbors of loc.
+    // Also acquires get_lock(i) for i = loc and out-neighbors of loc.
     void process_delete(const tsl::robin_set<uint32_t> &old_delete_set, size_t loc, const uint32_t range,
                         const uint32_t maxc, const float alpha, InMemQueryScratch<T> *scratch);
 
     void initialize_query_scratch(uint32_t num_threads, uint32_t search_l, uint32_t indexing_l, uint32_t r,
                                   uint32_t maxc, size_t dim);
+    // Sizes scratch for searches at L, and its visited set for the points of
+    // the index
+    void reserve_query_scratch(InMemQueryScratch<T> *scratch, uint32_t L);
+
+    // Whether searches traverse the graph on an SQ or PCA store that is
+    // populated from the full precision vectors, which are kept to prune the
+    // graph, and the suffix of the file the store is saved to next to it
+    bool has_navigation_store() const;
+    std::string navigation_store_suffix() const;
 
     // Do not call without acquiring appropriate locks
     // call public member functions save and load to invoke these.
-    DISKANN_DLLEXPORT size_t save_graph(std::string filename);
-    DISKANN_DLLEXPORT size_t save_data(std::string filename);
+    // The frozen points are saved after the _nd points; a non-zero
+    // frozen_location says where they are in memory if not right after them.
+    DISKANN_DLLEXPORT size_t save_graph(std::string filename, size_t frozen_location = 0);
+    DISKANN_DLLEXPORT size_t save_data(std::string filename, size_t frozen_location = 0);
     DISKANN_DLLEXPORT size_t save_tags(std::string filename);
     DISKANN_DLLEXPORT size_t save_delete_list(const std::string &filename);
+
+    // Records of the write-ahead log. An insert is its tag, the number of its
+    // labels, the labels and the vector; a delete is its tag.
+    enum WalRecordType : uint32_t
+    {
+        WAL_INSERT = 1,
+        WAL_DELETE = 2
+    };
+    // Append the record of an update and return its sequence number. Call
+    // with _tag_lock held, so that records follow the order of the tag map.
+    uint64_t log_insert(const T *point, const TagT tag, const std::vector<LabelT> &labels);
+    uint64_t log_delete(const TagT &tag);
+    // applies the operations of the log at path, batching runs of inserts
+    size_t replay_write_ahead_log(const std::string &path);
 #ifdef EXEC_ENV_OLS
     DISKANN_DLLEXPORT size_t load_graph(AlignedFileReader &reader, size_t expected_num_points);
     DISKANN_DLLEXPORT size_t load_data(AlignedFileReader &reader);
@@ -330,6 +684,9 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     DISKANN_DLLEXPORT size_t load_data(std::string filename0);
     DISKANN_DLLEXPORT size_t load_tags(const std::string tag_file_name);
     DISKANN_DLLEXPORT size_t load_delete_set(const std::string &filename);
+    // maps or reads the file of save_optimized_layout(), returning the number
+    // of points it holds with the frozen points
+    DISKANN_DLLEXPORT size_t load_layout(const std::string &filename);
 #endif
 
   private:
@@ -342,7 +699,17 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // Graph related data structures
     std::unique_ptr<AbstractGraphStore> _graph_store;
 
+    // nodes of the optimized layout, _node_size bytes each: the vector
+    // (_data_len bytes), its norm, and the neighbour count and neighbours
+    // (_neighbor_len bytes)
     char *_opt_graph = nullptr;
+    LargeBuffer _opt_graph_buffer;
+    // set instead of _opt_graph_buffer when the layout is a mapped file
+    std::unique_ptr<MemoryMapper> _opt_graph_mapping;
+    size_t _opt_num_nodes = 0;
+    // the index was loaded by load_optimized_layout(), so its data and graph
+    // stores are empty
+    bool _layout_only = false;
 
     // Dimensions
     size_t _dim = 0;
@@ -356,9 +723,9 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // See also _start below.
     size_t _num_frozen_pts = 0;
     size_t _frozen_pts_used = 0;
-    size_t _node_size;
-    size_t _data_len;
-    size_t _neighbor_len;
+    size_t _node_size = 0;
+    size_t _data_len = 0;
+    size_t _neighbor_len = 0;
 
     //  Start point of the search. When _num_frozen_pts is greater than zero,
     //  this is the location of the first frozen point. Otherwise, this is a
@@ -379,6 +746,12 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     // Location to label is only updated during insert_point(), all other reads are protected by
     // default as a location can only be released at end of consolidate deletes
     std::vector<std::vector<LabelT>> _location_to_labels;
+    // index of _location_to_labels for searches, built when a static index
+    // with many labels per point is loaded
+    LabelBitmap _label_bitmap;
+    // number of points with each label when the labels were loaded, to rank
+    // the clauses of filters
+    std::unordered_map<LabelT, uint32_t> _label_counts;
     tsl::robin_set<LabelT> _labels;
     std::string _labels_file;
     std::unordered_map<LabelT, uint32_t> _label_to_start_id;
@@ -395,14 +768,39 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     uint32_t _indexingMaxC;
     float _indexingAlpha;
     uint32_t _indexingThreads;
+    uint32_t _num_build_passes = defaults::BUILD_NUM_PASSES;
+    float _first_pass_alpha = defaults::FIRST_PASS_ALPHA;
+    uint32_t _first_pass_threads = 0;
+    uint32_t _locality_clusters = defaults::LOCALITY_CLUSTERS;
+    // runs the loops of the build and of consolidate_deletes(), see
+    // set_executor(); the default executor if null
+    std::shared_ptr<Executor> _executor;
+
+    // Entry layer built by build_entry_layer(); sample i of the layer is
+    // location _entry_layer_locations[i] of this index
+    std::unique_ptr<Index<T, uint32_t, uint32_t>> _entry_layer;
+    std::vector<uint32_t> _entry_layer_locations;
+
+    // copy of the graph and vectors on a CUDA device made by load_to_gpu(),
+    // searched by batch_search_on_gpu()
+    std::shared_ptr<GpuGraphSearcher> _gpu_searcher;
 
     // Query scratch data structures
-    ConcurrentQueue<InMemQueryScratch<T> *> _query_scratch;
+    ScratchPool<InMemQueryScratch<T>> _query_scratch;
+    // the largest L declared by reserve_search_l(), which scratch added later
+    // is also sized for
+    uint32_t _max_search_l = 0;
 
     // Flags for PQ based distance calculation
     bool _pq_dist = false;
     bool _use_opq = false;
     size_t _num_pq_chunks = 0;
+    // scalar quantization (SQDataStore) in place of PQ when non-zero
+    size_t _num_sq_bits = 0;
+    // PCA projection (PCADataStore) to this many dimensions when non-zero
+    size_t _num_pca_dims = 0;
+    bool _quantized_rerank = false;
+    uint32_t _quantized_rerank_factor = defaults::QUANTIZED_RERANK_FACTOR;
     // REFACTOR
     // uint8_t *_pq_data = nullptr;
     std::shared_ptr<QuantizedDistance<T>> _pq_distance_fn = nullptr;
@@ -416,8 +814,12 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
 
     // lazy_delete removes entry from _location_to_tag and _tag_to_location. If
     // _location_to_tag does not resolve a location, infer that it was deleted.
+    // Both change under the exclusive _tag_lock, but searches resolve the tags
+    // of their results through _location_to_tag without it, as its lookups
+    // are safe alongside a writer. Its array is reserved for _max_points +
+    // _num_frozen_pts, and only grows under the exclusive _update_lock.
     tsl::sparse_map<TagT, uint32_t> _tag_to_location;
-    natural_number_map<uint32_t, TagT> _location_to_tag;
+    location_tag_map<TagT> _location_to_tag;
 
     // _empty_slots has unallocated slots and those freed by consolidate_delete.
     // _delete_set has locations marked deleted by lazy_delete. Will not be
@@ -426,22 +828,50 @@ template <typename T, typename TagT = uint32_t, typename LabelT = uint32_t> clas
     natural_number_set<uint32_t> _empty_slots;
     std::unique_ptr<tsl::robin_set<uint32_t>> _delete_set;
 
+    // Log of inserts and lazy deletes since the last save, if open. Set and
+    // reset under the exclusive _update_lock.
+    std::unique_ptr<WriteAheadLog> _wal;
+
+    // One bit per location, set while the location is lazily deleted and not
+    // yet reused, so searches can check deletions without _delete_lock
+    std::unique_ptr<std::atomic<uint64_t>[]> _tombstones;
+    uint32_t _tombstone_hop_limit = defaults::TOMBSTONE_HOP_LIMIT;
+
+    // set by set_search_budget_model()
+    std::unique_ptr<SearchBudgetModel> _search_budget_model;
+
+    // Points being consolidated by consolidate_deletes_slice(), the next
+    // location it processes and the _max_points it started with.
+    // Protected by _consolidate_lock.
+    std::unique_ptr<tsl::robin_set<uint32_t>> _consolidating_set;
+    size_t _consolidate_cursor = 0;
+    size_t _consolidate_max_points = 0;
+
     bool _data_compacted = true;    // true if data has been compacted
     bool _is_saved = false;         // Checking if the index is already saved.
     bool _conc_consolidate = false; // use _lock while searching
+    bool _mmap_load = false;        // load maps the .mmap.data and .mmap.graph files
+    bool _mmap_build = false;       // build maps an aligned copy of the data file
 
     // Acquire locks in the order below when acquiring multiple locks
     std::shared_timed_mutex // RW mutex between save/load (exclusive lock) and
         _update_lock;       // search/inserts/deletes/consolidate (shared lock)
     std::shared_timed_mutex // Ensure only one consolidate or compact_data is
         _consolidate_lock;  // ever active
-    std::shared_timed_mutex // RW lock for _tag_to_location,
+    std::shared_timed_mutex // RW lock for _tag_to_location, writes to
         _tag_lock;          // _location_to_tag, _empty_slots, _nd, _max_points, _label_to_start_id
     std::shared_timed_mutex // RW Lock on _delete_set and _data_compacted
         _delete_lock;       // variable
 
-    // Per node lock, cardinality=_max_points + _num_frozen_points
+    // Neighbour-list locks. One per node (cardinality=_max_points + _num_frozen_points)
+    // unless _num_lock_stripes > 0, in which case node i uses _locks[i % _num_lock_stripes]
     std::vector<non_recursive_mutex> _locks;
+    size_t _num_lock_stripes = 0;
+
+    inline non_recursive_mutex &get_lock(const size_t location)
+    {
+        return _locks[_num_lock_stripes == 0 ? location : location % _num_lock_stripes];
+    }
 
     static const float INDEX_GROWTH_FACTOR;
 };
@@ -7,12 +7,28 @@ namespace diskann
 {
 enum class DataStoreStrategy
 {
-    MEMORY
+    MEMORY,
+    // in-memory store backed by a read-only mapping of a file written with
+    // save_mmap(); requires GraphStoreStrategy::MMAP
+    MMAP,
+    // for a static build from a file that does not fit in memory: build()
+    // writes the vectors aligned next to the file, a batch at a time, and maps
+    // that copy, so that the kernel pages them in for pruning and drops them
+    // under memory pressure. Requires pq_dist_build or num_sq_bits, whose
+    // codes stay in memory for the searches of the build.
+    MMAP_BUILD
 };
 
 enum class GraphStoreStrategy
 {
-    MEMORY
+    MEMORY,
+    // fixed-stride adjacency array, see FlatGraphStore
+    FLAT,
+    // FlatGraphStore backed by a read-only mapping of a file written with
+    // store_mmap(); requires DataStoreStrategy::MMAP
+    MMAP,
+    // delta-coded adjacency lists for static indices, see CompressedGraphStore
+    COMPRESSED
 };
 
 struct IndexConfig
@@ -32,7 +48,22 @@ struct IndexConfig
     bool filtered_index;
 
     size_t num_pq_chunks;
+    // 8 or 4 to build and search on a scalar quantized store instead of PQ;
+    // 0 for none
+    size_t num_sq_bits;
+    // the number of principal components to build and search on a PCA
+    // projected store instead; 0 for none
+    size_t num_pca_dims;
+    // re-rank the best quantized_rerank_factor * K candidates of a search on
+    // a quantized store with full precision distances
+    bool quantized_rerank;
+    uint32_t quantized_rerank_factor;
     size_t num_frozen_pts;
+    // points share num_lock_stripes neighbour-list locks; 0 for one lock per point
+    size_t num_lock_stripes;
+    // keep the norms of the vectors in the data store and compute L2 and
+    // cosine distances from them and an inner product
+    bool precompute_norms;
 
     std::string label_type;
     std::string tag_type;
@@ -49,12 +80,16 @@ struct IndexConfig
                 bool pq_dist_build, bool concurrent_consolidate, bool use_opq, bool filtered_index,
                 std::string &data_type, const std::string &tag_type, const std::string &label_type,
                 std::shared_ptr<IndexWriteParameters> index_write_params,
-                std::shared_ptr<IndexSearchParams> index_search_params)
+                std::shared_ptr<IndexSearchParams> index_search_params, size_t num_lock_stripes, size_t num_sq_bits,
+                bool quantized_rerank, uint32_t quantized_rerank_factor, bool precompute_norms, size_t num_pca_dims)
         : data_strategy(data_strategy), graph_strategy(graph_strategy), metric(metric), dimension(dimension),
           max_points(max_points), dynamic_index(dynamic_index), enable_tags(enable_tags), pq_dist_build(pq_dist_build),
           concurrent_consolidate(concurrent_consolidate), use_opq(use_opq), filtered_index(filtered_index),
-          num_pq_chunks(num_pq_chunks), num_frozen_pts(num_frozen_points), label_type(label_type), tag_type(tag_type),
-          data_type(data_type), index_write_params(index_write_params), index_search_params(index_search_params)
+          num_pq_chunks(num_pq_chunks), num_sq_bits(num_sq_bits), num_pca_dims(num_pca_dims),
+          quantized_rerank(quantized_rerank), quantized_rerank_factor(quantized_rerank_factor),
+          num_frozen_pts(num_frozen_points), num_lock_stripes(num_lock_stripes), precompute_norms(precompute_norms),
+          label_type(label_type), tag_type(tag_type), data_type(data_type), index_write_params(index_write_params),
+          index_search_params(index_search_params)
     {
     }
 
@@ -138,12 +173,48 @@ class IndexConfigBuilder
         return *this;
     }
 
+    IndexConfigBuilder &with_num_sq_bits(size_t num_sq_bits)
+    {
+        this->_num_sq_bits = num_sq_bits;
+        return *this;
+    }
+
+    IndexConfigBuilder &with_num_pca_dims(size_t num_pca_dims)
+    {
+        this->_num_pca_dims = num_pca_dims;
+        return *this;
+    }
+
+    IndexConfigBuilder &is_quantized_rerank(bool quantized_rerank)
+    {
+        this->_quantized_rerank = quantized_rerank;
+        return *this;
+    }
+
+    IndexConfigBuilder &with_quantized_rerank_factor(uint32_t quantized_rerank_factor)
+    {
+        this->_quantized_rerank_factor = quantized_rerank_factor;
+        return *this;
+    }
+
     IndexConfigBuilder &with_num_frozen_pts(size_t num_frozen_pts)
     {
         this->_num_frozen_pts = num_frozen_pts;
         return *this;
     }
 
+    IndexConfigBuilder &with_num_lock_stripes(size_t num_lock_stripes)
+    {
+        this->_num_lock_stripes = num_lock_stripes;
+        return *this;
+    }
+
+    IndexConfigBuilder &is_precompute_norms(bool precompute_norms)
+    {
+        this->_precompute_norms = precompute_norms;
+        return *this;
+    }
+
     IndexConfigBuilder &with_label_type(const std::string &label_type)
     {
         this->_label_type = label_type;
@@ -222,15 +293,16 @@ class IndexConfigBuilder
         return IndexConfig(_data_strategy, _graph_strategy, _metric, _dimension, _max_points, _num_pq_chunks,
                            _num_frozen_pts, _dynamic_index, _enable_tags, _pq_dist_build, _concurrent_consolidate,
                            _use_opq, _filtered_index, _data_type, _tag_type, _label_type, _index_write_params,
-                           _index_search_params);
+                           _index_search_params, _num_lock_stripes, _num_sq_bits, _quantized_rerank,
+                           _quantized_rerank_factor, _precompute_norms, _num_pca_dims);
     }
 
     IndexConfigBuilder(const IndexConfigBuilder &) = delete;
     IndexConfigBuilder &operator=(const IndexConfigBuilder &) = delete;
 
   private:
-    DataStoreStrategy _data_strategy;
-    GraphStoreStrategy _graph_strategy;
+    DataStoreStrategy _data_strategy = DataStoreStrategy::MEMORY;
+    GraphStoreStrategy _graph_strategy = GraphStoreStrategy::MEMORY;
 
     Metric _metric;
     size_t _dimension;
@@ -244,7 +316,13 @@ class IndexConfigBuilder
     bool _filtered_index{defaults::HAS_LABELS};
 
     size_t _num_pq_chunks = 0;
+    size_t _num_sq_bits = 0;
+    size_t _num_pca_dims = 0;
+    bool _quantized_rerank = false;
+    uint32_t _quantized_rerank_factor{defaults::QUANTIZED_RERANK_FACTOR};
     size_t _num_frozen_pts{defaults::NUM_FROZEN_POINTS_STATIC};
+    size_t _num_lock_stripes{defaults::NUM_LOCK_STRIPES};
+    bool _precompute_norms = false;
 
     std::string _label_type{"uint32"};
     std::string _tag_type{"uint32"};
@@ -3,7 +3,11 @@
 #include "index.h"
 #include "abstract_graph_store.h"
 #include "in_mem_graph_store.h"
+#include "flat_graph_store.h"
+#include "compressed_graph_store.h"
 #include "pq_data_store.h"
+#include "sq_data_store.h"
+#include "pca_data_store.h"
 
 namespace diskann
 {
@@ -13,13 +17,28 @@ class IndexFactory
     DISKANN_DLLEXPORT explicit IndexFactory(const IndexConfig &config);
     DISKANN_DLLEXPORT std::unique_ptr<AbstractIndex> create_instance();
 
+    // create_instance() as the concrete Index, for callers that know the
+    // types: its search(), batch_search() and the rest take typed pointers,
+    // without the std::any wrapping and type dispatch of AbstractIndex on
+    // every call. Throws ANNException if the types are not those of the
+    // config.
+    template <typename data_type, typename tag_type = uint32_t, typename label_type = uint32_t>
+    DISKANN_DLLEXPORT std::unique_ptr<Index<data_type, tag_type, label_type>> create_typed_instance();
+
+    // Dry run of create_instance() and a build: the bytes the index would
+    // hold, by component, once built on max_points points, with the scratch
+    // of its search and build threads. Labels and the optimized layout, which
+    // depend on the data, are left out.
+    DISKANN_DLLEXPORT static MemoryUsage estimate_memory_usage(const IndexConfig &config);
+
     DISKANN_DLLEXPORT static std::unique_ptr<AbstractGraphStore> construct_graphstore(
         const GraphStoreStrategy stratagy, const size_t size, const size_t reserve_graph_degree);
 
     template <typename T>
     DISKANN_DLLEXPORT static std::shared_ptr<AbstractDataStore<T>> construct_datastore(DataStoreStrategy stratagy,
                                                                                        size_t num_points,
-                                                                                       size_t dimension, Metric m);
+                                                                                       size_t dimension, Metric m,
+                                                                                       bool precompute_norms = false);
     // For now PQDataStore incorporates within itself all variants of quantization that we support. In the
     // future it may be necessary to introduce an AbstractPQDataStore class to spearate various quantization
     // flavours.
@@ -28,11 +47,23 @@ class IndexFactory
                                                                                     size_t num_points, size_t dimension,
                                                                                     Metric m, size_t num_pq_chunks,
                                                                                     bool use_opq);
+    template <typename T>
+    DISKANN_DLLEXPORT static std::shared_ptr<SQDataStore<T>> construct_sq_datastore(DataStoreStrategy strategy,
+                                                                                    size_t num_points, size_t dimension,
+                                                                                    Metric m, size_t num_sq_bits);
+    template <typename T>
+    DISKANN_DLLEXPORT static std::shared_ptr<PCADataStore<T>> construct_pca_datastore(DataStoreStrategy strategy,
+                                                                                      size_t num_points,
+                                                                                      size_t dimension, Metric m,
+                                                                                      size_t num_pca_dims);
     template <typename T> static Distance<T> *construct_inmem_distance_fn(Metric m);
 
   private:
     void check_config();
 
+    template <typename data_type, typename tag_type, typename label_type>
+    std::unique_ptr<Index<data_type, tag_type, label_type>> construct_index();
+
     template <typename data_type, typename tag_type, typename label_type>
     std::unique_ptr<AbstractIndex> create_instance();
 
@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#if !defined(_WINDOWS) && defined(USE_IO_URING)
+
+#include "aligned_file_reader.h"
+
+struct io_uring;
+
+// AlignedFileReader backed by io_uring. Each registered thread, and each
+// context from create_ctx(), owns one ring; the index file is registered with
+// every ring so submissions skip the fd lookup, and the owner's sector scratch
+// can be pinned as a fixed buffer via register_buffer(). With SQPOLL enabled,
+// a kernel thread polls the submission queue, so a steady stream of reads
+// needs no io_uring_enter() to submit.
+//
+// The IOContext handed out by get_ctx() and create_ctx() is an opaque handle
+// to a ring and must only be passed back to this reader.
+class IoUringAlignedFileReader : public AlignedFileReader
+{
+  private:
+    struct RingContext;
+
+    FileHandle file_desc;
+    bool _use_sqpoll;
+    uint32_t _sqpoll_idle_ms;
+    io_context_t bad_ctx = (io_context_t)-1;
+
+    static RingContext *to_ring(IOContext &ctx);
+    // a new ring, without the file registered
+    RingContext *new_ring();
+    void register_file(RingContext *ring);
+    void destroy_ring(IOContext ctx);
+
+  public:
+    IoUringAlignedFileReader(bool use_sqpoll = false, uint32_t sqpoll_idle_ms = 2000);
+    ~IoUringAlignedFileReader();
+
+    IOContext &get_ctx();
+    IOContext create_ctx();
+
+    // register thread-id for a context
+    void register_thread();
+
+    // de-register thread-id for a context
+    void deregister_thread();
+    void deregister_all_threads();
+    // unmaps and closes the child's copies of the rings, which the parent
+    // keeps using, without unregistering anything from them
+    void reset_after_fork();
+
+    // pins [buf, buf + len) as the fixed buffer of ctx's ring; reads that fall
+    // entirely inside it are issued as IORING_OP_READ_FIXED
+    void register_buffer(IOContext &ctx, void *buf, size_t len);
+
+    // Open & close ops
+    // Blocking calls
+    void open(const std::string &fname);
+    void close();
+
+    // process batch of aligned requests in parallel
+    // NOTE :: blocking call
+    void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false);
+
+    // pipelined search support; see AlignedFileReader
+    bool supports_async_reads()
+    {
+        return true;
+    }
+    void submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx);
+    void reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                    std::vector<uint64_t> &completed);
+};
+
+#endif
@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "tsl/robin_map.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// The labels of a set of points, indexed by label so that checking whether a
+// point has a label does not depend on how many labels the point has.
+//
+// The representation of each label is chosen when the index is built from
+// the number of points that have it. Labels held by at least 1/16 of the
+// points get a bitset over all points, which makes the check a single bit
+// test. The others are stored like Roaring bitmaps: the point ids are split
+// into chunks of 2^16, and each non-empty chunk is either a sorted array of
+// the low 16 bits of its ids or, past 4096 ids, a bitset of the chunk. Either
+// way a label takes at most about two bytes per point that has it.
+//
+// The index is immutable once built; concurrent contains() calls are safe.
+class LabelBitmap
+{
+  public:
+    // Builds the index of num_points points, point i having the counts[i]
+    // labels that start at labels + offsets[i]
+    template <typename LabelT>
+    DISKANN_DLLEXPORT void build(size_t num_points, const uint32_t *offsets, const uint32_t *counts,
+                                 const LabelT *labels);
+
+    // Builds the index of the first num_points entries of point_labels
+    template <typename LabelT>
+    DISKANN_DLLEXPORT void build(size_t num_points, const std::vector<std::vector<LabelT>> &point_labels);
+
+    DISKANN_DLLEXPORT void clear();
+
+    bool empty() const
+    {
+        return _num_points == 0;
+    }
+
+    size_t num_points() const
+    {
+        return _num_points;
+    }
+
+    size_t num_dense_labels() const
+    {
+        return _num_dense;
+    }
+
+    size_t num_sparse_labels() const
+    {
+        return _sparse_begin.empty() ? 0 : _sparse_begin.size() - 1;
+    }
+
+    // bytes held by the index
+    DISKANN_DLLEXPORT size_t memory_size() const;
+
+    // True if point, which must be below num_points(), has label
+    inline bool contains(uint32_t point, uint32_t label) const
+    {
+        const uint32_t slot = find_slot(label);
+        if (slot == NO_SLOT)
+            return false;
+        if (slot < _num_dense)
+            return (_dense_bits[slot * _words_per_row + (point >> 6)] >> (point & 63)) & 1;
+        return sparse_contains(slot - _num_dense, point);
+    }
+
+    // Moves the ids among ids[0, n) that have label to the front, keeping
+    // their order, and returns how many there are. The ids must be below
+    // num_points(). Much faster than calling contains() on each id for a
+    // dense label.
+    DISKANN_DLLEXPORT size_t select(uint32_t *ids, size_t n, uint32_t label) const;
+
+    // A label is stored as a bitset over all points once this many times its
+    // number of points reaches the number of points
+    static constexpr uint32_t DENSE_RATIO = 16;
+    // chunks of this many ids or fewer are stored as sorted arrays
+    static constexpr uint32_t ARRAY_MAX_SIZE = 4096;
+
+  private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    static constexpr uint32_t CHUNK_WORDS = (1 << 16) / 64;
+
+    // one chunk of 2^16 ids of a sparse label
+    struct Container
+    {
+        uint32_t key;         // high 16 bits of the ids
+        uint32_t cardinality; // ids in the chunk
+        uint64_t offset;      // into _array_values, or _chunk_bits past ARRAY_MAX_SIZE ids
+    };
+
+    template <typename LabelT, typename GetLabels> void build_from(size_t num_points, GetLabels get_labels);
+
+    inline uint32_t find_slot(uint32_t label) const
+    {
+        if (!_use_slot_map)
+            return label < _slot_table.size() ? _slot_table[label] : NO_SLOT;
+        auto iter = _slot_map.find(label);
+        return iter == _slot_map.end() ? NO_SLOT : iter->second;
+    }
+
+    inline bool sparse_contains(uint32_t sparse_slot, uint32_t point) const
+    {
+        const Container *first = _containers.data() + _sparse_begin[sparse_slot];
+        const Container *last = _containers.data() + _sparse_begin[sparse_slot + 1];
+        const uint32_t key = point >> 16;
+        const Container *iter =
+            std::lower_bound(first, last, key, [](const Container &c, uint32_t k) { return c.key < k; });
+        if (iter == last || iter->key != key)
+            return false;
+        const uint16_t low = (uint16_t)(point & 0xFFFF);
+        if (iter->cardinality > ARRAY_MAX_SIZE)
+            return (_chunk_bits[iter->offset + (low >> 6)] >> (low & 63)) & 1;
+        const uint16_t *values = _array_values.data() + iter->offset;
+        return std::binary_search(values, values + iter->cardinality, low);
+    }
+
+    size_t _num_points = 0;
+
+    // slot of each label: dense labels come first, then the sparse ones.
+    // Labels are looked up in a table indexed by label unless the largest
+    // label is too large for one.
+    bool _use_slot_map = false;
+    std::vector<uint32_t> _slot_table;
+    tsl::robin_map<uint32_t, uint32_t> _slot_map;
+
+    // one row of _words_per_row words per dense label
+    uint32_t _num_dense = 0;
+    size_t _words_per_row = 0;
+    std::vector<uint64_t> _dense_bits;
+
+    // the containers of sparse label i are
+    // _containers[_sparse_begin[i], _sparse_begin[i + 1]), sorted by key
+    std::vector<uint64_t> _sparse_begin;
+    std::vector<Container> _containers;
+    std::vector<uint16_t> _array_values;
+    std::vector<uint64_t> _chunk_bits;
+};
+} // namespace diskann
@@ -0,0 +1,145 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace diskann
+{
+// A boolean filter over the labels of a point for filtered searches: an AND
+// of clauses, each an OR of labels, and a list of labels the point must not
+// have. A point with the universal label satisfies every clause but is still
+// subject to the excluded labels.
+template <typename LabelT> struct LabelFilter
+{
+    std::vector<std::vector<LabelT>> clauses;
+    std::vector<LabelT> excluded;
+
+    LabelFilter() = default;
+
+    // the filter of a single label
+    explicit LabelFilter(const LabelT &label) : clauses(1, std::vector<LabelT>(1, label))
+    {
+    }
+
+    // true for the filter that matches every point
+    bool empty() const
+    {
+        return clauses.empty() && excluded.empty();
+    }
+
+    // true for the filter of a single label
+    bool is_single_label() const
+    {
+        return excluded.empty() && clauses.size() == 1 && clauses[0].size() == 1;
+    }
+
+    // has_label(label) tells whether the point has label, and has_universal()
+    // whether it has the universal label
+    template <typename HasLabel, typename HasUniversal>
+    bool matches(HasLabel &&has_label, HasUniversal &&has_universal) const
+    {
+        for (const LabelT &label : excluded)
+        {
+            if (has_label(label))
+                return false;
+        }
+        int universal = -1;
+        for (const auto &clause : clauses)
+        {
+            bool found = false;
+            for (const LabelT &label : clause)
+            {
+                if (has_label(label))
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+                continue;
+            if (universal < 0)
+                universal = has_universal() ? 1 : 0;
+            if (universal == 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Index of the clause expected to match the fewest points, given the
+    // number of points count(label) with each label, or -1 without clauses.
+    // Searches start from the entry points of its labels.
+    template <typename CountLabel> int64_t most_selective_clause(CountLabel &&count) const
+    {
+        int64_t best = -1;
+        uint64_t best_count = std::numeric_limits<uint64_t>::max();
+        for (size_t i = 0; i < clauses.size(); i++)
+        {
+            uint64_t clause_count = 0;
+            for (const LabelT &label : clauses[i])
+                clause_count += count(label);
+            if (clause_count < best_count)
+            {
+                best = (int64_t)i;
+                best_count = clause_count;
+            }
+        }
+        return best;
+    }
+};
+
+// True if filter contains the operators of parse_label_filter() and is not a
+// single label
+inline bool is_label_filter_expression(const std::string &filter)
+{
+    return filter.find_first_of("&|!") != std::string::npos;
+}
+
+// Parses a filter such as "red&large|huge&!used": clauses separated by '&',
+// the labels of a clause separated by '|', and excluded labels prefixed with
+// '!'. lookup converts a raw label and returns false if no point has it; such
+// labels are left out, so a clause of unknown labels is only satisfied by the
+// universal label.
+template <typename LabelT>
+LabelFilter<LabelT> parse_label_filter(const std::string &filter,
+                                       const std::function<bool(const std::string &, LabelT &)> &lookup)
+{
+    LabelFilter<LabelT> parsed;
+    size_t term_begin = 0;
+    while (term_begin <= filter.size())
+    {
+        size_t term_end = filter.find('&', term_begin);
+        if (term_end == std::string::npos)
+            term_end = filter.size();
+        const std::string term = filter.substr(term_begin, term_end - term_begin);
+        term_begin = term_end + 1;
+        if (term.empty())
+            continue;
+
+        LabelT label;
+        if (term[0] == '!')
+        {
+            if (lookup(term.substr(1), label))
+                parsed.excluded.push_back(label);
+            continue;
+        }
+        std::vector<LabelT> clause;
+        size_t begin = 0;
+        while (begin <= term.size())
+        {
+            size_t end = term.find('|', begin);
+            if (end == std::string::npos)
+                end = term.size();
+            if (end > begin && lookup(term.substr(begin, end - begin), label))
+                clause.push_back(label);
+            begin = end + 1;
+        }
+        parsed.clauses.push_back(clause);
+    }
+    return parsed;
+}
+} // namespace diskann
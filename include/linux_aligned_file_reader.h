@@ -4,7 +4,10 @@
 #pragma once
 #ifndef _WINDOWS
 
+#include <memory>
+
 #include "aligned_file_reader.h"
+#include "search_metrics.h"
 
 class LinuxAlignedFileReader : public AlignedFileReader
 {
@@ -12,12 +15,26 @@ class LinuxAlignedFileReader : public AlignedFileReader
     uint64_t file_sz;
     FileHandle file_desc;
     io_context_t bad_ctx = (io_context_t)-1;
+    std::unique_ptr<diskann::IOMetrics> io_metrics;
+    uint32_t _busy_poll_us;
 
   public:
-    LinuxAlignedFileReader();
+    // With busy_poll_us > 0, a thread waiting for its reads spins on the
+    // completion ring of its context in user space for up to that many
+    // microseconds before it sleeps in io_getevents(), which saves the wakeup
+    // on reads that complete within the spin at the cost of a busy core.
+    // reap_reads() then also returns the reads already completed beyond
+    // min_completions.
+    explicit LinuxAlignedFileReader(uint32_t busy_poll_us = 0);
     ~LinuxAlignedFileReader();
 
     IOContext &get_ctx();
+    IOContext create_ctx();
+    // contexts are plain io_setup() contexts, which read any file
+    bool has_file_independent_ctx()
+    {
+        return true;
+    }
 
     // register thread-id for a context
     void register_thread();
@@ -26,6 +43,10 @@ class LinuxAlignedFileReader : public AlignedFileReader
     void deregister_thread();
     void deregister_all_threads();
 
+    // call before the reads to sample; see AlignedFileReader
+    void enable_io_metrics();
+    diskann::IOMetrics *get_io_metrics();
+
     // Open & close ops
     // Blocking calls
     void open(const std::string &fname);
@@ -34,6 +55,15 @@ class LinuxAlignedFileReader : public AlignedFileReader
     // process batch of aligned requests in parallel
     // NOTE :: blocking call
     void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false);
+
+    // pipelined search support; see AlignedFileReader
+    bool supports_async_reads()
+    {
+        return true;
+    }
+    void submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx);
+    void reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                    std::vector<uint64_t> &completed);
 };
 
 #endif
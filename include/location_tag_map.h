@@ -0,0 +1,93 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace diskann
+{
+// The location-to-tag map of the dynamic index: a dense array with a slot per
+// location, holding the tag of the location if it has one. It has the
+// interface of natural_number_map<uint32_t, Value>, which it replaces there.
+//
+// Thread-safety: contains() and try_get() may run in parallel with set() and
+// erase() on other or the same keys, and never see a torn tag; each slot is a
+// sequence lock whose readers retry while a writer is in the slot. Writers
+// must be serialized with each other. reserve(), clear() and a set() that has
+// to grow the array move or reset the slots, so nothing else may use the map
+// meanwhile. Iteration (find_first, find_next, get) is meant for callers that
+// keep writers out.
+template <typename Value> class location_tag_map
+{
+  public:
+    // Represents a reference to a element in the map. Used while iterating
+    // over map entries.
+    struct position
+    {
+        size_t _key;
+        // The number of keys enumerated so far, to stop once all the entries
+        // have been seen
+        size_t _keys_already_enumerated;
+
+        bool is_valid() const;
+    };
+
+    location_tag_map();
+
+    // makes room for keys below count, so that setting them never grows the
+    // array
+    void reserve(size_t count);
+    size_t size() const;
+    // bytes allocated for the slots
+    size_t memory_size() const;
+
+    void set(uint32_t key, Value value);
+    void erase(uint32_t key);
+
+    bool contains(uint32_t key) const;
+    bool try_get(uint32_t key, Value &value) const;
+
+    // Returns the value at the specified position. Prerequisite: position is
+    // valid.
+    Value get(const position &pos) const;
+
+    // Finds the first element in the map, if any. Invalidated by changes in the
+    // map.
+    position find_first() const;
+
+    // Finds the next element in the map after the specified position.
+    // Invalidated by changes in the map.
+    position find_next(const position &after_position) const;
+
+    void clear();
+
+  private:
+    // 32-bit words hold tags of up to 4 bytes without padding
+    using word_t = typename std::conditional<sizeof(Value) <= sizeof(uint32_t), uint32_t, uint64_t>::type;
+    static constexpr size_t WORDS_PER_VALUE = (sizeof(Value) + sizeof(word_t) - 1) / sizeof(word_t);
+
+    // seq is odd while a writer is in the slot, has PRESENT set while the
+    // slot holds a tag, and advances by SEQ_STEP with every change
+    static constexpr uint32_t WRITING = 1;
+    static constexpr uint32_t PRESENT = 2;
+    static constexpr uint32_t SEQ_STEP = 4;
+
+    struct slot
+    {
+        std::atomic<uint32_t> seq;
+        std::atomic<word_t> words[WORDS_PER_VALUE];
+    };
+
+    // the sequence of the slot once no writer is in it
+    uint32_t stable_seq(const slot &s) const;
+    position find_from(size_t key, size_t keys_already_enumerated) const;
+
+    std::unique_ptr<slot[]> _slots;
+    size_t _capacity;
+    std::atomic<size_t> _size;
+};
+} // namespace diskann
@@ -43,9 +43,11 @@ void compute_closest_centers_in_block(const float *const data, const size_t num_
 // those
 // values
 
+// If center_penalties is not null, it holds a value per center that is added
+// to the squared distances to that center before they are ranked.
 void compute_closest_centers(float *data, size_t num_points, size_t dim, float *pivot_data, size_t num_centers,
                              size_t k, uint32_t *closest_centers_ivf, std::vector<size_t> *inverted_index = NULL,
-                             float *pts_norms_squared = NULL);
+                             float *pts_norms_squared = NULL, const float *center_penalties = NULL);
 
 // if to_subtract is 1, will subtract nearest center from each row. Else will
 // add. Output will be in data_load iself.
@@ -79,9 +81,47 @@ float lloyds_iter(float *data, size_t num_points, size_t dim, float *centers, si
 float run_lloyds(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
                  const size_t max_reps, std::vector<size_t> *closest_docs, uint32_t *closest_center);
 
+// run_lloyds() with the bounds of Hamerly's k-means: each point keeps the
+// distance to its center and a lower bound on that to any other center, which
+// the triangle inequality maintains as the centers move, and only the points
+// whose bounds overlap are compared to all the centers again. Computes the
+// same clusters in a fraction of the distance computations once the centers
+// settle; same arguments as run_lloyds().
+float run_bounded_lloyds(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
+                         const size_t max_reps, std::vector<size_t> *closest_docs, uint32_t *closest_center);
+
 // assumes already memory allocated for pivot_data as new
 // float[num_centers*dim] and select randomly num_centers points as pivots
 void selecting_pivots(float *data, size_t num_points, size_t dim, float *pivot_data, size_t num_centers);
 
 void kmeanspp_selecting_pivots(float *data, size_t num_points, size_t dim, float *pivot_data, size_t num_centers);
+
+// Picks pivots num_picked .. num_centers - 1 by k-means++ sampling against the
+// num_picked pivots already in pivot_data, which are kept. Lets a clustering
+// grow to more centers without reseeding from scratch.
+void kmeanspp_extend_pivots(float *data, size_t num_points, size_t dim, float *pivot_data, size_t num_picked,
+                            size_t num_centers);
+
+// Mini-batch k-means starting from the centers given: each step assigns
+// batch_size random points and moves each center towards its points with a
+// learning rate of one over the number of points it has seen so far. Runs at
+// most max_reps passes' worth of batches, and stops early once the smoothed
+// batch residual has stopped improving. Returns that residual, the mean
+// squared distance of a point to its closest center.
+float run_minibatch_lloyds(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
+                           const size_t max_reps, const size_t batch_size);
+
+// Capacity-penalized assignment to the centers of a k-means run: finds
+// penalties (see compute_closest_centers()) under which assigning each point
+// to its k_base closest centers puts no more than (1 + tolerance) times the
+// average on any center. Each step raises the penalty of the centers over
+// that and lowers that of those under the average, by steps that grow while
+// a center's penalty keeps moving the same way and halve when it turns. Stops
+// once balanced or after max_reps steps, leaves the most balanced penalties
+// found in center_penalties (num_centers values), and returns the size of the
+// largest center over the average. Other points must be assigned with the
+// same penalties.
+float balance_centers(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
+                      const size_t k_base, const float tolerance, float *center_penalties,
+                      const size_t max_reps = 100);
 } // namespace kmeans
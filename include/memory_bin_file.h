@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// The vectors of a bin file held in memory by the caller, registered under a
+// path that the build then takes as its data file. cached_ifstream,
+// read_file_parallel(), get_bin_metadata(), file_exists(), get_file_size()
+// and the bin loaders see through the path, so a disk index can be built on
+// vectors a caller already holds, or on a mapping of them, without writing
+// them out and reading them back. Nothing is created at the path.
+//
+// The vectors are only read, and must outlive the object, which unregisters
+// the path when destroyed.
+class MemoryBinFile
+{
+  public:
+    // Registers path for the num_points vectors of dim coordinates of
+    // coord_size bytes each at data. Throws if path is registered already or
+    // names a file on disk, which readers that do not know of memory files
+    // would read instead.
+    DISKANN_DLLEXPORT MemoryBinFile(const std::string &path, const void *data, uint64_t num_points, uint64_t dim,
+                                    uint64_t coord_size);
+    DISKANN_DLLEXPORT ~MemoryBinFile();
+    MemoryBinFile(const MemoryBinFile &) = delete;
+    MemoryBinFile &operator=(const MemoryBinFile &) = delete;
+
+    // the file registered at path, or nullptr
+    DISKANN_DLLEXPORT static const MemoryBinFile *find(const std::string &path);
+
+    const std::string &path() const
+    {
+        return _path;
+    }
+
+    const void *data() const
+    {
+        return _data;
+    }
+
+    uint64_t num_points() const
+    {
+        return _num_points;
+    }
+
+    uint64_t dim() const
+    {
+        return _dim;
+    }
+
+    // size of the bin file, header included
+    uint64_t size() const
+    {
+        return 2 * sizeof(uint32_t) + _num_points * _dim * _coord_size;
+    }
+
+    // Reads len bytes at offset of the bin file into buf
+    DISKANN_DLLEXPORT void read(char *buf, uint64_t offset, uint64_t len) const;
+
+  private:
+    std::string _path;
+    const void *_data;
+    uint64_t _num_points;
+    uint64_t _dim;
+    uint64_t _coord_size;
+    // the npts and dims header of the file
+    uint32_t _header[2];
+};
+} // namespace diskann
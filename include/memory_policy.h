@@ -0,0 +1,121 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Page size requested for the large buffers that hold vectors, graphs, PQ
+// codes and caches.
+enum class HugePageMode
+{
+    // aligned_alloc, as for any other buffer
+    NONE,
+    // explicit huge pages of the system's default size if a pool is reserved,
+    // transparent huge pages otherwise
+    AUTO,
+    // explicit 2 MB pages, falling back to transparent huge pages
+    HUGE_2MB,
+    // explicit 1 GB pages for buffers of at least 1 GB, 2 MB pages otherwise
+    HUGE_1GB
+};
+
+// Where the pages of those buffers are placed on a multi-socket machine.
+enum class NumaPlacement
+{
+    // on the node of the thread that first writes each page
+    FIRST_TOUCH,
+    // round robin over all online nodes, so that every socket sees the same
+    // average latency and the buffer's bandwidth is spread over all of them
+    INTERLEAVE
+};
+
+struct MemoryPolicy
+{
+    HugePageMode huge_pages = HugePageMode::AUTO;
+    NumaPlacement numa = NumaPlacement::FIRST_TOUCH;
+};
+
+// The policy applies to buffers allocated after it is set; set it before
+// building or loading an index.
+DISKANN_DLLEXPORT void set_memory_policy(const MemoryPolicy &policy);
+DISKANN_DLLEXPORT MemoryPolicy get_memory_policy();
+
+// Parse the command line spellings "none", "auto", "2mb", "1gb" and
+// "first_touch", "interleave"; throw ANNException on anything else.
+DISKANN_DLLEXPORT HugePageMode parse_huge_page_mode(const std::string &mode);
+DISKANN_DLLEXPORT NumaPlacement parse_numa_placement(const std::string &placement);
+
+// A zeroed buffer of at least the requested size allocated under the current
+// policy. Keep it to release the memory with free_large().
+struct LargeBuffer
+{
+    void *ptr = nullptr;
+    size_t len = 0;
+    bool mmapped = false;
+};
+
+// align must be a power of two no larger than 2 MB. Pages are not touched by
+// the allocation on Linux, so under FIRST_TOUCH they land on the node of the
+// thread that fills them in.
+DISKANN_DLLEXPORT LargeBuffer alloc_large(size_t size, size_t align);
+DISKANN_DLLEXPORT void free_large(LargeBuffer &buffer);
+// A zeroed buffer of at least size bytes whose pages take memory only once
+// they are touched, for stores that reserve room to grow into. Huge pages are
+// transparent ones. Empty where the OS cannot reserve (Windows); fall back to
+// alloc_large() then.
+DISKANN_DLLEXPORT LargeBuffer reserve_large(size_t size, size_t align);
+
+// Memory a buffer is explicitly placed in, for the parts of an index that
+// tolerate slower memory than the default buffers.
+enum class MemoryTier
+{
+    // alloc_large() under the current policy
+    DRAM,
+    // pages preferred on one NUMA node, such as a memory-only node backed by
+    // CXL-attached memory
+    NUMA_NODE,
+    // a shared mapping of an unlinked file in a directory: far memory on a
+    // tmpfs or DAX mount, or pages the kernel reads back from an NVMe drive
+    // on demand and evicts under memory pressure
+    FILE
+};
+
+struct MemoryPlacement
+{
+    MemoryTier tier = MemoryTier::DRAM;
+    // NUMA_NODE: the node, numbered as for get_num_numa_nodes()
+    uint32_t numa_node = 0;
+    // FILE: the directory the file is created in
+    std::string directory;
+};
+
+// Parse the command line spellings "dram", "numa:<node>" and "file:<dir>";
+// throw ANNException on anything else.
+DISKANN_DLLEXPORT MemoryPlacement parse_memory_placement(const std::string &placement);
+// A zeroed buffer of at least size bytes in the memory placement names, to
+// release with free_large(). Throws if the placement cannot be honoured;
+// tiers other than DRAM need Linux.
+DISKANN_DLLEXPORT LargeBuffer alloc_placed(size_t size, size_t align, const MemoryPlacement &placement);
+
+// NUMA nodes are numbered 0 .. get_num_numa_nodes() - 1 in the order the
+// system lists them. Without NUMA information (and on Windows) there is a
+// single node 0.
+DISKANN_DLLEXPORT uint32_t get_num_numa_nodes();
+// The node of the CPU the calling thread is running on.
+DISKANN_DLLEXPORT uint32_t get_current_numa_node();
+// Restricts the calling thread to the CPUs of node; threads it starts later
+// inherit this. alloc_large() calls from the thread then prefer pages on node
+// over the process placement. Returns false if the thread could not be
+// pinned.
+DISKANN_DLLEXPORT bool pin_thread_to_numa_node(uint32_t node);
+// Calls fn(node) for every node at once, each on a new thread pinned to that
+// node, and rethrows the first exception any of them threw. With a single
+// node fn(0) runs on the calling thread.
+DISKANN_DLLEXPORT void run_on_each_numa_node(const std::function<void(uint32_t)> &fn);
+} // namespace diskann
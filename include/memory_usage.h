@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace diskann
+{
+// The bytes an index holds in memory, by component, as reported by
+// Index::get_memory_usage() and PQFlashIndex::get_memory_usage(). Buffers are
+// counted at their allocated size and containers at their capacity; hash
+// tables are estimated from their bucket counts. Memory mapped files count in
+// full whether or not their pages are resident.
+class MemoryUsage
+{
+  public:
+    // adds bytes to component, which is appended if it is new
+    void add(const std::string &component, uint64_t bytes)
+    {
+        for (auto &entry : _components)
+        {
+            if (entry.first == component)
+            {
+                entry.second += bytes;
+                return;
+            }
+        }
+        _components.emplace_back(component, bytes);
+    }
+
+    // adds the components of other
+    void add(const MemoryUsage &other)
+    {
+        for (const auto &entry : other._components)
+            add(entry.first, entry.second);
+    }
+
+    uint64_t get(const std::string &component) const
+    {
+        for (const auto &entry : _components)
+        {
+            if (entry.first == component)
+                return entry.second;
+        }
+        return 0;
+    }
+
+    uint64_t total() const
+    {
+        uint64_t bytes = 0;
+        for (const auto &entry : _components)
+            bytes += entry.second;
+        return bytes;
+    }
+
+    const std::vector<std::pair<std::string, uint64_t>> &components() const
+    {
+        return _components;
+    }
+
+    // {"total_bytes": ..., "components": {"<component>": bytes, ...}}
+    std::string to_json() const
+    {
+        std::ostringstream out;
+        out << "{\"total_bytes\":" << total() << ",\"components\":{";
+        for (size_t i = 0; i < _components.size(); i++)
+            out << (i == 0 ? "" : ",") << "\"" << _components[i].first << "\":" << _components[i].second;
+        out << "}}";
+        return out.str();
+    }
+
+  private:
+    std::vector<std::pair<std::string, uint64_t>> _components;
+};
+
+// bytes allocated for the elements of a vector
+template <typename V> uint64_t vector_bytes(const V &v)
+{
+    return (uint64_t)v.capacity() * sizeof(typename V::value_type);
+}
+
+// estimated bytes of an open addressing hash table such as tsl::robin_map,
+// whose buckets hold the values along with a few bytes of probe metadata
+template <typename M> uint64_t hash_table_bytes(const M &m)
+{
+    return (uint64_t)m.bucket_count() * (sizeof(typename M::value_type) + sizeof(uint64_t));
+}
+
+// estimated bytes of a node based hash table such as std::unordered_map: a
+// pointer per bucket and a heap node per element
+template <typename M> uint64_t node_hash_table_bytes(const M &m)
+{
+    return (uint64_t)m.bucket_count() * sizeof(void *) +
+           (uint64_t)m.size() * (sizeof(typename M::value_type) + 2 * sizeof(void *));
+}
+} // namespace diskann
@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#ifndef _WINDOWS
+
+#include <string>
+
+#include "aligned_file_reader.h"
+
+// AlignedFileReader over a memory-mapped disk index, for indices that fit in
+// the page cache. read() copies out of the mapping, and mapped_data() lets
+// PQFlashIndex::cached_beam_search() expand nodes in place, with no read
+// submitted and no copy into the sector scratch. The first touch of a page
+// still costs a (blocking) page fault, so with prefetch the whole file is
+// requested from the kernel at open(); only use it when RAM allows.
+class MmapAlignedFileReader : public AlignedFileReader
+{
+  private:
+    bool _prefetch;
+    char *_data = nullptr;
+    uint64_t _size = 0;
+    // reads need no context; every thread shares this one
+    IOContext _ctx = nullptr;
+
+  public:
+    MmapAlignedFileReader(bool prefetch = true);
+    ~MmapAlignedFileReader();
+
+    IOContext &get_ctx();
+
+    // reads ignore their context
+    bool has_file_independent_ctx()
+    {
+        return true;
+    }
+
+    // no-ops; mapped reads need no per-thread state
+    void register_thread();
+    void deregister_thread();
+    void deregister_all_threads();
+
+    // maps fname with MADV_RANDOM, as node reads do not benefit from
+    // read-ahead, and with prefetch also MADV_WILLNEED
+    void open(const std::string &fname);
+    void close();
+
+    // copies each request out of the mapping
+    void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false);
+
+    char *mapped_data()
+    {
+        return _data;
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "percentile_stats.h"
+#include "pq_flash_index.h"
+#include "shard_pool.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Searches the disk indices of the shards of one dataset with a query at once
+// and merges their results, as the REST multi-index server does but in
+// process. The shards of a query run on the threads of the searcher's pool.
+//
+// l_search is a budget for the whole query: each shard searched gets a share
+// proportional to its number of points, and at least k_search. With the
+// centroids of the shards, such as those partition() writes, a query can
+// search only the shards whose centroids are closest to it.
+template <typename T, typename LabelT = uint32_t> class MultiIndexSearcher
+{
+  public:
+    DISKANN_DLLEXPORT MultiIndexSearcher(uint32_t num_threads);
+
+    // Adds a loaded index as the next shard. With id_map_file, a bin file of
+    // one uint32 per point such as the _ids_uint32.bin of a partition, its
+    // results are reported with those ids in place of its own, and a point
+    // found in several overlapping shards is reported once.
+    DISKANN_DLLEXPORT void add_shard(std::shared_ptr<PQFlashIndex<T, LabelT>> index,
+                                     const std::string &id_map_file = std::string(""));
+
+    // Loads one centroid per shard, in the order the shards were added, from
+    // a float bin file such as the _centroids.bin of partition()
+    DISKANN_DLLEXPORT void load_centroids(const std::string &centroids_file);
+
+    // Writes the k_search closest points over the shards searched, closest
+    // first, to res_ids and res_dists, and the shard of each to res_shards
+    // if given. With num_probes > 0 and centroids loaded, only the num_probes
+    // shards of closest centroids are searched. stats, if given, adds up the
+    // counters of the shards, with total_us the time of the whole query.
+    // Returns the number of results, below k_search only if the shards
+    // searched hold fewer points.
+    DISKANN_DLLEXPORT uint64_t search(const T *query, const uint64_t k_search, const uint64_t l_search,
+                                      uint64_t *res_ids, float *res_dists, const uint64_t beam_width,
+                                      const uint32_t num_probes = 0, uint32_t *res_shards = nullptr,
+                                      QueryStats *stats = nullptr);
+
+    size_t num_shards() const
+    {
+        return _shards.size();
+    }
+
+  private:
+    // the shards to search for query, closest centroid first
+    std::vector<uint32_t> route(const T *query, const uint32_t num_probes);
+
+    struct Shard
+    {
+        std::shared_ptr<PQFlashIndex<T, LabelT>> index;
+        uint64_t num_points;
+        std::vector<uint32_t> id_map;
+    };
+    std::vector<Shard> _shards;
+    std::vector<float> _centroids;
+    size_t _centroid_dim = 0;
+    std::unique_ptr<ShardPool> _pool;
+};
+} // namespace diskann
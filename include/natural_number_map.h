@@ -46,6 +46,8 @@ template <typename Key, typename Value> class natural_number_map
 
     void reserve(size_t count);
     size_t size() const;
+    // bytes allocated for the values and the bitset
+    size_t memory_size() const;
 
     void set(Key key, Value value);
     void erase(Key key);
@@ -33,6 +33,8 @@ template <typename T> class natural_number_set
     T pop_any();
     void clear();
     size_t size() const;
+    // bytes allocated for the values and the bitset
+    size_t memory_size() const;
     bool is_in_set(T id) const;
 
   private:
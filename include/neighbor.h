@@ -4,6 +4,8 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <vector>
 #include "utils.h"
@@ -36,6 +38,12 @@ struct Neighbor
 
 // Invariant: after every `insert` and `closest_unexpanded()`, `_cur` points to
 //            the first Neighbor which is unexpanded.
+//
+// Neighbors are kept as 64-bit keys, the distance bits mapped to an unsigned
+// integer with the same order above the id, so that comparing two keys orders
+// them exactly as Neighbor::operator< does. Insertion is then a branchless
+// binary search over integers and a move of 8 instead of 12 bytes per entry;
+// the expanded flags live in a separate byte array.
 class NeighborPriorityQueue
 {
   public:
@@ -43,7 +51,8 @@ class NeighborPriorityQueue
     {
     }
 
-    explicit NeighborPriorityQueue(size_t capacity) : _size(0), _capacity(capacity), _cur(0), _data(capacity + 1)
+    explicit NeighborPriorityQueue(size_t capacity)
+        : _size(0), _capacity(capacity), _cur(0), _keys(capacity + 1), _expanded(capacity + 1)
     {
     }
 
@@ -54,35 +63,40 @@ class NeighborPriorityQueue
     // next item will be set to the lowest index of an uncheck item
     void insert(const Neighbor &nbr)
     {
-        if (_size == _capacity && _data[_size - 1] < nbr)
+        const uint64_t key = to_key(nbr);
+        if (_size == _capacity && _keys[_size - 1] < key)
         {
             return;
         }
 
-        size_t lo = 0, hi = _size;
-        while (lo < hi)
+        // first key not below key
+        size_t lo = 0;
+        if (_size > 0)
         {
-            size_t mid = (lo + hi) >> 1;
-            if (nbr < _data[mid])
+            const uint64_t *base = _keys.data();
+            size_t n = _size;
+            while (n > 1)
             {
-                hi = mid;
-                // Make sure the same id isn't inserted into the set
-            }
-            else if (_data[mid].id == nbr.id)
-            {
-                return;
-            }
-            else
-            {
-                lo = mid + 1;
+                size_t half = n >> 1;
+                base = base[half] < key ? base + half : base;
+                n -= half;
             }
+            lo = (base - _keys.data()) + (*base < key);
+        }
+
+        // Make sure the same id isn't inserted into the set
+        if (lo < _size && _keys[lo] == key)
+        {
+            return;
         }
 
         if (lo < _capacity)
         {
-            std::memmove(&_data[lo + 1], &_data[lo], (_size - lo) * sizeof(Neighbor));
+            std::memmove(&_keys[lo + 1], &_keys[lo], (_size - lo) * sizeof(uint64_t));
+            std::memmove(&_expanded[lo + 1], &_expanded[lo], (_size - lo) * sizeof(uint8_t));
         }
-        _data[lo] = {nbr.id, nbr.distance};
+        _keys[lo] = key;
+        _expanded[lo] = 0;
         if (_size < _capacity)
         {
             _size++;
@@ -95,13 +109,13 @@ class NeighborPriorityQueue
 
     Neighbor closest_unexpanded()
     {
-        _data[_cur].expanded = true;
+        _expanded[_cur] = 1;
         size_t pre = _cur;
-        while (_cur < _size && _data[_cur].expanded)
+        while (_cur < _size && _expanded[_cur])
         {
             _cur++;
         }
-        return _data[pre];
+        return (*this)[pre];
     }
 
     bool has_unexpanded_node() const
@@ -121,21 +135,25 @@ class NeighborPriorityQueue
 
     void reserve(size_t capacity)
     {
-        if (capacity + 1 > _data.size())
+        if (capacity + 1 > _keys.size())
         {
-            _data.resize(capacity + 1);
+            _keys.resize(capacity + 1);
+            _expanded.resize(capacity + 1);
         }
         _capacity = capacity;
     }
 
-    Neighbor &operator[](size_t i)
+    // bytes allocated for the queue
+    size_t memory_size() const
     {
-        return _data[i];
+        return _keys.capacity() * sizeof(uint64_t) + _expanded.capacity() * sizeof(uint8_t);
     }
 
     Neighbor operator[](size_t i) const
     {
-        return _data[i];
+        Neighbor nbr((unsigned)_keys[i], to_distance(_keys[i]));
+        nbr.expanded = _expanded[i] != 0;
+        return nbr;
     }
 
     void clear()
@@ -145,8 +163,30 @@ class NeighborPriorityQueue
     }
 
   private:
+    // Flipping the sign bit of non-negative floats and all bits of negative
+    // ones orders their bit patterns like the values. -0 is folded into +0,
+    // which compares equal to it.
+    static inline uint64_t to_key(const Neighbor &nbr)
+    {
+        const float distance = nbr.distance + 0.0f;
+        uint32_t bits;
+        std::memcpy(&bits, &distance, sizeof(bits));
+        bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        return ((uint64_t)bits << 32) | nbr.id;
+    }
+
+    static inline float to_distance(uint64_t key)
+    {
+        uint32_t bits = (uint32_t)(key >> 32);
+        bits = (bits & 0x80000000u) ? (bits & 0x7FFFFFFFu) : ~bits;
+        float distance;
+        std::memcpy(&distance, &bits, sizeof(distance));
+        return distance;
+    }
+
     size_t _size, _capacity, _cur;
-    std::vector<Neighbor> _data;
+    std::vector<uint64_t> _keys;
+    std::vector<uint8_t> _expanded;
 };
 
 } // namespace diskann
@@ -0,0 +1,269 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <omp.h>
+#ifndef _WINDOWS
+#include <unistd.h>
+#endif
+
+#include "ann_exception.h"
+#include "compressed_file.h"
+#include "defaults.h"
+#include "memory_bin_file.h"
+
+#ifndef _WINDOWS
+// Opens filename for reading or writing by parallel_file_io(). With direct
+// set it bypasses the page cache, unless the file system has no direct I/O;
+// is_direct tells which.
+inline int open_for_parallel_io(const std::string &filename, bool for_write, bool direct, bool &is_direct)
+{
+    const int flags = for_write ? O_WRONLY : O_RDONLY;
+    int fd = direct ? ::open(filename.c_str(), flags | O_DIRECT) : -1;
+    is_direct = fd != -1;
+    if (fd == -1 && (!direct || errno == EINVAL))
+        fd = ::open(filename.c_str(), flags);
+    if (fd == -1)
+        throw diskann::ANNException("Failed to open " + filename + ": " + std::strerror(errno), -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+    return fd;
+}
+
+// pread()s or pwrite()s all of len bytes, and returns how many were read
+// before the end of the file
+inline size_t transfer_fully(int fd, const std::string &filename, char *buf, size_t len, size_t offset,
+                             bool for_write)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        const ssize_t ret = for_write ? ::pwrite(fd, buf + done, len - done, (off_t)(offset + done))
+                                      : ::pread(fd, buf + done, len - done, (off_t)(offset + done));
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0 || (ret == 0 && for_write))
+            throw diskann::ANNException(std::string("Failed to ") + (for_write ? "write to " : "read from ") +
+                                            filename + ": " + std::strerror(errno),
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (ret == 0)
+            break;
+        done += ret;
+    }
+    return done;
+}
+#endif
+
+// Reads len bytes at offset of filename into buf, or writes them from buf if
+// for_write is set; the file must exist. Transfers of more than one
+// PARALLEL_READ_CHUNK_SIZE chunk are spread over num_threads threads (all
+// OpenMP threads if 0), each with its own handle on the file, so that several
+// requests are in flight at once on NVMe drives.
+//
+// With direct set, Linux moves the whole sectors of the range through sector
+// aligned buffers with O_DIRECT, which keeps a file that is read or written
+// once from evicting everything else in the page cache. The partial sectors
+// at either end of a write are written through the page cache once the rest
+// is on disk, so that the two kinds of write never share a page.
+inline void parallel_file_io(const std::string &filename, char *buf, size_t offset, size_t len, bool for_write,
+                             uint32_t num_threads = 0, bool direct = false)
+{
+    if (len == 0)
+        return;
+    if (num_threads == 0)
+        num_threads = (uint32_t)omp_get_max_threads();
+    const size_t chunk_size = diskann::defaults::PARALLEL_READ_CHUNK_SIZE;
+    // chunks start at multiples of chunk_size in the file, so that they are
+    // sector aligned
+    const size_t first_chunk = offset / chunk_size;
+    const int64_t num_chunks = (int64_t)((offset + len + chunk_size - 1) / chunk_size - first_chunk);
+
+#ifdef _WINDOWS
+    (void)direct;
+    auto open_stream = [&](std::fstream &stream) {
+        stream.exceptions(std::ios::badbit | std::ios::failbit);
+        stream.open(filename, std::ios::binary | (for_write ? std::ios::in | std::ios::out : std::ios::in));
+    };
+    auto transfer = [&](std::fstream &stream, size_t start, size_t end) {
+        if (for_write)
+        {
+            stream.seekp(start, stream.beg);
+            stream.write(buf + (start - offset), end - start);
+        }
+        else
+        {
+            stream.seekg(start, stream.beg);
+            stream.read(buf + (start - offset), end - start);
+        }
+    };
+
+    if (num_threads == 1 || num_chunks <= 1)
+    {
+        std::fstream stream;
+        open_stream(stream);
+        transfer(stream, offset, offset + len);
+        return;
+    }
+#else
+    const size_t sector = diskann::defaults::SECTOR_LEN;
+    const size_t end = offset + len;
+    // the whole sectors of the range, moved with direct I/O
+    const size_t direct_start = for_write ? (offset + sector - 1) / sector * sector : offset / sector * sector;
+    const size_t direct_end = for_write ? end / sector * sector : (end + sector - 1) / sector * sector;
+
+    // moves [start, stop) of the range with fd, through bounce if it is direct
+    auto transfer = [&](int fd, bool is_direct, char *bounce, size_t start, size_t stop) {
+        if (!is_direct)
+        {
+            if (transfer_fully(fd, filename, buf + (start - offset), stop - start, start, for_write) < stop - start)
+                throw diskann::ANNException("Unexpected end of file " + filename, -1, __FUNCSIG__, __FILE__,
+                                            __LINE__);
+            return;
+        }
+        if (for_write)
+        {
+            std::memcpy(bounce, buf + (start - offset), stop - start);
+            transfer_fully(fd, filename, bounce, stop - start, start, true);
+            return;
+        }
+        const size_t lo = start / sector * sector;
+        const size_t got = transfer_fully(fd, filename, bounce, (stop + sector - 1) / sector * sector - lo, lo, false);
+        if (got < stop - lo)
+            throw diskann::ANNException("Unexpected end of file " + filename, -1, __FUNCSIG__, __FILE__, __LINE__);
+        std::memcpy(buf + (start - offset), bounce + (start - lo), stop - start);
+    };
+
+    if (!direct || direct_start >= direct_end)
+    {
+        direct = false;
+        if (num_threads == 1 || num_chunks <= 1)
+        {
+            bool is_direct;
+            const int fd = open_for_parallel_io(filename, for_write, false, is_direct);
+            try
+            {
+                transfer(fd, false, nullptr, offset, end);
+            }
+            catch (...)
+            {
+                ::close(fd);
+                throw;
+            }
+            ::close(fd);
+            return;
+        }
+    }
+#endif
+
+    std::exception_ptr error = nullptr;
+#pragma omp parallel num_threads((int)std::min<int64_t>(num_threads, num_chunks))
+    {
+#ifdef _WINDOWS
+        std::fstream stream;
+#else
+        int fd = -1;
+        bool is_direct = false;
+        char *bounce = nullptr;
+#endif
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t c = 0; c < num_chunks; c++)
+        {
+            try
+            {
+                const size_t chunk_start = std::max(offset, (first_chunk + c) * chunk_size);
+                const size_t chunk_end = std::min(offset + len, (first_chunk + c + 1) * chunk_size);
+#ifdef _WINDOWS
+                if (!stream.is_open())
+                    open_stream(stream);
+                transfer(stream, chunk_start, chunk_end);
+#else
+                if (fd == -1)
+                {
+                    fd = open_for_parallel_io(filename, for_write, direct, is_direct);
+                    if (is_direct && posix_memalign((void **)&bounce, sector, chunk_size) != 0)
+                        throw diskann::ANNException("Failed to allocate a buffer for " + filename, -1, __FUNCSIG__,
+                                                    __FILE__, __LINE__);
+                }
+                if (!is_direct)
+                {
+                    transfer(fd, false, nullptr, chunk_start, chunk_end);
+                }
+                else
+                {
+                    const size_t start = std::max(chunk_start, direct_start);
+                    const size_t stop = std::min(chunk_end, direct_end);
+                    if (start < stop)
+                        transfer(fd, true, bounce, start, stop);
+                }
+#endif
+            }
+            catch (...)
+            {
+#pragma omp critical
+                if (error == nullptr)
+                    error = std::current_exception();
+            }
+        }
+#ifndef _WINDOWS
+        std::free(bounce);
+        if (fd != -1)
+            ::close(fd);
+#endif
+    }
+    if (error != nullptr)
+        std::rethrow_exception(error);
+
+#ifndef _WINDOWS
+    // the partial sectors at the ends, once the direct writes are done
+    if (direct && for_write)
+    {
+        bool is_direct;
+        const int fd = open_for_parallel_io(filename, true, false, is_direct);
+        try
+        {
+            transfer(fd, false, nullptr, offset, direct_start);
+            transfer(fd, false, nullptr, direct_end, end);
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+#endif
+}
+
+// Reads len bytes at offset of filename into buf; a CompressedFile is read as
+// the file it was compressed from, and a MemoryBinFile from memory.
+inline void read_file_parallel(const std::string &filename, char *buf, size_t offset, size_t len,
+                               uint32_t num_threads = 0, bool direct = false)
+{
+    if (const diskann::MemoryBinFile *memory_file = diskann::MemoryBinFile::find(filename))
+    {
+        memory_file->read(buf, offset, len);
+        return;
+    }
+    if (diskann::CompressedFile::is_compressed(filename))
+    {
+        diskann::CompressedFile(filename).read(buf, offset, len, num_threads);
+        return;
+    }
+    parallel_file_io(filename, buf, offset, len, false, num_threads, direct);
+}
+
+inline void write_file_parallel(const std::string &filename, const char *buf, size_t offset, size_t len,
+                                uint32_t num_threads = 0, bool direct = false)
+{
+    parallel_file_io(filename, const_cast<char *>(buf), offset, len, true, num_threads, direct);
+}
@@ -23,13 +23,21 @@ class IndexWriteParameters
     const float alpha;
     const uint32_t num_threads;
     const uint32_t filter_list_size; // Lf
+    const uint32_t num_passes;
+    const float first_pass_alpha;          // alpha of all passes but the last
+    const uint32_t first_pass_num_threads; // threads of all passes but the last; 0 for num_threads
+    const uint32_t locality_clusters;      // > 0 visits the points grouped by nearest sampled pivot
 
     IndexWriteParameters(const uint32_t search_list_size, const uint32_t max_degree, const bool saturate_graph,
                          const uint32_t max_occlusion_size, const float alpha, const uint32_t num_threads,
-                         const uint32_t filter_list_size)
+                         const uint32_t filter_list_size, const uint32_t num_passes = defaults::BUILD_NUM_PASSES,
+                         const float first_pass_alpha = defaults::FIRST_PASS_ALPHA,
+                         const uint32_t first_pass_num_threads = 0,
+                         const uint32_t locality_clusters = defaults::LOCALITY_CLUSTERS)
         : search_list_size(search_list_size), max_degree(max_degree), saturate_graph(saturate_graph),
           max_occlusion_size(max_occlusion_size), alpha(alpha), num_threads(num_threads),
-          filter_list_size(filter_list_size)
+          filter_list_size(filter_list_size), num_passes(num_passes), first_pass_alpha(first_pass_alpha),
+          first_pass_num_threads(first_pass_num_threads), locality_clusters(locality_clusters)
     {
     }
 
@@ -91,16 +99,38 @@ class IndexWriteParametersBuilder
         return *this;
     }
 
+    // Builds the graph in num_passes passes over all points; all but the last
+    // use first_pass_alpha (1 builds a sparse graph quickly that the last
+    // pass refines) and first_pass_num_threads threads, if not 0
+    IndexWriteParametersBuilder &with_num_passes(const uint32_t num_passes, const float first_pass_alpha,
+                                                 const uint32_t first_pass_num_threads = 0)
+    {
+        _num_passes = num_passes == 0 ? 1 : num_passes;
+        _first_pass_alpha = first_pass_alpha;
+        _first_pass_num_threads = first_pass_num_threads;
+        return *this;
+    }
+
+    // Visits the points grouped by the nearest of this many sampled pivots,
+    // so that threads work on nearby points at the same time
+    IndexWriteParametersBuilder &with_locality_clusters(const uint32_t locality_clusters)
+    {
+        _locality_clusters = locality_clusters;
+        return *this;
+    }
+
     IndexWriteParameters build() const
     {
         return IndexWriteParameters(_search_list_size, _max_degree, _saturate_graph, _max_occlusion_size, _alpha,
-                                    _num_threads, _filter_list_size);
+                                    _num_threads, _filter_list_size, _num_passes, _first_pass_alpha,
+                                    _first_pass_num_threads, _locality_clusters);
     }
 
     IndexWriteParametersBuilder(const IndexWriteParameters &wp)
         : _search_list_size(wp.search_list_size), _max_degree(wp.max_degree),
           _max_occlusion_size(wp.max_occlusion_size), _saturate_graph(wp.saturate_graph), _alpha(wp.alpha),
-          _filter_list_size(wp.filter_list_size)
+          _filter_list_size(wp.filter_list_size), _num_passes(wp.num_passes), _first_pass_alpha(wp.first_pass_alpha),
+          _first_pass_num_threads(wp.first_pass_num_threads), _locality_clusters(wp.locality_clusters)
     {
     }
     IndexWriteParametersBuilder(const IndexWriteParametersBuilder &) = delete;
@@ -114,6 +144,10 @@ class IndexWriteParametersBuilder
     float _alpha{defaults::ALPHA};
     uint32_t _num_threads{defaults::NUM_THREADS};
     uint32_t _filter_list_size{defaults::FILTER_LIST_SIZE};
+    uint32_t _num_passes{defaults::BUILD_NUM_PASSES};
+    float _first_pass_alpha{defaults::FIRST_PASS_ALPHA};
+    uint32_t _first_pass_num_threads{0};
+    uint32_t _locality_clusters{defaults::LOCALITY_CLUSTERS};
 };
 
 } // namespace diskann
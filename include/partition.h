@@ -27,11 +27,12 @@ void gen_random_slice(const T *inputdata, size_t npts, size_t ndims, double p_va
                       size_t &slice_size);
 
 int estimate_cluster_sizes(float *test_data_float, size_t num_test, float *pivots, const size_t num_centers,
-                           const size_t dim, const size_t k_base, std::vector<size_t> &cluster_sizes);
+                           const size_t dim, const size_t k_base, std::vector<size_t> &cluster_sizes,
+                           const float *center_penalties = nullptr);
 
 template <typename T>
 int shard_data_into_clusters(const std::string data_file, float *pivots, const size_t num_centers, const size_t dim,
-                             const size_t k_base, std::string prefix_path);
+                             const size_t k_base, std::string prefix_path, const float *center_penalties = nullptr);
 
 template <typename T>
 int shard_data_into_clusters_only_ids(const std::string data_file, float *pivots, const size_t num_centers,
@@ -44,6 +45,16 @@ template <typename T>
 int partition(const std::string data_file, const float sampling_rate, size_t num_centers, size_t max_k_means_reps,
               const std::string prefix_path, size_t k_base);
 
+// With minibatch_kmeans, each attempt at a number of parts runs mini-batch
+// k-means with early stopping instead of full Lloyd iterations, and starts
+// from the centers of the previous attempt plus k-means++ seeds for the new
+// parts. The ids and the data of each shard are written in one pass over
+// data_file, to prefix_path + "_subshard-<i>_ids_uint32.bin" and ".bin".
+// With balance_tolerance > 0, the centers of each attempt are balanced with
+// kmeans::balance_centers() so that no part holds more than 1 +
+// balance_tolerance times the average, and the points are assigned with the
+// penalties found; the parts then take about as long to build.
 template <typename T>
 int partition_with_ram_budget(const std::string data_file, const double sampling_rate, double ram_budget,
-                              size_t graph_degree, const std::string prefix_path, size_t k_base);
+                              size_t graph_degree, const std::string prefix_path, size_t k_base,
+                              bool minibatch_kmeans = false, float balance_tolerance = 0);
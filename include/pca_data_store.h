@@ -0,0 +1,110 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "distance.h"
+#include "abstract_data_store.h"
+
+namespace diskann
+{
+// Stores each vector as its projection on the num_pca_dims principal
+// components of the data it was populated with, in float. The query is
+// projected once by preprocess_query(), so a hop of graph traversal reads
+// num_pca_dims floats per neighbour instead of the full vector. Like
+// SQDataStore, it is used for graph traversal alongside the full precision
+// InMemDataStore, which still prunes the graph and re-ranks the results.
+//
+// The components are those of the covariance of the data for L2 and of its
+// uncentered second moment for inner product. Vectors are projected without
+// centering, which leaves both distances unchanged within the subspace.
+template <typename data_t> class PCADataStore : public AbstractDataStore<data_t>
+{
+  public:
+    // num_pca_dims is at most dim
+    PCADataStore(size_t dim, location_t num_points, uint32_t num_pca_dims,
+                 std::unique_ptr<Distance<data_t>> distance_fn);
+    PCADataStore(const PCADataStore &) = delete;
+    PCADataStore &operator=(const PCADataStore &) = delete;
+    ~PCADataStore();
+
+    // Loads the projected vectors from filename and the components from
+    // get_params_filename(filename).
+    virtual location_t load(const std::string &filename) override;
+    virtual size_t save(const std::string &filename, const location_t num_points) override;
+
+    // The dimension of the vectors the store takes, which is not padded
+    virtual size_t get_aligned_dim() const override;
+    virtual size_t memory_size() const override;
+
+    // Learn the components from a sample of the vectors, then project them
+    virtual void populate_data(const data_t *vectors, const location_t num_pts) override;
+    virtual void populate_data(const std::string &filename, const size_t offset) override;
+
+    virtual void extract_data_to_bin(const std::string &filename, const location_t num_pts) override;
+
+    // get_vector maps the projection back to the full dimension, which gives
+    // the part of the vector within the subspace; set_vector projects
+    virtual void get_vector(const location_t i, data_t *target) const override;
+    virtual void set_vector(const location_t i, const data_t *const vector) override;
+    virtual void prefetch_vector(const location_t loc) override;
+
+    virtual void move_vectors(const location_t old_location_start, const location_t new_location_start,
+                              const location_t num_points) override;
+    virtual void copy_vectors(const location_t from_loc, const location_t to_loc, const location_t num_points) override;
+
+    // Writes the projected query the batched get_distance() overloads
+    // compare against into the PQScratch of scratch.
+    virtual void preprocess_query(const data_t *query, AbstractScratch<data_t> *scratch) const override;
+
+    virtual float get_distance(const data_t *query, const location_t loc) const override;
+    virtual float get_distance(const location_t loc1, const location_t loc2) const override;
+
+    // NOTE: Caller must invoke preprocess_query ONCE before calling this
+    // function.
+    virtual void get_distance(const data_t *preprocessed_query, const location_t *locations,
+                              const uint32_t location_count, float *distances,
+                              AbstractScratch<data_t> *scratch_space) const override;
+    virtual void get_distance(const data_t *preprocessed_query, const std::vector<location_t> &ids,
+                              std::vector<float> &distances, AbstractScratch<data_t> *scratch_space) const override;
+
+    // The full precision distance function, as for PQDataStore.
+    virtual Distance<data_t> *get_dist_fn() const override;
+
+    virtual location_t calculate_medoid() const override;
+
+    virtual size_t get_alignment_factor() const override;
+
+    static std::string get_params_filename(const std::string &filename)
+    {
+        return filename + "_components.bin";
+    }
+
+  protected:
+    virtual location_t expand(const location_t new_size) override;
+    virtual location_t shrink(const location_t new_size) override;
+
+    virtual location_t load_impl(const std::string &filename);
+
+  private:
+    // learns _components from an evenly spaced sample of the vectors
+    void train(const data_t *vectors, const location_t num_pts);
+    // projects num_pts vectors into num_pts rows of projected
+    void project(const data_t *vectors, const location_t num_pts, float *projected) const;
+    void reallocate_vectors(const location_t new_size);
+
+    uint32_t _num_pca_dims;
+    // rows of projected vectors, padded with zeros to a whole number of AVX
+    // registers for the float kernels
+    size_t _aligned_pca_dims;
+    float *_vectors = nullptr;
+
+    // [_aligned_pca_dims x dim], row r the r-th principal component; the
+    // padding rows are zero
+    std::vector<float> _components;
+
+    Metric _distance_metric;
+    std::unique_ptr<Distance<data_t>> _distance_fn;
+    // distances between projected vectors
+    std::unique_ptr<Distance<float>> _projected_distance_fn;
+    Batch4DistanceFn<float> _batch4_distance_fn = nullptr;
+};
+} // namespace diskann
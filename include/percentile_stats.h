@@ -23,6 +23,8 @@ struct QueryStats
     float total_us = 0; // total time to process query in micros
     float io_us = 0;    // total time spent in IO
     float cpu_us = 0;   // total time spent in CPU
+    float pq_us = 0;    // time spent on PQ distances, part of cpu_us
+    float fp_us = 0;    // time spent on full precision distances
 
     unsigned n_4k = 0;         // # of 4kB reads
     unsigned n_8k = 0;         // # of 8kB reads
@@ -33,6 +35,8 @@ struct QueryStats
     unsigned n_cmps = 0;       // # cmps
     unsigned n_cache_hits = 0; // # cache_hits
     unsigned n_hops = 0;       // # search hops
+    unsigned n_spec_reads = 0; // # speculative reads, part of n_ios
+    unsigned n_spec_hits = 0;  // # speculative reads a later hop used
 };
 
 template <typename T>
@@ -13,11 +13,19 @@ class FixedChunkPQTable
     float *tables = nullptr; // pq_tables = float array of size [256 * ndims]
     uint64_t ndims = 0;      // ndims = true dimension of vectors
     uint64_t n_chunks = 0;
+    uint64_t n_centers = NUM_PQ_CENTROIDS; // 256, 16 for 4-bit fast-scan PQ, or up to 2^16 for wide PQ
+    // entries per dimension of tables_tr and per chunk of the distance
+    // tables: max(256, n_centers)
+    uint64_t table_stride = NUM_PQ_CENTROIDS;
     bool use_rotation = false;
     uint32_t *chunk_offsets = nullptr;
     float *centroid = nullptr;
     float *tables_tr = nullptr; // same as pq_tables, but col-major
     float *rotmat_tr = nullptr;
+    std::vector<float> center_sq_norms; // [n_chunks * table_stride]
+
+    void populate_chunk_tables_batch(const float *query_vecs, const size_t nq, const size_t query_stride,
+                                     float *const *dist_vecs, const bool inner_product);
 
   public:
     FixedChunkPQTable();
@@ -32,11 +40,20 @@ class FixedChunkPQTable
 
     uint32_t get_num_chunks();
 
+    uint32_t get_num_centers();
+
+    // the populated distance tables take get_table_stride() * n_chunks floats
+    uint32_t get_table_stride();
+
+    // bytes of the pivots, centroid, chunk offsets and rotation matrix
+    size_t memory_size() const;
+
     void preprocess_query(float *query_vec);
 
     // assumes pre-processed query
     void populate_chunk_distances(const float *query_vec, float *dist_vec);
 
+    // these three take uint8 codes, i.e. codebooks of at most 256 centroids
     float l2_distance(const float *query_vec, uint8_t *base_vec);
 
     float inner_product(const float *query_vec, uint8_t *base_vec);
@@ -45,6 +62,19 @@ class FixedChunkPQTable
     void inflate_vector(uint8_t *base_vec, float *out_vec);
 
     void populate_chunk_inner_products(const float *query_vec, float *dist_vec);
+
+    // Hamming distances of the query bytes to the centers of binary PQ
+    void populate_chunk_hamming_distances(const float *query_vec, float *dist_vec);
+
+    // populate_chunk_distances and populate_chunk_inner_products for nq
+    // pre-processed queries, query q at query_vecs + q * query_stride and its
+    // table at dist_vecs[q]. One GEMM per chunk scores all queries at once,
+    // which amortises the table setup over a batch.
+    void populate_chunk_distances_batch(const float *query_vecs, const size_t nq, const size_t query_stride,
+                                        float *const *dist_vecs);
+
+    void populate_chunk_inner_products_batch(const float *query_vecs, const size_t nq, const size_t query_stride,
+                                             float *const *dist_vecs);
 };
 
 void aggregate_coords(const std::vector<unsigned> &ids, const uint8_t *all_coords, const uint64_t ndims, uint8_t *out);
@@ -59,10 +89,43 @@ void aggregate_coords(const unsigned *ids, const uint64_t n_ids, const uint8_t *
 void pq_dist_lookup(const uint8_t *pq_ids, const size_t n_pts, const size_t pq_nchunks, const float *pq_dists,
                     float *dists_out);
 
+// aggregate_coords followed by pq_dist_lookup in one pass: reads the codes of
+// ids straight from all_coords, without copying them to a scratch buffer
+void gather_pq_dist_lookup(const uint32_t *ids, const size_t n_ids, const uint8_t *all_coords, const size_t pq_nchunks,
+                           const float *pq_dists, float *dists_out);
+
+// gather_pq_dist_lookup for wide PQ: all_codes holds pq_nchunks uint16 codes
+// per point, and pq_dists table_stride floats per chunk
+void gather_pq_dist_lookup_wide(const uint32_t *ids, const size_t n_ids, const uint16_t *all_codes,
+                                const size_t pq_nchunks, const size_t table_stride, const float *pq_dists,
+                                float *dists_out);
+
+// 4-bit fast-scan PQ. Codes of chunks 2b and 2b+1 share byte b (low and high
+// nibble), so a point takes DIV_ROUND_UP(n_chunks, 2) bytes.
+DISKANN_DLLEXPORT void pack_fast_scan_codes(const uint8_t *codes, const size_t n_pts, const size_t n_chunks,
+                                            uint8_t *packed);
+
+DISKANN_DLLEXPORT void unpack_fast_scan_codes(const uint8_t *packed, const size_t n_chunks, uint8_t *codes);
+
+// pq_dists is laid out as for pq_dist_lookup (256 floats per chunk), of which
+// only the first 16 entries of each chunk are read
+DISKANN_DLLEXPORT void quantize_fast_scan_lut(const float *pq_dists, const size_t n_chunks, FastScanLUT &out);
+
+// packed_codes holds n_pts points of DIV_ROUND_UP(pq_nchunks, 2) bytes each,
+// e.g. as gathered by aggregate_coords
+DISKANN_DLLEXPORT void fast_scan_dist_lookup(const uint8_t *packed_codes, const size_t n_pts, const size_t pq_nchunks,
+                                             const FastScanLUT &lut, float *dists_out);
+
 DISKANN_DLLEXPORT int generate_pq_pivots(const float *const train_data, size_t num_train, unsigned dim,
                                          unsigned num_centers, unsigned num_pq_chunks, unsigned max_k_means_reps,
                                          std::string pq_pivots_path, bool make_zero_mean = false);
 
+// k-majority pivots for the Hamming distance on bit-packed uint8 vectors
+// given as floats, with num_pq_chunks contiguous byte chunks
+DISKANN_DLLEXPORT int generate_binary_pq_pivots(const float *const train_data, size_t num_train, uint32_t dim,
+                                                uint32_t num_centers, uint32_t num_pq_chunks,
+                                                uint32_t max_k_means_reps, std::string pq_pivots_path);
+
 DISKANN_DLLEXPORT int generate_opq_pivots(const float *train_data, size_t num_train, unsigned dim, unsigned num_centers,
                                           unsigned num_pq_chunks, std::string opq_pivots_path,
                                           bool make_zero_mean = false);
@@ -73,7 +136,7 @@ DISKANN_DLLEXPORT int generate_pq_pivots_simplified(const float *train_data, siz
 template <typename T>
 int generate_pq_data_from_pivots(const std::string &data_file, unsigned num_centers, unsigned num_pq_chunks,
                                  const std::string &pq_pivots_path, const std::string &pq_compressed_vectors_path,
-                                 bool use_opq = false);
+                                 bool use_opq = false, diskann::Metric metric = diskann::Metric::L2);
 
 DISKANN_DLLEXPORT int generate_pq_data_from_pivots_simplified(const float *data, const size_t num,
                                                               const float *pivot_data, const size_t pivots_num,
@@ -89,5 +152,5 @@ template <typename T>
 void generate_quantized_data(const std::string &data_file_to_use, const std::string &pq_pivots_path,
                              const std::string &pq_compressed_vectors_path, const diskann::Metric compareMetric,
                              const double p_val, const uint64_t num_pq_chunks, const bool use_opq,
-                             const std::string &codebook_prefix = "");
+                             const std::string &codebook_prefix = "", const uint32_t num_centers = NUM_PQ_CENTROIDS);
 } // namespace diskann
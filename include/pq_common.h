@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <sstream>
 
@@ -10,6 +11,14 @@
 #define MAX_PQ_TRAINING_SET_SIZE 256000
 #define MAX_PQ_CHUNKS 512
 
+// 4-bit PQ: 16 centroids per chunk, two codes per byte, scored with the
+// fast-scan kernel
+#define NUM_PQ_CENTROIDS_FAST_SCAN 16
+
+// wide PQ: more than 256 centroids per chunk, up to this many, with uint16
+// codes (two bytes per chunk) in the compressed vectors
+#define MAX_NUM_PQ_CENTROIDS_WIDE 65536
+
 namespace diskann
 {
 inline std::string get_quantized_vectors_filename(const std::string &prefix, bool use_opq, uint32_t num_chunks)
@@ -17,11 +26,30 @@ inline std::string get_quantized_vectors_filename(const std::string &prefix, boo
     return prefix + (use_opq ? "_opq" : "pq") + std::to_string(num_chunks) + "_compressed.bin";
 }
 
+// bytes of one chunk code in the compressed vectors file, whose header still
+// counts chunks
+inline uint64_t get_pq_code_size(uint64_t num_centers)
+{
+    if (num_centers <= NUM_PQ_CENTROIDS)
+        return sizeof(uint8_t);
+    return num_centers <= MAX_NUM_PQ_CENTROIDS_WIDE ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
 inline std::string get_pivot_data_filename(const std::string &prefix, bool use_opq, uint32_t num_chunks)
 {
     return prefix + (use_opq ? "_opq" : "pq") + std::to_string(num_chunks) + "_pivots.bin";
 }
 
+// Query <-> centroid distances of a 16-centroid PQ table quantized to uint8,
+// 16 entries per chunk, so that the fast-scan kernel can do table lookups in
+// SIMD registers. The distance to a point is bias + scale * (sum of entries).
+struct FastScanLUT
+{
+    uint8_t *lut = nullptr; // [NUM_PQ_CENTROIDS_FAST_SCAN * ROUND_UP(n_chunks, 2)]
+    float bias = 0;
+    float scale = 1;
+};
+
 inline std::string get_rotation_matrix_suffix(const std::string &pivot_data_filename)
 {
     return pivot_data_filename + "_rotation_matrix.bin";
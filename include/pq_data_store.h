@@ -33,6 +33,7 @@ template <typename data_t> class PQDataStore : public AbstractDataStore<data_t>
     // Since base class function is pure virtual, we need to declare it here, even though alignent concept is not needed
     // for Quantized data stores.
     virtual size_t get_aligned_dim() const override;
+    virtual size_t memory_size() const override;
 
     // Populate quantized data from unaligned data using PQ functionality
     virtual void populate_data(const data_t *vectors, const location_t num_pts) override;
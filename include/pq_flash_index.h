@@ -4,15 +4,33 @@
 #pragma once
 #include "common_includes.h"
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
 #include "aligned_file_reader.h"
-#include "concurrent_queue.h"
+#include "scratch_pool.h"
+#include "index.h"
+#include "memory_policy.h"
+#include "dynamic_sector_cache.h"
+#include "executor.h"
+#include "label_bitmap.h"
+#include "label_filter.h"
+#include "sector_cache.h"
+#include "shared_segment.h"
+#include "ssd_search_host.h"
 #include "neighbor.h"
 #include "parameters.h"
 #include "percentile_stats.h"
 #include "pq.h"
+#include "quantized_distance.h"
 #include "utils.h"
 #include "windows_customizations.h"
 #include "scratch.h"
+#include "search_metrics.h"
 #include "tsl/robin_map.h"
 #include "tsl/robin_set.h"
 
@@ -20,6 +38,91 @@
 
 namespace diskann
 {
+class MemoryMapper;
+
+// The file of PQFlashIndex::set_access_trace() starts with these uint64_t
+// fields, which give the layout of the nodes in the index. A record per query
+// follows: the number of nodes its beam search expanded, as uint32_t, then
+// their ids in the order they were expanded, as uint32_t.
+enum AccessTraceHeader
+{
+    TRACE_NUM_POINTS,
+    TRACE_NNODES_PER_SECTOR,
+    TRACE_SECTORS_PER_NODE,
+    TRACE_SECTOR_LEN,
+    TRACE_MAX_NODE_LEN,
+    TRACE_NUM_FIELDS
+};
+
+// The parts of a PQFlashIndex that PQFlashIndex::set_placement() can place
+// in a memory tier of their own.
+enum class IndexComponent
+{
+    // the PQ codes of all points, read at random by every search
+    PQ_CODES,
+    // the neighbour and coordinate rows of the cached nodes
+    NODE_CACHE,
+    // the full precision vectors searches with reorder data rerank with,
+    // read from the index per query unless placed
+    REORDER_VECTORS,
+    // the labels of all points, read by filtered searches
+    LABELS
+};
+
+// The state of a search that returns its results a page at a time, from
+// PQFlashIndex::begin_paged_search(). It holds the prepared query and its PQ
+// distance table, the visited set, the candidates not yet expanded, with the
+// PQ distances of all candidates seen, and the expanded points not yet
+// returned, so that each page only expands the graph as far as it needs. A
+// cursor is used by one thread at a time and must not outlive its index.
+template <typename T> struct PQFlashSearchCursor
+{
+    T *aligned_query_T = nullptr;
+    float *query_float = nullptr;
+    float *pq_dists = nullptr;
+    FastScanLUT fast_scan_lut;
+    float query_norm = 0;
+
+    uint64_t l_search = 0;
+    uint64_t beam_width = 0;
+    uint64_t num_returned = 0;
+
+    VisitedSet visited;
+    // a min-heap on PQ distance
+    std::vector<Neighbor> candidates;
+    std::vector<float> seen_dists;
+    // the bound_l smallest of seen_dists
+    uint64_t bound_l = 0;
+    std::priority_queue<float> closest_l;
+    // expanded, with full precision distances
+    std::vector<Neighbor> results;
+    // the points of collapsed duplicates that did not fit on the last page
+    std::deque<std::pair<uint64_t, float>> pending;
+
+    // pq_dists takes table_stride floats per chunk, see FixedChunkPQTable,
+    // and then disk_pq_entries floats for the table of the disk PQ, if any
+    PQFlashSearchCursor(uint64_t aligned_dim, uint64_t n_chunks, uint64_t table_stride, uint64_t disk_pq_entries = 0)
+    {
+        diskann::alloc_aligned((void **)&aligned_query_T, aligned_dim * sizeof(T), 8 * sizeof(T));
+        diskann::alloc_aligned((void **)&query_float, aligned_dim * sizeof(float), 8 * sizeof(float));
+        diskann::alloc_aligned((void **)&pq_dists, (table_stride * n_chunks + disk_pq_entries) * sizeof(float), 256);
+        diskann::alloc_aligned((void **)&fast_scan_lut.lut,
+                               ROUND_UP(NUM_PQ_CENTROIDS_FAST_SCAN * ROUND_UP(n_chunks, 2), 256), 256);
+        memset(aligned_query_T, 0, aligned_dim * sizeof(T));
+        memset(query_float, 0, aligned_dim * sizeof(float));
+    }
+
+    ~PQFlashSearchCursor()
+    {
+        diskann::aligned_free(aligned_query_T);
+        diskann::aligned_free(query_float);
+        diskann::aligned_free(pq_dists);
+        diskann::aligned_free(fast_scan_lut.lut);
+    }
+
+    PQFlashSearchCursor(const PQFlashSearchCursor &) = delete;
+    PQFlashSearchCursor &operator=(const PQFlashSearchCursor &) = delete;
+};
 
 template <typename T, typename LabelT = uint32_t> class PQFlashIndex
 {
@@ -46,6 +149,72 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
 
     DISKANN_DLLEXPORT void load_cache_list(std::vector<uint32_t> &node_list);
 
+    // Writes the static node cache built by load_cache_list() to filename:
+    // the cached nodes with their access counts, then their records as the
+    // cache holds them. The counts are the visits of the sample queries of
+    // generate_cache_list_from_sample_queries(), 0 for nodes cached otherwise.
+    DISKANN_DLLEXPORT void save_cache(const std::string &filename);
+
+    // Restores the node cache of this index from a file of save_cache() with
+    // a few sequential reads, instead of a read from the index per node, so a
+    // restarted index serves from a warm cache from its first query. A cache
+    // saved in the other sector cache mode is read from the index again. Call
+    // after load() and set_sector_cache_mode(), in place of load_cache_list().
+    DISKANN_DLLEXPORT void load_cache(const std::string &filename);
+
+    // Lets an index serve queries before it is fully in memory, at a higher
+    // latency for a while. load() maps _pq_compressed.bin instead of reading
+    // it, so its pages are read in on first touch while a background thread
+    // reads in the rest, and load_cache_list_async() builds the node cache
+    // alongside searches. Codes of 4-bit PQ or of a compressed file are still
+    // read by load(). Must be called before load().
+    DISKANN_DLLEXPORT void set_lazy_load(bool enable);
+
+    // Places a component in a memory tier other than the DRAM of the memory
+    // policy, to fit an index whose hot data outgrows DRAM: far memory such
+    // as a CXL-attached NUMA node, or a file mapping on tmpfs or an NVMe
+    // drive. REORDER_VECTORS, which stay on the index file by default, are
+    // read into memory of the placement at load(). For NODE_CACHE, the first
+    // dram_fraction of the cache list stays in DRAM and the rest goes to the
+    // placement; the lists of generate_cache_list_from_sample_queries() and
+    // cache_bfs_levels() start with the nodes searches visit most, so the
+    // hottest nodes stay in DRAM. Components shared by set_shared_memory()
+    // or mapped by set_lazy_load() are not placed. Must be called before
+    // load().
+    DISKANN_DLLEXPORT void set_placement(IndexComponent component, const MemoryPlacement &placement,
+                                         float dram_fraction = 0);
+
+    // Runs make_node_list, then load_cache_list() with the nodes it picks, on
+    // a background thread and returns at once. Searches skip the node cache
+    // until it is complete. Must be called after load(), at most once, and
+    // before searches start.
+    DISKANN_DLLEXPORT void load_cache_list_async(std::function<void(std::vector<uint32_t> &)> make_node_list);
+
+    // whether the PQ codes are in memory and the node cache requested by
+    // load_cache_list_async(), if any, is built
+    DISKANN_DLLEXPORT bool is_fully_loaded();
+    // Blocks until is_fully_loaded(); rethrows what load_cache_list_async()
+    // threw.
+    DISKANN_DLLEXPORT void wait_until_loaded();
+
+    // Readies an index loaded before fork() for searches in the child
+    // process, where its I/O contexts are the parent's: forgets them (see
+    // AlignedFileReader::reset_after_fork()) and gives the scratch new ones.
+    // Everything loaded stays shared with the parent until either writes to
+    // it, so that processes forked from one that loaded the index hold one
+    // copy of its PQ codes and caches. The parent must have called
+    // wait_until_loaded() and have had no search running at fork(), as its
+    // threads do not exist in the child; throws otherwise. An index on a
+    // search host leaves the host's contexts to
+    // SSDSearchHost::reset_after_fork().
+    DISKANN_DLLEXPORT void reset_after_fork();
+
+    // When enabled, load_cache_list() keeps the cached nodes' sectors verbatim
+    // in a single arena instead of splitting them into the nhood and coord
+    // caches, so a cache hit is expanded exactly like a sector read from SSD.
+    // Must be called before load_cache_list().
+    DISKANN_DLLEXPORT void set_sector_cache_mode(bool enable);
+
 #ifdef EXEC_ENV_OLS
     DISKANN_DLLEXPORT void generate_cache_list_from_sample_queries(MemoryMappedFiles &files, std::string sample_bin,
                                                                    uint64_t l_search, uint64_t beamwidth,
@@ -81,8 +250,92 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
                                               const uint32_t io_limit, const bool use_reorder_data = false,
                                               QueryStats *stats = nullptr);
 
+    // Filtered searches with a boolean filter over labels. Only points that
+    // match it are visited, starting from the medoids of the labels of its
+    // most selective clause, unless set_filter_planner() picks another route.
+    DISKANN_DLLEXPORT void cached_beam_search(const T *query, const uint64_t k_search, const uint64_t l_search,
+                                              uint64_t *res_ids, float *res_dists, const uint64_t beam_width,
+                                              const LabelFilter<LabelT> &filter, const bool use_reorder_data = false,
+                                              QueryStats *stats = nullptr);
+
+    DISKANN_DLLEXPORT void cached_beam_search(const T *query, const uint64_t k_search, const uint64_t l_search,
+                                              uint64_t *res_ids, float *res_dists, const uint64_t beam_width,
+                                              const LabelFilter<LabelT> &filter, const uint32_t io_limit,
+                                              const bool use_reorder_data = false, QueryStats *stats = nullptr);
+
+    // Searches with a float query, for callers of byte indices whose queries
+    // are float. The PQ distance tables are built from the query as it is,
+    // and full precision distances come from float-by-byte kernels (see
+    // get_mixed_distance_function()), instead of from a query rounded to T.
+    // Indices with a quantizer other than PQ get the rounded query for its
+    // tables. For other data types, the query is converted to T.
+    DISKANN_DLLEXPORT void cached_beam_search_float_query(const float *query, const uint64_t k_search,
+                                                          const uint64_t l_search, uint64_t *res_ids,
+                                                          float *res_dists, const uint64_t beam_width,
+                                                          const LabelFilter<LabelT> &filter = LabelFilter<LabelT>(),
+                                                          const bool use_reorder_data = false,
+                                                          QueryStats *stats = nullptr);
+
+    // Searches nq queries (query i starts at queries + i * query_aligned_dim) in
+    // lockstep on the calling thread. Each round collects the beams of all
+    // unfinished queries, reads their sectors with a single submission in which
+    // a sector wanted by several queries is read once, and then expands every
+    // query. Results for query i are written at res_ids/res_dists + i * k_search;
+    // stats, if given, must hold nq entries.
+    DISKANN_DLLEXPORT void batch_cached_beam_search(const T *queries, const uint64_t nq,
+                                                    const uint64_t query_aligned_dim, const uint64_t k_search,
+                                                    const uint64_t l_search, uint64_t *res_ids, float *res_dists,
+                                                    const uint64_t beam_width, QueryStats *stats = nullptr);
+
+    // Late-interaction search of a query made of nq vectors (vector i starts
+    // at queries + i * query_aligned_dim), such as the token embeddings of
+    // ColBERT, over an index of the vectors of documents: doc_ids[p] is the
+    // document of point p, or every point is its own document if doc_ids is
+    // null. The vectors are searched together as by batch_cached_beam_search(),
+    // so a sector several of them want is read once. Every point read is scored
+    // against all the vectors at once, in a single matrix product, and a
+    // document scores the sum over the vectors of their largest similarity to
+    // its points read (MaxSim): the inner product for INNER_PRODUCT and COSINE
+    // indices, the negated squared distance for L2. Writes the k_search best
+    // documents and their scores, best first, and returns their number.
+    DISKANN_DLLEXPORT uint64_t multi_vector_search(const T *queries, const uint64_t nq,
+                                                   const uint64_t query_aligned_dim, const uint32_t *doc_ids,
+                                                   const uint64_t k_search, const uint64_t l_search,
+                                                   uint32_t *res_docs, float *res_scores, const uint64_t beam_width,
+                                                   QueryStats *stats = nullptr);
+
+    // The K nearest other points of every point of the index, searched with
+    // l_search and beam_width on num_threads threads: knn_ids and knn_dists get
+    // K per point, by id, nearest first, with distances as search reports them,
+    // and the number of points is returned. The points are searched in their
+    // order on disk, a batch of neighbouring nodes at a time by
+    // batch_cached_beam_search(), each starting from its own node. Rows with
+    // fewer than K neighbours end in ids of -1. Needs the full precision
+    // vectors in the nodes.
+    DISKANN_DLLEXPORT uint64_t knn_self_join(const uint64_t K, const uint64_t l_search, const uint64_t beam_width,
+                                             const uint32_t num_threads, std::vector<uint32_t> &knn_ids,
+                                             std::vector<float> &knn_dists);
+
+    // Starts a search of query whose results are read a page at a time with
+    // next_page(). Each page searches with a list of l_search candidates
+    // beyond the results already returned, reading beam_width nodes at a time,
+    // and picks up the expansion where the previous page stopped.
+    DISKANN_DLLEXPORT std::unique_ptr<PQFlashSearchCursor<T>> begin_paged_search(const T *query,
+                                                                                 const uint64_t l_search,
+                                                                                 const uint64_t beam_width);
+
+    // Writes up to k_search more results of cursor to res_ids and res_dists,
+    // closest first, and returns their number, which is below k_search only
+    // once the search has reached every point it can. Collapsed duplicates
+    // cut off at the end of a page start the next one.
+    DISKANN_DLLEXPORT uint64_t next_page(PQFlashSearchCursor<T> &cursor, const uint64_t k_search, uint64_t *res_ids,
+                                         float *res_dists, QueryStats *stats = nullptr);
+
     DISKANN_DLLEXPORT LabelT get_converted_label(const std::string &filter_label);
 
+    // Converts a filter of raw labels, in the syntax of parse_label_filter()
+    DISKANN_DLLEXPORT LabelFilter<LabelT> get_converted_filter(const std::string &filter);
+
     DISKANN_DLLEXPORT uint32_t range_search(const T *query1, const double range, const uint64_t min_l_search,
                                             const uint64_t max_l_search, std::vector<uint64_t> &indices,
                                             std::vector<float> &distances, const uint64_t min_beam_width,
@@ -90,6 +343,129 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
 
     DISKANN_DLLEXPORT uint64_t get_data_dim();
 
+    // Linux: submit each beam without waiting, score cached nodes while the
+    // reads are in flight and expand sectors as their completions arrive.
+    // Requires a reader with supports_async_reads().
+    DISKANN_DLLEXPORT void set_pipelined_search(bool enable);
+
+    // Per-query adaptive search for cached_beam_search. With max_beam_width > 0
+    // the beam starts at the requested width and is resized every hop: it
+    // doubles (up to max_beam_width) after a hop that left the PQ top-k
+    // unchanged and shrinks by one after a hop that replaced more than half of
+    // it. With early_stop_hops > 0 the search stops once the top-k has not
+    // changed for that many consecutive hops. Passing 0 for both disables it.
+    // Must be called after load().
+    DISKANN_DLLEXPORT void set_adaptive_search(uint32_t max_beam_width, uint32_t early_stop_hops);
+
+    // Speculative reads for cached_beam_search. Each hop also reads the
+    // sectors of up to width unexpanded candidates past the beam, queued
+    // behind the beam's reads, into a per-query buffer; those the next hop
+    // picks need no read. A query stops speculating once max_wasted of its
+    // speculative reads went unused (0: no limit). width 0 disables it.
+    // Reads are counted against the io_limit of the query.
+    DISKANN_DLLEXPORT void set_speculative_reads(uint32_t width, uint32_t max_wasted);
+
+    // Scores candidates with quantizer, e.g. a RaBitQDistance, instead of the
+    // PQ data. Its pivot data must be loaded; load() then reads the codes from
+    // quantizer->get_quantized_vectors_filename(index_prefix) in place of the
+    // PQ codes. If it gives error bounds, the use_reorder_data rerank skips
+    // the candidates that cannot make the top k. Only L2 indices, and only
+    // cached_beam_search() and its filtered variants; the cursor, range and
+    // batched searches throw. Must be called before load().
+    DISKANN_DLLEXPORT void set_quantizer(std::unique_ptr<QuantizedDistance<T>> quantizer);
+
+    // Enables a cache of up to budget_bytes of node records that is filled and
+    // evicted while serving (CLOCK eviction with TinyLFU admission), next to the
+    // static cache built by load_cache_list(). 0 disables it. Must be called
+    // after load() and not while searches are running.
+    DISKANN_DLLEXPORT void set_dynamic_cache_budget(uint64_t budget_bytes);
+
+    // When several nodes share a sector, also score the nodes that were read
+    // alongside each expanded node at full precision and add them to the
+    // candidate list. Pays off most on layouts built with reorder_layout.
+    DISKANN_DLLEXPORT void set_score_colocated_nodes(bool enable);
+
+    // Checks filter labels with a LabelBitmap instead of scanning the labels
+    // of each point. load() turns it on when the points have at least
+    // defaults::LABEL_BITMAP_MIN_AVG_LABELS labels on average. Must be called
+    // after load() and not while searches are running.
+    DISKANN_DLLEXPORT void set_label_bitmap(bool enable);
+
+    // Plans each filtered search from the number of points expected to match
+    // its filter, counted from the labels of its most selective clause.
+    // Filters matched by at most scan_max_points points are answered exactly
+    // by scanning those points: PQ distances to all of them, and the best
+    // l_search re-ranked with the full vectors of their nodes. Filters matched
+    // by at least post_filter_min_fraction of the points run an unfiltered
+    // search with l_search scaled up by the inverse of that fraction, and keep
+    // the results that match. All others run a filtered beam search.
+    // scan_max_points = 0 and post_filter_min_fraction > 1 turn either route
+    // off. Must be called after load() and not while searches are running.
+    DISKANN_DLLEXPORT void set_filter_planner(uint32_t scan_max_points, float post_filter_min_fraction);
+    DISKANN_DLLEXPORT DynamicSectorCache *get_dynamic_cache();
+
+    // When enabled, the QueryStats of every cached_beam_search() and
+    // batch_cached_beam_search() query are added to get_metrics(), measured
+    // even when the caller passes no stats. Off by default, as the timers
+    // cost a little on every expanded node.
+    DISKANN_DLLEXPORT void set_collect_metrics(bool enable);
+    // the metrics of the searches so far; safe to read and reset while
+    // searches are running
+    DISKANN_DLLEXPORT SearchMetrics &get_metrics();
+
+    // Appends the nodes expanded by every cached_beam_search() and
+    // batch_cached_beam_search() query to filename, whether they were read
+    // from SSD or found in a cache, for apps/utils/simulate_cache to replay
+    // against other cache policies and sizes. Nodes re-ranked by a filter
+    // scan are not recorded. An empty filename stops the trace. Must be
+    // called after load() and not while searches are running.
+    DISKANN_DLLEXPORT void set_access_trace(const std::string &filename);
+
+    // Hides points from the results of all searches from now on, without
+    // changing the index: their nodes are still expanded to navigate the
+    // graph, but never returned, so searches need not over-fetch. ids are the
+    // ids searches return; a node that collapsed duplicates is returned until
+    // all of its ids are deleted. Safe to call while searches are running.
+    // Throws ANNException, deleting none of them, if an id is out of range.
+    DISKANN_DLLEXPORT void mark_deleted(const std::vector<uint32_t> &ids);
+    // returns points hidden by mark_deleted() to the results
+    DISKANN_DLLEXPORT void unmark_deleted(const std::vector<uint32_t> &ids);
+    // mark_deleted() of the ids in filename, a .bin file of uint32 ids with
+    // one dimension, as save_delete_list() writes them
+    DISKANN_DLLEXPORT void load_delete_list(const std::string &filename);
+    DISKANN_DLLEXPORT void save_delete_list(const std::string &filename);
+    DISKANN_DLLEXPORT uint64_t get_num_deleted();
+
+    // Bytes held in memory by the index, by component. Waits for the
+    // searches in progress while it measures their scratch. The scratch of a
+    // search host is not counted; see SSDSearchHost::get_memory_usage().
+    DISKANN_DLLEXPORT MemoryUsage get_memory_usage();
+
+    // Searches with the scratch and IO contexts of host, shared with the
+    // other indices attached to it, instead of setting up num_threads of its
+    // own in load(). Indices whose reader (or reorder data reader) binds its
+    // contexts to its file keep their own. Must be called before load().
+    DISKANN_DLLEXPORT void set_search_host(std::shared_ptr<SSDSearchHost<T>> host);
+
+    // The bytes load_cache_list() takes per cached node in the current cache
+    // mode, at most, for fitting a cache in a memory budget. Call after load().
+    DISKANN_DLLEXPORT uint64_t get_cache_bytes_per_node();
+
+    // Runs the sample queries of generate_cache_list_from_sample_queries() on
+    // executor instead of the default one, on at most nthreads of its threads
+    DISKANN_DLLEXPORT void set_executor(std::shared_ptr<Executor> executor);
+
+    // Keeps the PQ codes, the node cache and the labels in the named shared
+    // memory segments name + "_pq", "_cache" and "_labels" (see
+    // SharedSegment) instead of memory of the process. The first process to
+    // load the index fills them and the others map them, so that processes
+    // serving the same index hold one copy. Each must load the same files
+    // and cache the same number of nodes; the nodes cached are those of the
+    // first. The sector cache and the label index stay per process, and
+    // labels are still parsed by each. Must be called before load(); Linux
+    // only.
+    DISKANN_DLLEXPORT void set_shared_memory(const std::string &name);
+
     std::shared_ptr<AlignedFileReader> &reader;
 
     DISKANN_DLLEXPORT diskann::Metric get_metric();
@@ -104,6 +480,12 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     DISKANN_DLLEXPORT std::vector<bool> read_nodes(const std::vector<uint32_t> &node_ids,
                                                    std::vector<T *> &coord_buffers,
                                                    std::vector<std::pair<uint32_t, uint32_t *>> &nbr_buffers);
+    // read_nodes() of any number of nodes, in blocks of sector-sorted nodes
+    // on up to as many threads as load() was given, half of them while the
+    // cache loads in the background
+    DISKANN_DLLEXPORT std::vector<bool> read_nodes_parallel(
+        const std::vector<uint32_t> &node_ids, std::vector<T *> &coord_buffers,
+        std::vector<std::pair<uint32_t, uint32_t *>> &nbr_buffers);
 
     DISKANN_DLLEXPORT std::vector<std::uint8_t> get_pq_vector(std::uint64_t vid);
     DISKANN_DLLEXPORT uint64_t get_num_points();
@@ -111,11 +493,76 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
   protected:
     DISKANN_DLLEXPORT void use_medoids_data_as_centroids();
     DISKANN_DLLEXPORT void setup_thread_data(uint64_t nthreads, uint64_t visited_reserve = 4096);
+    // the scratch of the search host, if load() attached to one, else the
+    // index's own
+    ScratchPool<SSDThreadData<T>> &thread_data()
+    {
+        return _use_search_host ? _search_host->thread_data() : _thread_data;
+    }
 
     DISKANN_DLLEXPORT void set_universal_label(const LabelT &label);
 
   private:
     DISKANN_DLLEXPORT inline bool point_has_label(uint32_t point_id, LabelT label_id);
+    // True if point_id matches filter. With all_parts, the labels of a point
+    // that was split into dummy points are those of all its parts.
+    inline bool point_matches_filter(uint32_t point_id, const LabelFilter<LabelT> &filter, bool all_parts);
+    // Moves the ids among ids[0, n) that match filter to the front, keeping
+    // their order, and returns how many there are. A single label filter is
+    // answered by the label bitmap for all the ids at once when it can be.
+    size_t select_matching(uint32_t *ids, size_t n, const LabelFilter<LabelT> &filter, bool all_parts);
+
+    // runs a search of the public cached_beam_search() overloads as planned
+    // by set_filter_planner(). With float_query, that query is searched for
+    // and query is ignored, here and in the searches below.
+    void route_search(const T *query, const uint64_t k_search, const uint64_t l_search, uint64_t *res_ids,
+                      float *res_dists, const uint64_t beam_width, const LabelFilter<LabelT> &filter,
+                      const uint32_t io_limit, const bool use_reorder_data, QueryStats *stats,
+                      const float *float_query = nullptr);
+
+    // appends the records of num_queries queries, the nodes expanded by each,
+    // to the access trace
+    void append_access_trace(const std::vector<uint32_t> *expanded, const uint64_t num_queries);
+
+    // Beam search for the public cached_beam_search() overloads. With
+    // post_filter, the graph is searched without filter and only the
+    // results are filtered.
+    void filtered_beam_search(const T *query, const uint64_t k_search, const uint64_t l_search, uint64_t *res_ids,
+                              float *res_dists, const uint64_t beam_width, const LabelFilter<LabelT> &filter,
+                              const bool post_filter, const uint32_t io_limit, const bool use_reorder_data,
+                              QueryStats *stats, const float *float_query = nullptr);
+
+    // Exact filtered search over the points of the posting lists of
+    // scan_labels that match filter
+    void scan_filtered_points(const T *query, const uint64_t k_search, const uint64_t l_search, uint64_t *res_ids,
+                              float *res_dists, const LabelFilter<LabelT> &filter,
+                              const std::vector<LabelT> &scan_labels, QueryStats *stats,
+                              const float *float_query = nullptr);
+
+    // prepares query in cursor and adds the start points as its candidates
+    void start_cursor(PQFlashSearchCursor<T> &cursor, const T *query);
+
+    // expands the candidates of cursor within the l_search smallest PQ
+    // distances it has seen, reading beam_width nodes at a time
+    void expand_cursor(PQFlashSearchCursor<T> &cursor, const uint64_t l_search, const uint64_t beam_width,
+                       QueryStats *stats);
+
+    // writes the first k_search of the sorted full_retset to res_ids and
+    // res_dists, as original ids and distances, and returns their number; a
+    // node that collapsed duplicates stands for all of their ids
+    uint64_t copy_results(const std::vector<Neighbor> &full_retset, const uint64_t k_search, uint64_t *res_ids,
+                          float *res_dists, const float query_norm);
+    // the number of ids copy_results() writes for the first num_results of
+    // results, when it is not limited by k_search
+    uint64_t num_result_ids(const std::vector<Neighbor> &results, const uint64_t num_results) const;
+    // the id of node_id before the build renumbered it, for filter replicas
+    // and the disk layout
+    uint32_t unmapped_node_id(uint32_t node_id) const;
+    // the number of ids searches return, the bound of mark_deleted()
+    uint64_t num_point_ids() const;
+    // whether mark_deleted() hid the point id, or all the points of node_id
+    bool id_deleted(const uint32_t id) const;
+    bool node_deleted(const uint32_t node_id) const;
     std::unordered_map<std::string, LabelT> load_label_map(std::basic_istream<char> &infile);
     DISKANN_DLLEXPORT void parse_label_file(std::basic_istream<char> &infile, size_t &num_pts_labels);
     DISKANN_DLLEXPORT void get_label_file_metadata(const std::string &fileContent, uint32_t &num_pts,
@@ -124,6 +571,141 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
                                                   const uint32_t nthreads);
     void reset_stream_for_reading(std::basic_istream<char> &infile);
 
+    // copies query into aligned_query_T, normalizing it for cosine and MIPS, and
+    // seeds pq_query_scratch with its float copy. Returns the norm of the raw
+    // query for the metrics that normalize it, 0 otherwise.
+    float prepare_query(const T *query, T *aligned_query_T, PQScratch<T> *pq_query_scratch);
+    // prepare_query() for a float query: the prepared query is also kept in
+    // float in query_scratch, and aligned_query_T gets it rounded to T.
+    // Returns the prepared float query if _mixed_dist_cmp can compare it to
+    // the vectors, nullptr otherwise.
+    const float *prepare_float_query(const float *query, SSDQueryScratch<T> *query_scratch, float &query_norm);
+
+#ifndef EXEC_ENV_OLS
+    // loads the sampled navigation graph written by build_disk_entry_layer()
+    void load_entry_layer(const std::string &entry_layer_file, uint32_t num_threads);
+#endif
+    // writes the nodes an unfiltered search of query_float starts from into
+    // start_points (room for defaults::ENTRY_LAYER_NUM_SEEDS) and returns
+    // their count: the closest entry layer points if one was loaded, else the
+    // medoids of the closest centroids
+    uint32_t get_start_points(const float *query_float, uint32_t *start_points);
+
+    // full precision distance between two _aligned_dim vectors
+    inline float compare_full_precision(const T *a, const T *b) const
+    {
+        if (_fixed_dim_cmp != nullptr)
+            return _fixed_dim_cmp(a, b);
+        return _dist_cmp->compare(a, b, (uint32_t)_aligned_dim);
+    }
+    // compare_full_precision() from the query to b, or the mixed distance
+    // from exact_query when prepare_float_query() returned one
+    inline float compare_query(const float *exact_query, const T *aligned_query_T, const T *b) const
+    {
+        if (exact_query != nullptr)
+            return _mixed_dist_cmp(exact_query, b, (uint32_t)_data_dim);
+        return compare_full_precision(aligned_query_T, b);
+    }
+
+    void load_sector_cache(std::vector<uint32_t> &node_list);
+
+    // Entries of id in the static node caches, or nullptr if id has none or
+    // load_cache_list_async() is still building them.
+    inline std::pair<uint32_t, uint32_t *> *find_cached_nhood(uint32_t id)
+    {
+        if (!_static_cache_ready.load(std::memory_order_acquire))
+            return nullptr;
+        auto iter = _nhood_cache.find(id);
+        return iter == _nhood_cache.end() ? nullptr : &iter.value();
+    }
+    inline T *find_cached_coords(uint32_t id)
+    {
+        if (!_static_cache_ready.load(std::memory_order_acquire))
+            return nullptr;
+        auto iter = _coord_cache.find(id);
+        return iter == _coord_cache.end() ? nullptr : iter->second;
+    }
+    inline char *find_cached_sector(uint32_t id)
+    {
+        if (!_use_sector_cache || !_static_cache_ready.load(std::memory_order_acquire))
+            return nullptr;
+        return _sector_cache.find(id);
+    }
+
+    // touches every page of the mapped PQ codes, so they are read in before
+    // searches need them
+    void populate_pq_codes();
+
+    // reads the nodes of node_list into the rows of the caches, and their
+    // neighbour counts into nbr_counts, NODE_NOT_CACHED for nodes that failed
+    void read_cache_nodes(const std::vector<uint32_t> &node_list, uint32_t *nhood_buf, T *coord_buf,
+                          uint32_t *nbr_counts);
+    // adds the nodes in the rows of the node cache to the cache maps
+    void index_cache_nodes(const uint32_t *ids, const uint32_t *nbr_counts, size_t num_nodes);
+    // allocates rows for num_nodes nodes in the node cache: the first
+    // _num_dram_cache_nodes in DRAM and the rest in the node cache placement
+    void alloc_node_cache(size_t num_nodes);
+    uint32_t *nhood_cache_row(size_t i)
+    {
+        return i < _num_dram_cache_nodes ? _nhood_cache_buf + i * (_max_degree + 1)
+                                         : _far_nhood_cache_buf + (i - _num_dram_cache_nodes) * (_max_degree + 1);
+    }
+    T *coord_cache_row(size_t i)
+    {
+        return i < _num_dram_cache_nodes ? _coord_cache_buf + i * _aligned_dim
+                                         : _far_coord_cache_buf + (i - _num_dram_cache_nodes) * _aligned_dim;
+    }
+    // reads the sectors of the reorder data into _reorder_buffer
+    void load_reorder_vectors();
+    // frees _pts_to_labels, however it was allocated
+    void free_labels();
+    // maps the node cache segment of num_nodes nodes, filled with fill(ids,
+    // visit counts, neighbour counts, neighbour rows, coordinate rows) if this
+    // process is the first, and caches its nodes
+    void attach_shared_node_cache(
+        size_t num_nodes, const std::function<void(uint32_t *, uint32_t *, uint32_t *, uint32_t *, T *)> &fill);
+    // moves the parsed label arrays into their segment
+    void share_labels();
+
+    // fills the PQ distance tables of a rotated query: negated inner products
+    // to the centers for native MIPS indices, squared distances otherwise
+    void populate_pq_dists(const float *query_rotated, float *pq_dists);
+
+    // With the disk PQ, the vectors in the nodes are codes, scored by lookups
+    // in a table of the query to the disk PQ centers. That table follows the
+    // in-memory PQ table in the pq_dists buffers, disk_pq_table_entries()
+    // floats more; populate_disk_pq_dists fills it from the unrotated query.
+    uint64_t disk_pq_table_entries() const;
+    void populate_disk_pq_dists(const float *query_float, float *pq_dists);
+    float disk_pq_distance(const float *pq_dists, const T *codes);
+
+    // PQ distances from a query to ids, from its float tables (pq_dists) or,
+    // with 4-bit codes, from its quantized fast-scan tables
+    void compute_pq_dists(const uint32_t *ids, const uint64_t n_ids, const float *pq_dists,
+                          const FastScanLUT &fast_scan_lut, uint8_t *pq_coord_scratch, float *dists_out);
+
+    // distances from the query preprocessed into pq_scratch by _quantizer;
+    // with errors_out, also their error bounds, if _quantizer gives them
+    bool compute_quantized_dists(const uint32_t *ids, const uint64_t n_ids, PQScratch<T> *pq_scratch,
+                                 float *dists_out, float *errors_out = nullptr);
+
+    // drops the candidates whose _quantizer distance is, by its error bounds,
+    // larger than that of k_search others, if _quantizer gives bounds
+    void drop_outranked_candidates(std::vector<Neighbor> &candidates, const uint64_t k_search,
+                                   PQScratch<T> *pq_scratch);
+
+    // batch_cached_beam_search(), which also hands on_expand, if set, the id
+    // and the coords of every node it expands; res_ids may be null. With
+    // start_nodes, query q starts from node start_nodes[q] alone.
+    void batch_beam_search(const T *queries, const uint64_t nq, const uint64_t query_aligned_dim,
+                           const uint64_t k_search, const uint64_t l_search, uint64_t *res_ids, float *res_dists,
+                           const uint64_t beam_width, QueryStats *stats,
+                           const std::function<void(uint32_t, const T *)> &on_expand,
+                           const uint32_t *start_nodes = nullptr);
+
+    // for the searches that do not support set_quantizer()
+    void check_no_quantizer(const char *search) const;
+
     // sector # on disk where node_id is present with in the graph part
     DISKANN_DLLEXPORT uint64_t get_node_sector(uint64_t node_id);
 
@@ -133,6 +715,14 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     // returns region of `node_buf` containing [NNBRS][NBR_ID(uint32_t)]
     DISKANN_DLLEXPORT uint32_t *offset_to_node_nhood(char *node_buf);
 
+    // returns the neighbor ids that follow [NNBRS] in `node_nhood`, unpacked
+    // into `ids_scratch` (of max_degree ids) if they are bit-packed
+    DISKANN_DLLEXPORT uint32_t *node_nbr_ids(uint32_t *node_nhood, uint32_t *ids_scratch);
+
+    // returns the PQ codes of the neighbors that follow their ids in
+    // `node_nhood`, in a node with neighbor codes
+    DISKANN_DLLEXPORT uint8_t *node_nbr_codes(uint32_t *node_nhood);
+
     // returns region of `node_buf` containing [COORD(T)]
     DISKANN_DLLEXPORT T *offset_to_node_coords(char *node_buf);
 
@@ -141,7 +731,7 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     // offset in sector: [(i % nnodes_per_sector) * max_node_len]
     //
     // index info for multi-sector nodes
-    // nhood of node `i` is in sector: [i * DIV_ROUND_UP(_max_node_len, SECTOR_LEN)]
+    // nhood of node `i` is in sector: [i * DIV_ROUND_UP(_max_node_len, _sector_len)]
     // offset in sector: [0]
     //
     // Common info
@@ -152,17 +742,42 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     uint64_t _max_node_len = 0;
     uint64_t _nnodes_per_sector = 0; // 0 for multi-sector nodes, >0 for multi-node sectors
     uint64_t _max_degree = 0;
+    // PQ chunks of the neighbor codes stored after the neighbor ids of each
+    // node, with which cached_beam_search() scores the neighbors; 0 if none
+    uint64_t _inline_pq_chunks = 0;
+    // length of the sectors the nodes and reorder data are laid out in, and
+    // of every read of them; the metadata still takes the first
+    // defaults::SECTOR_LEN bytes, so node sectors are numbered from
+    // defaults::SECTOR_LEN / _sector_len
+    uint64_t _sector_len = defaults::SECTOR_LEN;
+    // bits of each neighbor id if they are bit-packed, see pack_ids(), and 0
+    // if they are uint32s; and the bytes of the ids of a node
+    uint64_t _nbr_id_bits = 0;
+    uint64_t _nbr_ids_len = 0;
 
     // Data used for searching with re-order vectors
     uint64_t _ndims_reorder_vecs = 0;
     uint64_t _reorder_data_start_sector = 0;
     uint64_t _nvecs_per_sector = 0;
+    // reads the reorder data when it is kept apart from the graph, in the file
+    // named by get_disk_index_vectors_file(); sectors are then numbered from
+    // the start of that file
+    std::shared_ptr<AlignedFileReader> _vectors_reader;
+    // set_placement(): the sectors of the reorder data from
+    // _reorder_first_sector on, held in memory of _reorder_placement
+    bool _reorder_resident = false;
+    MemoryPlacement _reorder_placement;
+    LargeBuffer _reorder_buffer;
+    uint64_t _reorder_first_sector = 0;
 
     diskann::Metric metric = diskann::Metric::L2;
 
     // used only for inner product search to re-scale the result value
     // (due to the pre-processing of base during index build)
     float _max_base_norm = 0.0f;
+    // inner product index built on the vectors as they are, without the extra
+    // dimension; told apart by the absence of the _max_base_norm.bin file
+    bool _native_mips = false;
 
     // data info
     uint64_t _num_points = 0;
@@ -182,11 +797,34 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     // pq_tables = float* [[2^8 * [chunk_size]] * _n_chunks]
     uint8_t *data = nullptr;
     uint64_t _n_chunks;
+    // bytes per point in data: _n_chunks, half that for 4-bit fast-scan PQ,
+    // or twice that for wide PQ
+    uint64_t _pq_code_len = 0;
+    bool _use_fast_scan_pq = false;
+    // more than 256 centroids per chunk: data holds uint16 codes
+    bool _use_wide_pq = false;
+    // set_quantizer(): data holds its codes, _n_chunks bytes each
+    std::unique_ptr<QuantizedDistance<T>> _quantizer;
+    // owns data, except for unpacked codes served from MemoryMappedFiles or
+    // from _pq_mapping
+    LargeBuffer _pq_data_buffer;
+    MemoryPlacement _pq_codes_placement;
+
+    // set_lazy_load(): the mapped codes file, and the thread reading it in
+    bool _lazy_load = false;
+    std::unique_ptr<MemoryMapper> _pq_mapping;
+    std::thread _pq_populate_thread;
+    std::atomic<bool> _pq_codes_resident{true};
+    std::atomic<bool> _stop_populating{false};
     FixedChunkPQTable _pq_table;
 
     // distance comparator
     std::shared_ptr<Distance<T>> _dist_cmp;
     std::shared_ptr<Distance<float>> _dist_cmp_float;
+    // unrolled _dist_cmp kernel for _aligned_dim, if one exists
+    FixedDimDistanceFn<T> _fixed_dim_cmp = nullptr;
+    // _dist_cmp between a float query and the vectors, if one exists
+    MixedDistanceFn<T> _mixed_dist_cmp = nullptr;
 
     // for very large datasets: we use PQ even for the disk resident index
     bool _use_disk_index_pq = false;
@@ -201,30 +839,113 @@ template <typename T, typename LabelT = uint32_t> class PQFlashIndex
     // defaults to 1
     size_t _num_medoids;
     // by default, it is empty. If there are multiple
-    // centroids, we pick the medoid corresponding to the
-    // closest centroid as the starting point of search
+    // centroids, we pick the medoids corresponding to the
+    // closest few centroids as the starting points of search
     float *_centroid_data = nullptr;
 
+    // optional entry layer, a Vamana graph over a sample of the points that
+    // replaces the centroid scan; its point i is node _entry_layer_ids[i]
+    std::unique_ptr<Index<float, uint32_t, uint32_t>> _entry_layer;
+    std::unique_ptr<uint32_t[]> _entry_layer_ids;
+    size_t _num_entry_layer_points = 0;
+
     // nhood_cache; the uint32_t in nhood_Cache are offsets into nhood_cache_buf
     unsigned *_nhood_cache_buf = nullptr;
+    LargeBuffer _nhood_cache_buffer;
     tsl::robin_map<uint32_t, std::pair<uint32_t, uint32_t *>> _nhood_cache;
 
     // coord_cache; The T* in coord_cache are offsets into coord_cache_buf
     T *_coord_cache_buf = nullptr;
+    LargeBuffer _coord_cache_buffer;
     tsl::robin_map<uint32_t, T *> _coord_cache;
 
+    // set_placement(): rows from _num_dram_cache_nodes on are in these
+    // buffers of the node cache placement
+    MemoryPlacement _node_cache_placement;
+    float _node_cache_dram_fraction = 0;
+    size_t _num_dram_cache_nodes = 0;
+    uint32_t *_far_nhood_cache_buf = nullptr;
+    LargeBuffer _far_nhood_cache_buffer;
+    T *_far_coord_cache_buf = nullptr;
+    LargeBuffer _far_coord_cache_buffer;
+
+    // sector-granular alternative to the two caches above
+    bool _use_sector_cache = false;
+    SectorCache _sector_cache;
+
+    // the nodes of the static caches above with their access counts, in the
+    // order they were cached, for save_cache()
+    std::vector<std::pair<uint32_t, uint32_t>> _cache_list;
+
+    // false while load_cache_list_async() fills the caches above; they are
+    // not read until it is set and not written after
+    std::atomic<bool> _static_cache_ready{true};
+    std::future<void> _cache_loading;
+
+    // optional cache of node records filled online from SSD reads; consulted
+    // for nodes missing from the static caches above
+    std::unique_ptr<DynamicSectorCache> _dynamic_cache;
+
     // thread-specific scratch
-    ConcurrentQueue<SSDThreadData<T> *> _thread_data;
+    ScratchPool<SSDThreadData<T>> _thread_data;
+    std::shared_ptr<SSDSearchHost<T>> _search_host;
+    bool _use_search_host = false;
+    std::shared_ptr<Executor> _executor;
+    // set_shared_memory(): the segments of the codes, the node cache and the
+    // labels, which then hold data, the cache buffers and the label arrays
+    std::string _shared_memory_name;
+    std::unique_ptr<SharedSegment> _pq_segment;
+    std::unique_ptr<SharedSegment> _cache_segment;
+    std::unique_ptr<SharedSegment> _labels_segment;
     uint64_t _max_nthreads;
     bool _load_flag = false;
     bool _count_visited_nodes = false;
+    bool _use_pipelined_search = false;
+    bool _collect_metrics = false;
+    SearchMetrics _metrics;
+    // the file of set_access_trace(), if any; queries append their records
+    // under the lock
+    std::unique_ptr<std::ofstream> _access_trace;
+    std::mutex _access_trace_lock;
+    // the ids hidden by mark_deleted(), one bit each, allocated on the first
+    // delete under the lock and then read by searches without it
+    std::mutex _deleted_lock;
+    std::unique_ptr<std::atomic<uint64_t>[]> _deleted_words;
+    std::atomic<const std::atomic<uint64_t> *> _deleted_bits{nullptr};
+    std::atomic<uint64_t> _num_deleted{0};
+    uint32_t _adaptive_max_beam_width = 0;
+    uint32_t _early_stop_hops = 0;
+    uint32_t _speculative_width = 0;
+    uint32_t _max_wasted_speculative_reads = 0;
+    bool _score_colocated_nodes = false;
     bool _reorder_data_exists = false;
+    // original id of every node when the disk layout was renumbered at build
+    // time; empty otherwise
+    std::vector<uint32_t> _layout_ids;
+    // when build_disk_index collapsed duplicates, the original ids of the
+    // points of node i (before the layout) are _duplicate_ids[
+    // _duplicate_offsets[i] .. _duplicate_offsets[i + 1]), the representative
+    // first; empty otherwise
+    std::vector<uint32_t> _duplicate_offsets;
+    std::vector<uint32_t> _duplicate_ids;
     uint64_t _reoreder_data_offset = 0;
 
     // filter support
     uint32_t *_pts_to_label_offsets = nullptr;
     uint32_t *_pts_to_label_counts = nullptr;
     LabelT *_pts_to_labels = nullptr;
+    // set_placement(): owns _pts_to_labels when the labels are placed
+    MemoryPlacement _labels_placement;
+    LargeBuffer _labels_buffer;
+    // index of the labels above, empty unless enabled by set_label_bitmap()
+    LabelBitmap _label_bitmap;
+    // number of points with each label, to rank the clauses of filters
+    tsl::robin_map<LabelT, uint32_t> _label_counts;
+    // filtered search planner, see set_filter_planner(), and the points of
+    // every label with at most _filter_scan_max_points of them
+    uint32_t _filter_scan_max_points = defaults::FILTER_SCAN_MAX_POINTS;
+    float _filter_post_min_fraction = defaults::FILTER_POST_FILTER_MIN_FRACTION;
+    tsl::robin_map<LabelT, std::vector<uint32_t>> _label_postings;
     std::unordered_map<LabelT, std::vector<uint32_t>> _filter_to_medoid_ids;
     bool _use_universal_label = false;
     LabelT _universal_filter_label;
@@ -9,15 +9,29 @@ namespace diskann
 template <typename T> class PQScratch
 {
   public:
-    float *aligned_pqtable_dist_scratch = nullptr; // MUST BE AT LEAST [256 * NCHUNKS]
+    float *aligned_pqtable_dist_scratch = nullptr; // MUST BE AT LEAST [table stride * NCHUNKS]
     float *aligned_dist_scratch = nullptr;         // MUST BE AT LEAST diskann MAX_DEGREE
     uint8_t *aligned_pq_coord_scratch = nullptr;   // AT LEAST  [N_CHUNKS * MAX_DEGREE]
     float *rotated_query = nullptr;
     float *aligned_query_float = nullptr;
+    FastScanLUT fast_scan_lut; // lut is [16 * MAX_PQ_CHUNKS], used with 4-bit PQ
 
     PQScratch(size_t graph_degree, size_t aligned_dim);
     void initialize(size_t dim, const T *query, const float norm = 1.0f);
+    // grows aligned_pqtable_dist_scratch to n_entries floats, for the tables
+    // of wide PQ, which need more than [256 * MAX_PQ_CHUNKS]
+    void reserve_pq_table(size_t n_entries);
     virtual ~PQScratch();
+
+    // bytes allocated for the buffers above
+    size_t memory_size() const
+    {
+        return _memory_size;
+    }
+
+  private:
+    size_t _memory_size = 0;
+    size_t _pq_table_entries = 0;
 };
 
 } // namespace diskann
\ No newline at end of file
@@ -19,8 +19,12 @@ const std::string make_program_description(const char *executable_name, const ch
 
 // Required parameters
 const char *DATA_TYPE_DESCRIPTION = "data type, one of {int8, uint8, float} - float is single precision (32 bit)";
+const char *DISK_DATA_TYPE_DESCRIPTION =
+    "data type, one of {int8, uint8, float, fp16, bf16} - float is single precision (32 bit), fp16 is IEEE half "
+    "precision and bf16 is bfloat16";
 const char *DISTANCE_FUNCTION_DESCRIPTION =
-    "distance function {l2, mips, fast_l2, cosine}.  'fast l2' and 'mips' only support data_type float";
+    "distance function {l2, mips, fast_l2, cosine, hamming}.  'fast l2' and 'mips' only support data_type float, "
+    "'hamming' only uint8 vectors of packed bits";
 const char *INDEX_PATH_PREFIX_DESCRIPTION = "Path prefix to the index, e.g. '/mnt/data/my_ann_index'";
 const char *RESULT_PATH_DESCRIPTION =
     "Path prefix for saving results of the queries, e.g. '/mnt/data/query_file_X.bin'";
@@ -77,5 +81,12 @@ const char *UNIVERSAL_LABEL =
     "in the labels file instead of listing all labels for a node.  DiskANN will not automatically assign a "
     "universal label to a node.";
 const char *FILTERED_LBUILD = "Build complexity for filtered points, higher value results in better graphs";
+const char *STATS_FILE = "Appends a CSV row of QPS, latency percentiles in microseconds and recall for each search "
+                         "list size to this file, with a header if the file is new, for scripts/perf/sweep.py";
+const char *HUGE_PAGES = "Page size for the vector, graph, PQ code and cache buffers {none, auto, 2mb, 1gb}. auto uses "
+                         "the system's default huge pages if a pool is reserved and transparent huge pages otherwise; "
+                         "2mb and 1gb fall back to transparent huge pages.  Default value: auto";
+const char *NUMA_PLACEMENT = "NUMA placement of those buffers {first_touch, interleave}. interleave spreads their "
+                             "pages over all online nodes.  Default value: first_touch";
 
 } // namespace program_options_utils
@@ -48,6 +48,15 @@ template <typename data_t> class QuantizedDistance
     virtual void preprocessed_distance(PQScratch<data_t> &pq_scratch, const uint32_t n_ids,
                                        std::vector<float> &dists_out) = 0;
 
+    // As preprocessed_distance, and also bounds on the error of each distance
+    // that hold with high probability, for quantizers that can give them.
+    // Returns false, and computes nothing, for those that cannot.
+    virtual bool preprocessed_distance_bounds(PQScratch<data_t> &pq_scratch, const uint32_t n_ids, float *dists_out,
+                                              float *errors_out)
+    {
+        return false;
+    }
+
     // Currently this function is required for DiskPQ. However, it too can be subsumed
     // under preprocessed_distance if we add the appropriate scratch variables to
     // PQScratch and initialize them in pq_flash_index.cpp::disk_iterate_to_fixed_point()
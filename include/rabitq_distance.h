@@ -0,0 +1,76 @@
+#pragma once
+#include "quantized_distance.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// RaBitQ: each vector is coded as the signs of its residual to the centroid of
+// the data after a random rotation, one bit per dimension, followed by two
+// floats: the norm of the residual and the inner product of the normalized
+// residual with the vector its bits stand for. The distance estimate is
+// unbiased and comes with an error bound that holds with high probability.
+//
+// A code takes get_num_chunks() bytes: padded_dim / 8 bytes of bits, with
+// padded_dim = ROUND_UP(dim, 64), then the two floats. The query is rotated
+// and quantized to 4 bits per dimension once, so that scoring a code is a few
+// ANDs and popcounts per 64 dimensions. Only L2 distances are supported.
+template <typename data_t> class RaBitQDistance : public QuantizedDistance<data_t>
+{
+  public:
+    RaBitQDistance() = default;
+
+    virtual ~RaBitQDistance() override = default;
+
+    virtual bool is_opq() const override;
+
+    // <prefix>_rabitq_compressed.bin and <prefix>_rabitq_pivots.bin; the
+    // pivots hold the centroid, and the rotation is in a file of its own
+    virtual std::string get_quantized_vectors_filename(const std::string &prefix) const override;
+    virtual std::string get_pivot_data_filename(const std::string &prefix) const override;
+    virtual std::string get_rotation_matrix_suffix(const std::string &pivots_filename) const override;
+
+    // num_chunks is ignored; the code length follows from the dimension
+#ifdef EXEC_ENV_OLS
+    virtual void load_pivot_data(MemoryMappedFiles &files, const std::string &pivots_file,
+                                 size_t num_chunks) override;
+#else
+    virtual void load_pivot_data(const std::string &pivots_file, size_t num_chunks) override;
+#endif
+
+    // bytes per code
+    virtual uint32_t get_num_chunks() const override;
+
+    // keeps the quantized, rotated query in aligned_pqtable_dist_scratch
+    virtual void preprocess_query(const data_t *aligned_query, uint32_t query_dim,
+                                  PQScratch<data_t> &pq_scratch) override;
+
+    // the codes of the ids are expected in aligned_pq_coord_scratch
+    virtual void preprocessed_distance(PQScratch<data_t> &pq_scratch, const uint32_t id_count,
+                                       float *dists_out) override;
+
+    virtual void preprocessed_distance(PQScratch<data_t> &pq_scratch, const uint32_t n_ids,
+                                       std::vector<float> &dists_out) override;
+
+    virtual bool preprocessed_distance_bounds(PQScratch<data_t> &pq_scratch, const uint32_t n_ids, float *dists_out,
+                                              float *errors_out) override;
+
+    // with the query in full precision
+    virtual float brute_force_distance(const float *query_vec, uint8_t *base_vec) override;
+
+  private:
+    // rotated = _rotation * padded vector
+    void rotate(const float *vec, float *rotated) const;
+
+    uint64_t _dim = 0;
+    uint64_t _padded_dim = 0;
+    std::vector<float> _centroid; // [_dim]
+    std::vector<float> _rotation; // [_padded_dim * _padded_dim], row-major
+};
+
+// Computes the centroid of data_file and a random rotation, saves them to
+// pivots_path (and its rotation matrix suffix), and writes the RaBitQ code of
+// every point to compressed_path as a bin file of uint8 rows.
+template <typename T>
+DISKANN_DLLEXPORT void generate_rabitq_data(const std::string &data_file, const std::string &pivots_path,
+                                            const std::string &compressed_path);
+} // namespace diskann
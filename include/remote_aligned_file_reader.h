@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#if !defined(_WINDOWS) && defined(USE_REMOTE_STORAGE)
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aligned_file_reader.h"
+
+// AlignedFileReader over a disk index kept in an object store: S3 or Azure
+// Blob through a presigned or SAS URL, or any HTTP server that honours Range
+// requests. The index is fetched in blocks of defaults::REMOTE_BLOCK_SECTORS
+// sectors into a read-through cache in RAM or in a file on a local drive. The
+// blocks a read() misses are coalesced into one ranged GET per run of
+// consecutive blocks, each extended by readahead blocks, and the GETs are
+// sent in parallel on the connections kept open by the context.
+//
+// open(<index>) reads the object from <index>.remote: its URL on the first
+// line, then optional "key value" lines:
+//   cache_mb <n>          size of the cache (default defaults::REMOTE_CACHE_MB)
+//   cache_file <path>     keep the cache in this file instead of in RAM
+//   block_sectors <n>     (default defaults::REMOTE_BLOCK_SECTORS)
+//   readahead_blocks <n>  (default defaults::REMOTE_READAHEAD_BLOCKS)
+// <index> itself is only read for its first sector by PQFlashIndex::load().
+class RemoteAlignedFileReader : public AlignedFileReader
+{
+  public:
+    RemoteAlignedFileReader();
+    ~RemoteAlignedFileReader();
+
+    // whether index_file has a <index_file>.remote location
+    static bool is_remote(const std::string &index_file);
+
+    IOContext &get_ctx();
+    IOContext create_ctx();
+
+    // register thread-id for a context
+    void register_thread();
+
+    // de-register thread-id for a context
+    void deregister_thread();
+    void deregister_all_threads();
+
+    // Open & close ops
+    // Blocking calls
+    void open(const std::string &fname);
+    void close();
+
+    // serves read_reqs from the cache, fetching the blocks it misses
+    // NOTE :: blocking call
+    void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false);
+
+  private:
+    struct Session;
+    class BlockCache;
+
+    // blocks [first, first + count) of the object, fetched by one ranged GET
+    struct Run
+    {
+        uint64_t first;
+        uint64_t count;
+        std::vector<char> data;
+    };
+
+    static Session *to_session(IOContext &ctx);
+    static Session *new_session();
+    void destroy_session(IOContext ctx);
+    // fetches all runs in parallel on session, retrying failed GETs
+    void fetch(Session *session, std::vector<Run> &runs);
+
+    std::string _url;
+    uint64_t _size = 0; // of the object
+    uint64_t _block_bytes = 0;
+    uint64_t _readahead_blocks = 0;
+    std::unique_ptr<BlockCache> _cache;
+    io_context_t bad_ctx = (io_context_t)-1;
+};
+
+#endif
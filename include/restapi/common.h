@@ -12,7 +12,42 @@ namespace diskann
 static const std::string VECTOR_KEY = "query", K_KEY = "k", INDICES_KEY = "indices", DISTANCES_KEY = "distances",
                          TAGS_KEY = "tags", QUERY_ID_KEY = "query_id", ERROR_MESSAGE_KEY = "error", L_KEY = "Ls",
                          TIME_TAKEN_KEY = "time_taken_in_us", PARTITION_KEY = "partition",
+                         PARTIAL_KEY = "partial", BUDGET_KEY = "budget_ms", SEQUENCE_KEY = "sequence",
                          UNKNOWN_ERROR = "unknown_error";
 const unsigned int DEFAULT_L = 100;
 
+// Binary protocol, for requests with Content-Type application/octet-stream.
+// All fields are little-endian. A request is a BinaryRequestHeader followed
+// by num_queries vectors of dimensions coordinates of the server's data type.
+// The response starts with a BinaryResponseHeader. Then, for each query, come
+// a uint32 count of results, count uint32 ids, count float distances, with
+// BINARY_HAS_PARTITIONS count uint32 partitions, and with BINARY_HAS_TAGS
+// count tags, each a uint32 length followed by that many bytes.
+struct BinaryRequestHeader
+{
+    uint32_t num_queries;
+    uint32_t dimensions;
+    uint32_t k;
+    uint32_t Ls;
+};
+
+struct BinaryResponseHeader
+{
+    uint32_t num_queries;
+    uint32_t k;
+    uint32_t flags;
+};
+
+const uint32_t BINARY_HAS_TAGS = 1, BINARY_HAS_PARTITIONS = 2, BINARY_PARTIAL = 4;
+
+// Updates, POSTed to /insert and /delete as application/octet-stream. An
+// insert is a BinaryInsertHeader followed by num_points uint32 tags and then
+// num_points vectors of dimensions coordinates of the server's data type. A
+// delete is a uint32 count followed by that many uint32 tags.
+struct BinaryInsertHeader
+{
+    uint32_t num_points;
+    uint32_t dimensions;
+};
+
 } // namespace diskann
\ No newline at end of file
@@ -3,12 +3,23 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <stdexcept>
 
 #include <index.h>
 #include <pq_flash_index.h>
+#include <search_metrics.h>
 
 namespace diskann
 {
@@ -61,6 +72,70 @@ class SearchResult
     std::vector<unsigned> _partitions;
 };
 
+struct ResultCacheParameters
+{
+    // results kept over all shards; 0 turns the cache off
+    size_t capacity = 0;
+    // shards, each with its own lock and LRU list
+    uint32_t num_shards = 16;
+    // results older than this are searched again; 0 keeps them until evicted
+    uint32_t ttl_seconds = 0;
+    // 0 caches exact queries. Otherwise each coordinate is rounded to a
+    // multiple of this step, and queries that round to the same vector share a
+    // result.
+    float quantization_step = 0;
+};
+
+// A sharded LRU cache of search results keyed by the query vector, K and L
+class QueryResultCache
+{
+  public:
+    QueryResultCache(const ResultCacheParameters &params);
+
+    template <typename T>
+    std::string make_key(const T *query, const unsigned int dimensions, const unsigned int K,
+                         const unsigned int Ls) const;
+
+    // the result cached for key, or null if there is none or it expired
+    std::shared_ptr<const SearchResult> lookup(const std::string &key);
+    void insert(const std::string &key, std::shared_ptr<const SearchResult> result);
+    // drops every result, e.g. after the index changed
+    void clear();
+
+    uint64_t get_hits() const
+    {
+        return _hits;
+    }
+    uint64_t get_misses() const
+    {
+        return _misses;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    struct Entry
+    {
+        std::string key;
+        std::shared_ptr<const SearchResult> result;
+        Clock::time_point inserted;
+    };
+    struct Shard
+    {
+        std::mutex lock;
+        // most recently used first
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+    };
+
+    Shard &shard_of(const std::string &key);
+
+    ResultCacheParameters _params;
+    size_t _shard_capacity;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+};
+
 class SearchNotImplementedException : public std::logic_error
 {
   private:
@@ -81,60 +156,340 @@ class SearchNotImplementedException : public std::logic_error
     }
 };
 
+struct BatchingParameters
+{
+    // queries searched together at most; 0 or 1 searches each query on its own
+    uint32_t max_batch_size = 0;
+    // how long the first query of a batch waits for others to join it
+    uint32_t max_wait_us = 200;
+    // threads that search batches, each one batch at a time
+    uint32_t num_dispatchers = 1;
+};
+
+// Collects the queries of concurrent callers into batches of up to
+// max_batch_size queries, waiting at most max_wait_us for a batch to fill,
+// and searches each batch with one call to a batched search. Callers block
+// until their query has been searched.
+template <typename T> class SearchBatcher
+{
+  public:
+    // batch_fn(queries, num_queries, stride, K, Ls, ids, distances) searches
+    // num_queries queries, query i at queries + i * stride, and writes the K
+    // results of query i at ids and distances + i * K
+    using BatchFn =
+        std::function<void(const T *, size_t, size_t, unsigned int, unsigned int, uint64_t *, float *)>;
+
+    SearchBatcher(const BatchingParameters &params, BatchFn batch_fn);
+    // Searches the queries already submitted, then stops
+    ~SearchBatcher();
+
+    void search(const T *query, const unsigned int dimensions, const unsigned int K, const unsigned int Ls,
+                uint64_t *ids, float *distances);
+
+  private:
+    struct Request
+    {
+        const T *query;
+        unsigned int dimensions, K, Ls;
+        uint64_t *ids;
+        float *distances;
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    void dispatch();
+    void search_group(Request **first, Request **last);
+
+    BatchingParameters _params;
+    BatchFn _batch_fn;
+    std::mutex _lock;
+    std::condition_variable _arrived;
+    std::condition_variable _finished;
+    std::deque<Request *> _queue;
+    bool _stopping = false;
+    std::vector<std::thread> _dispatchers;
+};
+
+struct AdmissionParameters
+{
+    // searches run at once at most; others are rejected. 0 admits all.
+    uint32_t max_in_flight = 0;
+    // past this many searches in flight, L shrinks in proportion, down to K;
+    // 0 keeps L
+    uint32_t degrade_in_flight = 0;
+};
+
+class SearchOverloadedException : public std::runtime_error
+{
+  public:
+    SearchOverloadedException() : std::runtime_error("Too many searches in flight")
+    {
+    }
+};
+
+struct UpdateParameters
+{
+    // points the index can hold; 0 serves it read-only
+    uint32_t max_points = 0;
+    // graph degree and list size of the inserts, and the alpha they prune with
+    uint32_t max_degree = 64;
+    uint32_t insert_l = 100;
+    float alpha = 1.2f;
+    // threads of each batch of inserts; 0 for one per core
+    uint32_t num_threads = 0;
+    // deleted points are consolidated once this many have been deleted; 0
+    // never consolidates them
+    uint32_t consolidate_after = 0;
+};
+
+// What became of the updates queued so far
+struct UpdateStatus
+{
+    uint64_t queued = 0;  // batches
+    uint64_t applied = 0; // batches, failed ones included
+    uint64_t failed_batches = 0;
+    uint64_t inserted = 0; // points
+    uint64_t deleted = 0;  // points
+    uint64_t rejected = 0; // points the index refused, such as known tags or unknown ones to delete
+};
+
+// Applies batches of updates on a thread of its own, in the order they were
+// queued, so that callers are acknowledged before their batch is applied.
+class UpdateQueue
+{
+  public:
+    // apply(delta) applies one batch, adding what it did to delta
+    using ApplyFn = std::function<void(UpdateStatus &)>;
+
+    UpdateQueue();
+    // applies the batches already queued, then stops
+    ~UpdateQueue();
+
+    // returns the sequence number of the batch, from 1; the batch has been
+    // applied once get_status().applied reaches it
+    uint64_t submit(ApplyFn apply);
+    UpdateStatus get_status();
+
+  private:
+    void run();
+
+    std::mutex _lock;
+    std::condition_variable _queued;
+    std::deque<ApplyFn> _pending;
+    UpdateStatus _status;
+    bool _stopping = false;
+    std::thread _worker;
+};
+
 class BaseSearch
 {
   public:
     BaseSearch(const std::string &tagsFile = nullptr);
     virtual SearchResult search(const float *query, const unsigned int dimensions, const unsigned int K,
-                                const unsigned int Ls)
+                                const unsigned int Ls, const unsigned int budget_ms = 0)
     {
         throw SearchNotImplementedException("float");
     }
     virtual SearchResult search(const int8_t *query, const unsigned int dimensions, const unsigned int K,
-                                const unsigned int Ls)
+                                const unsigned int Ls, const unsigned int budget_ms = 0)
     {
         throw SearchNotImplementedException("int8_t");
     }
 
     virtual SearchResult search(const uint8_t *query, const unsigned int dimensions, const unsigned int K,
-                                const unsigned int Ls)
+                                const unsigned int Ls, const unsigned int budget_ms = 0)
     {
         throw SearchNotImplementedException("uint8_t");
     }
 
     void lookup_tags(const unsigned K, const unsigned *indices, std::string *ret_tags);
 
+    // Serves repeated queries from a cache of results. Call
+    // invalidate_result_cache() whenever the index changes.
+    void enable_result_cache(const ResultCacheParameters &params);
+    void invalidate_result_cache();
+
+    // Searches concurrent queries in batches through the index's batched
+    // search
+    virtual void enable_batching(const BatchingParameters &params)
+    {
+        throw std::logic_error("Batching is not implemented for this index");
+    }
+
+    void enable_admission_control(const AdmissionParameters &params)
+    {
+        _admission = params;
+    }
+
+    // Queues the insertion of num_points vectors of dimensions coordinates,
+    // one after the other, with their tags, for indices served with updates.
+    // Returns the sequence number of the batch in the UpdateQueue.
+    virtual uint64_t queue_insert(const float *vectors, const uint32_t *tags, const size_t num_points,
+                                  const unsigned int dimensions)
+    {
+        throw std::logic_error("This index does not take updates");
+    }
+    virtual uint64_t queue_insert(const int8_t *vectors, const uint32_t *tags, const size_t num_points,
+                                  const unsigned int dimensions)
+    {
+        throw std::logic_error("This index does not take updates");
+    }
+    virtual uint64_t queue_insert(const uint8_t *vectors, const uint32_t *tags, const size_t num_points,
+                                  const unsigned int dimensions)
+    {
+        throw std::logic_error("This index does not take updates");
+    }
+
+    // Queues the lazy deletion of the points with these tags
+    virtual uint64_t queue_delete(std::vector<uint32_t> tags)
+    {
+        throw std::logic_error("This index does not take updates");
+    }
+
+    // Sets status and returns true, or returns false for indices that do not
+    // take updates
+    virtual bool get_update_status(UpdateStatus &status)
+    {
+        return false;
+    }
+
+    // Adds the search metrics of the index to metrics and returns true, or
+    // returns false for indices that do not collect any
+    virtual bool collect_metrics(SearchMetrics &metrics) const
+    {
+        return false;
+    }
+
+    // Adds the read latencies and queue depths of the index to metrics and
+    // returns true, or returns false for indices that do not sample them
+    virtual bool collect_io_metrics(IOMetrics &metrics) const
+    {
+        return false;
+    }
+
+    // Adds the bytes the index holds to usage and returns true, or returns
+    // false for indices that cannot report them
+    virtual bool collect_memory_usage(MemoryUsage &usage)
+    {
+        return false;
+    }
+
   protected:
+    // Counts a search in flight for its lifetime. Ls is the list size to
+    // search with, reduced when the searches in flight pass
+    // degrade_in_flight. Throws SearchOverloadedException if max_in_flight
+    // searches are running.
+    class AdmissionTicket
+    {
+      public:
+        AdmissionTicket(BaseSearch &search, const unsigned int K, const unsigned int Ls);
+        ~AdmissionTicket();
+        unsigned int Ls;
+
+      private:
+        BaseSearch &_search;
+    };
+
+    // runs search_fn(exact) and caches its result, unless the cache has one
+    // or search_fn clears exact
+    template <typename T, typename SearchFn>
+    SearchResult cached_search(const T *query, const unsigned int dimensions, const unsigned int K,
+                               const unsigned int Ls, SearchFn &&search_fn);
+
     bool _tags_enabled;
     std::vector<std::string> _tags_str;
+    std::unique_ptr<QueryResultCache> _result_cache;
+    AdmissionParameters _admission;
+    std::atomic<uint32_t> _in_flight{0};
 };
 
 template <typename T> class InMemorySearch : public BaseSearch
 {
   public:
+    // With update_params.max_points set, the index must have been saved by a
+    // dynamic index with tags. It then takes inserts and deletes, and
+    // searches return the tags of the points as their ids, so tagsFile must
+    // be empty.
     InMemorySearch(const std::string &baseFile, const std::string &indexFile, const std::string &tagsFile, Metric m,
-                   uint32_t num_threads, uint32_t search_l);
+                   uint32_t num_threads, uint32_t search_l,
+                   const UpdateParameters &update_params = UpdateParameters());
     virtual ~InMemorySearch();
 
-    SearchResult search(const T *query, const unsigned int dimensions, const unsigned int K, const unsigned int Ls);
+    // With a budget, L is reduced to what the recent searches suggest fits
+    // in it
+    SearchResult search(const T *query, const unsigned int dimensions, const unsigned int K, const unsigned int Ls,
+                        const unsigned int budget_ms = 0);
+    // batches are searched with interleaved queries; not for indices that
+    // take updates, whose batched search does not return tags
+    void enable_batching(const BatchingParameters &params) override;
+    bool collect_memory_usage(MemoryUsage &usage) override;
+
+    // inserts are applied with Index::insert_points(), a batch at a time
+    uint64_t queue_insert(const T *vectors, const uint32_t *tags, const size_t num_points,
+                          const unsigned int dimensions) override;
+    uint64_t queue_delete(std::vector<uint32_t> tags) override;
+    bool get_update_status(UpdateStatus &status) override;
 
   private:
+    SearchResult search_index(const T *query, const unsigned int dimensions, const unsigned int K,
+                              const unsigned int Ls, const unsigned int budget_ms, bool &exact);
+
     unsigned int _dimensions, _numPoints;
     std::unique_ptr<diskann::Index<T>> _index;
+    // with updates, the parameters of inserts and consolidation
+    std::shared_ptr<IndexWriteParameters> _write_params;
+    uint32_t _consolidate_after = 0;
+    // deleted since the last consolidation; only touched by _updates
+    uint64_t _unconsolidated = 0;
+    // with updates; destroyed before _index, as it updates it
+    std::unique_ptr<UpdateQueue> _updates;
+    // moving average of the search time per unit of L
+    std::atomic<float> _us_per_l{1.0f};
+    // destroyed first, as it searches _index
+    std::unique_ptr<SearchBatcher<T>> _batcher;
 };
 
 template <typename T> class PQFlashSearch : public BaseSearch
 {
   public:
+    // With numa_replicas, one copy of the index is loaded per NUMA node and
+    // each query is served by the copy on the node it runs on. With
+    // lazy_load, the constructor returns before the PQ codes and the node
+    // cache are in memory (see PQFlashIndex::set_lazy_load()). With a host,
+    // the index searches with the scratch the host shares between the
+    // indices of a process (see PQFlashIndex::set_search_host()); not with
+    // numa_replicas. A memory_quota in bytes caps the index: loading fails
+    // if the index needs more before its node cache, and the cache is cut to
+    // what fits in the rest.
     PQFlashSearch(const std::string &indexPrefix, const unsigned num_nodes_to_cache, const unsigned num_threads,
-                  const std::string &tagsFile, Metric m);
+                  const std::string &tagsFile, Metric m, const bool numa_replicas = false,
+                  const bool lazy_load = false, std::shared_ptr<SSDSearchHost<T>> host = nullptr,
+                  const uint64_t memory_quota = 0);
     virtual ~PQFlashSearch();
 
-    SearchResult search(const T *query, const unsigned int dimensions, const unsigned int K, const unsigned int Ls);
+    // With a budget, the reads of the search are capped at what the recent
+    // searches suggest fits in it
+    SearchResult search(const T *query, const unsigned int dimensions, const unsigned int K, const unsigned int Ls,
+                        const unsigned int budget_ms = 0);
+    // batches are searched in lockstep, sharing their reads
+    void enable_batching(const BatchingParameters &params) override;
+    // the metrics of all replicas together
+    bool collect_metrics(SearchMetrics &metrics) const override;
+    // the reads of all replicas together
+    bool collect_io_metrics(IOMetrics &metrics) const override;
+    // the memory of all replicas together
+    bool collect_memory_usage(MemoryUsage &usage) override;
 
   private:
+    SearchResult search_index(const T *query, const unsigned int dimensions, const unsigned int K,
+                              const unsigned int Ls, const unsigned int budget_ms, bool &exact);
+
     unsigned int _dimensions, _numPoints;
-    std::unique_ptr<diskann::PQFlashIndex<T>> _index;
-    std::shared_ptr<AlignedFileReader> reader;
+    // moving average of the search time per read
+    std::atomic<float> _us_per_io{100.0f};
+    // one per NUMA node with numa_replicas, else one; each has its own reader
+    std::vector<std::unique_ptr<diskann::PQFlashIndex<T>>> _replicas;
+    // destroyed first, as it searches _replicas
+    std::unique_ptr<SearchBatcher<T>> _batcher;
 };
 } // namespace diskann
@@ -3,7 +3,14 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 #include <restapi/common.h>
+#include <shard_pool.h>
 #include <cpprest/http_listener.h>
 
 namespace diskann
@@ -11,15 +18,37 @@ namespace diskann
 class Server
 {
   public:
+    // With several searchers, each query is searched on all of them at once
+    // on shard_threads threads (0 for one per core). A query waits at most
+    // shard_deadline_ms (0 for no limit) for the shards and is answered with
+    // the results of those that finished.
     Server(web::uri &url, std::vector<std::unique_ptr<diskann::BaseSearch>> &multi_searcher,
-           const std::string &typestring);
+           const std::string &typestring, const unsigned shard_threads = 0, const unsigned shard_deadline_ms = 0);
     virtual ~Server();
 
     pplx::task<void> open();
     pplx::task<void> close();
 
   protected:
+    // serves the search metrics of the searchers at /metrics, in the
+    // Prometheus text format or, if the request accepts it, OpenMetrics, and
+    // the bytes their indices hold at /memory
+    void handle_get(web::http::http_request message);
+    // {"total_bytes": ..., "components": {...}}, with the same per shard
+    // under "shards" when there are several
+    void handle_get_memory(web::http::http_request message);
     template <class T> void handle_post(web::http::http_request message);
+    // requests with an application/octet-stream body; see binary_protocol
+    template <class T> void handle_binary_post(web::http::http_request message);
+    // queues the batch POSTed to /insert or /delete and acknowledges it with
+    // 202 Accepted and its sequence number, before it is applied
+    template <class T> void handle_update(web::http::http_request message);
+    template <class T> uint64_t queue_insert_binary(const std::vector<unsigned char> &request);
+    uint64_t queue_delete_binary(const std::vector<unsigned char> &request);
+    // {"queued": ..., "applied": ..., ...}, see UpdateStatus
+    void handle_get_updates(web::http::http_request message);
+    template <class T>
+    std::vector<unsigned char> search_binary(const std::vector<unsigned char> &request, int64_t &num_queries);
 
     template <typename T>
     web::json::value toJsonArray(const std::vector<T> &v, std::function<web::json::value(const T &)> valConverter);
@@ -27,19 +56,30 @@ class Server
 
     template <class T>
     void parseJson(const utility::string_t &body, unsigned int &k, int64_t &queryId, T *&queryVector,
-                   unsigned int &dimensions, unsigned &Ls);
+                   unsigned int &dimensions, unsigned &Ls, unsigned &budget_ms);
 
     web::json::value idsToJsonArray(const diskann::SearchResult &result);
     web::json::value distancesToJsonArray(const diskann::SearchResult &result);
     web::json::value tagsToJsonArray(const diskann::SearchResult &result);
     web::json::value partitionsToJsonArray(const diskann::SearchResult &result);
 
-    SearchResult aggregate_results(const unsigned K, const std::vector<diskann::SearchResult> &results);
+    // merges the results of the shards, null for those that did not answer
+    SearchResult aggregate_results(const unsigned K, const std::vector<const diskann::SearchResult *> &results);
+
+    // searches every shard and fills in the results of those that answer in
+    // time; returns false if some did not. budget_ms, if not 0, is the
+    // latency budget of the search on each shard.
+    template <class T>
+    bool search_shards(const T *query, const unsigned dimensions, const unsigned K, const unsigned Ls,
+                       std::vector<std::unique_ptr<diskann::SearchResult>> &results, const unsigned budget_ms = 0);
 
   private:
     bool _isDebug;
     std::unique_ptr<web::http::experimental::listener::http_listener> _listener;
     const bool _multi_search;
     std::vector<std::unique_ptr<diskann::BaseSearch>> _multi_searcher;
+    const unsigned _shard_deadline_ms;
+    // after the searchers, so that it stops before they are destroyed
+    std::unique_ptr<ShardPool> _shard_pool;
 };
 } // namespace diskann
@@ -15,7 +15,8 @@
 #include "abstract_scratch.h"
 #include "neighbor.h"
 #include "defaults.h"
-#include "concurrent_queue.h"
+#include "scratch_pool.h"
+#include "visited_set.h"
 
 namespace diskann
 {
@@ -31,8 +32,15 @@ template <typename T> class InMemQueryScratch : public AbstractScratch<T>
     InMemQueryScratch(uint32_t search_l, uint32_t indexing_l, uint32_t r, uint32_t maxc, size_t dim, size_t aligned_dim,
                       size_t alignment_factor, bool init_pq_scratch = false);
     void resize_for_new_L(uint32_t new_search_l);
+    // As resize_for_new_L(), but at least doubles the L the scratch is sized
+    // for, so that searches stepping through larger Ls reallocate only a few
+    // times
+    void grow_for_new_L(uint32_t new_search_l);
     void clear();
 
+    // bytes allocated for the scratch
+    size_t memory_size() const;
+
     inline uint32_t get_L()
     {
         return _L;
@@ -65,13 +73,25 @@ template <typename T> class InMemQueryScratch : public AbstractScratch<T>
     {
         return _occlude_factor;
     }
-    inline tsl::robin_set<uint32_t> &inserted_into_pool_rs()
+    inline std::vector<uint32_t> &occlude_ids()
+    {
+        return _occlude_ids;
+    }
+    inline std::vector<uint32_t> &occlude_positions()
+    {
+        return _occlude_positions;
+    }
+    inline std::vector<float> &occlude_distances()
     {
-        return _inserted_into_pool_rs;
+        return _occlude_distances;
     }
-    inline boost::dynamic_bitset<> &inserted_into_pool_bs()
+    inline std::vector<float> &occlude_bounds()
     {
-        return *_inserted_into_pool_bs;
+        return _occlude_bounds;
+    }
+    inline VisitedSet &inserted_into_pool()
+    {
+        return _inserted_into_pool;
     }
     inline std::vector<uint32_t> &id_scratch()
     {
@@ -98,6 +118,7 @@ template <typename T> class InMemQueryScratch : public AbstractScratch<T>
     uint32_t _L;
     uint32_t _R;
     uint32_t _maxc;
+    size_t _aligned_query_size = 0;
 
     // _pool stores all neighbors explored from best_L_nodes.
     // Usually around L+R, but could be higher.
@@ -113,13 +134,16 @@ template <typename T> class InMemQueryScratch : public AbstractScratch<T>
     // _occlude_factor is initialized to maxc size
     std::vector<float> _occlude_factor;
 
-    // Capacity initialized to 20L
-    tsl::robin_set<uint32_t> _inserted_into_pool_rs;
+    // The pool entries an entry chosen by occlude_list may occlude: their ids,
+    // positions in the pool, distances to the chosen entry and the bounds
+    // past which those distances cannot occlude them. Sized maxc.
+    std::vector<uint32_t> _occlude_ids;
+    std::vector<uint32_t> _occlude_positions;
+    std::vector<float> _occlude_distances;
+    std::vector<float> _occlude_bounds;
 
-    // Use a pointer here to allow for forward declaration of dynamic_bitset
-    // in public headers to avoid making boost a dependency for clients
-    // of DiskANN.
-    boost::dynamic_bitset<> *_inserted_into_pool_bs;
+    // Sized for the index by iterate_to_fixed_point
+    VisitedSet _inserted_into_pool;
 
     // _id_scratch.size() must be > R*GRAPH_SLACK_FACTOR for iterate_to_fp
     std::vector<uint32_t> _id_scratch;
@@ -143,10 +167,17 @@ template <typename T> class SSDQueryScratch : public AbstractScratch<T>
   public:
     T *coord_scratch = nullptr; // MUST BE AT LEAST [sizeof(T) * data_dim]
 
-    char *sector_scratch = nullptr; // MUST BE AT LEAST [MAX_N_SECTOR_READS * SECTOR_LEN]
-    size_t sector_idx = 0;          // index of next [SECTOR_LEN] scratch to use
+    char *sector_scratch = nullptr;      // MUST BE AT LEAST [MAX_N_SECTOR_READS * SECTOR_LEN]
+    size_t sector_idx = 0;               // index of next [SECTOR_LEN] scratch to use
+    char *speculative_scratch = nullptr; // [MAX_SPECULATIVE_SECTORS * SECTOR_LEN]
+    char *reorder_scratch = nullptr;     // [MAX_REORDER_PREFETCH_SECTORS * SECTOR_LEN]
+    uint32_t *nbr_scratch = nullptr;     // [MAX_GRAPH_DEGREE], neighbor ids unpacked from a node
+    float *float_query = nullptr;        // [aligned_dim], the prepared query of a float query search
 
-    tsl::robin_set<size_t> visited;
+    // [MAX_GRAPH_DEGREE], the neighbors of a node left to score in a filtered search
+    uint32_t *filtered_nbr_scratch = nullptr;
+
+    VisitedSet visited;
     NeighborPriorityQueue retset;
     std::vector<Neighbor> full_retset;
 
@@ -154,6 +185,12 @@ template <typename T> class SSDQueryScratch : public AbstractScratch<T>
     ~SSDQueryScratch();
 
     void reset();
+
+    // bytes allocated for the scratch
+    size_t memory_size() const;
+
+  private:
+    size_t _buffer_size = 0;
 };
 
 template <typename T> class SSDThreadData
@@ -161,9 +198,15 @@ template <typename T> class SSDThreadData
   public:
     SSDQueryScratch<T> scratch;
     IOContext ctx;
+    IOContext vectors_ctx; // of the reader of the reorder data, when it has a file of its own
 
     SSDThreadData(size_t aligned_dim, size_t visited_reserve);
     void clear();
+
+    size_t memory_size() const
+    {
+        return scratch.memory_size() + sizeof(ctx) + sizeof(vectors_ctx);
+    }
 };
 
 //
@@ -172,14 +215,9 @@ template <typename T> class SSDThreadData
 template <typename T> class ScratchStoreManager
 {
   public:
-    ScratchStoreManager(ConcurrentQueue<T *> &query_scratch) : _scratch_pool(query_scratch)
+    ScratchStoreManager(ScratchPool<T> &query_scratch) : _scratch_pool(query_scratch)
     {
-        _scratch = query_scratch.pop();
-        while (_scratch == nullptr)
-        {
-            query_scratch.wait_for_push_notify();
-            _scratch = query_scratch.pop();
-        }
+        _scratch = query_scratch.acquire(_index);
     }
     T *scratch_space()
     {
@@ -189,27 +227,13 @@ template <typename T> class ScratchStoreManager
     ~ScratchStoreManager()
     {
         _scratch->clear();
-        _scratch_pool.push(_scratch);
-        _scratch_pool.push_notify_all();
-    }
-
-    void destroy()
-    {
-        while (!_scratch_pool.empty())
-        {
-            auto scratch = _scratch_pool.pop();
-            while (scratch == nullptr)
-            {
-                _scratch_pool.wait_for_push_notify();
-                scratch = _scratch_pool.pop();
-            }
-            delete scratch;
-        }
+        _scratch_pool.release(_index);
     }
 
   private:
     T *_scratch;
-    ConcurrentQueue<T *> &_scratch_pool;
+    uint32_t _index;
+    ScratchPool<T> &_scratch_pool;
     ScratchStoreManager(const ScratchStoreManager<T> &);
     ScratchStoreManager &operator=(const ScratchStoreManager<T> &);
 };
@@ -0,0 +1,201 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ann_exception.h"
+
+namespace diskann
+{
+// Pool of per-query scratch objects shared by the search threads. Idle
+// scratch sits on a lock-free (Treiber) stack, so taking and returning one is
+// a single compare-and-swap on the stack head. The head packs a version
+// counter with the index of the top slot, so a slot that is popped and pushed
+// back by other threads between a load and the CAS cannot be mistaken for an
+// unchanged stack (the ABA problem).
+//
+// A thread that finds the pool empty spins briefly and then sleeps on a
+// condition variable, which release() only touches while someone waits. The
+// pool owns its scratch and deletes it in destroy() or on destruction.
+template <typename T> class ScratchPool
+{
+  public:
+    ScratchPool() : _chunks(new std::atomic<Slot *>[MAX_CHUNKS])
+    {
+        for (uint32_t c = 0; c < MAX_CHUNKS; c++)
+            _chunks[c].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~ScratchPool()
+    {
+        destroy();
+    }
+
+    ScratchPool(const ScratchPool &) = delete;
+    ScratchPool &operator=(const ScratchPool &) = delete;
+
+    // Adds scratch to the pool, which takes ownership. May run concurrently
+    // with searches.
+    void push(T *scratch)
+    {
+        std::lock_guard<std::mutex> lk(_add_mut);
+        const uint32_t index = _num_slots.load(std::memory_order_relaxed);
+        if (index >= MAX_CHUNKS * CHUNK_SIZE)
+            throw ANNException("ScratchPool is full", -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (index % CHUNK_SIZE == 0)
+            _chunks[index / CHUNK_SIZE].store(new Slot[CHUNK_SIZE], std::memory_order_release);
+        slot(index).scratch = scratch;
+        _num_slots.store(index + 1, std::memory_order_release);
+        release(index);
+    }
+
+    // Number of scratch objects owned by the pool, idle or not
+    uint64_t size() const
+    {
+        return _num_slots.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // Takes an idle scratch, or returns nullptr if there is none. index
+    // identifies it to release().
+    T *try_acquire(uint32_t &index)
+    {
+        uint64_t head = _head.load(std::memory_order_acquire);
+        while (true)
+        {
+            const uint32_t top = (uint32_t)head;
+            if (top == EMPTY)
+                return nullptr;
+            const uint32_t next = slot(top - 1).next.load(std::memory_order_relaxed);
+            const uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+            if (_head.compare_exchange_weak(head, new_head, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                index = top - 1;
+                return slot(index).scratch;
+            }
+        }
+    }
+
+    // Takes an idle scratch, waiting for one if all are in use
+    T *acquire(uint32_t &index)
+    {
+        for (uint32_t attempt = 0;; attempt++)
+        {
+            T *scratch = try_acquire(index);
+            if (scratch != nullptr)
+                return scratch;
+            if (attempt < SPIN_ATTEMPTS)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(_wait_mut);
+            _num_waiters.fetch_add(1);
+            _wait_cv.wait_for(lk, std::chrono::microseconds(100),
+                              [this] { return (uint32_t)_head.load() != EMPTY; });
+            _num_waiters.fetch_sub(1);
+        }
+    }
+
+    void release(uint32_t index)
+    {
+        Slot &s = slot(index);
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        uint64_t new_head;
+        do
+        {
+            s.next.store((uint32_t)head, std::memory_order_relaxed);
+            new_head = (((head >> 32) + 1) << 32) | (index + 1);
+        } while (!_head.compare_exchange_weak(head, new_head));
+
+        if (_num_waiters.load() > 0)
+        {
+            std::lock_guard<std::mutex> lk(_wait_mut);
+            _wait_cv.notify_one();
+        }
+    }
+
+    // Calls fn on every scratch in the pool. Takes them all in turn, so that
+    // none is used by a search meanwhile, waiting for the searches using them
+    // to finish.
+    template <typename Fn> void for_each(Fn &&fn)
+    {
+        std::lock_guard<std::mutex> lk(_add_mut);
+        const uint32_t num_slots = _num_slots.load(std::memory_order_relaxed);
+        std::vector<uint32_t> taken;
+        taken.reserve(num_slots);
+        for (uint32_t i = 0; i < num_slots; i++)
+        {
+            uint32_t index;
+            fn(acquire(index));
+            taken.push_back(index);
+        }
+        for (uint32_t index : taken)
+            release(index);
+    }
+
+    // Bytes allocated for the scratch in the pool, by T::memory_size()
+    uint64_t memory_size()
+    {
+        uint64_t bytes = 0;
+        for_each([&bytes](T *scratch) { bytes += scratch->memory_size(); });
+        return bytes;
+    }
+
+    // Deletes all scratch. None may be in use.
+    void destroy()
+    {
+        std::lock_guard<std::mutex> lk(_add_mut);
+        const uint32_t num_slots = _num_slots.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < num_slots; i++)
+            delete slot(i).scratch;
+        for (uint32_t c = 0; c < MAX_CHUNKS; c++)
+            delete[] _chunks[c].exchange(nullptr);
+        _num_slots.store(0);
+        _head.store(EMPTY);
+    }
+
+  private:
+    struct Slot
+    {
+        T *scratch = nullptr;
+        // index + 1 of the slot below on the idle stack, EMPTY at the bottom
+        std::atomic<uint32_t> next{EMPTY};
+    };
+
+    // Slots live in chunks that are never moved, so a thread can read a slot
+    // while another adds scratch.
+    static const uint32_t CHUNK_SIZE = 256;
+    static const uint32_t MAX_CHUNKS = 1024;
+    static const uint32_t EMPTY = 0;
+    static const uint32_t SPIN_ATTEMPTS = 64;
+
+    Slot &slot(uint32_t index) const
+    {
+        return _chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+    }
+
+    std::unique_ptr<std::atomic<Slot *>[]> _chunks;
+    std::atomic<uint32_t> _num_slots{0};
+    // version in the upper 32 bits, index + 1 of the top idle slot (or EMPTY)
+    // in the lower 32
+    std::atomic<uint64_t> _head{EMPTY};
+
+    std::mutex _add_mut;
+    std::mutex _wait_mut;
+    std::condition_variable _wait_cv;
+    std::atomic<uint32_t> _num_waiters{0};
+};
+} // namespace diskann
@@ -0,0 +1,83 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "neighbor.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Features of a search after its first hops, from which SearchBudgetModel
+// predicts the hops it needs: a constant, the log of the distance to the
+// closest start point, the distances of the closest and K-th closest
+// candidates and how much the K-th improved over the second half of the
+// warmup, all relative to that distance, and the share of the K closest
+// candidates already expanded.
+const size_t SEARCH_BUDGET_FEATURES = 6;
+
+// A per-query hop budget for the in-memory Index::search at one L and K. After
+// warmup_hops hops, the search takes at most multiplier * exp(weights .
+// features) hops in all. Index::train_search_budget_model() fits the weights
+// on sample queries with their ground truth and picks the multiplier.
+struct SearchBudgetModel
+{
+    uint32_t L = 0;
+    uint32_t K = 0;
+    uint32_t warmup_hops = 0;
+    float multiplier = 1.0f;
+    float weights[SEARCH_BUDGET_FEATURES] = {};
+
+    // exp(weights . features), the hops predicted for a search
+    DISKANN_DLLEXPORT float predicted_hops(const float *features) const;
+
+    // the hops a search with these features may take, at least warmup_hops
+    DISKANN_DLLEXPORT uint32_t budget(const float *features) const;
+
+    DISKANN_DLLEXPORT void save(const std::string &path) const;
+    // Throws ANNException if path does not hold a model
+    DISKANN_DLLEXPORT static SearchBudgetModel load(const std::string &path);
+
+    // Least squares fit, slightly regularized, of log(hops[i]) on the
+    // SEARCH_BUDGET_FEATURES features of sample i, into weights
+    DISKANN_DLLEXPORT static void fit_weights(const std::vector<float> &features, const std::vector<uint32_t> &hops,
+                                              float *weights);
+};
+
+// The state of one search under a hop budget: a fixed cap on its hops, and
+// the features, recorded after warmup_hops hops and capping the hops further
+// if model is set.
+struct SearchBudget
+{
+    const SearchBudgetModel *model = nullptr;
+    uint32_t warmup_hops = 0;
+    uint32_t K = 1;
+    uint32_t max_hops = std::numeric_limits<uint32_t>::max();
+
+    float features[SEARCH_BUDGET_FEATURES] = {};
+    bool has_features = false;
+
+    SearchBudget() = default;
+    // a search governed by model
+    explicit SearchBudget(const SearchBudgetModel *model)
+        : model(model), warmup_hops(model->warmup_hops), K(model->K)
+    {
+    }
+
+    // call once the start points are in candidates
+    void begin(const NeighborPriorityQueue &candidates);
+    // call after each hop, hops counting it
+    void after_hop(const uint32_t hops, const NeighborPriorityQueue &candidates);
+
+  private:
+    float _entry_distance = 0;
+    float _half_warmup_kth = 0;
+
+    float kth_distance(const NeighborPriorityQueue &candidates) const;
+};
+} // namespace diskann
@@ -0,0 +1,230 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "percentile_stats.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// A lock-free histogram of non-negative integers in the style of HdrHistogram:
+// values below SUB_BUCKETS are counted exactly, and every power of two above
+// is split into SUB_BUCKETS / 2 buckets of equal width, so a value is known to
+// within 1/16 of itself. Values past 2^MAX_VALUE_BITS go to the last bucket.
+//
+// record() is a few relaxed atomic increments and may be called from any
+// number of threads; the readers see a consistent enough snapshot for
+// monitoring, not an exact one.
+class LatencyHistogram
+{
+  public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 5;
+    static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr uint32_t MAX_VALUE_BITS = 48;
+    static constexpr uint32_t NUM_BUCKETS = SUB_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2);
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    inline void record(uint64_t value)
+    {
+        _counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = _max.load(std::memory_order_relaxed);
+        while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t count() const
+    {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t sum() const
+    {
+        return _sum.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const
+    {
+        return _max.load(std::memory_order_relaxed);
+    }
+
+    // The largest value of the bucket holding the value of the given rank,
+    // for quantile in [0, 1]; 0 if nothing was recorded
+    DISKANN_DLLEXPORT uint64_t value_at_quantile(double quantile) const;
+
+    // adds the counts of other to this histogram
+    DISKANN_DLLEXPORT void add(const LatencyHistogram &other);
+    DISKANN_DLLEXPORT void reset();
+
+  private:
+    static inline uint32_t bucket_of(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return (uint32_t)value;
+        uint32_t msb = 63;
+        while ((value >> msb) == 0)
+            msb--;
+        if (msb >= MAX_VALUE_BITS)
+            return NUM_BUCKETS - 1;
+        const uint32_t shift = msb - (SUB_BUCKET_BITS - 1);
+        return SUB_BUCKETS + (msb - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2) + (uint32_t)(value >> shift) -
+               SUB_BUCKETS / 2;
+    }
+
+    // largest value that falls in bucket
+    static uint64_t highest_value_of(uint32_t bucket);
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> _counts;
+    std::atomic<uint64_t> _count{0};
+    std::atomic<uint64_t> _sum{0};
+    std::atomic<uint64_t> _max{0};
+};
+
+// The QueryStats of the searches of an index, aggregated into a histogram per
+// phase and counters of reads and cache hits. Times are in microseconds.
+class SearchMetrics
+{
+  public:
+    enum Series
+    {
+        TOTAL_US,   // whole query
+        IO_US,      // waiting for reads
+        PQ_US,      // PQ distances to the neighbors of expanded nodes
+        FP_US,      // full precision distances to expanded and re-ranked nodes
+        HOPS,       // rounds of reads
+        IOS,        // reads
+        BYTES_READ, // bytes read
+        NUM_SERIES
+    };
+
+    DISKANN_DLLEXPORT void record(const QueryStats &stats);
+    DISKANN_DLLEXPORT void add(const SearchMetrics &other);
+    DISKANN_DLLEXPORT void reset();
+
+    const LatencyHistogram &histogram(Series series) const
+    {
+        return _histograms[series];
+    }
+
+    uint64_t num_queries() const
+    {
+        return _histograms[TOTAL_US].count();
+    }
+
+    uint64_t num_cache_hits() const
+    {
+        return _cache_hits.load(std::memory_order_relaxed);
+    }
+
+    // share of the nodes expanded without a read
+    DISKANN_DLLEXPORT double cache_hit_rate() const;
+
+    // Writes the metrics of each (labels, metrics) entry of sets in the
+    // Prometheus text format, each histogram as a summary with quantiles
+    // 0.5, 0.9, 0.99 and 0.999. labels is a comma separated list such as
+    // shard="0", or empty. With openmetrics, writes the OpenMetrics 1.0 text
+    // format instead, which names counters differently and ends with # EOF,
+    // unless more metrics follow (write_eof false).
+    DISKANN_DLLEXPORT static void write_text(std::ostream &out,
+                                             const std::vector<std::pair<std::string, const SearchMetrics *>> &sets,
+                                             const std::string &prefix = "diskann_search",
+                                             const bool openmetrics = false, const bool write_eof = true);
+
+  private:
+    std::array<LatencyHistogram, NUM_SERIES> _histograms;
+    std::atomic<uint64_t> _cache_hits{0};
+};
+
+// The reads of a file reader: the time from submitting each read to reaping
+// its completion, the reads in flight on the whole reader (the queue depth the
+// device gets from it) and on the submitting context at every submission, and
+// the reads slower than a threshold. Readers that support it fill one in once
+// AlignedFileReader::enable_io_metrics() is called.
+class IOMetrics
+{
+  public:
+    enum Series
+    {
+        LATENCY_US,    // submission to completion of a read
+        DEVICE_DEPTH,  // reads in flight on the reader after a submission
+        CONTEXT_DEPTH, // reads in flight on the submitting context after it
+        NUM_SERIES
+    };
+
+    // n reads were submitted on a context that now has context_depth in flight
+    inline void record_submit(uint64_t n, uint64_t context_depth)
+    {
+        const uint64_t depth = _in_flight.fetch_add(n, std::memory_order_relaxed) + n;
+        _histograms[DEVICE_DEPTH].record(depth);
+        _histograms[CONTEXT_DEPTH].record(context_depth);
+    }
+
+    inline void record_completion(uint64_t latency_us)
+    {
+        _in_flight.fetch_sub(1, std::memory_order_relaxed);
+        _histograms[LATENCY_US].record(latency_us);
+        const uint64_t threshold = _slow_read_us.load(std::memory_order_relaxed);
+        if (threshold > 0 && latency_us > threshold)
+            slow_read(latency_us);
+    }
+
+    // Counts the reads that take longer than threshold_us (0 for none) and
+    // calls alert with the latency of each, from the thread that reaped it.
+    // Without an alert, a warning is logged at most once a second.
+    DISKANN_DLLEXPORT void set_slow_read_alert(uint64_t threshold_us,
+                                               std::function<void(uint64_t latency_us)> alert = nullptr);
+
+    const LatencyHistogram &histogram(Series series) const
+    {
+        return _histograms[series];
+    }
+
+    uint64_t in_flight() const
+    {
+        return _in_flight.load(std::memory_order_relaxed);
+    }
+
+    uint64_t num_slow_reads() const
+    {
+        return _slow_reads.load(std::memory_order_relaxed);
+    }
+
+    // adds the histograms and counters of other; the alert is not copied
+    DISKANN_DLLEXPORT void add(const IOMetrics &other);
+    DISKANN_DLLEXPORT void reset();
+
+    // as SearchMetrics::write_text(), with the read latency and queue depths
+    // as summaries
+    DISKANN_DLLEXPORT static void write_text(std::ostream &out,
+                                             const std::vector<std::pair<std::string, const IOMetrics *>> &sets,
+                                             const std::string &prefix = "diskann_io", const bool openmetrics = false,
+                                             const bool write_eof = true);
+
+  private:
+    DISKANN_DLLEXPORT void slow_read(uint64_t latency_us);
+
+    std::array<LatencyHistogram, NUM_SERIES> _histograms;
+    std::atomic<uint64_t> _in_flight{0};
+    std::atomic<uint64_t> _slow_reads{0};
+    std::atomic<uint64_t> _slow_read_us{0};
+    std::mutex _alert_mut;
+    std::function<void(uint64_t)> _alert;
+    uint64_t _last_warning_us = 0;
+};
+} // namespace diskann
@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// What a trace point records; a and b are the arguments of
+// SearchTrace::record()
+enum class TraceEventType : uint32_t
+{
+    QUERY_BEGIN, // a: L, b: beam width (0 for in-memory searches)
+    QUERY_END,   // a: hops, b: reads
+    HOP_BEGIN,   // a: hop, b: nodes in the beam
+    HOP_END,     // a: hop, b: reads issued in the hop
+    EXPAND,      // a: node expanded, b: distances computed to its neighbors
+    READ,        // a: sector read, b: bytes
+    CACHE_HIT    // a: node found in a cache
+};
+
+// Trace points on the hops of the disk and in-memory searches, for profiling
+// single slow queries on live machines.
+//
+// Tracing is off until set_enabled(true); a trace point then costs a relaxed
+// load of a global flag. Building with DISKANN_DISABLE_TRACING removes the
+// trace points altogether. While on, each thread appends its events to a ring
+// buffer of its own, which keeps the last buffer_capacity() events, and
+// write_chrome_trace() dumps the buffers of all threads as Chrome trace
+// event JSON, which chrome://tracing and Perfetto open. Dump after turning
+// tracing off: events written during a dump may come out torn.
+class SearchTrace
+{
+  public:
+    static inline bool enabled()
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    DISKANN_DLLEXPORT static void set_enabled(bool enable);
+
+    // events kept per thread, rounded up to a power of two; applies to the
+    // buffers of threads that have not recorded anything yet
+    DISKANN_DLLEXPORT static void set_buffer_capacity(uint64_t num_events);
+    DISKANN_DLLEXPORT static uint64_t buffer_capacity();
+
+    DISKANN_DLLEXPORT static void record(TraceEventType type, uint64_t a = 0, uint64_t b = 0);
+
+    // drops the events recorded so far
+    DISKANN_DLLEXPORT static void clear();
+
+    DISKANN_DLLEXPORT static void write_chrome_trace(std::ostream &out);
+    DISKANN_DLLEXPORT static void write_chrome_trace(const std::string &path);
+
+  private:
+    DISKANN_DLLEXPORT static std::atomic<bool> _enabled;
+};
+} // namespace diskann
+
+#ifdef DISKANN_DISABLE_TRACING
+#define DISKANN_TRACE_ENABLED() false
+#else
+#define DISKANN_TRACE_ENABLED() diskann::SearchTrace::enabled()
+#endif
+
+// Records an event if tracing is on; the arguments are not evaluated otherwise
+#define DISKANN_TRACE(type, a, b)                                                                                     \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (DISKANN_TRACE_ENABLED())                                                                                   \
+            diskann::SearchTrace::record(diskann::TraceEventType::type, (uint64_t)(a), (uint64_t)(b));                 \
+    } while (0)
@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "memory_policy.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Read-only cache of node records stored exactly as they are laid out on disk:
+// each slot holds the sector(s) a node is read from, so a cached node is
+// decoded with the same offset_to_node() arithmetic as an SSD read and its
+// neighbor list is used in place. All records live in one arena, backed by
+// huge pages where the OS provides them, and nodes are located through a
+// linear-probing table keyed by node id.
+//
+// Thread-safety: build with reset()/insert() before searching; find() is safe
+// from any number of threads once building is done.
+class SectorCache
+{
+  public:
+    SectorCache() = default;
+    DISKANN_DLLEXPORT ~SectorCache();
+
+    // drops the current contents and makes room for num_records records of
+    // record_len bytes each and an index of up to num_keys node ids
+    DISKANN_DLLEXPORT void reset(uint64_t num_records, uint64_t record_len, uint64_t num_keys);
+
+    char *record(uint64_t slot)
+    {
+        return _arena + slot * _record_len;
+    }
+
+    // maps node_id to the record in slot; several nodes may share a record
+    DISKANN_DLLEXPORT void insert(uint32_t node_id, uint32_t slot);
+
+    // returns the record holding node_id, or nullptr if it is not cached
+    inline char *find(uint32_t node_id) const
+    {
+        if (_num_keys == 0)
+            return nullptr;
+        uint64_t pos = hash(node_id) & _mask;
+        while (_table[pos].node_id != EMPTY_KEY)
+        {
+            if (_table[pos].node_id == node_id)
+                return _arena + (uint64_t)_table[pos].slot * _record_len;
+            pos = (pos + 1) & _mask;
+        }
+        return nullptr;
+    }
+
+    uint64_t size() const
+    {
+        return _num_keys;
+    }
+
+    uint64_t num_records() const
+    {
+        return _num_records;
+    }
+
+    uint64_t record_len() const
+    {
+        return _record_len;
+    }
+
+    // the slot of a record returned by find()
+    uint32_t slot_of(const char *record) const
+    {
+        return (uint32_t)((record - _arena) / _record_len);
+    }
+
+    // bytes of the records and the index
+    uint64_t memory_size() const
+    {
+        return _buffer.len + _table.capacity() * sizeof(Entry);
+    }
+
+  private:
+    static const uint32_t EMPTY_KEY = 0xffffffff;
+
+    struct Entry
+    {
+        uint32_t node_id;
+        uint32_t slot;
+    };
+
+    static inline uint64_t hash(uint32_t node_id)
+    {
+        return (uint64_t)node_id * 0x9E3779B97F4A7C15ULL >> 17;
+    }
+
+    void free_arena();
+
+    char *_arena = nullptr;
+    LargeBuffer _buffer;
+    uint64_t _record_len = 0;
+    uint64_t _num_records = 0;
+    uint64_t _num_keys = 0;
+    uint64_t _mask = 0;
+    std::vector<Entry> _table;
+};
+} // namespace diskann
@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Threads that run the searches of the shards of a query concurrently
+class ShardPool
+{
+  public:
+    DISKANN_DLLEXPORT ShardPool(unsigned num_threads);
+    // Waits for the running tasks; queued ones are dropped
+    DISKANN_DLLEXPORT ~ShardPool();
+
+    DISKANN_DLLEXPORT void submit(std::function<void()> task);
+
+  private:
+    void run();
+
+    std::mutex _lock;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _tasks;
+    bool _stopping = false;
+    std::vector<std::thread> _threads;
+};
+} // namespace diskann
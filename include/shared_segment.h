@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// A read-only buffer in a named POSIX shared memory segment, filled once by
+// the first process that opens it and mapped by the others, so that processes
+// serving the same index hold one copy of it. The segment outlives the
+// processes until remove(). Not supported on Windows.
+class SharedSegment
+{
+  public:
+    // Maps segment name (without the leading '/' of shm_open()) of size
+    // bytes. If no process has filled it yet, calls fill with the zeroed
+    // buffer; other processes opening the segment meanwhile wait for it. If
+    // a process dies while filling, the next one to open the segment fills
+    // it again. Throws if the segment holds a buffer of another size, which
+    // is left from another index or version of it.
+    DISKANN_DLLEXPORT SharedSegment(const std::string &name, size_t size, const std::function<void(char *)> &fill);
+    DISKANN_DLLEXPORT ~SharedSegment();
+    SharedSegment(const SharedSegment &) = delete;
+    SharedSegment &operator=(const SharedSegment &) = delete;
+
+    char *data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    // whether this process filled the segment
+    bool filled_here() const
+    {
+        return _filled_here;
+    }
+
+    // Removes segment name, if it exists; processes mapping it keep their
+    // mapping until they unmap it
+    DISKANN_DLLEXPORT static void remove(const std::string &name);
+
+  private:
+    void *_mapping = nullptr;
+    size_t _mapping_len = 0;
+    char *_data = nullptr;
+    size_t _size = 0;
+    bool _filled_here = false;
+};
+} // namespace diskann
@@ -1,6 +1,20 @@
 #pragma once
 
-#ifdef _WINDOWS
+// AArch64 builds (Graviton, Ampere) use the NEON kernels, which every AArch64
+// CPU has, in place of the AVX ones; _mm_prefetch maps to the compiler's
+// prefetch so the prefetching code is shared.
+#if defined(__aarch64__)
+#define USE_NEON
+#include <arm_neon.h>
+
+#ifndef _MM_HINT_T0
+#define _MM_HINT_NTA 0
+#define _MM_HINT_T2 1
+#define _MM_HINT_T1 2
+#define _MM_HINT_T0 3
+#endif
+#define _mm_prefetch(p, hint) __builtin_prefetch((const void *)(p), 0, (hint))
+#elif defined(_WINDOWS)
 #include <immintrin.h>
 #include <smmintrin.h>
 #include <tmmintrin.h>
@@ -9,6 +23,7 @@
 #include <immintrin.h>
 #endif
 
+#ifndef USE_NEON
 namespace diskann
 {
 static inline __m256 _mm256_mul_epi8(__m256i X)
@@ -104,3 +119,4 @@ static inline float _mm256_reduce_add_ps(__m256 x)
     return _mm_cvtss_f32(x32);
 }
 } // namespace diskann
+#endif
@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#if !defined(_WINDOWS) && defined(USE_SPDK)
+
+#include <string>
+#include <vector>
+
+#include "aligned_file_reader.h"
+
+struct spdk_nvme_ctrlr;
+struct spdk_nvme_ns;
+
+// AlignedFileReader that reads a disk index straight off an NVMe namespace
+// with SPDK, bypassing the kernel: each context owns an I/O queue pair of the
+// controller and polls it for completions, so a 4 KB read costs no system
+// call or interrupt. For dedicated hosts whose drive is bound to SPDK
+// (vfio-pci or uio); the drive can hold nothing else the kernel uses.
+//
+// The index is copied to the raw namespace beforehand (e.g. with dd before
+// binding the drive), and open(<index>) reads where from <index>.spdk, a text
+// file of three lines: the SPDK transport id of the controller (such as
+// "trtype:PCIe traddr:0000:81:00.0"), the namespace id and the byte offset of
+// the index on the namespace, a multiple of its block size. <index> itself is
+// only read for its first sector by PQFlashIndex::load().
+//
+// SPDK needs DMA-able memory, so reads land in a bounce buffer of each queue
+// pair and are copied out; the copy of a 4 KB sector is far cheaper than the
+// kernel path it replaces. A context has one read() or submit_reads() in
+// flight at a time, which pipelined search reaps in full before the next.
+class SpdkAlignedFileReader : public AlignedFileReader
+{
+  private:
+    struct QueuePair;
+
+    spdk_nvme_ctrlr *_ctrlr = nullptr;
+    spdk_nvme_ns *_ns = nullptr;
+    uint64_t _base_offset = 0;
+    uint32_t _block_size = 0;
+    uint64_t _slot_bytes = 0; // bounce buffer per outstanding command
+    io_context_t bad_ctx = (io_context_t)-1;
+
+    static QueuePair *to_qpair(IOContext &ctx);
+    QueuePair *new_qpair();
+    void destroy_qpair(IOContext ctx);
+    // queues the pieces of read_reqs on qp, polling for completions whenever
+    // its queue or bounce buffer is full
+    void submit(std::vector<AlignedRead> &read_reqs, QueuePair *qp);
+    // processes the completions ready on qp, throwing on a failed read
+    static void poll(QueuePair *qp);
+
+  public:
+    SpdkAlignedFileReader() = default;
+    ~SpdkAlignedFileReader();
+
+    IOContext &get_ctx();
+    IOContext create_ctx();
+
+    // register thread-id for a context
+    void register_thread();
+
+    // de-register thread-id for a context
+    void deregister_thread();
+    void deregister_all_threads();
+    // throws: the queue pairs and DMA memory of SPDK are not usable in a
+    // forked process, which must load the index itself
+    void reset_after_fork();
+
+    // Open & close ops
+    // Blocking calls
+    void open(const std::string &fname);
+    void close();
+
+    // process batch of aligned requests in parallel
+    // NOTE :: blocking call
+    void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false);
+
+    // pipelined search support; see AlignedFileReader
+    bool supports_async_reads()
+    {
+        return true;
+    }
+    void submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx);
+    void reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                    std::vector<uint64_t> &completed);
+};
+
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "distance.h"
+#include "abstract_data_store.h"
+
+namespace diskann
+{
+// Stores each vector as one 8-bit or 4-bit code per dimension, scaled between
+// the per-dimension minimum and maximum of the data it was populated with.
+// Distances are asymmetric: the query stays in float and is compared with the
+// decoded codes. Like PQDataStore, it is used for graph traversal alongside
+// the full-precision InMemDataStore, which still prunes the graph.
+template <typename data_t> class SQDataStore : public AbstractDataStore<data_t>
+{
+  public:
+    // num_bits is 8 or 4
+    SQDataStore(size_t dim, location_t num_points, uint32_t num_bits, std::unique_ptr<Distance<data_t>> distance_fn);
+    SQDataStore(const SQDataStore &) = delete;
+    SQDataStore &operator=(const SQDataStore &) = delete;
+    ~SQDataStore();
+
+    // Loads the codes from filename and the per-dimension ranges from
+    // get_params_filename(filename).
+    virtual location_t load(const std::string &filename) override;
+    virtual size_t save(const std::string &filename, const location_t num_points) override;
+
+    // Quantized data has no alignment requirement, so this is the dimension.
+    virtual size_t get_aligned_dim() const override;
+    virtual size_t memory_size() const override;
+
+    // Learn the per-dimension ranges from the vectors, then encode them
+    virtual void populate_data(const data_t *vectors, const location_t num_pts) override;
+    virtual void populate_data(const std::string &filename, const size_t offset) override;
+
+    virtual void extract_data_to_bin(const std::string &filename, const location_t num_pts) override;
+
+    // get_vector decodes; set_vector encodes with the ranges learned by
+    // populate_data, clamping values outside them
+    virtual void get_vector(const location_t i, data_t *target) const override;
+    virtual void set_vector(const location_t i, const data_t *const vector) override;
+    virtual void prefetch_vector(const location_t loc) override;
+
+    virtual void move_vectors(const location_t old_location_start, const location_t new_location_start,
+                              const location_t num_points) override;
+    virtual void copy_vectors(const location_t from_loc, const location_t to_loc, const location_t num_points) override;
+
+    // Writes the float query the batched get_distance() overloads compare
+    // against into the PQScratch of scratch.
+    virtual void preprocess_query(const data_t *query, AbstractScratch<data_t> *scratch) const override;
+
+    virtual float get_distance(const data_t *query, const location_t loc) const override;
+    virtual float get_distance(const location_t loc1, const location_t loc2) const override;
+
+    // NOTE: Caller must invoke preprocess_query ONCE before calling this
+    // function.
+    virtual void get_distance(const data_t *preprocessed_query, const location_t *locations,
+                              const uint32_t location_count, float *distances,
+                              AbstractScratch<data_t> *scratch_space) const override;
+    virtual void get_distance(const data_t *preprocessed_query, const std::vector<location_t> &ids,
+                              std::vector<float> &distances, AbstractScratch<data_t> *scratch_space) const override;
+
+    // The full precision distance function, as for PQDataStore.
+    virtual Distance<data_t> *get_dist_fn() const override;
+
+    virtual location_t calculate_medoid() const override;
+
+    virtual size_t get_alignment_factor() const override;
+
+    static std::string get_params_filename(const std::string &filename)
+    {
+        return filename + "_params.bin";
+    }
+
+  protected:
+    virtual location_t expand(const location_t new_size) override;
+    virtual location_t shrink(const location_t new_size) override;
+
+    virtual location_t load_impl(const std::string &filename);
+
+  private:
+    void encode(const data_t *vector, uint8_t *code) const;
+    void decode(const uint8_t *code, float *vector) const;
+    void reallocate_codes(const location_t new_size);
+    // widens _min and max to the values of vectors
+    void update_range(const data_t *vectors, const location_t num_pts, std::vector<float> &max);
+    // the codes span [_min, max] in each dimension
+    void set_scale(std::vector<float> &max, const location_t num_pts);
+
+    uint8_t *_codes = nullptr;
+    uint32_t _num_bits;
+    // bytes per vector
+    size_t _code_len;
+
+    // a dimension decodes as _min[d] + code * _scale[d]
+    std::vector<float> _min;
+    std::vector<float> _scale;
+
+    Metric _distance_metric;
+    std::unique_ptr<Distance<data_t>> _distance_fn;
+    // query (shifted by _min for L2) to codes, chosen for _num_bits, the
+    // metric and the CPU
+    float (*_code_distance)(const float *query, const uint8_t *code, const float *min, const float *scale,
+                            size_t dim) = nullptr;
+};
+} // namespace diskann
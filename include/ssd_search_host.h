@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "aligned_file_reader.h"
+#include "memory_usage.h"
+#include "scratch.h"
+#include "scratch_pool.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// Search scratch and I/O contexts shared by the disk indices hosted in one
+// process, in place of the pool each PQFlashIndex sets up for its own
+// searches (see PQFlashIndex::set_search_host()). A host of many small
+// indices then holds num_threads scratch, about a megabyte each, and
+// num_threads AIO contexts in all instead of that many per index, and runs at
+// most num_threads searches at once over all of them.
+//
+// The scratch fits indices of up to max_dim dimensions, and its PQ tables
+// grow to those of the largest index attached. The contexts come from
+// io_setup() and so read any file; indices whose reader binds its contexts to
+// its file keep a pool of their own (see
+// AlignedFileReader::has_file_independent_ctx()). Not supported on Windows.
+template <typename T> class SSDSearchHost
+{
+  public:
+    // num_threads is at least 2, as cache_bfs_levels() holds one scratch
+    // while it reads nodes with another
+    DISKANN_DLLEXPORT SSDSearchHost(uint32_t num_threads, size_t max_dim);
+    DISKANN_DLLEXPORT ~SSDSearchHost();
+    SSDSearchHost(const SSDSearchHost &) = delete;
+    SSDSearchHost &operator=(const SSDSearchHost &) = delete;
+
+    // Grows the scratch for an index: PQ tables of pq_table_entries floats
+    // and, with vectors_ctx, a second context for the reader of its reorder
+    // data. Waits for the searches in progress. Throws if aligned_dim is
+    // above what the scratch fits.
+    DISKANN_DLLEXPORT void reserve(size_t aligned_dim, size_t pq_table_entries, bool vectors_ctx);
+
+    // Gives the scratch new contexts in a child process forked after the
+    // host was set up, in place of the parent's (see
+    // PQFlashIndex::reset_after_fork()). Throws if a search was running at
+    // fork().
+    DISKANN_DLLEXPORT void reset_after_fork();
+
+    ScratchPool<SSDThreadData<T>> &thread_data()
+    {
+        return _thread_data;
+    }
+
+    uint32_t get_num_threads() const
+    {
+        return _num_threads;
+    }
+
+    // the bytes of the shared scratch; waits for the searches in progress
+    DISKANN_DLLEXPORT MemoryUsage get_memory_usage();
+
+  private:
+    uint32_t _num_threads;
+    size_t _max_aligned_dim;
+    bool _has_vectors_ctx = false;
+    // serializes reserve()
+    std::mutex _reserve_lock;
+    // only creates the contexts, and releases them on destruction
+    std::unique_ptr<AlignedFileReader> _ctx_reader;
+    ScratchPool<SSDThreadData<T>> _thread_data;
+};
+} // namespace diskann
@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#ifndef _WINDOWS
+
+#include <string>
+#include <vector>
+
+#include "defaults.h"
+#include "linux_aligned_file_reader.h"
+
+// AlignedFileReader over a disk index striped across several files, normally
+// one per NVMe drive, RAID-0 style: stripe unit u of the index (stripe_sectors
+// sectors from offset u * stripe_sectors * SECTOR_LEN) is in file
+// u % num_files. Each read is split at unit boundaries and the pieces are
+// sent to the files that hold them in one submission, so the reads of a beam
+// keep the queues of all drives busy.
+//
+// The stripes of <index> are listed in <index>.stripes, written with the
+// stripes by stripe_file(). open(<index>) reads that list; <index> itself is
+// only read for its first sector by PQFlashIndex::load().
+class StripedAlignedFileReader : public LinuxAlignedFileReader
+{
+  public:
+    StripedAlignedFileReader() = default;
+    ~StripedAlignedFileReader();
+
+    // Splits index_file into one stripe per entry of stripe_paths, in units
+    // of stripe_sectors sectors, and writes index_file + ".stripes". With
+    // truncate_original, index_file is cut down to its first sector.
+    static void stripe_file(const std::string &index_file, const std::vector<std::string> &stripe_paths,
+                            uint64_t stripe_sectors = diskann::defaults::STRIPE_SECTORS,
+                            bool truncate_original = false);
+
+    // whether index_file has been striped by stripe_file()
+    static bool is_striped(const std::string &index_file);
+
+    void open(const std::string &fname);
+    void close();
+
+    void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async = false);
+
+    // pipelined search support; see AlignedFileReader. A request completes
+    // once all of its pieces have.
+    bool supports_async_reads()
+    {
+        return true;
+    }
+    void submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx);
+    void reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                    std::vector<uint64_t> &completed);
+
+  private:
+    // a part of a request that lies in a single stripe unit
+    struct Piece
+    {
+        int fd;
+        uint64_t offset; // in the stripe file
+        uint64_t len;
+        char *buf;
+        uint64_t request; // index of the request it is part of
+    };
+
+    // appends the pieces of read_reqs to pieces
+    void split(std::vector<AlignedRead> &read_reqs, std::vector<Piece> &pieces) const;
+
+    std::vector<int> _fds;
+    uint64_t _stripe_bytes = 0;
+};
+
+#endif
@@ -26,6 +26,12 @@ class Timer
         return std::chrono::duration_cast<std::chrono::microseconds>(_clock::now() - check_point).count();
     }
 
+    // elapsed() with the fraction of a microsecond, for timing short steps
+    float elapsed_us_fractional() const
+    {
+        return std::chrono::duration<float, std::micro>(_clock::now() - check_point).count();
+    }
+
     float elapsed_seconds() const
     {
         return (float)elapsed() / 1000000.0f;
@@ -21,9 +21,12 @@ typedef int FileHandle;
 #endif
 
 #include "distance.h"
+#include "simd_utils.h"
 #include "logger.h"
 #include "cached_io.h"
+#include "parallel_io.h"
 #include "ann_exception.h"
+#include "defaults.h"
 #include "windows_customizations.h"
 #include "tsl/robin_set.h"
 #include "types.h"
@@ -97,6 +100,8 @@ inline bool file_exists_impl(const std::string &name, bool dirCheck = false)
 
 inline bool file_exists(const std::string &name, bool dirCheck = false)
 {
+    if (!dirCheck && diskann::MemoryBinFile::find(name) != nullptr)
+        return true;
 #ifdef EXEC_ENV_OLS
     bool exists = file_exists_impl(name, dirCheck);
     if (exists)
@@ -142,6 +147,8 @@ inline void open_file_to_write(std::ofstream &writer, const std::string &filenam
 
 inline size_t get_file_size(const std::string &fname)
 {
+    if (const diskann::MemoryBinFile *memory_file = diskann::MemoryBinFile::find(fname))
+        return memory_file->size();
     std::ifstream reader(fname, std::ios::binary | std::ios::ate);
     if (!reader.fail() && reader.is_open())
     {
@@ -358,28 +365,119 @@ inline void get_bin_metadata(MemoryMappedFiles &files, const std::string &bin_fi
 
 inline void get_bin_metadata(const std::string &bin_file, size_t &nrows, size_t &ncols, size_t offset = 0)
 {
+    if (const MemoryBinFile *memory_file = MemoryBinFile::find(bin_file))
+    {
+        int32_t metadata[2];
+        memory_file->read((char *)metadata, offset, sizeof(metadata));
+        nrows = metadata[0];
+        ncols = metadata[1];
+        return;
+    }
+    if (CompressedFile::is_compressed(bin_file))
+    {
+        int32_t metadata[2];
+        CompressedFile(bin_file).read((char *)metadata, offset, sizeof(metadata), 1);
+        nrows = metadata[0];
+        ncols = metadata[1];
+        return;
+    }
     std::ifstream reader(bin_file.c_str(), std::ios::binary);
     get_bin_metadata_impl(reader, nrows, ncols, offset);
 }
 // get_bin_metadata functions END
 
 #ifndef EXEC_ENV_OLS
-inline size_t get_graph_num_frozen_points(const std::string &graph_file)
+// The header of a graph file written by InMemGraphStore::save_graph()
+struct GraphFileHeader
 {
     size_t expected_file_size;
-    uint32_t max_observed_degree, start;
-    size_t file_frozen_pts;
+    uint32_t max_observed_degree;
+    uint32_t start;
+    size_t num_frozen_points;
+};
+
+// reads the header of graph_file, which may be a CompressedFile
+inline GraphFileHeader read_graph_header(const std::string &graph_file)
+{
+    GraphFileHeader header;
+    read_file_parallel(graph_file, (char *)&header, 0, sizeof(header), 1);
+    return header;
+}
+
+inline size_t get_graph_num_frozen_points(const std::string &graph_file)
+{
+    return read_graph_header(graph_file).num_frozen_points;
+}
+
+// Decodes the adjacency lists of a graph file written by
+// InMemGraphStore::save_graph(). The file is read GRAPH_LOAD_WINDOW_SIZE bytes
+// at a time with read_file_parallel(), the records in a window are located
+// with one pass over their degrees, and visit(node, degree, neighbours) is
+// then called for all of them from parallel threads. Returns the number of
+// nodes; sets num_edges and max_degree from the lists read.
+template <typename Visitor>
+inline uint32_t load_graph_adjacency_parallel(const std::string &graph_file, const size_t header_size,
+                                              const size_t expected_file_size, Visitor visit, size_t &num_edges,
+                                              uint32_t &max_degree)
+{
+    std::vector<char> window(std::min((size_t)diskann::defaults::GRAPH_LOAD_WINDOW_SIZE, expected_file_size - header_size));
+    std::vector<size_t> record_offsets;
+    size_t file_pos = header_size;
+    uint32_t nodes_read = 0;
+    num_edges = 0;
+    max_degree = 0;
+
+    while (file_pos < expected_file_size)
+    {
+        const size_t window_len = std::min(window.size(), expected_file_size - file_pos);
+        read_file_parallel(graph_file, window.data(), file_pos, window_len);
+
+        record_offsets.clear();
+        size_t pos = 0;
+        uint32_t k = 0;
+        while (pos + sizeof(uint32_t) <= window_len)
+        {
+            std::memcpy(&k, window.data() + pos, sizeof(uint32_t));
+            if (pos + sizeof(uint32_t) * ((size_t)k + 1) > window_len)
+                break;
+            if (k == 0)
+            {
+                diskann::cerr << "ERROR: Point found with no out-neighbours, point#" << nodes_read + record_offsets.size()
+                              << std::endl;
+            }
+            num_edges += k;
+            max_degree = std::max(max_degree, k);
+            record_offsets.push_back(pos);
+            pos += sizeof(uint32_t) * ((size_t)k + 1);
+        }
 
-    std::ifstream in;
-    in.exceptions(std::ios::badbit | std::ios::failbit);
+        if (record_offsets.empty())
+        {
+            // a single record larger than the window, or a truncated file
+            if (file_pos + window_len == expected_file_size)
+            {
+                throw ANNException("ERROR: graph file " + graph_file + " is truncated", -1, __FUNCSIG__, __FILE__,
+                                   __LINE__);
+            }
+            window.resize(sizeof(uint32_t) * ((size_t)k + 1));
+            continue;
+        }
 
-    in.open(graph_file, std::ios::binary);
-    in.read((char *)&expected_file_size, sizeof(size_t));
-    in.read((char *)&max_observed_degree, sizeof(uint32_t));
-    in.read((char *)&start, sizeof(uint32_t));
-    in.read((char *)&file_frozen_pts, sizeof(size_t));
+        const uint32_t first_node = nodes_read;
+        const char *window_data = window.data();
+#pragma omp parallel for schedule(static, 65536)
+        for (int64_t j = 0; j < (int64_t)record_offsets.size(); j++)
+        {
+            const uint32_t *record = (const uint32_t *)(window_data + record_offsets[j]);
+            visit(first_node + (uint32_t)j, record[0], record + 1);
+        }
 
-    return file_frozen_pts;
+        nodes_read += (uint32_t)record_offsets.size();
+        file_pos += pos;
+        if (nodes_read / 10000000 != (nodes_read - record_offsets.size()) / 10000000)
+            diskann::cout << "." << std::flush;
+    }
+    return nodes_read;
 }
 #endif
 
@@ -461,9 +559,16 @@ inline void load_bin(const std::string &bin_file, T *&data, size_t &npts, size_t
     try
     {
         diskann::cout << "Opening bin file " << bin_file.c_str() << "... " << std::endl;
-        reader.open(bin_file, std::ios::binary | std::ios::ate);
-        reader.seekg(0);
-        load_bin_impl<T>(reader, data, npts, dim, offset);
+        if (MemoryBinFile::find(bin_file) == nullptr)
+        {
+            reader.open(bin_file, std::ios::binary | std::ios::ate);
+            reader.close();
+        }
+        get_bin_metadata(bin_file, npts, dim, offset);
+        std::cout << "Metadata: #pts = " << npts << ", #dims = " << dim << "..." << std::endl;
+
+        data = new T[npts * dim];
+        read_file_parallel(bin_file, (char *)data, offset + 2 * sizeof(uint32_t), npts * dim * sizeof(T));
     }
     catch (std::system_error &e)
     {
@@ -729,9 +834,9 @@ inline size_t save_bin(const std::string &filename, T *data, size_t npts, size_t
     writer.write((char *)&ndims_i32, sizeof(int));
     diskann::cout << "bin: #pts = " << npts << ", #dims = " << ndims << ", size = " << bytes_written << "B"
                   << std::endl;
-
-    writer.write((char *)data, npts * ndims * sizeof(T));
     writer.close();
+
+    write_file_parallel(filename, (const char *)data, offset + 2 * sizeof(uint32_t), npts * ndims * sizeof(T));
     diskann::cout << "Finished writing bin." << std::endl;
     return bytes_written;
 }
@@ -805,27 +910,6 @@ inline void load_aligned_bin(MemoryMappedFiles &files, const std::string &bin_fi
 }
 #endif
 
-template <typename T>
-inline void load_aligned_bin(const std::string &bin_file, T *&data, size_t &npts, size_t &dim, size_t &rounded_dim)
-{
-    std::ifstream reader;
-    reader.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-    try
-    {
-        diskann::cout << "Reading (with alignment) bin file " << bin_file << " ..." << std::flush;
-        reader.open(bin_file, std::ios::binary | std::ios::ate);
-
-        uint64_t fsize = reader.tellg();
-        reader.seekg(0);
-        load_aligned_bin_impl(reader, fsize, data, npts, dim, rounded_dim);
-    }
-    catch (std::system_error &e)
-    {
-        throw FileException(bin_file, e, __FUNCSIG__, __FILE__, __LINE__);
-    }
-}
-
 template <typename InType, typename OutType>
 void convert_types(const InType *srcmat, OutType *destmat, size_t npts, size_t dim)
 {
@@ -850,14 +934,14 @@ void convert_types(const InType *srcmat, OutType *destmat, size_t npts, size_t d
 template <typename T> float prepare_base_for_inner_products(const std::string in_file, const std::string out_file)
 {
     std::cout << "Pre-processing base file by adding extra coordinate" << std::endl;
-    std::ifstream in_reader(in_file.c_str(), std::ios::binary);
+    auto in_reader = std::make_unique<cached_ifstream>(in_file, 64 * 1024 * 1024);
     std::ofstream out_writer(out_file.c_str(), std::ios::binary);
     uint64_t npts, in_dims, out_dims;
     float max_norm = 0;
 
     uint32_t npts32, dims32;
-    in_reader.read((char *)&npts32, sizeof(uint32_t));
-    in_reader.read((char *)&dims32, sizeof(uint32_t));
+    in_reader->read((char *)&npts32, sizeof(uint32_t));
+    in_reader->read((char *)&dims32, sizeof(uint32_t));
 
     npts = npts32;
     in_dims = dims32;
@@ -882,7 +966,7 @@ template <typename T> float prepare_base_for_inner_products(const std::string in
         uint64_t start_id = b * block_size;
         uint64_t end_id = (b + 1) * block_size < npts ? (b + 1) * block_size : npts;
         uint64_t block_pts = end_id - start_id;
-        in_reader.read((char *)in_block_data.get(), block_pts * in_dims * sizeof(T));
+        in_reader->read((char *)in_block_data.get(), block_pts * in_dims * sizeof(T));
         for (uint64_t p = 0; p < block_pts; p++)
         {
             for (uint64_t j = 0; j < in_dims; j++)
@@ -895,13 +979,16 @@ template <typename T> float prepare_base_for_inner_products(const std::string in
 
     max_norm = std::sqrt(max_norm);
 
-    in_reader.seekg(2 * sizeof(uint32_t), std::ios::beg);
+    // a second pass over the points, past the header
+    in_reader = std::make_unique<cached_ifstream>(in_file, 64 * 1024 * 1024);
+    in_reader->read((char *)&npts32, sizeof(uint32_t));
+    in_reader->read((char *)&dims32, sizeof(uint32_t));
     for (uint64_t b = 0; b < num_blocks; b++)
     {
         uint64_t start_id = b * block_size;
         uint64_t end_id = (b + 1) * block_size < npts ? (b + 1) * block_size : npts;
         uint64_t block_pts = end_id - start_id;
-        in_reader.read((char *)in_block_data.get(), block_pts * in_dims * sizeof(T));
+        in_reader->read((char *)in_block_data.get(), block_pts * in_dims * sizeof(T));
         for (uint64_t p = 0; p < block_pts; p++)
         {
             for (uint64_t j = 0; j < in_dims; j++)
@@ -969,21 +1056,94 @@ inline void copy_aligned_data_from_file(const char *bin_file, T *&data, size_t &
         throw diskann::ANNException("Null pointer passed to copy_aligned_data_from_file function", -1, __FUNCSIG__,
                                     __FILE__, __LINE__);
     }
+    if (MemoryBinFile::find(bin_file) == nullptr)
+    {
+        std::ifstream reader;
+        reader.exceptions(std::ios::badbit | std::ios::failbit);
+        reader.open(bin_file, std::ios::binary);
+        reader.close();
+    }
+    get_bin_metadata(bin_file, npts, dim, offset);
+
+    const size_t data_offset = offset + 2 * sizeof(int);
+    if (rounded_dim == dim)
+    {
+        read_file_parallel(bin_file, (char *)data, data_offset, npts * dim * sizeof(T));
+        return;
+    }
+
+    // read blocks of rows in parallel and spread them to the padded layout
+    const size_t row_bytes = dim * sizeof(T);
+    const size_t rows_per_block = std::max((size_t)1, (size_t)diskann::defaults::PARALLEL_READ_CHUNK_SIZE / row_bytes);
+    const int64_t num_blocks = (int64_t)DIV_ROUND_UP(npts, rows_per_block);
+    std::exception_ptr error = nullptr;
+#pragma omp parallel
+    {
+        std::vector<char> block;
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t b = 0; b < num_blocks; b++)
+        {
+            try
+            {
+                const size_t first_row = (size_t)b * rows_per_block;
+                const size_t num_rows = std::min(rows_per_block, npts - first_row);
+                block.resize(num_rows * row_bytes);
+                read_file_parallel(bin_file, block.data(), data_offset + first_row * row_bytes, block.size(), 1);
+                for (size_t i = 0; i < num_rows; i++)
+                {
+                    T *row = data + (first_row + i) * rounded_dim;
+                    memcpy(row, block.data() + i * row_bytes, row_bytes);
+                    memset(row + dim, 0, (rounded_dim - dim) * sizeof(T));
+                }
+            }
+            catch (...)
+            {
+#pragma omp critical
+                if (error == nullptr)
+                    error = std::current_exception();
+            }
+        }
+    }
+    if (error != nullptr)
+        std::rethrow_exception(error);
+}
+
+template <typename T>
+inline void load_aligned_bin(const std::string &bin_file, T *&data, size_t &npts, size_t &dim, size_t &rounded_dim)
+{
+    const MemoryBinFile *memory_file = MemoryBinFile::find(bin_file);
+    if (memory_file != nullptr || CompressedFile::is_compressed(bin_file))
+    {
+        diskann::cout << "Reading (with alignment) " << (memory_file != nullptr ? "memory" : "compressed")
+                      << " bin file " << bin_file << " ..." << std::flush;
+        const size_t actual_file_size =
+            memory_file != nullptr ? memory_file->size() : CompressedFile(bin_file).size();
+        get_bin_metadata(bin_file, npts, dim);
+        if (actual_file_size != npts * dim * sizeof(T) + 2 * sizeof(uint32_t))
+            throw diskann::ANNException("Error. File size mismatch in " + bin_file, -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        rounded_dim = ROUND_UP(dim, 8);
+        alloc_aligned(((void **)&data), npts * rounded_dim * sizeof(T), 8 * sizeof(T));
+        copy_aligned_data_from_file(bin_file.c_str(), data, npts, dim, rounded_dim);
+        diskann::cout << " done." << std::endl;
+        return;
+    }
+
     std::ifstream reader;
-    reader.exceptions(std::ios::badbit | std::ios::failbit);
-    reader.open(bin_file, std::ios::binary);
-    reader.seekg(offset, reader.beg);
+    reader.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
-    int npts_i32, dim_i32;
-    reader.read((char *)&npts_i32, sizeof(int));
-    reader.read((char *)&dim_i32, sizeof(int));
-    npts = (unsigned)npts_i32;
-    dim = (unsigned)dim_i32;
+    try
+    {
+        diskann::cout << "Reading (with alignment) bin file " << bin_file << " ..." << std::flush;
+        reader.open(bin_file, std::ios::binary | std::ios::ate);
 
-    for (size_t i = 0; i < npts; i++)
+        uint64_t fsize = reader.tellg();
+        reader.seekg(0);
+        load_aligned_bin_impl(reader, fsize, data, npts, dim, rounded_dim);
+    }
+    catch (std::system_error &e)
     {
-        reader.read((char *)(data + i * rounded_dim), dim * sizeof(T));
-        memset(data + i * rounded_dim + dim, 0, (rounded_dim - dim) * sizeof(T));
+        throw FileException(bin_file, e, __FUNCSIG__, __FILE__, __LINE__);
     }
 }
 
@@ -1004,7 +1164,7 @@ inline void prefetch_vector_l2(const char *vec, size_t vecsize)
 }
 
 // NOTE: Implementation in utils.cpp.
-void block_convert(std::ofstream &writr, std::ifstream &readr, float *read_buf, uint64_t npts, uint64_t ndims);
+void block_convert(std::ofstream &writr, cached_ifstream &readr, float *read_buf, uint64_t npts, uint64_t ndims);
 
 DISKANN_DLLEXPORT void normalize_data_file(const std::string &inFileName, const std::string &outFileName);
 
@@ -1162,6 +1322,14 @@ template <> inline const char *diskann_type_to_name<int8_t>()
 {
     return "int8";
 }
+template <> inline const char *diskann_type_to_name<diskann::float16>()
+{
+    return "fp16";
+}
+template <> inline const char *diskann_type_to_name<diskann::bfloat16>()
+{
+    return "bf16";
+}
 template <> inline const char *diskann_type_to_name<uint16_t>()
 {
     return "uint16";
@@ -1193,6 +1361,11 @@ template <> inline const char *diskann_type_to_name<int64_t>()
 
 extern bool AvxSupportedCPU;
 extern bool Avx2SupportedCPU;
+extern bool Avx512SupportedCPU;       // AVX-512 F, BW and VL
+extern bool Avx512VnniSupportedCPU;   // the above and AVX-512 VNNI
+extern bool Avx512Bf16SupportedCPU;   // AVX-512 F, BW, VL and BF16
+extern bool Avx512PopcntSupportedCPU; // AVX-512 F, BW and VPOPCNTDQ
+extern bool SveSupportedCPU;          // AArch64 SVE
 
 inline size_t getMemoryUsage()
 {
@@ -1251,3 +1424,8 @@ inline size_t getMemoryUsage()
 
 extern bool AvxSupportedCPU;
 extern bool Avx2SupportedCPU;
+extern bool Avx512SupportedCPU;       // AVX-512 F, BW and VL
+extern bool Avx512VnniSupportedCPU;   // the above and AVX-512 VNNI
+extern bool Avx512Bf16SupportedCPU;   // AVX-512 F, BW, VL and BF16
+extern bool Avx512PopcntSupportedCPU; // AVX-512 F, BW and VPOPCNTDQ
+extern bool SveSupportedCPU;          // AArch64 SVE
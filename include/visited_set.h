@@ -0,0 +1,162 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "defaults.h"
+
+namespace diskann
+{
+// The set of points a search has already seen, kept in the per-thread scratch
+// and cleared before every query.
+//
+// For graphs of up to defaults::VISITED_ARRAY_MAX_POINTS points it is an array
+// with one 16-bit stamp per point: a point is visited when its stamp equals
+// the current epoch, so insert() is a single store and clear() moves to the
+// next epoch. The array is only rewritten when the epoch wraps, once every
+// 65535 queries.
+//
+// Larger graphs use an open addressing table sized from the expected number
+// of inserts per query (about L * R), whose slots are stamped the same way.
+// It doubles if a query inserts more than half its capacity.
+class VisitedSet
+{
+  public:
+    // Prepares the set for ids below num_points and about expected_size
+    // inserts between clears. It only allocates when the set is too small, so
+    // it can be called before every query.
+    void reserve(uint64_t num_points, uint64_t expected_size)
+    {
+        if (num_points <= defaults::VISITED_ARRAY_MAX_POINTS)
+        {
+            if (!_table.empty())
+            {
+                std::vector<Slot>().swap(_table);
+                _epoch = 1;
+            }
+            if (_stamps.size() < std::max<uint64_t>(num_points, 1))
+                _stamps.resize(std::max<uint64_t>(num_points, 1), 0);
+        }
+        else
+        {
+            reserve_table(expected_size);
+        }
+    }
+
+    // Uses the hash table whatever the number of points, for sets that only
+    // live for one query and would not repay the per-point array
+    void reserve_table(uint64_t expected_size)
+    {
+        if (!_stamps.empty())
+        {
+            std::vector<uint16_t>().swap(_stamps);
+            _epoch = 1;
+        }
+        uint64_t capacity = 64;
+        while (capacity < 2 * expected_size)
+            capacity *= 2;
+        if (_table.size() < capacity)
+            resize_table(capacity);
+    }
+
+    // Adds id and returns true if it was not in the set
+    inline bool insert(uint64_t id)
+    {
+        if (!_stamps.empty())
+        {
+            assert(id < _stamps.size());
+            if (_stamps[id] == (uint16_t)_epoch)
+                return false;
+            _stamps[id] = (uint16_t)_epoch;
+            return true;
+        }
+
+        uint64_t pos = probe(id);
+        if (_table[pos].epoch == _epoch)
+            return false;
+        _table[pos].epoch = _epoch;
+        _table[pos].id = (uint32_t)id;
+        if (++_count * 2 > _table.size())
+            resize_table(2 * _table.size());
+        return true;
+    }
+
+    inline bool contains(uint64_t id) const
+    {
+        if (!_stamps.empty())
+        {
+            assert(id < _stamps.size());
+            return _stamps[id] == (uint16_t)_epoch;
+        }
+        return !_table.empty() && _table[probe(id)].epoch == _epoch;
+    }
+
+    // bytes allocated for the set
+    size_t memory_size() const
+    {
+        return _stamps.capacity() * sizeof(uint16_t) + _table.capacity() * sizeof(Slot);
+    }
+
+    inline void clear()
+    {
+        _count = 0;
+        _epoch++;
+        if (!_stamps.empty() && (uint16_t)_epoch == 0)
+        {
+            std::fill(_stamps.begin(), _stamps.end(), (uint16_t)0);
+            _epoch = 1;
+        }
+        else if (_epoch == 0)
+        {
+            std::fill(_table.begin(), _table.end(), Slot());
+            _epoch = 1;
+        }
+    }
+
+  private:
+    struct Slot
+    {
+        uint32_t epoch = 0;
+        uint32_t id = 0;
+    };
+
+    // The slot holding id in the current epoch, or the free slot its probe
+    // sequence ends at. The table is never more than half full.
+    inline uint64_t probe(uint64_t id) const
+    {
+        const uint64_t mask = _table.size() - 1;
+        uint64_t pos = (id * 0x9E3779B97F4A7C15ULL) >> _shift;
+        while (_table[pos].epoch == _epoch && _table[pos].id != (uint32_t)id)
+            pos = (pos + 1) & mask;
+        return pos;
+    }
+
+    // capacity is a power of two; live entries are carried over
+    void resize_table(uint64_t capacity)
+    {
+        std::vector<Slot> old_table(capacity);
+        old_table.swap(_table);
+        _shift = 64;
+        for (uint64_t c = capacity; c > 1; c /= 2)
+            _shift--;
+        for (const Slot &slot : old_table)
+            if (slot.epoch == _epoch)
+                _table[probe(slot.id)] = slot;
+    }
+
+    // one stamp per point in array mode, empty otherwise
+    std::vector<uint16_t> _stamps;
+    // power of two slots in table mode, empty otherwise
+    std::vector<Slot> _table;
+    // 64 - log2(_table.size()), so the top bits of the hash pick the slot
+    uint32_t _shift = 64;
+    // entries inserted this epoch in table mode
+    uint64_t _count = 0;
+    // never 0, which marks a free slot or an unvisited point
+    uint32_t _epoch = 1;
+};
+} // namespace diskann
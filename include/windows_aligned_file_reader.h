@@ -26,8 +26,8 @@ class WindowsAlignedFileReader : public AlignedFileReader
     std::string m_filename;
 #endif
 
-  protected:
-    // virtual IOContext createContext();
+    // opens a handle to the file with its own completion port
+    IOContext open_ctx();
 
   public:
     DISKANN_DLLEXPORT WindowsAlignedFileReader(){};
@@ -48,6 +48,7 @@ class WindowsAlignedFileReader : public AlignedFileReader
         // TODO: Needs implementation.
     }
     DISKANN_DLLEXPORT virtual IOContext &get_ctx() override;
+    DISKANN_DLLEXPORT virtual IOContext create_ctx() override;
 
     // process batch of aligned requests in parallel
     // NOTE :: blocking call for the calling thread, but can thread-safe
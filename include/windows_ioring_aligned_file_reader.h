@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+#if defined(_WINDOWS) && !defined(USE_BING_INFRA) && defined(USE_IORING)
+#include <Windows.h>
+#include <ioringapi.h>
+
+#include <mutex>
+#include <thread>
+#include "aligned_file_reader.h"
+#include "windows_customizations.h"
+
+// AlignedFileReader backed by the IoRing API of Windows 11 and Server 2022
+// and later. Each registered thread, and each context from create_ctx(), owns
+// one ring with the index file registered in it, and the owner's sector
+// scratch can be registered via register_buffer(). A batch of reads is queued
+// in the ring and submitted with a single kernel transition, where
+// WindowsAlignedFileReader issues a ReadFile() per read.
+//
+// open() throws if the running system has no IoRing, so callers can fall back
+// to WindowsAlignedFileReader. The IOContext handed out by get_ctx() and
+// create_ctx() only carries the ring, and must only be passed back to this
+// reader.
+class WindowsIoRingAlignedFileReader : public AlignedFileReader
+{
+  private:
+    struct RingContext;
+
+#ifdef UNICODE
+    std::wstring m_filename;
+#else
+    std::string m_filename;
+#endif
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    IORING_VERSION m_version = IORING_VERSION_INVALID;
+
+    static RingContext *to_ring(IOContext &ctx);
+    // a new ring with the file registered
+    IOContext new_ctx();
+    void destroy_ctx(IOContext &ctx);
+
+  public:
+    DISKANN_DLLEXPORT WindowsIoRingAlignedFileReader(){};
+    DISKANN_DLLEXPORT virtual ~WindowsIoRingAlignedFileReader();
+
+    // whether the running system supports the reads of this reader
+    DISKANN_DLLEXPORT static bool is_supported();
+
+    DISKANN_DLLEXPORT virtual void open(const std::string &fname) override;
+    DISKANN_DLLEXPORT virtual void close() override;
+
+    DISKANN_DLLEXPORT virtual void register_thread() override;
+    DISKANN_DLLEXPORT virtual void deregister_thread() override;
+    DISKANN_DLLEXPORT virtual void deregister_all_threads() override;
+    DISKANN_DLLEXPORT virtual IOContext &get_ctx() override;
+    DISKANN_DLLEXPORT virtual IOContext create_ctx() override;
+
+    // registers [buf, buf + len) with ctx's ring; reads that fall entirely
+    // inside it refer to it by index instead of having the kernel probe and
+    // lock its pages per read
+    DISKANN_DLLEXPORT virtual void register_buffer(IOContext &ctx, void *buf, size_t len) override;
+
+    // queues the reads, MAX_IO_DEPTH at a time, and waits for them
+    DISKANN_DLLEXPORT virtual void read(std::vector<AlignedRead> &read_reqs, IOContext &ctx,
+                                        bool async = false) override;
+};
+#endif
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "defaults.h"
+#include "windows_customizations.h"
+
+namespace diskann
+{
+// When the records of a write-ahead log reach storage
+enum class WalSync
+{
+    // written to the file every group_commit_us, and left to the OS to sync:
+    // survives the process crashing, but not the machine
+    None,
+    // synced every group_commit_us; at most that much is lost on power loss
+    Batched,
+    // synced before the operation that appended them returns. Operations that
+    // wait at the same time share a sync.
+    Commit
+};
+
+struct WriteAheadLogOptions
+{
+    WalSync sync = WalSync::Commit;
+    uint32_t group_commit_us = defaults::WAL_GROUP_COMMIT_US;
+};
+
+// An append-only file of operation records, written by a background thread in
+// groups. Each record is a type, a payload and a checksum of both; a torn
+// record at the end of the file, from a crash during a write, ends the log
+// and is cut off when the log is opened again.
+//
+// Thread-safety: append(), wait() and flush() may be called concurrently.
+// reset() must not run alongside append().
+class WriteAheadLog
+{
+  public:
+    // Opens the log at path for appending after the records already there,
+    // creating it if needed.
+    DISKANN_DLLEXPORT WriteAheadLog(const std::string &path, const WriteAheadLogOptions &options);
+    // writes out and syncs the records appended so far
+    DISKANN_DLLEXPORT ~WriteAheadLog();
+
+    // Queues a record and returns its sequence number, for wait().
+    DISKANN_DLLEXPORT uint64_t append(uint32_t type, const void *payload, uint32_t bytes);
+
+    // Returns once record seq is as durable as options.sync asks, at once
+    // unless that is WalSync::Commit.
+    DISKANN_DLLEXPORT void wait(uint64_t seq);
+
+    // writes out and syncs everything appended so far before returning
+    DISKANN_DLLEXPORT void flush();
+
+    // Drops every record, once a snapshot holds their effects.
+    DISKANN_DLLEXPORT void reset();
+
+    // Calls apply on each record of the log at path in order, and returns the
+    // number of records. A log that does not exist has none.
+    DISKANN_DLLEXPORT static uint64_t replay(const std::string &path,
+                                             const std::function<void(uint32_t, const char *, uint32_t)> &apply);
+
+    // syncs a file written with the usual streams to storage
+    DISKANN_DLLEXPORT static void sync_file(const std::string &path);
+
+  private:
+    void run();
+    // writes batch at the end of the file and syncs it if sync is set;
+    // returns an error message, or an empty one
+    std::string write_batch(const std::vector<char> &batch, bool sync);
+    // throws the error of a failed write; called with _lock held
+    void throw_if_failed();
+    // for the constructor, which leaves no file open when it throws
+    void close_and_throw(const std::string &message);
+
+    std::string _path;
+    WriteAheadLogOptions _options;
+    FILE *_file = nullptr;
+
+    std::mutex _lock; // guards the fields below
+    std::condition_variable _wake;      // wakes the writer
+    std::condition_variable _committed; // wakes threads waiting on records
+    std::vector<char> _pending;         // records not yet handed to the writer
+    uint64_t _appended = 0;             // sequence number of the last record appended
+    uint64_t _durable = 0;              // ... of the last one written, and synced if options.sync asks
+    uint64_t _synced = 0;               // ... of the last one synced
+    uint64_t _sync_requested = 0;       // ... of the last one flush() waits to be synced
+    bool _writing = false;              // the writer is writing a batch
+    bool _stopping = false;
+    std::string _error; // the first write that failed
+    std::thread _writer;
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+};
+} // namespace diskann
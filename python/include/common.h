@@ -9,6 +9,8 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 
+#include "memory_usage.h"
+
 namespace py = pybind11;
 
 namespace diskannpy
@@ -21,4 +23,13 @@ typedef uint32_t DynamicIdType;
 
 template <class IdType> using NeighborsAndDistances = std::pair<py::array_t<IdType>, py::array_t<float>>;
 
+// {component: bytes} of the memory usage of an index
+inline py::dict to_dict(const diskann::MemoryUsage &usage)
+{
+    py::dict components;
+    for (const auto &component : usage.components())
+        components[py::str(component.first)] = component.second;
+    return components;
+}
+
 }; // namespace diskannpy
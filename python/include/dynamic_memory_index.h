@@ -30,18 +30,20 @@ class DynamicMemoryIndex
 
     void load(const std::string &index_path);
     int insert(const py::array_t<DT, py::array::c_style | py::array::forcecast> &vector, DynamicIdType id);
-    py::array_t<int> batch_insert(py::array_t<DT, py::array::c_style | py::array::forcecast> &vectors,
-                                  py::array_t<DynamicIdType, py::array::c_style | py::array::forcecast> &ids, int32_t num_inserts,
+    py::array_t<int> batch_insert(py::array_t<DT, py::array::c_style> &vectors,
+                                  py::array_t<DynamicIdType, py::array::c_style> &ids, int32_t num_inserts,
                                   int num_threads = 0);
     int mark_deleted(DynamicIdType id);
     void save(const std::string &save_path, bool compact_before_save = false);
     NeighborsAndDistances<DynamicIdType> search(py::array_t<DT, py::array::c_style | py::array::forcecast> &query, uint64_t knn,
                                       uint64_t complexity);
-    NeighborsAndDistances<DynamicIdType> batch_search(py::array_t<DT, py::array::c_style | py::array::forcecast> &queries,
+    NeighborsAndDistances<DynamicIdType> batch_search(py::array_t<DT, py::array::c_style> &queries,
                                             uint64_t num_queries, uint64_t knn, uint64_t complexity,
                                             uint32_t num_threads);
     void consolidate_delete();
     size_t num_points();
+    // bytes held by the index, by component
+    py::dict memory_usage();
 
 
   private:
@@ -3,8 +3,13 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
@@ -35,6 +40,9 @@ template <typename DT> class StaticDiskIndex
     StaticDiskIndex(diskann::Metric metric, const std::string &index_path_prefix, uint32_t num_threads,
                     size_t num_nodes_to_cache, uint32_t cache_mechanism);
 
+    // Completes the queued asynchronous searches
+    ~StaticDiskIndex();
+
     void cache_bfs_levels(size_t num_nodes_to_cache);
 
     void cache_sample_paths(size_t num_nodes_to_cache, const std::string &warmup_query_file, uint32_t num_threads);
@@ -43,11 +51,55 @@ template <typename DT> class StaticDiskIndex
                                                uint64_t knn, uint64_t complexity, uint64_t beam_width);
 
     NeighborsAndDistances<StaticIdType> batch_search(
-        py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries, uint64_t knn,
+        py::array_t<DT, py::array::c_style> &queries, uint64_t num_queries, uint64_t knn,
         uint64_t complexity, uint64_t beam_width, uint32_t num_threads);
 
+    // Queues query for the asynchronous search workers and returns at once.
+    // The workers search the queries queued together with the same
+    // parameters as one batch, then call done(ids, distances, None), or
+    // done(None, None, error message) if the search failed, on their own
+    // thread with the GIL held.
+    void search_async(py::array_t<DT, py::array::c_style | py::array::forcecast> &query, uint64_t knn,
+                      uint64_t complexity, uint64_t beam_width, py::function done);
+
+    // Waits until the index is loaded, then stops the asynchronous search
+    // workers once they complete the queries queued, so that no thread of the
+    // index runs across fork(). The next search_async() starts them again.
+    void prepare_fork();
+
+    // Readies the index for searches in a child process, after
+    // prepare_fork() in the parent; see PQFlashIndex::reset_after_fork()
+    void after_fork_in_child();
+
+    // bytes held in memory by the index, by component
+    py::dict memory_usage();
+
+    // queries searched together by one worker at most
+    static constexpr size_t ASYNC_MAX_BATCH_SIZE = 32;
+
   private:
+    struct AsyncQuery
+    {
+        std::vector<DT> query;
+        uint64_t knn;
+        uint64_t complexity;
+        uint64_t beam_width;
+        py::function done;
+    };
+
+    void run_async_worker();
+    // joins the workers, which complete the queries queued first
+    void stop_async_workers();
+
     std::shared_ptr<AlignedFileReader> _reader;
     diskann::PQFlashIndex<DT> _index;
+    uint32_t _num_threads;
+
+    // the workers are started by the first search_async()
+    std::mutex _async_lock;
+    std::condition_variable _async_cv;
+    std::deque<AsyncQuery> _async_queue;
+    std::vector<std::thread> _async_workers;
+    bool _async_stopping = false;
 };
 } // namespace diskannpy
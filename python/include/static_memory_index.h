@@ -31,9 +31,12 @@ template <typename DT> class StaticMemoryIndex
         filterT filter);
 
     NeighborsAndDistances<StaticIdType> batch_search(
-        py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries, uint64_t knn,
+        py::array_t<DT, py::array::c_style> &queries, uint64_t num_queries, uint64_t knn,
         uint64_t complexity, uint32_t num_threads);
 
+    // bytes held by the index, by component
+    py::dict memory_usage();
+
   private:
     diskann::Index<DT, StaticIdType, filterT> _index;
 };
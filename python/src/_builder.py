@@ -67,9 +67,8 @@ def build_disk_index(
     are too large to fit in memory. Memory is still used, but it is primarily used to provide precise disk
     locations for fast retrieval of smaller subsets of the index without compromising much on recall.
 
-    If you provide a numpy array, it will save this array to disk in a temp location
-    in the format DiskANN's PQ Flash Index builder requires. This temp folder is deleted upon index creation completion
-    or error.
+    If you provide a numpy array, the index is built on the array where it is, without writing it to disk first. A
+    C-contiguous array of the vector dtype is read in place; any other is copied into one for the build.
 
     ## Distance Metric and Vector Datatype Restrictions
     | Metric \ Datatype | np.float32 | np.uint8 | np.int8 |
@@ -126,9 +125,18 @@ def build_disk_index(
         "index_directory must both exist and be a directory",
     )
 
-    vector_bin_path, vector_dtype_actual = _valid_path_and_dtype(
-        data, vector_dtype, index_directory, index_prefix
-    )
+    if isinstance(data, str):
+        vector_bin_path, vector_dtype_actual = _valid_path_and_dtype(
+            data, vector_dtype, index_directory, index_prefix
+        )
+        vectors = None
+        num_points, dimensions = vectors_metadata_from_file(vector_bin_path)
+    else:
+        vector_bin_path = ""
+        vector_dtype_actual = valid_dtype(data.dtype)
+        _assert(len(data.shape) == 2, "data must be a 2 dimensional array")
+        vectors = np.ascontiguousarray(data, dtype=vector_dtype_actual)
+        num_points, dimensions = vectors.shape
     _assert(dap_metric != _native_dap.COSINE, "Cosine is currently not supported in StaticDiskIndex")
     if dap_metric == _native_dap.INNER_PRODUCT:
         _assert(
@@ -136,8 +144,6 @@ def build_disk_index(
             "Integral vector dtypes (np.uint8, np.int8) are not supported with distance metric mips"
         )
 
-    num_points, dimensions = vectors_metadata_from_file(vector_bin_path)
-
     if vector_dtype_actual == np.uint8:
         _builder = _native_dap.build_disk_uint8_index
     elif vector_dtype_actual == np.int8:
@@ -157,6 +163,7 @@ def build_disk_index(
         indexing_ram_budget=build_memory_maximum,
         num_threads=num_threads,
         pq_disk_bytes=pq_disk_bytes,
+        vectors=vectors,
     )
     _write_index_metadata(
         index_prefix_path, vector_dtype_actual, dap_metric, num_points, dimensions
@@ -340,6 +347,9 @@ def build_memory_index(
         filter_labels_file=filter_labels_file,
         universal_label=universal_label,
         filter_complexity=filter_complexity,
+        # an unfiltered build reads an array it was given in place instead of
+        # loading it back from vector_bin_path
+        vectors=data if isinstance(data, np.ndarray) else None,
     )
 
     _write_index_metadata(
@@ -66,7 +66,8 @@ def _castable_dtype_or_raise(
     data: Union[VectorLike, VectorLikeBatch, VectorIdentifierBatch], expected: np.dtype
 ) -> np.ndarray:
     if isinstance(data, np.ndarray) and np.can_cast(data.dtype, expected):
-        return data.astype(expected, casting="safe")
+        # no copy for arrays already of the expected dtype, e.g. np.memmap
+        return data.astype(expected, casting="safe", copy=False)
     else:
         raise TypeError(
             f"expecting a numpy ndarray of dtype {expected}, not a {type(data)}"
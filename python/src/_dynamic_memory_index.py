@@ -509,3 +509,10 @@ class DynamicMemoryIndex:
         self._points_deleted = False
         self._num_vectors -= self._removed_num_vectors
         self._removed_num_vectors = 0
+
+    def memory_usage(self) -> dict[str, int]:
+        """
+        Returns the bytes this index holds in memory, by component (e.g. ``"graph"``, ``"scratch"``). Buffers count at
+        their allocated size and hash tables are estimated. Waits for the searches in progress to finish.
+        """
+        return self._index.memory_usage()
@@ -1,8 +1,10 @@
 # Copyright (c) Microsoft Corporation. All rights reserved.
 # Licensed under the MIT license.
 
+import asyncio
 import os
 import warnings
+import weakref
 from typing import Optional
 
 import numpy as np
@@ -33,6 +35,11 @@ __ALL__ = ["StaticDiskIndex"]
 class StaticDiskIndex:
     """
     A StaticDiskIndex is a disk-backed index that is not mutable.
+
+    An index may be loaded once in a process that then forks workers, as gunicorn does with `--preload`: each worker
+    searches the index inherited, sharing its PQ codes and node cache with the others, and only opens I/O contexts of
+    its own. Before a fork the index waits until it is loaded and stops its `search_async` workers, which the next
+    `search_async` starts again; it must not be searched while the process forks.
     """
 
     def __init__(
@@ -106,6 +113,21 @@ class StaticDiskIndex:
             num_nodes_to_cache=num_nodes_to_cache,
             cache_mechanism=cache_mechanism,
         )
+        if hasattr(os, "register_at_fork"):
+            # the hooks cannot be unregistered, so they must not keep the index alive
+            index_ref = weakref.ref(self._index)
+
+            def _before_fork():
+                index = index_ref()
+                if index is not None:
+                    index.prepare_fork()
+
+            def _after_fork_in_child():
+                index = index_ref()
+                if index is not None:
+                    index.after_fork_in_child()
+
+            os.register_at_fork(before=_before_fork, after_in_child=_after_fork_in_child)
 
     def search(
         self, query: VectorLike, k_neighbors: int, complexity: int, beam_width: int = 2
@@ -146,6 +168,54 @@ class StaticDiskIndex:
         )
         return QueryResponse(identifiers=neighbors, distances=distances)
 
+    async def search_async(
+        self, query: VectorLike, k_neighbors: int, complexity: int, beam_width: int = 2
+    ) -> QueryResponse:
+        """
+        Searches the index by a single query vector without blocking the running event loop.
+
+        The query is queued for the index's native worker threads (`num_threads` of them), which search the queries
+        queued at the same time together, reading the disk sectors of a batch in one submission.
+
+        ### Parameters
+        Same as `search`.
+        """
+        _query = _castable_dtype_or_raise(query, expected=self._vector_dtype)
+        _assert(len(_query.shape) == 1, "query vector must be 1-d")
+        _assert_is_positive_uint32(k_neighbors, "k_neighbors")
+        _assert_is_positive_uint32(complexity, "complexity")
+        _assert_is_positive_uint32(beam_width, "beam_width")
+
+        if k_neighbors > complexity:
+            warnings.warn(
+                f"{k_neighbors=} asked for, but {complexity=} was smaller. Increasing {complexity} to {k_neighbors}"
+            )
+            complexity = k_neighbors
+
+        loop = asyncio.get_running_loop()
+        future = loop.create_future()
+
+        def _complete(neighbors, distances, error):
+            if future.cancelled():
+                return
+            if error is not None:
+                future.set_exception(RuntimeError(error))
+            else:
+                future.set_result(QueryResponse(identifiers=neighbors, distances=distances))
+
+        def _done(neighbors, distances, error):
+            # called on a native worker thread
+            loop.call_soon_threadsafe(_complete, neighbors, distances, error)
+
+        self._index.search_async(
+            query=_query,
+            knn=k_neighbors,
+            complexity=complexity,
+            beam_width=beam_width,
+            done=_done,
+        )
+        return await future
+
     def batch_search(
         self,
         queries: VectorLikeBatch,
@@ -197,3 +267,10 @@ class StaticDiskIndex:
             num_threads=num_threads,
         )
         return QueryResponseBatch(identifiers=neighbors, distances=distances)
+
+    def memory_usage(self) -> dict[str, int]:
+        """
+        Returns the bytes this index holds in memory, by component (e.g. ``"graph"``, ``"scratch"``). Buffers count at
+        their allocated size and hash tables are estimated. Waits for the searches in progress to finish.
+        """
+        return self._index.memory_usage()
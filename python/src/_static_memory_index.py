@@ -226,3 +226,10 @@ class StaticMemoryIndex:
             num_threads=num_threads,
         )
         return QueryResponseBatch(identifiers=neighbors, distances=distances)
+
+    def memory_usage(self) -> dict[str, int]:
+        """
+        Returns the bytes this index holds in memory, by component (e.g. ``"graph"``, ``"scratch"``). Buffers count at
+        their allocated size and hash tables are estimated. Waits for the searches in progress to finish.
+        """
+        return self._index.memory_usage()
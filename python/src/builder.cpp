@@ -13,23 +13,37 @@ template <typename DT>
 void build_disk_index(const diskann::Metric metric, const std::string &data_file_path,
                       const std::string &index_prefix_path, const uint32_t complexity, const uint32_t graph_degree,
                       const double final_index_ram_limit, const double indexing_ram_budget, const uint32_t num_threads,
-                      const uint32_t pq_disk_bytes)
+                      const uint32_t pq_disk_bytes, const py::object &vectors)
 {
     std::string params = std::to_string(graph_degree) + " " + std::to_string(complexity) + " " +
                          std::to_string(final_index_ram_limit) + " " + std::to_string(indexing_ram_budget) + " " +
                          std::to_string(num_threads);
     if (pq_disk_bytes > 0)
         params = params + " " + std::to_string(pq_disk_bytes);
-    diskann::build_disk_index<DT>(data_file_path.c_str(), index_prefix_path.c_str(), params.c_str(), metric);
+    if (vectors.is_none())
+    {
+        diskann::build_disk_index<DT>(data_file_path.c_str(), index_prefix_path.c_str(), params.c_str(), metric);
+        return;
+    }
+
+    // built on the array where it is rather than on a copy in a file
+    auto array = py::array_t<DT, py::array::c_style>::ensure(vectors);
+    if (!array || array.ndim() != 2)
+        throw std::runtime_error("vectors must be a 2d array");
+    const DT *data = array.data();
+    const size_t num_points = array.shape(0), dim = array.shape(1);
+    py::gil_scoped_release release;
+    diskann::build_disk_index_from_memory<DT>(data, num_points, dim, index_prefix_path.c_str(), params.c_str(),
+                                              metric);
 }
 
 template void build_disk_index<float>(diskann::Metric, const std::string &, const std::string &, uint32_t, uint32_t,
-                                      double, double, uint32_t, uint32_t);
+                                      double, double, uint32_t, uint32_t, const py::object &);
 
 template void build_disk_index<uint8_t>(diskann::Metric, const std::string &, const std::string &, uint32_t, uint32_t,
-                                        double, double, uint32_t, uint32_t);
+                                        double, double, uint32_t, uint32_t, const py::object &);
 template void build_disk_index<int8_t>(diskann::Metric, const std::string &, const std::string &, uint32_t, uint32_t,
-                                       double, double, uint32_t, uint32_t);
+                                       double, double, uint32_t, uint32_t, const py::object &);
 
 template <typename T, typename TagT, typename LabelT>
 std::string prepare_filtered_label_map(diskann::Index<T, TagT, LabelT> &index, const std::string &index_output_path,
@@ -55,13 +69,40 @@ template std::string prepare_filtered_label_map<int8_t>(diskann::Index<int8_t, u
 template std::string prepare_filtered_label_map<uint8_t>(diskann::Index<uint8_t, uint32_t, uint32_t> &,
                                                          const std::string &, const std::string &, const std::string &);
 
+// Builds index from the numpy array vectors, read in place when possible so
+// that the vectors are not held twice, or from the file holding the same
+// vectors if vectors is None or a PQ build needs the file
+template <typename T, typename TagT, typename LabelT>
+void build_from_vectors_or_file(diskann::Index<T, TagT, LabelT> &index, const py::object &vectors,
+                                const bool use_pq_build, const std::string &vector_bin_path, const size_t data_num,
+                                const std::vector<TagT> &tags)
+{
+    if (vectors.is_none() || use_pq_build)
+    {
+        index.build(vector_bin_path.c_str(), data_num, tags);
+        return;
+    }
+
+    auto array = py::array_t<T, py::array::c_style>::ensure(vectors);
+    if (!array || array.ndim() != 2 || (size_t)array.shape(0) != data_num)
+        throw std::runtime_error("vectors must be the 2d array of the vectors in " + vector_bin_path);
+    // the index may drop the array after the GIL is released
+    auto owner = std::shared_ptr<const void>(new py::object(array), [](const void *object) {
+        py::gil_scoped_acquire acquire;
+        delete (const py::object *)object;
+    });
+    const T *data = array.data();
+    py::gil_scoped_release release;
+    index.build(data, data_num, tags, std::move(owner));
+}
+
 template <typename T, typename TagT, typename LabelT>
 void build_memory_index(const diskann::Metric metric, const std::string &vector_bin_path,
                         const std::string &index_output_path, const uint32_t graph_degree, const uint32_t complexity,
                         const float alpha, const uint32_t num_threads, const bool use_pq_build,
                         const size_t num_pq_bytes, const bool use_opq, const bool use_tags,
                         const std::string &filter_labels_file, const std::string &universal_label,
-                        const uint32_t filter_complexity)
+                        const uint32_t filter_complexity, const py::object &vectors)
 {
     diskann::IndexWriteParameters index_build_params = diskann::IndexWriteParametersBuilder(complexity, graph_degree)
                                                            .with_filter_list_size(filter_complexity)
@@ -92,7 +133,7 @@ void build_memory_index(const diskann::Metric metric, const std::string &vector_
         std::vector<TagT> tags(tags_data, tags_data + data_num);
         if (filter_labels_file.empty())
         {
-            index.build(vector_bin_path.c_str(), data_num, tags);
+            build_from_vectors_or_file(index, vectors, use_pq_build, vector_bin_path, data_num, tags);
         }
         else
         {
@@ -105,7 +146,7 @@ void build_memory_index(const diskann::Metric metric, const std::string &vector_
     {
         if (filter_labels_file.empty())
         {
-            index.build(vector_bin_path.c_str(), data_num);
+            build_from_vectors_or_file(index, vectors, use_pq_build, vector_bin_path, data_num, std::vector<TagT>());
         }
         else
         {
@@ -120,14 +161,14 @@ void build_memory_index(const diskann::Metric metric, const std::string &vector_
 
 template void build_memory_index<float>(diskann::Metric, const std::string &, const std::string &, uint32_t, uint32_t,
                                         float, uint32_t, bool, size_t, bool, bool, const std::string &,
-                                        const std::string &, uint32_t);
+                                        const std::string &, uint32_t, const py::object &);
 
 template void build_memory_index<int8_t>(diskann::Metric, const std::string &, const std::string &, uint32_t, uint32_t,
                                          float, uint32_t, bool, size_t, bool, bool, const std::string &,
-                                         const std::string &, uint32_t);
+                                         const std::string &, uint32_t, const py::object &);
 
 template void build_memory_index<uint8_t>(diskann::Metric, const std::string &, const std::string &, uint32_t, uint32_t,
                                           float, uint32_t, bool, size_t, bool, bool, const std::string &,
-                                          const std::string &, uint32_t);
+                                          const std::string &, uint32_t, const py::object &);
 
 } // namespace diskannpy
@@ -80,23 +80,25 @@ int DynamicMemoryIndex<DT>::insert(const py::array_t<DT, py::array::c_style | py
 }
 
 template <class DT>
-py::array_t<int> DynamicMemoryIndex<DT>::batch_insert(
-    py::array_t<DT, py::array::c_style | py::array::forcecast> &vectors,
-    py::array_t<DynamicIdType, py::array::c_style | py::array::forcecast> &ids, const int32_t num_inserts,
-    const int num_threads)
+py::array_t<int> DynamicMemoryIndex<DT>::batch_insert(py::array_t<DT, py::array::c_style> &vectors,
+                                                      py::array_t<DynamicIdType, py::array::c_style> &ids,
+                                                      const int32_t num_inserts, const int num_threads)
 {
-    if (num_threads == 0)
-        omp_set_num_threads(omp_get_num_procs());
-    else
-        omp_set_num_threads(num_threads);
     py::array_t<int> insert_retvals(num_inserts);
 
-#pragma omp parallel for schedule(dynamic, 1) default(none) shared(num_inserts, insert_retvals, vectors, ids)
-    for (int32_t i = 0; i < num_inserts; i++)
+    const DT *vectors_data = vectors.data();
+    const DynamicIdType *ids_data = ids.data();
+    int *retvals_data = insert_retvals.mutable_data();
     {
-        insert_retvals.mutable_data()[i] = _index.insert_point(vectors.data(i), *(ids.data(i)));
+        py::gil_scoped_release release;
+        if (num_threads == 0)
+            omp_set_num_threads(omp_get_num_procs());
+        else
+            omp_set_num_threads(num_threads);
+        std::vector<int> retvals;
+        _index.insert_points(vectors_data, ids_data, num_inserts, retvals);
+        std::copy(retvals.begin(), retvals.end(), retvals_data);
     }
-
     return insert_retvals;
 }
 
@@ -127,24 +129,31 @@ NeighborsAndDistances<DynamicIdType> DynamicMemoryIndex<DT>::search(
 
 template <class DT>
 NeighborsAndDistances<DynamicIdType> DynamicMemoryIndex<DT>::batch_search(
-    py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, const uint64_t num_queries, const uint64_t knn,
+    py::array_t<DT, py::array::c_style> &queries, const uint64_t num_queries, const uint64_t knn,
     const uint64_t complexity, const uint32_t num_threads)
 {
     py::array_t<DynamicIdType> ids({num_queries, knn});
     py::array_t<float> dists({num_queries, knn});
     std::vector<DT *> empty_vector;
 
-    if (num_threads == 0)
-        omp_set_num_threads(omp_get_num_procs());
-    else
-        omp_set_num_threads(static_cast<int32_t>(num_threads));
+    const DT *queries_data = queries.data();
+    const uint64_t dim = queries.shape(1);
+    DynamicIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
+    {
+        py::gil_scoped_release release;
+        if (num_threads == 0)
+            omp_set_num_threads(omp_get_num_procs());
+        else
+            omp_set_num_threads(static_cast<int32_t>(num_threads));
 
 #pragma omp parallel for schedule(dynamic, 1) default(none)                                                            \
-    shared(num_queries, queries, knn, complexity, ids, dists, empty_vector)
-    for (int64_t i = 0; i < (int64_t)num_queries; i++)
-    {
-        _index.search_with_tags(queries.data(i), knn, complexity, ids.mutable_data(i), dists.mutable_data(i),
-                                empty_vector);
+    shared(num_queries, queries_data, dim, knn, complexity, ids_data, dists_data, empty_vector)
+        for (int64_t i = 0; i < (int64_t)num_queries; i++)
+        {
+            _index.search_with_tags(queries_data + i * dim, knn, complexity, ids_data + i * knn, dists_data + i * knn,
+                                    empty_vector);
+        }
     }
 
     return std::make_pair(ids, dists);
@@ -160,6 +169,17 @@ template <class DT> size_t DynamicMemoryIndex<DT>::num_points()
     return _index.get_num_points();
 }
 
+template <class DT> py::dict DynamicMemoryIndex<DT>::memory_usage()
+{
+    diskann::MemoryUsage usage;
+    {
+        // measuring waits for the searches in progress
+        py::gil_scoped_release release;
+        usage = _index.get_memory_usage();
+    }
+    return to_dict(usage);
+}
+
 template class DynamicMemoryIndex<float>;
 template class DynamicMemoryIndex<uint8_t>;
 template class DynamicMemoryIndex<int8_t>;
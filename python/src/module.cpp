@@ -44,12 +44,12 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
 {
     m.def(variant.disk_builder_name.c_str(), &diskannpy::build_disk_index<T>, "distance_metric"_a, "data_file_path"_a,
           "index_prefix_path"_a, "complexity"_a, "graph_degree"_a, "final_index_ram_limit"_a, "indexing_ram_budget"_a,
-          "num_threads"_a, "pq_disk_bytes"_a);
+          "num_threads"_a, "pq_disk_bytes"_a, "vectors"_a = py::none());
 
     m.def(variant.memory_builder_name.c_str(), &diskannpy::build_memory_index<T>, "distance_metric"_a,
           "data_file_path"_a, "index_output_path"_a, "graph_degree"_a, "complexity"_a, "alpha"_a, "num_threads"_a,
           "use_pq_build"_a, "num_pq_bytes"_a, "use_opq"_a, "use_tags"_a = false, "filter_labels_file"_a = "",
-          "universal_label"_a = "", "filter_complexity"_a = 0);
+          "universal_label"_a = "", "filter_complexity"_a = 0, "vectors"_a = py::none());
 
     py::class_<diskannpy::StaticMemoryIndex<T>>(m, variant.static_memory_index_name.c_str())
         .def(py::init<const diskann::Metric, const std::string &, const size_t, const size_t, const uint32_t,
@@ -60,7 +60,8 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
         .def("search_with_filter", &diskannpy::StaticMemoryIndex<T>::search_with_filter, "query"_a, "knn"_a,
              "complexity"_a, "filter"_a)
         .def("batch_search", &diskannpy::StaticMemoryIndex<T>::batch_search, "queries"_a, "num_queries"_a, "knn"_a,
-             "complexity"_a, "num_threads"_a);
+             "complexity"_a, "num_threads"_a)
+        .def("memory_usage", &diskannpy::StaticMemoryIndex<T>::memory_usage);
 
     py::class_<diskannpy::DynamicMemoryIndex<T>>(m, variant.dynamic_memory_index_name.c_str())
         .def(py::init<const diskann::Metric, const size_t, const size_t, const uint32_t, const uint32_t, const bool,
@@ -83,7 +84,8 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
         .def("insert", &diskannpy::DynamicMemoryIndex<T>::insert, "vector"_a, "id"_a)
         .def("mark_deleted", &diskannpy::DynamicMemoryIndex<T>::mark_deleted, "id"_a)
         .def("consolidate_delete", &diskannpy::DynamicMemoryIndex<T>::consolidate_delete)
-        .def("num_points", &diskannpy::DynamicMemoryIndex<T>::num_points);
+        .def("num_points", &diskannpy::DynamicMemoryIndex<T>::num_points)
+        .def("memory_usage", &diskannpy::DynamicMemoryIndex<T>::memory_usage);
 
     py::class_<diskannpy::StaticDiskIndex<T>>(m, variant.static_disk_index_name.c_str())
         .def(py::init<const diskann::Metric, const std::string &, const uint32_t, const size_t, const uint32_t>(),
@@ -92,7 +94,12 @@ template <typename T> inline void add_variant(py::module_ &m, const Variant &var
         .def("cache_bfs_levels", &diskannpy::StaticDiskIndex<T>::cache_bfs_levels, "num_nodes_to_cache"_a)
         .def("search", &diskannpy::StaticDiskIndex<T>::search, "query"_a, "knn"_a, "complexity"_a, "beam_width"_a)
         .def("batch_search", &diskannpy::StaticDiskIndex<T>::batch_search, "queries"_a, "num_queries"_a, "knn"_a,
-             "complexity"_a, "beam_width"_a, "num_threads"_a);
+             "complexity"_a, "beam_width"_a, "num_threads"_a)
+        .def("search_async", &diskannpy::StaticDiskIndex<T>::search_async, "query"_a, "knn"_a, "complexity"_a,
+             "beam_width"_a, "done"_a)
+        .def("prepare_fork", &diskannpy::StaticDiskIndex<T>::prepare_fork)
+        .def("after_fork_in_child", &diskannpy::StaticDiskIndex<T>::after_fork_in_child)
+        .def("memory_usage", &diskannpy::StaticDiskIndex<T>::memory_usage);
 }
 
 PYBIND11_MODULE(_diskannpy, m)
@@ -12,9 +12,9 @@ template <typename DT>
 StaticDiskIndex<DT>::StaticDiskIndex(const diskann::Metric metric, const std::string &index_path_prefix,
                                      const uint32_t num_threads, const size_t num_nodes_to_cache,
                                      const uint32_t cache_mechanism)
-    : _reader(std::make_shared<PlatformSpecificAlignedFileReader>()), _index(_reader, metric)
+    : _reader(std::make_shared<PlatformSpecificAlignedFileReader>()), _index(_reader, metric),
+      _num_threads(num_threads != 0 ? num_threads : omp_get_num_procs())
 {
-    const uint32_t _num_threads = num_threads != 0 ? num_threads : omp_get_num_procs();
     int load_success = _index.load(_num_threads, index_path_prefix.c_str());
     if (load_success != 0)
     {
@@ -31,6 +31,43 @@ StaticDiskIndex<DT>::StaticDiskIndex(const diskann::Metric metric, const std::st
     }
 }
 
+template <typename DT> StaticDiskIndex<DT>::~StaticDiskIndex()
+{
+    stop_async_workers();
+}
+
+template <typename DT> void StaticDiskIndex<DT>::stop_async_workers()
+{
+    {
+        std::lock_guard<std::mutex> guard(_async_lock);
+        _async_stopping = true;
+    }
+    _async_cv.notify_all();
+    {
+        // the workers need the GIL to complete the queries still queued
+        py::gil_scoped_release release;
+        for (auto &worker : _async_workers)
+            worker.join();
+    }
+    std::lock_guard<std::mutex> guard(_async_lock);
+    _async_workers.clear();
+    _async_stopping = false;
+}
+
+template <typename DT> void StaticDiskIndex<DT>::prepare_fork()
+{
+    {
+        py::gil_scoped_release release;
+        _index.wait_until_loaded();
+    }
+    stop_async_workers();
+}
+
+template <typename DT> void StaticDiskIndex<DT>::after_fork_in_child()
+{
+    _index.reset_after_fork();
+}
+
 template <typename DT> void StaticDiskIndex<DT>::cache_bfs_levels(const size_t num_nodes_to_cache)
 {
     std::vector<uint32_t> node_list;
@@ -61,46 +98,175 @@ NeighborsAndDistances<StaticIdType> StaticDiskIndex<DT>::search(
     py::array_t<StaticIdType> ids(knn);
     py::array_t<float> dists(knn);
 
-    std::vector<uint32_t> u32_ids(knn);
     std::vector<uint64_t> u64_ids(knn);
     diskann::QueryStats stats;
 
-    _index.cached_beam_search(query.data(), knn, complexity, u64_ids.data(), dists.mutable_data(), beam_width, false,
-                              &stats);
-
-    auto r = ids.mutable_unchecked<1>();
-    for (uint64_t i = 0; i < knn; ++i)
-        r(i) = (unsigned)u64_ids[i];
+    const DT *query_data = query.data();
+    StaticIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
+    {
+        py::gil_scoped_release release;
+        _index.cached_beam_search(query_data, knn, complexity, u64_ids.data(), dists_data, beam_width, false, &stats);
+        for (uint64_t i = 0; i < knn; ++i)
+            ids_data[i] = (StaticIdType)u64_ids[i];
+    }
 
     return std::make_pair(ids, dists);
 }
 
 template <typename DT>
 NeighborsAndDistances<StaticIdType> StaticDiskIndex<DT>::batch_search(
-    py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, const uint64_t num_queries, const uint64_t knn,
+    py::array_t<DT, py::array::c_style> &queries, const uint64_t num_queries, const uint64_t knn,
     const uint64_t complexity, const uint64_t beam_width, const uint32_t num_threads)
 {
     py::array_t<StaticIdType> ids({num_queries, knn});
     py::array_t<float> dists({num_queries, knn});
 
-    omp_set_num_threads(num_threads);
+    // the buffers are only touched through raw pointers once the GIL is
+    // released
+    const DT *queries_data = queries.data();
+    const uint64_t dim = queries.shape(1);
+    StaticIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
+    {
+        py::gil_scoped_release release;
+        omp_set_num_threads(num_threads != 0 ? num_threads : omp_get_num_procs());
 
-    std::vector<uint64_t> u64_ids(knn * num_queries);
+        // the index returns 64-bit ids, so each thread converts its results
+        // into the output from a buffer of one query
+#pragma omp parallel default(none)                                                                                     \
+    shared(num_queries, queries_data, dim, knn, complexity, ids_data, dists_data, beam_width)
+        {
+            std::vector<uint64_t> u64_ids(knn);
+#pragma omp for schedule(dynamic, 1)
+            for (int64_t i = 0; i < (int64_t)num_queries; i++)
+            {
+                _index.cached_beam_search(queries_data + i * dim, knn, complexity, u64_ids.data(),
+                                          dists_data + i * knn, beam_width);
+                for (uint64_t j = 0; j < knn; ++j)
+                    ids_data[i * knn + j] = (StaticIdType)u64_ids[j];
+            }
+        }
+    }
+
+    return std::make_pair(ids, dists);
+}
 
-#pragma omp parallel for schedule(dynamic, 1) default(none)                                                            \
-    shared(num_queries, queries, knn, complexity, u64_ids, dists, beam_width)
-    for (int64_t i = 0; i < (int64_t)num_queries; i++)
+template <typename DT>
+void StaticDiskIndex<DT>::search_async(py::array_t<DT, py::array::c_style | py::array::forcecast> &query,
+                                       const uint64_t knn, const uint64_t complexity, const uint64_t beam_width,
+                                       py::function done)
+{
+    AsyncQuery async_query;
+    async_query.query.assign(query.data(), query.data() + query.size());
+    async_query.knn = knn;
+    async_query.complexity = complexity;
+    async_query.beam_width = beam_width;
+    async_query.done = std::move(done);
     {
-        _index.cached_beam_search(queries.data(i), knn, complexity, u64_ids.data() + i * knn, dists.mutable_data(i),
-                                  beam_width);
+        std::lock_guard<std::mutex> guard(_async_lock);
+        if (_async_workers.empty())
+        {
+            for (uint32_t i = 0; i < _num_threads; i++)
+                _async_workers.emplace_back([this]() { run_async_worker(); });
+        }
+        _async_queue.push_back(std::move(async_query));
     }
+    _async_cv.notify_one();
+}
+
+template <typename DT> void StaticDiskIndex<DT>::run_async_worker()
+{
+    std::vector<AsyncQuery> batch;
+    std::vector<DT> queries;
+    std::vector<uint64_t> u64_ids;
+    std::vector<float> dists;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(_async_lock);
+            _async_cv.wait(guard, [this]() { return _async_stopping || !_async_queue.empty(); });
+            if (_async_queue.empty())
+                return;
 
-    auto r = ids.mutable_unchecked();
-    for (uint64_t i = 0; i < num_queries; ++i)
-        for (uint64_t j = 0; j < knn; ++j)
-            r(i, j) = (uint32_t)u64_ids[i * knn + j];
+            // the first query and those queued after it with the same
+            // parameters
+            batch.push_back(std::move(_async_queue.front()));
+            _async_queue.pop_front();
+            const AsyncQuery &first = batch.front();
+            for (auto iter = _async_queue.begin();
+                 iter != _async_queue.end() && batch.size() < ASYNC_MAX_BATCH_SIZE;)
+            {
+                if (iter->knn == first.knn && iter->complexity == first.complexity &&
+                    iter->beam_width == first.beam_width && iter->query.size() == first.query.size())
+                {
+                    batch.push_back(std::move(*iter));
+                    iter = _async_queue.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+        }
 
-    return std::make_pair(ids, dists);
+        const AsyncQuery &first = batch.front();
+        const uint64_t dim = first.query.size();
+        const uint64_t knn = first.knn;
+        queries.resize(batch.size() * dim);
+        for (size_t i = 0; i < batch.size(); i++)
+            std::copy(batch[i].query.begin(), batch[i].query.end(), queries.begin() + i * dim);
+        u64_ids.assign(batch.size() * knn, 0);
+        dists.assign(batch.size() * knn, 0.0f);
+        std::string error;
+        try
+        {
+            _index.batch_cached_beam_search(queries.data(), batch.size(), dim, knn, first.complexity, u64_ids.data(),
+                                            dists.data(), first.beam_width);
+        }
+        catch (const std::exception &ex)
+        {
+            error = ex.what();
+        }
+
+        py::gil_scoped_acquire acquire;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            try
+            {
+                if (!error.empty())
+                {
+                    batch[i].done(py::none(), py::none(), error);
+                    continue;
+                }
+                py::array_t<StaticIdType> ids(knn);
+                py::array_t<float> query_dists(knn);
+                StaticIdType *ids_data = ids.mutable_data();
+                for (uint64_t j = 0; j < knn; j++)
+                    ids_data[j] = (StaticIdType)u64_ids[i * knn + j];
+                std::copy(dists.begin() + i * knn, dists.begin() + (i + 1) * knn, query_dists.mutable_data());
+                batch[i].done(ids, query_dists, py::none());
+            }
+            catch (py::error_already_set &ex)
+            {
+                // there is no caller to raise to
+                ex.discard_as_unraisable("StaticDiskIndex.search_async callback");
+            }
+        }
+        // the callbacks are released with the GIL held
+        batch.clear();
+    }
+}
+
+template <typename DT> py::dict StaticDiskIndex<DT>::memory_usage()
+{
+    diskann::MemoryUsage usage;
+    {
+        // measuring waits for the searches in progress
+        py::gil_scoped_release release;
+        usage = _index.get_memory_usage();
+    }
+    return to_dict(usage);
 }
 
 template class StaticDiskIndex<float>;
@@ -65,25 +65,36 @@ NeighborsAndDistances<StaticIdType> StaticMemoryIndex<DT>::search_with_filter(
 
 template <typename DT>
 NeighborsAndDistances<StaticIdType> StaticMemoryIndex<DT>::batch_search(
-    py::array_t<DT, py::array::c_style | py::array::forcecast> &queries, const uint64_t num_queries, const uint64_t knn,
+    py::array_t<DT, py::array::c_style> &queries, const uint64_t num_queries, const uint64_t knn,
     const uint64_t complexity, const uint32_t num_threads)
 {
     const uint32_t _num_threads = num_threads != 0 ? num_threads : omp_get_num_procs();
     py::array_t<StaticIdType> ids({num_queries, knn});
     py::array_t<float> dists({num_queries, knn});
-    std::vector<DT *> empty_vector;
-
-    omp_set_num_threads(static_cast<int32_t>(_num_threads));
 
-#pragma omp parallel for schedule(dynamic, 1) default(none) shared(num_queries, queries, knn, complexity, ids, dists)
-    for (int64_t i = 0; i < (int64_t)num_queries; i++)
+    const DT *queries_data = queries.data();
+    const size_t dim = queries.shape(1);
+    StaticIdType *ids_data = ids.mutable_data();
+    float *dists_data = dists.mutable_data();
     {
-        _index.search(queries.data(i), knn, complexity, ids.mutable_data(i), dists.mutable_data(i));
+        py::gil_scoped_release release;
+        _index.batch_search(queries_data, num_queries, dim, knn, complexity, ids_data, dists_data, _num_threads);
     }
 
     return std::make_pair(ids, dists);
 }
 
+template <typename DT> py::dict StaticMemoryIndex<DT>::memory_usage()
+{
+    diskann::MemoryUsage usage;
+    {
+        // measuring waits for the searches in progress
+        py::gil_scoped_release release;
+        usage = _index.get_memory_usage();
+    }
+    return to_dict(usage);
+}
+
 template class StaticMemoryIndex<float>;
 template class StaticMemoryIndex<uint8_t>;
 template class StaticMemoryIndex<int8_t>;
@@ -16,7 +16,7 @@ use diskann::{
     utils::{load_metadata_from_file, Timer},
 };
 
-use vector::{FullPrecisionDistance, Half, Metric};
+use vector::{BFloat16, FullPrecisionDistance, Half, Metric};
 
 /// The main function to build an in-memory index
 #[allow(clippy::too_many_arguments)]
@@ -31,6 +31,7 @@ fn build_in_memory_index<T>(
     _use_pq_build: bool,
     _num_pq_bytes: usize,
     use_opq: bool,
+    save_mapped: bool,
 ) -> ANNResult<()>
 where
     T: Default + Copy + Sync + Send + Into<f32>,
@@ -68,6 +69,9 @@ where
 
     println!("Indexing time: {}", diff.as_secs_f64());
     index.save(save_path)?;
+    if save_mapped {
+        index.save_mapped(save_path)?;
+    }
 
     Ok(())
 }
@@ -94,6 +98,7 @@ fn main() -> ANNResult<()> {
             _use_pq_build,
             args.build_pq_bytes,
             args.use_opq,
+            args.save_mapped,
         ),
         DataType::FP16 => build_in_memory_index::<Half>(
             args.dist_fn,
@@ -106,6 +111,20 @@ fn main() -> ANNResult<()> {
             _use_pq_build,
             args.build_pq_bytes,
             args.use_opq,
+            args.save_mapped,
+        ),
+        DataType::BF16 => build_in_memory_index::<BFloat16>(
+            args.dist_fn,
+            &args.data_path.to_string_lossy(),
+            args.max_degree,
+            args.l_build,
+            args.alpha,
+            &args.index_path_prefix,
+            args.num_threads,
+            _use_pq_build,
+            args.build_pq_bytes,
+            args.use_opq,
+            args.save_mapped,
         ),
     };
 
@@ -128,11 +147,14 @@ enum DataType {
 
     /// Half data type.
     FP16,
+
+    /// Brain float 16 data type, as written by convert_f32_to_bf16.
+    BF16,
 }
 
 #[derive(Debug, Parser)]
 struct BuildMemoryIndexArgs {
-    /// data type <int8/uint8/float / fp16> (required)
+    /// data type <int8/uint8/float / fp16 / bf16> (required)
     #[arg(long = "data_type", default_value = "float")]
     pub data_type: DataType,
 
@@ -171,4 +193,8 @@ struct BuildMemoryIndexArgs {
     /// Set true for OPQ compression while using PQ distance comparisons for building the index, and false for PQ compression
     #[arg(long = "use_opq", short, default_value = "false")]
     pub use_opq: bool,
+
+    /// Also save the index in the layout search_memory_index --mmap maps
+    #[arg(long = "save_mapped", default_value = "false")]
+    pub save_mapped: bool,
 }
@@ -15,7 +15,7 @@ use diskann::{
     utils::{load_metadata_from_file, save_bin_u32},
 };
 use std::{env, path::Path, process::exit, time::Instant};
-use vector::{FullPrecisionDistance, Half, Metric};
+use vector::{BFloat16, FullPrecisionDistance, Half, Metric};
 
 use rayon::prelude::*;
 
@@ -32,6 +32,8 @@ fn search_memory_index<T>(
     l_vec: &Vec<u32>,
     show_qps_per_thread: bool,
     fail_if_recall_below: f32,
+    mmap: bool,
+    populate: bool,
 ) -> ANNResult<i32>
 where
     T: Default + Copy + Sized + Pod + Sync + Send + Into<f32>,
@@ -77,7 +79,12 @@ where
     .with_num_threads(num_threads)
     .build();
 
-    let (index_num_points, _) = load_metadata_from_file(&format!("{}.data", index_path))?;
+    let data_file = if mmap {
+        format!("{}.mapped_data", index_path)
+    } else {
+        format!("{}.data", index_path)
+    };
+    let (index_num_points, _) = load_metadata_from_file(&data_file)?;
 
     let index_config = IndexConfiguration::new(
         metric,
@@ -93,7 +100,11 @@ where
     );
     let mut index = index::create_inmem_index::<T>(index_config)?;
 
-    index.load(index_path, index_num_points)?;
+    if mmap {
+        index.load_mapped(index_path, index_num_points, populate)?;
+    } else {
+        index.load(index_path, index_num_points)?;
+    }
 
     println!("Using {} threads to search", num_threads);
     let qps_title = if show_qps_per_thread {
@@ -242,6 +253,8 @@ fn main() -> ANNResult<()> {
         let mut l_vec: Vec<u32> = Vec::new();
         let mut show_qps_per_thread: bool = false;
         let mut fail_if_recall_below: f32 = 0.0;
+        let mut mmap: bool = false;
+        let mut populate: bool = false;
 
         let args: Vec<String> = env::args().collect();
         let mut iter = args.iter().skip(1).peekable();
@@ -309,6 +322,12 @@ fn main() -> ANNResult<()> {
                 "--qps_per_thread" => {
                     show_qps_per_thread = true;
                 }
+                "--mmap" => {
+                    mmap = true;
+                }
+                "--populate" => {
+                    populate = true;
+                }
                 "--fail_if_recall_below" => {
                     fail_if_recall_below =
                         iter.next().ok_or_else(ann_error)?.parse().map_err(|err| {
@@ -351,6 +370,8 @@ fn main() -> ANNResult<()> {
                     &l_vec,
                     show_qps_per_thread,
                     fail_if_recall_below,
+                    mmap,
+                    populate,
                 )?;
             }
             "int8" => {
@@ -366,6 +387,8 @@ fn main() -> ANNResult<()> {
                     &l_vec,
                     show_qps_per_thread,
                     fail_if_recall_below,
+                    mmap,
+                    populate,
                 )?;
             }
             "uint8" => {
@@ -381,6 +404,8 @@ fn main() -> ANNResult<()> {
                     &l_vec,
                     show_qps_per_thread,
                     fail_if_recall_below,
+                    mmap,
+                    populate,
                 )?;
             }
             "f16" => {
@@ -396,6 +421,25 @@ fn main() -> ANNResult<()> {
                     &l_vec,
                     show_qps_per_thread,
                     fail_if_recall_below,
+                    mmap,
+                    populate,
+                )?;
+            }
+            "bf16" => {
+                return_val = search_memory_index::<BFloat16>(
+                    metric.unwrap(),
+                    &index_path,
+                    &result_path_prefix,
+                    &query_file,
+                    &truthset_file,
+                    num_cpus,
+                    recall_at.unwrap(),
+                    print_all_recalls,
+                    &l_vec,
+                    show_qps_per_thread,
+                    fail_if_recall_below,
+                    mmap,
+                    populate,
                 )?;
             }
             _ => {
@@ -415,8 +459,8 @@ fn main() -> ANNResult<()> {
 fn print_help() {
     println!("Arguments");
     println!("--help, -h                Print information on arguments");
-    println!("--data_type               data type <int8/uint8/float> (required)");
-    println!("--dist_fn                 distance function <l2/cosine> (required)");
+    println!("--data_type               data type <int8/uint8/float/f16/bf16> (required)");
+    println!("--dist_fn                 distance function <l2/cosine/mips> (required)");
     println!("--index_path_prefix       Path prefix to the index (required)");
     println!("--result_path             Path prefix for saving results of the queries (required)");
     println!("--query_file              Query file in binary format");
@@ -427,4 +471,6 @@ fn print_help() {
     println!("----num_threads, -T       Number of threads used for building index (defaults to num_cpus::get())");
     println!("--qps_per_thread          Print overall QPS divided by the number of threads in the output table");
     println!("--fail_if_recall_below    If set to a value >0 and <100%, program returns -1 if best recall found is below this threshold");
+    println!("--mmap                    Map the index saved by build_memory_index --save_mapped instead of reading it");
+    println!("--populate                With --mmap, read all pages of the index before searching");
 }
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+//! Disk layout benchmark: lays out a synthetic graph of 128-dimensional float points as
+//! build_disk_index does and reports the rate the layout is written at. Set
+//! DISKANN_BENCH_LAYOUT_DIR to a directory on the drive to measure (the temporary directory
+//! otherwise), and DISKANN_BENCH_LAYOUT_POINTS to the number of points (1 million by default).
+
+use std::fs::{self, File};
+use std::io::{BufWriter, Write};
+use std::time::Duration;
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use diskann::storage::DiskIndexStorage;
+use rand::rngs::StdRng;
+use rand::{Rng, SeedableRng};
+
+const DIM: usize = 128;
+const MAX_DEGREE: u32 = 64;
+
+/// Write a data file of num_points random points, and a graph in which every point has MAX_DEGREE
+/// random neighbors
+fn write_input(data_file: &str, mem_index_file: &str, num_points: usize) -> std::io::Result<()> {
+    let mut rng = StdRng::seed_from_u64(73);
+
+    let mut data = BufWriter::new(File::create(data_file)?);
+    data.write_all(&(num_points as u32).to_le_bytes())?;
+    data.write_all(&(DIM as u32).to_le_bytes())?;
+    for _ in 0..num_points * DIM {
+        data.write_all(&rng.gen_range(0.0f32..128.0).to_le_bytes())?;
+    }
+    data.flush()?;
+
+    let mut graph = BufWriter::new(File::create(mem_index_file)?);
+    let graph_size = 24 + num_points as u64 * (MAX_DEGREE as u64 + 1) * 4;
+    graph.write_all(&graph_size.to_le_bytes())?;
+    graph.write_all(&MAX_DEGREE.to_le_bytes())?;
+    graph.write_all(&0u32.to_le_bytes())?;
+    graph.write_all(&0u64.to_le_bytes())?;
+    for _ in 0..num_points {
+        graph.write_all(&MAX_DEGREE.to_le_bytes())?;
+        for _ in 0..MAX_DEGREE {
+            graph.write_all(&rng.gen_range(0..num_points as u32).to_le_bytes())?;
+        }
+    }
+    graph.flush()
+}
+
+fn benchmark_disk_layout(c: &mut Criterion) {
+    let dir = std::env::var("DISKANN_BENCH_LAYOUT_DIR")
+        .unwrap_or_else(|_| std::env::temp_dir().to_string_lossy().into_owned());
+    let num_points = std::env::var("DISKANN_BENCH_LAYOUT_POINTS")
+        .ok()
+        .and_then(|points| points.parse().ok())
+        .unwrap_or(1_000_000);
+
+    let data_file = format!("{}/disk_layout_bench.fbin", dir);
+    let index_prefix = format!("{}/disk_layout_bench", dir);
+    write_input(&data_file, &format!("{}_mem.index", index_prefix), num_points).unwrap();
+    let storage = DiskIndexStorage::<f32>::new(data_file.clone(), index_prefix.clone()).unwrap();
+
+    let mut group = c.benchmark_group("disk-layout");
+    group.measurement_time(Duration::from_secs(20)).sample_size(10);
+
+    storage.create_disk_layout().unwrap();
+    let layout_size = fs::metadata(format!("{}_disk.index", index_prefix)).unwrap().len();
+    group.throughput(Throughput::Bytes(layout_size));
+    group.bench_function("Create Disk Layout", |f| {
+        f.iter(|| storage.create_disk_layout().unwrap());
+    });
+    group.finish();
+
+    for file in [
+        data_file,
+        format!("{}_mem.index", index_prefix),
+        format!("{}_disk.index", index_prefix),
+    ] {
+        let _ = fs::remove_file(file);
+    }
+}
+
+criterion_group!(benches, benchmark_disk_layout);
+criterion_main!(benches);
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+//! Disk index search benchmark, comparable with the C++ search_disk_index driver.
+//! Set DISKANN_BENCH_DISK_INDEX to the prefix of a disk index of 128-dimensional float vectors
+//! built by build_disk_index; the benchmark is skipped otherwise.
+
+use criterion::{criterion_group, criterion_main, Criterion};
+
+#[cfg(target_os = "linux")]
+fn benchmark_disk_search(c: &mut Criterion) {
+    use std::time::Duration;
+
+    use criterion::{black_box, Throughput};
+    use diskann::index::PQFlashIndex;
+    use rand::rngs::StdRng;
+    use rand::{Rng, SeedableRng};
+
+    const DIM: usize = 128;
+    const NUM_QUERIES: usize = 1000;
+    const K: usize = 10;
+    const L: usize = 100;
+    const BEAM_WIDTH: usize = 4;
+
+    let index_prefix = match std::env::var("DISKANN_BENCH_DISK_INDEX") {
+        Ok(prefix) => prefix,
+        Err(_) => {
+            println!("DISKANN_BENCH_DISK_INDEX is not set, skipping the disk search benchmark");
+            return;
+        }
+    };
+
+    let num_threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let index = PQFlashIndex::<f32, DIM>::load(&index_prefix, num_threads, L, BEAM_WIDTH).unwrap();
+
+    let mut rng = StdRng::seed_from_u64(73);
+    let queries: Vec<f32> = (0..NUM_QUERIES * DIM).map(|_| rng.gen_range(0.0..128.0)).collect();
+    let mut indices = vec![0u32; NUM_QUERIES * K];
+    let mut distances = vec![0f32; NUM_QUERIES * K];
+
+    let mut group = c.benchmark_group("disk-search");
+    group.measurement_time(Duration::from_secs(10)).sample_size(10);
+
+    group.throughput(Throughput::Elements(1));
+    group.bench_function("Disk Index Search Latency", |f| {
+        let mut query_index = 0;
+        f.iter(|| {
+            let query = &queries[query_index * DIM..(query_index + 1) * DIM];
+            query_index = (query_index + 1) % NUM_QUERIES;
+            black_box(index.search(query, K, L, BEAM_WIDTH, &mut indices[..K], &mut distances[..K]).unwrap())
+        });
+    });
+
+    group.throughput(Throughput::Elements(NUM_QUERIES as u64));
+    group.bench_function("Disk Index Search QPS", |f| {
+        f.iter(|| {
+            index.search_batch(&queries, K, L, BEAM_WIDTH, &mut indices, &mut distances).unwrap();
+            black_box(&indices);
+        });
+    });
+}
+
+#[cfg(not(target_os = "linux"))]
+fn benchmark_disk_search(_: &mut Criterion) {
+    println!("The io_uring disk search is only available on Linux, skipping the disk search benchmark");
+}
+
+criterion_group!(benches, benchmark_disk_search);
+criterion_main!(benches);
@@ -5,7 +5,7 @@
 use criterion::{black_box, criterion_group, criterion_main, Criterion};
 
 use rand::{thread_rng, Rng};
-use vector::{FullPrecisionDistance, Metric};
+use vector::{BFloat16, FullPrecisionDistance, Metric};
 
 // make sure the vector is 256-bit (32 bytes) aligned required by _mm256_load_ps
 #[repr(C, align(32))]
@@ -29,6 +29,25 @@ fn benchmark_l2_distance_float_rust(c: &mut Criterion) {
     });
 }
 
+fn benchmark_distance_bf16_rust(c: &mut Criterion) {
+    let a = Box::new([(); 256].map(|_| BFloat16::from_f32(thread_rng().gen_range(0.0..100.0))));
+    let b = Box::new([(); 256].map(|_| BFloat16::from_f32(thread_rng().gen_range(0.0..100.0))));
+    let mut group = c.benchmark_group("bf16-computation");
+    group.sample_size(5000);
+
+    for (name, metric) in [("L2", Metric::L2), ("Inner Product", Metric::InnerProduct)] {
+        group.bench_function(format!("bf16 {} Rust run", name), |f| {
+            f.iter(|| {
+                black_box(<[BFloat16; 256]>::distance_compare(
+                    black_box(&a),
+                    black_box(&b),
+                    metric,
+                ))
+            })
+        });
+    }
+}
+
 // make sure the vector is 256-bit (32 bytes) aligned required by _mm256_load_ps
 fn prepare_random_aligned_vectors() -> (Box<Vector32ByteAligned>, Box<Vector32ByteAligned>) {
     let a = Box::new(Vector32ByteAligned {
@@ -42,6 +61,10 @@ fn prepare_random_aligned_vectors() -> (Box<Vector32ByteAligned>, Box<Vector32By
     (a, b)
 }
 
-criterion_group!(benches, benchmark_l2_distance_float_rust,);
+criterion_group!(
+    benches,
+    benchmark_l2_distance_float_rust,
+    benchmark_distance_bf16_rust,
+);
 criterion_main!(benches);
 
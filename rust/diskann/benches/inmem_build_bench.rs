@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+//! In-memory index build benchmark over random 128-dimensional float vectors, run with
+//! rayon pools of different sizes to show how the build scales with threads.
+
+use std::fs::File;
+use std::io::{BufWriter, Write};
+use std::time::Duration;
+
+use criterion::{criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion, Throughput};
+use diskann::index::create_inmem_index;
+use diskann::model::{IndexConfiguration, IndexWriteParametersBuilder};
+use rand::rngs::StdRng;
+use rand::{Rng, SeedableRng};
+use vector::Metric;
+
+const DIM: usize = 128;
+const NUM_POINTS: usize = 20_000;
+const L: u32 = 50;
+const R: u32 = 32;
+
+fn write_random_data(path: &str) {
+    let mut rng = StdRng::seed_from_u64(11);
+    let mut writer = BufWriter::new(File::create(path).unwrap());
+    writer.write_all(&(NUM_POINTS as i32).to_le_bytes()).unwrap();
+    writer.write_all(&(DIM as i32).to_le_bytes()).unwrap();
+    for _ in 0..NUM_POINTS * DIM {
+        writer.write_all(&rng.gen::<f32>().to_le_bytes()).unwrap();
+    }
+}
+
+fn benchmark_inmem_build(c: &mut Criterion) {
+    let data_path = std::env::temp_dir().join("diskann_inmem_build_bench.bin");
+    let data_path = data_path.to_str().unwrap().to_string();
+    write_random_data(&data_path);
+
+    let mut group = c.benchmark_group("inmem-build");
+    group.measurement_time(Duration::from_secs(30)).sample_size(10);
+    group.throughput(Throughput::Elements(NUM_POINTS as u64));
+
+    let mut thread_counts = vec![1, 4, 16];
+    let num_cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    if !thread_counts.contains(&num_cores) {
+        thread_counts.push(num_cores);
+    }
+
+    for num_threads in thread_counts {
+        let pool = rayon::ThreadPoolBuilder::new().num_threads(num_threads).build().unwrap();
+        group.bench_with_input(BenchmarkId::new("Build", num_threads), &num_threads, |f, _| {
+            f.iter_batched(
+                || {
+                    // num_threads 0 leaves the thread count to the installed pool
+                    let index_write_parameters = IndexWriteParametersBuilder::new(L, R).with_alpha(1.2).build();
+                    let config = IndexConfiguration::new(
+                        Metric::L2,
+                        DIM,
+                        DIM,
+                        NUM_POINTS,
+                        false,
+                        0,
+                        false,
+                        0,
+                        1f32,
+                        index_write_parameters,
+                    );
+                    create_inmem_index::<f32>(config).unwrap()
+                },
+                |mut index| pool.install(|| index.build(&data_path, NUM_POINTS).unwrap()),
+                BatchSize::PerIteration,
+            );
+        });
+    }
+
+    group.finish();
+    std::fs::remove_file(&data_path).ok();
+}
+
+criterion_group!(benches, benchmark_inmem_build);
+criterion_main!(benches);
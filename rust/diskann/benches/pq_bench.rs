@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+use std::time::Duration;
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use diskann::model::{pq_dist_lookup_into, NUM_PQ_CENTROIDS};
+use rand::rngs::StdRng;
+use rand::{Rng, SeedableRng};
+
+/// Nodes looked up per call, about the neighbors of a node in a search
+const NUM_POINTS: usize = 128;
+
+fn benchmark_pq_dist_lookup(c: &mut Criterion) {
+    let mut rng = StdRng::seed_from_u64(73);
+    let mut group = c.benchmark_group("pq-dist-lookup");
+    group.measurement_time(Duration::from_secs(3)).sample_size(200);
+    group.throughput(Throughput::Elements(NUM_POINTS as u64));
+
+    for num_chunks in [8, 16, 32, 64, 128] {
+        let pq_ids: Vec<u8> = (0..NUM_POINTS * num_chunks).map(|_| rng.gen()).collect();
+        let pq_dists: Vec<f32> = (0..NUM_PQ_CENTROIDS * num_chunks).map(|_| rng.gen()).collect();
+        let mut dists_out = vec![0.0f32; NUM_POINTS];
+
+        group.bench_with_input(BenchmarkId::new("PQ Dist Lookup", num_chunks), &num_chunks, |f, &num_chunks| {
+            f.iter(|| {
+                pq_dist_lookup_into(&pq_ids, NUM_POINTS, num_chunks, &pq_dists, &mut dists_out);
+                black_box(&dists_out);
+            });
+        });
+    }
+
+    group.finish();
+}
+
+criterion_group!(benches, benchmark_pq_dist_lookup);
+criterion_main!(benches);
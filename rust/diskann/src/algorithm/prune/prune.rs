@@ -90,6 +90,13 @@ where
                                 occlude_factor[j].max(neighbor2.distance / djk)
                             };
                         }
+                        Metric::InnerProduct => {
+                            // distances are negated inner products, so occlude neighbor2 when
+                            // neighbor is more similar to it than cur_alpha times the point is
+                            if -djk > cur_alpha * -neighbor2.distance {
+                                occlude_factor[j] = occlude_factor[j].max(cur_alpha + 0.01);
+                            }
+                        }
                     }
                 }
             }
@@ -281,8 +288,7 @@ where
         // vertex contains a vector of the neighbors of vertex_id
         let mut vertex_guard = self.final_graph.write_vertex_and_neighbors(vertex_id)?;
 
-        vertex_guard.set_neighbors(new_out_neighbors);
-        Ok(())
+        vertex_guard.set_neighbors(&new_out_neighbors)
     }
 }
 
@@ -214,7 +214,6 @@ mod search_test {
     use vector::Metric;
 
     use crate::model::configuration::index_write_parameters::IndexWriteParametersBuilder;
-    use crate::model::graph::AdjacencyList;
     use crate::model::IndexConfiguration;
     use crate::test_utils::inmem_index_initialization::create_index_with_test_data;
 
@@ -293,7 +292,8 @@ mod search_test {
             .final_graph
             .write_vertex_and_neighbors(vertex_id)
             .unwrap()
-            .set_neighbors(AdjacencyList::from(neighbors));
+            .set_neighbors(&neighbors)
+            .unwrap();
     }
     #[test]
     fn search_for_point_works_with_edges() {
@@ -7,6 +7,7 @@
 //! Aligned allocator
 
 use std::alloc::Layout;
+use std::fs::File;
 use std::ops::{Deref, DerefMut, Range};
 use std::ptr::copy_nonoverlapping;
 
@@ -20,13 +21,25 @@ use super::{ANNResult, ANNError};
 /// and frees it when dropped. It also implements Deref and DerefMut to allow access
 /// to the underlying slice.
 pub struct AlignedBoxWithSlice<T> {
-    /// The layout of the allocated memory.
-    layout: Layout,
+    /// Where the memory comes from.
+    backing: Backing,
 
     /// The slice that points to the allocated memory.
     val: Box<[T]>,
 }
 
+#[derive(Debug)]
+enum Backing {
+    /// Allocated from the global allocator with this layout.
+    Heap(Layout),
+
+    /// Mapped by `map_file`, this many bytes.
+    Mapped(usize),
+}
+
+/// Size of the pages `map_file` maps files in.
+pub const MAP_PAGE_SIZE: usize = 4096;
+
 impl<T> AlignedBoxWithSlice<T> {
     /// Creates a new `AlignedBoxWithSlice` with the given capacity and alignment.
     /// The allocated memory are set to 0.
@@ -52,7 +65,107 @@ impl<T> AlignedBoxWithSlice<T> {
             std::boxed::Box::from_raw(slice)
         };
 
-        Ok(Self { layout, val })
+        Ok(Self { backing: Backing::Heap(layout), val })
+    }
+
+    /// Creates an `AlignedBoxWithSlice` of the given capacity over the file, from file_offset on,
+    /// without reading it: the pages are mapped copy-on-write, so that they come from the page cache
+    /// as they are first touched, and processes mapping the same file share them until they write
+    /// to them. With populate set, the pages are faulted in before returning instead. Elements past
+    /// the end of the file are 0. The slice is aligned to MAP_PAGE_SIZE.
+    ///
+    /// The file holds the elements as they are in memory, and must not be truncated while mapped.
+    /// Elsewhere than on Linux, the file is read into memory instead.
+    ///
+    /// # Error
+    ///
+    /// Return IndexError if file_offset is not a multiple of MAP_PAGE_SIZE, and IOError if the file
+    /// cannot be opened or mapped.
+    pub fn map_file(filename: &str, file_offset: u64, capacity: usize, populate: bool) -> ANNResult<Self> {
+        if file_offset % MAP_PAGE_SIZE as u64 != 0 {
+            return Err(ANNError::log_index_error(format!(
+                "Cannot map {} from offset {}, which is not a multiple of {}",
+                filename, file_offset, MAP_PAGE_SIZE
+            )));
+        }
+        let len = capacity.checked_mul(std::mem::size_of::<T>())
+            .ok_or_else(|| ANNError::log_index_error("capacity overflow".to_string()))?;
+        let file = File::open(filename)?;
+        let file_len = file.metadata()?.len().saturating_sub(file_offset);
+        let file_bytes = len.min(file_len.try_into().unwrap_or(usize::MAX));
+        if len == 0 {
+            return Self::new(capacity, MAP_PAGE_SIZE);
+        }
+
+        Self::map(&file, file_offset, len, file_bytes, populate)
+    }
+
+    #[cfg(target_os = "linux")]
+    fn map(file: &File, file_offset: u64, len: usize, file_bytes: usize, populate: bool) -> ANNResult<Self> {
+        use std::os::unix::io::AsRawFd;
+
+        // the whole capacity is reserved as zeroed anonymous memory first, and the file mapped over
+        // its start, so that the elements past the end of the file can be touched
+        let base = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_NORESERVE,
+                -1,
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            return Err(ANNError::log_io_error(std::io::Error::last_os_error()));
+        }
+
+        if file_bytes > 0 {
+            let flags = libc::MAP_PRIVATE | libc::MAP_FIXED | if populate { libc::MAP_POPULATE } else { 0 };
+            let mapped = unsafe {
+                libc::mmap(
+                    base,
+                    file_bytes,
+                    libc::PROT_READ | libc::PROT_WRITE,
+                    flags,
+                    file.as_raw_fd(),
+                    file_offset as libc::off_t,
+                )
+            };
+            if mapped == libc::MAP_FAILED {
+                let err = std::io::Error::last_os_error();
+                unsafe { libc::munmap(base, len) };
+                return Err(ANNError::log_io_error(err));
+            }
+            if !populate {
+                // searches touch the elements in no particular order, so read ahead no further than
+                // the page that faulted
+                unsafe { libc::madvise(base, file_bytes, libc::MADV_RANDOM) };
+            }
+        }
+
+        let val = unsafe {
+            let slice = std::slice::from_raw_parts_mut(base as *mut T, len / std::mem::size_of::<T>());
+            std::boxed::Box::from_raw(slice)
+        };
+        Ok(Self { backing: Backing::Mapped(len), val })
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    fn map(file: &File, file_offset: u64, len: usize, file_bytes: usize, _populate: bool) -> ANNResult<Self> {
+        use std::io::{Read, Seek, SeekFrom};
+
+        let mut data = Self::new(len / std::mem::size_of::<T>(), MAP_PAGE_SIZE)?;
+        let bytes = unsafe { std::slice::from_raw_parts_mut(data.val.as_mut_ptr() as *mut u8, file_bytes) };
+        let mut file = file;
+        file.seek(SeekFrom::Start(file_offset))?;
+        file.read_exact(bytes)?;
+        Ok(data)
+    }
+
+    /// Whether the memory is a mapping of a file made by `map_file`.
+    pub fn is_mapped(&self) -> bool {
+        matches!(self.backing, Backing::Mapped(_))
     }
 
     /// Returns a reference to the slice.
@@ -121,9 +234,17 @@ impl<T> Drop for AlignedBoxWithSlice<T> {
         let mut val2 = std::mem::ManuallyDrop::new(val);
         let ptr = val2.as_mut_ptr();
 
-        unsafe {
-            // let nonNull = NonNull::new_unchecked(ptr as *mut u8);
-            std::alloc::dealloc(ptr as *mut u8, self.layout)
+        match self.backing {
+            Backing::Heap(layout) => unsafe {
+                // let nonNull = NonNull::new_unchecked(ptr as *mut u8);
+                std::alloc::dealloc(ptr as *mut u8, layout)
+            },
+            #[cfg(target_os = "linux")]
+            Backing::Mapped(len) => unsafe {
+                libc::munmap(ptr as *mut libc::c_void, len);
+            },
+            #[cfg(not(target_os = "linux"))]
+            Backing::Mapped(_) => {}
         }
     }
 }
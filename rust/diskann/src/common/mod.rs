@@ -3,7 +3,7 @@
  * Licensed under the MIT license.
  */
 mod aligned_allocator;
-pub use aligned_allocator::AlignedBoxWithSlice;
+pub use aligned_allocator::{AlignedBoxWithSlice, MAP_PAGE_SIZE};
 
 mod ann_result;
 pub use ann_result::*;
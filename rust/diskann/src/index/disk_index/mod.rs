@@ -7,3 +7,8 @@ mod disk_index;
 pub use disk_index::DiskIndex;
 
 pub mod ann_disk_index;
+
+#[cfg(target_os = "linux")]
+mod pq_flash_index;
+#[cfg(target_os = "linux")]
+pub use pq_flash_index::PQFlashIndex;
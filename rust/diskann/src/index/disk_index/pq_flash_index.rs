@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+#![warn(missing_docs)]
+
+//! Disk index search, the counterpart of the C++ PQFlashIndex
+
+use std::cmp::Ordering;
+use std::mem;
+use std::sync::Arc;
+use std::time::Duration;
+
+use rayon::prelude::*;
+use vector::{FullPrecisionDistance, Metric};
+
+use crate::common::{ANNError, ANNResult};
+use crate::model::graph::DiskGraph;
+use crate::model::{
+    pq_dist_lookup_into, ArcConcurrentBoxedQueue, FixedChunkPQTable, LinuxAlignedFileReader, Neighbor,
+    NeighborPriorityQueue, PQScratch, SSDQueryScratch, SSDSearchScratch, ScratchStoreManager, Vertex,
+    MAX_GRAPH_DEGREE, MAX_N_SECTOR_READS, MAX_PQ_CHUNKS, SECTOR_LEN,
+};
+use crate::storage::{load_pq_pivots_bin, DiskGraphStorage};
+use crate::utils::load_bin;
+
+/// Time to wait for a scratch to be returned to the pool before checking again
+const SCRATCH_WAIT_TIME: Duration = Duration::from_millis(10);
+
+/// Number of u64 values in the metadata at the start of the disk index file
+const DISK_LAYOUT_META_LEN: usize = 9;
+
+/// Initial capacity of the visited set of each scratch
+const VISITED_RESERVE: usize = 4096;
+
+/// Searches a disk index built by DiskIndex, reading the graph with io_uring.
+/// The layout and the search follow the C++ PQFlashIndex: the PQ codes of all points are kept in
+/// memory to rank candidates, and each step reads the sectors of up to beam_width of the closest
+/// unvisited candidates, whose full precision vectors give the final ranking.
+/// Searches may run concurrently on up to num_threads threads, each on its own pooled scratch.
+pub struct PQFlashIndex<T, const N: usize>
+where
+    T: Default + Copy,
+    [T; N]: FullPrecisionDistance<T, N>,
+{
+    /// Number of points in the index
+    num_points: usize,
+
+    /// Dimension of the vectors
+    dim: usize,
+
+    /// Entry point of the search
+    medoid: u32,
+
+    /// Frozen point, which is left out of the results
+    frozen_point: Option<u32>,
+
+    /// Number of PQ chunks of each point
+    num_pq_chunks: usize,
+
+    /// PQ codes of all points: num_points * num_pq_chunks
+    pq_codes: Vec<u8>,
+
+    /// PQ pivots
+    pq_table: FixedChunkPQTable,
+
+    /// Largest search list size and beam width the scratches are allocated for
+    max_search_l: usize,
+    max_beam_width: usize,
+
+    /// Scratches of the searches, one per thread
+    scratch_pool: ArcConcurrentBoxedQueue<SSDSearchScratch<T, N>>,
+}
+
+impl<T, const N: usize> PQFlashIndex<T, N>
+where
+    T: Default + Copy + Sync + Send + Into<f32>,
+    [T; N]: FullPrecisionDistance<T, N>,
+{
+    /// Load the disk index at index_path_prefix for searches on up to num_threads threads with
+    /// search lists of up to max_search_l and beams of up to max_beam_width
+    pub fn load(
+        index_path_prefix: &str,
+        num_threads: usize,
+        max_search_l: usize,
+        max_beam_width: usize,
+    ) -> ANNResult<Self> {
+        if num_threads == 0 || max_search_l == 0 || max_beam_width == 0 || max_beam_width > MAX_N_SECTOR_READS {
+            return Err(ANNError::log_index_config_error(
+                "PQFlashIndex::load".to_string(),
+                format!(
+                    "num_threads {} and max_search_l {} must be positive and max_beam_width {} in [1, {}]",
+                    num_threads, max_search_l, max_beam_width, MAX_N_SECTOR_READS
+                ),
+            ));
+        }
+
+        let disk_index_file = index_path_prefix.to_string() + "_disk.index";
+        let (meta, meta_len, _) = load_bin::<u64>(&disk_index_file, 0)?;
+        if meta_len < DISK_LAYOUT_META_LEN {
+            return Err(ANNError::log_index_error(format!(
+                "Disk index {} has {} metadata values, expecting {}",
+                disk_index_file, meta_len, DISK_LAYOUT_META_LEN
+            )));
+        }
+
+        let num_points = meta[0] as usize;
+        let dim = meta[1] as usize;
+        let medoid = meta[2] as u32;
+        let max_node_len = meta[3];
+        let num_nodes_per_sector = meta[4];
+        let frozen_point = if meta[5] == 1 { Some(meta[6] as u32) } else { None };
+        if medoid as usize >= num_points {
+            return Err(ANNError::log_index_error(format!(
+                "Disk index medoid {} is out of range for {} points",
+                medoid, num_points
+            )));
+        }
+        if dim > N {
+            return Err(ANNError::log_index_error(format!(
+                "Disk index dim {} is greater than aligned dim {}",
+                dim, N
+            )));
+        }
+        if num_nodes_per_sector == 0 || max_node_len > SECTOR_LEN as u64 {
+            return Err(ANNError::log_index_error(format!(
+                "Nodes of {} bytes do not fit in a sector; only indices with nodes of up to {} bytes are supported",
+                max_node_len, SECTOR_LEN
+            )));
+        }
+
+        let (pq_codes, pq_num_points, num_pq_chunks) =
+            load_bin::<u8>(&(index_path_prefix.to_string() + ".bin_pq_compressed.bin"), 0)?;
+        if num_pq_chunks == 0 || num_pq_chunks > MAX_PQ_CHUNKS {
+            return Err(ANNError::log_pq_error(format!(
+                "PQ codes have {} chunks, expecting 1 to {}",
+                num_pq_chunks, MAX_PQ_CHUNKS
+            )));
+        }
+        if pq_num_points != num_points {
+            return Err(ANNError::log_pq_error(format!(
+                "PQ codes cover {} points, but the disk index has {}",
+                pq_num_points, num_points
+            )));
+        }
+        let pq_table = load_pq_pivots_bin(
+            &(index_path_prefix.to_string() + ".bin_pq_pivots.bin"),
+            &num_pq_chunks,
+        )?
+        .into_pq_table(num_pq_chunks);
+
+        let reader = Arc::new(LinuxAlignedFileReader::new(&disk_index_file)?);
+        let fp_vector_len = (dim * mem::size_of::<T>()) as u64;
+        let scratch_pool = ArcConcurrentBoxedQueue::new();
+        for _ in 0..num_threads {
+            let query_scratch = SSDQueryScratch::<T, N>::new(VISITED_RESERVE, max_search_l, true)?;
+            let graph = DiskGraph::new(
+                dim,
+                num_nodes_per_sector,
+                max_node_len,
+                fp_vector_len,
+                max_beam_width,
+                DiskGraphStorage::new(reader.clone())?,
+            )?;
+            scratch_pool.push(Box::new(SSDSearchScratch::new(query_scratch, graph)))?;
+        }
+
+        Ok(Self {
+            num_points,
+            dim,
+            medoid,
+            frozen_point,
+            num_pq_chunks,
+            pq_codes,
+            pq_table,
+            max_search_l,
+            max_beam_width,
+            scratch_pool,
+        })
+    }
+
+    /// Number of points in the index
+    pub fn num_points(&self) -> usize {
+        self.num_points
+    }
+
+    /// Search the k nearest neighbors of query with a search list of size l, reading up to
+    /// beam_width nodes per round trip to the disk. Writes the ids and L2 distances of the
+    /// neighbors, closest first, and returns their number.
+    pub fn search(
+        &self,
+        query: &[T],
+        k: usize,
+        l: usize,
+        beam_width: usize,
+        indices: &mut [u32],
+        distances: &mut [f32],
+    ) -> ANNResult<usize> {
+        if k == 0 || l < k || l > self.max_search_l || beam_width == 0 || beam_width > self.max_beam_width {
+            return Err(ANNError::log_index_config_error(
+                "search".to_string(),
+                format!(
+                    "k {} and l {} must satisfy 0 < k <= l <= {}, and beam_width {} must be in [1, {}]",
+                    k, l, self.max_search_l, beam_width, self.max_beam_width
+                ),
+            ));
+        }
+        if query.len() < self.dim || indices.len() < k || distances.len() < k {
+            return Err(ANNError::log_index_error(format!(
+                "search: query of dim {} and output of size {} are too small for dim {} and k {}",
+                query.len(), indices.len().min(distances.len()), self.dim, k
+            )));
+        }
+
+        let mut scratch_manager = ScratchStoreManager::new(self.scratch_pool.clone(), SCRATCH_WAIT_TIME)?;
+        let scratch = scratch_manager.scratch_space().ok_or_else(|| {
+            ANNError::log_index_error("search: no scratch space available".to_string())
+        })?;
+        let SSDSearchScratch { query_scratch, graph } = scratch;
+        let SSDQueryScratch {
+            scratch_dataset,
+            query: aligned_query,
+            id_scratch,
+            pq_scratch,
+            best_candidates,
+            full_return_set,
+            ..
+        } = query_scratch;
+        let pq_scratch = pq_scratch.as_deref_mut().ok_or_else(|| {
+            ANNError::log_index_error("search: the scratch has no PQ scratch".to_string())
+        })?;
+
+        aligned_query.fill(T::default());
+        aligned_query[..self.dim].copy_from_slice(&query[..self.dim]);
+        let query_vertex = Vertex::<T, N>::try_from((&aligned_query[..N], u32::MAX))
+            .map_err(ANNError::log_try_from_slice_error)?;
+
+        let mut query_f32: Vec<f32> = query[..self.dim].iter().map(|&v| v.into()).collect();
+        self.pq_table.preprocess_query(&mut query_f32);
+        let pq_dists = self.pq_table.populate_chunk_distances(&query_f32);
+
+        best_candidates.reserve(l);
+        best_candidates.set_capacity(l);
+        id_scratch.insert(self.medoid);
+        let mut new_neighbors = Vec::with_capacity(MAX_GRAPH_DEGREE);
+        new_neighbors.push(self.medoid);
+        self.insert_pq_candidates(&new_neighbors, &pq_dists, pq_scratch, best_candidates);
+
+        while best_candidates.has_notvisited_node() {
+            graph.reset();
+            let mut num_to_fetch = 0;
+            while num_to_fetch < beam_width && best_candidates.has_notvisited_node() {
+                graph.add_vertex(best_candidates.closest_notvisited().id);
+                num_to_fetch += 1;
+            }
+            graph.fetch_nodes()?;
+
+            for item in &*graph {
+                let (node_index, vertex_and_neighbors) = item?;
+                let vertex = graph.copy_fp_vector_to_disk_scratch_dataset::<T, N>(node_index, scratch_dataset)?;
+                full_return_set.push(Neighbor::new(
+                    vertex.vertex_id(),
+                    vertex.compare(&query_vertex, Metric::L2),
+                ));
+
+                new_neighbors.clear();
+                for &neighbor_id in vertex_and_neighbors.get_neighbors().iter() {
+                    if (neighbor_id as usize) < self.num_points && id_scratch.insert(neighbor_id) {
+                        new_neighbors.push(neighbor_id);
+                    }
+                }
+                self.insert_pq_candidates(&new_neighbors, &pq_dists, pq_scratch, best_candidates);
+            }
+        }
+
+        full_return_set.sort_unstable_by(|a, b| a.distance.partial_cmp(&b.distance).unwrap_or(Ordering::Equal));
+        let mut num_results = 0;
+        for neighbor in full_return_set.iter() {
+            if num_results == k {
+                break;
+            }
+            if Some(neighbor.id) == self.frozen_point {
+                continue;
+            }
+            indices[num_results] = neighbor.id;
+            distances[num_results] = neighbor.distance;
+            num_results += 1;
+        }
+
+        Ok(num_results)
+    }
+
+    /// Search num_queries queries, stored one after the other with dim values each, in parallel.
+    /// Writes k ids and distances per query, padded with u32::MAX and f32::MAX past the number of
+    /// results of the query.
+    pub fn search_batch(
+        &self,
+        queries: &[T],
+        k: usize,
+        l: usize,
+        beam_width: usize,
+        indices: &mut [u32],
+        distances: &mut [f32],
+    ) -> ANNResult<()> {
+        let num_queries = queries.len() / self.dim;
+        if indices.len() < num_queries * k || distances.len() < num_queries * k {
+            return Err(ANNError::log_index_error(format!(
+                "search_batch: output of size {} is too small for {} queries of {} results",
+                indices.len().min(distances.len()), num_queries, k
+            )));
+        }
+
+        queries
+            .par_chunks_exact(self.dim)
+            .zip(indices.par_chunks_mut(k))
+            .zip(distances.par_chunks_mut(k))
+            .try_for_each(|((query, query_indices), query_distances)| {
+                let num_results = self.search(query, k, l, beam_width, query_indices, query_distances)?;
+                query_indices[num_results..].fill(u32::MAX);
+                query_distances[num_results..].fill(f32::MAX);
+                Ok(())
+            })
+    }
+
+    /// Insert ids into best_candidates at their PQ distances to the query whose chunk distances are
+    /// pq_dists. The PQ codes of the ids are gathered into the PQ scratch and looked up together.
+    fn insert_pq_candidates(
+        &self,
+        ids: &[u32],
+        pq_dists: &[f32],
+        pq_scratch: &mut PQScratch,
+        best_candidates: &mut NeighborPriorityQueue,
+    ) {
+        let num_pq_chunks = self.num_pq_chunks;
+        for batch in ids.chunks(MAX_GRAPH_DEGREE) {
+            let codes = &mut pq_scratch.aligned_pq_coord_scratch[..batch.len() * num_pq_chunks];
+            for (id, point_codes) in batch.iter().zip(codes.chunks_exact_mut(num_pq_chunks)) {
+                let first = *id as usize * num_pq_chunks;
+                point_codes.copy_from_slice(&self.pq_codes[first..first + num_pq_chunks]);
+            }
+
+            let distances = &mut pq_scratch.aligned_dist_scratch[..batch.len()];
+            pq_dist_lookup_into(codes, batch.len(), num_pq_chunks, pq_dists, distances);
+            for (&id, &distance) in batch.iter().zip(distances.iter()) {
+                best_candidates.insert(Neighbor::new(id, distance));
+            }
+        }
+    }
+}
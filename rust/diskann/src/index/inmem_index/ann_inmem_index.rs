@@ -26,6 +26,15 @@ where T : Default + Copy + Sync + Send + Into<f32>
     /// Load index
     fn load(&mut self, filename: &str, expected_num_points: usize) -> ANNResult<()>;
 
+    /// Save index to {filename}.mapped_data and {filename}.mapped_graph in the layout it has in
+    /// memory, for load_mapped
+    fn save_mapped(&mut self, filename: &str) -> ANNResult<()>;
+
+    /// Load index saved by save_mapped by mapping its files copy-on-write rather than reading them,
+    /// so that it is ready at once and processes serving the same files share their pages. Pages
+    /// are read as searches first touch them, or all before returning with populate set.
+    fn load_mapped(&mut self, filename: &str, expected_num_points: usize, populate: bool) -> ANNResult<()>;
+
     /// insert index
     fn insert(&mut self, filename: &str, num_points_to_insert: usize) -> ANNResult<()>;
 
@@ -114,7 +114,7 @@ where
 
         if self.query_scratch_queue.size()? == 0 {
             self.initialize_query_scratch(
-                5 + self.configuration.index_write_parameter.num_threads,
+                5 + self.num_build_threads(),
                 self.configuration.index_write_parameter.search_list_size,
             )?;
         }
@@ -196,11 +196,15 @@ where
         vertex_id: u32,
         scratch: &mut InMemQueryScratch<T, N>,
     ) -> Result<(), ANNError> {
-        let vertex = self.final_graph.read_vertex_and_neighbors(vertex_id)?;
-        assert!(vertex.size() <= self.configuration.index_write_parameter.max_degree as usize);
+        // Copy the neighbors out, as inter_insert locks them and they may share a lock with vertex_id
+        let neighbors = {
+            let vertex = self.final_graph.read_vertex_and_neighbors(vertex_id)?;
+            assert!(vertex.size() <= self.configuration.index_write_parameter.max_degree as usize);
+            vertex.get_neighbors().to_vec()
+        };
         self.inter_insert(
             vertex_id,
-            vertex.get_neighbors(),
+            &neighbors,
             self.configuration.index_write_parameter.max_degree,
             scratch,
         )?;
@@ -213,7 +217,7 @@ where
         new_neighbors: AdjacencyList,
     ) -> Result<(), ANNError> {
         let vertex = &mut self.final_graph.write_vertex_and_neighbors(vertex_id)?;
-        vertex.set_neighbors(new_neighbors);
+        vertex.set_neighbors(&new_neighbors)?;
         assert!(vertex.size() <= self.configuration.index_write_parameter.max_degree as usize);
         Ok(())
     }
@@ -351,9 +355,7 @@ where
 
                 self.final_graph
                     .write_vertex_and_neighbors(vertex_id)?
-                    .set_neighbors(new_out_neighbors);
-
-                Ok(())
+                    .set_neighbors(&new_out_neighbors)
             },
         )
     }
@@ -385,7 +387,7 @@ where
     /// Returns an `ANNError` if there is an error retrieving the vertex or one of its neighbors.
     pub fn get_unique_neighbors(
         &self,
-        neighbors: &Vec<u32>,
+        neighbors: &[u32],
         vertex_id: u32,
     ) -> Result<Vec<Neighbor>, ANNError> {
         let vertex = self.dataset.get_vertex(vertex_id)?;
@@ -487,6 +489,17 @@ where
         Ok(())
     }
 
+    /// Threads that may take a scratch at once: rayon uses every logical core when
+    /// num_threads is 0, so the pool must cover the current rayon pool as well.
+    /// Reading the rayon pool size starts the global pool, so set its thread
+    /// count before calling this.
+    fn num_build_threads(&self) -> u32 {
+        self.configuration
+            .index_write_parameter
+            .num_threads
+            .max(rayon::current_num_threads() as u32)
+    }
+
     fn initialize_query_scratch(
         &mut self,
         num_threads: u32,
@@ -647,13 +660,6 @@ where
             todo!("PQ is not supported now");
         }
 
-        if self.query_scratch_queue.size()? == 0 {
-            self.initialize_query_scratch(
-                5 + self.configuration.index_write_parameter.num_threads,
-                self.configuration.index_write_parameter.search_list_size,
-            )?;
-        }
-
         if self.configuration.index_write_parameter.num_threads > 0 {
             // set the thread count of Rayon, otherwise it will use threads as many as logical cores.
             std::env::set_var(
@@ -665,6 +671,13 @@ where
             );
         }
 
+        if self.query_scratch_queue.size()? == 0 {
+            self.initialize_query_scratch(
+                5 + self.num_build_threads(),
+                self.configuration.index_write_parameter.search_list_size,
+            )?;
+        }
+
         self.dataset
             .append_from_file(filename, num_points_to_insert)?;
         self.final_graph.extend(
@@ -728,7 +741,48 @@ where
 
         if self.query_scratch_queue.size()? == 0 {
             self.initialize_query_scratch(
-                5 + self.configuration.index_write_parameter.num_threads,
+                5 + self.num_build_threads(),
+                self.configuration.index_write_parameter.search_list_size,
+            )?;
+        }
+
+        Ok(())
+    }
+
+    fn save_mapped(&mut self, filename: &str) -> ANNResult<()> {
+        let data_file = filename.to_string() + ".mapped_data";
+        let graph_file = filename.to_string() + ".mapped_graph";
+        let delete_file = filename.to_string() + ".delete";
+
+        self.save_mapped_graph(graph_file.as_str())?;
+        self.save_mapped_data(data_file.as_str())?;
+        self.save_delete_list(delete_file.as_str())?;
+
+        Ok(())
+    }
+
+    fn load_mapped(
+        &mut self,
+        filename: &str,
+        expected_num_points: usize,
+        populate: bool,
+    ) -> ANNResult<()> {
+        self.num_active_pts = expected_num_points;
+        self.load_mapped_graph(
+            &format!("{}.mapped_graph", filename),
+            expected_num_points,
+            populate,
+        )?;
+        self.load_mapped_data(
+            &format!("{}.mapped_data", filename),
+            expected_num_points,
+            populate,
+        )?;
+        self.load_delete_list(&format!("{}.delete", filename))?;
+
+        if self.query_scratch_queue.size()? == 0 {
+            self.initialize_query_scratch(
+                5 + self.num_build_threads(),
                 self.configuration.index_write_parameter.search_list_size,
             )?;
         }
@@ -777,7 +831,7 @@ where
 
 #[cfg(test)]
 mod index_test {
-    use vector::Metric;
+    use vector::{BFloat16, Metric};
 
     use super::*;
     use crate::{
@@ -785,7 +839,7 @@ mod index_test {
             configuration::index_write_parameters::IndexWriteParametersBuilder, vertex::DIM_128,
         },
         test_utils::get_test_file_path,
-        utils::file_util::load_ids_to_delete_from_file,
+        utils::file_util::{load_bin, load_ids_to_delete_from_file},
         utils::round_up,
     };
 
@@ -886,6 +940,62 @@ mod index_test {
         }
     }
 
+    /// Build bf16 indices of TEST_DATA_FILE, with each metric bf16 supports, and search for a point
+    #[test]
+    fn index_end_to_end_test_bf16() {
+        let (data, data_num, dim) =
+            load_bin::<f32>(get_test_file_path(TEST_DATA_FILE).as_str(), 0).unwrap();
+        let bf16_file = "index_end_to_end_test_bf16.bin";
+        let mut bytes = Vec::with_capacity(8 + data.len() * 2);
+        bytes.extend_from_slice(&(data_num as u32).to_le_bytes());
+        bytes.extend_from_slice(&(dim as u32).to_le_bytes());
+        for value in data {
+            bytes.extend_from_slice(&half::bf16::from_f32(value).to_le_bytes());
+        }
+        std::fs::write(bf16_file, bytes).unwrap();
+
+        for metric in [Metric::L2, Metric::InnerProduct] {
+            let index_write_parameters = IndexWriteParametersBuilder::new(L, R)
+                .with_alpha(ALPHA)
+                .with_num_threads(8)
+                .build();
+            let config = IndexConfiguration::new(
+                metric,
+                dim,
+                round_up(dim as u64, 16_u64) as usize,
+                data_num,
+                false,
+                0,
+                false,
+                0,
+                1f32,
+                index_write_parameters,
+            );
+            let mut index: InmemIndex<BFloat16, DIM_128> = InmemIndex::new(config).unwrap();
+            index.build(bf16_file, data_num).unwrap();
+
+            for i in 0..data_num {
+                assert_ne!(
+                    index
+                        .final_graph
+                        .read_vertex_and_neighbors(i as u32)
+                        .unwrap()
+                        .size(),
+                    0
+                );
+            }
+
+            if metric == Metric::L2 {
+                let query = index.dataset.get_vertex(7).unwrap();
+                let mut indices = [0u32; 1];
+                index.search(&query, 1, L, &mut indices).unwrap();
+                assert_eq!(indices[0], 7);
+            }
+        }
+
+        std::fs::remove_file(bf16_file).expect("Failed to delete file");
+    }
+
     const TEST_DATA_FILE_2: &str = "tests/data/siftsmall_learn_256pts_2.fbin";
     const INSERT_TRUTH_GRAPH: &str =
         "tests/data/truth_index_siftsmall_learn_256pts_1+2_R4_L50_A1.2";
@@ -4,13 +4,13 @@
  */
 use std::fs::File;
 use std::io::{BufReader, BufWriter, Seek, SeekFrom, Write};
+use std::mem;
 use std::path::Path;
 
 use byteorder::{LittleEndian, ReadBytesExt};
 use vector::FullPrecisionDistance;
 
-use crate::common::{ANNError, ANNResult};
-use crate::model::graph::AdjacencyList;
+use crate::common::{ANNError, ANNResult, MAP_PAGE_SIZE};
 use crate::model::InMemoryGraph;
 use crate::utils::{file_exists, save_data_in_base_dimensions};
 
@@ -96,7 +96,7 @@ where
 
             self.final_graph
                 .write_vertex_and_neighbors(nodes_read - 1)?
-                .set_neighbors(AdjacencyList::from(tmp));
+                .set_neighbors(&tmp)?;
             bytes_read += 4 * (num_nbrs as usize + 1);
         }
 
@@ -201,6 +201,128 @@ where
         Ok(delete_file_size)
     }
 
+    /// Save the first num_active_pts + num_frozen_pts points of the data in the layout they have in
+    /// memory, for `load_mapped_data`: a header page of {npts: u32, dim: u32, aligned_dim: u32},
+    /// zero padded to MAP_PAGE_SIZE, followed by npts rows of aligned_dim elements. The header
+    /// starts like that of a data file, so `load_metadata_from_file` reads it.
+    pub fn save_mapped_data(&mut self, data_file: &str) -> ANNResult<usize> {
+        let num_points = self.num_active_pts + self.configuration.num_frozen_pts;
+        let mut out = BufWriter::new(File::create(data_file)?);
+
+        let mut header = vec![0u8; MAP_PAGE_SIZE];
+        header[0..4].copy_from_slice(&(num_points as u32).to_le_bytes());
+        header[4..8].copy_from_slice(&(self.configuration.dim as u32).to_le_bytes());
+        header[8..12].copy_from_slice(&(N as u32).to_le_bytes());
+        out.write_all(&header)?;
+
+        let rows = &self.dataset.data[..num_points * N];
+        // Safety: the rows are plain elements, written as they are in memory
+        let bytes = unsafe { std::slice::from_raw_parts(rows.as_ptr() as *const u8, mem::size_of_val(rows)) };
+        out.write_all(bytes)?;
+        out.flush()?;
+        Ok(header.len() + bytes.len())
+    }
+
+    /// Map the data saved by `save_mapped_data`, which must hold expected_num_points points of the
+    /// dimensions of the index.
+    pub fn load_mapped_data(&mut self, data_file: &str, expected_num_points: usize, populate: bool) -> ANNResult<()> {
+        let mut reader = BufReader::new(File::open(data_file)?);
+        let num_points = reader.read_u32::<LittleEndian>()? as usize;
+        let dim = reader.read_u32::<LittleEndian>()? as usize;
+        let aligned_dim = reader.read_u32::<LittleEndian>()? as usize;
+        if num_points != expected_num_points || dim != self.configuration.dim || aligned_dim != N {
+            return Err(ANNError::log_index_config_error(
+                "data_file".to_string(),
+                format!(
+                    "{} holds {} points of {} dimensions aligned to {}, but {} points of {} dimensions aligned to {} were expected",
+                    data_file, num_points, dim, aligned_dim, expected_num_points, self.configuration.dim, N
+                ),
+            ));
+        }
+
+        // room for the points the index may grow to, as the dataset of `new` has
+        let total_internal_points = self.configuration.max_points + self.configuration.num_frozen_pts;
+        self.dataset.capacity = self.dataset.capacity.max(total_internal_points * N);
+        self.dataset
+            .map_from_file(data_file, MAP_PAGE_SIZE as u64, expected_num_points, populate)
+    }
+
+    /// Save the first num_active_pts + num_frozen_pts vertices of the graph in the layout of the
+    /// graph in memory, for `load_mapped_graph`: a header page of {num_vertices: u64,
+    /// slot_capacity: u64, max_observed_degree: u32, start: u32, num_frozen_pts: u64}, zero padded
+    /// to MAP_PAGE_SIZE, followed by the arena of the vertices, see `InMemoryGraph::write_arena`.
+    pub fn save_mapped_graph(&mut self, graph_file: &str) -> ANNResult<usize> {
+        let num_vertices = self.num_active_pts + self.configuration.num_frozen_pts;
+        let mut out = BufWriter::new(File::create(graph_file)?);
+
+        let mut header = vec![0u8; MAP_PAGE_SIZE];
+        header[0..8].copy_from_slice(&(num_vertices as u64).to_le_bytes());
+        header[8..16].copy_from_slice(&(self.final_graph.slot_capacity() as u64).to_le_bytes());
+        header[16..20].copy_from_slice(&self.max_observed_degree.to_le_bytes());
+        header[20..24].copy_from_slice(&self.start.to_le_bytes());
+        header[24..32].copy_from_slice(&(self.configuration.num_frozen_pts as u64).to_le_bytes());
+        out.write_all(&header)?;
+
+        self.final_graph.write_arena(&mut out, num_vertices)?;
+        out.flush()?;
+        Ok(header.len() + num_vertices * (self.final_graph.slot_capacity() + 1) * mem::size_of::<u32>())
+    }
+
+    /// Map the graph saved by `save_mapped_graph` in place of the graph of the index, and return
+    /// the number of vertices it holds.
+    pub fn load_mapped_graph(
+        &mut self,
+        graph_file: &str,
+        expected_num_points: usize,
+        populate: bool,
+    ) -> ANNResult<usize> {
+        let mut reader = BufReader::new(File::open(graph_file)?);
+        let num_vertices = reader.read_u64::<LittleEndian>()? as usize;
+        let slot_capacity = reader.read_u64::<LittleEndian>()? as usize;
+        let max_observed_degree = reader.read_u32::<LittleEndian>()?;
+        let start = reader.read_u32::<LittleEndian>()?;
+        let file_frozen_pts = reader.read_u64::<LittleEndian>()? as usize;
+
+        if file_frozen_pts != self.configuration.num_frozen_pts {
+            return Err(ANNError::log_index_config_error(
+                "num_frozen_pts".to_string(),
+                format!(
+                    "ERROR: {} has {} frozen points, but the index was configured with {}",
+                    graph_file, file_frozen_pts, self.configuration.num_frozen_pts
+                ),
+            ));
+        }
+        if num_vertices != expected_num_points {
+            return Err(ANNError::log_index_error(format!(
+                "ERROR: {} holds {} vertices, but {} points were expected",
+                graph_file, num_vertices, expected_num_points
+            )));
+        }
+
+        let expected_max_points = expected_num_points - file_frozen_pts;
+        if self.configuration.max_points < expected_max_points {
+            println!("Number of points in data: {} is greater than max_points: {} Setting max points to: {}", expected_max_points, self.configuration.max_points, expected_max_points);
+            self.configuration.max_points = expected_max_points;
+        }
+
+        println!("Mapping vamana graph {}...", graph_file);
+        self.final_graph = InMemoryGraph::map_arena(
+            graph_file,
+            MAP_PAGE_SIZE as u64,
+            self.configuration.max_points + self.configuration.num_frozen_pts,
+            slot_capacity,
+            populate,
+        )?;
+        self.start = start;
+        self.max_observed_degree = max_observed_degree;
+
+        println!(
+            "Done. Index has {} nodes, _start is set to {}",
+            num_vertices, self.start
+        );
+        Ok(num_vertices)
+    }
+
     // load the deleted list from the delete file if it exists.
     pub fn load_delete_list(&mut self, delete_list_file: &str) -> ANNResult<usize> {
         let mut len = 0;
@@ -301,4 +423,57 @@ mod index_test {
         );
         fs::remove_file(data_file).expect("Failed to delete file");
     }
+
+    #[test]
+    fn save_and_load_mapped_test() {
+        let (data_num, dim) = load_metadata_from_file(TEST_DATA_FILE).unwrap();
+        let new_config = || {
+            let index_write_parameters = IndexWriteParametersBuilder::new(L, R)
+                .with_alpha(ALPHA)
+                .build();
+            IndexConfiguration::new(
+                Metric::L2,
+                dim,
+                round_up(dim as u64, 16_u64) as usize,
+                data_num,
+                false,
+                0,
+                false,
+                0,
+                1f32,
+                index_write_parameters,
+            )
+        };
+        let mut index: InmemIndex<f32, DIM_128> = InmemIndex::new(new_config()).unwrap();
+        index.build(TEST_DATA_FILE, data_num).unwrap();
+
+        let index_file = "test_save_and_load_mapped";
+        index.save_mapped(index_file).unwrap();
+        let mut mapped: InmemIndex<f32, DIM_128> = InmemIndex::new(new_config()).unwrap();
+        mapped.load_mapped(index_file, data_num, false).unwrap();
+        fs::remove_file(format!("{}.mapped_data", index_file)).expect("Failed to delete file");
+        fs::remove_file(format!("{}.mapped_graph", index_file)).expect("Failed to delete file");
+
+        assert!(mapped.dataset.data.is_mapped());
+        assert_eq!(mapped.start, index.start);
+        assert_eq!(
+            &mapped.dataset.data[..data_num * DIM_128],
+            &index.dataset.data[..data_num * DIM_128]
+        );
+        for i in 0..data_num as u32 {
+            assert_eq!(
+                mapped.final_graph.read_vertex_and_neighbors(i).unwrap().get_neighbors(),
+                index.final_graph.read_vertex_and_neighbors(i).unwrap().get_neighbors()
+            );
+        }
+
+        // pages are copied as they are written to, rather than written back
+        mapped
+            .final_graph
+            .write_vertex_and_neighbors(0)
+            .unwrap()
+            .set_neighbors(&[1])
+            .unwrap();
+        assert_eq!(mapped.final_graph.read_vertex_and_neighbors(0).unwrap().get_neighbors(), &[1]);
+    }
 }
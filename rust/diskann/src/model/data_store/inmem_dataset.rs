@@ -71,6 +71,26 @@ where
         Ok(())
     }
 
+    /// Map the dataset from a file of rows of N elements, starting at data_offset, instead of
+    /// reading it; see `AlignedBoxWithSlice::map_file`
+    pub fn map_from_file(
+        &mut self,
+        filename: &str,
+        data_offset: u64,
+        num_points_to_load: usize,
+        populate: bool,
+    ) -> ANNResult<()> {
+        println!(
+            "Mapping {} vectors from file {} into dataset...",
+            num_points_to_load, filename
+        );
+        self.data = AlignedBoxWithSlice::map_file(filename, data_offset, self.capacity, populate)?;
+        self.num_active_pts = num_points_to_load;
+
+        println!("Dataset mapped.");
+        Ok(())
+    }
+
     /// Append the dataset from file
     pub fn append_from_file(
         &mut self,
@@ -6,78 +6,305 @@
 
 //! In-memory graph
 
+use std::cell::UnsafeCell;
+use std::fmt;
+use std::io::Write;
 use std::sync::{RwLock, RwLockReadGuard, RwLockWriteGuard};
 
-use crate::common::ANNError;
+use crate::common::{ANNError, ANNResult, AlignedBoxWithSlice};
+use crate::model::GRAPH_SLACK_FACTOR;
 
-use super::VertexAndNeighbors;
+/// Number of locks guarding the adjacency lists. Vertex v is guarded by lock v % NUM_LOCK_STRIPES.
+pub const NUM_LOCK_STRIPES: usize = 4096;
 
 /// The entire graph of in-memory index
-#[derive(Debug)]
+///
+/// The adjacency lists live in one flat arena with a slot of fixed size per vertex:
+/// {num_neighbors: u32}{neighbors: [u32; slot_capacity]}, where slot_capacity is max_degree with
+/// GRAPH_SLACK_FACTOR slack. The lists are guarded by NUM_LOCK_STRIPES striped locks rather than
+/// a lock per vertex, so the graph needs no allocation per vertex and the lists are contiguous.
+///
+/// Two vertices may share a lock: a thread must not lock a vertex while it holds the guard of
+/// another one.
+///
+/// The arena is written to and mapped back from files as is, see `write_arena` and `map_arena`.
 pub struct InMemoryGraph {
-    /// The entire graph
-    pub final_graph: Vec<RwLock<VertexAndNeighbors>>,
+    /// Number of vertices
+    num_vertices: usize,
+
+    /// Number of neighbors a slot can hold
+    slot_capacity: usize,
+
+    /// Slots of all vertices, only accessed under the lock of their stripe
+    arena: AlignedBoxWithSlice<UnsafeCell<u32>>,
+
+    /// Striped locks
+    locks: Box<[RwLock<()>]>,
 }
 
+// Safety: the slot of a vertex is only accessed through the guards, which hold the lock of its stripe.
+unsafe impl Sync for InMemoryGraph {}
+
 impl InMemoryGraph {
     /// Create InMemoryGraph instance
     pub fn new(size: usize, max_degree: u32) -> Self {
-        let mut graph = Vec::with_capacity(size);
-        for id in 0..size {
-            graph.push(RwLock::new(VertexAndNeighbors::for_range(
-                id as u32,
-                max_degree as usize,
+        let slot_capacity = Self::slot_capacity_for(max_degree);
+        Self {
+            num_vertices: size,
+            slot_capacity,
+            arena: Self::new_arena(size * (slot_capacity + 1)),
+            locks: (0..NUM_LOCK_STRIPES).map(|_| RwLock::new(())).collect(),
+        }
+    }
+
+    /// Create an InMemoryGraph of size vertices over the arena written by `write_arena` to filename
+    /// at file_offset, whose slots hold slot_capacity neighbors. The file is mapped rather than
+    /// read, see `AlignedBoxWithSlice::map_file`; vertices past those in the file have no neighbors.
+    pub fn map_arena(
+        filename: &str,
+        file_offset: u64,
+        size: usize,
+        slot_capacity: usize,
+        populate: bool,
+    ) -> ANNResult<Self> {
+        Ok(Self {
+            num_vertices: size,
+            slot_capacity,
+            arena: AlignedBoxWithSlice::map_file(filename, file_offset, size * (slot_capacity + 1), populate)?,
+            locks: (0..NUM_LOCK_STRIPES).map(|_| RwLock::new(())).collect(),
+        })
+    }
+
+    /// Write the slots of the first num_vertices vertices, in the layout `map_arena` maps
+    pub fn write_arena<W: Write>(&mut self, writer: &mut W, num_vertices: usize) -> ANNResult<()> {
+        if num_vertices > self.num_vertices {
+            return Err(ANNError::log_index_error(format!(
+                "Cannot write {} vertices of a graph of {}",
+                num_vertices, self.num_vertices
             )));
         }
-        Self { final_graph: graph }
+
+        let len = num_vertices * (self.slot_capacity + 1);
+        for value in self.arena[..len].iter_mut() {
+            writer.write_all(&value.get_mut().to_le_bytes())?;
+        }
+        Ok(())
     }
 
     /// Size of graph
     pub fn size(&self) -> usize {
-        self.final_graph.len()
+        self.num_vertices
+    }
+
+    /// Number of neighbors the list of a vertex can hold
+    pub fn slot_capacity(&self) -> usize {
+        self.slot_capacity
     }
 
     /// Extend the graph by size vectors
     pub fn extend(&mut self, size: usize, max_degree: u32) {
-        for id in 0..size {
-            self.final_graph
-                .push(RwLock::new(VertexAndNeighbors::for_range(
-                    id as u32,
-                    max_degree as usize,
-                )));
+        let slot_capacity = Self::slot_capacity_for(max_degree).max(self.slot_capacity);
+        let new_num_vertices = self.num_vertices + size;
+        let mut arena = Self::new_arena(new_num_vertices * (slot_capacity + 1));
+        for vertex_id in 0..self.num_vertices {
+            let old_slot = &mut self.arena[vertex_id * (self.slot_capacity + 1)..];
+            let new_slot = &mut arena[vertex_id * (slot_capacity + 1)..];
+            let len = *old_slot[0].get_mut() as usize + 1;
+            for (new_value, old_value) in new_slot[..len].iter_mut().zip(old_slot[..len].iter_mut()) {
+                *new_value.get_mut() = *old_value.get_mut();
+            }
         }
+
+        self.num_vertices = new_num_vertices;
+        self.slot_capacity = slot_capacity;
+        self.arena = arena;
     }
 
     /// Get read guard of vertex_id
-    pub fn read_vertex_and_neighbors(
-        &self,
-        vertex_id: u32,
-    ) -> Result<RwLockReadGuard<VertexAndNeighbors>, ANNError> {
-        self.final_graph[vertex_id as usize].read().map_err(|err| {
+    pub fn read_vertex_and_neighbors(&self, vertex_id: u32) -> ANNResult<VertexReadGuard> {
+        self.check_vertex_id(vertex_id)?;
+        let lock = self.stripe(vertex_id).read().map_err(|err| {
             ANNError::log_lock_poison_error(format!(
                 "PoisonError: Lock poisoned when reading final_graph for vertex_id {}, err={}",
                 vertex_id, err
             ))
+        })?;
+
+        // Safety: the lock of the stripe of vertex_id is held as long as the guard
+        let slot = unsafe { std::slice::from_raw_parts(self.slot_ptr(vertex_id), self.slot_capacity + 1) };
+        let num_neighbors = slot[0] as usize;
+        Ok(VertexReadGuard {
+            _lock: lock,
+            vertex_id,
+            neighbors: &slot[1..1 + num_neighbors],
         })
     }
 
     /// Get write guard of vertex_id
-    pub fn write_vertex_and_neighbors(
-        &self,
-        vertex_id: u32,
-    ) -> Result<RwLockWriteGuard<VertexAndNeighbors>, ANNError> {
-        self.final_graph[vertex_id as usize].write().map_err(|err| {
+    pub fn write_vertex_and_neighbors(&self, vertex_id: u32) -> ANNResult<VertexWriteGuard> {
+        self.check_vertex_id(vertex_id)?;
+        let lock = self.stripe(vertex_id).write().map_err(|err| {
             ANNError::log_lock_poison_error(format!(
                 "PoisonError: Lock poisoned when writing final_graph for vertex_id {}, err={}",
                 vertex_id, err
             ))
+        })?;
+
+        // Safety: the lock of the stripe of vertex_id is held exclusively as long as the guard
+        let slot = unsafe { std::slice::from_raw_parts_mut(self.slot_ptr(vertex_id), self.slot_capacity + 1) };
+        Ok(VertexWriteGuard {
+            _lock: lock,
+            vertex_id,
+            slot,
         })
     }
+
+    fn slot_capacity_for(max_degree: u32) -> usize {
+        (GRAPH_SLACK_FACTOR * max_degree as f64).ceil() as usize
+    }
+
+    fn new_arena(len: usize) -> AlignedBoxWithSlice<UnsafeCell<u32>> {
+        // zeroed memory holds empty slots
+        AlignedBoxWithSlice::new(len, std::mem::align_of::<u32>())
+            .expect("the arena of the graph cannot be allocated")
+    }
+
+    #[inline]
+    fn stripe(&self, vertex_id: u32) -> &RwLock<()> {
+        &self.locks[vertex_id as usize % NUM_LOCK_STRIPES]
+    }
+
+    #[inline]
+    fn slot_ptr(&self, vertex_id: u32) -> *mut u32 {
+        let offset = vertex_id as usize * (self.slot_capacity + 1);
+        UnsafeCell::raw_get(self.arena[offset..].as_ptr())
+    }
+
+    #[inline]
+    fn check_vertex_id(&self, vertex_id: u32) -> ANNResult<()> {
+        if vertex_id as usize >= self.num_vertices {
+            return Err(ANNError::log_index_error(format!(
+                "vertex_id {} is out of range of the {} vertices of final_graph",
+                vertex_id, self.num_vertices
+            )));
+        }
+        Ok(())
+    }
+}
+
+impl fmt::Debug for InMemoryGraph {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("InMemoryGraph")
+            .field("num_vertices", &self.num_vertices)
+            .field("slot_capacity", &self.slot_capacity)
+            .finish()
+    }
+}
+
+/// Shared access to the out neighbors of a vertex
+#[derive(Debug)]
+pub struct VertexReadGuard<'a> {
+    _lock: RwLockReadGuard<'a, ()>,
+
+    /// The id of the vertex
+    pub vertex_id: u32,
+
+    neighbors: &'a [u32],
+}
+
+impl VertexReadGuard<'_> {
+    /// Get size of neighbors
+    #[inline(always)]
+    pub fn size(&self) -> usize {
+        self.neighbors.len()
+    }
+
+    /// Get the neighbors
+    #[inline(always)]
+    pub fn get_neighbors(&self) -> &[u32] {
+        self.neighbors
+    }
+}
+
+/// Exclusive access to the out neighbors of a vertex
+#[derive(Debug)]
+pub struct VertexWriteGuard<'a> {
+    _lock: RwLockWriteGuard<'a, ()>,
+
+    /// The id of the vertex
+    pub vertex_id: u32,
+
+    /// {num_neighbors}{neighbors}
+    slot: &'a mut [u32],
+}
+
+impl VertexWriteGuard<'_> {
+    /// Get size of neighbors
+    #[inline(always)]
+    pub fn size(&self) -> usize {
+        self.slot[0] as usize
+    }
+
+    /// Get the neighbors
+    #[inline(always)]
+    pub fn get_neighbors(&self) -> &[u32] {
+        &self.slot[1..1 + self.size()]
+    }
+
+    /// Update the neighbors vector (post a pruning exercise)
+    pub fn set_neighbors(&mut self, new_neighbors: &[u32]) -> ANNResult<()> {
+        if new_neighbors.len() >= self.slot.len() {
+            return Err(ANNError::log_index_error(format!(
+                "vertex_id {} can hold {} neighbors, but {} were given",
+                self.vertex_id,
+                self.slot.len() - 1,
+                new_neighbors.len()
+            )));
+        }
+
+        self.slot[1..1 + new_neighbors.len()].copy_from_slice(new_neighbors);
+        self.slot[0] = new_neighbors.len() as u32;
+        Ok(())
+    }
+
+    /// Adds a node to the list of neighbors for the given node.
+    ///
+    /// # Arguments
+    ///
+    /// * `node_id` - The ID of the node to add.
+    /// * `range` - The range of the graph.
+    ///
+    /// # Return
+    ///
+    /// Returns `None` if the node is already in the list of neighbors, or a `Vec` containing the updated list of neighbors if the list of neighbors is full.
+    pub fn add_to_neighbors(&mut self, node_id: u32, range: u32) -> Option<Vec<u32>> {
+        let neighbor_len = self.size();
+
+        // Check if n is already in the graph entry
+        if self.get_neighbors().contains(&node_id) {
+            return None;
+        }
+
+        // If not, check if the graph entry has enough space
+        let max_len = ((GRAPH_SLACK_FACTOR * range as f64) as usize).min(self.slot.len() - 1);
+        if neighbor_len < max_len {
+            // If yes, add n to the graph entry
+            self.slot[1 + neighbor_len] = node_id;
+            self.slot[0] += 1;
+            return None;
+        }
+
+        let mut copy_of_neighbors = Vec::with_capacity(neighbor_len + 1);
+        copy_of_neighbors.extend_from_slice(self.get_neighbors());
+        copy_of_neighbors.push(node_id);
+
+        Some(copy_of_neighbors)
+    }
 }
 
 #[cfg(test)]
 mod graph_tests {
-    use crate::model::{graph::AdjacencyList, GRAPH_SLACK_FACTOR};
+    use crate::model::GRAPH_SLACK_FACTOR;
 
     use super::*;
 
@@ -86,11 +313,12 @@ mod graph_tests {
         let graph = InMemoryGraph::new(10, 10);
         let capacity = (GRAPH_SLACK_FACTOR * 10_f64).ceil() as usize;
 
-        assert_eq!(graph.final_graph.len(), 10);
+        assert_eq!(graph.size(), 10);
+        assert_eq!(graph.slot_capacity(), capacity);
         for i in 0..10 {
-            let neighbor = graph.final_graph[i].read().unwrap();
-            assert_eq!(neighbor.vertex_id, i as u32);
-            assert_eq!(neighbor.get_neighbors().capacity(), capacity);
+            let neighbor = graph.read_vertex_and_neighbors(i).unwrap();
+            assert_eq!(neighbor.vertex_id, i);
+            assert_eq!(neighbor.size(), 0);
         }
     }
 
@@ -103,18 +331,23 @@ mod graph_tests {
     #[test]
     fn test_extend() {
         let mut graph = InMemoryGraph::new(10, 10);
+        graph
+            .write_vertex_and_neighbors(9)
+            .unwrap()
+            .set_neighbors(&[1, 2, 3])
+            .unwrap();
         graph.extend(10, 10);
 
         assert_eq!(graph.size(), 20);
 
         let capacity = (GRAPH_SLACK_FACTOR * 10_f64).ceil() as usize;
-        let mut id: u32 = 0;
+        assert_eq!(graph.slot_capacity(), capacity);
+        assert_eq!(graph.read_vertex_and_neighbors(9).unwrap().get_neighbors(), &[1, 2, 3]);
 
         for i in 10..20 {
-            let neighbor = graph.final_graph[i].read().unwrap();
-            assert_eq!(neighbor.vertex_id, id);
-            assert_eq!(neighbor.get_neighbors().capacity(), capacity);
-            id += 1;
+            let neighbor = graph.read_vertex_and_neighbors(i).unwrap();
+            assert_eq!(neighbor.vertex_id, i);
+            assert_eq!(neighbor.size(), 0);
         }
     }
 
@@ -124,6 +357,7 @@ mod graph_tests {
         let neighbor = graph.read_vertex_and_neighbors(0);
         assert!(neighbor.is_ok());
         assert_eq!(neighbor.unwrap().vertex_id, 0);
+        assert!(graph.read_vertex_and_neighbors(10).is_err());
     }
 
     #[test]
@@ -136,6 +370,17 @@ mod graph_tests {
         }
 
         let neighbor = graph.read_vertex_and_neighbors(0).unwrap();
-        assert_eq!(neighbor.get_neighbors(), &AdjacencyList::from(vec![10_u32]));
+        assert_eq!(neighbor.get_neighbors(), &[10_u32]);
+    }
+
+    #[test]
+    fn test_add_to_neighbors_full() {
+        let graph = InMemoryGraph::new(1, 2);
+        let mut vertex = graph.write_vertex_and_neighbors(0).unwrap();
+        assert_eq!(vertex.add_to_neighbors(1, 2), None);
+        assert_eq!(vertex.add_to_neighbors(1, 2), None);
+        assert_eq!(vertex.add_to_neighbors(2, 2), None);
+        assert_eq!(vertex.add_to_neighbors(3, 2), Some(vec![1, 2, 3]));
+        assert!(vertex.set_neighbors(&[1, 2, 3, 4]).is_err());
     }
 }
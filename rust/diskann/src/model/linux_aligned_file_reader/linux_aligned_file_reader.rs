@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+use std::fs::{File, OpenOptions};
+use std::io;
+use std::os::unix::fs::OpenOptionsExt;
+use std::os::unix::io::AsRawFd;
+
+use io_uring::{opcode, types, IoUring};
+
+use crate::common::{ANNError, ANNResult};
+use crate::model::{AlignedRead, MAX_IO_CONCURRENCY};
+
+/// Entries of the submission queue of each ring; one batch of reads fits in it.
+pub const IO_URING_QUEUE_DEPTH: u32 = MAX_IO_CONCURRENCY as u32;
+
+/// Reads aligned sectors of a file with io_uring, the Linux counterpart of WindowsAlignedFileReader.
+/// The file is opened once with O_DIRECT and shared by all threads; each thread submits its reads
+/// to its own ring, created by create_ring.
+pub struct LinuxAlignedFileReader {
+    file: File,
+}
+
+impl LinuxAlignedFileReader {
+    pub fn new(fname: &str) -> ANNResult<Self> {
+        let file = OpenOptions::new()
+            .read(true)
+            .custom_flags(libc::O_DIRECT)
+            .open(fname)
+            .map_err(ANNError::log_io_error)?;
+
+        Ok(Self { file })
+    }
+
+    /// Create the ring of a thread. A ring must only be used by one thread at a time.
+    pub fn create_ring(&self) -> ANNResult<IoUring> {
+        IoUring::new(IO_URING_QUEUE_DEPTH).map_err(ANNError::log_io_error)
+    }
+
+    /// Read the requests in batches of MAX_IO_CONCURRENCY, each batch submitted with one system call.
+    /// Returns once all of them have completed.
+    pub fn read<T>(&self, read_requests: &mut [AlignedRead<T>], ring: &mut IoUring) -> ANNResult<()> {
+        let fd = types::Fd(self.file.as_raw_fd());
+        let mut lengths = Vec::with_capacity(MAX_IO_CONCURRENCY);
+
+        for batch in read_requests.chunks_mut(MAX_IO_CONCURRENCY) {
+            lengths.clear();
+            for (index, request) in batch.iter_mut().enumerate() {
+                let offset = request.offset();
+                let buf = request.aligned_buf_mut();
+                let len = std::mem::size_of_val(buf);
+                lengths.push(len);
+
+                let entry = opcode::Read::new(fd, buf.as_mut_ptr() as *mut u8, len as u32)
+                    .offset(offset)
+                    .build()
+                    .user_data(index as u64);
+
+                // Safety: the buffer outlives the read, as we wait below for all reads of the batch to complete.
+                unsafe { ring.submission().push(&entry) }.map_err(|_| {
+                    ANNError::log_index_error("io_uring submission queue is full".to_string())
+                })?;
+            }
+
+            ring.submit_and_wait(batch.len()).map_err(ANNError::log_io_error)?;
+
+            let mut num_completed = 0;
+            let mut first_error = None;
+            while num_completed < batch.len() {
+                if ring.completion().is_empty() {
+                    ring.submit_and_wait(1).map_err(ANNError::log_io_error)?;
+                }
+
+                for cqe in ring.completion() {
+                    num_completed += 1;
+                    let result = cqe.result();
+                    let expected = lengths[cqe.user_data() as usize];
+                    if first_error.is_some() {
+                        continue;
+                    }
+                    if result < 0 {
+                        first_error = Some(io::Error::from_raw_os_error(-result));
+                    } else if result as usize != expected {
+                        first_error = Some(io::Error::new(
+                            io::ErrorKind::UnexpectedEof,
+                            format!("io_uring read returned {} bytes, expected {}", result, expected),
+                        ));
+                    }
+                }
+            }
+
+            if let Some(err) = first_error {
+                return Err(ANNError::log_io_error(err));
+            }
+        }
+
+        Ok(())
+    }
+}
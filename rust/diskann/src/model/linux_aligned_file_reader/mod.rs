@@ -0,0 +1,7 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+#[allow(clippy::module_inception)]
+mod linux_aligned_file_reader;
+pub use linux_aligned_file_reader::*;
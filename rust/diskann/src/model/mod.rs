@@ -27,3 +27,8 @@ pub use pq::*;
 
 pub mod windows_aligned_file_reader;
 pub use windows_aligned_file_reader::*;
+
+#[cfg(target_os = "linux")]
+pub mod linux_aligned_file_reader;
+#[cfg(target_os = "linux")]
+pub use linux_aligned_file_reader::*;
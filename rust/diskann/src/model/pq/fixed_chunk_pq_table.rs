@@ -8,7 +8,13 @@ use hashbrown::HashMap;
 use rayon::prelude::{
     IndexedParallelIterator, IntoParallelRefMutIterator, ParallelIterator, ParallelSliceMut,
 };
-use std::arch::x86_64::{_mm_prefetch, _MM_HINT_T0};
+use std::arch::x86_64::{
+    __m128i, __m256, __m256i, _mm256_add_epi32, _mm256_add_ps, _mm256_castps256_ps128,
+    _mm256_cvtepu8_epi32, _mm256_extractf128_ps, _mm256_i32gather_ps, _mm256_set1_epi32,
+    _mm256_setr_epi32, _mm256_setzero_ps, _mm512_add_epi32, _mm512_add_ps, _mm512_cvtepu8_epi32,
+    _mm512_i32gather_ps, _mm512_reduce_add_ps, _mm512_set1_epi32, _mm512_setr_epi32,
+    _mm512_setzero_ps, _mm_add_ps, _mm_cvtss_f32, _mm_hadd_ps, _mm_loadl_epi64, _mm_loadu_si128,
+};
 
 use crate::{
     common::{ANNError, ANNResult},
@@ -219,31 +225,124 @@ pub fn pq_dist_lookup(
     pq_dists: &[f32],
 ) -> Vec<f32> {
     let mut dists_out: Vec<f32> = vec![0.0; n_pts];
-    unsafe {
-        _mm_prefetch(dists_out.as_ptr() as *const i8, _MM_HINT_T0);
-        _mm_prefetch(pq_ids.as_ptr() as *const i8, _MM_HINT_T0);
-        _mm_prefetch(pq_ids.as_ptr().add(64) as *const i8, _MM_HINT_T0);
-        _mm_prefetch(pq_ids.as_ptr().add(128) as *const i8, _MM_HINT_T0);
+    pq_dist_lookup_into(pq_ids, n_pts, pq_nchunks, pq_dists, &mut dists_out);
+    dists_out
+}
+
+/// pq_dist_lookup writing into dists_out, for callers that reuse their buffers.
+/// The chunks of each node are summed with AVX-512 or AVX2 gathers, whichever the CPU supports.
+pub fn pq_dist_lookup_into(
+    pq_ids: &[u8],
+    n_pts: usize,
+    pq_nchunks: usize,
+    pq_dists: &[f32],
+    dists_out: &mut [f32],
+) {
+    assert!(pq_ids.len() >= n_pts * pq_nchunks);
+    assert!(pq_dists.len() >= pq_nchunks * NUM_PQ_CENTROIDS);
+    assert!(dists_out.len() >= n_pts);
+    if pq_nchunks == 0 {
+        dists_out[..n_pts].fill(0.0);
+        return;
     }
-    for chunk in 0..pq_nchunks {
-        let chunk_dists = &pq_dists[256 * chunk..];
-        if chunk < pq_nchunks - 1 {
-            unsafe {
-                _mm_prefetch(
-                    chunk_dists.as_ptr().offset(256 * chunk as isize).add(256) as *const i8,
-                    _MM_HINT_T0,
-                );
-            }
+
+    if is_x86_feature_detected!("avx512f") && is_x86_feature_detected!("avx2") {
+        // Safety: the CPU supports the target features, and the asserts above keep the gathers in bounds
+        unsafe { pq_dist_lookup_avx512(pq_ids, n_pts, pq_nchunks, pq_dists, dists_out) }
+    } else if is_x86_feature_detected!("avx2") {
+        // Safety: as above
+        unsafe { pq_dist_lookup_avx2(pq_ids, n_pts, pq_nchunks, pq_dists, dists_out) }
+    } else {
+        for (codes, dist) in pq_ids.chunks_exact(pq_nchunks).zip(dists_out[..n_pts].iter_mut()) {
+            *dist = pq_dist_remaining_chunks(codes, 0, pq_dists, 0.0);
         }
-        dists_out
-            .par_iter_mut()
-            .enumerate()
-            .for_each(|(n_iter, dist)| {
-                let pq_centerid = pq_ids[pq_nchunks * n_iter + chunk];
-                *dist += chunk_dists[pq_centerid as usize];
-            });
     }
-    dists_out
+}
+
+/// Add the distances of chunks first_chunk.. of a node to sum
+#[inline(always)]
+fn pq_dist_remaining_chunks(codes: &[u8], first_chunk: usize, pq_dists: &[f32], mut sum: f32) -> f32 {
+    for (chunk, &code) in codes.iter().enumerate().skip(first_chunk) {
+        sum += pq_dists[chunk * NUM_PQ_CENTROIDS + code as usize];
+    }
+    sum
+}
+
+/// Add the distances of chunks chunk..chunk + 8 of the node whose codes start at codes to sum
+#[inline(always)]
+unsafe fn pq_dist_8_chunks(
+    codes: *const u8,
+    chunk: usize,
+    pq_dists: *const f32,
+    lane_offsets: __m256i,
+    sum: __m256,
+) -> __m256 {
+    let centroids = _mm256_cvtepu8_epi32(_mm_loadl_epi64(codes.add(chunk) as *const __m128i));
+    let chunk_offset = _mm256_set1_epi32((chunk * NUM_PQ_CENTROIDS) as i32);
+    let offsets = _mm256_add_epi32(centroids, _mm256_add_epi32(lane_offsets, chunk_offset));
+    _mm256_add_ps(sum, _mm256_i32gather_ps::<4>(pq_dists, offsets))
+}
+
+#[inline(always)]
+unsafe fn horizontal_sum_8(sum: __m256) -> f32 {
+    let sum = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps::<1>(sum));
+    let sum = _mm_hadd_ps(sum, sum);
+    _mm_cvtss_f32(_mm_hadd_ps(sum, sum))
+}
+
+#[target_feature(enable = "avx2")]
+unsafe fn pq_dist_lookup_avx2(
+    pq_ids: &[u8],
+    n_pts: usize,
+    pq_nchunks: usize,
+    pq_dists: &[f32],
+    dists_out: &mut [f32],
+) {
+    let lane_offsets = _mm256_setr_epi32(0, 256, 512, 768, 1024, 1280, 1536, 1792);
+    for (codes, dist) in pq_ids.chunks_exact(pq_nchunks).zip(dists_out[..n_pts].iter_mut()) {
+        let mut sum = _mm256_setzero_ps();
+        let mut chunk = 0;
+        while chunk + 8 <= pq_nchunks {
+            sum = pq_dist_8_chunks(codes.as_ptr(), chunk, pq_dists.as_ptr(), lane_offsets, sum);
+            chunk += 8;
+        }
+        *dist = pq_dist_remaining_chunks(codes, chunk, pq_dists, horizontal_sum_8(sum));
+    }
+}
+
+#[target_feature(enable = "avx512f,avx2")]
+unsafe fn pq_dist_lookup_avx512(
+    pq_ids: &[u8],
+    n_pts: usize,
+    pq_nchunks: usize,
+    pq_dists: &[f32],
+    dists_out: &mut [f32],
+) {
+    let lane_offsets_16 = _mm512_setr_epi32(
+        0, 256, 512, 768, 1024, 1280, 1536, 1792, 2048, 2304, 2560, 2816, 3072, 3328, 3584, 3840,
+    );
+    let lane_offsets_8 = _mm256_setr_epi32(0, 256, 512, 768, 1024, 1280, 1536, 1792);
+    for (codes, dist) in pq_ids.chunks_exact(pq_nchunks).zip(dists_out[..n_pts].iter_mut()) {
+        let mut sum_16 = _mm512_setzero_ps();
+        let mut chunk = 0;
+        while chunk + 16 <= pq_nchunks {
+            let centroids =
+                _mm512_cvtepu8_epi32(_mm_loadu_si128(codes.as_ptr().add(chunk) as *const __m128i));
+            let chunk_offset = _mm512_set1_epi32((chunk * NUM_PQ_CENTROIDS) as i32);
+            let offsets = _mm512_add_epi32(centroids, _mm512_add_epi32(lane_offsets_16, chunk_offset));
+            sum_16 = _mm512_add_ps(sum_16, _mm512_i32gather_ps::<4>(offsets, pq_dists.as_ptr()));
+            chunk += 16;
+        }
+
+        let mut sum_8 = _mm256_setzero_ps();
+        if chunk + 8 <= pq_nchunks {
+            sum_8 = pq_dist_8_chunks(codes.as_ptr(), chunk, pq_dists.as_ptr(), lane_offsets_8, sum_8);
+            chunk += 8;
+        }
+
+        let sum = _mm512_reduce_add_ps(sum_16) + horizontal_sum_8(sum_8);
+        *dist = pq_dist_remaining_chunks(codes, chunk, pq_dists, sum);
+    }
 }
 
 pub fn aggregate_coords(ids: &[u32], all_coords: &[u8], ndims: usize) -> Vec<u8> {
@@ -480,4 +579,21 @@ mod pq_index_prune_query_test {
         assert_eq!(dists_out[0], pq_dists[0 + 1] + pq_dists[256 + 3]);
         assert_eq!(dists_out[1], pq_dists[0 + 2] + pq_dists[256 + 2]);
     }
+
+    #[test]
+    fn pq_dist_lookup_simd_test() {
+        for pq_nchunks in [1, 7, 8, 9, 16, 17, 24, 31, 32, 64, 100] {
+            let n_pts = 37;
+            let pq_ids: Vec<u8> = (0..n_pts * pq_nchunks).map(|_| rand::random()).collect();
+            let pq_dists: Vec<f32> = (0..256 * pq_nchunks).map(|_| rand::random()).collect();
+
+            let dists_out = pq_dist_lookup(&pq_ids, n_pts, pq_nchunks, &pq_dists);
+            for (point, dist) in dists_out.iter().enumerate() {
+                let expected: f32 = (0..pq_nchunks)
+                    .map(|chunk| pq_dists[256 * chunk + pq_ids[point * pq_nchunks + chunk] as usize])
+                    .sum();
+                assert!((dist - expected).abs() <= 1e-4 * expected.max(1.0));
+            }
+        }
+    }
 }
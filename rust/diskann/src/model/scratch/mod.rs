@@ -24,5 +24,8 @@ pub use ssd_query_scratch::*;
 pub mod ssd_thread_data;
 pub use ssd_thread_data::*;
 
+pub mod ssd_search_scratch;
+pub use ssd_search_scratch::*;
+
 pub mod ssd_io_context;
 pub use ssd_io_context::*;
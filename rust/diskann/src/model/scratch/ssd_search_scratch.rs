@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+use crate::model::graph::DiskGraph;
+
+use super::{Scratch, SSDQueryScratch};
+
+// Per-thread state of a disk index search, the counterpart of the C++ SSDThreadData: the query
+// scratch and the disk graph whose storage holds the thread's own reader context.
+// Instances are pooled and handed out by ScratchStoreManager.
+pub struct SSDSearchScratch<T: Default + Copy, const N: usize> {
+    pub query_scratch: SSDQueryScratch<T, N>,
+    pub graph: DiskGraph,
+}
+
+impl<T: Default + Copy, const N: usize> SSDSearchScratch<T, N> {
+    pub fn new(query_scratch: SSDQueryScratch<T, N>, graph: DiskGraph) -> Self {
+        Self {
+            query_scratch,
+            graph,
+        }
+    }
+}
+
+impl<T: Default + Copy, const N: usize> Scratch for SSDSearchScratch<T, N> {
+    fn clear(&mut self) {
+        self.query_scratch.clear();
+        self.graph.reset();
+    }
+}
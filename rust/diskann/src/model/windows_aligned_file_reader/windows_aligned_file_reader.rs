@@ -66,6 +66,14 @@ impl<'a, T> AlignedRead<'a, T> {
     pub fn aligned_buf(&self) -> &[T] {
         self.aligned_buf
     }
+
+    pub fn aligned_buf_mut(&mut self) -> &mut [T] {
+        self.aligned_buf
+    }
+
+    pub fn offset(&self) -> u64 {
+        self.offset
+    }
 }
 
 pub struct WindowsAlignedFileReader {
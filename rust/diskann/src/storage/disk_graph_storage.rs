@@ -8,10 +8,18 @@
 
 use std::sync::Arc;
 
-use crate::{model::{WindowsAlignedFileReader, IOContext, AlignedRead}, common::ANNResult};
+#[cfg(target_os = "linux")]
+use io_uring::IoUring;
+
+#[cfg(target_os = "linux")]
+use crate::model::LinuxAlignedFileReader;
+#[cfg(not(target_os = "linux"))]
+use crate::model::{IOContext, WindowsAlignedFileReader};
+use crate::{model::AlignedRead, common::ANNResult};
 
 /// Graph storage for disk index
 /// One thread has one storage instance
+#[cfg(not(target_os = "linux"))]
 pub struct DiskGraphStorage {
     /// Disk graph reader
     disk_graph_reader: Arc<WindowsAlignedFileReader>,
@@ -20,6 +28,7 @@ pub struct DiskGraphStorage {
     ctx: Arc<IOContext>,
 }
 
+#[cfg(not(target_os = "linux"))]
 impl DiskGraphStorage {
     /// Create a new DiskGraphStorage instance
     pub fn new(disk_graph_reader: Arc<WindowsAlignedFileReader>) -> ANNResult<Self> {
@@ -31,7 +40,35 @@ impl DiskGraphStorage {
     }
 
     /// Read disk graph data
-    pub fn read<T>(&self, read_requests: &mut [AlignedRead<T>]) -> ANNResult<()> {
+    pub fn read<T>(&mut self, read_requests: &mut [AlignedRead<T>]) -> ANNResult<()> {
         self.disk_graph_reader.read(read_requests, &self.ctx)
     }
 }
+
+/// Graph storage for disk index
+/// One thread has one storage instance
+#[cfg(target_os = "linux")]
+pub struct DiskGraphStorage {
+    /// Disk graph reader
+    disk_graph_reader: Arc<LinuxAlignedFileReader>,
+
+    /// io_uring of this storage instance
+    ring: IoUring,
+}
+
+#[cfg(target_os = "linux")]
+impl DiskGraphStorage {
+    /// Create a new DiskGraphStorage instance
+    pub fn new(disk_graph_reader: Arc<LinuxAlignedFileReader>) -> ANNResult<Self> {
+        let ring = disk_graph_reader.create_ring()?;
+        Ok(Self {
+            disk_graph_reader,
+            ring,
+        })
+    }
+
+    /// Read disk graph data
+    pub fn read<T>(&mut self, read_requests: &mut [AlignedRead<T>]) -> ANNResult<()> {
+        self.disk_graph_reader.read(read_requests, &mut self.ring)
+    }
+}
@@ -3,23 +3,25 @@
  * Licensed under the MIT license.
  */
 use byteorder::{ByteOrder, LittleEndian, ReadBytesExt};
+use rayon::prelude::*;
 use std::fs::File;
-use std::io::Read;
+use std::io::BufReader;
 use std::marker::PhantomData;
 use std::{fs, mem};
 
 use crate::common::{ANNError, ANNResult};
-use crate::model::NUM_PQ_CENTROIDS;
-use crate::storage::PQStorage;
+use crate::model::{FixedChunkPQTable, NUM_PQ_CENTROIDS};
+use crate::storage::{PQStorage, SectorBlockWriter};
 use crate::utils::{convert_types_u32_usize, convert_types_u64_usize, load_bin, save_bin_u64};
 use crate::utils::{
-    file_exists, gen_sample_data, get_file_size, round_up, CachedReader, CachedWriter,
+    file_exists, gen_sample_data, get_file_size, round_up, CachedReader,
 };
 
 const SECTOR_LEN: usize = 4096;
 
-/// Todo: Remove the allow(dead_code) when the disk search code is complete
-#[allow(dead_code)]
+/// Sectors of the disk layout assembled and written at a time, 64 MB
+const SECTORS_PER_BLOCK: usize = 16 * 1024;
+
 pub struct PQPivotData {
     dim: usize,
     pq_table: Vec<f32>,
@@ -27,6 +29,13 @@ pub struct PQPivotData {
     chunk_offsets: Vec<usize>,
 }
 
+impl PQPivotData {
+    /// Create the FixedChunkPQTable of the pivots
+    pub fn into_pq_table(self, num_pq_chunks: usize) -> FixedChunkPQTable {
+        FixedChunkPQTable::new(self.dim, num_pq_chunks, self.pq_table, self.centroids, self.chunk_offsets)
+    }
+}
+
 pub struct DiskIndexStorage<T> {
     /// Dataset file
     dataset_file: String,
@@ -73,6 +82,10 @@ impl<T> DiskIndexStorage<T> {
     /// Sector #1: disk_layout_meta
     /// Sector #n: num_nodes_per_sector nodes
     /// Each node's layout: {full precision vector:[T; DIM]}{num_nbrs: u32}{neighbors: [u32; num_nbrs]}
+    ///
+    /// The nodes are read in blocks of SECTORS_PER_BLOCK sectors, whose sectors are assembled by the
+    /// rayon workers and handed to a SectorBlockWriter, which writes each block in one large aligned
+    /// write while the next one is assembled.
     /// # Arguments
     /// * `dataset_file` - dataset file containing full precision vectors
     /// * `mem_index_file` - in-memory index graph file
@@ -81,9 +94,8 @@ impl<T> DiskIndexStorage<T> {
         let mem_index_file = self.mem_index_file();
         let disk_layout_file = self.disk_index_file();
 
-        // amount to read or write in one shot
+        // amount to read in one shot
         let read_blk_size = 64 * 1024 * 1024;
-        let write_blk_size = read_blk_size;
         let mut dataset_reader = CachedReader::new(self.dataset_file.as_str(), read_blk_size)?;
 
         let num_pts = dataset_reader.read_u32()? as u64;
@@ -93,8 +105,13 @@ impl<T> DiskIndexStorage<T> {
         let actual_file_size = get_file_size(mem_index_file.as_str())?;
         println!("Vamana index file size={}", actual_file_size);
 
-        let mut vamana_reader = File::open(mem_index_file)?;
-        let mut diskann_writer = CachedWriter::new(disk_layout_file.as_str(), write_blk_size)?;
+        let mut vamana_reader =
+            BufReader::with_capacity(read_blk_size as usize, File::open(mem_index_file)?);
+        let mut diskann_writer = SectorBlockWriter::new(
+            disk_layout_file.as_str(),
+            SECTORS_PER_BLOCK * SECTOR_LEN,
+            SECTOR_LEN,
+        )?;
 
         let index_file_size = vamana_reader.read_u64::<LittleEndian>()?;
         if index_file_size != actual_file_size {
@@ -121,12 +138,9 @@ impl<T> DiskIndexStorage<T> {
         println!("max_node_len: {}B", max_node_len);
         println!("num_nodes_per_sector: {}B", num_nodes_per_sector);
 
-        // SECTOR_LEN buffer for each sector
-        let mut sector_buf = vec![0u8; SECTOR_LEN];
-        let mut node_buf = vec![0u8; max_node_len as usize];
-
-        let num_nbrs_start = (dims as usize) * mem::size_of::<T>();
-        let nbrs_buf_start = num_nbrs_start + mem::size_of::<u32>();
+        let coords_len = (dims as usize) * mem::size_of::<T>();
+        let max_node_len = max_node_len as usize;
+        let nodes_per_sector = num_nodes_per_sector as usize;
 
         // number of sectors (1 for meta data)
         let num_sectors = round_up(num_pts, num_nodes_per_sector) / num_nodes_per_sector;
@@ -136,7 +150,7 @@ impl<T> DiskIndexStorage<T> {
             num_pts,
             dims,
             medoid as u64,
-            max_node_len,
+            max_node_len as u64,
             num_nodes_per_sector,
             vamana_frozen_num,
             vamana_frozen_loc as u64,
@@ -147,24 +161,30 @@ impl<T> DiskIndexStorage<T> {
             disk_index_file_size,
         ];
 
-        diskann_writer.write(&sector_buf)?;
-
-        let mut cur_node_coords = vec![0u8; (dims as usize) * mem::size_of::<T>()];
-        let mut cur_node_id = 0u64;
-
-        for sector in 0..num_sectors {
-            if sector % 100_000 == 0 {
-                println!("Sector #{} written", sector);
-            }
-            sector_buf.fill(0);
-
-            for sector_node_id in 0..num_nodes_per_sector {
-                if cur_node_id >= num_pts {
-                    break;
-                }
-
-                node_buf.fill(0);
-
+        // the meta data sector is written over at the end
+        let mut block = diskann_writer.get_buffer()?;
+        block[..SECTOR_LEN].fill(0);
+        diskann_writer.write(block, SECTOR_LEN)?;
+
+        // coords and neighbors of the nodes of a block, read in node order; the neighbors of node i
+        // of the block are nbrs[nbrs_offsets[i]..nbrs_offsets[i + 1]]
+        let max_block_nodes = SECTORS_PER_BLOCK * nodes_per_sector;
+        let mut coords = vec![0u8; max_block_nodes.min(num_pts as usize) * coords_len];
+        let mut nbrs: Vec<u32> = Vec::new();
+        let mut nbrs_offsets: Vec<usize> = Vec::with_capacity(max_block_nodes + 1);
+
+        let num_sectors = num_sectors as usize;
+        let mut first_sector = 0;
+        while first_sector < num_sectors {
+            let block_sectors = SECTORS_PER_BLOCK.min(num_sectors - first_sector);
+            let first_node = first_sector * nodes_per_sector;
+            let block_nodes = (block_sectors * nodes_per_sector).min(num_pts as usize - first_node);
+
+            dataset_reader.read(&mut coords[..block_nodes * coords_len])?;
+            nbrs.clear();
+            nbrs_offsets.clear();
+            nbrs_offsets.push(0);
+            for _ in 0..block_nodes {
                 // read cur node's num_nbrs
                 let num_nbrs = vamana_reader.read_u32::<LittleEndian>()?;
 
@@ -172,35 +192,53 @@ impl<T> DiskIndexStorage<T> {
                 debug_assert!(num_nbrs > 0);
                 debug_assert!(num_nbrs <= max_degree);
 
-                // write coords of node first
-                dataset_reader.read(&mut cur_node_coords)?;
-                node_buf[..cur_node_coords.len()].copy_from_slice(&cur_node_coords);
-
-                // write num_nbrs
-                LittleEndian::write_u32(
-                    &mut node_buf[num_nbrs_start..(num_nbrs_start + mem::size_of::<u32>())],
-                    num_nbrs,
-                );
-
-                // write neighbors
-                let nbrs_buf = &mut node_buf[nbrs_buf_start
-                    ..(nbrs_buf_start + (num_nbrs as usize) * mem::size_of::<u32>())];
-                vamana_reader.read_exact(nbrs_buf)?;
-
-                // get offset into sector_buf
-                let sector_node_buf_start = (sector_node_id * max_node_len) as usize;
-                let sector_node_buf = &mut sector_buf
-                    [sector_node_buf_start..(sector_node_buf_start + max_node_len as usize)];
-                sector_node_buf.copy_from_slice(&node_buf[..(max_node_len as usize)]);
-
-                cur_node_id += 1;
+                let start = nbrs.len();
+                nbrs.resize(start + num_nbrs as usize, 0);
+                vamana_reader.read_u32_into::<LittleEndian>(&mut nbrs[start..])?;
+                nbrs_offsets.push(nbrs.len());
             }
 
-            // flush sector to disk
-            diskann_writer.write(&sector_buf)?;
+            let mut block = diskann_writer.get_buffer()?;
+            block[..block_sectors * SECTOR_LEN]
+                .par_chunks_mut(SECTOR_LEN)
+                .enumerate()
+                .for_each(|(sector, sector_buf)| {
+                    sector_buf.fill(0);
+                    let sector_first_node = sector * nodes_per_sector;
+                    let sector_nodes = nodes_per_sector.min(block_nodes.saturating_sub(sector_first_node));
+                    for sector_node_id in 0..sector_nodes {
+                        let node = sector_first_node + sector_node_id;
+                        let node_buf = &mut sector_buf
+                            [sector_node_id * max_node_len..(sector_node_id + 1) * max_node_len];
+
+                        // write coords of node first
+                        node_buf[..coords_len]
+                            .copy_from_slice(&coords[node * coords_len..(node + 1) * coords_len]);
+
+                        // write num_nbrs
+                        let node_nbrs = &nbrs[nbrs_offsets[node]..nbrs_offsets[node + 1]];
+                        let nbrs_buf = &mut node_buf[coords_len..];
+                        LittleEndian::write_u32(&mut nbrs_buf[..mem::size_of::<u32>()], node_nbrs.len() as u32);
+
+                        // write neighbors
+                        LittleEndian::write_u32_into(
+                            node_nbrs,
+                            &mut nbrs_buf[mem::size_of::<u32>()..(node_nbrs.len() + 1) * mem::size_of::<u32>()],
+                        );
+                    }
+                });
+
+            // queue the block for the disk
+            diskann_writer.write(block, block_sectors * SECTOR_LEN)?;
+
+            if first_sector / 100_000 != (first_sector + block_sectors) / 100_000 {
+                println!("Sector #{} written", first_sector + block_sectors);
+            }
+            first_sector += block_sectors;
         }
 
-        diskann_writer.flush()?;
+        let bytes_written = diskann_writer.finish()?;
+        println!("Finished writing {}B", bytes_written);
         save_bin_u64(
             disk_layout_file.as_str(),
             &disk_layout_meta,
@@ -231,50 +269,7 @@ impl<T> DiskIndexStorage<T> {
         &self,
         num_pq_chunks: &usize,
     ) -> ANNResult<PQPivotData> {
-        let pq_pivots_path = &self.pq_pivot_file();
-        if !file_exists(pq_pivots_path) {
-            return Err(ANNError::log_pq_error(
-                "ERROR: PQ k-means pivot file not found.".to_string(),
-            ));
-        }
-
-        let (data, offset_num, offset_dim) = load_bin::<u64>(pq_pivots_path, 0)?;
-        let file_offset_data = convert_types_u64_usize(&data, offset_num, offset_dim);
-        if offset_num != 4 {
-            let error_message = format!("Error reading pq_pivots file {}. Offsets don't contain correct metadata, # offsets = {}, but expecting 4.", pq_pivots_path, offset_num);
-            return Err(ANNError::log_pq_error(error_message));
-        }
-
-        let (data, pivot_num, dim) = load_bin::<f32>(pq_pivots_path, file_offset_data[0])?;
-        let pq_table = data.to_vec();
-        if pivot_num != NUM_PQ_CENTROIDS {
-            let error_message = format!(
-                "Error reading pq_pivots file {}. file_num_centers = {}, but expecting {} centers.",
-                pq_pivots_path, pivot_num, NUM_PQ_CENTROIDS
-            );
-            return Err(ANNError::log_pq_error(error_message));
-        }
-
-        let (data, centroid_dim, nc) = load_bin::<f32>(pq_pivots_path, file_offset_data[1])?;
-        let centroids = data.to_vec();
-        if centroid_dim != dim || nc != 1 {
-            let error_message = format!("Error reading pq_pivots file {}. file_dim = {}, file_cols = {} but expecting {} entries in 1 dimension.", pq_pivots_path, centroid_dim, nc, dim);
-            return Err(ANNError::log_pq_error(error_message));
-        }
-
-        let (data, chunk_offset_num, nc) = load_bin::<u32>(pq_pivots_path, file_offset_data[2])?;
-        let chunk_offsets = convert_types_u32_usize(&data, chunk_offset_num, nc);
-        if chunk_offset_num != num_pq_chunks + 1 || nc != 1 {
-            let error_message = format!("Error reading pq_pivots file at chunk offsets; file has nr={}, nc={} but expecting nr={} and nc=1.", chunk_offset_num, nc, num_pq_chunks + 1);
-            return Err(ANNError::log_pq_error(error_message));
-        }
-
-        Ok(PQPivotData {
-            dim, 
-            pq_table, 
-            centroids, 
-            chunk_offsets
-        })
+        load_pq_pivots_bin(&self.pq_pivot_file(), num_pq_chunks)
     }
 
     fn mem_index_file(&self) -> String {
@@ -298,6 +293,56 @@ impl<T> DiskIndexStorage<T> {
     }
 }
 
+/// Load the pre-trained pivot table at pq_pivots_path
+pub fn load_pq_pivots_bin(
+    pq_pivots_path: &str,
+    num_pq_chunks: &usize,
+) -> ANNResult<PQPivotData> {
+    if !file_exists(pq_pivots_path) {
+        return Err(ANNError::log_pq_error(
+            "ERROR: PQ k-means pivot file not found.".to_string(),
+        ));
+    }
+
+    let (data, offset_num, offset_dim) = load_bin::<u64>(pq_pivots_path, 0)?;
+    let file_offset_data = convert_types_u64_usize(&data, offset_num, offset_dim);
+    if offset_num != 4 {
+        let error_message = format!("Error reading pq_pivots file {}. Offsets don't contain correct metadata, # offsets = {}, but expecting 4.", pq_pivots_path, offset_num);
+        return Err(ANNError::log_pq_error(error_message));
+    }
+
+    let (data, pivot_num, dim) = load_bin::<f32>(pq_pivots_path, file_offset_data[0])?;
+    let pq_table = data.to_vec();
+    if pivot_num != NUM_PQ_CENTROIDS {
+        let error_message = format!(
+            "Error reading pq_pivots file {}. file_num_centers = {}, but expecting {} centers.",
+            pq_pivots_path, pivot_num, NUM_PQ_CENTROIDS
+        );
+        return Err(ANNError::log_pq_error(error_message));
+    }
+
+    let (data, centroid_dim, nc) = load_bin::<f32>(pq_pivots_path, file_offset_data[1])?;
+    let centroids = data.to_vec();
+    if centroid_dim != dim || nc != 1 {
+        let error_message = format!("Error reading pq_pivots file {}. file_dim = {}, file_cols = {} but expecting {} entries in 1 dimension.", pq_pivots_path, centroid_dim, nc, dim);
+        return Err(ANNError::log_pq_error(error_message));
+    }
+
+    let (data, chunk_offset_num, nc) = load_bin::<u32>(pq_pivots_path, file_offset_data[2])?;
+    let chunk_offsets = convert_types_u32_usize(&data, chunk_offset_num, nc);
+    if chunk_offset_num != num_pq_chunks + 1 || nc != 1 {
+        let error_message = format!("Error reading pq_pivots file at chunk offsets; file has nr={}, nc={} but expecting nr={} and nc=1.", chunk_offset_num, nc, num_pq_chunks + 1);
+        return Err(ANNError::log_pq_error(error_message));
+    }
+
+    Ok(PQPivotData {
+        dim, 
+        pq_table, 
+        centroids, 
+        chunk_offsets
+    })
+}
+
 #[cfg(test)]
 mod disk_index_storage_test {
     use std::fs;
@@ -10,3 +10,6 @@ pub use disk_graph_storage::*;
 
 mod pq_storage;
 pub use pq_storage::*;
+
+mod sector_block_writer;
+pub use sector_block_writer::*;
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+#![warn(missing_debug_implementations, missing_docs)]
+
+//! Ordered writer of blocks of sectors
+
+use std::fs::{File, OpenOptions};
+use std::io::Write;
+use std::sync::mpsc::{sync_channel, Receiver, SyncSender};
+use std::thread::JoinHandle;
+
+use crate::common::{ANNError, ANNResult, AlignedBoxWithSlice};
+
+/// Buffers a SectorBlockWriter hands out: one being filled while the other is written.
+const NUM_BUFFERS: usize = 2;
+
+/// Writes blocks of whole sectors to a file, in the order they are queued, on a thread of its own,
+/// so that the caller assembles the next block while one is written. Each block goes out in one
+/// large write, with O_DIRECT on Linux where the file system supports it, from a sector aligned
+/// buffer that comes back through `get_buffer` once written.
+#[derive(Debug)]
+pub struct SectorBlockWriter {
+    sender: Option<SyncSender<(AlignedBoxWithSlice<u8>, usize)>>,
+    recycled: Receiver<AlignedBoxWithSlice<u8>>,
+    worker: Option<JoinHandle<ANNResult<u64>>>,
+    block_size: usize,
+    sector_len: usize,
+    num_buffers: usize,
+}
+
+impl SectorBlockWriter {
+    /// Create or truncate filename and write blocks of up to block_size bytes, a multiple of
+    /// sector_len, to it
+    pub fn new(filename: &str, block_size: usize, sector_len: usize) -> ANNResult<Self> {
+        if sector_len == 0 || block_size == 0 || block_size % sector_len != 0 {
+            return Err(ANNError::log_index_error(format!(
+                "Block size {} is not a multiple of sector length {}",
+                block_size, sector_len
+            )));
+        }
+
+        let mut file = Self::open(filename)?;
+        let (sender, receiver) = sync_channel::<(AlignedBoxWithSlice<u8>, usize)>(NUM_BUFFERS);
+        let (recycler, recycled) = sync_channel(NUM_BUFFERS);
+        let worker = std::thread::spawn(move || -> ANNResult<u64> {
+            let mut bytes_written = 0u64;
+            for (buffer, len) in receiver {
+                file.write_all(&buffer[..len])?;
+                bytes_written += len as u64;
+                // the caller may have stopped taking buffers
+                let _ = recycler.send(buffer);
+            }
+            file.flush()?;
+            Ok(bytes_written)
+        });
+
+        Ok(Self {
+            sender: Some(sender),
+            recycled,
+            worker: Some(worker),
+            block_size,
+            sector_len,
+            num_buffers: 0,
+        })
+    }
+
+    #[cfg(target_os = "linux")]
+    fn open(filename: &str) -> ANNResult<File> {
+        use std::os::unix::fs::OpenOptionsExt;
+
+        let mut options = OpenOptions::new();
+        options.write(true).create(true).truncate(true);
+        // some file systems, such as tmpfs, refuse O_DIRECT
+        match options.clone().custom_flags(libc::O_DIRECT).open(filename) {
+            Ok(file) => Ok(file),
+            Err(_) => options.open(filename).map_err(ANNError::log_io_error),
+        }
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    fn open(filename: &str) -> ANNResult<File> {
+        OpenOptions::new()
+            .write(true)
+            .create(true)
+            .truncate(true)
+            .open(filename)
+            .map_err(ANNError::log_io_error)
+    }
+
+    /// Size of the buffers of `get_buffer`
+    pub fn block_size(&self) -> usize {
+        self.block_size
+    }
+
+    /// A buffer of block_size bytes to fill, waiting for an earlier block to be written if
+    /// NUM_BUFFERS are already out. Its content is that of an earlier block.
+    pub fn get_buffer(&mut self) -> ANNResult<AlignedBoxWithSlice<u8>> {
+        if self.num_buffers < NUM_BUFFERS {
+            self.num_buffers += 1;
+            return AlignedBoxWithSlice::new(self.block_size, self.sector_len);
+        }
+
+        match self.recycled.recv() {
+            Ok(buffer) => Ok(buffer),
+            Err(_) => Err(self.stopped_error()),
+        }
+    }
+
+    /// Queue the first len bytes of buffer, whole sectors, to be written after the blocks queued
+    /// before them
+    pub fn write(&mut self, buffer: AlignedBoxWithSlice<u8>, len: usize) -> ANNResult<()> {
+        if len % self.sector_len != 0 || len > buffer.len() {
+            return Err(ANNError::log_index_error(format!(
+                "Cannot write {} bytes of a buffer of {} in whole sectors of {}",
+                len,
+                buffer.len(),
+                self.sector_len
+            )));
+        }
+
+        let sent = match &self.sender {
+            Some(sender) => sender.send((buffer, len)).is_ok(),
+            None => false,
+        };
+        if sent {
+            Ok(())
+        } else {
+            Err(self.stopped_error())
+        }
+    }
+
+    /// Wait for the blocks queued so far to be written and return the number of bytes written
+    pub fn finish(mut self) -> ANNResult<u64> {
+        self.sender = None;
+        self.join()
+    }
+
+    fn join(&mut self) -> ANNResult<u64> {
+        match self.worker.take() {
+            Some(worker) => worker.join().map_err(|_| {
+                ANNError::log_index_error("The sector block writer panicked".to_string())
+            })?,
+            None => Err(ANNError::log_index_error(
+                "The sector block writer has stopped".to_string(),
+            )),
+        }
+    }
+
+    /// The error that stopped the worker, once it has stopped
+    fn stopped_error(&mut self) -> ANNError {
+        self.sender = None;
+        match self.join() {
+            Err(err) => err,
+            Ok(_) => ANNError::log_index_error("The sector block writer has stopped".to_string()),
+        }
+    }
+}
+
+impl Drop for SectorBlockWriter {
+    fn drop(&mut self) {
+        self.sender = None;
+        let _ = self.join();
+    }
+}
+
+#[cfg(test)]
+mod sector_block_writer_test {
+    use std::fs;
+
+    use super::*;
+
+    #[test]
+    fn writes_blocks_in_order() {
+        let file_name = "sector_block_writer_test.bin";
+        let mut writer = SectorBlockWriter::new(file_name, 4 * 4096, 4096).unwrap();
+        for i in 0..5u8 {
+            let mut buffer = writer.get_buffer().unwrap();
+            buffer.fill(i);
+            writer.write(buffer, (i as usize % 4 + 1) * 4096).unwrap();
+        }
+        assert_eq!(writer.finish().unwrap(), (1 + 2 + 3 + 4 + 1) * 4096);
+
+        let written = fs::read(file_name).unwrap();
+        fs::remove_file(file_name).expect("Failed to delete file");
+        let mut expected = Vec::new();
+        for i in 0..5u8 {
+            expected.extend(std::iter::repeat(i).take((i as usize % 4 + 1) * 4096));
+        }
+        assert!(written == expected);
+    }
+
+    #[test]
+    fn rejects_partial_sectors() {
+        let file_name = "sector_block_writer_partial_test.bin";
+        let mut writer = SectorBlockWriter::new(file_name, 2 * 4096, 4096).unwrap();
+        let buffer = writer.get_buffer().unwrap();
+        assert!(writer.write(buffer, 100).is_err());
+        drop(writer);
+        fs::remove_file(file_name).expect("Failed to delete file");
+    }
+}
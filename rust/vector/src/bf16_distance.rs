@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+#![warn(missing_debug_implementations, missing_docs)]
+
+//! Distance calculation for bf16 vectors
+//!
+//! A bf16 is the upper half of an f32, so it widens to one by a shift of 16 bits. The AVX2
+//! kernels widen 8 elements at a time and the AVX-512 ones 16, picked at run time. On CPUs with
+//! AVX-512-BF16 the inner product multiplies pairs of bf16 directly, 32 elements an instruction;
+//! the L2 kernels still widen, as the difference of two bf16 is not a bf16.
+
+use std::arch::x86_64::*;
+
+use crate::BFloat16;
+
+/// Calculate the squared L2 distance by vector arithmetic
+#[inline(never)]
+pub fn distance_l2_vector_bf16<const N: usize>(a: &[BFloat16; N], b: &[BFloat16; N]) -> f32 {
+    debug_assert_eq!(N % 8, 0);
+
+    if is_x86_feature_detected!("avx512f") {
+        unsafe { distance_l2_bf16_avx512::<N>(a, b) }
+    } else {
+        unsafe { distance_l2_bf16_avx2::<N>(a, b) }
+    }
+}
+
+/// Calculate the negated inner product by vector arithmetic, so that closer vectors compare
+/// smaller
+#[inline(never)]
+pub fn distance_ip_vector_bf16<const N: usize>(a: &[BFloat16; N], b: &[BFloat16; N]) -> f32 {
+    debug_assert_eq!(N % 8, 0);
+
+    if is_x86_feature_detected!("avx512bf16") && is_x86_feature_detected!("avx512f") {
+        unsafe { -inner_product_bf16_avx512bf16::<N>(a, b) }
+    } else if is_x86_feature_detected!("avx512f") {
+        unsafe { -inner_product_bf16_avx512::<N>(a, b, 0, _mm512_setzero_ps()) }
+    } else {
+        unsafe { -inner_product_bf16_avx2::<N>(a, b) }
+    }
+}
+
+/// Widen the 8 bf16 at ptr
+#[inline(always)]
+unsafe fn widen8_avx2(ptr: *const BFloat16) -> __m256 {
+    let halves = _mm_loadu_si128(ptr as *const __m128i);
+    _mm256_castsi256_ps(_mm256_slli_epi32::<16>(_mm256_cvtepu16_epi32(halves)))
+}
+
+#[inline(always)]
+unsafe fn reduce_avx2(sum: __m256) -> f32 {
+    let x128: __m128 = _mm_add_ps(_mm256_extractf128_ps(sum, 1), _mm256_castps256_ps128(sum));
+    /* ( -, -, x1+x3+x5+x7, x0+x2+x4+x6 ) */
+    let x64: __m128 = _mm_add_ps(x128, _mm_movehl_ps(x128, x128));
+    /* ( -, -, -, x0+x1+x2+x3+x4+x5+x6+x7 ) */
+    let x32: __m128 = _mm_add_ss(x64, _mm_shuffle_ps(x64, x64, 0x55));
+    _mm_cvtss_f32(x32)
+}
+
+unsafe fn distance_l2_bf16_avx2<const N: usize>(a: &[BFloat16; N], b: &[BFloat16; N]) -> f32 {
+    let mut sum = _mm256_setzero_ps();
+    for i in (0..N).step_by(8) {
+        let diff = _mm256_sub_ps(
+            widen8_avx2(a.as_ptr().add(i)),
+            widen8_avx2(b.as_ptr().add(i)),
+        );
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    reduce_avx2(sum)
+}
+
+unsafe fn inner_product_bf16_avx2<const N: usize>(a: &[BFloat16; N], b: &[BFloat16; N]) -> f32 {
+    let mut sum = _mm256_setzero_ps();
+    for i in (0..N).step_by(8) {
+        sum = _mm256_fmadd_ps(
+            widen8_avx2(a.as_ptr().add(i)),
+            widen8_avx2(b.as_ptr().add(i)),
+            sum,
+        );
+    }
+    reduce_avx2(sum)
+}
+
+/// Widen the 16 bf16 at ptr
+#[inline]
+#[target_feature(enable = "avx512f")]
+unsafe fn widen16_avx512(ptr: *const BFloat16) -> __m512 {
+    let halves = _mm256_loadu_si256(ptr as *const __m256i);
+    _mm512_castsi512_ps(_mm512_slli_epi32::<16>(_mm512_cvtepu16_epi32(halves)))
+}
+
+/// Widen the 8 bf16 at ptr into the lower half, with zeros above
+#[inline]
+#[target_feature(enable = "avx512f")]
+unsafe fn widen8_avx512(ptr: *const BFloat16) -> __m512 {
+    let halves = _mm256_zextsi128_si256(_mm_loadu_si128(ptr as *const __m128i));
+    _mm512_castsi512_ps(_mm512_slli_epi32::<16>(_mm512_cvtepu16_epi32(halves)))
+}
+
+#[target_feature(enable = "avx512f")]
+unsafe fn distance_l2_bf16_avx512<const N: usize>(a: &[BFloat16; N], b: &[BFloat16; N]) -> f32 {
+    let mut sum = _mm512_setzero_ps();
+    let mut i = 0;
+    while i + 16 <= N {
+        let diff = _mm512_sub_ps(
+            widen16_avx512(a.as_ptr().add(i)),
+            widen16_avx512(b.as_ptr().add(i)),
+        );
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+        i += 16;
+    }
+    if i < N {
+        let diff = _mm512_sub_ps(
+            widen8_avx512(a.as_ptr().add(i)),
+            widen8_avx512(b.as_ptr().add(i)),
+        );
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    _mm512_reduce_add_ps(sum)
+}
+
+/// Add the inner product of the elements from start on to the lanes of sum, and return the total
+#[target_feature(enable = "avx512f")]
+unsafe fn inner_product_bf16_avx512<const N: usize>(
+    a: &[BFloat16; N],
+    b: &[BFloat16; N],
+    start: usize,
+    mut sum: __m512,
+) -> f32 {
+    let mut i = start;
+    while i + 16 <= N {
+        sum = _mm512_fmadd_ps(
+            widen16_avx512(a.as_ptr().add(i)),
+            widen16_avx512(b.as_ptr().add(i)),
+            sum,
+        );
+        i += 16;
+    }
+    if i < N {
+        sum = _mm512_fmadd_ps(
+            widen8_avx512(a.as_ptr().add(i)),
+            widen8_avx512(b.as_ptr().add(i)),
+            sum,
+        );
+    }
+    _mm512_reduce_add_ps(sum)
+}
+
+#[target_feature(enable = "avx512bf16,avx512f")]
+unsafe fn inner_product_bf16_avx512bf16<const N: usize>(
+    a: &[BFloat16; N],
+    b: &[BFloat16; N],
+) -> f32 {
+    let mut sum = _mm512_setzero_ps();
+    let mut i = 0;
+    while i + 32 <= N {
+        let a_vec: __m512bh =
+            std::mem::transmute(_mm512_loadu_si512(a.as_ptr().add(i) as *const _));
+        let b_vec: __m512bh =
+            std::mem::transmute(_mm512_loadu_si512(b.as_ptr().add(i) as *const _));
+        sum = _mm512_dpbf16_ps(sum, a_vec, b_vec);
+        i += 32;
+    }
+    // dimensions are multiples of 8 rather than 32
+    inner_product_bf16_avx512::<N>(a, b, i, sum)
+}
+
+#[cfg(test)]
+mod bf16_distance_test {
+    use rand::{thread_rng, Rng};
+
+    use super::*;
+
+    fn random_vectors<const N: usize>() -> (Box<[BFloat16; N]>, Box<[BFloat16; N]>) {
+        let mut rng = thread_rng();
+        let a = Box::new([(); N].map(|_| BFloat16::from_f32(rng.gen_range(-1.0..1.0))));
+        let b = Box::new([(); N].map(|_| BFloat16::from_f32(rng.gen_range(-1.0..1.0))));
+        (a, b)
+    }
+
+    fn no_vector_l2(a: &[BFloat16], b: &[BFloat16]) -> f32 {
+        a.iter()
+            .zip(b)
+            .map(|(x, y)| (x.to_f32() - y.to_f32()).powi(2))
+            .sum()
+    }
+
+    fn no_vector_ip(a: &[BFloat16], b: &[BFloat16]) -> f32 {
+        a.iter().zip(b).map(|(x, y)| x.to_f32() * y.to_f32()).sum()
+    }
+
+    fn check<const N: usize>() {
+        let (a, b) = random_vectors::<N>();
+        let l2 = no_vector_l2(&a[..], &b[..]);
+        let ip = no_vector_ip(&a[..], &b[..]);
+
+        assert!((distance_l2_vector_bf16::<N>(&a, &b) - l2).abs() < 1e-3);
+        assert!((distance_ip_vector_bf16::<N>(&a, &b) + ip).abs() < 1e-3);
+        unsafe {
+            assert!((distance_l2_bf16_avx2::<N>(&a, &b) - l2).abs() < 1e-3);
+            assert!((inner_product_bf16_avx2::<N>(&a, &b) - ip).abs() < 1e-3);
+            if is_x86_feature_detected!("avx512f") {
+                assert!((distance_l2_bf16_avx512::<N>(&a, &b) - l2).abs() < 1e-3);
+                let sum = _mm512_setzero_ps();
+                assert!((inner_product_bf16_avx512::<N>(&a, &b, 0, sum) - ip).abs() < 1e-3);
+            }
+            if is_x86_feature_detected!("avx512bf16") && is_x86_feature_detected!("avx512f") {
+                assert!((inner_product_bf16_avx512bf16::<N>(&a, &b) - ip).abs() < 1e-3);
+            }
+        }
+    }
+
+    #[test]
+    fn kernels_match_novector() {
+        check::<104>();
+        check::<128>();
+        check::<256>();
+    }
+
+    #[test]
+    fn identical_vectors_have_no_l2_distance() {
+        let (a, _) = random_vectors::<104>();
+        assert_eq!(distance_l2_vector_bf16::<104>(&a, &a), 0.0);
+    }
+}
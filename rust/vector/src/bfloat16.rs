@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT license.
+ */
+use bytemuck::{Pod, Zeroable};
+use half::bf16;
+use std::convert::AsRef;
+use std::fmt;
+
+// Define the BFloat16 type as a new type over bf16, with the same 2 byte layout, the upper half of
+// an f32. It keeps the range of f32 at the precision of 8 bits, which is what the bf16 files of
+// convert_f32_to_bf16 hold.
+pub struct BFloat16(bf16);
+
+unsafe impl Pod for BFloat16 {}
+unsafe impl Zeroable for BFloat16 {}
+
+// Implement From<BFloat16> for f32
+impl From<BFloat16> for f32 {
+    fn from(val: BFloat16) -> Self {
+        val.0.to_f32()
+    }
+}
+
+// Implement AsRef<bf16> for BFloat16 so that it can be used in distance_compare.
+impl AsRef<bf16> for BFloat16 {
+    fn as_ref(&self) -> &bf16 {
+        &self.0
+    }
+}
+
+impl BFloat16 {
+    pub fn from_f32(value: f32) -> Self {
+        Self(bf16::from_f32(value))
+    }
+
+    pub fn to_f32(&self) -> f32 {
+        self.0.to_f32()
+    }
+}
+
+impl Default for BFloat16 {
+    fn default() -> Self {
+        Self(bf16::from_f32(Default::default()))
+    }
+}
+
+impl Clone for BFloat16 {
+    fn clone(&self) -> Self {
+        BFloat16(self.0)
+    }
+}
+
+impl Copy for BFloat16 {}
+
+impl fmt::Debug for BFloat16 {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "BFloat16({:?})", self.0)
+    }
+}
+
+unsafe impl Send for BFloat16 {}
+unsafe impl Sync for BFloat16 {}
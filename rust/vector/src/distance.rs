@@ -2,8 +2,9 @@
  * Copyright (c) Microsoft Corporation. All rights reserved.
  * Licensed under the MIT license.
  */
+use crate::bf16_distance::{distance_ip_vector_bf16, distance_l2_vector_bf16};
 use crate::l2_float_distance::{distance_l2_vector_f16, distance_l2_vector_f32};
-use crate::{Half, Metric};
+use crate::{BFloat16, Half, Metric};
 
 /// Distance contract for full-precision vertex
 pub trait FullPrecisionDistance<T, const N: usize> {
@@ -35,6 +36,18 @@ impl<const N: usize> FullPrecisionDistance<Half, N> for [Half; N] {
     }
 }
 
+// reason = "Not supported Metric type Metric::Cosine"
+#[allow(clippy::panic)]
+impl<const N: usize> FullPrecisionDistance<BFloat16, N> for [BFloat16; N] {
+    fn distance_compare(a: &[BFloat16; N], b: &[BFloat16; N], metric: Metric) -> f32 {
+        match metric {
+            Metric::L2 => distance_l2_vector_bf16::<N>(a, b),
+            Metric::InnerProduct => distance_ip_vector_bf16::<N>(a, b),
+            _ => panic!("Not supported Metric type {:?}", metric),
+        }
+    }
+}
+
 // reason = "Not yet supported Vector i8"
 #[allow(clippy::panic)]
 impl<const N: usize> FullPrecisionDistance<i8, N> for [i8; N] {
@@ -10,12 +10,15 @@
 // #![feature(stdsimd)]
 // mod f32x16;
 // Uncomment above 2 to experiment with f32x16
+mod bf16_distance;
+mod bfloat16;
 mod distance;
 mod half;
 mod l2_float_distance;
 mod metric;
 mod utils;
 
+pub use crate::bfloat16::BFloat16;
 pub use crate::half::Half;
 pub use distance::FullPrecisionDistance;
 pub use metric::Metric;
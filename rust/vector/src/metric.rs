@@ -14,6 +14,9 @@ pub enum Metric {
     /// Cosine similarity
     /// TODO: T should be float for Cosine distance
     Cosine,
+
+    /// Inner product, negated so that closer vectors compare smaller. Supported for bf16 vectors.
+    InnerProduct,
 }
 
 #[derive(thiserror::Error, Debug)]
@@ -29,6 +32,7 @@ impl FromStr for Metric {
         match s.to_lowercase().as_str() {
             "l2" => Ok(Metric::L2),
             "cosine" => Ok(Metric::Cosine),
+            "mips" | "inner_product" => Ok(Metric::InnerProduct),
             _ => Err(ParseMetricError::InvalidFormat(String::from(s))),
         }
     }
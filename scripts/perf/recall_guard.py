@@ -0,0 +1,185 @@
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT license.
+
+"""Recall and QPS regression guard over small in-memory and SSD indexes.
+
+The data step writes random base and query vectors with rand_data_gen and
+their ground truth with compute_groundtruth, unless they are there already.
+The check step builds the memory or disk index of recall_guard.json from
+scratch, searches it over its search list sizes and fails if the recall at
+any L is below the floor of the config, or has dropped by more than the
+tolerance since the baseline. QPS and p99 latency are compared with the
+baseline too, within their own tolerances. Baselines depend on the machine,
+so they live in the work directory (or --baseline): the first check records
+one, and --update_baseline replaces it after an intended change.
+
+    python scripts/perf/recall_guard.py data --bin_dir build/apps --work_dir build/recall_guard
+    python scripts/perf/recall_guard.py check memory --bin_dir build/apps --work_dir build/recall_guard
+
+The CTest targets of the RECALL_TESTS CMake option run these steps.
+"""
+
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+
+BUILD_APPS = {"memory": "build_memory_index", "disk": "build_disk_index"}
+SEARCH_APPS = {"memory": "search_memory_index", "disk": "search_disk_index"}
+
+
+def to_flags(params):
+    """Command line flags of a dict of parameters: a value per key, several
+    for lists, and the bare flag for true booleans."""
+    flags = []
+    for key, value in params.items():
+        if isinstance(value, bool):
+            if value:
+                flags.append("--" + key)
+        elif isinstance(value, list):
+            flags += ["--" + key] + [str(v) for v in value]
+        else:
+            flags += ["--" + key, str(value)]
+    return flags
+
+
+def run(command, log):
+    log.write(" ".join(command) + "\n")
+    log.flush()
+    subprocess.run(command, stdout=log, stderr=subprocess.STDOUT, check=True)
+
+
+def data_files(work_dir):
+    return {name: os.path.join(work_dir, name) for name in ("base.bin", "query.bin", "gt.bin")}
+
+
+def make_data(args, config, log):
+    dataset = config["dataset"]
+    files = data_files(args.work_dir)
+    for name, count in (("base.bin", dataset["num_points"]), ("query.bin", dataset["num_queries"])):
+        if not os.path.exists(files[name]):
+            run([os.path.join(args.utils_dir, "rand_data_gen"), "--data_type", dataset["data_type"],
+                 "--output_file", files[name], "-D", str(dataset["dim"]), "-N", str(count),
+                 "--norm", str(dataset["norm"])], log)
+    if not os.path.exists(files["gt.bin"]):
+        run([os.path.join(args.utils_dir, "compute_groundtruth"), "--data_type", dataset["data_type"],
+             "--dist_fn", dataset["dist_fn"], "--base_file", files["base.bin"], "--query_file", files["query.bin"],
+             "--gt_file", files["gt.bin"], "--K", str(dataset["recall_at"])], log)
+    return 0
+
+
+def measure(args, config, index_type, log):
+    """Builds the index and returns the stats rows of its search, keyed by L.
+    The search list sizes are searched twice in the same process and only
+    the second pass is kept, so that the caches are warm."""
+    dataset = config["dataset"]
+    index = config["indexes"][index_type]
+    files = data_files(args.work_dir)
+    for path in files.values():
+        if not os.path.exists(path):
+            sys.exit("Missing {}; run the data step first".format(path))
+    index_prefix = os.path.join(args.work_dir, index_type + "_index")
+
+    run([os.path.join(args.bin_dir, BUILD_APPS[index_type]), "--data_type", dataset["data_type"],
+         "--dist_fn", dataset["dist_fn"], "--data_path", files["base.bin"],
+         "--index_path_prefix", index_prefix] + to_flags(index["build"]), log)
+
+    Ls = index["search"]["L"]
+    stats_file = os.path.join(args.work_dir, index_type + "_stats.csv")
+    if os.path.exists(stats_file):
+        os.remove(stats_file)
+    run([os.path.join(args.bin_dir, SEARCH_APPS[index_type]), "--data_type", dataset["data_type"],
+         "--dist_fn", dataset["dist_fn"], "--index_path_prefix", index_prefix, "--query_file", files["query.bin"],
+         "--gt_file", files["gt.bin"], "--recall_at", str(dataset["recall_at"]),
+         "--result_path", os.path.join(args.work_dir, index_type + "_res"), "--stats_file", stats_file,
+         "--search_list"] + [str(L) for L in Ls * 2] + to_flags(index["search"].get("options", {})), log)
+
+    with open(stats_file) as f:
+        rows = list(csv.DictReader(f))[len(Ls):]
+    return {row["L"]: {"recall": float(row["recall"]), "qps": float(row["qps"]),
+                       "p99_latency_us": float(row["p99_latency_us"])} for row in rows}
+
+
+def compare(config, index_type, results, baseline):
+    """The failures of results against the recall floors of the config and
+    against baseline, if there is one."""
+    tolerance = config["tolerance"]
+    floors = config["indexes"][index_type].get("min_recall", {})
+    failures = []
+    for L, result in sorted(results.items(), key=lambda item: int(item[0])):
+        if L in floors and result["recall"] < floors[L]:
+            failures.append("L={}: recall {:.4f} is below the floor of {:.4f}".format(L, result["recall"], floors[L]))
+        if baseline is None or L not in baseline:
+            continue
+        base = baseline[L]
+        if result["recall"] < base["recall"] - tolerance["recall"]:
+            failures.append("L={}: recall {:.4f} dropped from {:.4f}".format(L, result["recall"], base["recall"]))
+        if result["qps"] < base["qps"] * (1 - tolerance["qps"]):
+            failures.append("L={}: QPS {:.0f} dropped from {:.0f}".format(L, result["qps"], base["qps"]))
+        if result["p99_latency_us"] > base["p99_latency_us"] * (1 + tolerance["latency"]):
+            failures.append("L={}: p99 latency {:.0f}us rose from {:.0f}us".format(
+                L, result["p99_latency_us"], base["p99_latency_us"]))
+    return failures
+
+
+def check(args, config, log):
+    index_type = args.index
+    results = measure(args, config, index_type, log)
+    with open(os.path.join(args.work_dir, index_type + "_results.json"), "w") as f:
+        json.dump(results, f, indent=2)
+
+    baseline_path = args.baseline or os.path.join(args.work_dir, "baseline.json")
+    baselines = {}
+    if os.path.exists(baseline_path):
+        with open(baseline_path) as f:
+            baselines = json.load(f)
+    baseline = None if args.update_baseline else baselines.get(index_type)
+
+    print("{:>6} {:>10} {:>10} {:>14}".format("L", "recall", "QPS", "p99 (us)"))
+    for L, result in sorted(results.items(), key=lambda item: int(item[0])):
+        print("{:>6} {:>10.4f} {:>10.0f} {:>14.0f}".format(L, result["recall"], result["qps"],
+                                                           result["p99_latency_us"]))
+    failures = compare(config, index_type, results, baseline)
+
+    if baseline is None and not failures:
+        baselines[index_type] = results
+        with open(baseline_path, "w") as f:
+            json.dump(baselines, f, indent=2)
+        print("Recorded the {} baseline in {}".format(index_type, baseline_path))
+    for failure in failures:
+        print("FAIL " + failure)
+    return 1 if failures else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("step", choices=["data", "check"])
+    parser.add_argument("index", nargs="?", choices=sorted(BUILD_APPS), help="index to check")
+    parser.add_argument("--config", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                         "recall_guard.json"))
+    parser.add_argument("--bin_dir", default="build/apps", help="directory of the build and search apps")
+    parser.add_argument("--utils_dir", help="directory of rand_data_gen and compute_groundtruth (bin_dir/utils)")
+    parser.add_argument("--work_dir", default="recall_guard", help="directory of the data, indexes and baseline")
+    parser.add_argument("--baseline", help="baseline file, work_dir/baseline.json by default")
+    parser.add_argument("--update_baseline", action="store_true", help="replace the baseline with this run")
+    args = parser.parse_args()
+    if args.step == "check" and args.index is None:
+        parser.error("check needs the index to check: " + " or ".join(sorted(BUILD_APPS)))
+    args.utils_dir = args.utils_dir or os.path.join(args.bin_dir, "utils")
+
+    with open(args.config) as f:
+        config = json.load(f)
+    os.makedirs(args.work_dir, exist_ok=True)
+    log_name = "data.log" if args.step == "data" else args.index + ".log"
+    with open(os.path.join(args.work_dir, log_name), "w") as log:
+        try:
+            return make_data(args, config, log) if args.step == "data" else check(args, config, log)
+        except subprocess.CalledProcessError as e:
+            print("{} failed with status {}; see {}".format(e.cmd[0], e.returncode, log.name))
+            return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,168 @@
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT license.
+
+"""Recall, QPS and latency sweeps over in-memory and SSD indexes.
+
+Builds each index of a YAML config (see sweep_example.yaml) with
+build_memory_index or build_disk_index, unless it already exists, and runs
+search_memory_index or search_disk_index over every combination of the
+thread counts and beam widths of its sweep, each time over all its search
+list sizes. The searches write their measurements with --stats_file; this
+script collects them into one CSV or JSON file (by the extension of the
+output path), one row per dataset, index, threads, beam width and L, and
+marks the rows on the recall-QPS Pareto front of each index and thread count.
+
+    python scripts/perf/sweep.py config.yaml -o results.csv
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import os
+import subprocess
+import sys
+import time
+
+import yaml
+
+BUILD_APPS = {"memory": "build_memory_index", "disk": "build_disk_index"}
+SEARCH_APPS = {"memory": "search_memory_index", "disk": "search_disk_index"}
+
+# files whose presence means an index was built
+INDEX_FILES = {"memory": "{}", "disk": "{}_disk.index"}
+
+STATS_COLUMNS = ["L", "beamwidth", "threads", "qps", "mean_latency_us", "p50_latency_us", "p99_latency_us",
+                 "p999_latency_us", "mean_ios", "mean_cmps", "recall"]
+COLUMNS = ["dataset", "index", "type", "build_seconds"] + STATS_COLUMNS + ["pareto"]
+
+
+def to_flags(params):
+    """Command line flags of a dict of parameters: a value per key, several
+    for lists, and the bare flag for true booleans."""
+    flags = []
+    for key, value in params.items():
+        if isinstance(value, bool):
+            if value:
+                flags.append("--" + key)
+        elif isinstance(value, list):
+            flags += ["--" + key] + [str(v) for v in value]
+        else:
+            flags += ["--" + key, str(value)]
+    return flags
+
+
+def run(command, log):
+    log.write(" ".join(command) + "\n")
+    log.flush()
+    subprocess.run(command, stdout=log, stderr=subprocess.STDOUT, check=True)
+
+
+def build(config, dataset, index, index_prefix, log):
+    """Builds the index unless it exists; returns the build time in seconds,
+    or None if the index was there already."""
+    index_type = index["type"]
+    if os.path.exists(INDEX_FILES[index_type].format(index_prefix)):
+        print("Using existing index " + index_prefix)
+        return None
+    command = [os.path.join(config["bin_dir"], BUILD_APPS[index_type]),
+               "--data_type", dataset["data_type"], "--dist_fn", dataset["dist_fn"],
+               "--data_path", dataset["base_file"], "--index_path_prefix", index_prefix]
+    command += to_flags(index.get("build", {}))
+    print("Building " + index_prefix)
+    start = time.monotonic()
+    run(command, log)
+    return time.monotonic() - start
+
+
+def search(config, dataset, index, index_prefix, threads, beamwidth, log):
+    """Runs one search over all the L values of the index; returns the rows of
+    its stats file. With warmup, the L values are searched twice in the same
+    process and only the second pass is kept."""
+    index_type = index["type"]
+    sweep = index["search"]
+    Ls = [L for L in sweep["L"] if L >= dataset["recall_at"]]
+    passes = 2 if config.get("warmup", True) else 1
+    stats_file = os.path.join(config["work_dir"], "stats.csv")
+    if os.path.exists(stats_file):
+        os.remove(stats_file)
+
+    command = [os.path.join(config["bin_dir"], SEARCH_APPS[index_type]),
+               "--data_type", dataset["data_type"], "--dist_fn", dataset["dist_fn"],
+               "--index_path_prefix", index_prefix, "--query_file", dataset["query_file"],
+               "--gt_file", dataset.get("gt_file", "null"), "--recall_at", str(dataset["recall_at"]),
+               "--result_path", os.path.join(config["work_dir"], "res"), "--num_threads", str(threads),
+               "--stats_file", stats_file, "--search_list"] + [str(L) for L in Ls * passes]
+    if beamwidth is not None:
+        command += ["--beamwidth", str(beamwidth)]
+    command += to_flags(sweep.get("options", {}))
+    run(command, log)
+
+    with open(stats_file) as f:
+        rows = list(csv.DictReader(f))
+    return rows[len(rows) - len(Ls):]
+
+
+def mark_pareto(rows):
+    """Sets pareto on the rows that no other row of the same dataset, index
+    and thread count beats in both recall and QPS."""
+    groups = {}
+    for row in rows:
+        groups.setdefault((row["dataset"], row["index"], row["threads"]), []).append(row)
+    for group in groups.values():
+        best_qps = -1.0
+        for row in sorted(group, key=lambda r: (-float(r["recall"] or 0), -float(r["qps"]))):
+            row["pareto"] = float(row["qps"]) > best_qps
+            best_qps = max(best_qps, float(row["qps"]))
+
+
+def write(rows, path):
+    if path.endswith(".json"):
+        with open(path, "w") as f:
+            json.dump(rows, f, indent=2)
+    else:
+        with open(path, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=COLUMNS)
+            writer.writeheader()
+            writer.writerows(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("config", help="YAML file of datasets, indexes and search sweeps")
+    parser.add_argument("-o", "--output", default="sweep_results.csv", help="CSV or JSON file of the results")
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        config = yaml.safe_load(f)
+    config.setdefault("bin_dir", "build/apps")
+    config.setdefault("work_dir", "sweep")
+    os.makedirs(config["work_dir"], exist_ok=True)
+
+    rows = []
+    with open(os.path.join(config["work_dir"], "sweep.log"), "a") as log:
+        for dataset in config["datasets"]:
+            for index in config["indexes"]:
+                if index["type"] not in BUILD_APPS:
+                    sys.exit("Unknown index type {}, use memory or disk".format(index["type"]))
+                index_prefix = os.path.join(config["work_dir"], "{}_{}".format(dataset["name"], index["name"]))
+                build_seconds = build(config, dataset, index, index_prefix, log)
+
+                sweep = index["search"]
+                beamwidths = sweep.get("beamwidth", [None]) if index["type"] == "disk" else [None]
+                for threads, beamwidth in itertools.product(sweep.get("threads", [os.cpu_count()]), beamwidths):
+                    print("Searching {} with {} threads{}".format(
+                        index_prefix, threads, "" if beamwidth is None else ", beam width {}".format(beamwidth)))
+                    for stats in search(config, dataset, index, index_prefix, threads, beamwidth, log):
+                        row = {"dataset": dataset["name"], "index": index["name"], "type": index["type"],
+                               "build_seconds": "" if build_seconds is None else round(build_seconds, 1)}
+                        row.update(stats)
+                        rows.append(row)
+
+    mark_pareto(rows)
+    write(rows, args.output)
+    print("Wrote {} rows to {}".format(len(rows), args.output))
+
+
+if __name__ == "__main__":
+    main()
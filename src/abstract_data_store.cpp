@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "abstract_data_store.h"
+#include "ann_exception.h"
 
 namespace diskann
 {
@@ -23,6 +24,58 @@ template <typename data_t> size_t AbstractDataStore<data_t>::get_dims() const
     return _dim;
 }
 
+template <typename data_t> location_t AbstractDataStore<data_t>::load_mmap(const std::string &filename)
+{
+    throw ANNException("ERROR: this data store cannot be loaded from a memory-mapped file", -1, __FUNCSIG__,
+                       __FILE__, __LINE__);
+}
+
+template <typename data_t>
+size_t AbstractDataStore<data_t>::save_mmap(const std::string &filename, const location_t num_pts)
+{
+    throw ANNException("ERROR: this data store cannot be saved as a memory-mapped file", -1, __FUNCSIG__, __FILE__,
+                       __LINE__);
+}
+
+template <typename data_t>
+location_t AbstractDataStore<data_t>::populate_data_mmap(const std::string &filename, const std::string &mmap_file)
+{
+    throw ANNException("ERROR: this data store cannot be backed by a memory-mapped file", -1, __FUNCSIG__, __FILE__,
+                       __LINE__);
+}
+
+template <typename data_t>
+bool AbstractDataStore<data_t>::use_external_data(const data_t *vectors, const location_t num_pts,
+                                                  std::shared_ptr<const void> owner)
+{
+    return false;
+}
+
+template <typename data_t>
+void AbstractDataStore<data_t>::get_distances_to(const location_t loc, const location_t *locations,
+                                                 const uint32_t location_count, float *distances) const
+{
+    for (uint32_t i = 0; i < location_count; i++)
+    {
+        distances[i] = get_distance(locations[i], loc);
+    }
+}
+
+template <typename data_t>
+float AbstractDataStore<data_t>::get_distance_with_bound(const data_t *query, const location_t loc,
+                                                         const float bound) const
+{
+    return get_distance(query, loc);
+}
+
+template <typename data_t>
+void AbstractDataStore<data_t>::get_distances_to_with_bound(const location_t loc, const location_t *locations,
+                                                            const uint32_t location_count, const float *bounds,
+                                                            float *distances) const
+{
+    get_distances_to(loc, locations, location_count, distances);
+}
+
 template <typename data_t> location_t AbstractDataStore<data_t>::resize(const location_t new_num_points)
 {
     if (new_num_points > _capacity)
@@ -41,5 +94,7 @@ template <typename data_t> location_t AbstractDataStore<data_t>::resize(const lo
 
 template DISKANN_DLLEXPORT class AbstractDataStore<float>;
 template DISKANN_DLLEXPORT class AbstractDataStore<int8_t>;
+template DISKANN_DLLEXPORT class AbstractDataStore<float16>;
+template DISKANN_DLLEXPORT class AbstractDataStore<bfloat16>;
 template DISKANN_DLLEXPORT class AbstractDataStore<uint8_t>;
 } // namespace diskann
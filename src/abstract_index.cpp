@@ -66,6 +66,15 @@ int AbstractIndex::insert_point(const data_type *point, const tag_type tag, cons
     return this->_insert_point(any_point, any_tag, any_labels);
 }
 
+template <typename data_type, typename tag_type>
+size_t AbstractIndex::insert_points(const data_type *points, const tag_type *tags, const size_t num_points,
+                                    std::vector<int> &insert_retvals)
+{
+    auto any_points = std::any(points);
+    auto any_tags = std::any(tags);
+    return this->_insert_points(any_points, any_tags, num_points, insert_retvals);
+}
+
 template <typename tag_type> int AbstractIndex::lazy_delete(const tag_type &tag)
 {
     auto any_tag = std::any(tag);
@@ -234,6 +243,34 @@ template DISKANN_DLLEXPORT int AbstractIndex::insert_point<float, uint64_t>(cons
 template DISKANN_DLLEXPORT int AbstractIndex::insert_point<uint8_t, uint64_t>(const uint8_t *point, const uint64_t tag);
 template DISKANN_DLLEXPORT int AbstractIndex::insert_point<int8_t, uint64_t>(const int8_t *point, const uint64_t tag);
 
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<float, int32_t>(
+    const float *points, const int32_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<uint8_t, int32_t>(
+    const uint8_t *points, const int32_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<int8_t, int32_t>(
+    const int8_t *points, const int32_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<float, uint32_t>(
+    const float *points, const uint32_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<uint8_t, uint32_t>(
+    const uint8_t *points, const uint32_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<int8_t, uint32_t>(
+    const int8_t *points, const uint32_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<float, int64_t>(
+    const float *points, const int64_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<uint8_t, int64_t>(
+    const uint8_t *points, const int64_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<int8_t, int64_t>(
+    const int8_t *points, const int64_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<float, uint64_t>(
+    const float *points, const uint64_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<uint8_t, uint64_t>(
+    const uint8_t *points, const uint64_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+template DISKANN_DLLEXPORT size_t AbstractIndex::insert_points<int8_t, uint64_t>(
+    const int8_t *points, const uint64_t *tags, const size_t num_points, std::vector<int> &insert_retvals);
+
 template DISKANN_DLLEXPORT int AbstractIndex::insert_point<float, int32_t, uint16_t>(
     const float *point, const int32_t tag, const std::vector<uint16_t> &labels);
 template DISKANN_DLLEXPORT int AbstractIndex::insert_point<uint8_t, int32_t, uint16_t>(
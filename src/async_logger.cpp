@@ -0,0 +1,242 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "async_logger.h"
+#include "logger.h"
+
+namespace diskann
+{
+std::atomic<int> AsyncLogger::_min_severity{(int)LogSeverity::Debug};
+
+namespace
+{
+const uint32_t FLUSH_INTERVAL_MS = 10;
+
+struct LogSlot
+{
+    uint64_t ts_ns;
+    LogSeverity severity;
+    uint32_t length;
+    char text[AsyncLogger::MESSAGE_SIZE + 1];
+};
+
+// The messages of one thread. Only that thread advances head, when it
+// publishes a message, and only the flusher advances tail, once it has
+// written the messages before it.
+struct ThreadLogBuffer
+{
+    std::vector<LogSlot> slots{AsyncLogger::MESSAGES_PER_THREAD};
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+uint64_t now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void write_to_streams(LogSeverity severity, const char *text)
+{
+    if (severity >= LogSeverity::Warning)
+        diskann::cerr << text << "\n";
+    else
+        diskann::cout << text << "\n";
+}
+
+// Buffers outlive their threads so that the messages of a thread that exits
+// are still written. The registry is never destroyed, so threads may log
+// while the process exits; what they log after the exit handler has run is
+// lost.
+struct LogRegistry
+{
+    std::mutex lock; // guards buffers
+    std::vector<std::unique_ptr<ThreadLogBuffer>> buffers;
+
+    std::mutex flush_lock; // serializes flushes and guards the fields below
+    std::function<void(LogSeverity, const char *)> sink = write_to_streams;
+    uint64_t reported_dropped = 0;
+
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread flusher;
+
+    void flush()
+    {
+        std::vector<ThreadLogBuffer *> pending;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto &buffer : buffers)
+                pending.push_back(buffer.get());
+        }
+
+        std::lock_guard<std::mutex> guard(flush_lock);
+        // the messages of all threads, written in the order they were logged
+        std::vector<std::pair<uint64_t, LogSlot *>> messages;
+        std::vector<uint64_t> heads(pending.size());
+        uint64_t dropped = 0;
+        for (size_t b = 0; b < pending.size(); b++)
+        {
+            ThreadLogBuffer *buffer = pending[b];
+            heads[b] = buffer->head.load(std::memory_order_acquire);
+            for (uint64_t i = buffer->tail.load(std::memory_order_relaxed); i < heads[b]; i++)
+            {
+                LogSlot &slot = buffer->slots[i % buffer->slots.size()];
+                messages.emplace_back(slot.ts_ns, &slot);
+            }
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        std::stable_sort(messages.begin(), messages.end(),
+                         [](const std::pair<uint64_t, LogSlot *> &a, const std::pair<uint64_t, LogSlot *> &b) {
+                             return a.first < b.first;
+                         });
+
+        if (dropped > reported_dropped)
+        {
+            const std::string note = "Dropped " + std::to_string(dropped - reported_dropped) +
+                                     " log messages written faster than they could be flushed";
+            sink(LogSeverity::Warning, note.c_str());
+            reported_dropped = dropped;
+        }
+        for (auto &message : messages)
+            sink(message.second->severity, message.second->text);
+        if (!messages.empty())
+        {
+            diskann::cout.flush();
+            diskann::cerr.flush();
+        }
+
+        for (size_t b = 0; b < pending.size(); b++)
+            pending[b]->tail.store(heads[b], std::memory_order_release);
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> guard(wake_lock);
+        while (!stopping)
+        {
+            wake.wait_for(guard, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+            guard.unlock();
+            flush();
+            guard.lock();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(wake_lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (flusher.joinable())
+            flusher.join();
+        flush();
+    }
+};
+
+LogRegistry &registry()
+{
+    static LogRegistry *instance = [] {
+        LogRegistry *reg = new LogRegistry();
+        reg->flusher = std::thread([reg] { reg->run(); });
+        std::atexit([] { registry().stop(); });
+        return reg;
+    }();
+    return *instance;
+}
+
+ThreadLogBuffer *register_thread()
+{
+    LogRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.buffers.emplace_back(new ThreadLogBuffer());
+    return reg.buffers.back().get();
+}
+
+ThreadLogBuffer *thread_buffer()
+{
+    thread_local ThreadLogBuffer *buffer = register_thread();
+    return buffer;
+}
+} // namespace
+
+void AsyncLogger::set_min_severity(LogSeverity severity)
+{
+    _min_severity.store((int)severity, std::memory_order_relaxed);
+}
+
+void AsyncLogger::set_sink(std::function<void(LogSeverity, const char *)> sink)
+{
+    LogRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.flush_lock);
+    reg.sink = sink ? std::move(sink) : write_to_streams;
+}
+
+void AsyncLogger::flush()
+{
+    registry().flush();
+}
+
+uint64_t AsyncLogger::num_dropped()
+{
+    LogRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    uint64_t dropped = 0;
+    for (auto &buffer : reg.buffers)
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    return dropped;
+}
+
+bool AsyncLogger::rate_limit(std::atomic<uint64_t> &next_us, uint64_t interval_ms)
+{
+    const uint64_t now_us = now_ns() / 1000;
+    uint64_t next = next_us.load(std::memory_order_relaxed);
+    if (now_us < next)
+        return false;
+    return next_us.compare_exchange_strong(next, now_us + interval_ms * 1000, std::memory_order_relaxed);
+}
+
+LogMessage::LogMessage(LogSeverity severity) : _severity(severity), _slot(nullptr), _stream(&_buf)
+{
+    ThreadLogBuffer *buffer = thread_buffer();
+    const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    if (head - buffer->tail.load(std::memory_order_acquire) >= buffer->slots.size())
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        _buf.set(nullptr, 0);
+        return;
+    }
+    LogSlot *slot = &buffer->slots[head % buffer->slots.size()];
+    _slot = slot;
+    _buf.set(slot->text, AsyncLogger::MESSAGE_SIZE);
+}
+
+LogMessage::~LogMessage()
+{
+    if (_slot == nullptr)
+        return;
+    LogSlot *slot = (LogSlot *)_slot;
+    slot->length = (uint32_t)_buf.length();
+    slot->text[slot->length] = '\0';
+    slot->severity = _severity;
+    slot->ts_ns = now_ns();
+
+    ThreadLogBuffer *buffer = thread_buffer();
+    buffer->head.store(buffer->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    if (_severity >= LogSeverity::Error)
+        registry().wake.notify_one();
+}
+} // namespace diskann
@@ -0,0 +1,211 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "build_manifest.h"
+#include "ann_exception.h"
+#include "logger.h"
+#include "utils.h"
+
+namespace diskann
+{
+namespace
+{
+const std::string MANIFEST_HEADER = "diskann_build_manifest 1";
+
+// -1 if the file does not exist
+int64_t file_size_or_missing(const std::string &path)
+{
+    if (!file_exists(path))
+        return -1;
+    return (int64_t)get_file_size(path);
+}
+} // namespace
+
+BuildManifest::BuildManifest(const std::string &path, const std::string &build_key, bool resume)
+    : _path(path), _build_key(build_key), _resume(resume)
+{
+    if (!resume || !file_exists(path))
+        return;
+
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != MANIFEST_HEADER)
+    {
+        diskann::cout << "Ignoring unreadable build manifest " << path << std::endl;
+        return;
+    }
+    if (!std::getline(in, line) || line != "key " + build_key)
+    {
+        diskann::cout << "Ignoring build manifest " << path << " written for a different build" << std::endl;
+        return;
+    }
+
+    // "started <stage>" or "done <stage> <num_artifacts>", each artifact on
+    // a line of its own as "<size> <path>"
+    while (std::getline(in, line))
+    {
+        std::istringstream tokens(line);
+        std::string state, name;
+        tokens >> state >> name;
+        Stage &stage = _stages[name];
+        if (state == "done")
+        {
+            size_t num_artifacts = 0;
+            tokens >> num_artifacts;
+            stage.done = true;
+            for (size_t i = 0; i < num_artifacts && std::getline(in, line); i++)
+            {
+                const size_t space = line.find(' ');
+                if (space == std::string::npos)
+                    break;
+                stage.artifacts.emplace_back(line.substr(space + 1), std::stoull(line.substr(0, space)));
+            }
+        }
+    }
+    diskann::cout << "Resuming build from manifest " << path << std::endl;
+}
+
+bool BuildManifest::is_done(const std::string &stage) const
+{
+    auto iter = _stages.find(stage);
+    if (iter == _stages.end() || !iter->second.done)
+        return false;
+    for (const auto &artifact : iter->second.artifacts)
+    {
+        if (file_size_or_missing(artifact.first) != (int64_t)artifact.second)
+        {
+            diskann::cout << "Redoing stage " << stage << ": " << artifact.first << " is missing or changed"
+                          << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BuildManifest::in_progress(const std::string &stage) const
+{
+    auto iter = _stages.find(stage);
+    return iter != _stages.end() && !iter->second.done;
+}
+
+std::vector<std::string> BuildManifest::artifacts(const std::string &stage) const
+{
+    std::vector<std::string> paths;
+    auto iter = _stages.find(stage);
+    if (iter != _stages.end())
+    {
+        for (const auto &artifact : iter->second.artifacts)
+            paths.push_back(artifact.first);
+    }
+    return paths;
+}
+
+void BuildManifest::begin(const std::string &stage)
+{
+    _stages[stage] = Stage();
+    save();
+}
+
+void BuildManifest::mark_done(const std::string &stage, const std::vector<std::string> &artifacts)
+{
+    Stage done;
+    done.done = true;
+    for (const auto &artifact : artifacts)
+    {
+        const int64_t size = file_size_or_missing(artifact);
+        if (size < 0)
+            throw ANNException("Stage " + stage + " did not produce " + artifact, -1, __FUNCSIG__, __FILE__,
+                               __LINE__);
+        done.artifacts.emplace_back(artifact, (uint64_t)size);
+    }
+    _stages[stage] = done;
+    save();
+}
+
+void BuildManifest::refresh(const std::vector<std::string> &stages)
+{
+    for (const auto &stage : stages)
+    {
+        auto iter = _stages.find(stage);
+        if (iter != _stages.end() && iter->second.done)
+            mark_done(stage, artifacts(stage));
+    }
+}
+
+void BuildManifest::invalidate(const std::vector<std::string> &stages)
+{
+    size_t erased = 0;
+    for (const auto &stage : stages)
+        erased += _stages.erase(stage);
+    if (erased > 0)
+        save();
+}
+
+void BuildManifest::remove()
+{
+    _stages.clear();
+    std::remove(_path.c_str());
+}
+
+void BuildManifest::save() const
+{
+    const std::string tmp_path = _path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        out << MANIFEST_HEADER << "\n" << "key " << _build_key << "\n";
+        for (const auto &stage : _stages)
+        {
+            if (!stage.second.done)
+            {
+                out << "started " << stage.first << "\n";
+                continue;
+            }
+            out << "done " << stage.first << " " << stage.second.artifacts.size() << "\n";
+            for (const auto &artifact : stage.second.artifacts)
+                out << artifact.second << " " << artifact.first << "\n";
+        }
+        out.flush();
+        if (!out)
+            throw ANNException("Failed to write build manifest " + tmp_path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#ifdef _WINDOWS
+    // rename does not replace an existing file here
+    std::remove(_path.c_str());
+#endif
+    if (std::rename(tmp_path.c_str(), _path.c_str()) != 0)
+        throw ANNException("Failed to replace build manifest " + _path, -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+std::vector<uint32_t> parse_shard_list(const std::string &list)
+{
+    std::vector<uint32_t> shards;
+    if (list == "none")
+        return shards;
+
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty())
+            continue;
+        try
+        {
+            const size_t dash = range.find('-');
+            const uint32_t first = (uint32_t)std::stoul(range.substr(0, dash));
+            const uint32_t last = dash == std::string::npos ? first : (uint32_t)std::stoul(range.substr(dash + 1));
+            for (uint32_t shard = first; shard <= last; shard++)
+                shards.push_back(shard);
+        }
+        catch (const std::logic_error &)
+        {
+            throw ANNException("Invalid shard list " + list + ". Use ids and ranges such as 0,2,5-7, or none.", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+    return shards;
+}
+} // namespace diskann
@@ -0,0 +1,272 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WINDOWS
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "ann_exception.h"
+#include "build_profiler.h"
+
+namespace diskann
+{
+std::atomic<bool> BuildProfiler::_enabled{false};
+
+namespace
+{
+// the resources the process has used up to a point in time
+struct UsageSample
+{
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t storage_bytes_read = 0;
+    uint64_t storage_bytes_written = 0;
+};
+
+double wall_seconds()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#ifdef _WINDOWS
+double filetime_seconds(const FILETIME &time)
+{
+    return (double)(((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 1e7;
+}
+
+UsageSample sample_usage()
+{
+    UsageSample sample;
+    sample.wall_seconds = wall_seconds();
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        sample.cpu_seconds = filetime_seconds(kernel) + filetime_seconds(user);
+    // Windows does not tell reads served from the cache apart
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(GetCurrentProcess(), &io))
+    {
+        sample.bytes_read = sample.storage_bytes_read = io.ReadTransferCount;
+        sample.bytes_written = sample.storage_bytes_written = io.WriteTransferCount;
+    }
+    return sample;
+}
+
+uint64_t peak_rss_bytes()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+}
+
+bool reset_peak_rss()
+{
+    return false;
+}
+#else
+UsageSample sample_usage()
+{
+    UsageSample sample;
+    sample.wall_seconds = wall_seconds();
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        sample.cpu_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec +
+                             usage.ru_stime.tv_usec / 1e6;
+    }
+    // rchar and wchar count the bytes of every read and write call, the
+    // others only those that reached storage
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value)
+    {
+        if (key == "rchar:")
+            sample.bytes_read = value;
+        else if (key == "wchar:")
+            sample.bytes_written = value;
+        else if (key == "read_bytes:")
+            sample.storage_bytes_read = value;
+        else if (key == "write_bytes:")
+            sample.storage_bytes_written = value;
+    }
+    return sample;
+}
+
+uint64_t peak_rss_bytes()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    }
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? (uint64_t)usage.ru_maxrss * 1024 : 0;
+}
+
+// restarts the peak from the current resident size (Linux 4.0 and later)
+bool reset_peak_rss()
+{
+    FILE *clear_refs = std::fopen("/proc/self/clear_refs", "w");
+    if (clear_refs == nullptr)
+        return false;
+    const bool reset = std::fputs("5", clear_refs) >= 0;
+    return std::fclose(clear_refs) == 0 && reset;
+}
+#endif
+
+struct StageRecord
+{
+    std::string name;
+    int64_t parent;
+    bool done = false;
+    UsageSample start;
+    UsageSample end;
+    uint64_t peak_rss = 0;
+};
+
+struct ProfileRegistry
+{
+    std::mutex lock;
+    std::vector<StageRecord> stages;
+    // the stages open now, innermost last
+    std::vector<int64_t> open;
+    bool per_stage_peak_rss = true;
+};
+
+ProfileRegistry &registry()
+{
+    static ProfileRegistry instance;
+    return instance;
+}
+
+void write_json_string(std::ostream &out, const std::string &value)
+{
+    out << "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\';
+        out << c;
+    }
+    out << "\"";
+}
+} // namespace
+
+void BuildProfiler::set_enabled(bool enable)
+{
+    // start the clock before the first stage
+    wall_seconds();
+    _enabled.store(enable, std::memory_order_relaxed);
+}
+
+void BuildProfiler::clear()
+{
+    ProfileRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.stages.clear();
+    reg.open.clear();
+    reg.per_stage_peak_rss = true;
+}
+
+BuildProfiler::Stage::Stage(const std::string &name) : _index(-1)
+{
+    if (!BuildProfiler::enabled())
+        return;
+    ProfileRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    // the peak so far belongs to the stages already open, and the new stage
+    // starts measuring its own
+    const uint64_t peak = peak_rss_bytes();
+    for (int64_t open : reg.open)
+        reg.stages[open].peak_rss = (std::max)(reg.stages[open].peak_rss, peak);
+    if (!reset_peak_rss())
+        reg.per_stage_peak_rss = false;
+
+    StageRecord record;
+    record.name = name;
+    record.parent = reg.open.empty() ? -1 : reg.open.back();
+    record.start = sample_usage();
+    _index = (int64_t)reg.stages.size();
+    reg.stages.push_back(record);
+    reg.open.push_back(_index);
+}
+
+BuildProfiler::Stage::~Stage()
+{
+    if (_index < 0)
+        return;
+    ProfileRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    // cleared while the stage was open
+    if (_index >= (int64_t)reg.stages.size())
+        return;
+    StageRecord &record = reg.stages[_index];
+    record.end = sample_usage();
+    record.peak_rss = (std::max)(record.peak_rss, peak_rss_bytes());
+    record.done = true;
+    // the peak of a stage bounds that of the stages around it from below
+    for (int64_t open : reg.open)
+        reg.stages[open].peak_rss = (std::max)(reg.stages[open].peak_rss, record.peak_rss);
+    reg.open.erase(std::remove(reg.open.begin(), reg.open.end(), _index), reg.open.end());
+}
+
+void BuildProfiler::write_json(std::ostream &out)
+{
+    ProfileRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    const uint32_t num_cpus = (std::max)(std::thread::hardware_concurrency(), 1u);
+    out << "{\"num_cpus\":" << num_cpus << ",\"per_stage_peak_rss\":" << (reg.per_stage_peak_rss ? "true" : "false")
+        << ",\"stages\":[";
+    bool first = true;
+    for (const StageRecord &record : reg.stages)
+    {
+        if (!record.done)
+            continue;
+        const double wall = record.end.wall_seconds - record.start.wall_seconds;
+        const double cpu = record.end.cpu_seconds - record.start.cpu_seconds;
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        first = false;
+        write_json_string(out, record.name);
+        out << ",\"parent\":";
+        if (record.parent < 0)
+            out << "null";
+        else
+            write_json_string(out, reg.stages[record.parent].name);
+        out << ",\"wall_seconds\":" << wall << ",\"cpu_seconds\":" << cpu
+            << ",\"cpu_utilization\":" << (wall > 0 ? cpu / (wall * num_cpus) : 0.0)
+            << ",\"peak_rss_bytes\":" << record.peak_rss
+            << ",\"bytes_read\":" << record.end.bytes_read - record.start.bytes_read
+            << ",\"bytes_written\":" << record.end.bytes_written - record.start.bytes_written
+            << ",\"storage_bytes_read\":" << record.end.storage_bytes_read - record.start.storage_bytes_read
+            << ",\"storage_bytes_written\":" << record.end.storage_bytes_written - record.start.storage_bytes_written
+            << "}";
+    }
+    out << "\n]}\n";
+}
+
+void BuildProfiler::write_json(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+        throw ANNException("Cannot open build report file " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    write_json(out);
+}
+} // namespace diskann
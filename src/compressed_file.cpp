@@ -0,0 +1,449 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+
+#include <omp.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ann_exception.h"
+#include "compressed_file.h"
+#include "logger.h"
+#include "parallel_io.h"
+
+namespace diskann
+{
+namespace
+{
+const uint64_t COMPRESSED_MAGIC = 0x31504d434e4e4144ULL; // "DANNCMP1"
+const uint32_t COMPRESSED_VERSION = 1;
+// the graph file header: file size, max degree, start and frozen point count
+const uint64_t GRAPH_HEADER_SIZE = 24;
+#ifdef USE_ZSTD
+const int ZSTD_LEVEL = 3;
+#endif
+
+struct CompressedFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t codec;
+    uint64_t size;
+    uint64_t num_blocks;
+    uint64_t table_offset;
+};
+
+struct TableEntry
+{
+    uint64_t original_offset;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+void put_varint(std::vector<char> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+bool get_varint(const uint8_t *&in, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 35 && in < end; shift += 7)
+    {
+        const uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void encode_graph_block(const char *raw, uint64_t len, uint64_t original_offset, std::vector<char> &out)
+{
+    uint64_t pos = 0;
+    if (original_offset == 0)
+    {
+        out.insert(out.end(), raw, raw + GRAPH_HEADER_SIZE);
+        pos = GRAPH_HEADER_SIZE;
+    }
+    std::vector<uint32_t> nbrs;
+    while (pos < len)
+    {
+        uint32_t k;
+        std::memcpy(&k, raw + pos, sizeof(uint32_t));
+        nbrs.resize(k);
+        std::memcpy(nbrs.data(), raw + pos + sizeof(uint32_t), k * sizeof(uint32_t));
+        std::sort(nbrs.begin(), nbrs.end());
+        put_varint(out, k);
+        uint32_t prev = 0;
+        for (const uint32_t id : nbrs)
+        {
+            put_varint(out, id - prev);
+            prev = id;
+        }
+        pos += sizeof(uint32_t) * ((uint64_t)k + 1);
+    }
+}
+
+bool decode_graph_block(const char *packed, uint64_t packed_len, uint64_t original_offset, char *out, uint64_t len)
+{
+    const uint8_t *in = (const uint8_t *)packed;
+    const uint8_t *end = in + packed_len;
+    uint64_t pos = 0;
+    if (original_offset == 0)
+    {
+        if (packed_len < GRAPH_HEADER_SIZE || len < GRAPH_HEADER_SIZE)
+            return false;
+        std::memcpy(out, in, GRAPH_HEADER_SIZE);
+        in += GRAPH_HEADER_SIZE;
+        pos = GRAPH_HEADER_SIZE;
+    }
+    while (pos < len)
+    {
+        uint32_t k;
+        if (!get_varint(in, end, k) || pos + sizeof(uint32_t) * ((uint64_t)k + 1) > len)
+            return false;
+        std::memcpy(out + pos, &k, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+        uint32_t id = 0, gap;
+        for (uint32_t i = 0; i < k; i++)
+        {
+            if (!get_varint(in, end, gap))
+                return false;
+            id += gap;
+            std::memcpy(out + pos, &id, sizeof(uint32_t));
+            pos += sizeof(uint32_t);
+        }
+    }
+    return in == end;
+}
+
+void throw_without_zstd()
+{
+    throw ANNException("zstd compressed files need a build with USE_ZSTD (cmake -DZSTD=ON)", -1, __FUNCSIG__,
+                       __FILE__, __LINE__);
+}
+
+void encode_block(BlockCodec codec, const char *raw, uint64_t len, uint64_t original_offset, std::vector<char> &out)
+{
+    out.clear();
+    if (codec == BlockCodec::GraphVarint)
+    {
+        encode_graph_block(raw, len, original_offset, out);
+        return;
+    }
+#ifdef USE_ZSTD
+    out.resize(ZSTD_compressBound(len));
+    const size_t bytes = ZSTD_compress(out.data(), out.size(), raw, len, ZSTD_LEVEL);
+    if (ZSTD_isError(bytes))
+        throw ANNException(std::string("zstd compression failed: ") + ZSTD_getErrorName(bytes), -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    out.resize(bytes);
+#else
+    throw_without_zstd();
+#endif
+}
+
+bool decode_block(BlockCodec codec, const char *packed, uint64_t packed_len, uint64_t original_offset, char *out,
+                  uint64_t len)
+{
+    if (codec == BlockCodec::GraphVarint)
+        return decode_graph_block(packed, packed_len, original_offset, out, len);
+#ifdef USE_ZSTD
+    return ZSTD_decompress(out, len, packed, packed_len) == len;
+#else
+    throw_without_zstd();
+    return false;
+#endif
+}
+
+// Splits data, which starts at original_offset of the file, into blocks of
+// about block_size bytes, each given by its start in data. Returns how much of
+// data the blocks take; without at_end, a block is cut only where it is full.
+uint64_t cut_blocks(BlockCodec codec, const char *data, uint64_t len, uint64_t original_offset, uint64_t block_size,
+                    bool at_end, std::vector<uint64_t> &starts, const std::string &in_file)
+{
+    starts.clear();
+    if (codec != BlockCodec::GraphVarint)
+    {
+        uint64_t pos = 0;
+        for (; pos + block_size <= len || (at_end && pos < len); pos += std::min(block_size, len - pos))
+            starts.push_back(pos);
+        return pos;
+    }
+
+    // blocks hold whole adjacency lists, and the first one the header too
+    uint64_t block_start = 0, pos = 0;
+    if (original_offset == 0)
+        pos = GRAPH_HEADER_SIZE;
+    while (pos + sizeof(uint32_t) <= len)
+    {
+        uint32_t k;
+        std::memcpy(&k, data + pos, sizeof(uint32_t));
+        const uint64_t record = sizeof(uint32_t) * ((uint64_t)k + 1);
+        if (pos + record > len)
+            break;
+        pos += record;
+        if (pos - block_start >= block_size)
+        {
+            starts.push_back(block_start);
+            block_start = pos;
+        }
+    }
+    if (at_end)
+    {
+        if (pos != len)
+            throw ANNException(in_file + " is not a graph file, or is truncated", -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (block_start < len)
+            starts.push_back(block_start);
+        return len;
+    }
+    return block_start;
+}
+} // namespace
+
+CompressedFile::CompressedFile(const std::string &path) : _path(path)
+{
+    std::ifstream in;
+    in.exceptions(std::ios::badbit | std::ios::failbit);
+    CompressedFileHeader header;
+    std::vector<TableEntry> table;
+    uint64_t file_size = 0;
+    try
+    {
+        in.open(path, std::ios::binary | std::ios::ate);
+        file_size = (uint64_t)in.tellg();
+        in.seekg(0, std::ios::beg);
+        in.read((char *)&header, sizeof(header));
+        if (header.magic != COMPRESSED_MAGIC || header.version != COMPRESSED_VERSION ||
+            (header.codec != (uint32_t)BlockCodec::GraphVarint && header.codec != (uint32_t)BlockCodec::Zstd) ||
+            header.table_offset > file_size ||
+            file_size - header.table_offset != header.num_blocks * sizeof(TableEntry))
+            throw ANNException(path + " is not a compressed file of a supported version", -1, __FUNCSIG__, __FILE__,
+                               __LINE__);
+        table.resize(header.num_blocks);
+        in.seekg(header.table_offset, std::ios::beg);
+        in.read((char *)table.data(), table.size() * sizeof(TableEntry));
+    }
+    catch (std::system_error &e)
+    {
+        throw FileException(path, e, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    _codec = (BlockCodec)header.codec;
+    _size = header.size;
+    for (uint64_t b = 0; b < table.size(); b++)
+    {
+        const TableEntry &entry = table[b];
+        const uint64_t next = b + 1 < table.size() ? table[b + 1].original_offset : _size;
+        if ((b == 0 && entry.original_offset != 0) || entry.original_offset >= next || entry.offset < sizeof(header) ||
+            entry.offset + entry.bytes > header.table_offset)
+            throw ANNException("Corrupt block table in " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+        _blocks.push_back(Block{entry.original_offset, entry.offset, entry.bytes});
+    }
+    if (_blocks.empty() && _size != 0)
+        throw ANNException("Corrupt block table in " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    _blocks.push_back(Block{_size, header.table_offset, 0});
+}
+
+bool CompressedFile::is_compressed(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    uint64_t magic = 0;
+    return in.read((char *)&magic, sizeof(magic)) && magic == COMPRESSED_MAGIC;
+}
+
+void CompressedFile::read(char *buf, uint64_t offset, uint64_t len, uint32_t num_threads) const
+{
+    if (len == 0)
+        return;
+    if (offset + len > _size)
+        throw ANNException("Reading beyond the end of " + _path, -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    auto after = [](uint64_t pos, const Block &block) { return pos < block.original_offset; };
+    const int64_t first = std::upper_bound(_blocks.begin(), _blocks.end(), offset, after) - _blocks.begin() - 1;
+    const int64_t last = std::upper_bound(_blocks.begin(), _blocks.end(), offset + len - 1, after) - _blocks.begin();
+    if (num_threads == 0)
+        num_threads = (uint32_t)omp_get_max_threads();
+
+    std::exception_ptr error = nullptr;
+#pragma omp parallel num_threads((int)std::min<int64_t>(num_threads, last - first))
+    {
+        std::ifstream in;
+        in.exceptions(std::ios::badbit | std::ios::failbit);
+        std::vector<char> packed, scratch;
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t b = first; b < last; b++)
+        {
+            try
+            {
+                const Block &block = _blocks[b];
+                const uint64_t block_end = _blocks[b + 1].original_offset;
+                const uint64_t block_len = block_end - block.original_offset;
+                if (!in.is_open())
+                    in.open(_path, std::ios::binary);
+                packed.resize(block.bytes);
+                in.seekg(block.offset, std::ios::beg);
+                in.read(packed.data(), block.bytes);
+
+                // blocks the read covers whole are decoded in place
+                const uint64_t start = std::max(offset, block.original_offset);
+                const uint64_t stop = std::min(offset + len, block_end);
+                const bool whole = start == block.original_offset && stop == block_end;
+                if (!whole)
+                    scratch.resize(block_len);
+                char *out = whole ? buf + (start - offset) : scratch.data();
+                if (!decode_block(_codec, packed.data(), block.bytes, block.original_offset, out, block_len))
+                    throw ANNException("Corrupt block at offset " + std::to_string(block.offset) + " of " + _path, -1,
+                                       __FUNCSIG__, __FILE__, __LINE__);
+                if (!whole)
+                    std::memcpy(buf + (start - offset), scratch.data() + (start - block.original_offset), stop - start);
+            }
+            catch (...)
+            {
+#pragma omp critical
+                if (error == nullptr)
+                    error = std::current_exception();
+            }
+        }
+    }
+    if (error != nullptr)
+        std::rethrow_exception(error);
+}
+
+void CompressedFile::compress(const std::string &in_file, const std::string &out_file, BlockCodec codec,
+                              uint64_t block_size)
+{
+    if (codec != BlockCodec::GraphVarint && codec != BlockCodec::Zstd)
+        throw ANNException("Unknown block codec " + std::to_string((uint32_t)codec), -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+#ifndef USE_ZSTD
+    if (codec == BlockCodec::Zstd)
+        throw_without_zstd();
+#endif
+    block_size = std::max(block_size, (uint64_t)1);
+
+    uint64_t size;
+    {
+        std::ifstream in(in_file, std::ios::binary | std::ios::ate);
+        if (!in.is_open())
+            throw ANNException("Cannot open " + in_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+        size = (uint64_t)in.tellg();
+    }
+    if (codec == BlockCodec::GraphVarint)
+    {
+        uint64_t graph_size = 0;
+        if (size >= GRAPH_HEADER_SIZE)
+            parallel_file_io(in_file, (char *)&graph_size, 0, sizeof(graph_size), false, 1);
+        if (graph_size != size)
+            throw ANNException(in_file + " is not a graph file", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    std::ofstream out;
+    out.exceptions(std::ios::badbit | std::ios::failbit);
+    CompressedFileHeader header{COMPRESSED_MAGIC, COMPRESSED_VERSION, (uint32_t)codec, size, 0, 0};
+    std::vector<TableEntry> table;
+    try
+    {
+        out.open(out_file, std::ios::binary | std::ios::trunc);
+        out.write((char *)&header, sizeof(header));
+
+        // the input is read a window of blocks at a time, and the blocks of a
+        // window are compressed by all threads
+        uint64_t window_size = block_size * 4 * (uint64_t)omp_get_max_threads();
+        std::vector<char> window;
+        std::vector<uint64_t> starts;
+        std::vector<std::vector<char>> packed;
+        uint64_t window_offset = 0, carry = 0;
+        while (window_offset + carry < size)
+        {
+            const uint64_t bytes = std::min(window_size, size - window_offset - carry);
+            window.resize(carry + bytes);
+            parallel_file_io(in_file, window.data() + carry, window_offset + carry, bytes, false);
+            const bool at_end = window_offset + carry + bytes == size;
+            const uint64_t used = cut_blocks(codec, window.data(), window.size(), window_offset, block_size, at_end,
+                                             starts, in_file);
+            if (starts.empty())
+            {
+                // a list longer than the window
+                carry = window.size();
+                window_size *= 2;
+                continue;
+            }
+
+            packed.resize(starts.size());
+            std::exception_ptr error = nullptr;
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int64_t b = 0; b < (int64_t)starts.size(); b++)
+            {
+                try
+                {
+                    const uint64_t end = b + 1 < (int64_t)starts.size() ? starts[b + 1] : used;
+                    encode_block(codec, window.data() + starts[b], end - starts[b], window_offset + starts[b],
+                                 packed[b]);
+                }
+                catch (...)
+                {
+#pragma omp critical
+                    if (error == nullptr)
+                        error = std::current_exception();
+                }
+            }
+            if (error != nullptr)
+                std::rethrow_exception(error);
+
+            for (size_t b = 0; b < starts.size(); b++)
+            {
+                table.push_back(TableEntry{window_offset + starts[b], (uint64_t)out.tellp(), packed[b].size()});
+                out.write(packed[b].data(), packed[b].size());
+            }
+
+            carry = window.size() - used;
+            std::memmove(window.data(), window.data() + used, carry);
+            window_offset += used;
+        }
+
+        header.num_blocks = table.size();
+        header.table_offset = (uint64_t)out.tellp();
+        out.write((char *)table.data(), table.size() * sizeof(TableEntry));
+        out.seekp(0, std::ios::beg);
+        out.write((char *)&header, sizeof(header));
+        out.close();
+    }
+    catch (std::system_error &e)
+    {
+        throw FileException(out_file, e, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    diskann::cout << "Compressed " << in_file << " (" << size << "B) into " << out_file << " ("
+                  << header.table_offset + table.size() * sizeof(TableEntry) << "B, " << table.size() << " blocks)"
+                  << std::endl;
+}
+
+void CompressedFile::decompress(const std::string &in_file, const std::string &out_file)
+{
+    const CompressedFile file(in_file);
+    {
+        std::ofstream out(out_file, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            throw ANNException("Cannot create " + out_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    std::vector<char> window(std::min(file.size(), defaults::GRAPH_LOAD_WINDOW_SIZE));
+    for (uint64_t offset = 0; offset < file.size(); offset += window.size())
+    {
+        const uint64_t bytes = std::min((uint64_t)window.size(), file.size() - offset);
+        file.read(window.data(), offset, bytes);
+        write_file_parallel(out_file, window.data(), offset, bytes);
+    }
+    diskann::cout << "Decompressed " << in_file << " into " << out_file << " (" << file.size() << "B)" << std::endl;
+}
+} // namespace diskann
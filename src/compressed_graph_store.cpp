@@ -0,0 +1,286 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "compressed_graph_store.h"
+#include "utils.h"
+
+namespace diskann
+{
+namespace
+{
+// gaps per block; a block at a width of w bits takes w bytes
+const uint32_t GAP_BLOCK = 8;
+// bytes the decoder may read past the last gap of a list
+const size_t LIST_PADDING = sizeof(uint64_t);
+
+// Writes the list of the k ids at ids to out and returns its length. With out
+// null, only returns the length.
+size_t encode_list(const uint32_t *ids, const uint32_t k, uint8_t *out)
+{
+    if (k == 0)
+        return 0;
+    if (k > UINT16_MAX)
+        throw ANNException("ERROR: the compressed graph store holds lists of at most " +
+                               std::to_string(UINT16_MAX) + " neighbours, not " + std::to_string(k),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    thread_local std::vector<uint32_t> sorted;
+    sorted.assign(ids, ids + k);
+    std::sort(sorted.begin(), sorted.end());
+
+    const uint16_t degree = (uint16_t)k;
+    if (out != nullptr)
+    {
+        std::memcpy(out, &degree, sizeof(degree));
+        std::memcpy(out + sizeof(degree), sorted.data(), sizeof(uint32_t));
+    }
+    size_t len = sizeof(degree) + sizeof(uint32_t);
+    for (uint32_t b = 1; b < k; b += GAP_BLOCK)
+    {
+        const uint32_t num_gaps = (std::min)(GAP_BLOCK, k - b);
+        uint32_t gaps[GAP_BLOCK] = {0};
+        uint32_t all_bits = 0;
+        for (uint32_t j = 0; j < num_gaps; j++)
+        {
+            gaps[j] = sorted[b + j] - sorted[b + j - 1];
+            all_bits |= gaps[j];
+        }
+        uint32_t width = 0;
+        while (width < 32 && (all_bits >> width) != 0)
+            width++;
+
+        if (out != nullptr)
+        {
+            // packed here first, as the bytes past the block belong to the
+            // next list, which another thread may be writing
+            uint8_t block[GAP_BLOCK * sizeof(uint32_t) + sizeof(uint64_t)] = {0};
+            for (uint32_t j = 0; j < GAP_BLOCK; j++)
+            {
+                const uint32_t bit = j * width;
+                uint64_t word;
+                std::memcpy(&word, block + bit / 8, sizeof(word));
+                word |= (uint64_t)gaps[j] << (bit % 8);
+                std::memcpy(block + bit / 8, &word, sizeof(word));
+            }
+            out[len] = (uint8_t)width;
+            std::memcpy(out + len + 1, block, width);
+        }
+        len += 1 + width;
+    }
+    return len;
+}
+
+// Decodes the list at in to out, which must have room for the degree rounded
+// up to whole blocks plus one, and returns the degree
+uint32_t decode_list(const uint8_t *in, uint32_t *out)
+{
+    uint16_t degree;
+    std::memcpy(&degree, in, sizeof(degree));
+    in += sizeof(degree);
+    std::memcpy(out, in, sizeof(uint32_t));
+    in += sizeof(uint32_t);
+    for (uint32_t b = 1; b < degree; b += GAP_BLOCK)
+    {
+        const uint32_t width = *in++;
+        const uint64_t mask = ((uint64_t)1 << width) - 1;
+        uint32_t *lanes = out + b;
+        for (uint32_t j = 0; j < GAP_BLOCK; j++)
+        {
+            const uint32_t bit = j * width;
+            uint64_t word;
+            std::memcpy(&word, in + bit / 8, sizeof(word));
+            lanes[j] = (uint32_t)((word >> (bit % 8)) & mask);
+        }
+        for (uint32_t j = 0; j < GAP_BLOCK; j++)
+            lanes[j] += lanes[(int32_t)j - 1];
+        in += width;
+    }
+    return degree;
+}
+} // namespace
+
+CompressedGraphStore::CompressedGraphStore(const size_t total_pts, const size_t reserve_graph_degree)
+    : AbstractGraphStore(total_pts, reserve_graph_degree), _lists(LIST_PADDING, 0), _offsets(total_pts + 1, 0)
+{
+}
+
+std::tuple<uint32_t, uint32_t, size_t> CompressedGraphStore::load(const std::string &index_path_prefix,
+                                                                  const size_t num_points)
+{
+    const GraphFileHeader header = read_graph_header(index_path_prefix);
+    const size_t expected_file_size = header.expected_file_size;
+    _max_observed_degree = header.max_observed_degree;
+    const uint32_t start = header.start;
+    const size_t file_frozen_pts = header.num_frozen_points;
+    size_t vamana_metadata_size = sizeof(size_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(size_t);
+
+    diskann::cout << "From graph header, expected_file_size: " << expected_file_size
+                  << ", _max_observed_degree: " << _max_observed_degree << ", _start: " << start
+                  << ", file_frozen_pts: " << file_frozen_pts << std::endl;
+
+    diskann::cout << "Loading vamana graph " << index_path_prefix << " into compressed graph store..." << std::flush;
+
+    // the file is read twice: once to size every compressed list, and once
+    // to write them into an array of exactly that size
+    const size_t num_nodes = std::max(_offsets.size() - 1, num_points);
+    std::vector<uint64_t> offsets(num_nodes + 1, 0);
+    size_t cc = 0;
+    uint32_t max_degree = 0;
+    std::atomic<bool> overflow(false);
+    const uint32_t nodes_read = load_graph_adjacency_parallel(
+        index_path_prefix, vamana_metadata_size, expected_file_size,
+        [&offsets, &overflow, num_nodes](const uint32_t node, const uint32_t k, const uint32_t *nbrs) {
+            if (node >= num_nodes)
+            {
+                overflow = true;
+                return;
+            }
+            offsets[node + 1] = encode_list(nbrs, k, nullptr);
+        },
+        cc, max_degree);
+    if (overflow)
+    {
+        throw ANNException("ERROR: graph file " + index_path_prefix + " holds more than the " +
+                               std::to_string(num_nodes) + " nodes of the compressed graph store",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    for (size_t i = 0; i < num_nodes; i++)
+        offsets[i + 1] += offsets[i];
+
+    std::vector<uint8_t> lists(offsets[num_nodes] + LIST_PADDING, 0);
+    load_graph_adjacency_parallel(
+        index_path_prefix, vamana_metadata_size, expected_file_size,
+        [&offsets, &lists](const uint32_t node, const uint32_t k, const uint32_t *nbrs) {
+            encode_list(nbrs, k, lists.data() + offsets[node]);
+        },
+        cc, max_degree);
+
+    _lists.swap(lists);
+    _offsets.swap(offsets);
+    set_total_points(num_nodes);
+    _max_range_of_graph = std::max(_max_range_of_graph, (size_t)max_degree);
+
+    diskann::cout << "done. Index has " << nodes_read << " nodes and " << cc << " out-edges in "
+                  << _lists.size() / (1024 * 1024) << " MB, _start is set to " << start << std::endl;
+    return std::make_tuple(nodes_read, start, file_frozen_pts);
+}
+
+int CompressedGraphStore::store(const std::string &index_path_prefix, const size_t num_points,
+                                const size_t num_frozen_points, const uint32_t start, const size_t frozen_location)
+{
+    std::ofstream out;
+    open_file_to_write(out, index_path_prefix);
+
+    size_t file_offset = 0;
+    out.seekp(file_offset, out.beg);
+    size_t index_size = 24;
+    uint32_t max_degree = 0;
+    out.write((char *)&index_size, sizeof(uint64_t));
+    out.write((char *)&_max_observed_degree, sizeof(uint32_t));
+    uint32_t ep_u32 = start;
+    out.write((char *)&ep_u32, sizeof(uint32_t));
+    out.write((char *)&num_frozen_points, sizeof(size_t));
+
+    // Note: num_points = _nd + _num_frozen_points
+    const size_t active_points = num_points - num_frozen_points;
+    const size_t frozen_start = frozen_location == 0 ? active_points : frozen_location;
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        NeighbourList nbrs = get_neighbours((location_t)(i < active_points ? i : frozen_start + (i - active_points)));
+        uint32_t GK = (uint32_t)nbrs.size();
+        std::vector<uint32_t> record(nbrs.begin(), nbrs.end());
+        for (auto &id : record)
+        {
+            if (frozen_start != active_points && id >= frozen_start)
+                id = (uint32_t)(id - frozen_start + active_points);
+        }
+        out.write((char *)&GK, sizeof(uint32_t));
+        out.write((char *)record.data(), GK * sizeof(uint32_t));
+        max_degree = GK > max_degree ? GK : max_degree;
+        index_size += (size_t)(sizeof(uint32_t) * (GK + 1));
+    }
+    out.seekp(file_offset, out.beg);
+    out.write((char *)&index_size, sizeof(uint64_t));
+    out.write((char *)&max_degree, sizeof(uint32_t));
+    out.close();
+    return (int)index_size;
+}
+
+NeighbourList CompressedGraphStore::get_neighbours(const location_t i) const
+{
+    thread_local std::vector<location_t> decoded;
+    const uint64_t offset = _offsets[i];
+    if (offset == _offsets[i + 1])
+        return NeighbourList(nullptr, 0);
+
+    uint16_t degree;
+    std::memcpy(&degree, _lists.data() + offset, sizeof(degree));
+    const size_t capacity = ROUND_UP((size_t)degree, GAP_BLOCK) + 1;
+    if (decoded.size() < capacity)
+        decoded.resize(capacity);
+    decode_list(_lists.data() + offset, decoded.data());
+    return NeighbourList(decoded.data(), degree);
+}
+
+void CompressedGraphStore::prefetch_neighbours(const location_t i) const
+{
+    if ((size_t)i + 1 < _offsets.size())
+        prefetch_vector((const char *)_lists.data() + _offsets[i], _offsets[i + 1] - _offsets[i]);
+}
+
+void CompressedGraphStore::throw_read_only() const
+{
+    throw ANNException("ERROR: the compressed graph store is read-only", -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+void CompressedGraphStore::add_neighbour(const location_t i, location_t neighbour_id)
+{
+    throw_read_only();
+}
+
+void CompressedGraphStore::clear_neighbours(const location_t i)
+{
+    throw_read_only();
+}
+
+void CompressedGraphStore::swap_neighbours(const location_t a, location_t b)
+{
+    throw_read_only();
+}
+
+void CompressedGraphStore::set_neighbours(const location_t i, std::vector<location_t> &neighbours)
+{
+    throw_read_only();
+}
+
+size_t CompressedGraphStore::resize_graph(const size_t new_size)
+{
+    const uint64_t end = _offsets.back();
+    _offsets.resize(new_size + 1, end);
+    _lists.resize(_offsets.back() + LIST_PADDING, 0);
+    set_total_points(new_size);
+    return new_size;
+}
+
+void CompressedGraphStore::clear_graph()
+{
+    std::vector<uint8_t>(LIST_PADDING, 0).swap(_lists);
+    std::vector<uint64_t>(1, 0).swap(_offsets);
+}
+
+size_t CompressedGraphStore::get_max_range_of_graph()
+{
+    return _max_range_of_graph;
+}
+
+uint32_t CompressedGraphStore::get_max_observed_degree()
+{
+    return _max_observed_degree;
+}
+
+size_t CompressedGraphStore::memory_size() const
+{
+    return _lists.capacity() + _offsets.capacity() * sizeof(uint64_t);
+}
+
+} // namespace diskann
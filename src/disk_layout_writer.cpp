@@ -0,0 +1,436 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "common_includes.h"
+
+#include "disk_layout_writer.h"
+#include "defaults.h"
+#include "logger.h"
+#include "utils.h"
+
+#ifndef _WINDOWS
+#include <unistd.h>
+#endif
+#ifdef USE_AVX2
+#include <immintrin.h>
+#endif
+
+namespace diskann
+{
+// about this much of the disk index is assembled and written at a time
+const uint64_t WRITE_BLOCK_BYTES = 64 * 1024 * 1024;
+
+// Output file of the disk layout, written in whole sectors from sector
+// aligned buffers. On Linux it bypasses the page cache with O_DIRECT, which
+// the layout does not benefit from and which would otherwise evict the base
+// file being read; file systems without direct I/O get buffered writes, as do
+// layouts in sectors smaller than the block size of some file systems.
+class SectorFile
+{
+  public:
+    SectorFile(const std::string &filename, bool direct) : _filename(filename)
+    {
+#ifndef _WINDOWS
+        _fd = direct ? ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644) : -1;
+        if (_fd == -1 && (!direct || errno == EINVAL))
+            _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (_fd == -1)
+            throw ANNException("Failed to open " + filename + " for writing: " + std::strerror(errno), -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+#else
+        _writer.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        try
+        {
+            _writer.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+        }
+        catch (std::system_error &e)
+        {
+            throw FileException(filename, e, __FUNCSIG__, __FILE__, __LINE__);
+        }
+#endif
+    }
+
+    ~SectorFile()
+    {
+#ifndef _WINDOWS
+        if (_fd != -1)
+            ::close(_fd);
+#endif
+    }
+
+    void write(const char *buf, uint64_t len, uint64_t offset)
+    {
+#ifndef _WINDOWS
+        while (len > 0)
+        {
+            const ssize_t ret = ::pwrite(_fd, buf, len, (off_t)offset);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                throw ANNException("Failed to write to " + _filename + ": " + std::strerror(errno), -1, __FUNCSIG__,
+                                   __FILE__, __LINE__);
+            buf += ret;
+            len -= ret;
+            offset += ret;
+        }
+#else
+        _writer.seekp(offset, std::ios::beg);
+        _writer.write(buf, len);
+#endif
+    }
+
+  private:
+    std::string _filename;
+#ifndef _WINDOWS
+    int _fd = -1;
+#else
+    std::ofstream _writer;
+#endif
+};
+
+void pack_ids(const uint32_t *ids, uint64_t n, uint32_t bits, uint32_t *packed)
+{
+    for (uint64_t i = 0; i < n; i++)
+    {
+        const uint64_t pos = i * bits;
+        const uint64_t field = (uint64_t)ids[i] << (pos % 32);
+        packed[pos / 32] |= (uint32_t)field;
+        packed[pos / 32 + 1] |= (uint32_t)(field >> 32);
+    }
+}
+
+void unpack_ids(const uint32_t *packed, uint64_t n, uint32_t bits, uint32_t *ids)
+{
+    const uint64_t mask = ((uint64_t)1 << bits) - 1;
+    uint64_t i = 0;
+#ifdef USE_AVX2
+    // each id is the word holding its first bit shifted down, or'ed with the
+    // next word shifted up; a shift by 32 gives 0
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i bits_v = _mm256_set1_epi32((int32_t)bits);
+    const __m256i mask_v = _mm256_set1_epi32((int32_t)(uint32_t)mask);
+    const __m256i word_bits = _mm256_set1_epi32(32);
+    const __m256i one = _mm256_set1_epi32(1);
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i pos = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32((int32_t)i), lanes), bits_v);
+        const __m256i word = _mm256_srli_epi32(pos, 5);
+        const __m256i shift = _mm256_and_si256(pos, _mm256_set1_epi32(31));
+        const __m256i lo = _mm256_i32gather_epi32((const int *)packed, word, 4);
+        const __m256i hi = _mm256_i32gather_epi32((const int *)packed, _mm256_add_epi32(word, one), 4);
+        const __m256i id = _mm256_or_si256(_mm256_srlv_epi32(lo, shift),
+                                           _mm256_sllv_epi32(hi, _mm256_sub_epi32(word_bits, shift)));
+        _mm256_storeu_si256((__m256i *)(ids + i), _mm256_and_si256(id, mask_v));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const uint64_t pos = i * bits;
+        const uint64_t window = packed[pos / 32] | ((uint64_t)packed[pos / 32 + 1] << 32);
+        ids[i] = (uint32_t)((window >> (pos % 32)) & mask);
+    }
+}
+
+DiskLayoutWriter::DiskLayoutWriter(const std::string &base_file, size_t coord_size, const std::string &output_file,
+                                   uint32_t width, const std::string &reorder_data_file, bool separate_reorder_data,
+                                   const std::string &nbr_codes_file, uint64_t sector_len, bool pack_nbr_ids)
+    : _base_file(base_file), _output_file(output_file), _coord_size(coord_size), _width(width),
+      _sector_len(sector_len), _nbr_codes_file(nbr_codes_file)
+{
+    if (!is_valid_sector_len(sector_len))
+        throw ANNException("Sector length " + std::to_string(sector_len) +
+                               " is not one of 512, 1024, 2048 and 4096",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    size_t npts, ndims;
+    diskann::get_bin_metadata(base_file, npts, ndims);
+    _npts = npts;
+    _ndims = ndims;
+
+    if (reorder_data_file != std::string(""))
+    {
+        size_t reorder_data_file_size = get_file_size(reorder_data_file);
+        _reorder_data_reader.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        uint32_t npts_reorder_file = 0, ndims_reorder_file = 0;
+        try
+        {
+            _reorder_data_reader.open(reorder_data_file, std::ios::binary);
+            _reorder_data_reader.read((char *)&npts_reorder_file, sizeof(uint32_t));
+            _reorder_data_reader.read((char *)&ndims_reorder_file, sizeof(uint32_t));
+        }
+        catch (std::system_error &e)
+        {
+            throw FileException(reorder_data_file, e, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        if (npts_reorder_file != npts)
+            throw ANNException("Mismatch in num_points between reorder data file and base file", -1, __FUNCSIG__,
+                               __FILE__, __LINE__);
+        if (reorder_data_file_size != 8 + sizeof(float) * (size_t)npts_reorder_file * (size_t)ndims_reorder_file)
+            throw ANNException("Discrepancy in reorder data file size ", -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (ndims_reorder_file * sizeof(float) > _sector_len)
+            throw ANNException("Reorder data vectors of " + std::to_string(ndims_reorder_file * sizeof(float)) +
+                                   " bytes do not fit in a sector of " + std::to_string(_sector_len),
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        _ndims_reorder = ndims_reorder_file;
+        _separate_reorder_data = separate_reorder_data;
+    }
+
+    if (!nbr_codes_file.empty())
+    {
+        size_t npts_codes, code_len;
+        diskann::get_bin_metadata(nbr_codes_file, npts_codes, code_len);
+        if (npts_codes != npts)
+            throw ANNException("Mismatch in num_points between PQ codes file and base file", -1, __FUNCSIG__,
+                               __FILE__, __LINE__);
+        _nbr_code_len = code_len;
+    }
+
+    _nbr_id_bits = pack_nbr_ids ? get_packed_id_bits(_npts) : 0;
+    _nbr_ids_len = pack_nbr_ids ? get_packed_ids_len(_width, _nbr_id_bits) : (uint64_t)_width * sizeof(uint32_t);
+    _max_node_len = sizeof(uint32_t) + _nbr_ids_len + (_ndims * _coord_size) + (uint64_t)_width * _nbr_code_len;
+    _nnodes_per_sector = _sector_len / _max_node_len; // 0 if max_node_len > sector_len
+    _nsectors_per_node = DIV_ROUND_UP(_max_node_len, _sector_len);
+
+    if (_nnodes_per_sector > 0)
+    {
+        _block_sectors = (std::max)((uint64_t)1, WRITE_BLOCK_BYTES / _sector_len);
+        _block_nodes = _block_sectors * _nnodes_per_sector;
+    }
+    else
+    {
+        _block_nodes = (std::max)((uint64_t)1, WRITE_BLOCK_BYTES / (_nsectors_per_node * _sector_len));
+        _block_sectors = _block_nodes * _nsectors_per_node;
+    }
+    // the reorder data goes through the same buffers
+    if (_ndims_reorder > 0)
+        _block_sectors =
+            (std::max)(_block_sectors, DIV_ROUND_UP(_ndims_reorder * sizeof(float), _sector_len));
+}
+
+void DiskLayoutWriter::open()
+{
+    diskann::cout << "max_node_len: " << _max_node_len << "B" << std::endl;
+    diskann::cout << "nnodes_per_sector: " << _nnodes_per_sector << "B" << std::endl;
+
+    _base_reader.open(_base_file, WRITE_BLOCK_BYTES);
+    uint32_t npts, ndims;
+    _base_reader.read((char *)&npts, sizeof(uint32_t));
+    _base_reader.read((char *)&ndims, sizeof(uint32_t));
+
+    _staged_nnbrs.resize(_block_nodes);
+    _staged_nbrs.resize(_block_nodes * _width);
+    _coords.resize(_block_nodes * _ndims * _coord_size);
+    for (auto &buf : _sector_bufs)
+        alloc_aligned((void **)&buf, _block_sectors * _sector_len, defaults::SECTOR_LEN);
+
+    if (_nbr_code_len > 0)
+    {
+        // neighbors are anywhere in the graph, so all codes are kept in memory
+        size_t npts_codes, code_len;
+        diskann::load_bin<uint8_t>(_nbr_codes_file, _nbr_codes, npts_codes, code_len);
+    }
+
+    _file = std::make_unique<SectorFile>(_output_file, _sector_len == defaults::SECTOR_LEN);
+    // the metadata, in the first defaults::SECTOR_LEN bytes, is written by
+    // finish()
+    _write_offset = defaults::SECTOR_LEN;
+}
+
+DiskLayoutWriter::~DiskLayoutWriter()
+{
+    if (_pending_write.valid())
+    {
+        try
+        {
+            _pending_write.get();
+        }
+        catch (...)
+        {
+        }
+    }
+    for (auto &buf : _sector_bufs)
+        aligned_free(buf);
+}
+
+void DiskLayoutWriter::add_nodes(const uint32_t *nnbrs, const uint32_t *nbrs, size_t stride, uint64_t num_nodes)
+{
+    if (_file == nullptr)
+        open();
+    if (_nodes_added + _staged + num_nodes > _npts)
+        throw ANNException("More graph nodes than points in the base file", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    for (uint64_t i = 0; i < num_nodes; i++)
+    {
+        const uint32_t k = (std::min)(nnbrs[i], _width);
+        _staged_nnbrs[_staged] = k;
+        std::memcpy(_staged_nbrs.data() + _staged * _width, nbrs + i * stride, k * sizeof(uint32_t));
+        if (++_staged == _block_nodes)
+            flush_block();
+    }
+}
+
+void DiskLayoutWriter::flush_block()
+{
+    if (_staged == 0)
+        return;
+
+    _base_reader.read(_coords.data(), _staged * _ndims * _coord_size);
+    const uint64_t num_sectors =
+        _nnodes_per_sector > 0 ? DIV_ROUND_UP(_staged, _nnodes_per_sector) : _staged * _nsectors_per_node;
+    const uint64_t node_sectors = _nnodes_per_sector > 0 ? 1 : _nsectors_per_node;
+    const uint64_t nodes_per_sector = _nnodes_per_sector > 0 ? _nnodes_per_sector : 1;
+    const uint64_t coords_len = _ndims * _coord_size;
+
+    wait_for_write();
+    char *buf = _sector_bufs[_cur_buf];
+#pragma omp parallel for schedule(static, 64)
+    for (int64_t sector = 0; sector < (int64_t)(num_sectors / node_sectors); sector++)
+    {
+        char *sector_buf = buf + sector * node_sectors * _sector_len;
+        std::memset(sector_buf, 0, node_sectors * _sector_len);
+        for (uint64_t n = sector * nodes_per_sector; n < (std::min)(_staged, (sector + 1) * nodes_per_sector); n++)
+        {
+            char *node_buf = sector_buf + (n - sector * nodes_per_sector) * _max_node_len;
+            std::memcpy(node_buf, _coords.data() + n * coords_len, coords_len);
+            *(uint32_t *)(node_buf + coords_len) = _staged_nnbrs[n];
+            uint32_t *nbr_ids = (uint32_t *)(node_buf + coords_len + sizeof(uint32_t));
+            if (_nbr_id_bits > 0)
+                pack_ids(_staged_nbrs.data() + n * _width, _staged_nnbrs[n], _nbr_id_bits, nbr_ids);
+            else
+                std::memcpy(nbr_ids, _staged_nbrs.data() + n * _width, _staged_nnbrs[n] * sizeof(uint32_t));
+            uint8_t *nbr_codes = (uint8_t *)nbr_ids + _nbr_ids_len;
+            for (uint32_t j = 0; j < _staged_nnbrs[n] && _nbr_code_len > 0; j++)
+            {
+                std::memcpy(nbr_codes + j * _nbr_code_len,
+                            _nbr_codes.get() + (uint64_t)_staged_nbrs[n * _width + j] * _nbr_code_len,
+                            _nbr_code_len);
+            }
+        }
+    }
+    write_async(buf, num_sectors * _sector_len);
+
+    _nodes_added += _staged;
+    _staged = 0;
+    diskann::cout << "Sector #" << _write_offset / _sector_len << " written" << std::endl;
+}
+
+void DiskLayoutWriter::write_async(const char *buf, uint64_t len)
+{
+    const uint64_t offset = _write_offset;
+    _write_offset += len;
+    _pending_write = std::async(std::launch::async, [this, buf, len, offset] { _file->write(buf, len, offset); });
+    _cur_buf = 1 - _cur_buf;
+}
+
+void DiskLayoutWriter::wait_for_write()
+{
+    if (_pending_write.valid())
+        _pending_write.get();
+}
+
+void DiskLayoutWriter::finish(uint64_t medoid, uint64_t num_frozen_pts, uint64_t frozen_loc)
+{
+    if (_file == nullptr)
+        open();
+    flush_block();
+    if (_nodes_added != _npts)
+    {
+        std::stringstream stream;
+        stream << "Disk layout received " << _nodes_added << " graph nodes for " << _npts << " points" << std::endl;
+        throw ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    const uint64_t header_sectors = defaults::SECTOR_LEN / _sector_len;
+    const uint64_t n_sectors = (_write_offset / _sector_len) - header_sectors;
+
+    uint64_t n_reorder_sectors = 0;
+    uint64_t n_data_nodes_per_sector = 0;
+    std::unique_ptr<SectorFile> graph_file;
+    if (_separate_reorder_data)
+    {
+        // the reorder data starts at the first sector of a file of its own
+        diskann::cout << "Index written. Writing reorder data to " << get_disk_index_vectors_file(_output_file)
+                      << "..." << std::endl;
+        wait_for_write();
+        graph_file = std::move(_file);
+        _file = std::make_unique<SectorFile>(get_disk_index_vectors_file(_output_file),
+                                             _sector_len == defaults::SECTOR_LEN);
+        _write_offset = 0;
+    }
+    else if (_ndims_reorder > 0)
+    {
+        diskann::cout << "Index written. Appending reorder data..." << std::endl;
+    }
+    if (_ndims_reorder > 0)
+    {
+        const uint64_t vec_len = _ndims_reorder * sizeof(float);
+        n_data_nodes_per_sector = _sector_len / vec_len;
+        n_reorder_sectors = DIV_ROUND_UP(_npts, n_data_nodes_per_sector);
+
+        std::vector<char> vecs(_block_sectors * n_data_nodes_per_sector * vec_len);
+        for (uint64_t sector = 0; sector < n_reorder_sectors; sector += _block_sectors)
+        {
+            const uint64_t num_sectors = (std::min)(_block_sectors, n_reorder_sectors - sector);
+            const uint64_t first = sector * n_data_nodes_per_sector;
+            const uint64_t num_vecs = (std::min)(num_sectors * n_data_nodes_per_sector, _npts - first);
+            _reorder_data_reader.read(vecs.data(), num_vecs * vec_len);
+
+            wait_for_write();
+            char *buf = _sector_bufs[_cur_buf];
+#pragma omp parallel for schedule(static, 64)
+            for (int64_t s = 0; s < (int64_t)num_sectors; s++)
+            {
+                const uint64_t begin = s * n_data_nodes_per_sector;
+                const uint64_t count = (std::min)(n_data_nodes_per_sector, num_vecs - begin);
+                std::memset(buf + s * _sector_len, 0, _sector_len);
+                std::memcpy(buf + s * _sector_len, vecs.data() + begin * vec_len, count * vec_len);
+            }
+            write_async(buf, num_sectors * _sector_len);
+        }
+    }
+    wait_for_write();
+    if (_separate_reorder_data)
+        _file = std::move(graph_file);
+
+    std::vector<uint64_t> output_file_meta;
+    output_file_meta.push_back(_npts);
+    output_file_meta.push_back(_ndims);
+    output_file_meta.push_back(medoid);
+    output_file_meta.push_back(_max_node_len);
+    output_file_meta.push_back(_nnodes_per_sector);
+    output_file_meta.push_back(num_frozen_pts);
+    output_file_meta.push_back(frozen_loc);
+    output_file_meta.push_back((uint64_t)(_ndims_reorder > 0));
+    if (_ndims_reorder > 0)
+    {
+        // start sector 0, the metadata sector, stands for the vectors file
+        output_file_meta.push_back(_separate_reorder_data ? 0 : header_sectors + n_sectors);
+        output_file_meta.push_back(_ndims_reorder);
+        output_file_meta.push_back(n_data_nodes_per_sector);
+    }
+    const uint64_t file_sectors = header_sectors + n_sectors + (_separate_reorder_data ? 0 : n_reorder_sectors);
+    output_file_meta.push_back(file_sectors * _sector_len);
+    // then the optional rows up to the last one that is not its default
+    const std::vector<uint64_t> optional_meta = {_nbr_code_len, _sector_len, _nbr_id_bits};
+    const std::vector<uint64_t> optional_defaults = {0, defaults::SECTOR_LEN, 0};
+    size_t num_optional = optional_meta.size();
+    while (num_optional > 0 && optional_meta[num_optional - 1] == optional_defaults[num_optional - 1])
+        num_optional--;
+    output_file_meta.insert(output_file_meta.end(), optional_meta.begin(), optional_meta.begin() + num_optional);
+
+    // the first defaults::SECTOR_LEN bytes hold the metadata as a bin file of
+    // one column, as written by save_bin
+    char *buf = _sector_bufs[_cur_buf];
+    std::memset(buf, 0, defaults::SECTOR_LEN);
+    const int32_t meta_rows = (int32_t)output_file_meta.size(), meta_cols = 1;
+    std::memcpy(buf, &meta_rows, sizeof(int32_t));
+    std::memcpy(buf + sizeof(int32_t), &meta_cols, sizeof(int32_t));
+    std::memcpy(buf + 2 * sizeof(int32_t), output_file_meta.data(), output_file_meta.size() * sizeof(uint64_t));
+    _file->write(buf, defaults::SECTOR_LEN, 0);
+    _file.reset();
+    _finished = true;
+
+    diskann::cout << "medoid: " << medoid << std::endl;
+    diskann::cout << "# sectors: " << n_sectors << std::endl;
+    diskann::cout << "Output disk index file written to " << _output_file << std::endl;
+}
+} // namespace diskann
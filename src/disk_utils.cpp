@@ -2,6 +2,8 @@
 // Licensed under the MIT license.
 
 #include "common_includes.h"
+#include <future>
+#include <numeric>
 
 #if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
 #include "gperftools/malloc_extension.h"
@@ -9,9 +11,14 @@
 
 #include "logger.h"
 #include "disk_utils.h"
+#include "disk_layout_writer.h"
+#include "gpu_graph_build.h"
+#include "build_manifest.h"
+#include "build_profiler.h"
 #include "cached_io.h"
 #include "index.h"
-#include "mkl.h"
+#include "math_utils.h"
+#include "blas_compat.h"
 #include "omp.h"
 #include "percentile_stats.h"
 #include "partition.h"
@@ -241,7 +248,7 @@ void read_idmap(const std::string &fname, std::vector<uint32_t> &ivecs)
 int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suffix, const std::string &idmaps_prefix,
                  const std::string &idmaps_suffix, const uint64_t nshards, uint32_t max_degree,
                  const std::string &output_vamana, const std::string &medoids_file, bool use_filters,
-                 const std::string &labels_to_medoids_file)
+                 const std::string &labels_to_medoids_file, DiskLayoutWriter *disk_layout)
 {
     // Read ID maps
     std::vector<std::string> vamana_names(nshards);
@@ -266,21 +273,37 @@ int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suf
     nnodes++;
     diskann::cout << "# nodes: " << nnodes << ", max. degree: " << max_degree << std::endl;
 
-    // compute inverse map: node -> shards
-    std::vector<std::pair<uint32_t, uint32_t>> node_shard;
-    node_shard.reserve(nelems);
-    for (size_t shard = 0; shard < nshards; shard++)
+    // compute inverse map: node -> (shard, index in shard), grouped by node
+    // with node_offsets so that nodes can be merged independently
+    std::vector<uint64_t> node_offsets(nnodes + 1, 0);
+    for (auto &idmap : idmaps)
+    {
+        for (auto &id : idmap)
+            node_offsets[id + 1]++;
+    }
+    for (size_t node = 0; node < nnodes; node++)
+        node_offsets[node + 1] += node_offsets[node];
+
+    std::vector<std::pair<uint32_t, uint32_t>> node_shard(nelems);
     {
-        diskann::cout << "Creating inverse map -- shard #" << shard << std::endl;
-        for (size_t idx = 0; idx < idmaps[shard].size(); idx++)
+        std::vector<uint64_t> next_entry(node_offsets.begin(), node_offsets.end() - 1);
+        for (size_t shard = 0; shard < nshards; shard++)
         {
-            size_t node_id = idmaps[shard][idx];
-            node_shard.push_back(std::make_pair((uint32_t)node_id, (uint32_t)shard));
+            diskann::cout << "Creating inverse map -- shard #" << shard << std::endl;
+            for (size_t idx = 0; idx < idmaps[shard].size(); idx++)
+            {
+                // shards are read front to back one block of ids at a time
+                if (idx > 0 && idmaps[shard][idx] <= idmaps[shard][idx - 1])
+                {
+                    std::stringstream stream;
+                    stream << "Error: ids of shard " << shard << " are not in increasing order at position " << idx
+                           << std::endl;
+                    throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+                }
+                node_shard[next_entry[idmaps[shard][idx]]++] = std::make_pair((uint32_t)shard, (uint32_t)idx);
+            }
         }
     }
-    std::sort(node_shard.begin(), node_shard.end(), [](const auto &left, const auto &right) {
-        return left.first < right.first || (left.first == right.first && left.second < right.second);
-    });
     diskann::cout << "Finished computing node -> shards map" << std::endl;
 
     // will merge all the labels to medoids files of each shard into one
@@ -351,14 +374,9 @@ int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suf
         sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t); // expected file size + max degree +
                                                                                    // medoid_id + frozen_point info
 
-    // create cached vamana writers
-    cached_ofstream merged_vamana_writer(output_vamana, BUFFER_SIZE_FOR_CACHED_IO);
-
     size_t merged_index_size = vamana_metadata_size; // we initialize the size of the merged index to
                                                      // the metadata size
     size_t merged_index_frozen = 0;
-    merged_vamana_writer.write((char *)&merged_index_size,
-                               sizeof(uint64_t)); // we will overwrite the index size at the end
 
     uint32_t output_width = max_degree;
     uint32_t max_input_width = 0;
@@ -372,7 +390,6 @@ int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suf
 
     diskann::cout << "Max input width: " << max_input_width << ", output width: " << output_width << std::endl;
 
-    merged_vamana_writer.write((char *)&output_width, sizeof(uint32_t));
     std::ofstream medoid_writer(medoids_file.c_str(), std::ios::binary);
     uint32_t nshards_u32 = (uint32_t)nshards;
     uint32_t one_val = 1;
@@ -382,6 +399,7 @@ int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suf
     uint64_t vamana_index_frozen = 0; // as of now the functionality to merge many overlapping vamana
                                       // indices is supported only for bulk indices without frozen point.
                                       // Hence the final index will also not have any frozen points.
+    uint32_t merged_medoid = 0;
     for (uint64_t shard = 0; shard < nshards; shard++)
     {
         uint32_t medoid;
@@ -395,85 +413,151 @@ int merge_shards(const std::string &vamana_prefix, const std::string &vamana_suf
         medoid_writer.write((char *)&medoid, sizeof(uint32_t));
         // write renamed medoid
         if (shard == (nshards - 1)) //--> uncomment if running hierarchical
-            merged_vamana_writer.write((char *)&medoid, sizeof(uint32_t));
+            merged_medoid = medoid;
     }
-    merged_vamana_writer.write((char *)&merged_index_frozen, sizeof(uint64_t));
     medoid_writer.close();
 
+    // create cached vamana writer, unless the merged graph goes straight into
+    // a disk layout
+    std::unique_ptr<cached_ofstream> merged_vamana_writer;
+    if (disk_layout == nullptr)
+    {
+        merged_vamana_writer = std::make_unique<cached_ofstream>(output_vamana, BUFFER_SIZE_FOR_CACHED_IO);
+        merged_vamana_writer->write((char *)&merged_index_size,
+                                    sizeof(uint64_t)); // we will overwrite the index size at the end
+        merged_vamana_writer->write((char *)&output_width, sizeof(uint32_t));
+        merged_vamana_writer->write((char *)&merged_medoid, sizeof(uint32_t));
+        merged_vamana_writer->write((char *)&merged_index_frozen, sizeof(uint64_t));
+    }
+
     diskann::cout << "Starting merge" << std::endl;
 
-    // Gopal. random_shuffle() is deprecated.
-    std::random_device rng;
-    std::mt19937 urng(rng());
+    // The merged graph is produced in blocks of consecutive node ids. While
+    // the threads merge one block, the neighbor lists of the next one are read
+    // from the shards; the reads are sequential since every shard stores its
+    // nodes in increasing id order. Blocks are sized to hold about
+    // MERGE_BLOCK_BYTES of shard neighbor lists.
+    const uint64_t MERGE_BLOCK_BYTES = 256 * 1024 * 1024;
+    const uint64_t bytes_per_node =
+        (uint64_t)((double)nelems / (double)nnodes * (max_input_width + 1) * sizeof(uint32_t)) + 1;
+    const uint64_t block_size = (std::max)((uint64_t)1024, MERGE_BLOCK_BYTES / bytes_per_node);
+    const uint64_t num_blocks = DIV_ROUND_UP(nnodes, block_size);
+
+    // neighbor lists of one shard for the nodes of a block, in local ids
+    struct ShardBlock
+    {
+        uint64_t first_local = 0;
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> nbrs;
+    };
+    std::vector<ShardBlock> shard_blocks[2] = {std::vector<ShardBlock>(nshards), std::vector<ShardBlock>(nshards)};
+    std::vector<uint64_t> next_local(nshards, 0);
+
+    auto read_block = [&](uint64_t block, std::vector<ShardBlock> &blocks) {
+        const uint64_t end = (std::min)(nnodes, (block + 1) * block_size);
+        for (uint64_t shard = 0; shard < nshards; shard++)
+        {
+            ShardBlock &cur = blocks[shard];
+            uint64_t &local = next_local[shard];
+            cur.first_local = local;
+            cur.offsets.assign(1, 0);
+            cur.nbrs.clear();
+            for (; local < idmaps[shard].size() && idmaps[shard][local] < end; local++)
+            {
+                uint32_t shard_nnbrs;
+                vamana_readers[shard].read((char *)&shard_nnbrs, sizeof(uint32_t));
+                if (shard_nnbrs == 0)
+                {
+                    diskann::cout << "WARNING: shard #" << shard << ", node_id " << idmaps[shard][local]
+                                  << " has 0 nbrs" << std::endl;
+                }
+                const size_t pos = cur.nbrs.size();
+                cur.nbrs.resize(pos + shard_nnbrs);
+                if (shard_nnbrs > 0)
+                    vamana_readers[shard].read((char *)(cur.nbrs.data() + pos), shard_nnbrs * sizeof(uint32_t));
+                cur.offsets.push_back(cur.nbrs.size());
+            }
+        }
+    };
 
-    std::vector<bool> nhood_set(nnodes, 0);
-    std::vector<uint32_t> final_nhood;
+    // seeds the choice of neighbors kept when the union of a node's shard
+    // neighborhoods exceeds max_degree
+    const uint64_t seed = std::random_device()();
+    std::vector<uint32_t> block_nnbrs(block_size);
+    std::vector<uint32_t> block_nbrs(block_size * max_degree);
 
-    uint32_t nnbrs = 0, shard_nnbrs = 0;
-    uint32_t cur_id = 0;
-    for (const auto &id_shard : node_shard)
+    std::future<void> reader = std::async(std::launch::async, read_block, 0, std::ref(shard_blocks[0]));
+    for (uint64_t block = 0; block < num_blocks; block++)
     {
-        uint32_t node_id = id_shard.first;
-        uint32_t shard_id = id_shard.second;
-        if (cur_id < node_id)
+        reader.get();
+        if (block + 1 < num_blocks)
+            reader = std::async(std::launch::async, read_block, block + 1, std::ref(shard_blocks[(block + 1) % 2]));
+        const std::vector<ShardBlock> &blocks = shard_blocks[block % 2];
+        const uint64_t start = block * block_size;
+        const uint64_t end = (std::min)(nnodes, start + block_size);
+
+#pragma omp parallel
         {
-            // Gopal. random_shuffle() is deprecated.
-            std::shuffle(final_nhood.begin(), final_nhood.end(), urng);
-            nnbrs = (uint32_t)(std::min)(final_nhood.size(), (uint64_t)max_degree);
-            // write into merged ofstream
-            merged_vamana_writer.write((char *)&nnbrs, sizeof(uint32_t));
-            merged_vamana_writer.write((char *)final_nhood.data(), nnbrs * sizeof(uint32_t));
-            merged_index_size += (sizeof(uint32_t) + nnbrs * sizeof(uint32_t));
-            if (cur_id % 499999 == 1)
+            std::vector<uint32_t> final_nhood;
+            std::mt19937 urng;
+#pragma omp for schedule(dynamic, 256)
+            for (int64_t node = (int64_t)start; node < (int64_t)end; node++)
             {
-                diskann::cout << "." << std::flush;
+                final_nhood.clear();
+                for (uint64_t e = node_offsets[node]; e < node_offsets[node + 1]; e++)
+                {
+                    const uint32_t shard = node_shard[e].first;
+                    const ShardBlock &cur = blocks[shard];
+                    const uint64_t i = node_shard[e].second - cur.first_local;
+                    for (uint64_t j = cur.offsets[i]; j < cur.offsets[i + 1]; j++)
+                        final_nhood.push_back(idmaps[shard][cur.nbrs[j]]);
+                }
+                std::sort(final_nhood.begin(), final_nhood.end());
+                final_nhood.erase(std::unique(final_nhood.begin(), final_nhood.end()), final_nhood.end());
+                if (final_nhood.size() > max_degree)
+                {
+                    urng.seed((uint32_t)(seed + node));
+                    std::shuffle(final_nhood.begin(), final_nhood.end(), urng);
+                }
+                const uint32_t nnbrs = (uint32_t)(std::min)(final_nhood.size(), (size_t)max_degree);
+                block_nnbrs[node - start] = nnbrs;
+                std::copy(final_nhood.begin(), final_nhood.begin() + nnbrs,
+                          block_nbrs.begin() + (node - start) * max_degree);
             }
-            cur_id = node_id;
-            nnbrs = 0;
-            for (auto &p : final_nhood)
-                nhood_set[p] = 0;
-            final_nhood.clear();
         }
-        // read from shard_id ifstream
-        vamana_readers[shard_id].read((char *)&shard_nnbrs, sizeof(uint32_t));
 
-        if (shard_nnbrs == 0)
+        if (disk_layout != nullptr)
         {
-            diskann::cout << "WARNING: shard #" << shard_id << ", node_id " << node_id << " has 0 nbrs" << std::endl;
+            disk_layout->add_nodes(block_nnbrs.data(), block_nbrs.data(), max_degree, end - start);
         }
-
-        std::vector<uint32_t> shard_nhood(shard_nnbrs);
-        if (shard_nnbrs > 0)
-            vamana_readers[shard_id].read((char *)shard_nhood.data(), shard_nnbrs * sizeof(uint32_t));
-        // rename nodes
-        for (uint64_t j = 0; j < shard_nnbrs; j++)
+        else
         {
-            if (nhood_set[idmaps[shard_id][shard_nhood[j]]] == 0)
+            // write into merged ofstream
+            for (uint64_t node = start; node < end; node++)
             {
-                nhood_set[idmaps[shard_id][shard_nhood[j]]] = 1;
-                final_nhood.emplace_back(idmaps[shard_id][shard_nhood[j]]);
+                const uint32_t nnbrs = block_nnbrs[node - start];
+                merged_vamana_writer->write((char *)&nnbrs, sizeof(uint32_t));
+                if (nnbrs > 0)
+                    merged_vamana_writer->write((char *)(block_nbrs.data() + (node - start) * max_degree),
+                                                nnbrs * sizeof(uint32_t));
+                merged_index_size += (sizeof(uint32_t) + nnbrs * sizeof(uint32_t));
             }
         }
+        diskann::cout << "." << std::flush;
     }
+    diskann::cout << std::endl;
 
-    // Gopal. random_shuffle() is deprecated.
-    std::shuffle(final_nhood.begin(), final_nhood.end(), urng);
-    nnbrs = (uint32_t)(std::min)(final_nhood.size(), (uint64_t)max_degree);
-    // write into merged ofstream
-    merged_vamana_writer.write((char *)&nnbrs, sizeof(uint32_t));
-    if (nnbrs > 0)
+    if (disk_layout != nullptr)
     {
-        merged_vamana_writer.write((char *)final_nhood.data(), nnbrs * sizeof(uint32_t));
+        disk_layout->finish(merged_medoid);
     }
-    merged_index_size += (sizeof(uint32_t) + nnbrs * sizeof(uint32_t));
-    for (auto &p : final_nhood)
-        nhood_set[p] = 0;
-    final_nhood.clear();
-
-    diskann::cout << "Expected size: " << merged_index_size << std::endl;
+    else
+    {
+        diskann::cout << "Expected size: " << merged_index_size << std::endl;
 
-    merged_vamana_writer.reset();
-    merged_vamana_writer.write((char *)&merged_index_size, sizeof(uint64_t));
+        merged_vamana_writer->reset();
+        merged_vamana_writer->write((char *)&merged_index_size, sizeof(uint64_t));
+    }
 
     diskann::cout << "Finished merge" << std::endl;
     return 0;
@@ -624,13 +708,147 @@ void extract_shard_labels(const std::string &in_label_file, const std::string &s
         delete[] ids;
 }
 
+void save_shard_job(const std::string &job_file, const ShardBuildJob &job)
+{
+    // one "<field> <value>" line per field
+    std::ofstream out(job_file, std::ios::trunc);
+    out << "shard_prefix " << job.shard_prefix << "\n"
+        << "base_file " << job.base_file << "\n"
+        << "label_file " << job.label_file << "\n"
+        << "universal_label " << job.universal_label << "\n"
+        << "metric " << (int)job.metric << "\n"
+        << "L " << job.L << "\n"
+        << "R " << job.R << "\n"
+        << "Lf " << job.Lf << "\n"
+        << "num_threads " << job.num_threads << "\n"
+        << "build_pq_bytes " << job.build_pq_bytes << "\n"
+        << "use_opq " << job.use_opq << "\n"
+        << "use_filters " << job.use_filters << "\n"
+        << "use_gpu " << job.use_gpu << "\n"
+        << "build_key " << job.build_key << "\n";
+    out.flush();
+    if (!out)
+        throw ANNException("Failed to write shard job " + job_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+ShardBuildJob load_shard_job(const std::string &job_file)
+{
+    std::ifstream in(job_file);
+    if (!in)
+        throw ANNException("Failed to open shard job " + job_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    std::map<std::string, std::string> fields;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const size_t space = line.find(' ');
+        if (space != std::string::npos)
+            fields[line.substr(0, space)] = line.substr(space + 1);
+    }
+    for (const char *name : {"shard_prefix", "base_file", "metric", "L", "R", "build_key"})
+    {
+        if (fields.find(name) == fields.end())
+            throw ANNException(std::string("Shard job ") + job_file + " has no " + name, -1, __FUNCSIG__, __FILE__,
+                               __LINE__);
+    }
+
+    ShardBuildJob job;
+    job.shard_prefix = fields["shard_prefix"];
+    job.base_file = fields["base_file"];
+    job.label_file = fields["label_file"];
+    job.universal_label = fields["universal_label"];
+    job.metric = (diskann::Metric)std::stoi(fields["metric"]);
+    job.L = (uint32_t)std::stoul(fields["L"]);
+    job.R = (uint32_t)std::stoul(fields["R"]);
+    job.Lf = (uint32_t)std::stoul("0" + fields["Lf"]);
+    job.num_threads = (uint32_t)std::stoul("0" + fields["num_threads"]);
+    job.build_pq_bytes = (size_t)std::stoull("0" + fields["build_pq_bytes"]);
+    job.use_opq = fields["use_opq"] == "1";
+    job.use_filters = fields["use_filters"] == "1";
+    job.use_gpu = fields["use_gpu"] == "1";
+    job.build_key = fields["build_key"];
+    return job;
+}
+
+template <typename T> void build_shard(const ShardBuildJob &job)
+{
+    std::string shard_base_file = job.shard_prefix + ".bin";
+    std::string shard_ids_file = job.shard_prefix + "_ids_uint32.bin";
+    std::string shard_labels_file = job.shard_prefix + "_labels.txt";
+    std::string shard_index_file = job.shard_prefix + "_mem.index";
+
+    // the shard records its completion in a manifest of its own, so that
+    // shards built on different machines do not write to the same file
+    BuildManifest shard_manifest(shard_index_file + "_manifest.txt", job.build_key, true);
+    if (shard_manifest.is_done("shard"))
+    {
+        diskann::cout << "Shard " << job.shard_prefix << " is already built" << std::endl;
+        return;
+    }
+
+    // the partitioning writes the data of the shards along with their ids; it
+    // is read from the base file again if it was not written, say on another
+    // machine
+    uint64_t shard_ids_pts, shard_ids_dim, base_pts, base_dim;
+    get_bin_metadata(shard_ids_file, shard_ids_pts, shard_ids_dim);
+    get_bin_metadata(job.base_file, base_pts, base_dim);
+    if (!file_exists(shard_base_file) ||
+        get_file_size(shard_base_file) != 2 * sizeof(uint32_t) + shard_ids_pts * base_dim * sizeof(T))
+        retrieve_shard_data_from_ids<T>(job.base_file, shard_ids_file, shard_base_file);
+
+    // a graph of nearest neighbors on the GPU, where it can, and otherwise
+    // Vamana
+    const bool built_on_gpu = job.use_gpu && !job.use_filters && job.build_pq_bytes == 0 &&
+                              build_graph_on_gpu<T>(shard_base_file, job.metric, job.R, 2 * job.R, defaults::ALPHA,
+                                                    job.num_threads, shard_index_file);
+    if (!built_on_gpu)
+    {
+        diskann::IndexWriteParameters low_degree_params = diskann::IndexWriteParametersBuilder(job.L, job.R)
+                                                              .with_filter_list_size(job.Lf)
+                                                              .with_saturate_graph(false)
+                                                              .with_num_threads(job.num_threads)
+                                                              .build();
+
+        uint64_t shard_base_dim, shard_base_pts;
+        get_bin_metadata(shard_base_file, shard_base_pts, shard_base_dim);
+
+        diskann::Index<T> _index(job.metric, shard_base_dim, shard_base_pts,
+                                 std::make_shared<diskann::IndexWriteParameters>(low_degree_params), nullptr,
+                                 defaults::NUM_FROZEN_POINTS_STATIC, false, false, false, job.build_pq_bytes > 0,
+                                 job.build_pq_bytes, job.use_opq);
+        if (!job.use_filters)
+        {
+            _index.build(shard_base_file.c_str(), shard_base_pts);
+        }
+        else
+        {
+            diskann::extract_shard_labels(job.label_file, shard_ids_file, shard_labels_file);
+            if (job.universal_label != "")
+            { //  indicates no universal label
+                uint32_t unv_label_as_num = 0;
+                _index.set_universal_label(unv_label_as_num);
+            }
+            _index.build_filtered_index(shard_base_file.c_str(), shard_labels_file, shard_base_pts);
+        }
+        _index.save(shard_index_file.c_str());
+    }
+
+    std::remove(shard_base_file.c_str());
+    std::vector<std::string> shard_files = {shard_index_file};
+    if (job.use_filters)
+        shard_files.push_back(shard_index_file + "_labels_to_medoids.txt");
+    shard_manifest.mark_done("shard", shard_files);
+}
+
 template <typename T, typename LabelT>
 int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R,
                               double sampling_rate, double ram_budget, std::string mem_index_path,
                               std::string medoids_file, std::string centroids_file, size_t build_pq_bytes, bool use_opq,
                               uint32_t num_threads, bool use_filters, const std::string &label_file,
                               const std::string &labels_to_medoids_file, const std::string &universal_label,
-                              const uint32_t Lf)
+                              const uint32_t Lf, const bool minibatch_kmeans, DiskLayoutWriter *disk_layout,
+                              BuildManifest *manifest, const std::string &only_shards, const float partition_balance,
+                              const bool gpu_build)
 {
     size_t base_num, base_dim;
     diskann::get_bin_metadata(base_file, base_num, base_dim);
@@ -640,9 +858,25 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
     // TODO: Make this honest when there is filter support
     if (full_index_ram < ram_budget * 1024 * 1024 * 1024)
     {
+        if (!only_shards.empty())
+        {
+            diskann::cout << "Full index fits in RAM budget, so there are no shards to build. The final build "
+                             "(without a shard list) builds it in one shot."
+                          << std::endl;
+            return 0;
+        }
+        BuildProfiler::Stage stage("in_memory_build");
         diskann::cout << "Full index fits in RAM budget, should consume at most "
                       << full_index_ram / (1024 * 1024 * 1024) << "GiBs, so building in one shot" << std::endl;
 
+        if (gpu_build && !use_filters && build_pq_bytes == 0 &&
+            build_graph_on_gpu<T>(base_file, compareMetric, R, 2 * R, defaults::ALPHA, num_threads, mem_index_path))
+        {
+            std::remove(medoids_file.c_str());
+            std::remove(centroids_file.c_str());
+            return 0;
+        }
+
         diskann::IndexWriteParameters paras = diskann::IndexWriteParametersBuilder(L, R)
                                                   .with_filter_list_size(Lf)
                                                   .with_saturate_graph(!use_filters)
@@ -653,7 +887,13 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
                                                std::make_shared<diskann::IndexWriteParameters>(paras), nullptr,
                                                defaults::NUM_FROZEN_POINTS_STATIC, false, false, false,
                                                build_pq_bytes > 0, build_pq_bytes, use_opq, use_filters);
-        if (!use_filters)
+        const MemoryBinFile *memory_file = MemoryBinFile::find(base_file);
+        if (!use_filters && memory_file != nullptr && build_pq_bytes == 0)
+            // the graph is built on the caller's vectors where they are, which
+            // outlive _index
+            _index.build((const T *)memory_file->data(), base_num, std::vector<TagT>(),
+                         std::shared_ptr<const void>(memory_file->data(), [](const void *) {}));
+        else if (!use_filters)
             _index.build(base_file.c_str(), base_num);
         else
         {
@@ -686,13 +926,69 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
 
     std::string merged_index_prefix = mem_index_path + "_tempFiles";
 
+    const std::string shard_key = manifest != nullptr ? manifest->build_key() : std::string("");
+    auto shard_job = [&](int p) {
+        ShardBuildJob job;
+        job.shard_prefix = merged_index_prefix + "_subshard-" + std::to_string(p);
+        job.base_file = base_file;
+        job.label_file = label_file;
+        job.universal_label = universal_label;
+        job.metric = compareMetric;
+        job.L = L;
+        job.R = 2 * R / 3;
+        job.Lf = Lf;
+        job.num_threads = num_threads;
+        job.build_pq_bytes = build_pq_bytes;
+        job.use_opq = use_opq;
+        job.use_filters = use_filters;
+        job.use_gpu = gpu_build;
+        job.build_key = shard_key;
+        return job;
+    };
+
     Timer timer;
-    int num_parts =
-        partition_with_ram_budget<T>(base_file, sampling_rate, ram_budget, 2 * R / 3, merged_index_prefix, 2);
-    diskann::cout << timer.elapsed_seconds_for_step("partitioning data ") << std::endl;
+    int num_parts;
+    // the partition is random, so it must be shared by every run that builds
+    // some of the shards
+    if (manifest != nullptr && manifest->is_done("partition"))
+    {
+        // the centroids, then the ids of every shard
+        num_parts = (int)manifest->artifacts("partition").size() - 1;
+        diskann::cout << "Reusing the partition into " << num_parts << " shards" << std::endl;
+    }
+    else
+    {
+        BuildProfiler::Stage stage("partitioning");
+        num_parts = partition_with_ram_budget<T>(base_file, sampling_rate, ram_budget, 2 * R / 3, merged_index_prefix,
+                                                 2, minibatch_kmeans, partition_balance);
+        diskann::cout << timer.elapsed_seconds_for_step("partitioning data ") << std::endl;
+
+        std::string cur_centroid_filepath = merged_index_prefix + "_centroids.bin";
+        std::rename(cur_centroid_filepath.c_str(), centroids_file.c_str());
+
+        // shards built from an earlier partition are stale
+        std::vector<std::string> partition_files = {centroids_file};
+        for (int p = 0; p < num_parts; p++)
+        {
+            ShardBuildJob job = shard_job(p);
+            std::remove((job.shard_prefix + "_mem.index_manifest.txt").c_str());
+            save_shard_job(job.shard_prefix + "_job.txt", job);
+            partition_files.push_back(job.shard_prefix + "_ids_uint32.bin");
+        }
+        if (manifest != nullptr)
+            manifest->mark_done("partition", partition_files);
+    }
 
-    std::string cur_centroid_filepath = merged_index_prefix + "_centroids.bin";
-    std::rename(cur_centroid_filepath.c_str(), centroids_file.c_str());
+    // shards this run builds: all of them, or those listed in only_shards
+    std::vector<bool> selected(num_parts, only_shards.empty());
+    for (uint32_t p : parse_shard_list(only_shards.empty() ? "none" : only_shards))
+    {
+        if (p >= (uint32_t)num_parts)
+            throw ANNException("Shard " + std::to_string(p) + " does not exist, the data has " +
+                                   std::to_string(num_parts) + " shards",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        selected[p] = true;
+    }
 
     timer.reset();
     for (int p = 0; p < num_parts; p++)
@@ -700,64 +996,37 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
 #if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
         MallocExtension::instance()->ReleaseFreeMemory();
 #endif
+        if (selected[p])
+        {
+            BuildProfiler::Stage stage("shard_" + std::to_string(p));
+            build_shard<T>(shard_job(p));
+        }
+    }
+    diskann::cout << timer.elapsed_seconds_for_step("building indices on shards") << std::endl;
 
-        std::string shard_base_file = merged_index_prefix + "_subshard-" + std::to_string(p) + ".bin";
-
-        std::string shard_ids_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_ids_uint32.bin";
-
-        std::string shard_labels_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_labels.txt";
-
-        retrieve_shard_data_from_ids<T>(base_file, shard_ids_file, shard_base_file);
+    if (!only_shards.empty())
+        return 0;
 
+    // shards may have been built by other processes
+    for (int p = 0; p < num_parts; p++)
+    {
         std::string shard_index_file = merged_index_prefix + "_subshard-" + std::to_string(p) + "_mem.index";
+        if (!BuildManifest(shard_index_file + "_manifest.txt", shard_key, true).is_done("shard"))
+            throw ANNException("Shard " + std::to_string(p) + " was not built", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
 
-        diskann::IndexWriteParameters low_degree_params = diskann::IndexWriteParametersBuilder(L, 2 * R / 3)
-                                                              .with_filter_list_size(Lf)
-                                                              .with_saturate_graph(false)
-                                                              .with_num_threads(num_threads)
-                                                              .build();
-
-        uint64_t shard_base_dim, shard_base_pts;
-        get_bin_metadata(shard_base_file, shard_base_pts, shard_base_dim);
-
-        diskann::Index<T> _index(compareMetric, shard_base_dim, shard_base_pts,
-                                 std::make_shared<diskann::IndexWriteParameters>(low_degree_params), nullptr,
-                                 defaults::NUM_FROZEN_POINTS_STATIC, false, false, false, build_pq_bytes > 0,
-                                 build_pq_bytes, use_opq);
-        if (!use_filters)
-        {
-            _index.build(shard_base_file.c_str(), shard_base_pts);
-        }
-        else
-        {
-            diskann::extract_shard_labels(label_file, shard_ids_file, shard_labels_file);
-            if (universal_label != "")
-            { //  indicates no universal label
-                LabelT unv_label_as_num = 0;
-                _index.set_universal_label(unv_label_as_num);
-            }
-            _index.build_filtered_index(shard_base_file.c_str(), shard_labels_file, shard_base_pts);
-        }
-        _index.save(shard_index_file.c_str());
-        // copy universal label file from first shard to the final destination
-        // index, since all shards anyway share the universal label
-        if (p == 0)
-        {
-            std::string shard_universal_label_file = shard_index_file + "_universal_label.txt";
-            if (universal_label != "")
-            {
-                copy_file(shard_universal_label_file, final_index_universal_label_file);
-            }
-        }
-
-        std::remove(shard_base_file.c_str());
+    // copy universal label file from first shard to the final destination
+    // index, since all shards anyway share the universal label
+    if (universal_label != "")
+    {
+        copy_file(merged_index_prefix + "_subshard-0_mem.index_universal_label.txt", final_index_universal_label_file);
     }
-    diskann::cout << timer.elapsed_seconds_for_step("building indices on shards") << std::endl;
 
     timer.reset();
+    BuildProfiler::Stage merge_stage("merge");
     diskann::merge_shards(merged_index_prefix + "_subshard-", "_mem.index", merged_index_prefix + "_subshard-",
                           "_ids_uint32.bin", num_parts, R, mem_index_path, medoids_file, use_filters,
-                          labels_to_medoids_file);
+                          labels_to_medoids_file, disk_layout);
     diskann::cout << timer.elapsed_seconds_for_step("merging indices") << std::endl;
 
     // delete tempFiles
@@ -773,6 +1042,8 @@ int build_merged_vamana_index(std::string base_file, diskann::Metric compareMetr
         std::remove(shard_id_file.c_str());
         std::remove(shard_index_file.c_str());
         std::remove(shard_index_file_data.c_str());
+        std::remove((shard_index_file + "_manifest.txt").c_str());
+        std::remove((merged_index_prefix + "_subshard-" + std::to_string(p) + "_job.txt").c_str());
         if (use_filters)
         {
             std::string shard_index_label_file = shard_index_file + "_labels.txt";
@@ -845,55 +1116,16 @@ uint32_t optimize_beamwidth(std::unique_ptr<diskann::PQFlashIndex<T, LabelT>> &p
 
 template <typename T>
 void create_disk_layout(const std::string base_file, const std::string mem_index_file, const std::string output_file,
-                        const std::string reorder_data_file)
+                        const std::string reorder_data_file, const bool separate_reorder_data,
+                        const std::string nbr_codes_file, const uint64_t sector_len, const bool pack_nbr_ids)
 {
-    uint32_t npts, ndims;
-
-    // amount to read or write in one shot
+    // amount to read in one shot
     size_t read_blk_size = 64 * 1024 * 1024;
-    size_t write_blk_size = read_blk_size;
-    cached_ifstream base_reader(base_file, read_blk_size);
-    base_reader.read((char *)&npts, sizeof(uint32_t));
-    base_reader.read((char *)&ndims, sizeof(uint32_t));
-
-    size_t npts_64, ndims_64;
-    npts_64 = npts;
-    ndims_64 = ndims;
-
-    // Check if we need to append data for re-ordering
-    bool append_reorder_data = false;
-    std::ifstream reorder_data_reader;
-
-    uint32_t npts_reorder_file = 0, ndims_reorder_file = 0;
-    if (reorder_data_file != std::string(""))
-    {
-        append_reorder_data = true;
-        size_t reorder_data_file_size = get_file_size(reorder_data_file);
-        reorder_data_reader.exceptions(std::ofstream::failbit | std::ofstream::badbit);
 
-        try
-        {
-            reorder_data_reader.open(reorder_data_file, std::ios::binary);
-            reorder_data_reader.read((char *)&npts_reorder_file, sizeof(uint32_t));
-            reorder_data_reader.read((char *)&ndims_reorder_file, sizeof(uint32_t));
-            if (npts_reorder_file != npts)
-                throw ANNException("Mismatch in num_points between reorder "
-                                   "data file and base file",
-                                   -1, __FUNCSIG__, __FILE__, __LINE__);
-            if (reorder_data_file_size != 8 + sizeof(float) * (size_t)npts_reorder_file * (size_t)ndims_reorder_file)
-                throw ANNException("Discrepancy in reorder data file size ", -1, __FUNCSIG__, __FILE__, __LINE__);
-        }
-        catch (std::system_error &e)
-        {
-            throw FileException(reorder_data_file, e, __FUNCSIG__, __FILE__, __LINE__);
-        }
-    }
-
-    // create cached reader + writer
+    // create cached reader
     size_t actual_file_size = get_file_size(mem_index_file);
     diskann::cout << "Vamana index file size=" << actual_file_size << std::endl;
-    std::ifstream vamana_reader(mem_index_file, std::ios::binary);
-    cached_ofstream diskann_writer(output_file, write_blk_size);
+    cached_ifstream vamana_reader(mem_index_file, read_blk_size);
 
     // metadata: width, medoid
     uint32_t width_u32, medoid_u32;
@@ -914,223 +1146,1330 @@ void create_disk_layout(const std::string base_file, const std::string mem_index
     vamana_reader.read((char *)&width_u32, sizeof(uint32_t));
     vamana_reader.read((char *)&medoid_u32, sizeof(uint32_t));
     vamana_reader.read((char *)&vamana_frozen_num, sizeof(uint64_t));
-    // compute
-    uint64_t medoid, max_node_len, nnodes_per_sector;
-    npts_64 = (uint64_t)npts;
-    medoid = (uint64_t)medoid_u32;
+    uint64_t medoid = (uint64_t)medoid_u32;
     if (vamana_frozen_num == 1)
         vamana_frozen_loc = medoid;
-    max_node_len = (((uint64_t)width_u32 + 1) * sizeof(uint32_t)) + (ndims_64 * sizeof(T));
-    nnodes_per_sector = defaults::SECTOR_LEN / max_node_len; // 0 if max_node_len > SECTOR_LEN
 
-    diskann::cout << "medoid: " << medoid << "B" << std::endl;
-    diskann::cout << "max_node_len: " << max_node_len << "B" << std::endl;
-    diskann::cout << "nnodes_per_sector: " << nnodes_per_sector << "B" << std::endl;
-
-    // defaults::SECTOR_LEN buffer for each sector
-    std::unique_ptr<char[]> sector_buf = std::make_unique<char[]>(defaults::SECTOR_LEN);
-    std::unique_ptr<char[]> multisector_buf = std::make_unique<char[]>(ROUND_UP(max_node_len, defaults::SECTOR_LEN));
-    std::unique_ptr<char[]> node_buf = std::make_unique<char[]>(max_node_len);
-    uint32_t &nnbrs = *(uint32_t *)(node_buf.get() + ndims_64 * sizeof(T));
-    uint32_t *nhood_buf = (uint32_t *)(node_buf.get() + (ndims_64 * sizeof(T)) + sizeof(uint32_t));
+    // The layout is defaults::SECTOR_LEN bytes of metadata followed by the
+    // nodes in sectors of sector_len bytes, each the
+    // coordinates of the point, its number of neighbors and the neighbor ids,
+    // padded to max_node_len. Nodes are packed several to a sector, or span
+    // whole sectors if they do not fit in one. The float vectors of
+    // reorder_data_file, if any, follow in sectors of their own, or with
+    // separate_reorder_data fill a file of their own. With nbr_codes_file,
+    // the neighbor ids of a node are followed by the PQ codes of the
+    // neighbors. With pack_nbr_ids, the neighbor ids are bit-packed.
+    DiskLayoutWriter layout_writer(base_file, sizeof(T), output_file, width_u32, reorder_data_file,
+                                   separate_reorder_data, nbr_codes_file, sector_len, pack_nbr_ids);
+    const uint64_t npts_64 = layout_writer.num_points();
+
+    // hand the graph to the writer in blocks of nodes
+    const uint64_t block_nodes =
+        (std::max)((uint64_t)1, read_blk_size / (((uint64_t)width_u32 + 1) * sizeof(uint32_t)));
+    std::vector<uint32_t> nnbrs(block_nodes);
+    std::vector<uint32_t> nbrs(block_nodes * width_u32);
+    std::vector<uint32_t> overflow;
+    for (uint64_t start = 0; start < npts_64; start += block_nodes)
+    {
+        const uint64_t num_nodes = (std::min)(block_nodes, npts_64 - start);
+        for (uint64_t i = 0; i < num_nodes; i++)
+        {
+            // read cur node's nnbrs
+            vamana_reader.read((char *)&nnbrs[i], sizeof(uint32_t));
 
-    // number of sectors (1 for meta data)
-    uint64_t n_sectors = nnodes_per_sector > 0 ? ROUND_UP(npts_64, nnodes_per_sector) / nnodes_per_sector
-                                               : npts_64 * DIV_ROUND_UP(max_node_len, defaults::SECTOR_LEN);
-    uint64_t n_reorder_sectors = 0;
-    uint64_t n_data_nodes_per_sector = 0;
+            // sanity checks on nnbrs
+            assert(nnbrs[i] > 0);
+            assert(nnbrs[i] <= width_u32);
 
-    if (append_reorder_data)
-    {
-        n_data_nodes_per_sector = defaults::SECTOR_LEN / (ndims_reorder_file * sizeof(float));
-        n_reorder_sectors = ROUND_UP(npts_64, n_data_nodes_per_sector) / n_data_nodes_per_sector;
+            // read node's nhood, skipping anything beyond the width
+            vamana_reader.read((char *)(nbrs.data() + i * width_u32),
+                               (std::min)(nnbrs[i], width_u32) * sizeof(uint32_t));
+            if (nnbrs[i] > width_u32)
+            {
+                overflow.resize(nnbrs[i] - width_u32);
+                vamana_reader.read((char *)overflow.data(), overflow.size() * sizeof(uint32_t));
+            }
+        }
+        layout_writer.add_nodes(nnbrs.data(), nbrs.data(), width_u32, num_nodes);
     }
-    uint64_t disk_index_file_size = (n_sectors + n_reorder_sectors + 1) * defaults::SECTOR_LEN;
+    layout_writer.finish(medoid, vamana_frozen_num, vamana_frozen_loc);
+}
 
-    std::vector<uint64_t> output_file_meta;
-    output_file_meta.push_back(npts_64);
-    output_file_meta.push_back(ndims_64);
-    output_file_meta.push_back(medoid);
-    output_file_meta.push_back(max_node_len);
-    output_file_meta.push_back(nnodes_per_sector);
-    output_file_meta.push_back(vamana_frozen_num);
-    output_file_meta.push_back(vamana_frozen_loc);
-    output_file_meta.push_back((uint64_t)append_reorder_data);
-    if (append_reorder_data)
-    {
-        output_file_meta.push_back(n_sectors + 1);
-        output_file_meta.push_back(ndims_reorder_file);
-        output_file_meta.push_back(n_data_nodes_per_sector);
-    }
-    output_file_meta.push_back(disk_index_file_size);
+std::vector<uint64_t> load_disk_index_metadata(const std::string &disk_index_path)
+{
+    std::ifstream reader(disk_index_path, std::ios::binary);
+    int32_t meta_rows = 0, meta_cols = 0;
+    reader.read((char *)&meta_rows, sizeof(int32_t));
+    reader.read((char *)&meta_cols, sizeof(int32_t));
+    if (!reader || meta_rows < 9 || meta_cols != 1)
+        throw ANNException("Could not read the metadata of " + disk_index_path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    std::vector<uint64_t> meta(meta_rows);
+    reader.read((char *)meta.data(), meta.size() * sizeof(uint64_t));
+    return meta;
+}
 
-    diskann_writer.write(sector_buf.get(), defaults::SECTOR_LEN);
+uint64_t get_inline_pq_chunks(const std::vector<uint64_t> &meta)
+{
+    // the file size is the last row unless the codes follow it
+    const size_t rows = meta[7] != 0 ? 12 : 9;
+    return meta.size() > rows ? meta[rows] : 0;
+}
 
-    std::unique_ptr<T[]> cur_node_coords = std::make_unique<T[]>(ndims_64);
-    diskann::cout << "# sectors: " << n_sectors << std::endl;
-    uint64_t cur_node_id = 0;
+uint64_t get_disk_sector_len(const std::vector<uint64_t> &meta)
+{
+    // follows the neighbor code chunks, which are then present even if 0
+    const size_t rows = meta[7] != 0 ? 13 : 10;
+    return meta.size() > rows ? meta[rows] : defaults::SECTOR_LEN;
+}
 
-    if (nnodes_per_sector > 0)
-    { // Write multiple nodes per sector
-        for (uint64_t sector = 0; sector < n_sectors; sector++)
-        {
-            if (sector % 100000 == 0)
-            {
-                diskann::cout << "Sector #" << sector << "written" << std::endl;
-            }
-            memset(sector_buf.get(), 0, defaults::SECTOR_LEN);
-            for (uint64_t sector_node_id = 0; sector_node_id < nnodes_per_sector && cur_node_id < npts_64;
-                 sector_node_id++)
-            {
-                memset(node_buf.get(), 0, max_node_len);
-                // read cur node's nnbrs
-                vamana_reader.read((char *)&nnbrs, sizeof(uint32_t));
+uint64_t get_packed_nbr_id_bits(const std::vector<uint64_t> &meta)
+{
+    const size_t rows = meta[7] != 0 ? 14 : 11;
+    return meta.size() > rows ? meta[rows] : 0;
+}
 
-                // sanity checks on nnbrs
-                assert(nnbrs > 0);
-                assert(nnbrs <= width_u32);
+namespace
+{
+// Where the nodes of a disk index are, from its metadata
+struct DiskNodeLayout
+{
+    uint64_t ndims, max_node_len, nnodes_per_sector, sector_len, nsectors_per_node;
 
-                // read node's nhood
-                vamana_reader.read((char *)nhood_buf, (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
-                if (nnbrs > width_u32)
-                {
-                    vamana_reader.seekg((nnbrs - width_u32) * sizeof(uint32_t), vamana_reader.cur);
-                }
+    DiskNodeLayout(const std::vector<uint64_t> &meta)
+        : ndims(meta[1]), max_node_len(meta[3]), nnodes_per_sector(meta[4]), sector_len(get_disk_sector_len(meta)),
+          nsectors_per_node(DIV_ROUND_UP(meta[3], sector_len))
+    {
+    }
 
-                // write coords of node first
-                //  T *node_coords = data + ((uint64_t) ndims_64 * cur_node_id);
-                base_reader.read((char *)cur_node_coords.get(), sizeof(T) * ndims_64);
-                memcpy(node_buf.get(), cur_node_coords.get(), ndims_64 * sizeof(T));
+    template <typename T> uint32_t width() const
+    {
+        return (uint32_t)((max_node_len - ndims * sizeof(T)) / sizeof(uint32_t) - 1);
+    }
 
-                // write nnbrs
-                *(uint32_t *)(node_buf.get() + ndims_64 * sizeof(T)) = (std::min)(nnbrs, width_u32);
+    // first sector of node i, after the defaults::SECTOR_LEN bytes of
+    // metadata, and its offset in the sector
+    uint64_t sector(uint64_t i) const
+    {
+        return defaults::SECTOR_LEN / sector_len +
+               (nnodes_per_sector > 0 ? i / nnodes_per_sector : i * nsectors_per_node);
+    }
+    uint64_t offset(uint64_t i) const
+    {
+        return nnodes_per_sector > 0 ? (i % nnodes_per_sector) * max_node_len : 0;
+    }
 
-                // write nhood next
-                memcpy(node_buf.get() + ndims_64 * sizeof(T) + sizeof(uint32_t), nhood_buf,
-                       (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
+    // sectors holding the num_nodes nodes from start, which is the first node
+    // of a sector
+    uint64_t num_sectors(uint64_t start, uint64_t num_nodes) const
+    {
+        return num_nodes == 0 ? 0
+                              : sector(start + num_nodes - 1) + (nnodes_per_sector > 0 ? 1 : nsectors_per_node) -
+                                    sector(start);
+    }
 
-                // get offset into sector_buf
-                char *sector_node_buf = sector_buf.get() + (sector_node_id * max_node_len);
+    // nodes in a block of at most block_sectors sectors, so that blocks start
+    // on a sector boundary
+    uint64_t block_nodes(uint64_t block_sectors) const
+    {
+        return nnodes_per_sector > 0 ? block_sectors * nnodes_per_sector
+                                     : (std::max)((uint64_t)1, block_sectors / nsectors_per_node);
+    }
+};
+} // namespace
 
-                // copy node buf into sector_node_buf
-                memcpy(sector_node_buf, node_buf.get(), max_node_len);
-                cur_node_id++;
-            }
-            // flush sector to disk
-            diskann_writer.write(sector_buf.get(), defaults::SECTOR_LEN);
-        }
+template <typename T>
+uint64_t disk_index_to_mem_index(const std::string &disk_index_path, const std::string &mem_index_path,
+                                 const bool add_frozen_point)
+{
+    const std::vector<uint64_t> meta = load_disk_index_metadata(disk_index_path);
+    const DiskNodeLayout layout(meta);
+    const uint64_t npts = meta[0], ndims = meta[1], medoid = meta[2];
+    const uint32_t width = layout.width<T>();
+    if (meta[7] != 0)
+        throw ANNException(disk_index_path + " holds PQ compressed vectors, which cannot be read back", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    if (get_inline_pq_chunks(meta) != 0)
+        throw ANNException(disk_index_path + " holds neighbor PQ codes, which cannot be read back", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    if (get_packed_nbr_id_bits(meta) != 0)
+        throw ANNException(disk_index_path + " holds packed neighbor ids, which cannot be read back", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    uint64_t num_frozen = meta[5];
+    uint32_t start = (uint32_t)(num_frozen > 0 ? meta[6] : medoid);
+    const bool synthesize_frozen = add_frozen_point && num_frozen == 0;
+    if (synthesize_frozen)
+    {
+        num_frozen = 1;
+        start = (uint32_t)npts;
     }
-    else
-    { // Write multi-sector nodes
-        uint64_t nsectors_per_node = DIV_ROUND_UP(max_node_len, defaults::SECTOR_LEN);
-        for (uint64_t i = 0; i < npts_64; i++)
+
+    const uint64_t block_sectors = (uint64_t)64 * 1024 * 1024 / layout.sector_len;
+    const uint64_t block_nodes = layout.block_nodes(block_sectors);
+    std::vector<char> sectors((block_sectors + layout.nsectors_per_node) * layout.sector_len);
+    std::vector<T> medoid_coords(ndims);
+    std::vector<uint32_t> medoid_nbrs;
+
+    std::ifstream disk_reader(disk_index_path, std::ios::binary);
+    std::ofstream data_writer(mem_index_path + ".data", std::ios::binary);
+    std::ofstream graph_writer(mem_index_path, std::ios::binary);
+    const uint32_t npts_u32 = (uint32_t)(npts + (synthesize_frozen ? 1 : 0)), ndims_u32 = (uint32_t)ndims;
+    uint64_t graph_size = sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+    uint32_t max_degree = 0;
+    data_writer.write((char *)&npts_u32, sizeof(uint32_t));
+    data_writer.write((char *)&ndims_u32, sizeof(uint32_t));
+    graph_writer.write((char *)&graph_size, sizeof(uint64_t));
+    graph_writer.write((char *)&max_degree, sizeof(uint32_t));
+    graph_writer.write((char *)&start, sizeof(uint32_t));
+    graph_writer.write((char *)&num_frozen, sizeof(uint64_t));
+    auto write_node = [&](const char *coords, uint32_t nnbrs, const uint32_t *nbrs) {
+        data_writer.write(coords, ndims * sizeof(T));
+        graph_writer.write((char *)&nnbrs, sizeof(uint32_t));
+        graph_writer.write((char *)nbrs, nnbrs * sizeof(uint32_t));
+        graph_size += ((uint64_t)nnbrs + 1) * sizeof(uint32_t);
+        max_degree = (std::max)(max_degree, nnbrs);
+    };
+
+    for (uint64_t block_start = 0; block_start < npts; block_start += block_nodes)
+    {
+        const uint64_t num_nodes = (std::min)(block_nodes, npts - block_start);
+        const uint64_t first_sector = layout.sector(block_start);
+        disk_reader.seekg(first_sector * layout.sector_len, disk_reader.beg);
+        disk_reader.read(sectors.data(), layout.num_sectors(block_start, num_nodes) * layout.sector_len);
+        for (uint64_t i = block_start; i < block_start + num_nodes; i++)
         {
-            if ((i * nsectors_per_node) % 100000 == 0)
+            const char *node =
+                sectors.data() + (layout.sector(i) - first_sector) * layout.sector_len + layout.offset(i);
+            const uint32_t *nhood = (const uint32_t *)(node + ndims * sizeof(T));
+            const uint32_t nnbrs = (std::min)(nhood[0], width);
+            write_node(node, nnbrs, nhood + 1);
+            if (synthesize_frozen && i == medoid)
             {
-                diskann::cout << "Sector #" << i * nsectors_per_node << "written" << std::endl;
+                std::memcpy(medoid_coords.data(), node, ndims * sizeof(T));
+                medoid_nbrs.assign(nhood + 1, nhood + 1 + nnbrs);
             }
-            memset(multisector_buf.get(), 0, nsectors_per_node * defaults::SECTOR_LEN);
+        }
+    }
+    if (!disk_reader)
+        throw ANNException("Failed to read the nodes of " + disk_index_path, -1, __FUNCSIG__, __FILE__, __LINE__);
 
-            memset(node_buf.get(), 0, max_node_len);
-            // read cur node's nnbrs
-            vamana_reader.read((char *)&nnbrs, sizeof(uint32_t));
+    if (synthesize_frozen)
+    {
+        // a copy of the medoid linked to the medoid and its neighbors
+        medoid_nbrs.insert(medoid_nbrs.begin(), (uint32_t)medoid);
+        medoid_nbrs.resize((std::min)(medoid_nbrs.size(), (size_t)width));
+        write_node((const char *)medoid_coords.data(), (uint32_t)medoid_nbrs.size(), medoid_nbrs.data());
+    }
+    graph_writer.seekp(0, graph_writer.beg);
+    graph_writer.write((char *)&graph_size, sizeof(uint64_t));
+    graph_writer.write((char *)&max_degree, sizeof(uint32_t));
+    if (!graph_writer || !data_writer)
+        throw ANNException("Failed to write the in-memory index " + mem_index_path, -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    return npts_u32;
+}
 
-            // sanity checks on nnbrs
-            assert(nnbrs > 0);
-            assert(nnbrs <= width_u32);
+// Appends the rows of the bin file new_rows to the bin file file, which must
+// have expected_rows rows of the same width.
+static void append_bin_rows(const std::string &file, const std::string &new_rows, const size_t expected_rows)
+{
+    size_t nrows, ncols, new_nrows, new_ncols;
+    diskann::get_bin_metadata(file, nrows, ncols);
+    diskann::get_bin_metadata(new_rows, new_nrows, new_ncols);
+    if (nrows != expected_rows || ncols != new_ncols)
+    {
+        std::stringstream stream;
+        stream << file << " has " << nrows << " rows of " << ncols << " values, expected " << expected_rows
+               << " rows of " << new_ncols << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
 
-            // read node's nhood
-            vamana_reader.read((char *)nhood_buf, (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
-            if (nnbrs > width_u32)
-            {
-                vamana_reader.seekg((nnbrs - width_u32) * sizeof(uint32_t), vamana_reader.cur);
-            }
+    const size_t row_size = (get_file_size(new_rows) - 2 * sizeof(uint32_t)) / (std::max)((size_t)1, new_nrows);
+    std::vector<char> rows(new_nrows * row_size);
+    {
+        std::ifstream reader(new_rows, std::ios::binary);
+        reader.seekg(2 * sizeof(uint32_t), reader.beg);
+        reader.read(rows.data(), rows.size());
+    }
+    std::fstream writer(file, std::ios::binary | std::ios::in | std::ios::out);
+    writer.seekp(2 * sizeof(uint32_t) + nrows * row_size, writer.beg);
+    writer.write(rows.data(), rows.size());
+    const uint32_t total_rows = (uint32_t)(nrows + new_nrows);
+    writer.seekp(0, writer.beg);
+    writer.write((char *)&total_rows, sizeof(uint32_t));
+    if (!writer)
+        throw diskann::ANNException("Failed to append rows to " + file, -1, __FUNCSIG__, __FILE__, __LINE__);
+}
 
-            // write coords of node first
-            //  T *node_coords = data + ((uint64_t) ndims_64 * cur_node_id);
-            base_reader.read((char *)cur_node_coords.get(), sizeof(T) * ndims_64);
-            memcpy(multisector_buf.get(), cur_node_coords.get(), ndims_64 * sizeof(T));
+void get_pq_pivots_metadata(const std::string &pq_pivots_path, uint32_t &num_centers, uint32_t &num_chunks,
+                            bool &use_opq)
+{
+    std::unique_ptr<size_t[]> offsets;
+    size_t nr, nc, pivots_rows, chunk_offsets_rows;
+    diskann::load_bin<size_t>(pq_pivots_path, offsets, nr, nc);
+    if (nr != 4 && nr != 5)
+        throw ANNException("Unexpected offsets in " + pq_pivots_path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    diskann::get_bin_metadata(pq_pivots_path, pivots_rows, nc, offsets[0]);
+    diskann::get_bin_metadata(pq_pivots_path, chunk_offsets_rows, nc, offsets[nr == 4 ? 2 : 3]);
+    num_centers = (uint32_t)pivots_rows;
+    num_chunks = (uint32_t)(chunk_offsets_rows - 1);
+    use_opq = file_exists(pq_pivots_path + "_rotation_matrix.bin");
+}
 
-            // write nnbrs
-            *(uint32_t *)(multisector_buf.get() + ndims_64 * sizeof(T)) = (std::min)(nnbrs, width_u32);
+template <typename T>
+int append_to_disk_index(const std::string &index_prefix, const std::string &new_data_file,
+                         const diskann::Metric compareMetric, const uint32_t L, const float alpha,
+                         const uint32_t num_threads)
+{
+    Timer timer;
+    const std::string disk_index_path = index_prefix + "_disk.index";
+    const std::string pq_pivots_path = index_prefix + "_pq_pivots.bin";
+    const std::string pq_compressed_path = index_prefix + "_pq_compressed.bin";
+    const std::string layout_ids_path = disk_index_path + "_layout_ids.bin";
+    const std::string tmp_prefix = index_prefix + "_append";
+    const std::string tmp_mem_index = tmp_prefix + "_mem.index";
+    const std::string tmp_data = tmp_prefix + "_data.bin";
+    const std::string tmp_pq_compressed = tmp_prefix + "_pq_compressed.bin";
+
+    if (compareMetric == diskann::Metric::INNER_PRODUCT ||
+        (compareMetric == diskann::Metric::COSINE && !std::is_same<T, float>::value))
+        throw ANNException("Appending to a disk index supports L2, and cosine for floating point data", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    if (file_exists(disk_index_path + "_pq_pivots.bin") || file_exists(disk_index_path + "_labels.txt"))
+        throw ANNException("Appending is only supported for disk indices with full precision vectors and no filters",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    std::vector<uint64_t> meta = load_disk_index_metadata(disk_index_path);
+    const DiskNodeLayout layout(meta);
+    const uint64_t npts = meta[0], ndims = meta[1];
+    if (meta[5] != 0 || meta[7] != 0 || get_inline_pq_chunks(meta) != 0 ||
+        get_disk_sector_len(meta) != defaults::SECTOR_LEN || get_packed_nbr_id_bits(meta) != 0)
+        throw ANNException("Appending is not supported for disk indices with frozen points, reorder data, neighbor "
+                           "PQ codes, short sectors or packed neighbor ids",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    const uint32_t width = layout.width<T>();
+
+    std::string data_file_to_use = new_data_file;
+    if (compareMetric == diskann::Metric::COSINE)
+    {
+        // the disk index holds the normalized base vectors
+        diskann::normalize_data_file(new_data_file, tmp_data);
+        data_file_to_use = tmp_data;
+    }
+    std::unique_ptr<T[]> new_data;
+    size_t num_new, new_dims;
+    diskann::load_bin<T>(data_file_to_use, new_data, num_new, new_dims);
+    if (new_dims != ndims)
+        throw ANNException("Dimension of " + new_data_file + " does not match the disk index", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    if (num_new == 0)
+    {
+        diskann::cout << "No points to append" << std::endl;
+        std::remove(tmp_data.c_str());
+        return 0;
+    }
+    const uint64_t total_pts = npts + num_new;
 
-            // write nhood next
-            memcpy(multisector_buf.get() + ndims_64 * sizeof(T) + sizeof(uint32_t), nhood_buf,
-                   (std::min)(nnbrs, width_u32) * sizeof(uint32_t));
+    // unpack the graph and the vectors into an in-memory index
+    disk_index_to_mem_index<T>(disk_index_path, tmp_mem_index);
+    diskann::cout << timer.elapsed_seconds_for_step("reading the graph of " + std::to_string(npts) + " points")
+                  << std::endl;
 
-            // flush sector to disk
-            diskann_writer.write(multisector_buf.get(), nsectors_per_node * defaults::SECTOR_LEN);
-        }
+    // insert the new points by search and prune, adding their reverse edges
+    timer.reset();
+    {
+        auto params = std::make_shared<IndexWriteParameters>(IndexWriteParametersBuilder(L, width)
+                                                                 .with_alpha(alpha)
+                                                                 .with_saturate_graph(false)
+                                                                 .with_num_threads(num_threads)
+                                                                 .build());
+        diskann::Index<T> index(compareMetric, ndims, total_pts, params, nullptr, defaults::NUM_FROZEN_POINTS_STATIC,
+                                false, false, false, false, 0, false);
+        index.load(tmp_mem_index.c_str(), num_threads, L);
+        index.append_points(new_data.get(), num_new);
+        index.save(tmp_mem_index.c_str());
     }
+    diskann::cout << timer.elapsed_seconds_for_step("inserting " + std::to_string(num_new) + " points") << std::endl;
 
-    if (append_reorder_data)
+    // compress the new points with the existing pivots before touching the index
+    timer.reset();
     {
-        diskann::cout << "Index written. Appending reorder data..." << std::endl;
-
-        auto vec_len = ndims_reorder_file * sizeof(float);
-        std::unique_ptr<char[]> vec_buf = std::make_unique<char[]>(vec_len);
+        uint32_t num_centers, num_chunks;
+        bool use_opq;
+        get_pq_pivots_metadata(pq_pivots_path, num_centers, num_chunks, use_opq);
+        generate_pq_data_from_pivots<T>(data_file_to_use, num_centers, num_chunks, pq_pivots_path, tmp_pq_compressed,
+                                        use_opq);
+    }
+    diskann::cout << timer.elapsed_seconds_for_step("compressing the new points") << std::endl;
 
-        for (uint64_t sector = 0; sector < n_reorder_sectors; sector++)
+    // rewrite the sectors whose nodes changed and add those of the new points
+    timer.reset();
+    uint64_t rewritten = 0;
+    {
+        const uint64_t block_sectors = (uint64_t)64 * 1024 * 1024 / defaults::SECTOR_LEN;
+        const uint64_t block_nodes = layout.block_nodes(block_sectors);
+        const uint64_t old_num_sectors = layout.num_sectors(0, npts);
+        std::vector<char> sectors((block_sectors + layout.nsectors_per_node) * defaults::SECTOR_LEN);
+        std::vector<char> old_sectors(sectors.size());
+        std::vector<uint32_t> nbrs;
+
+        std::fstream disk_file(disk_index_path, std::ios::binary | std::ios::in | std::ios::out);
+        cached_ifstream graph_reader(tmp_mem_index, 64 * 1024 * 1024);
+        uint64_t graph_header[3];
+        graph_reader.read((char *)graph_header, sizeof(graph_header));
+        for (uint64_t start = 0; start < total_pts; start += block_nodes)
         {
-            if (sector % 100000 == 0)
+            const uint64_t num_nodes = (std::min)(block_nodes, total_pts - start);
+            const uint64_t first_sector = layout.sector(start);
+            const uint64_t num_sectors = layout.num_sectors(start, num_nodes);
+            const uint64_t num_old_sectors =
+                first_sector < old_num_sectors + 1 ? (std::min)(num_sectors, old_num_sectors + 1 - first_sector) : 0;
+            std::memset(old_sectors.data(), 0, num_sectors * defaults::SECTOR_LEN);
+            if (num_old_sectors > 0)
             {
-                diskann::cout << "Reorder data Sector #" << sector << "written" << std::endl;
+                disk_file.seekg(first_sector * defaults::SECTOR_LEN, disk_file.beg);
+                disk_file.read(old_sectors.data(), num_old_sectors * defaults::SECTOR_LEN);
             }
+            std::memcpy(sectors.data(), old_sectors.data(), num_sectors * defaults::SECTOR_LEN);
 
-            memset(sector_buf.get(), 0, defaults::SECTOR_LEN);
-
-            for (uint64_t sector_node_id = 0; sector_node_id < n_data_nodes_per_sector && sector_node_id < npts_64;
-                 sector_node_id++)
+            for (uint64_t i = start; i < start + num_nodes; i++)
             {
-                memset(vec_buf.get(), 0, vec_len);
-                reorder_data_reader.read(vec_buf.get(), vec_len);
+                char *node =
+                    sectors.data() + (layout.sector(i) - first_sector) * defaults::SECTOR_LEN + layout.offset(i);
+                if (i >= npts)
+                    std::memcpy(node, new_data.get() + (i - npts) * ndims, ndims * sizeof(T));
+                uint32_t nnbrs;
+                graph_reader.read((char *)&nnbrs, sizeof(uint32_t));
+                nbrs.resize(nnbrs);
+                graph_reader.read((char *)nbrs.data(), nnbrs * sizeof(uint32_t));
+                nnbrs = (std::min)(nnbrs, width);
+                char *nhood = node + ndims * sizeof(T);
+                std::memset(nhood, 0, ((size_t)width + 1) * sizeof(uint32_t));
+                std::memcpy(nhood, &nnbrs, sizeof(uint32_t));
+                std::memcpy(nhood + sizeof(uint32_t), nbrs.data(), nnbrs * sizeof(uint32_t));
+            }
 
-                // copy node buf into sector_node_buf
-                memcpy(sector_buf.get() + (sector_node_id * vec_len), vec_buf.get(), vec_len);
+            for (uint64_t s = 0; s < num_sectors; s++)
+            {
+                const char *sector = sectors.data() + s * defaults::SECTOR_LEN;
+                if (s < num_old_sectors &&
+                    std::memcmp(sector, old_sectors.data() + s * defaults::SECTOR_LEN, defaults::SECTOR_LEN) == 0)
+                    continue;
+                disk_file.seekp((first_sector + s) * defaults::SECTOR_LEN, disk_file.beg);
+                disk_file.write(sector, defaults::SECTOR_LEN);
+                rewritten++;
             }
-            // flush sector to disk
-            diskann_writer.write(sector_buf.get(), defaults::SECTOR_LEN);
         }
+
+        // the metadata sector last, so that the index reads as the old one
+        // until all nodes are in place
+        meta[0] = total_pts;
+        meta.back() = (layout.num_sectors(0, total_pts) + 1) * defaults::SECTOR_LEN;
+        disk_file.seekp(2 * sizeof(int32_t), disk_file.beg);
+        disk_file.write((char *)meta.data(), meta.size() * sizeof(uint64_t));
+        if (!disk_file)
+            throw ANNException("Failed to update " + disk_index_path, -1, __FUNCSIG__, __FILE__, __LINE__);
     }
-    diskann_writer.close();
-    diskann::save_bin<uint64_t>(output_file, output_file_meta.data(), output_file_meta.size(), 1, 0);
-    diskann::cout << "Output disk index file written to " << output_file << std::endl;
-}
+    diskann::cout << timer.elapsed_seconds_for_step("rewriting " + std::to_string(rewritten) + " sectors") << std::endl;
 
-template <typename T, typename LabelT>
-int build_disk_index(const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
-                     diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
-                     const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
-                     const uint32_t Lf)
-{
-    std::stringstream parser;
-    parser << std::string(indexBuildParameters);
-    std::string cur_param;
-    std::vector<std::string> param_list;
-    while (parser >> cur_param)
+    append_bin_rows(pq_compressed_path, tmp_pq_compressed, npts);
+    if (file_exists(layout_ids_path))
     {
-        param_list.push_back(cur_param);
+        // the new points keep their ids, following those of the base
+        std::vector<uint32_t> new_ids(num_new);
+        for (size_t i = 0; i < num_new; i++)
+            new_ids[i] = (uint32_t)(npts + i);
+        diskann::save_bin<uint32_t>(tmp_prefix + "_layout_ids.bin", new_ids.data(), num_new, 1);
+        append_bin_rows(layout_ids_path, tmp_prefix + "_layout_ids.bin", npts);
+        std::remove((tmp_prefix + "_layout_ids.bin").c_str());
     }
-    if (param_list.size() < 5 || param_list.size() > 9)
+    const std::string duplicates_path = disk_index_path + "_duplicates.bin";
+    if (file_exists(duplicates_path))
     {
-        diskann::cout << "Correct usage of parameters is R (max degree)\n"
-                         "L (indexing list size, better if >= R)\n"
-                         "B (RAM limit of final index in GB)\n"
-                         "M (memory limit while indexing)\n"
-                         "T (number of threads for indexing)\n"
-                         "B' (PQ bytes for disk index: optional parameter for "
-                         "very large dimensional data)\n"
-                         "reorder (set true to include full precision in data file"
-                         ": optional paramter, use only when using disk PQ\n"
-                         "build_PQ_byte (number of PQ bytes for inde build; set 0 to use "
-                         "full precision vectors)\n"
-                         "QD Quantized Dimension to overwrite the derived dim from B "
-                      << std::endl;
-        return -1;
+        // the new points follow the points of the base, which may outnumber
+        // its nodes, and each is a node of its own
+        size_t num_base_points, ids_dim;
+        diskann::get_bin_metadata(duplicates_path, num_base_points, ids_dim);
+        std::vector<uint32_t> new_nodes(num_new);
+        for (size_t i = 0; i < num_new; i++)
+            new_nodes[i] = (uint32_t)(npts + i);
+        diskann::save_bin<uint32_t>(tmp_prefix + "_duplicates.bin", new_nodes.data(), num_new, 1);
+        append_bin_rows(duplicates_path, tmp_prefix + "_duplicates.bin", num_base_points);
+        std::remove((tmp_prefix + "_duplicates.bin").c_str());
     }
 
-    if (!std::is_same<T, float>::value &&
-        (compareMetric == diskann::Metric::INNER_PRODUCT || compareMetric == diskann::Metric::COSINE))
+    for (const std::string &file : {tmp_mem_index, tmp_mem_index + ".data", tmp_data, tmp_pq_compressed,
+                                    tmp_pq_compressed + "_inflated.bin"})
+        std::remove(file.c_str());
+    diskann::cout << "Appended " << num_new << " points to " << disk_index_path << ", which now has " << total_pts
+                  << " points" << std::endl;
+    return 0;
+}
+
+void reorder_graph_for_locality(const std::string &mem_index_file, std::vector<uint32_t> &new_to_old,
+                                const std::string &labels_file)
+{
+    Timer timer;
+    size_t expected_file_size, file_size = get_file_size(mem_index_file);
+    uint32_t width, start;
+    uint64_t num_frozen_pts;
+
+    // load the graph as CSR
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> nbrs;
+    {
+        cached_ifstream reader(mem_index_file, 64 * 1024 * 1024);
+        reader.read((char *)&expected_file_size, sizeof(uint64_t));
+        reader.read((char *)&width, sizeof(uint32_t));
+        reader.read((char *)&start, sizeof(uint32_t));
+        reader.read((char *)&num_frozen_pts, sizeof(uint64_t));
+        if (expected_file_size != file_size)
+            throw ANNException("Vamana index file size does not match size in its header", -1, __FUNCSIG__, __FILE__,
+                               __LINE__);
+
+        size_t bytes_read = sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+        offsets.push_back(0);
+        while (bytes_read < file_size)
+        {
+            uint32_t k;
+            reader.read((char *)&k, sizeof(uint32_t));
+            size_t cur = nbrs.size();
+            nbrs.resize(cur + k);
+            reader.read((char *)(nbrs.data() + cur), k * sizeof(uint32_t));
+            offsets.push_back(nbrs.size());
+            bytes_read += sizeof(uint32_t) * ((size_t)k + 1);
+        }
+    }
+    size_t npts = offsets.size() - 1;
+
+    // BFS from the seeds in turn, visiting each adjacency list in its stored
+    // (closest first) order and only the nodes of the group of the seed, if
+    // groups are given; every seed not reached earlier starts a BFS of its
+    // own, so that every node gets a position even if the graph is not
+    // connected
+    std::vector<bool> visited(npts, false);
+    auto bfs = [&](const std::vector<uint32_t> &seeds, const std::vector<uint32_t> *groups,
+                   std::vector<uint32_t> &order) {
+        for (uint32_t seed : seeds)
+        {
+            if (visited[seed])
+                continue;
+            size_t head = order.size();
+            visited[seed] = true;
+            order.push_back(seed);
+            while (head < order.size())
+            {
+                uint32_t cur = order[head++];
+                for (size_t j = offsets[cur]; j < offsets[cur + 1]; j++)
+                {
+                    uint32_t nbr = nbrs[j];
+                    if (!visited[nbr] && (groups == nullptr || (*groups)[nbr] == (*groups)[seed]))
+                    {
+                        visited[nbr] = true;
+                        order.push_back(nbr);
+                    }
+                }
+            }
+        }
+    };
+    std::vector<uint32_t> seeds(npts + 1);
+    seeds[0] = start;
+    std::iota(seeds.begin() + 1, seeds.end(), 0);
+    new_to_old.clear();
+    new_to_old.reserve(npts);
+    bfs(seeds, nullptr, new_to_old);
+
+    if (!labels_file.empty())
+    {
+        // the rarest label of each node, which filtered searches for it find
+        // packed in few sectors; those for common labels pass most nodes of
+        // any sector anyway
+        std::vector<std::vector<uint32_t>> node_labels;
+        std::unordered_map<uint32_t, size_t> label_counts;
+        {
+            std::ifstream reader(labels_file);
+            std::string line, token;
+            while (std::getline(reader, line))
+            {
+                node_labels.emplace_back();
+                std::istringstream iss(line);
+                while (std::getline(iss, token, ','))
+                {
+                    token.erase(std::remove_if(token.begin(), token.end(), ::isspace), token.end());
+                    if (token.empty())
+                        continue;
+                    node_labels.back().push_back((uint32_t)std::stoul(token));
+                    label_counts[node_labels.back().back()]++;
+                }
+            }
+        }
+        if (node_labels.size() != npts)
+            throw ANNException("Number of lines in " + labels_file + " does not match the number of nodes", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        std::vector<uint32_t> groups(npts, std::numeric_limits<uint32_t>::max());
+        for (size_t i = 0; i < npts; i++)
+        {
+            for (uint32_t label : node_labels[i])
+            {
+                const uint32_t cur = groups[i];
+                if (cur == std::numeric_limits<uint32_t>::max() || label_counts[label] < label_counts[cur] ||
+                    (label_counts[label] == label_counts[cur] && label < cur))
+                    groups[i] = label;
+            }
+        }
+
+        // the groups in the order the BFS above first reaches them, each laid
+        // out in BFS order within the group from its nodes in that order
+        std::unordered_map<uint32_t, size_t> group_rank;
+        std::vector<std::vector<uint32_t>> group_seeds;
+        for (uint32_t id : new_to_old)
+        {
+            auto it = group_rank.emplace(groups[id], group_seeds.size()).first;
+            if (it->second == group_seeds.size())
+                group_seeds.emplace_back();
+            group_seeds[it->second].push_back(id);
+        }
+        std::fill(visited.begin(), visited.end(), false);
+        new_to_old.clear();
+        for (const auto &members : group_seeds)
+            bfs(members, &groups, new_to_old);
+        diskann::cout << "Grouped the nodes by the rarest of their labels into " << group_seeds.size() << " groups"
+                      << std::endl;
+    }
+
+    std::vector<uint32_t> old_to_new(npts);
+    for (size_t i = 0; i < npts; i++)
+        old_to_new[new_to_old[i]] = (uint32_t)i;
+
+    // rewrite the graph in the new order with renumbered neighbors
+    {
+        cached_ofstream writer(mem_index_file, 64 * 1024 * 1024);
+        uint32_t new_start = old_to_new[start];
+        writer.write((char *)&file_size, sizeof(uint64_t));
+        writer.write((char *)&width, sizeof(uint32_t));
+        writer.write((char *)&new_start, sizeof(uint32_t));
+        writer.write((char *)&num_frozen_pts, sizeof(uint64_t));
+        std::vector<uint32_t> remapped;
+        for (size_t i = 0; i < npts; i++)
+        {
+            uint32_t old_id = new_to_old[i];
+            uint32_t k = (uint32_t)(offsets[old_id + 1] - offsets[old_id]);
+            remapped.resize(k);
+            for (uint32_t j = 0; j < k; j++)
+                remapped[j] = old_to_new[nbrs[offsets[old_id] + j]];
+            writer.write((char *)&k, sizeof(uint32_t));
+            writer.write((char *)remapped.data(), k * sizeof(uint32_t));
+        }
+    }
+    diskann::cout << timer.elapsed_seconds_for_step("reordering graph for sector locality") << std::endl;
+}
+
+namespace
+{
+// The adjacency lists of a Vamana graph file and its header
+struct VamanaGraph
+{
+    uint32_t width = 0;
+    uint32_t start = 0;
+    uint64_t num_frozen_pts = 0;
+    std::vector<std::vector<uint32_t>> nbrs;
+
+    void load(const std::string &mem_index_file)
+    {
+        size_t expected_file_size, file_size = get_file_size(mem_index_file);
+        cached_ifstream reader(mem_index_file, 64 * 1024 * 1024);
+        reader.read((char *)&expected_file_size, sizeof(uint64_t));
+        reader.read((char *)&width, sizeof(uint32_t));
+        reader.read((char *)&start, sizeof(uint32_t));
+        reader.read((char *)&num_frozen_pts, sizeof(uint64_t));
+        if (expected_file_size != file_size)
+            throw ANNException("Vamana index file size does not match size in its header", -1, __FUNCSIG__, __FILE__,
+                               __LINE__);
+
+        size_t bytes_read = sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+        nbrs.clear();
+        while (bytes_read < file_size)
+        {
+            uint32_t k;
+            reader.read((char *)&k, sizeof(uint32_t));
+            nbrs.emplace_back(k);
+            reader.read((char *)nbrs.back().data(), k * sizeof(uint32_t));
+            bytes_read += sizeof(uint32_t) * ((size_t)k + 1);
+        }
+    }
+
+    void save(const std::string &mem_index_file)
+    {
+        uint64_t file_size = sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+        width = 0;
+        for (const auto &list : nbrs)
+        {
+            file_size += sizeof(uint32_t) * (list.size() + 1);
+            width = (std::max)(width, (uint32_t)list.size());
+        }
+        cached_ofstream writer(mem_index_file, 64 * 1024 * 1024);
+        writer.write((char *)&file_size, sizeof(uint64_t));
+        writer.write((char *)&width, sizeof(uint32_t));
+        writer.write((char *)&start, sizeof(uint32_t));
+        writer.write((char *)&num_frozen_pts, sizeof(uint64_t));
+        for (const auto &list : nbrs)
+        {
+            uint32_t k = (uint32_t)list.size();
+            writer.write((char *)&k, sizeof(uint32_t));
+            writer.write((char *)list.data(), k * sizeof(uint32_t));
+        }
+    }
+};
+
+// In-degrees and BFS depths of the nodes of a graph, UINT32_MAX for the nodes
+// that cannot be reached, and the nodes found weakly reachable
+struct GraphConnectivity
+{
+    std::vector<uint32_t> in_degree;
+    std::vector<uint32_t> depth;
+    std::vector<uint32_t> weak;
+
+    void analyse(const VamanaGraph &graph, const std::vector<uint32_t> &entry_points, const uint32_t min_in_degree,
+                 const uint32_t max_hops)
+    {
+        const size_t npts = graph.nbrs.size();
+        in_degree.assign(npts, 0);
+        for (const auto &list : graph.nbrs)
+        {
+            for (uint32_t nbr : list)
+                in_degree[nbr]++;
+        }
+
+        depth.assign(npts, std::numeric_limits<uint32_t>::max());
+        std::vector<uint32_t> queue;
+        for (uint32_t entry : entry_points)
+        {
+            if (depth[entry] != 0)
+                queue.push_back(entry);
+            depth[entry] = 0;
+        }
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            const uint32_t cur = queue[head];
+            for (uint32_t nbr : graph.nbrs[cur])
+            {
+                if (depth[nbr] == std::numeric_limits<uint32_t>::max())
+                {
+                    depth[nbr] = depth[cur] + 1;
+                    queue.push_back(nbr);
+                }
+            }
+        }
+
+        weak.clear();
+        size_t num_unreachable = 0, num_far = 0, num_low_in_degree = 0;
+        double depth_sum = 0;
+        for (size_t i = 0; i < npts; i++)
+        {
+            const bool unreachable = depth[i] == std::numeric_limits<uint32_t>::max();
+            num_unreachable += unreachable;
+            num_far += depth[i] > max_hops;
+            num_low_in_degree += in_degree[i] < min_in_degree;
+            if (!unreachable)
+                depth_sum += depth[i];
+            if (depth[i] > max_hops || in_degree[i] < min_in_degree)
+                weak.push_back((uint32_t)i);
+        }
+        diskann::cout << "Nodes: " << npts << ", unreachable: " << num_unreachable << ", beyond " << max_hops
+                      << " hops: " << num_far << ", in-degree below " << min_in_degree << ": " << num_low_in_degree
+                      << ", mean depth of the reachable: " << depth_sum / (std::max)((size_t)1, queue.size())
+                      << std::endl;
+    }
+};
+} // namespace
+
+template <typename T>
+uint64_t repair_graph_connectivity(const std::string &mem_index_file, const std::string &data_file,
+                                   const std::string &medoids_file, const uint32_t min_in_degree,
+                                   const uint32_t max_hops, uint32_t max_degree, const uint32_t L, const bool repair)
+{
+    Timer timer;
+    VamanaGraph graph;
+    graph.load(mem_index_file);
+    const size_t npts = graph.nbrs.size();
+    if (max_degree == 0)
+        max_degree = graph.width;
+
+    std::vector<uint32_t> entry_points(1, graph.start);
+    if (!medoids_file.empty() && file_exists(medoids_file))
+    {
+        std::unique_ptr<uint32_t[]> medoids;
+        size_t num_medoids, medoids_dim;
+        diskann::load_bin<uint32_t>(medoids_file, medoids, num_medoids, medoids_dim);
+        for (size_t i = 0; i < num_medoids * medoids_dim; i++)
+        {
+            if (medoids[i] < npts)
+                entry_points.push_back(medoids[i]);
+        }
+    }
+
+    GraphConnectivity connectivity;
+    connectivity.analyse(graph, entry_points, min_in_degree, max_hops);
+    if (!repair || connectivity.weak.empty())
+        return 0;
+
+    T *data = nullptr;
+    size_t data_npts, dim, aligned_dim;
+    diskann::load_aligned_bin<T>(data_file, data, data_npts, dim, aligned_dim);
+    std::unique_ptr<T, decltype(&diskann::aligned_free)> data_holder(data, &diskann::aligned_free);
+    if (data_npts != npts)
+        throw ANNException("Number of points in " + data_file + " does not match the graph", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    std::unique_ptr<Distance<T>> dist_fn(get_distance_function<T>(diskann::Metric::L2));
+    auto distance = [&](uint32_t a, uint32_t b) {
+        return dist_fn->compare(data + a * aligned_dim, data + b * aligned_dim, (uint32_t)aligned_dim);
+    };
+
+    // For each weak node, the nodes it should get edges from: the closest to
+    // it among those a greedy search for it from the entry points visits,
+    // preferring those within max_hops - 1 hops, so that the new edge puts it
+    // within max_hops. A few spares stand in for nodes that are full.
+    const std::vector<uint32_t> &weak = connectivity.weak;
+    std::vector<std::vector<Neighbor>> sources(weak.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t w = 0; w < (int64_t)weak.size(); w++)
+    {
+        const uint32_t target = weak[w];
+        NeighborPriorityQueue retset(L);
+        tsl::robin_set<uint32_t> visited;
+        std::vector<Neighbor> seen;
+        auto visit = [&](uint32_t id) {
+            if (!visited.insert(id).second)
+                return;
+            Neighbor nn(id, distance(target, id));
+            retset.insert(nn);
+            if (id != target)
+                seen.push_back(nn);
+        };
+        for (uint32_t entry : entry_points)
+            visit(entry);
+        while (retset.has_unexpanded_node())
+        {
+            const Neighbor cur = retset.closest_unexpanded();
+            for (uint32_t nbr : graph.nbrs[cur.id])
+                visit(nbr);
+        }
+
+        std::sort(seen.begin(), seen.end());
+        const uint32_t needed = min_in_degree > connectivity.in_degree[target]
+                                    ? min_in_degree - connectivity.in_degree[target]
+                                    : 1;
+        for (bool near_only : {true, false})
+        {
+            for (const Neighbor &nn : seen)
+            {
+                if (sources[w].size() >= 2 * (size_t)needed)
+                    break;
+                if (near_only != (connectivity.depth[nn.id] < max_hops))
+                    continue;
+                const auto &list = graph.nbrs[nn.id];
+                if (std::find(list.begin(), list.end(), target) == list.end())
+                    sources[w].push_back(nn);
+            }
+        }
+    }
+
+    // Add the edges one node at a time, the farthest nodes first. A full node
+    // gives up its longest redundant edge instead: one to a neighbor that
+    // another of its neighbors links to as well, and that keeps more than
+    // min_in_degree in-edges. The edge must be longer than the new one unless
+    // the weak node is beyond max_hops.
+    std::vector<uint32_t> &in_degree = connectivity.in_degree;
+    std::vector<size_t> order(weak.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return connectivity.depth[weak[a]] > connectivity.depth[weak[b]];
+    });
+    uint64_t num_added = 0, num_replaced = 0;
+    for (size_t w : order)
+    {
+        const uint32_t target = weak[w];
+        bool far = connectivity.depth[target] > max_hops;
+        for (const Neighbor &source : sources[w])
+        {
+            if (in_degree[target] >= min_in_degree && !far)
+                break;
+            auto &list = graph.nbrs[source.id];
+            if (list.size() < max_degree)
+            {
+                list.push_back(target);
+            }
+            else
+            {
+                size_t victim = list.size();
+                float victim_dist = far ? -1.0f : source.distance;
+                for (size_t j = 0; j < list.size(); j++)
+                {
+                    if (in_degree[list[j]] <= min_in_degree)
+                        continue;
+                    const bool redundant = std::any_of(list.begin(), list.end(), [&](uint32_t other) {
+                        const auto &other_list = graph.nbrs[other];
+                        return other != list[j] &&
+                               std::find(other_list.begin(), other_list.end(), list[j]) != other_list.end();
+                    });
+                    if (!redundant)
+                        continue;
+                    const float d = distance(source.id, list[j]);
+                    if (d > victim_dist)
+                    {
+                        victim = j;
+                        victim_dist = d;
+                    }
+                }
+                if (victim == list.size())
+                    continue;
+                in_degree[list[victim]]--;
+                list[victim] = target;
+                num_replaced++;
+            }
+            in_degree[target]++;
+            num_added++;
+            // an edge from a node within max_hops - 1 hops is enough
+            if (connectivity.depth[source.id] < max_hops)
+                far = false;
+        }
+    }
+    diskann::cout << "Added " << num_added << " edges to " << weak.size() << " weakly reachable nodes, "
+                  << num_replaced << " of them in place of longer edges" << std::endl;
+
+    connectivity.analyse(graph, entry_points, min_in_degree, max_hops);
+    graph.save(mem_index_file);
+    diskann::cout << timer.elapsed_seconds_for_step("repairing graph connectivity") << std::endl;
+    return num_added;
+}
+
+template <typename T>
+void permute_bin_rows(const std::string &in_file, const std::string &out_file, const std::vector<uint32_t> &new_to_old)
+{
+    size_t npts, ndims;
+    diskann::get_bin_metadata(in_file, npts, ndims);
+    if (npts != new_to_old.size())
+        throw ANNException("Number of points in " + in_file + " does not match the permutation size", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+
+    std::vector<uint32_t> old_to_new(npts);
+    for (size_t i = 0; i < npts; i++)
+        old_to_new[new_to_old[i]] = (uint32_t)i;
+
+    // each pass streams the input once and fills a window of output rows, so
+    // memory stays bounded for files larger than RAM
+    const size_t row_size = ndims * sizeof(T);
+    const size_t window_rows = (std::max)((size_t)1, (size_t)(1024 * 1024 * 1024) / (std::max)(row_size, (size_t)1));
+    std::vector<char> window(std::min(npts, window_rows) * row_size);
+    std::vector<char> row(row_size);
+
+    cached_ofstream writer(out_file, 64 * 1024 * 1024);
+    uint32_t npts_u32 = (uint32_t)npts, ndims_u32 = (uint32_t)ndims;
+    writer.write((char *)&npts_u32, sizeof(uint32_t));
+    writer.write((char *)&ndims_u32, sizeof(uint32_t));
+    for (size_t window_start = 0; window_start < npts; window_start += window_rows)
+    {
+        size_t window_end = (std::min)(npts, window_start + window_rows);
+        cached_ifstream reader(in_file, 64 * 1024 * 1024);
+        reader.read((char *)&npts_u32, sizeof(uint32_t));
+        reader.read((char *)&ndims_u32, sizeof(uint32_t));
+        for (size_t i = 0; i < npts; i++)
+        {
+            reader.read(row.data(), row_size);
+            size_t new_id = old_to_new[i];
+            if (new_id >= window_start && new_id < window_end)
+                memcpy(window.data() + (new_id - window_start) * row_size, row.data(), row_size);
+        }
+        writer.write(window.data(), (window_end - window_start) * row_size);
+    }
+}
+
+// rewrites a text file holding one line per point in the new order
+void permute_text_lines(const std::string &in_file, const std::string &out_file,
+                        const std::vector<uint32_t> &new_to_old)
+{
+    std::vector<std::string> lines;
+    {
+        std::ifstream reader(in_file);
+        std::string line;
+        while (std::getline(reader, line))
+            lines.push_back(line);
+    }
+    if (lines.size() != new_to_old.size())
+        throw ANNException("Number of lines in " + in_file + " does not match the permutation size", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    std::ofstream writer(out_file);
+    for (auto old_id : new_to_old)
+        writer << lines[old_id] << std::endl;
+}
+
+// renumbers the point ids in a comma separated file; the first token of each
+// line is left alone if it is not an id (e.g. a label)
+void remap_ids_in_text_file(const std::string &file, const std::vector<uint32_t> &old_to_new, bool first_token_is_id)
+{
+    std::vector<std::string> lines;
+    {
+        std::ifstream reader(file);
+        std::string line;
+        while (std::getline(reader, line))
+            lines.push_back(line);
+    }
+    std::ofstream writer(file);
+    for (auto &line : lines)
+    {
+        std::istringstream iss(line);
+        std::string token;
+        uint32_t cnt = 0;
+        while (std::getline(iss, token, ','))
+        {
+            if (cnt > 0)
+                writer << ", ";
+            if (cnt == 0 && !first_token_is_id)
+                writer << token;
+            else
+                writer << old_to_new[std::stoul(token)];
+            cnt++;
+        }
+        writer << std::endl;
+    }
+}
+
+template <typename T>
+size_t collapse_duplicates(const std::string &base_file, const std::string &out_file,
+                           const std::string &duplicates_file, const float radius)
+{
+    size_t npts, dim;
+    diskann::get_bin_metadata(base_file, npts, dim);
+    const size_t row_size = dim * sizeof(T);
+    std::vector<T> row(dim);
+    uint32_t npts_u32, ndims_u32;
+
+    // the hyperplanes of the hash pass through the mean, so that the sign
+    // bits split the data rather than all agreeing on off-center data
+    std::vector<double> mean(dim, 0.0);
+    {
+        cached_ifstream reader(base_file, 64 * 1024 * 1024);
+        reader.read((char *)&npts_u32, sizeof(uint32_t));
+        reader.read((char *)&ndims_u32, sizeof(uint32_t));
+        for (size_t i = 0; i < npts; i++)
+        {
+            reader.read((char *)row.data(), row_size);
+            for (size_t d = 0; d < dim; d++)
+                mean[d] += (float)row[d];
+        }
+    }
+    for (size_t d = 0; d < dim; d++)
+        mean[d] /= (std::max)(npts, (size_t)1);
+
+    // enough bits that distinct points rarely share a bucket, while points a
+    // small angle apart around the mean share all of them
+    uint32_t num_bits = 8;
+    while (num_bits < 64 && ((uint64_t)1 << (num_bits - 8)) < npts)
+        num_bits++;
+    std::mt19937 gen(0x5eed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> planes((size_t)num_bits * dim);
+    for (auto &x : planes)
+        x = normal(gen);
+
+    std::vector<std::pair<uint64_t, uint32_t>> buckets(npts);
+    {
+        cached_ifstream reader(base_file, 64 * 1024 * 1024);
+        reader.read((char *)&npts_u32, sizeof(uint32_t));
+        reader.read((char *)&ndims_u32, sizeof(uint32_t));
+        std::vector<float> centered(dim);
+        for (size_t i = 0; i < npts; i++)
+        {
+            reader.read((char *)row.data(), row_size);
+            for (size_t d = 0; d < dim; d++)
+                centered[d] = (float)((float)row[d] - mean[d]);
+            uint64_t signature = 0;
+            for (uint32_t b = 0; b < num_bits; b++)
+            {
+                const float *plane = planes.data() + (size_t)b * dim;
+                float dot = 0;
+                for (size_t d = 0; d < dim; d++)
+                    dot += plane[d] * centered[d];
+                if (dot > 0)
+                    signature |= (uint64_t)1 << b;
+            }
+            buckets[i] = std::make_pair(signature, (uint32_t)i);
+        }
+    }
+    std::sort(buckets.begin(), buckets.end());
+
+    // the members of a bucket join the first earlier member within radius,
+    // or otherwise stand for themselves; exact duplicates always share a
+    // bucket, near-duplicates split by a hyperplane are kept apart
+    const float radius_sq = radius * radius;
+    std::vector<uint32_t> canonical(npts);
+    for (size_t i = 0; i < npts; i++)
+        canonical[i] = (uint32_t)i;
+    std::ifstream reader(base_file, std::ios::binary);
+    std::vector<uint32_t> bucket_canonicals;
+    std::vector<T> canonical_rows, member(dim);
+    for (size_t start = 0, end = 0; start < npts; start = end)
+    {
+        end = start + 1;
+        while (end < npts && buckets[end].first == buckets[start].first)
+            end++;
+        if (end - start == 1)
+            continue;
+
+        bucket_canonicals.clear();
+        canonical_rows.clear();
+        for (size_t j = start; j < end; j++)
+        {
+            const uint32_t id = buckets[j].second;
+            reader.seekg(2 * sizeof(uint32_t) + id * row_size, reader.beg);
+            reader.read((char *)member.data(), row_size);
+            for (size_t c = 0; c < bucket_canonicals.size(); c++)
+            {
+                const T *other = canonical_rows.data() + c * dim;
+                bool within;
+                if (radius == 0)
+                {
+                    within = std::memcmp(other, member.data(), row_size) == 0;
+                }
+                else
+                {
+                    float dist = 0;
+                    for (size_t d = 0; d < dim; d++)
+                    {
+                        const float diff = (float)other[d] - (float)member[d];
+                        dist += diff * diff;
+                    }
+                    within = dist <= radius_sq;
+                }
+                if (within)
+                {
+                    canonical[id] = bucket_canonicals[c];
+                    break;
+                }
+            }
+            if (canonical[id] == id)
+            {
+                bucket_canonicals.push_back(id);
+                canonical_rows.insert(canonical_rows.end(), member.begin(), member.end());
+            }
+        }
+    }
+    reader.close();
+
+    // the points that stand for themselves become the nodes in their order;
+    // a canonical point precedes the points it stands for
+    std::vector<uint32_t> point_nodes(npts);
+    uint32_t num_nodes = 0;
+    for (size_t i = 0; i < npts; i++)
+        point_nodes[i] = canonical[i] == i ? num_nodes++ : point_nodes[canonical[i]];
+
+    {
+        cached_ifstream base_reader(base_file, 64 * 1024 * 1024);
+        base_reader.read((char *)&npts_u32, sizeof(uint32_t));
+        base_reader.read((char *)&ndims_u32, sizeof(uint32_t));
+        cached_ofstream writer(out_file, 64 * 1024 * 1024);
+        writer.write((char *)&num_nodes, sizeof(uint32_t));
+        writer.write((char *)&ndims_u32, sizeof(uint32_t));
+        for (size_t i = 0; i < npts; i++)
+        {
+            base_reader.read((char *)row.data(), row_size);
+            if (canonical[i] == i)
+                writer.write((char *)row.data(), row_size);
+        }
+    }
+    diskann::save_bin<uint32_t>(duplicates_file, point_nodes.data(), npts, 1);
+
+    diskann::cout << "Collapsed " << npts << " points into " << num_nodes << " nodes" << std::endl;
+    return num_nodes;
+}
+
+// Reads data_file once and keeps each row with probability p_val, converted
+// to float; sample_ids receives the row ids of the kept rows.
+template <typename T>
+static void sample_rows_with_ids(const std::string &data_file, const double p_val, std::vector<uint32_t> &sample_ids,
+                                 std::vector<float> &sample_data)
+{
+    size_t num_points, dim;
+    diskann::get_bin_metadata(data_file, num_points, dim);
+
+    cached_ifstream base_reader(data_file, 64 * 1024 * 1024);
+    uint32_t npts32, ndims32;
+    base_reader.read((char *)&npts32, sizeof(uint32_t));
+    base_reader.read((char *)&ndims32, sizeof(uint32_t));
+
+    std::unique_ptr<T[]> cur_vector = std::make_unique<T[]>(dim);
+    std::random_device rd;
+    std::mt19937 generator(rd());
+    std::uniform_real_distribution<double> distribution(0, 1);
+    for (size_t i = 0; i < num_points; i++)
+    {
+        base_reader.read((char *)cur_vector.get(), dim * sizeof(T));
+        if (distribution(generator) < p_val)
+        {
+            sample_ids.push_back((uint32_t)i);
+            for (size_t d = 0; d < dim; d++)
+                sample_data.push_back((float)cur_vector[d]);
+        }
+    }
+}
+
+template <typename T>
+void build_disk_entry_layer(const std::string &data_file, const std::string &entry_layer_path, const double sample_rate,
+                            const uint32_t num_threads)
+{
+    size_t num_points, dim;
+    diskann::get_bin_metadata(data_file, num_points, dim);
+
+    size_t num_samples = (size_t)std::ceil(num_points * sample_rate);
+    num_samples = (std::max)(num_samples, (size_t)defaults::ENTRY_LAYER_MIN_POINTS);
+    if (2 * num_samples > num_points)
+    {
+        diskann::cout << "Index has too few points for an entry layer, not building one." << std::endl;
+        return;
+    }
+
+    std::vector<uint32_t> sample_ids;
+    std::vector<float> sample_data;
+    sample_rows_with_ids<T>(data_file, (double)num_samples / num_points, sample_ids, sample_data);
+    if (sample_ids.empty())
+        return;
+
+    // the data on disk is already transformed so that L2 ranks it for every metric
+    auto write_params = std::make_shared<IndexWriteParameters>(
+        IndexWriteParametersBuilder(defaults::BUILD_LIST_SIZE, defaults::MAX_DEGREE)
+            .with_alpha(defaults::ALPHA)
+            .with_num_threads(num_threads)
+            .build());
+    diskann::Index<float, uint32_t, uint32_t> entry_layer(diskann::Metric::L2, dim, sample_ids.size(), write_params,
+                                                          nullptr);
+    entry_layer.build(sample_data.data(), sample_ids.size(), std::vector<uint32_t>());
+    entry_layer.save(entry_layer_path.c_str());
+    diskann::save_bin<uint32_t>(entry_layer_path + "_ids.bin", sample_ids.data(), sample_ids.size(), 1);
+    diskann::cout << "Built entry layer over " << sample_ids.size() << " of " << num_points << " points" << std::endl;
+}
+
+template <typename T>
+void build_disk_entry_centroids(const std::string &data_file, const std::string &medoids_path,
+                                const std::string &centroids_path, const uint32_t num_centroids)
+{
+    size_t num_points, dim;
+    diskann::get_bin_metadata(data_file, num_points, dim);
+
+    const size_t num_samples =
+        (std::min)(num_points, (size_t)num_centroids * defaults::ENTRY_CENTROIDS_SAMPLES_PER_CENTROID);
+    if (num_samples < 2 * (size_t)num_centroids)
+    {
+        diskann::cout << "Index has too few points for " << num_centroids << " entry centroids, keeping the medoids."
+                      << std::endl;
+        return;
+    }
+
+    std::vector<uint32_t> sample_ids;
+    std::vector<float> sample_data;
+    sample_rows_with_ids<T>(data_file, (double)num_samples / num_points, sample_ids, sample_data);
+    const size_t num_sampled = sample_ids.size();
+    if (num_sampled < 2 * (size_t)num_centroids)
+        return;
+
+    // the data on disk is already transformed so that L2 ranks it for every metric
+    std::vector<float> centers((size_t)num_centroids * dim);
+    std::vector<size_t> *closest_docs = new std::vector<size_t>[num_centroids];
+    uint32_t *closest_center = new uint32_t[num_sampled];
+    kmeans::kmeanspp_selecting_pivots(sample_data.data(), num_sampled, dim, centers.data(), num_centroids);
+    kmeans::run_lloyds(sample_data.data(), num_sampled, dim, centers.data(), num_centroids,
+                       defaults::ENTRY_CENTROIDS_KMEANS_REPS, closest_docs, closest_center);
+
+    // the medoid of a cluster is its sampled point closest to the center;
+    // empty clusters are dropped
+    std::vector<uint32_t> medoids;
+    std::vector<float> centroids;
+    medoids.reserve(num_centroids);
+    centroids.reserve((size_t)num_centroids * dim);
+    for (uint32_t c = 0; c < num_centroids; c++)
+    {
+        if (closest_docs[c].empty())
+            continue;
+        float *center = centers.data() + (size_t)c * dim;
+        size_t best_doc = closest_docs[c][0];
+        float best_dist = (std::numeric_limits<float>::max)();
+        for (const size_t doc : closest_docs[c])
+        {
+            const float dist = math_utils::calc_distance(sample_data.data() + doc * dim, center, dim);
+            if (dist < best_dist)
+            {
+                best_dist = dist;
+                best_doc = doc;
+            }
+        }
+        medoids.push_back(sample_ids[best_doc]);
+        centroids.insert(centroids.end(), center, center + dim);
+    }
+    delete[] closest_docs;
+    delete[] closest_center;
+
+    diskann::save_bin<uint32_t>(medoids_path, medoids.data(), medoids.size(), 1);
+    diskann::save_bin<float>(centroids_path, centroids.data(), medoids.size(), dim);
+    diskann::cout << "Chose " << medoids.size() << " entry points from k-means over " << num_sampled << " points"
+                  << std::endl;
+}
+
+template <typename T, typename LabelT>
+int build_disk_index(const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+                     diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+                     const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+                     const uint32_t Lf, const bool reorder_layout, const bool fast_scan_pq,
+                     const float entry_layer_sample_rate, const uint32_t num_entry_centroids,
+                     const bool minibatch_kmeans, const bool resume, const std::string &only_shards)
+{
+    std::stringstream parser;
+    parser << std::string(indexBuildParameters);
+    std::string cur_param;
+    std::vector<std::string> param_list;
+    while (parser >> cur_param)
+    {
+        param_list.push_back(cur_param);
+    }
+    if (param_list.size() < 5 || param_list.size() > 18)
+    {
+        diskann::cout << "Correct usage of parameters is R (max degree)\n"
+                         "L (indexing list size, better if >= R)\n"
+                         "B (RAM limit of final index in GB)\n"
+                         "M (memory limit while indexing)\n"
+                         "T (number of threads for indexing)\n"
+                         "B' (PQ bytes for disk index: optional parameter for "
+                         "very large dimensional data)\n"
+                         "reorder (set true to include full precision in data file"
+                         ": optional paramter, use only when using disk PQ; 2 keeps "
+                         "them in a file of their own)\n"
+                         "build_PQ_byte (number of PQ bytes for inde build; set 0 to use "
+                         "full precision vectors)\n"
+                         "QD Quantized Dimension to overwrite the derived dim from B\n"
+                         "inline_pq_codes (set 1 to store the PQ codes of the neighbors "
+                         "of each node in the node: optional parameter)\n"
+                         "sector_len (bytes of the sectors of the disk layout, 512, 1024, "
+                         "2048 or 4096; 0 for the default 4096: optional parameter)\n"
+                         "pack_nbr_ids (set 1 to bit-pack the neighbor ids of the nodes: "
+                         "optional parameter)\n"
+                         "pq_centers (centroids per PQ chunk, a power of two from 256 to "
+                         "65536; above 256 the codes take 2 bytes; 0 for the default 256: "
+                         "optional parameter)\n"
+                         "native_mips (set 1 to build an inner product index on the vectors "
+                         "as they are, without the extra dimension: optional parameter)\n"
+                         "partition_balance (keep the shards of a build split to fit M within "
+                         "this fraction of their average size, e.g. 0.1; 0 does not balance "
+                         "them: optional parameter)\n"
+                         "dedup_radius (collapse points within this L2 distance of another "
+                         "into one node; 0 collapses exact duplicates only, negative does not "
+                         "collapse: optional parameter)\n"
+                         "gpu_build (set 1 to build the graphs on the GPU in builds with "
+                         "CUDA: optional parameter)\n"
+                         "label_layout (set 1 to group the nodes by label when reordering the "
+                         "layout, with filters: optional parameter)"
+                      << std::endl;
+        return -1;
+    }
+
+    if (!std::is_same<T, float>::value &&
+        (compareMetric == diskann::Metric::INNER_PRODUCT || compareMetric == diskann::Metric::COSINE))
     {
         std::stringstream stream;
         stream << "Disk-index build currently only supports floating point data for Max "
@@ -1154,13 +2493,19 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
             use_disk_pq = false;
     }
 
-    bool reorder_data = false;
+    bool reorder_data = false, separate_reorder_data = false;
     if (param_list.size() >= 7)
     {
         if (1 == atoi(param_list[6].c_str()))
         {
             reorder_data = true;
         }
+        else if (2 == atoi(param_list[6].c_str()))
+        {
+            // the full precision vectors go to a file of their own
+            reorder_data = true;
+            separate_reorder_data = true;
+        }
     }
 
     if (param_list.size() >= 8)
@@ -1168,6 +2513,137 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
         build_pq_bytes = atoi(param_list[7].c_str());
     }
 
+    bool inline_pq_codes = false;
+    if (param_list.size() >= 10)
+    {
+        inline_pq_codes = 1 == atoi(param_list[9].c_str());
+    }
+
+    // sectors shorter than the default waste less of each read on small nodes
+    uint64_t sector_len = defaults::SECTOR_LEN;
+    if (param_list.size() >= 11 && atoi(param_list[10].c_str()) > 0)
+    {
+        sector_len = (uint64_t)atoi(param_list[10].c_str());
+        if (!is_valid_sector_len(sector_len))
+        {
+            diskann::cerr << "sector_len must be 512, 1024, 2048 or 4096" << std::endl;
+            return -1;
+        }
+    }
+
+    // ids of log2(npts) bits fit more neighbors in the same node length
+    bool pack_nbr_ids = false;
+    if (param_list.size() >= 12)
+    {
+        pack_nbr_ids = 1 == atoi(param_list[11].c_str());
+    }
+
+    // more centroids per chunk cut the quantization error at the cost of
+    // uint16 codes and larger distance tables
+    uint32_t pq_centers = NUM_PQ_CENTROIDS;
+    if (param_list.size() >= 13 && atoi(param_list[12].c_str()) > 0)
+    {
+        pq_centers = (uint32_t)atoi(param_list[12].c_str());
+        if (pq_centers < NUM_PQ_CENTROIDS || pq_centers > MAX_NUM_PQ_CENTROIDS_WIDE ||
+            (pq_centers & (pq_centers - 1)) != 0)
+        {
+            diskann::cerr << "pq_centers must be a power of two from " << NUM_PQ_CENTROIDS << " to "
+                          << MAX_NUM_PQ_CENTROIDS_WIDE << std::endl;
+            return -1;
+        }
+        if (pq_centers > NUM_PQ_CENTROIDS && fast_scan_pq)
+        {
+            diskann::cerr << "pq_centers cannot be combined with 4-bit fast-scan PQ" << std::endl;
+            return -1;
+        }
+        if (pq_centers > NUM_PQ_CENTROIDS && inline_pq_codes)
+        {
+            diskann::cerr << "The neighbor PQ codes stored in the nodes are bytes; inline_pq_codes needs "
+                          << NUM_PQ_CENTROIDS << " pq_centers" << std::endl;
+            return -1;
+        }
+    }
+
+    // inner product indices are otherwise built for L2 on a copy of the base
+    // with an extra dimension, which costs a pass over the data and a
+    // dimension on every distance
+    bool native_mips = false;
+    if (param_list.size() >= 14)
+    {
+        native_mips = 1 == atoi(param_list[13].c_str());
+        if (native_mips && compareMetric != diskann::Metric::INNER_PRODUCT)
+        {
+            diskann::cerr << "native_mips needs the inner product metric" << std::endl;
+            return -1;
+        }
+        if (native_mips && (build_pq_bytes > 0 || entry_layer_sample_rate > 0))
+        {
+            diskann::cerr << "native_mips cannot be combined with build_PQ_bytes or an entry layer, which are L2 only"
+                          << std::endl;
+            return -1;
+        }
+    }
+
+    // shards of skewed data otherwise differ widely in size, and the largest
+    // take the longest to build
+    float partition_balance = 0;
+    if (param_list.size() >= 15)
+    {
+        partition_balance = (float)atof(param_list[14].c_str());
+        if (partition_balance < 0)
+        {
+            diskann::cerr << "partition_balance must not be negative" << std::endl;
+            return -1;
+        }
+    }
+
+    // duplicates take a node each and fill each other's neighbor lists
+    float dedup_radius = -1;
+    if (param_list.size() >= 16)
+    {
+        dedup_radius = (float)atof(param_list[15].c_str());
+        if (dedup_radius >= 0 && use_filters)
+        {
+            diskann::cerr << "dedup_radius cannot be combined with filters, as duplicates may have different labels"
+                          << std::endl;
+            return -1;
+        }
+    }
+    const bool dedup = dedup_radius >= 0;
+
+    // graphs of exact nearest neighbors pruned like Vamana's, see
+    // build_graph_on_gpu(); without a device the graphs are built as usual
+    const bool gpu_build = param_list.size() >= 17 && atoi(param_list[16].c_str()) == 1;
+
+    // nodes grouped by label, then in BFS order, for filtered searches to
+    // read sectors of nodes that pass their filter; see
+    // reorder_graph_for_locality()
+    const bool label_layout = param_list.size() >= 18 && atoi(param_list[17].c_str()) == 1;
+    if (label_layout && !use_filters)
+    {
+        diskann::cerr << "label_layout needs a label file" << std::endl;
+        return -1;
+    }
+    const bool reorder_nodes = reorder_layout || label_layout;
+
+    // Hamming indices hold bit-packed uint8 vectors, with binary PQ codes;
+    // the options below quantize or compare the vectors as reals
+    if (compareMetric == diskann::Metric::HAMMING)
+    {
+        if (!std::is_same<T, uint8_t>::value)
+        {
+            diskann::cerr << "The Hamming metric needs uint8 vectors of packed bits" << std::endl;
+            return -1;
+        }
+        if (use_disk_pq || build_pq_bytes > 0 || use_opq || gpu_build || entry_layer_sample_rate > 0 || dedup)
+        {
+            diskann::cerr << "The Hamming metric cannot be combined with PQ_disk_bytes, build_PQ_bytes, use_opq, "
+                             "gpu_build, an entry layer or dedup_radius"
+                          << std::endl;
+            return -1;
+        }
+    }
+
     std::string base_file(dataFilePath);
     std::string data_file_to_use = base_file;
     std::string labels_file_original = label_file;
@@ -1200,36 +2676,128 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
         index_prefix_path +
         "_prepped_base.bin"; // temp file for storing pre-processed base file for cosine/ mips metrics
     bool created_temp_file_for_processed_data = false;
+    std::string norm_file = disk_index_path + "_max_base_norm.bin";
+    std::string layout_ids_path = disk_index_path + "_layout_ids.bin";
+    std::string duplicates_path = disk_index_path + "_duplicates.bin";
+    std::string dedup_base = index_prefix_path + "_dedup_base.bin";
+    std::string reordered_base = index_prefix_path + "_reordered_base.bin";
+    bool created_reordered_base = false;
+    std::string entry_layer_path = disk_index_path + "_entry_layer.index";
+
+    // Every stage below records its outputs in the manifest once it is done.
+    // Runs that only build shards resume from it too, as they rely on the
+    // stages before the graph having been done by an earlier run.
+    std::stringstream build_key;
+    build_key << base_file << " " << (file_exists(base_file) ? get_file_size(base_file) : 0) << " "
+              << indexBuildParameters << " " << (int)compareMetric << " " << use_opq << " " << codebook_prefix << " "
+              << use_filters << " " << label_file << " " << universal_label << " " << filter_threshold << " " << Lf
+              << " " << reorder_layout << " " << fast_scan_pq << " " << entry_layer_sample_rate << " "
+              << num_entry_centroids << " " << minibatch_kmeans;
+    BuildManifest manifest(index_prefix_path + "_build_manifest.txt", build_key.str(), resume || !only_shards.empty());
+
+    std::vector<std::string> stages;
+    if (dedup)
+        stages.push_back("dedup");
+    if ((compareMetric == diskann::Metric::INNER_PRODUCT && !native_mips) || compareMetric == diskann::Metric::COSINE)
+        stages.push_back("preprocess");
+    if (use_filters)
+        stages.push_back("labels");
+    if (use_disk_pq)
+        stages.push_back("disk_pq");
+    stages.insert(stages.end(), {"pq", "graph"});
+    if (reorder_nodes)
+        stages.push_back("reorder");
+    stages.push_back("layout");
+    if (num_entry_centroids > 0)
+        stages.push_back("entry_centroids");
+    if (entry_layer_sample_rate > 0)
+        stages.push_back("entry_layer");
+
+    // the first stage left to do invalidates every stage after it
+    size_t first_to_run = 0;
+    while (first_to_run < stages.size() && manifest.is_done(stages[first_to_run]))
+        first_to_run++;
+    const size_t reorder_stage = std::find(stages.begin(), stages.end(), "reorder") - stages.begin();
+    const size_t graph_stage = std::find(stages.begin(), stages.end(), "graph") - stages.begin();
+    // reordering rewrites the outputs of the earlier stages in place, so if
+    // it was interrupted or one of those is gone the build starts over
+    if (manifest.in_progress("reorder") || (first_to_run < reorder_stage && manifest.is_done("reorder")))
+        first_to_run = 0;
+    if (first_to_run < graph_stage)
+    {
+        if (!only_shards.empty() && only_shards != "none")
+            throw ANNException("Shards can only be built once the stages before the graph are done. Run the build "
+                               "with the shard list none first.",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        manifest.invalidate({"partition"});
+    }
+    manifest.invalidate(std::vector<std::string>(stages.begin() + first_to_run, stages.end()));
+    const bool reordered = manifest.is_done("reorder");
+
+    // the later stages run on one representative of every set of duplicates
+    if (manifest.is_done("dedup"))
+    {
+        diskann::cout << "Skipping collapsing duplicates, which is done" << std::endl;
+        data_file_to_use = dedup_base;
+    }
+    else if (dedup)
+    {
+        BuildProfiler::Stage stage("dedup");
+        Timer timer;
+        diskann::collapse_duplicates<T>(base_file, dedup_base, duplicates_path, dedup_radius);
+        data_file_to_use = dedup_base;
+        diskann::cout << timer.elapsed_seconds_for_step("collapsing duplicates") << std::endl;
+        manifest.mark_done("dedup", {dedup_base, duplicates_path});
+    }
+    else if (file_exists(duplicates_path))
+    {
+        // stale map from an earlier build with the same prefix
+        std::remove(duplicates_path.c_str());
+    }
 
     // output a new base file which contains extra dimension with sqrt(1 -
     // ||x||^2/M^2) for every x, M is max norm of all points. Extra space on
     // disk needed!
-    if (compareMetric == diskann::Metric::INNER_PRODUCT)
+    if (manifest.is_done("preprocess"))
+    {
+        diskann::cout << "Skipping preprocessing, which is done" << std::endl;
+        data_file_to_use = prepped_base;
+        created_temp_file_for_processed_data = true;
+    }
+    else if (compareMetric == diskann::Metric::INNER_PRODUCT && native_mips)
     {
+        // search tells native indices apart by the missing max norm file
+        std::remove(norm_file.c_str());
+    }
+    else if (compareMetric == diskann::Metric::INNER_PRODUCT)
+    {
+        BuildProfiler::Stage stage("preprocess");
         Timer timer;
         std::cout << "Using Inner Product search, so need to pre-process base "
                      "data into temp file. Please ensure there is additional "
                      "(n*(d+1)*4) bytes for storing pre-processed base vectors, "
                      "apart from the interim indices created by DiskANN and the final index."
                   << std::endl;
+        float max_norm_of_base = diskann::prepare_base_for_inner_products<T>(data_file_to_use, prepped_base);
         data_file_to_use = prepped_base;
-        float max_norm_of_base = diskann::prepare_base_for_inner_products<T>(base_file, prepped_base);
-        std::string norm_file = disk_index_path + "_max_base_norm.bin";
         diskann::save_bin<float>(norm_file, &max_norm_of_base, 1, 1);
         diskann::cout << timer.elapsed_seconds_for_step("preprocessing data for inner product") << std::endl;
         created_temp_file_for_processed_data = true;
+        manifest.mark_done("preprocess", {prepped_base, norm_file});
     }
     else if (compareMetric == diskann::Metric::COSINE)
     {
+        BuildProfiler::Stage stage("preprocess");
         Timer timer;
         std::cout << "Normalizing data for cosine to temporary file, please ensure there is additional "
                      "(n*d*4) bytes for storing normalized base vectors, "
                      "apart from the interim indices created by DiskANN and the final index."
                   << std::endl;
+        diskann::normalize_data_file(data_file_to_use, prepped_base);
         data_file_to_use = prepped_base;
-        diskann::normalize_data_file(base_file, prepped_base);
         diskann::cout << timer.elapsed_seconds_for_step("preprocessing data for cosine") << std::endl;
         created_temp_file_for_processed_data = true;
+        manifest.mark_done("preprocess", {prepped_base});
     }
 
     uint32_t R = (uint32_t)atoi(param_list[0].c_str());
@@ -1268,20 +2836,33 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
     std::string augmented_data_file, augmented_labels_file;
     if (use_filters)
     {
-        convert_labels_string_to_int(labels_file_original, labels_file_to_use, disk_labels_int_map_file,
-                                     universal_label);
+        BuildProfiler::Stage stage("labels");
+        const bool labels_done = manifest.is_done("labels");
+        if (!labels_done)
+            convert_labels_string_to_int(labels_file_original, labels_file_to_use, disk_labels_int_map_file,
+                                         universal_label);
+        std::vector<std::string> label_files = {labels_file_to_use, disk_labels_int_map_file};
         augmented_data_file = index_prefix_path + "_augmented_data.bin";
         augmented_labels_file = index_prefix_path + "_augmented_labels.txt";
         if (filter_threshold != 0)
         {
             dummy_remap_file = index_prefix_path + "_dummy_remap.txt";
-            breakup_dense_points<T>(data_file_to_use, labels_file_to_use, filter_threshold, augmented_data_file,
-                                    augmented_labels_file,
-                                    dummy_remap_file); // RKNOTE: This has large memory footprint,
-                                                       // need to make this streaming
+            if (!labels_done)
+                breakup_dense_points<T>(data_file_to_use, labels_file_to_use, filter_threshold, augmented_data_file,
+                                        augmented_labels_file,
+                                        dummy_remap_file); // RKNOTE: This has large memory footprint,
+                                                           // need to make this streaming
             data_file_to_use = augmented_data_file;
             labels_file_to_use = augmented_labels_file;
+            label_files = {augmented_labels_file, disk_labels_int_map_file, augmented_data_file, dummy_remap_file};
         }
+        if (!labels_done)
+            manifest.mark_done("labels", label_files);
+    }
+    if (reordered)
+    {
+        data_file_to_use = reordered_base;
+        created_reordered_base = true;
     }
 
     size_t points_num, dim;
@@ -1290,12 +2871,18 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
     diskann::get_bin_metadata(data_file_to_use.c_str(), points_num, dim);
     const double p_val = ((double)MAX_PQ_TRAINING_SET_SIZE / (double)points_num);
 
-    if (use_disk_pq)
+    if (use_disk_pq && !manifest.is_done("disk_pq"))
     {
+        BuildProfiler::Stage stage("disk_pq");
         generate_disk_quantized_data<T>(data_file_to_use, disk_pq_pivots_path, disk_pq_compressed_vectors_path,
                                         compareMetric, p_val, disk_pq_dims);
+        manifest.mark_done("disk_pq", {disk_pq_pivots_path, disk_pq_compressed_vectors_path});
     }
     size_t num_pq_chunks = (size_t)(std::floor)(uint64_t(final_index_ram_limit / points_num));
+    // 4-bit codes fit two chunks into every byte of the budget
+    if (fast_scan_pq)
+        num_pq_chunks *= 2;
+    num_pq_chunks /= get_pq_code_size(pq_centers);
 
     num_pq_chunks = num_pq_chunks <= 0 ? 1 : num_pq_chunks;
     num_pq_chunks = num_pq_chunks > dim ? dim : num_pq_chunks;
@@ -1309,40 +2896,225 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
         num_pq_chunks = atoi(param_list[8].c_str());
     }
 
-    diskann::cout << "Compressing " << dim << "-dimensional data into " << num_pq_chunks << " bytes per vector."
-                  << std::endl;
+    if (fast_scan_pq)
+        diskann::cout << "Compressing " << dim << "-dimensional data into " << num_pq_chunks
+                      << " 4-bit codes per vector." << std::endl;
+    else if (pq_centers > NUM_PQ_CENTROIDS)
+        diskann::cout << "Compressing " << dim << "-dimensional data into " << num_pq_chunks << " codes of "
+                      << pq_centers << " centroids per vector." << std::endl;
+    else
+        diskann::cout << "Compressing " << dim << "-dimensional data into " << num_pq_chunks << " bytes per vector."
+                      << std::endl;
 
-    generate_quantized_data<T>(data_file_to_use, pq_pivots_path, pq_compressed_vectors_path, compareMetric, p_val,
-                               num_pq_chunks, use_opq, codebook_prefix);
-    diskann::cout << timer.elapsed_seconds_for_step("generating quantized data") << std::endl;
+    if (!manifest.is_done("pq"))
+    {
+        BuildProfiler::Stage stage("pq");
+        generate_quantized_data<T>(data_file_to_use, pq_pivots_path, pq_compressed_vectors_path, compareMetric, p_val,
+                                   num_pq_chunks, use_opq, codebook_prefix,
+                                   fast_scan_pq ? NUM_PQ_CENTROIDS_FAST_SCAN : pq_centers);
+        diskann::cout << timer.elapsed_seconds_for_step("generating quantized data") << std::endl;
+        manifest.mark_done("pq", {pq_pivots_path, pq_compressed_vectors_path});
+    }
 
 // Gopal. Splitting diskann_dll into separate DLLs for search and build.
 // This code should only be available in the "build" DLL.
 #if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
     MallocExtension::instance()->ReleaseFreeMemory();
 #endif
-    // Whether it is cosine or inner product, we still L2 metric due to the pre-processing.
-    timer.reset();
-    diskann::build_merged_vamana_index<T, LabelT>(data_file_to_use.c_str(), diskann::Metric::L2, L, R, p_val,
-                                                  indexing_ram_budget, mem_index_path, medoids_path, centroids_path,
-                                                  build_pq_bytes, use_opq, num_threads, use_filters, labels_file_to_use,
-                                                  labels_to_medoids_path, universal_label, Lf);
-    diskann::cout << timer.elapsed_seconds_for_step("building merged vamana index") << std::endl;
+    // Unless the graph is renumbered for locality first, a graph merged from
+    // shards is laid out on disk as it is merged instead of being saved as an
+    // in-memory index and read back by create_disk_layout
+    std::unique_ptr<DiskLayoutWriter> disk_layout;
+    std::vector<std::string> layout_files = {disk_index_path};
+    if (separate_reorder_data)
+        layout_files.push_back(get_disk_index_vectors_file(disk_index_path));
+    const std::string nbr_codes_file = inline_pq_codes ? pq_compressed_vectors_path : std::string("");
+    const bool build_graph = !manifest.is_done("graph");
+    if (build_graph && !reorder_nodes)
+    {
+        if (!use_disk_pq)
+            disk_layout = std::make_unique<DiskLayoutWriter>(data_file_to_use, sizeof(T), disk_index_path, R, "",
+                                                             false, nbr_codes_file, sector_len, pack_nbr_ids);
+        else
+            disk_layout = std::make_unique<DiskLayoutWriter>(disk_pq_compressed_vectors_path, sizeof(uint8_t),
+                                                             disk_index_path, R,
+                                                             reorder_data ? data_file_to_use : std::string(""),
+                                                             separate_reorder_data, nbr_codes_file, sector_len,
+                                                             pack_nbr_ids);
+    }
+
+    // Whether it is cosine or inner product, we still L2 metric due to the pre-processing, unless the inner product
+    // index is native, whose graph is pruned by inner product.
+    if (build_graph)
+    {
+        BuildProfiler::Stage stage("graph");
+        timer.reset();
+        diskann::Metric graph_metric = diskann::Metric::L2;
+        if (native_mips)
+            graph_metric = diskann::Metric::INNER_PRODUCT;
+        else if (compareMetric == diskann::Metric::HAMMING)
+            graph_metric = diskann::Metric::HAMMING;
+        diskann::build_merged_vamana_index<T, LabelT>(
+            data_file_to_use.c_str(), graph_metric, L, R, p_val, indexing_ram_budget, mem_index_path, medoids_path,
+            centroids_path, build_pq_bytes, use_opq, num_threads, use_filters, labels_file_to_use,
+            labels_to_medoids_path, universal_label, Lf, minibatch_kmeans, disk_layout.get(), &manifest, only_shards,
+            partition_balance, gpu_build);
+        diskann::cout << timer.elapsed_seconds_for_step("building merged vamana index") << std::endl;
+        if (!only_shards.empty())
+        {
+            diskann::cout << "Built shards " << only_shards
+                          << ". Once all are built, run the build again with resume and no shard list to merge them."
+                          << std::endl;
+            return 0;
+        }
+
+        std::vector<std::string> graph_files;
+        for (const std::string &file : {mem_index_path, medoids_path, centroids_path, labels_to_medoids_path,
+                                        mem_labels_file, mem_univ_label_file})
+        {
+            if (file_exists(file))
+                graph_files.push_back(file);
+        }
+        // a graph laid out while merging exists only as the disk index
+        if (disk_layout != nullptr && disk_layout->finished())
+            graph_files.insert(graph_files.end(), layout_files.begin(), layout_files.end());
+        manifest.mark_done("graph", graph_files);
+        if (disk_layout != nullptr && disk_layout->finished())
+            manifest.mark_done("layout", layout_files);
+    }
+    else if (!only_shards.empty())
+    {
+        diskann::cout << "The graph is already built, so there are no shards left to build" << std::endl;
+        return 0;
+    }
+
+    if (reorder_nodes && !reordered)
+    {
+        // renumber the nodes in BFS order, by label first with label_layout,
+        // so that graph neighbors land in the same sectors, and bring every
+        // per-point artifact into that order
+        BuildProfiler::Stage stage("reorder");
+        manifest.begin("reorder");
+        std::vector<uint32_t> new_to_old;
+        diskann::reorder_graph_for_locality(mem_index_path, new_to_old,
+                                            label_layout ? labels_file_to_use : std::string(""));
+        std::vector<uint32_t> old_to_new(new_to_old.size());
+        for (size_t i = 0; i < new_to_old.size(); i++)
+            old_to_new[new_to_old[i]] = (uint32_t)i;
+
+        diskann::permute_bin_rows<T>(data_file_to_use, reordered_base, new_to_old);
+        if (created_temp_file_for_processed_data)
+            std::remove(prepped_base.c_str());
+        data_file_to_use = reordered_base;
+        created_reordered_base = true;
+
+        std::string tmp_file = index_prefix_path + "_reorder_tmp.bin";
+        if (pq_centers > NUM_PQ_CENTROIDS)
+            diskann::permute_bin_rows<uint16_t>(pq_compressed_vectors_path, tmp_file, new_to_old);
+        else
+            diskann::permute_bin_rows<uint8_t>(pq_compressed_vectors_path, tmp_file, new_to_old);
+        std::remove(pq_compressed_vectors_path.c_str());
+        std::rename(tmp_file.c_str(), pq_compressed_vectors_path.c_str());
+        if (use_disk_pq)
+        {
+            diskann::permute_bin_rows<uint8_t>(disk_pq_compressed_vectors_path, tmp_file, new_to_old);
+            std::remove(disk_pq_compressed_vectors_path.c_str());
+            std::rename(tmp_file.c_str(), disk_pq_compressed_vectors_path.c_str());
+        }
+
+        if (file_exists(medoids_path))
+        {
+            std::unique_ptr<uint32_t[]> medoids;
+            size_t num_medoids, medoid_dim;
+            diskann::load_bin<uint32_t>(medoids_path, medoids, num_medoids, medoid_dim);
+            for (size_t i = 0; i < num_medoids; i++)
+                medoids[i] = old_to_new[medoids[i]];
+            diskann::save_bin<uint32_t>(medoids_path, medoids.get(), num_medoids, medoid_dim);
+        }
+        if (use_filters)
+        {
+            std::string tmp_labels = index_prefix_path + "_reorder_tmp_labels.txt";
+            permute_text_lines(labels_file_to_use, tmp_labels, new_to_old);
+            std::remove(labels_file_to_use.c_str());
+            std::rename(tmp_labels.c_str(), labels_file_to_use.c_str());
+            if (file_exists(labels_to_medoids_path))
+                remap_ids_in_text_file(labels_to_medoids_path, old_to_new, false);
+            if (file_exists(dummy_remap_file))
+                remap_ids_in_text_file(dummy_remap_file, old_to_new, true);
+        }
+        diskann::save_bin<uint32_t>(layout_ids_path, new_to_old.data(), new_to_old.size(), 1);
+
+        // the outputs of the earlier stages were rewritten, and the
+        // preprocessed data is superseded by the reordered copy
+        manifest.mark_done("reorder", {layout_ids_path, reordered_base});
+        manifest.refresh({"labels", "disk_pq", "pq", "graph"});
+        if (created_temp_file_for_processed_data)
+            manifest.mark_done("preprocess");
+    }
+    else if (reorder_nodes)
+    {
+        diskann::cout << "Skipping reordering the graph, which is done" << std::endl;
+    }
+    else if (file_exists(layout_ids_path))
+    {
+        // stale map from an earlier build with the same prefix
+        std::remove(layout_ids_path.c_str());
+    }
 
     timer.reset();
-    if (!use_disk_pq)
+    if (disk_layout != nullptr && disk_layout->finished())
+    {
+        diskann::cout << "Disk layout was written while merging the shards" << std::endl;
+    }
+    else if (manifest.is_done("layout"))
+    {
+        diskann::cout << "Skipping the disk layout, which is done" << std::endl;
+    }
+    else if (!use_disk_pq)
     {
-        diskann::create_disk_layout<T>(data_file_to_use.c_str(), mem_index_path, disk_index_path);
+        BuildProfiler::Stage stage("layout");
+        diskann::create_disk_layout<T>(data_file_to_use.c_str(), mem_index_path, disk_index_path, "", false,
+                                       nbr_codes_file, sector_len, pack_nbr_ids);
     }
     else
     {
-        if (!reorder_data)
-            diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path);
-        else
-            diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path,
-                                                 data_file_to_use.c_str());
+        BuildProfiler::Stage stage("layout");
+        diskann::create_disk_layout<uint8_t>(disk_pq_compressed_vectors_path, mem_index_path, disk_index_path,
+                                             reorder_data ? data_file_to_use : std::string(""),
+                                             separate_reorder_data, nbr_codes_file, sector_len, pack_nbr_ids);
     }
     diskann::cout << timer.elapsed_seconds_for_step("generating disk layout") << std::endl;
+    if (!manifest.is_done("layout"))
+        manifest.mark_done("layout", layout_files);
+
+    // data_file_to_use is in disk node order here, so the sampled row ids are node ids
+    if (num_entry_centroids > 0 && !manifest.is_done("entry_centroids"))
+    {
+        BuildProfiler::Stage stage("entry_centroids");
+        timer.reset();
+        build_disk_entry_centroids<T>(data_file_to_use, medoids_path, centroids_path, num_entry_centroids);
+        diskann::cout << timer.elapsed_seconds_for_step("choosing entry centroids") << std::endl;
+        manifest.mark_done("entry_centroids", {medoids_path, centroids_path});
+        manifest.refresh({"graph"});
+    }
+    if (entry_layer_sample_rate > 0)
+    {
+        if (!manifest.is_done("entry_layer"))
+        {
+            BuildProfiler::Stage stage("entry_layer");
+            timer.reset();
+            build_disk_entry_layer<T>(data_file_to_use, entry_layer_path, entry_layer_sample_rate, num_threads);
+            diskann::cout << timer.elapsed_seconds_for_step("building entry layer") << std::endl;
+            manifest.mark_done("entry_layer", {entry_layer_path, entry_layer_path + "_ids.bin"});
+        }
+    }
+    else if (file_exists(entry_layer_path))
+    {
+        // stale layer from an earlier build with the same prefix
+        std::remove(entry_layer_path.c_str());
+        std::remove((entry_layer_path + ".data").c_str());
+        std::remove((entry_layer_path + "_ids.bin").c_str());
+    }
 
     double ten_percent_points = std::ceil(points_num * 0.1);
     double num_sample_points =
@@ -1364,9 +3136,14 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
     }
     if (created_temp_file_for_processed_data)
         std::remove(prepped_base.c_str());
+    if (created_reordered_base)
+        std::remove(reordered_base.c_str());
+    if (dedup)
+        std::remove(dedup_base.c_str());
     std::remove(mem_index_path.c_str());
     if (use_disk_pq)
         std::remove(disk_pq_compressed_vectors_path.c_str());
+    manifest.remove();
 
     auto e = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diff = e - s;
@@ -1375,20 +3152,113 @@ int build_disk_index(const char *dataFilePath, const char *indexFilePath, const
     return 0;
 }
 
+template <typename T, typename LabelT>
+int build_disk_index_from_memory(const T *data, size_t num_points, size_t dim, const char *indexFilePath,
+                                 const char *indexBuildParameters, diskann::Metric compareMetric, bool use_opq,
+                                 const std::string &codebook_prefix, bool use_filters, const std::string &label_file,
+                                 const std::string &universal_label, const uint32_t filter_threshold, const uint32_t Lf)
+{
+    MemoryBinFile base(std::string(indexFilePath) + "_memory_base.bin", data, num_points, dim, sizeof(T));
+    diskann::cout << "Building on " << num_points << " vectors of " << dim << " dimensions in memory" << std::endl;
+    return build_disk_index<T, LabelT>(base.path().c_str(), indexFilePath, indexBuildParameters, compareMetric,
+                                       use_opq, codebook_prefix, use_filters, label_file, universal_label,
+                                       filter_threshold, Lf);
+}
+
+template DISKANN_DLLEXPORT void permute_bin_rows<int8_t>(const std::string &in_file, const std::string &out_file,
+                                                         const std::vector<uint32_t> &new_to_old);
+template DISKANN_DLLEXPORT void permute_bin_rows<float16>(const std::string &in_file, const std::string &out_file,
+                                                          const std::vector<uint32_t> &new_to_old);
+template DISKANN_DLLEXPORT void permute_bin_rows<bfloat16>(const std::string &in_file, const std::string &out_file,
+                                                           const std::vector<uint32_t> &new_to_old);
+template DISKANN_DLLEXPORT void permute_bin_rows<uint8_t>(const std::string &in_file, const std::string &out_file,
+                                                          const std::vector<uint32_t> &new_to_old);
+template DISKANN_DLLEXPORT void permute_bin_rows<float>(const std::string &in_file, const std::string &out_file,
+                                                        const std::vector<uint32_t> &new_to_old);
+
+template DISKANN_DLLEXPORT uint64_t repair_graph_connectivity<int8_t>(
+    const std::string &mem_index_file, const std::string &data_file, const std::string &medoids_file,
+    const uint32_t min_in_degree, const uint32_t max_hops, uint32_t max_degree, const uint32_t L, const bool repair);
+template DISKANN_DLLEXPORT uint64_t repair_graph_connectivity<uint8_t>(
+    const std::string &mem_index_file, const std::string &data_file, const std::string &medoids_file,
+    const uint32_t min_in_degree, const uint32_t max_hops, uint32_t max_degree, const uint32_t L, const bool repair);
+template DISKANN_DLLEXPORT uint64_t repair_graph_connectivity<float>(
+    const std::string &mem_index_file, const std::string &data_file, const std::string &medoids_file,
+    const uint32_t min_in_degree, const uint32_t max_hops, uint32_t max_degree, const uint32_t L, const bool repair);
+template DISKANN_DLLEXPORT uint64_t repair_graph_connectivity<float16>(
+    const std::string &mem_index_file, const std::string &data_file, const std::string &medoids_file,
+    const uint32_t min_in_degree, const uint32_t max_hops, uint32_t max_degree, const uint32_t L, const bool repair);
+template DISKANN_DLLEXPORT uint64_t repair_graph_connectivity<bfloat16>(
+    const std::string &mem_index_file, const std::string &data_file, const std::string &medoids_file,
+    const uint32_t min_in_degree, const uint32_t max_hops, uint32_t max_degree, const uint32_t L, const bool repair);
+
+template DISKANN_DLLEXPORT size_t collapse_duplicates<int8_t>(const std::string &base_file,
+                                                              const std::string &out_file,
+                                                              const std::string &duplicates_file,
+                                                              const float radius);
+template DISKANN_DLLEXPORT size_t collapse_duplicates<float16>(const std::string &base_file,
+                                                               const std::string &out_file,
+                                                               const std::string &duplicates_file,
+                                                               const float radius);
+template DISKANN_DLLEXPORT size_t collapse_duplicates<bfloat16>(const std::string &base_file,
+                                                                const std::string &out_file,
+                                                                const std::string &duplicates_file,
+                                                                const float radius);
+template DISKANN_DLLEXPORT size_t collapse_duplicates<uint8_t>(const std::string &base_file,
+                                                               const std::string &out_file,
+                                                               const std::string &duplicates_file,
+                                                               const float radius);
+template DISKANN_DLLEXPORT size_t collapse_duplicates<float>(const std::string &base_file,
+                                                             const std::string &out_file,
+                                                             const std::string &duplicates_file,
+                                                             const float radius);
+
 template DISKANN_DLLEXPORT void create_disk_layout<int8_t>(const std::string base_file,
                                                            const std::string mem_index_file,
                                                            const std::string output_file,
-                                                           const std::string reorder_data_file);
+                                                           const std::string reorder_data_file,
+                                                           const bool separate_reorder_data,
+                                                           const std::string nbr_codes_file,
+                                                           const uint64_t sector_len,
+                                                           const bool pack_nbr_ids);
+template DISKANN_DLLEXPORT void create_disk_layout<float16>(const std::string base_file,
+                                                            const std::string mem_index_file,
+                                                            const std::string output_file,
+                                                            const std::string reorder_data_file,
+                                                            const bool separate_reorder_data,
+                                                            const std::string nbr_codes_file,
+                                                            const uint64_t sector_len,
+                                                            const bool pack_nbr_ids);
+template DISKANN_DLLEXPORT void create_disk_layout<bfloat16>(const std::string base_file,
+                                                             const std::string mem_index_file,
+                                                             const std::string output_file,
+                                                             const std::string reorder_data_file,
+                                                             const bool separate_reorder_data,
+                                                             const std::string nbr_codes_file,
+                                                             const uint64_t sector_len,
+                                                             const bool pack_nbr_ids);
 template DISKANN_DLLEXPORT void create_disk_layout<uint8_t>(const std::string base_file,
                                                             const std::string mem_index_file,
                                                             const std::string output_file,
-                                                            const std::string reorder_data_file);
+                                                            const std::string reorder_data_file,
+                                                            const bool separate_reorder_data,
+                                                            const std::string nbr_codes_file,
+                                                            const uint64_t sector_len,
+                                                            const bool pack_nbr_ids);
 template DISKANN_DLLEXPORT void create_disk_layout<float>(const std::string base_file, const std::string mem_index_file,
                                                           const std::string output_file,
-                                                          const std::string reorder_data_file);
+                                                          const std::string reorder_data_file,
+                                                          const bool separate_reorder_data,
+                                                          const std::string nbr_codes_file,
+                                                          const uint64_t sector_len,
+                                                          const bool pack_nbr_ids);
 
 template DISKANN_DLLEXPORT int8_t *load_warmup<int8_t>(const std::string &cache_warmup_file, uint64_t &warmup_num,
                                                        uint64_t warmup_dim, uint64_t warmup_aligned_dim);
+template DISKANN_DLLEXPORT float16 *load_warmup<float16>(const std::string &cache_warmup_file, uint64_t &warmup_num,
+                                                         uint64_t warmup_dim, uint64_t warmup_aligned_dim);
+template DISKANN_DLLEXPORT bfloat16 *load_warmup<bfloat16>(const std::string &cache_warmup_file, uint64_t &warmup_num,
+                                                           uint64_t warmup_dim, uint64_t warmup_aligned_dim);
 template DISKANN_DLLEXPORT uint8_t *load_warmup<uint8_t>(const std::string &cache_warmup_file, uint64_t &warmup_num,
                                                          uint64_t warmup_dim, uint64_t warmup_aligned_dim);
 template DISKANN_DLLEXPORT float *load_warmup<float>(const std::string &cache_warmup_file, uint64_t &warmup_num,
@@ -1398,6 +3268,12 @@ template DISKANN_DLLEXPORT float *load_warmup<float>(const std::string &cache_wa
 template DISKANN_DLLEXPORT int8_t *load_warmup<int8_t>(MemoryMappedFiles &files, const std::string &cache_warmup_file,
                                                        uint64_t &warmup_num, uint64_t warmup_dim,
                                                        uint64_t warmup_aligned_dim);
+template DISKANN_DLLEXPORT float16 *load_warmup<float16>(MemoryMappedFiles &files, const std::string &cache_warmup_file,
+                                                         uint64_t &warmup_num, uint64_t warmup_dim,
+                                                         uint64_t warmup_aligned_dim);
+template DISKANN_DLLEXPORT bfloat16 *load_warmup<bfloat16>(
+    MemoryMappedFiles &files, const std::string &cache_warmup_file, uint64_t &warmup_num, uint64_t warmup_dim,
+    uint64_t warmup_aligned_dim);
 template DISKANN_DLLEXPORT uint8_t *load_warmup<uint8_t>(MemoryMappedFiles &files, const std::string &cache_warmup_file,
                                                          uint64_t &warmup_num, uint64_t warmup_dim,
                                                          uint64_t warmup_aligned_dim);
@@ -1409,6 +3285,12 @@ template DISKANN_DLLEXPORT float *load_warmup<float>(MemoryMappedFiles &files, c
 template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<int8_t, uint32_t>(
     std::unique_ptr<diskann::PQFlashIndex<int8_t, uint32_t>> &pFlashIndex, int8_t *tuning_sample,
     uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
+template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<float16, uint32_t>(
+    std::unique_ptr<diskann::PQFlashIndex<float16, uint32_t>> &pFlashIndex, float16 *tuning_sample,
+    uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
+template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<bfloat16, uint32_t>(
+    std::unique_ptr<diskann::PQFlashIndex<bfloat16, uint32_t>> &pFlashIndex, bfloat16 *tuning_sample,
+    uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
 template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<uint8_t, uint32_t>(
     std::unique_ptr<diskann::PQFlashIndex<uint8_t, uint32_t>> &pFlashIndex, uint8_t *tuning_sample,
     uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
@@ -1419,6 +3301,12 @@ template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<float, uint32_t>(
 template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<int8_t, uint16_t>(
     std::unique_ptr<diskann::PQFlashIndex<int8_t, uint16_t>> &pFlashIndex, int8_t *tuning_sample,
     uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
+template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<float16, uint16_t>(
+    std::unique_ptr<diskann::PQFlashIndex<float16, uint16_t>> &pFlashIndex, float16 *tuning_sample,
+    uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
+template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<bfloat16, uint16_t>(
+    std::unique_ptr<diskann::PQFlashIndex<bfloat16, uint16_t>> &pFlashIndex, bfloat16 *tuning_sample,
+    uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
 template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<uint8_t, uint16_t>(
     std::unique_ptr<diskann::PQFlashIndex<uint8_t, uint16_t>> &pFlashIndex, uint8_t *tuning_sample,
     uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
@@ -1426,27 +3314,140 @@ template DISKANN_DLLEXPORT uint32_t optimize_beamwidth<float, uint16_t>(
     std::unique_ptr<diskann::PQFlashIndex<float, uint16_t>> &pFlashIndex, float *tuning_sample,
     uint64_t tuning_sample_num, uint64_t tuning_sample_aligned_dim, uint32_t L, uint32_t nthreads, uint32_t start_bw);
 
+template DISKANN_DLLEXPORT uint64_t disk_index_to_mem_index<int8_t>(const std::string &disk_index_path,
+                                                                    const std::string &mem_index_path,
+                                                                    const bool add_frozen_point);
+template DISKANN_DLLEXPORT uint64_t disk_index_to_mem_index<uint8_t>(const std::string &disk_index_path,
+                                                                     const std::string &mem_index_path,
+                                                                     const bool add_frozen_point);
+template DISKANN_DLLEXPORT uint64_t disk_index_to_mem_index<float>(const std::string &disk_index_path,
+                                                                   const std::string &mem_index_path,
+                                                                   const bool add_frozen_point);
+template DISKANN_DLLEXPORT uint64_t disk_index_to_mem_index<float16>(const std::string &disk_index_path,
+                                                                     const std::string &mem_index_path,
+                                                                     const bool add_frozen_point);
+template DISKANN_DLLEXPORT uint64_t disk_index_to_mem_index<bfloat16>(const std::string &disk_index_path,
+                                                                      const std::string &mem_index_path,
+                                                                      const bool add_frozen_point);
+
+template DISKANN_DLLEXPORT int append_to_disk_index<int8_t>(const std::string &index_prefix,
+                                                            const std::string &new_data_file,
+                                                            const diskann::Metric compareMetric, const uint32_t L,
+                                                            const float alpha, const uint32_t num_threads);
+template DISKANN_DLLEXPORT int append_to_disk_index<uint8_t>(const std::string &index_prefix,
+                                                             const std::string &new_data_file,
+                                                             const diskann::Metric compareMetric, const uint32_t L,
+                                                             const float alpha, const uint32_t num_threads);
+template DISKANN_DLLEXPORT int append_to_disk_index<float>(const std::string &index_prefix,
+                                                           const std::string &new_data_file,
+                                                           const diskann::Metric compareMetric, const uint32_t L,
+                                                           const float alpha, const uint32_t num_threads);
+template DISKANN_DLLEXPORT int append_to_disk_index<float16>(const std::string &index_prefix,
+                                                             const std::string &new_data_file,
+                                                             const diskann::Metric compareMetric, const uint32_t L,
+                                                             const float alpha, const uint32_t num_threads);
+template DISKANN_DLLEXPORT int append_to_disk_index<bfloat16>(const std::string &index_prefix,
+                                                              const std::string &new_data_file,
+                                                              const diskann::Metric compareMetric, const uint32_t L,
+                                                              const float alpha, const uint32_t num_threads);
+
+template DISKANN_DLLEXPORT void build_shard<int8_t>(const ShardBuildJob &job);
+template DISKANN_DLLEXPORT void build_shard<uint8_t>(const ShardBuildJob &job);
+template DISKANN_DLLEXPORT void build_shard<float>(const ShardBuildJob &job);
+template DISKANN_DLLEXPORT void build_shard<float16>(const ShardBuildJob &job);
+template DISKANN_DLLEXPORT void build_shard<bfloat16>(const ShardBuildJob &job);
+
+template DISKANN_DLLEXPORT void build_disk_entry_layer<int8_t>(const std::string &data_file,
+                                                              const std::string &entry_layer_path,
+                                                              const double sample_rate, const uint32_t num_threads);
+template DISKANN_DLLEXPORT void build_disk_entry_layer<uint8_t>(const std::string &data_file,
+                                                               const std::string &entry_layer_path,
+                                                               const double sample_rate, const uint32_t num_threads);
+template DISKANN_DLLEXPORT void build_disk_entry_layer<float>(const std::string &data_file,
+                                                             const std::string &entry_layer_path,
+                                                             const double sample_rate, const uint32_t num_threads);
+template DISKANN_DLLEXPORT void build_disk_entry_layer<float16>(const std::string &data_file,
+                                                               const std::string &entry_layer_path,
+                                                               const double sample_rate, const uint32_t num_threads);
+template DISKANN_DLLEXPORT void build_disk_entry_layer<bfloat16>(const std::string &data_file,
+                                                                const std::string &entry_layer_path,
+                                                                const double sample_rate, const uint32_t num_threads);
+
+template DISKANN_DLLEXPORT void build_disk_entry_centroids<int8_t>(const std::string &data_file,
+                                                                  const std::string &medoids_path,
+                                                                  const std::string &centroids_path,
+                                                                  const uint32_t num_centroids);
+template DISKANN_DLLEXPORT void build_disk_entry_centroids<uint8_t>(const std::string &data_file,
+                                                                   const std::string &medoids_path,
+                                                                   const std::string &centroids_path,
+                                                                   const uint32_t num_centroids);
+template DISKANN_DLLEXPORT void build_disk_entry_centroids<float>(const std::string &data_file,
+                                                                 const std::string &medoids_path,
+                                                                 const std::string &centroids_path,
+                                                                 const uint32_t num_centroids);
+template DISKANN_DLLEXPORT void build_disk_entry_centroids<float16>(const std::string &data_file,
+                                                                   const std::string &medoids_path,
+                                                                   const std::string &centroids_path,
+                                                                   const uint32_t num_centroids);
+template DISKANN_DLLEXPORT void build_disk_entry_centroids<bfloat16>(const std::string &data_file,
+                                                                    const std::string &medoids_path,
+                                                                    const std::string &centroids_path,
+                                                                    const uint32_t num_centroids);
+
 template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint32_t>(const char *dataFilePath, const char *indexFilePath,
                                                                   const char *indexBuildParameters,
                                                                   diskann::Metric compareMetric, bool use_opq,
                                                                   const std::string &codebook_prefix, bool use_filters,
                                                                   const std::string &label_file,
                                                                   const std::string &universal_label,
-                                                                  const uint32_t filter_threshold, const uint32_t Lf);
+                                                                  const uint32_t filter_threshold, const uint32_t Lf,
+                                                                  const bool reorder_layout, const bool fast_scan_pq,
+                                                                  const float entry_layer_sample_rate,
+                                                                  const uint32_t num_entry_centroids,
+                                                                  const bool minibatch_kmeans, const bool resume,
+                                                                  const std::string &only_shards);
+template DISKANN_DLLEXPORT int build_disk_index<float16, uint32_t>(const char *dataFilePath, const char *indexFilePath,
+                                                                   const char *indexBuildParameters,
+                                                                   diskann::Metric compareMetric, bool use_opq,
+                                                                   const std::string &codebook_prefix, bool use_filters,
+                                                                   const std::string &label_file,
+                                                                   const std::string &universal_label,
+                                                                   const uint32_t filter_threshold, const uint32_t Lf,
+                                                                   const bool reorder_layout, const bool fast_scan_pq,
+                                                                   const float entry_layer_sample_rate,
+                                                                   const uint32_t num_entry_centroids,
+                                                                   const bool minibatch_kmeans, const bool resume,
+                                                                   const std::string &only_shards);
+template DISKANN_DLLEXPORT int build_disk_index<bfloat16, uint32_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool reorder_layout, const bool fast_scan_pq, const float entry_layer_sample_rate,
+    const uint32_t num_entry_centroids, const bool minibatch_kmeans, const bool resume, const std::string &only_shards);
 template DISKANN_DLLEXPORT int build_disk_index<uint8_t, uint32_t>(const char *dataFilePath, const char *indexFilePath,
                                                                    const char *indexBuildParameters,
                                                                    diskann::Metric compareMetric, bool use_opq,
                                                                    const std::string &codebook_prefix, bool use_filters,
                                                                    const std::string &label_file,
                                                                    const std::string &universal_label,
-                                                                   const uint32_t filter_threshold, const uint32_t Lf);
+                                                                   const uint32_t filter_threshold, const uint32_t Lf,
+                                                                   const bool reorder_layout, const bool fast_scan_pq,
+                                                                   const float entry_layer_sample_rate,
+                                                                   const uint32_t num_entry_centroids,
+                                                                   const bool minibatch_kmeans, const bool resume,
+                                                                   const std::string &only_shards);
 template DISKANN_DLLEXPORT int build_disk_index<float, uint32_t>(const char *dataFilePath, const char *indexFilePath,
                                                                  const char *indexBuildParameters,
                                                                  diskann::Metric compareMetric, bool use_opq,
                                                                  const std::string &codebook_prefix, bool use_filters,
                                                                  const std::string &label_file,
                                                                  const std::string &universal_label,
-                                                                 const uint32_t filter_threshold, const uint32_t Lf);
+                                                                 const uint32_t filter_threshold, const uint32_t Lf,
+                                                                 const bool reorder_layout, const bool fast_scan_pq,
+                                                                 const float entry_layer_sample_rate,
+                                                                 const uint32_t num_entry_centroids,
+                                                                 const bool minibatch_kmeans, const bool resume,
+                                                                 const std::string &only_shards);
 // LabelT = uint16
 template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint16_t>(const char *dataFilePath, const char *indexFilePath,
                                                                   const char *indexBuildParameters,
@@ -1454,51 +3455,175 @@ template DISKANN_DLLEXPORT int build_disk_index<int8_t, uint16_t>(const char *da
                                                                   const std::string &codebook_prefix, bool use_filters,
                                                                   const std::string &label_file,
                                                                   const std::string &universal_label,
-                                                                  const uint32_t filter_threshold, const uint32_t Lf);
+                                                                  const uint32_t filter_threshold, const uint32_t Lf,
+                                                                  const bool reorder_layout, const bool fast_scan_pq,
+                                                                  const float entry_layer_sample_rate,
+                                                                  const uint32_t num_entry_centroids,
+                                                                  const bool minibatch_kmeans, const bool resume,
+                                                                  const std::string &only_shards);
+template DISKANN_DLLEXPORT int build_disk_index<float16, uint16_t>(const char *dataFilePath, const char *indexFilePath,
+                                                                   const char *indexBuildParameters,
+                                                                   diskann::Metric compareMetric, bool use_opq,
+                                                                   const std::string &codebook_prefix, bool use_filters,
+                                                                   const std::string &label_file,
+                                                                   const std::string &universal_label,
+                                                                   const uint32_t filter_threshold, const uint32_t Lf,
+                                                                   const bool reorder_layout, const bool fast_scan_pq,
+                                                                   const float entry_layer_sample_rate,
+                                                                   const uint32_t num_entry_centroids,
+                                                                   const bool minibatch_kmeans, const bool resume,
+                                                                   const std::string &only_shards);
+template DISKANN_DLLEXPORT int build_disk_index<bfloat16, uint16_t>(
+    const char *dataFilePath, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf, const bool reorder_layout, const bool fast_scan_pq, const float entry_layer_sample_rate,
+    const uint32_t num_entry_centroids, const bool minibatch_kmeans, const bool resume, const std::string &only_shards);
 template DISKANN_DLLEXPORT int build_disk_index<uint8_t, uint16_t>(const char *dataFilePath, const char *indexFilePath,
                                                                    const char *indexBuildParameters,
                                                                    diskann::Metric compareMetric, bool use_opq,
                                                                    const std::string &codebook_prefix, bool use_filters,
                                                                    const std::string &label_file,
                                                                    const std::string &universal_label,
-                                                                   const uint32_t filter_threshold, const uint32_t Lf);
+                                                                   const uint32_t filter_threshold, const uint32_t Lf,
+                                                                   const bool reorder_layout, const bool fast_scan_pq,
+                                                                   const float entry_layer_sample_rate,
+                                                                   const uint32_t num_entry_centroids,
+                                                                   const bool minibatch_kmeans, const bool resume,
+                                                                   const std::string &only_shards);
 template DISKANN_DLLEXPORT int build_disk_index<float, uint16_t>(const char *dataFilePath, const char *indexFilePath,
                                                                  const char *indexBuildParameters,
                                                                  diskann::Metric compareMetric, bool use_opq,
                                                                  const std::string &codebook_prefix, bool use_filters,
                                                                  const std::string &label_file,
                                                                  const std::string &universal_label,
-                                                                 const uint32_t filter_threshold, const uint32_t Lf);
+                                                                 const uint32_t filter_threshold, const uint32_t Lf,
+                                                                 const bool reorder_layout, const bool fast_scan_pq,
+                                                                 const float entry_layer_sample_rate,
+                                                                 const uint32_t num_entry_centroids,
+                                                                 const bool minibatch_kmeans, const bool resume,
+                                                                 const std::string &only_shards);
+
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<int8_t, uint32_t>(
+    const int8_t *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<float16, uint32_t>(
+    const float16 *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<bfloat16, uint32_t>(
+    const bfloat16 *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<uint8_t, uint32_t>(
+    const uint8_t *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<float, uint32_t>(
+    const float *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<int8_t, uint16_t>(
+    const int8_t *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<float16, uint16_t>(
+    const float16 *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<bfloat16, uint16_t>(
+    const bfloat16 *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<uint8_t, uint16_t>(
+    const uint8_t *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
+template DISKANN_DLLEXPORT int build_disk_index_from_memory<float, uint16_t>(
+    const float *data, size_t num_points, size_t dim, const char *indexFilePath, const char *indexBuildParameters,
+    diskann::Metric compareMetric, bool use_opq, const std::string &codebook_prefix, bool use_filters,
+    const std::string &label_file, const std::string &universal_label, const uint32_t filter_threshold,
+    const uint32_t Lf);
 
 template DISKANN_DLLEXPORT int build_merged_vamana_index<int8_t, uint32_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
+template DISKANN_DLLEXPORT int build_merged_vamana_index<float16, uint32_t>(
+    std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
+    double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
+    size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
+template DISKANN_DLLEXPORT int build_merged_vamana_index<bfloat16, uint32_t>(
+    std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
+    double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
+    size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<float, uint32_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<uint8_t, uint32_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
 // Label=16_t
 template DISKANN_DLLEXPORT int build_merged_vamana_index<int8_t, uint16_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
+template DISKANN_DLLEXPORT int build_merged_vamana_index<float16, uint16_t>(
+    std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
+    double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
+    size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
+template DISKANN_DLLEXPORT int build_merged_vamana_index<bfloat16, uint16_t>(
+    std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
+    double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
+    size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<float, uint16_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
 template DISKANN_DLLEXPORT int build_merged_vamana_index<uint8_t, uint16_t>(
     std::string base_file, diskann::Metric compareMetric, uint32_t L, uint32_t R, double sampling_rate,
     double ram_budget, std::string mem_index_path, std::string medoids_path, std::string centroids_file,
     size_t build_pq_bytes, bool use_opq, uint32_t num_threads, bool use_filters, const std::string &label_file,
-    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf);
+    const std::string &labels_to_medoids_file, const std::string &universal_label, const uint32_t Lf,
+    const bool minibatch_kmeans, DiskLayoutWriter *disk_layout, BuildManifest *manifest,
+    const std::string &only_shards, const float partition_balance, const bool gpu_build);
 }; // namespace diskann
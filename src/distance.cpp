@@ -1,18 +1,10 @@
 // TODO
 // CHECK COSINE ON LINUX
 
-#ifdef _WINDOWS
-#include <immintrin.h>
-#include <smmintrin.h>
-#include <tmmintrin.h>
-#include <intrin.h>
-#else
-#include <immintrin.h>
-#endif
-
 #include "simd_utils.h"
 #include <cosine_similarity.h>
 #include <iostream>
+#include <utility>
 
 #include "distance.h"
 #include "utils.h"
@@ -31,6 +23,11 @@ float Distance<T>::compare(const T *a, const T *b, const float normA, const floa
     throw std::logic_error("This function is not implemented.");
 }
 
+template <typename T> float Distance<T>::compare_with_bound(const T *a, const T *b, uint32_t length, float bound) const
+{
+    return compare(a, b, length);
+}
+
 template <typename T> uint32_t Distance<T>::post_normalization_dimension(uint32_t orig_dimension) const
 {
     return orig_dimension;
@@ -61,6 +58,145 @@ template <typename T> size_t Distance<T>::get_required_alignment() const
     return _alignment_factor;
 }
 
+//
+// Byte dot products. Bytes are widened to int16 and multiplied and
+// accumulated into int32 with vpmaddwd (smull and sadalp on NEON), so the
+// sums are exact and the kernels give the results of the scalar loops.
+//
+
+#ifdef USE_AVX2
+static inline int32_t avx2_reduce_add_epi32(__m256i x)
+{
+    __m128i x128 = _mm_add_epi32(_mm256_extracti128_si256(x, 1), _mm256_castsi256_si128(x));
+    x128 = _mm_add_epi32(x128, _mm_shuffle_epi32(x128, 0x4e));
+    x128 = _mm_add_epi32(x128, _mm_shuffle_epi32(x128, 0xb1));
+    return _mm_cvtsi128_si32(x128);
+}
+
+// widens 16 bytes to int16, signed or unsigned
+template <bool is_signed> static inline __m256i avx2_load_widen(const uint8_t *p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return is_signed ? _mm256_cvtepi8_epi16(v) : _mm256_cvtepu8_epi16(v);
+}
+#endif
+
+#ifdef USE_NEON
+static inline int8x16_t neon_load_bytes(const int8_t *p)
+{
+    return vld1q_s8(p);
+}
+
+static inline uint8x16_t neon_load_bytes(const uint8_t *p)
+{
+    return vld1q_u8(p);
+}
+
+// adds the products of the 16 byte pairs, two to a lane, to acc
+static inline int32x4_t neon_madd_bytes(int32x4_t acc, int8x16_t a, int8x16_t b)
+{
+    acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(a), vget_low_s8(b)));
+    return vpadalq_s16(acc, vmull_high_s8(a, b));
+}
+
+static inline int32x4_t neon_madd_bytes(int32x4_t acc, uint8x16_t a, uint8x16_t b)
+{
+    uint32x4_t sum = vpaddlq_u16(vmull_u8(vget_low_u8(a), vget_low_u8(b)));
+    sum = vpadalq_u16(sum, vmull_high_u8(a, b));
+    return vaddq_s32(acc, vreinterpretq_s32_u32(sum));
+}
+
+static inline float neon_dot_float(const float *a, const float *b, uint32_t length)
+{
+    float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+    uint32_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vfmaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float result = vaddvq_f32(vaddq_f32(sum0, sum1));
+    for (; i < length; i++)
+        result += a[i] * b[i];
+    return result;
+}
+#endif
+
+// the dot product of a and b and, with magnitudes, their squared norms
+template <typename T, bool magnitudes>
+static inline int32_t byte_dot(const T *a, const T *b, uint32_t length, int32_t *mag_a = nullptr,
+                               int32_t *mag_b = nullptr)
+{
+    int32_t dot = 0, sq_a = 0, sq_b = 0;
+    uint32_t i = 0;
+#ifdef USE_AVX2
+    constexpr bool is_signed = std::is_same<T, int8_t>::value;
+    const uint8_t *pa = (const uint8_t *)a, *pb = (const uint8_t *)b;
+    __m256i dot_acc = _mm256_setzero_si256();
+    __m256i mag_a_acc = _mm256_setzero_si256();
+    __m256i mag_b_acc = _mm256_setzero_si256();
+    for (; i + 16 <= length; i += 16)
+    {
+        __m256i va = avx2_load_widen<is_signed>(pa + i);
+        __m256i vb = avx2_load_widen<is_signed>(pb + i);
+        dot_acc = _mm256_add_epi32(dot_acc, _mm256_madd_epi16(va, vb));
+        if (magnitudes)
+        {
+            mag_a_acc = _mm256_add_epi32(mag_a_acc, _mm256_madd_epi16(va, va));
+            mag_b_acc = _mm256_add_epi32(mag_b_acc, _mm256_madd_epi16(vb, vb));
+        }
+    }
+    dot = avx2_reduce_add_epi32(dot_acc);
+    if (magnitudes)
+    {
+        sq_a = avx2_reduce_add_epi32(mag_a_acc);
+        sq_b = avx2_reduce_add_epi32(mag_b_acc);
+    }
+#elif defined(USE_NEON)
+    int32x4_t dot_acc = vdupq_n_s32(0), mag_a_acc = vdupq_n_s32(0), mag_b_acc = vdupq_n_s32(0);
+    for (; i + 16 <= length; i += 16)
+    {
+        auto va = neon_load_bytes(a + i);
+        auto vb = neon_load_bytes(b + i);
+        dot_acc = neon_madd_bytes(dot_acc, va, vb);
+        if (magnitudes)
+        {
+            mag_a_acc = neon_madd_bytes(mag_a_acc, va, va);
+            mag_b_acc = neon_madd_bytes(mag_b_acc, vb, vb);
+        }
+    }
+    dot = vaddvq_s32(dot_acc);
+    if (magnitudes)
+    {
+        sq_a = vaddvq_s32(mag_a_acc);
+        sq_b = vaddvq_s32(mag_b_acc);
+    }
+#endif
+    for (; i < length; i++)
+    {
+        dot += (int32_t)a[i] * (int32_t)b[i];
+        if (magnitudes)
+        {
+            sq_a += (int32_t)a[i] * (int32_t)a[i];
+            sq_b += (int32_t)b[i] * (int32_t)b[i];
+        }
+    }
+    if (magnitudes)
+    {
+        *mag_a = sq_a;
+        *mag_b = sq_b;
+    }
+    return dot;
+}
+
+template <typename T> static inline float byte_cosine(const T *a, const T *b, uint32_t length)
+{
+    int32_t magA, magB;
+    int32_t scalarProduct = byte_dot<T, true>(a, b, length, &magA, &magB);
+    // similarity == 1-cosine distance
+    return 1.0f - (float)(scalarProduct / (sqrt(magA) * sqrt(magB)));
+}
+
 //
 // Cosine distance functions.
 //
@@ -69,6 +205,8 @@ float DistanceCosineInt8::compare(const int8_t *a, const int8_t *b, uint32_t len
 {
 #ifdef _WINDOWS
     return diskann::CosineSimilarity2<int8_t>(a, b, length);
+#elif defined(USE_AVX2) || defined(USE_NEON)
+    return byte_cosine(a, b, length);
 #else
     int magA = 0, magB = 0, scalarProduct = 0;
     for (uint32_t i = 0; i < length; i++)
@@ -86,6 +224,25 @@ float DistanceCosineFloat::compare(const float *a, const float *b, uint32_t leng
 {
 #ifdef _WINDOWS
     return diskann::CosineSimilarity2<float>(a, b, length);
+#elif defined(USE_NEON)
+    float32x4_t dot = vdupq_n_f32(0), mag_a = vdupq_n_f32(0), mag_b = vdupq_n_f32(0);
+    uint32_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        float32x4_t va = vld1q_f32(a + i), vb = vld1q_f32(b + i);
+        dot = vfmaq_f32(dot, va, vb);
+        mag_a = vfmaq_f32(mag_a, va, va);
+        mag_b = vfmaq_f32(mag_b, vb, vb);
+    }
+    float magA = vaddvq_f32(mag_a), magB = vaddvq_f32(mag_b), scalarProduct = vaddvq_f32(dot);
+    for (; i < length; i++)
+    {
+        magA += a[i] * a[i];
+        magB += b[i] * b[i];
+        scalarProduct += a[i] * b[i];
+    }
+    // similarity == 1-cosine distance
+    return 1.0f - (scalarProduct / (sqrt(magA) * sqrt(magB)));
 #else
     float magA = 0, magB = 0, scalarProduct = 0;
     for (uint32_t i = 0; i < length; i++)
@@ -112,6 +269,25 @@ float SlowDistanceCosineUInt8::compare(const uint8_t *a, const uint8_t *b, uint3
     return 1.0f - (float)(scalarProduct / (sqrt(magA) * sqrt(magB)));
 }
 
+float DistanceCosineUInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return byte_cosine(a, b, length);
+}
+
+//
+// Inner product distance functions.
+//
+
+float DistanceInnerProductInt8::compare(const int8_t *a, const int8_t *b, uint32_t length) const
+{
+    return -(float)byte_dot<int8_t, false>(a, b, length);
+}
+
+float DistanceInnerProductUInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return -(float)byte_dot<uint8_t, false>(a, b, length);
+}
+
 //
 // L2 distance functions.
 //
@@ -173,6 +349,66 @@ float DistanceL2UInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t size
     return (float)result;
 }
 
+// The bounded L2 kernels check the partial sum against the bound once per
+// this many dimensions. As the squared differences are never negative, a
+// partial sum past the bound means the distance is past it too.
+static const uint32_t BOUND_CHECK_DIMS = 64;
+
+// integer sums are exact, so the blocks give the result of compare()
+template <typename T> static inline float l2_bytes_with_bound(const T *a, const T *b, uint32_t size, float bound)
+{
+    int32_t result = 0;
+    for (uint32_t start = 0; start < size; start += BOUND_CHECK_DIMS)
+    {
+        const int32_t end = (int32_t)(std::min)(size, start + BOUND_CHECK_DIMS);
+#ifndef _WINDOWS
+#pragma omp simd reduction(+ : result)
+#endif
+        for (int32_t i = (int32_t)start; i < end; i++)
+        {
+            result += ((int32_t)((int16_t)a[i] - (int16_t)b[i])) * ((int32_t)((int16_t)a[i] - (int16_t)b[i]));
+        }
+        if ((float)result > bound)
+            break;
+    }
+    return (float)result;
+}
+
+float DistanceL2Int8::compare_with_bound(const int8_t *a, const int8_t *b, uint32_t size, float bound) const
+{
+    return l2_bytes_with_bound(a, b, size, bound);
+}
+
+float DistanceL2UInt8::compare_with_bound(const uint8_t *a, const uint8_t *b, uint32_t size, float bound) const
+{
+    return l2_bytes_with_bound(a, b, size, bound);
+}
+
+#ifdef USE_NEON
+// two accumulators, with the running sum reduced every BOUND_CHECK_DIMS
+// dimensions if bounded; any length
+template <bool bounded>
+static inline float neon_l2_float(const float *a, const float *b, uint32_t length, float bound)
+{
+    float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+    uint32_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        float32x4_t diff0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t diff1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        sum0 = vfmaq_f32(sum0, diff0, diff0);
+        sum1 = vfmaq_f32(sum1, diff1, diff1);
+        if (bounded && (i + 8) % BOUND_CHECK_DIMS == 0 && i + 8 < length &&
+            vaddvq_f32(vaddq_f32(sum0, sum1)) > bound)
+            return vaddvq_f32(vaddq_f32(sum0, sum1));
+    }
+    float result = vaddvq_f32(vaddq_f32(sum0, sum1));
+    for (; i < length; i++)
+        result += (a[i] - b[i]) * (a[i] - b[i]);
+    return result;
+}
+#endif
+
 #ifndef _WINDOWS
 float DistanceL2Float::compare(const float *a, const float *b, uint32_t size) const
 {
@@ -208,6 +444,8 @@ float DistanceL2Float::compare(const float *a, const float *b, uint32_t size) co
 
     // horizontal add sum
     result = _mm256_reduce_add_ps(sum);
+#elif defined(USE_NEON)
+    result = neon_l2_float<false>(a, b, size, 0);
 #else
 #ifndef _WINDOWS
 #pragma omp simd reduction(+ : result) aligned(a, b : 32)
@@ -220,6 +458,27 @@ float DistanceL2Float::compare(const float *a, const float *b, uint32_t size) co
     return result;
 }
 
+// the accumulation of compare(), with the running sum reduced at each check
+float DistanceL2Float::compare_with_bound(const float *a, const float *b, uint32_t size, float bound) const
+{
+#ifdef USE_AVX2
+    const uint32_t niters = size / 8;
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t j = 0; j < niters; j++)
+    {
+        __m256 tmp_vec = _mm256_sub_ps(_mm256_load_ps(a + 8 * j), _mm256_load_ps(b + 8 * j));
+        sum = _mm256_fmadd_ps(tmp_vec, tmp_vec, sum);
+        if ((j + 1) % (BOUND_CHECK_DIMS / 8) == 0 && j + 1 < niters && _mm256_reduce_add_ps(sum) > bound)
+            break;
+    }
+    return _mm256_reduce_add_ps(sum);
+#elif defined(USE_NEON)
+    return neon_l2_float<true>(a, b, size, bound);
+#else
+    return compare(a, b, size);
+#endif
+}
+
 template <typename T> float SlowDistanceL2<T>::compare(const T *a, const T *b, uint32_t length) const
 {
     float result = 0.0f;
@@ -343,6 +602,8 @@ template <typename T> float DistanceInnerProduct<T>::inner_product(const T *a, c
     _mm256_storeu_ps(unpack, sum);
     result = unpack[0] + unpack[1] + unpack[2] + unpack[3] + unpack[4] + unpack[5] + unpack[6] + unpack[7];
 
+#elif defined(USE_NEON)
+    result = neon_dot_float((const float *)a, (const float *)b, size);
 #else
 #ifdef __SSE2__
 #define SSE_DOT(addr1, addr2, dest, tmp1, tmp2)                                                                        \
@@ -455,6 +716,8 @@ template <typename T> float DistanceFastL2<T>::norm(const T *a, uint32_t size) c
     }
     _mm256_storeu_ps(unpack, sum);
     result = unpack[0] + unpack[1] + unpack[2] + unpack[3] + unpack[4] + unpack[5] + unpack[6] + unpack[7];
+#elif defined(USE_NEON)
+    result = neon_dot_float((const float *)a, (const float *)a, size);
 #else
 #ifdef __SSE2__
 #define SSE_L2NORM(addr, dest, tmp)                                                                                    \
@@ -521,6 +784,9 @@ template <typename T> float DistanceFastL2<T>::norm(const T *a, uint32_t size) c
 
 float AVXDistanceInnerProductFloat::compare(const float *a, const float *b, uint32_t size) const
 {
+#ifdef USE_NEON
+    return -neon_dot_float(a, b, size);
+#else
     float result = 0.0f;
 #define AVX_DOT(addr1, addr2, dest, tmp1, tmp2)                                                                        \
     tmp1 = _mm256_loadu_ps(addr1);                                                                                     \
@@ -559,6 +825,7 @@ float AVXDistanceInnerProductFloat::compare(const float *a, const float *b, uint
     result = unpack[0] + unpack[1] + unpack[2] + unpack[3] + unpack[4] + unpack[5] + unpack[6] + unpack[7];
 
     return -result;
+#endif
 }
 
 uint32_t AVXNormalizedCosineDistanceFloat::post_normalization_dimension(uint32_t orig_dimension) const
@@ -595,132 +862,1216 @@ void AVXNormalizedCosineDistanceFloat::normalize_and_copy(const float *query_vec
     }
 }
 
-// Get the right distance function for the given metric.
-template <> diskann::Distance<float> *get_distance_function(diskann::Metric m)
+//
+// Hamming distance on bit-packed vectors.
+//
+
+static inline uint32_t popcount64(uint64_t x)
 {
-    if (m == diskann::Metric::L2)
-    {
-        if (Avx2SupportedCPU)
-        {
-            diskann::cout << "L2: Using AVX2 distance computation DistanceL2Float" << std::endl;
-            return new diskann::DistanceL2Float();
-        }
-        else if (AvxSupportedCPU)
-        {
-            diskann::cout << "L2: AVX2 not supported. Using AVX distance computation" << std::endl;
-            return new diskann::AVXDistanceL2Float();
-        }
-        else
-        {
-            diskann::cout << "L2: Older CPU. Using slow distance computation" << std::endl;
-            return new diskann::SlowDistanceL2<float>();
-        }
-    }
-    else if (m == diskann::Metric::COSINE)
+#ifdef _WINDOWS
+    return (uint32_t)__popcnt64(x);
+#else
+    return (uint32_t)__builtin_popcountll(x);
+#endif
+}
+
+float DistanceHammingUInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    uint64_t count = 0;
+    uint32_t i = 0;
+#ifdef USE_AVX2
+    // the popcount of each nibble by table lookup, summed over each 8 bytes
+    // by vpsadbw
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+                                            2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= length; i += 32)
     {
-        diskann::cout << "Cosine: Using either AVX or AVX2 implementation" << std::endl;
-        return new diskann::DistanceCosineFloat();
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                     _mm256_loadu_si256((const __m256i *)(b + i)));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask)),
+                                         _mm256_shuffle_epi8(lookup, high));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
     }
-    else if (m == diskann::Metric::INNER_PRODUCT)
+    __m128i acc128 = _mm_add_epi64(_mm256_extracti128_si256(acc, 1), _mm256_castsi256_si128(acc));
+    count = (uint64_t)_mm_cvtsi128_si64(_mm_add_epi64(acc128, _mm_unpackhi_epi64(acc128, acc128)));
+#elif defined(USE_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 16 <= length; i += 16)
+        acc = vpadalq_u16(acc, vpaddlq_u8(vcntq_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)))));
+    count = vaddvq_u32(acc);
+#endif
+    for (; i + 8 <= length; i += 8)
     {
-        diskann::cout << "Inner product: Using AVX2 implementation "
-                         "AVXDistanceInnerProductFloat"
-                      << std::endl;
-        return new diskann::AVXDistanceInnerProductFloat();
+        uint64_t x, y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        count += popcount64(x ^ y);
     }
-    else if (m == diskann::Metric::FAST_L2)
+    for (; i < length; i++)
+        count += popcount64((uint64_t)(a[i] ^ b[i]));
+    return (float)count;
+}
+
+//
+// AVX-512 distance functions. They are compiled for AVX-512 regardless of the
+// build flags and only selected by get_distance_function() when the CPU has
+// the instructions. x86 only.
+//
+#ifndef USE_NEON
+#ifdef _WINDOWS
+#define AVX512_TARGET
+#else
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni")))
+#endif
+
+AVX512_TARGET static inline __mmask16 avx512_tail_mask16(uint32_t n)
+{
+    return (__mmask16)((1u << n) - 1);
+}
+
+AVX512_TARGET static inline __mmask32 avx512_tail_mask32(uint32_t n)
+{
+    return (__mmask32)((1u << n) - 1);
+}
+
+template <bool bounded>
+AVX512_TARGET static inline float avx512_l2_float(const float *a, const float *b, uint32_t length, float bound)
+{
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 32 <= length; i += 32)
     {
-        diskann::cout << "Fast_L2: Using AVX2 implementation with norm "
-                         "memoization DistanceFastL2<float>"
-                      << std::endl;
-        return new diskann::DistanceFastL2<float>();
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+        sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+        if (bounded && (i + 32) % BOUND_CHECK_DIMS == 0 && _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1)) > bound)
+            return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
     }
-    else
+    for (; i < length; i += 16)
     {
-        std::stringstream stream;
-        stream << "Only L2, cosine, and inner product supported for floating "
-                  "point vectors as of now."
-               << std::endl;
-        diskann::cerr << stream.str() << std::endl;
-        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        __mmask16 mask = avx512_tail_mask16((std::min)(length - i, 16u));
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        sum0 = _mm512_fmadd_ps(d, d, sum0);
     }
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
 }
 
-template <> diskann::Distance<int8_t> *get_distance_function(diskann::Metric m)
+AVX512_TARGET float AVX512DistanceL2Float::compare(const float *a, const float *b, uint32_t length) const
 {
-    if (m == diskann::Metric::L2)
+    return avx512_l2_float<false>(a, b, length, 0);
+}
+
+AVX512_TARGET float AVX512DistanceL2Float::compare_with_bound(const float *a, const float *b, uint32_t length,
+                                                              float bound) const
+{
+    return avx512_l2_float<true>(a, b, length, bound);
+}
+
+AVX512_TARGET static inline float avx512_dot_float(const float *a, const float *b, uint32_t length)
+{
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 32 <= length; i += 32)
     {
-        if (Avx2SupportedCPU)
-        {
-            diskann::cout << "Using AVX2 distance computation DistanceL2Int8." << std::endl;
-            return new diskann::DistanceL2Int8();
-        }
-        else if (AvxSupportedCPU)
-        {
-            diskann::cout << "AVX2 not supported. Using AVX distance computation" << std::endl;
-            return new diskann::AVXDistanceL2Int8();
-        }
-        else
-        {
-            diskann::cout << "Older CPU. Using slow distance computation "
-                             "SlowDistanceL2Int<int8_t>."
-                          << std::endl;
-            return new diskann::SlowDistanceL2<int8_t>();
-        }
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), sum1);
     }
-    else if (m == diskann::Metric::COSINE)
+    for (; i < length; i += 16)
     {
-        diskann::cout << "Using either AVX or AVX2 for Cosine similarity "
-                         "DistanceCosineInt8."
-                      << std::endl;
-        return new diskann::DistanceCosineInt8();
+        __mmask16 mask = avx512_tail_mask16((std::min)(length - i, 16u));
+        sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), sum0);
     }
-    else
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+AVX512_TARGET float AVX512DistanceInnerProductFloat::compare(const float *a, const float *b, uint32_t length) const
+{
+    return -avx512_dot_float(a, b, length);
+}
+
+AVX512_TARGET float AVX512DistanceCosineFloat::compare(const float *a, const float *b, uint32_t length) const
+{
+    __m512 dot = _mm512_setzero_ps();
+    __m512 mag_a = _mm512_setzero_ps();
+    __m512 mag_b = _mm512_setzero_ps();
+    for (uint32_t i = 0; i < length; i += 16)
     {
-        std::stringstream stream;
-        stream << "Only L2 and cosine supported for signed byte vectors." << std::endl;
-        diskann::cerr << stream.str() << std::endl;
-        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        __mmask16 mask = avx512_tail_mask16((std::min)(length - i, 16u));
+        __m512 va = _mm512_maskz_loadu_ps(mask, a + i);
+        __m512 vb = _mm512_maskz_loadu_ps(mask, b + i);
+        dot = _mm512_fmadd_ps(va, vb, dot);
+        mag_a = _mm512_fmadd_ps(va, va, mag_a);
+        mag_b = _mm512_fmadd_ps(vb, vb, mag_b);
     }
+    float scalar_product = _mm512_reduce_add_ps(dot);
+    // similarity == 1-cosine distance
+    return 1.0f - (scalar_product / (sqrt(_mm512_reduce_add_ps(mag_a)) * sqrt(_mm512_reduce_add_ps(mag_b))));
 }
 
-template <> diskann::Distance<uint8_t> *get_distance_function(diskann::Metric m)
+// widens 32 bytes (fewer at the tail) to int16, signed or unsigned
+template <bool is_signed> AVX512_TARGET static inline __m512i avx512_load_widen(__mmask32 mask, const void *p)
 {
-    if (m == diskann::Metric::L2)
+    __m256i v = _mm256_maskz_loadu_epi8(mask, p);
+    return is_signed ? _mm512_cvtepi8_epi16(v) : _mm512_cvtepu8_epi16(v);
+}
+
+template <bool is_signed, bool bounded = false>
+AVX512_TARGET static inline float avx512_vnni_l2(const void *a, const void *b, uint32_t length, float bound = 0)
+{
+    const uint8_t *pa = (const uint8_t *)a, *pb = (const uint8_t *)b;
+    __m512i acc = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < length; i += 32)
     {
-#ifdef _WINDOWS
-        diskann::cout << "WARNING: AVX/AVX2 distance function not defined for Uint8. "
-                         "Using "
-                         "slow version. "
-                         "Contact gopalsr@microsoft.com if you need AVX/AVX2 support."
-                      << std::endl;
-#endif
-        return new diskann::DistanceL2UInt8();
+        __mmask32 mask = length - i >= 32 ? (__mmask32)0xffffffff : avx512_tail_mask32(length - i);
+        __m512i diff = _mm512_sub_epi16(avx512_load_widen<is_signed>(mask, pa + i),
+                                        avx512_load_widen<is_signed>(mask, pb + i));
+        acc = _mm512_dpwssd_epi32(acc, diff, diff);
+        if (bounded && (i + 32) % BOUND_CHECK_DIMS == 0 && (float)_mm512_reduce_add_epi32(acc) > bound)
+            break;
     }
-    else if (m == diskann::Metric::COSINE)
+    return (float)_mm512_reduce_add_epi32(acc);
+}
+
+template <bool is_signed>
+AVX512_TARGET static inline float avx512_vnni_cosine(const void *a, const void *b, uint32_t length)
+{
+    const uint8_t *pa = (const uint8_t *)a, *pb = (const uint8_t *)b;
+    __m512i dot = _mm512_setzero_si512();
+    __m512i mag_a = _mm512_setzero_si512();
+    __m512i mag_b = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < length; i += 32)
     {
-        diskann::cout << "AVX/AVX2 distance function not defined for Uint8. Using "
-                         "slow version SlowDistanceCosineUint8() "
-                         "Contact gopalsr@microsoft.com if you need AVX/AVX2 support."
-                      << std::endl;
-        return new diskann::SlowDistanceCosineUInt8();
+        __mmask32 mask = length - i >= 32 ? (__mmask32)0xffffffff : avx512_tail_mask32(length - i);
+        __m512i va = avx512_load_widen<is_signed>(mask, pa + i);
+        __m512i vb = avx512_load_widen<is_signed>(mask, pb + i);
+        dot = _mm512_dpwssd_epi32(dot, va, vb);
+        mag_a = _mm512_dpwssd_epi32(mag_a, va, va);
+        mag_b = _mm512_dpwssd_epi32(mag_b, vb, vb);
     }
-    else
+    int scalar_product = _mm512_reduce_add_epi32(dot);
+    // similarity == 1-cosine distance
+    return 1.0f - (float)(scalar_product /
+                          (sqrt(_mm512_reduce_add_epi32(mag_a)) * sqrt(_mm512_reduce_add_epi32(mag_b))));
+}
+
+template <bool is_signed>
+AVX512_TARGET static inline float avx512_vnni_dot(const void *a, const void *b, uint32_t length)
+{
+    const uint8_t *pa = (const uint8_t *)a, *pb = (const uint8_t *)b;
+    __m512i dot = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < length; i += 32)
     {
-        std::stringstream stream;
-        stream << "Only L2 and cosine supported for uint32_t byte vectors." << std::endl;
-        diskann::cerr << stream.str() << std::endl;
-        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        __mmask32 mask = length - i >= 32 ? (__mmask32)0xffffffff : avx512_tail_mask32(length - i);
+        dot = _mm512_dpwssd_epi32(dot, avx512_load_widen<is_signed>(mask, pa + i),
+                                  avx512_load_widen<is_signed>(mask, pb + i));
     }
+    return (float)_mm512_reduce_add_epi32(dot);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceL2Int8::compare(const int8_t *a, const int8_t *b, uint32_t length) const
+{
+    return avx512_vnni_l2<true>(a, b, length);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceL2Int8::compare_with_bound(const int8_t *a, const int8_t *b, uint32_t length,
+                                                                  float bound) const
+{
+    return avx512_vnni_l2<true, true>(a, b, length, bound);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceCosineInt8::compare(const int8_t *a, const int8_t *b, uint32_t length) const
+{
+    return avx512_vnni_cosine<true>(a, b, length);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceL2UInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return avx512_vnni_l2<false>(a, b, length);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceL2UInt8::compare_with_bound(const uint8_t *a, const uint8_t *b, uint32_t length,
+                                                                   float bound) const
+{
+    return avx512_vnni_l2<false, true>(a, b, length, bound);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceCosineUInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return avx512_vnni_cosine<false>(a, b, length);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceInnerProductInt8::compare(const int8_t *a, const int8_t *b,
+                                                                 uint32_t length) const
+{
+    return -avx512_vnni_dot<true>(a, b, length);
+}
+
+AVX512_TARGET float AVX512VNNIDistanceInnerProductUInt8::compare(const uint8_t *a, const uint8_t *b,
+                                                                  uint32_t length) const
+{
+    return -avx512_vnni_dot<false>(a, b, length);
+}
+
+#ifdef _WINDOWS
+#define AVX512_POPCNT_TARGET
+#else
+#define AVX512_POPCNT_TARGET __attribute__((target("avx512f,avx512bw,avx512vpopcntdq")))
+#endif
+
+AVX512_POPCNT_TARGET float AVX512DistanceHammingUInt8::compare(const uint8_t *a, const uint8_t *b,
+                                                               uint32_t length) const
+{
+    __m512i acc0 = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    uint32_t i = 0;
+    for (; i + 128 <= length; i += 128)
+    {
+        acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(_mm512_xor_si512(_mm512_loadu_si512(a + i),
+                                                                           _mm512_loadu_si512(b + i))));
+        acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(_mm512_xor_si512(_mm512_loadu_si512(a + i + 64),
+                                                                           _mm512_loadu_si512(b + i + 64))));
+    }
+    for (; i < length; i += 64)
+    {
+        const uint32_t n = (std::min)(length - i, 64u);
+        const __mmask64 mask = n == 64 ? ~(__mmask64)0 : (((__mmask64)1 << n) - 1);
+        acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(_mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, a + i),
+                                                                           _mm512_maskz_loadu_epi8(mask, b + i))));
+    }
+    return (float)_mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1));
+}
+#endif
+
+//
+// float16 / bfloat16 distance functions.
+//
+#ifndef USE_NEON
+#ifdef _WINDOWS
+#define AVX2_F16C_TARGET
+#define AVX512_BF16_TARGET
+#else
+#define AVX2_F16C_TARGET __attribute__((target("avx2,fma,f16c")))
+#define AVX512_BF16_TARGET __attribute__((target("avx512f,avx512bw,avx512vl,avx512bf16")))
+#endif
+
+AVX2_F16C_TARGET static inline __m256 widen8(const float16 *p)
+{
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)p));
+}
+
+AVX2_F16C_TARGET static inline __m256 widen8(const bfloat16 *p)
+{
+    __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(v, 16));
+}
+
+AVX512_TARGET static inline __m512 widen16(__mmask16 mask, const float16 *p)
+{
+    return _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(mask, p));
+}
+
+AVX512_TARGET static inline __m512 widen16(__mmask16 mask, const bfloat16 *p)
+{
+    __m512i v = _mm512_cvtepu16_epi32(_mm256_maskz_loadu_epi16(mask, p));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(v, 16));
+}
+#endif
+
+template <typename T> static float half_l2_scalar(const T *a, const T *b, uint32_t length)
+{
+    float result = 0;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        float diff = (float)a[i] - (float)b[i];
+        result += diff * diff;
+    }
+    return result;
+}
+
+template <typename T> static float half_dot_scalar(const T *a, const T *b, uint32_t length)
+{
+    float result = 0;
+    for (uint32_t i = 0; i < length; i++)
+        result += (float)a[i] * (float)b[i];
+    return result;
+}
+
+template <typename T> static float half_cosine_scalar(const T *a, const T *b, uint32_t length)
+{
+    float magA = 0, magB = 0, scalarProduct = 0;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        magA += (float)a[i] * (float)a[i];
+        magB += (float)b[i] * (float)b[i];
+        scalarProduct += (float)a[i] * (float)b[i];
+    }
+    // similarity == 1-cosine distance
+    return 1.0f - (scalarProduct / (sqrt(magA) * sqrt(magB)));
+}
+
+#ifndef USE_NEON
+template <typename T> AVX2_F16C_TARGET static float half_l2_avx2(const T *a, const T *b, uint32_t length)
+{
+    __m256 sum = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256 diff = _mm256_sub_ps(widen8(a + i), widen8(b + i));
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    return _mm256_reduce_add_ps(sum) + half_l2_scalar(a + i, b + i, length - i);
+}
+
+template <typename T> AVX2_F16C_TARGET static float half_dot_avx2(const T *a, const T *b, uint32_t length)
+{
+    __m256 sum = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 8 <= length; i += 8)
+        sum = _mm256_fmadd_ps(widen8(a + i), widen8(b + i), sum);
+    return _mm256_reduce_add_ps(sum) + half_dot_scalar(a + i, b + i, length - i);
+}
+
+template <typename T> AVX2_F16C_TARGET static float half_cosine_avx2(const T *a, const T *b, uint32_t length)
+{
+    __m256 dot = _mm256_setzero_ps(), mag_a = _mm256_setzero_ps(), mag_b = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256 va = widen8(a + i), vb = widen8(b + i);
+        dot = _mm256_fmadd_ps(va, vb, dot);
+        mag_a = _mm256_fmadd_ps(va, va, mag_a);
+        mag_b = _mm256_fmadd_ps(vb, vb, mag_b);
+    }
+    float scalarProduct = _mm256_reduce_add_ps(dot), magA = _mm256_reduce_add_ps(mag_a),
+          magB = _mm256_reduce_add_ps(mag_b);
+    for (; i < length; i++)
+    {
+        magA += (float)a[i] * (float)a[i];
+        magB += (float)b[i] * (float)b[i];
+        scalarProduct += (float)a[i] * (float)b[i];
+    }
+    return 1.0f - (scalarProduct / (sqrt(magA) * sqrt(magB)));
+}
+
+template <typename T> AVX512_TARGET static float half_l2_avx512(const T *a, const T *b, uint32_t length)
+{
+    __m512 sum = _mm512_setzero_ps();
+    for (uint32_t i = 0; i < length; i += 16)
+    {
+        __mmask16 mask = avx512_tail_mask16((std::min)(length - i, 16u));
+        __m512 diff = _mm512_sub_ps(widen16(mask, a + i), widen16(mask, b + i));
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    return _mm512_reduce_add_ps(sum);
+}
+
+template <typename T> AVX512_TARGET static float half_dot_avx512(const T *a, const T *b, uint32_t length)
+{
+    __m512 sum = _mm512_setzero_ps();
+    for (uint32_t i = 0; i < length; i += 16)
+    {
+        __mmask16 mask = avx512_tail_mask16((std::min)(length - i, 16u));
+        sum = _mm512_fmadd_ps(widen16(mask, a + i), widen16(mask, b + i), sum);
+    }
+    return _mm512_reduce_add_ps(sum);
+}
+
+template <typename T> AVX512_TARGET static float half_cosine_avx512(const T *a, const T *b, uint32_t length)
+{
+    __m512 dot = _mm512_setzero_ps(), mag_a = _mm512_setzero_ps(), mag_b = _mm512_setzero_ps();
+    for (uint32_t i = 0; i < length; i += 16)
+    {
+        __mmask16 mask = avx512_tail_mask16((std::min)(length - i, 16u));
+        __m512 va = widen16(mask, a + i), vb = widen16(mask, b + i);
+        dot = _mm512_fmadd_ps(va, vb, dot);
+        mag_a = _mm512_fmadd_ps(va, va, mag_a);
+        mag_b = _mm512_fmadd_ps(vb, vb, mag_b);
+    }
+    float scalarProduct = _mm512_reduce_add_ps(dot);
+    return 1.0f - (scalarProduct / (sqrt(_mm512_reduce_add_ps(mag_a)) * sqrt(_mm512_reduce_add_ps(mag_b))));
+}
+
+#ifdef __GNUC__
+// vdpbf16ps multiplies pairs of bfloat16 exactly and accumulates in float
+AVX512_BF16_TARGET static float bf16_dot_avx512bf16(const bfloat16 *a, const bfloat16 *b, uint32_t length)
+{
+    __m512 sum = _mm512_setzero_ps();
+    for (uint32_t i = 0; i < length; i += 32)
+    {
+        __mmask32 mask = length - i >= 32 ? (__mmask32)0xffffffff : avx512_tail_mask32(length - i);
+        __m512i va = _mm512_maskz_loadu_epi16(mask, a + i);
+        __m512i vb = _mm512_maskz_loadu_epi16(mask, b + i);
+        sum = _mm512_dpbf16_ps(sum, (__m512bh)va, (__m512bh)vb);
+    }
+    return _mm512_reduce_add_ps(sum);
+}
+
+AVX512_BF16_TARGET static float bf16_cosine_avx512bf16(const bfloat16 *a, const bfloat16 *b, uint32_t length)
+{
+    __m512 dot = _mm512_setzero_ps(), mag_a = _mm512_setzero_ps(), mag_b = _mm512_setzero_ps();
+    for (uint32_t i = 0; i < length; i += 32)
+    {
+        __mmask32 mask = length - i >= 32 ? (__mmask32)0xffffffff : avx512_tail_mask32(length - i);
+        __m512bh va = (__m512bh)_mm512_maskz_loadu_epi16(mask, a + i);
+        __m512bh vb = (__m512bh)_mm512_maskz_loadu_epi16(mask, b + i);
+        dot = _mm512_dpbf16_ps(dot, va, vb);
+        mag_a = _mm512_dpbf16_ps(mag_a, va, va);
+        mag_b = _mm512_dpbf16_ps(mag_b, vb, vb);
+    }
+    float scalarProduct = _mm512_reduce_add_ps(dot);
+    return 1.0f - (scalarProduct / (sqrt(_mm512_reduce_add_ps(mag_a)) * sqrt(_mm512_reduce_add_ps(mag_b))));
+}
+#endif
+#else
+static inline float32x4_t neon_widen4(const float16 *p)
+{
+    return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t *)p)));
+}
+
+// a bfloat16 is the upper half of a float
+static inline float32x4_t neon_widen4(const bfloat16 *p)
+{
+    return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16((const uint16_t *)p), 16));
+}
+
+template <typename T> static float half_l2_neon(const T *a, const T *b, uint32_t length)
+{
+    float32x4_t sum = vdupq_n_f32(0);
+    uint32_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        float32x4_t diff = vsubq_f32(neon_widen4(a + i), neon_widen4(b + i));
+        sum = vfmaq_f32(sum, diff, diff);
+    }
+    return vaddvq_f32(sum) + half_l2_scalar(a + i, b + i, length - i);
+}
+
+template <typename T> static float half_dot_neon(const T *a, const T *b, uint32_t length)
+{
+    float32x4_t sum = vdupq_n_f32(0);
+    uint32_t i = 0;
+    for (; i + 4 <= length; i += 4)
+        sum = vfmaq_f32(sum, neon_widen4(a + i), neon_widen4(b + i));
+    return vaddvq_f32(sum) + half_dot_scalar(a + i, b + i, length - i);
+}
+
+template <typename T> static float half_cosine_neon(const T *a, const T *b, uint32_t length)
+{
+    float32x4_t dot = vdupq_n_f32(0), mag_a = vdupq_n_f32(0), mag_b = vdupq_n_f32(0);
+    uint32_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        float32x4_t va = neon_widen4(a + i), vb = neon_widen4(b + i);
+        dot = vfmaq_f32(dot, va, vb);
+        mag_a = vfmaq_f32(mag_a, va, va);
+        mag_b = vfmaq_f32(mag_b, vb, vb);
+    }
+    float scalarProduct = vaddvq_f32(dot), magA = vaddvq_f32(mag_a), magB = vaddvq_f32(mag_b);
+    for (; i < length; i++)
+    {
+        magA += (float)a[i] * (float)a[i];
+        magB += (float)b[i] * (float)b[i];
+        scalarProduct += (float)a[i] * (float)b[i];
+    }
+    return 1.0f - (scalarProduct / (sqrt(magA) * sqrt(magB)));
+}
+#endif
+
+template <typename T> DistanceL2Half<T>::DistanceL2Half() : Distance<T>(diskann::Metric::L2)
+{
+#ifdef USE_NEON
+    _kernel = half_l2_neon<T>;
+#else
+    if (Avx512SupportedCPU)
+        _kernel = half_l2_avx512<T>;
+    else if (Avx2SupportedCPU)
+        _kernel = half_l2_avx2<T>;
+    else
+        _kernel = half_l2_scalar<T>;
+#endif
+}
+
+template <typename T>
+DistanceInnerProductHalf<T>::DistanceInnerProductHalf() : Distance<T>(diskann::Metric::INNER_PRODUCT)
+{
+#ifdef USE_NEON
+    _kernel = half_dot_neon<T>;
+#else
+#ifdef __GNUC__
+    if constexpr (std::is_same<T, bfloat16>::value)
+    {
+        if (Avx512Bf16SupportedCPU)
+        {
+            _kernel = bf16_dot_avx512bf16;
+            return;
+        }
+    }
+#endif
+    if (Avx512SupportedCPU)
+        _kernel = half_dot_avx512<T>;
+    else if (Avx2SupportedCPU)
+        _kernel = half_dot_avx2<T>;
+    else
+        _kernel = half_dot_scalar<T>;
+#endif
+}
+
+template <typename T> DistanceCosineHalf<T>::DistanceCosineHalf() : Distance<T>(diskann::Metric::COSINE)
+{
+#ifdef USE_NEON
+    _kernel = half_cosine_neon<T>;
+#else
+#ifdef __GNUC__
+    if constexpr (std::is_same<T, bfloat16>::value)
+    {
+        if (Avx512Bf16SupportedCPU)
+        {
+            _kernel = bf16_cosine_avx512bf16;
+            return;
+        }
+    }
+#endif
+    if (Avx512SupportedCPU)
+        _kernel = half_cosine_avx512<T>;
+    else if (Avx2SupportedCPU)
+        _kernel = half_cosine_avx2<T>;
+    else
+        _kernel = half_cosine_scalar<T>;
+#endif
+}
+
+template <typename T> static diskann::Distance<T> *get_half_distance_function(diskann::Metric m)
+{
+    if (m == diskann::Metric::L2)
+    {
+        diskann::cout << "L2: Using " << diskann_type_to_name<T>() << " distance computation DistanceL2Half"
+                      << std::endl;
+        return new diskann::DistanceL2Half<T>();
+    }
+    else if (m == diskann::Metric::INNER_PRODUCT)
+    {
+        diskann::cout << "Inner product: Using " << diskann_type_to_name<T>()
+                      << " distance computation DistanceInnerProductHalf" << std::endl;
+        return new diskann::DistanceInnerProductHalf<T>();
+    }
+    else if (m == diskann::Metric::COSINE)
+    {
+        diskann::cout << "Cosine: Using " << diskann_type_to_name<T>() << " distance computation DistanceCosineHalf"
+                      << std::endl;
+        return new diskann::DistanceCosineHalf<T>();
+    }
+    else
+    {
+        std::stringstream stream;
+        stream << "Only L2, cosine, and inner product supported for " << diskann_type_to_name<T>() << " vectors."
+               << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+}
+
+//
+// Fixed-dimension kernels. The dimension is a template argument, so the block
+// loop is expanded at compile time into straight-line code with four
+// independent accumulators.
+//
+#ifdef USE_AVX2
+template <uint32_t I> static inline void l2_block(const float *a, const float *b, __m256 (&acc)[4])
+{
+    __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + 8 * I), _mm256_loadu_ps(b + 8 * I));
+    acc[I % 4] = _mm256_fmadd_ps(diff, diff, acc[I % 4]);
+}
+
+template <uint32_t I> static inline void ip_block(const float *a, const float *b, __m256 (&acc)[4])
+{
+    acc[I % 4] = _mm256_fmadd_ps(_mm256_loadu_ps(a + 8 * I), _mm256_loadu_ps(b + 8 * I), acc[I % 4]);
+}
+
+static inline float sum_accumulators(const __m256 (&acc)[4])
+{
+    return _mm256_reduce_add_ps(_mm256_add_ps(_mm256_add_ps(acc[0], acc[1]), _mm256_add_ps(acc[2], acc[3])));
+}
+
+template <uint32_t... I>
+static inline float l2_blocks(const float *a, const float *b, std::integer_sequence<uint32_t, I...>)
+{
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    (l2_block<I>(a, b, acc), ...);
+    return sum_accumulators(acc);
+}
+
+// l2_blocks() with the partial sum checked against the bound every
+// BOUND_CHECK_DIMS dimensions; the blocks go into the same accumulators in
+// the same order, so a distance within the bound is the same to the bit
+template <uint32_t... I>
+static inline float l2_blocks_with_bound(const float *a, const float *b, float bound,
+                                         std::integer_sequence<uint32_t, I...>)
+{
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    // stops at the first block after which the check fails
+    (void)((l2_block<I>(a, b, acc), (8 * (I + 1)) % BOUND_CHECK_DIMS != 0 || sum_accumulators(acc) <= bound) && ...);
+    return sum_accumulators(acc);
+}
+
+template <uint32_t... I>
+static inline float ip_blocks(const float *a, const float *b, std::integer_sequence<uint32_t, I...>)
+{
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    (ip_block<I>(a, b, acc), ...);
+    return sum_accumulators(acc);
+}
+
+template <uint32_t DIM> struct L2FloatFixed
+{
+    static_assert(DIM % 8 == 0, "fixed-dimension kernels work on whole 8-float blocks");
+    static float compare(const float *a, const float *b)
+    {
+        return l2_blocks(a, b, std::make_integer_sequence<uint32_t, DIM / 8>());
+    }
+};
+
+template <uint32_t DIM> struct L2FloatFixedBounded
+{
+    static_assert(DIM % 8 == 0, "fixed-dimension kernels work on whole 8-float blocks");
+    static float compare(const float *a, const float *b, float bound)
+    {
+        return l2_blocks_with_bound(a, b, bound, std::make_integer_sequence<uint32_t, DIM / 8>());
+    }
+};
+
+// negated, as for the other inner product distances
+template <uint32_t DIM> struct InnerProductFloatFixed
+{
+    static_assert(DIM % 8 == 0, "fixed-dimension kernels work on whole 8-float blocks");
+    static float compare(const float *a, const float *b)
+    {
+        return -ip_blocks(a, b, std::make_integer_sequence<uint32_t, DIM / 8>());
+    }
+};
+
+template <template <uint32_t> class Kernel, typename Fn = FixedDimDistanceFn<float>>
+static Fn pick_fixed_dim_kernel(uint32_t dim)
+{
+    switch (dim)
+    {
+    case 96:
+        return &Kernel<96>::compare;
+    case 104: // 100, padded
+        return &Kernel<104>::compare;
+    case 128:
+        return &Kernel<128>::compare;
+    case 384:
+        return &Kernel<384>::compare;
+    case 768:
+        return &Kernel<768>::compare;
+    case 1536:
+        return &Kernel<1536>::compare;
+    default:
+        return nullptr;
+    }
+}
+#endif
+
+//
+// Four-point kernels: each block of the query is loaded once and applied to
+// four vectors, which keeps four independent accumulation chains in flight.
+//
+#ifdef USE_AVX2
+template <bool InnerProduct>
+static void float_batch4_distance(const float *query, const float *const *points, uint32_t length, float *distances)
+{
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+    uint32_t d = 0;
+    for (; d + 8 <= length; d += 8)
+    {
+        __m256 q = _mm256_loadu_ps(query + d);
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            __m256 p = _mm256_loadu_ps(points[j] + d);
+            if (InnerProduct)
+            {
+                acc[j] = _mm256_fmadd_ps(q, p, acc[j]);
+            }
+            else
+            {
+                __m256 diff = _mm256_sub_ps(q, p);
+                acc[j] = _mm256_fmadd_ps(diff, diff, acc[j]);
+            }
+        }
+    }
+    for (uint32_t j = 0; j < 4; j++)
+    {
+        float result = _mm256_reduce_add_ps(acc[j]);
+        for (uint32_t i = d; i < length; i++)
+        {
+            result += InnerProduct ? query[i] * points[j][i] : (query[i] - points[j][i]) * (query[i] - points[j][i]);
+        }
+        distances[j] = InnerProduct ? -result : result;
+    }
+}
+#endif
+
+template <typename T> Batch4DistanceFn<T> get_batch4_distance_function(Metric m)
+{
+    return nullptr;
+}
+
+template <> Batch4DistanceFn<float> get_batch4_distance_function(Metric m)
+{
+#ifdef USE_AVX2
+    if (!Avx2SupportedCPU)
+        return nullptr;
+    if (m == diskann::Metric::L2)
+        return &float_batch4_distance<false>;
+    if (m == diskann::Metric::INNER_PRODUCT)
+        return &float_batch4_distance<true>;
+#endif
+    return nullptr;
+}
+
+//
+// Distances between a float query and byte vectors. The bytes are widened
+// to float, eight at a time under AVX2 and NEON.
+//
+
+enum class MixedKind
+{
+    L2,
+    InnerProduct,
+    Cosine
+};
+
+template <typename T, MixedKind kind> static float mixed_distance(const float *query, const T *b, uint32_t length)
+{
+    float sum = 0, sq_q = 0, sq_b = 0;
+    uint32_t i = 0;
+#ifdef USE_AVX2
+    __m256 sum_acc = _mm256_setzero_ps();
+    __m256 q_acc = _mm256_setzero_ps();
+    __m256 b_acc = _mm256_setzero_ps();
+    for (; i + 8 <= length; i += 8)
+    {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)(b + i));
+        __m256i wide = std::is_same<T, int8_t>::value ? _mm256_cvtepi8_epi32(bytes) : _mm256_cvtepu8_epi32(bytes);
+        __m256 vb = _mm256_cvtepi32_ps(wide);
+        __m256 vq = _mm256_loadu_ps(query + i);
+        if (kind == MixedKind::L2)
+        {
+            __m256 diff = _mm256_sub_ps(vq, vb);
+            sum_acc = _mm256_fmadd_ps(diff, diff, sum_acc);
+        }
+        else
+        {
+            sum_acc = _mm256_fmadd_ps(vq, vb, sum_acc);
+        }
+        if (kind == MixedKind::Cosine)
+        {
+            q_acc = _mm256_fmadd_ps(vq, vq, q_acc);
+            b_acc = _mm256_fmadd_ps(vb, vb, b_acc);
+        }
+    }
+    sum = _mm256_reduce_add_ps(sum_acc);
+    if (kind == MixedKind::Cosine)
+    {
+        sq_q = _mm256_reduce_add_ps(q_acc);
+        sq_b = _mm256_reduce_add_ps(b_acc);
+    }
+#elif defined(USE_NEON)
+    float32x4_t sum_acc = vdupq_n_f32(0);
+    float32x4_t q_acc = vdupq_n_f32(0);
+    float32x4_t b_acc = vdupq_n_f32(0);
+    for (; i + 8 <= length; i += 8)
+    {
+        int16x8_t wide = std::is_same<T, int8_t>::value
+                             ? vmovl_s8(vld1_s8((const int8_t *)(b + i)))
+                             : vreinterpretq_s16_u16(vmovl_u8(vld1_u8((const uint8_t *)(b + i))));
+        const float32x4_t halves[2] = {vcvtq_f32_s32(vmovl_s16(vget_low_s16(wide))),
+                                       vcvtq_f32_s32(vmovl_high_s16(wide))};
+        for (uint32_t h = 0; h < 2; h++)
+        {
+            float32x4_t vb = halves[h];
+            float32x4_t vq = vld1q_f32(query + i + 4 * h);
+            if (kind == MixedKind::L2)
+            {
+                float32x4_t diff = vsubq_f32(vq, vb);
+                sum_acc = vfmaq_f32(sum_acc, diff, diff);
+            }
+            else
+            {
+                sum_acc = vfmaq_f32(sum_acc, vq, vb);
+            }
+            if (kind == MixedKind::Cosine)
+            {
+                q_acc = vfmaq_f32(q_acc, vq, vq);
+                b_acc = vfmaq_f32(b_acc, vb, vb);
+            }
+        }
+    }
+    sum = vaddvq_f32(sum_acc);
+    if (kind == MixedKind::Cosine)
+    {
+        sq_q = vaddvq_f32(q_acc);
+        sq_b = vaddvq_f32(b_acc);
+    }
+#endif
+    for (; i < length; i++)
+    {
+        const float vb = (float)b[i];
+        if (kind == MixedKind::L2)
+            sum += (query[i] - vb) * (query[i] - vb);
+        else
+            sum += query[i] * vb;
+        if (kind == MixedKind::Cosine)
+        {
+            sq_q += query[i] * query[i];
+            sq_b += vb * vb;
+        }
+    }
+    if (kind == MixedKind::InnerProduct)
+        return -sum;
+    if (kind == MixedKind::Cosine)
+        return 1.0f - sum / (std::sqrt(sq_q) * std::sqrt(sq_b));
+    return sum;
+}
+
+template <typename T> MixedDistanceFn<T> get_mixed_distance_function(Metric m)
+{
+    return nullptr;
+}
+
+template <typename T> static MixedDistanceFn<T> get_byte_mixed_distance_function(Metric m)
+{
+    if (m == diskann::Metric::L2)
+        return &mixed_distance<T, MixedKind::L2>;
+    if (m == diskann::Metric::INNER_PRODUCT)
+        return &mixed_distance<T, MixedKind::InnerProduct>;
+    if (m == diskann::Metric::COSINE)
+        return &mixed_distance<T, MixedKind::Cosine>;
+    return nullptr;
+}
+
+template <> MixedDistanceFn<int8_t> get_mixed_distance_function(Metric m)
+{
+    return get_byte_mixed_distance_function<int8_t>(m);
+}
+
+template <> MixedDistanceFn<uint8_t> get_mixed_distance_function(Metric m)
+{
+    return get_byte_mixed_distance_function<uint8_t>(m);
+}
+
+template <typename T> FixedDimDistanceFn<T> get_fixed_dim_distance_function(Metric m, uint32_t dim)
+{
+    return nullptr;
+}
+
+template <> FixedDimDistanceFn<float> get_fixed_dim_distance_function(Metric m, uint32_t dim)
+{
+#ifdef USE_AVX2
+    if (!Avx2SupportedCPU)
+        return nullptr;
+    if (m == diskann::Metric::L2)
+        return pick_fixed_dim_kernel<L2FloatFixed>(dim);
+    if (m == diskann::Metric::INNER_PRODUCT)
+        return pick_fixed_dim_kernel<InnerProductFloatFixed>(dim);
+#endif
+    return nullptr;
+}
+
+template <typename T> FixedDimBoundedDistanceFn<T> get_fixed_dim_bounded_distance_function(Metric m, uint32_t dim)
+{
+    return nullptr;
+}
+
+template <>
+FixedDimBoundedDistanceFn<float> get_fixed_dim_bounded_distance_function(Metric m, uint32_t dim)
+{
+#ifdef USE_AVX2
+    if (!Avx2SupportedCPU)
+        return nullptr;
+    if (m == diskann::Metric::L2)
+        return pick_fixed_dim_kernel<L2FloatFixedBounded, FixedDimBoundedDistanceFn<float>>(dim);
+#endif
+    return nullptr;
+}
+
+#ifdef USE_NEON
+// AArch64 has none of the AVX classes. The portable classes run NEON kernels
+// there, and CPUs with SVE get the classes of distance_sve.cpp instead.
+template <typename T, typename L2, typename Cosine, typename InnerProduct>
+static diskann::Distance<T> *get_arm_distance_function(diskann::Metric m, const char *isa)
+{
+    if (m == diskann::Metric::L2)
+    {
+        diskann::cout << "L2: Using " << isa << " distance computation for " << diskann_type_to_name<T>() << std::endl;
+        return new L2();
+    }
+    else if (m == diskann::Metric::COSINE)
+    {
+        diskann::cout << "Cosine: Using " << isa << " distance computation for " << diskann_type_to_name<T>()
+                      << std::endl;
+        return new Cosine();
+    }
+    else if (m == diskann::Metric::INNER_PRODUCT)
+    {
+        diskann::cout << "Inner product: Using " << isa << " distance computation for " << diskann_type_to_name<T>()
+                      << std::endl;
+        return new InnerProduct();
+    }
+    std::stringstream stream;
+    stream << "Only L2, cosine and inner product supported for " << diskann_type_to_name<T>() << " vectors."
+           << std::endl;
+    diskann::cerr << stream.str() << std::endl;
+    throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+#endif
+
+template <> diskann::Distance<float16> *get_distance_function(diskann::Metric m)
+{
+    return get_half_distance_function<float16>(m);
+}
+
+template <> diskann::Distance<bfloat16> *get_distance_function(diskann::Metric m)
+{
+    return get_half_distance_function<bfloat16>(m);
+}
+
+// Get the right distance function for the given metric.
+template <> diskann::Distance<float> *get_distance_function(diskann::Metric m)
+{
+#ifdef USE_NEON
+    if (m == diskann::Metric::FAST_L2)
+    {
+        diskann::cout << "Fast_L2: Using NEON implementation with norm memoization DistanceFastL2<float>" << std::endl;
+        return new diskann::DistanceFastL2<float>();
+    }
+#ifdef DISKANN_HAS_SVE
+    if (SveSupportedCPU)
+        return get_arm_distance_function<float, SVEDistanceL2Float, SVEDistanceCosineFloat,
+                                         SVEDistanceInnerProductFloat>(m, "SVE");
+#endif
+    return get_arm_distance_function<float, DistanceL2Float, DistanceCosineFloat, AVXDistanceInnerProductFloat>(
+        m, "NEON");
+#else
+    if (m == diskann::Metric::L2)
+    {
+        if (Avx512SupportedCPU)
+        {
+            diskann::cout << "L2: Using AVX-512 distance computation AVX512DistanceL2Float" << std::endl;
+            return new diskann::AVX512DistanceL2Float();
+        }
+        else if (Avx2SupportedCPU)
+        {
+            diskann::cout << "L2: Using AVX2 distance computation DistanceL2Float" << std::endl;
+            return new diskann::DistanceL2Float();
+        }
+        else if (AvxSupportedCPU)
+        {
+            diskann::cout << "L2: AVX2 not supported. Using AVX distance computation" << std::endl;
+            return new diskann::AVXDistanceL2Float();
+        }
+        else
+        {
+            diskann::cout << "L2: Older CPU. Using slow distance computation" << std::endl;
+            return new diskann::SlowDistanceL2<float>();
+        }
+    }
+    else if (m == diskann::Metric::COSINE)
+    {
+        if (Avx512SupportedCPU)
+        {
+            diskann::cout << "Cosine: Using AVX-512 implementation AVX512DistanceCosineFloat" << std::endl;
+            return new diskann::AVX512DistanceCosineFloat();
+        }
+        diskann::cout << "Cosine: Using either AVX or AVX2 implementation" << std::endl;
+        return new diskann::DistanceCosineFloat();
+    }
+    else if (m == diskann::Metric::INNER_PRODUCT)
+    {
+        if (Avx512SupportedCPU)
+        {
+            diskann::cout << "Inner product: Using AVX-512 implementation AVX512DistanceInnerProductFloat"
+                          << std::endl;
+            return new diskann::AVX512DistanceInnerProductFloat();
+        }
+        diskann::cout << "Inner product: Using AVX2 implementation "
+                         "AVXDistanceInnerProductFloat"
+                      << std::endl;
+        return new diskann::AVXDistanceInnerProductFloat();
+    }
+    else if (m == diskann::Metric::FAST_L2)
+    {
+        diskann::cout << "Fast_L2: Using AVX2 implementation with norm "
+                         "memoization DistanceFastL2<float>"
+                      << std::endl;
+        return new diskann::DistanceFastL2<float>();
+    }
+    else
+    {
+        std::stringstream stream;
+        stream << "Only L2, cosine, and inner product supported for floating "
+                  "point vectors as of now."
+               << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#endif
+}
+
+template <> diskann::Distance<int8_t> *get_distance_function(diskann::Metric m)
+{
+#ifdef USE_NEON
+#ifdef DISKANN_HAS_SVE
+    if (SveSupportedCPU)
+        return get_arm_distance_function<int8_t, SVEDistanceL2Int8, SVEDistanceCosineInt8,
+                                         SVEDistanceInnerProductInt8>(m, "SVE");
+#endif
+    return get_arm_distance_function<int8_t, DistanceL2Int8, DistanceCosineInt8, DistanceInnerProductInt8>(m,
+                                                                                                           "NEON");
+#else
+    if (m == diskann::Metric::L2)
+    {
+        if (Avx512VnniSupportedCPU)
+        {
+            diskann::cout << "Using AVX-512 VNNI distance computation AVX512VNNIDistanceL2Int8." << std::endl;
+            return new diskann::AVX512VNNIDistanceL2Int8();
+        }
+        else if (Avx2SupportedCPU)
+        {
+            diskann::cout << "Using AVX2 distance computation DistanceL2Int8." << std::endl;
+            return new diskann::DistanceL2Int8();
+        }
+        else if (AvxSupportedCPU)
+        {
+            diskann::cout << "AVX2 not supported. Using AVX distance computation" << std::endl;
+            return new diskann::AVXDistanceL2Int8();
+        }
+        else
+        {
+            diskann::cout << "Older CPU. Using slow distance computation "
+                             "SlowDistanceL2Int<int8_t>."
+                          << std::endl;
+            return new diskann::SlowDistanceL2<int8_t>();
+        }
+    }
+    else if (m == diskann::Metric::COSINE)
+    {
+        if (Avx512VnniSupportedCPU)
+        {
+            diskann::cout << "Using AVX-512 VNNI for Cosine similarity AVX512VNNIDistanceCosineInt8." << std::endl;
+            return new diskann::AVX512VNNIDistanceCosineInt8();
+        }
+        diskann::cout << "Using either AVX or AVX2 for Cosine similarity "
+                         "DistanceCosineInt8."
+                      << std::endl;
+        return new diskann::DistanceCosineInt8();
+    }
+    else if (m == diskann::Metric::INNER_PRODUCT)
+    {
+        if (Avx512VnniSupportedCPU)
+        {
+            diskann::cout << "Using AVX-512 VNNI for inner product AVX512VNNIDistanceInnerProductInt8." << std::endl;
+            return new diskann::AVX512VNNIDistanceInnerProductInt8();
+        }
+        diskann::cout << "Using AVX2 for inner product DistanceInnerProductInt8." << std::endl;
+        return new diskann::DistanceInnerProductInt8();
+    }
+    else
+    {
+        std::stringstream stream;
+        stream << "Only L2, cosine and inner product supported for signed byte vectors." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#endif
+}
+
+template <> diskann::Distance<uint8_t> *get_distance_function(diskann::Metric m)
+{
+    if (m == diskann::Metric::HAMMING)
+    {
+#ifndef USE_NEON
+        if (Avx512PopcntSupportedCPU)
+        {
+            diskann::cout << "Hamming: Using AVX-512 VPOPCNTDQ implementation AVX512DistanceHammingUInt8" << std::endl;
+            return new diskann::AVX512DistanceHammingUInt8();
+        }
+#endif
+        diskann::cout << "Hamming: Using DistanceHammingUInt8" << std::endl;
+        return new diskann::DistanceHammingUInt8();
+    }
+#ifdef USE_NEON
+#ifdef DISKANN_HAS_SVE
+    if (SveSupportedCPU)
+        return get_arm_distance_function<uint8_t, SVEDistanceL2UInt8, SVEDistanceCosineUInt8,
+                                         SVEDistanceInnerProductUInt8>(m, "SVE");
+#endif
+    return get_arm_distance_function<uint8_t, DistanceL2UInt8, DistanceCosineUInt8, DistanceInnerProductUInt8>(
+        m, "NEON");
+#else
+    if (m == diskann::Metric::L2)
+    {
+        if (Avx512VnniSupportedCPU)
+        {
+            diskann::cout << "Using AVX-512 VNNI distance computation AVX512VNNIDistanceL2UInt8." << std::endl;
+            return new diskann::AVX512VNNIDistanceL2UInt8();
+        }
+#ifdef _WINDOWS
+        diskann::cout << "WARNING: AVX/AVX2 distance function not defined for Uint8. "
+                         "Using "
+                         "slow version. "
+                         "Contact gopalsr@microsoft.com if you need AVX/AVX2 support."
+                      << std::endl;
+#endif
+        return new diskann::DistanceL2UInt8();
+    }
+    else if (m == diskann::Metric::COSINE)
+    {
+        if (Avx512VnniSupportedCPU)
+        {
+            diskann::cout << "Using AVX-512 VNNI for Cosine similarity AVX512VNNIDistanceCosineUInt8." << std::endl;
+            return new diskann::AVX512VNNIDistanceCosineUInt8();
+        }
+        diskann::cout << "Using AVX2 for Cosine similarity DistanceCosineUInt8." << std::endl;
+        return new diskann::DistanceCosineUInt8();
+    }
+    else if (m == diskann::Metric::INNER_PRODUCT)
+    {
+        if (Avx512VnniSupportedCPU)
+        {
+            diskann::cout << "Using AVX-512 VNNI for inner product AVX512VNNIDistanceInnerProductUInt8." << std::endl;
+            return new diskann::AVX512VNNIDistanceInnerProductUInt8();
+        }
+        diskann::cout << "Using AVX2 for inner product DistanceInnerProductUInt8." << std::endl;
+        return new diskann::DistanceInnerProductUInt8();
+    }
+    else
+    {
+        std::stringstream stream;
+        stream << "Only L2, cosine, inner product and Hamming supported for unsigned byte vectors." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#endif
 }
 
 template DISKANN_DLLEXPORT class DistanceInnerProduct<float>;
 template DISKANN_DLLEXPORT class DistanceInnerProduct<int8_t>;
 template DISKANN_DLLEXPORT class DistanceInnerProduct<uint8_t>;
+template DISKANN_DLLEXPORT class DistanceInnerProduct<float16>;
+template DISKANN_DLLEXPORT class DistanceInnerProduct<bfloat16>;
 
 template DISKANN_DLLEXPORT class DistanceFastL2<float>;
 template DISKANN_DLLEXPORT class DistanceFastL2<int8_t>;
 template DISKANN_DLLEXPORT class DistanceFastL2<uint8_t>;
+template DISKANN_DLLEXPORT class DistanceFastL2<float16>;
+template DISKANN_DLLEXPORT class DistanceFastL2<bfloat16>;
 
 template DISKANN_DLLEXPORT class SlowDistanceL2<float>;
 template DISKANN_DLLEXPORT class SlowDistanceL2<int8_t>;
@@ -729,5 +2080,43 @@ template DISKANN_DLLEXPORT class SlowDistanceL2<uint8_t>;
 template DISKANN_DLLEXPORT Distance<float> *get_distance_function(Metric m);
 template DISKANN_DLLEXPORT Distance<int8_t> *get_distance_function(Metric m);
 template DISKANN_DLLEXPORT Distance<uint8_t> *get_distance_function(Metric m);
+template DISKANN_DLLEXPORT Distance<float16> *get_distance_function(Metric m);
+template DISKANN_DLLEXPORT Distance<bfloat16> *get_distance_function(Metric m);
+
+template DISKANN_DLLEXPORT FixedDimDistanceFn<float> get_fixed_dim_distance_function(Metric m, uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimDistanceFn<int8_t> get_fixed_dim_distance_function(Metric m, uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimDistanceFn<uint8_t> get_fixed_dim_distance_function(Metric m, uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimDistanceFn<float16> get_fixed_dim_distance_function(Metric m, uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimDistanceFn<bfloat16> get_fixed_dim_distance_function(Metric m, uint32_t dim);
+
+template DISKANN_DLLEXPORT FixedDimBoundedDistanceFn<float> get_fixed_dim_bounded_distance_function(Metric m,
+                                                                                                    uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimBoundedDistanceFn<int8_t> get_fixed_dim_bounded_distance_function(Metric m,
+                                                                                                     uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimBoundedDistanceFn<uint8_t> get_fixed_dim_bounded_distance_function(Metric m,
+                                                                                                      uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimBoundedDistanceFn<float16> get_fixed_dim_bounded_distance_function(Metric m,
+                                                                                                      uint32_t dim);
+template DISKANN_DLLEXPORT FixedDimBoundedDistanceFn<bfloat16> get_fixed_dim_bounded_distance_function(Metric m,
+                                                                                                       uint32_t dim);
+
+template DISKANN_DLLEXPORT Batch4DistanceFn<float> get_batch4_distance_function(Metric m);
+template DISKANN_DLLEXPORT Batch4DistanceFn<int8_t> get_batch4_distance_function(Metric m);
+template DISKANN_DLLEXPORT Batch4DistanceFn<uint8_t> get_batch4_distance_function(Metric m);
+template DISKANN_DLLEXPORT Batch4DistanceFn<float16> get_batch4_distance_function(Metric m);
+template DISKANN_DLLEXPORT Batch4DistanceFn<bfloat16> get_batch4_distance_function(Metric m);
+
+template DISKANN_DLLEXPORT MixedDistanceFn<float> get_mixed_distance_function(Metric m);
+template DISKANN_DLLEXPORT MixedDistanceFn<int8_t> get_mixed_distance_function(Metric m);
+template DISKANN_DLLEXPORT MixedDistanceFn<uint8_t> get_mixed_distance_function(Metric m);
+template DISKANN_DLLEXPORT MixedDistanceFn<float16> get_mixed_distance_function(Metric m);
+template DISKANN_DLLEXPORT MixedDistanceFn<bfloat16> get_mixed_distance_function(Metric m);
+
+template DISKANN_DLLEXPORT class DistanceL2Half<float16>;
+template DISKANN_DLLEXPORT class DistanceL2Half<bfloat16>;
+template DISKANN_DLLEXPORT class DistanceInnerProductHalf<float16>;
+template DISKANN_DLLEXPORT class DistanceInnerProductHalf<bfloat16>;
+template DISKANN_DLLEXPORT class DistanceCosineHalf<float16>;
+template DISKANN_DLLEXPORT class DistanceCosineHalf<bfloat16>;
 
 } // namespace diskann
@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+// SVE distance kernels. This file alone is compiled for SVE (see
+// src/CMakeLists.txt), so nothing here may run before get_distance_function()
+// has checked SveSupportedCPU.
+
+#include <algorithm>
+#include <arm_sve.h>
+#include <cmath>
+
+#include "distance.h"
+
+namespace diskann
+{
+// checked every this many dimensions, as by the other bounded kernels
+static const uint32_t SVE_BOUND_CHECK_DIMS = 64;
+
+template <bool bounded> static inline float sve_l2_float(const float *a, const float *b, uint32_t length, float bound)
+{
+    svfloat32_t sum = svdup_n_f32(0);
+    for (uint32_t start = 0; start < length; start += SVE_BOUND_CHECK_DIMS)
+    {
+        const uint32_t end = (std::min)(length, start + SVE_BOUND_CHECK_DIMS);
+        for (uint32_t i = start; i < end; i += (uint32_t)svcntw())
+        {
+            const svbool_t pg = svwhilelt_b32(i, end);
+            const svfloat32_t diff = svsub_f32_x(pg, svld1_f32(pg, a + i), svld1_f32(pg, b + i));
+            sum = svmla_f32_m(pg, sum, diff, diff);
+        }
+        if (bounded && end < length && svaddv_f32(svptrue_b32(), sum) > bound)
+            break;
+    }
+    return svaddv_f32(svptrue_b32(), sum);
+}
+
+static inline float sve_dot_float(const float *a, const float *b, uint32_t length)
+{
+    svfloat32_t sum = svdup_n_f32(0);
+    for (uint32_t i = 0; i < length; i += (uint32_t)svcntw())
+    {
+        const svbool_t pg = svwhilelt_b32(i, length);
+        sum = svmla_f32_m(pg, sum, svld1_f32(pg, a + i), svld1_f32(pg, b + i));
+    }
+    return svaddv_f32(svptrue_b32(), sum);
+}
+
+float SVEDistanceL2Float::compare(const float *a, const float *b, uint32_t length) const
+{
+    return sve_l2_float<false>(a, b, length, 0);
+}
+
+float SVEDistanceL2Float::compare_with_bound(const float *a, const float *b, uint32_t length, float bound) const
+{
+    return sve_l2_float<true>(a, b, length, bound);
+}
+
+float SVEDistanceInnerProductFloat::compare(const float *a, const float *b, uint32_t length) const
+{
+    return -sve_dot_float(a, b, length);
+}
+
+float SVEDistanceCosineFloat::compare(const float *a, const float *b, uint32_t length) const
+{
+    svfloat32_t dot = svdup_n_f32(0), mag_a = svdup_n_f32(0), mag_b = svdup_n_f32(0);
+    for (uint32_t i = 0; i < length; i += (uint32_t)svcntw())
+    {
+        const svbool_t pg = svwhilelt_b32(i, length);
+        const svfloat32_t va = svld1_f32(pg, a + i), vb = svld1_f32(pg, b + i);
+        dot = svmla_f32_m(pg, dot, va, vb);
+        mag_a = svmla_f32_m(pg, mag_a, va, va);
+        mag_b = svmla_f32_m(pg, mag_b, vb, vb);
+    }
+    const svbool_t all = svptrue_b32();
+    const float scalarProduct = svaddv_f32(all, dot);
+    // similarity == 1-cosine distance
+    return 1.0f - (scalarProduct / (std::sqrt(svaddv_f32(all, mag_a)) * std::sqrt(svaddv_f32(all, mag_b))));
+}
+
+//
+// Byte kernels. The loads zero the inactive lanes, which add nothing to the
+// dot products, so the tail needs no separate loop.
+//
+
+// the dot product of a and b and, with magnitudes, their squared norms
+template <bool magnitudes>
+static inline int64_t sve_byte_dot(const int8_t *a, const int8_t *b, uint32_t length, int64_t *sq_a = nullptr,
+                                   int64_t *sq_b = nullptr)
+{
+    svint32_t dot = svdup_n_s32(0), mag_a = svdup_n_s32(0), mag_b = svdup_n_s32(0);
+    for (uint32_t i = 0; i < length; i += (uint32_t)svcntb())
+    {
+        const svbool_t pg = svwhilelt_b8(i, length);
+        const svint8_t va = svld1_s8(pg, a + i), vb = svld1_s8(pg, b + i);
+        dot = svdot_s32(dot, va, vb);
+        if (magnitudes)
+        {
+            mag_a = svdot_s32(mag_a, va, va);
+            mag_b = svdot_s32(mag_b, vb, vb);
+        }
+    }
+    const svbool_t all = svptrue_b32();
+    if (magnitudes)
+    {
+        *sq_a = svaddv_s32(all, mag_a);
+        *sq_b = svaddv_s32(all, mag_b);
+    }
+    return svaddv_s32(all, dot);
+}
+
+template <bool magnitudes>
+static inline int64_t sve_byte_dot(const uint8_t *a, const uint8_t *b, uint32_t length, int64_t *sq_a = nullptr,
+                                   int64_t *sq_b = nullptr)
+{
+    svuint32_t dot = svdup_n_u32(0), mag_a = svdup_n_u32(0), mag_b = svdup_n_u32(0);
+    for (uint32_t i = 0; i < length; i += (uint32_t)svcntb())
+    {
+        const svbool_t pg = svwhilelt_b8(i, length);
+        const svuint8_t va = svld1_u8(pg, a + i), vb = svld1_u8(pg, b + i);
+        dot = svdot_u32(dot, va, vb);
+        if (magnitudes)
+        {
+            mag_a = svdot_u32(mag_a, va, va);
+            mag_b = svdot_u32(mag_b, vb, vb);
+        }
+    }
+    const svbool_t all = svptrue_b32();
+    if (magnitudes)
+    {
+        *sq_a = (int64_t)svaddv_u32(all, mag_a);
+        *sq_b = (int64_t)svaddv_u32(all, mag_b);
+    }
+    return (int64_t)svaddv_u32(all, dot);
+}
+
+// |a - b|^2 = |a|^2 + |b|^2 - 2 a.b, exact in integers
+template <typename T> static inline float sve_byte_l2(const T *a, const T *b, uint32_t length)
+{
+    int64_t sq_a, sq_b;
+    const int64_t dot = sve_byte_dot<true>(a, b, length, &sq_a, &sq_b);
+    return (float)(sq_a + sq_b - 2 * dot);
+}
+
+template <typename T> static inline float sve_byte_cosine(const T *a, const T *b, uint32_t length)
+{
+    int64_t sq_a, sq_b;
+    const int64_t dot = sve_byte_dot<true>(a, b, length, &sq_a, &sq_b);
+    // similarity == 1-cosine distance
+    return 1.0f - (float)(dot / (std::sqrt((double)sq_a) * std::sqrt((double)sq_b)));
+}
+
+float SVEDistanceL2Int8::compare(const int8_t *a, const int8_t *b, uint32_t length) const
+{
+    return sve_byte_l2(a, b, length);
+}
+
+float SVEDistanceInnerProductInt8::compare(const int8_t *a, const int8_t *b, uint32_t length) const
+{
+    return -(float)sve_byte_dot<false>(a, b, length);
+}
+
+float SVEDistanceCosineInt8::compare(const int8_t *a, const int8_t *b, uint32_t length) const
+{
+    return sve_byte_cosine(a, b, length);
+}
+
+float SVEDistanceL2UInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return sve_byte_l2(a, b, length);
+}
+
+float SVEDistanceInnerProductUInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return -(float)sve_byte_dot<false>(a, b, length);
+}
+
+float SVEDistanceCosineUInt8::compare(const uint8_t *a, const uint8_t *b, uint32_t length) const
+{
+    return sve_byte_cosine(a, b, length);
+}
+} // namespace diskann
@@ -0,0 +1,189 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cstring>
+
+#include "dynamic_sector_cache.h"
+#include "memory_usage.h"
+
+namespace diskann
+{
+namespace
+{
+const uint32_t SKETCH_ROWS = 4;
+const uint8_t SKETCH_MAX_COUNT = 15;
+
+inline uint64_t mix64(uint64_t x)
+{
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+} // namespace
+
+struct DynamicSectorCache::Shard
+{
+    std::mutex lock;
+    uint64_t capacity = 0;
+    uint64_t size = 0;
+    uint64_t hand = 0;
+    std::vector<char> data;
+    std::vector<uint64_t> keys;
+    std::vector<uint8_t> referenced;
+    tsl::robin_map<uint64_t, uint64_t> slot_of;
+
+    // count-min sketch of access frequencies, SKETCH_ROWS x sketch_width
+    uint64_t sketch_width = 0;
+    std::vector<uint8_t> sketch;
+    uint64_t samples = 0;
+    uint64_t reset_at = 0;
+
+    Shard(uint64_t cap, uint64_t entry_len) : capacity(cap)
+    {
+        data.resize(cap * entry_len);
+        keys.resize(cap);
+        referenced.resize(cap, 0);
+        slot_of.reserve(cap);
+
+        sketch_width = 64;
+        while (sketch_width < cap)
+            sketch_width <<= 1;
+        sketch.resize(SKETCH_ROWS * sketch_width, 0);
+        reset_at = 10 * (std::max)(cap, (uint64_t)1);
+    }
+
+    uint64_t sketch_index(uint64_t key, uint32_t row) const
+    {
+        return row * sketch_width + (mix64(key + row * 0x51ed27ULL) & (sketch_width - 1));
+    }
+
+    uint8_t frequency(uint64_t key) const
+    {
+        uint8_t f = SKETCH_MAX_COUNT;
+        for (uint32_t r = 0; r < SKETCH_ROWS; r++)
+            f = (std::min)(f, sketch[sketch_index(key, r)]);
+        return f;
+    }
+
+    void record_access(uint64_t key)
+    {
+        for (uint32_t r = 0; r < SKETCH_ROWS; r++)
+        {
+            uint8_t &c = sketch[sketch_index(key, r)];
+            if (c < SKETCH_MAX_COUNT)
+                c++;
+        }
+        // age the sketch so that frequencies track the recent workload
+        if (++samples >= reset_at)
+        {
+            for (auto &c : sketch)
+                c >>= 1;
+            samples /= 2;
+        }
+    }
+};
+
+DynamicSectorCache::DynamicSectorCache(uint64_t budget_bytes, uint64_t entry_len, uint32_t num_shards)
+    : _entry_len(entry_len)
+{
+    uint64_t num_entries = entry_len == 0 ? 0 : budget_bytes / entry_len;
+    uint64_t n_shards = (std::max)((uint64_t)1, (std::min)((uint64_t)num_shards, num_entries));
+    for (uint64_t s = 0; s < n_shards; s++)
+    {
+        uint64_t cap = num_entries / n_shards + (s < num_entries % n_shards ? 1 : 0);
+        _shards.emplace_back(new Shard(cap, entry_len));
+        _capacity += cap;
+    }
+}
+
+DynamicSectorCache::~DynamicSectorCache()
+{
+}
+
+DynamicSectorCache::Shard &DynamicSectorCache::shard_for(uint64_t sector)
+{
+    return *_shards[mix64(sector) % _shards.size()];
+}
+
+bool DynamicSectorCache::lookup(uint64_t sector, char *out)
+{
+    Shard &shard = shard_for(sector);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.record_access(sector);
+    auto iter = shard.slot_of.find(sector);
+    if (iter == shard.slot_of.end())
+    {
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint64_t slot = iter->second;
+    shard.referenced[slot] = 1;
+    std::memcpy(out, shard.data.data() + slot * _entry_len, _entry_len);
+    _hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void DynamicSectorCache::admit(uint64_t sector, const char *data)
+{
+    Shard &shard = shard_for(sector);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (shard.capacity == 0 || shard.slot_of.find(sector) != shard.slot_of.end())
+        return;
+
+    uint64_t slot;
+    if (shard.size < shard.capacity)
+    {
+        slot = shard.size++;
+    }
+    else
+    {
+        // CLOCK: skip (and clear) recently referenced entries
+        while (shard.referenced[shard.hand])
+        {
+            shard.referenced[shard.hand] = 0;
+            shard.hand = (shard.hand + 1) % shard.capacity;
+        }
+        slot = shard.hand;
+        // TinyLFU admission: keep the victim unless the newcomer is hotter
+        if (shard.frequency(sector) <= shard.frequency(shard.keys[slot]))
+            return;
+        shard.slot_of.erase(shard.keys[slot]);
+        shard.hand = (shard.hand + 1) % shard.capacity;
+    }
+
+    std::memcpy(shard.data.data() + slot * _entry_len, data, _entry_len);
+    shard.keys[slot] = sector;
+    shard.referenced[slot] = 0;
+    shard.slot_of.insert(std::make_pair(sector, slot));
+}
+
+uint64_t DynamicSectorCache::capacity() const
+{
+    return _capacity;
+}
+
+uint64_t DynamicSectorCache::memory_size() const
+{
+    uint64_t bytes = 0;
+    for (const auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        bytes += vector_bytes(shard->data) + vector_bytes(shard->keys) + vector_bytes(shard->referenced) +
+                 vector_bytes(shard->sketch) + hash_table_bytes(shard->slot_of);
+    }
+    return bytes;
+}
+
+uint64_t DynamicSectorCache::num_hits() const
+{
+    return _hits.load(std::memory_order_relaxed);
+}
+
+uint64_t DynamicSectorCache::num_misses() const
+{
+    return _misses.load(std::memory_order_relaxed);
+}
+} // namespace diskann
@@ -0,0 +1,198 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "executor.h"
+
+namespace diskann
+{
+struct WorkStealingExecutor::Loop
+{
+    // the part of the range a thread has not taken yet
+    struct Block
+    {
+        std::mutex lock;
+        uint64_t begin = 0;
+        uint64_t end = 0;
+    };
+
+    Loop(uint64_t count, uint64_t grain, const std::function<void(uint64_t, uint64_t)> &body, uint32_t num_blocks)
+        : count(count), grain(grain), body(body), blocks(num_blocks)
+    {
+        for (uint32_t i = 0; i < num_blocks; i++)
+        {
+            blocks[i].begin = count * i / num_blocks;
+            blocks[i].end = count * (i + 1) / num_blocks;
+        }
+    }
+
+    // takes the next range of block, or the back half of what another block
+    // has left into block
+    bool take(uint32_t block, uint64_t &begin, uint64_t &end)
+    {
+        {
+            Block &own = blocks[block];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (own.begin < own.end)
+            {
+                begin = own.begin;
+                end = std::min(own.end, begin + grain);
+                own.begin = end;
+                return true;
+            }
+        }
+        for (uint32_t i = 1; i < blocks.size(); i++)
+        {
+            Block &victim = blocks[(block + i) % blocks.size()];
+            uint64_t stolen_begin, stolen_end;
+            {
+                std::lock_guard<std::mutex> guard(victim.lock);
+                const uint64_t left = victim.end - victim.begin;
+                if (left == 0)
+                    continue;
+                stolen_end = victim.end;
+                stolen_begin = left <= grain ? victim.begin : victim.end - left / 2;
+                victim.end = stolen_begin;
+            }
+            begin = stolen_begin;
+            end = std::min(stolen_end, begin + grain);
+            if (end < stolen_end)
+            {
+                Block &own = blocks[block];
+                std::lock_guard<std::mutex> guard(own.lock);
+                own.begin = end;
+                own.end = stolen_end;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(uint32_t block)
+    {
+        uint64_t begin, end;
+        while (take(block, begin, end))
+        {
+            if (!cancelled.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    body(begin, end);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> guard(done_lock);
+                    if (error == nullptr)
+                        error = std::current_exception();
+                    cancelled = true;
+                }
+            }
+            if (num_done.fetch_add(end - begin) + (end - begin) == count)
+            {
+                std::lock_guard<std::mutex> guard(done_lock);
+                done.notify_all();
+            }
+        }
+    }
+
+    const uint64_t count;
+    const uint64_t grain;
+    const std::function<void(uint64_t, uint64_t)> &body;
+    std::vector<Block> blocks;
+    // blocks are joined in order; block 0 is the calling thread's
+    uint32_t next_block = 1;
+
+    std::atomic<uint64_t> num_done{0};
+    std::atomic<bool> cancelled{false};
+    std::mutex done_lock;
+    std::condition_variable done;
+    std::exception_ptr error;
+};
+
+WorkStealingExecutor::WorkStealingExecutor(uint32_t num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t i = 1; i < num_threads; i++)
+        _workers.emplace_back([this]() { run_worker(); });
+}
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto &worker : _workers)
+        worker.join();
+}
+
+void WorkStealingExecutor::run_worker()
+{
+    while (true)
+    {
+        std::shared_ptr<Loop> loop;
+        uint32_t block;
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _cv.wait(guard, [this]() { return _stopping || !_loops.empty(); });
+            if (_stopping)
+                return;
+            loop = _loops.front();
+            block = loop->next_block++;
+            if (loop->next_block == loop->blocks.size())
+                _loops.pop_front();
+        }
+        loop->run(block);
+    }
+}
+
+void WorkStealingExecutor::parallel_for(uint64_t count, uint64_t grain,
+                                        const std::function<void(uint64_t, uint64_t)> &body, uint32_t max_threads)
+{
+    if (count == 0)
+        return;
+    grain = std::max(grain, (uint64_t)1);
+    uint32_t num_blocks = get_num_threads();
+    if (max_threads != 0)
+        num_blocks = std::min(num_blocks, max_threads);
+    num_blocks = (uint32_t)std::min<uint64_t>(num_blocks, (count + grain - 1) / grain);
+
+    auto loop = std::make_shared<Loop>(count, grain, body, num_blocks);
+    if (num_blocks > 1)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _loops.push_back(loop);
+        }
+        if (num_blocks == 2)
+            _cv.notify_one();
+        else
+            _cv.notify_all();
+    }
+    loop->run(0);
+
+    // blocks no worker joined were stolen by the threads that did
+    {
+        std::unique_lock<std::mutex> guard(loop->done_lock);
+        loop->done.wait(guard, [&loop]() { return loop->num_done.load() == loop->count; });
+    }
+    if (num_blocks > 1)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _loops.remove(loop);
+    }
+    if (loop->error != nullptr)
+        std::rethrow_exception(loop->error);
+}
+
+std::shared_ptr<Executor> get_default_executor()
+{
+    static std::shared_ptr<Executor> executor = std::make_shared<WorkStealingExecutor>();
+    return executor;
+}
+} // namespace diskann
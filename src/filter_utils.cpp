@@ -2,8 +2,10 @@
 // Licensed under the MIT license.
 
 #include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <mutex>
 #include <random>
 #include <string>
 #include <tuple>
@@ -32,14 +34,36 @@ void generate_label_indices(path input_data_path, path final_index_path_prefix,
                                                                      .with_alpha(alpha)
                                                                      .with_num_threads(num_threads)
                                                                      .build();
+    diskann::IndexWriteParameters single_thread_build_parameters = diskann::IndexWriteParametersBuilder(L, R)
+                                                                       .with_saturate_graph(false)
+                                                                       .with_alpha(alpha)
+                                                                       .with_num_threads(1)
+                                                                       .build();
+
+    // Labels are built largest first. Those large enough to keep all threads
+    // busy are built one after another with all of them; the rest are built
+    // concurrently with one thread each, handed out one label at a time since
+    // their sizes vary widely.
+    std::vector<std::pair<size_t, std::string>> labels_by_size;
+    for (const auto &lbl : all_labels)
+    {
+        size_t number_of_label_points, dimension;
+        diskann::get_bin_metadata(input_data_path + "_" + lbl, number_of_label_points, dimension);
+        labels_by_size.emplace_back(number_of_label_points, lbl);
+    }
+    std::sort(labels_by_size.begin(), labels_by_size.end(), std::greater<std::pair<size_t, std::string>>());
+    const size_t shared_build_min_points = (size_t)num_threads * defaults::LABEL_INDEX_MIN_POINTS_PER_THREAD;
+    size_t num_shared_builds = 0;
+    while (num_shared_builds < labels_by_size.size() && num_threads > 1 &&
+           labels_by_size[num_shared_builds].first >= shared_build_min_points)
+        num_shared_builds++;
 
     std::cout << "Generating indices per label..." << std::endl;
-    // for each label, build an index on resp. points
-    double total_indexing_time = 0.0, indexing_percentage = 0.0;
+    auto indexing_timer = std::chrono::high_resolution_clock::now();
+    double indexing_percentage = 0.0;
     std::cout.setstate(std::ios_base::failbit);
     diskann::cout.setstate(std::ios_base::failbit);
-    for (const auto &lbl : all_labels)
-    {
+    auto build_label_index = [&](const std::string &lbl, const diskann::IndexWriteParameters &parameters) {
         path curr_label_input_data_path(input_data_path + "_" + lbl);
         path curr_label_index_path(final_index_path_prefix + "_" + lbl);
 
@@ -47,24 +71,380 @@ void generate_label_indices(path input_data_path, path final_index_path_prefix,
         diskann::get_bin_metadata(curr_label_input_data_path, number_of_label_points, dimension);
 
         diskann::Index<T> index(diskann::Metric::L2, dimension, number_of_label_points,
-                                std::make_shared<diskann::IndexWriteParameters>(label_index_build_parameters), nullptr,
-                                0, false, false, false, false, 0, false);
-
-        auto index_build_timer = std::chrono::high_resolution_clock::now();
+                                std::make_shared<diskann::IndexWriteParameters>(parameters), nullptr, 0, false, false,
+                                false, false, 0, false);
         index.build(curr_label_input_data_path.c_str(), number_of_label_points);
-        std::chrono::duration<double> current_indexing_time =
-            std::chrono::high_resolution_clock::now() - index_build_timer;
+        index.save(curr_label_index_path.c_str());
+
+#pragma omp critical
+        {
+            indexing_percentage += (1 / (double)all_labels.size());
+            print_progress(indexing_percentage);
+        }
+    };
 
-        total_indexing_time += current_indexing_time.count();
-        indexing_percentage += (1 / (double)all_labels.size());
-        print_progress(indexing_percentage);
+    for (size_t i = 0; i < num_shared_builds; i++)
+        build_label_index(labels_by_size[i].second, label_index_build_parameters);
 
-        index.save(curr_label_index_path.c_str());
+    std::exception_ptr build_error;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (int64_t i = (int64_t)num_shared_builds; i < (int64_t)labels_by_size.size(); i++)
+    {
+        try
+        {
+            build_label_index(labels_by_size[i].second, single_thread_build_parameters);
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!build_error)
+                build_error = std::current_exception();
+        }
+    }
+    std::cout.clear();
+    diskann::cout.clear();
+    if (build_error)
+        std::rethrow_exception(build_error);
+
+    std::chrono::duration<double> total_indexing_time = std::chrono::high_resolution_clock::now() - indexing_timer;
+    std::cout << "\nDone. Generated per-label indices in " << total_indexing_time.count() << " seconds\n"
+              << std::endl;
+}
+
+namespace
+{
+// Hands out a memory budget to concurrent builds; a build that needs more
+// than the whole budget runs alone
+class MemoryBudget
+{
+  public:
+    explicit MemoryBudget(uint64_t budget) : _budget(budget)
+    {
+    }
+
+    void acquire(uint64_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _released.wait(lock, [&] { return _in_use == 0 || _in_use + bytes <= _budget; });
+        _in_use += bytes;
+    }
+
+    void release(uint64_t bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _in_use -= bytes;
+        }
+        _released.notify_all();
+    }
+
+  private:
+    const uint64_t _budget;
+    uint64_t _in_use = 0;
+    std::mutex _mutex;
+    std::condition_variable _released;
+};
+
+// Vamana's robust prune of the candidates of one point, sorted by distance,
+// with the vectors of the candidates in candidate_vectors
+template <typename T>
+void prune_stitched_neighbors(const std::vector<Neighbor> &candidates, const T *candidate_vectors,
+                              const size_t aligned_dim, diskann::Distance<T> &distance, const uint32_t R,
+                              const float alpha, std::vector<float> &occlude_factor, std::vector<uint32_t> &pruned)
+{
+    pruned.clear();
+    occlude_factor.assign(candidates.size(), 0.0f);
+    float cur_alpha = 1;
+    while (cur_alpha <= alpha && pruned.size() < R)
+    {
+        for (size_t i = 0; i < candidates.size() && pruned.size() < R; i++)
+        {
+            if (occlude_factor[i] > cur_alpha)
+                continue;
+            occlude_factor[i] = std::numeric_limits<float>::max();
+            pruned.push_back(candidates[i].id);
+            for (size_t j = i + 1; j < candidates.size(); j++)
+            {
+                if (occlude_factor[j] > alpha)
+                    continue;
+                const float djk = distance.compare(candidate_vectors + j * aligned_dim,
+                                                   candidate_vectors + i * aligned_dim, (uint32_t)aligned_dim);
+                occlude_factor[j] = (djk == 0) ? std::numeric_limits<float>::max()
+                                               : std::max(occlude_factor[j], candidates[j].distance / djk);
+            }
+        }
+        cur_alpha *= 1.2f;
+    }
+}
+} // namespace
+
+template <typename T>
+void build_stitched_index_streaming(path input_data_path, path final_index_path_prefix,
+                                    const std::vector<label_set> &point_ids_to_labels, label_set all_labels,
+                                    uint32_t R, uint32_t L, float alpha, uint32_t stitched_R, uint32_t num_threads,
+                                    double memory_budget_gb, tsl::robin_map<std::string, uint32_t> &label_entry_points)
+{
+    auto stitching_timer = std::chrono::high_resolution_clock::now();
+    diskann::MemoryMapper input_data(input_data_path);
+    const char *input_start = input_data.getBuf();
+    uint32_t number_of_points, dimension;
+    std::memcpy(&number_of_points, input_start, sizeof(uint32_t));
+    std::memcpy(&dimension, input_start + sizeof(uint32_t), sizeof(uint32_t));
+    if (number_of_points != point_ids_to_labels.size())
+        throw diskann::ANNException("Number of points in labels file and data file differ", -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    const T *vectors = (const T *)(input_start + 2 * sizeof(uint32_t));
+    const size_t aligned_dim = ROUND_UP(dimension, 8);
+    const uint64_t budget = (uint64_t)(memory_budget_gb * 1024 * 1024 * 1024);
+
+    // the ids of the points of each label, read from the base file by id
+    // rather than copied into a file per label
+    tsl::robin_map<std::string, std::vector<uint32_t>> label_ids;
+    for (uint32_t point_id = 0; point_id < number_of_points; point_id++)
+    {
+        for (const auto &lbl : point_ids_to_labels[point_id])
+            label_ids[lbl].push_back(point_id);
+    }
+
+    // the edges of the label graphs are spilled to a file per range of
+    // source points, with as many ranges as the merge needs to fit the budget
+    uint64_t expected_edges = 0;
+    for (const auto &lbl : all_labels)
+        expected_edges += (uint64_t)label_ids[lbl].size() * R;
+    const uint64_t EDGE_BYTES = 2 * sizeof(uint32_t);
+    const uint64_t ranges_for_budget = DIV_ROUND_UP(2 * expected_edges * EDGE_BYTES, std::max<uint64_t>(budget, 1));
+    const uint32_t num_ranges =
+        (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(number_of_points, ranges_for_budget));
+    const uint32_t range_size = (uint32_t)DIV_ROUND_UP(number_of_points, num_ranges);
+    std::vector<path> edge_files(num_ranges);
+    std::vector<std::ofstream> edge_writers(num_ranges);
+    std::vector<std::mutex> edge_locks(num_ranges);
+    for (uint32_t r = 0; r < num_ranges; r++)
+    {
+        edge_files[r] = final_index_path_prefix + "_stitch_edges_" + std::to_string(r) + ".bin";
+        edge_writers[r].exceptions(std::ios::badbit | std::ios::failbit);
+        edge_writers[r].open(edge_files[r], std::ios::binary);
+    }
+
+    // labels largest first, as in generate_label_indices
+    std::vector<std::pair<size_t, std::string>> labels_by_size;
+    for (const auto &lbl : all_labels)
+        labels_by_size.emplace_back(label_ids[lbl].size(), lbl);
+    std::sort(labels_by_size.begin(), labels_by_size.end(), std::greater<std::pair<size_t, std::string>>());
+    const size_t shared_build_min_points = (size_t)num_threads * defaults::LABEL_INDEX_MIN_POINTS_PER_THREAD;
+    size_t num_shared_builds = 0;
+    while (num_shared_builds < labels_by_size.size() && num_threads > 1 &&
+           labels_by_size[num_shared_builds].first >= shared_build_min_points)
+        num_shared_builds++;
+
+    // the gathered vectors, the copy and graph of the index, and the edges
+    // of the label before they are spilled
+    const uint64_t bytes_per_label_point = dimension * sizeof(T) + aligned_dim * sizeof(T) +
+                                           (uint64_t)(R * defaults::GRAPH_SLACK_FACTOR) * sizeof(uint32_t) +
+                                           R * EDGE_BYTES;
+    MemoryBudget label_budget(budget);
+    std::mutex entry_points_lock;
+
+    std::cout << "Building " << all_labels.size() << " label graphs, spilling their edges to " << num_ranges
+              << " file(s)..." << std::endl;
+    double indexing_percentage = 0.0;
+    std::cout.setstate(std::ios_base::failbit);
+    diskann::cout.setstate(std::ios_base::failbit);
+    auto build_label_graph = [&](const std::string &lbl, const uint32_t build_threads) {
+        const std::vector<uint32_t> &orig_ids = label_ids[lbl];
+        const uint64_t label_bytes = orig_ids.size() * bytes_per_label_point;
+        label_budget.acquire(label_bytes);
+        try
+        {
+            std::vector<T> label_vectors(orig_ids.size() * dimension);
+            for (size_t i = 0; i < orig_ids.size(); i++)
+                std::memcpy(label_vectors.data() + i * dimension, vectors + (size_t)orig_ids[i] * dimension,
+                            dimension * sizeof(T));
+
+            auto parameters = std::make_shared<diskann::IndexWriteParameters>(
+                diskann::IndexWriteParametersBuilder(L, R)
+                    .with_saturate_graph(false)
+                    .with_alpha(alpha)
+                    .with_num_threads(build_threads)
+                    .build());
+            diskann::Index<T> index(diskann::Metric::L2, dimension, orig_ids.size(), parameters, nullptr, 0, false,
+                                    false, false, false, 0, false);
+            index.build(label_vectors.data(), orig_ids.size(), std::vector<uint32_t>());
+            {
+                std::vector<T>().swap(label_vectors);
+            }
+
+            std::vector<std::vector<uint32_t>> range_edges(num_ranges);
+            std::vector<uint32_t> neighbours;
+            for (uint32_t node = 0; node < orig_ids.size(); node++)
+            {
+                const uint32_t src = orig_ids[node];
+                index.get_neighbours(node, neighbours);
+                for (const uint32_t nbr : neighbours)
+                {
+                    range_edges[src / range_size].push_back(src);
+                    range_edges[src / range_size].push_back(orig_ids[nbr]);
+                }
+            }
+            for (uint32_t r = 0; r < num_ranges; r++)
+            {
+                if (range_edges[r].empty())
+                    continue;
+                std::lock_guard<std::mutex> guard(edge_locks[r]);
+                edge_writers[r].write((char *)range_edges[r].data(), range_edges[r].size() * sizeof(uint32_t));
+            }
+
+            std::lock_guard<std::mutex> guard(entry_points_lock);
+            label_entry_points[lbl] = orig_ids[index.get_start_point()];
+            indexing_percentage += (1 / (double)all_labels.size());
+            print_progress(indexing_percentage);
+        }
+        catch (...)
+        {
+            label_budget.release(label_bytes);
+            throw;
+        }
+        label_budget.release(label_bytes);
+    };
+
+    for (size_t i = 0; i < num_shared_builds; i++)
+        build_label_graph(labels_by_size[i].second, num_threads);
+
+    std::exception_ptr build_error;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (int64_t i = (int64_t)num_shared_builds; i < (int64_t)labels_by_size.size(); i++)
+    {
+        try
+        {
+            build_label_graph(labels_by_size[i].second, 1);
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!build_error)
+                build_error = std::current_exception();
+        }
     }
     std::cout.clear();
     diskann::cout.clear();
+    for (auto &writer : edge_writers)
+        writer.close();
+    if (build_error)
+        std::rethrow_exception(build_error);
+    std::cout << std::endl;
+
+    // the stitched graph, in the format of Index::save, one range of points
+    // at a time: the edges of the range are deduplicated and the neighbours
+    // of every point pruned to stitched_R
+    std::ofstream graph_writer;
+    graph_writer.exceptions(std::ios::badbit | std::ios::failbit);
+    graph_writer.open(final_index_path_prefix, std::ios::binary);
+    uint64_t index_size = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t), num_frozen_points = 0, num_edges = 0;
+    uint32_t max_observed_degree = 0;
+    uint32_t entry_point = labels_by_size.empty() ? 0 : label_entry_points[labels_by_size[0].second];
+    graph_writer.write((char *)&index_size, sizeof(uint64_t));
+    graph_writer.write((char *)&max_observed_degree, sizeof(uint32_t));
+    graph_writer.write((char *)&entry_point, sizeof(uint32_t));
+    graph_writer.write((char *)&num_frozen_points, sizeof(uint64_t));
+
+    std::unique_ptr<diskann::Distance<T>> distance(diskann::get_distance_function<T>(diskann::Metric::L2));
+    for (uint32_t r = 0; r < num_ranges; r++)
+    {
+        const uint32_t range_start = r * range_size;
+        const uint32_t range_end = std::min(number_of_points, range_start + range_size);
+        if (range_start >= range_end)
+        {
+            std::remove(edge_files[r].c_str());
+            continue;
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        {
+            std::ifstream edge_reader(edge_files[r], std::ios::binary | std::ios::ate);
+            edges.resize((size_t)edge_reader.tellg() / EDGE_BYTES);
+            edge_reader.seekg(0);
+            std::vector<uint32_t> flat(edges.size() * 2);
+            edge_reader.read((char *)flat.data(), flat.size() * sizeof(uint32_t));
+            for (size_t e = 0; e < edges.size(); e++)
+                edges[e] = std::make_pair(flat[2 * e], flat[2 * e + 1]);
+        }
+        std::remove(edge_files[r].c_str());
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        // where the edges of each point of the range start
+        std::vector<size_t> offsets(range_end - range_start + 1, 0);
+        for (const auto &edge : edges)
+            offsets[edge.first - range_start + 1]++;
+        for (size_t i = 1; i < offsets.size(); i++)
+            offsets[i] += offsets[i - 1];
+
+        std::vector<std::vector<uint32_t>> pruned(range_end - range_start);
+#pragma omp parallel num_threads(num_threads)
+        {
+            std::vector<Neighbor> candidates;
+            std::vector<float> occlude_factor;
+            // zero-padded to aligned_dim and aligned, as the distance
+            // functions expect: the point, a candidate, and the candidates
+            // being pruned
+            const size_t scratch_vectors = 2 + defaults::MAX_OCCLUSION_SIZE;
+            T *point_vector = nullptr;
+            diskann::alloc_aligned((void **)&point_vector, scratch_vectors * aligned_dim * sizeof(T), 8 * sizeof(T));
+            std::memset(point_vector, 0, scratch_vectors * aligned_dim * sizeof(T));
+            T *candidate_vector = point_vector + aligned_dim;
+            T *candidate_vectors = point_vector + 2 * aligned_dim;
+
+#pragma omp for schedule(dynamic, 256)
+            for (int64_t i = 0; i < (int64_t)pruned.size(); i++)
+            {
+                const uint32_t point = range_start + (uint32_t)i;
+                std::memcpy(point_vector, vectors + (size_t)point * dimension, dimension * sizeof(T));
+                candidates.clear();
+                for (size_t e = offsets[i]; e < offsets[i + 1]; e++)
+                {
+                    const uint32_t nbr = edges[e].second;
+                    if (nbr == point)
+                        continue;
+                    std::memcpy(candidate_vector, vectors + (size_t)nbr * dimension, dimension * sizeof(T));
+                    candidates.emplace_back(nbr, distance->compare(point_vector, candidate_vector,
+                                                                   (uint32_t)aligned_dim));
+                }
+                if (candidates.size() <= stitched_R)
+                {
+                    for (const auto &candidate : candidates)
+                        pruned[i].push_back(candidate.id);
+                    continue;
+                }
+                std::sort(candidates.begin(), candidates.end());
+                if (candidates.size() > defaults::MAX_OCCLUSION_SIZE)
+                    candidates.resize(defaults::MAX_OCCLUSION_SIZE);
+                for (size_t c = 0; c < candidates.size(); c++)
+                    std::memcpy(candidate_vectors + c * aligned_dim, vectors + (size_t)candidates[c].id * dimension,
+                                dimension * sizeof(T));
+                prune_stitched_neighbors(candidates, candidate_vectors, aligned_dim, *distance, stitched_R, alpha,
+                                         occlude_factor, pruned[i]);
+            }
+            diskann::aligned_free(point_vector);
+        }
 
-    std::cout << "\nDone. Generated per-label indices in " << total_indexing_time << " seconds\n" << std::endl;
+        for (const auto &neighbours : pruned)
+        {
+            const uint32_t degree = (uint32_t)neighbours.size();
+            graph_writer.write((char *)&degree, sizeof(uint32_t));
+            graph_writer.write((char *)neighbours.data(), degree * sizeof(uint32_t));
+            index_size += (1 + (uint64_t)degree) * sizeof(uint32_t);
+            max_observed_degree = std::max(max_observed_degree, degree);
+            num_edges += degree;
+        }
+    }
+    graph_writer.seekp(0);
+    graph_writer.write((char *)&index_size, sizeof(uint64_t));
+    graph_writer.write((char *)&max_observed_degree, sizeof(uint32_t));
+    graph_writer.close();
+
+    std::chrono::duration<double> stitching_time = std::chrono::high_resolution_clock::now() - stitching_timer;
+    std::cout << "Stitched graph written in " << stitching_time.count() << " seconds" << std::endl;
+    std::cout << "Stitched graph average degree: " << (float)num_edges / (float)number_of_points << std::endl;
+    std::cout << "Stitched graph max degree: " << max_observed_degree << std::endl << std::endl;
 }
 
 // for use on systems without writev (i.e. Windows)
@@ -338,6 +718,25 @@ template DISKANN_DLLEXPORT void generate_label_indices<uint8_t>(path input_data_
 template DISKANN_DLLEXPORT void generate_label_indices<int8_t>(path input_data_path, path final_index_path_prefix,
                                                                label_set all_labels, uint32_t R, uint32_t L,
                                                                float alpha, uint32_t num_threads);
+template DISKANN_DLLEXPORT void generate_label_indices<float16>(path input_data_path, path final_index_path_prefix,
+                                                                label_set all_labels, uint32_t R, uint32_t L,
+                                                                float alpha, uint32_t num_threads);
+template DISKANN_DLLEXPORT void generate_label_indices<bfloat16>(path input_data_path, path final_index_path_prefix,
+                                                                 label_set all_labels, uint32_t R, uint32_t L,
+                                                                 float alpha, uint32_t num_threads);
+
+template DISKANN_DLLEXPORT void build_stitched_index_streaming<float>(
+    path input_data_path, path final_index_path_prefix, const std::vector<label_set> &point_ids_to_labels,
+    label_set all_labels, uint32_t R, uint32_t L, float alpha, uint32_t stitched_R, uint32_t num_threads,
+    double memory_budget_gb, tsl::robin_map<std::string, uint32_t> &label_entry_points);
+template DISKANN_DLLEXPORT void build_stitched_index_streaming<uint8_t>(
+    path input_data_path, path final_index_path_prefix, const std::vector<label_set> &point_ids_to_labels,
+    label_set all_labels, uint32_t R, uint32_t L, float alpha, uint32_t stitched_R, uint32_t num_threads,
+    double memory_budget_gb, tsl::robin_map<std::string, uint32_t> &label_entry_points);
+template DISKANN_DLLEXPORT void build_stitched_index_streaming<int8_t>(
+    path input_data_path, path final_index_path_prefix, const std::vector<label_set> &point_ids_to_labels,
+    label_set all_labels, uint32_t R, uint32_t L, float alpha, uint32_t stitched_R, uint32_t num_threads,
+    double memory_budget_gb, tsl::robin_map<std::string, uint32_t> &label_entry_points);
 
 template DISKANN_DLLEXPORT tsl::robin_map<std::string, std::vector<uint32_t>>
 generate_label_specific_vector_files_compat<float>(path input_data_path,
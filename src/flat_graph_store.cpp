@@ -0,0 +1,347 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "flat_graph_store.h"
+#include "memory_mapper.h"
+#include "defaults.h"
+#include "utils.h"
+
+namespace diskann
+{
+FlatGraphStore::FlatGraphStore(const size_t total_pts, const size_t reserve_graph_degree)
+    : AbstractGraphStore(total_pts, reserve_graph_degree)
+{
+    reallocate(total_pts, reserve_graph_degree + 1);
+}
+
+FlatGraphStore::~FlatGraphStore()
+{
+    free_graph();
+}
+
+void FlatGraphStore::free_graph()
+{
+    if (_mapping != nullptr)
+        _mapping.reset();
+    else
+        free_large(_buffer);
+    _graph = nullptr;
+}
+
+void FlatGraphStore::reallocate(size_t num_nodes, size_t stride, size_t reserve_nodes)
+{
+    // allocated under the memory policy, so backed by huge pages where the OS
+    // provides them; the buffer comes back zeroed, so every degree is 0
+    LargeBuffer new_buffer;
+    if (reserve_nodes > num_nodes)
+        new_buffer = reserve_large(reserve_nodes * stride * sizeof(uint32_t), sizeof(uint32_t));
+    if (new_buffer.ptr == nullptr)
+        new_buffer = alloc_large(num_nodes * stride * sizeof(uint32_t), sizeof(uint32_t));
+    uint32_t *new_graph = (uint32_t *)new_buffer.ptr;
+
+    size_t nodes_to_copy = std::min(num_nodes, _num_nodes);
+    for (size_t i = 0; i < nodes_to_copy; i++)
+    {
+        const uint32_t *src = node_slots((location_t)i);
+        if (src[0] + 1 > stride)
+        {
+            free_large(new_buffer);
+            throw ANNException("ERROR: node " + std::to_string(i) + " has " + std::to_string(src[0]) +
+                                   " neighbours, more than the new stride of the flat graph store holds",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        std::memcpy(new_graph + i * stride, src, (src[0] + 1) * sizeof(uint32_t));
+    }
+
+    free_graph();
+    _buffer = new_buffer;
+    _graph = new_graph;
+    _num_nodes = num_nodes;
+    _stride = stride;
+}
+
+std::tuple<uint32_t, uint32_t, size_t> FlatGraphStore::load(const std::string &index_path_prefix,
+                                                            const size_t num_points)
+{
+    size_t expected_file_size;
+    size_t file_frozen_pts;
+    uint32_t start;
+
+    const GraphFileHeader header = read_graph_header(index_path_prefix);
+    expected_file_size = header.expected_file_size;
+    _max_observed_degree = header.max_observed_degree;
+    start = header.start;
+    file_frozen_pts = header.num_frozen_points;
+    size_t vamana_metadata_size = sizeof(size_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(size_t);
+
+    diskann::cout << "From graph header, expected_file_size: " << expected_file_size
+                  << ", _max_observed_degree: " << _max_observed_degree << ", _start: " << start
+                  << ", file_frozen_pts: " << file_frozen_pts << std::endl;
+
+    diskann::cout << "Loading vamana graph " << index_path_prefix << " into flat graph store..." << std::flush;
+
+    // the header's max degree bounds every list in the file, so grow the
+    // stride (and the node count if the caller asks for more) before reading
+    size_t num_nodes = std::max(_num_nodes, num_points);
+    size_t stride = std::max(_stride, (size_t)_max_observed_degree + 1);
+    if (num_nodes != _num_nodes || stride != _stride)
+    {
+        reallocate(num_nodes, stride);
+        set_total_points(num_nodes);
+    }
+
+    size_t cc = 0;
+    uint32_t max_degree = 0;
+    std::atomic<bool> overflow(false);
+    const uint32_t nodes_read = load_graph_adjacency_parallel(
+        index_path_prefix, vamana_metadata_size, expected_file_size,
+        [this, &overflow](const uint32_t node, const uint32_t k, const uint32_t *nbrs) {
+            if (node >= _num_nodes || k + 1 > _stride)
+            {
+                overflow = true;
+                return;
+            }
+            uint32_t *slots = node_slots(node);
+            std::memcpy(slots + 1, nbrs, k * sizeof(uint32_t));
+            slots[0] = k;
+        },
+        cc, max_degree);
+    if (overflow)
+    {
+        throw ANNException("ERROR: graph file " + index_path_prefix + " does not fit the flat graph store", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _max_range_of_graph = std::max(_max_range_of_graph, (size_t)max_degree);
+
+    diskann::cout << "done. Index has " << nodes_read << " nodes and " << cc << " out-edges, _start is set to " << start
+                  << std::endl;
+    return std::make_tuple(nodes_read, start, file_frozen_pts);
+}
+
+int FlatGraphStore::store(const std::string &index_path_prefix, const size_t num_points,
+                          const size_t num_frozen_points, const uint32_t start, const size_t frozen_location)
+{
+    std::ofstream out;
+    open_file_to_write(out, index_path_prefix);
+
+    size_t file_offset = 0;
+    out.seekp(file_offset, out.beg);
+    size_t index_size = 24;
+    uint32_t max_degree = 0;
+    out.write((char *)&index_size, sizeof(uint64_t));
+    out.write((char *)&_max_observed_degree, sizeof(uint32_t));
+    uint32_t ep_u32 = start;
+    out.write((char *)&ep_u32, sizeof(uint32_t));
+    out.write((char *)&num_frozen_points, sizeof(size_t));
+
+    // Note: num_points = _nd + _num_frozen_points; each node's degree and
+    // neighbour ids are already laid out as the file wants them, unless the
+    // frozen points have to move
+    const size_t active_points = num_points - num_frozen_points;
+    const size_t frozen_start = frozen_location == 0 ? active_points : frozen_location;
+    std::vector<uint32_t> moved_slots;
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        const uint32_t *slots = node_slots((location_t)(i < active_points ? i : frozen_start + (i - active_points)));
+        uint32_t GK = slots[0];
+        if (frozen_start != active_points)
+        {
+            moved_slots.assign(slots, slots + GK + 1);
+            for (uint32_t j = 1; j <= GK; j++)
+            {
+                if (moved_slots[j] >= frozen_start)
+                    moved_slots[j] = (uint32_t)(moved_slots[j] - frozen_start + active_points);
+            }
+            slots = moved_slots.data();
+        }
+        out.write((char *)slots, (GK + 1) * sizeof(uint32_t));
+        max_degree = GK > max_degree ? GK : max_degree;
+        index_size += (size_t)(sizeof(uint32_t) * (GK + 1));
+    }
+    out.seekp(file_offset, out.beg);
+    out.write((char *)&index_size, sizeof(uint64_t));
+    out.write((char *)&max_degree, sizeof(uint32_t));
+    out.close();
+    return (int)index_size;
+}
+
+namespace
+{
+// header of a file written by store_mmap(), padded to MMAP_HEADER_SIZE
+struct MmapGraphHeader
+{
+    uint32_t num_points;
+    uint32_t stride;
+    uint32_t max_observed_degree;
+    uint32_t start;
+    uint64_t num_frozen_points;
+    uint64_t max_range_of_graph;
+};
+} // namespace
+
+int FlatGraphStore::store_mmap(const std::string &filename, const size_t num_points, const size_t num_frozen_points,
+                               const uint32_t start)
+{
+    std::ofstream out;
+    open_file_to_write(out, filename);
+
+    std::vector<char> header(defaults::MMAP_HEADER_SIZE, 0);
+    MmapGraphHeader fields{(uint32_t)num_points, (uint32_t)_stride, _max_observed_degree, start,
+                           (uint64_t)num_frozen_points, (uint64_t)_max_range_of_graph};
+    std::memcpy(header.data(), &fields, sizeof(fields));
+    out.write(header.data(), header.size());
+    out.write((char *)_graph, num_points * _stride * sizeof(uint32_t));
+    out.close();
+
+    size_t bytes_written = defaults::MMAP_HEADER_SIZE + num_points * _stride * sizeof(uint32_t);
+    diskann::cout << "Wrote " << num_points << " adjacency lists of stride " << _stride << " to " << filename
+                  << std::endl;
+    return (int)bytes_written;
+}
+
+std::tuple<uint32_t, uint32_t, size_t> FlatGraphStore::load_mmap(const std::string &filename)
+{
+    if (!file_exists(filename))
+    {
+        throw ANNException("ERROR: graph file " + filename + " does not exist", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    auto mapping = std::make_unique<MemoryMapper>(filename);
+    MmapGraphHeader fields{};
+    if (mapping->getFileSize() >= defaults::MMAP_HEADER_SIZE)
+        std::memcpy(&fields, mapping->getBuf(), sizeof(fields));
+    size_t expected_size = defaults::MMAP_HEADER_SIZE + (size_t)fields.num_points * fields.stride * sizeof(uint32_t);
+    if (fields.stride == 0 || mapping->getFileSize() < expected_size)
+    {
+        throw ANNException("ERROR: " + filename + " is not a memory-mapped graph file", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+
+    free_graph();
+#ifndef _WINDOWS
+    // start reading the file into the page cache in the background
+    madvise(mapping->getBuf(), mapping->getFileSize(), MADV_WILLNEED);
+#endif
+    _graph = (uint32_t *)(mapping->getBuf() + defaults::MMAP_HEADER_SIZE);
+    _mapping = std::move(mapping);
+    _num_nodes = fields.num_points;
+    _stride = fields.stride;
+    _max_observed_degree = fields.max_observed_degree;
+    _max_range_of_graph = fields.max_range_of_graph;
+    set_total_points(_num_nodes);
+
+    diskann::cout << "Mapped vamana graph " << filename << " with " << _num_nodes << " nodes, _start is set to "
+                  << fields.start << std::endl;
+    return std::make_tuple(fields.num_points, fields.start, (size_t)fields.num_frozen_points);
+}
+
+NeighbourList FlatGraphStore::get_neighbours(const location_t i) const
+{
+    const uint32_t *slots = node_slots(i);
+    return NeighbourList(slots + 1, slots[0]);
+}
+
+void FlatGraphStore::prefetch_neighbours(const location_t i) const
+{
+    if (i < _num_nodes)
+        prefetch_vector((const char *)node_slots(i), _stride * sizeof(uint32_t));
+}
+
+void FlatGraphStore::add_neighbour(const location_t i, location_t neighbour_id)
+{
+    detach_mapping();
+    uint32_t *slots = node_slots(i);
+    uint32_t degree = slots[0];
+    if (degree + 2 > _stride)
+    {
+        throw ANNException("ERROR: node " + std::to_string(i) + " already holds the " + std::to_string(_stride - 1) +
+                               " neighbours the flat graph store reserves",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    // write the id before publishing the new degree
+    slots[degree + 1] = neighbour_id;
+    slots[0] = degree + 1;
+    if (_max_observed_degree < degree + 1)
+    {
+        _max_observed_degree = degree + 1;
+    }
+}
+
+void FlatGraphStore::clear_neighbours(const location_t i)
+{
+    detach_mapping();
+    node_slots(i)[0] = 0;
+}
+
+void FlatGraphStore::swap_neighbours(const location_t a, location_t b)
+{
+    detach_mapping();
+    uint32_t *slots_a = node_slots(a);
+    uint32_t *slots_b = node_slots(b);
+    std::swap_ranges(slots_a, slots_a + std::max(slots_a[0], slots_b[0]) + 1, slots_b);
+}
+
+void FlatGraphStore::set_neighbours(const location_t i, std::vector<location_t> &neighbours)
+{
+    if (neighbours.size() + 1 > _stride)
+    {
+        throw ANNException("ERROR: cannot set " + std::to_string(neighbours.size()) + " neighbours on node " +
+                               std::to_string(i) + ", the flat graph store reserves " + std::to_string(_stride - 1),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    detach_mapping();
+    uint32_t *slots = node_slots(i);
+    std::memcpy(slots + 1, neighbours.data(), neighbours.size() * sizeof(location_t));
+    slots[0] = (uint32_t)neighbours.size();
+    if (_max_observed_degree < neighbours.size())
+    {
+        _max_observed_degree = (uint32_t)(neighbours.size());
+    }
+}
+
+size_t FlatGraphStore::resize_graph(const size_t new_size)
+{
+    if (new_size == 0)
+    {
+        free_graph();
+    }
+    else if (new_size > _num_nodes && _num_nodes > 0 && _mapping == nullptr &&
+             new_size * _stride * sizeof(uint32_t) <= _buffer.len)
+    {
+        // the lists stay where they are; the new nodes may hold lists from
+        // before a shrink
+        std::memset(node_slots((location_t)_num_nodes), 0, (new_size - _num_nodes) * _stride * sizeof(uint32_t));
+    }
+    else
+    {
+        // a growing array moves once into one with room for the resizes to come
+        reallocate(new_size, _stride,
+                   new_size > _num_nodes && _num_nodes > 0 ? new_size * defaults::STORE_GROWTH_RESERVE : 0);
+    }
+    _num_nodes = new_size;
+    set_total_points(new_size);
+    return new_size;
+}
+
+void FlatGraphStore::clear_graph()
+{
+    free_graph();
+    _num_nodes = 0;
+}
+
+size_t FlatGraphStore::get_max_range_of_graph()
+{
+    return _max_range_of_graph;
+}
+
+size_t FlatGraphStore::memory_size() const
+{
+    return _num_nodes * _stride * sizeof(uint32_t);
+}
+
+uint32_t FlatGraphStore::get_max_observed_degree()
+{
+    return _max_observed_degree;
+}
+
+} // namespace diskann
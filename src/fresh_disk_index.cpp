@@ -0,0 +1,539 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+#include "omp.h"
+
+#include "fresh_disk_index.h"
+#include "disk_utils.h"
+#include "logger.h"
+#include "pq.h"
+#include "timer.h"
+#include "tsl/robin_set.h"
+#ifdef _WINDOWS
+#include "windows_aligned_file_reader.h"
+#else
+#include "linux_aligned_file_reader.h"
+#endif
+
+namespace diskann
+{
+namespace
+{
+// id of the frozen point of merged disk indices, which is never returned
+const uint32_t FROZEN_POINT_ID = std::numeric_limits<uint32_t>::max();
+
+// the deltas and the merge use the id plus one as tag, as tag 0 is reserved
+inline uint32_t id_to_tag(uint32_t id)
+{
+    return id + 1;
+}
+
+inline uint32_t tag_to_id(uint32_t tag)
+{
+    return tag - 1;
+}
+
+void remove_generation_files(const std::string &prefix)
+{
+    for (const std::string suffix : {"_disk.index", "_pq_compressed.bin", "_disk.index_tags.bin"})
+        std::remove((prefix + suffix).c_str());
+}
+} // namespace
+
+template <typename T>
+FreshDiskIndex<T>::FreshDiskIndex(const std::string &index_prefix, const FreshDiskIndexParameters &params,
+                                  std::function<std::shared_ptr<AlignedFileReader>()> make_reader)
+    : _index_prefix(index_prefix), _params(params), _make_reader(make_reader)
+{
+    _num_threads = _params.num_threads > 0 ? _params.num_threads : (uint32_t)omp_get_num_procs();
+    if (!_make_reader)
+    {
+        _make_reader = []() {
+#ifdef _WINDOWS
+            return std::shared_ptr<AlignedFileReader>(new WindowsAlignedFileReader());
+#else
+            return std::shared_ptr<AlignedFileReader>(new LinuxAlignedFileReader());
+#endif
+        };
+    }
+
+    // the number of the latest merge, if any
+    uint64_t number = 0;
+    std::ifstream generation_file(_index_prefix + "_fresh_generation.txt");
+    if (generation_file)
+        generation_file >> number;
+    _disk = open_generation(number);
+    if (_disk->index->get_metric() != diskann::Metric::L2)
+        throw ANNException("FreshDiskIndex only supports the L2 metric", -1, __FUNCSIG__, __FILE__, __LINE__);
+    _dim = _disk->index->get_data_dim();
+
+    const std::string disk_index_path = generation_prefix(number) + "_disk.index";
+    const std::vector<uint64_t> meta = load_disk_index_metadata(disk_index_path);
+    if (meta[7] != 0 || get_inline_pq_chunks(meta) != 0 || get_disk_sector_len(meta) != defaults::SECTOR_LEN ||
+        get_packed_nbr_id_bits(meta) != 0 || file_exists(disk_index_path + "_pq_pivots.bin") ||
+        file_exists(disk_index_path + "_labels.txt") || file_exists(disk_index_path + "_duplicates.bin"))
+        throw ANNException("FreshDiskIndex needs a disk index with full precision vectors and plain neighbor ids in "
+                           "default sectors, and without filters or collapsed duplicates",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    // the deltas start their searches from the medoid of the disk index
+    _medoid.resize(_dim);
+    std::vector<uint32_t> medoid_id = {(uint32_t)meta[2]};
+    std::vector<T *> coords = {_medoid.data()};
+    std::vector<std::pair<uint32_t, uint32_t *>> nbrs = {{0, nullptr}};
+    _disk->index->read_nodes(medoid_id, coords, nbrs);
+
+    _delta = create_delta();
+}
+
+template <typename T> FreshDiskIndex<T>::~FreshDiskIndex()
+{
+    if (_merge_thread.joinable())
+        _merge_thread.join();
+}
+
+template <typename T> std::string FreshDiskIndex<T>::generation_prefix(uint64_t number) const
+{
+    return number == 0 ? _index_prefix : _index_prefix + "_merged" + std::to_string(number);
+}
+
+template <typename T>
+std::shared_ptr<typename FreshDiskIndex<T>::DiskGeneration> FreshDiskIndex<T>::open_generation(uint64_t number)
+{
+    auto generation = std::make_shared<DiskGeneration>();
+    generation->number = number;
+    generation->prefix = generation_prefix(number);
+    generation->reader = _make_reader();
+    generation->index.reset(new PQFlashIndex<T>(generation->reader, diskann::Metric::L2));
+
+    int status;
+    if (number == 0)
+    {
+        status = generation->index->load(_num_threads, generation->prefix.c_str());
+    }
+    else
+    {
+        // merged indices share the pivots of the original one
+        const std::string disk_index_path = generation->prefix + "_disk.index";
+        const std::string pivots_path = _index_prefix + "_pq_pivots.bin";
+        const std::string compressed_path = generation->prefix + "_pq_compressed.bin";
+        status = generation->index->load_from_separate_paths(_num_threads, disk_index_path.c_str(),
+                                                             pivots_path.c_str(), compressed_path.c_str());
+        std::unique_ptr<uint32_t[]> ids;
+        size_t num_ids, ids_dim;
+        diskann::load_bin<uint32_t>(disk_index_path + "_tags.bin", ids, num_ids, ids_dim);
+        generation->ids.assign(ids.get(), ids.get() + num_ids);
+    }
+    if (status != 0)
+        throw ANNException("Failed to load the disk index " + generation->prefix, -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    if (_params.num_nodes_to_cache > 0)
+    {
+        std::vector<uint32_t> node_list;
+        generation->index->cache_bfs_levels(_params.num_nodes_to_cache, node_list);
+        generation->index->load_cache_list(node_list);
+    }
+    return generation;
+}
+
+template <typename T> std::shared_ptr<typename FreshDiskIndex<T>::Delta> FreshDiskIndex<T>::create_delta()
+{
+    auto write_params = std::make_shared<IndexWriteParameters>(
+        IndexWriteParametersBuilder(_params.delta_L, _params.delta_R)
+            .with_alpha(_params.delta_alpha)
+            .with_num_threads(_num_threads)
+            .build());
+    auto search_params = std::make_shared<IndexSearchParams>(_params.delta_L, _num_threads);
+    auto delta = std::make_shared<Delta>(diskann::Metric::L2, _dim, _params.delta_capacity, write_params, search_params,
+                                         1, true, true, false, false, 0, false);
+    delta->set_start_points(_medoid.data(), _dim);
+    delta->enable_delete();
+    return delta;
+}
+
+template <typename T> int FreshDiskIndex<T>::insert(const T *point, const uint32_t id)
+{
+    if (id == FROZEN_POINT_ID)
+        throw ANNException("Id " + std::to_string(id) + " is reserved", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    int status;
+    size_t delta_size;
+    {
+        std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+        {
+            // hides any older copy in the disk index or a frozen delta
+            std::lock_guard<std::mutex> dl(_deletes_lock);
+            _deletes[id] = ++_sequence;
+        }
+        std::vector<uint32_t> tags = {id_to_tag(id)}, not_found;
+        _delta->lazy_delete(tags, not_found);
+        status = _delta->insert_point(point, id_to_tag(id));
+        delta_size = _delta->get_num_points();
+    }
+
+    if (_params.merge_threshold > 0 && delta_size >= _params.merge_threshold)
+        start_merge();
+    return status;
+}
+
+template <typename T> void FreshDiskIndex<T>::lazy_delete(const uint32_t id)
+{
+    std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+    {
+        std::lock_guard<std::mutex> dl(_deletes_lock);
+        _deletes[id] = ++_sequence;
+    }
+    std::vector<uint32_t> tags = {id_to_tag(id)}, not_found;
+    _delta->lazy_delete(tags, not_found);
+}
+
+template <typename T>
+size_t FreshDiskIndex<T>::search(const T *query, const uint64_t K, const uint32_t L, const uint32_t beam_width,
+                                 uint32_t *ids, float *distances, QueryStats *stats)
+{
+    const uint32_t list_size = (std::max)(L, (uint32_t)K);
+    std::vector<std::pair<float, uint32_t>> candidates;
+
+    // held until the results are filtered, so that a merge cannot drop the
+    // deletes that still apply to the disk index searched here
+    std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+
+    // all candidates of the disk index, as deleted ones are dropped below
+    std::vector<uint64_t> disk_ids(list_size);
+    std::vector<float> disk_distances(list_size);
+    _disk->index->cached_beam_search(query, list_size, list_size, disk_ids.data(), disk_distances.data(), beam_width,
+                                     false, stats);
+    const size_t num_disk = (std::min)((uint64_t)list_size, _disk->index->get_num_points());
+
+    std::vector<uint32_t> tags(list_size);
+    std::vector<float> tag_distances(list_size);
+    std::vector<T *> no_vectors;
+    auto search_delta = [&](Delta &delta, std::vector<std::pair<float, uint32_t>> &found) {
+        const size_t num_found =
+            delta.search_with_tags(query, list_size, list_size, tags.data(), tag_distances.data(), no_vectors);
+        for (size_t i = 0; i < num_found; i++)
+            found.emplace_back(tag_distances[i], tag_to_id(tags[i]));
+    };
+    std::vector<std::vector<std::pair<float, uint32_t>>> frozen_candidates(_frozen_deltas.size());
+    for (size_t d = 0; d < _frozen_deltas.size(); d++)
+        search_delta(*_frozen_deltas[d].index, frozen_candidates[d]);
+
+    {
+        std::lock_guard<std::mutex> dl(_deletes_lock);
+        // a point is hidden by a delete or replacement later than the index
+        // it was found in
+        auto hidden = [&](uint32_t id, uint64_t sequence) {
+            auto iter = _deletes.find(id);
+            return iter != _deletes.end() && iter->second > sequence;
+        };
+
+        for (size_t i = 0; i < num_disk; i++)
+        {
+            const uint32_t id = _disk->ids.empty() ? (uint32_t)disk_ids[i] : _disk->ids[disk_ids[i]];
+            if (id != FROZEN_POINT_ID && !hidden(id, 0))
+                candidates.emplace_back(disk_distances[i], id);
+        }
+        for (size_t d = 0; d < _frozen_deltas.size(); d++)
+        {
+            for (const auto &candidate : frozen_candidates[d])
+            {
+                if (!hidden(candidate.second, _frozen_deltas[d].sequence))
+                    candidates.push_back(candidate);
+            }
+        }
+    }
+    search_delta(*_delta, candidates);
+    sl.unlock();
+
+    // an id is in at most one of the indices unless it was replaced while
+    // being searched; keep its closest copy
+    std::sort(candidates.begin(), candidates.end());
+    tsl::robin_set<uint32_t> seen;
+    size_t num_results = 0;
+    for (size_t i = 0; i < candidates.size() && num_results < K; i++)
+    {
+        if (!seen.insert(candidates[i].second).second)
+            continue;
+        ids[num_results] = candidates[i].second;
+        if (distances != nullptr)
+            distances[num_results] = candidates[i].first;
+        num_results++;
+    }
+    return num_results;
+}
+
+template <typename T> bool FreshDiskIndex<T>::start_merge()
+{
+    bool expected = false;
+    if (!_merging.compare_exchange_strong(expected, true))
+        return false;
+    {
+        std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+        std::lock_guard<std::mutex> dl(_deletes_lock);
+        if (_delta->get_num_points() == 0 && _deletes.empty() && _frozen_deltas.empty())
+        {
+            _merging = false;
+            return false;
+        }
+    }
+
+    if (_merge_thread.joinable())
+        _merge_thread.join();
+    _merge_error = nullptr;
+    _merge_thread = std::thread([this]() {
+        try
+        {
+            merge_deltas();
+        }
+        catch (...)
+        {
+            diskann::cerr << "Merge into the disk index failed; the delta is kept for the next merge" << std::endl;
+            _merge_error = std::current_exception();
+        }
+        _merging = false;
+    });
+    return true;
+}
+
+template <typename T> void FreshDiskIndex<T>::merge()
+{
+    merge_deltas();
+}
+
+template <typename T> void FreshDiskIndex<T>::wait_for_merge()
+{
+    if (_merge_thread.joinable())
+        _merge_thread.join();
+    if (_merge_error != nullptr)
+    {
+        std::exception_ptr error = _merge_error;
+        _merge_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename T> void FreshDiskIndex<T>::merge_deltas()
+{
+    std::lock_guard<std::mutex> ml(_merge_lock);
+
+    // freeze the delta and take the deletes made so far; inserts and deletes
+    // from here on go to a new delta and stay in the list
+    std::shared_ptr<DiskGeneration> disk;
+    std::vector<FrozenDelta> deltas;
+    tsl::robin_map<uint32_t, uint64_t> deletes;
+    uint64_t sequence;
+    {
+        // the next delta is allocated before searches are held up
+        std::shared_ptr<Delta> next_delta;
+        {
+            std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+            if (_delta->get_num_points() > 0)
+                next_delta = create_delta();
+        }
+        std::unique_lock<std::shared_timed_mutex> sl(_state_lock);
+        std::lock_guard<std::mutex> dl(_deletes_lock);
+        if (next_delta != nullptr)
+        {
+            _frozen_deltas.push_back(FrozenDelta{_delta, _sequence});
+            _delta = next_delta;
+        }
+        if (_frozen_deltas.empty() && _deletes.empty())
+            return;
+        disk = _disk;
+        deltas = _frozen_deltas;
+        deletes = _deletes;
+        sequence = _sequence;
+    }
+
+    Timer timer;
+    std::shared_ptr<DiskGeneration> merged = build_generation(disk, deltas, deletes);
+
+    // the indices are swapped while no search runs; deletes merged into the
+    // new disk index no longer apply
+    std::shared_ptr<DiskGeneration> old_disk;
+    {
+        std::unique_lock<std::shared_timed_mutex> sl(_state_lock);
+        std::lock_guard<std::mutex> dl(_deletes_lock);
+        old_disk = _disk;
+        _disk = merged;
+        _frozen_deltas.erase(_frozen_deltas.begin(), _frozen_deltas.begin() + deltas.size());
+        for (auto iter = _deletes.begin(); iter != _deletes.end();)
+        {
+            if (iter->second <= sequence)
+                iter = _deletes.erase(iter);
+            else
+                ++iter;
+        }
+    }
+    {
+        std::ofstream generation_file(_index_prefix + "_fresh_generation.txt", std::ios::trunc);
+        generation_file << merged->number << std::endl;
+    }
+    disk.reset();
+    if (old_disk->number > 0)
+    {
+        const std::string old_prefix = old_disk->prefix;
+        old_disk.reset();
+        remove_generation_files(old_prefix);
+    }
+    diskann::cout << timer.elapsed_seconds_for_step("merging into disk index generation " +
+                                                    std::to_string(merged->number))
+                  << std::endl;
+}
+
+template <typename T>
+std::shared_ptr<typename FreshDiskIndex<T>::DiskGeneration> FreshDiskIndex<T>::build_generation(
+    const std::shared_ptr<DiskGeneration> &disk, const std::vector<FrozenDelta> &deltas,
+    const tsl::robin_map<uint32_t, uint64_t> &deletes)
+{
+    Timer timer;
+    const uint64_t number = disk->number + 1;
+    const std::string prefix = generation_prefix(number);
+    const std::string disk_index_path = disk->prefix + "_disk.index";
+    const std::string mem_index_path = prefix + "_mem.index";
+    remove_generation_files(prefix);
+
+    // the graph of the current disk index, with a frozen point as the
+    // dynamic index needs one, tagged with the ids of its points
+    const std::vector<uint64_t> meta = load_disk_index_metadata(disk_index_path);
+    const uint64_t num_points = disk_index_to_mem_index<T>(disk_index_path, mem_index_path, true);
+    const uint64_t frozen_node = meta[5] > 0 ? meta[6] : meta[0];
+    std::vector<uint32_t> node_ids = disk->ids;
+    if (node_ids.empty())
+    {
+        const std::string layout_ids_path = disk_index_path + "_layout_ids.bin";
+        if (file_exists(layout_ids_path))
+        {
+            std::unique_ptr<uint32_t[]> layout_ids;
+            size_t num_ids, ids_dim;
+            diskann::load_bin<uint32_t>(layout_ids_path, layout_ids, num_ids, ids_dim);
+            node_ids.assign(layout_ids.get(), layout_ids.get() + num_ids);
+        }
+        else
+        {
+            node_ids.resize(meta[0]);
+            for (uint32_t i = 0; i < (uint32_t)meta[0]; i++)
+                node_ids[i] = i;
+        }
+    }
+    std::vector<uint32_t> tags(num_points);
+    for (uint64_t i = 0; i < num_points; i++)
+        tags[i] = i == frozen_node ? 0 : id_to_tag(node_ids[i]);
+    diskann::save_bin<uint32_t>(mem_index_path + ".tags", tags.data(), tags.size(), 1);
+
+    // the newest copy of each point of the deltas that is not deleted or
+    // replaced since
+    tsl::robin_set<uint32_t> taken;
+    std::vector<uint32_t> delta_tags;
+    std::vector<T> delta_points;
+    std::vector<T> point(_dim);
+    for (auto delta = deltas.rbegin(); delta != deltas.rend(); ++delta)
+    {
+        tsl::robin_set<uint32_t> active_tags;
+        delta->index->get_active_tags(active_tags);
+        for (uint32_t tag : active_tags)
+        {
+            const uint32_t id = tag_to_id(tag);
+            auto iter = deletes.find(id);
+            if ((iter != deletes.end() && iter->second > delta->sequence) || !taken.insert(id).second)
+                continue;
+            delta->index->get_vector_by_tag(tag, point.data());
+            delta_tags.push_back(tag);
+            delta_points.insert(delta_points.end(), point.begin(), point.end());
+        }
+    }
+
+    // remove the deleted and replaced points, then insert the deltas
+    const uint32_t width = (uint32_t)((meta[3] - meta[1] * sizeof(T)) / sizeof(uint32_t) - 1);
+    IndexWriteParameters params = IndexWriteParametersBuilder(_params.merge_L, width)
+                                      .with_alpha(_params.merge_alpha)
+                                      .with_saturate_graph(false)
+                                      .with_num_threads(_num_threads)
+                                      .build();
+    {
+        Index<T, uint32_t, uint32_t> index(diskann::Metric::L2, _dim, num_points + delta_tags.size(),
+                                           std::make_shared<IndexWriteParameters>(params), nullptr, 1, true, true,
+                                           false, false, 0, false);
+        index.load(mem_index_path.c_str(), _num_threads, _params.merge_L);
+        if (!deletes.empty())
+        {
+            index.enable_delete();
+            std::vector<uint32_t> deleted_tags, not_found;
+            deleted_tags.reserve(deletes.size());
+            for (const auto &deleted : deletes)
+                deleted_tags.push_back(id_to_tag(deleted.first));
+            index.lazy_delete(deleted_tags, not_found);
+            if (not_found.size() < deleted_tags.size())
+                index.consolidate_deletes(params);
+        }
+        if (!delta_tags.empty())
+        {
+            std::vector<int> statuses(delta_tags.size());
+            index.insert_points(delta_points.data(), delta_tags.data(), delta_tags.size(), statuses);
+        }
+        index.save(mem_index_path.c_str(), true);
+    }
+    diskann::cout << timer.elapsed_seconds_for_step("removing " + std::to_string(deletes.size()) +
+                                                    " deleted and inserting " + std::to_string(delta_tags.size()) +
+                                                    " points")
+                  << std::endl;
+
+    // lay out the merged graph, and compress its points with the pivots of
+    // the original index
+    timer.reset();
+    create_disk_layout<T>(mem_index_path + ".data", mem_index_path, prefix + "_disk.index");
+    uint32_t num_centers, num_chunks;
+    bool use_opq;
+    const std::string pivots_path = _index_prefix + "_pq_pivots.bin";
+    get_pq_pivots_metadata(pivots_path, num_centers, num_chunks, use_opq);
+    generate_pq_data_from_pivots<T>(mem_index_path + ".data", num_centers, num_chunks, pivots_path,
+                                    prefix + "_pq_compressed.bin", use_opq);
+
+    // node ids, with the frozen point written last by save()
+    std::unique_ptr<uint32_t[]> saved_tags;
+    size_t num_tags, tags_dim;
+    diskann::load_bin<uint32_t>(mem_index_path + ".tags", saved_tags, num_tags, tags_dim);
+    std::vector<uint32_t> ids(num_tags);
+    for (size_t i = 0; i < num_tags; i++)
+        ids[i] = saved_tags[i] == 0 ? FROZEN_POINT_ID : tag_to_id(saved_tags[i]);
+    diskann::save_bin<uint32_t>(prefix + "_disk.index_tags.bin", ids.data(), ids.size(), 1);
+
+    for (const std::string suffix : {"", ".data", ".tags"})
+        std::remove((mem_index_path + suffix).c_str());
+    std::remove((prefix + "_pq_compressed.bin_inflated.bin").c_str());
+    diskann::cout << timer.elapsed_seconds_for_step("writing disk index generation " + std::to_string(number))
+                  << std::endl;
+
+    return open_generation(number);
+}
+
+template <typename T> size_t FreshDiskIndex<T>::get_delta_size()
+{
+    std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+    size_t size = _delta->get_num_points();
+    for (const auto &frozen : _frozen_deltas)
+        size += frozen.index->get_num_points();
+    return size;
+}
+
+template <typename T> size_t FreshDiskIndex<T>::get_num_pending_deletes()
+{
+    std::lock_guard<std::mutex> dl(_deletes_lock);
+    return _deletes.size();
+}
+
+template <typename T> uint64_t FreshDiskIndex<T>::get_generation()
+{
+    std::shared_lock<std::shared_timed_mutex> sl(_state_lock);
+    return _disk->number;
+}
+
+template DISKANN_DLLEXPORT class FreshDiskIndex<float>;
+template DISKANN_DLLEXPORT class FreshDiskIndex<int8_t>;
+template DISKANN_DLLEXPORT class FreshDiskIndex<uint8_t>;
+} // namespace diskann
@@ -0,0 +1,310 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <omp.h>
+
+#include "gpu_graph_build.h"
+#include "cached_io.h"
+#include "disk_utils.h"
+#include "logger.h"
+#include "neighbor.h"
+#include "timer.h"
+#include "utils.h"
+
+#ifdef USE_CUDA
+#include "gpu_math_utils.h"
+#endif
+
+namespace diskann
+{
+#ifdef USE_CUDA
+namespace
+{
+// bytes of the k nearest lists of one batch of queries
+const size_t KNN_BATCH_BYTES = (size_t)512 * 1024 * 1024;
+
+// The robust prune of Vamana (Index::occlude_list) of the candidates of node
+// p, sorted by their distance to it, down to R neighbors
+void robust_prune(const uint32_t p, const std::vector<Neighbor> &pool, const float alpha, const uint32_t R,
+                  const float *data, const size_t aligned_dim, Distance<float> *dist_fn,
+                  std::vector<float> &occlude_factor, std::vector<uint32_t> &result)
+{
+    result.clear();
+    occlude_factor.assign(pool.size(), 0.0f);
+    float cur_alpha = 1;
+    while (cur_alpha <= alpha && result.size() < R)
+    {
+        for (size_t i = 0; i < pool.size() && result.size() < R; i++)
+        {
+            if (occlude_factor[i] > cur_alpha)
+                continue;
+            occlude_factor[i] = std::numeric_limits<float>::max();
+            if (pool[i].id != p)
+                result.push_back(pool[i].id);
+            const float *vec = data + pool[i].id * aligned_dim;
+            for (size_t j = i + 1; j < pool.size(); j++)
+            {
+                if (occlude_factor[j] > alpha)
+                    continue;
+                const float djk = dist_fn->compare(vec, data + pool[j].id * aligned_dim, (uint32_t)aligned_dim);
+                occlude_factor[j] = djk == 0 ? std::numeric_limits<float>::max()
+                                             : (std::max)(occlude_factor[j], pool[j].distance / djk);
+            }
+        }
+        cur_alpha *= 1.2f;
+    }
+}
+
+// the point closest to the mean of the points
+uint32_t find_medoid(const float *data, const size_t npts, const size_t aligned_dim)
+{
+    std::vector<double> center(aligned_dim, 0);
+    for (size_t i = 0; i < npts; i++)
+        for (size_t j = 0; j < aligned_dim; j++)
+            center[j] += data[i * aligned_dim + j];
+
+    std::vector<float> dists(npts);
+#pragma omp parallel for schedule(static, 65536)
+    for (int64_t i = 0; i < (int64_t)npts; i++)
+    {
+        double dist = 0;
+        for (size_t j = 0; j < aligned_dim; j++)
+        {
+            const double diff = center[j] / npts - data[i * aligned_dim + j];
+            dist += diff * diff;
+        }
+        dists[i] = (float)dist;
+    }
+    return (uint32_t)(std::min_element(dists.begin(), dists.end()) - dists.begin());
+}
+} // namespace
+#endif
+
+template <typename T>
+bool build_graph_on_gpu(const std::string &data_file, const diskann::Metric metric, const uint32_t R,
+                        const uint32_t knn_degree, const float alpha, const uint32_t num_threads,
+                        const std::string &graph_file)
+{
+#ifndef USE_CUDA
+    (void)data_file;
+    (void)metric;
+    (void)R;
+    (void)knn_degree;
+    (void)alpha;
+    (void)num_threads;
+    (void)graph_file;
+    return false;
+#else
+    if (metric != diskann::Metric::L2 || !math_utils::gpu::is_available())
+        return false;
+    if (num_threads != 0)
+        omp_set_num_threads(num_threads);
+
+    Timer timer;
+    size_t npts, dim, aligned_dim;
+    std::unique_ptr<float, decltype(&diskann::aligned_free)> data(nullptr, &diskann::aligned_free);
+    {
+        T *raw = nullptr;
+        diskann::load_aligned_bin<T>(data_file, raw, npts, dim, aligned_dim);
+        std::unique_ptr<T, decltype(&diskann::aligned_free)> raw_holder(raw, &diskann::aligned_free);
+        float *converted = nullptr;
+        diskann::alloc_aligned((void **)&converted, npts * aligned_dim * sizeof(float), 8 * sizeof(float));
+        data.reset(converted);
+        diskann::convert_types<T, float>(raw, converted, npts, aligned_dim);
+    }
+    if (npts < 2)
+        return false;
+
+    // the nearest neighbors of every point, the point itself among them, a
+    // batch of queries at a time
+    const size_t k = (std::min)((size_t)knn_degree, npts - 1) + 1;
+    const size_t batch = (std::max)((size_t)1, KNN_BATCH_BYTES / (k * (sizeof(float) + sizeof(uint32_t))));
+    std::vector<uint32_t> knn_ids(npts * k);
+    std::vector<float> knn_dists(npts * k);
+    for (size_t start = 0; start < npts; start += batch)
+    {
+        const size_t num_queries = (std::min)(batch, npts - start);
+        std::fill(knn_dists.begin() + start * k, knn_dists.begin() + (start + num_queries) * k, FLT_MAX);
+        std::fill(knn_ids.begin() + start * k, knn_ids.begin() + (start + num_queries) * k,
+                  std::numeric_limits<uint32_t>::max());
+        math_utils::gpu::update_knn(data.get(), npts, 0, aligned_dim, data.get() + start * aligned_dim, num_queries,
+                                    k, false, nullptr, knn_dists.data() + start * k, knn_ids.data() + start * k);
+    }
+
+    // the nearest points of a random sample, whose edges span the gaps between
+    // clusters that the nearest neighbors stay within, as the random edges
+    // Index::build() starts from do
+    const size_t num_samples = (std::min)(npts, (std::max)((size_t)R, (size_t)std::sqrt((double)npts)));
+    const size_t k_samples = (std::min)((size_t)(std::max)(R / 2, 1u), num_samples);
+    std::vector<uint32_t> samples(npts);
+    std::iota(samples.begin(), samples.end(), 0);
+    std::shuffle(samples.begin(), samples.end(), std::mt19937(0xdeadbeef));
+    samples.resize(num_samples);
+    std::vector<float> sample_data(num_samples * aligned_dim);
+    for (size_t i = 0; i < num_samples; i++)
+        std::copy(data.get() + samples[i] * aligned_dim, data.get() + (samples[i] + 1) * aligned_dim,
+                  sample_data.data() + i * aligned_dim);
+    std::vector<uint32_t> sample_ids(npts * k_samples);
+    std::vector<float> sample_dists(npts * k_samples);
+    for (size_t start = 0; start < npts; start += batch)
+    {
+        const size_t num_queries = (std::min)(batch, npts - start);
+        std::fill(sample_dists.begin() + start * k_samples, sample_dists.begin() + (start + num_queries) * k_samples,
+                  FLT_MAX);
+        std::fill(sample_ids.begin() + start * k_samples, sample_ids.begin() + (start + num_queries) * k_samples,
+                  std::numeric_limits<uint32_t>::max());
+        math_utils::gpu::update_knn(sample_data.data(), num_samples, 0, aligned_dim, data.get() + start * aligned_dim,
+                                    num_queries, k_samples, false, nullptr, sample_dists.data() + start * k_samples,
+                                    sample_ids.data() + start * k_samples);
+    }
+    std::vector<float>().swap(sample_data);
+    diskann::cout << timer.elapsed_seconds_for_step("finding the " + std::to_string(k - 1) + " nearest neighbors and " +
+                                                    std::to_string(k_samples) + " nearest samples on the GPU")
+                  << std::endl;
+
+    // prune the lists, then add the reverse edges and prune again the lists
+    // that no longer fit
+    timer.reset();
+    std::unique_ptr<Distance<float>> dist_fn(get_distance_function<float>(diskann::Metric::L2));
+    std::vector<std::vector<uint32_t>> graph(npts);
+#pragma omp parallel
+    {
+        std::vector<Neighbor> pool;
+        std::vector<float> occlude_factor;
+#pragma omp for schedule(dynamic, 1024)
+        for (int64_t p = 0; p < (int64_t)npts; p++)
+        {
+            pool.clear();
+            for (size_t j = 0; j < k; j++)
+            {
+                const uint32_t id = knn_ids[p * k + j];
+                if (id != (uint32_t)p && id != std::numeric_limits<uint32_t>::max())
+                    pool.emplace_back(id, knn_dists[p * k + j]);
+            }
+            const size_t num_nearest = pool.size();
+            for (size_t j = 0; j < k_samples; j++)
+            {
+                const uint32_t sample = sample_ids[p * k_samples + j];
+                if (sample == std::numeric_limits<uint32_t>::max())
+                    continue;
+                const uint32_t id = samples[sample];
+                if (id != (uint32_t)p &&
+                    std::find_if(pool.begin(), pool.begin() + num_nearest,
+                                 [id](const Neighbor &nbr) { return nbr.id == id; }) == pool.begin() + num_nearest)
+                    pool.emplace_back(id, sample_dists[p * k_samples + j]);
+            }
+            std::sort(pool.begin(), pool.end());
+            robust_prune((uint32_t)p, pool, alpha, R, data.get(), aligned_dim, dist_fn.get(), occlude_factor,
+                         graph[p]);
+        }
+    }
+    std::vector<uint32_t>().swap(knn_ids);
+    std::vector<float>().swap(knn_dists);
+    std::vector<uint32_t>().swap(sample_ids);
+    std::vector<float>().swap(sample_dists);
+
+    std::vector<size_t> reverse_offsets(npts + 1, 0);
+    for (const auto &list : graph)
+        for (uint32_t nbr : list)
+            reverse_offsets[nbr + 1]++;
+    for (size_t i = 0; i < npts; i++)
+        reverse_offsets[i + 1] += reverse_offsets[i];
+    std::vector<uint32_t> reverse(reverse_offsets[npts]);
+    {
+        std::vector<size_t> fill(reverse_offsets.begin(), reverse_offsets.end() - 1);
+        for (size_t p = 0; p < npts; p++)
+            for (uint32_t nbr : graph[p])
+                reverse[fill[nbr]++] = (uint32_t)p;
+    }
+
+    std::vector<std::vector<uint32_t>> merged(npts);
+#pragma omp parallel
+    {
+        std::vector<Neighbor> pool;
+        std::vector<float> occlude_factor;
+#pragma omp for schedule(dynamic, 1024)
+        for (int64_t p = 0; p < (int64_t)npts; p++)
+        {
+            std::vector<uint32_t> &list = merged[p];
+            list = graph[p];
+            for (size_t j = reverse_offsets[p]; j < reverse_offsets[p + 1]; j++)
+            {
+                if (std::find(graph[p].begin(), graph[p].end(), reverse[j]) == graph[p].end())
+                    list.push_back(reverse[j]);
+            }
+            if (list.size() <= R)
+                continue;
+            pool.clear();
+            const float *vec = data.get() + p * aligned_dim;
+            for (uint32_t id : list)
+                pool.emplace_back(id, dist_fn->compare(vec, data.get() + id * aligned_dim, (uint32_t)aligned_dim));
+            std::sort(pool.begin(), pool.end());
+            robust_prune((uint32_t)p, pool, alpha, R, data.get(), aligned_dim, dist_fn.get(), occlude_factor, list);
+        }
+    }
+    graph.swap(merged);
+    std::vector<std::vector<uint32_t>>().swap(merged);
+    diskann::cout << timer.elapsed_seconds_for_step("pruning the neighbor lists") << std::endl;
+
+    // in the format of InMemGraphStore::store(), without frozen points
+    const uint32_t start = find_medoid(data.get(), npts, aligned_dim);
+    data.reset();
+    {
+        uint64_t file_size = sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+        uint32_t max_degree = 0;
+        for (const auto &list : graph)
+        {
+            file_size += sizeof(uint32_t) * (list.size() + 1);
+            max_degree = (std::max)(max_degree, (uint32_t)list.size());
+        }
+        const uint64_t num_frozen_pts = 0;
+        cached_ofstream writer(graph_file, 64 * 1024 * 1024);
+        writer.write((char *)&file_size, sizeof(uint64_t));
+        writer.write((char *)&max_degree, sizeof(uint32_t));
+        writer.write((char *)&start, sizeof(uint32_t));
+        writer.write((char *)&num_frozen_pts, sizeof(uint64_t));
+        for (const auto &list : graph)
+        {
+            const uint32_t nnbrs = (uint32_t)list.size();
+            writer.write((char *)&nnbrs, sizeof(uint32_t));
+            writer.write((char *)list.data(), nnbrs * sizeof(uint32_t));
+        }
+    }
+
+    // a graph of nearest neighbors may fall apart into clusters
+    repair_graph_connectivity<T>(graph_file, data_file, "", 1, std::numeric_limits<uint32_t>::max() - 1, R,
+                                 defaults::BUILD_LIST_SIZE, true);
+    return true;
+#endif
+}
+
+template DISKANN_DLLEXPORT bool build_graph_on_gpu<float>(const std::string &data_file, const diskann::Metric metric,
+                                                          const uint32_t R, const uint32_t knn_degree,
+                                                          const float alpha, const uint32_t num_threads,
+                                                          const std::string &graph_file);
+template DISKANN_DLLEXPORT bool build_graph_on_gpu<int8_t>(const std::string &data_file, const diskann::Metric metric,
+                                                           const uint32_t R, const uint32_t knn_degree,
+                                                           const float alpha, const uint32_t num_threads,
+                                                           const std::string &graph_file);
+template DISKANN_DLLEXPORT bool build_graph_on_gpu<uint8_t>(const std::string &data_file, const diskann::Metric metric,
+                                                            const uint32_t R, const uint32_t knn_degree,
+                                                            const float alpha, const uint32_t num_threads,
+                                                            const std::string &graph_file);
+template DISKANN_DLLEXPORT bool build_graph_on_gpu<float16>(const std::string &data_file, const diskann::Metric metric,
+                                                            const uint32_t R, const uint32_t knn_degree,
+                                                            const float alpha, const uint32_t num_threads,
+                                                            const std::string &graph_file);
+template DISKANN_DLLEXPORT bool build_graph_on_gpu<bfloat16>(const std::string &data_file,
+                                                             const diskann::Metric metric, const uint32_t R,
+                                                             const uint32_t knn_degree, const float alpha,
+                                                             const uint32_t num_threads, const std::string &graph_file);
+} // namespace diskann
@@ -0,0 +1,414 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+#include "ann_exception.h"
+#include "gpu_graph_search.h"
+#include "logger.h"
+
+namespace diskann
+{
+namespace
+{
+const unsigned WARP_SIZE = 32;
+const unsigned FULL_MASK = 0xffffffffu;
+const uint32_t EMPTY = 0xffffffffu;
+// set on the ids in a list of candidates once they have been expanded
+const uint32_t EXPANDED = 0x80000000u;
+const size_t MAX_BATCH = 1 << 16;
+
+void check(cudaError_t err, const char *what)
+{
+    if (err != cudaSuccess)
+        throw diskann::ANNException(std::string(what) + " failed: " + cudaGetErrorString(err), -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+}
+
+template <typename T> class DeviceBuffer
+{
+  public:
+    explicit DeviceBuffer(size_t count)
+    {
+        check(cudaMalloc((void **)&_ptr, std::max(count, (size_t)1) * sizeof(T)), "cudaMalloc");
+    }
+    ~DeviceBuffer()
+    {
+        cudaFree(_ptr);
+    }
+    DeviceBuffer(const DeviceBuffer &) = delete;
+    DeviceBuffer &operator=(const DeviceBuffer &) = delete;
+
+    T *get() const
+    {
+        return _ptr;
+    }
+
+  private:
+    T *_ptr = nullptr;
+};
+
+// page locked host memory, which asynchronous copies need
+template <typename T> class PinnedBuffer
+{
+  public:
+    explicit PinnedBuffer(size_t count)
+    {
+        check(cudaMallocHost((void **)&_ptr, std::max(count, (size_t)1) * sizeof(T)), "cudaMallocHost");
+    }
+    ~PinnedBuffer()
+    {
+        cudaFreeHost(_ptr);
+    }
+    PinnedBuffer(const PinnedBuffer &) = delete;
+    PinnedBuffer &operator=(const PinnedBuffer &) = delete;
+
+    T *get() const
+    {
+        return _ptr;
+    }
+
+  private:
+    T *_ptr = nullptr;
+};
+
+// The distance of the query to vec, summed over the lanes of the warp, a
+// dimension each; every lane gets the total
+__device__ float warp_distance(const float *query, const float *vec, size_t dim, bool inner_product)
+{
+    float sum = 0;
+    for (size_t j = threadIdx.x; j < dim; j += WARP_SIZE)
+    {
+        const float v = vec[j];
+        if (inner_product)
+        {
+            sum += query[j] * v;
+        }
+        else
+        {
+            const float diff = query[j] - v;
+            sum += diff * diff;
+        }
+    }
+    for (unsigned offset = WARP_SIZE / 2; offset > 0; offset /= 2)
+        sum += __shfl_xor_sync(FULL_MASK, sum, offset);
+    return inner_product ? -sum : sum;
+}
+
+// Adds id to the open addressing table of the query, of mask + 1 slots.
+// True if it was not there; a full table counts id as seen.
+__device__ bool visit(uint32_t *table, uint32_t mask, uint32_t id)
+{
+    uint32_t slot = (id * 2654435761u) & mask;
+    for (uint32_t probe = 0; probe <= mask; probe++)
+    {
+        const uint32_t prev = atomicCAS(table + slot, EMPTY, id);
+        if (prev == EMPTY)
+            return true;
+        if (prev == id)
+            return false;
+        slot = (slot + 1) & mask;
+    }
+    return false;
+}
+
+// Run by one lane: inserts id into the list of at most L candidates, kept
+// ascending by distance, unless the list is full of closer ones
+__device__ void insert_candidate(float *list_dists, uint32_t *list_ids, uint32_t &list_size, uint32_t L, uint32_t id,
+                                 float dist)
+{
+    if (list_size == L && dist >= list_dists[L - 1])
+        return;
+    uint32_t pos = list_size < L ? list_size : L - 1;
+    while (pos > 0 && list_dists[pos - 1] > dist)
+    {
+        list_dists[pos] = list_dists[pos - 1];
+        list_ids[pos] = list_ids[pos - 1];
+        pos--;
+    }
+    list_dists[pos] = dist;
+    list_ids[pos] = id;
+    if (list_size < L)
+        list_size++;
+}
+
+// One warp per query. The query and its list of candidates live in shared
+// memory, dim floats then L distances and L ids; the visited table of query
+// q is the (visited_mask + 1) slots at visited + q * (visited_mask + 1).
+__global__ void beam_search_kernel(const float *vectors, size_t dim, const uint32_t *graph, uint32_t max_degree,
+                                   const uint32_t *start_points, uint32_t num_start_points, const uint8_t *excluded,
+                                   bool inner_product, const float *queries, uint32_t L, uint32_t K,
+                                   uint32_t *visited, uint32_t visited_mask, uint32_t *result_ids,
+                                   float *result_dists)
+{
+    extern __shared__ float shared[];
+    float *query = shared;
+    float *list_dists = query + dim;
+    uint32_t *list_ids = (uint32_t *)(list_dists + L);
+    __shared__ uint32_t list_size;
+
+    const size_t q = blockIdx.x;
+    const unsigned lane = threadIdx.x;
+    for (size_t j = lane; j < dim; j += WARP_SIZE)
+        query[j] = queries[q * dim + j];
+    if (lane == 0)
+        list_size = 0;
+    __syncwarp();
+
+    uint32_t *table = visited + q * ((size_t)visited_mask + 1);
+    for (uint32_t s = 0; s < num_start_points; s++)
+    {
+        const uint32_t id = start_points[s];
+        int fresh = 0;
+        if (lane == 0)
+            fresh = visit(table, visited_mask, id);
+        if (!__shfl_sync(FULL_MASK, fresh, 0))
+            continue;
+        const float dist = warp_distance(query, vectors + (size_t)id * dim, dim, inner_product);
+        if (lane == 0)
+            insert_candidate(list_dists, list_ids, list_size, L, id, dist);
+        __syncwarp();
+    }
+
+    while (true)
+    {
+        // the closest candidate not yet expanded, each lane looking at every
+        // WARP_SIZE-th
+        uint32_t first = EMPTY;
+        const uint32_t size = list_size;
+        for (uint32_t i = lane; i < size; i += WARP_SIZE)
+        {
+            if ((list_ids[i] & EXPANDED) == 0)
+            {
+                first = i;
+                break;
+            }
+        }
+        for (unsigned offset = WARP_SIZE / 2; offset > 0; offset /= 2)
+            first = min(first, __shfl_xor_sync(FULL_MASK, first, offset));
+        if (first == EMPTY)
+            break;
+        const uint32_t node = list_ids[first];
+        __syncwarp();
+        if (lane == 0)
+            list_ids[first] = node | EXPANDED;
+        __syncwarp();
+
+        // each lane takes a neighbor, and the warp scores those it saw first
+        // one after the other
+        const uint32_t *nbrs = graph + (size_t)node * max_degree;
+        for (uint32_t base = 0; base < max_degree; base += WARP_SIZE)
+        {
+            const uint32_t j = base + lane;
+            const uint32_t nbr = j < max_degree ? nbrs[j] : EMPTY;
+            const bool fresh = nbr != EMPTY && visit(table, visited_mask, nbr);
+            unsigned pending = __ballot_sync(FULL_MASK, fresh);
+            while (pending != 0)
+            {
+                const int src = __ffs(pending) - 1;
+                pending &= pending - 1;
+                const uint32_t id = __shfl_sync(FULL_MASK, nbr, src);
+                const float dist = warp_distance(query, vectors + (size_t)id * dim, dim, inner_product);
+                if (lane == 0)
+                    insert_candidate(list_dists, list_ids, list_size, L, id, dist);
+                __syncwarp();
+            }
+            // the lists are padded at their end
+            if (__ballot_sync(FULL_MASK, j < max_degree && nbr == EMPTY) != 0)
+                break;
+        }
+    }
+
+    if (lane == 0)
+    {
+        uint32_t *ids = result_ids + q * K;
+        float *dists = result_dists + q * K;
+        uint32_t found = 0;
+        for (uint32_t i = 0; i < list_size && found < K; i++)
+        {
+            const uint32_t id = list_ids[i] & ~EXPANDED;
+            if (excluded != nullptr && excluded[id])
+                continue;
+            ids[found] = id;
+            dists[found] = list_dists[i];
+            found++;
+        }
+        for (; found < K; found++)
+        {
+            ids[found] = EMPTY;
+            dists[found] = FLT_MAX;
+        }
+    }
+}
+
+// the device buffers and page locked host buffers of one stream
+struct BatchBuffers
+{
+    BatchBuffers(size_t batch, size_t dim, size_t K, size_t table_size)
+        : d_queries(batch * dim), d_visited(batch * table_size), d_ids(batch * K), d_dists(batch * K),
+          h_queries(batch * dim), h_ids(batch * K), h_dists(batch * K)
+    {
+        check(cudaStreamCreate(&stream), "cudaStreamCreate");
+    }
+    ~BatchBuffers()
+    {
+        cudaStreamDestroy(stream);
+    }
+
+    cudaStream_t stream;
+    DeviceBuffer<float> d_queries;
+    DeviceBuffer<uint32_t> d_visited;
+    DeviceBuffer<uint32_t> d_ids;
+    DeviceBuffer<float> d_dists;
+    PinnedBuffer<float> h_queries;
+    PinnedBuffer<uint32_t> h_ids;
+    PinnedBuffer<float> h_dists;
+    // the queries [start, start + count) are in flight on the stream
+    size_t start = 0;
+    size_t count = 0;
+};
+} // namespace
+
+struct GpuGraphSearcher::Impl
+{
+    int device = 0;
+    size_t num_points = 0;
+    size_t dim = 0;
+    uint32_t max_degree = 0;
+    uint32_t num_start_points = 0;
+    bool inner_product = false;
+    std::unique_ptr<DeviceBuffer<float>> vectors;
+    std::unique_ptr<DeviceBuffer<uint32_t>> graph;
+    std::unique_ptr<DeviceBuffer<uint32_t>> start_points;
+    std::unique_ptr<DeviceBuffer<uint8_t>> excluded;
+};
+
+GpuGraphSearcher::GpuGraphSearcher(const float *vectors, size_t num_points, size_t dim, const uint32_t *graph,
+                                   uint32_t max_degree, const std::vector<uint32_t> &start_points,
+                                   const uint8_t *excluded, bool inner_product)
+    : _impl(new Impl())
+{
+    if (num_points >= EXPANDED || start_points.empty() || max_degree == 0)
+        throw diskann::ANNException("GpuGraphSearcher needs fewer than 2^31 points, a start point and edges", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+
+    check(cudaGetDevice(&_impl->device), "cudaGetDevice");
+    _impl->num_points = num_points;
+    _impl->dim = dim;
+    _impl->max_degree = max_degree;
+    _impl->num_start_points = (uint32_t)start_points.size();
+    _impl->inner_product = inner_product;
+
+    _impl->vectors.reset(new DeviceBuffer<float>(num_points * dim));
+    check(cudaMemcpy(_impl->vectors->get(), vectors, num_points * dim * sizeof(float), cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    _impl->graph.reset(new DeviceBuffer<uint32_t>(num_points * max_degree));
+    check(cudaMemcpy(_impl->graph->get(), graph, num_points * max_degree * sizeof(uint32_t), cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    _impl->start_points.reset(new DeviceBuffer<uint32_t>(start_points.size()));
+    check(cudaMemcpy(_impl->start_points->get(), start_points.data(), start_points.size() * sizeof(uint32_t),
+                     cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    if (excluded != nullptr)
+    {
+        _impl->excluded.reset(new DeviceBuffer<uint8_t>(num_points));
+        check(cudaMemcpy(_impl->excluded->get(), excluded, num_points, cudaMemcpyHostToDevice), "cudaMemcpy");
+    }
+    diskann::cout << "Copied " << num_points << " points of degree up to " << max_degree << " to CUDA device "
+                  << _impl->device << ", " << (device_bytes() >> 20) << " MB" << std::endl;
+}
+
+GpuGraphSearcher::~GpuGraphSearcher() = default;
+
+size_t GpuGraphSearcher::device_bytes() const
+{
+    return _impl->num_points * (_impl->dim * sizeof(float) + _impl->max_degree * sizeof(uint32_t) +
+                                (_impl->excluded != nullptr ? sizeof(uint8_t) : 0)) +
+           _impl->num_start_points * sizeof(uint32_t);
+}
+
+void GpuGraphSearcher::search(const float *queries, size_t num_queries, size_t K, uint32_t L, uint32_t *ids,
+                              float *dists)
+{
+    if (num_queries == 0 || K == 0)
+        return;
+    if (L < K || L > MAX_L)
+        throw diskann::ANNException("L must be at least K and at most " + std::to_string(MAX_L) + " on the GPU", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+
+    const Impl &impl = *_impl;
+    check(cudaSetDevice(impl.device), "cudaSetDevice");
+    const size_t shared_bytes = impl.dim * sizeof(float) + (size_t)L * (sizeof(float) + sizeof(uint32_t));
+    int max_shared_bytes = 0;
+    check(cudaDeviceGetAttribute(&max_shared_bytes, cudaDevAttrMaxSharedMemoryPerBlock, impl.device),
+          "cudaDeviceGetAttribute");
+    if (shared_bytes > (size_t)max_shared_bytes)
+        throw diskann::ANNException("The query and a list of " + std::to_string(L) +
+                                        " candidates do not fit in the shared memory of a block",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    // a visited table with twice the slots of the neighbors a search expanding
+    // about L nodes scores, so that probes stay short
+    const uint64_t expected_visits = 2 * ((uint64_t)L + impl.num_start_points) * impl.max_degree;
+    size_t table_size = 1;
+    while (table_size < expected_visits && table_size < ((size_t)1 << 31))
+        table_size <<= 1;
+
+    // two batches in flight, which take up to half of the free memory
+    size_t free_bytes = 0, total_bytes = 0;
+    check(cudaMemGetInfo(&free_bytes, &total_bytes), "cudaMemGetInfo");
+    const size_t bytes_per_query =
+        table_size * sizeof(uint32_t) + impl.dim * sizeof(float) + K * (sizeof(uint32_t) + sizeof(float));
+    const size_t batch = std::max((size_t)1, std::min({num_queries, free_bytes / 4 / bytes_per_query, MAX_BATCH}));
+
+    std::unique_ptr<BatchBuffers> buffers[2];
+    for (size_t s = 0; s < 2; s++)
+        buffers[s].reset(new BatchBuffers(batch, impl.dim, K, table_size));
+
+    // waits for the batch in flight on buffers, if any, and hands out its results
+    auto finish = [&](BatchBuffers &b) {
+        if (b.count == 0)
+            return;
+        check(cudaStreamSynchronize(b.stream), "cudaStreamSynchronize");
+        std::memcpy(ids + b.start * K, b.h_ids.get(), b.count * K * sizeof(uint32_t));
+        std::memcpy(dists + b.start * K, b.h_dists.get(), b.count * K * sizeof(float));
+        b.count = 0;
+    };
+
+    size_t next = 0;
+    for (size_t start = 0; start < num_queries; start += batch, next = 1 - next)
+    {
+        BatchBuffers &b = *buffers[next];
+        finish(b);
+        b.start = start;
+        b.count = std::min(batch, num_queries - start);
+
+        std::memcpy(b.h_queries.get(), queries + start * impl.dim, b.count * impl.dim * sizeof(float));
+        check(cudaMemcpyAsync(b.d_queries.get(), b.h_queries.get(), b.count * impl.dim * sizeof(float),
+                              cudaMemcpyHostToDevice, b.stream),
+              "cudaMemcpyAsync");
+        check(cudaMemsetAsync(b.d_visited.get(), 0xff, b.count * table_size * sizeof(uint32_t), b.stream),
+              "cudaMemsetAsync");
+        beam_search_kernel<<<(unsigned)b.count, WARP_SIZE, shared_bytes, b.stream>>>(
+            impl.vectors->get(), impl.dim, impl.graph->get(), impl.max_degree, impl.start_points->get(),
+            impl.num_start_points, impl.excluded != nullptr ? impl.excluded->get() : nullptr, impl.inner_product,
+            b.d_queries.get(), L, (uint32_t)K, b.d_visited.get(), (uint32_t)(table_size - 1), b.d_ids.get(),
+            b.d_dists.get());
+        check(cudaGetLastError(), "beam_search_kernel");
+        check(cudaMemcpyAsync(b.h_ids.get(), b.d_ids.get(), b.count * K * sizeof(uint32_t), cudaMemcpyDeviceToHost,
+                              b.stream),
+              "cudaMemcpyAsync");
+        check(cudaMemcpyAsync(b.h_dists.get(), b.d_dists.get(), b.count * K * sizeof(float),
+                              cudaMemcpyDeviceToHost, b.stream),
+              "cudaMemcpyAsync");
+    }
+    finish(*buffers[next]);
+    finish(*buffers[1 - next]);
+}
+} // namespace diskann
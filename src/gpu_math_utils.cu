@@ -0,0 +1,516 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cublas_v2.h>
+#include <cuda_runtime.h>
+#include <thrust/binary_search.h>
+#include <thrust/device_ptr.h>
+#include <thrust/execution_policy.h>
+#include <thrust/functional.h>
+#include <thrust/scan.h>
+
+#include "ann_exception.h"
+#include "gpu_math_utils.h"
+#include "logger.h"
+
+namespace math_utils
+{
+namespace gpu
+{
+namespace
+{
+const size_t THREADS_PER_BLOCK = 256;
+const size_t MAX_BLOCK_POINTS = 1 << 26;
+
+void check(cudaError_t err, const char *what)
+{
+    if (err != cudaSuccess)
+        throw diskann::ANNException(std::string(what) + " failed: " + cudaGetErrorString(err), -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+}
+
+void check(cublasStatus_t status, const char *what)
+{
+    if (status != CUBLAS_STATUS_SUCCESS)
+        throw diskann::ANNException(std::string(what) + " failed with cuBLAS status " + std::to_string((int)status),
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+size_t num_blocks(size_t n)
+{
+    return (n + THREADS_PER_BLOCK - 1) / THREADS_PER_BLOCK;
+}
+
+template <typename T> class DeviceBuffer
+{
+  public:
+    explicit DeviceBuffer(size_t count)
+    {
+        check(cudaMalloc((void **)&_ptr, std::max(count, (size_t)1) * sizeof(T)), "cudaMalloc");
+    }
+    ~DeviceBuffer()
+    {
+        cudaFree(_ptr);
+    }
+    DeviceBuffer(const DeviceBuffer &) = delete;
+    DeviceBuffer &operator=(const DeviceBuffer &) = delete;
+
+    T *get() const
+    {
+        return _ptr;
+    }
+
+  private:
+    T *_ptr = nullptr;
+};
+
+class CublasHandle
+{
+  public:
+    CublasHandle()
+    {
+        check(cublasCreate(&_handle), "cublasCreate");
+    }
+    ~CublasHandle()
+    {
+        cublasDestroy(_handle);
+    }
+    CublasHandle(const CublasHandle &) = delete;
+    CublasHandle &operator=(const CublasHandle &) = delete;
+
+    cublasHandle_t get() const
+    {
+        return _handle;
+    }
+
+  private:
+    cublasHandle_t _handle;
+};
+
+__global__ void row_norms_kernel(const float *data, size_t num_rows, size_t dim, float *norms)
+{
+    const size_t row = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (row >= num_rows)
+        return;
+    const float *vec = data + row * dim;
+    float sum = 0;
+    for (size_t d = 0; d < dim; d++)
+        sum += vec[d] * vec[d];
+    norms[row] = sum;
+}
+
+// dots holds the inner product of every point with every center, point major.
+// Each thread keeps its point's k closest centers sorted in registers; ties go
+// to the lower center id, as on the CPU.
+__global__ void select_closest_kernel(const float *dots, const float *pts_norms, const float *centers_norms,
+                                      size_t num_points, size_t num_centers, size_t k, uint32_t *closest)
+{
+    const size_t point = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (point >= num_points)
+        return;
+
+    float best_dists[MAX_K];
+    uint32_t best_ids[MAX_K];
+    for (size_t l = 0; l < k; l++)
+    {
+        best_dists[l] = FLT_MAX;
+        best_ids[l] = 0;
+    }
+
+    const float *row = dots + point * num_centers;
+    for (size_t c = 0; c < num_centers; c++)
+    {
+        const float dist = pts_norms[point] + centers_norms[c] - 2 * row[c];
+        if (dist >= best_dists[k - 1])
+            continue;
+        size_t pos = k - 1;
+        while (pos > 0 && best_dists[pos - 1] > dist)
+        {
+            best_dists[pos] = best_dists[pos - 1];
+            best_ids[pos] = best_ids[pos - 1];
+            pos--;
+        }
+        best_dists[pos] = dist;
+        best_ids[pos] = (uint32_t)c;
+    }
+
+    for (size_t l = 0; l < k; l++)
+        closest[point * k + l] = best_ids[l];
+}
+
+// dists[i] = min(dists[i], |data[i] - pivot|^2), or just the distance when
+// first is set
+__global__ void update_min_dists_kernel(const float *data, size_t num_points, size_t dim, const float *pivot,
+                                        float *dists, bool first)
+{
+    const size_t point = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (point >= num_points)
+        return;
+    const float *vec = data + point * dim;
+    float sum = 0;
+    for (size_t d = 0; d < dim; d++)
+    {
+        const float diff = vec[d] - pivot[d];
+        sum += diff * diff;
+    }
+    dists[point] = first ? sum : fminf(dists[point], sum);
+}
+
+// dots holds the inner product of every query with every point of a tile,
+// query major within each point so that the threads of a warp read adjacent
+// queries. Each thread merges the tile into the k nearest list of its query,
+// kept ascending in global memory; candidates no closer than the farthest in
+// the list are skipped, as in the CPU heaps, so most cost one comparison.
+__global__ void merge_knn_kernel(const float *dots, const float *pts_norms, const float *query_norms,
+                                 const uint8_t *excluded, size_t num_queries, size_t tile_size, uint32_t first_id,
+                                 size_t k, bool inner_product, float *knn_dists, uint32_t *knn_ids)
+{
+    const size_t query = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (query >= num_queries)
+        return;
+
+    float *dists = knn_dists + query * k;
+    uint32_t *ids = knn_ids + query * k;
+    float worst = dists[k - 1];
+    for (size_t p = 0; p < tile_size; p++)
+    {
+        if (excluded != nullptr && excluded[p])
+            continue;
+        const float dot = dots[p * num_queries + query];
+        const float dist = inner_product ? -dot : pts_norms[p] + query_norms[query] - 2 * dot;
+        if (dist >= worst)
+            continue;
+        size_t pos = k - 1;
+        while (pos > 0 && dists[pos - 1] > dist)
+        {
+            dists[pos] = dists[pos - 1];
+            ids[pos] = ids[pos - 1];
+            pos--;
+        }
+        dists[pos] = dist;
+        ids[pos] = first_id + (uint32_t)p;
+        worst = dists[k - 1];
+    }
+}
+
+// update_knn() on one device for the queries [query_begin, query_end)
+void update_knn_on_device(int device, const float *points, size_t num_points, uint32_t id_offset, size_t dim,
+                          const float *queries, size_t query_begin, size_t query_end, size_t k, bool inner_product,
+                          const uint8_t *excluded, float *knn_dists, uint32_t *knn_ids)
+{
+    check(cudaSetDevice(device), "cudaSetDevice");
+    const size_t num_queries = query_end - query_begin;
+
+    CublasHandle cublas;
+    DeviceBuffer<float> d_queries(num_queries * dim);
+    DeviceBuffer<float> d_query_norms(num_queries);
+    DeviceBuffer<float> d_knn_dists(num_queries * k);
+    DeviceBuffer<uint32_t> d_knn_ids(num_queries * k);
+    check(cudaMemcpy(d_queries.get(), queries + query_begin * dim, num_queries * dim * sizeof(float),
+                     cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    check(cudaMemcpy(d_knn_dists.get(), knn_dists + query_begin * k, num_queries * k * sizeof(float),
+                     cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    check(cudaMemcpy(d_knn_ids.get(), knn_ids + query_begin * k, num_queries * k * sizeof(uint32_t),
+                     cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    row_norms_kernel<<<(unsigned)num_blocks(num_queries), THREADS_PER_BLOCK>>>(d_queries.get(), num_queries, dim,
+                                                                               d_query_norms.get());
+    check(cudaGetLastError(), "row_norms_kernel");
+
+    // Two tiles of points, each with its norms, mask and inner products with
+    // all queries, take up to half of the free device memory. While one
+    // tile is multiplied and merged on its stream, the next is copied on the
+    // other; the merges still run in order, as they share the lists.
+    size_t free_bytes = 0, total_bytes = 0;
+    check(cudaMemGetInfo(&free_bytes, &total_bytes), "cudaMemGetInfo");
+    const size_t bytes_per_point = (dim + 1 + num_queries) * sizeof(float) + sizeof(uint8_t);
+    const size_t tile_size =
+        std::max((size_t)1, std::min({num_points, free_bytes / 4 / bytes_per_point, MAX_BLOCK_POINTS}));
+
+    std::vector<std::unique_ptr<DeviceBuffer<float>>> d_points, d_pts_norms, d_dots;
+    std::vector<std::unique_ptr<DeviceBuffer<uint8_t>>> d_excluded;
+    cudaStream_t streams[2];
+    for (size_t b = 0; b < 2; b++)
+    {
+        d_points.emplace_back(new DeviceBuffer<float>(tile_size * dim));
+        d_pts_norms.emplace_back(new DeviceBuffer<float>(tile_size));
+        d_dots.emplace_back(new DeviceBuffer<float>(tile_size * num_queries));
+        d_excluded.emplace_back(new DeviceBuffer<uint8_t>(excluded != nullptr ? tile_size : 1));
+        check(cudaStreamCreate(&streams[b]), "cudaStreamCreate");
+    }
+    cudaEvent_t merged;
+    check(cudaEventCreateWithFlags(&merged, cudaEventDisableTiming), "cudaEventCreate");
+
+    size_t tile = 0;
+    for (size_t start = 0; start < num_points; start += tile_size, tile++)
+    {
+        const size_t b = tile % 2;
+        const size_t cur_tile_size = std::min(tile_size, num_points - start);
+        check(cudaMemcpyAsync(d_points[b]->get(), points + start * dim, cur_tile_size * dim * sizeof(float),
+                              cudaMemcpyHostToDevice, streams[b]),
+              "cudaMemcpyAsync");
+        if (excluded != nullptr)
+        {
+            check(cudaMemcpyAsync(d_excluded[b]->get(), excluded + start, cur_tile_size, cudaMemcpyHostToDevice,
+                                  streams[b]),
+                  "cudaMemcpyAsync");
+        }
+        row_norms_kernel<<<(unsigned)num_blocks(cur_tile_size), THREADS_PER_BLOCK, 0, streams[b]>>>(
+            d_points[b]->get(), cur_tile_size, dim, d_pts_norms[b]->get());
+        check(cudaGetLastError(), "row_norms_kernel");
+
+        // cuBLAS is column major: queries^T * points is the num_queries x
+        // cur_tile_size matrix of dots, with the queries of a point adjacent
+        const float alpha = 1.0f, beta = 0.0f;
+        check(cublasSetStream(cublas.get(), streams[b]), "cublasSetStream");
+        check(cublasSgemm(cublas.get(), CUBLAS_OP_T, CUBLAS_OP_N, (int)num_queries, (int)cur_tile_size, (int)dim,
+                          &alpha, d_queries.get(), (int)dim, d_points[b]->get(), (int)dim, &beta, d_dots[b]->get(),
+                          (int)num_queries),
+              "cublasSgemm");
+
+        if (tile > 0)
+            check(cudaStreamWaitEvent(streams[b], merged, 0), "cudaStreamWaitEvent");
+        merge_knn_kernel<<<(unsigned)num_blocks(num_queries), THREADS_PER_BLOCK, 0, streams[b]>>>(
+            d_dots[b]->get(), d_pts_norms[b]->get(), d_query_norms.get(),
+            excluded != nullptr ? d_excluded[b]->get() : nullptr, num_queries, cur_tile_size,
+            id_offset + (uint32_t)start, k, inner_product, d_knn_dists.get(), d_knn_ids.get());
+        check(cudaGetLastError(), "merge_knn_kernel");
+        check(cudaEventRecord(merged, streams[b]), "cudaEventRecord");
+    }
+
+    for (size_t b = 0; b < 2; b++)
+    {
+        check(cudaStreamSynchronize(streams[b]), "cudaStreamSynchronize");
+        cudaStreamDestroy(streams[b]);
+    }
+    cudaEventDestroy(merged);
+    check(cudaMemcpy(knn_dists + query_begin * k, d_knn_dists.get(), num_queries * k * sizeof(float),
+                     cudaMemcpyDeviceToHost),
+          "cudaMemcpy");
+    check(cudaMemcpy(knn_ids + query_begin * k, d_knn_ids.get(), num_queries * k * sizeof(uint32_t),
+                     cudaMemcpyDeviceToHost),
+          "cudaMemcpy");
+}
+
+struct ToDouble
+{
+    __host__ __device__ double operator()(float x) const
+    {
+        return (double)x;
+    }
+};
+} // namespace
+
+bool is_available()
+{
+    static std::once_flag checked;
+    static bool available = false;
+    std::call_once(checked, [] {
+        int num_devices = 0;
+        if (cudaGetDeviceCount(&num_devices) != cudaSuccess || num_devices == 0)
+        {
+            cudaGetLastError();
+            diskann::cout << "No CUDA device found, running on the CPU." << std::endl;
+            return;
+        }
+        int device = 0;
+        cudaDeviceProp prop;
+        if (cudaGetDevice(&device) != cudaSuccess || cudaGetDeviceProperties(&prop, device) != cudaSuccess)
+            return;
+        diskann::cout << "Running on CUDA device " << device << ": " << prop.name << std::endl;
+        available = true;
+    });
+    return available;
+}
+
+size_t num_devices()
+{
+    int count = 0;
+    if (!is_available() || cudaGetDeviceCount(&count) != cudaSuccess)
+        return 0;
+    return (size_t)count;
+}
+
+void compute_closest_centers(const float *data, size_t num_points, size_t dim, const float *centers,
+                             size_t num_centers, size_t k, uint32_t *closest_centers, const float *pts_norms_squared)
+{
+    if (k == 0 || k > MAX_K || k > num_centers)
+        throw diskann::ANNException("k = " + std::to_string(k) + " is not supported on the GPU for " +
+                                        std::to_string(num_centers) + " centers",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (num_points == 0)
+        return;
+
+    CublasHandle cublas;
+    DeviceBuffer<float> d_centers(num_centers * dim);
+    DeviceBuffer<float> d_centers_norms(num_centers);
+    check(cudaMemcpy(d_centers.get(), centers, num_centers * dim * sizeof(float), cudaMemcpyHostToDevice),
+          "cudaMemcpy");
+    row_norms_kernel<<<(unsigned)num_blocks(num_centers), THREADS_PER_BLOCK>>>(d_centers.get(), num_centers, dim,
+                                                                               d_centers_norms.get());
+    check(cudaGetLastError(), "row_norms_kernel");
+
+    // a block of points, their norms, their inner products with all centers
+    // and the chosen ids take up to half of the free device memory, and its
+    // dimensions must fit the int arguments of cuBLAS
+    size_t free_bytes = 0, total_bytes = 0;
+    check(cudaMemGetInfo(&free_bytes, &total_bytes), "cudaMemGetInfo");
+    const size_t bytes_per_point = (dim + 1 + num_centers) * sizeof(float) + k * sizeof(uint32_t);
+    const size_t block_size =
+        std::max((size_t)1, std::min({num_points, free_bytes / 2 / bytes_per_point, MAX_BLOCK_POINTS}));
+
+    DeviceBuffer<float> d_data(block_size * dim);
+    DeviceBuffer<float> d_pts_norms(block_size);
+    DeviceBuffer<float> d_dots(block_size * num_centers);
+    DeviceBuffer<uint32_t> d_closest(block_size * k);
+
+    for (size_t start = 0; start < num_points; start += block_size)
+    {
+        const size_t cur_blk_size = std::min(block_size, num_points - start);
+        check(cudaMemcpy(d_data.get(), data + start * dim, cur_blk_size * dim * sizeof(float),
+                         cudaMemcpyHostToDevice),
+              "cudaMemcpy");
+        if (pts_norms_squared != nullptr)
+        {
+            check(cudaMemcpy(d_pts_norms.get(), pts_norms_squared + start, cur_blk_size * sizeof(float),
+                             cudaMemcpyHostToDevice),
+                  "cudaMemcpy");
+        }
+        else
+        {
+            row_norms_kernel<<<(unsigned)num_blocks(cur_blk_size), THREADS_PER_BLOCK>>>(d_data.get(), cur_blk_size,
+                                                                                        dim, d_pts_norms.get());
+            check(cudaGetLastError(), "row_norms_kernel");
+        }
+
+        // cuBLAS is column major: the row major centers and points are dim x
+        // num_centers and dim x cur_blk_size, and the product centers^T *
+        // points is the row major cur_blk_size x num_centers matrix of dots.
+        const float alpha = 1.0f, beta = 0.0f;
+        check(cublasSgemm(cublas.get(), CUBLAS_OP_T, CUBLAS_OP_N, (int)num_centers, (int)cur_blk_size, (int)dim,
+                          &alpha, d_centers.get(), (int)dim, d_data.get(), (int)dim, &beta, d_dots.get(),
+                          (int)num_centers),
+              "cublasSgemm");
+
+        select_closest_kernel<<<(unsigned)num_blocks(cur_blk_size), THREADS_PER_BLOCK>>>(
+            d_dots.get(), d_pts_norms.get(), d_centers_norms.get(), cur_blk_size, num_centers, k, d_closest.get());
+        check(cudaGetLastError(), "select_closest_kernel");
+
+        check(cudaMemcpy(closest_centers + start * k, d_closest.get(), cur_blk_size * k * sizeof(uint32_t),
+                         cudaMemcpyDeviceToHost),
+              "cudaMemcpy");
+    }
+}
+
+bool kmeanspp_selecting_pivots(const float *data, size_t num_points, size_t dim, float *pivot_data,
+                               size_t num_centers)
+{
+    size_t free_bytes = 0, total_bytes = 0;
+    check(cudaMemGetInfo(&free_bytes, &total_bytes), "cudaMemGetInfo");
+    if ((num_points * dim + num_points) * sizeof(float) + num_points * sizeof(double) > free_bytes / 2)
+        return false;
+
+    DeviceBuffer<float> d_data(num_points * dim);
+    DeviceBuffer<float> d_dists(num_points);
+    DeviceBuffer<double> d_prefix(num_points);
+    check(cudaMemcpy(d_data.get(), data, num_points * dim * sizeof(float), cudaMemcpyHostToDevice), "cudaMemcpy");
+
+    std::vector<size_t> picked;
+    std::random_device rd;
+    auto x = rd();
+    std::mt19937 generator(x);
+    std::uniform_real_distribution<> distribution(0, 1);
+    std::uniform_int_distribution<size_t> int_dist(0, num_points - 1);
+    size_t init_id = int_dist(generator);
+    size_t num_picked = 1;
+
+    picked.push_back(init_id);
+    std::memcpy(pivot_data, data + init_id * dim, dim * sizeof(float));
+    update_min_dists_kernel<<<(unsigned)num_blocks(num_points), THREADS_PER_BLOCK>>>(
+        d_data.get(), num_points, dim, d_data.get() + init_id * dim, d_dists.get(), true);
+    check(cudaGetLastError(), "update_min_dists_kernel");
+
+    thrust::device_ptr<float> dists(d_dists.get());
+    thrust::device_ptr<double> prefix(d_prefix.get());
+    bool sum_flag = false;
+
+    while (num_picked < num_centers)
+    {
+        // the next pivot is the point whose slice of the prefix sums of the
+        // distances the dart falls in, as on the CPU
+        thrust::transform_inclusive_scan(thrust::device, dists, dists + num_points, prefix, ToDouble(),
+                                         thrust::plus<double>());
+        double sum = 0;
+        check(cudaMemcpy(&sum, d_prefix.get() + num_points - 1, sizeof(double), cudaMemcpyDeviceToHost),
+              "cudaMemcpy");
+        if (sum == 0)
+            sum_flag = true;
+
+        const double dart_val = distribution(generator) * sum;
+        size_t tmp_pivot = thrust::upper_bound(thrust::device, prefix, prefix + num_points, dart_val) - prefix;
+        tmp_pivot = std::min(tmp_pivot, num_points - 1);
+
+        if (std::find(picked.begin(), picked.end(), tmp_pivot) != picked.end() && (sum_flag == false))
+            continue;
+        picked.push_back(tmp_pivot);
+        std::memcpy(pivot_data + num_picked * dim, data + tmp_pivot * dim, dim * sizeof(float));
+
+        update_min_dists_kernel<<<(unsigned)num_blocks(num_points), THREADS_PER_BLOCK>>>(
+            d_data.get(), num_points, dim, d_data.get() + tmp_pivot * dim, d_dists.get(), false);
+        check(cudaGetLastError(), "update_min_dists_kernel");
+        num_picked++;
+    }
+    check(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+    return true;
+}
+void update_knn(const float *points, size_t num_points, uint32_t id_offset, size_t dim, const float *queries,
+                size_t num_queries, size_t k, bool inner_product, const uint8_t *excluded, float *knn_dists,
+                uint32_t *knn_ids)
+{
+    if (k == 0 || num_points == 0 || num_queries == 0)
+        return;
+
+    // the queries are split evenly, and every device streams all the points
+    const size_t devices = std::max((size_t)1, std::min(num_devices(), num_queries));
+    const size_t per_device = (num_queries + devices - 1) / devices;
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(devices);
+    for (size_t d = 0; d < devices; d++)
+    {
+        const size_t query_begin = d * per_device;
+        const size_t query_end = std::min(num_queries, query_begin + per_device);
+        threads.emplace_back([&, d, query_begin, query_end] {
+            try
+            {
+                update_knn_on_device((int)d, points, num_points, id_offset, dim, queries, query_begin, query_end, k,
+                                     inner_product, excluded, knn_dists, knn_ids);
+            }
+            catch (...)
+            {
+                errors[d] = std::current_exception();
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+} // namespace gpu
+} // namespace math_utils
@@ -4,6 +4,8 @@
 #include <memory>
 #include "abstract_scratch.h"
 #include "in_mem_data_store.h"
+#include "memory_mapper.h"
+#include "defaults.h"
 
 #include "utils.h"
 
@@ -12,20 +14,100 @@ namespace diskann
 
 template <typename data_t>
 InMemDataStore<data_t>::InMemDataStore(const location_t num_points, const size_t dim,
-                                       std::unique_ptr<Distance<data_t>> distance_fn)
+                                       std::unique_ptr<Distance<data_t>> distance_fn, const bool precompute_norms)
     : AbstractDataStore<data_t>(num_points, dim), _distance_fn(std::move(distance_fn))
 {
     _aligned_dim = ROUND_UP(dim, _distance_fn->get_required_alignment());
-    alloc_aligned(((void **)&_data), this->_capacity * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
-    std::memset(_data, 0, this->_capacity * _aligned_dim * sizeof(data_t));
+    _fixed_dim_distance_fn =
+        get_fixed_dim_distance_function<data_t>(_distance_fn->get_metric(), (uint32_t)_aligned_dim);
+    _fixed_dim_bounded_fn =
+        get_fixed_dim_bounded_distance_function<data_t>(_distance_fn->get_metric(), (uint32_t)_aligned_dim);
+    _batch4_distance_fn = get_batch4_distance_function<data_t>(_distance_fn->get_metric());
+    // zeroed, and under a first-touch policy placed by the threads that
+    // populate it
+    _buffer = alloc_large(this->_capacity * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
+    _data = (data_t *)_buffer.ptr;
+
+    const Metric metric = _distance_fn->get_metric();
+    const bool float_like = std::is_same<data_t, float>::value || std::is_same<data_t, float16>::value ||
+                            std::is_same<data_t, bfloat16>::value;
+    // byte vectors only for cosine, where it saves the two magnitudes per
+    // comparison; their L2 kernels are already a single pass
+    if (precompute_norms && (metric == Metric::COSINE || (float_like && metric == Metric::L2)) &&
+        !_distance_fn->preprocessing_required())
+    {
+        _use_norms = true;
+        _norms.assign(this->_capacity, 0.0f);
+        _ip_distance_fn.reset(get_distance_function<data_t>(Metric::INNER_PRODUCT));
+        _fixed_dim_ip_fn = get_fixed_dim_distance_function<data_t>(Metric::INNER_PRODUCT, (uint32_t)_aligned_dim);
+        _batch4_ip_fn = get_batch4_distance_function<data_t>(Metric::INNER_PRODUCT);
+    }
 }
 
 template <typename data_t> InMemDataStore<data_t>::~InMemDataStore()
 {
-    if (_data != nullptr)
-    {
-        aligned_free(this->_data);
-    }
+    free_data();
+}
+
+template <typename data_t> void InMemDataStore<data_t>::free_data()
+{
+    if (_mapping != nullptr)
+        _mapping.reset();
+    else if (_external_owner != nullptr)
+        _external_owner.reset();
+    else
+        free_large(_buffer);
+    _data = nullptr;
+    _paged_mapping = false;
+}
+
+template <typename data_t> void InMemDataStore<data_t>::detach_mapping()
+{
+    if (_mapping == nullptr && _external_owner == nullptr)
+        return;
+    reallocate_data(this->_capacity);
+}
+
+template <typename data_t> void InMemDataStore<data_t>::reallocate_data(const location_t new_capacity)
+{
+    LargeBuffer new_buffer = alloc_large(new_capacity * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
+    memcpy(new_buffer.ptr, _data, std::min(new_capacity, this->_capacity) * _aligned_dim * sizeof(data_t));
+    free_data();
+    _buffer = new_buffer;
+    _data = (data_t *)_buffer.ptr;
+}
+
+template <typename data_t> float InMemDataStore<data_t>::inner_product(const data_t *a, const data_t *b) const
+{
+    // the kernels return the negated inner product
+    if (_fixed_dim_ip_fn != nullptr)
+        return -_fixed_dim_ip_fn(a, b);
+    return -_ip_distance_fn->compare(a, b, (uint32_t)_aligned_dim);
+}
+
+template <typename data_t> float InMemDataStore<data_t>::compute_norm(const data_t *vector) const
+{
+    const float sq_norm = inner_product(vector, vector);
+    return _distance_fn->get_metric() == Metric::COSINE ? std::sqrt(sq_norm) : sq_norm;
+}
+
+// For L2, a point compared with an identical copy of itself gets exactly 0,
+// as its norm comes from the same kernel as the inner product
+template <typename data_t>
+float InMemDataStore<data_t>::distance_from_norms(const float inner_product, const float norm_a,
+                                                  const float norm_b) const
+{
+    if (_distance_fn->get_metric() == Metric::COSINE)
+        return 1.0f - inner_product / (norm_a * norm_b);
+    return (std::max)(norm_a + norm_b - 2 * inner_product, 0.0f);
+}
+
+template <typename data_t> void InMemDataStore<data_t>::update_norms(const location_t first, const location_t count)
+{
+    if (!_use_norms)
+        return;
+    for (location_t i = first; i < first + count; i++)
+        _norms[i] = compute_norm(_data + (size_t)i * _aligned_dim);
 }
 
 template <typename data_t> size_t InMemDataStore<data_t>::get_aligned_dim() const
@@ -38,6 +120,14 @@ template <typename data_t> size_t InMemDataStore<data_t>::get_alignment_factor()
     return _distance_fn->get_required_alignment();
 }
 
+template <typename data_t> size_t InMemDataStore<data_t>::memory_size() const
+{
+    // mapped and external vectors count as well, as searches touch them all,
+    // but not those paged in on demand
+    const size_t data_bytes = _paged_mapping ? 0 : this->capacity() * _aligned_dim * sizeof(data_t);
+    return data_bytes + _norms.size() * sizeof(float);
+}
+
 template <typename data_t> location_t InMemDataStore<data_t>::load(const std::string &filename)
 {
     return load_impl(filename);
@@ -56,7 +146,7 @@ template <typename data_t> location_t InMemDataStore<data_t>::load_impl(AlignedF
         stream << "ERROR: Driver requests loading " << this->_dim << " dimension,"
                << "but file has " << file_dim << " dimension." << std::endl;
         diskann::cerr << stream.str() << std::endl;
-        aligned_free(_data);
+        free_data();
         throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
@@ -65,6 +155,7 @@ template <typename data_t> location_t InMemDataStore<data_t>::load_impl(AlignedF
         this->resize((location_t)file_num_points);
     }
     copy_aligned_data_from_file<data_t>(reader, _data, file_num_points, file_dim, _aligned_dim);
+    update_norms(0, (location_t)file_num_points);
 
     return (location_t)file_num_points;
 }
@@ -72,13 +163,14 @@ template <typename data_t> location_t InMemDataStore<data_t>::load_impl(AlignedF
 
 template <typename data_t> location_t InMemDataStore<data_t>::load_impl(const std::string &filename)
 {
+    detach_mapping();
     size_t file_dim, file_num_points;
     if (!file_exists(filename))
     {
         std::stringstream stream;
         stream << "ERROR: data file " << filename << " does not exist." << std::endl;
         diskann::cerr << stream.str() << std::endl;
-        aligned_free(_data);
+        free_data();
         throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
     }
     diskann::get_bin_metadata(filename, file_num_points, file_dim);
@@ -89,7 +181,7 @@ template <typename data_t> location_t InMemDataStore<data_t>::load_impl(const st
         stream << "ERROR: Driver requests loading " << this->_dim << " dimension,"
                << "but file has " << file_dim << " dimension." << std::endl;
         diskann::cerr << stream.str() << std::endl;
-        aligned_free(_data);
+        free_data();
         throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
@@ -99,6 +191,7 @@ template <typename data_t> location_t InMemDataStore<data_t>::load_impl(const st
     }
 
     copy_aligned_data_from_file<data_t>(filename.c_str(), _data, file_num_points, file_dim, _aligned_dim);
+    update_norms(0, (location_t)file_num_points);
 
     return (location_t)file_num_points;
 }
@@ -108,8 +201,138 @@ template <typename data_t> size_t InMemDataStore<data_t>::save(const std::string
     return save_data_in_base_dimensions(filename, _data, num_points, this->get_dims(), this->get_aligned_dim(), 0U);
 }
 
+// the header keeps npts and dim where get_bin_metadata() expects them
+static void write_mmap_header(std::ofstream &writer, const size_t num_points, const size_t dim,
+                              const size_t aligned_dim)
+{
+    std::vector<char> header(defaults::MMAP_HEADER_SIZE, 0);
+    uint32_t header_fields[3] = {(uint32_t)num_points, (uint32_t)dim, (uint32_t)aligned_dim};
+    std::memcpy(header.data(), header_fields, sizeof(header_fields));
+    writer.write(header.data(), header.size());
+}
+
+template <typename data_t>
+size_t InMemDataStore<data_t>::save_mmap(const std::string &filename, const location_t num_points)
+{
+    std::ofstream writer;
+    open_file_to_write(writer, filename);
+    write_mmap_header(writer, num_points, this->_dim, _aligned_dim);
+    writer.write((char *)_data, (size_t)num_points * _aligned_dim * sizeof(data_t));
+    writer.close();
+
+    size_t bytes_written = defaults::MMAP_HEADER_SIZE + (size_t)num_points * _aligned_dim * sizeof(data_t);
+    diskann::cout << "Wrote " << num_points << " aligned vectors to " << filename << std::endl;
+    return bytes_written;
+}
+
+template <typename data_t> location_t InMemDataStore<data_t>::load_mmap(const std::string &filename)
+{
+    return map_file(filename, false);
+}
+
+template <typename data_t>
+location_t InMemDataStore<data_t>::populate_data_mmap(const std::string &filename, const std::string &mmap_file)
+{
+    size_t file_num_points, file_dim;
+    get_bin_metadata(filename, file_num_points, file_dim);
+    if (file_dim != this->_dim)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << filename << " holds " << file_dim << " dimensional vectors, but the data store expects "
+               << this->_dim << "." << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    const size_t num_points = (std::min)(file_num_points, (size_t)this->capacity());
+
+    // a batch of padded vectors at a time, preprocessed as populate_data()
+    // would
+    std::ifstream reader(filename, std::ios::binary);
+    reader.seekg(2 * sizeof(uint32_t), std::ios::beg);
+    std::ofstream writer;
+    open_file_to_write(writer, mmap_file);
+    write_mmap_header(writer, num_points, this->_dim, _aligned_dim);
+    const size_t batch_size = (std::max)((size_t)1, defaults::MMAP_BUILD_BATCH_SIZE / (_aligned_dim * sizeof(data_t)));
+    data_t *batch = nullptr;
+    alloc_aligned((void **)&batch, batch_size * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
+    std::memset(batch, 0, batch_size * _aligned_dim * sizeof(data_t));
+    for (size_t start = 0; start < num_points; start += batch_size)
+    {
+        const size_t count = (std::min)(batch_size, num_points - start);
+        for (size_t i = 0; i < count; i++)
+            reader.read((char *)(batch + i * _aligned_dim), this->_dim * sizeof(data_t));
+        if (_distance_fn->preprocessing_required())
+            _distance_fn->preprocess_base_points(batch, _aligned_dim, count);
+        writer.write((char *)batch, count * _aligned_dim * sizeof(data_t));
+    }
+    aligned_free(batch);
+    writer.close();
+    if (!reader)
+    {
+        throw diskann::ANNException("ERROR: could not read " + std::to_string(num_points) + " vectors from " + filename,
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    return map_file(mmap_file, true);
+}
+
+template <typename data_t>
+location_t InMemDataStore<data_t>::map_file(const std::string &filename, const bool random_access)
+{
+    if (!file_exists(filename))
+    {
+        std::stringstream stream;
+        stream << "ERROR: data file " << filename << " does not exist." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    auto mapping = std::make_unique<MemoryMapper>(filename);
+    uint32_t header_fields[3] = {0, 0, 0};
+    if (mapping->getFileSize() >= defaults::MMAP_HEADER_SIZE)
+        std::memcpy(header_fields, mapping->getBuf(), sizeof(header_fields));
+    size_t file_num_points = header_fields[0];
+    size_t expected_size = defaults::MMAP_HEADER_SIZE + file_num_points * _aligned_dim * sizeof(data_t);
+    if (header_fields[1] != this->_dim || header_fields[2] != _aligned_dim || mapping->getFileSize() < expected_size)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << filename << " holds " << header_fields[1] << " dimensional vectors padded to "
+               << header_fields[2] << " in " << mapping->getFileSize() << " bytes, but the data store expects "
+               << this->_dim << " dimensions padded to " << _aligned_dim << "." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    data_t *mapped_data = (data_t *)(mapping->getBuf() + defaults::MMAP_HEADER_SIZE);
+    if (file_num_points < this->capacity())
+    {
+        // the store has room for more points than the file, which a mapping
+        // cannot provide, so copy into the existing buffer instead
+        detach_mapping();
+        memcpy(_data, mapped_data, file_num_points * _aligned_dim * sizeof(data_t));
+        update_norms(0, (location_t)file_num_points);
+        return (location_t)file_num_points;
+    }
+
+    free_data();
+#ifndef _WINDOWS
+    // start reading the file into the page cache in the background, unless it
+    // is read a few vectors at a time
+    madvise(mapping->getBuf(), mapping->getFileSize(), random_access ? MADV_RANDOM : MADV_WILLNEED);
+#endif
+    _mapping = std::move(mapping);
+    _paged_mapping = random_access;
+    _data = mapped_data;
+    this->_capacity = (location_t)file_num_points;
+    if (_use_norms)
+        _norms.resize(this->_capacity);
+    update_norms(0, (location_t)file_num_points);
+
+    return (location_t)file_num_points;
+}
+
 template <typename data_t> void InMemDataStore<data_t>::populate_data(const data_t *vectors, const location_t num_pts)
 {
+    detach_mapping();
     memset(_data, 0, _aligned_dim * sizeof(data_t) * num_pts);
     for (location_t i = 0; i < num_pts; i++)
     {
@@ -120,10 +343,28 @@ template <typename data_t> void InMemDataStore<data_t>::populate_data(const data
     {
         _distance_fn->preprocess_base_points(_data, this->_aligned_dim, num_pts);
     }
+    update_norms(0, num_pts);
+}
+
+template <typename data_t>
+bool InMemDataStore<data_t>::use_external_data(const data_t *vectors, const location_t num_pts,
+                                               std::shared_ptr<const void> owner)
+{
+    if (num_pts != this->capacity() || this->_dim != _aligned_dim || _distance_fn->preprocessing_required() ||
+        (uintptr_t)vectors % (8 * sizeof(data_t)) != 0 || owner == nullptr)
+        return false;
+
+    free_data();
+    _external_owner = std::move(owner);
+    // only read: every path that writes detaches first
+    _data = const_cast<data_t *>(vectors);
+    update_norms(0, num_pts);
+    return true;
 }
 
 template <typename data_t> void InMemDataStore<data_t>::populate_data(const std::string &filename, const size_t offset)
 {
+    detach_mapping();
     size_t npts, ndim;
     copy_aligned_data_from_file(filename.c_str(), _data, npts, ndim, _aligned_dim, offset);
 
@@ -148,6 +389,7 @@ template <typename data_t> void InMemDataStore<data_t>::populate_data(const std:
     {
         _distance_fn->preprocess_base_points(_data, this->_aligned_dim, this->capacity());
     }
+    update_norms(0, (location_t)npts);
 }
 
 template <typename data_t>
@@ -164,6 +406,7 @@ template <typename data_t> void InMemDataStore<data_t>::get_vector(const locatio
 
 template <typename data_t> void InMemDataStore<data_t>::set_vector(const location_t loc, const data_t *const vector)
 {
+    detach_mapping();
     size_t offset_in_data = loc * _aligned_dim;
     memset(_data + offset_in_data, 0, _aligned_dim * sizeof(data_t));
     memcpy(_data + offset_in_data, vector, this->_dim * sizeof(data_t));
@@ -171,6 +414,7 @@ template <typename data_t> void InMemDataStore<data_t>::set_vector(const locatio
     {
         _distance_fn->preprocess_base_points(_data + offset_in_data, _aligned_dim, 1);
     }
+    update_norms(loc, 1);
 }
 
 template <typename data_t> void InMemDataStore<data_t>::prefetch_vector(const location_t loc)
@@ -197,6 +441,10 @@ void InMemDataStore<data_t>::preprocess_query(const data_t *query, AbstractScrat
 
 template <typename data_t> float InMemDataStore<data_t>::get_distance(const data_t *query, const location_t loc) const
 {
+    if (_use_norms)
+        return distance_from_norms(inner_product(query, _data + _aligned_dim * loc), compute_norm(query), _norms[loc]);
+    if (_fixed_dim_distance_fn != nullptr)
+        return _fixed_dim_distance_fn(query, _data + _aligned_dim * loc);
     return _distance_fn->compare(query, _data + _aligned_dim * loc, (uint32_t)_aligned_dim);
 }
 
@@ -205,28 +453,213 @@ void InMemDataStore<data_t>::get_distance(const data_t *query, const location_t
                                           const uint32_t location_count, float *distances,
                                           AbstractScratch<data_t> *scratch_space) const
 {
-    for (location_t i = 0; i < location_count; i++)
+    if (_use_norms)
+    {
+        get_distances_from_norms(query, locations, location_count, distances);
+        return;
+    }
+    if (_batch4_distance_fn == nullptr)
+    {
+        for (location_t i = 0; i < location_count; i++)
+        {
+            distances[i] = InMemDataStore<data_t>::get_distance(query, locations[i]);
+        }
+        return;
+    }
+
+    // keep the vectors defaults::DISTANCE_PREFETCH_AHEAD ids ahead on their
+    // way into cache while four at a time are compared
+    const size_t vector_bytes = _aligned_dim * sizeof(data_t);
+    const uint32_t ahead = (std::min)(location_count, defaults::DISTANCE_PREFETCH_AHEAD);
+    for (uint32_t i = 0; i < ahead; i++)
+    {
+        diskann::prefetch_vector((const char *)(_data + locations[i] * _aligned_dim), vector_bytes);
+    }
+
+    const data_t *points[4];
+    uint32_t i = 0;
+    for (; i + 4 <= location_count; i += 4)
+    {
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            if (i + j + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+            {
+                location_t next = locations[i + j + defaults::DISTANCE_PREFETCH_AHEAD];
+                diskann::prefetch_vector((const char *)(_data + next * _aligned_dim), vector_bytes);
+            }
+            points[j] = _data + locations[i + j] * _aligned_dim;
+        }
+        _batch4_distance_fn(query, points, (uint32_t)_aligned_dim, distances + i);
+    }
+    for (; i < location_count; i++)
+    {
+        distances[i] = InMemDataStore<data_t>::get_distance(query, locations[i]);
+    }
+}
+
+// get_distance() for a batch of locations, with the norm of the query
+// computed once
+template <typename data_t>
+void InMemDataStore<data_t>::get_distances_from_norms(const data_t *query, const location_t *locations,
+                                                      const uint32_t location_count, float *distances) const
+{
+    const float query_norm = compute_norm(query);
+    const size_t vector_bytes = _aligned_dim * sizeof(data_t);
+    const uint32_t ahead = (std::min)(location_count, defaults::DISTANCE_PREFETCH_AHEAD);
+    for (uint32_t i = 0; i < ahead; i++)
     {
-        distances[i] = _distance_fn->compare(query, _data + locations[i] * _aligned_dim, (uint32_t)this->_aligned_dim);
+        diskann::prefetch_vector((const char *)(_data + locations[i] * _aligned_dim), vector_bytes);
+    }
+
+    const data_t *points[4];
+    uint32_t i = 0;
+    if (_batch4_ip_fn != nullptr)
+    {
+        for (; i + 4 <= location_count; i += 4)
+        {
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                if (i + j + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+                {
+                    location_t next = locations[i + j + defaults::DISTANCE_PREFETCH_AHEAD];
+                    diskann::prefetch_vector((const char *)(_data + next * _aligned_dim), vector_bytes);
+                }
+                points[j] = _data + locations[i + j] * _aligned_dim;
+            }
+            _batch4_ip_fn(query, points, (uint32_t)_aligned_dim, distances + i);
+            for (uint32_t j = 0; j < 4; j++)
+                distances[i + j] = distance_from_norms(-distances[i + j], query_norm, _norms[locations[i + j]]);
+        }
+    }
+    for (; i < location_count; i++)
+    {
+        if (i + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+        {
+            location_t next = locations[i + defaults::DISTANCE_PREFETCH_AHEAD];
+            diskann::prefetch_vector((const char *)(_data + next * _aligned_dim), vector_bytes);
+        }
+        distances[i] = distance_from_norms(inner_product(query, _data + locations[i] * _aligned_dim), query_norm,
+                                           _norms[locations[i]]);
     }
 }
 
 template <typename data_t>
 float InMemDataStore<data_t>::get_distance(const location_t loc1, const location_t loc2) const
 {
+    if (_use_norms)
+        return distance_from_norms(inner_product(_data + loc1 * _aligned_dim, _data + loc2 * _aligned_dim),
+                                   _norms[loc1], _norms[loc2]);
+    if (_fixed_dim_distance_fn != nullptr)
+        return _fixed_dim_distance_fn(_data + loc1 * _aligned_dim, _data + loc2 * _aligned_dim);
     return _distance_fn->compare(_data + loc1 * _aligned_dim, _data + loc2 * _aligned_dim,
                                  (uint32_t)this->_aligned_dim);
 }
 
+// The same kernel and argument order as get_distance(locations[i], loc), so
+// that the distances are bit for bit those of the pairwise calls, with the
+// vectors prefetched ahead and the kernel picked once for the row
+template <typename data_t>
+void InMemDataStore<data_t>::get_distances_to(const location_t loc, const location_t *locations,
+                                              const uint32_t location_count, float *distances) const
+{
+    const size_t vector_bytes = _aligned_dim * sizeof(data_t);
+#ifndef _WINDOWS
+    // the vectors of a paged mapping are requested together, so that their
+    // reads from the file overlap instead of faulting in one by one
+    if (_paged_mapping)
+    {
+        static const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        for (uint32_t i = 0; i < location_count; i++)
+        {
+            const uintptr_t start = (uintptr_t)(_data + locations[i] * _aligned_dim);
+            const uintptr_t page = start - start % page_size;
+            madvise((void *)page, start + vector_bytes - page, MADV_WILLNEED);
+        }
+    }
+#endif
+    const uint32_t ahead = (std::min)(location_count, defaults::DISTANCE_PREFETCH_AHEAD);
+    for (uint32_t i = 0; i < ahead; i++)
+    {
+        diskann::prefetch_vector((const char *)(_data + locations[i] * _aligned_dim), vector_bytes);
+    }
+
+    const data_t *target = _data + loc * _aligned_dim;
+    for (uint32_t i = 0; i < location_count; i++)
+    {
+        if (i + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+        {
+            location_t next = locations[i + defaults::DISTANCE_PREFETCH_AHEAD];
+            diskann::prefetch_vector((const char *)(_data + next * _aligned_dim), vector_bytes);
+        }
+        const data_t *point = _data + locations[i] * _aligned_dim;
+        if (_use_norms)
+            distances[i] = distance_from_norms(inner_product(point, target), _norms[locations[i]], _norms[loc]);
+        else
+            distances[i] = _fixed_dim_distance_fn != nullptr
+                               ? _fixed_dim_distance_fn(point, target)
+                               : _distance_fn->compare(point, target, (uint32_t)_aligned_dim);
+    }
+}
+
+// Norms turn distances into inner products, whose partial sums say nothing
+// about the distance, so the bounds only help without them
+template <typename data_t>
+float InMemDataStore<data_t>::get_distance_with_bound(const data_t *query, const location_t loc,
+                                                      const float bound) const
+{
+    if (_use_norms)
+        return InMemDataStore<data_t>::get_distance(query, loc);
+    if (_fixed_dim_distance_fn != nullptr)
+    {
+        return _fixed_dim_bounded_fn != nullptr ? _fixed_dim_bounded_fn(query, _data + _aligned_dim * loc, bound)
+                                                : _fixed_dim_distance_fn(query, _data + _aligned_dim * loc);
+    }
+    return _distance_fn->compare_with_bound(query, _data + _aligned_dim * loc, (uint32_t)_aligned_dim, bound);
+}
+
+template <typename data_t>
+void InMemDataStore<data_t>::get_distances_to_with_bound(const location_t loc, const location_t *locations,
+                                                         const uint32_t location_count, const float *bounds,
+                                                         float *distances) const
+{
+    if (_use_norms || (_fixed_dim_distance_fn != nullptr && _fixed_dim_bounded_fn == nullptr))
+    {
+        InMemDataStore<data_t>::get_distances_to(loc, locations, location_count, distances);
+        return;
+    }
+
+    const size_t vector_bytes = _aligned_dim * sizeof(data_t);
+    const uint32_t ahead = (std::min)(location_count, defaults::DISTANCE_PREFETCH_AHEAD);
+    for (uint32_t i = 0; i < ahead; i++)
+    {
+        diskann::prefetch_vector((const char *)(_data + locations[i] * _aligned_dim), vector_bytes);
+    }
+
+    const data_t *target = _data + loc * _aligned_dim;
+    for (uint32_t i = 0; i < location_count; i++)
+    {
+        if (i + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+        {
+            location_t next = locations[i + defaults::DISTANCE_PREFETCH_AHEAD];
+            diskann::prefetch_vector((const char *)(_data + next * _aligned_dim), vector_bytes);
+        }
+        const data_t *point = _data + locations[i] * _aligned_dim;
+        distances[i] = _fixed_dim_bounded_fn != nullptr
+                           ? _fixed_dim_bounded_fn(point, target, bounds[i])
+                           : _distance_fn->compare_with_bound(point, target, (uint32_t)_aligned_dim, bounds[i]);
+    }
+}
+
 template <typename data_t>
 void InMemDataStore<data_t>::get_distance(const data_t *preprocessed_query, const std::vector<location_t> &ids,
                                           std::vector<float> &distances, AbstractScratch<data_t> *scratch_space) const
 {
-    for (int i = 0; i < ids.size(); i++)
+    if (distances.size() < ids.size())
     {
-        distances[i] =
-            _distance_fn->compare(preprocessed_query, _data + ids[i] * _aligned_dim, (uint32_t)this->_aligned_dim);
+        distances.resize(ids.size());
     }
+    InMemDataStore<data_t>::get_distance(preprocessed_query, ids.data(), (uint32_t)ids.size(), distances.data(),
+                                         scratch_space);
 }
 
 template <typename data_t> location_t InMemDataStore<data_t>::expand(const location_t new_size)
@@ -242,15 +675,35 @@ template <typename data_t> location_t InMemDataStore<data_t>::expand(const locat
            << this->capacity() << ")" << std::endl;
         throw diskann::ANNException(ss.str(), -1);
     }
-#ifndef _WINDOWS
-    data_t *new_data;
-    alloc_aligned((void **)&new_data, new_size * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
-    memcpy(new_data, _data, this->capacity() * _aligned_dim * sizeof(data_t));
-    aligned_free(_data);
-    _data = new_data;
-#else
-    realloc_aligned((void **)&_data, new_size * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
-#endif
+
+    // Within the owned buffer the vectors stay where they are, and only the
+    // new locations, which may hold vectors from before a shrink, are
+    // cleared. Otherwise they move once into a buffer with room to grow into.
+    const size_t vector_bytes = _aligned_dim * sizeof(data_t);
+    const bool owned = _mapping == nullptr && _external_owner == nullptr;
+    if (!owned || (size_t)new_size * vector_bytes > _buffer.len)
+    {
+        LargeBuffer new_buffer =
+            reserve_large((size_t)new_size * defaults::STORE_GROWTH_RESERVE * vector_bytes, 8 * sizeof(data_t));
+        if (new_buffer.ptr == nullptr)
+        {
+            reallocate_data(new_size);
+            this->_capacity = new_size;
+            if (_use_norms)
+                _norms.resize(new_size, 0.0f);
+            return this->_capacity;
+        }
+        memcpy(new_buffer.ptr, _data, this->_capacity * vector_bytes);
+        free_data();
+        _buffer = new_buffer;
+        _data = (data_t *)_buffer.ptr;
+    }
+    else
+    {
+        memset(_data + this->_capacity * _aligned_dim, 0, (new_size - this->_capacity) * vector_bytes);
+    }
+    if (_use_norms)
+        _norms.resize(new_size, 0.0f);
     this->_capacity = new_size;
     return this->_capacity;
 }
@@ -268,16 +721,10 @@ template <typename data_t> location_t InMemDataStore<data_t>::shrink(const locat
            << this->capacity() << ")" << std::endl;
         throw diskann::ANNException(ss.str(), -1);
     }
-#ifndef _WINDOWS
-    data_t *new_data;
-    alloc_aligned((void **)&new_data, new_size * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
-    memcpy(new_data, _data, new_size * _aligned_dim * sizeof(data_t));
-    aligned_free(_data);
-    _data = new_data;
-#else
-    realloc_aligned((void **)&_data, new_size * _aligned_dim * sizeof(data_t), 8 * sizeof(data_t));
-#endif
+    reallocate_data(new_size);
     this->_capacity = new_size;
+    if (_use_norms)
+        _norms.resize(new_size);
     return this->_capacity;
 }
 
@@ -323,9 +770,12 @@ void InMemDataStore<data_t>::move_vectors(const location_t old_location_start, c
     }
 
     // Use memmove to handle overlapping ranges.
+    detach_mapping();
     copy_vectors(old_location_start, new_location_start, num_locations);
     memset(_data + _aligned_dim * mem_clear_loc_start, 0,
            sizeof(data_t) * _aligned_dim * (mem_clear_loc_end_limit - mem_clear_loc_start));
+    if (_use_norms)
+        std::fill(_norms.begin() + mem_clear_loc_start, _norms.begin() + mem_clear_loc_end_limit, 0.0f);
 }
 
 template <typename data_t>
@@ -335,7 +785,10 @@ void InMemDataStore<data_t>::copy_vectors(const location_t from_loc, const locat
     assert(from_loc < this->_capacity);
     assert(to_loc < this->_capacity);
     assert(num_points < this->_capacity);
+    detach_mapping();
     memmove(_data + _aligned_dim * to_loc, _data + _aligned_dim * from_loc, num_points * _aligned_dim * sizeof(data_t));
+    if (_use_norms)
+        memmove(_norms.data() + to_loc, _norms.data() + from_loc, num_points * sizeof(float));
 }
 
 template <typename data_t> location_t InMemDataStore<data_t>::calculate_medoid() const
@@ -396,6 +849,8 @@ template <typename data_t> Distance<data_t> *InMemDataStore<data_t>::get_dist_fn
 
 template DISKANN_DLLEXPORT class InMemDataStore<float>;
 template DISKANN_DLLEXPORT class InMemDataStore<int8_t>;
+template DISKANN_DLLEXPORT class InMemDataStore<float16>;
+template DISKANN_DLLEXPORT class InMemDataStore<bfloat16>;
 template DISKANN_DLLEXPORT class InMemDataStore<uint8_t>;
 
 } // namespace diskann
\ No newline at end of file
@@ -22,15 +22,23 @@ std::tuple<uint32_t, uint32_t, size_t> InMemGraphStore::load(const std::string &
     return load_impl(index_path_prefix, num_points);
 }
 int InMemGraphStore::store(const std::string &index_path_prefix, const size_t num_points,
-                           const size_t num_frozen_points, const uint32_t start)
+                           const size_t num_frozen_points, const uint32_t start, const size_t frozen_location)
 {
-    return save_graph(index_path_prefix, num_points, num_frozen_points, start);
+    return save_graph(index_path_prefix, num_points, num_frozen_points, start, frozen_location);
 }
-const std::vector<location_t> &InMemGraphStore::get_neighbours(const location_t i) const
+NeighbourList InMemGraphStore::get_neighbours(const location_t i) const
 {
     return _graph.at(i);
 }
 
+// only the list header is known here; its contents are prefetched by the
+// caller once get_neighbours() returns
+void InMemGraphStore::prefetch_neighbours(const location_t i) const
+{
+    if (i < _graph.size())
+        _mm_prefetch((const char *)&_graph[i], _MM_HINT_T0);
+}
+
 void InMemGraphStore::add_neighbour(const location_t i, location_t neighbour_id)
 {
     _graph[i].emplace_back(neighbour_id);
@@ -60,6 +68,10 @@ void InMemGraphStore::set_neighbours(const location_t i, std::vector<location_t>
 
 size_t InMemGraphStore::resize_graph(const size_t new_size)
 {
+    // the lists move to a new array only when it runs out of room, so leave
+    // room for the resizes to come
+    if (new_size > _graph.capacity() && !_graph.empty())
+        _graph.reserve(new_size * defaults::STORE_GROWTH_RESERVE);
     _graph.resize(new_size);
     set_total_points(new_size);
     return _graph.size();
@@ -138,16 +150,12 @@ std::tuple<uint32_t, uint32_t, size_t> InMemGraphStore::load_impl(const std::str
     size_t expected_file_size;
     size_t file_frozen_pts;
     uint32_t start;
-    size_t file_offset = 0; // will need this for single file format support
-
-    std::ifstream in;
-    in.exceptions(std::ios::badbit | std::ios::failbit);
-    in.open(filename, std::ios::binary);
-    in.seekg(file_offset, in.beg);
-    in.read((char *)&expected_file_size, sizeof(size_t));
-    in.read((char *)&_max_observed_degree, sizeof(uint32_t));
-    in.read((char *)&start, sizeof(uint32_t));
-    in.read((char *)&file_frozen_pts, sizeof(size_t));
+
+    const GraphFileHeader header = read_graph_header(filename);
+    expected_file_size = header.expected_file_size;
+    _max_observed_degree = header.max_observed_degree;
+    start = header.start;
+    file_frozen_pts = header.num_frozen_points;
     size_t vamana_metadata_size = sizeof(size_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(size_t);
 
     diskann::cout << "From graph header, expected_file_size: " << expected_file_size
@@ -164,33 +172,25 @@ std::tuple<uint32_t, uint32_t, size_t> InMemGraphStore::load_impl(const std::str
         this->resize_graph(expected_num_points);
     }
 
-    size_t bytes_read = vamana_metadata_size;
     size_t cc = 0;
-    uint32_t nodes_read = 0;
-    while (bytes_read != expected_file_size)
+    uint32_t max_degree = 0;
+    const uint32_t nodes_read = load_graph_adjacency_parallel(
+        filename, vamana_metadata_size, expected_file_size,
+        [this](const uint32_t node, const uint32_t k, const uint32_t *nbrs) {
+            if (node < _graph.size())
+            {
+                std::vector<uint32_t> tmp(nbrs, nbrs + k);
+                _graph[node].swap(tmp);
+            }
+        },
+        cc, max_degree);
+    if (nodes_read > _graph.size())
     {
-        uint32_t k;
-        in.read((char *)&k, sizeof(uint32_t));
-
-        if (k == 0)
-        {
-            diskann::cerr << "ERROR: Point found with no out-neighbours, point#" << nodes_read << std::endl;
-        }
-
-        cc += k;
-        ++nodes_read;
-        std::vector<uint32_t> tmp(k);
-        tmp.reserve(k);
-        in.read((char *)tmp.data(), k * sizeof(uint32_t));
-        _graph[nodes_read - 1].swap(tmp);
-        bytes_read += sizeof(uint32_t) * ((size_t)k + 1);
-        if (nodes_read % 10000000 == 0)
-            diskann::cout << "." << std::flush;
-        if (k > _max_range_of_graph)
-        {
-            _max_range_of_graph = k;
-        }
+        throw ANNException("ERROR: graph file " + filename + " has " + std::to_string(nodes_read) +
+                               " nodes, more than the " + std::to_string(_graph.size()) + " expected",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
     }
+    _max_range_of_graph = std::max(_max_range_of_graph, (size_t)max_degree);
 
     diskann::cout << "done. Index has " << nodes_read << " nodes and " << cc << " out-edges, _start is set to " << start
                   << std::endl;
@@ -198,7 +198,7 @@ std::tuple<uint32_t, uint32_t, size_t> InMemGraphStore::load_impl(const std::str
 }
 
 int InMemGraphStore::save_graph(const std::string &index_path_prefix, const size_t num_points,
-                                const size_t num_frozen_points, const uint32_t start)
+                                const size_t num_frozen_points, const uint32_t start, const size_t frozen_location)
 {
     std::ofstream out;
     open_file_to_write(out, index_path_prefix);
@@ -214,12 +214,24 @@ int InMemGraphStore::save_graph(const std::string &index_path_prefix, const size
     out.write((char *)&num_frozen_points, sizeof(size_t));
 
     // Note: num_points = _nd + _num_frozen_points
+    const size_t active_points = num_points - num_frozen_points;
+    const size_t frozen_start = frozen_location == 0 ? active_points : frozen_location;
+    std::vector<uint32_t> moved_ids;
     for (uint32_t i = 0; i < num_points; i++)
     {
-        uint32_t GK = (uint32_t)_graph[i].size();
+        const std::vector<uint32_t> &neighbours = _graph[i < active_points ? i : frozen_start + (i - active_points)];
+        uint32_t GK = (uint32_t)neighbours.size();
+        const uint32_t *ids = neighbours.data();
+        if (frozen_start != active_points)
+        {
+            moved_ids.assign(neighbours.begin(), neighbours.end());
+            for (uint32_t &id : moved_ids)
+                id = id >= frozen_start ? (uint32_t)(id - frozen_start + active_points) : id;
+            ids = moved_ids.data();
+        }
         out.write((char *)&GK, sizeof(uint32_t));
-        out.write((char *)_graph[i].data(), GK * sizeof(uint32_t));
-        max_degree = _graph[i].size() > max_degree ? (uint32_t)_graph[i].size() : max_degree;
+        out.write((char *)ids, GK * sizeof(uint32_t));
+        max_degree = GK > max_degree ? GK : max_degree;
         index_size += (size_t)(sizeof(uint32_t) * (GK + 1));
     }
     out.seekp(file_offset, out.beg);
@@ -234,6 +246,14 @@ size_t InMemGraphStore::get_max_range_of_graph()
     return _max_range_of_graph;
 }
 
+size_t InMemGraphStore::memory_size() const
+{
+    size_t bytes = _graph.capacity() * sizeof(std::vector<uint32_t>);
+    for (const auto &neighbours : _graph)
+        bytes += neighbours.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
 uint32_t InMemGraphStore::get_max_observed_degree()
 {
     return _max_observed_degree;
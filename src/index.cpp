@@ -3,11 +3,14 @@
 
 #include <omp.h>
 
+#include <numeric>
 #include <type_traits>
 
 #include "boost/dynamic_bitset.hpp"
+#include "async_logger.h"
 #include "index_factory.h"
 #include "memory_mapper.h"
+#include "search_trace.h"
 #include "timer.h"
 #include "tsl/robin_map.h"
 #include "tsl/robin_set.h"
@@ -21,9 +24,12 @@
 #include <xmmintrin.h>
 #endif
 
-#include "index.h"
+#ifdef USE_CUDA
+#include "gpu_graph_search.h"
+#include "gpu_math_utils.h"
+#endif
 
-#define MAX_POINTS_FOR_USING_BITSET 10000000
+#include "index.h"
 
 namespace diskann
 {
@@ -35,28 +41,50 @@ Index<T, TagT, LabelT>::Index(const IndexConfig &index_config, std::shared_ptr<A
                               std::shared_ptr<AbstractDataStore<T>> pq_data_store)
     : _dist_metric(index_config.metric), _dim(index_config.dimension), _max_points(index_config.max_points),
       _num_frozen_pts(index_config.num_frozen_pts), _dynamic_index(index_config.dynamic_index),
-      _enable_tags(index_config.enable_tags), _indexingMaxC(DEFAULT_MAXC), _query_scratch(nullptr),
-      _pq_dist(index_config.pq_dist_build), _use_opq(index_config.use_opq),
+      _enable_tags(index_config.enable_tags), _indexingMaxC(DEFAULT_MAXC),
+      _pq_dist(index_config.pq_dist_build || index_config.num_sq_bits != 0 || index_config.num_pca_dims != 0),
+      _use_opq(index_config.use_opq),
       _filtered_index(index_config.filtered_index), _num_pq_chunks(index_config.num_pq_chunks),
-      _delete_set(new tsl::robin_set<uint32_t>), _conc_consolidate(index_config.concurrent_consolidate)
+      _delete_set(new tsl::robin_set<uint32_t>), _conc_consolidate(index_config.concurrent_consolidate),
+      _mmap_load(index_config.data_strategy == DataStoreStrategy::MMAP),
+      _mmap_build(index_config.data_strategy == DataStoreStrategy::MMAP_BUILD),
+      _num_lock_stripes(index_config.num_lock_stripes)
 {
     if (_dynamic_index && !_enable_tags)
     {
         throw ANNException("ERROR: Dynamic Indexing must have tags enabled.", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
+    if (_mmap_load != (index_config.graph_strategy == GraphStoreStrategy::MMAP))
+        throw ANNException("ERROR: memory-mapped loading needs both the data and graph store strategy set to MMAP",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (_mmap_load && _dynamic_index)
+        throw ANNException("ERROR: memory-mapped indices are read-only and cannot be dynamic", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    if (_mmap_build && (_dynamic_index || !(index_config.pq_dist_build || index_config.num_sq_bits != 0)))
+        throw ANNException("ERROR: memory-mapped builds are static and need PQ or SQ codes to search with", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    if (index_config.graph_strategy == GraphStoreStrategy::COMPRESSED && _dynamic_index)
+        throw ANNException("ERROR: compressed graph stores are read-only and cannot be dynamic", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+
     if (_pq_dist)
     {
         if (_dynamic_index)
             throw ANNException("ERROR: Dynamic Indexing not supported with PQ distance based "
                                "index construction",
                                -1, __FUNCSIG__, __FILE__, __LINE__);
-        if (_dist_metric == diskann::Metric::INNER_PRODUCT)
+        if (_dist_metric == diskann::Metric::INNER_PRODUCT && index_config.num_sq_bits == 0 &&
+            index_config.num_pca_dims == 0)
             throw ANNException("ERROR: Inner product metrics not yet supported "
                                "with PQ distance "
                                "base index",
                                -1, __FUNCSIG__, __FILE__, __LINE__);
     }
+    _num_sq_bits = index_config.num_sq_bits;
+    _num_pca_dims = index_config.num_pca_dims;
+    _quantized_rerank = index_config.quantized_rerank;
+    _quantized_rerank_factor = (std::max)(index_config.quantized_rerank_factor, 1U);
 
     if (_dynamic_index && _num_frozen_pts == 0)
     {
@@ -76,7 +104,8 @@ Index<T, TagT, LabelT>::Index(const IndexConfig &index_config, std::shared_ptr<A
     _pq_data_store = pq_data_store;
     _graph_store = std::move(graph_store);
 
-    _locks = std::vector<non_recursive_mutex>(total_internal_points);
+    _locks = std::vector<non_recursive_mutex>(_num_lock_stripes == 0 ? total_internal_points : _num_lock_stripes);
+    reset_tombstones();
     if (_enable_tags)
     {
         _location_to_tag.reserve(total_internal_points);
@@ -101,6 +130,10 @@ Index<T, TagT, LabelT>::Index(const IndexConfig &index_config, std::shared_ptr<A
         _filterIndexingQueueSize = index_config.index_write_params->filter_list_size;
         _indexingThreads = index_config.index_write_params->num_threads;
         _saturate_graph = index_config.index_write_params->saturate_graph;
+        _num_build_passes = index_config.index_write_params->num_passes;
+        _first_pass_alpha = index_config.index_write_params->first_pass_alpha;
+        _first_pass_threads = index_config.index_write_params->first_pass_num_threads;
+        _locality_clusters = index_config.index_write_params->locality_clusters;
 
         if (index_config.index_search_params != nullptr)
         {
@@ -117,7 +150,7 @@ Index<T, TagT, LabelT>::Index(Metric m, const size_t dim, const size_t max_point
                               const std::shared_ptr<IndexSearchParams> index_search_params, const size_t num_frozen_pts,
                               const bool dynamic_index, const bool enable_tags, const bool concurrent_consolidate,
                               const bool pq_dist_build, const size_t num_pq_chunks, const bool use_opq,
-                              const bool filtered_index)
+                              const bool filtered_index, const bool precompute_norms)
     : Index(
           IndexConfigBuilder()
               .with_metric(m)
@@ -133,12 +166,13 @@ Index<T, TagT, LabelT>::Index(Metric m, const size_t dim, const size_t max_point
               .with_num_pq_chunks(num_pq_chunks)
               .is_use_opq(use_opq)
               .is_filtered(filtered_index)
+              .is_precompute_norms(precompute_norms)
               .with_data_type(diskann_type_to_name<T>())
               .build(),
           IndexFactory::construct_datastore<T>(DataStoreStrategy::MEMORY,
                                                (max_points == 0 ? (size_t)1 : max_points) +
                                                    (dynamic_index && num_frozen_pts == 0 ? (size_t)1 : num_frozen_pts),
-                                               dim, m),
+                                               dim, m, precompute_norms),
           IndexFactory::construct_graphstore(GraphStoreStrategy::MEMORY,
                                              (max_points == 0 ? (size_t)1 : max_points) +
                                                  (dynamic_index && num_frozen_pts == 0 ? (size_t)1 : num_frozen_pts),
@@ -169,16 +203,9 @@ template <typename T, typename TagT, typename LabelT> Index<T, TagT, LabelT>::~I
         LockGuard lg(lock);
     }
 
-    if (_opt_graph != nullptr)
-    {
-        delete[] _opt_graph;
-    }
+    free_large(_opt_graph_buffer);
 
-    if (!_query_scratch.empty())
-    {
-        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-        manager.destroy();
-    }
+    _query_scratch.destroy();
 }
 
 template <typename T, typename TagT, typename LabelT>
@@ -189,10 +216,26 @@ void Index<T, TagT, LabelT>::initialize_query_scratch(uint32_t num_threads, uint
     {
         auto scratch = new InMemQueryScratch<T>(search_l, indexing_l, r, maxc, dim, _data_store->get_aligned_dim(),
                                                 _data_store->get_alignment_factor(), _pq_dist);
+        reserve_query_scratch(scratch, (std::max)(search_l, _max_search_l));
         _query_scratch.push(scratch);
     }
 }
 
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::reserve_query_scratch(InMemQueryScratch<T> *scratch, const uint32_t L)
+{
+    scratch->resize_for_new_L(L);
+    // as iterate_to_fixed_point() does at the start of every search
+    scratch->inserted_into_pool().reserve(_max_points + _num_frozen_pts, (uint64_t)L * scratch->get_R());
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::reserve_search_l(const uint32_t max_search_l)
+{
+    _max_search_l = (std::max)(_max_search_l, max_search_l);
+    _query_scratch.for_each([this](InMemQueryScratch<T> *scratch) { reserve_query_scratch(scratch, _max_search_l); });
+}
+
 template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, LabelT>::save_tags(std::string tags_file)
 {
     if (!_enable_tags)
@@ -218,7 +261,7 @@ template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, Labe
     }
     if (_num_frozen_pts > 0)
     {
-        std::memset((char *)&tag_data[_start], 0, sizeof(TagT) * _num_frozen_pts);
+        std::memset((char *)&tag_data[_nd], 0, sizeof(TagT) * _num_frozen_pts);
     }
     try
     {
@@ -232,20 +275,44 @@ template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, Labe
     return tag_bytes_written;
 }
 
-template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, LabelT>::save_data(std::string data_file)
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::save_data(std::string data_file, size_t frozen_location)
 {
-    // Note: at this point, either _nd == _max_points or any frozen points have
-    // been temporarily moved to _nd, so _nd + _num_frozen_pts is the valid
-    // location limit.
-    return _data_store->save(data_file, (location_t)(_nd + _num_frozen_pts));
+    // Note: either _nd == _max_points or any frozen points have been
+    // temporarily moved to _nd, so _nd + _num_frozen_pts is the valid
+    // location limit, unless the frozen points are at frozen_location.
+    if (frozen_location == 0 || frozen_location == _nd || _num_frozen_pts == 0)
+        return _data_store->save(data_file, (location_t)(_nd + _num_frozen_pts));
+
+    // the frozen vectors are appended to those of the _nd points
+    size_t bytes_written = _data_store->save(data_file, (location_t)_nd);
+    std::fstream writer(data_file, std::ios::binary | std::ios::in | std::ios::out);
+    if (!writer)
+        throw ANNException("Cannot reopen " + data_file + " to add the frozen points", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    const int npts_i32 = (int)(_nd + _num_frozen_pts);
+    writer.write((char *)&npts_i32, sizeof(int));
+    writer.seekp(0, std::ios::end);
+    std::vector<T> vector(_data_store->get_dims());
+    for (size_t i = 0; i < _num_frozen_pts; i++)
+    {
+        _data_store->get_vector((location_t)(frozen_location + i), vector.data());
+        writer.write((char *)vector.data(), vector.size() * sizeof(T));
+        bytes_written += vector.size() * sizeof(T);
+    }
+    return bytes_written;
 }
 
 // save the graph index on a file as an adjacency list. For each point,
 // first store the number of neighbors, and then the neighbor list (each as
 // 4 byte uint32_t)
-template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, LabelT>::save_graph(std::string graph_file)
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::save_graph(std::string graph_file, size_t frozen_location)
 {
-    return _graph_store->store(graph_file, _nd + _num_frozen_pts, _num_frozen_pts, _start);
+    uint32_t start = _start;
+    if (frozen_location != 0 && _start >= frozen_location)
+        start = (uint32_t)(_start - frozen_location + _nd);
+    return _graph_store->store(graph_file, _nd + _num_frozen_pts, _num_frozen_pts, start, frozen_location);
 }
 
 template <typename T, typename TagT, typename LabelT>
@@ -277,7 +344,6 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
     if (compact_before_save)
     {
         compact_data();
-        compact_frozen_point();
     }
     else
     {
@@ -288,6 +354,25 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
         }
     }
 
+    // The files list the frozen points right after the _nd points. A
+    // navigation store is saved as it is laid out, so with one the frozen
+    // points move there until the save is done. Otherwise they are saved
+    // from where they are, and the index is not changed by the rest of the
+    // save.
+    const bool move_frozen_points = has_navigation_store();
+    size_t frozen_location = 0;
+    if (move_frozen_points)
+        compact_frozen_point();
+    else if (_num_frozen_pts > 0 && _nd < _max_points)
+        frozen_location = _max_points;
+    auto saved_id = [&](uint32_t location) {
+        return frozen_location != 0 && location >= frozen_location ? (uint32_t)(location - frozen_location + _nd)
+                                                                    : location;
+    };
+    auto saved_location = [&](uint32_t i) {
+        return frozen_location != 0 && i >= _nd ? (uint32_t)(frozen_location + i - _nd) : i;
+    };
+
     if (!_save_as_one_file)
     {
         if (_filtered_index)
@@ -301,7 +386,7 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
                 }
                 for (auto iter : _label_to_start_id)
                 {
-                    medoid_writer << iter.first << ", " << iter.second << std::endl;
+                    medoid_writer << iter.first << ", " << saved_id(iter.second) << std::endl;
                 }
                 medoid_writer.close();
             }
@@ -320,12 +405,13 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
                 assert(label_writer.is_open());
                 for (uint32_t i = 0; i < _nd + _num_frozen_pts; i++)
                 {
-                    for (uint32_t j = 0; j + 1 < _location_to_labels[i].size(); j++)
+                    const std::vector<LabelT> &labels = _location_to_labels[saved_location(i)];
+                    for (uint32_t j = 0; j + 1 < labels.size(); j++)
                     {
-                        label_writer << _location_to_labels[i][j] << ",";
+                        label_writer << labels[j] << ",";
                     }
-                    if (_location_to_labels[i].size() != 0)
-                        label_writer << _location_to_labels[i][_location_to_labels[i].size() - 1];
+                    if (labels.size() != 0)
+                        label_writer << labels[labels.size() - 1];
 
                     label_writer << std::endl;
                 }
@@ -347,13 +433,13 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
                     assert(raw_label_writer.is_open());
                     for (uint32_t i = 0; i < _nd + _num_frozen_pts; i++)
                     {
-                        for (uint32_t j = 0; j + 1 < _location_to_labels[i].size(); j++)
+                        const std::vector<LabelT> &labels = _location_to_labels[saved_location(i)];
+                        for (uint32_t j = 0; j + 1 < labels.size(); j++)
                         {
-                            raw_label_writer << mapped_to_raw_labels[_location_to_labels[i][j]] << ",";
+                            raw_label_writer << mapped_to_raw_labels[labels[j]] << ",";
                         }
-                        if (_location_to_labels[i].size() != 0)
-                            raw_label_writer
-                                << mapped_to_raw_labels[_location_to_labels[i][_location_to_labels[i].size() - 1]];
+                        if (labels.size() != 0)
+                            raw_label_writer << mapped_to_raw_labels[labels[labels.size() - 1]];
 
                         raw_label_writer << std::endl;
                     }
@@ -367,18 +453,43 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
         std::string data_file = std::string(filename) + ".data";
         std::string delete_list_file = std::string(filename) + ".del";
 
+        // Searches may run while the files are written. Inserts, deletes and
+        // consolidation still wait on the locks held.
+        if (!move_frozen_points)
+            ul.unlock();
+
         // Because the save_* functions use append mode, ensure that
         // the files are deleted before save. Ideally, we should check
         // the error code for delete_file, but will ignore now because
         // delete should succeed if save will succeed.
         delete_file(graph_file);
-        save_graph(graph_file);
+        save_graph(graph_file, frozen_location);
         delete_file(data_file);
-        save_data(data_file);
+        save_data(data_file, frozen_location);
+        if (has_navigation_store())
+        {
+            delete_file(graph_file + navigation_store_suffix());
+            _pq_data_store->save(graph_file + navigation_store_suffix(), (location_t)(_nd + _num_frozen_pts));
+        }
         delete_file(tags_file);
         save_tags(tags_file);
         delete_file(delete_list_file);
         save_delete_list(delete_list_file);
+
+        // The log is emptied only once the files that now hold its updates
+        // are on storage
+        if (_wal != nullptr)
+        {
+            for (const std::string &file :
+                 {graph_file, data_file, graph_file + ".sq", graph_file + ".pca", tags_file, delete_list_file,
+                  graph_file + "_labels.txt", graph_file + "_labels_to_medoids.txt",
+                  graph_file + "_universal_label.txt", graph_file + "_raw_labels.txt"})
+            {
+                if (file_exists(file))
+                    WriteAheadLog::sync_file(file);
+            }
+            _wal->reset();
+        }
     }
     else
     {
@@ -389,7 +500,8 @@ void Index<T, TagT, LabelT>::save(const char *filename, bool compact_before_save
 
     // If frozen points were temporarily compacted to _nd, move back to
     // _max_points.
-    reposition_frozen_point_to_end();
+    if (move_frozen_points)
+        reposition_frozen_point_to_end();
 
     diskann::cout << "Time taken for save: " << timer.elapsed() / 1000000.0 << "s." << std::endl;
 }
@@ -495,7 +607,10 @@ size_t Index<T, TagT, LabelT>::load_data(std::string filename)
     // manner.
     copy_aligned_data_from_file<T>(reader, _data, file_num_points, file_dim, _data_store->get_aligned_dim());
 #else
-    _data_store->load(filename); // offset == 0.
+    if (_mmap_load)
+        _data_store->load_mmap(filename);
+    else
+        _data_store->load(filename); // offset == 0.
 #endif
     return file_num_points;
 }
@@ -554,11 +669,26 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
         // For DLVS Store, we will not support saving the index in multiple
         // files.
 #ifndef EXEC_ENV_OLS
-        std::string data_file = std::string(filename) + ".data";
+        std::string data_file = std::string(filename) + (_mmap_load ? ".mmap.data" : ".data");
         std::string tags_file = std::string(filename) + ".tags";
         std::string delete_set_file = std::string(filename) + ".del";
-        std::string graph_file = std::string(filename);
-        data_file_num_pts = load_data(data_file);
+        std::string graph_file = std::string(filename) + (_mmap_load ? ".mmap.graph" : "");
+        if (_layout_only)
+            data_file_num_pts = load_layout(mem_index_file + ".opt");
+        else
+            data_file_num_pts = load_data(data_file);
+        if (has_navigation_store() && !_layout_only)
+        {
+            // indices saved without the store populate it again from their data
+            const std::string store_file = mem_index_file + navigation_store_suffix();
+            if (file_exists(store_file))
+                _pq_data_store->load(store_file);
+            else if (!_mmap_load)
+                _pq_data_store->populate_data(data_file, 0U);
+            else
+                throw ANNException("ERROR: " + store_file + " is needed to search a memory-mapped index on it", -1,
+                                   __FUNCSIG__, __FILE__, __LINE__);
+        }
         if (file_exists(delete_set_file))
         {
             load_delete_set(delete_set_file);
@@ -567,7 +697,7 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
         {
             tags_file_num_pts = load_tags(tags_file);
         }
-        graph_num_pts = load_graph(graph_file, data_file_num_pts);
+        graph_num_pts = _layout_only ? data_file_num_pts : load_graph(graph_file, data_file_num_pts);
 #endif
     }
     else
@@ -593,6 +723,15 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
         _label_map = load_label_map(labels_map_file);
         parse_label_file(labels_file, label_num_pts);
         assert(label_num_pts == data_file_num_pts - _num_frozen_pts);
+        if (!_dynamic_index)
+        {
+            size_t num_total_labels = 0;
+            for (size_t i = 0; i < label_num_pts; i++)
+                num_total_labels += _location_to_labels[i].size();
+            _label_bitmap.clear();
+            if (label_num_pts > 0 && num_total_labels >= label_num_pts * defaults::LABEL_BITMAP_MIN_AVG_LABELS)
+                _label_bitmap.build(label_num_pts, _location_to_labels);
+        }
         if (file_exists(labels_to_medoids))
         {
             std::ifstream medoid_stream(labels_to_medoids);
@@ -635,6 +774,8 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
     }
 
     _nd = data_file_num_pts - _num_frozen_pts;
+    if (_enable_tags)
+        _location_to_tag.reserve(_max_points + _num_frozen_pts);
     _empty_slots.clear();
     _empty_slots.reserve(_max_points);
     for (auto i = _nd; i < _max_points; i++)
@@ -642,7 +783,10 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
         _empty_slots.insert((uint32_t)i);
     }
 
-    reposition_frozen_point_to_end();
+    // the layout was saved with the frozen points already at the end
+    if (!_layout_only)
+        reposition_frozen_point_to_end();
+    reset_tombstones();
     diskann::cout << "Num frozen points:" << _num_frozen_pts << " _nd: " << _nd << " _start: " << _start
                   << " size(_location_to_tag): " << _location_to_tag.size()
                   << " size(_tag_to_location):" << _tag_to_location.size() << " Max points: " << _max_points
@@ -654,8 +798,9 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
     // initialize_q_s().
     if (_query_scratch.size() == 0)
     {
-        initialize_query_scratch(num_threads, search_l, search_l, (uint32_t)_graph_store->get_max_range_of_graph(),
-                                 _indexingMaxC, _dim);
+        const uint32_t max_degree = _layout_only ? (uint32_t)(_neighbor_len / sizeof(uint32_t) - 1)
+                                                 : (uint32_t)_graph_store->get_max_range_of_graph();
+        initialize_query_scratch(num_threads, search_l, search_l, max_degree, _indexingMaxC, _dim);
     }
 }
 
@@ -663,20 +808,7 @@ void Index<T, TagT, LabelT>::load(const char *filename, uint32_t num_threads, ui
 template <typename T, typename TagT, typename LabelT>
 size_t Index<T, TagT, LabelT>::get_graph_num_frozen_points(const std::string &graph_file)
 {
-    size_t expected_file_size;
-    uint32_t max_observed_degree, start;
-    size_t file_frozen_pts;
-
-    std::ifstream in;
-    in.exceptions(std::ios::badbit | std::ios::failbit);
-
-    in.open(graph_file, std::ios::binary);
-    in.read((char *)&expected_file_size, sizeof(size_t));
-    in.read((char *)&max_observed_degree, sizeof(uint32_t));
-    in.read((char *)&start, sizeof(uint32_t));
-    in.read((char *)&file_frozen_pts, sizeof(size_t));
-
-    return file_frozen_pts;
+    return read_graph_header(graph_file).num_frozen_points;
 }
 #endif
 
@@ -690,7 +822,7 @@ template <typename T, typename TagT, typename LabelT>
 size_t Index<T, TagT, LabelT>::load_graph(std::string filename, size_t expected_num_points)
 {
 #endif
-    auto res = _graph_store->load(filename, expected_num_points);
+    auto res = _mmap_load ? _graph_store->load_mmap(filename) : _graph_store->load(filename, expected_num_points);
     _start = std::get<1>(res);
     _num_frozen_pts = std::get<2>(res);
     return std::get<0>(res);
@@ -755,12 +887,148 @@ template <typename T, typename TagT, typename LabelT> std::vector<uint32_t> Inde
     return init_ids;
 }
 
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::rerank_candidates(InMemQueryScratch<T> *scratch, const size_t K)
+{
+    if (!_pq_dist || !_quantized_rerank || K == 0)
+        return;
+
+    // the rest of the list only steers navigation; leave room for frozen
+    // points, which are dropped from the results
+    NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+    const size_t num_rerank = (std::min)(best_L_nodes.size(), _quantized_rerank_factor * K + _num_frozen_pts);
+    std::vector<Neighbor> &candidates = scratch->pool();
+    candidates.clear();
+    // A candidate farther than K results seen so far cannot be returned, so
+    // its distance is only computed up to theirs, the top of this max-heap
+    std::vector<float> &closest = scratch->dist_scratch();
+    closest.clear();
+    for (size_t i = 0; i < num_rerank; i++)
+    {
+        const uint32_t id = best_L_nodes[i].id;
+        const float bound = closest.size() < K ? std::numeric_limits<float>::max() : closest.front();
+        const float distance = _data_store->get_distance_with_bound(scratch->aligned_query(), id, bound);
+        candidates.emplace_back(id, distance);
+
+        // only the candidates copy_search_results() keeps count
+        if (id >= _max_points || is_tombstone(id) || distance >= bound)
+            continue;
+        if (closest.size() == K)
+        {
+            std::pop_heap(closest.begin(), closest.end());
+            closest.pop_back();
+        }
+        closest.push_back(distance);
+        std::push_heap(closest.begin(), closest.end());
+    }
+    closest.clear();
+
+    best_L_nodes.clear();
+    for (const auto &candidate : candidates)
+    {
+        best_L_nodes.insert(candidate);
+    }
+    candidates.clear();
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::add_entry_layer_seeds(const T *query, std::vector<uint32_t> &init_ids)
+{
+    if (_entry_layer == nullptr)
+        return;
+
+    uint32_t seeds[defaults::ENTRY_LAYER_NUM_SEEDS];
+    std::fill(seeds, seeds + defaults::ENTRY_LAYER_NUM_SEEDS, std::numeric_limits<uint32_t>::max());
+    _entry_layer->search(query, defaults::ENTRY_LAYER_NUM_SEEDS, defaults::ENTRY_LAYER_SEARCH_LIST_SIZE, seeds);
+
+    for (uint32_t i = 0; i < defaults::ENTRY_LAYER_NUM_SEEDS; i++)
+    {
+        if (seeds[i] >= _entry_layer_locations.size())
+            continue;
+        const uint32_t location = _entry_layer_locations[seeds[i]];
+        if (std::find(init_ids.begin(), init_ids.end(), location) == init_ids.end())
+            init_ids.emplace_back(location);
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::build_entry_layer(float sample_rate)
+{
+    if (_dynamic_index)
+    {
+        throw ANNException("Entry layer is only supported for static indices", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (!_has_built)
+    {
+        throw ANNException("Build or load the index before building its entry layer", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+
+    std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+    _entry_layer.reset();
+    _entry_layer_locations.clear();
+
+    size_t num_samples = (size_t)std::ceil(_nd * sample_rate);
+    num_samples = (std::max)(num_samples, (size_t)defaults::ENTRY_LAYER_MIN_POINTS);
+    if (2 * num_samples > _nd)
+    {
+        diskann::cout << "Index has too few points for an entry layer, not building one." << std::endl;
+        return;
+    }
+
+    std::random_device rd;
+    std::mt19937 generator(rd());
+    std::uniform_real_distribution<double> distribution(0, 1);
+    const double p_val = (double)num_samples / _nd;
+    for (uint32_t location = 0; location < _nd; location++)
+    {
+        if (distribution(generator) < p_val)
+            _entry_layer_locations.push_back(location);
+    }
+    if (_entry_layer_locations.empty())
+        return;
+
+    const size_t num_sampled = _entry_layer_locations.size();
+    std::vector<T> sample_data(num_sampled * _dim);
+    for (size_t i = 0; i < num_sampled; i++)
+    {
+        // a layout loaded on its own is the only copy of the vectors
+        if (_layout_only)
+            std::memcpy(sample_data.data() + i * _dim, _opt_graph + _node_size * _entry_layer_locations[i],
+                        _dim * sizeof(T));
+        else
+            _data_store->get_vector(_entry_layer_locations[i], sample_data.data() + i * _dim);
+    }
+
+    auto write_params = std::make_shared<IndexWriteParameters>(
+        IndexWriteParametersBuilder(defaults::BUILD_LIST_SIZE, defaults::MAX_DEGREE)
+            .with_alpha(defaults::ALPHA)
+            .build());
+    auto search_params = std::make_shared<IndexSearchParams>(defaults::ENTRY_LAYER_SEARCH_LIST_SIZE,
+                                                             (uint32_t)_query_scratch.size());
+    _entry_layer = std::make_unique<Index<T, uint32_t, uint32_t>>(_dist_metric, _dim, num_sampled, write_params,
+                                                                  search_params);
+    _entry_layer->build(sample_data.data(), num_sampled, std::vector<uint32_t>());
+
+    diskann::cout << "Built entry layer over " << num_sampled << " of " << _nd << " points." << std::endl;
+}
+
 // Find common filter between a node's labels and a given set of labels, while
 // taking into account universal label
 template <typename T, typename TagT, typename LabelT>
 bool Index<T, TagT, LabelT>::detect_common_filters(uint32_t point_id, bool search_invocation,
                                                    const std::vector<LabelT> &incoming_labels)
 {
+    if (search_invocation && point_id < _label_bitmap.num_points())
+    {
+        for (const LabelT &label : incoming_labels)
+        {
+            if (_label_bitmap.contains(point_id, (uint32_t)label))
+                return true;
+        }
+        return _use_universal_label && _label_bitmap.contains(point_id, (uint32_t)_universal_label);
+    }
+
     auto &curr_node_labels = _location_to_labels[point_id];
     std::vector<LabelT> common_filters;
     std::set_intersection(incoming_labels.begin(), incoming_labels.end(), curr_node_labels.begin(),
@@ -788,16 +1056,53 @@ bool Index<T, TagT, LabelT>::detect_common_filters(uint32_t point_id, bool searc
     return (common_filters.size() > 0);
 }
 
+template <typename T, typename TagT, typename LabelT>
+bool Index<T, TagT, LabelT>::point_matches_filter(uint32_t point_id, const LabelFilter<LabelT> &filter)
+{
+    auto has_label = [&](const LabelT &label) {
+        if (point_id < _label_bitmap.num_points())
+            return _label_bitmap.contains(point_id, (uint32_t)label);
+        const auto &point_labels = _location_to_labels[point_id];
+        return std::find(point_labels.begin(), point_labels.end(), label) != point_labels.end();
+    };
+    return filter.matches(has_label, [&]() { return _use_universal_label && has_label(_universal_label); });
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::add_filter_start_points(const LabelFilter<LabelT> &filter, std::vector<uint32_t> &init_ids)
+{
+    // start from the medoids of the labels of the most selective clause
+    const int64_t entry_clause = filter.most_selective_clause([this](const LabelT &label) {
+        auto iter = _label_counts.find(label);
+        return iter == _label_counts.end() ? (uint64_t)0 : (uint64_t)iter->second;
+    });
+    if (entry_clause < 0)
+        return;
+
+    bool found_medoid = false;
+    for (const LabelT &label : filter.clauses[entry_clause])
+    {
+        auto iter = _label_to_start_id.find(label);
+        if (iter != _label_to_start_id.end())
+        {
+            init_ids.emplace_back(iter->second);
+            found_medoid = true;
+        }
+    }
+    if (!found_medoid)
+        throw diskann::ANNException("No filtered medoid found. exitting ", -1);
+}
+
 template <typename T, typename TagT, typename LabelT>
 std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
     InMemQueryScratch<T> *scratch, const uint32_t Lsize, const std::vector<uint32_t> &init_ids, bool use_filter,
-    const std::vector<LabelT> &filter_labels, bool search_invocation)
+    const std::vector<LabelT> &filter_labels, bool search_invocation, const LabelFilter<LabelT> *label_filter,
+    SearchBudget *budget)
 {
     std::vector<Neighbor> &expanded_nodes = scratch->pool();
     NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
     best_L_nodes.reserve(Lsize);
-    tsl::robin_set<uint32_t> &inserted_into_pool_rs = scratch->inserted_into_pool_rs();
-    boost::dynamic_bitset<> &inserted_into_pool_bs = scratch->inserted_into_pool_bs();
+    VisitedSet &inserted_into_pool = scratch->inserted_into_pool();
     std::vector<uint32_t> &id_scratch = scratch->id_scratch();
     std::vector<float> &dist_scratch = scratch->dist_scratch();
     assert(id_scratch.size() == 0);
@@ -813,28 +1118,11 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
         throw ANNException("ERROR: Clear scratch space before passing.", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
-    // Decide whether to use bitset or robin set to mark visited nodes
-    auto total_num_points = _max_points + _num_frozen_pts;
-    bool fast_iterate = total_num_points <= MAX_POINTS_FOR_USING_BITSET;
-
-    if (fast_iterate)
-    {
-        if (inserted_into_pool_bs.size() < total_num_points)
-        {
-            // hopefully using 2X will reduce the number of allocations.
-            auto resize_size =
-                2 * total_num_points > MAX_POINTS_FOR_USING_BITSET ? MAX_POINTS_FOR_USING_BITSET : 2 * total_num_points;
-            inserted_into_pool_bs.resize(resize_size);
-        }
-    }
-
-    // Lambda to determine if a node has been visited
-    auto is_not_visited = [this, fast_iterate, &inserted_into_pool_bs, &inserted_into_pool_rs](const uint32_t id) {
-        return fast_iterate ? inserted_into_pool_bs[id] == 0
-                            : inserted_into_pool_rs.find(id) == inserted_into_pool_rs.end();
-    };
+    // Each search inserts about Lsize * R neighbours into the pool
+    inserted_into_pool.reserve(_max_points + _num_frozen_pts, (uint64_t)Lsize * scratch->get_R());
 
-    // Lambda to batch compute query<-> node distances in PQ space
+    // Lambda to batch compute query<-> node distances in the search data store,
+    // one call per expanded neighbourhood
     auto compute_dists = [this, scratch, pq_dists](const std::vector<uint32_t> &ids, std::vector<float> &dists_out) {
         _pq_data_store->get_distance(scratch->aligned_query(), ids, dists_out, scratch);
     };
@@ -849,23 +1137,16 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
                                         __LINE__);
         }
 
-        if (use_filter)
+        // with a label filter, the start points are searched from even if
+        // they do not match it
+        if (use_filter && label_filter == nullptr)
         {
             if (!detect_common_filters(id, search_invocation, filter_labels))
                 continue;
         }
 
-        if (is_not_visited(id))
+        if (inserted_into_pool.insert(id))
         {
-            if (fast_iterate)
-            {
-                inserted_into_pool_bs[id] = 1;
-            }
-            else
-            {
-                inserted_into_pool_rs.insert(id);
-            }
-
             float distance;
             uint32_t ids[] = {id};
             float distances[] = {std::numeric_limits<float>::max()};
@@ -879,11 +1160,21 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
 
     uint32_t hops = 0;
     uint32_t cmps = 0;
+    std::vector<location_t> nbrs_copy;
+    // builds run this for every point, so only searches are traced
+    const bool tracing = search_invocation && DISKANN_TRACE_ENABLED();
+    if (tracing)
+        SearchTrace::record(TraceEventType::QUERY_BEGIN, Lsize, 0);
+    if (budget != nullptr)
+        budget->begin(best_L_nodes);
 
-    while (best_L_nodes.has_unexpanded_node())
+    while (best_L_nodes.has_unexpanded_node() && (budget == nullptr || hops < budget->max_hops))
     {
         auto nbr = best_L_nodes.closest_unexpanded();
         auto n = nbr.id;
+        // searches stop navigating through deleted points after _tombstone_hop_limit hops
+        const bool skip_tombstones = search_invocation && _dynamic_index && hops >= _tombstone_hop_limit;
+        hops++;
 
         // Add node to expanded nodes to create pool for prune later
         if (!search_invocation)
@@ -903,24 +1194,29 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
             }
         }
 
-        // Find which of the nodes in des have not been visited before
+        // Find which of the nodes in des have not been visited before, and
+        // mark them visited
         id_scratch.clear();
         dist_scratch.clear();
         if (_dynamic_index)
         {
-            LockGuard guard(_locks[n]);
+            LockGuard guard(get_lock(n));
             for (auto id : _graph_store->get_neighbours(n))
             {
                 assert(id < _max_points + _num_frozen_pts);
 
+                if (skip_tombstones && is_tombstone(id))
+                    continue;
+
                 if (use_filter)
                 {
                     // NOTE: NEED TO CHECK IF THIS CORRECT WITH NEW LOCKS.
-                    if (!detect_common_filters(id, search_invocation, filter_labels))
+                    if (label_filter != nullptr ? !point_matches_filter(id, *label_filter)
+                                                : !detect_common_filters(id, search_invocation, filter_labels))
                         continue;
                 }
 
-                if (is_not_visited(id))
+                if (inserted_into_pool.insert(id))
                 {
                     id_scratch.push_back(id);
                 }
@@ -928,50 +1224,48 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::iterate_to_fixed_point(
         }
         else
         {
-            _locks[n].lock();
+            get_lock(n).lock();
             auto nbrs = _graph_store->get_neighbours(n);
-            _locks[n].unlock();
-            for (auto id : nbrs)
+            nbrs_copy.assign(nbrs.begin(), nbrs.end());
+            get_lock(n).unlock();
+            for (auto id : nbrs_copy)
             {
                 assert(id < _max_points + _num_frozen_pts);
 
+                if (skip_tombstones && is_tombstone(id))
+                    continue;
+
                 if (use_filter)
                 {
                     // NOTE: NEED TO CHECK IF THIS CORRECT WITH NEW LOCKS.
-                    if (!detect_common_filters(id, search_invocation, filter_labels))
+                    if (label_filter != nullptr ? !point_matches_filter(id, *label_filter)
+                                                : !detect_common_filters(id, search_invocation, filter_labels))
                         continue;
                 }
 
-                if (is_not_visited(id))
+                if (inserted_into_pool.insert(id))
                 {
                     id_scratch.push_back(id);
                 }
             }
         }
 
-        // Mark nodes visited
-        for (auto id : id_scratch)
-        {
-            if (fast_iterate)
-            {
-                inserted_into_pool_bs[id] = 1;
-            }
-            else
-            {
-                inserted_into_pool_rs.insert(id);
-            }
-        }
-
         assert(dist_scratch.capacity() >= id_scratch.size());
         compute_dists(id_scratch, dist_scratch);
         cmps += (uint32_t)id_scratch.size();
+        if (tracing)
+            SearchTrace::record(TraceEventType::EXPAND, n, id_scratch.size());
 
         // Insert <id, dist> pairs into the pool of candidates
         for (size_t m = 0; m < id_scratch.size(); ++m)
         {
             best_L_nodes.insert(Neighbor(id_scratch[m], dist_scratch[m]));
         }
+        if (budget != nullptr)
+            budget->after_hop(hops, best_L_nodes);
     }
+    if (tracing)
+        SearchTrace::record(TraceEventType::QUERY_END, hops, 0);
     return std::make_pair(hops, cmps);
 }
 
@@ -1073,6 +1367,10 @@ void Index<T, TagT, LabelT>::occlude_list(const uint32_t location, std::vector<N
     occlude_factor.clear();
     // Initialize occlude_factor to pool.size() many 0.0f values for correctness
     occlude_factor.insert(occlude_factor.end(), pool.size(), 0.0f);
+    std::vector<uint32_t> &occlude_ids = scratch->occlude_ids();
+    std::vector<uint32_t> &occlude_positions = scratch->occlude_positions();
+    std::vector<float> &occlude_distances = scratch->occlude_distances();
+    std::vector<float> &occlude_bounds = scratch->occlude_bounds();
 
     float cur_alpha = 1;
     while (cur_alpha <= alpha && result.size() < degree)
@@ -1099,7 +1397,15 @@ void Index<T, TagT, LabelT>::occlude_list(const uint32_t location, std::vector<N
                 }
             }
 
-            // Update occlude factor for points from iter+1 to pool.end()
+            // the occlude factors are not read again once the result is full
+            if (result.size() == degree)
+                break;
+
+            // Update occlude factor for points from iter+1 to pool.end(). The
+            // distances from iter to those it may occlude are computed as one
+            // row, so that the data store can batch and prefetch them.
+            occlude_ids.clear();
+            occlude_positions.clear();
             for (auto iter2 = iter + 1; iter2 != pool.end(); iter2++)
             {
                 auto t = iter2 - pool.begin();
@@ -1127,16 +1433,43 @@ void Index<T, TagT, LabelT>::occlude_list(const uint32_t location, std::vector<N
                 if (!prune_allowed)
                     continue;
 
-                float djk = _data_store->get_distance(iter2->id, iter->id);
-                if (_dist_metric == diskann::Metric::L2 || _dist_metric == diskann::Metric::COSINE)
+                occlude_ids.push_back(iter2->id);
+                occlude_positions.push_back((uint32_t)t);
+            }
+            if (occlude_ids.empty())
+                continue;
+            occlude_distances.resize(occlude_ids.size());
+            if (_dist_metric == diskann::Metric::L2 || _dist_metric == diskann::Metric::COSINE ||
+                _dist_metric == diskann::Metric::HAMMING)
+            {
+                // a distance above pool[t].distance gives a factor below 1,
+                // which never occludes, so it need not be computed in full
+                occlude_bounds.clear();
+                for (const uint32_t t : occlude_positions)
+                    occlude_bounds.push_back(pool[t].distance);
+                _data_store->get_distances_to_with_bound(iter->id, occlude_ids.data(), (uint32_t)occlude_ids.size(),
+                                                         occlude_bounds.data(), occlude_distances.data());
+            }
+            else
+            {
+                _data_store->get_distances_to(iter->id, occlude_ids.data(), (uint32_t)occlude_ids.size(),
+                                              occlude_distances.data());
+            }
+
+            for (size_t k = 0; k < occlude_positions.size(); k++)
+            {
+                const uint32_t t = occlude_positions[k];
+                const float djk = occlude_distances[k];
+                if (_dist_metric == diskann::Metric::L2 || _dist_metric == diskann::Metric::COSINE ||
+                    _dist_metric == diskann::Metric::HAMMING)
                 {
                     occlude_factor[t] = (djk == 0) ? std::numeric_limits<float>::max()
-                                                   : std::max(occlude_factor[t], iter2->distance / djk);
+                                                   : std::max(occlude_factor[t], pool[t].distance / djk);
                 }
                 else if (_dist_metric == diskann::Metric::INNER_PRODUCT)
                 {
                     // Improvization for flipping max and min dist for MIPS
-                    float x = -iter2->distance;
+                    float x = -pool[t].distance;
                     float y = -djk;
                     if (y > cur_alpha * x)
                     {
@@ -1168,12 +1501,22 @@ void Index<T, TagT, LabelT>::prune_neighbors(const uint32_t location, std::vecto
         return;
     }
 
-    // If using _pq_build, over-write the PQ distances with actual distances
-    // REFACTOR PQ: TODO: How to get rid of this!?
+    // With a quantized build the pool was found on the navigation store, but
+    // it is pruned on the full-precision vectors: its distances to location
+    // are recomputed as one row, so the data store can batch and prefetch the
+    // reads. The pool is only a few hundred candidates, so the build keeps
+    // most of its savings while occlude_list sees exact distances throughout.
     if (_pq_dist)
     {
-        for (auto &ngh : pool)
-            ngh.distance = _data_store->get_distance(ngh.id, location);
+        std::vector<uint32_t> &pool_ids = scratch->occlude_ids();
+        std::vector<float> &pool_distances = scratch->occlude_distances();
+        pool_ids.clear();
+        for (const auto &ngh : pool)
+            pool_ids.push_back(ngh.id);
+        pool_distances.resize(pool_ids.size());
+        _data_store->get_distances_to(location, pool_ids.data(), (uint32_t)pool_ids.size(), pool_distances.data());
+        for (size_t i = 0; i < pool.size(); i++)
+            pool[i].distance = pool_distances[i];
     }
 
     // sort the pool based on distance to query and prune it with occlude_list
@@ -1213,8 +1556,8 @@ void Index<T, TagT, LabelT>::inter_insert(uint32_t n, std::vector<uint32_t> &pru
         std::vector<uint32_t> copy_of_neighbors;
         bool prune_needed = false;
         {
-            LockGuard guard(_locks[des]);
-            auto &des_pool = _graph_store->get_neighbours(des);
+            LockGuard guard(get_lock(des));
+            auto des_pool = _graph_store->get_neighbours(des);
             if (std::find(des_pool.begin(), des_pool.end(), n) == des_pool.end())
             {
                 if (des_pool.size() < (uint64_t)(defaults::GRAPH_SLACK_FACTOR * range))
@@ -1226,7 +1569,7 @@ void Index<T, TagT, LabelT>::inter_insert(uint32_t n, std::vector<uint32_t> &pru
                 else
                 {
                     copy_of_neighbors.reserve(des_pool.size() + 1);
-                    copy_of_neighbors = des_pool;
+                    copy_of_neighbors.assign(des_pool.begin(), des_pool.end());
                     copy_of_neighbors.push_back(n);
                     prune_needed = true;
                 }
@@ -1254,7 +1597,7 @@ void Index<T, TagT, LabelT>::inter_insert(uint32_t n, std::vector<uint32_t> &pru
             std::vector<uint32_t> new_out_neighbors;
             prune_neighbors(des, dummy_pool, new_out_neighbors, scratch);
             {
-                LockGuard guard(_locks[des]);
+                LockGuard guard(get_lock(des));
 
                 _graph_store->set_neighbours(des, new_out_neighbors);
             }
@@ -1268,12 +1611,132 @@ void Index<T, TagT, LabelT>::inter_insert(uint32_t n, std::vector<uint32_t> &pru
     inter_insert(n, pruned_list, _indexingRange, scratch);
 }
 
-template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::link()
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::batch_inter_insert(const uint32_t *sources, const std::vector<uint32_t> *pruned_lists,
+                                                const size_t num_sources)
+{
+    // group the reverse edges (des, src) by destination
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (size_t j = 0; j < num_sources; j++)
+    {
+        for (auto des : pruned_lists[j])
+            edges.emplace_back(des, sources[j]);
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<size_t> group_starts;
+    for (size_t e = 0; e < edges.size(); e++)
+    {
+        if (e == 0 || edges[e].first != edges[e - 1].first)
+            group_starts.push_back(e);
+    }
+    group_starts.push_back(edges.size());
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t g = 0; g < (int64_t)group_starts.size() - 1; g++)
+    {
+        const uint32_t des = edges[group_starts[g]].first;
+        assert(des < _max_points + _num_frozen_pts);
+
+        std::vector<uint32_t> copy_of_neighbors;
+        bool prune_needed = false;
+        {
+            LockGuard guard(get_lock(des));
+            auto des_pool = _graph_store->get_neighbours(des);
+            copy_of_neighbors.reserve(des_pool.size() + group_starts[g + 1] - group_starts[g]);
+            copy_of_neighbors.assign(des_pool.begin(), des_pool.end());
+            for (size_t e = group_starts[g]; e < group_starts[g + 1]; e++)
+            {
+                if (std::find(des_pool.begin(), des_pool.end(), edges[e].second) == des_pool.end())
+                    copy_of_neighbors.push_back(edges[e].second);
+            }
+
+            if (copy_of_neighbors.size() == des_pool.size())
+                continue;
+            if (copy_of_neighbors.size() <= (uint64_t)(defaults::GRAPH_SLACK_FACTOR * _indexingRange))
+                _graph_store->set_neighbours(des, copy_of_neighbors);
+            else
+                prune_needed = true;
+        } // des lock is released by this point
+
+        if (prune_needed)
+        {
+            ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+            auto scratch = manager.scratch_space();
+
+            tsl::robin_set<uint32_t> dummy_visited(0);
+            std::vector<Neighbor> dummy_pool(0);
+            dummy_visited.reserve(copy_of_neighbors.size());
+            dummy_pool.reserve(copy_of_neighbors.size());
+
+            for (auto cur_nbr : copy_of_neighbors)
+            {
+                if (dummy_visited.find(cur_nbr) == dummy_visited.end() && cur_nbr != des)
+                {
+                    float dist = _data_store->get_distance(des, cur_nbr);
+                    dummy_pool.emplace_back(Neighbor(cur_nbr, dist));
+                    dummy_visited.insert(cur_nbr);
+                }
+            }
+            std::vector<uint32_t> new_out_neighbors;
+            prune_neighbors(des, dummy_pool, new_out_neighbors, scratch);
+            {
+                LockGuard guard(get_lock(des));
+
+                _graph_store->set_neighbours(des, new_out_neighbors);
+            }
+        }
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::order_for_locality(std::vector<uint32_t> &visit_order, uint32_t num_clusters)
 {
-    uint32_t num_threads = _indexingThreads;
-    if (num_threads != 0)
-        omp_set_num_threads(num_threads);
+    const size_t num_points = std::min(visit_order.size(), (size_t)_nd);
+    num_clusters = (uint32_t)std::min((size_t)num_clusters, num_points);
+    if (num_clusters < 2)
+        return;
+
+    diskann::Timer timer;
+    std::vector<uint32_t> pivots(visit_order.begin(), visit_order.begin() + num_points);
+    std::mt19937 gen(0x5eed);
+    for (uint32_t i = 0; i < num_clusters; i++)
+        std::swap(pivots[i], pivots[i + gen() % (num_points - i)]);
+    pivots.resize(num_clusters);
+
+    std::vector<uint32_t> cluster(num_points);
+#pragma omp parallel for schedule(dynamic, 4096)
+    for (int64_t i = 0; i < (int64_t)num_points; i++)
+    {
+        float best = std::numeric_limits<float>::max();
+        for (uint32_t c = 0; c < num_clusters; c++)
+        {
+            const float dist = _data_store->get_distance(visit_order[i], pivots[c]);
+            if (dist < best)
+            {
+                best = dist;
+                cluster[i] = c;
+            }
+        }
+    }
+
+    // stable counting sort by cluster
+    std::vector<size_t> offsets(num_clusters + 1, 0);
+    for (size_t i = 0; i < num_points; i++)
+        offsets[cluster[i] + 1]++;
+    for (uint32_t c = 0; c < num_clusters; c++)
+        offsets[c + 1] += offsets[c];
+    std::vector<uint32_t> ordered(num_points);
+    for (size_t i = 0; i < num_points; i++)
+        ordered[offsets[cluster[i]]++] = visit_order[i];
+    std::copy(ordered.begin(), ordered.end(), visit_order.begin());
 
+    diskann::cout << "Grouped " << num_points << " points around " << num_clusters << " pivots in "
+                  << (double)timer.elapsed() / 1000000.0 << "s" << std::endl;
+}
+
+template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::link()
+{
     /* visit_order is a vector that is initialized to the entire graph */
     std::vector<uint32_t> visit_order;
     std::vector<diskann::Neighbor> pool, tmp;
@@ -1296,75 +1759,121 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
     else
         _start = calculate_entry_point();
 
+    if (_indexingThreads != 0)
+        omp_set_num_threads(_indexingThreads);
+    if (_locality_clusters > 0)
+        order_for_locality(visit_order, _locality_clusters);
+
     diskann::Timer link_timer;
 
-#pragma omp parallel for schedule(dynamic, 2048)
-    for (int64_t node_ctr = 0; node_ctr < (int64_t)(visit_order.size()); node_ctr++)
-    {
-        auto node = visit_order[node_ctr];
+    // all passes but the last build a first graph, usually sparser with
+    // alpha = 1, that the last pass refines with the configured alpha
+    const float alpha = _indexingAlpha;
+    const uint32_t num_passes = std::max(_num_build_passes, 1u);
+    for (uint32_t pass = 0; pass < num_passes; pass++)
+    {
+        const bool last_pass = pass + 1 == num_passes;
+        _indexingAlpha = last_pass ? alpha : _first_pass_alpha;
+        uint32_t num_threads = _indexingThreads;
+        // the scratch pool holds _indexingThreads scratch spaces
+        if (!last_pass && _first_pass_threads != 0)
+            num_threads = num_threads == 0 ? _first_pass_threads : std::min(_first_pass_threads, num_threads);
+        if (num_threads != 0)
+            omp_set_num_threads(num_threads);
+
+        diskann::Timer pass_timer;
+        std::atomic<uint64_t> num_done(0);
+        const uint64_t report_every = std::max<uint64_t>(visit_order.size() / 100, 10000);
+
+        auto link_nodes = [&](uint64_t begin, uint64_t end) {
+            for (uint64_t node_ctr = begin; node_ctr < end; node_ctr++)
+            {
+                auto node = visit_order[node_ctr];
 
-        // Find and add appropriate graph edges
-        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-        auto scratch = manager.scratch_space();
-        std::vector<uint32_t> pruned_list;
-        if (_filtered_index)
-        {
-            search_for_point_and_prune(node, _indexingQueueSize, pruned_list, scratch, true, _filterIndexingQueueSize);
-        }
-        else
-        {
-            search_for_point_and_prune(node, _indexingQueueSize, pruned_list, scratch);
-        }
-        assert(pruned_list.size() > 0);
+                // Find and add appropriate graph edges
+                ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+                auto scratch = manager.scratch_space();
+                std::vector<uint32_t> pruned_list;
+                if (_filtered_index)
+                {
+                    search_for_point_and_prune(node, _indexingQueueSize, pruned_list, scratch, true,
+                                               _filterIndexingQueueSize);
+                }
+                else
+                {
+                    search_for_point_and_prune(node, _indexingQueueSize, pruned_list, scratch);
+                }
+                assert(pruned_list.size() > 0);
 
-        {
-            LockGuard guard(_locks[node]);
+                {
+                    LockGuard guard(get_lock(node));
 
-            _graph_store->set_neighbours(node, pruned_list);
-            assert(_graph_store->get_neighbours((location_t)node).size() <= _indexingRange);
-        }
+                    _graph_store->set_neighbours(node, pruned_list);
+                    assert(_graph_store->get_neighbours((location_t)node).size() <= _indexingRange);
+                }
 
-        inter_insert(node, pruned_list, scratch);
+                inter_insert(node, pruned_list, scratch);
 
-        if (node_ctr % 100000 == 0)
+                const uint64_t done = ++num_done;
+                if (done % report_every == 0)
+                {
+                    const double seconds = (double)pass_timer.elapsed() / 1000000.0;
+                    const double rate = done / std::max(seconds, 1e-6);
+                    DISKANN_LOG(Info) << "Pass " << pass + 1 << "/" << num_passes << ": "
+                                      << (100.0 * done) / visit_order.size() << "% of index build completed, "
+                                      << (uint64_t)rate << " points/s, ETA "
+                                      << (uint64_t)((visit_order.size() - done) / rate) << "s";
+                }
+            }
+        };
+        get_executor()->parallel_for(visit_order.size(), 2048, link_nodes, num_threads);
+        if (_nd > 0)
         {
-            diskann::cout << "\r" << (100.0 * node_ctr) / (visit_order.size()) << "% of index build completed."
-                          << std::flush;
+            DISKANN_LOG(Info) << "Pass " << pass + 1 << "/" << num_passes << " with alpha " << _indexingAlpha
+                              << " and " << (num_threads != 0 ? num_threads : omp_get_max_threads())
+                              << " threads took " << (double)pass_timer.elapsed() / 1000000.0 << "s";
+            // keep the progress ahead of what the build prints next
+            AsyncLogger::flush();
         }
     }
+    _indexingAlpha = alpha;
+    if (_indexingThreads != 0)
+        omp_set_num_threads(_indexingThreads);
 
     if (_nd > 0)
     {
         diskann::cout << "Starting final cleanup.." << std::flush;
     }
-#pragma omp parallel for schedule(dynamic, 2048)
-    for (int64_t node_ctr = 0; node_ctr < (int64_t)(visit_order.size()); node_ctr++)
-    {
-        auto node = visit_order[node_ctr];
-        if (_graph_store->get_neighbours((location_t)node).size() > _indexingRange)
+    auto prune_nodes = [&](uint64_t begin, uint64_t end) {
+        for (uint64_t node_ctr = begin; node_ctr < end; node_ctr++)
         {
-            ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-            auto scratch = manager.scratch_space();
+            auto node = visit_order[node_ctr];
+            if (_graph_store->get_neighbours((location_t)node).size() > _indexingRange)
+            {
+                ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+                auto scratch = manager.scratch_space();
 
-            tsl::robin_set<uint32_t> dummy_visited(0);
-            std::vector<Neighbor> dummy_pool(0);
-            std::vector<uint32_t> new_out_neighbors;
+                tsl::robin_set<uint32_t> dummy_visited(0);
+                std::vector<Neighbor> dummy_pool(0);
+                std::vector<uint32_t> new_out_neighbors;
 
-            for (auto cur_nbr : _graph_store->get_neighbours((location_t)node))
-            {
-                if (dummy_visited.find(cur_nbr) == dummy_visited.end() && cur_nbr != node)
+                for (auto cur_nbr : _graph_store->get_neighbours((location_t)node))
                 {
-                    float dist = _data_store->get_distance(node, cur_nbr);
-                    dummy_pool.emplace_back(Neighbor(cur_nbr, dist));
-                    dummy_visited.insert(cur_nbr);
+                    if (dummy_visited.find(cur_nbr) == dummy_visited.end() && cur_nbr != node)
+                    {
+                        float dist = _data_store->get_distance(node, cur_nbr);
+                        dummy_pool.emplace_back(Neighbor(cur_nbr, dist));
+                        dummy_visited.insert(cur_nbr);
+                    }
                 }
-            }
-            prune_neighbors(node, dummy_pool, new_out_neighbors, scratch);
+                prune_neighbors(node, dummy_pool, new_out_neighbors, scratch);
 
-            _graph_store->clear_neighbours((location_t)node);
-            _graph_store->set_neighbours((location_t)node, new_out_neighbors);
+                _graph_store->clear_neighbours((location_t)node);
+                _graph_store->set_neighbours((location_t)node, new_out_neighbors);
+            }
         }
-    }
+    };
+    get_executor()->parallel_for(visit_order.size(), 2048, prune_nodes, _indexingThreads);
     if (_nd > 0)
     {
         diskann::cout << "done. Link time: " << ((double)link_timer.elapsed() / (double)1000000) << "s" << std::endl;
@@ -1381,36 +1890,38 @@ void Index<T, TagT, LabelT>::prune_all_neighbors(const uint32_t max_degree, cons
     _filtered_index = true;
 
     diskann::Timer timer;
-#pragma omp parallel for
-    for (int64_t node = 0; node < (int64_t)(_max_points + _num_frozen_pts); node++)
-    {
-        if ((size_t)node < _nd || (size_t)node >= _max_points)
+    auto prune_nodes = [&](uint64_t begin, uint64_t end) {
+        for (int64_t node = (int64_t)begin; node < (int64_t)end; node++)
         {
-            if (_graph_store->get_neighbours((location_t)node).size() > range)
+            if ((size_t)node < _nd || (size_t)node >= _max_points)
             {
-                tsl::robin_set<uint32_t> dummy_visited(0);
-                std::vector<Neighbor> dummy_pool(0);
-                std::vector<uint32_t> new_out_neighbors;
+                if (_graph_store->get_neighbours((location_t)node).size() > range)
+                {
+                    tsl::robin_set<uint32_t> dummy_visited(0);
+                    std::vector<Neighbor> dummy_pool(0);
+                    std::vector<uint32_t> new_out_neighbors;
 
-                ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-                auto scratch = manager.scratch_space();
+                    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+                    auto scratch = manager.scratch_space();
 
-                for (auto cur_nbr : _graph_store->get_neighbours((location_t)node))
-                {
-                    if (dummy_visited.find(cur_nbr) == dummy_visited.end() && cur_nbr != node)
+                    for (auto cur_nbr : _graph_store->get_neighbours((location_t)node))
                     {
-                        float dist = _data_store->get_distance((location_t)node, (location_t)cur_nbr);
-                        dummy_pool.emplace_back(Neighbor(cur_nbr, dist));
-                        dummy_visited.insert(cur_nbr);
+                        if (dummy_visited.find(cur_nbr) == dummy_visited.end() && cur_nbr != node)
+                        {
+                            float dist = _data_store->get_distance((location_t)node, (location_t)cur_nbr);
+                            dummy_pool.emplace_back(Neighbor(cur_nbr, dist));
+                            dummy_visited.insert(cur_nbr);
+                        }
                     }
-                }
 
-                prune_neighbors((uint32_t)node, dummy_pool, range, maxc, alpha, new_out_neighbors, scratch);
-                _graph_store->clear_neighbours((location_t)node);
-                _graph_store->set_neighbours((location_t)node, new_out_neighbors);
+                    prune_neighbors((uint32_t)node, dummy_pool, range, maxc, alpha, new_out_neighbors, scratch);
+                    _graph_store->clear_neighbours((location_t)node);
+                    _graph_store->set_neighbours((location_t)node, new_out_neighbors);
+                }
             }
         }
-    }
+    };
+    get_executor()->parallel_for(_max_points + _num_frozen_pts, 2048, prune_nodes, _indexingThreads);
 
     diskann::cout << "Prune time : " << timer.elapsed() / 1000 << "ms" << std::endl;
     size_t max = 0, min = 1 << 30, total = 0, cnt = 0;
@@ -1418,7 +1929,7 @@ void Index<T, TagT, LabelT>::prune_all_neighbors(const uint32_t max_degree, cons
     {
         if (i < _nd || i >= _max_points)
         {
-            const std::vector<uint32_t> &pool = _graph_store->get_neighbours((location_t)i);
+            auto pool = _graph_store->get_neighbours((location_t)i);
             max = (std::max)(max, pool.size());
             min = (std::min)(min, pool.size());
             total += pool.size();
@@ -1547,7 +2058,7 @@ void Index<T, TagT, LabelT>::build_with_data_populated(const std::vector<TagT> &
     size_t max = 0, min = SIZE_MAX, total = 0, cnt = 0;
     for (size_t i = 0; i < _nd; i++)
     {
-        auto &pool = _graph_store->get_neighbours((location_t)i);
+        auto pool = _graph_store->get_neighbours((location_t)i);
         max = std::max(max, pool.size());
         min = std::min(min, pool.size());
         total += pool.size();
@@ -1577,12 +2088,19 @@ void Index<T, TagT, LabelT>::_build(const DataType &data, const size_t num_point
 }
 template <typename T, typename TagT, typename LabelT>
 void Index<T, TagT, LabelT>::build(const T *data, const size_t num_points_to_load, const std::vector<TagT> &tags)
+{
+    build(data, num_points_to_load, tags, nullptr);
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::build(const T *data, const size_t num_points_to_load, const std::vector<TagT> &tags,
+                                   std::shared_ptr<const void> data_owner)
 {
     if (num_points_to_load == 0)
     {
         throw ANNException("Do not call build with 0 points", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
-    if (_pq_dist)
+    if (_pq_dist && !has_navigation_store())
     {
         throw ANNException("ERROR: DO not use this build interface with PQ distance", -1, __FUNCSIG__, __FILE__,
                            __LINE__);
@@ -1594,7 +2112,12 @@ void Index<T, TagT, LabelT>::build(const T *data, const size_t num_points_to_loa
         std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
         _nd = num_points_to_load;
 
-        _data_store->populate_data(data, (location_t)num_points_to_load);
+        if (_data_store->use_external_data(data, (location_t)num_points_to_load, std::move(data_owner)))
+            diskann::cout << "Building on the caller's vectors in place" << std::endl;
+        else
+            _data_store->populate_data(data, (location_t)num_points_to_load);
+        if (has_navigation_store())
+            _pq_data_store->populate_data(data, (location_t)num_points_to_load);
     }
 
     build_with_data_populated(tags);
@@ -1676,7 +2199,19 @@ void Index<T, TagT, LabelT>::build(const char *filename, const size_t num_points
 #endif
     }
 
-    _data_store->populate_data(filename, 0U);
+    if (_mmap_build)
+    {
+        // the copy is unlinked once mapped, and goes away with the mapping
+        const std::string mmap_file = std::string(filename) + ".build.mmap";
+        _data_store->populate_data_mmap(filename, mmap_file);
+#ifndef _WINDOWS
+        std::remove(mmap_file.c_str());
+#endif
+    }
+    else
+    {
+        _data_store->populate_data(filename, 0U);
+    }
     diskann::cout << "Using only first " << num_points_to_load << " from file.. " << std::endl;
 
     {
@@ -1795,6 +2330,18 @@ LabelT Index<T, TagT, LabelT>::get_converted_label(const std::string &raw_label)
     throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
 }
 
+template <typename T, typename TagT, typename LabelT>
+LabelFilter<LabelT> Index<T, TagT, LabelT>::get_converted_filter(const std::string &filter)
+{
+    return parse_label_filter<LabelT>(filter, [this](const std::string &raw_label, LabelT &label) {
+        auto iter = _label_map.find(raw_label);
+        if (iter == _label_map.end())
+            return false;
+        label = iter->second;
+        return true;
+    });
+}
+
 template <typename T, typename TagT, typename LabelT>
 void Index<T, TagT, LabelT>::parse_label_file(const std::string &label_file, size_t &num_points)
 {
@@ -1805,40 +2352,81 @@ void Index<T, TagT, LabelT>::parse_label_file(const std::string &label_file, siz
     {
         throw diskann::ANNException(std::string("Failed to open file ") + label_file, -1);
     }
+    infile.close();
 
-    std::string line, token;
-    uint32_t line_cnt = 0;
+    // read the file with parallel chunked reads, find the lines in one pass
+    // and parse them in parallel
+    const size_t file_size = get_file_size(label_file);
+    std::string buffer(file_size, '\0');
+    if (file_size > 0)
+        read_file_parallel(label_file, &buffer[0], 0, file_size);
 
-    while (std::getline(infile, line))
+    std::vector<size_t> line_starts;
+    for (size_t pos = 0; pos < file_size;)
     {
-        line_cnt++;
+        line_starts.push_back(pos);
+        const char *eol = (const char *)std::memchr(buffer.data() + pos, '\n', file_size - pos);
+        pos = eol == nullptr ? file_size : (size_t)(eol - buffer.data()) + 1;
     }
+    line_starts.push_back(file_size);
+    const size_t line_cnt = line_starts.size() - 1;
+    _location_to_labels.clear();
     _location_to_labels.resize(line_cnt, std::vector<LabelT>());
 
-    infile.clear();
-    infile.seekg(0, std::ios::beg);
-    line_cnt = 0;
-
-    while (std::getline(infile, line))
+    std::vector<tsl::robin_map<LabelT, uint32_t>> thread_labels(omp_get_max_threads());
+    std::exception_ptr error = nullptr;
+#pragma omp parallel for schedule(static, 16384)
+    for (int64_t i = 0; i < (int64_t)line_cnt; i++)
     {
-        std::istringstream iss(line);
-        std::vector<LabelT> lbls(0);
-        getline(iss, token, '\t');
-        std::istringstream new_iss(token);
-        while (getline(new_iss, token, ','))
+        try
+        {
+            // a line is the text up to '\n'; its labels are the text up to the
+            // first '\t', separated by ','
+            size_t line_end = line_starts[i + 1];
+            if (line_end > line_starts[i] && buffer[line_end - 1] == '\n')
+                line_end--;
+            line_end = std::find(buffer.begin() + line_starts[i], buffer.begin() + line_end, '\t') - buffer.begin();
+
+            std::vector<LabelT> &lbls = _location_to_labels[i];
+            auto &labels_seen = thread_labels[omp_get_thread_num()];
+            std::string token;
+            size_t pos = line_starts[i];
+            while (pos < line_end)
+            {
+                const size_t comma = std::find(buffer.begin() + pos, buffer.begin() + line_end, ',') - buffer.begin();
+                token.clear();
+                for (size_t c = pos; c < comma; c++)
+                {
+                    if (buffer[c] != '\r')
+                        token.push_back(buffer[c]);
+                }
+                LabelT token_as_num = (LabelT)std::stoul(token);
+                lbls.push_back(token_as_num);
+                labels_seen[token_as_num]++;
+                pos = comma + 1;
+            }
+            std::sort(lbls.begin(), lbls.end());
+        }
+        catch (...)
         {
-            token.erase(std::remove(token.begin(), token.end(), '\n'), token.end());
-            token.erase(std::remove(token.begin(), token.end(), '\r'), token.end());
-            LabelT token_as_num = (LabelT)std::stoul(token);
-            lbls.push_back(token_as_num);
-            _labels.insert(token_as_num);
+#pragma omp critical
+            if (error == nullptr)
+                error = std::current_exception();
         }
+    }
+    if (error != nullptr)
+        std::rethrow_exception(error);
 
-        std::sort(lbls.begin(), lbls.end());
-        _location_to_labels[line_cnt] = lbls;
-        line_cnt++;
+    _label_counts.clear();
+    for (auto &labels_seen : thread_labels)
+    {
+        for (auto &label_count : labels_seen)
+        {
+            _labels.insert(label_count.first);
+            _label_counts[label_count.first] += label_count.second;
+        }
     }
-    num_points = (size_t)line_cnt;
+    num_points = line_cnt;
     diskann::cout << "Identified " << _labels.size() << " distinct label(s)" << std::endl;
 }
 
@@ -1867,57 +2455,81 @@ void Index<T, TagT, LabelT>::build_filtered_index(const char *filename, const st
                      num_points_labels); // determines medoid for each label and identifies
                                          // the points to label mapping
 
-    std::unordered_map<LabelT, std::vector<uint32_t>> label_to_points;
-
+    // the points of each label, gathered in one pass; points with the universal
+    // label belong to every label and are kept apart instead of copied
+    const std::vector<LabelT> labels(_labels.begin(), _labels.end());
+    tsl::robin_map<LabelT, uint32_t> label_slot;
+    for (uint32_t i = 0; i < (uint32_t)labels.size(); i++)
+        label_slot[labels[i]] = i;
+    std::vector<std::vector<uint32_t>> label_to_points(labels.size());
+    std::vector<uint32_t> universal_points;
     for (uint32_t point_id = 0; point_id < num_points_to_load; point_id++)
     {
-        for (auto label : _location_to_labels[point_id])
+        for (const LabelT &label : _location_to_labels[point_id])
         {
-            if (label != _universal_label)
-            {
-                label_to_points[label].emplace_back(point_id);
-            }
-            else
+            if (_use_universal_label && label == _universal_label)
             {
-                for (typename tsl::robin_set<LabelT>::size_type lbl = 0; lbl < _labels.size(); lbl++)
-                {
-                    auto itr = _labels.begin();
-                    std::advance(itr, lbl);
-                    auto &x = *itr;
-                    label_to_points[x].emplace_back(point_id);
-                }
+                universal_points.emplace_back(point_id);
+                continue;
             }
+            auto iter = label_slot.find(label);
+            if (iter != label_slot.end())
+                label_to_points[iter->second].emplace_back(point_id);
         }
     }
 
-    uint32_t num_cands = 25;
-    for (auto itr = _labels.begin(); itr != _labels.end(); itr++)
+    // Each label starts from the least used of num_cands random points with
+    // it, so that labels spread over different start points. The labels are
+    // processed concurrently, each with its own generator, and share the usage
+    // counts.
+    const uint32_t num_cands = 25;
+    const uint32_t seed = (uint32_t)rand();
+    std::vector<uint32_t> medoid_counts(num_points_to_load, 0);
+    for (const auto &point_count : _medoid_counts)
+    {
+        if (point_count.first < num_points_to_load)
+            medoid_counts[point_count.first] = point_count.second;
+    }
+    std::vector<uint32_t> label_medoids(labels.size(), std::numeric_limits<uint32_t>::max());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t i = 0; i < (int64_t)labels.size(); i++)
     {
+        const std::vector<uint32_t> &labeled_points = label_to_points[i];
+        const size_t num_labeled = labeled_points.size() + universal_points.size();
+        if (num_labeled == 0)
+            continue;
+        std::mt19937 gen(seed + (uint32_t)i);
+        std::uniform_int_distribution<size_t> dist(0, num_labeled - 1);
         uint32_t best_medoid_count = std::numeric_limits<uint32_t>::max();
-        auto &curr_label = *itr;
-        uint32_t best_medoid;
-        auto labeled_points = label_to_points[curr_label];
+        uint32_t best_medoid = 0;
         for (uint32_t cnd = 0; cnd < num_cands; cnd++)
         {
-            uint32_t cur_cnd = labeled_points[rand() % labeled_points.size()];
-            uint32_t cur_cnt = std::numeric_limits<uint32_t>::max();
-            if (_medoid_counts.find(cur_cnd) == _medoid_counts.end())
-            {
-                _medoid_counts[cur_cnd] = 0;
-                cur_cnt = 0;
-            }
-            else
-            {
-                cur_cnt = _medoid_counts[cur_cnd];
-            }
+            const size_t pos = dist(gen);
+            const uint32_t cur_cnd = pos < labeled_points.size() ? labeled_points[pos]
+                                                                 : universal_points[pos - labeled_points.size()];
+            uint32_t cur_cnt;
+#pragma omp atomic read
+            cur_cnt = medoid_counts[cur_cnd];
             if (cur_cnt < best_medoid_count)
             {
                 best_medoid_count = cur_cnt;
                 best_medoid = cur_cnd;
             }
         }
-        _label_to_start_id[curr_label] = best_medoid;
-        _medoid_counts[best_medoid]++;
+#pragma omp atomic update
+        medoid_counts[best_medoid]++;
+        label_medoids[i] = best_medoid;
+    }
+
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        if (label_medoids[i] != std::numeric_limits<uint32_t>::max())
+            _label_to_start_id[labels[i]] = label_medoids[i];
+    }
+    for (uint32_t point_id = 0; point_id < num_points_to_load; point_id++)
+    {
+        if (medoid_counts[point_id] > 0)
+            _medoid_counts[point_id] = medoid_counts[point_id];
     }
 
     this->build(filename, num_points_to_load, tags);
@@ -1959,6 +2571,16 @@ template <typename T, typename TagT, typename LabelT>
 template <typename IdType>
 std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search(const T *query, const size_t K, const uint32_t L,
                                                              IdType *indices, float *distances)
+{
+    SearchBudget budget;
+    return search_with_budget(query, K, L, indices, distances, search_budget_for(L, K, budget));
+}
+
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_budget(const T *query, const size_t K,
+                                                                         const uint32_t L, IdType *indices,
+                                                                         float *distances, SearchBudget *budget)
 {
     if (K > (uint64_t)L)
     {
@@ -1970,27 +2592,41 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search(const T *query, con
 
     if (L > scratch->get_L())
     {
-        diskann::cout << "Attempting to expand query scratch_space. Was created "
-                      << "with Lsize: " << scratch->get_L() << " but search L is: " << L << std::endl;
-        scratch->resize_for_new_L(L);
-        diskann::cout << "Resize completed. New scratch->L is " << scratch->get_L() << std::endl;
+        DISKANN_LOG(Info) << "Expanding query scratch space from L " << scratch->get_L() << " to search L " << L;
+        scratch->grow_for_new_L(L);
     }
 
     const std::vector<LabelT> unused_filter_label;
-    const std::vector<uint32_t> init_ids = get_init_ids();
+    std::vector<uint32_t> init_ids = get_init_ids();
 
     std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
 
+    add_entry_layer_seeds(query, init_ids);
     _data_store->preprocess_query(query, scratch);
 
-    auto retval = iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true);
+    auto retval = iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true, nullptr, budget);
+    rerank_candidates(scratch, K);
+
+    const size_t pos = copy_search_results(scratch, K, indices, distances);
+    if (pos < K)
+    {
+        DISKANN_LOG_EVERY_MS(Warning, 1000) << "Found pos: " << pos << "fewer than K elements " << K << " for query";
+    }
+
+    return retval;
+}
 
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+size_t Index<T, TagT, LabelT>::copy_search_results(InMemQueryScratch<T> *scratch, const size_t K, IdType *indices,
+                                                   float *distances)
+{
     NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
 
     size_t pos = 0;
-    for (size_t i = 0; i < best_L_nodes.size(); ++i)
+    for (size_t i = 0; i < best_L_nodes.size() && pos < K; ++i)
     {
-        if (best_L_nodes[i].id < _max_points)
+        if (best_L_nodes[i].id < _max_points && !is_tombstone(best_L_nodes[i].id))
         {
             // safe because Index uses uint32_t ids internally
             // and IDType will be uint32_t or uint64_t
@@ -2007,127 +2643,656 @@ std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search(const T *query, con
             }
             pos++;
         }
-        if (pos == K)
-            break;
-    }
-    if (pos < K)
-    {
-        diskann::cerr << "Found pos: " << pos << "fewer than K elements " << K << " for query" << std::endl;
     }
-
-    return retval;
+    return pos;
 }
 
 template <typename T, typename TagT, typename LabelT>
-std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::_search_with_filters(const DataType &query,
-                                                                           const std::string &raw_label, const size_t K,
-                                                                           const uint32_t L, std::any &indices,
-                                                                           float *distances)
+void Index<T, TagT, LabelT>::iterate_to_fixed_point_interleaved(const std::vector<InMemQueryScratch<T> *> &scratches,
+                                                                const uint32_t Lsize,
+                                                                const std::vector<std::vector<uint32_t>> &init_ids)
 {
-    auto converted_label = this->get_converted_label(raw_label);
-    if (typeid(uint64_t *) == indices.type())
-    {
-        auto ptr = std::any_cast<uint64_t *>(indices);
-        return this->search_with_filters(std::any_cast<T *>(query), converted_label, K, L, ptr, distances);
+    const size_t num_queries = scratches.size();
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        InMemQueryScratch<T> *scratch = scratches[q];
+        NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+        best_L_nodes.reserve(Lsize);
+        VisitedSet &inserted_into_pool = scratch->inserted_into_pool();
+        inserted_into_pool.reserve(_max_points + _num_frozen_pts, (uint64_t)Lsize * scratch->get_R());
+        _pq_data_store->preprocess_query(scratch->aligned_query(), scratch);
+        for (auto id : init_ids[q])
+        {
+            if (id >= _max_points + _num_frozen_pts)
+                throw diskann::ANNException(std::string("Wrong loc") + std::to_string(id), -1, __FUNCSIG__,
+                                            __FILE__, __LINE__);
+            if (inserted_into_pool.insert(id))
+                best_L_nodes.insert(Neighbor(id, _pq_data_store->get_distance(scratch->aligned_query(), id)));
+        }
     }
-    else if (typeid(uint32_t *) == indices.type())
+
+    // Each query is a state machine that is advanced one step at a time, round
+    // robin. A step ends by prefetching what the next step of the query reads
+    // (the adjacency list of the node it picked, then the vectors of the new
+    // neighbours), so the load overlaps with the steps of the other queries.
+    enum class Step
     {
-        auto ptr = std::any_cast<uint32_t *>(indices);
-        return this->search_with_filters(std::any_cast<T *>(query), converted_label, K, L, ptr, distances);
-    }
-    else
+        select,
+        expand,
+        score
+    };
+    struct QueryState
     {
-        throw ANNException("Error: Id type can only be uint64_t or uint32_t.", -1);
+        size_t q;
+        Step step;
+        uint32_t node;
+        uint32_t hops;
+    };
+    std::vector<QueryState> active;
+    active.reserve(num_queries);
+    for (size_t q = 0; q < num_queries; q++)
+        active.push_back({q, Step::select, 0, 0});
+
+    std::vector<location_t> nbrs_copy;
+    while (!active.empty())
+    {
+        for (size_t a = 0; a < active.size();)
+        {
+            QueryState &state = active[a];
+            InMemQueryScratch<T> *scratch = scratches[state.q];
+            NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+            std::vector<uint32_t> &id_scratch = scratch->id_scratch();
+
+            if (state.step == Step::select)
+            {
+                if (!best_L_nodes.has_unexpanded_node())
+                {
+                    // done; the last query takes its place
+                    active[a] = active.back();
+                    active.pop_back();
+                    continue;
+                }
+                state.node = best_L_nodes.closest_unexpanded().id;
+                _graph_store->prefetch_neighbours(state.node);
+                state.step = Step::expand;
+            }
+            else if (state.step == Step::expand)
+            {
+                const bool skip_tombstones = _dynamic_index && state.hops >= _tombstone_hop_limit;
+                state.hops++;
+                get_lock(state.node).lock();
+                auto nbrs = _graph_store->get_neighbours(state.node);
+                nbrs_copy.assign(nbrs.begin(), nbrs.end());
+                get_lock(state.node).unlock();
+
+                VisitedSet &inserted_into_pool = scratch->inserted_into_pool();
+                id_scratch.clear();
+                for (auto id : nbrs_copy)
+                {
+                    if (skip_tombstones && is_tombstone(id))
+                        continue;
+                    if (inserted_into_pool.insert(id))
+                    {
+                        id_scratch.push_back(id);
+                        _pq_data_store->prefetch_vector(id);
+                    }
+                }
+                state.step = id_scratch.empty() ? Step::select : Step::score;
+            }
+            else
+            {
+                std::vector<float> &dist_scratch = scratch->dist_scratch();
+                _pq_data_store->get_distance(scratch->aligned_query(), id_scratch, dist_scratch, scratch);
+                for (size_t m = 0; m < id_scratch.size(); ++m)
+                    best_L_nodes.insert(Neighbor(id_scratch[m], dist_scratch[m]));
+                id_scratch.clear();
+                state.step = Step::select;
+            }
+            a++;
+        }
     }
+    for (auto scratch : scratches)
+        scratch->id_scratch().clear();
 }
 
 template <typename T, typename TagT, typename LabelT>
 template <typename IdType>
-std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const T *query, const LabelT &filter_label,
-                                                                          const size_t K, const uint32_t L,
-                                                                          IdType *indices, float *distances)
+void Index<T, TagT, LabelT>::batch_search(const T *queries, const size_t num_queries, const size_t query_stride,
+                                          const size_t K, const uint32_t L, IdType *indices, float *distances,
+                                          const uint32_t num_threads, const uint32_t interleave)
 {
     if (K > (uint64_t)L)
     {
         throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
+    const int num_search_threads = num_threads != 0 ? (int)num_threads : omp_get_num_procs();
 
-    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-    auto scratch = manager.scratch_space();
+    if (_opt_graph != nullptr)
+    {
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_search_threads)
+        for (int64_t i = 0; i < (int64_t)num_queries; i++)
+        {
+            search_with_optimized_layout(queries + i * query_stride, K, L, indices + i * K,
+                                         distances == nullptr ? nullptr : distances + i * K);
+        }
+        return;
+    }
 
-    if (L > scratch->get_L())
+    if (interleave <= 1)
     {
-        diskann::cout << "Attempting to expand query scratch_space. Was created "
-                      << "with Lsize: " << scratch->get_L() << " but search L is: " << L << std::endl;
-        scratch->resize_for_new_L(L);
-        diskann::cout << "Resize completed. New scratch->L is " << scratch->get_L() << std::endl;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_search_threads)
+        for (int64_t i = 0; i < (int64_t)num_queries; i++)
+        {
+            search(queries + i * query_stride, K, L, indices + i * K,
+                   distances == nullptr ? nullptr : distances + i * K);
+        }
+        return;
     }
 
-    std::vector<LabelT> filter_vec;
-    std::vector<uint32_t> init_ids = get_init_ids();
+    const int64_t num_groups = (int64_t)DIV_ROUND_UP(num_queries, (size_t)interleave);
+#pragma omp parallel num_threads(num_search_threads)
+    {
+        std::vector<std::unique_ptr<InMemQueryScratch<T>>> owned_scratches;
+        std::vector<InMemQueryScratch<T> *> group;
+        std::vector<std::vector<uint32_t>> init_ids;
+        for (uint32_t j = 0; j < interleave; j++)
+        {
+            owned_scratches.emplace_back(new InMemQueryScratch<T>(
+                L, _indexingQueueSize, _indexingRange, _indexingMaxC, _data_store->get_dims(),
+                _data_store->get_aligned_dim(), _data_store->get_alignment_factor(), _pq_dist));
+        }
 
-    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
-    std::shared_lock<std::shared_timed_mutex> tl(_tag_lock, std::defer_lock);
-    if (_dynamic_index)
-        tl.lock();
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t g = 0; g < num_groups; g++)
+        {
+            const size_t first = (size_t)g * interleave;
+            const size_t count = (std::min)((size_t)interleave, num_queries - first);
+            group.clear();
+            init_ids.resize(count);
 
-    if (_label_to_start_id.find(filter_label) != _label_to_start_id.end())
-    {
-        init_ids.emplace_back(_label_to_start_id[filter_label]);
+            std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+            for (size_t j = 0; j < count; j++)
+            {
+                InMemQueryScratch<T> *scratch = owned_scratches[j].get();
+                scratch->clear();
+                const T *query = queries + (first + j) * query_stride;
+                init_ids[j] = get_init_ids();
+                add_entry_layer_seeds(query, init_ids[j]);
+                _data_store->preprocess_query(query, scratch);
+                group.push_back(scratch);
+            }
+            iterate_to_fixed_point_interleaved(group, L, init_ids);
+            for (size_t j = 0; j < count; j++)
+            {
+                rerank_candidates(group[j], K);
+                copy_search_results(group[j], K, indices + (first + j) * K,
+                                    distances == nullptr ? nullptr : distances + (first + j) * K);
+            }
+        }
     }
-    else
+}
+
+template <typename T, typename TagT, typename LabelT> bool Index<T, TagT, LabelT>::load_to_gpu()
+{
+#ifndef USE_CUDA
+    return false;
+#else
+    if (_opt_graph != nullptr || _layout_only ||
+        (_dist_metric != diskann::Metric::L2 && _dist_metric != diskann::Metric::INNER_PRODUCT) ||
+        !math_utils::gpu::is_available())
     {
-        diskann::cout << "No filtered medoid found. exitting "
-                      << std::endl; // RKNOTE: If universal label found start there
-        throw diskann::ANNException("No filtered medoid found. exitting ", -1);
+        return false;
     }
-    if (_dynamic_index)
-        tl.unlock();
+    _gpu_searcher.reset();
 
-    filter_vec.emplace_back(filter_label);
+    // every location, so that ids need no mapping; empty slots have no edges
+    // in or out, and the frozen points and lazily deleted points are never
+    // returned
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    const size_t num_points = _max_points + _num_frozen_pts;
+    uint32_t max_degree = 1;
+    for (size_t loc = 0; loc < num_points; loc++)
+        max_degree = (std::max)(max_degree, (uint32_t)_graph_store->get_neighbours((location_t)loc).size());
+
+    std::vector<float> vectors(num_points * _dim);
+    std::vector<uint32_t> graph(num_points * max_degree, std::numeric_limits<uint32_t>::max());
+    std::vector<uint8_t> excluded(num_points, 0);
+#pragma omp parallel
+    {
+        std::vector<T> vec(_dim);
+#pragma omp for schedule(static, 8192)
+        for (int64_t loc = 0; loc < (int64_t)num_points; loc++)
+        {
+            _data_store->get_vector((location_t)loc, vec.data());
+            for (size_t j = 0; j < _dim; j++)
+                vectors[loc * _dim + j] = (float)vec[j];
+            const NeighbourList nbrs = _graph_store->get_neighbours((location_t)loc);
+            std::copy(nbrs.begin(), nbrs.end(), graph.begin() + loc * max_degree);
+            excluded[loc] = (size_t)loc >= _max_points || is_tombstone((uint32_t)loc);
+        }
+    }
 
-    _data_store->preprocess_query(query, scratch);
-    auto retval = iterate_to_fixed_point(scratch, L, init_ids, true, filter_vec, true);
+    _gpu_searcher = std::make_shared<GpuGraphSearcher>(vectors.data(), num_points, _dim, graph.data(), max_degree,
+                                                       get_init_ids(), excluded.data(),
+                                                       _dist_metric == diskann::Metric::INNER_PRODUCT);
+    return true;
+#endif
+}
 
-    auto best_L_nodes = scratch->best_l_nodes();
+template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::release_gpu()
+{
+    _gpu_searcher.reset();
+}
 
-    size_t pos = 0;
-    for (size_t i = 0; i < best_L_nodes.size(); ++i)
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+void Index<T, TagT, LabelT>::batch_search_on_gpu(const T *queries, const size_t num_queries,
+                                                 const size_t query_stride, const size_t K, const uint32_t L,
+                                                 IdType *indices, float *distances)
+{
+#ifdef USE_CUDA
+    std::shared_ptr<GpuGraphSearcher> searcher = _gpu_searcher;
+    if (searcher != nullptr)
     {
-        if (best_L_nodes[i].id < _max_points)
+        if (K > (uint64_t)L)
         {
-            indices[pos] = (IdType)best_L_nodes[i].id;
+            throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
 
-            if (distances != nullptr)
+        // the queries as floats and their results, a chunk at a time, which
+        // the searcher splits further into batches that fit the device
+        const size_t chunk = (std::min)(num_queries, (size_t)1 << 20);
+        std::vector<float> chunk_queries(chunk * _dim);
+        std::vector<uint32_t> chunk_ids(chunk * K);
+        std::vector<float> chunk_dists(chunk * K);
+        for (size_t start = 0; start < num_queries; start += chunk)
+        {
+            const size_t count = (std::min)(chunk, num_queries - start);
+#pragma omp parallel for schedule(static, 1024)
+            for (int64_t i = 0; i < (int64_t)count; i++)
             {
-#ifdef EXEC_ENV_OLS
-                // DLVS expects negative distances
-                distances[pos] = best_L_nodes[i].distance;
-#else
-                distances[pos] = _dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * best_L_nodes[i].distance
-                                                                                : best_L_nodes[i].distance;
-#endif
+                const T *query = queries + (start + i) * query_stride;
+                for (size_t j = 0; j < _dim; j++)
+                    chunk_queries[i * _dim + j] = (float)query[j];
+            }
+            searcher->search(chunk_queries.data(), count, K, L, chunk_ids.data(), chunk_dists.data());
+            for (size_t i = 0; i < count * K; i++)
+            {
+                indices[start * K + i] = chunk_ids[i] == std::numeric_limits<uint32_t>::max()
+                                             ? std::numeric_limits<IdType>::max()
+                                             : (IdType)chunk_ids[i];
+                if (distances != nullptr)
+                {
+                    distances[start * K + i] = _dist_metric == diskann::Metric::INNER_PRODUCT &&
+                                                       chunk_ids[i] != std::numeric_limits<uint32_t>::max()
+                                                   ? -chunk_dists[i]
+                                                   : chunk_dists[i];
+                }
             }
-            pos++;
         }
-        if (pos == K)
-            break;
-    }
-    if (pos < K)
-    {
-        diskann::cerr << "Found fewer than K elements for query" << std::endl;
+        return;
     }
+#endif
+    batch_search(queries, num_queries, query_stride, K, L, indices, distances);
+}
 
-    return retval;
+template <typename T, typename TagT, typename LabelT>
+std::unique_ptr<IndexSearchCursor<T>> Index<T, TagT, LabelT>::begin_paged_search(const T *query, const uint32_t L)
+{
+    std::unique_ptr<IndexSearchCursor<T>> cursor(new IndexSearchCursor<T>());
+    cursor->L = L;
+    cursor->scratch.reset(new InMemQueryScratch<T>(L, _indexingQueueSize, _indexingRange, _indexingMaxC,
+                                                   _data_store->get_dims(), _data_store->get_aligned_dim(),
+                                                   _data_store->get_alignment_factor(), _pq_dist));
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    cursor->init_ids = get_init_ids();
+    add_entry_layer_seeds(query, cursor->init_ids);
+    _data_store->preprocess_query(query, cursor->scratch.get());
+    return cursor;
 }
 
 template <typename T, typename TagT, typename LabelT>
-size_t Index<T, TagT, LabelT>::_search_with_tags(const DataType &query, const uint64_t K, const uint32_t L,
-                                                 const TagType &tags, float *distances, DataVector &res_vectors,
-                                                 bool use_filters, const std::string filter_label)
+size_t Index<T, TagT, LabelT>::next_page(IndexSearchCursor<T> &cursor, const size_t K, uint32_t *indices,
+                                         float *distances)
 {
-    try
-    {
+    InMemQueryScratch<T> *scratch = cursor.scratch.get();
+    const uint32_t L = (uint32_t)((std::max)((size_t)cursor.L, K) + cursor.returned.size());
+    scratch->grow_for_new_L(L);
+    scratch->id_scratch().clear();
+
+    const std::vector<LabelT> unused_filter_label;
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    iterate_to_fixed_point(scratch, L, cursor.init_ids, false, unused_filter_label, true);
+
+    // the list still holds the results of earlier pages
+    NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+    std::vector<Neighbor> &results = scratch->pool();
+    results.clear();
+    for (size_t i = 0; i < best_L_nodes.size(); ++i)
+    {
+        const uint32_t id = best_L_nodes[i].id;
+        if (id < _max_points && !is_tombstone(id) && cursor.returned.find(id) == cursor.returned.end())
+            results.push_back(best_L_nodes[i]);
+    }
+    if (_pq_dist && _quantized_rerank)
+    {
+        results.resize((std::min)(results.size(), _quantized_rerank_factor * K));
+        for (auto &result : results)
+            result.distance = _data_store->get_distance(scratch->aligned_query(), result.id);
+        std::sort(results.begin(), results.end());
+    }
+
+    const size_t num_results = (std::min)(results.size(), K);
+    for (size_t pos = 0; pos < num_results; pos++)
+    {
+        indices[pos] = results[pos].id;
+        cursor.returned.insert(results[pos].id);
+        if (distances != nullptr)
+        {
+#ifdef EXEC_ENV_OLS
+            distances[pos] = results[pos].distance;
+#else
+            distances[pos] =
+                _dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * results[pos].distance : results[pos].distance;
+#endif
+        }
+    }
+    results.clear();
+    return num_results;
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::range_search(const T *query, const float range, const uint32_t min_l_search,
+                                            const uint32_t max_l_search, const size_t max_results,
+                                            std::vector<uint32_t> &indices, std::vector<float> &distances,
+                                            std::vector<TagT> *tags, const LabelFilter<LabelT> *filter)
+{
+    if (tags != nullptr && !_enable_tags)
+    {
+        throw ANNException("Tags requested from an index without tags", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    const bool use_filter = filter != nullptr && !filter->empty();
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    std::vector<uint32_t> init_ids = get_init_ids();
+    if (use_filter)
+    {
+        std::shared_lock<std::shared_timed_mutex> tl(_tag_lock, std::defer_lock);
+        if (_dynamic_index)
+            tl.lock();
+        add_filter_start_points(*filter, init_ids);
+    }
+    else
+    {
+        add_entry_layer_seeds(query, init_ids);
+    }
+    _data_store->preprocess_query(query, scratch);
+
+    // the largest distance within range; inner products are negated
+    const float max_distance = _dist_metric == diskann::Metric::INNER_PRODUCT ? -range : range;
+    NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
+    uint32_t L = (std::max)(min_l_search, (uint32_t)1);
+    while (true)
+    {
+        // each round searches afresh, as every point of the last list was
+        // expanded already and a longer list would gain nothing from it
+        scratch->resize_for_new_L(L);
+        scratch->clear();
+        iterate_to_fixed_point(scratch, L, init_ids, use_filter, std::vector<LabelT>(), true,
+                               use_filter ? filter : nullptr);
+
+        // points beyond the list may be within range only if all of it is
+        if (best_L_nodes.size() < L || best_L_nodes[L - 1].distance > max_distance || L >= max_l_search)
+            break;
+        size_t num_points = 0;
+        for (size_t i = 0; i < best_L_nodes.size(); i++)
+        {
+            const uint32_t id = best_L_nodes[i].id;
+            if (id < _max_points && !is_tombstone(id))
+                num_points++;
+        }
+        if (num_points >= max_results)
+            break;
+        L = (uint32_t)(std::min)((uint64_t)L * 2, (uint64_t)max_l_search);
+    }
+
+    std::vector<Neighbor> &results = scratch->pool();
+    results.clear();
+    for (size_t i = 0; i < best_L_nodes.size(); i++)
+    {
+        Neighbor candidate = best_L_nodes[i];
+        if (candidate.id >= _max_points || is_tombstone(candidate.id) ||
+            (use_filter && !point_matches_filter(candidate.id, *filter)))
+            continue;
+        // the list holds the distances of the quantized vectors
+        if (_pq_dist)
+            candidate.distance = _data_store->get_distance(scratch->aligned_query(), candidate.id);
+        if (candidate.distance <= max_distance)
+            results.push_back(candidate);
+    }
+    if (_pq_dist)
+        std::sort(results.begin(), results.end());
+
+    indices.clear();
+    distances.clear();
+    if (tags != nullptr)
+        tags->clear();
+    for (size_t i = 0; i < results.size() && indices.size() < max_results; i++)
+    {
+        // _location_to_tag is read without _tag_lock, as in search_with_tags()
+        TagT tag;
+        if (tags != nullptr)
+        {
+            if (!_location_to_tag.try_get(results[i].id, tag))
+                continue;
+            tags->push_back(tag);
+        }
+        indices.push_back(results[i].id);
+#ifdef EXEC_ENV_OLS
+        distances.push_back(results[i].distance);
+#else
+        distances.push_back(_dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * results[i].distance
+                                                                            : results[i].distance);
+#endif
+    }
+    results.clear();
+    return indices.size();
+}
+
+template <typename T, typename TagT, typename LabelT>
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::_search_with_filters(const DataType &query,
+                                                                           const std::string &raw_label, const size_t K,
+                                                                           const uint32_t L, std::any &indices,
+                                                                           float *distances)
+{
+    if (is_label_filter_expression(raw_label))
+    {
+        const LabelFilter<LabelT> filter = get_converted_filter(raw_label);
+        if (typeid(uint64_t *) == indices.type())
+            return search_with_filters(std::any_cast<T *>(query), filter, K, L, std::any_cast<uint64_t *>(indices),
+                                       distances);
+        else if (typeid(uint32_t *) == indices.type())
+            return search_with_filters(std::any_cast<T *>(query), filter, K, L, std::any_cast<uint32_t *>(indices),
+                                       distances);
+        throw ANNException("Error: Id type can only be uint64_t or uint32_t.", -1);
+    }
+
+    auto converted_label = this->get_converted_label(raw_label);
+    if (typeid(uint64_t *) == indices.type())
+    {
+        auto ptr = std::any_cast<uint64_t *>(indices);
+        return this->search_with_filters(std::any_cast<T *>(query), converted_label, K, L, ptr, distances);
+    }
+    else if (typeid(uint32_t *) == indices.type())
+    {
+        auto ptr = std::any_cast<uint32_t *>(indices);
+        return this->search_with_filters(std::any_cast<T *>(query), converted_label, K, L, ptr, distances);
+    }
+    else
+    {
+        throw ANNException("Error: Id type can only be uint64_t or uint32_t.", -1);
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const T *query, const LabelT &filter_label,
+                                                                          const size_t K, const uint32_t L,
+                                                                          IdType *indices, float *distances)
+{
+    if (K > (uint64_t)L)
+    {
+        throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+
+    if (L > scratch->get_L())
+    {
+        DISKANN_LOG(Info) << "Expanding query scratch space from L " << scratch->get_L() << " to search L " << L;
+        scratch->grow_for_new_L(L);
+    }
+
+    std::vector<LabelT> filter_vec;
+    std::vector<uint32_t> init_ids = get_init_ids();
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    std::shared_lock<std::shared_timed_mutex> tl(_tag_lock, std::defer_lock);
+    if (_dynamic_index)
+        tl.lock();
+
+    if (_label_to_start_id.find(filter_label) != _label_to_start_id.end())
+    {
+        init_ids.emplace_back(_label_to_start_id[filter_label]);
+    }
+    else
+    {
+        diskann::cout << "No filtered medoid found. exitting "
+                      << std::endl; // RKNOTE: If universal label found start there
+        throw diskann::ANNException("No filtered medoid found. exitting ", -1);
+    }
+    if (_dynamic_index)
+        tl.unlock();
+
+    filter_vec.emplace_back(filter_label);
+
+    _data_store->preprocess_query(query, scratch);
+    auto retval = iterate_to_fixed_point(scratch, L, init_ids, true, filter_vec, true);
+    rerank_candidates(scratch, K);
+
+    auto best_L_nodes = scratch->best_l_nodes();
+
+    size_t pos = 0;
+    for (size_t i = 0; i < best_L_nodes.size(); ++i)
+    {
+        if (best_L_nodes[i].id < _max_points && !is_tombstone(best_L_nodes[i].id))
+        {
+            indices[pos] = (IdType)best_L_nodes[i].id;
+
+            if (distances != nullptr)
+            {
+#ifdef EXEC_ENV_OLS
+                // DLVS expects negative distances
+                distances[pos] = best_L_nodes[i].distance;
+#else
+                distances[pos] = _dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * best_L_nodes[i].distance
+                                                                                : best_L_nodes[i].distance;
+#endif
+            }
+            pos++;
+        }
+        if (pos == K)
+            break;
+    }
+    if (pos < K)
+    {
+        DISKANN_LOG_EVERY_MS(Warning, 1000) << "Found fewer than K elements for query";
+    }
+
+    return retval;
+}
+
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+std::pair<uint32_t, uint32_t> Index<T, TagT, LabelT>::search_with_filters(const T *query,
+                                                                          const LabelFilter<LabelT> &filter,
+                                                                          const size_t K, const uint32_t L,
+                                                                          IdType *indices, float *distances)
+{
+    if (K > (uint64_t)L)
+    {
+        throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+
+    if (L > scratch->get_L())
+    {
+        DISKANN_LOG(Info) << "Expanding query scratch space from L " << scratch->get_L() << " to search L " << L;
+        scratch->grow_for_new_L(L);
+    }
+
+    std::vector<uint32_t> init_ids = get_init_ids();
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    std::shared_lock<std::shared_timed_mutex> tl(_tag_lock, std::defer_lock);
+    if (_dynamic_index)
+        tl.lock();
+
+    add_filter_start_points(filter, init_ids);
+    if (_dynamic_index)
+        tl.unlock();
+
+    _data_store->preprocess_query(query, scratch);
+    auto retval = iterate_to_fixed_point(scratch, L, init_ids, !filter.empty(), std::vector<LabelT>(), true, &filter);
+    rerank_candidates(scratch, K);
+
+    auto best_L_nodes = scratch->best_l_nodes();
+
+    size_t pos = 0;
+    for (size_t i = 0; i < best_L_nodes.size(); ++i)
+    {
+        const uint32_t id = best_L_nodes[i].id;
+        if (id < _max_points && !is_tombstone(id) && point_matches_filter(id, filter))
+        {
+            indices[pos] = (IdType)id;
+
+            if (distances != nullptr)
+            {
+#ifdef EXEC_ENV_OLS
+                // DLVS expects negative distances
+                distances[pos] = best_L_nodes[i].distance;
+#else
+                distances[pos] = _dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * best_L_nodes[i].distance
+                                                                                : best_L_nodes[i].distance;
+#endif
+            }
+            pos++;
+        }
+        if (pos == K)
+            break;
+    }
+    if (pos < K)
+    {
+        DISKANN_LOG_EVERY_MS(Warning, 1000) << "Found fewer than K elements for query";
+    }
+
+    return retval;
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::_search_with_tags(const DataType &query, const uint64_t K, const uint32_t L,
+                                                 const TagType &tags, float *distances, DataVector &res_vectors,
+                                                 bool use_filters, const std::string filter_label)
+{
+    try
+    {
         return this->search_with_tags(std::any_cast<const T *>(query), K, L, std::any_cast<TagT *>(tags), distances,
                                       res_vectors.get<std::vector<T *>>(), use_filters, filter_label);
     }
@@ -2155,10 +3320,8 @@ size_t Index<T, TagT, LabelT>::search_with_tags(const T *query, const uint64_t K
 
     if (L > scratch->get_L())
     {
-        diskann::cout << "Attempting to expand query scratch_space. Was created "
-                      << "with Lsize: " << scratch->get_L() << " but search L is: " << L << std::endl;
-        scratch->resize_for_new_L(L);
-        diskann::cout << "Resize completed. New scratch->L is " << scratch->get_L() << std::endl;
+        DISKANN_LOG(Info) << "Expanding query scratch space from L " << scratch->get_L() << " to search L " << L;
+        scratch->grow_for_new_L(L);
     }
 
     std::shared_lock<std::shared_timed_mutex> ul(_update_lock);
@@ -2171,7 +3334,9 @@ size_t Index<T, TagT, LabelT>::search_with_tags(const T *query, const uint64_t K
     if (!use_filters)
     {
         const std::vector<LabelT> unused_filter_label;
-        iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true);
+        SearchBudget budget;
+        iterate_to_fixed_point(scratch, L, init_ids, false, unused_filter_label, true, nullptr,
+                               search_budget_for(L, K, budget));
     }
     else
     {
@@ -2180,16 +3345,19 @@ size_t Index<T, TagT, LabelT>::search_with_tags(const T *query, const uint64_t K
         filter_vec.push_back(converted_label);
         iterate_to_fixed_point(scratch, L, init_ids, true, filter_vec, true);
     }
+    rerank_candidates(scratch, K);
 
     NeighborPriorityQueue &best_L_nodes = scratch->best_l_nodes();
     assert(best_L_nodes.size() <= L);
 
-    std::shared_lock<std::shared_timed_mutex> tl(_tag_lock);
-
+    // _location_to_tag is read without _tag_lock, so that resolving tags does
+    // not wait for inserts and deletes
     size_t pos = 0;
     for (size_t i = 0; i < best_L_nodes.size(); ++i)
     {
         auto node = best_L_nodes[i];
+        if (is_tombstone(node.id))
+            continue;
 
         TagT tag;
         if (_location_to_tag.try_get(node.id, tag))
@@ -2231,6 +3399,62 @@ template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, Labe
     return _max_points;
 }
 
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::get_neighbours(const uint32_t location, std::vector<uint32_t> &neighbours)
+{
+    LockGuard guard(get_lock(location));
+    const auto list = _graph_store->get_neighbours(location);
+    neighbours.assign(list.begin(), list.end());
+}
+
+template <typename T, typename TagT, typename LabelT> uint32_t Index<T, TagT, LabelT>::get_start_point()
+{
+    return _start;
+}
+
+template <typename T, typename TagT, typename LabelT> MemoryUsage Index<T, TagT, LabelT>::get_memory_usage()
+{
+    MemoryUsage usage;
+    // searches take their scratch before _update_lock, so measure it first
+    usage.add("scratch", _query_scratch.memory_size());
+
+    std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+    usage.add("data", _data_store->memory_size());
+    usage.add("graph", _graph_store->memory_size());
+    if (_pq_data_store != nullptr && _pq_data_store != _data_store)
+        usage.add("pq_data", _pq_data_store->memory_size());
+    usage.add("pq_table", _pq_table.memory_size());
+    // a mapped layout counts as well, as searches touch all of it
+    usage.add("optimized_layout", _opt_graph_mapping != nullptr ? _opt_num_nodes * _node_size : _opt_graph_buffer.len);
+    usage.add("locks", vector_bytes(_locks));
+
+    // a sparse_map keeps its values packed, with a bitmap and a pointer per
+    // group of 64 buckets
+    usage.add("tags", (uint64_t)_tag_to_location.size() * sizeof(std::pair<TagT, uint32_t>) +
+                          (uint64_t)_tag_to_location.bucket_count() / 4 + _location_to_tag.memory_size());
+
+    uint64_t label_bytes = vector_bytes(_location_to_labels) + _label_bitmap.memory_size() +
+                           node_hash_table_bytes(_label_counts) + hash_table_bytes(_labels) +
+                           node_hash_table_bytes(_label_to_start_id) + node_hash_table_bytes(_medoid_counts) +
+                           node_hash_table_bytes(_label_map);
+    for (const auto &labels : _location_to_labels)
+        label_bytes += vector_bytes(labels);
+    usage.add("labels", label_bytes);
+
+    uint64_t delete_bytes = _empty_slots.memory_size();
+    if (_delete_set != nullptr)
+        delete_bytes += hash_table_bytes(*_delete_set);
+    if (_consolidating_set != nullptr)
+        delete_bytes += hash_table_bytes(*_consolidating_set);
+    if (_tombstones != nullptr)
+        delete_bytes += DIV_ROUND_UP(_max_points + _num_frozen_pts, 64) * sizeof(uint64_t);
+    usage.add("deletes", delete_bytes);
+
+    if (_entry_layer != nullptr)
+        usage.add("entry_layer", _entry_layer->get_memory_usage().total() + vector_bytes(_entry_layer_locations));
+    return usage;
+}
+
 template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::generate_frozen_point()
 {
     if (_num_frozen_pts == 0)
@@ -2258,7 +3482,7 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         //       _num_pq_chunks * DIV_ROUND_UP(NUM_PQ_BITS, 8));
         _pq_data_store->copy_vectors((location_t)res, (location_t)_max_points, 1);
     }
-    else
+    if (!_pq_dist || has_navigation_store())
     {
         _data_store->copy_vectors((location_t)res, (location_t)_max_points, 1);
     }
@@ -2295,6 +3519,22 @@ template <typename T, typename TagT, typename LabelT> int Index<T, TagT, LabelT>
     return 0;
 }
 
+template <typename T, typename TagT, typename LabelT>
+bool Index<T, TagT, LabelT>::has_deleted_neighbour(const uint32_t loc)
+{
+    // the deleted points keep their tombstones until released, after the
+    // repair, so checking them is as good as looking each up in the delete set
+    std::unique_lock<non_recursive_mutex> adj_list_lock;
+    if (_conc_consolidate)
+        adj_list_lock = std::unique_lock<non_recursive_mutex>(get_lock(loc));
+    for (auto ngh : _graph_store->get_neighbours((location_t)loc))
+    {
+        if (is_tombstone(ngh))
+            return true;
+    }
+    return false;
+}
+
 template <typename T, typename TagT, typename LabelT>
 inline void Index<T, TagT, LabelT>::process_delete(const tsl::robin_set<uint32_t> &old_delete_set, size_t loc,
                                                    const uint32_t range, const uint32_t maxc, const float alpha,
@@ -2311,8 +3551,9 @@ inline void Index<T, TagT, LabelT>::process_delete(const tsl::robin_set<uint32_t
         // Acquire and release lock[loc] before acquiring locks for neighbors
         std::unique_lock<non_recursive_mutex> adj_list_lock;
         if (_conc_consolidate)
-            adj_list_lock = std::unique_lock<non_recursive_mutex>(_locks[loc]);
-        adj_list = _graph_store->get_neighbours((location_t)loc);
+            adj_list_lock = std::unique_lock<non_recursive_mutex>(get_lock(loc));
+        auto nbrs = _graph_store->get_neighbours((location_t)loc);
+        adj_list.assign(nbrs.begin(), nbrs.end());
     }
 
     bool modify = false;
@@ -2328,7 +3569,7 @@ inline void Index<T, TagT, LabelT>::process_delete(const tsl::robin_set<uint32_t
 
             std::unique_lock<non_recursive_mutex> ngh_lock;
             if (_conc_consolidate)
-                ngh_lock = std::unique_lock<non_recursive_mutex>(_locks[ngh]);
+                ngh_lock = std::unique_lock<non_recursive_mutex>(get_lock(ngh));
             for (auto j : _graph_store->get_neighbours((location_t)ngh))
                 if (j != loc && old_delete_set.find(j) == old_delete_set.end())
                     expanded_nodes_set.insert(j);
@@ -2339,7 +3580,7 @@ inline void Index<T, TagT, LabelT>::process_delete(const tsl::robin_set<uint32_t
     {
         if (expanded_nodes_set.size() <= range)
         {
-            std::unique_lock<non_recursive_mutex> adj_list_lock(_locks[loc]);
+            std::unique_lock<non_recursive_mutex> adj_list_lock(get_lock(loc));
             _graph_store->clear_neighbours((location_t)loc);
             for (auto &ngh : expanded_nodes_set)
                 _graph_store->add_neighbour((location_t)loc, ngh);
@@ -2356,7 +3597,7 @@ inline void Index<T, TagT, LabelT>::process_delete(const tsl::robin_set<uint32_t
             std::vector<uint32_t> &occlude_list_output = scratch->occlude_list_output();
             occlude_list((uint32_t)loc, expanded_nghrs_vec, alpha, range, maxc, occlude_list_output, scratch,
                          &old_delete_set);
-            std::unique_lock<non_recursive_mutex> adj_list_lock(_locks[loc]);
+            std::unique_lock<non_recursive_mutex> adj_list_lock(get_lock(loc));
             _graph_store->set_neighbours((location_t)loc, occlude_list_output);
         }
     }
@@ -2406,17 +3647,116 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
         return consolidation_report(diskann::consolidation_report::status_code::LOCK_FAIL, 0, 0, 0, 0, 0, 0, 0);
     }
 
+    if (_consolidating_set != nullptr)
+    {
+        diskann::cerr << "consolidate_deletes called while an incremental consolidation is in progress; finish it "
+                         "with consolidate_deletes_slice"
+                      << std::endl;
+        return consolidation_report(diskann::consolidation_report::status_code::FAIL, 0, 0, 0, 0, 0, 0, 0);
+    }
+
     diskann::cout << "Starting consolidate_deletes... ";
 
-    std::unique_ptr<tsl::robin_set<uint32_t>> old_delete_set(new tsl::robin_set<uint32_t>);
+    std::unique_ptr<tsl::robin_set<uint32_t>> old_delete_set(new tsl::robin_set<uint32_t>);
+    {
+        std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+        std::swap(_delete_set, old_delete_set);
+    }
+
+    if (old_delete_set->find(_start) != old_delete_set->end())
+    {
+        throw diskann::ANNException("ERROR: start node has been deleted", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    const uint32_t range = params.max_degree;
+    const uint32_t maxc = params.max_occlusion_size;
+    const float alpha = params.alpha;
+    const uint32_t num_threads = params.num_threads == 0 ? omp_get_num_procs() : params.num_threads;
+
+    std::atomic<uint32_t> num_calls_to_process_delete(0);
+    diskann::Timer timer;
+    auto repair_locations = [&](uint64_t begin, uint64_t end) {
+        uint32_t num_calls = 0;
+        for (int64_t loc = (int64_t)begin; loc < (int64_t)end; loc++)
+        {
+            if (old_delete_set->find((uint32_t)loc) == old_delete_set->end() &&
+                !_empty_slots.is_in_set((uint32_t)loc) && has_deleted_neighbour((uint32_t)loc))
+            {
+                ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+                auto scratch = manager.scratch_space();
+                process_delete(*old_delete_set, loc, range, maxc, alpha, scratch);
+                num_calls += 1;
+            }
+        }
+        num_calls_to_process_delete += num_calls;
+    };
+    get_executor()->parallel_for(_max_points, 8192, repair_locations, num_threads);
+    for (int64_t loc = _max_points; loc < (int64_t)(_max_points + _num_frozen_pts); loc++)
+    {
+        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+        auto scratch = manager.scratch_space();
+        process_delete(*old_delete_set, loc, range, maxc, alpha, scratch);
+        num_calls_to_process_delete += 1;
+    }
+
+    std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+    size_t ret_nd = release_locations(*old_delete_set);
+    size_t max_points = _max_points;
+    size_t empty_slots_size = _empty_slots.size();
+
+    std::shared_lock<std::shared_timed_mutex> dl(_delete_lock);
+    size_t delete_set_size = _delete_set->size();
+    size_t old_delete_set_size = old_delete_set->size();
+
+    if (!_conc_consolidate)
+    {
+        update_lock.unlock();
+    }
+
+    double duration = timer.elapsed() / 1000000.0;
+    diskann::cout << " done in " << duration << " seconds." << std::endl;
+    return consolidation_report(diskann::consolidation_report::status_code::SUCCESS, ret_nd, max_points,
+                                empty_slots_size, old_delete_set_size, delete_set_size, num_calls_to_process_delete,
+                                duration);
+}
+
+template <typename T, typename TagT, typename LabelT>
+consolidation_report Index<T, TagT, LabelT>::consolidate_deletes_slice(const IndexWriteParameters &params,
+                                                                       const size_t max_locations)
+{
+    if (!_enable_tags)
+        throw diskann::ANNException("Point tag array not instantiated", -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (!_conc_consolidate)
+        throw diskann::ANNException("Incremental consolidation needs an index with concurrent_consolidate set", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+
+    std::unique_lock<std::shared_timed_mutex> cl(_consolidate_lock, std::defer_lock);
+    if (!cl.try_lock())
+    {
+        diskann::cerr << "Consildate delete function failed to acquire consolidate lock" << std::endl;
+        return consolidation_report(diskann::consolidation_report::status_code::LOCK_FAIL, 0, 0, 0, 0, 0, 0, 0);
+    }
+
+    diskann::Timer timer;
+    if (_consolidating_set == nullptr)
     {
-        std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
-        std::swap(_delete_set, old_delete_set);
+        _consolidating_set.reset(new tsl::robin_set<uint32_t>);
+        {
+            std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+            std::swap(_delete_set, _consolidating_set);
+        }
+        if (_consolidating_set->find(_start) != _consolidating_set->end())
+        {
+            throw diskann::ANNException("ERROR: start node has been deleted", -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        _consolidate_cursor = 0;
+        _consolidate_max_points = _max_points;
     }
-
-    if (old_delete_set->find(_start) != old_delete_set->end())
+    else if (_consolidate_max_points != _max_points)
     {
-        throw diskann::ANNException("ERROR: start node has been deleted", -1, __FUNCSIG__, __FILE__, __LINE__);
+        // resize() moved the frozen points, so start over; repairing a list twice is harmless
+        _consolidate_cursor = 0;
+        _consolidate_max_points = _max_points;
     }
 
     const uint32_t range = params.max_degree;
@@ -2424,46 +3764,51 @@ consolidation_report Index<T, TagT, LabelT>::consolidate_deletes(const IndexWrit
     const float alpha = params.alpha;
     const uint32_t num_threads = params.num_threads == 0 ? omp_get_num_procs() : params.num_threads;
 
-    uint32_t num_calls_to_process_delete = 0;
-    diskann::Timer timer;
-#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 8192) reduction(+ : num_calls_to_process_delete)
-    for (int64_t loc = 0; loc < (int64_t)_max_points; loc++)
-    {
-        if (old_delete_set->find((uint32_t)loc) == old_delete_set->end() && !_empty_slots.is_in_set((uint32_t)loc))
+    const size_t total_locations = _max_points + _num_frozen_pts;
+    const size_t slice_start = _consolidate_cursor;
+    const size_t slice_end = std::min(total_locations, slice_start + std::max(max_locations, (size_t)1));
+    const tsl::robin_set<uint32_t> &old_delete_set = *_consolidating_set;
+
+    std::atomic<uint32_t> num_calls_to_process_delete(0);
+    auto repair_locations = [&](uint64_t begin, uint64_t end) {
+        uint32_t num_calls = 0;
+        for (int64_t loc = (int64_t)(slice_start + begin); loc < (int64_t)(slice_start + end); loc++)
         {
+            if (loc < (int64_t)_max_points && (old_delete_set.find((uint32_t)loc) != old_delete_set.end() ||
+                                               _empty_slots.is_in_set((uint32_t)loc)))
+                continue;
+
             ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
             auto scratch = manager.scratch_space();
-            process_delete(*old_delete_set, loc, range, maxc, alpha, scratch);
-            num_calls_to_process_delete += 1;
+            process_delete(old_delete_set, loc, range, maxc, alpha, scratch);
+            num_calls += 1;
         }
-    }
-    for (int64_t loc = _max_points; loc < (int64_t)(_max_points + _num_frozen_pts); loc++)
-    {
-        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-        auto scratch = manager.scratch_space();
-        process_delete(*old_delete_set, loc, range, maxc, alpha, scratch);
-        num_calls_to_process_delete += 1;
-    }
+        num_calls_to_process_delete += num_calls;
+    };
+    get_executor()->parallel_for(slice_end - slice_start, 256, repair_locations, num_threads);
+    _consolidate_cursor = slice_end;
 
+    auto status = diskann::consolidation_report::status_code::IN_PROGRESS;
+    size_t slots_released = 0;
     std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
-    size_t ret_nd = release_locations(*old_delete_set);
+    if (slice_end == total_locations)
+    {
+        release_locations(old_delete_set);
+        slots_released = old_delete_set.size();
+        _consolidating_set.reset();
+        _consolidate_cursor = 0;
+        status = diskann::consolidation_report::status_code::SUCCESS;
+    }
+    size_t ret_nd = _nd;
     size_t max_points = _max_points;
     size_t empty_slots_size = _empty_slots.size();
 
     std::shared_lock<std::shared_timed_mutex> dl(_delete_lock);
     size_t delete_set_size = _delete_set->size();
-    size_t old_delete_set_size = old_delete_set->size();
-
-    if (!_conc_consolidate)
-    {
-        update_lock.unlock();
-    }
 
     double duration = timer.elapsed() / 1000000.0;
-    diskann::cout << " done in " << duration << " seconds." << std::endl;
-    return consolidation_report(diskann::consolidation_report::status_code::SUCCESS, ret_nd, max_points,
-                                empty_slots_size, old_delete_set_size, delete_set_size, num_calls_to_process_delete,
-                                duration);
+    return consolidation_report(status, ret_nd, max_points, empty_slots_size, slots_released, delete_set_size,
+                                num_calls_to_process_delete, duration, total_locations - slice_end);
 }
 
 template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::compact_frozen_point()
@@ -2498,6 +3843,12 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         return;
     }
 
+    if (_consolidating_set != nullptr)
+    {
+        throw ANNException("Can not compact data while an incremental consolidation is in progress", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    }
+
     if (_delete_set->size() > 0)
     {
         throw ANNException("Can not compact data when index has non-empty _delete_set of "
@@ -2508,23 +3859,37 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
 
     diskann::Timer timer;
 
-    std::vector<uint32_t> new_location = std::vector<uint32_t>(_max_points + _num_frozen_pts, UINT32_MAX);
-
-    uint32_t new_counter = 0;
-    std::set<uint32_t> empty_locations;
-    for (uint32_t old_location = 0; old_location < _max_points; old_location++)
-    {
-        if (_location_to_tag.contains(old_location))
+    const uint32_t total_points = (uint32_t)(_max_points + _num_frozen_pts);
+    std::vector<uint32_t> new_location = std::vector<uint32_t>(total_points, UINT32_MAX);
+
+    // The points with tags keep their order. Each block of locations counts
+    // its points, and the sums of the counts of the blocks before it number
+    // them.
+    const uint32_t block_size = 1 << 16;
+    const int64_t num_blocks = (int64_t)((_max_points + block_size - 1) / block_size);
+    std::vector<uint32_t> block_start(num_blocks + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int64_t b = 0; b < num_blocks; b++)
+    {
+        const uint32_t block_end = (uint32_t)std::min<size_t>((size_t)(b + 1) * block_size, _max_points);
+        uint32_t count = 0;
+        for (uint32_t old_location = (uint32_t)b * block_size; old_location < block_end; old_location++)
+            count += _location_to_tag.contains(old_location) ? 1 : 0;
+        block_start[b + 1] = count;
+    }
+    std::partial_sum(block_start.begin(), block_start.end(), block_start.begin());
+#pragma omp parallel for schedule(static)
+    for (int64_t b = 0; b < num_blocks; b++)
+    {
+        const uint32_t block_end = (uint32_t)std::min<size_t>((size_t)(b + 1) * block_size, _max_points);
+        uint32_t new_counter = block_start[b];
+        for (uint32_t old_location = (uint32_t)b * block_size; old_location < block_end; old_location++)
         {
-            new_location[old_location] = new_counter;
-            new_counter++;
-        }
-        else
-        {
-            empty_locations.insert(old_location);
+            if (_location_to_tag.contains(old_location))
+                new_location[old_location] = new_counter++;
         }
     }
-    for (uint32_t old_location = (uint32_t)_max_points; old_location < _max_points + _num_frozen_pts; old_location++)
+    for (uint32_t old_location = (uint32_t)_max_points; old_location < total_points; old_location++)
     {
         new_location[old_location] = old_location;
     }
@@ -2535,77 +3900,85 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         throw diskann::ANNException("ERROR: Start node deleted.", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
 
+    // Rewrite the lists of the points that stay, frozen ones included, in
+    // place and in parallel
     size_t num_dangling = 0;
-    for (uint32_t old = 0; old < _max_points + _num_frozen_pts; ++old)
+#pragma omp parallel for schedule(dynamic, 2048) reduction(+ : num_dangling)
+    for (int64_t old = 0; old < (int64_t)total_points; old++)
     {
-        // compact _final_graph
-        std::vector<uint32_t> new_adj_list;
+        if (new_location[old] == UINT32_MAX)
+        {
+            _graph_store->clear_neighbours((location_t)old);
+            continue;
+        }
 
-        if ((new_location[old] < _max_points) // If point continues to exist
-            || (old >= _max_points && old < _max_points + _num_frozen_pts))
+        std::vector<uint32_t> new_adj_list;
+        new_adj_list.reserve(_graph_store->get_neighbours((location_t)old).size());
+        for (auto ngh_iter : _graph_store->get_neighbours((location_t)old))
         {
-            new_adj_list.reserve(_graph_store->get_neighbours((location_t)old).size());
-            for (auto ngh_iter : _graph_store->get_neighbours((location_t)old))
+            if (new_location[ngh_iter] == UINT32_MAX)
             {
-                if (empty_locations.find(ngh_iter) != empty_locations.end())
-                {
-                    ++num_dangling;
-                    diskann::cerr << "Error in compact_data(). _final_graph[" << old << "] has neighbor " << ngh_iter
-                                  << " which is a location not associated with any tag." << std::endl;
-                }
-                else
-                {
-                    new_adj_list.push_back(new_location[ngh_iter]);
-                }
+                ++num_dangling;
+#pragma omp critical
+                diskann::cerr << "Error in compact_data(). _final_graph[" << old << "] has neighbor " << ngh_iter
+                              << " which is a location not associated with any tag." << std::endl;
             }
-            //_graph_store->get_neighbours((location_t)old).swap(new_adj_list);
-            _graph_store->set_neighbours((location_t)old, new_adj_list);
-
-            // Move the data and adj list to the correct position
-            if (new_location[old] != old)
+            else
             {
-                assert(new_location[old] < old);
-                _graph_store->swap_neighbours(new_location[old], (location_t)old);
-
-                if (_filtered_index)
-                {
-                    _location_to_labels[new_location[old]].swap(_location_to_labels[old]);
-                }
-
-                _data_store->copy_vectors(old, new_location[old], 1);
+                new_adj_list.push_back(new_location[ngh_iter]);
             }
         }
-        else
-        {
-            _graph_store->clear_neighbours((location_t)old);
-        }
+        _graph_store->set_neighbours((location_t)old, new_adj_list);
     }
     diskann::cerr << "#dangling references after data compaction: " << num_dangling << std::endl;
 
-    _tag_to_location.clear();
-    for (auto pos = _location_to_tag.find_first(); pos.is_valid(); pos = _location_to_tag.find_next(pos))
+    // Move the points down in ascending order, so that every slot is vacated
+    // before it is written, with one copy per run of consecutive points
+    for (uint32_t old = 0; old < _max_points;)
     {
-        const auto tag = _location_to_tag.get(pos);
-        _tag_to_location[tag] = new_location[pos._key];
+        if (new_location[old] == UINT32_MAX || new_location[old] == old)
+        {
+            old++;
+            continue;
+        }
+        uint32_t run_end = old + 1;
+        while (run_end < _max_points && new_location[run_end] == new_location[old] + (run_end - old))
+            run_end++;
+
+        _data_store->copy_vectors(old, new_location[old], run_end - old);
+        for (uint32_t moved = old; moved < run_end; moved++)
+        {
+            assert(new_location[moved] < moved);
+            _graph_store->swap_neighbours(new_location[moved], (location_t)moved);
+            if (_filtered_index)
+            {
+                _location_to_labels[new_location[moved]].swap(_location_to_labels[moved]);
+            }
+        }
+        old = run_end;
     }
-    _location_to_tag.clear();
-    for (const auto &iter : _tag_to_location)
+
+    // Ascending order again frees every slot of _location_to_tag before it is
+    // set; the tags keep their entries in _tag_to_location
+    for (uint32_t old = 0; old < _max_points; old++)
     {
-        _location_to_tag.set(iter.second, iter.first);
+        TagT tag;
+        if (new_location[old] == old || !_location_to_tag.try_get(old, tag))
+            continue;
+        _location_to_tag.erase(old);
+        _location_to_tag.set(new_location[old], tag);
+        _tag_to_location[tag] = new_location[old];
     }
     // remove all cleared up old
-    for (size_t old = _nd; old < _max_points; ++old)
+#pragma omp parallel for schedule(static)
+    for (int64_t old = (int64_t)_nd; old < (int64_t)_max_points; ++old)
     {
         _graph_store->clear_neighbours((location_t)old);
-    }
-    if (_filtered_index)
-    {
-        for (size_t old = _nd; old < _max_points; old++)
+        if (_filtered_index)
         {
             _location_to_labels[old].clear();
         }
     }
-
     _empty_slots.clear();
     // mark all slots after _nd as empty
     for (auto i = _nd; i < _max_points; i++)
@@ -2613,6 +3986,7 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         _empty_slots.insert((uint32_t)i);
     }
     _data_compacted = true;
+    reset_tombstones();
     diskann::cout << "Time taken for compact_data: " << timer.elapsed() / 1000000. << "s." << std::endl;
 }
 
@@ -2641,11 +4015,280 @@ template <typename T, typename TagT, typename LabelT> int Index<T, TagT, LabelT>
 
         location = _empty_slots.pop_any();
         _delete_set->erase(location);
+        set_tombstone(location, false);
     }
     ++_nd;
     return location;
 }
 
+template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::reset_tombstones()
+{
+    const size_t num_words = DIV_ROUND_UP(_max_points + _num_frozen_pts, 64);
+    _tombstones.reset(new std::atomic<uint64_t>[num_words]);
+    for (size_t i = 0; i < num_words; i++)
+        _tombstones[i].store(0, std::memory_order_relaxed);
+
+    for (auto location : *_delete_set)
+        set_tombstone(location, true);
+    if (_consolidating_set != nullptr)
+    {
+        for (auto location : *_consolidating_set)
+            set_tombstone(location, true);
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::set_tombstone_hop_limit(const uint32_t hop_limit)
+{
+    _tombstone_hop_limit = hop_limit;
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::knn_self_join(const size_t K, const uint32_t L, uint32_t *knn_ids, float *knn_dists)
+{
+    if (K == 0 || K >= L)
+        throw ANNException("Set L to more than K, and K to at least 1", -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (_opt_graph != nullptr)
+        throw ANNException("No self-join of an index with the optimized layout", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+
+    std::shared_lock<std::shared_timed_mutex> ul(_update_lock);
+    std::shared_lock<std::shared_timed_mutex> dl(_delete_lock);
+    if (!_data_compacted)
+        throw ANNException("Consolidate the deletes and compact the index before a self-join", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+
+    // the points in breadth-first order from the start points, then any
+    // that the graph does not reach
+    const size_t num_points = _nd;
+    std::vector<uint32_t> order;
+    order.reserve(num_points);
+    boost::dynamic_bitset<> visited(_max_points + _num_frozen_pts);
+    std::vector<uint32_t> frontier = get_init_ids();
+    for (const uint32_t loc : frontier)
+        visited.set(loc);
+    while (!frontier.empty())
+    {
+        std::vector<uint32_t> next;
+        for (const uint32_t loc : frontier)
+        {
+            if (loc < num_points)
+                order.push_back(loc);
+            for (const auto nbr : _graph_store->get_neighbours((location_t)loc))
+            {
+                if (!visited.test(nbr))
+                {
+                    visited.set(nbr);
+                    next.push_back(nbr);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+    for (uint32_t loc = 0; loc < num_points; loc++)
+    {
+        if (!visited.test(loc))
+            order.push_back(loc);
+    }
+
+    const std::vector<LabelT> unused_filter_label;
+    const size_t num_results = K + 1;
+#pragma omp parallel
+    {
+        ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+        auto scratch = manager.scratch_space();
+        if (L > scratch->get_L())
+            scratch->grow_for_new_L(L);
+        std::vector<T> point(_dim);
+        std::vector<uint32_t> ids(num_results);
+        std::vector<float> dists(num_results);
+
+#pragma omp for schedule(dynamic, 64)
+        for (int64_t i = 0; i < (int64_t)order.size(); i++)
+        {
+            const uint32_t loc = order[i];
+            _data_store->get_vector(loc, point.data());
+            _data_store->preprocess_query(point.data(), scratch);
+            iterate_to_fixed_point(scratch, L, std::vector<uint32_t>{loc}, false, unused_filter_label, true);
+            rerank_candidates(scratch, num_results);
+            const size_t found = copy_search_results(scratch, num_results, ids.data(), dists.data());
+            scratch->clear();
+
+            uint32_t *row_ids = knn_ids + (size_t)loc * K;
+            float *row_dists = knn_dists + (size_t)loc * K;
+            size_t pos = 0;
+            for (size_t j = 0; j < found && pos < K; j++)
+            {
+                if (ids[j] == loc)
+                    continue;
+                row_ids[pos] = ids[j];
+                row_dists[pos] = dists[j];
+                pos++;
+            }
+            for (; pos < K; pos++)
+            {
+                row_ids[pos] = std::numeric_limits<uint32_t>::max();
+                row_dists[pos] = std::numeric_limits<float>::max();
+            }
+        }
+    }
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::set_search_budget_model(const SearchBudgetModel *model)
+{
+    _search_budget_model.reset(model != nullptr ? new SearchBudgetModel(*model) : nullptr);
+}
+
+template <typename T, typename TagT, typename LabelT>
+SearchBudget *Index<T, TagT, LabelT>::search_budget_for(const uint32_t L, const size_t K, SearchBudget &budget)
+{
+    if (_search_budget_model == nullptr || _search_budget_model->L != L || _search_budget_model->K != K)
+        return nullptr;
+    budget = SearchBudget(_search_budget_model.get());
+    return &budget;
+}
+
+template <typename T, typename TagT, typename LabelT>
+SearchBudgetModel Index<T, TagT, LabelT>::train_search_budget_model(const T *queries, const size_t num_queries,
+                                                                    const size_t query_stride, const uint32_t *gt,
+                                                                    const size_t gt_dim, const size_t K,
+                                                                    const uint32_t L, const float target_recall,
+                                                                    const uint32_t warmup_hops)
+{
+    if (K == 0 || K > gt_dim || K > L)
+        throw ANNException("K must be at least 1 and at most L and the ground truth per query", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    if (warmup_hops == 0)
+        throw ANNException("warmup_hops must be at least 1", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    SearchBudgetModel model;
+    model.L = L;
+    model.K = (uint32_t)K;
+    model.warmup_hops = warmup_hops;
+
+    // recall@K and hops of query q searched under budget
+    auto run = [&](const size_t q, SearchBudget &budget, float &recall) {
+        std::vector<uint32_t> ids(K, std::numeric_limits<uint32_t>::max());
+        const uint32_t hops = search_with_budget(queries + q * query_stride, K, L, ids.data(), (float *)nullptr,
+                                                 &budget)
+                                  .first;
+        const uint32_t *truth = gt + q * gt_dim;
+        size_t found = 0;
+        for (size_t i = 0; i < K; i++)
+            found += std::find(truth, truth + K, ids[i]) != truth + K ? 1 : 0;
+        recall = (float)found / (float)K;
+        return hops;
+    };
+
+    // the features of each query and the fewest hops reaching the recall of
+    // its full search, or 0 if it ends within the warmup
+    std::vector<float> full_recall(num_queries), features(num_queries * SEARCH_BUDGET_FEATURES);
+    std::vector<uint32_t> needed_hops(num_queries, 0);
+    std::atomic<uint64_t> full_hops(0);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t q = 0; q < (int64_t)num_queries; q++)
+    {
+        SearchBudget budget;
+        budget.warmup_hops = warmup_hops;
+        budget.K = (uint32_t)K;
+        uint32_t hi = run(q, budget, full_recall[q]);
+        full_hops += hi;
+        if (!budget.has_features)
+            continue;
+        std::copy(budget.features, budget.features + SEARCH_BUDGET_FEATURES,
+                  features.data() + q * SEARCH_BUDGET_FEATURES);
+
+        uint32_t lo = warmup_hops;
+        while (lo < hi)
+        {
+            SearchBudget capped = budget;
+            capped.max_hops = lo + (hi - lo) / 2;
+            float recall;
+            run(q, capped, recall);
+            if (recall >= full_recall[q])
+                hi = capped.max_hops;
+            else
+                lo = capped.max_hops + 1;
+        }
+        needed_hops[q] = hi;
+    }
+
+    std::vector<float> fit_features;
+    std::vector<uint32_t> fit_hops;
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        if (needed_hops[q] == 0)
+            continue;
+        fit_features.insert(fit_features.end(), features.data() + q * SEARCH_BUDGET_FEATURES,
+                            features.data() + (q + 1) * SEARCH_BUDGET_FEATURES);
+        fit_hops.push_back(needed_hops[q]);
+    }
+    if (fit_hops.empty())
+    {
+        // no search outlasts the warmup, so there is nothing to cut
+        model.multiplier = std::numeric_limits<float>::max();
+        return model;
+    }
+    SearchBudgetModel::fit_weights(fit_features, fit_hops, model.weights);
+
+    // mean recall@K and hops of the sample at the multiplier of model
+    auto evaluate = [&](double &mean_hops) {
+        double recall_sum = 0, hops_sum = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : recall_sum, hops_sum)
+        for (int64_t q = 0; q < (int64_t)num_queries; q++)
+        {
+            SearchBudget budget(&model);
+            float recall;
+            hops_sum += run(q, budget, recall);
+            recall_sum += recall;
+        }
+        mean_hops = hops_sum / (double)num_queries;
+        return recall_sum / (double)num_queries;
+    };
+
+    // every query gets the hops it needs at the highest multiplier; bisect
+    // on a log scale below it
+    double full_mean_recall = 0;
+    float hi = 0;
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        full_mean_recall += full_recall[q];
+        if (needed_hops[q] > 0)
+            hi = (std::max)(hi, needed_hops[q] / model.predicted_hops(features.data() + q * SEARCH_BUDGET_FEATURES));
+    }
+    full_mean_recall /= (double)num_queries;
+    const double target = (std::min)((double)target_recall, full_mean_recall);
+    float lo = hi / 1024;
+    double mean_hops;
+    for (uint32_t iter = 0; iter < 16; iter++)
+    {
+        model.multiplier = std::sqrt(lo * hi);
+        if (evaluate(mean_hops) >= target)
+            hi = model.multiplier;
+        else
+            lo = model.multiplier;
+    }
+    model.multiplier = hi;
+    const double mean_recall = evaluate(mean_hops);
+
+    diskann::cout << "Search budget for L=" << L << ", K=" << K << ": recall@" << K << " " << mean_recall
+                  << " in " << mean_hops << " hops per query, against " << full_mean_recall << " in "
+                  << (double)full_hops / (double)num_queries << " for full searches" << std::endl;
+    return model;
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::set_executor(std::shared_ptr<Executor> executor)
+{
+    _executor = executor;
+}
+
+template <typename T, typename TagT, typename LabelT> std::shared_ptr<Executor> Index<T, TagT, LabelT>::get_executor()
+{
+    return _executor != nullptr ? _executor : get_default_executor();
+}
+
 template <typename T, typename TagT, typename LabelT> size_t Index<T, TagT, LabelT>::release_location(int location)
 {
     if (_empty_slots.is_in_set(location))
@@ -2694,7 +4337,7 @@ void Index<T, TagT, LabelT>::reposition_points(uint32_t old_location_start, uint
     std::vector<location_t> updated_neighbours_location;
     for (uint32_t i = 0; i < _max_points + _num_frozen_pts; i++)
     {
-        auto &i_neighbours = _graph_store->get_neighbours((location_t)i);
+        auto i_neighbours = _graph_store->get_neighbours((location_t)i);
         std::vector<location_t> i_neighbours_copy(i_neighbours.begin(), i_neighbours.end());
         for (auto &loc : i_neighbours_copy)
         {
@@ -2757,6 +4400,19 @@ void Index<T, TagT, LabelT>::reposition_points(uint32_t old_location_start, uint
         }
     }
     _data_store->move_vectors(old_location_start, new_location_start, num_locations);
+    if (has_navigation_store())
+        _pq_data_store->move_vectors(old_location_start, new_location_start, num_locations);
+}
+
+template <typename T, typename TagT, typename LabelT> bool Index<T, TagT, LabelT>::has_navigation_store() const
+{
+    return _num_sq_bits != 0 || _num_pca_dims != 0;
+}
+
+template <typename T, typename TagT, typename LabelT>
+std::string Index<T, TagT, LabelT>::navigation_store_suffix() const
+{
+    return _num_pca_dims != 0 ? ".pca" : ".sq";
 }
 
 template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::reposition_frozen_point_to_end()
@@ -2791,9 +4447,16 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
     auto start = std::chrono::high_resolution_clock::now();
     assert(_empty_slots.size() == 0); // should not resize if there are empty slots.
 
+    // The stores reserve room to grow into the first time they grow, so later
+    // resizes extend them in place instead of copying every vector and list
+    // while searches wait on _update_lock. Per-point locks are rebuilt; lock
+    // stripes (_num_lock_stripes) keep their count.
     _data_store->resize((location_t)new_internal_points);
     _graph_store->resize_graph(new_internal_points);
-    _locks = std::vector<non_recursive_mutex>(new_internal_points);
+    if (_num_lock_stripes == 0)
+        _locks = std::vector<non_recursive_mutex>(new_internal_points);
+    if (_enable_tags)
+        _location_to_tag.reserve(new_internal_points);
 
     if (_num_frozen_pts != 0)
     {
@@ -2802,6 +4465,7 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
     }
 
     _max_points = new_max_points;
+    reset_tombstones();
     _empty_slots.reserve(_max_points);
     for (auto i = _nd; i < _max_points; i++)
     {
@@ -2812,6 +4476,25 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
     diskann::cout << "Resizing took: " << std::chrono::duration<double>(stop - start).count() << "s" << std::endl;
 }
 
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::_insert_points(const DataType &points, const TagType &tags, const size_t num_points,
+                                              std::vector<int> &insert_retvals)
+{
+    try
+    {
+        return this->insert_points(std::any_cast<const T *>(points), std::any_cast<const TagT *>(tags), num_points,
+                                   insert_retvals);
+    }
+    catch (const std::bad_any_cast &anycast_e)
+    {
+        throw new ANNException("Error:Trying to insert invalid data type" + std::string(anycast_e.what()), -1);
+    }
+    catch (const std::exception &e)
+    {
+        throw new ANNException("Error:" + std::string(e.what()), -1);
+    }
+}
+
 template <typename T, typename TagT, typename LabelT>
 int Index<T, TagT, LabelT>::_insert_point(const DataType &point, const TagType tag)
 {
@@ -2960,51 +4643,213 @@ int Index<T, TagT, LabelT>::insert_point(const T *point, const TagT tag, const s
         _tag_to_location[tag] = location;
         _location_to_tag.set(location, tag);
     }
+    const uint64_t wal_seq = _wal != nullptr ? log_insert(point, tag, labels) : 0;
     tl.unlock();
 
     _data_store->set_vector(location, point); // update datastore
 
-    // Find and add appropriate graph edges
-    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
-    auto scratch = manager.scratch_space();
-    std::vector<uint32_t> pruned_list; // it is the set best candidates to connect to this point
-    if (_filtered_index)
+    // Find and add appropriate graph edges
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+    std::vector<uint32_t> pruned_list; // it is the set best candidates to connect to this point
+    if (_filtered_index)
+    {
+        // when filtered the best_candidates will share the same label ( label_present > distance)
+        search_for_point_and_prune(location, _indexingQueueSize, pruned_list, scratch, true, _filterIndexingQueueSize);
+    }
+    else
+    {
+        search_for_point_and_prune(location, _indexingQueueSize, pruned_list, scratch);
+    }
+    assert(pruned_list.size() > 0); // should find atleast one neighbour (i.e frozen point acting as medoid)
+
+    set_inserted_point_neighbours(location, pruned_list);
+
+    inter_insert(location, pruned_list, scratch);
+
+    if (wal_seq != 0)
+        _wal->wait(wal_seq);
+    return 0;
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::insert_points(const T *points, const TagT *tags, const size_t num_points,
+                                             std::vector<int> &insert_retvals)
+{
+    assert(_has_built);
+    if (_filtered_index)
+    {
+        throw diskann::ANNException("Error: insert_points does not support filtered indices, use insert_point.", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    for (size_t i = 0; i < num_points; i++)
+    {
+        if (tags[i] == 0)
+        {
+            throw diskann::ANNException("Do not insert point with tag 0. That is "
+                                        "reserved for points hidden "
+                                        "from the user.",
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+    insert_retvals.assign(num_points, -1);
+
+#if EXPAND_IF_FULL
+    {
+        std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+        std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+        std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+        if (_nd + num_points > _max_points)
+            resize(std::max((size_t)(_max_points * INDEX_GROWTH_FACTOR), _nd + num_points));
+    }
+#endif
+
+    std::shared_lock<std::shared_timed_mutex> shared_ul(_update_lock);
+
+    // reserve locations and tags for the whole batch at once
+    std::vector<uint32_t> locations;
+    std::vector<size_t> point_ids;
+    size_t nd_before_batch;
+    uint64_t wal_seq = 0;
+    {
+        std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+        std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+        nd_before_batch = _nd;
+        locations.reserve(num_points);
+        point_ids.reserve(num_points);
+        for (size_t i = 0; i < num_points; i++)
+        {
+            if (_enable_tags && _tag_to_location.find(tags[i]) != _tag_to_location.end())
+                continue;
+
+            int location = reserve_location();
+            if (location == -1)
+                break; // cant insert as active pts >= max_pts
+
+            if (_enable_tags)
+            {
+                _tag_to_location[tags[i]] = location;
+                _location_to_tag.set(location, tags[i]);
+            }
+            if (_wal != nullptr)
+                wal_seq = log_insert(points + i * _dim, tags[i], std::vector<LabelT>());
+            locations.push_back((uint32_t)location);
+            point_ids.push_back(i);
+        }
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int64_t j = 0; j < (int64_t)locations.size(); j++)
+    {
+        _data_store->set_vector(locations[j], points + point_ids[j] * _dim);
+    }
+
+    link_inserted_points(locations, nd_before_batch);
+    for (size_t j = 0; j < locations.size(); j++)
+        insert_retvals[point_ids[j]] = 0;
+
+    if (wal_seq != 0)
+        _wal->wait(wal_seq);
+
+    return locations.size();
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::append_points(const T *points, const size_t num_points)
+{
+    assert(_has_built);
+    if (_enable_tags || _filtered_index)
     {
-        // when filtered the best_candidates will share the same label ( label_present > distance)
-        search_for_point_and_prune(location, _indexingQueueSize, pruned_list, scratch, true, _filterIndexingQueueSize);
+        throw diskann::ANNException("Error: append_points is for indices without tags or filters, use insert_points.",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
     }
-    else
+
+    std::shared_lock<std::shared_timed_mutex> shared_ul(_update_lock);
+    std::vector<uint32_t> locations(num_points);
+    size_t nd_before;
     {
-        search_for_point_and_prune(location, _indexingQueueSize, pruned_list, scratch);
+        std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+        std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+        nd_before = _nd;
+        if (_nd + num_points > _max_points || (_delete_set != nullptr && !_delete_set->empty()))
+        {
+            throw diskann::ANNException("Error: cannot append " + std::to_string(num_points) + " points to an index of " +
+                                            std::to_string(_nd) + " points with room for " +
+                                            std::to_string(_max_points) + " and no deleted points",
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        for (size_t i = 0; i < num_points; i++)
+            locations[i] = (uint32_t)(_nd + i);
+        _nd += num_points;
+        _empty_slots.clear();
+        for (size_t i = _nd; i < _max_points; i++)
+            _empty_slots.insert((uint32_t)i);
     }
-    assert(pruned_list.size() > 0); // should find atleast one neighbour (i.e frozen point acting as medoid)
 
+#pragma omp parallel for schedule(static)
+    for (int64_t j = 0; j < (int64_t)num_points; j++)
     {
-        std::shared_lock<std::shared_timed_mutex> tlock(_tag_lock, std::defer_lock);
-        if (_conc_consolidate)
-            tlock.lock();
+        _data_store->set_vector(locations[j], points + j * _dim);
+    }
 
-        LockGuard guard(_locks[location]);
-        _graph_store->clear_neighbours(location);
+    link_inserted_points(locations, nd_before);
+}
 
-        std::vector<uint32_t> neighbor_links;
-        for (auto link : pruned_list)
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::link_inserted_points(const std::vector<uint32_t> &locations, const size_t nd_before)
+{
+    // Points in a round do not see each other until the reverse edges of the
+    // round are added, so rounds are kept small relative to the index.
+    std::vector<std::vector<uint32_t>> pruned_lists(locations.size());
+    const size_t min_round_size = (size_t)omp_get_max_threads();
+    size_t round_start = 0;
+    while (round_start < locations.size())
+    {
+        const size_t round_size =
+            std::max(min_round_size, (size_t)(defaults::INSERT_BATCH_ROUND_FRACTION * (nd_before + round_start)));
+        const size_t round_end = std::min(locations.size(), round_start + round_size);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int64_t j = (int64_t)round_start; j < (int64_t)round_end; j++)
         {
-            if (_conc_consolidate)
-                if (!_location_to_tag.contains(link))
-                    continue;
-            neighbor_links.emplace_back(link);
+            ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+            auto scratch = manager.scratch_space();
+            search_for_point_and_prune(locations[j], _indexingQueueSize, pruned_lists[j], scratch);
+            assert(pruned_lists[j].size() > 0);
+            set_inserted_point_neighbours(locations[j], pruned_lists[j]);
         }
-        _graph_store->set_neighbours(location, neighbor_links);
-        assert(_graph_store->get_neighbours(location).size() <= _indexingRange);
 
-        if (_conc_consolidate)
-            tlock.unlock();
+        batch_inter_insert(locations.data() + round_start, pruned_lists.data() + round_start, round_end - round_start);
+        for (size_t j = round_start; j < round_end; j++)
+            std::vector<uint32_t>().swap(pruned_lists[j]);
+        round_start = round_end;
     }
+}
 
-    inter_insert(location, pruned_list, scratch);
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::set_inserted_point_neighbours(const uint32_t location,
+                                                           const std::vector<uint32_t> &pruned_list)
+{
+    std::shared_lock<std::shared_timed_mutex> tlock(_tag_lock, std::defer_lock);
+    if (_conc_consolidate)
+        tlock.lock();
 
-    return 0;
+    LockGuard guard(get_lock(location));
+    _graph_store->clear_neighbours(location);
+
+    std::vector<uint32_t> neighbor_links;
+    for (auto link : pruned_list)
+    {
+        if (_conc_consolidate)
+            if (!_location_to_tag.contains(link))
+                continue;
+        neighbor_links.emplace_back(link);
+    }
+    _graph_store->set_neighbours(location, neighbor_links);
+    assert(_graph_store->get_neighbours(location).size() <= _indexingRange);
+
+    if (_conc_consolidate)
+        tlock.unlock();
 }
 
 template <typename T, typename TagT, typename LabelT> int Index<T, TagT, LabelT>::_lazy_delete(const TagType &tag)
@@ -3052,8 +4897,15 @@ template <typename T, typename TagT, typename LabelT> int Index<T, TagT, LabelT>
 
     const auto location = _tag_to_location[tag];
     _delete_set->insert(location);
+    set_tombstone(location, true);
     _location_to_tag.erase(location);
     _tag_to_location.erase(tag);
+    const uint64_t wal_seq = _wal != nullptr ? log_delete(tag) : 0;
+
+    dl.unlock();
+    tl.unlock();
+    if (wal_seq != 0)
+        _wal->wait(wal_seq);
     return 0;
 }
 
@@ -3069,6 +4921,7 @@ void Index<T, TagT, LabelT>::lazy_delete(const std::vector<TagT> &tags, std::vec
     std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
     _data_compacted = false;
 
+    uint64_t wal_seq = 0;
     for (auto tag : tags)
     {
         if (_tag_to_location.find(tag) == _tag_to_location.end())
@@ -3079,10 +4932,227 @@ void Index<T, TagT, LabelT>::lazy_delete(const std::vector<TagT> &tags, std::vec
         {
             const auto location = _tag_to_location[tag];
             _delete_set->insert(location);
+            set_tombstone(location, true);
+            _location_to_tag.erase(location);
+            _tag_to_location.erase(tag);
+            if (_wal != nullptr)
+                wal_seq = log_delete(tag);
+        }
+    }
+
+    dl.unlock();
+    tl.unlock();
+    if (wal_seq != 0)
+        _wal->wait(wal_seq);
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::lazy_delete_by_label(const LabelT &label, std::vector<TagT> &deleted_tags,
+                                                    const IndexWriteParameters *consolidate_params)
+{
+    if (!_filtered_index)
+        throw ANNException("lazy_delete_by_label needs a filtered index", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    return lazy_delete_matching(
+        [&](uint32_t location, const TagT &) {
+            if (location < _label_bitmap.num_points())
+                return _label_bitmap.contains(location, (uint32_t)label);
+            const auto &point_labels = _location_to_labels[location];
+            return std::find(point_labels.begin(), point_labels.end(), label) != point_labels.end();
+        },
+        deleted_tags, consolidate_params);
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::lazy_delete_if(const std::function<bool(const TagT &)> &predicate,
+                                              std::vector<TagT> &deleted_tags,
+                                              const IndexWriteParameters *consolidate_params)
+{
+    return lazy_delete_matching([&](uint32_t, const TagT &tag) { return predicate(tag); }, deleted_tags,
+                                consolidate_params);
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::lazy_delete_matching(const std::function<bool(uint32_t, const TagT &)> &matches,
+                                                    std::vector<TagT> &deleted_tags,
+                                                    const IndexWriteParameters *consolidate_params)
+{
+    if (!_enable_tags)
+        throw ANNException("Point tag array not instantiated", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    size_t num_deleted = 0;
+    uint64_t wal_seq = 0;
+    {
+        std::shared_lock<std::shared_timed_mutex> ul(_update_lock);
+
+        // find the points in parallel, alongside searches
+        std::vector<std::pair<uint32_t, TagT>> found;
+        {
+            std::shared_lock<std::shared_timed_mutex> tl(_tag_lock);
+            std::mutex found_mutex;
+            get_executor()->parallel_for(
+                _max_points, 8192,
+                [&](uint64_t begin, uint64_t end) {
+                    std::vector<std::pair<uint32_t, TagT>> local;
+                    for (uint64_t loc = begin; loc < end; loc++)
+                    {
+                        TagT tag;
+                        if (_location_to_tag.try_get((uint32_t)loc, tag) && matches((uint32_t)loc, tag))
+                            local.emplace_back((uint32_t)loc, tag);
+                    }
+                    std::lock_guard<std::mutex> guard(found_mutex);
+                    found.insert(found.end(), local.begin(), local.end());
+                },
+                omp_get_num_procs());
+        }
+
+        // then mark those still holding the same tag, as lazy_delete does
+        std::unique_lock<std::shared_timed_mutex> tl(_tag_lock);
+        std::unique_lock<std::shared_timed_mutex> dl(_delete_lock);
+        _data_compacted = false;
+        for (const auto &[location, tag] : found)
+        {
+            auto iter = _tag_to_location.find(tag);
+            if (iter == _tag_to_location.end() || iter->second != location || !matches(location, tag))
+                continue;
+            _delete_set->insert(location);
+            set_tombstone(location, true);
             _location_to_tag.erase(location);
             _tag_to_location.erase(tag);
+            if (_wal != nullptr)
+                wal_seq = log_delete(tag);
+            deleted_tags.push_back(tag);
+            num_deleted++;
+        }
+    }
+    if (wal_seq != 0)
+        _wal->wait(wal_seq);
+
+    if (consolidate_params != nullptr && num_deleted > 0)
+        consolidate_deletes(*consolidate_params);
+    return num_deleted;
+}
+
+template <typename T, typename TagT, typename LabelT>
+uint64_t Index<T, TagT, LabelT>::log_insert(const T *point, const TagT tag, const std::vector<LabelT> &labels)
+{
+    // the labels of unfiltered indices are placeholders
+    const uint32_t num_labels = _filtered_index ? (uint32_t)labels.size() : 0;
+    std::vector<char> record(sizeof(TagT) + sizeof(uint32_t) + num_labels * sizeof(LabelT) + _dim * sizeof(T));
+    char *cursor = record.data();
+    std::memcpy(cursor, &tag, sizeof(TagT));
+    cursor += sizeof(TagT);
+    std::memcpy(cursor, &num_labels, sizeof(uint32_t));
+    cursor += sizeof(uint32_t);
+    if (num_labels > 0)
+        std::memcpy(cursor, labels.data(), num_labels * sizeof(LabelT));
+    cursor += num_labels * sizeof(LabelT);
+    std::memcpy(cursor, point, _dim * sizeof(T));
+    return _wal->append(WAL_INSERT, record.data(), (uint32_t)record.size());
+}
+
+template <typename T, typename TagT, typename LabelT> uint64_t Index<T, TagT, LabelT>::log_delete(const TagT &tag)
+{
+    return _wal->append(WAL_DELETE, &tag, sizeof(TagT));
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::replay_write_ahead_log(const std::string &path)
+{
+    std::vector<T> batch_points;
+    std::vector<TagT> batch_tags;
+    size_t num_not_applied = 0;
+    auto insert_batch = [&]() {
+        if (batch_tags.empty())
+            return;
+        std::vector<int> insert_retvals;
+        num_not_applied += batch_tags.size() -
+                           insert_points(batch_points.data(), batch_tags.data(), batch_tags.size(), insert_retvals);
+        batch_points.clear();
+        batch_tags.clear();
+    };
+
+    auto apply = [&](uint32_t type, const char *payload, uint32_t bytes) {
+        TagT tag;
+        uint32_t num_labels = 0;
+        if (bytes >= sizeof(TagT) + sizeof(uint32_t))
+            std::memcpy(&num_labels, payload + sizeof(TagT), sizeof(uint32_t));
+        const size_t insert_bytes =
+            sizeof(TagT) + sizeof(uint32_t) + (size_t)num_labels * sizeof(LabelT) + _dim * sizeof(T);
+        if (!(type == WAL_DELETE && bytes == sizeof(TagT)) && !(type == WAL_INSERT && bytes == insert_bytes))
+        {
+            throw ANNException("Write-ahead log " + path + " has a record of type " + std::to_string(type) +
+                                   " and size " + std::to_string(bytes) + " that does not fit this index",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        std::memcpy(&tag, payload, sizeof(TagT));
+
+        if (type == WAL_DELETE)
+        {
+            insert_batch();
+            std::vector<TagT> failed_tags;
+            lazy_delete(std::vector<TagT>{tag}, failed_tags);
+            num_not_applied += failed_tags.size();
+            return;
+        }
+
+        const char *point = payload + sizeof(TagT) + sizeof(uint32_t) + num_labels * sizeof(LabelT);
+        if (!_filtered_index)
+        {
+            const size_t offset = batch_points.size();
+            batch_points.resize(offset + _dim);
+            std::memcpy(batch_points.data() + offset, point, _dim * sizeof(T));
+            batch_tags.push_back(tag);
+            if (batch_tags.size() >= defaults::WAL_REPLAY_BATCH_SIZE)
+                insert_batch();
+            return;
         }
+
+        std::vector<LabelT> labels(num_labels);
+        if (num_labels > 0)
+            std::memcpy(labels.data(), payload + sizeof(TagT) + sizeof(uint32_t), num_labels * sizeof(LabelT));
+        std::vector<T> vector(_dim);
+        std::memcpy(vector.data(), point, _dim * sizeof(T));
+        if (insert_point(vector.data(), tag, labels) != 0)
+            num_not_applied++;
+    };
+
+    const uint64_t num_records = WriteAheadLog::replay(path, apply);
+    insert_batch();
+
+    // Updates the last save already holds, from a crash before it emptied
+    // the log, and inserts into a full index fail
+    if (num_not_applied > 0)
+    {
+        diskann::cerr << "Could not apply " << num_not_applied << " of the " << num_records << " operations in "
+                      << path << std::endl;
+    }
+    return (size_t)num_records;
+}
+
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::open_write_ahead_log(const std::string &path, const WriteAheadLogOptions &options)
+{
+    if (!_enable_tags)
+    {
+        throw ANNException("A write-ahead log identifies points by their tags, so it needs an index with tags", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
     }
+    if (_wal != nullptr)
+        throw ANNException("A write-ahead log is already open", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    // replayed before the log is set, so that it is not logged again
+    const size_t num_replayed = replay_write_ahead_log(path);
+
+    std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+    _wal = std::make_unique<WriteAheadLog>(path, options);
+    return num_replayed;
+}
+
+template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT>::close_write_ahead_log()
+{
+    std::unique_lock<std::shared_timed_mutex> ul(_update_lock);
+    _wal.reset();
 }
 
 template <typename T, typename TagT, typename LabelT> bool Index<T, TagT, LabelT>::is_index_saved()
@@ -3187,34 +5257,193 @@ template <typename T, typename TagT, typename LabelT> void Index<T, TagT, LabelT
         throw diskann::ANNException("Optimize_index_layout not implemented for dyanmic indices", -1, __FUNCSIG__,
                                     __FILE__, __LINE__);
     }
+    if (_opt_graph != nullptr)
+        return;
+    if (_dist_metric == diskann::Metric::FAST_L2 && !std::is_floating_point<T>::value)
+    {
+        throw diskann::ANNException("ERROR: FastL2 only defined for float currently.", -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
 
-    float *cur_vec = new float[_data_store->get_aligned_dim()];
-    std::memset(cur_vec, 0, _data_store->get_aligned_dim() * sizeof(float));
-    _data_len = (_data_store->get_aligned_dim() + 1) * sizeof(float);
+    // the vector comes first so that it keeps the alignment of the node
+    _data_len = _data_store->get_aligned_dim() * sizeof(T);
     _neighbor_len = (_graph_store->get_max_observed_degree() + 1) * sizeof(uint32_t);
-    _node_size = _data_len + _neighbor_len;
-    _opt_graph = new char[_node_size * _nd];
+    _node_size = ROUND_UP(_data_len + sizeof(float) + _neighbor_len, defaults::CACHE_LINE_SIZE);
+    _opt_num_nodes = _max_points + _num_frozen_pts;
+    _opt_graph_buffer = alloc_large(_node_size * _opt_num_nodes, defaults::CACHE_LINE_SIZE);
+    _opt_graph = (char *)_opt_graph_buffer.ptr;
+
     auto dist_fast = (DistanceFastL2<T> *)(_data_store->get_dist_fn());
-    for (uint32_t i = 0; i < _nd; i++)
+    const uint32_t max_degree = _graph_store->get_max_observed_degree();
+#pragma omp parallel for schedule(static, 8192)
+    for (int64_t i = 0; i < (int64_t)_opt_num_nodes; i++)
     {
         char *cur_node_offset = _opt_graph + i * _node_size;
-        _data_store->get_vector(i, (T *)cur_vec);
-        float cur_norm = dist_fast->norm((T *)cur_vec, (uint32_t)_data_store->get_aligned_dim());
-        std::memcpy(cur_node_offset, &cur_norm, sizeof(float));
-        std::memcpy(cur_node_offset + sizeof(float), cur_vec, _data_len - sizeof(float));
-
-        cur_node_offset += _data_len;
-        uint32_t k = (uint32_t)_graph_store->get_neighbours(i).size();
+        _data_store->get_vector((location_t)i, (T *)cur_node_offset);
+        float cur_norm = 0;
+        if (_dist_metric == diskann::Metric::FAST_L2)
+            cur_norm = dist_fast->norm((T *)cur_node_offset, (uint32_t)_data_store->get_aligned_dim());
+        std::memcpy(cur_node_offset + _data_len, &cur_norm, sizeof(float));
+
+        cur_node_offset += _data_len + sizeof(float);
+        auto nbrs = _graph_store->get_neighbours((location_t)i);
+        uint32_t k = (std::min)((uint32_t)nbrs.size(), max_degree);
         std::memcpy(cur_node_offset, &k, sizeof(uint32_t));
-        std::memcpy(cur_node_offset + sizeof(uint32_t), _graph_store->get_neighbours(i).data(), k * sizeof(uint32_t));
-        // std::vector<uint32_t>().swap(_graph_store->get_neighbours(i));
-        _graph_store->clear_neighbours(i);
+        std::memcpy(cur_node_offset + sizeof(uint32_t), nbrs.data(), k * sizeof(uint32_t));
     }
     _graph_store->clear_graph();
     _graph_store->resize_graph(0);
-    delete[] cur_vec;
 }
 
+// The file of save_optimized_layout() starts with a header of
+// MMAP_HEADER_SIZE bytes, which keeps the nodes aligned when it is mapped.
+// Its fields, in this order, are uint64_t.
+enum OptimizedLayoutHeader
+{
+    OPT_NUM_POINTS,
+    OPT_MAX_POINTS,
+    OPT_NUM_FROZEN_POINTS,
+    OPT_START,
+    OPT_METRIC,
+    OPT_DIM,
+    OPT_ALIGNED_DIM,
+    OPT_DATA_SIZE,
+    OPT_NODE_SIZE,
+    OPT_NEIGHBOR_LEN,
+    OPT_NUM_FIELDS
+};
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::save_optimized_layout(const char *filename)
+{
+    if (_opt_graph == nullptr)
+    {
+        throw ANNException("Call optimize_index_layout() before saving the optimized layout", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    }
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    const std::string layout_file = std::string(filename) + ".opt";
+    std::ofstream writer;
+    open_file_to_write(writer, layout_file);
+
+    std::vector<char> header(defaults::MMAP_HEADER_SIZE, 0);
+    uint64_t header_fields[OPT_NUM_FIELDS];
+    header_fields[OPT_NUM_POINTS] = _nd + _num_frozen_pts;
+    header_fields[OPT_MAX_POINTS] = _max_points;
+    header_fields[OPT_NUM_FROZEN_POINTS] = _num_frozen_pts;
+    header_fields[OPT_START] = _start;
+    header_fields[OPT_METRIC] = (uint64_t)_dist_metric;
+    header_fields[OPT_DIM] = _dim;
+    header_fields[OPT_ALIGNED_DIM] = _data_store->get_aligned_dim();
+    header_fields[OPT_DATA_SIZE] = sizeof(T);
+    header_fields[OPT_NODE_SIZE] = _node_size;
+    header_fields[OPT_NEIGHBOR_LEN] = _neighbor_len;
+    std::memcpy(header.data(), header_fields, sizeof(header_fields));
+    writer.write(header.data(), header.size());
+    writer.write(_opt_graph, _opt_num_nodes * _node_size);
+    writer.close();
+
+    diskann::cout << "Wrote the optimized layout of " << _opt_num_nodes << " nodes to " << layout_file << std::endl;
+}
+
+template <typename T, typename TagT, typename LabelT>
+void Index<T, TagT, LabelT>::load_optimized_layout(const char *filename, uint32_t num_threads, uint32_t search_l)
+{
+#ifdef EXEC_ENV_OLS
+    throw ANNException("Loading the optimized layout alone is not supported with EXEC_ENV_OLS", -1, __FUNCSIG__,
+                       __FILE__, __LINE__);
+#else
+    if (_dynamic_index)
+    {
+        throw ANNException("The optimized layout is only supported for static indices", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+    _layout_only = true;
+    load(filename, num_threads, search_l);
+#endif
+}
+
+#ifndef EXEC_ENV_OLS
+template <typename T, typename TagT, typename LabelT>
+size_t Index<T, TagT, LabelT>::load_layout(const std::string &filename)
+{
+    if (!file_exists(filename))
+    {
+        std::stringstream stream;
+        stream << "ERROR: optimized layout file " << filename << " does not exist." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    uint64_t header_fields[OPT_NUM_FIELDS] = {};
+    size_t file_size = 0;
+    std::unique_ptr<MemoryMapper> mapping;
+    std::ifstream reader;
+    if (_mmap_load)
+    {
+        mapping = std::make_unique<MemoryMapper>(filename);
+        file_size = mapping->getFileSize();
+        if (file_size >= defaults::MMAP_HEADER_SIZE)
+            std::memcpy(header_fields, mapping->getBuf(), sizeof(header_fields));
+    }
+    else
+    {
+        reader.exceptions(std::ios::badbit | std::ios::failbit);
+        reader.open(filename, std::ios::binary | std::ios::ate);
+        file_size = reader.tellg();
+        reader.seekg(0, std::ios::beg);
+        if (file_size >= defaults::MMAP_HEADER_SIZE)
+            reader.read((char *)header_fields, sizeof(header_fields));
+    }
+
+    const size_t num_nodes = header_fields[OPT_MAX_POINTS] + header_fields[OPT_NUM_FROZEN_POINTS];
+    const size_t layout_bytes = num_nodes * header_fields[OPT_NODE_SIZE];
+    if (header_fields[OPT_DIM] != _dim || header_fields[OPT_ALIGNED_DIM] != _data_store->get_aligned_dim() ||
+        header_fields[OPT_DATA_SIZE] != sizeof(T) || header_fields[OPT_METRIC] != (uint64_t)_dist_metric ||
+        file_size < defaults::MMAP_HEADER_SIZE + layout_bytes)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << filename << " holds the layout of " << header_fields[OPT_DIM]
+               << " dimensional vectors of " << header_fields[OPT_DATA_SIZE] << " byte elements under metric "
+               << header_fields[OPT_METRIC] << " in " << file_size << " bytes, but the index has " << _dim
+               << " dimensional vectors of " << sizeof(T) << " byte elements under metric " << (int)_dist_metric
+               << "." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    _max_points = header_fields[OPT_MAX_POINTS];
+    _num_frozen_pts = header_fields[OPT_NUM_FROZEN_POINTS];
+    _start = (uint32_t)header_fields[OPT_START];
+    _data_len = _data_store->get_aligned_dim() * sizeof(T);
+    _node_size = header_fields[OPT_NODE_SIZE];
+    _neighbor_len = header_fields[OPT_NEIGHBOR_LEN];
+    _opt_num_nodes = num_nodes;
+
+    if (mapping != nullptr)
+    {
+#ifndef _WINDOWS
+        // start reading the file into the page cache in the background
+        madvise(mapping->getBuf(), mapping->getFileSize(), MADV_WILLNEED);
+#endif
+        _opt_graph_mapping = std::move(mapping);
+        _opt_graph = _opt_graph_mapping->getBuf() + defaults::MMAP_HEADER_SIZE;
+    }
+    else
+    {
+        _opt_graph_buffer = alloc_large(layout_bytes, defaults::CACHE_LINE_SIZE);
+        _opt_graph = (char *)_opt_graph_buffer.ptr;
+        reader.seekg(defaults::MMAP_HEADER_SIZE, std::ios::beg);
+        reader.read(_opt_graph, layout_bytes);
+    }
+
+    diskann::cout << "Loaded the optimized layout of " << _opt_num_nodes << " nodes from " << filename
+                  << (_opt_graph_mapping != nullptr ? " (mapped)" : "") << std::endl;
+    return header_fields[OPT_NUM_POINTS];
+}
+#endif
+
 template <typename T, typename TagT, typename LabelT>
 void Index<T, TagT, LabelT>::_search_with_optimized_layout(const DataType &query, size_t K, size_t L, uint32_t *indices)
 {
@@ -3238,84 +5467,122 @@ void Index<T, TagT, LabelT>::_search_with_optimized_layout(const DataType &query
 template <typename T, typename TagT, typename LabelT>
 void Index<T, TagT, LabelT>::search_with_optimized_layout(const T *query, size_t K, size_t L, uint32_t *indices)
 {
-    DistanceFastL2<T> *dist_fast = (DistanceFastL2<T> *)(_data_store->get_dist_fn());
-
-    NeighborPriorityQueue retset(L);
-    std::vector<uint32_t> init_ids(L);
-
-    boost::dynamic_bitset<> flags{_nd, 0};
-    uint32_t tmp_l = 0;
-    uint32_t *neighbors = (uint32_t *)(_opt_graph + _node_size * _start + _data_len);
-    uint32_t MaxM_ep = *neighbors;
-    neighbors++;
+    search_with_optimized_layout<uint32_t>(query, K, (uint32_t)L, indices, nullptr);
+}
 
-    for (; tmp_l < L && tmp_l < MaxM_ep; tmp_l++)
+template <typename T, typename TagT, typename LabelT>
+template <typename IdType>
+size_t Index<T, TagT, LabelT>::search_with_optimized_layout(const T *query, const size_t K, const uint32_t L,
+                                                            IdType *indices, float *distances, TagT *tags,
+                                                            const LabelFilter<LabelT> *filter)
+{
+    if (_opt_graph == nullptr)
     {
-        init_ids[tmp_l] = neighbors[tmp_l];
-        flags[init_ids[tmp_l]] = true;
+        throw ANNException("Call optimize_index_layout() before searching on the optimized layout", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
     }
-
-    while (tmp_l < L)
+    if (K > (uint64_t)L)
     {
-        uint32_t id = rand() % _nd;
-        if (flags[id])
-            continue;
-        flags[id] = true;
-        init_ids[tmp_l] = id;
-        tmp_l++;
+        throw ANNException("Set L to a value of at least K", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
-
-    for (uint32_t i = 0; i < init_ids.size(); i++)
+    if (tags != nullptr && !_enable_tags)
     {
-        uint32_t id = init_ids[i];
-        if (id >= _nd)
-            continue;
-        _mm_prefetch(_opt_graph + _node_size * id, _MM_HINT_T0);
+        throw ANNException("Tags requested from an index without tags", -1, __FUNCSIG__, __FILE__, __LINE__);
     }
-    L = 0;
-    for (uint32_t i = 0; i < init_ids.size(); i++)
+    if (filter != nullptr && filter->empty())
+        filter = nullptr;
+
+    ScratchStoreManager<InMemQueryScratch<T>> manager(_query_scratch);
+    auto scratch = manager.scratch_space();
+    if (L > scratch->get_L())
+        scratch->grow_for_new_L(L);
+
+    std::shared_lock<std::shared_timed_mutex> lock(_update_lock);
+    std::vector<uint32_t> init_ids = get_init_ids();
+    if (filter != nullptr)
+        add_filter_start_points(*filter, init_ids);
+    else
+        add_entry_layer_seeds(query, init_ids);
+    _data_store->preprocess_query(query, scratch);
+    const T *aligned_query = scratch->aligned_query();
+
+    const uint32_t aligned_dim = (uint32_t)_data_store->get_aligned_dim();
+    const bool fast_l2 = _dist_metric == diskann::Metric::FAST_L2;
+    Distance<T> *dist_fn = _data_store->get_dist_fn();
+    auto dist_fast = (DistanceFastL2<T> *)dist_fn;
+    // FastL2 leaves out the norm of the query, which does not change the
+    // order; it is added back to the distances returned
+    const float query_norm = fast_l2 ? dist_fast->norm(aligned_query, aligned_dim) : 0;
+    auto node_distance = [&](uint32_t id) {
+        const char *node = _opt_graph + _node_size * id;
+        if (fast_l2)
+            return dist_fast->compare(aligned_query, (const T *)node, *(const float *)(node + _data_len), aligned_dim);
+        return dist_fn->compare(aligned_query, (const T *)node, aligned_dim);
+    };
+
+    NeighborPriorityQueue &retset = scratch->best_l_nodes();
+    retset.reserve(L);
+    VisitedSet &visited = scratch->inserted_into_pool();
+    visited.reserve(_opt_num_nodes, (uint64_t)L * scratch->get_R());
+
+    // with a filter, the start points are searched from even if they do not
+    // match it
+    for (auto id : init_ids)
     {
-        uint32_t id = init_ids[i];
-        if (id >= _nd)
-            continue;
-        T *x = (T *)(_opt_graph + _node_size * id);
-        float norm_x = *x;
-        x++;
-        float dist = dist_fast->compare(x, query, norm_x, (uint32_t)_data_store->get_aligned_dim());
-        retset.insert(Neighbor(id, dist));
-        flags[id] = true;
-        L++;
+        if (id < _opt_num_nodes && visited.insert(id))
+            retset.insert(Neighbor(id, node_distance(id)));
     }
 
+    std::vector<uint32_t> &id_scratch = scratch->id_scratch();
     while (retset.has_unexpanded_node())
     {
-        auto nbr = retset.closest_unexpanded();
-        auto n = nbr.id;
-        _mm_prefetch(_opt_graph + _node_size * n + _data_len, _MM_HINT_T0);
-        neighbors = (uint32_t *)(_opt_graph + _node_size * n + _data_len);
+        auto n = retset.closest_unexpanded().id;
+        const uint32_t *neighbors = (const uint32_t *)(_opt_graph + _node_size * n + _data_len + sizeof(float));
         uint32_t MaxM = *neighbors;
         neighbors++;
-        for (uint32_t m = 0; m < MaxM; ++m)
-            _mm_prefetch(_opt_graph + _node_size * neighbors[m], _MM_HINT_T0);
+
+        id_scratch.clear();
         for (uint32_t m = 0; m < MaxM; ++m)
         {
             uint32_t id = neighbors[m];
-            if (flags[id])
+            if (filter != nullptr && !point_matches_filter(id, *filter))
                 continue;
-            flags[id] = 1;
-            T *data = (T *)(_opt_graph + _node_size * id);
-            float norm = *data;
-            data++;
-            float dist = dist_fast->compare(query, data, norm, (uint32_t)_data_store->get_aligned_dim());
-            Neighbor nn(id, dist);
-            retset.insert(nn);
+            if (visited.insert(id))
+            {
+                id_scratch.push_back(id);
+                prefetch_vector(_opt_graph + _node_size * id, _data_len + sizeof(float));
+            }
         }
+        for (auto id : id_scratch)
+            retset.insert(Neighbor(id, node_distance(id)));
     }
+    id_scratch.clear();
 
-    for (size_t i = 0; i < K; i++)
+    size_t pos = 0;
+    for (size_t i = 0; i < retset.size() && pos < K; ++i)
     {
-        indices[i] = retset[i].id;
+        const uint32_t id = retset[i].id;
+        if (id >= _max_points || is_tombstone(id))
+            continue;
+        if (filter != nullptr && !point_matches_filter(id, *filter))
+            continue;
+        if (tags != nullptr && !_location_to_tag.try_get(id, tags[pos]))
+            continue;
+
+        indices[pos] = (IdType)id;
+        if (distances != nullptr)
+        {
+            float dist = retset[i].distance + query_norm;
+#ifdef EXEC_ENV_OLS
+            // DLVS expects negative distances
+            distances[pos] = dist;
+#else
+            distances[pos] = _dist_metric == diskann::Metric::INNER_PRODUCT ? -1 * dist : dist;
+#endif
+        }
+        pos++;
     }
+    return pos;
 }
 
 /*  Internals of the library */
@@ -3327,6 +5594,8 @@ template DISKANN_DLLEXPORT class Index<int8_t, int32_t, uint32_t>;
 template DISKANN_DLLEXPORT class Index<uint8_t, int32_t, uint32_t>;
 template DISKANN_DLLEXPORT class Index<float, uint32_t, uint32_t>;
 template DISKANN_DLLEXPORT class Index<int8_t, uint32_t, uint32_t>;
+template DISKANN_DLLEXPORT class Index<float16, uint32_t, uint32_t>;
+template DISKANN_DLLEXPORT class Index<bfloat16, uint32_t, uint32_t>;
 template DISKANN_DLLEXPORT class Index<uint8_t, uint32_t, uint32_t>;
 template DISKANN_DLLEXPORT class Index<float, int64_t, uint32_t>;
 template DISKANN_DLLEXPORT class Index<int8_t, int64_t, uint32_t>;
@@ -3343,6 +5612,8 @@ template DISKANN_DLLEXPORT class Index<int8_t, int32_t, uint16_t>;
 template DISKANN_DLLEXPORT class Index<uint8_t, int32_t, uint16_t>;
 template DISKANN_DLLEXPORT class Index<float, uint32_t, uint16_t>;
 template DISKANN_DLLEXPORT class Index<int8_t, uint32_t, uint16_t>;
+template DISKANN_DLLEXPORT class Index<float16, uint32_t, uint16_t>;
+template DISKANN_DLLEXPORT class Index<bfloat16, uint32_t, uint16_t>;
 template DISKANN_DLLEXPORT class Index<uint8_t, uint32_t, uint16_t>;
 template DISKANN_DLLEXPORT class Index<float, int64_t, uint16_t>;
 template DISKANN_DLLEXPORT class Index<int8_t, int64_t, uint16_t>;
@@ -3481,5 +5752,298 @@ template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t,
 template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint16_t>::search_with_filters<
     uint32_t>(const int8_t *query, const uint16_t &filter_label, const size_t K, const uint32_t L, uint32_t *indices,
               float *distances);
+// boolean label filters
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint32_t>::search_with_filters<
+    uint64_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint32_t>::search_with_filters<
+    uint32_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint64_t, uint32_t>::search_with_filters<
+    uint64_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint64_t, uint32_t>::search_with_filters<
+    uint32_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint64_t, uint32_t>::search_with_filters<
+    uint64_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint64_t, uint32_t>::search_with_filters<
+    uint32_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint32_t, uint32_t>::search_with_filters<
+    uint64_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint32_t, uint32_t>::search_with_filters<
+    uint32_t>(const float *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint32_t, uint32_t>::search_with_filters<
+    uint64_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint32_t, uint32_t>::search_with_filters<
+    uint32_t>(const uint8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint32_t>::search_with_filters<
+    uint64_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint32_t>::search_with_filters<
+    uint32_t>(const int8_t *query, const LabelFilter<uint32_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint16_t>::search_with_filters<
+    uint64_t>(const float *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint64_t, uint16_t>::search_with_filters<
+    uint32_t>(const float *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint64_t, uint16_t>::search_with_filters<
+    uint64_t>(const uint8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint64_t, uint16_t>::search_with_filters<
+    uint32_t>(const uint8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint64_t, uint16_t>::search_with_filters<
+    uint64_t>(const int8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint64_t, uint16_t>::search_with_filters<
+    uint32_t>(const int8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint32_t, uint16_t>::search_with_filters<
+    uint64_t>(const float *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<float, uint32_t, uint16_t>::search_with_filters<
+    uint32_t>(const float *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint32_t, uint16_t>::search_with_filters<
+    uint64_t>(const uint8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<uint8_t, uint32_t, uint16_t>::search_with_filters<
+    uint32_t>(const uint8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint16_t>::search_with_filters<
+    uint64_t>(const int8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT std::pair<uint32_t, uint32_t> Index<int8_t, uint32_t, uint16_t>::search_with_filters<
+    uint32_t>(const int8_t *query, const LabelFilter<uint16_t> &filter, const size_t K, const uint32_t L,
+              uint32_t *indices, float *distances);
+
+
+// batched searches
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint32_t>::batch_search<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint32_t>::batch_search<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint32_t>::batch_search<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint32_t>::batch_search<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint32_t>::batch_search<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint32_t>::batch_search<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint16_t>::batch_search<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint16_t>::batch_search<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint16_t>::batch_search<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint16_t>::batch_search<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint16_t>::batch_search<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint16_t>::batch_search<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint32_t>::batch_search<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint32_t>::batch_search<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint32_t>::batch_search<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint32_t>::batch_search<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint32_t>::batch_search<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint32_t>::batch_search<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint16_t>::batch_search<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint16_t>::batch_search<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint16_t>::batch_search<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint16_t>::batch_search<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint16_t>::batch_search<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint16_t>::batch_search<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances, const uint32_t num_threads, const uint32_t interleave);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint32_t>::batch_search_on_gpu<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint32_t>::batch_search_on_gpu<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint32_t>::batch_search_on_gpu<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint32_t>::batch_search_on_gpu<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint32_t>::batch_search_on_gpu<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint32_t>::batch_search_on_gpu<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint16_t>::batch_search_on_gpu<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint64_t, uint16_t>::batch_search_on_gpu<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint16_t>::batch_search_on_gpu<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint64_t, uint16_t>::batch_search_on_gpu<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint16_t>::batch_search_on_gpu<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint64_t, uint16_t>::batch_search_on_gpu<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint32_t>::batch_search_on_gpu<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint32_t>::batch_search_on_gpu<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint32_t>::batch_search_on_gpu<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint32_t>::batch_search_on_gpu<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint32_t>::batch_search_on_gpu<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint32_t>::batch_search_on_gpu<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint16_t>::batch_search_on_gpu<uint64_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<float, uint32_t, uint16_t>::batch_search_on_gpu<uint32_t>(
+    const float *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint16_t>::batch_search_on_gpu<uint64_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<uint8_t, uint32_t, uint16_t>::batch_search_on_gpu<uint32_t>(
+    const uint8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint16_t>::batch_search_on_gpu<uint64_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint64_t *indices, float *distances);
+template DISKANN_DLLEXPORT void Index<int8_t, uint32_t, uint16_t>::batch_search_on_gpu<uint32_t>(
+    const int8_t *queries, const size_t num_queries, const size_t query_stride, const size_t K, const uint32_t L,
+    uint32_t *indices, float *distances);
+// searches on the optimized layout
+template DISKANN_DLLEXPORT size_t Index<float, uint64_t, uint32_t>::search_with_optimized_layout<uint64_t>(
+    const float *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint64_t, uint32_t>::search_with_optimized_layout<uint32_t>(
+    const float *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint64_t, uint32_t>::search_with_optimized_layout<uint64_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint64_t, uint32_t>::search_with_optimized_layout<uint32_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint64_t, uint32_t>::search_with_optimized_layout<uint64_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint64_t, uint32_t>::search_with_optimized_layout<uint32_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint64_t, uint16_t>::search_with_optimized_layout<uint64_t>(
+    const float *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint64_t, uint16_t>::search_with_optimized_layout<uint32_t>(
+    const float *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint64_t, uint16_t>::search_with_optimized_layout<uint64_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint64_t, uint16_t>::search_with_optimized_layout<uint32_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint64_t, uint16_t>::search_with_optimized_layout<uint64_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint64_t, uint16_t>::search_with_optimized_layout<uint32_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint64_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint32_t, uint32_t>::search_with_optimized_layout<uint64_t>(
+    const float *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint32_t, uint32_t>::search_with_optimized_layout<uint32_t>(
+    const float *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint32_t, uint32_t>::search_with_optimized_layout<uint64_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint32_t, uint32_t>::search_with_optimized_layout<uint32_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint32_t, uint32_t>::search_with_optimized_layout<uint64_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint32_t, uint32_t>::search_with_optimized_layout<uint32_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint32_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint32_t, uint16_t>::search_with_optimized_layout<uint64_t>(
+    const float *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<float, uint32_t, uint16_t>::search_with_optimized_layout<uint32_t>(
+    const float *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint32_t, uint16_t>::search_with_optimized_layout<uint64_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<uint8_t, uint32_t, uint16_t>::search_with_optimized_layout<uint32_t>(
+    const uint8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint32_t, uint16_t>::search_with_optimized_layout<uint64_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint64_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint16_t> *filter);
+template DISKANN_DLLEXPORT size_t Index<int8_t, uint32_t, uint16_t>::search_with_optimized_layout<uint32_t>(
+    const int8_t *query, const size_t K, const uint32_t L, uint32_t *indices, float *distances, uint32_t *tags,
+    const LabelFilter<uint16_t> *filter);
 
 } // namespace diskann
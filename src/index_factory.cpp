@@ -32,6 +32,43 @@ void IndexFactory::check_config()
                                "with PQ distance "
                                "base index",
                                -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (_config->metric == diskann::Metric::HAMMING)
+            throw ANNException("ERROR: PQ distance based index construction does not support the Hamming metric", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    if (_config->num_sq_bits != 0)
+    {
+        if (_config->num_sq_bits != 8 && _config->num_sq_bits != 4)
+            throw ANNException("ERROR: scalar quantization supports 8 or 4 bits per dimension", -1, __FUNCSIG__,
+                               __FILE__, __LINE__);
+        if (_config->pq_dist_build)
+            throw ANNException("ERROR: choose either PQ or scalar quantization for distance based index construction",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (_config->dynamic_index)
+            throw ANNException("ERROR: Dynamic Indexing not supported with scalar quantization based "
+                               "index construction",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (_config->metric != diskann::Metric::L2 && _config->metric != diskann::Metric::INNER_PRODUCT)
+            throw ANNException("ERROR: scalar quantization supports only the L2 and inner product metrics", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    if (_config->num_pca_dims != 0)
+    {
+        if (_config->num_pca_dims > _config->dimension)
+            throw ANNException("ERROR: a PCA projected store keeps at most as many dimensions as the data has", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        if (_config->pq_dist_build || _config->num_sq_bits != 0)
+            throw ANNException("ERROR: choose one of PQ, scalar quantization and PCA for distance based index "
+                               "construction",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        if (_config->dynamic_index)
+            throw ANNException("ERROR: Dynamic Indexing not supported with PCA based index construction", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        if (_config->metric != diskann::Metric::L2 && _config->metric != diskann::Metric::INNER_PRODUCT)
+            throw ANNException("ERROR: PCA projection supports only the L2 and inner product metrics", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
     }
 
     if (_config->data_type != "float" && _config->data_type != "uint8" && _config->data_type != "int8")
@@ -54,6 +91,10 @@ template <typename T> Distance<T> *IndexFactory::construct_inmem_distance_fn(Met
 {
     if (metric == diskann::Metric::COSINE && std::is_same<T, float>::value)
     {
+#ifndef USE_NEON
+        if (Avx512SupportedCPU)
+            return (Distance<T> *)new AVX512NormalizedCosineDistanceFloat();
+#endif
         return (Distance<T> *)new AVXNormalizedCosineDistanceFloat();
     }
     else
@@ -65,15 +106,17 @@ template <typename T> Distance<T> *IndexFactory::construct_inmem_distance_fn(Met
 template <typename T>
 std::shared_ptr<AbstractDataStore<T>> IndexFactory::construct_datastore(DataStoreStrategy strategy,
                                                                         size_t total_internal_points, size_t dimension,
-                                                                        Metric metric)
+                                                                        Metric metric, bool precompute_norms)
 {
     std::unique_ptr<Distance<T>> distance;
     switch (strategy)
     {
     case DataStoreStrategy::MEMORY:
+    case DataStoreStrategy::MMAP:
+    case DataStoreStrategy::MMAP_BUILD:
         distance.reset(construct_inmem_distance_fn<T>(metric));
         return std::make_shared<diskann::InMemDataStore<T>>((location_t)total_internal_points, dimension,
-                                                            std::move(distance));
+                                                            std::move(distance), precompute_norms);
     default:
         break;
     }
@@ -88,11 +131,83 @@ std::unique_ptr<AbstractGraphStore> IndexFactory::construct_graphstore(const Gra
     {
     case GraphStoreStrategy::MEMORY:
         return std::make_unique<InMemGraphStore>(size, reserve_graph_degree);
+    case GraphStoreStrategy::FLAT:
+    case GraphStoreStrategy::MMAP:
+        return std::make_unique<FlatGraphStore>(size, reserve_graph_degree);
+    case GraphStoreStrategy::COMPRESSED:
+        return std::make_unique<CompressedGraphStore>(size, reserve_graph_degree);
     default:
         throw ANNException("Error : Current GraphStoreStratagy is not supported.", -1);
     }
 }
 
+MemoryUsage IndexFactory::estimate_memory_usage(const IndexConfig &config)
+{
+    const size_t type_size = config.data_type == std::string("float") ? sizeof(float) : sizeof(uint8_t);
+    const size_t tag_size =
+        (config.tag_type == std::string("int64") || config.tag_type == std::string("uint64")) ? 8 : 4;
+    const size_t num_frozen_pts =
+        (config.dynamic_index && config.num_frozen_pts == 0) ? (size_t)1 : config.num_frozen_pts;
+    const size_t num_points = config.max_points + num_frozen_pts;
+    const size_t dim = config.dimension;
+    const size_t aligned_dim = ROUND_UP(dim, 8);
+    const uint32_t R = config.index_write_params == nullptr ? 0 : config.index_write_params->max_degree;
+    const size_t reserve_degree = (size_t)(defaults::GRAPH_SLACK_FACTOR * 1.05 * R);
+
+    MemoryUsage usage;
+    // a mapped build reads the vectors from the page cache, which the kernel
+    // can reclaim
+    if (config.data_strategy != DataStoreStrategy::MMAP_BUILD)
+        usage.add("data", (uint64_t)num_points * aligned_dim * type_size);
+    if (config.graph_strategy == GraphStoreStrategy::MEMORY)
+        usage.add("graph", (uint64_t)num_points * (sizeof(std::vector<uint32_t>) + reserve_degree * sizeof(uint32_t)));
+    else
+        usage.add("graph", (uint64_t)num_points * (reserve_degree + 1) * sizeof(uint32_t));
+    if ((config.data_strategy == DataStoreStrategy::MEMORY || config.data_strategy == DataStoreStrategy::MMAP_BUILD) &&
+        config.pq_dist_build)
+    {
+        usage.add("pq_data", (uint64_t)num_points * config.num_pq_chunks);
+        usage.add("pq_table", (NUM_PQ_CENTROIDS + 1) * dim * sizeof(float) +
+                                  (config.use_opq ? dim * dim * sizeof(float) : 0));
+    }
+    else if (config.num_sq_bits != 0)
+    {
+        usage.add("pq_data", (uint64_t)num_points * DIV_ROUND_UP(dim * config.num_sq_bits, 8) +
+                                 2 * dim * sizeof(float));
+    }
+    else if (config.num_pca_dims != 0)
+    {
+        usage.add("pq_data", (uint64_t)num_points * ROUND_UP(config.num_pca_dims, 8) * sizeof(float) +
+                                 ROUND_UP(config.num_pca_dims, 8) * dim * sizeof(float));
+    }
+    usage.add("locks", (config.num_lock_stripes == 0 ? num_points : config.num_lock_stripes) *
+                           sizeof(non_recursive_mutex));
+    // the tag of each location with its bitset, and the location of each tag
+    // in a sparse map
+    if (config.enable_tags)
+        usage.add("tags", (uint64_t)num_points * (2 * tag_size + sizeof(uint32_t)) + num_points / 8 + num_points / 4);
+    usage.add("deletes", (uint64_t)num_points * sizeof(uint32_t) + DIV_ROUND_UP(num_points, 64) * sizeof(uint64_t));
+
+    // one InMemQueryScratch per search and build thread, sized as
+    // Index::initialize_query_scratch() and iterate_to_fixed_point() do
+    if (config.index_write_params != nullptr && config.index_search_params != nullptr)
+    {
+        const IndexWriteParameters &write_params = *config.index_write_params;
+        const size_t L = std::max(config.index_search_params->initial_search_list_size, write_params.search_list_size);
+        const size_t slack_R = (size_t)std::ceil(1.5 * defaults::GRAPH_SLACK_FACTOR * R);
+        const size_t visited = num_points <= defaults::VISITED_ARRAY_MAX_POINTS
+                                   ? num_points * sizeof(uint16_t)
+                                   : 4 * L * R * 2 * sizeof(uint32_t); // at most 4 * L * R slots
+        const uint64_t per_scratch = aligned_dim * type_size + (3 * L + R) * sizeof(Neighbor) +
+                                     (L + 1) * (sizeof(uint64_t) + sizeof(uint8_t)) +
+                                     write_params.max_occlusion_size * sizeof(float) +
+                                     slack_R * (sizeof(uint32_t) + sizeof(float)) + visited +
+                                     sizeof(InMemQueryScratch<float>);
+        usage.add("scratch", per_scratch * (config.index_search_params->num_search_threads + write_params.num_threads));
+    }
+    return usage;
+}
+
 template <typename T>
 std::shared_ptr<PQDataStore<T>> IndexFactory::construct_pq_datastore(DataStoreStrategy strategy, size_t num_points,
                                                                      size_t dimension, Metric m, size_t num_pq_chunks,
@@ -115,21 +230,73 @@ std::shared_ptr<PQDataStore<T>> IndexFactory::construct_pq_datastore(DataStoreSt
     return nullptr;
 }
 
+template <typename T>
+std::shared_ptr<SQDataStore<T>> IndexFactory::construct_sq_datastore(DataStoreStrategy strategy, size_t num_points,
+                                                                     size_t dimension, Metric m, size_t num_sq_bits)
+{
+    std::unique_ptr<Distance<T>> distance_fn;
+    switch (strategy)
+    {
+    case DataStoreStrategy::MEMORY:
+        distance_fn.reset(construct_inmem_distance_fn<T>(m));
+        return std::make_shared<diskann::SQDataStore<T>>(dimension, (location_t)num_points, (uint32_t)num_sq_bits,
+                                                         std::move(distance_fn));
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+template <typename T>
+std::shared_ptr<PCADataStore<T>> IndexFactory::construct_pca_datastore(DataStoreStrategy strategy, size_t num_points,
+                                                                       size_t dimension, Metric m, size_t num_pca_dims)
+{
+    std::unique_ptr<Distance<T>> distance_fn;
+    switch (strategy)
+    {
+    case DataStoreStrategy::MEMORY:
+        distance_fn.reset(construct_inmem_distance_fn<T>(m));
+        return std::make_shared<diskann::PCADataStore<T>>(dimension, (location_t)num_points, (uint32_t)num_pca_dims,
+                                                          std::move(distance_fn));
+    default:
+        break;
+    }
+    return nullptr;
+}
+
 template <typename data_type, typename tag_type, typename label_type>
-std::unique_ptr<AbstractIndex> IndexFactory::create_instance()
+std::unique_ptr<Index<data_type, tag_type, label_type>> IndexFactory::construct_index()
 {
     size_t num_points = _config->max_points + _config->num_frozen_pts;
     size_t dim = _config->dimension;
     // auto graph_store = construct_graphstore(_config->graph_strategy, num_points);
-    auto data_store = construct_datastore<data_type>(_config->data_strategy, num_points, dim, _config->metric);
+    auto data_store = construct_datastore<data_type>(_config->data_strategy, num_points, dim, _config->metric,
+                                                     _config->precompute_norms);
     std::shared_ptr<AbstractDataStore<data_type>> pq_data_store = nullptr;
 
-    if (_config->data_strategy == DataStoreStrategy::MEMORY && _config->pq_dist_build)
+    if ((_config->data_strategy == DataStoreStrategy::MEMORY ||
+         _config->data_strategy == DataStoreStrategy::MMAP_BUILD) &&
+        _config->pq_dist_build)
     {
         pq_data_store =
-            construct_pq_datastore<data_type>(_config->data_strategy, num_points + _config->num_frozen_pts, dim,
+            construct_pq_datastore<data_type>(DataStoreStrategy::MEMORY, num_points + _config->num_frozen_pts, dim,
                                               _config->metric, _config->num_pq_chunks, _config->use_opq);
     }
+    else if (_config->num_sq_bits != 0)
+    {
+        // the codes are always held in memory, also in front of a mapped
+        // full precision store
+        pq_data_store =
+            construct_sq_datastore<data_type>(DataStoreStrategy::MEMORY, num_points + _config->num_frozen_pts, dim,
+                                              _config->metric, _config->num_sq_bits);
+    }
+    else if (_config->num_pca_dims != 0)
+    {
+        // held in memory like the SQ codes
+        pq_data_store =
+            construct_pca_datastore<data_type>(DataStoreStrategy::MEMORY, num_points + _config->num_frozen_pts, dim,
+                                               _config->metric, _config->num_pca_dims);
+    }
     else
     {
         pq_data_store = data_store;
@@ -146,6 +313,34 @@ std::unique_ptr<AbstractIndex> IndexFactory::create_instance()
                                                                              std::move(graph_store), pq_data_store);
 }
 
+template <typename data_type, typename tag_type, typename label_type>
+std::unique_ptr<AbstractIndex> IndexFactory::create_instance()
+{
+    return construct_index<data_type, tag_type, label_type>();
+}
+
+template <typename data_type, typename tag_type, typename label_type>
+std::unique_ptr<Index<data_type, tag_type, label_type>> IndexFactory::create_typed_instance()
+{
+    // the label types also go by uint and ushort
+    std::string config_label_type = _config->label_type;
+    if (config_label_type == "uint")
+        config_label_type = "uint32";
+    else if (config_label_type == "ushort")
+        config_label_type = "uint16";
+    if (_config->data_type != diskann_type_to_name<data_type>() ||
+        _config->tag_type != diskann_type_to_name<tag_type>() ||
+        config_label_type != diskann_type_to_name<label_type>())
+    {
+        throw ANNException(std::string("ERROR: the index config has data, tag and label types ") + _config->data_type +
+                               ", " + _config->tag_type + " and " + _config->label_type + ", not " +
+                               diskann_type_to_name<data_type>() + ", " + diskann_type_to_name<tag_type>() + " and " +
+                               diskann_type_to_name<label_type>(),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    return construct_index<data_type, tag_type, label_type>();
+}
+
 std::unique_ptr<AbstractIndex> IndexFactory::create_instance(const std::string &data_type, const std::string &tag_type,
                                                              const std::string &label_type)
 {
@@ -203,6 +398,31 @@ std::unique_ptr<AbstractIndex> IndexFactory::create_instance(const std::string &
         throw ANNException("Error: unsupported label_type please choose from [uint/ushort]", -1);
 }
 
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, int32_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, int32_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, int32_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, uint32_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, uint32_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, uint32_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, int64_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, int64_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, int64_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, uint64_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, uint64_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, uint64_t, uint32_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, int32_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, int32_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, int32_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, uint32_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, uint32_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, uint32_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, int64_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, int64_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, int64_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<float, uint64_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<uint8_t, uint64_t, uint16_t>> IndexFactory::create_typed_instance();
+template DISKANN_DLLEXPORT std::unique_ptr<Index<int8_t, uint64_t, uint16_t>> IndexFactory::create_typed_instance();
+
 // template DISKANN_DLLEXPORT std::shared_ptr<AbstractDataStore<uint8_t>> IndexFactory::construct_datastore(
 //     DataStoreStrategy stratagy, size_t num_points, size_t dimension, Metric m);
 // template DISKANN_DLLEXPORT std::shared_ptr<AbstractDataStore<int8_t>> IndexFactory::construct_datastore(
@@ -210,4 +430,15 @@ std::unique_ptr<AbstractIndex> IndexFactory::create_instance(const std::string &
 // template DISKANN_DLLEXPORT std::shared_ptr<AbstractDataStore<float>> IndexFactory::construct_datastore(
 //     DataStoreStrategy stratagy, size_t num_points, size_t dimension, Metric m);
 
+// The 16-bit types are only built through the disk index path, which constructs
+// Index directly rather than through create_instance.
+template DISKANN_DLLEXPORT std::shared_ptr<AbstractDataStore<float16>> IndexFactory::construct_datastore(
+    DataStoreStrategy stratagy, size_t num_points, size_t dimension, Metric m, bool precompute_norms);
+template DISKANN_DLLEXPORT std::shared_ptr<AbstractDataStore<bfloat16>> IndexFactory::construct_datastore(
+    DataStoreStrategy stratagy, size_t num_points, size_t dimension, Metric m, bool precompute_norms);
+template DISKANN_DLLEXPORT std::shared_ptr<PQDataStore<float16>> IndexFactory::construct_pq_datastore(
+    DataStoreStrategy strategy, size_t num_points, size_t dimension, Metric m, size_t num_pq_chunks, bool use_opq);
+template DISKANN_DLLEXPORT std::shared_ptr<PQDataStore<bfloat16>> IndexFactory::construct_pq_datastore(
+    DataStoreStrategy strategy, size_t num_points, size_t dimension, Metric m, size_t num_pq_chunks, bool use_opq);
+
 } // namespace diskann
@@ -0,0 +1,392 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "io_uring_aligned_file_reader.h"
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <liburing.h>
+#include "ann_exception.h"
+#include "logger.h"
+#include "utils.h"
+
+#define URING_ENTRIES 1024
+
+struct IoUringAlignedFileReader::RingContext
+{
+    struct io_uring ring;
+    bool file_registered = false;
+    char *fixed_buf = nullptr;
+    size_t fixed_len = 0;
+};
+
+IoUringAlignedFileReader::IoUringAlignedFileReader(bool use_sqpoll, uint32_t sqpoll_idle_ms)
+    : _use_sqpoll(use_sqpoll), _sqpoll_idle_ms(sqpoll_idle_ms)
+{
+    this->file_desc = -1;
+}
+
+IoUringAlignedFileReader::~IoUringAlignedFileReader()
+{
+    deregister_all_threads();
+    if (this->file_desc != -1)
+    {
+        ::close(this->file_desc);
+    }
+}
+
+IoUringAlignedFileReader::RingContext *IoUringAlignedFileReader::to_ring(IOContext &ctx)
+{
+    return reinterpret_cast<RingContext *>(ctx);
+}
+
+void IoUringAlignedFileReader::register_file(RingContext *ctx)
+{
+    if (this->file_desc == -1 || ctx->file_registered)
+        return;
+    int ret = io_uring_register_files(&ctx->ring, &this->file_desc, 1);
+    if (ret != 0)
+    {
+        diskann::cerr << "io_uring_register_files() failed; returned " << ret << ": " << ::strerror(-ret)
+                      << ". Falling back to unregistered fd." << std::endl;
+        return;
+    }
+    ctx->file_registered = true;
+}
+
+void IoUringAlignedFileReader::destroy_ring(IOContext ctx)
+{
+    RingContext *rctx = to_ring(ctx);
+    if (rctx->fixed_buf != nullptr)
+        io_uring_unregister_buffers(&rctx->ring);
+    if (rctx->file_registered)
+        io_uring_unregister_files(&rctx->ring);
+    io_uring_queue_exit(&rctx->ring);
+    delete rctx;
+}
+
+IoUringAlignedFileReader::RingContext *IoUringAlignedFileReader::new_ring()
+{
+    RingContext *rctx = new RingContext();
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (_use_sqpoll)
+    {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = _sqpoll_idle_ms;
+    }
+    int ret = io_uring_queue_init_params(URING_ENTRIES, &rctx->ring, &params);
+    if (ret != 0)
+    {
+        delete rctx;
+        std::stringstream stream;
+        stream << "io_uring_queue_init_params() failed; returned " << ret << ": " << ::strerror(-ret);
+        if (_use_sqpoll && ret == -EPERM)
+            stream << ". SQPOLL may require CAP_SYS_NICE on this kernel.";
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    return rctx;
+}
+
+IOContext &IoUringAlignedFileReader::get_ctx()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    auto iter = ctx_map.find(std::this_thread::get_id());
+    if (iter == ctx_map.end())
+    {
+        lk.unlock();
+        register_thread();
+        lk.lock();
+        iter = ctx_map.find(std::this_thread::get_id());
+    }
+    if (iter == ctx_map.end())
+    {
+        std::cerr << "bad thread access; returning -1 as io_context_t" << std::endl;
+        return this->bad_ctx;
+    }
+    return iter.value();
+}
+
+IOContext IoUringAlignedFileReader::create_ctx()
+{
+    RingContext *rctx = new_ring();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    register_file(rctx);
+    owned_ctxs.push_back(reinterpret_cast<IOContext>(rctx));
+    return reinterpret_cast<IOContext>(rctx);
+}
+
+void IoUringAlignedFileReader::register_thread()
+{
+    auto my_id = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    if (ctx_map.find(my_id) != ctx_map.end())
+    {
+        std::cerr << "multiple calls to register_thread from the same thread" << std::endl;
+        return;
+    }
+
+    RingContext *rctx = new_ring();
+    register_file(rctx);
+
+    diskann::cout << "allocating io_uring ctx: " << rctx << " to thread-id:" << my_id << std::endl;
+    ctx_map[my_id] = reinterpret_cast<IOContext>(rctx);
+    lk.unlock();
+}
+
+void IoUringAlignedFileReader::deregister_thread()
+{
+    auto my_id = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    auto iter = ctx_map.find(my_id);
+    if (iter == ctx_map.end())
+        return;
+    destroy_ring(iter->second);
+    ctx_map.erase(iter);
+    std::cerr << "returned ctx from thread-id:" << my_id << std::endl;
+    lk.unlock();
+}
+
+void IoUringAlignedFileReader::deregister_all_threads()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    for (auto x = ctx_map.begin(); x != ctx_map.end(); x++)
+    {
+        destroy_ring(x.value());
+    }
+    ctx_map.clear();
+    for (IOContext ctx : owned_ctxs)
+        destroy_ring(ctx);
+    owned_ctxs.clear();
+}
+
+void IoUringAlignedFileReader::reset_after_fork()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    std::vector<IOContext> ctxs(owned_ctxs);
+    for (auto x = ctx_map.begin(); x != ctx_map.end(); x++)
+        ctxs.push_back(x.value());
+    for (IOContext ctx : ctxs)
+    {
+        RingContext *rctx = to_ring(ctx);
+        io_uring_queue_exit(&rctx->ring);
+        delete rctx;
+    }
+    ctx_map.clear();
+    owned_ctxs.clear();
+}
+
+void IoUringAlignedFileReader::register_buffer(IOContext &ctx, void *buf, size_t len)
+{
+    RingContext *rctx = to_ring(ctx);
+    if (ctx == bad_ctx || rctx->fixed_buf != nullptr)
+        return;
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    int ret = io_uring_register_buffers(&rctx->ring, &iov, 1);
+    if (ret != 0)
+    {
+        diskann::cerr << "io_uring_register_buffers() failed; returned " << ret << ": " << ::strerror(-ret)
+                      << ". Reads will not use fixed buffers." << std::endl;
+        return;
+    }
+    rctx->fixed_buf = (char *)buf;
+    rctx->fixed_len = len;
+}
+
+void IoUringAlignedFileReader::open(const std::string &fname)
+{
+    int flags = O_DIRECT | O_RDONLY | O_LARGEFILE;
+    this->file_desc = ::open(fname.c_str(), flags);
+    // error checks
+    assert(this->file_desc != -1);
+    std::cerr << "Opened file : " << fname << std::endl;
+
+    // rings created before open() still need the file
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    for (auto x = ctx_map.begin(); x != ctx_map.end(); x++)
+    {
+        register_file(to_ring(x.value()));
+    }
+    for (IOContext &ctx : owned_ctxs)
+        register_file(to_ring(ctx));
+}
+
+void IoUringAlignedFileReader::close()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    std::vector<RingContext *> rings;
+    for (auto x = ctx_map.begin(); x != ctx_map.end(); x++)
+        rings.push_back(to_ring(x.value()));
+    for (IOContext &ctx : owned_ctxs)
+        rings.push_back(to_ring(ctx));
+    for (RingContext *rctx : rings)
+    {
+        if (rctx->file_registered)
+        {
+            io_uring_unregister_files(&rctx->ring);
+            rctx->file_registered = false;
+        }
+    }
+    lk.unlock();
+
+    ::close(this->file_desc);
+    this->file_desc = -1;
+}
+
+void IoUringAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
+{
+    if (async == true)
+    {
+        diskann::cout << "Async currently not supported in linux." << std::endl;
+    }
+    assert(this->file_desc != -1);
+    RingContext *rctx = to_ring(ctx);
+    struct io_uring *ring = &rctx->ring;
+
+    // break-up requests into chunks of size URING_ENTRIES each
+    uint64_t n_iters = ROUND_UP(read_reqs.size(), URING_ENTRIES) / URING_ENTRIES;
+    for (uint64_t iter = 0; iter < n_iters; iter++)
+    {
+        uint64_t n_ops = std::min((uint64_t)read_reqs.size() - (iter * URING_ENTRIES), (uint64_t)URING_ENTRIES);
+        for (uint64_t j = 0; j < n_ops; j++)
+        {
+            AlignedRead &req = read_reqs[j + iter * URING_ENTRIES];
+            struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+            if (sqe == nullptr)
+            {
+                throw diskann::ANNException("io_uring submission queue full", -1, __FUNCSIG__, __FILE__, __LINE__);
+            }
+
+            int fd = rctx->file_registered ? 0 : this->file_desc;
+            char *buf = (char *)req.buf;
+            if (rctx->fixed_buf != nullptr && buf >= rctx->fixed_buf &&
+                buf + req.len <= rctx->fixed_buf + rctx->fixed_len)
+                io_uring_prep_read_fixed(sqe, fd, buf, (unsigned)req.len, req.offset, 0);
+            else
+                io_uring_prep_read(sqe, fd, buf, (unsigned)req.len, req.offset);
+            if (rctx->file_registered)
+                io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+            io_uring_sqe_set_data64(sqe, j);
+        }
+
+        // one io_uring_enter() submits the batch and waits for all of it
+        int ret = io_uring_submit_and_wait(ring, (unsigned)n_ops);
+        if (ret < 0 || (uint64_t)ret != n_ops)
+        {
+            std::stringstream stream;
+            stream << "io_uring_submit_and_wait() failed; returned " << ret << ", expected=" << n_ops;
+            if (ret < 0)
+                stream << ", " << ::strerror(-ret);
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+
+        uint64_t n_done = 0;
+        while (n_done < n_ops)
+        {
+            struct io_uring_cqe *cqe = nullptr;
+            ret = io_uring_wait_cqe(ring, &cqe);
+            if (ret < 0)
+            {
+                std::stringstream stream;
+                stream << "io_uring_wait_cqe() failed; returned " << ret << ": " << ::strerror(-ret);
+                throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+            }
+            uint64_t idx = io_uring_cqe_get_data64(cqe);
+            int64_t res = cqe->res;
+            io_uring_cqe_seen(ring, cqe);
+            if (res < 0)
+            {
+                std::stringstream stream;
+                stream << "io_uring read failed for request " << idx + iter * URING_ENTRIES << "; returned " << res
+                       << ", " << ::strerror((int)-res);
+                throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+            }
+            n_done++;
+        }
+    }
+}
+
+void IoUringAlignedFileReader::submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx)
+{
+    assert(this->file_desc != -1);
+    RingContext *rctx = to_ring(ctx);
+    struct io_uring *ring = &rctx->ring;
+    if (read_reqs.size() > URING_ENTRIES)
+    {
+        throw diskann::ANNException("submit_reads() supports at most URING_ENTRIES outstanding reads", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    for (uint64_t j = 0; j < read_reqs.size(); j++)
+    {
+        AlignedRead &req = read_reqs[j];
+        struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        if (sqe == nullptr)
+        {
+            throw diskann::ANNException("io_uring submission queue full", -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+
+        int fd = rctx->file_registered ? 0 : this->file_desc;
+        char *buf = (char *)req.buf;
+        if (rctx->fixed_buf != nullptr && buf >= rctx->fixed_buf && buf + req.len <= rctx->fixed_buf + rctx->fixed_len)
+            io_uring_prep_read_fixed(sqe, fd, buf, (unsigned)req.len, req.offset, 0);
+        else
+            io_uring_prep_read(sqe, fd, buf, (unsigned)req.len, req.offset);
+        if (rctx->file_registered)
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        io_uring_sqe_set_data64(sqe, j);
+    }
+
+    int ret = io_uring_submit(ring);
+    if (ret < 0 || (uint64_t)ret != read_reqs.size())
+    {
+        std::stringstream stream;
+        stream << "io_uring_submit() failed; returned " << ret << ", expected=" << read_reqs.size();
+        if (ret < 0)
+            stream << ", " << ::strerror(-ret);
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+}
+
+void IoUringAlignedFileReader::reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                                          std::vector<uint64_t> &completed)
+{
+    struct io_uring *ring = &to_ring(ctx)->ring;
+    min_completions = std::min(min_completions, max_completions);
+
+    uint64_t n_reaped = 0;
+    while (n_reaped < max_completions)
+    {
+        struct io_uring_cqe *cqe = nullptr;
+        // block only while we are short of min_completions, then drain what is ready
+        int ret = n_reaped < min_completions ? io_uring_wait_cqe(ring, &cqe) : io_uring_peek_cqe(ring, &cqe);
+        if (ret == -EAGAIN || ret == -EINTR)
+        {
+            if (n_reaped >= min_completions)
+                break;
+            continue;
+        }
+        if (ret < 0)
+        {
+            std::stringstream stream;
+            stream << "io_uring_wait_cqe() failed; returned " << ret << ": " << ::strerror(-ret);
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        uint64_t idx = io_uring_cqe_get_data64(cqe);
+        int64_t res = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+        if (res < 0)
+        {
+            std::stringstream stream;
+            stream << "io_uring read failed for request " << idx << "; returned " << res << ", "
+                   << ::strerror((int)-res);
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        completed.push_back(idx);
+        n_reaped++;
+    }
+}
@@ -0,0 +1,287 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <omp.h>
+
+#include "label_bitmap.h"
+#include "ann_exception.h"
+#include "simd_utils.h"
+#include "utils.h"
+
+#ifdef _WINDOWS
+#define AVX512_TARGET
+#else
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni")))
+#endif
+
+namespace diskann
+{
+template <typename LabelT>
+void LabelBitmap::build(size_t num_points, const uint32_t *offsets, const uint32_t *counts, const LabelT *labels)
+{
+    build_from<LabelT>(num_points, [&](size_t i, const LabelT *&first, size_t &count) {
+        first = labels + offsets[i];
+        count = counts[i];
+    });
+}
+
+template <typename LabelT>
+void LabelBitmap::build(size_t num_points, const std::vector<std::vector<LabelT>> &point_labels)
+{
+    if (point_labels.size() < num_points)
+        throw ANNException("LabelBitmap: labels given for " + std::to_string(point_labels.size()) + " of " +
+                               std::to_string(num_points) + " points",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    build_from<LabelT>(num_points, [&](size_t i, const LabelT *&first, size_t &count) {
+        first = point_labels[i].data();
+        count = point_labels[i].size();
+    });
+}
+
+template <typename LabelT, typename GetLabels> void LabelBitmap::build_from(size_t num_points, GetLabels get_labels)
+{
+    clear();
+    if (num_points == 0)
+        return;
+    if (num_points > (size_t)UINT32_MAX)
+        throw ANNException("LabelBitmap: too many points", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    const LabelT *lbls;
+    size_t nlbls;
+    uint64_t max_label = 0;
+    for (size_t i = 0; i < num_points; i++)
+    {
+        get_labels(i, lbls, nlbls);
+        for (size_t j = 0; j < nlbls; j++)
+            max_label = std::max(max_label, (uint64_t)lbls[j]);
+    }
+
+    // number of points with each label, kept where the slot will go
+    _use_slot_map = max_label >= std::max<uint64_t>(num_points, 1 << 16);
+    std::vector<uint32_t> label_of_slot;
+    std::vector<uint64_t> freq;
+    if (!_use_slot_map)
+        _slot_table.assign(max_label + 1, NO_SLOT);
+    auto slot_of = [&](uint32_t label) -> uint32_t & {
+        return _use_slot_map ? _slot_map[label] : _slot_table[label];
+    };
+    for (size_t i = 0; i < num_points; i++)
+    {
+        get_labels(i, lbls, nlbls);
+        for (size_t j = 0; j < nlbls; j++)
+        {
+            const uint32_t label = (uint32_t)lbls[j];
+            if (_use_slot_map && _slot_map.find(label) == _slot_map.end())
+                _slot_map[label] = NO_SLOT;
+            uint32_t &slot = slot_of(label);
+            if (slot == NO_SLOT)
+            {
+                slot = (uint32_t)freq.size();
+                label_of_slot.push_back(label);
+                freq.push_back(0);
+            }
+            freq[slot]++;
+        }
+    }
+
+    // renumber the slots: dense labels first, in order of first appearance
+    const size_t num_labels = freq.size();
+    std::vector<uint32_t> new_slot(num_labels);
+    std::vector<uint32_t> sparse_labels;
+    for (size_t s = 0; s < num_labels; s++)
+    {
+        if (freq[s] * DENSE_RATIO >= num_points)
+            new_slot[s] = _num_dense++;
+        else
+            sparse_labels.push_back((uint32_t)s);
+    }
+    for (size_t i = 0; i < sparse_labels.size(); i++)
+        new_slot[sparse_labels[i]] = _num_dense + (uint32_t)i;
+    for (size_t s = 0; s < num_labels; s++)
+        slot_of(label_of_slot[s]) = new_slot[s];
+
+    // dense rows; each thread sets the bits of whole words
+    _num_points = num_points;
+    _words_per_row = (num_points + 63) / 64;
+    _dense_bits.assign(_num_dense * _words_per_row, 0);
+    if (_num_dense > 0)
+    {
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int64_t w = 0; w < (int64_t)_words_per_row; w++)
+        {
+            const LabelT *first;
+            size_t count;
+            const size_t end = std::min(num_points, (size_t)(w + 1) * 64);
+            for (size_t i = (size_t)w * 64; i < end; i++)
+            {
+                get_labels(i, first, count);
+                for (size_t j = 0; j < count; j++)
+                {
+                    const uint32_t slot = find_slot((uint32_t)first[j]);
+                    if (slot < _num_dense)
+                        _dense_bits[slot * _words_per_row + w] |= (uint64_t)1 << (i & 63);
+                }
+            }
+        }
+    }
+
+    // sparse labels: gather the ids of each label in order, then cut them into
+    // chunks
+    const size_t num_sparse = sparse_labels.size();
+    std::vector<uint64_t> list_begin(num_sparse + 1, 0);
+    for (size_t i = 0; i < num_sparse; i++)
+        list_begin[i + 1] = list_begin[i] + freq[sparse_labels[i]];
+    std::vector<uint32_t> ids(list_begin[num_sparse]);
+    std::vector<uint64_t> list_end(list_begin.begin(), list_begin.end() - 1);
+    for (size_t i = 0; i < num_points; i++)
+    {
+        get_labels(i, lbls, nlbls);
+        for (size_t j = 0; j < nlbls; j++)
+        {
+            const uint32_t slot = find_slot((uint32_t)lbls[j]);
+            if (slot < _num_dense)
+                continue;
+            uint64_t &end = list_end[slot - _num_dense];
+            // a label repeated on a point is stored once
+            if (end == list_begin[slot - _num_dense] || ids[end - 1] != (uint32_t)i)
+                ids[end++] = (uint32_t)i;
+        }
+    }
+
+    _sparse_begin.assign(num_sparse + 1, 0);
+    for (size_t l = 0; l < num_sparse; l++)
+    {
+        for (uint64_t pos = list_begin[l]; pos < list_end[l];)
+        {
+            const uint32_t key = ids[pos] >> 16;
+            uint64_t chunk_end = pos;
+            while (chunk_end < list_end[l] && (ids[chunk_end] >> 16) == key)
+                chunk_end++;
+
+            Container container;
+            container.key = key;
+            container.cardinality = (uint32_t)(chunk_end - pos);
+            if (container.cardinality > ARRAY_MAX_SIZE)
+            {
+                container.offset = _chunk_bits.size();
+                _chunk_bits.resize(_chunk_bits.size() + CHUNK_WORDS, 0);
+                for (uint64_t k = pos; k < chunk_end; k++)
+                {
+                    const uint32_t low = ids[k] & 0xFFFF;
+                    _chunk_bits[container.offset + (low >> 6)] |= (uint64_t)1 << (low & 63);
+                }
+            }
+            else
+            {
+                container.offset = _array_values.size();
+                for (uint64_t k = pos; k < chunk_end; k++)
+                    _array_values.push_back((uint16_t)(ids[k] & 0xFFFF));
+            }
+            _containers.push_back(container);
+            pos = chunk_end;
+        }
+        _sparse_begin[l + 1] = _containers.size();
+    }
+    _containers.shrink_to_fit();
+    _array_values.shrink_to_fit();
+}
+
+void LabelBitmap::clear()
+{
+    _num_points = 0;
+    _use_slot_map = false;
+    _slot_table.clear();
+    _slot_table.shrink_to_fit();
+    _slot_map.clear();
+    _num_dense = 0;
+    _words_per_row = 0;
+    _dense_bits.clear();
+    _dense_bits.shrink_to_fit();
+    _sparse_begin.clear();
+    _containers.clear();
+    _containers.shrink_to_fit();
+    _array_values.clear();
+    _array_values.shrink_to_fit();
+    _chunk_bits.clear();
+    _chunk_bits.shrink_to_fit();
+}
+
+size_t LabelBitmap::memory_size() const
+{
+    return _slot_table.size() * sizeof(uint32_t) + _slot_map.size() * 2 * sizeof(uint32_t) +
+           _dense_bits.size() * sizeof(uint64_t) + _sparse_begin.size() * sizeof(uint64_t) +
+           _containers.size() * sizeof(Container) + _array_values.size() * sizeof(uint16_t) +
+           _chunk_bits.size() * sizeof(uint64_t);
+}
+
+#ifndef USE_NEON
+// The bits of a dense row are read as 32-bit words, 16 ids at a time: gather
+// the word of each id, shift its bit down, and compress the ids whose bit is
+// set to the front.
+AVX512_TARGET static size_t avx512_select_dense(uint32_t *ids, size_t n, const uint64_t *row)
+{
+    const int *words = (const int *)row;
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i low_bits = _mm512_set1_epi32(31);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 tail = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        const __m512i id = _mm512_maskz_loadu_epi32(tail, ids + i);
+        const __m512i word =
+            _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), tail, _mm512_srli_epi32(id, 5), words, 4);
+        const __m512i bit = _mm512_srlv_epi32(word, _mm512_and_si512(id, low_bits));
+        const __mmask16 keep = _mm512_mask_test_epi32_mask(tail, bit, one);
+        // count never passes i, so this only overwrites ids already read
+        _mm512_mask_compressstoreu_epi32(ids + count, keep, id);
+#ifdef _WINDOWS
+        count += __popcnt(keep);
+#else
+        count += __builtin_popcount(keep);
+#endif
+    }
+    return count;
+}
+#endif
+
+size_t LabelBitmap::select(uint32_t *ids, size_t n, uint32_t label) const
+{
+    const uint32_t slot = find_slot(label);
+    if (slot == NO_SLOT)
+        return 0;
+
+    size_t count = 0;
+    if (slot < _num_dense)
+    {
+        const uint64_t *row = _dense_bits.data() + slot * _words_per_row;
+#ifndef USE_NEON
+        if (Avx512SupportedCPU)
+            return avx512_select_dense(ids, n, row);
+#endif
+        for (size_t i = 0; i < n; i++)
+        {
+            const uint32_t id = ids[i];
+            ids[count] = id;
+            count += (row[id >> 6] >> (id & 63)) & 1;
+        }
+        return count;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint32_t id = ids[i];
+        ids[count] = id;
+        count += sparse_contains(slot - _num_dense, id);
+    }
+    return count;
+}
+
+template DISKANN_DLLEXPORT void LabelBitmap::build<uint16_t>(size_t num_points, const uint32_t *offsets,
+                                                             const uint32_t *counts, const uint16_t *labels);
+template DISKANN_DLLEXPORT void LabelBitmap::build<uint32_t>(size_t num_points, const uint32_t *offsets,
+                                                             const uint32_t *counts, const uint32_t *labels);
+template DISKANN_DLLEXPORT void LabelBitmap::build<uint16_t>(
+    size_t num_points, const std::vector<std::vector<uint16_t>> &point_labels);
+template DISKANN_DLLEXPORT void LabelBitmap::build<uint32_t>(
+    size_t num_points, const std::vector<std::vector<uint32_t>> &point_labels);
+} // namespace diskann
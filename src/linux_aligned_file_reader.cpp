@@ -4,18 +4,149 @@
 #include "linux_aligned_file_reader.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 #include "tsl/robin_map.h"
 #include "utils.h"
 #define MAX_EVENTS 1024
 
+// the header of the completion ring that the kernel maps at the address of
+// an aio context; the events follow it
+#define AIO_RING_MAGIC 0xa10a10a1
+struct aio_ring
+{
+    unsigned id;
+    unsigned nr;
+    unsigned head;
+    unsigned tail;
+    unsigned magic;
+    unsigned compat_features;
+    unsigned incompat_features;
+    unsigned header_length;
+};
+
+// with IO metrics enabled, the data of an async read holds its submission
+// time in microseconds above the index of its request
+#define READ_INDEX_BITS 16
+#define READ_INDEX_MASK ((1ULL << READ_INDEX_BITS) - 1)
+
 namespace
 {
 typedef struct io_event io_event_t;
 typedef struct iocb iocb_t;
 
-void execute_io(io_context_t ctx, int fd, std::vector<AlignedRead> &read_reqs, uint64_t n_retries = 0)
+uint64_t now_us()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// reads in flight on each context of this thread. A context is used by one
+// thread at a time, and its user reaps all its reads before handing it on.
+uint64_t &context_depth(io_context_t ctx)
+{
+    thread_local tsl::robin_map<io_context_t, uint64_t> depths;
+    return depths[ctx];
+}
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// moves up to max_nr of the events completed on ctx to evts straight from its
+// ring, without a system call, and returns their number, or -1 if the ring
+// is not one this code knows. Only the thread using ctx may call it.
+int64_t user_getevents(io_context_t ctx, int64_t max_nr, io_event_t *evts)
+{
+    aio_ring *ring = (aio_ring *)ctx;
+    if (ring->magic != AIO_RING_MAGIC || ring->incompat_features != 0)
+        return -1;
+    const io_event_t *events = (const io_event_t *)((const char *)ring + sizeof(aio_ring));
+    const unsigned nr = ring->nr;
+    unsigned head = ring->head;
+    int64_t n = 0;
+    while (n < max_nr)
+    {
+        // the kernel writes an event before publishing it through tail
+        const unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+            break;
+        evts[n++] = events[head];
+        head = (head + 1) % nr;
+    }
+    if (n > 0)
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+// Reaps at least min_nr and at most max_nr events of ctx into evts and
+// returns their number, or a negative errno. With spin_us > 0, the ring is
+// first polled in user space for up to spin_us microseconds, and only what is
+// still missing then is waited for in io_getevents(); with min_nr == 0, the
+// events already completed are taken without a system call.
+int64_t get_events(io_context_t ctx, int64_t min_nr, int64_t max_nr, io_event_t *evts, uint32_t spin_us)
+{
+    int64_t n = 0;
+    if (spin_us > 0)
+    {
+        const uint64_t deadline = now_us() + spin_us;
+        while (true)
+        {
+            const int64_t ret = user_getevents(ctx, max_nr - n, evts + n);
+            if (ret < 0)
+                break;
+            n += ret;
+            if (n >= min_nr || now_us() >= deadline)
+                break;
+            cpu_relax();
+        }
+    }
+    while (n < min_nr)
+    {
+        const int64_t ret = io_getevents(ctx, min_nr - n, max_nr - n, evts + n, nullptr);
+        if (ret == -EINTR)
+            continue;
+        if (ret < 0)
+            return ret;
+        n += ret;
+    }
+    return n;
+}
+
+// waits for all n_ops reads submitted on ctx, recording, with metrics, the
+// latency of each from submit_us to the call that reaped it
+int64_t reap_all(io_context_t ctx, uint64_t n_ops, io_event_t *evts, uint64_t submit_us, diskann::IOMetrics *metrics,
+                 uint32_t spin_us)
+{
+    uint64_t n_reaped = 0;
+    while (n_reaped < n_ops)
+    {
+        int64_t ret = get_events(ctx, 1, (int64_t)(n_ops - n_reaped), evts + n_reaped, spin_us);
+        if (ret <= 0)
+            return ret;
+        if (metrics != nullptr)
+        {
+            const uint64_t latency_us = now_us() - submit_us;
+            for (int64_t i = 0; i < ret; i++)
+                metrics->record_completion(latency_us);
+        }
+        n_reaped += (uint64_t)ret;
+    }
+    return (int64_t)n_reaped;
+}
+
+void execute_io(io_context_t ctx, int fd, std::vector<AlignedRead> &read_reqs, diskann::IOMetrics *metrics,
+                uint32_t spin_us, uint64_t n_retries = 0)
 {
 #ifdef DEBUG
     for (auto &req : read_reqs)
@@ -54,6 +185,7 @@ void execute_io(io_context_t ctx, int fd, std::vector<AlignedRead> &read_reqs, u
         while (n_tries <= n_retries)
         {
             // issue reads
+            const uint64_t submit_us = metrics != nullptr ? now_us() : 0;
             int64_t ret = io_submit(ctx, (int64_t)n_ops, cbs.data());
             // if requests didn't get accepted
             if (ret != (int64_t)n_ops)
@@ -65,8 +197,18 @@ void execute_io(io_context_t ctx, int fd, std::vector<AlignedRead> &read_reqs, u
             }
             else
             {
-                // wait on io_getevents
-                ret = io_getevents(ctx, (int64_t)n_ops, (int64_t)n_ops, evts.data(), nullptr);
+                // wait on io_getevents; reaping as reads complete when timing
+                // them or polling for them
+                if (metrics != nullptr || spin_us > 0)
+                {
+                    if (metrics != nullptr)
+                        metrics->record_submit(n_ops, n_ops);
+                    ret = reap_all(ctx, n_ops, evts.data(), submit_us, metrics, spin_us);
+                }
+                else
+                {
+                    ret = io_getevents(ctx, (int64_t)n_ops, (int64_t)n_ops, evts.data(), nullptr);
+                }
                 // if requests didn't complete
                 if (ret != (int64_t)n_ops)
                 {
@@ -91,7 +233,7 @@ void execute_io(io_context_t ctx, int fd, std::vector<AlignedRead> &read_reqs, u
 }
 } // namespace
 
-LinuxAlignedFileReader::LinuxAlignedFileReader()
+LinuxAlignedFileReader::LinuxAlignedFileReader(uint32_t busy_poll_us) : _busy_poll_us(busy_poll_us)
 {
     this->file_desc = -1;
 }
@@ -121,16 +263,37 @@ LinuxAlignedFileReader::~LinuxAlignedFileReader()
 io_context_t &LinuxAlignedFileReader::get_ctx()
 {
     std::unique_lock<std::mutex> lk(ctx_mut);
-    // perform checks only in DEBUG mode
-    if (ctx_map.find(std::this_thread::get_id()) == ctx_map.end())
+    auto iter = ctx_map.find(std::this_thread::get_id());
+    if (iter == ctx_map.end())
+    {
+        lk.unlock();
+        register_thread();
+        lk.lock();
+        iter = ctx_map.find(std::this_thread::get_id());
+    }
+    if (iter == ctx_map.end())
     {
         std::cerr << "bad thread access; returning -1 as io_context_t" << std::endl;
         return this->bad_ctx;
     }
-    else
+    return iter.value();
+}
+
+io_context_t LinuxAlignedFileReader::create_ctx()
+{
+    io_context_t ctx = 0;
+    int ret = io_setup(MAX_EVENTS, &ctx);
+    if (ret != 0)
     {
-        return ctx_map[std::this_thread::get_id()];
+        std::stringstream stream;
+        stream << "io_setup() failed; returned " << ret << ": " << ::strerror(-ret);
+        if (ret == -EAGAIN)
+            stream << ". Consider increasing /proc/sys/fs/aio-max-nr";
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
     }
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    owned_ctxs.push_back(ctx);
+    return ctx;
 }
 
 void LinuxAlignedFileReader::register_thread()
@@ -193,6 +356,9 @@ void LinuxAlignedFileReader::deregister_all_threads()
         //  std::cerr << "returned ctx from thread-id:" << my_id << std::endl;
     }
     ctx_map.clear();
+    for (io_context_t ctx : owned_ctxs)
+        io_destroy(ctx);
+    owned_ctxs.clear();
     //  lk.unlock();
 }
 
@@ -224,5 +390,93 @@ void LinuxAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, io_contex
         diskann::cout << "Async currently not supported in linux." << std::endl;
     }
     assert(this->file_desc != -1);
-    execute_io(ctx, this->file_desc, read_reqs);
+    execute_io(ctx, this->file_desc, read_reqs, this->io_metrics.get(), _busy_poll_us);
+}
+
+void LinuxAlignedFileReader::enable_io_metrics()
+{
+    if (this->io_metrics == nullptr)
+        this->io_metrics.reset(new diskann::IOMetrics());
+}
+
+diskann::IOMetrics *LinuxAlignedFileReader::get_io_metrics()
+{
+    return this->io_metrics.get();
+}
+
+void LinuxAlignedFileReader::submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx)
+{
+    assert(this->file_desc != -1);
+    uint64_t n_ops = read_reqs.size();
+    if (n_ops > MAX_EVENTS)
+    {
+        throw diskann::ANNException("submit_reads() supports at most MAX_EVENTS outstanding reads", -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+    }
+
+    // the kernel copies each iocb during io_submit, so they need not outlive this call
+    diskann::IOMetrics *metrics = this->io_metrics.get();
+    const uint64_t submit_bits = metrics != nullptr ? now_us() << READ_INDEX_BITS : 0;
+    std::vector<iocb_t *> cbs(n_ops, nullptr);
+    std::vector<struct iocb> cb(n_ops);
+    for (uint64_t j = 0; j < n_ops; j++)
+    {
+        io_prep_pread(cb.data() + j, this->file_desc, read_reqs[j].buf, read_reqs[j].len, read_reqs[j].offset);
+        cb[j].data = (void *)(submit_bits | j);
+        cbs[j] = cb.data() + j;
+    }
+
+    int64_t ret = io_submit(ctx, (int64_t)n_ops, cbs.data());
+    if (ret != (int64_t)n_ops)
+    {
+        std::stringstream stream;
+        stream << "io_submit() failed; returned " << ret << ", expected=" << n_ops;
+        if (ret < 0)
+            stream << ", " << ::strerror((int)-ret);
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (metrics != nullptr)
+    {
+        uint64_t &depth = context_depth(ctx);
+        depth += n_ops;
+        metrics->record_submit(n_ops, depth);
+    }
+}
+
+void LinuxAlignedFileReader::reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                                        std::vector<uint64_t> &completed)
+{
+    io_event_t evts[MAX_IO_DEPTH];
+    max_completions = std::min(max_completions, (uint64_t)MAX_IO_DEPTH);
+    min_completions = std::min(min_completions, max_completions);
+
+    diskann::IOMetrics *metrics = this->io_metrics.get();
+    // a polling reader also takes the reads already completed beyond
+    // min_completions, which costs no system call
+    const int64_t ret = get_events(ctx, (int64_t)min_completions, (int64_t)max_completions, evts, _busy_poll_us);
+    if (ret < 0)
+    {
+        std::stringstream stream;
+        stream << "io_getevents() failed; returned " << ret << ", " << ::strerror((int)-ret);
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    // the submission time is truncated by the shift, which the wrapping
+    // subtraction undoes as long as a read takes under 2^48 us
+    const uint64_t reap_bits = metrics != nullptr ? now_us() << READ_INDEX_BITS : 0;
+    for (int64_t i = 0; i < ret; i++)
+    {
+        if ((int64_t)evts[i].res < 0)
+        {
+            std::stringstream stream;
+            stream << "async read failed; returned " << (int64_t)evts[i].res << ", "
+                   << ::strerror((int)-(int64_t)evts[i].res);
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        const uint64_t data = (uint64_t)evts[i].data;
+        completed.push_back(data & READ_INDEX_MASK);
+        if (metrics != nullptr)
+            metrics->record_completion((reap_bits - (data & ~READ_INDEX_MASK)) >> READ_INDEX_BITS);
+    }
+    if (metrics != nullptr)
+        context_depth(ctx) -= (uint64_t)ret;
 }
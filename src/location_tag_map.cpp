@@ -0,0 +1,176 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <thread>
+
+#include "location_tag_map.h"
+#include "tag_uint128.h"
+
+namespace diskann
+{
+static constexpr size_t invalid_position = (size_t)-1;
+
+template <typename Value> location_tag_map<Value>::location_tag_map() : _capacity(0), _size(0)
+{
+}
+
+template <typename Value> void location_tag_map<Value>::reserve(size_t count)
+{
+    if (count <= _capacity)
+        return;
+
+    // value-initialized, so every slot starts empty
+    std::unique_ptr<slot[]> slots(new slot[count]());
+    for (size_t key = 0; key < _capacity; key++)
+    {
+        slots[key].seq.store(_slots[key].seq.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        for (size_t w = 0; w < WORDS_PER_VALUE; w++)
+            slots[key].words[w].store(_slots[key].words[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    _slots = std::move(slots);
+    _capacity = count;
+}
+
+template <typename Value> size_t location_tag_map<Value>::size() const
+{
+    return _size.load(std::memory_order_relaxed);
+}
+
+template <typename Value> size_t location_tag_map<Value>::memory_size() const
+{
+    return _capacity * sizeof(slot);
+}
+
+template <typename Value> void location_tag_map<Value>::set(uint32_t key, Value value)
+{
+    if (key >= _capacity)
+        reserve((std::max)((size_t)key + 1, 2 * _capacity));
+
+    word_t words[WORDS_PER_VALUE] = {};
+    std::memcpy(words, &value, sizeof(Value));
+
+    slot &s = _slots[key];
+    const uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq | WRITING, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t w = 0; w < WORDS_PER_VALUE; w++)
+        s.words[w].store(words[w], std::memory_order_relaxed);
+    s.seq.store(((seq & ~(WRITING | PRESENT)) + SEQ_STEP) | PRESENT, std::memory_order_release);
+
+    if ((seq & PRESENT) == 0)
+        _size.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename Value> void location_tag_map<Value>::erase(uint32_t key)
+{
+    if (key >= _capacity)
+        return;
+
+    slot &s = _slots[key];
+    const uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    if ((seq & PRESENT) == 0)
+        return;
+    s.seq.store((seq & ~(WRITING | PRESENT)) + SEQ_STEP, std::memory_order_release);
+    _size.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <typename Value> uint32_t location_tag_map<Value>::stable_seq(const slot &s) const
+{
+    uint32_t seq = s.seq.load(std::memory_order_acquire);
+    while (seq & WRITING)
+    {
+        std::this_thread::yield();
+        seq = s.seq.load(std::memory_order_acquire);
+    }
+    return seq;
+}
+
+template <typename Value> bool location_tag_map<Value>::contains(uint32_t key) const
+{
+    return key < _capacity && (stable_seq(_slots[key]) & PRESENT) != 0;
+}
+
+template <typename Value> bool location_tag_map<Value>::try_get(uint32_t key, Value &value) const
+{
+    if (key >= _capacity)
+        return false;
+
+    const slot &s = _slots[key];
+    word_t words[WORDS_PER_VALUE];
+    while (true)
+    {
+        const uint32_t before = stable_seq(s);
+        if ((before & PRESENT) == 0)
+            return false;
+        for (size_t w = 0; w < WORDS_PER_VALUE; w++)
+            words[w] = s.words[w].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == before)
+            break;
+    }
+    std::memcpy(&value, words, sizeof(Value));
+    return true;
+}
+
+template <typename Value>
+typename location_tag_map<Value>::position location_tag_map<Value>::find_from(
+    size_t key, size_t keys_already_enumerated) const
+{
+    if (keys_already_enumerated >= size())
+        return position{invalid_position, keys_already_enumerated};
+    for (; key < _capacity; key++)
+    {
+        if (_slots[key].seq.load(std::memory_order_relaxed) & PRESENT)
+            return position{key, keys_already_enumerated};
+    }
+    return position{invalid_position, keys_already_enumerated};
+}
+
+template <typename Value>
+typename location_tag_map<Value>::position location_tag_map<Value>::find_first() const
+{
+    return find_from(0, 0);
+}
+
+template <typename Value>
+typename location_tag_map<Value>::position location_tag_map<Value>::find_next(const position &after_position) const
+{
+    return find_from(after_position._key + 1, after_position._keys_already_enumerated + 1);
+}
+
+template <typename Value> bool location_tag_map<Value>::position::is_valid() const
+{
+    return _key != invalid_position;
+}
+
+template <typename Value> Value location_tag_map<Value>::get(const position &pos) const
+{
+    assert(pos.is_valid());
+    Value value;
+    const bool found = try_get((uint32_t)pos._key, value);
+    assert(found);
+    (void)found;
+    return value;
+}
+
+template <typename Value> void location_tag_map<Value>::clear()
+{
+    for (size_t key = 0; key < _capacity; key++)
+    {
+        _slots[key].seq.store(0, std::memory_order_relaxed);
+        for (size_t w = 0; w < WORDS_PER_VALUE; w++)
+            _slots[key].words[w].store(0, std::memory_order_relaxed);
+    }
+    _size.store(0, std::memory_order_relaxed);
+}
+
+// Instantiate used templates.
+template class location_tag_map<int32_t>;
+template class location_tag_map<uint32_t>;
+template class location_tag_map<int64_t>;
+template class location_tag_map<uint64_t>;
+template class location_tag_map<tag_uint128>;
+} // namespace diskann
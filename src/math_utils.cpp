@@ -2,11 +2,16 @@
 // Licensed under the MIT license.
 
 #include <limits>
+#include <random>
+#include <vector>
 #include <malloc.h>
 #include <math_utils.h>
-#include <mkl.h>
+#include "blas_compat.h"
 #include "logger.h"
 #include "utils.h"
+#ifdef USE_CUDA
+#include "gpu_math_utils.h"
+#endif
 
 namespace math_utils
 {
@@ -146,7 +151,7 @@ void compute_closest_centers_in_block(const float *const data, const size_t num_
 
 void compute_closest_centers(float *data, size_t num_points, size_t dim, float *pivot_data, size_t num_centers,
                              size_t k, uint32_t *closest_centers_ivf, std::vector<size_t> *inverted_index,
-                             float *pts_norms_squared)
+                             float *pts_norms_squared, const float *center_penalties)
 {
     if (k > num_centers)
     {
@@ -154,6 +159,21 @@ void compute_closest_centers(float *data, size_t num_points, size_t dim, float *
         return;
     }
 
+#ifdef USE_CUDA
+    if (k <= gpu::MAX_K && center_penalties == NULL && gpu::is_available())
+    {
+        gpu::compute_closest_centers(data, num_points, dim, pivot_data, num_centers, k, closest_centers_ivf,
+                                     pts_norms_squared);
+        if (inverted_index != NULL)
+        {
+            for (size_t j = 0; j < num_points; j++)
+                for (size_t l = 0; l < k; l++)
+                    inverted_index[closest_centers_ivf[j * k + l]].push_back(j);
+        }
+        return;
+    }
+#endif
+
     bool is_norm_given_for_pts = (pts_norms_squared != NULL);
 
     float *pivs_norms_squared = new float[num_centers];
@@ -167,6 +187,13 @@ void compute_closest_centers(float *data, size_t num_points, size_t dim, float *
     if (!is_norm_given_for_pts)
         math_utils::compute_vecs_l2sq(pts_norms_squared, data, num_points, dim);
     math_utils::compute_vecs_l2sq(pivs_norms_squared, pivot_data, num_centers, dim);
+    // the distances are ranked as expanded, so the penalties go with the
+    // norms of the centers
+    if (center_penalties != NULL)
+    {
+        for (size_t c = 0; c < num_centers; c++)
+            pivs_norms_squared[c] += center_penalties[c];
+    }
     uint32_t *closest_centers = new uint32_t[PAR_BLOCK_SIZE * k];
     float *distance_matrix = new float[num_centers * PAR_BLOCK_SIZE];
 
@@ -353,6 +380,197 @@ float run_lloyds(float *data, size_t num_points, size_t dim, float *centers, con
     return residual;
 }
 
+float run_bounded_lloyds(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
+                         const size_t max_reps, std::vector<size_t> *closest_docs, uint32_t *closest_center)
+{
+    if (num_centers < 2)
+        return run_lloyds(data, num_points, dim, centers, num_centers, max_reps, closest_docs, closest_center);
+
+    bool ret_closest_docs = true;
+    bool ret_closest_center = true;
+    if (closest_docs == NULL)
+    {
+        closest_docs = new std::vector<size_t>[num_centers];
+        ret_closest_docs = false;
+    }
+    if (closest_center == NULL)
+    {
+        closest_center = new uint32_t[num_points];
+        ret_closest_center = false;
+    }
+
+    // upper: the distance of each point to its center; lower: a bound below
+    // the distance to any other center. The bounds are Euclidean, not
+    // squared, for the triangle inequality.
+    std::vector<float> upper(num_points);
+    std::vector<float> lower(num_points, 0);
+    // half the distance of each center to the closest other one
+    std::vector<float> half_gap(num_centers);
+    std::vector<float> moved(num_centers);
+    std::vector<float> old_centers(num_centers * dim);
+
+    // the points whose bounds overlap, and the buffers to compare a block of
+    // them to the centers
+    std::vector<size_t> scanned;
+    const size_t block_size = (std::max)((size_t)1024, ((size_t)1 << 22) / num_centers);
+    std::vector<float> block(block_size * dim);
+    std::vector<float> block_l2sq(block_size);
+    std::vector<uint32_t> block_closest(block_size);
+    std::vector<float> dist_matrix(block_size * num_centers);
+    std::vector<float> docs_l2sq(num_points);
+    std::vector<float> centers_l2sq(num_centers);
+    math_utils::compute_vecs_l2sq(docs_l2sq.data(), data, num_points, dim);
+
+    // the first assignment has no bounds to go by
+    math_utils::compute_closest_centers(data, num_points, dim, centers, num_centers, 1, closest_center, NULL,
+                                        docs_l2sq.data());
+
+    float residual = std::numeric_limits<float>::max();
+    float old_residual;
+    size_t num_scanned = 0;
+    size_t rep = 0;
+    for (; rep < max_reps; ++rep)
+    {
+        old_residual = residual;
+
+        if (rep > 0)
+        {
+#pragma omp parallel for schedule(dynamic, 16)
+            for (int64_t c = 0; c < (int64_t)num_centers; c++)
+            {
+                float closest = std::numeric_limits<float>::max();
+                for (size_t c2 = 0; c2 < num_centers; c2++)
+                {
+                    if (c2 == (size_t)c)
+                        continue;
+                    closest = (std::min)(closest, math_utils::calc_distance(centers + (size_t)c * dim,
+                                                                            centers + c2 * dim, dim));
+                }
+                half_gap[c] = std::sqrt(closest) / 2;
+            }
+
+            // a point can only be closer to another center than to its own
+            // if its distance to it is above both bounds; those points are
+            // compared to all the centers in blocks, as in lloyds_iter()
+            scanned.clear();
+            for (size_t i = 0; i < num_points; i++)
+            {
+                if (upper[i] > (std::max)(half_gap[closest_center[i]], lower[i]))
+                    scanned.push_back(i);
+            }
+            num_scanned += scanned.size();
+            math_utils::compute_vecs_l2sq(centers_l2sq.data(), centers, num_centers, dim);
+
+            for (size_t block_start = 0; block_start < scanned.size(); block_start += block_size)
+            {
+                const size_t block_len = (std::min)(block_size, scanned.size() - block_start);
+#pragma omp parallel for schedule(static, 1024)
+                for (int64_t j = 0; j < (int64_t)block_len; j++)
+                {
+                    const size_t i = scanned[block_start + j];
+                    std::memcpy(block.data() + j * dim, data + i * dim, dim * sizeof(float));
+                    block_l2sq[j] = docs_l2sq[i];
+                }
+                math_utils::compute_closest_centers_in_block(block.data(), block_len, dim, centers, num_centers,
+                                                             block_l2sq.data(), centers_l2sq.data(),
+                                                             block_closest.data(), dist_matrix.data());
+#pragma omp parallel for schedule(static, 1024)
+                for (int64_t j = 0; j < (int64_t)block_len; j++)
+                {
+                    const size_t i = scanned[block_start + j];
+                    const uint32_t best = block_closest[j];
+                    const float *dists = dist_matrix.data() + j * num_centers;
+                    float second = std::numeric_limits<float>::max();
+                    for (size_t c = 0; c < num_centers; c++)
+                    {
+                        if (c != best)
+                            second = (std::min)(second, dists[c]);
+                    }
+                    closest_center[i] = best;
+                    // the distances of the blocks are rounded, so the bound
+                    // on the others is kept a little low
+                    lower[i] = std::sqrt((std::max)(second, 0.0f)) * (1 - 1e-4f);
+                }
+            }
+        }
+
+        for (size_t c = 0; c < num_centers; ++c)
+            closest_docs[c].clear();
+        for (size_t i = 0; i < num_points; i++)
+            closest_docs[closest_center[i]].push_back(i);
+
+        // the means of the clusters, as in lloyds_iter()
+        std::memcpy(old_centers.data(), centers, sizeof(float) * num_centers * dim);
+        memset(centers, 0, sizeof(float) * num_centers * dim);
+#pragma omp parallel for schedule(static, 1)
+        for (int64_t c = 0; c < (int64_t)num_centers; ++c)
+        {
+            float *center = centers + (size_t)c * dim;
+            std::vector<double> cluster_sum(dim, 0.0);
+            for (size_t i : closest_docs[c])
+            {
+                float *current = data + i * dim;
+                for (size_t j = 0; j < dim; j++)
+                    cluster_sum[j] += (double)current[j];
+            }
+            if (closest_docs[c].size() > 0)
+            {
+                for (size_t j = 0; j < dim; j++)
+                    center[j] = (float)(cluster_sum[j] / ((double)closest_docs[c].size()));
+            }
+            moved[c] = std::sqrt(math_utils::calc_distance(old_centers.data() + (size_t)c * dim, center, dim));
+        }
+
+        // the other centers of a point move by at most the two largest moves
+        size_t most_moved = 0;
+        for (size_t c = 1; c < num_centers; c++)
+        {
+            if (moved[c] > moved[most_moved])
+                most_moved = c;
+        }
+        float second_move = 0;
+        for (size_t c = 0; c < num_centers; c++)
+        {
+            if (c != most_moved)
+                second_move = (std::max)(second_move, moved[c]);
+        }
+
+        // the residual computes the distance of each point to its moved
+        // center, which makes its upper bound exact again
+        double rep_residual = 0;
+#pragma omp parallel for schedule(static, 8192) reduction(+ : rep_residual)
+        for (int64_t i = 0; i < (int64_t)num_points; i++)
+        {
+            const uint32_t own = closest_center[i];
+            const float dist = math_utils::calc_distance(data + (size_t)i * dim, centers + (size_t)own * dim, dim);
+            rep_residual += dist;
+            upper[i] = std::sqrt(dist);
+            lower[i] -= own == most_moved ? second_move : moved[most_moved];
+        }
+        residual = (float)rep_residual;
+
+        if (((rep != 0) && ((old_residual - residual) / residual) < 0.00001) ||
+            (residual < std::numeric_limits<float>::epsilon()))
+        {
+            diskann::cout << "Residuals unchanged: " << old_residual << " becomes " << residual
+                          << ". Early termination." << std::endl;
+            rep++;
+            break;
+        }
+    }
+    if (rep > 1)
+    {
+        diskann::cout << "Bounded k-means scanned the centers for " << num_scanned << " of the "
+                      << num_points * (rep - 1) << " assignments after the first" << std::endl;
+    }
+
+    if (!ret_closest_docs)
+        delete[] closest_docs;
+    if (!ret_closest_center)
+        delete[] closest_center;
+    return residual;
+}
+
 // assumes memory allocated for pivot_data as new
 // float[num_centers*dim]
 // and select randomly num_centers points as pivots
@@ -390,6 +608,12 @@ void kmeanspp_selecting_pivots(float *data, size_t num_points, size_t dim, float
         return;
     }
 
+#ifdef USE_CUDA
+    if (math_utils::gpu::is_available() &&
+        math_utils::gpu::kmeanspp_selecting_pivots(data, num_points, dim, pivot_data, num_centers))
+        return;
+#endif
+
     std::vector<size_t> picked;
     std::random_device rd;
     auto x = rd();
@@ -455,4 +679,211 @@ void kmeanspp_selecting_pivots(float *data, size_t num_points, size_t dim, float
     delete[] dist;
 }
 
+void kmeanspp_extend_pivots(float *data, size_t num_points, size_t dim, float *pivot_data, size_t num_picked,
+                            size_t num_centers)
+{
+    if (num_picked == 0)
+    {
+        kmeanspp_selecting_pivots(data, num_points, dim, pivot_data, num_centers);
+        return;
+    }
+
+    // squared distance of every point to its closest existing pivot
+    std::vector<uint32_t> closest(num_points);
+    math_utils::compute_closest_centers(data, num_points, dim, pivot_data, num_picked, 1, closest.data());
+    std::vector<float> dist(num_points);
+#pragma omp parallel for schedule(static, 8192)
+    for (int64_t i = 0; i < (int64_t)num_points; i++)
+    {
+        dist[i] = math_utils::calc_distance(data + i * dim, pivot_data + (size_t)closest[i] * dim, dim);
+    }
+
+    std::random_device rd;
+    std::mt19937 generator(rd());
+    std::uniform_real_distribution<> distribution(0, 1);
+    std::uniform_int_distribution<size_t> int_dist(0, num_points - 1);
+
+    while (num_picked < num_centers)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < num_points; i++)
+            sum += dist[i];
+
+        // every point sits on a pivot when the sum is 0
+        size_t tmp_pivot = int_dist(generator);
+        if (sum > 0)
+        {
+            double dart_val = distribution(generator) * sum;
+            double prefix_sum = 0;
+            tmp_pivot = num_points - 1;
+            for (size_t i = 0; i < num_points; i++)
+            {
+                prefix_sum += dist[i];
+                if (dart_val < prefix_sum)
+                {
+                    tmp_pivot = i;
+                    break;
+                }
+            }
+        }
+        std::memcpy(pivot_data + num_picked * dim, data + tmp_pivot * dim, dim * sizeof(float));
+
+#pragma omp parallel for schedule(static, 8192)
+        for (int64_t i = 0; i < (int64_t)num_points; i++)
+        {
+            dist[i] = (std::min)(dist[i], math_utils::calc_distance(data + i * dim, data + tmp_pivot * dim, dim));
+        }
+        num_picked++;
+    }
+}
+
+float run_minibatch_lloyds(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
+                           const size_t max_reps, const size_t batch_size)
+{
+    // the smoothed residual must improve by this fraction within this many
+    // steps to keep going
+    const double MIN_IMPROVEMENT = 1e-4;
+    const size_t MAX_STEPS_WITHOUT_IMPROVEMENT = 10;
+
+    const size_t cur_batch_size = (std::min)((std::max)(batch_size, (size_t)1), num_points);
+    const size_t max_steps = (std::max)((size_t)1, max_reps * num_points / cur_batch_size);
+    // weight of each batch in the smoothed residual
+    const double alpha = (std::min)(1.0, 2.0 * cur_batch_size / (num_points + 1));
+
+    std::vector<float> batch(cur_batch_size * dim);
+    std::vector<uint32_t> closest(cur_batch_size);
+    std::vector<size_t> center_counts(num_centers, 0);
+    std::vector<std::vector<size_t>> center_members(num_centers);
+
+    std::random_device rd;
+    std::mt19937 generator(rd());
+    std::uniform_int_distribution<size_t> int_dist(0, num_points - 1);
+
+    double smoothed_residual = -1;
+    double best_residual = std::numeric_limits<double>::max();
+    size_t steps_without_improvement = 0;
+    size_t step = 0;
+    for (; step < max_steps; step++)
+    {
+        for (size_t i = 0; i < cur_batch_size; i++)
+            std::memcpy(batch.data() + i * dim, data + int_dist(generator) * dim, dim * sizeof(float));
+
+        math_utils::compute_closest_centers(batch.data(), cur_batch_size, dim, centers, num_centers, 1,
+                                            closest.data());
+
+        // residual of the batch before the centers move
+        double residual = 0;
+#pragma omp parallel for schedule(static, 1024) reduction(+ : residual)
+        for (int64_t i = 0; i < (int64_t)cur_batch_size; i++)
+        {
+            residual += math_utils::calc_distance(batch.data() + i * dim, centers + (size_t)closest[i] * dim, dim);
+        }
+        residual /= (double)cur_batch_size;
+
+        for (auto &members : center_members)
+            members.clear();
+        for (size_t i = 0; i < cur_batch_size; i++)
+            center_members[closest[i]].push_back(i);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int64_t c = 0; c < (int64_t)num_centers; c++)
+        {
+            float *center = centers + (size_t)c * dim;
+            for (size_t i : center_members[c])
+            {
+                const float eta = 1.0f / (float)(++center_counts[c]);
+                const float *point = batch.data() + i * dim;
+                for (size_t d = 0; d < dim; d++)
+                    center[d] += eta * (point[d] - center[d]);
+            }
+        }
+
+        smoothed_residual = smoothed_residual < 0 ? residual : (1 - alpha) * smoothed_residual + alpha * residual;
+        if (smoothed_residual < best_residual * (1 - MIN_IMPROVEMENT))
+        {
+            best_residual = smoothed_residual;
+            steps_without_improvement = 0;
+        }
+        else if (++steps_without_improvement >= MAX_STEPS_WITHOUT_IMPROVEMENT)
+        {
+            step++;
+            break;
+        }
+    }
+
+    diskann::cout << "Mini-batch k-means ran " << step << " of at most " << max_steps << " steps of "
+                  << cur_batch_size << " points, smoothed residual " << smoothed_residual << std::endl;
+    return (float)smoothed_residual;
+}
+
+float balance_centers(float *data, size_t num_points, size_t dim, float *centers, const size_t num_centers,
+                      const size_t k_base, const float tolerance, float *center_penalties, const size_t max_reps)
+{
+    const double target = (double)num_points * k_base / num_centers;
+    const double capacity = (1 + tolerance) * target;
+
+    std::vector<uint32_t> closest(num_points * k_base);
+    std::vector<size_t> sizes(num_centers);
+    // the step of the penalty of each center, and the direction of its last
+    // change
+    std::vector<double> steps(num_centers, 0);
+    std::vector<int> directions(num_centers, 0);
+    std::fill(center_penalties, center_penalties + num_centers, 0.0f);
+    // the penalties of the most balanced step so far
+    std::vector<float> best_penalties(center_penalties, center_penalties + num_centers);
+    size_t best_largest = std::numeric_limits<size_t>::max();
+
+    size_t rep = 0;
+    for (;; rep++)
+    {
+        math_utils::compute_closest_centers(data, num_points, dim, centers, num_centers, k_base, closest.data(), NULL,
+                                            NULL, center_penalties);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (size_t i = 0; i < num_points * k_base; i++)
+            sizes[closest[i]]++;
+        const size_t largest = *std::max_element(sizes.begin(), sizes.end());
+        if (largest < best_largest)
+        {
+            best_largest = largest;
+            std::copy(center_penalties, center_penalties + num_centers, best_penalties.begin());
+        }
+        if (largest <= capacity || rep == max_reps)
+            break;
+
+        if (rep == 0)
+        {
+            // the first steps are a tenth of the mean squared distance of a
+            // point to its closest center
+            double mean_dist = 0;
+#pragma omp parallel for schedule(static, 8192) reduction(+ : mean_dist)
+            for (int64_t i = 0; i < (int64_t)num_points; i++)
+            {
+                mean_dist +=
+                    math_utils::calc_distance(data + i * dim, centers + (size_t)closest[i * k_base] * dim, dim);
+            }
+            std::fill(steps.begin(), steps.end(), 0.1 * mean_dist / (double)num_points);
+        }
+
+        // centers over capacity push points away and those under the average
+        // draw them in. The gaps between clusters differ widely, so each
+        // center's step grows while its penalty keeps moving the same way and
+        // shrinks when it overshoots.
+        for (size_t c = 0; c < num_centers; c++)
+        {
+            const int direction = sizes[c] > capacity ? 1 : (sizes[c] < target ? -1 : 0);
+            if (direction == 0)
+                continue;
+            if (directions[c] != 0)
+                steps[c] *= direction == directions[c] ? 1.2 : 0.5;
+            directions[c] = direction;
+            center_penalties[c] += (float)(direction * steps[c]);
+        }
+    }
+
+    std::copy(best_penalties.begin(), best_penalties.end(), center_penalties);
+    diskann::cout << "Balancing " << num_centers << " centers took " << rep << " steps, largest has "
+                  << best_largest / target << " times the average of " << target << " points" << std::endl;
+    return (float)(best_largest / target);
+}
+
 } // namespace kmeans
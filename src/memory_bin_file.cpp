@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include "memory_bin_file.h"
+#include "ann_exception.h"
+#include "utils.h"
+
+namespace diskann
+{
+namespace
+{
+std::mutex registry_lock;
+std::unordered_map<std::string, const MemoryBinFile *> registry;
+} // namespace
+
+MemoryBinFile::MemoryBinFile(const std::string &path, const void *data, uint64_t num_points, uint64_t dim,
+                             uint64_t coord_size)
+    : _path(path), _data(data), _num_points(num_points), _dim(dim), _coord_size(coord_size)
+{
+    if (num_points > UINT32_MAX || dim > UINT32_MAX)
+        throw ANNException("A bin file holds at most 2^32 - 1 points of 2^32 - 1 dimensions", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    _header[0] = (uint32_t)num_points;
+    _header[1] = (uint32_t)dim;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (registry.count(path) > 0)
+        throw ANNException("Memory bin file " + path + " is registered already", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    if (file_exists_impl(path))
+        throw ANNException("Cannot register memory bin file " + path + " over the file there", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    registry[path] = this;
+}
+
+MemoryBinFile::~MemoryBinFile()
+{
+    std::lock_guard<std::mutex> guard(registry_lock);
+    registry.erase(_path);
+}
+
+const MemoryBinFile *MemoryBinFile::find(const std::string &path)
+{
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (registry.empty())
+        return nullptr;
+    auto iter = registry.find(path);
+    return iter == registry.end() ? nullptr : iter->second;
+}
+
+void MemoryBinFile::read(char *buf, uint64_t offset, uint64_t len) const
+{
+    if (offset > size() || len > size() - offset)
+        throw ANNException("Reading " + std::to_string(len) + " bytes at " + std::to_string(offset) +
+                               " beyond the end of memory bin file " + _path,
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    const uint64_t header_len = sizeof(_header);
+    if (offset < header_len)
+    {
+        const uint64_t bytes = (std::min)(len, header_len - offset);
+        std::memcpy(buf, (const char *)_header + offset, bytes);
+        buf += bytes;
+        offset += bytes;
+        len -= bytes;
+    }
+    if (len > 0)
+        std::memcpy(buf, (const char *)_data + (offset - header_len), len);
+}
+} // namespace diskann
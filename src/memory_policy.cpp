@@ -0,0 +1,437 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memory_policy.h"
+#include "utils.h"
+
+#ifndef _WINDOWS
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace diskann
+{
+namespace
+{
+const size_t HUGE_PAGE_SIZE_2MB = 2 * 1024 * 1024;
+const size_t HUGE_PAGE_SIZE_1GB = 1024 * 1024 * 1024;
+// from linux/mempolicy.h, which libc does not wrap
+const int MPOL_PREFERRED_MODE = 1;
+const int MPOL_INTERLEAVE_MODE = 3;
+
+std::atomic<HugePageMode> g_huge_pages{HugePageMode::AUTO};
+std::atomic<NumaPlacement> g_numa{NumaPlacement::FIRST_TOUCH};
+
+#ifndef _WINDOWS
+void *try_mmap(size_t len, int extra_flags)
+{
+    void *ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+// Parses lists of ranges such as "0-1,4", as used in /sys for node and cpu
+// sets.
+std::vector<uint32_t> parse_id_list(const std::string &path)
+{
+    std::vector<uint32_t> ids;
+    std::ifstream in(path);
+    std::string list;
+    if (!in || !std::getline(in, list))
+        return ids;
+
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty())
+            continue;
+        const size_t dash = range.find('-');
+        const uint32_t first = (uint32_t)std::stoul(range.substr(0, dash));
+        const uint32_t last = dash == std::string::npos ? first : (uint32_t)std::stoul(range.substr(dash + 1));
+        for (uint32_t id = first; id <= last; id++)
+            ids.push_back(id);
+    }
+    return ids;
+}
+
+// The online nodes and their CPUs, read once. Node indices used by the public
+// functions are positions in node_ids, which need not be contiguous.
+struct NumaTopology
+{
+    std::vector<uint32_t> node_ids;
+    std::vector<std::vector<uint32_t>> node_cpus;
+    // node index of each cpu id
+    std::vector<uint32_t> cpu_to_node;
+
+    NumaTopology()
+    {
+        node_ids = parse_id_list("/sys/devices/system/node/online");
+        for (uint32_t node_id : node_ids)
+        {
+            const std::string node_dir = "/sys/devices/system/node/node" + std::to_string(node_id);
+            node_cpus.push_back(parse_id_list(node_dir + "/cpulist"));
+            for (uint32_t cpu : node_cpus.back())
+            {
+                if (cpu_to_node.size() <= cpu)
+                    cpu_to_node.resize(cpu + 1, 0);
+                cpu_to_node[cpu] = (uint32_t)(node_cpus.size() - 1);
+            }
+        }
+    }
+
+    static const NumaTopology &get()
+    {
+        static const NumaTopology topology;
+        return topology;
+    }
+};
+
+// set by pin_thread_to_numa_node(); -1 when the thread is not pinned
+thread_local int64_t t_preferred_node_id = -1;
+
+std::vector<unsigned long> node_mask(const std::vector<uint32_t> &node_ids)
+{
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask;
+    for (uint32_t node : node_ids)
+    {
+        if (mask.size() <= node / bits)
+            mask.resize(node / bits + 1, 0);
+        mask[node / bits] |= 1UL << (node % bits);
+    }
+    return mask;
+}
+
+void bind_pages(void *ptr, size_t len, int mode, const std::vector<unsigned long> &mask)
+{
+    static std::once_flag warned;
+    if (mask.empty())
+        return;
+    const unsigned long max_node = mask.size() * 8 * sizeof(unsigned long) + 1;
+    if (syscall(SYS_mbind, ptr, len, mode, mask.data(), max_node, 0) != 0)
+    {
+        std::call_once(warned, [] {
+            diskann::cerr << "Warning: could not set the NUMA placement of a buffer: " << std::strerror(errno)
+                          << ". Pages will be placed on first touch." << std::endl;
+        });
+    }
+}
+
+// Applies the thread's preferred node if it is pinned, else the process
+// placement.
+void place_pages(void *ptr, size_t len, NumaPlacement placement)
+{
+    if (t_preferred_node_id >= 0)
+    {
+        bind_pages(ptr, len, MPOL_PREFERRED_MODE, node_mask({(uint32_t)t_preferred_node_id}));
+    }
+    else if (placement == NumaPlacement::INTERLEAVE)
+    {
+        static const std::vector<unsigned long> all_nodes = node_mask(NumaTopology::get().node_ids);
+        bind_pages(ptr, len, MPOL_INTERLEAVE_MODE, all_nodes);
+    }
+}
+#endif
+} // namespace
+
+void set_memory_policy(const MemoryPolicy &policy)
+{
+    g_huge_pages = policy.huge_pages;
+    g_numa = policy.numa;
+}
+
+MemoryPolicy get_memory_policy()
+{
+    MemoryPolicy policy;
+    policy.huge_pages = g_huge_pages;
+    policy.numa = g_numa;
+    return policy;
+}
+
+HugePageMode parse_huge_page_mode(const std::string &mode)
+{
+    if (mode == "none")
+        return HugePageMode::NONE;
+    if (mode == "auto")
+        return HugePageMode::AUTO;
+    if (mode == "2mb")
+        return HugePageMode::HUGE_2MB;
+    if (mode == "1gb")
+        return HugePageMode::HUGE_1GB;
+    throw ANNException("Unknown huge page mode " + mode + ". Use none, auto, 2mb or 1gb.", -1, __FUNCSIG__,
+                       __FILE__, __LINE__);
+}
+
+NumaPlacement parse_numa_placement(const std::string &placement)
+{
+    if (placement == "first_touch")
+        return NumaPlacement::FIRST_TOUCH;
+    if (placement == "interleave")
+        return NumaPlacement::INTERLEAVE;
+    throw ANNException("Unknown NUMA placement " + placement + ". Use first_touch or interleave.", -1, __FUNCSIG__,
+                       __FILE__, __LINE__);
+}
+
+LargeBuffer alloc_large(size_t size, size_t align)
+{
+    LargeBuffer buffer;
+    size = std::max(size, (size_t)1);
+    const MemoryPolicy policy = get_memory_policy();
+
+#ifndef _WINDOWS
+    if (policy.huge_pages != HugePageMode::NONE)
+    {
+        // explicit huge pages if the system has a pool of the requested size
+        // reserved, transparent huge pages otherwise
+        size_t len = ROUND_UP(size, HUGE_PAGE_SIZE_2MB);
+        void *ptr = nullptr;
+        if (policy.huge_pages == HugePageMode::HUGE_1GB && size >= HUGE_PAGE_SIZE_1GB)
+        {
+            ptr = try_mmap(ROUND_UP(size, HUGE_PAGE_SIZE_1GB), MAP_HUGETLB | MAP_HUGE_1GB);
+            if (ptr != nullptr)
+                len = ROUND_UP(size, HUGE_PAGE_SIZE_1GB);
+        }
+        if (ptr == nullptr && policy.huge_pages != HugePageMode::AUTO)
+            ptr = try_mmap(len, MAP_HUGETLB | MAP_HUGE_2MB);
+        else if (ptr == nullptr)
+            ptr = try_mmap(len, MAP_HUGETLB);
+        if (ptr == nullptr)
+        {
+            ptr = try_mmap(len, 0);
+            if (ptr != nullptr)
+                madvise(ptr, len, MADV_HUGEPAGE);
+        }
+        if (ptr != nullptr)
+        {
+            place_pages(ptr, len, policy.numa);
+            // anonymous mappings come back zeroed and untouched
+            buffer.ptr = ptr;
+            buffer.len = len;
+            buffer.mmapped = true;
+            return buffer;
+        }
+    }
+    else if (policy.numa == NumaPlacement::INTERLEAVE || t_preferred_node_id >= 0)
+    {
+        // NUMA placement needs a page aligned range of its own
+        const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        const size_t len = ROUND_UP(size, page_size);
+        void *ptr = try_mmap(len, 0);
+        if (ptr != nullptr)
+        {
+            place_pages(ptr, len, policy.numa);
+            buffer.ptr = ptr;
+            buffer.len = len;
+            buffer.mmapped = true;
+            return buffer;
+        }
+    }
+#endif
+
+    buffer.len = ROUND_UP(size, align);
+    diskann::alloc_aligned(&buffer.ptr, buffer.len, align);
+    std::memset(buffer.ptr, 0, buffer.len);
+    return buffer;
+}
+
+LargeBuffer reserve_large(size_t size, size_t align)
+{
+    LargeBuffer buffer;
+#ifndef _WINDOWS
+    const MemoryPolicy policy = get_memory_policy();
+    const size_t page_size =
+        policy.huge_pages != HugePageMode::NONE ? HUGE_PAGE_SIZE_2MB : (size_t)sysconf(_SC_PAGESIZE);
+    const size_t len = ROUND_UP(std::max(size, align), page_size);
+    void *ptr = try_mmap(len, MAP_NORESERVE);
+    if (ptr == nullptr)
+        return buffer;
+    if (policy.huge_pages != HugePageMode::NONE)
+        madvise(ptr, len, MADV_HUGEPAGE);
+    place_pages(ptr, len, policy.numa);
+    buffer.ptr = ptr;
+    buffer.len = len;
+    buffer.mmapped = true;
+#endif
+    return buffer;
+}
+
+MemoryPlacement parse_memory_placement(const std::string &placement)
+{
+    MemoryPlacement parsed;
+    if (placement == "dram")
+        return parsed;
+    if (placement.rfind("numa:", 0) == 0 && placement.size() > 5 &&
+        placement.find_first_not_of("0123456789", 5) == std::string::npos)
+    {
+        parsed.tier = MemoryTier::NUMA_NODE;
+        parsed.numa_node = (uint32_t)std::stoul(placement.substr(5));
+        return parsed;
+    }
+    if (placement.rfind("file:", 0) == 0 && placement.size() > 5)
+    {
+        parsed.tier = MemoryTier::FILE;
+        parsed.directory = placement.substr(5);
+        return parsed;
+    }
+    throw ANNException("Unknown memory placement " + placement + ". Use dram, numa:<node> or file:<dir>.", -1,
+                       __FUNCSIG__, __FILE__, __LINE__);
+}
+
+LargeBuffer alloc_placed(size_t size, size_t align, const MemoryPlacement &placement)
+{
+    if (placement.tier == MemoryTier::DRAM)
+        return alloc_large(size, align);
+
+    LargeBuffer buffer;
+#ifndef _WINDOWS
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t len = ROUND_UP(std::max(size, align), page_size);
+    if (placement.tier == MemoryTier::NUMA_NODE)
+    {
+        const NumaTopology &topology = NumaTopology::get();
+        if (placement.numa_node >= topology.node_ids.size())
+            throw ANNException("There is no NUMA node " + std::to_string(placement.numa_node) + " to place a buffer on",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        buffer.ptr = try_mmap(len, 0);
+        if (buffer.ptr == nullptr)
+            throw ANNException("Could not map " + std::to_string(len) + " bytes: " + std::strerror(errno), -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        bind_pages(buffer.ptr, len, MPOL_PREFERRED_MODE, node_mask({topology.node_ids[placement.numa_node]}));
+    }
+    else
+    {
+        // unlinked at once, so the blocks go back to the file system when the
+        // buffer is unmapped or the process dies
+        std::string path = placement.directory + "/diskann_placed_XXXXXX";
+        const int fd = mkstemp(&path[0]);
+        if (fd < 0)
+            throw ANNException("Could not create a file in " + placement.directory + ": " + std::strerror(errno), -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        unlink(path.c_str());
+        void *ptr = MAP_FAILED;
+        if (ftruncate(fd, (off_t)len) == 0)
+            ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        const int error = errno;
+        close(fd);
+        if (ptr == MAP_FAILED)
+            throw ANNException("Could not map " + std::to_string(len) + " bytes of a file in " +
+                                   placement.directory + ": " + std::strerror(error),
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        buffer.ptr = ptr;
+    }
+    buffer.len = len;
+    buffer.mmapped = true;
+#else
+    throw ANNException("Memory placements other than dram need Linux", -1, __FUNCSIG__, __FILE__, __LINE__);
+#endif
+    return buffer;
+}
+
+void free_large(LargeBuffer &buffer)
+{
+    if (buffer.ptr == nullptr)
+        return;
+#ifndef _WINDOWS
+    if (buffer.mmapped)
+        munmap(buffer.ptr, buffer.len);
+    else
+#endif
+        diskann::aligned_free(buffer.ptr);
+    buffer = LargeBuffer();
+}
+
+uint32_t get_num_numa_nodes()
+{
+#ifndef _WINDOWS
+    return (uint32_t)std::max<size_t>(NumaTopology::get().node_ids.size(), 1);
+#else
+    return 1;
+#endif
+}
+
+uint32_t get_current_numa_node()
+{
+#ifndef _WINDOWS
+    const NumaTopology &topology = NumaTopology::get();
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && (size_t)cpu < topology.cpu_to_node.size())
+        return topology.cpu_to_node[cpu];
+#endif
+    return 0;
+}
+
+bool pin_thread_to_numa_node(uint32_t node)
+{
+#ifndef _WINDOWS
+    const NumaTopology &topology = NumaTopology::get();
+    if (node >= topology.node_ids.size() || topology.node_cpus[node].empty())
+        return false;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (uint32_t cpu : topology.node_cpus[node])
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        return false;
+    t_preferred_node_id = topology.node_ids[node];
+    return true;
+#else
+    return false;
+#endif
+}
+
+void run_on_each_numa_node(const std::function<void(uint32_t)> &fn)
+{
+    const uint32_t num_nodes = get_num_numa_nodes();
+    if (num_nodes == 1)
+    {
+        fn(0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(num_nodes);
+    for (uint32_t node = 0; node < num_nodes; node++)
+    {
+        threads.emplace_back([&fn, &errors, node] {
+            try
+            {
+                if (!pin_thread_to_numa_node(node))
+                    diskann::cerr << "Warning: could not pin a thread to NUMA node " << node << std::endl;
+                fn(node);
+            }
+            catch (...)
+            {
+                errors[node] = std::current_exception();
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &error : errors)
+        if (error != nullptr)
+            std::rethrow_exception(error);
+}
+} // namespace diskann
@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "mmap_aligned_file_reader.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ann_exception.h"
+#include "logger.h"
+
+MmapAlignedFileReader::MmapAlignedFileReader(bool prefetch) : _prefetch(prefetch)
+{
+}
+
+MmapAlignedFileReader::~MmapAlignedFileReader()
+{
+    close();
+}
+
+IOContext &MmapAlignedFileReader::get_ctx()
+{
+    return _ctx;
+}
+
+void MmapAlignedFileReader::register_thread()
+{
+}
+
+void MmapAlignedFileReader::deregister_thread()
+{
+}
+
+void MmapAlignedFileReader::deregister_all_threads()
+{
+}
+
+void MmapAlignedFileReader::open(const std::string &fname)
+{
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw diskann::ANNException("Cannot open " + fname + ": " + ::strerror(errno), -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0)
+    {
+        ::close(fd);
+        throw diskann::ANNException("Cannot map the empty or unreadable file " + fname, -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+    void *data = mmap(nullptr, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw diskann::ANNException("Cannot map " + fname + ": " + ::strerror(errno), -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+    _data = (char *)data;
+    _size = (uint64_t)sb.st_size;
+
+    if (madvise(_data, _size, MADV_RANDOM) != 0)
+        diskann::cerr << "madvise(MADV_RANDOM) failed: " << ::strerror(errno) << std::endl;
+    if (_prefetch && madvise(_data, _size, MADV_WILLNEED) != 0)
+        diskann::cerr << "madvise(MADV_WILLNEED) failed: " << ::strerror(errno) << std::endl;
+    diskann::cout << "Mapped " << _size << " bytes of " << fname << (_prefetch ? ", prefetching it" : "")
+                  << std::endl;
+}
+
+void MmapAlignedFileReader::close()
+{
+    if (_data != nullptr)
+        munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+}
+
+void MmapAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
+{
+    for (AlignedRead &req : read_reqs)
+    {
+        if (req.offset + req.len > _size)
+        {
+            throw diskann::ANNException("Read of " + std::to_string(req.len) + " bytes at " +
+                                            std::to_string(req.offset) + " is past the end of the mapped file",
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        memcpy(req.buf, _data + req.offset, req.len);
+    }
+}
@@ -0,0 +1,224 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+#include "multi_index_searcher.h"
+#include "ann_exception.h"
+#include "logger.h"
+#include "timer.h"
+#include "utils.h"
+
+namespace diskann
+{
+template <typename T, typename LabelT> MultiIndexSearcher<T, LabelT>::MultiIndexSearcher(uint32_t num_threads)
+{
+    _pool.reset(new ShardPool(std::max(num_threads, 1u)));
+}
+
+template <typename T, typename LabelT>
+void MultiIndexSearcher<T, LabelT>::add_shard(std::shared_ptr<PQFlashIndex<T, LabelT>> index,
+                                              const std::string &id_map_file)
+{
+    Shard shard;
+    shard.index = index;
+    shard.num_points = index->get_num_points();
+    if (!id_map_file.empty())
+    {
+        std::unique_ptr<uint32_t[]> ids;
+        size_t npts, dim;
+        diskann::load_bin<uint32_t>(id_map_file, ids, npts, dim);
+        if (npts != shard.num_points || dim != 1)
+        {
+            throw ANNException("Id map " + id_map_file + " has " + std::to_string(npts) + "x" + std::to_string(dim) +
+                                   " ids for a shard of " + std::to_string(shard.num_points) + " points",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        shard.id_map.assign(ids.get(), ids.get() + npts);
+    }
+    _shards.push_back(std::move(shard));
+}
+
+template <typename T, typename LabelT>
+void MultiIndexSearcher<T, LabelT>::load_centroids(const std::string &centroids_file)
+{
+    std::unique_ptr<float[]> centroids;
+    size_t num_centroids, dim;
+    diskann::load_bin<float>(centroids_file, centroids, num_centroids, dim);
+    if (num_centroids != _shards.size())
+    {
+        throw ANNException("Centroid file " + centroids_file + " has " + std::to_string(num_centroids) +
+                               " centroids for " + std::to_string(_shards.size()) + " shards",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    for (auto &shard : _shards)
+    {
+        if (dim > shard.index->get_data_dim())
+        {
+            throw ANNException("Centroids of " + std::to_string(dim) + " dimensions for shards of " +
+                                   std::to_string(shard.index->get_data_dim()),
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+    _centroids.assign(centroids.get(), centroids.get() + num_centroids * dim);
+    _centroid_dim = dim;
+    diskann::cout << "Loaded " << num_centroids << " shard centroids of " << dim << " dimensions" << std::endl;
+}
+
+template <typename T, typename LabelT>
+std::vector<uint32_t> MultiIndexSearcher<T, LabelT>::route(const T *query, const uint32_t num_probes)
+{
+    std::vector<uint32_t> shards(_shards.size());
+    for (uint32_t i = 0; i < shards.size(); i++)
+        shards[i] = i;
+    if (num_probes == 0 || num_probes >= shards.size() || _centroids.empty())
+        return shards;
+
+    std::vector<float> dists(_shards.size());
+    for (size_t i = 0; i < _shards.size(); i++)
+    {
+        const float *centroid = _centroids.data() + i * _centroid_dim;
+        float dist = 0;
+        for (size_t d = 0; d < _centroid_dim; d++)
+        {
+            const float diff = (float)query[d] - centroid[d];
+            dist += diff * diff;
+        }
+        dists[i] = dist;
+    }
+    std::partial_sort(shards.begin(), shards.begin() + num_probes, shards.end(),
+                      [&dists](uint32_t a, uint32_t b) { return dists[a] < dists[b]; });
+    shards.resize(num_probes);
+    return shards;
+}
+
+template <typename T, typename LabelT>
+uint64_t MultiIndexSearcher<T, LabelT>::search(const T *query, const uint64_t k_search, const uint64_t l_search,
+                                               uint64_t *res_ids, float *res_dists, const uint64_t beam_width,
+                                               const uint32_t num_probes, uint32_t *res_shards, QueryStats *stats)
+{
+    if (_shards.empty())
+        throw ANNException("No shards to search", -1, __FUNCSIG__, __FILE__, __LINE__);
+    Timer query_timer;
+
+    const std::vector<uint32_t> probed = route(query, num_probes);
+    uint64_t probed_points = 0;
+    for (uint32_t shard : probed)
+        probed_points += _shards[shard].num_points;
+
+    // the tasks write into their own slots and the query waits for all of
+    // them, as they use the buffers of this frame
+    std::vector<std::vector<uint64_t>> ids(probed.size());
+    std::vector<std::vector<float>> dists(probed.size());
+    std::vector<QueryStats> shard_stats(probed.size());
+    std::mutex lock;
+    std::condition_variable done;
+    size_t remaining = probed.size();
+    std::exception_ptr error;
+
+    for (size_t i = 0; i < probed.size(); i++)
+    {
+        const Shard &shard = _shards[probed[i]];
+        const uint64_t k = std::min(k_search, shard.num_points);
+        const uint64_t share = DIV_ROUND_UP(l_search * shard.num_points, std::max(probed_points, (uint64_t)1));
+        const uint64_t l = std::max(share, k);
+        ids[i].resize(k);
+        dists[i].resize(k);
+        _pool->submit([&, i, k, l]() {
+            std::exception_ptr shard_error;
+            try
+            {
+                _shards[probed[i]].index->cached_beam_search(query, k, l, ids[i].data(), dists[i].data(), beam_width,
+                                                             false, stats != nullptr ? &shard_stats[i] : nullptr);
+            }
+            catch (...)
+            {
+                shard_error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            if (shard_error != nullptr && error == nullptr)
+                error = shard_error;
+            if (--remaining == 0)
+                done.notify_all();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&remaining]() { return remaining == 0; });
+    }
+    if (error != nullptr)
+        std::rethrow_exception(error);
+
+    // k-way merge of the sorted results of the shards: the heap holds the
+    // next result of each shard
+    using Head = std::pair<float, std::pair<size_t, size_t>>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (size_t i = 0; i < probed.size(); i++)
+    {
+        if (!dists[i].empty())
+            heads.push(Head(dists[i][0], std::make_pair(i, (size_t)0)));
+    }
+    uint64_t count = 0;
+    while (count < k_search && !heads.empty())
+    {
+        const size_t i = heads.top().second.first;
+        const size_t pos = heads.top().second.second;
+        heads.pop();
+        if (pos + 1 < dists[i].size())
+            heads.push(Head(dists[i][pos + 1], std::make_pair(i, pos + 1)));
+
+        const Shard &shard = _shards[probed[i]];
+        const uint64_t id = shard.id_map.empty() ? ids[i][pos] : shard.id_map[ids[i][pos]];
+        // overlapping shards may both find a point; the first copy is the
+        // closest as they hold the same vector
+        if (!shard.id_map.empty() && std::find(res_ids, res_ids + count, id) != res_ids + count)
+            continue;
+        res_ids[count] = id;
+        res_dists[count] = dists[i][pos];
+        if (res_shards != nullptr)
+            res_shards[count] = probed[i];
+        count++;
+    }
+
+    if (stats != nullptr)
+    {
+        *stats = QueryStats();
+        for (auto &s : shard_stats)
+        {
+            stats->io_us += s.io_us;
+            stats->cpu_us += s.cpu_us;
+            stats->pq_us += s.pq_us;
+            stats->fp_us += s.fp_us;
+            stats->n_4k += s.n_4k;
+            stats->n_8k += s.n_8k;
+            stats->n_12k += s.n_12k;
+            stats->n_ios += s.n_ios;
+            stats->read_size += s.read_size;
+            stats->n_cmps_saved += s.n_cmps_saved;
+            stats->n_cmps += s.n_cmps;
+            stats->n_cache_hits += s.n_cache_hits;
+            stats->n_hops += s.n_hops;
+            stats->n_spec_reads += s.n_spec_reads;
+            stats->n_spec_hits += s.n_spec_hits;
+        }
+        stats->total_us = (float)query_timer.elapsed();
+    }
+    return count;
+}
+
+template class MultiIndexSearcher<uint8_t>;
+template class MultiIndexSearcher<int8_t>;
+template class MultiIndexSearcher<float16>;
+template class MultiIndexSearcher<bfloat16>;
+template class MultiIndexSearcher<float>;
+template class MultiIndexSearcher<uint8_t, uint16_t>;
+template class MultiIndexSearcher<int8_t, uint16_t>;
+template class MultiIndexSearcher<float16, uint16_t>;
+template class MultiIndexSearcher<bfloat16, uint16_t>;
+template class MultiIndexSearcher<float, uint16_t>;
+} // namespace diskann
@@ -28,6 +28,11 @@ template <typename Key, typename Value> size_t natural_number_map<Key, Value>::s
     return _size;
 }
 
+template <typename Key, typename Value> size_t natural_number_map<Key, Value>::memory_size() const
+{
+    return _values_vector.capacity() * sizeof(Value) + _values_bitset->capacity() / 8;
+}
+
 template <typename Key, typename Value> void natural_number_map<Key, Value>::set(Key key, Value value)
 {
     if (key >= _values_bitset->size())
@@ -60,6 +60,11 @@ template <typename T> size_t natural_number_set<T>::size() const
     return _values_vector.size();
 }
 
+template <typename T> size_t natural_number_set<T>::memory_size() const
+{
+    return _values_vector.capacity() * sizeof(T) + _values_bitset->capacity() / 8;
+}
+
 template <typename T> bool natural_number_set<T>::is_in_set(T id) const
 {
     return _values_bitset->test(id);
@@ -1,8 +1,12 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <exception>
+#include <future>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -21,12 +25,21 @@
 #include "parameters.h"
 #include "memory_mapper.h"
 #include "partition.h"
+#include "parallel_io.h"
 #ifdef _WINDOWS
 #include <xmmintrin.h>
 #endif
 
 // block size for reading/ processing large files and matrices in blocks
 #define BLOCK_SIZE 5000000
+// smallest batch of mini-batch k-means in partition_with_ram_budget; larger
+// partitionings use 64 points per center
+#define MINIBATCH_MIN_SIZE ((size_t)4096)
+// points read, assigned and written at a time when sharding the base file,
+// and the buffers of each shard's data and id files (whole sectors)
+#define SHARD_BLOCK_SIZE ((size_t)1 << 20)
+#define SHARD_DATA_BUFFER_LEN ((size_t)4 << 20)
+#define SHARD_IDMAP_BUFFER_LEN ((size_t)256 << 10)
 
 // #define SAVE_INFLATED_PQ true
 
@@ -181,7 +194,8 @@ void gen_random_slice(const T *inputdata, size_t npts, size_t ndims, double p_va
 }
 
 int estimate_cluster_sizes(float *test_data_float, size_t num_test, float *pivots, const size_t num_centers,
-                           const size_t test_dim, const size_t k_base, std::vector<size_t> &cluster_sizes)
+                           const size_t test_dim, const size_t k_base, std::vector<size_t> &cluster_sizes,
+                           const float *center_penalties)
 {
     cluster_sizes.clear();
 
@@ -207,7 +221,7 @@ int estimate_cluster_sizes(float *test_data_float, size_t num_test, float *pivot
         block_data_float = test_data_float + start_id * test_dim;
 
         math_utils::compute_closest_centers(block_data_float, cur_blk_size, test_dim, pivots, num_centers, k_base,
-                                            block_closest_centers);
+                                            block_closest_centers, NULL, NULL, center_penalties);
 
         for (size_t p = 0; p < cur_blk_size; p++)
         {
@@ -232,105 +246,121 @@ int estimate_cluster_sizes(float *test_data_float, size_t num_test, float *pivot
     return 0;
 }
 
-template <typename T>
-int shard_data_into_clusters(const std::string data_file, float *pivots, const size_t num_centers, const size_t dim,
-                             const size_t k_base, std::string prefix_path)
+namespace
 {
-    size_t read_blk_size = 64 * 1024 * 1024;
-    //  uint64_t write_blk_size = 64 * 1024 * 1024;
-    // create cached reader + writer
-    cached_ifstream base_reader(data_file, read_blk_size);
-    uint32_t npts32;
-    uint32_t basedim32;
-    base_reader.read((char *)&npts32, sizeof(uint32_t));
-    base_reader.read((char *)&basedim32, sizeof(uint32_t));
-    size_t num_points = npts32;
-    if (basedim32 != dim)
+// Bin file of a shard, appended to through a sector aligned buffer that is
+// written with O_DIRECT on Linux each time it fills, so that the shards of a
+// large base file do not take over the page cache. The number of points in
+// the header is filled in by finish().
+class ShardFile
+{
+  public:
+    ShardFile(const std::string &filename, uint32_t dim, size_t buffer_len)
+        : _filename(filename), _buffer_len(buffer_len)
     {
-        diskann::cout << "Error. dimensions dont match for train set and base set" << std::endl;
-        return -1;
+        diskann::alloc_aligned((void **)&_buffer, buffer_len, diskann::defaults::SECTOR_LEN);
+        uint32_t header[2] = {0, dim};
+        std::memcpy(_buffer, header, sizeof(header));
+        _used = sizeof(header);
+#ifndef _WINDOWS
+        {
+            std::ofstream create(filename, std::ios::binary | std::ios::trunc);
+        }
+        _fd = open_for_parallel_io(filename, true, true, _is_direct);
+#else
+        _writer.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        _writer.open(filename, std::ios::binary | std::ios::trunc);
+#endif
     }
 
-    std::unique_ptr<size_t[]> shard_counts = std::make_unique<size_t[]>(num_centers);
-    std::vector<std::ofstream> shard_data_writer(num_centers);
-    std::vector<std::ofstream> shard_idmap_writer(num_centers);
-    uint32_t dummy_size = 0;
-    uint32_t const_one = 1;
-
-    for (size_t i = 0; i < num_centers; i++)
+    ~ShardFile()
     {
-        std::string data_filename = prefix_path + "_subshard-" + std::to_string(i) + ".bin";
-        std::string idmap_filename = prefix_path + "_subshard-" + std::to_string(i) + "_ids_uint32.bin";
-        shard_data_writer[i] = std::ofstream(data_filename.c_str(), std::ios::binary);
-        shard_idmap_writer[i] = std::ofstream(idmap_filename.c_str(), std::ios::binary);
-        shard_data_writer[i].write((char *)&dummy_size, sizeof(uint32_t));
-        shard_data_writer[i].write((char *)&basedim32, sizeof(uint32_t));
-        shard_idmap_writer[i].write((char *)&dummy_size, sizeof(uint32_t));
-        shard_idmap_writer[i].write((char *)&const_one, sizeof(uint32_t));
-        shard_counts[i] = 0;
+#ifndef _WINDOWS
+        if (_fd != -1)
+            ::close(_fd);
+#endif
+        diskann::aligned_free(_buffer);
     }
 
-    size_t block_size = num_points <= BLOCK_SIZE ? num_points : BLOCK_SIZE;
-    std::unique_ptr<uint32_t[]> block_closest_centers = std::make_unique<uint32_t[]>(block_size * k_base);
-    std::unique_ptr<T[]> block_data_T = std::make_unique<T[]>(block_size * dim);
-    std::unique_ptr<float[]> block_data_float = std::make_unique<float[]>(block_size * dim);
-
-    size_t num_blocks = DIV_ROUND_UP(num_points, block_size);
-
-    for (size_t block = 0; block < num_blocks; block++)
+    void append(const char *data, size_t len)
     {
-        size_t start_id = block * block_size;
-        size_t end_id = (std::min)((block + 1) * block_size, num_points);
-        size_t cur_blk_size = end_id - start_id;
-
-        base_reader.read((char *)block_data_T.get(), sizeof(T) * (cur_blk_size * dim));
-        diskann::convert_types<T, float>(block_data_T.get(), block_data_float.get(), cur_blk_size, dim);
-
-        math_utils::compute_closest_centers(block_data_float.get(), cur_blk_size, dim, pivots, num_centers, k_base,
-                                            block_closest_centers.get());
-
-        for (size_t p = 0; p < cur_blk_size; p++)
+        while (len > 0)
         {
-            for (size_t p1 = 0; p1 < k_base; p1++)
-            {
-                size_t shard_id = block_closest_centers[p * k_base + p1];
-                uint32_t original_point_map_id = (uint32_t)(start_id + p);
-                shard_data_writer[shard_id].write((char *)(block_data_T.get() + p * dim), sizeof(T) * dim);
-                shard_idmap_writer[shard_id].write((char *)&original_point_map_id, sizeof(uint32_t));
-                shard_counts[shard_id]++;
-            }
+            const size_t copied = (std::min)(len, _buffer_len - _used);
+            std::memcpy(_buffer + _used, data, copied);
+            _used += copied;
+            data += copied;
+            len -= copied;
+            if (_used == _buffer_len)
+                flush();
         }
     }
 
-    size_t total_count = 0;
-    diskann::cout << "Actual shard sizes: " << std::flush;
-    for (size_t i = 0; i < num_centers; i++)
+    // writes what is left in the buffer, and npts into the header
+    void finish(uint32_t npts)
     {
-        uint32_t cur_shard_count = (uint32_t)shard_counts[i];
-        total_count += cur_shard_count;
-        diskann::cout << cur_shard_count << " ";
-        shard_data_writer[i].seekp(0);
-        shard_data_writer[i].write((char *)&cur_shard_count, sizeof(uint32_t));
-        shard_data_writer[i].close();
-        shard_idmap_writer[i].seekp(0);
-        shard_idmap_writer[i].write((char *)&cur_shard_count, sizeof(uint32_t));
-        shard_idmap_writer[i].close();
+        if (_offset == 0)
+            std::memcpy(_buffer, &npts, sizeof(uint32_t));
+#ifndef _WINDOWS
+        // the tail is not whole sectors, so it goes through the page cache
+        bool is_direct;
+        int fd = open_for_parallel_io(_filename, true, false, is_direct);
+        transfer_fully(fd, _filename, _buffer, _used, _offset, true);
+        if (_offset != 0)
+            transfer_fully(fd, _filename, (char *)&npts, sizeof(uint32_t), 0, true);
+        ::close(fd);
+        ::close(_fd);
+        _fd = -1;
+#else
+        _writer.write(_buffer, _used);
+        if (_offset != 0)
+        {
+            _writer.seekp(0);
+            _writer.write((char *)&npts, sizeof(uint32_t));
+        }
+        _writer.close();
+#endif
     }
 
-    diskann::cout << "\n Partitioned " << num_points << " with replication factor " << k_base << " to get "
-                  << total_count << " points across " << num_centers << " shards " << std::endl;
-    return 0;
-}
+  private:
+    void flush()
+    {
+#ifndef _WINDOWS
+        transfer_fully(_fd, _filename, _buffer, _buffer_len, _offset, true);
+#else
+        _writer.write(_buffer, _buffer_len);
+#endif
+        _offset += _buffer_len;
+        _used = 0;
+    }
 
-// useful for partitioning large dataset. we first generate only the IDS for
-// each shard, and retrieve the actual vectors on demand.
+    std::string _filename;
+    char *_buffer = nullptr;
+    size_t _buffer_len;
+    size_t _used = 0;
+    // of the start of the buffer in the file
+    size_t _offset = 0;
+#ifndef _WINDOWS
+    int _fd = -1;
+    bool _is_direct = false;
+#else
+    std::ofstream _writer;
+#endif
+};
+
+// Assigns each point of data_file to its k_base closest pivots (with
+// center_penalties added to the distances, if given) and writes the ids of
+// the points of each shard, and the points themselves if write_data is set,
+// in one pass over the file. The next block is read while a block is
+// assigned with the parallel GEMM of compute_closest_centers(), and the
+// shards of the block are then written by as many threads, each shard to its
+// own buffered files.
 template <typename T>
-int shard_data_into_clusters_only_ids(const std::string data_file, float *pivots, const size_t num_centers,
-                                      const size_t dim, const size_t k_base, std::string prefix_path)
+int shard_data_in_one_pass(const std::string &data_file, float *pivots, const size_t num_centers, const size_t dim,
+                           const size_t k_base, const std::string &prefix_path, bool write_data,
+                           const float *center_penalties)
 {
     size_t read_blk_size = 64 * 1024 * 1024;
-    //  uint64_t write_blk_size = 64 * 1024 * 1024;
-    // create cached reader + writer
     cached_ifstream base_reader(data_file, read_blk_size);
     uint32_t npts32;
     uint32_t basedim32;
@@ -343,27 +373,35 @@ int shard_data_into_clusters_only_ids(const std::string data_file, float *pivots
         return -1;
     }
 
-    std::unique_ptr<size_t[]> shard_counts = std::make_unique<size_t[]>(num_centers);
-
-    std::vector<std::ofstream> shard_idmap_writer(num_centers);
-    uint32_t dummy_size = 0;
-    uint32_t const_one = 1;
-
+    std::vector<size_t> shard_counts(num_centers, 0);
+    std::vector<std::unique_ptr<ShardFile>> shard_data_writer(num_centers);
+    std::vector<std::unique_ptr<ShardFile>> shard_idmap_writer(num_centers);
     for (size_t i = 0; i < num_centers; i++)
     {
+        std::string data_filename = prefix_path + "_subshard-" + std::to_string(i) + ".bin";
         std::string idmap_filename = prefix_path + "_subshard-" + std::to_string(i) + "_ids_uint32.bin";
-        shard_idmap_writer[i] = std::ofstream(idmap_filename.c_str(), std::ios::binary);
-        shard_idmap_writer[i].write((char *)&dummy_size, sizeof(uint32_t));
-        shard_idmap_writer[i].write((char *)&const_one, sizeof(uint32_t));
-        shard_counts[i] = 0;
+        if (write_data)
+            shard_data_writer[i].reset(new ShardFile(data_filename, basedim32, SHARD_DATA_BUFFER_LEN));
+        shard_idmap_writer[i].reset(new ShardFile(idmap_filename, 1, SHARD_IDMAP_BUFFER_LEN));
     }
 
-    size_t block_size = num_points <= BLOCK_SIZE ? num_points : BLOCK_SIZE;
+    size_t block_size = num_points <= SHARD_BLOCK_SIZE ? num_points : SHARD_BLOCK_SIZE;
     std::unique_ptr<uint32_t[]> block_closest_centers = std::make_unique<uint32_t[]>(block_size * k_base);
     std::unique_ptr<T[]> block_data_T = std::make_unique<T[]>(block_size * dim);
+    std::unique_ptr<T[]> next_block_data_T = std::make_unique<T[]>(block_size * dim);
     std::unique_ptr<float[]> block_data_float = std::make_unique<float[]>(block_size * dim);
+    // the assignments of a block in the order of their shards
+    std::vector<size_t> shard_starts(num_centers + 1);
+    std::vector<uint32_t> shard_members(block_size * k_base);
 
     size_t num_blocks = DIV_ROUND_UP(num_points, block_size);
+    auto read_block = [&](size_t block, T *buf) {
+        size_t cur_blk_size = (std::min)((block + 1) * block_size, num_points) - block * block_size;
+        base_reader.read((char *)buf, sizeof(T) * (cur_blk_size * dim));
+    };
+    std::future<void> next_read;
+    if (num_blocks > 0)
+        next_read = std::async(std::launch::async, read_block, 0, next_block_data_T.get());
 
     for (size_t block = 0; block < num_blocks; block++)
     {
@@ -371,22 +409,54 @@ int shard_data_into_clusters_only_ids(const std::string data_file, float *pivots
         size_t end_id = (std::min)((block + 1) * block_size, num_points);
         size_t cur_blk_size = end_id - start_id;
 
-        base_reader.read((char *)block_data_T.get(), sizeof(T) * (cur_blk_size * dim));
-        diskann::convert_types<T, float>(block_data_T.get(), block_data_float.get(), cur_blk_size, dim);
+        next_read.get();
+        std::swap(block_data_T, next_block_data_T);
+        if (block + 1 < num_blocks)
+            next_read = std::async(std::launch::async, read_block, block + 1, next_block_data_T.get());
 
+        diskann::convert_types<T, float>(block_data_T.get(), block_data_float.get(), cur_blk_size, dim);
         math_utils::compute_closest_centers(block_data_float.get(), cur_blk_size, dim, pivots, num_centers, k_base,
-                                            block_closest_centers.get());
+                                            block_closest_centers.get(), NULL, NULL, center_penalties);
 
+        std::fill(shard_starts.begin(), shard_starts.end(), 0);
+        for (size_t j = 0; j < cur_blk_size * k_base; j++)
+            shard_starts[block_closest_centers[j] + 1]++;
+        for (size_t c = 0; c < num_centers; c++)
+            shard_starts[c + 1] += shard_starts[c];
         for (size_t p = 0; p < cur_blk_size; p++)
         {
             for (size_t p1 = 0; p1 < k_base; p1++)
+                shard_members[shard_starts[block_closest_centers[p * k_base + p1]]++] = (uint32_t)p;
+        }
+        // the counting sort left each start at the start of the next shard
+        for (size_t c = num_centers; c > 0; c--)
+            shard_starts[c] = shard_starts[c - 1];
+        shard_starts[0] = 0;
+
+        std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int64_t shard_id = 0; shard_id < (int64_t)num_centers; shard_id++)
+        {
+            try
             {
-                size_t shard_id = block_closest_centers[p * k_base + p1];
-                uint32_t original_point_map_id = (uint32_t)(start_id + p);
-                shard_idmap_writer[shard_id].write((char *)&original_point_map_id, sizeof(uint32_t));
-                shard_counts[shard_id]++;
+                for (size_t j = shard_starts[shard_id]; j < shard_starts[shard_id + 1]; j++)
+                {
+                    size_t p = shard_members[j];
+                    uint32_t original_point_map_id = (uint32_t)(start_id + p);
+                    if (write_data)
+                        shard_data_writer[shard_id]->append((char *)(block_data_T.get() + p * dim), sizeof(T) * dim);
+                    shard_idmap_writer[shard_id]->append((char *)&original_point_map_id, sizeof(uint32_t));
+                }
+                shard_counts[shard_id] += shard_starts[shard_id + 1] - shard_starts[shard_id];
+            }
+            catch (...)
+            {
+#pragma omp critical
+                error = std::current_exception();
             }
         }
+        if (error != nullptr)
+            std::rethrow_exception(error);
     }
 
     size_t total_count = 0;
@@ -396,15 +466,33 @@ int shard_data_into_clusters_only_ids(const std::string data_file, float *pivots
         uint32_t cur_shard_count = (uint32_t)shard_counts[i];
         total_count += cur_shard_count;
         diskann::cout << cur_shard_count << " ";
-        shard_idmap_writer[i].seekp(0);
-        shard_idmap_writer[i].write((char *)&cur_shard_count, sizeof(uint32_t));
-        shard_idmap_writer[i].close();
+        if (write_data)
+            shard_data_writer[i]->finish(cur_shard_count);
+        shard_idmap_writer[i]->finish(cur_shard_count);
     }
 
     diskann::cout << "\n Partitioned " << num_points << " with replication factor " << k_base << " to get "
                   << total_count << " points across " << num_centers << " shards " << std::endl;
     return 0;
 }
+} // namespace
+
+template <typename T>
+int shard_data_into_clusters(const std::string data_file, float *pivots, const size_t num_centers, const size_t dim,
+                             const size_t k_base, std::string prefix_path, const float *center_penalties)
+{
+    return shard_data_in_one_pass<T>(data_file, pivots, num_centers, dim, k_base, prefix_path, true,
+                                     center_penalties);
+}
+
+// useful for partitioning large dataset. we first generate only the IDS for
+// each shard, and retrieve the actual vectors on demand.
+template <typename T>
+int shard_data_into_clusters_only_ids(const std::string data_file, float *pivots, const size_t num_centers,
+                                      const size_t dim, const size_t k_base, std::string prefix_path)
+{
+    return shard_data_in_one_pass<T>(data_file, pivots, num_centers, dim, k_base, prefix_path, false, nullptr);
+}
 
 template <typename T>
 int retrieve_shard_data_from_ids(const std::string data_file, std::string idmap_filename, std::string data_filename)
@@ -505,7 +593,8 @@ int partition(const std::string data_file, const float sampling_rate, size_t num
     diskann::cout << "Processing global k-means (kmeans_partitioning Step)" << std::endl;
     kmeans::kmeanspp_selecting_pivots(train_data_float, num_train, train_dim, pivot_data, num_parts);
 
-    kmeans::run_lloyds(train_data_float, num_train, train_dim, pivot_data, num_parts, max_k_means_reps, NULL, NULL);
+    kmeans::run_bounded_lloyds(train_data_float, num_train, train_dim, pivot_data, num_parts, max_k_means_reps, NULL,
+                               NULL);
 
     diskann::cout << "Saving global k-center pivots" << std::endl;
     diskann::save_bin<float>(output_file.c_str(), pivot_data, (size_t)num_parts, train_dim);
@@ -521,7 +610,8 @@ int partition(const std::string data_file, const float sampling_rate, size_t num
 
 template <typename T>
 int partition_with_ram_budget(const std::string data_file, const double sampling_rate, double ram_budget,
-                              size_t graph_degree, const std::string prefix_path, size_t k_base)
+                              size_t graph_degree, const std::string prefix_path, size_t k_base, bool minibatch_kmeans,
+                              float balance_tolerance)
 {
     size_t train_dim;
     size_t num_train;
@@ -549,26 +639,53 @@ int partition_with_ram_budget(const std::string data_file, const double sampling
     //  std::to_string(num_parts);
     output_file = cur_file + "_centroids.bin";
 
+    // centers of the previous attempt, which mini-batch mode grows rather than
+    // reseeds
+    int prev_num_parts = 0;
+    // with balance_tolerance, the penalties that balance the parts
+    std::vector<float> center_penalties;
+
     while (!fit_in_ram)
     {
         fit_in_ram = true;
 
         double max_ram_usage = 0;
-        if (pivot_data != nullptr)
-            delete[] pivot_data;
-
+        float *prev_pivot_data = pivot_data;
         pivot_data = new float[num_parts * train_dim];
         // Process Global k-means for kmeans_partitioning Step
         diskann::cout << "Processing global k-means (kmeans_partitioning Step)" << std::endl;
-        kmeans::kmeanspp_selecting_pivots(train_data_float, num_train, train_dim, pivot_data, num_parts);
+        if (minibatch_kmeans)
+        {
+            if (prev_pivot_data != nullptr)
+                std::memcpy(pivot_data, prev_pivot_data, prev_num_parts * train_dim * sizeof(float));
+            kmeans::kmeanspp_extend_pivots(train_data_float, num_train, train_dim, pivot_data, prev_num_parts,
+                                           num_parts);
+            kmeans::run_minibatch_lloyds(train_data_float, num_train, train_dim, pivot_data, num_parts,
+                                         max_k_means_reps, (std::max)(MINIBATCH_MIN_SIZE, 64 * (size_t)num_parts));
+        }
+        else
+        {
+            kmeans::kmeanspp_selecting_pivots(train_data_float, num_train, train_dim, pivot_data, num_parts);
+            kmeans::run_bounded_lloyds(train_data_float, num_train, train_dim, pivot_data, num_parts,
+                                       max_k_means_reps, NULL, NULL);
+        }
+        delete[] prev_pivot_data;
+        prev_num_parts = num_parts;
 
-        kmeans::run_lloyds(train_data_float, num_train, train_dim, pivot_data, num_parts, max_k_means_reps, NULL, NULL);
+        center_penalties.clear();
+        if (balance_tolerance > 0)
+        {
+            center_penalties.resize(num_parts);
+            kmeans::balance_centers(train_data_float, num_train, train_dim, pivot_data, num_parts, k_base,
+                                    balance_tolerance, center_penalties.data());
+        }
 
         // now pivots are ready. need to stream base points and assign them to
         // closest clusters.
 
         std::vector<size_t> cluster_sizes;
-        estimate_cluster_sizes(test_data_float, num_test, pivot_data, num_parts, train_dim, k_base, cluster_sizes);
+        estimate_cluster_sizes(test_data_float, num_test, pivot_data, num_parts, train_dim, k_base, cluster_sizes,
+                               center_penalties.empty() ? nullptr : center_penalties.data());
 
         for (auto &p : cluster_sizes)
         {
@@ -594,7 +711,8 @@ int partition_with_ram_budget(const std::string data_file, const double sampling
     diskann::cout << "Saving global k-center pivots" << std::endl;
     diskann::save_bin<float>(output_file.c_str(), pivot_data, (size_t)num_parts, train_dim);
 
-    shard_data_into_clusters_only_ids<T>(data_file, pivot_data, num_parts, train_dim, k_base, prefix_path);
+    shard_data_into_clusters<T>(data_file, pivot_data, num_parts, train_dim, k_base, prefix_path,
+                                center_penalties.empty() ? nullptr : center_penalties.data());
     delete[] pivot_data;
     delete[] train_data_float;
     delete[] test_data_float;
@@ -605,6 +723,10 @@ int partition_with_ram_budget(const std::string data_file, const double sampling
 
 template void DISKANN_DLLEXPORT gen_random_slice<int8_t>(const std::string base_file, const std::string output_prefix,
                                                          double sampling_rate);
+template void DISKANN_DLLEXPORT gen_random_slice<diskann::float16>(
+    const std::string base_file, const std::string output_prefix, double sampling_rate);
+template void DISKANN_DLLEXPORT gen_random_slice<diskann::bfloat16>(
+    const std::string base_file, const std::string output_prefix, double sampling_rate);
 template void DISKANN_DLLEXPORT gen_random_slice<uint8_t>(const std::string base_file, const std::string output_prefix,
                                                           double sampling_rate);
 template void DISKANN_DLLEXPORT gen_random_slice<float>(const std::string base_file, const std::string output_prefix,
@@ -616,6 +738,12 @@ template void DISKANN_DLLEXPORT gen_random_slice<uint8_t>(const uint8_t *inputda
                                                           double p_val, float *&sampled_data, size_t &slice_size);
 template void DISKANN_DLLEXPORT gen_random_slice<int8_t>(const int8_t *inputdata, size_t npts, size_t ndims,
                                                          double p_val, float *&sampled_data, size_t &slice_size);
+template void DISKANN_DLLEXPORT gen_random_slice<diskann::float16>(
+    const diskann::float16 *inputdata, size_t npts, size_t ndims, double p_val, float *&sampled_data,
+    size_t &slice_size);
+template void DISKANN_DLLEXPORT gen_random_slice<diskann::bfloat16>(
+    const diskann::bfloat16 *inputdata, size_t npts, size_t ndims, double p_val, float *&sampled_data,
+    size_t &slice_size);
 
 template void DISKANN_DLLEXPORT gen_random_slice<float>(const std::string data_file, double p_val, float *&sampled_data,
                                                         size_t &slice_size, size_t &ndims);
@@ -623,10 +751,20 @@ template void DISKANN_DLLEXPORT gen_random_slice<uint8_t>(const std::string data
                                                           float *&sampled_data, size_t &slice_size, size_t &ndims);
 template void DISKANN_DLLEXPORT gen_random_slice<int8_t>(const std::string data_file, double p_val,
                                                          float *&sampled_data, size_t &slice_size, size_t &ndims);
+template void DISKANN_DLLEXPORT gen_random_slice<diskann::float16>(
+    const std::string data_file, double p_val, float *&sampled_data, size_t &slice_size, size_t &ndims);
+template void DISKANN_DLLEXPORT gen_random_slice<diskann::bfloat16>(
+    const std::string data_file, double p_val, float *&sampled_data, size_t &slice_size, size_t &ndims);
 
 template DISKANN_DLLEXPORT int partition<int8_t>(const std::string data_file, const float sampling_rate,
                                                  size_t num_centers, size_t max_k_means_reps,
                                                  const std::string prefix_path, size_t k_base);
+template DISKANN_DLLEXPORT int partition<diskann::float16>(const std::string data_file, const float sampling_rate,
+                                                           size_t num_centers, size_t max_k_means_reps,
+                                                           const std::string prefix_path, size_t k_base);
+template DISKANN_DLLEXPORT int partition<diskann::bfloat16>(const std::string data_file, const float sampling_rate,
+                                                            size_t num_centers, size_t max_k_means_reps,
+                                                            const std::string prefix_path, size_t k_base);
 template DISKANN_DLLEXPORT int partition<uint8_t>(const std::string data_file, const float sampling_rate,
                                                   size_t num_centers, size_t max_k_means_reps,
                                                   const std::string prefix_path, size_t k_base);
@@ -634,17 +772,21 @@ template DISKANN_DLLEXPORT int partition<float>(const std::string data_file, con
                                                 size_t num_centers, size_t max_k_means_reps,
                                                 const std::string prefix_path, size_t k_base);
 
-template DISKANN_DLLEXPORT int partition_with_ram_budget<int8_t>(const std::string data_file,
-                                                                 const double sampling_rate, double ram_budget,
-                                                                 size_t graph_degree, const std::string prefix_path,
-                                                                 size_t k_base);
-template DISKANN_DLLEXPORT int partition_with_ram_budget<uint8_t>(const std::string data_file,
-                                                                  const double sampling_rate, double ram_budget,
-                                                                  size_t graph_degree, const std::string prefix_path,
-                                                                  size_t k_base);
-template DISKANN_DLLEXPORT int partition_with_ram_budget<float>(const std::string data_file, const double sampling_rate,
-                                                                double ram_budget, size_t graph_degree,
-                                                                const std::string prefix_path, size_t k_base);
+template DISKANN_DLLEXPORT int partition_with_ram_budget<int8_t>(
+    const std::string data_file, const double sampling_rate, double ram_budget, size_t graph_degree,
+    const std::string prefix_path, size_t k_base, bool minibatch_kmeans, float balance_tolerance);
+template DISKANN_DLLEXPORT int partition_with_ram_budget<diskann::float16>(
+    const std::string data_file, const double sampling_rate, double ram_budget, size_t graph_degree,
+    const std::string prefix_path, size_t k_base, bool minibatch_kmeans, float balance_tolerance);
+template DISKANN_DLLEXPORT int partition_with_ram_budget<diskann::bfloat16>(
+    const std::string data_file, const double sampling_rate, double ram_budget, size_t graph_degree,
+    const std::string prefix_path, size_t k_base, bool minibatch_kmeans, float balance_tolerance);
+template DISKANN_DLLEXPORT int partition_with_ram_budget<uint8_t>(
+    const std::string data_file, const double sampling_rate, double ram_budget, size_t graph_degree,
+    const std::string prefix_path, size_t k_base, bool minibatch_kmeans, float balance_tolerance);
+template DISKANN_DLLEXPORT int partition_with_ram_budget<float>(
+    const std::string data_file, const double sampling_rate, double ram_budget, size_t graph_degree,
+    const std::string prefix_path, size_t k_base, bool minibatch_kmeans, float balance_tolerance);
 
 template DISKANN_DLLEXPORT int retrieve_shard_data_from_ids<float>(const std::string data_file,
                                                                    std::string idmap_filename,
@@ -654,4 +796,10 @@ template DISKANN_DLLEXPORT int retrieve_shard_data_from_ids<uint8_t>(const std::
                                                                      std::string data_filename);
 template DISKANN_DLLEXPORT int retrieve_shard_data_from_ids<int8_t>(const std::string data_file,
                                                                     std::string idmap_filename,
-                                                                    std::string data_filename);
\ No newline at end of file
+                                                                    std::string data_filename);
+template DISKANN_DLLEXPORT int retrieve_shard_data_from_ids<diskann::float16>(const std::string data_file,
+                                                                              std::string idmap_filename,
+                                                                              std::string data_filename);
+template DISKANN_DLLEXPORT int retrieve_shard_data_from_ids<diskann::bfloat16>(const std::string data_file,
+                                                                               std::string idmap_filename,
+                                                                               std::string data_filename);
\ No newline at end of file
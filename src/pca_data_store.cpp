@@ -0,0 +1,495 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <limits>
+
+#include "blas_compat.h"
+
+#include "abstract_scratch.h"
+#include "pca_data_store.h"
+#include "pq_scratch.h"
+#include "defaults.h"
+#include "utils.h"
+#include "memory_usage.h"
+
+namespace diskann
+{
+
+// vectors are converted to float and projected this many at a time
+static const size_t PCA_BLOCK_SIZE = 4096;
+
+template <typename data_t>
+PCADataStore<data_t>::PCADataStore(size_t dim, location_t num_points, uint32_t num_pca_dims,
+                                   std::unique_ptr<Distance<data_t>> distance_fn)
+    : AbstractDataStore<data_t>(num_points, dim), _num_pca_dims(num_pca_dims),
+      _distance_metric(distance_fn->get_metric()), _distance_fn(std::move(distance_fn))
+{
+    if (_num_pca_dims == 0 || _num_pca_dims > dim)
+    {
+        throw diskann::ANNException("ERROR: a PCA projected store keeps between 1 and " + std::to_string(dim) +
+                                        " dimensions",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (_distance_metric != diskann::Metric::L2 && _distance_metric != diskann::Metric::INNER_PRODUCT)
+    {
+        throw diskann::ANNException("ERROR: PCA projection supports only the L2 and inner product metrics", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    _aligned_pca_dims = ROUND_UP(_num_pca_dims, 8);
+    _projected_distance_fn.reset(get_distance_function<float>(_distance_metric));
+    _batch4_distance_fn = get_batch4_distance_function<float>(_distance_metric);
+
+    // the first coordinates until components are learned
+    _components.assign(_aligned_pca_dims * dim, 0.0f);
+    for (size_t r = 0; r < _num_pca_dims; r++)
+        _components[r * dim + r] = 1.0f;
+
+    alloc_aligned(((void **)&_vectors), this->_capacity * _aligned_pca_dims * sizeof(float), 8 * sizeof(float));
+    std::memset(_vectors, 0, this->_capacity * _aligned_pca_dims * sizeof(float));
+}
+
+template <typename data_t> PCADataStore<data_t>::~PCADataStore()
+{
+    if (_vectors != nullptr)
+    {
+        aligned_free(_vectors);
+        _vectors = nullptr;
+    }
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::train(const data_t *vectors, const location_t num_pts)
+{
+    const size_t dim = this->_dim;
+    const size_t num_train = (std::min)((size_t)num_pts, (size_t)defaults::PCA_TRAINING_SAMPLE_SIZE);
+    if (num_train == 0)
+        return;
+    const double stride = (double)num_pts / (double)num_train;
+    auto sample = [&](size_t i) { return vectors + (size_t)(i * stride) * dim; };
+
+    // L2 distances are invariant to the mean, so its components are those of
+    // the covariance; inner products are not, and keep it
+    std::vector<float> mean(dim, 0.0f);
+    if (_distance_metric == diskann::Metric::L2)
+    {
+        std::vector<double> sum(dim, 0.0);
+        for (size_t i = 0; i < num_train; i++)
+        {
+            const data_t *vector = sample(i);
+            for (size_t d = 0; d < dim; d++)
+                sum[d] += (double)vector[d];
+        }
+        for (size_t d = 0; d < dim; d++)
+            mean[d] = (float)(sum[d] / (double)num_train);
+    }
+
+    std::vector<float> covariance(dim * dim, 0.0f);
+    std::vector<float> block(PCA_BLOCK_SIZE * dim);
+    for (size_t start = 0; start < num_train; start += PCA_BLOCK_SIZE)
+    {
+        const size_t count = (std::min)(PCA_BLOCK_SIZE, num_train - start);
+        for (size_t i = 0; i < count; i++)
+        {
+            const data_t *vector = sample(start + i);
+            for (size_t d = 0; d < dim; d++)
+                block[i * dim + d] = (float)vector[d] - mean[d];
+        }
+        cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, (MKL_INT)dim, (MKL_INT)dim, (MKL_INT)count, 1.0f,
+                    block.data(), (MKL_INT)dim, block.data(), (MKL_INT)dim, 1.0f, covariance.data(), (MKL_INT)dim);
+    }
+
+    // the right singular vectors of the symmetric matrix are its eigenvectors,
+    // by decreasing eigenvalue
+    std::vector<float> singular_values(dim), u(dim * dim), vt(dim * dim);
+    MKL_INT errcode = LAPACKE_sgesdd(LAPACK_ROW_MAJOR, 'A', (MKL_INT)dim, (MKL_INT)dim, covariance.data(),
+                                     (MKL_INT)dim, singular_values.data(), u.data(), (MKL_INT)dim, vt.data(),
+                                     (MKL_INT)dim);
+    if (errcode != 0)
+    {
+        throw diskann::ANNException("ERROR: the SVD of the covariance did not converge while learning the PCA "
+                                    "components",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    std::fill(_components.begin(), _components.end(), 0.0f);
+    std::copy(vt.begin(), vt.begin() + _num_pca_dims * dim, _components.begin());
+
+    double total = 0, kept = 0;
+    for (size_t d = 0; d < dim; d++)
+    {
+        total += singular_values[d];
+        kept += d < _num_pca_dims ? singular_values[d] : 0;
+    }
+    diskann::cout << "PCA: " << _num_pca_dims << " of " << dim << " components keep "
+                  << (total > 0 ? 100.0 * kept / total : 100.0) << "% of the variance" << std::endl;
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::project(const data_t *vectors, const location_t num_pts, float *projected) const
+{
+    const size_t dim = this->_dim;
+    std::vector<float> block((std::min)((size_t)num_pts, PCA_BLOCK_SIZE) * dim);
+    for (size_t start = 0; start < num_pts; start += PCA_BLOCK_SIZE)
+    {
+        const size_t count = (std::min)(PCA_BLOCK_SIZE, (size_t)num_pts - start);
+        for (size_t i = 0; i < count * dim; i++)
+            block[i] = (float)vectors[start * dim + i];
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, (MKL_INT)count, (MKL_INT)_aligned_pca_dims,
+                    (MKL_INT)dim, 1.0f, block.data(), (MKL_INT)dim, _components.data(), (MKL_INT)dim, 0.0f,
+                    projected + start * _aligned_pca_dims, (MKL_INT)_aligned_pca_dims);
+    }
+}
+
+template <typename data_t> location_t PCADataStore<data_t>::load(const std::string &filename)
+{
+    return load_impl(filename);
+}
+
+template <typename data_t> location_t PCADataStore<data_t>::load_impl(const std::string &filename)
+{
+    size_t num_components, components_dim;
+    std::unique_ptr<float[]> components;
+    diskann::load_bin<float>(get_params_filename(filename), components, num_components, components_dim);
+    if (num_components != _num_pca_dims || components_dim != this->_dim)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << get_params_filename(filename) << " holds " << num_components << "x"
+               << components_dim << " floats, but the data store expects " << _num_pca_dims << "x" << this->_dim
+               << "." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    std::fill(_components.begin(), _components.end(), 0.0f);
+    std::copy(components.get(), components.get() + _num_pca_dims * this->_dim, _components.begin());
+
+    size_t file_num_points, file_dim;
+    std::unique_ptr<float[]> vectors;
+    diskann::load_bin<float>(filename, vectors, file_num_points, file_dim);
+    if (file_dim != _aligned_pca_dims)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << filename << " holds " << file_dim << " dimensional projections, but the data store uses "
+               << _aligned_pca_dims << "." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (file_num_points > this->capacity())
+    {
+        this->resize((location_t)file_num_points);
+    }
+    memcpy(_vectors, vectors.get(), file_num_points * _aligned_pca_dims * sizeof(float));
+
+    return (location_t)file_num_points;
+}
+
+// The projections are saved as they are laid out, padding included
+template <typename data_t> size_t PCADataStore<data_t>::save(const std::string &filename, const location_t num_points)
+{
+    size_t bytes_written =
+        diskann::save_bin<float>(get_params_filename(filename), _components.data(), _num_pca_dims, this->_dim);
+    return bytes_written + diskann::save_bin<float>(filename, _vectors, num_points, _aligned_pca_dims);
+}
+
+template <typename data_t> size_t PCADataStore<data_t>::get_aligned_dim() const
+{
+    return this->get_dims();
+}
+
+template <typename data_t> void PCADataStore<data_t>::populate_data(const data_t *vectors, const location_t num_pts)
+{
+    train(vectors, num_pts);
+    project(vectors, num_pts, _vectors);
+}
+
+template <typename data_t> void PCADataStore<data_t>::populate_data(const std::string &filename, const size_t offset)
+{
+    size_t npts, ndim;
+    std::unique_ptr<data_t[]> vectors;
+    diskann::load_bin<data_t>(filename, vectors, npts, ndim, offset);
+
+    if ((location_t)npts > this->capacity())
+    {
+        std::stringstream ss;
+        ss << "Number of points in the file: " << filename
+           << " is greater than the capacity of data store: " << this->capacity()
+           << ". Must invoke resize before calling populate_data()" << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+
+    if (ndim != this->get_dims())
+    {
+        std::stringstream ss;
+        ss << "Number of dimensions of a point in the file: " << filename
+           << " is not equal to dimensions of data store: " << this->get_dims() << "." << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+
+    populate_data(vectors.get(), (location_t)npts);
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::extract_data_to_bin(const std::string &filename, const location_t num_pts)
+{
+    std::vector<data_t> vectors((size_t)num_pts * this->_dim);
+    for (location_t i = 0; i < num_pts; i++)
+    {
+        get_vector(i, vectors.data() + i * this->_dim);
+    }
+    diskann::save_bin<data_t>(filename, vectors.data(), num_pts, this->_dim);
+}
+
+template <typename data_t> void PCADataStore<data_t>::get_vector(const location_t i, data_t *target) const
+{
+    const float *projected = _vectors + (size_t)i * _aligned_pca_dims;
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        float value = 0;
+        for (size_t r = 0; r < _num_pca_dims; r++)
+            value += _components[r * this->_dim + d] * projected[r];
+        target[d] = (data_t)value;
+    }
+}
+
+template <typename data_t> void PCADataStore<data_t>::set_vector(const location_t i, const data_t *const vector)
+{
+    project(vector, 1, _vectors + (size_t)i * _aligned_pca_dims);
+}
+
+template <typename data_t> void PCADataStore<data_t>::prefetch_vector(const location_t loc)
+{
+    diskann::prefetch_vector((const char *)(_vectors + (size_t)loc * _aligned_pca_dims),
+                             _aligned_pca_dims * sizeof(float));
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::move_vectors(const location_t old_location_start, const location_t new_location_start,
+                                        const location_t num_points)
+{
+    if (num_points == 0 || old_location_start == new_location_start)
+    {
+        return;
+    }
+    const size_t row_bytes = _aligned_pca_dims * sizeof(float);
+    memmove(_vectors + new_location_start * _aligned_pca_dims, _vectors + old_location_start * _aligned_pca_dims,
+            num_points * row_bytes);
+
+    // clear the rows in the old range that the new range does not cover
+    location_t mem_clear_loc_start = old_location_start;
+    location_t mem_clear_loc_end_limit = old_location_start + num_points;
+    if (new_location_start < old_location_start)
+    {
+        if (mem_clear_loc_start < new_location_start + num_points)
+            mem_clear_loc_start = new_location_start + num_points;
+    }
+    else if (mem_clear_loc_end_limit > new_location_start)
+    {
+        mem_clear_loc_end_limit = new_location_start;
+    }
+    memset(_vectors + mem_clear_loc_start * _aligned_pca_dims, 0,
+           (size_t)(mem_clear_loc_end_limit - mem_clear_loc_start) * row_bytes);
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::copy_vectors(const location_t from_loc, const location_t to_loc, const location_t num_points)
+{
+    memcpy(_vectors + to_loc * _aligned_pca_dims, _vectors + from_loc * _aligned_pca_dims,
+           num_points * _aligned_pca_dims * sizeof(float));
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::preprocess_query(const data_t *query, AbstractScratch<data_t> *scratch) const
+{
+    if (scratch == nullptr)
+    {
+        throw diskann::ANNException("Scratch space is null", -1);
+    }
+
+    PQScratch<data_t> *pq_scratch = scratch->pq_scratch();
+    if (pq_scratch == nullptr)
+    {
+        throw diskann::ANNException("PQScratch space has not been set in the scratch object.", -1);
+    }
+
+    // aligned_query_float holds the aligned full dimension, which is at least
+    // _aligned_pca_dims
+    project(query, 1, pq_scratch->aligned_query_float);
+}
+
+// Used for the few start points of a search, before the query is projected
+// into a scratch
+template <typename data_t> float PCADataStore<data_t>::get_distance(const data_t *query, const location_t loc) const
+{
+    float *projected = nullptr;
+    alloc_aligned((void **)&projected, _aligned_pca_dims * sizeof(float), 8 * sizeof(float));
+    project(query, 1, projected);
+    const float result = _projected_distance_fn->compare(projected, _vectors + (size_t)loc * _aligned_pca_dims,
+                                                         (uint32_t)_aligned_pca_dims);
+    aligned_free(projected);
+    return result;
+}
+
+template <typename data_t> float PCADataStore<data_t>::get_distance(const location_t loc1, const location_t loc2) const
+{
+    return _projected_distance_fn->compare(_vectors + (size_t)loc1 * _aligned_pca_dims,
+                                           _vectors + (size_t)loc2 * _aligned_pca_dims, (uint32_t)_aligned_pca_dims);
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::get_distance(const data_t *preprocessed_query, const location_t *locations,
+                                        const uint32_t location_count, float *distances,
+                                        AbstractScratch<data_t> *scratch_space) const
+{
+    if (scratch_space == nullptr || scratch_space->pq_scratch() == nullptr)
+    {
+        throw diskann::ANNException("PQScratch not set in scratch space.", -1);
+    }
+    const float *query = scratch_space->pq_scratch()->aligned_query_float;
+
+    const size_t row_bytes = _aligned_pca_dims * sizeof(float);
+    const uint32_t ahead = (std::min)(location_count, defaults::DISTANCE_PREFETCH_AHEAD);
+    for (uint32_t i = 0; i < ahead; i++)
+    {
+        diskann::prefetch_vector((const char *)(_vectors + locations[i] * _aligned_pca_dims), row_bytes);
+    }
+
+    const float *points[4];
+    uint32_t i = 0;
+    if (_batch4_distance_fn != nullptr)
+    {
+        for (; i + 4 <= location_count; i += 4)
+        {
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                if (i + j + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+                {
+                    location_t next = locations[i + j + defaults::DISTANCE_PREFETCH_AHEAD];
+                    diskann::prefetch_vector((const char *)(_vectors + next * _aligned_pca_dims), row_bytes);
+                }
+                points[j] = _vectors + locations[i + j] * _aligned_pca_dims;
+            }
+            _batch4_distance_fn(query, points, (uint32_t)_aligned_pca_dims, distances + i);
+        }
+    }
+    for (; i < location_count; i++)
+    {
+        if (i + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+        {
+            location_t next = locations[i + defaults::DISTANCE_PREFETCH_AHEAD];
+            diskann::prefetch_vector((const char *)(_vectors + next * _aligned_pca_dims), row_bytes);
+        }
+        distances[i] = _projected_distance_fn->compare(query, _vectors + locations[i] * _aligned_pca_dims,
+                                                       (uint32_t)_aligned_pca_dims);
+    }
+}
+
+template <typename data_t>
+void PCADataStore<data_t>::get_distance(const data_t *preprocessed_query, const std::vector<location_t> &ids,
+                                        std::vector<float> &distances, AbstractScratch<data_t> *scratch_space) const
+{
+    if (distances.size() < ids.size())
+    {
+        distances.resize(ids.size());
+    }
+    PCADataStore<data_t>::get_distance(preprocessed_query, ids.data(), (uint32_t)ids.size(), distances.data(),
+                                       scratch_space);
+}
+
+template <typename data_t> Distance<data_t> *PCADataStore<data_t>::get_dist_fn() const
+{
+    return _distance_fn.get();
+}
+
+// Returns the point whose projection is closest to the mean of all the
+// projections
+template <typename data_t> location_t PCADataStore<data_t>::calculate_medoid() const
+{
+    std::vector<double> center(_aligned_pca_dims, 0);
+    for (location_t i = 0; i < this->capacity(); i++)
+    {
+        const float *projected = _vectors + (size_t)i * _aligned_pca_dims;
+        for (size_t r = 0; r < _num_pca_dims; r++)
+            center[r] += projected[r];
+    }
+    for (size_t r = 0; r < _num_pca_dims; r++)
+        center[r] /= (double)this->capacity();
+
+    location_t min_idx = 0;
+    double min_dist = (std::numeric_limits<double>::max)();
+    for (location_t i = 0; i < this->capacity(); i++)
+    {
+        const float *projected = _vectors + (size_t)i * _aligned_pca_dims;
+        double dist = 0;
+        for (size_t r = 0; r < _num_pca_dims; r++)
+            dist += (projected[r] - center[r]) * (projected[r] - center[r]);
+        if (dist < min_dist)
+        {
+            min_idx = i;
+            min_dist = dist;
+        }
+    }
+    return min_idx;
+}
+
+template <typename data_t> size_t PCADataStore<data_t>::get_alignment_factor() const
+{
+    return 1;
+}
+
+template <typename data_t> size_t PCADataStore<data_t>::memory_size() const
+{
+    return this->capacity() * _aligned_pca_dims * sizeof(float) + vector_bytes(_components);
+}
+
+template <typename data_t> void PCADataStore<data_t>::reallocate_vectors(const location_t new_size)
+{
+    const size_t row_bytes = _aligned_pca_dims * sizeof(float);
+    float *new_vectors;
+    alloc_aligned((void **)&new_vectors, (size_t)new_size * row_bytes, 8 * sizeof(float));
+    memset(new_vectors, 0, (size_t)new_size * row_bytes);
+    memcpy(new_vectors, _vectors, (size_t)(std::min)(new_size, this->capacity()) * row_bytes);
+    aligned_free(_vectors);
+    _vectors = new_vectors;
+    this->_capacity = new_size;
+}
+
+template <typename data_t> location_t PCADataStore<data_t>::expand(const location_t new_size)
+{
+    if (new_size == this->capacity())
+    {
+        return this->capacity();
+    }
+    else if (new_size < this->capacity())
+    {
+        std::stringstream ss;
+        ss << "Cannot 'expand' datastore when new capacity (" << new_size << ") < existing capacity("
+           << this->capacity() << ")" << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+    reallocate_vectors(new_size);
+    return this->_capacity;
+}
+
+template <typename data_t> location_t PCADataStore<data_t>::shrink(const location_t new_size)
+{
+    if (new_size == this->capacity())
+    {
+        return this->capacity();
+    }
+    else if (new_size > this->capacity())
+    {
+        std::stringstream ss;
+        ss << "Cannot 'shrink' datastore when new capacity (" << new_size << ") > existing capacity("
+           << this->capacity() << ")" << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+    reallocate_vectors(new_size);
+    return this->_capacity;
+}
+
+template DISKANN_DLLEXPORT class PCADataStore<int8_t>;
+template DISKANN_DLLEXPORT class PCADataStore<float16>;
+template DISKANN_DLLEXPORT class PCADataStore<bfloat16>;
+template DISKANN_DLLEXPORT class PCADataStore<float>;
+template DISKANN_DLLEXPORT class PCADataStore<uint8_t>;
+
+} // namespace diskann
@@ -1,11 +1,14 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
-#include "mkl.h"
+#include "blas_compat.h"
+#include <future>
+#include "simd_utils.h"
 #if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
 #include "gperftools/malloc_extension.h"
 #endif
 #include "pq.h"
+#include "build_profiler.h"
 #include "partition.h"
 #include "math_utils.h"
 #include "tsl/robin_map.h"
@@ -89,14 +92,18 @@ void FixedChunkPQTable::load_pq_centroid_bin(const char *pq_table_file, size_t n
     diskann::load_bin<float>(pq_table_file, tables, nr, nc, file_offset_data[0]);
 #endif
 
-    if ((nr != NUM_PQ_CENTROIDS))
+    const bool wide = nr > NUM_PQ_CENTROIDS && nr <= MAX_NUM_PQ_CENTROIDS_WIDE && (nr & (nr - 1)) == 0;
+    if ((nr != NUM_PQ_CENTROIDS) && (nr != NUM_PQ_CENTROIDS_FAST_SCAN) && !wide)
     {
         diskann::cout << "Error reading pq_pivots file " << pq_table_file << ". file_num_centers  = " << nr
-                      << " but expecting " << NUM_PQ_CENTROIDS << " centers";
+                      << " but expecting " << NUM_PQ_CENTROIDS << ", " << NUM_PQ_CENTROIDS_FAST_SCAN
+                      << " or a power of two up to " << MAX_NUM_PQ_CENTROIDS_WIDE << " centers";
         throw diskann::ANNException("Error reading pq_pivots file at pivots data.", -1, __FUNCSIG__, __FILE__,
                                     __LINE__);
     }
 
+    this->n_centers = nr;
+    this->table_stride = (std::max)((uint64_t)NUM_PQ_CENTROIDS, this->n_centers);
     this->ndims = nc;
 
 #ifdef EXEC_ENV_OLS
@@ -132,7 +139,7 @@ void FixedChunkPQTable::load_pq_centroid_bin(const char *pq_table_file, size_t n
     }
 
     this->n_chunks = nr - 1;
-    diskann::cout << "Loaded PQ Pivots: #ctrs: " << NUM_PQ_CENTROIDS << ", #dims: " << this->ndims
+    diskann::cout << "Loaded PQ Pivots: #ctrs: " << this->n_centers << ", #dims: " << this->ndims
                   << ", #chunks: " << this->n_chunks << std::endl;
 
 #ifdef EXEC_ENV_OLS
@@ -152,13 +159,27 @@ void FixedChunkPQTable::load_pq_centroid_bin(const char *pq_table_file, size_t n
         use_rotation = true;
     }
 
-    // alloc and compute transpose
-    tables_tr = new float[256 * this->ndims];
-    for (size_t i = 0; i < 256; i++)
+    // alloc and compute transpose; rows are at least 256 wide so that codes
+    // index the same way for 4-bit and 8-bit codebooks
+    tables_tr = new float[table_stride * this->ndims]();
+    for (size_t i = 0; i < this->n_centers; i++)
     {
         for (size_t j = 0; j < this->ndims; j++)
         {
-            tables_tr[j * 256 + i] = tables[i * this->ndims + j];
+            tables_tr[j * table_stride + i] = tables[i * this->ndims + j];
+        }
+    }
+
+    // squared norms of the centers within each chunk, for the batched tables
+    center_sq_norms.assign(table_stride * n_chunks, 0.0f);
+    for (size_t chunk = 0; chunk < n_chunks; chunk++)
+    {
+        float *chunk_norms = center_sq_norms.data() + table_stride * chunk;
+        for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
+        {
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
+            for (size_t idx = 0; idx < n_centers; idx++)
+                chunk_norms[idx] += centers_dim_vec[idx] * centers_dim_vec[idx];
         }
     }
 }
@@ -168,6 +189,28 @@ uint32_t FixedChunkPQTable::get_num_chunks()
     return static_cast<uint32_t>(n_chunks);
 }
 
+uint32_t FixedChunkPQTable::get_num_centers()
+{
+    return static_cast<uint32_t>(n_centers);
+}
+
+uint32_t FixedChunkPQTable::get_table_stride()
+{
+    return static_cast<uint32_t>(table_stride);
+}
+
+size_t FixedChunkPQTable::memory_size() const
+{
+    if (tables == nullptr)
+        return 0;
+    // tables and their transpose tables_tr, the centroid and chunk offsets
+    size_t bytes = (n_centers + table_stride) * ndims * sizeof(float) + ndims * sizeof(float) +
+                   (n_chunks + 1) * sizeof(uint32_t) + center_sq_norms.size() * sizeof(float);
+    if (use_rotation)
+        bytes += ndims * ndims * sizeof(float);
+    return bytes;
+}
+
 void FixedChunkPQTable::preprocess_query(float *query_vec)
 {
     for (uint32_t d = 0; d < ndims; d++)
@@ -191,16 +234,16 @@ void FixedChunkPQTable::preprocess_query(float *query_vec)
 // assumes pre-processed query
 void FixedChunkPQTable::populate_chunk_distances(const float *query_vec, float *dist_vec)
 {
-    memset(dist_vec, 0, 256 * n_chunks * sizeof(float));
+    memset(dist_vec, 0, table_stride * n_chunks * sizeof(float));
     // chunk wise distance computation
     for (size_t chunk = 0; chunk < n_chunks; chunk++)
     {
         // sum (q-c)^2 for the dimensions associated with this chunk
-        float *chunk_dists = dist_vec + (256 * chunk);
+        float *chunk_dists = dist_vec + (table_stride * chunk);
         for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
         {
-            const float *centers_dim_vec = tables_tr + (256 * j);
-            for (size_t idx = 0; idx < 256; idx++)
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
+            for (size_t idx = 0; idx < n_centers; idx++)
             {
                 double diff = centers_dim_vec[idx] - (query_vec[j]);
                 chunk_dists[idx] += (float)(diff * diff);
@@ -209,6 +252,83 @@ void FixedChunkPQTable::populate_chunk_distances(const float *query_vec, float *
     }
 }
 
+// assumes an unrotated query with a zero centroid, as binary PQ has
+void FixedChunkPQTable::populate_chunk_hamming_distances(const float *query_vec, float *dist_vec)
+{
+    memset(dist_vec, 0, table_stride * n_chunks * sizeof(float));
+    for (size_t chunk = 0; chunk < n_chunks; chunk++)
+    {
+        float *chunk_dists = dist_vec + (table_stride * chunk);
+        for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
+        {
+            const uint32_t query_byte = (uint32_t)query_vec[j];
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
+            for (size_t idx = 0; idx < n_centers; idx++)
+            {
+                uint32_t diff = query_byte ^ (uint32_t)centers_dim_vec[idx];
+                // popcount of a byte
+                diff = diff - ((diff >> 1) & 0x55);
+                diff = (diff & 0x33) + ((diff >> 2) & 0x33);
+                chunk_dists[idx] += (float)((diff + (diff >> 4)) & 0x0f);
+            }
+        }
+    }
+}
+
+// ||q - c||^2 = ||q||^2 - 2 <q, c> + ||c||^2 per chunk, with the inner
+// products of all queries and centers of a chunk in one GEMM
+void FixedChunkPQTable::populate_chunk_tables_batch(const float *query_vecs, const size_t nq,
+                                                    const size_t query_stride, float *const *dist_vecs,
+                                                    const bool inner_product)
+{
+    if (nq == 0)
+        return;
+    std::vector<float> prods(nq * n_centers);
+    for (size_t chunk = 0; chunk < n_chunks; chunk++)
+    {
+        const size_t first_dim = chunk_offsets[chunk];
+        const size_t chunk_dims = chunk_offsets[chunk + 1] - first_dim;
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, (MKL_INT)nq, (MKL_INT)n_centers, (MKL_INT)chunk_dims,
+                    inner_product ? -1.0f : -2.0f, query_vecs + first_dim, (MKL_INT)query_stride,
+                    tables_tr + table_stride * first_dim, (MKL_INT)table_stride, 0.0f, prods.data(),
+                    (MKL_INT)n_centers);
+
+        const float *chunk_norms = center_sq_norms.data() + table_stride * chunk;
+        for (size_t q = 0; q < nq; q++)
+        {
+            float *chunk_dists = dist_vecs[q] + table_stride * chunk;
+            const float *q_prods = prods.data() + q * n_centers;
+            if (inner_product)
+            {
+                memcpy(chunk_dists, q_prods, n_centers * sizeof(float));
+            }
+            else
+            {
+                const float *q_chunk = query_vecs + q * query_stride + first_dim;
+                float q_norm = 0;
+                for (size_t j = 0; j < chunk_dims; j++)
+                    q_norm += q_chunk[j] * q_chunk[j];
+                for (size_t idx = 0; idx < n_centers; idx++)
+                    chunk_dists[idx] = (std::max)(q_prods[idx] + q_norm + chunk_norms[idx], 0.0f);
+            }
+            if (table_stride > n_centers)
+                memset(chunk_dists + n_centers, 0, (table_stride - n_centers) * sizeof(float));
+        }
+    }
+}
+
+void FixedChunkPQTable::populate_chunk_distances_batch(const float *query_vecs, const size_t nq,
+                                                       const size_t query_stride, float *const *dist_vecs)
+{
+    populate_chunk_tables_batch(query_vecs, nq, query_stride, dist_vecs, false);
+}
+
+void FixedChunkPQTable::populate_chunk_inner_products_batch(const float *query_vecs, const size_t nq,
+                                                            const size_t query_stride, float *const *dist_vecs)
+{
+    populate_chunk_tables_batch(query_vecs, nq, query_stride, dist_vecs, true);
+}
+
 float FixedChunkPQTable::l2_distance(const float *query_vec, uint8_t *base_vec)
 {
     float res = 0;
@@ -216,7 +336,7 @@ float FixedChunkPQTable::l2_distance(const float *query_vec, uint8_t *base_vec)
     {
         for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
         {
-            const float *centers_dim_vec = tables_tr + (256 * j);
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
             float diff = centers_dim_vec[base_vec[chunk]] - (query_vec[j]);
             res += diff * diff;
         }
@@ -231,7 +351,7 @@ float FixedChunkPQTable::inner_product(const float *query_vec, uint8_t *base_vec
     {
         for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
         {
-            const float *centers_dim_vec = tables_tr + (256 * j);
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
             float diff = centers_dim_vec[base_vec[chunk]] * query_vec[j]; // assumes centroid is 0 to
                                                                           // prevent translation errors
             res += diff;
@@ -248,7 +368,7 @@ void FixedChunkPQTable::inflate_vector(uint8_t *base_vec, float *out_vec)
     {
         for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
         {
-            const float *centers_dim_vec = tables_tr + (256 * j);
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
             out_vec[j] = centers_dim_vec[base_vec[chunk]] + centroid[j];
         }
     }
@@ -256,16 +376,16 @@ void FixedChunkPQTable::inflate_vector(uint8_t *base_vec, float *out_vec)
 
 void FixedChunkPQTable::populate_chunk_inner_products(const float *query_vec, float *dist_vec)
 {
-    memset(dist_vec, 0, 256 * n_chunks * sizeof(float));
+    memset(dist_vec, 0, table_stride * n_chunks * sizeof(float));
     // chunk wise distance computation
     for (size_t chunk = 0; chunk < n_chunks; chunk++)
     {
         // sum (q-c)^2 for the dimensions associated with this chunk
-        float *chunk_dists = dist_vec + (256 * chunk);
+        float *chunk_dists = dist_vec + (table_stride * chunk);
         for (size_t j = chunk_offsets[chunk]; j < chunk_offsets[chunk + 1]; j++)
         {
-            const float *centers_dim_vec = tables_tr + (256 * j);
-            for (size_t idx = 0; idx < 256; idx++)
+            const float *centers_dim_vec = tables_tr + (table_stride * j);
+            for (size_t idx = 0; idx < n_centers; idx++)
             {
                 double prod = centers_dim_vec[idx] * query_vec[j]; // assumes that we are not
                                                                    // shifting the vectors to
@@ -344,6 +464,295 @@ void pq_dist_lookup(const uint8_t *pq_ids, const size_t n_pts, const size_t pq_n
     }
 }
 
+void gather_pq_dist_lookup(const uint32_t *ids, const size_t n_ids, const uint8_t *all_coords, const size_t pq_nchunks,
+                           const float *pq_dists, float *dists_out)
+{
+    size_t i = 0;
+#ifdef USE_AVX2
+    // 8 points at a time. Four consecutive code bytes of each point are loaded
+    // into one 32-bit lane, and every byte indexes a gather from the table of
+    // its chunk. The rows of the next 8 points are prefetched meanwhile.
+    const __m256i byte_mask = _mm256_set1_epi32(0xff);
+    const size_t nchunks_by_4 = pq_nchunks & ~(size_t)3;
+    const uint8_t *rows[8];
+    for (size_t p = 0; p < 8 && p < n_ids; p++)
+        _mm_prefetch((const char *)(all_coords + (size_t)ids[p] * pq_nchunks), _MM_HINT_T0);
+    for (; i + 8 <= n_ids; i += 8)
+    {
+        for (size_t p = 0; p < 8; p++)
+            rows[p] = all_coords + (size_t)ids[i + p] * pq_nchunks;
+        for (size_t p = i + 8; p < i + 16 && p < n_ids; p++)
+            _mm_prefetch((const char *)(all_coords + (size_t)ids[p] * pq_nchunks), _MM_HINT_T0);
+
+        __m256 acc = _mm256_setzero_ps();
+        size_t chunk = 0;
+        for (; chunk < nchunks_by_4; chunk += 4)
+        {
+            alignas(32) uint32_t words[8];
+            for (size_t p = 0; p < 8; p++)
+                memcpy(words + p, rows[p] + chunk, sizeof(uint32_t));
+            const __m256i codes = _mm256_load_si256((const __m256i *)words);
+            const float *chunk_dists = pq_dists + 256 * chunk;
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(chunk_dists, _mm256_and_si256(codes, byte_mask), 4));
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(chunk_dists + 256,
+                                                         _mm256_and_si256(_mm256_srli_epi32(codes, 8), byte_mask), 4));
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(chunk_dists + 512,
+                                                         _mm256_and_si256(_mm256_srli_epi32(codes, 16), byte_mask), 4));
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(chunk_dists + 768, _mm256_srli_epi32(codes, 24), 4));
+        }
+        for (; chunk < pq_nchunks; chunk++)
+        {
+            const __m256i codes = _mm256_setr_epi32(rows[0][chunk], rows[1][chunk], rows[2][chunk], rows[3][chunk],
+                                                    rows[4][chunk], rows[5][chunk], rows[6][chunk], rows[7][chunk]);
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(pq_dists + 256 * chunk, codes, 4));
+        }
+        _mm256_storeu_ps(dists_out + i, acc);
+    }
+#elif defined(USE_NEON)
+    // NEON has no gather: 4 points at a time, so that the table loads of
+    // the four overlap, with the rows of the next 4 points prefetched.
+    const uint8_t *rows[4];
+    for (size_t p = 0; p < 4 && p < n_ids; p++)
+        _mm_prefetch((const char *)(all_coords + (size_t)ids[p] * pq_nchunks), _MM_HINT_T0);
+    for (; i + 4 <= n_ids; i += 4)
+    {
+        for (size_t p = 0; p < 4; p++)
+            rows[p] = all_coords + (size_t)ids[i + p] * pq_nchunks;
+        for (size_t p = i + 4; p < i + 8 && p < n_ids; p++)
+            _mm_prefetch((const char *)(all_coords + (size_t)ids[p] * pq_nchunks), _MM_HINT_T0);
+
+        float32x4_t acc = vdupq_n_f32(0);
+        for (size_t chunk = 0; chunk < pq_nchunks; chunk++)
+        {
+            const float *chunk_dists = pq_dists + 256 * chunk;
+            const float lanes[4] = {chunk_dists[rows[0][chunk]], chunk_dists[rows[1][chunk]],
+                                    chunk_dists[rows[2][chunk]], chunk_dists[rows[3][chunk]]};
+            acc = vaddq_f32(acc, vld1q_f32(lanes));
+        }
+        vst1q_f32(dists_out + i, acc);
+    }
+#endif
+    for (; i < n_ids; i++)
+    {
+        const uint8_t *row = all_coords + (size_t)ids[i] * pq_nchunks;
+        float dist = 0;
+        for (size_t chunk = 0; chunk < pq_nchunks; chunk++)
+            dist += pq_dists[256 * chunk + row[chunk]];
+        dists_out[i] = dist;
+    }
+}
+
+void gather_pq_dist_lookup_wide(const uint32_t *ids, const size_t n_ids, const uint16_t *all_codes,
+                                const size_t pq_nchunks, const size_t table_stride, const float *pq_dists,
+                                float *dists_out)
+{
+    size_t i = 0;
+#ifdef USE_AVX2
+    // As gather_pq_dist_lookup, but a 32-bit lane holds the codes of two
+    // chunks. A chunk table of 4096 or more floats does not stay in L1, so
+    // the eight loads of a gather are left to overlap their misses rather
+    // than prefetched; only the code rows of the next 8 points are.
+    const __m256i code_mask = _mm256_set1_epi32(0xffff);
+    const size_t nchunks_by_2 = pq_nchunks & ~(size_t)1;
+    const uint16_t *rows[8];
+    for (size_t p = 0; p < 8 && p < n_ids; p++)
+        _mm_prefetch((const char *)(all_codes + (size_t)ids[p] * pq_nchunks), _MM_HINT_T0);
+    for (; i + 8 <= n_ids; i += 8)
+    {
+        for (size_t p = 0; p < 8; p++)
+            rows[p] = all_codes + (size_t)ids[i + p] * pq_nchunks;
+        for (size_t p = i + 8; p < i + 16 && p < n_ids; p++)
+            _mm_prefetch((const char *)(all_codes + (size_t)ids[p] * pq_nchunks), _MM_HINT_T0);
+
+        __m256 acc = _mm256_setzero_ps();
+        size_t chunk = 0;
+        for (; chunk < nchunks_by_2; chunk += 2)
+        {
+            alignas(32) uint32_t words[8];
+            for (size_t p = 0; p < 8; p++)
+                memcpy(words + p, rows[p] + chunk, sizeof(uint32_t));
+            const __m256i codes = _mm256_load_si256((const __m256i *)words);
+            const float *chunk_dists = pq_dists + table_stride * chunk;
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(chunk_dists, _mm256_and_si256(codes, code_mask), 4));
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(chunk_dists + table_stride, _mm256_srli_epi32(codes, 16), 4));
+        }
+        if (chunk < pq_nchunks)
+        {
+            const __m256i codes = _mm256_setr_epi32(rows[0][chunk], rows[1][chunk], rows[2][chunk], rows[3][chunk],
+                                                    rows[4][chunk], rows[5][chunk], rows[6][chunk], rows[7][chunk]);
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(pq_dists + table_stride * chunk, codes, 4));
+        }
+        _mm256_storeu_ps(dists_out + i, acc);
+    }
+#endif
+    for (; i < n_ids; i++)
+    {
+        const uint16_t *row = all_codes + (size_t)ids[i] * pq_nchunks;
+        float dist = 0;
+        for (size_t chunk = 0; chunk < pq_nchunks; chunk++)
+            dist += pq_dists[table_stride * chunk + row[chunk]];
+        dists_out[i] = dist;
+    }
+}
+
+void pack_fast_scan_codes(const uint8_t *codes, const size_t n_pts, const size_t n_chunks, uint8_t *packed)
+{
+    const size_t code_len = DIV_ROUND_UP(n_chunks, 2);
+    for (size_t i = 0; i < n_pts; i++)
+    {
+        const uint8_t *in = codes + i * n_chunks;
+        uint8_t *out = packed + i * code_len;
+        for (size_t b = 0; b < code_len; b++)
+        {
+            uint8_t hi = (2 * b + 1 < n_chunks) ? in[2 * b + 1] : 0;
+            out[b] = (uint8_t)((in[2 * b] & 0x0f) | (hi << 4));
+        }
+    }
+}
+
+void unpack_fast_scan_codes(const uint8_t *packed, const size_t n_chunks, uint8_t *codes)
+{
+    for (size_t chunk = 0; chunk < n_chunks; chunk++)
+    {
+        codes[chunk] = (chunk % 2 == 0) ? (packed[chunk / 2] & 0x0f) : (packed[chunk / 2] >> 4);
+    }
+}
+
+void quantize_fast_scan_lut(const float *pq_dists, const size_t n_chunks, FastScanLUT &out)
+{
+    const size_t n_padded = ROUND_UP(n_chunks, 2);
+    // entries are summed in uint16 lanes, so cap them such that the sum over
+    // all chunks cannot overflow
+    const float qmax = (float)(std::min)((size_t)255, (size_t)65535 / n_padded);
+
+    std::vector<float> mins(n_chunks);
+    float max_range = 0;
+    out.bias = 0;
+    for (size_t chunk = 0; chunk < n_chunks; chunk++)
+    {
+        const float *chunk_dists = pq_dists + 256 * chunk;
+        float lo = chunk_dists[0], hi = chunk_dists[0];
+        for (size_t idx = 1; idx < NUM_PQ_CENTROIDS_FAST_SCAN; idx++)
+        {
+            lo = (std::min)(lo, chunk_dists[idx]);
+            hi = (std::max)(hi, chunk_dists[idx]);
+        }
+        mins[chunk] = lo;
+        out.bias += lo;
+        max_range = (std::max)(max_range, hi - lo);
+    }
+    out.scale = max_range > 0 ? max_range / qmax : 1.0f;
+
+    for (size_t chunk = 0; chunk < n_chunks; chunk++)
+    {
+        const float *chunk_dists = pq_dists + 256 * chunk;
+        uint8_t *chunk_lut = out.lut + NUM_PQ_CENTROIDS_FAST_SCAN * chunk;
+        for (size_t idx = 0; idx < NUM_PQ_CENTROIDS_FAST_SCAN; idx++)
+        {
+            float q = std::round((chunk_dists[idx] - mins[chunk]) / out.scale);
+            chunk_lut[idx] = (uint8_t)(std::min)(q, qmax);
+        }
+    }
+    if (n_padded != n_chunks)
+        memset(out.lut + NUM_PQ_CENTROIDS_FAST_SCAN * n_chunks, 0, NUM_PQ_CENTROIDS_FAST_SCAN);
+}
+
+void fast_scan_dist_lookup(const uint8_t *packed_codes, const size_t n_pts, const size_t pq_nchunks,
+                           const FastScanLUT &lut, float *dists_out)
+{
+    const size_t code_len = DIV_ROUND_UP(pq_nchunks, 2);
+    size_t i = 0;
+#ifdef USE_AVX2
+    // FastScan: 32 points at a time. Byte b of all 32 points goes into one
+    // register; both nibbles are looked up with pshufb against the 16-entry
+    // tables of chunks 2b and 2b+1 and accumulated in uint16 lanes.
+    alignas(32) uint8_t block[32];
+    alignas(32) uint16_t sums[32];
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 32 <= n_pts; i += 32)
+    {
+        __m256i acc_lo = _mm256_setzero_si256();
+        __m256i acc_hi = _mm256_setzero_si256();
+        for (size_t b = 0; b < code_len; b++)
+        {
+            const uint8_t *src = packed_codes + i * code_len + b;
+            for (size_t p = 0; p < 32; p++)
+                block[p] = src[p * code_len];
+            __m256i codes = _mm256_load_si256((const __m256i *)block);
+            __m256i lo = _mm256_and_si256(codes, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(codes, 4), low_mask);
+
+            const uint8_t *tables = lut.lut + 2 * NUM_PQ_CENTROIDS_FAST_SCAN * b;
+            __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables));
+            __m256i lut_hi =
+                _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(tables + NUM_PQ_CENTROIDS_FAST_SCAN)));
+            __m256i d_lo = _mm256_shuffle_epi8(lut_lo, lo);
+            __m256i d_hi = _mm256_shuffle_epi8(lut_hi, hi);
+
+            acc_lo = _mm256_add_epi16(acc_lo, _mm256_unpacklo_epi8(d_lo, zero));
+            acc_lo = _mm256_add_epi16(acc_lo, _mm256_unpacklo_epi8(d_hi, zero));
+            acc_hi = _mm256_add_epi16(acc_hi, _mm256_unpackhi_epi8(d_lo, zero));
+            acc_hi = _mm256_add_epi16(acc_hi, _mm256_unpackhi_epi8(d_hi, zero));
+        }
+        // unpack works per 128-bit lane: acc_lo holds points 0-7 and 16-23,
+        // acc_hi holds points 8-15 and 24-31
+        _mm256_store_si256((__m256i *)sums, acc_lo);
+        _mm256_store_si256((__m256i *)(sums + 16), acc_hi);
+        for (size_t p = 0; p < 8; p++)
+        {
+            dists_out[i + p] = lut.bias + lut.scale * sums[p];
+            dists_out[i + 8 + p] = lut.bias + lut.scale * sums[16 + p];
+            dists_out[i + 16 + p] = lut.bias + lut.scale * sums[8 + p];
+            dists_out[i + 24 + p] = lut.bias + lut.scale * sums[24 + p];
+        }
+    }
+#elif defined(USE_NEON)
+    // As above with tbl for pshufb, 16 points to a register. The widening
+    // adds keep the points in order.
+    alignas(16) uint8_t block[32];
+    alignas(16) uint16_t sums[32];
+    const uint8x16_t low_mask = vdupq_n_u8(0x0f);
+    for (; i + 32 <= n_pts; i += 32)
+    {
+        uint16x8_t acc[4] = {vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0)};
+        for (size_t b = 0; b < code_len; b++)
+        {
+            const uint8_t *src = packed_codes + i * code_len + b;
+            for (size_t p = 0; p < 32; p++)
+                block[p] = src[p * code_len];
+
+            const uint8_t *tables = lut.lut + 2 * NUM_PQ_CENTROIDS_FAST_SCAN * b;
+            const uint8x16_t lut_lo = vld1q_u8(tables);
+            const uint8x16_t lut_hi = vld1q_u8(tables + NUM_PQ_CENTROIDS_FAST_SCAN);
+            for (size_t half = 0; half < 2; half++)
+            {
+                const uint8x16_t codes = vld1q_u8(block + 16 * half);
+                const uint8x16_t d_lo = vqtbl1q_u8(lut_lo, vandq_u8(codes, low_mask));
+                const uint8x16_t d_hi = vqtbl1q_u8(lut_hi, vshrq_n_u8(codes, 4));
+                acc[2 * half] = vaddw_u8(vaddw_u8(acc[2 * half], vget_low_u8(d_lo)), vget_low_u8(d_hi));
+                acc[2 * half + 1] = vaddw_high_u8(vaddw_high_u8(acc[2 * half + 1], d_lo), d_hi);
+            }
+        }
+        for (size_t r = 0; r < 4; r++)
+            vst1q_u16(sums + 8 * r, acc[r]);
+        for (size_t p = 0; p < 32; p++)
+            dists_out[i + p] = lut.bias + lut.scale * sums[p];
+    }
+#endif
+    for (; i < n_pts; i++)
+    {
+        const uint8_t *codes = packed_codes + i * code_len;
+        uint32_t sum = 0;
+        for (size_t b = 0; b < code_len; b++)
+        {
+            const uint8_t *tables = lut.lut + 2 * NUM_PQ_CENTROIDS_FAST_SCAN * b;
+            sum += tables[codes[b] & 0x0f] + tables[NUM_PQ_CENTROIDS_FAST_SCAN + (codes[b] >> 4)];
+        }
+        dists_out[i] = lut.bias + lut.scale * sum;
+    }
+}
+
 // generate_pq_pivots_simplified is a simplified version of generate_pq_pivots.
 // Input is provided in the in-memory buffer train_data.
 // Output is stored in the in-memory buffer pivot_data_vector.
@@ -390,8 +799,8 @@ int generate_pq_pivots_simplified(const float *train_data, size_t num_train, siz
 
         kmeans::kmeanspp_selecting_pivots(cur_data, num_train, cur_chunk_size, cur_pivot_data, num_centers);
 
-        kmeans::run_lloyds(cur_data, num_train, cur_chunk_size, cur_pivot_data, num_centers, KMEANS_ITERS_FOR_PQ, NULL,
-                           closest_center);
+        kmeans::run_bounded_lloyds(cur_data, num_train, cur_chunk_size, cur_pivot_data, num_centers,
+                                   KMEANS_ITERS_FOR_PQ, NULL, closest_center);
 
         for (uint64_t j = 0; j < num_centers; j++)
         {
@@ -534,8 +943,8 @@ int generate_pq_pivots(const float *const passed_train_data, size_t num_train, u
 
         kmeans::kmeanspp_selecting_pivots(cur_data.get(), num_train, cur_chunk_size, cur_pivot_data.get(), num_centers);
 
-        kmeans::run_lloyds(cur_data.get(), num_train, cur_chunk_size, cur_pivot_data.get(), num_centers,
-                           max_k_means_reps, NULL, closest_center.get());
+        kmeans::run_bounded_lloyds(cur_data.get(), num_train, cur_chunk_size, cur_pivot_data.get(), num_centers,
+                                   max_k_means_reps, NULL, closest_center.get());
 
         for (uint64_t j = 0; j < num_centers; j++)
         {
@@ -560,6 +969,130 @@ int generate_pq_pivots(const float *const passed_train_data, size_t num_train, u
     return 0;
 }
 
+// PQ pivots for the Hamming distance on bit-packed vectors: the bytes are
+// split into num_pq_chunks contiguous chunks, and the centers of each chunk are
+// bit strings clustered by k-majority, which assigns every vector to its
+// closest center in Hamming distance and sets each bit of a center to the
+// majority of its vectors. The pivots hold the center bytes as floats, with a
+// zero centroid, in the format of generate_pq_pivots.
+int generate_binary_pq_pivots(const float *const train_data, size_t num_train, uint32_t dim, uint32_t num_centers,
+                              uint32_t num_pq_chunks, uint32_t max_k_means_reps, std::string pq_pivots_path)
+{
+    if (num_pq_chunks > dim)
+    {
+        diskann::cout << " Error: number of chunks more than dimension" << std::endl;
+        return -1;
+    }
+    if (num_train == 0)
+    {
+        diskann::cout << " Error: no training data" << std::endl;
+        return -1;
+    }
+
+    std::vector<uint32_t> chunk_offsets(num_pq_chunks + 1);
+    for (uint32_t b = 0; b <= num_pq_chunks; b++)
+        chunk_offsets[b] = (uint32_t)(((uint64_t)b * dim) / num_pq_chunks);
+
+    std::vector<uint8_t> bytes(num_train * dim);
+    for (size_t i = 0; i < num_train * dim; i++)
+        bytes[i] = (uint8_t)train_data[i];
+
+    DistanceHammingUInt8 hamming;
+    std::mt19937 rng(0x5eed);
+    std::unique_ptr<float[]> full_pivot_data = std::make_unique<float[]>((size_t)num_centers * dim);
+    std::vector<float> centroid(dim, 0.0f);
+    for (uint32_t c = 0; c < num_pq_chunks; c++)
+    {
+        const uint32_t chunk_size = chunk_offsets[c + 1] - chunk_offsets[c];
+        if (chunk_size == 0)
+            continue;
+        std::vector<uint8_t> data(num_train * chunk_size);
+        for (size_t j = 0; j < num_train; j++)
+            std::memcpy(data.data() + j * chunk_size, bytes.data() + j * dim + chunk_offsets[c], chunk_size);
+
+        // seeded with random training vectors
+        std::vector<uint8_t> centers((size_t)num_centers * chunk_size);
+        for (uint32_t k = 0; k < num_centers; k++)
+            std::memcpy(centers.data() + (size_t)k * chunk_size, data.data() + (rng() % num_train) * chunk_size,
+                        chunk_size);
+
+        std::vector<uint32_t> closest(num_train, 0);
+        for (uint32_t rep = 0; rep < max_k_means_reps; rep++)
+        {
+            uint64_t changed = 0;
+#pragma omp parallel for schedule(static, 8192) reduction(+ : changed)
+            for (int64_t j = 0; j < (int64_t)num_train; j++)
+            {
+                const uint8_t *point = data.data() + j * chunk_size;
+                uint32_t best = 0;
+                float best_dist = std::numeric_limits<float>::max();
+                for (uint32_t k = 0; k < num_centers; k++)
+                {
+                    const float dist = hamming.compare(point, centers.data() + (size_t)k * chunk_size, chunk_size);
+                    if (dist < best_dist)
+                    {
+                        best_dist = dist;
+                        best = k;
+                    }
+                }
+                changed += closest[j] != best ? 1 : 0;
+                closest[j] = best;
+            }
+            if (rep > 0 && changed == 0)
+                break;
+
+            // the bitwise majority of each cluster; an empty cluster is
+            // reseeded with a random training vector
+            std::vector<uint32_t> bit_counts((size_t)num_centers * chunk_size * 8, 0);
+            std::vector<uint32_t> sizes(num_centers, 0);
+            for (size_t j = 0; j < num_train; j++)
+            {
+                const uint8_t *point = data.data() + j * chunk_size;
+                uint32_t *counts = bit_counts.data() + (size_t)closest[j] * chunk_size * 8;
+                for (uint32_t bit = 0; bit < chunk_size * 8; bit++)
+                    counts[bit] += (point[bit / 8] >> (bit % 8)) & 1;
+                sizes[closest[j]]++;
+            }
+            for (uint32_t k = 0; k < num_centers; k++)
+            {
+                uint8_t *center = centers.data() + (size_t)k * chunk_size;
+                if (sizes[k] == 0)
+                {
+                    std::memcpy(center, data.data() + (rng() % num_train) * chunk_size, chunk_size);
+                    continue;
+                }
+                const uint32_t *counts = bit_counts.data() + (size_t)k * chunk_size * 8;
+                std::memset(center, 0, chunk_size);
+                for (uint32_t bit = 0; bit < chunk_size * 8; bit++)
+                {
+                    if (2 * counts[bit] > sizes[k])
+                        center[bit / 8] |= (uint8_t)(1 << (bit % 8));
+                }
+            }
+        }
+
+        for (uint32_t k = 0; k < num_centers; k++)
+        {
+            for (uint32_t d = 0; d < chunk_size; d++)
+                full_pivot_data[(size_t)k * dim + chunk_offsets[c] + d] = centers[(size_t)k * chunk_size + d];
+        }
+    }
+
+    std::vector<size_t> cumul_bytes(4, 0);
+    cumul_bytes[0] = METADATA_SIZE;
+    cumul_bytes[1] = cumul_bytes[0] + diskann::save_bin<float>(pq_pivots_path.c_str(), full_pivot_data.get(),
+                                                               (size_t)num_centers, dim, cumul_bytes[0]);
+    cumul_bytes[2] = cumul_bytes[1] +
+                     diskann::save_bin<float>(pq_pivots_path.c_str(), centroid.data(), (size_t)dim, 1, cumul_bytes[1]);
+    cumul_bytes[3] = cumul_bytes[2] + diskann::save_bin<uint32_t>(pq_pivots_path.c_str(), chunk_offsets.data(),
+                                                                  chunk_offsets.size(), 1, cumul_bytes[2]);
+    diskann::save_bin<size_t>(pq_pivots_path.c_str(), cumul_bytes.data(), cumul_bytes.size(), 1, 0);
+
+    diskann::cout << "Saved binary pq pivot data to " << pq_pivots_path << " of size "
+                  << cumul_bytes[cumul_bytes.size() - 1] << "B." << std::endl;
+    return 0;
+}
+
 int generate_opq_pivots(const float *passed_train_data, size_t num_train, uint32_t dim, uint32_t num_centers,
                         uint32_t num_pq_chunks, std::string opq_pivots_path, bool make_zero_mean)
 {
@@ -711,8 +1244,8 @@ int generate_opq_pivots(const float *passed_train_data, size_t num_train, uint32
             }
 
             uint32_t num_lloyds_iters = 8;
-            kmeans::run_lloyds(cur_data.get(), num_train, cur_chunk_size, cur_pivot_data.get(), num_centers,
-                               num_lloyds_iters, NULL, closest_center.get());
+            kmeans::run_bounded_lloyds(cur_data.get(), num_train, cur_chunk_size, cur_pivot_data.get(), num_centers,
+                                       num_lloyds_iters, NULL, closest_center.get());
 
             for (uint64_t j = 0; j < num_centers; j++)
             {
@@ -843,13 +1376,18 @@ int generate_pq_data_from_pivots_simplified(const float *data, const size_t num,
 // streams the base file (data_file), and computes the closest centers in each
 // chunk to generate the compressed data_file and stores it in
 // pq_compressed_vectors_path.
-// If the numbber of centers is < 256, it stores as byte vector, else as
-// 4-byte vector in binary format.
+// If the numbber of centers is <= 256, it stores as byte vector, else as
+// 2-byte vector up to 65536 centers and 4-byte vector beyond, in binary
+// format (see get_pq_code_size).
 template <typename T>
 int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks,
                                  const std::string &pq_pivots_path, const std::string &pq_compressed_vectors_path,
-                                 bool use_opq)
+                                 bool use_opq, diskann::Metric metric)
 {
+    const bool hamming = metric == diskann::Metric::HAMMING;
+    if (hamming && (!std::is_same<T, uint8_t>::value || use_opq))
+        throw diskann::ANNException("Hamming PQ codes need uint8 vectors of packed bits and no OPQ", -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
     size_t read_blk_size = 64 * 1024 * 1024;
     cached_ifstream base_reader(data_file, read_blk_size);
     uint32_t npts32;
@@ -938,25 +1476,70 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
     compressed_file_writer.write((char *)&num_pq_chunks_u32, sizeof(uint32_t));
 
     size_t block_size = num_points <= BLOCK_SIZE ? num_points : BLOCK_SIZE;
+    size_t num_blocks = DIV_ROUND_UP(num_points, block_size);
+    size_t code_size = get_pq_code_size(num_centers);
 
 #ifdef SAVE_INFLATED_PQ
     std::ofstream inflated_file_writer(inflated_pq_file, std::ios::binary);
     inflated_file_writer.write((char *)&num_points, sizeof(uint32_t));
     inflated_file_writer.write((char *)&basedim32, sizeof(uint32_t));
+#endif
 
-    std::unique_ptr<float[]> block_inflated_base = std::make_unique<float[]>(block_size * dim);
-    std::memset(block_inflated_base.get(), 0, block_size * dim * sizeof(float));
+    // The blocks go through a three stage pipeline: while one block is
+    // encoded, the next is read and the previous one written out. The read and
+    // written blocks each alternate between two buffers.
+    std::unique_ptr<T[]> block_data_T[2];
+    std::unique_ptr<uint8_t[]> block_codes[2];
+#ifdef SAVE_INFLATED_PQ
+    std::unique_ptr<float[]> block_inflated_base[2];
 #endif
+    for (size_t buf = 0; buf < 2 && buf < num_blocks; buf++)
+    {
+        block_data_T[buf] = std::make_unique<T[]>(block_size * dim);
+        block_codes[buf] = std::make_unique<uint8_t[]>(block_size * num_pq_chunks * code_size);
+#ifdef SAVE_INFLATED_PQ
+        block_inflated_base[buf] = std::make_unique<float[]>(block_size * dim);
+        std::memset(block_inflated_base[buf].get(), 0, block_size * dim * sizeof(float));
+#endif
+    }
 
     std::unique_ptr<uint32_t[]> block_compressed_base =
         std::make_unique<uint32_t[]>(block_size * (size_t)num_pq_chunks);
     std::memset(block_compressed_base.get(), 0, block_size * (size_t)num_pq_chunks * sizeof(uint32_t));
 
-    std::unique_ptr<T[]> block_data_T = std::make_unique<T[]>(block_size * dim);
     std::unique_ptr<float[]> block_data_float = std::make_unique<float[]>(block_size * dim);
     std::unique_ptr<float[]> block_data_tmp = std::make_unique<float[]>(block_size * dim);
 
-    size_t num_blocks = DIV_ROUND_UP(num_points, block_size);
+    // the pivots of each chunk, contiguous as compute_closest_centers expects
+    std::vector<std::unique_ptr<float[]>> chunk_pivot_data(num_pq_chunks);
+    for (size_t i = 0; i < num_pq_chunks; i++)
+    {
+        size_t cur_chunk_size = chunk_offsets[i + 1] - chunk_offsets[i];
+        chunk_pivot_data[i] = std::make_unique<float[]>(num_centers * cur_chunk_size);
+        for (size_t j = 0; j < num_centers; j++)
+        {
+            std::memcpy(chunk_pivot_data[i].get() + j * cur_chunk_size,
+                        full_pivot_data.get() + j * dim + chunk_offsets[i], cur_chunk_size * sizeof(float));
+        }
+    }
+
+    auto block_points = [&](size_t block) {
+        return (std::min)((block + 1) * block_size, num_points) - block * block_size;
+    };
+    auto read_block = [&](size_t block) {
+        base_reader.read((char *)(block_data_T[block % 2].get()), sizeof(T) * (block_points(block) * dim));
+    };
+    auto write_block = [&](size_t block) {
+        compressed_file_writer.write((char *)(block_codes[block % 2].get()),
+                                     block_points(block) * num_pq_chunks * code_size);
+#ifdef SAVE_INFLATED_PQ
+        inflated_file_writer.write((char *)(block_inflated_base[block % 2].get()),
+                                   block_points(block) * dim * sizeof(float));
+#endif
+    };
+
+    std::future<void> reader = std::async(std::launch::async, read_block, 0);
+    std::future<void> writer;
 
     for (size_t block = 0; block < num_blocks; block++)
     {
@@ -964,8 +1547,11 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
         size_t end_id = (std::min)((block + 1) * block_size, num_points);
         size_t cur_blk_size = end_id - start_id;
 
-        base_reader.read((char *)(block_data_T.get()), sizeof(T) * (cur_blk_size * dim));
-        diskann::convert_types<T, float>(block_data_T.get(), block_data_tmp.get(), cur_blk_size, dim);
+        reader.get();
+        if (block + 1 < num_blocks)
+            reader = std::async(std::launch::async, read_block, block + 1);
+
+        diskann::convert_types<T, float>(block_data_T[block % 2].get(), block_data_tmp.get(), cur_blk_size, dim);
 
         diskann::cout << "Processing points  [" << start_id << ", " << end_id << ").." << std::flush;
 
@@ -1001,7 +1587,7 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
             if (cur_chunk_size == 0)
                 continue;
 
-            std::unique_ptr<float[]> cur_pivot_data = std::make_unique<float[]>(num_centers * cur_chunk_size);
+            float *cur_pivot_data = chunk_pivot_data[i].get();
             std::unique_ptr<float[]> cur_data = std::make_unique<float[]>(cur_blk_size * cur_chunk_size);
             std::unique_ptr<uint32_t[]> closest_center = std::make_unique<uint32_t[]>(cur_blk_size);
 
@@ -1012,15 +1598,39 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
                     cur_data[j * cur_chunk_size + k] = block_data_float[j * dim + chunk_offsets[i] + k];
             }
 
-#pragma omp parallel for schedule(static, 1)
-            for (int64_t j = 0; j < (int64_t)num_centers; j++)
+            if (hamming)
             {
-                std::memcpy(cur_pivot_data.get() + j * cur_chunk_size,
-                            full_pivot_data.get() + j * dim + chunk_offsets[i], cur_chunk_size * sizeof(float));
+                // the pivots of binary PQ are center bytes
+                std::vector<uint8_t> chunk_centers(num_centers * cur_chunk_size);
+                for (size_t k = 0; k < num_centers * cur_chunk_size; k++)
+                    chunk_centers[k] = (uint8_t)cur_pivot_data[k];
+                std::vector<uint8_t> chunk_bytes(cur_blk_size * cur_chunk_size);
+                for (size_t k = 0; k < cur_blk_size * cur_chunk_size; k++)
+                    chunk_bytes[k] = (uint8_t)cur_data[k];
+                DistanceHammingUInt8 distance;
+#pragma omp parallel for schedule(static, 8192)
+                for (int64_t j = 0; j < (int64_t)cur_blk_size; j++)
+                {
+                    float best_dist = std::numeric_limits<float>::max();
+                    for (uint32_t k = 0; k < num_centers; k++)
+                    {
+                        const float dist = distance.compare(chunk_bytes.data() + j * cur_chunk_size,
+                                                            chunk_centers.data() + k * cur_chunk_size,
+                                                            (uint32_t)cur_chunk_size);
+                        if (dist < best_dist)
+                        {
+                            best_dist = dist;
+                            closest_center[j] = k;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // one GEMM per chunk against all centers of the chunk
+                math_utils::compute_closest_centers(cur_data.get(), cur_blk_size, cur_chunk_size, cur_pivot_data,
+                                                    num_centers, 1, closest_center.get());
             }
-
-            math_utils::compute_closest_centers(cur_data.get(), cur_blk_size, cur_chunk_size, cur_pivot_data.get(),
-                                                num_centers, 1, closest_center.get());
 
 #pragma omp parallel for schedule(static, 8192)
             for (int64_t j = 0; j < (int64_t)cur_blk_size; j++)
@@ -1028,29 +1638,37 @@ int generate_pq_data_from_pivots(const std::string &data_file, uint32_t num_cent
                 block_compressed_base[j * num_pq_chunks + i] = closest_center[j];
 #ifdef SAVE_INFLATED_PQ
                 for (size_t k = 0; k < cur_chunk_size; k++)
-                    block_inflated_base[j * dim + chunk_offsets[i] + k] =
+                    block_inflated_base[block % 2][j * dim + chunk_offsets[i] + k] =
                         cur_pivot_data[closest_center[j] * cur_chunk_size + k] + centroid[chunk_offsets[i] + k];
 #endif
             }
         }
 
-        if (num_centers > 256)
+        if (code_size == sizeof(uint32_t))
+        {
+            std::memcpy(block_codes[block % 2].get(), block_compressed_base.get(),
+                        cur_blk_size * num_pq_chunks * sizeof(uint32_t));
+        }
+        else if (code_size == sizeof(uint16_t))
         {
-            compressed_file_writer.write((char *)(block_compressed_base.get()),
-                                         cur_blk_size * num_pq_chunks * sizeof(uint32_t));
+            diskann::convert_types<uint32_t, uint16_t>(block_compressed_base.get(),
+                                                       (uint16_t *)block_codes[block % 2].get(), cur_blk_size,
+                                                       num_pq_chunks);
         }
         else
         {
-            std::unique_ptr<uint8_t[]> pVec = std::make_unique<uint8_t[]>(cur_blk_size * num_pq_chunks);
-            diskann::convert_types<uint32_t, uint8_t>(block_compressed_base.get(), pVec.get(), cur_blk_size,
-                                                      num_pq_chunks);
-            compressed_file_writer.write((char *)(pVec.get()), cur_blk_size * num_pq_chunks * sizeof(uint8_t));
+            diskann::convert_types<uint32_t, uint8_t>(block_compressed_base.get(), block_codes[block % 2].get(),
+                                                      cur_blk_size, num_pq_chunks);
         }
-#ifdef SAVE_INFLATED_PQ
-        inflated_file_writer.write((char *)(block_inflated_base.get()), cur_blk_size * dim * sizeof(float));
-#endif
+        // one write in flight at a time; it also frees this block's buffers
+        // for the block after next
+        if (writer.valid())
+            writer.get();
+        writer = std::async(std::launch::async, write_block, block);
         diskann::cout << ".done." << std::endl;
     }
+    if (writer.valid())
+        writer.get();
 // Gopal. Splitting diskann_dll into separate DLLs for search and build.
 // This code should only be available in the "build" DLL.
 #if defined(DISKANN_RELEASE_UNUSED_TCMALLOC_MEMORY_AT_CHECKPOINTS) && defined(DISKANN_BUILD)
@@ -1070,17 +1688,21 @@ void generate_disk_quantized_data(const std::string &data_file_to_use, const std
 {
     size_t train_size, train_dim;
     float *train_data;
+    {
+        BuildProfiler::Stage stage("pq_training");
+        // instantiates train_data with random sample updates train_size
+        gen_random_slice<T>(data_file_to_use.c_str(), p_val, train_data, train_size, train_dim);
+        diskann::cout << "Training data with " << train_size << " samples loaded." << std::endl;
 
-    // instantiates train_data with random sample updates train_size
-    gen_random_slice<T>(data_file_to_use.c_str(), p_val, train_data, train_size, train_dim);
-    diskann::cout << "Training data with " << train_size << " samples loaded." << std::endl;
+        if (disk_pq_dims > train_dim)
+            disk_pq_dims = train_dim;
 
-    if (disk_pq_dims > train_dim)
-        disk_pq_dims = train_dim;
+        std::cout << "Compressing base for disk-PQ into " << disk_pq_dims << " chunks " << std::endl;
+        generate_pq_pivots(train_data, train_size, (uint32_t)train_dim, 256, (uint32_t)disk_pq_dims,
+                           NUM_KMEANS_REPS_PQ, disk_pq_pivots_path, false);
+    }
 
-    std::cout << "Compressing base for disk-PQ into " << disk_pq_dims << " chunks " << std::endl;
-    generate_pq_pivots(train_data, train_size, (uint32_t)train_dim, 256, (uint32_t)disk_pq_dims, NUM_KMEANS_REPS_PQ,
-                       disk_pq_pivots_path, false);
+    BuildProfiler::Stage stage("pq_encoding");
     if (compareMetric == diskann::Metric::INNER_PRODUCT)
         generate_pq_data_from_pivots<float>(data_file_to_use, 256, (uint32_t)disk_pq_dims, disk_pq_pivots_path,
                                             disk_pq_compressed_vectors_path);
@@ -1095,12 +1717,13 @@ template <typename T>
 void generate_quantized_data(const std::string &data_file_to_use, const std::string &pq_pivots_path,
                              const std::string &pq_compressed_vectors_path, diskann::Metric compareMetric,
                              const double p_val, const size_t num_pq_chunks, const bool use_opq,
-                             const std::string &codebook_prefix)
+                             const std::string &codebook_prefix, const uint32_t num_centers)
 {
     size_t train_size, train_dim;
     float *train_data;
     if (!file_exists(codebook_prefix))
     {
+        BuildProfiler::Stage stage("pq_training");
         // instantiates train_data with random sample updates train_size
         gen_random_slice<T>(data_file_to_use.c_str(), p_val, train_data, train_size, train_dim);
         diskann::cout << "Training data with " << train_size << " samples loaded." << std::endl;
@@ -1111,14 +1734,19 @@ void generate_quantized_data(const std::string &data_file_to_use, const std::str
         if (use_opq) // we also do not center the data for OPQ
             make_zero_mean = false;
 
-        if (!use_opq)
+        if (compareMetric == diskann::Metric::HAMMING)
+        {
+            generate_binary_pq_pivots(train_data, train_size, (uint32_t)train_dim, num_centers,
+                                      (uint32_t)num_pq_chunks, NUM_KMEANS_REPS_PQ, pq_pivots_path);
+        }
+        else if (!use_opq)
         {
-            generate_pq_pivots(train_data, train_size, (uint32_t)train_dim, NUM_PQ_CENTROIDS, (uint32_t)num_pq_chunks,
+            generate_pq_pivots(train_data, train_size, (uint32_t)train_dim, num_centers, (uint32_t)num_pq_chunks,
                                NUM_KMEANS_REPS_PQ, pq_pivots_path, make_zero_mean);
         }
         else
         {
-            generate_opq_pivots(train_data, train_size, (uint32_t)train_dim, NUM_PQ_CENTROIDS, (uint32_t)num_pq_chunks,
+            generate_opq_pivots(train_data, train_size, (uint32_t)train_dim, num_centers, (uint32_t)num_pq_chunks,
                                 pq_pivots_path, make_zero_mean);
         }
         delete[] train_data;
@@ -1127,33 +1755,42 @@ void generate_quantized_data(const std::string &data_file_to_use, const std::str
     {
         diskann::cout << "Skip Training with predefined pivots in: " << pq_pivots_path << std::endl;
     }
-    generate_pq_data_from_pivots<T>(data_file_to_use, NUM_PQ_CENTROIDS, (uint32_t)num_pq_chunks, pq_pivots_path,
-                                    pq_compressed_vectors_path, use_opq);
+    BuildProfiler::Stage stage("pq_encoding");
+    generate_pq_data_from_pivots<T>(data_file_to_use, num_centers, (uint32_t)num_pq_chunks, pq_pivots_path,
+                                    pq_compressed_vectors_path, use_opq, compareMetric);
 }
 
 // Instantations of supported templates
 
-template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<int8_t>(const std::string &data_file, uint32_t num_centers,
-                                                                    uint32_t num_pq_chunks,
-                                                                    const std::string &pq_pivots_path,
-                                                                    const std::string &pq_compressed_vectors_path,
-                                                                    bool use_opq);
-template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<uint8_t>(const std::string &data_file, uint32_t num_centers,
-                                                                     uint32_t num_pq_chunks,
-                                                                     const std::string &pq_pivots_path,
-                                                                     const std::string &pq_compressed_vectors_path,
-                                                                     bool use_opq);
-template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<float>(const std::string &data_file, uint32_t num_centers,
-                                                                   uint32_t num_pq_chunks,
-                                                                   const std::string &pq_pivots_path,
-                                                                   const std::string &pq_compressed_vectors_path,
-                                                                   bool use_opq);
+template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<int8_t>(
+    const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks, const std::string &pq_pivots_path,
+    const std::string &pq_compressed_vectors_path, bool use_opq, diskann::Metric metric);
+template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<float16>(
+    const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks, const std::string &pq_pivots_path,
+    const std::string &pq_compressed_vectors_path, bool use_opq, diskann::Metric metric);
+template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<bfloat16>(
+    const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks, const std::string &pq_pivots_path,
+    const std::string &pq_compressed_vectors_path, bool use_opq, diskann::Metric metric);
+template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<uint8_t>(
+    const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks, const std::string &pq_pivots_path,
+    const std::string &pq_compressed_vectors_path, bool use_opq, diskann::Metric metric);
+template DISKANN_DLLEXPORT int generate_pq_data_from_pivots<float>(
+    const std::string &data_file, uint32_t num_centers, uint32_t num_pq_chunks, const std::string &pq_pivots_path,
+    const std::string &pq_compressed_vectors_path, bool use_opq, diskann::Metric metric);
 
 template DISKANN_DLLEXPORT void generate_disk_quantized_data<int8_t>(const std::string &data_file_to_use,
                                                                      const std::string &disk_pq_pivots_path,
                                                                      const std::string &disk_pq_compressed_vectors_path,
                                                                      diskann::Metric compareMetric, const double p_val,
                                                                      size_t &disk_pq_dims);
+template DISKANN_DLLEXPORT void generate_disk_quantized_data<float16>(
+    const std::string &data_file_to_use, const std::string &disk_pq_pivots_path,
+    const std::string &disk_pq_compressed_vectors_path, diskann::Metric compareMetric, const double p_val,
+    size_t &disk_pq_dims);
+template DISKANN_DLLEXPORT void generate_disk_quantized_data<bfloat16>(
+    const std::string &data_file_to_use, const std::string &disk_pq_pivots_path,
+    const std::string &disk_pq_compressed_vectors_path, diskann::Metric compareMetric, const double p_val,
+    size_t &disk_pq_dims);
 
 template DISKANN_DLLEXPORT void generate_disk_quantized_data<uint8_t>(
     const std::string &data_file_to_use, const std::string &disk_pq_pivots_path,
@@ -1171,19 +1808,36 @@ template DISKANN_DLLEXPORT void generate_quantized_data<int8_t>(const std::strin
                                                                 const std::string &pq_compressed_vectors_path,
                                                                 diskann::Metric compareMetric, const double p_val,
                                                                 const size_t num_pq_chunks, const bool use_opq,
-                                                                const std::string &codebook_prefix);
+                                                                const std::string &codebook_prefix,
+                                                                const uint32_t num_centers);
+template DISKANN_DLLEXPORT void generate_quantized_data<float16>(const std::string &data_file_to_use,
+                                                                 const std::string &pq_pivots_path,
+                                                                 const std::string &pq_compressed_vectors_path,
+                                                                 diskann::Metric compareMetric, const double p_val,
+                                                                 const size_t num_pq_chunks, const bool use_opq,
+                                                                 const std::string &codebook_prefix,
+                                                                 const uint32_t num_centers);
+template DISKANN_DLLEXPORT void generate_quantized_data<bfloat16>(const std::string &data_file_to_use,
+                                                                  const std::string &pq_pivots_path,
+                                                                  const std::string &pq_compressed_vectors_path,
+                                                                  diskann::Metric compareMetric, const double p_val,
+                                                                  const size_t num_pq_chunks, const bool use_opq,
+                                                                  const std::string &codebook_prefix,
+                                                                  const uint32_t num_centers);
 
 template DISKANN_DLLEXPORT void generate_quantized_data<uint8_t>(const std::string &data_file_to_use,
                                                                  const std::string &pq_pivots_path,
                                                                  const std::string &pq_compressed_vectors_path,
                                                                  diskann::Metric compareMetric, const double p_val,
                                                                  const size_t num_pq_chunks, const bool use_opq,
-                                                                 const std::string &codebook_prefix);
+                                                                 const std::string &codebook_prefix,
+                                                                 const uint32_t num_centers);
 
 template DISKANN_DLLEXPORT void generate_quantized_data<float>(const std::string &data_file_to_use,
                                                                const std::string &pq_pivots_path,
                                                                const std::string &pq_compressed_vectors_path,
                                                                diskann::Metric compareMetric, const double p_val,
                                                                const size_t num_pq_chunks, const bool use_opq,
-                                                               const std::string &codebook_prefix);
+                                                               const std::string &codebook_prefix,
+                                                               const uint32_t num_centers);
 } // namespace diskann
@@ -214,6 +214,11 @@ template <typename data_t> size_t PQDataStore<data_t>::get_alignment_factor() co
     return 1;
 }
 
+template <typename data_t> size_t PQDataStore<data_t>::memory_size() const
+{
+    return _quantized_data == nullptr ? 0 : this->capacity() * _num_chunks;
+}
+
 template <typename data_t> Distance<data_t> *PQDataStore<data_t>::get_dist_fn() const
 {
     return _distance_fn.get();
@@ -254,6 +259,8 @@ template <typename data_t> location_t PQDataStore<data_t>::load_impl(AlignedFile
 #endif
 
 template DISKANN_DLLEXPORT class PQDataStore<int8_t>;
+template DISKANN_DLLEXPORT class PQDataStore<float16>;
+template DISKANN_DLLEXPORT class PQDataStore<bfloat16>;
 template DISKANN_DLLEXPORT class PQDataStore<float>;
 template DISKANN_DLLEXPORT class PQDataStore<uint8_t>;
 
@@ -1,13 +1,20 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <numeric>
+
 #include "common_includes.h"
+#include "blas_compat.h"
 
 #include "timer.h"
 #include "pq.h"
 #include "pq_scratch.h"
 #include "pq_flash_index.h"
+#include "search_trace.h"
 #include "cosine_similarity.h"
+#include "compressed_file.h"
+#include "memory_mapper.h"
+#include "disk_layout_writer.h"
 
 #ifdef _WINDOWS
 #include "windows_aligned_file_reader.h"
@@ -27,10 +34,12 @@
 
 namespace diskann
 {
+// neighbour count of a node of the cache list that failed to read
+const uint32_t NODE_NOT_CACHED = std::numeric_limits<uint32_t>::max();
 
 template <typename T, typename LabelT>
 PQFlashIndex<T, LabelT>::PQFlashIndex(std::shared_ptr<AlignedFileReader> &fileReader, diskann::Metric m)
-    : reader(fileReader), metric(m), _thread_data(nullptr)
+    : reader(fileReader), metric(m)
 {
     diskann::Metric metric_to_invoke = m;
     if (m == diskann::Metric::COSINE || m == diskann::Metric::INNER_PRODUCT)
@@ -52,46 +61,55 @@ PQFlashIndex<T, LabelT>::PQFlashIndex(std::shared_ptr<AlignedFileReader> &fileRe
     }
 
     this->_dist_cmp.reset(diskann::get_distance_function<T>(metric_to_invoke));
+    // float vectors have no Hamming distance; the float comparator only
+    // ranks the centroids of multiple entry points, where L2 is close enough
+    if (metric_to_invoke == diskann::Metric::HAMMING)
+        metric_to_invoke = diskann::Metric::L2;
     this->_dist_cmp_float.reset(diskann::get_distance_function<float>(metric_to_invoke));
 }
 
 template <typename T, typename LabelT> PQFlashIndex<T, LabelT>::~PQFlashIndex()
 {
-#ifndef EXEC_ENV_OLS
-    if (data != nullptr)
-    {
-        delete[] data;
-    }
-#endif
+    _stop_populating = true;
+    if (_pq_populate_thread.joinable())
+        _pq_populate_thread.join();
+    if (_cache_loading.valid())
+        _cache_loading.wait();
+    free_large(_pq_data_buffer);
 
     if (_centroid_data != nullptr)
         aligned_free(_centroid_data);
     // delete backing bufs for nhood and coord cache
-    if (_nhood_cache_buf != nullptr)
-    {
-        delete[] _nhood_cache_buf;
-        diskann::aligned_free(_coord_cache_buf);
-    }
+    free_large(_nhood_cache_buffer);
+    free_large(_coord_cache_buffer);
+    free_large(_far_nhood_cache_buffer);
+    free_large(_far_coord_cache_buffer);
+    free_large(_reorder_buffer);
 
     if (_load_flag)
     {
         diskann::cout << "Clearing scratch" << std::endl;
-        ScratchStoreManager<SSDThreadData<T>> manager(this->_thread_data);
-        manager.destroy();
+        this->_thread_data.destroy();
         this->reader->deregister_all_threads();
         reader->close();
+        if (_vectors_reader != nullptr)
+        {
+            _vectors_reader->deregister_all_threads();
+            _vectors_reader->close();
+        }
     }
-    if (_pts_to_label_offsets != nullptr)
+    // shared labels are unmapped with their segment
+    if (_pts_to_label_offsets != nullptr && _labels_segment == nullptr)
     {
         delete[] _pts_to_label_offsets;
     }
-    if (_pts_to_label_counts != nullptr)
+    if (_pts_to_label_counts != nullptr && _labels_segment == nullptr)
     {
         delete[] _pts_to_label_counts;
     }
-    if (_pts_to_labels != nullptr)
+    if (_pts_to_labels != nullptr && _labels_segment == nullptr)
     {
-        delete[] _pts_to_labels;
+        free_labels();
     }
     if (_medoids != nullptr)
     {
@@ -101,8 +119,11 @@ template <typename T, typename LabelT> PQFlashIndex<T, LabelT>::~PQFlashIndex()
 
 template <typename T, typename LabelT> inline uint64_t PQFlashIndex<T, LabelT>::get_node_sector(uint64_t node_id)
 {
-    return 1 + (_nnodes_per_sector > 0 ? node_id / _nnodes_per_sector
-                                       : node_id * DIV_ROUND_UP(_max_node_len, defaults::SECTOR_LEN));
+    // the metadata takes the first defaults::SECTOR_LEN bytes whatever the
+    // length of the node sectors
+    const uint64_t header_sectors = defaults::SECTOR_LEN / _sector_len;
+    return header_sectors + (_nnodes_per_sector > 0 ? node_id / _nnodes_per_sector
+                                                    : node_id * DIV_ROUND_UP(_max_node_len, _sector_len));
 }
 
 template <typename T, typename LabelT>
@@ -116,6 +137,20 @@ template <typename T, typename LabelT> inline uint32_t *PQFlashIndex<T, LabelT>:
     return (unsigned *)(node_buf + _disk_bytes_per_point);
 }
 
+template <typename T, typename LabelT>
+inline uint32_t *PQFlashIndex<T, LabelT>::node_nbr_ids(uint32_t *node_nhood, uint32_t *ids_scratch)
+{
+    if (_nbr_id_bits == 0)
+        return node_nhood + 1;
+    diskann::unpack_ids(node_nhood + 1, *node_nhood, (uint32_t)_nbr_id_bits, ids_scratch);
+    return ids_scratch;
+}
+
+template <typename T, typename LabelT> inline uint8_t *PQFlashIndex<T, LabelT>::node_nbr_codes(uint32_t *node_nhood)
+{
+    return (uint8_t *)(node_nhood + 1) + _nbr_ids_len;
+}
+
 template <typename T, typename LabelT> inline T *PQFlashIndex<T, LabelT>::offset_to_node_coords(char *node_buf)
 {
     return (T *)(node_buf);
@@ -124,19 +159,55 @@ template <typename T, typename LabelT> inline T *PQFlashIndex<T, LabelT>::offset
 template <typename T, typename LabelT>
 void PQFlashIndex<T, LabelT>::setup_thread_data(uint64_t nthreads, uint64_t visited_reserve)
 {
-    diskann::cout << "Setting up thread-specific contexts for nthreads: " << nthreads << std::endl;
-// omp parallel for to generate unique thread IDs
+    diskann::cout << "Setting up scratch and IO contexts for " << nthreads << " concurrent searches" << std::endl;
+#ifdef EXEC_ENV_OLS
+// the readers here only have per-thread contexts, so each scratch takes the
+// context of a distinct omp thread
 #pragma omp parallel for num_threads((int)nthreads)
     for (int64_t thread = 0; thread < (int64_t)nthreads; thread++)
     {
 #pragma omp critical
         {
             SSDThreadData<T> *data = new SSDThreadData<T>(this->_aligned_dim, visited_reserve);
+            data->scratch.pq_scratch()->reserve_pq_table(this->_n_chunks * _pq_table.get_table_stride() +
+                                                         disk_pq_table_entries());
             this->reader->register_thread();
             data->ctx = this->reader->get_ctx();
+            this->reader->register_buffer(data->ctx, data->scratch.sector_scratch,
+                                          defaults::MAX_N_SECTOR_READS * defaults::SECTOR_LEN);
             this->_thread_data.push(data);
         }
     }
+#else
+    if (_search_host != nullptr)
+    {
+        if (reader->has_file_independent_ctx() &&
+            (_vectors_reader == nullptr || _vectors_reader->has_file_independent_ctx()))
+        {
+            _search_host->reserve(_aligned_dim, _n_chunks * _pq_table.get_table_stride() + disk_pq_table_entries(),
+                                  _vectors_reader != nullptr);
+            _use_search_host = true;
+            _load_flag = true;
+            return;
+        }
+        diskann::cout << "The reader of the index needs contexts of its own; not using the search host" << std::endl;
+    }
+
+    // each scratch owns its IO context, so a search can run on any thread
+    // that takes one from the pool
+    for (uint64_t thread = 0; thread < nthreads; thread++)
+    {
+        SSDThreadData<T> *data = new SSDThreadData<T>(this->_aligned_dim, visited_reserve);
+        data->scratch.pq_scratch()->reserve_pq_table(this->_n_chunks * _pq_table.get_table_stride() +
+                                                     disk_pq_table_entries());
+        data->ctx = this->reader->create_ctx();
+        this->reader->register_buffer(data->ctx, data->scratch.sector_scratch,
+                                      defaults::MAX_N_SECTOR_READS * defaults::SECTOR_LEN);
+        if (_vectors_reader != nullptr)
+            data->vectors_ctx = _vectors_reader->create_ctx();
+        this->_thread_data.push(data);
+    }
+#endif
     _load_flag = true;
 }
 
@@ -149,40 +220,49 @@ std::vector<bool> PQFlashIndex<T, LabelT>::read_nodes(const std::vector<uint32_t
     std::vector<bool> retval(node_ids.size(), true);
 
     char *buf = nullptr;
-    auto num_sectors = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, defaults::SECTOR_LEN);
-    alloc_aligned((void **)&buf, node_ids.size() * num_sectors * defaults::SECTOR_LEN, defaults::SECTOR_LEN);
+    auto num_sectors = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    alloc_aligned((void **)&buf, node_ids.size() * num_sectors * _sector_len, defaults::SECTOR_LEN);
 
-    // create read requests
+    // one read request per distinct sector, in sector order; nodes that share
+    // a sector share its read
+    std::vector<std::pair<uint64_t, size_t>> sectors(node_ids.size());
     for (size_t i = 0; i < node_ids.size(); ++i)
+        sectors[i] = std::make_pair(get_node_sector(node_ids[i]), i);
+    std::sort(sectors.begin(), sectors.end());
+    std::vector<size_t> read_of_node(node_ids.size());
+    for (size_t s = 0; s < sectors.size(); ++s)
     {
-        auto node_id = node_ids[i];
-
-        AlignedRead read;
-        read.len = num_sectors * defaults::SECTOR_LEN;
-        read.buf = buf + i * num_sectors * defaults::SECTOR_LEN;
-        read.offset = get_node_sector(node_id) * defaults::SECTOR_LEN;
-        read_reqs.push_back(read);
+        if (s == 0 || sectors[s].first != sectors[s - 1].first)
+        {
+            AlignedRead read;
+            read.len = num_sectors * _sector_len;
+            read.buf = buf + read_reqs.size() * num_sectors * _sector_len;
+            read.offset = sectors[s].first * _sector_len;
+            read_reqs.push_back(read);
+        }
+        read_of_node[sectors[s].second] = read_reqs.size() - 1;
     }
 
     // borrow thread data and issue reads
-    ScratchStoreManager<SSDThreadData<T>> manager(this->_thread_data);
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
     auto this_thread_data = manager.scratch_space();
     IOContext &ctx = this_thread_data->ctx;
     reader->read(read_reqs, ctx);
 
     // copy reads into buffers
-    for (uint32_t i = 0; i < read_reqs.size(); i++)
+    for (uint32_t i = 0; i < node_ids.size(); i++)
     {
+        const size_t r = read_of_node[i];
 #if defined(_WINDOWS) && defined(USE_BING_INFRA) // this block is to handle failed reads in
                                                  // production settings
-        if ((*ctx.m_pRequestsStatus)[i] != IOContext::READ_SUCCESS)
+        if ((*ctx.m_pRequestsStatus)[r] != IOContext::READ_SUCCESS)
         {
             retval[i] = false;
             continue;
         }
 #endif
 
-        char *node_buf = offset_to_node((char *)read_reqs[i].buf, node_ids[i]);
+        char *node_buf = offset_to_node((char *)read_reqs[r].buf, node_ids[i]);
 
         if (coord_buffers[i] != nullptr)
         {
@@ -195,7 +275,9 @@ std::vector<bool> PQFlashIndex<T, LabelT>::read_nodes(const std::vector<uint32_t
             uint32_t *node_nhood = offset_to_node_nhood(node_buf);
             auto num_nbrs = *node_nhood;
             nbr_buffers[i].first = num_nbrs;
-            memcpy(nbr_buffers[i].second, node_nhood + 1, num_nbrs * sizeof(uint32_t));
+            uint32_t *nbrs = node_nbr_ids(node_nhood, nbr_buffers[i].second);
+            if (nbrs != nbr_buffers[i].second)
+                memcpy(nbr_buffers[i].second, nbrs, num_nbrs * sizeof(uint32_t));
         }
     }
 
@@ -204,54 +286,620 @@ std::vector<bool> PQFlashIndex<T, LabelT>::read_nodes(const std::vector<uint32_t
     return retval;
 }
 
+template <typename T, typename LabelT>
+std::vector<bool> PQFlashIndex<T, LabelT>::read_nodes_parallel(
+    const std::vector<uint32_t> &node_ids, std::vector<T *> &coord_buffers,
+    std::vector<std::pair<uint32_t, uint32_t *>> &nbr_buffers)
+{
+    // blocks of nodes in sector order, so that each thread reads a run of
+    // nearby sectors, while the threads together keep the device busy
+    std::vector<size_t> order(node_ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return get_node_sector(node_ids[a]) < get_node_sector(node_ids[b]);
+    });
+
+    const size_t num_blocks = DIV_ROUND_UP(node_ids.size(), defaults::CACHE_READ_BLOCK_SIZE);
+    // while the cache loads in the background, leave half the IO contexts
+    // to the searches
+    uint64_t num_threads = (std::max)(_max_nthreads, (uint64_t)1);
+    if (!_static_cache_ready.load(std::memory_order_acquire))
+        num_threads = (std::max)(num_threads / 2, (uint64_t)1);
+    num_threads = (std::min)(num_threads, (uint64_t)(std::max)(num_blocks, (size_t)1));
+
+    std::vector<uint8_t> status(node_ids.size(), 0);
+    std::exception_ptr read_error;
+#pragma omp parallel for schedule(dynamic, 1) num_threads((int)num_threads)
+    for (int64_t block = 0; block < (int64_t)num_blocks; block++)
+    {
+        const size_t start = block * defaults::CACHE_READ_BLOCK_SIZE;
+        const size_t end = (std::min)(node_ids.size(), start + defaults::CACHE_READ_BLOCK_SIZE);
+        std::vector<uint32_t> block_ids;
+        std::vector<T *> block_coords;
+        std::vector<std::pair<uint32_t, uint32_t *>> block_nbrs;
+        for (size_t i = start; i < end; i++)
+        {
+            block_ids.push_back(node_ids[order[i]]);
+            block_coords.push_back(coord_buffers[order[i]]);
+            block_nbrs.push_back(nbr_buffers[order[i]]);
+        }
+        try
+        {
+            const std::vector<bool> block_status = read_nodes(block_ids, block_coords, block_nbrs);
+            for (size_t i = start; i < end; i++)
+            {
+                nbr_buffers[order[i]].first = block_nbrs[i - start].first;
+                status[order[i]] = block_status[i - start] ? 1 : 0;
+            }
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!read_error)
+                read_error = std::current_exception();
+        }
+    }
+    if (read_error)
+        std::rethrow_exception(read_error);
+    return std::vector<bool>(status.begin(), status.end());
+}
+
 template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::load_cache_list(std::vector<uint32_t> &node_list)
 {
+    // keep the visit counts of generate_cache_list_from_sample_queries(), if
+    // it picked the nodes, for save_cache()
+    tsl::robin_map<uint32_t, uint32_t> visits;
+    if (!_node_visit_counter.empty())
+    {
+        tsl::robin_set<uint32_t> cached(node_list.begin(), node_list.end());
+        for (const auto &[node, count] : _node_visit_counter)
+        {
+            if (cached.find(node) != cached.end())
+                visits[node] = count;
+        }
+    }
+    _cache_list.clear();
+    _cache_list.reserve(node_list.size());
+    for (uint32_t node : node_list)
+    {
+        auto iter = visits.find(node);
+        _cache_list.emplace_back(node, iter == visits.end() ? 0 : iter->second);
+    }
+
+    if (_use_sector_cache)
+    {
+        load_sector_cache(node_list);
+        return;
+    }
+
     diskann::cout << "Loading the cache list into memory.." << std::flush;
     size_t num_cached_nodes = node_list.size();
+    if (!_shared_memory_name.empty())
+    {
+        attach_shared_node_cache(num_cached_nodes, [&](uint32_t *ids, uint32_t *visit_counts, uint32_t *nbr_counts,
+                                                       uint32_t *nhood_buf, T *coord_buf) {
+            for (size_t i = 0; i < num_cached_nodes; i++)
+            {
+                ids[i] = _cache_list[i].first;
+                visit_counts[i] = _cache_list[i].second;
+            }
+            read_cache_nodes(node_list, nhood_buf, coord_buf, nbr_counts);
+        });
+        diskann::cout << "..done." << std::endl;
+        return;
+    }
+
+    alloc_node_cache(num_cached_nodes);
+    std::vector<uint32_t> nbr_counts(num_cached_nodes);
+    if (_num_dram_cache_nodes < num_cached_nodes)
+    {
+        std::vector<uint32_t> dram_nodes(node_list.begin(), node_list.begin() + _num_dram_cache_nodes);
+        std::vector<uint32_t> far_nodes(node_list.begin() + _num_dram_cache_nodes, node_list.end());
+        read_cache_nodes(dram_nodes, _nhood_cache_buf, _coord_cache_buf, nbr_counts.data());
+        read_cache_nodes(far_nodes, _far_nhood_cache_buf, _far_coord_cache_buf,
+                         nbr_counts.data() + _num_dram_cache_nodes);
+    }
+    else
+    {
+        read_cache_nodes(node_list, _nhood_cache_buf, _coord_cache_buf, nbr_counts.data());
+    }
+    index_cache_nodes(node_list.data(), nbr_counts.data(), num_cached_nodes);
+    diskann::cout << "..done." << std::endl;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::read_cache_nodes(const std::vector<uint32_t> &node_list, uint32_t *nhood_buf,
+                                               T *coord_buf, uint32_t *nbr_counts)
+{
+    size_t num_cached_nodes = node_list.size();
+    std::vector<T *> coord_buffers(num_cached_nodes);
+    std::vector<std::pair<uint32_t, uint32_t *>> nbr_buffers(num_cached_nodes);
+    for (size_t node_idx = 0; node_idx < num_cached_nodes; node_idx++)
+    {
+        coord_buffers[node_idx] = coord_buf + node_idx * _aligned_dim;
+        nbr_buffers[node_idx] = std::make_pair(0, nhood_buf + node_idx * (_max_degree + 1));
+    }
+
+    auto read_status = read_nodes_parallel(node_list, coord_buffers, nbr_buffers);
+
+    // nodes that failed to read are left out of the cache
+    for (size_t i = 0; i < num_cached_nodes; i++)
+        nbr_counts[i] = read_status[i] ? nbr_buffers[i].first : NODE_NOT_CACHED;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::index_cache_nodes(const uint32_t *ids, const uint32_t *nbr_counts, size_t num_nodes)
+{
+    _nhood_cache.reserve(num_nodes);
+    _coord_cache.reserve(num_nodes);
+    for (size_t i = 0; i < num_nodes; i++)
+    {
+        if (nbr_counts[i] == NODE_NOT_CACHED)
+            continue;
+        _coord_cache.insert(std::make_pair(ids[i], coord_cache_row(i)));
+        _nhood_cache.insert(std::make_pair(ids[i], std::make_pair(nbr_counts[i], nhood_cache_row(i))));
+    }
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::alloc_node_cache(size_t num_nodes)
+{
+    free_large(_nhood_cache_buffer);
+    free_large(_coord_cache_buffer);
+    free_large(_far_nhood_cache_buffer);
+    free_large(_far_coord_cache_buffer);
+    _far_nhood_cache_buf = nullptr;
+    _far_coord_cache_buf = nullptr;
+
+    _num_dram_cache_nodes = num_nodes;
+    if (_node_cache_placement.tier != MemoryTier::DRAM)
+        _num_dram_cache_nodes = (std::min)(num_nodes, (size_t)(num_nodes * (double)_node_cache_dram_fraction));
+    const size_t nhood_row_len = (_max_degree + 1) * sizeof(uint32_t);
+    const size_t coord_row_len = _aligned_dim * sizeof(T);
+    _nhood_cache_buffer = alloc_large(_num_dram_cache_nodes * nhood_row_len, sizeof(uint32_t));
+    _nhood_cache_buf = (uint32_t *)_nhood_cache_buffer.ptr;
+    _coord_cache_buffer = alloc_large(_num_dram_cache_nodes * coord_row_len, 8 * sizeof(T));
+    _coord_cache_buf = (T *)_coord_cache_buffer.ptr;
+    if (_num_dram_cache_nodes < num_nodes)
+    {
+        const size_t num_far_nodes = num_nodes - _num_dram_cache_nodes;
+        _far_nhood_cache_buffer =
+            alloc_placed(num_far_nodes * nhood_row_len, sizeof(uint32_t), _node_cache_placement);
+        _far_nhood_cache_buf = (uint32_t *)_far_nhood_cache_buffer.ptr;
+        _far_coord_cache_buffer = alloc_placed(num_far_nodes * coord_row_len, 8 * sizeof(T), _node_cache_placement);
+        _far_coord_cache_buf = (T *)_far_coord_cache_buffer.ptr;
+    }
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::attach_shared_node_cache(
+    size_t num_nodes, const std::function<void(uint32_t *, uint32_t *, uint32_t *, uint32_t *, T *)> &fill)
+{
+    // node ids, visit counts and neighbour counts, then the neighbour and
+    // coordinate rows, each aligned for the distance kernels
+    const size_t nhood_offset = ROUND_UP(3 * num_nodes * sizeof(uint32_t), 64);
+    const size_t coord_offset = ROUND_UP(nhood_offset + num_nodes * (_max_degree + 1) * sizeof(uint32_t), 64);
+    const size_t len = coord_offset + num_nodes * _aligned_dim * sizeof(T);
+
+    _nhood_cache.clear();
+    _coord_cache.clear();
+    _cache_segment.reset();
+    _cache_segment = std::make_unique<SharedSegment>(_shared_memory_name + "_cache", len, [&](char *buf) {
+        fill((uint32_t *)buf, (uint32_t *)buf + num_nodes, (uint32_t *)buf + 2 * num_nodes,
+             (uint32_t *)(buf + nhood_offset), (T *)(buf + coord_offset));
+    });
+
+    // another process may have cached other nodes than this one picked
+    const uint32_t *ids = (const uint32_t *)_cache_segment->data();
+    const uint32_t *visit_counts = ids + num_nodes;
+    _nhood_cache_buf = (uint32_t *)(_cache_segment->data() + nhood_offset);
+    _coord_cache_buf = (T *)(_cache_segment->data() + coord_offset);
+    _num_dram_cache_nodes = num_nodes;
+    index_cache_nodes(ids, ids + 2 * num_nodes, num_nodes);
+    _cache_list.clear();
+    _cache_list.reserve(num_nodes);
+    for (size_t i = 0; i < num_nodes; i++)
+        _cache_list.emplace_back(ids[i], visit_counts[i]);
+}
 
-    // Allocate space for neighborhood cache
-    _nhood_cache_buf = new uint32_t[num_cached_nodes * (_max_degree + 1)];
-    memset(_nhood_cache_buf, 0, num_cached_nodes * (_max_degree + 1));
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_sector_cache_mode(bool enable)
+{
+    _use_sector_cache = enable;
+}
 
-    // Allocate space for coordinate cache
-    size_t coord_cache_buf_len = num_cached_nodes * _aligned_dim;
-    diskann::alloc_aligned((void **)&_coord_cache_buf, coord_cache_buf_len * sizeof(T), 8 * sizeof(T));
-    memset(_coord_cache_buf, 0, coord_cache_buf_len * sizeof(T));
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_lazy_load(bool enable)
+{
+    _lazy_load = enable;
+}
 
-    size_t BLOCK_SIZE = 8;
-    size_t num_blocks = DIV_ROUND_UP(num_cached_nodes, BLOCK_SIZE);
-    for (size_t block = 0; block < num_blocks; block++)
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_placement(IndexComponent component, const MemoryPlacement &placement,
+                                            float dram_fraction)
+{
+    if (_load_flag)
+    {
+        throw ANNException("Set the placement of index components before loading the index", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    }
+    if (dram_fraction < 0 || dram_fraction > 1 || (dram_fraction != 0 && component != IndexComponent::NODE_CACHE))
+    {
+        throw ANNException("The DRAM fraction must be in [0, 1], and only the node cache can be split", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    }
+    switch (component)
     {
-        size_t start_idx = block * BLOCK_SIZE;
-        size_t end_idx = (std::min)(num_cached_nodes, (block + 1) * BLOCK_SIZE);
+    case IndexComponent::PQ_CODES:
+        _pq_codes_placement = placement;
+        break;
+    case IndexComponent::NODE_CACHE:
+        _node_cache_placement = placement;
+        _node_cache_dram_fraction = dram_fraction;
+        break;
+    case IndexComponent::REORDER_VECTORS:
+        _reorder_placement = placement;
+        _reorder_resident = true;
+        break;
+    case IndexComponent::LABELS:
+        _labels_placement = placement;
+        break;
+    }
+}
 
-        // Copy offset into buffers to read into
-        std::vector<uint32_t> nodes_to_read;
-        std::vector<T *> coord_buffers;
-        std::vector<std::pair<uint32_t, uint32_t *>> nbr_buffers;
-        for (size_t node_idx = start_idx; node_idx < end_idx; node_idx++)
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::load_cache_list_async(std::function<void(std::vector<uint32_t> &)> make_node_list)
+{
+    if (_cache_loading.valid())
+    {
+        throw ANNException("load_cache_list_async() may only be called once", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+    _static_cache_ready = false;
+    _cache_loading = std::async(std::launch::async, [this, make_node_list]() {
+        try
         {
-            nodes_to_read.push_back(node_list[node_idx]);
-            coord_buffers.push_back(_coord_cache_buf + node_idx * _aligned_dim);
-            nbr_buffers.emplace_back(0, _nhood_cache_buf + node_idx * (_max_degree + 1));
+            std::vector<uint32_t> node_list;
+            make_node_list(node_list);
+            load_cache_list(node_list);
         }
+        catch (...)
+        {
+            // searches may use whatever was cached before the failure
+            _static_cache_ready.store(true, std::memory_order_release);
+            throw;
+        }
+        _static_cache_ready.store(true, std::memory_order_release);
+    });
+}
+
+template <typename T, typename LabelT> bool PQFlashIndex<T, LabelT>::is_fully_loaded()
+{
+    return _pq_codes_resident.load(std::memory_order_acquire) &&
+           _static_cache_ready.load(std::memory_order_acquire);
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::wait_until_loaded()
+{
+    if (_pq_populate_thread.joinable())
+        _pq_populate_thread.join();
+    if (_cache_loading.valid())
+        _cache_loading.get();
+}
 
-        // issue the reads
-        auto read_status = read_nodes(nodes_to_read, coord_buffers, nbr_buffers);
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::reset_after_fork()
+{
+    if (_pq_populate_thread.joinable() || _cache_loading.valid())
+    {
+        throw ANNException("The index was still loading at fork(); call wait_until_loaded() before it", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (!_load_flag)
+        return;
+    reader->reset_after_fork();
+    if (_vectors_reader != nullptr)
+        _vectors_reader->reset_after_fork();
+    if (_use_search_host)
+        return;
 
-        // check for success and insert into the cache.
-        for (size_t i = 0; i < read_status.size(); i++)
+    // take every scratch, which all are free unless a search was running
+    std::vector<uint32_t> taken;
+    taken.reserve(_thread_data.size());
+    for (uint64_t i = 0; i < _thread_data.size(); i++)
+    {
+        uint32_t index;
+        SSDThreadData<T> *data = _thread_data.try_acquire(index);
+        if (data == nullptr)
         {
-            if (read_status[i] == true)
-            {
-                _coord_cache.insert(std::make_pair(nodes_to_read[i], coord_buffers[i]));
-                _nhood_cache.insert(std::make_pair(nodes_to_read[i], nbr_buffers[i]));
-            }
+            throw ANNException("A search was running at fork(); the child cannot search the index", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        }
+        data->ctx = reader->create_ctx();
+        reader->register_buffer(data->ctx, data->scratch.sector_scratch,
+                                defaults::MAX_N_SECTOR_READS * defaults::SECTOR_LEN);
+        if (_vectors_reader != nullptr)
+            data->vectors_ctx = _vectors_reader->create_ctx();
+        taken.push_back(index);
+    }
+    for (uint32_t index : taken)
+        _thread_data.release(index);
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::populate_pq_codes()
+{
+    const char *buf = _pq_mapping->getBuf();
+    const size_t len = _pq_mapping->getFileSize();
+    const size_t page_size = 4096;
+    uint8_t sum = 0;
+    for (size_t offset = 0; offset < len && !_stop_populating.load(std::memory_order_relaxed); offset += page_size)
+        sum += (uint8_t)buf[offset];
+    // keeps the reads from being optimized out
+    volatile uint8_t sink = sum;
+    (void)sink;
+    _pq_codes_resident.store(true, std::memory_order_release);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::load_sector_cache(std::vector<uint32_t> &node_list)
+{
+    diskann::cout << "Loading the cache list into the sector cache.." << std::flush;
+    const uint64_t num_sectors_per_node =
+        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    const uint64_t record_len = num_sectors_per_node * _sector_len;
+
+    // nodes that share a sector share a record
+    tsl::robin_map<uint64_t, uint32_t> sector_to_slot;
+    std::vector<uint64_t> slot_sectors;
+    std::vector<uint32_t> node_slots(node_list.size());
+    for (size_t i = 0; i < node_list.size(); i++)
+    {
+        uint64_t sector = get_node_sector((size_t)node_list[i]);
+        auto iter = sector_to_slot.find(sector);
+        if (iter == sector_to_slot.end())
+        {
+            iter = sector_to_slot.insert(std::make_pair(sector, (uint32_t)slot_sectors.size())).first;
+            slot_sectors.push_back(sector);
+        }
+        node_slots[i] = iter->second;
+    }
+
+    _sector_cache.reset(slot_sectors.size(), record_len, node_list.size());
+
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    auto this_thread_data = manager.scratch_space();
+    IOContext &ctx = this_thread_data->ctx;
+
+    std::vector<AlignedRead> read_reqs;
+    for (size_t start = 0; start < slot_sectors.size(); start += defaults::MAX_N_SECTOR_READS)
+    {
+        size_t end = (std::min)(slot_sectors.size(), (size_t)(start + defaults::MAX_N_SECTOR_READS));
+        read_reqs.clear();
+        for (size_t slot = start; slot < end; slot++)
+        {
+            read_reqs.emplace_back(slot_sectors[slot] * _sector_len, record_len,
+                                   _sector_cache.record(slot));
+        }
+        reader->read(read_reqs, ctx);
+    }
+
+    for (size_t i = 0; i < node_list.size(); i++)
+    {
+        _sector_cache.insert(node_list[i], node_slots[i]);
+    }
+    diskann::cout << "..done. " << slot_sectors.size() << " sectors hold " << _sector_cache.size() << " nodes."
+                  << std::endl;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::load_reorder_vectors()
+{
+    const uint64_t num_sectors = DIV_ROUND_UP(_num_points, _nvecs_per_sector);
+    diskann::cout << "Reading " << num_sectors << " sectors of reorder data into memory.." << std::flush;
+    free_large(_reorder_buffer);
+    _reorder_first_sector = VECTOR_SECTOR_NO(0);
+    _reorder_buffer = alloc_placed(num_sectors * _sector_len, _sector_len, _reorder_placement);
+
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    auto this_thread_data = manager.scratch_space();
+    AlignedFileReader *vectors_reader = _vectors_reader != nullptr ? _vectors_reader.get() : reader.get();
+    IOContext &ctx = _vectors_reader != nullptr ? this_thread_data->vectors_ctx : this_thread_data->ctx;
+
+    // MAX_N_SECTOR_READS reads of MAX_N_SECTOR_READS sectors each at a time
+    const uint64_t sectors_per_read = defaults::MAX_N_SECTOR_READS;
+    std::vector<AlignedRead> read_reqs;
+    for (uint64_t start = 0; start < num_sectors;)
+    {
+        read_reqs.clear();
+        for (; start < num_sectors && read_reqs.size() < defaults::MAX_N_SECTOR_READS; start += sectors_per_read)
+        {
+            const uint64_t count = (std::min)(sectors_per_read, num_sectors - start);
+            read_reqs.emplace_back((_reorder_first_sector + start) * _sector_len, count * _sector_len,
+                                   (char *)_reorder_buffer.ptr + start * _sector_len);
         }
+        vectors_reader->read(read_reqs, ctx);
     }
     diskann::cout << "..done." << std::endl;
 }
 
+// The file of save_cache() starts with these uint64_t fields, which tie it
+// to the index and to the cache mode it was saved in. The node ids and their
+// access counts follow as uint32_t. A sector cache then has the slot of each
+// node as uint32_t and its records. Otherwise the neighbour counts of the
+// nodes follow as uint32_t, then their rows of the neighbour cache and of the
+// coordinate cache.
+enum CacheFileHeader
+{
+    CACHE_SECTOR_MODE,
+    CACHE_NUM_NODES,
+    CACHE_NUM_RECORDS,
+    CACHE_RECORD_LEN,
+    CACHE_NUM_POINTS,
+    CACHE_MAX_DEGREE,
+    CACHE_ALIGNED_DIM,
+    CACHE_DATA_SIZE,
+    CACHE_MAX_NODE_LEN,
+    CACHE_FIRST_MEDOID,
+    CACHE_NUM_FIELDS
+};
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::save_cache(const std::string &filename)
+{
+    if (!_static_cache_ready.load(std::memory_order_acquire))
+    {
+        throw ANNException("Wait for load_cache_list_async() to finish before saving the cache", -1, __FUNCSIG__,
+                           __FILE__, __LINE__);
+    }
+
+    // nodes whose read failed were left out of the node caches
+    std::vector<std::pair<uint32_t, uint32_t>> cached;
+    cached.reserve(_cache_list.size());
+    for (const auto &entry : _cache_list)
+    {
+        if (_use_sector_cache ? _sector_cache.find(entry.first) != nullptr
+                              : _nhood_cache.find(entry.first) != _nhood_cache.end())
+            cached.push_back(entry);
+    }
+    const size_t num_nodes = cached.size();
+
+    uint64_t header[CACHE_NUM_FIELDS];
+    header[CACHE_SECTOR_MODE] = _use_sector_cache ? 1 : 0;
+    header[CACHE_NUM_NODES] = num_nodes;
+    header[CACHE_NUM_RECORDS] = _use_sector_cache ? _sector_cache.num_records() : num_nodes;
+    header[CACHE_RECORD_LEN] = _use_sector_cache ? _sector_cache.record_len() : 0;
+    header[CACHE_NUM_POINTS] = _num_points;
+    header[CACHE_MAX_DEGREE] = _max_degree;
+    header[CACHE_ALIGNED_DIM] = _aligned_dim;
+    header[CACHE_DATA_SIZE] = sizeof(T);
+    header[CACHE_MAX_NODE_LEN] = _max_node_len;
+    header[CACHE_FIRST_MEDOID] = _num_medoids > 0 ? _medoids[0] : 0;
+
+    std::ofstream writer;
+    open_file_to_write(writer, filename);
+    writer.write((char *)header, sizeof(header));
+    std::vector<uint32_t> column(num_nodes);
+    for (size_t i = 0; i < num_nodes; i++)
+        column[i] = cached[i].first;
+    writer.write((char *)column.data(), num_nodes * sizeof(uint32_t));
+    for (size_t i = 0; i < num_nodes; i++)
+        column[i] = cached[i].second;
+    writer.write((char *)column.data(), num_nodes * sizeof(uint32_t));
+
+    if (_use_sector_cache)
+    {
+        for (size_t i = 0; i < num_nodes; i++)
+            column[i] = _sector_cache.slot_of(_sector_cache.find(cached[i].first));
+        writer.write((char *)column.data(), num_nodes * sizeof(uint32_t));
+        writer.write(_sector_cache.record(0), _sector_cache.num_records() * _sector_cache.record_len());
+    }
+    else
+    {
+        for (size_t i = 0; i < num_nodes; i++)
+            column[i] = _nhood_cache.find(cached[i].first)->second.first;
+        writer.write((char *)column.data(), num_nodes * sizeof(uint32_t));
+        for (size_t i = 0; i < num_nodes; i++)
+            writer.write((char *)_nhood_cache.find(cached[i].first)->second.second,
+                         (_max_degree + 1) * sizeof(uint32_t));
+        for (size_t i = 0; i < num_nodes; i++)
+            writer.write((char *)_coord_cache.find(cached[i].first)->second, _aligned_dim * sizeof(T));
+    }
+    writer.close();
+    diskann::cout << "Saved the cache of " << num_nodes << " nodes to " << filename << std::endl;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::load_cache(const std::string &filename)
+{
+    if (!file_exists(filename))
+    {
+        throw ANNException("Cache file " + filename + " does not exist", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    std::ifstream reader;
+    reader.exceptions(std::ios::badbit | std::ios::failbit);
+    reader.open(filename, std::ios::binary);
+    uint64_t header[CACHE_NUM_FIELDS];
+    reader.read((char *)header, sizeof(header));
+    if (header[CACHE_NUM_POINTS] != _num_points || header[CACHE_MAX_DEGREE] != _max_degree ||
+        header[CACHE_ALIGNED_DIM] != _aligned_dim || header[CACHE_DATA_SIZE] != sizeof(T) ||
+        header[CACHE_MAX_NODE_LEN] != _max_node_len ||
+        header[CACHE_FIRST_MEDOID] != (_num_medoids > 0 ? _medoids[0] : 0))
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << filename << " holds the cache of an index of " << header[CACHE_NUM_POINTS]
+               << " points with " << header[CACHE_ALIGNED_DIM] << " dimensions and degree "
+               << header[CACHE_MAX_DEGREE] << ", which does not match this index of " << _num_points
+               << " points with " << _aligned_dim << " dimensions and degree " << _max_degree << "." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    const size_t num_nodes = header[CACHE_NUM_NODES];
+    std::vector<uint32_t> node_list(num_nodes), counts(num_nodes);
+    reader.read((char *)node_list.data(), num_nodes * sizeof(uint32_t));
+    reader.read((char *)counts.data(), num_nodes * sizeof(uint32_t));
+
+    if ((header[CACHE_SECTOR_MODE] != 0) != _use_sector_cache)
+    {
+        diskann::cout << filename << " was saved in the other cache mode, reading its nodes from the index"
+                      << std::endl;
+        load_cache_list(node_list);
+    }
+    else if (_use_sector_cache)
+    {
+        diskann::cout << "Loading the sector cache from " << filename << ".." << std::flush;
+        const uint64_t num_sectors_per_node =
+            _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+        if (header[CACHE_RECORD_LEN] != num_sectors_per_node * _sector_len)
+        {
+            throw ANNException("The records of " + filename + " do not match the sectors of this index", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        }
+        std::vector<uint32_t> node_slots(num_nodes);
+        reader.read((char *)node_slots.data(), num_nodes * sizeof(uint32_t));
+        _sector_cache.reset(header[CACHE_NUM_RECORDS], header[CACHE_RECORD_LEN], num_nodes);
+        reader.read(_sector_cache.record(0), header[CACHE_NUM_RECORDS] * header[CACHE_RECORD_LEN]);
+        for (size_t i = 0; i < num_nodes; i++)
+            _sector_cache.insert(node_list[i], node_slots[i]);
+        diskann::cout << "..done. " << header[CACHE_NUM_RECORDS] << " sectors hold " << _sector_cache.size()
+                      << " nodes." << std::endl;
+    }
+    else if (!_shared_memory_name.empty())
+    {
+        diskann::cout << "Loading the node cache from " << filename << ".." << std::flush;
+        attach_shared_node_cache(num_nodes, [&](uint32_t *ids, uint32_t *visit_counts, uint32_t *nbr_counts,
+                                                uint32_t *nhood_buf, T *coord_buf) {
+            memcpy(ids, node_list.data(), num_nodes * sizeof(uint32_t));
+            memcpy(visit_counts, counts.data(), num_nodes * sizeof(uint32_t));
+            reader.read((char *)nbr_counts, num_nodes * sizeof(uint32_t));
+            reader.read((char *)nhood_buf, num_nodes * (_max_degree + 1) * sizeof(uint32_t));
+            reader.read((char *)coord_buf, num_nodes * _aligned_dim * sizeof(T));
+        });
+        diskann::cout << "..done." << std::endl;
+        return;
+    }
+    else
+    {
+        diskann::cout << "Loading the node cache from " << filename << ".." << std::flush;
+        _nhood_cache.clear();
+        _coord_cache.clear();
+        alloc_node_cache(num_nodes);
+
+        // the rows of the nodes past _num_dram_cache_nodes go to the far
+        // buffers
+        const size_t num_far_nodes = num_nodes - _num_dram_cache_nodes;
+        std::vector<uint32_t> num_nbrs(num_nodes);
+        reader.read((char *)num_nbrs.data(), num_nodes * sizeof(uint32_t));
+        reader.read((char *)_nhood_cache_buf, _num_dram_cache_nodes * (_max_degree + 1) * sizeof(uint32_t));
+        if (num_far_nodes > 0)
+            reader.read((char *)_far_nhood_cache_buf, num_far_nodes * (_max_degree + 1) * sizeof(uint32_t));
+        reader.read((char *)_coord_cache_buf, _num_dram_cache_nodes * _aligned_dim * sizeof(T));
+        if (num_far_nodes > 0)
+            reader.read((char *)_far_coord_cache_buf, num_far_nodes * _aligned_dim * sizeof(T));
+        index_cache_nodes(node_list.data(), num_nbrs.data(), num_nodes);
+        diskann::cout << "..done." << std::endl;
+    }
+
+    _cache_list.clear();
+    _cache_list.reserve(num_nodes);
+    for (size_t i = 0; i < num_nodes; i++)
+        _cache_list.emplace_back(node_list[i], counts[i]);
+}
+
 #ifdef EXEC_ENV_OLS
 template <typename T, typename LabelT>
 void PQFlashIndex<T, LabelT>::generate_cache_list_from_sample_queries(MemoryMappedFiles &files, std::string sample_bin,
@@ -318,16 +966,20 @@ void PQFlashIndex<T, LabelT>::generate_cache_list_from_sample_queries(std::strin
         generate_random_labels(random_query_filters, (uint32_t)sample_num, nthreads);
     }
 
-#pragma omp parallel for schedule(dynamic, 1) num_threads(nthreads)
-    for (int64_t i = 0; i < (int64_t)sample_num; i++)
-    {
-        auto &label_for_search = random_query_filters[i];
-        // run a search on the sample query with a random label (sampled from base label distribution), and it will
-        // concurrently update the node_visit_counter to track most visited nodes. The last false is to not use the
-        // "use_reorder_data" option which enables a final reranking if the disk index itself contains only PQ data.
-        cached_beam_search(samples + (i * sample_aligned_dim), 1, l_search, tmp_result_ids_64.data() + i,
-                           tmp_result_dists.data() + i, beamwidth, filtered_search, label_for_search, false);
-    }
+    auto search_samples = [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; i++)
+        {
+            auto &label_for_search = random_query_filters[i];
+            // run a search on the sample query with a random label (sampled from base label distribution), and it
+            // will concurrently update the node_visit_counter to track most visited nodes. The last false is to not
+            // use the "use_reorder_data" option which enables a final reranking if the disk index itself contains
+            // only PQ data.
+            cached_beam_search(samples + (i * sample_aligned_dim), 1, l_search, tmp_result_ids_64.data() + i,
+                               tmp_result_dists.data() + i, beamwidth, filtered_search, label_for_search, false);
+        }
+    };
+    std::shared_ptr<Executor> executor = _executor != nullptr ? _executor : get_default_executor();
+    executor->parallel_for(sample_num, 1, search_samples, nthreads);
 
     std::sort(this->_node_visit_counter.begin(), _node_visit_counter.end(),
               [](std::pair<uint32_t, uint32_t> &left, std::pair<uint32_t, uint32_t> &right) {
@@ -365,11 +1017,6 @@ void PQFlashIndex<T, LabelT>::cache_bfs_levels(uint64_t num_nodes_to_cache, std:
     }
     diskann::cout << "Caching " << num_nodes_to_cache << "..." << std::endl;
 
-    // borrow thread data
-    ScratchStoreManager<SSDThreadData<T>> manager(this->_thread_data);
-    auto this_thread_data = manager.scratch_space();
-    IOContext &ctx = this_thread_data->ctx;
-
     std::unique_ptr<tsl::robin_set<uint32_t>> cur_level, prev_level;
     cur_level = std::make_unique<tsl::robin_set<uint32_t>>();
     prev_level = std::make_unique<tsl::robin_set<uint32_t>>();
@@ -423,53 +1070,48 @@ void PQFlashIndex<T, LabelT>::cache_bfs_levels(uint64_t num_nodes_to_cache, std:
         diskann::cout << "Level: " << lvl << std::flush;
         bool finish_flag = false;
 
-        uint64_t BLOCK_SIZE = 1024;
-        uint64_t nblocks = DIV_ROUND_UP(nodes_to_expand.size(), BLOCK_SIZE);
-        for (size_t block = 0; block < nblocks && !finish_flag; block++)
+        // each wave is read by all the threads at once, in sector order, and
+        // then expanded in the order of nodes_to_expand
+        const uint64_t WAVE_SIZE = defaults::CACHE_READ_BLOCK_SIZE * (std::max)(_max_nthreads, (uint64_t)1);
+        std::vector<uint32_t> nbr_storage;
+        uint64_t nwaves = DIV_ROUND_UP(nodes_to_expand.size(), WAVE_SIZE);
+        for (size_t wave = 0; wave < nwaves && !finish_flag; wave++)
         {
             diskann::cout << "." << std::flush;
-            size_t start = block * BLOCK_SIZE;
-            size_t end = (std::min)((block + 1) * BLOCK_SIZE, nodes_to_expand.size());
+            size_t start = wave * WAVE_SIZE;
+            size_t end = (std::min)((wave + 1) * WAVE_SIZE, nodes_to_expand.size());
 
-            std::vector<uint32_t> nodes_to_read;
+            std::vector<uint32_t> nodes_to_read(nodes_to_expand.begin() + start, nodes_to_expand.begin() + end);
             std::vector<T *> coord_buffers(end - start, nullptr);
             std::vector<std::pair<uint32_t, uint32_t *>> nbr_buffers;
-
-            for (size_t cur_pt = start; cur_pt < end; cur_pt++)
-            {
-                nodes_to_read.push_back(nodes_to_expand[cur_pt]);
-                nbr_buffers.emplace_back(0, new uint32_t[_max_degree + 1]);
-            }
+            nbr_storage.resize((end - start) * (_max_degree + 1));
+            for (size_t i = 0; i < end - start; i++)
+                nbr_buffers.emplace_back(0, nbr_storage.data() + i * (_max_degree + 1));
 
             // issue read requests
-            auto read_status = read_nodes(nodes_to_read, coord_buffers, nbr_buffers);
+            auto read_status = read_nodes_parallel(nodes_to_read, coord_buffers, nbr_buffers);
 
             // process each nhood buf
-            for (uint32_t i = 0; i < read_status.size(); i++)
+            for (uint32_t i = 0; i < read_status.size() && !finish_flag; i++)
             {
                 if (read_status[i] == false)
-                {
                     continue;
-                }
-                else
-                {
-                    uint32_t nnbrs = nbr_buffers[i].first;
-                    uint32_t *nbrs = nbr_buffers[i].second;
 
-                    // explore next level
-                    for (uint32_t j = 0; j < nnbrs && !finish_flag; j++)
+                uint32_t nnbrs = nbr_buffers[i].first;
+                uint32_t *nbrs = nbr_buffers[i].second;
+
+                // explore next level
+                for (uint32_t j = 0; j < nnbrs && !finish_flag; j++)
+                {
+                    if (node_set.find(nbrs[j]) == node_set.end())
                     {
-                        if (node_set.find(nbrs[j]) == node_set.end())
-                        {
-                            cur_level->insert(nbrs[j]);
-                        }
-                        if (cur_level->size() + node_set.size() >= num_nodes_to_cache)
-                        {
-                            finish_flag = true;
-                        }
+                        cur_level->insert(nbrs[j]);
+                    }
+                    if (cur_level->size() + node_set.size() >= num_nodes_to_cache)
+                    {
+                        finish_flag = true;
                     }
                 }
-                delete[] nbr_buffers[i].second;
             }
         }
 
@@ -601,6 +1243,18 @@ LabelT PQFlashIndex<T, LabelT>::get_converted_label(const std::string &filter_la
     throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
 }
 
+template <typename T, typename LabelT>
+LabelFilter<LabelT> PQFlashIndex<T, LabelT>::get_converted_filter(const std::string &filter)
+{
+    return parse_label_filter<LabelT>(filter, [this](const std::string &raw_label, LabelT &label) {
+        auto iter = _label_map.find(raw_label);
+        if (iter == _label_map.end())
+            return false;
+        label = iter->second;
+        return true;
+    });
+}
+
 template <typename T, typename LabelT>
 void PQFlashIndex<T, LabelT>::reset_stream_for_reading(std::basic_istream<char> &infile)
 {
@@ -655,6 +1309,8 @@ void PQFlashIndex<T, LabelT>::get_label_file_metadata(const std::string &fileCon
 template <typename T, typename LabelT>
 inline bool PQFlashIndex<T, LabelT>::point_has_label(uint32_t point_id, LabelT label_id)
 {
+    if (!_label_bitmap.empty())
+        return _label_bitmap.contains(point_id, (uint32_t)label_id);
     uint32_t start_vec = _pts_to_label_offsets[point_id];
     uint32_t num_lbls = _pts_to_label_counts[point_id];
     bool ret_val = false;
@@ -670,83 +1326,151 @@ inline bool PQFlashIndex<T, LabelT>::point_has_label(uint32_t point_id, LabelT l
 }
 
 template <typename T, typename LabelT>
-void PQFlashIndex<T, LabelT>::parse_label_file(std::basic_istream<char> &infile, size_t &num_points_labels)
+inline bool PQFlashIndex<T, LabelT>::point_matches_filter(uint32_t point_id, const LabelFilter<LabelT> &filter,
+                                                          bool all_parts)
 {
-    infile.seekg(0, std::ios::end);
-    size_t file_size = infile.tellg();
-
-    std::string buffer(file_size, ' ');
-
-    infile.seekg(0, std::ios::beg);
-    infile.read(&buffer[0], file_size);
+    auto real_iter = _real_to_dummy_map.end();
+    if (all_parts && !_dummy_pts.empty())
+    {
+        auto dummy_iter = _dummy_to_real_map.find(point_id);
+        real_iter = _real_to_dummy_map.find(dummy_iter == _dummy_to_real_map.end() ? point_id : dummy_iter->second);
+    }
+    if (real_iter == _real_to_dummy_map.end())
+    {
+        return filter.matches(
+            [&](const LabelT &label) { return point_has_label(point_id, label); },
+            [&]() { return _use_universal_label && point_has_label(point_id, _universal_filter_label); });
+    }
 
-    std::string line;
-    uint32_t line_cnt = 0;
+    auto has_label = [&](const LabelT &label) {
+        if (point_has_label(real_iter->first, label))
+            return true;
+        for (uint32_t dummy : real_iter->second)
+        {
+            if (point_has_label(dummy, label))
+                return true;
+        }
+        return false;
+    };
+    return filter.matches(has_label, [&]() { return _use_universal_label && has_label(_universal_filter_label); });
+}
 
-    uint32_t num_pts_in_label_file;
-    uint32_t num_total_labels;
-    get_label_file_metadata(buffer, num_pts_in_label_file, num_total_labels);
+template <typename T, typename LabelT>
+size_t PQFlashIndex<T, LabelT>::select_matching(uint32_t *ids, size_t n, const LabelFilter<LabelT> &filter,
+                                                bool all_parts)
+{
+    // the universal label and the parts of split points need more than the
+    // one label of the filter
+    if (filter.is_single_label() && !_label_bitmap.empty() && !_use_universal_label &&
+        !(all_parts && !_dummy_pts.empty()))
+    {
+        return _label_bitmap.select(ids, n, (uint32_t)filter.clauses[0][0]);
+    }
 
-    _pts_to_label_offsets = new uint32_t[num_pts_in_label_file];
-    _pts_to_label_counts = new uint32_t[num_pts_in_label_file];
-    _pts_to_labels = new LabelT[num_total_labels];
-    uint32_t labels_seen_so_far = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (point_matches_filter(ids[i], filter, all_parts))
+            ids[count++] = ids[i];
+    }
+    return count;
+}
 
-    std::string label_str;
-    size_t cur_pos = 0;
-    size_t next_pos = 0;
-    while (cur_pos < file_size && cur_pos != std::string::npos)
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::parse_label_file(std::basic_istream<char> &infile, size_t &num_points_labels)
+{
+    infile.seekg(0, std::ios::end);
+    size_t file_size = infile.tellg();
+
+    std::string buffer(file_size, ' ');
+
+    infile.seekg(0, std::ios::beg);
+    infile.read(&buffer[0], file_size);
+
+    // only lines terminated by '\n' hold a point; find their ends in one pass
+    std::vector<size_t> line_ends;
+    for (size_t pos = 0; pos < file_size;)
     {
-        next_pos = buffer.find('\n', cur_pos);
-        if (next_pos == std::string::npos)
-        {
+        const char *eol = (const char *)std::memchr(buffer.data() + pos, '\n', file_size - pos);
+        if (eol == nullptr)
             break;
-        }
-
-        _pts_to_label_offsets[line_cnt] = labels_seen_so_far;
-        uint32_t &num_lbls_in_cur_pt = _pts_to_label_counts[line_cnt];
-        num_lbls_in_cur_pt = 0;
+        line_ends.push_back((size_t)(eol - buffer.data()));
+        pos = line_ends.back() + 1;
+    }
+    const uint32_t line_cnt = (uint32_t)line_ends.size();
+    auto line_begin_of = [&](int64_t i) { return buffer.begin() + (i == 0 ? 0 : line_ends[i - 1] + 1); };
+
+    // count the labels of each line in parallel, lay them out in file order
+    // and parse them in parallel
+    _pts_to_label_offsets = new uint32_t[line_cnt];
+    _pts_to_label_counts = new uint32_t[line_cnt];
+#pragma omp parallel for schedule(static, 16384)
+    for (int64_t i = 0; i < (int64_t)line_cnt; i++)
+    {
+        const auto line_begin = line_begin_of(i);
+        const auto line_end = buffer.begin() + line_ends[i];
+        uint32_t count = 0;
+        for (auto lbl = line_begin; lbl < line_end; lbl = std::find(lbl, line_end, ',') + 1)
+            count++;
+        _pts_to_label_counts[i] = count;
+    }
 
-        size_t lbl_pos = cur_pos;
-        size_t next_lbl_pos = 0;
-        while (lbl_pos < next_pos && lbl_pos != std::string::npos)
+    uint32_t num_total_labels = 0;
+    for (uint32_t i = 0; i < line_cnt; i++)
+    {
+        if (_pts_to_label_counts[i] == 0)
         {
-            next_lbl_pos = buffer.find(',', lbl_pos);
-            if (next_lbl_pos == std::string::npos) // the last label in the whole file
-            {
-                next_lbl_pos = next_pos;
-            }
-
-            if (next_lbl_pos > next_pos) // the last label in one line, just read to the end
-            {
-                next_lbl_pos = next_pos;
-            }
+            diskann::cout << "No label found for point " << i << std::endl;
+            exit(-1);
+        }
+        _pts_to_label_offsets[i] = num_total_labels;
+        num_total_labels += _pts_to_label_counts[i];
+    }
+    if (_labels_placement.tier != MemoryTier::DRAM)
+    {
+        _labels_buffer = alloc_placed(num_total_labels * sizeof(LabelT), alignof(LabelT), _labels_placement);
+        _pts_to_labels = (LabelT *)_labels_buffer.ptr;
+    }
+    else
+    {
+        _pts_to_labels = new LabelT[num_total_labels];
+    }
 
-            label_str.assign(buffer.c_str() + lbl_pos, next_lbl_pos - lbl_pos);
-            if (label_str[label_str.length() - 1] == '\t') // '\t' won't exist in label file?
+    std::exception_ptr error = nullptr;
+#pragma omp parallel for schedule(static, 16384)
+    for (int64_t i = 0; i < (int64_t)line_cnt; i++)
+    {
+        try
+        {
+            const auto line_begin = line_begin_of(i);
+            const auto line_end = buffer.begin() + line_ends[i];
+            LabelT *lbls = _pts_to_labels + _pts_to_label_offsets[i];
+            std::string label_str;
+            for (auto lbl = line_begin; lbl < line_end;)
             {
-                label_str.erase(label_str.length() - 1);
+                const auto lbl_end = std::find(lbl, line_end, ',');
+                label_str.assign(lbl, lbl_end);
+                if (!label_str.empty() && label_str.back() == '\t') // '\t' won't exist in label file?
+                {
+                    label_str.pop_back();
+                }
+                *lbls++ = (LabelT)std::stoul(label_str);
+                lbl = lbl_end + 1;
             }
-
-            LabelT token_as_num = (LabelT)std::stoul(label_str);
-            _pts_to_labels[labels_seen_so_far++] = (LabelT)token_as_num;
-            num_lbls_in_cur_pt++;
-
-            // move to next label
-            lbl_pos = next_lbl_pos + 1;
         }
-
-        // move to next line
-        cur_pos = next_pos + 1;
-
-        if (num_lbls_in_cur_pt == 0)
+        catch (...)
         {
-            diskann::cout << "No label found for point " << line_cnt << std::endl;
-            exit(-1);
+#pragma omp critical
+            if (error == nullptr)
+                error = std::current_exception();
         }
-
-        line_cnt++;
     }
+    if (error != nullptr)
+        std::rethrow_exception(error);
+
+    _label_counts.clear();
+    for (uint32_t i = 0; i < num_total_labels; i++)
+        _label_counts[_pts_to_labels[i]]++;
 
     num_points_labels = line_cnt;
     reset_stream_for_reading(infile);
@@ -767,7 +1491,9 @@ template <typename T, typename LabelT> int PQFlashIndex<T, LabelT>::load(uint32_
 {
 #endif
     std::string pq_table_bin = std::string(index_prefix) + "_pq_pivots.bin";
-    std::string pq_compressed_vectors = std::string(index_prefix) + "_pq_compressed.bin";
+    std::string pq_compressed_vectors = _quantizer != nullptr
+                                            ? _quantizer->get_quantized_vectors_filename(index_prefix)
+                                            : std::string(index_prefix) + "_pq_compressed.bin";
     std::string _disk_index_file = std::string(index_prefix) + "_disk.index";
 #ifdef EXEC_ENV_OLS
     return load_from_separate_paths(files, num_threads, _disk_index_file.c_str(), pq_table_bin.c_str(),
@@ -811,27 +1537,134 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
 
     this->_disk_index_file = _disk_index_file;
 
-    if (pq_file_num_centroids != 256)
+    if (_quantizer != nullptr && _dist_cmp->get_metric() != diskann::Metric::L2)
+    {
+        throw ANNException("set_quantizer() only supports L2 indices", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    // indices converted to L2 search by an extra dimension keep the max norm
+    // of the base; those built natively compare by inner product throughout
+    std::string norm_file = std::string(_disk_index_file) + "_max_base_norm.bin";
+#ifdef EXEC_ENV_OLS
+    _native_mips = metric == diskann::Metric::INNER_PRODUCT && !files.fileExists(norm_file);
+#else
+    _native_mips = metric == diskann::Metric::INNER_PRODUCT && !file_exists(norm_file);
+#endif
+    if (_native_mips)
+    {
+        diskann::cout << "No " << norm_file << ", so the index was built for native inner product search"
+                      << std::endl;
+        this->_dist_cmp.reset(diskann::get_distance_function<T>(diskann::Metric::INNER_PRODUCT));
+        this->_dist_cmp_float.reset(diskann::get_distance_function<float>(diskann::Metric::INNER_PRODUCT));
+    }
+    // with a quantizer, the pivots only give the dimension, and the codes
+    // are its own
+    const bool wide_pq = _quantizer == nullptr && pq_file_num_centroids > NUM_PQ_CENTROIDS &&
+                         pq_file_num_centroids <= MAX_NUM_PQ_CENTROIDS_WIDE &&
+                         (pq_file_num_centroids & (pq_file_num_centroids - 1)) == 0;
+    if (pq_file_num_centroids != NUM_PQ_CENTROIDS && pq_file_num_centroids != NUM_PQ_CENTROIDS_FAST_SCAN && !wide_pq)
     {
-        diskann::cout << "Error. Number of PQ centroids is not 256. Exiting." << std::endl;
+        diskann::cout << "Error. Number of PQ centroids is not " << NUM_PQ_CENTROIDS << ", "
+                      << NUM_PQ_CENTROIDS_FAST_SCAN << " or a power of two up to " << MAX_NUM_PQ_CENTROIDS_WIDE
+                      << ". Exiting." << std::endl;
         return -1;
     }
+    const size_t pq_code_size = _quantizer != nullptr ? 1 : get_pq_code_size(pq_file_num_centroids);
 
     this->_data_dim = pq_file_dim;
     // will change later if we use PQ on disk or if we are using
     // inner product without PQ
     this->_disk_bytes_per_point = this->_data_dim * sizeof(T);
     this->_aligned_dim = ROUND_UP(pq_file_dim, 8);
+    this->_fixed_dim_cmp = get_fixed_dim_distance_function<T>(_dist_cmp->get_metric(), (uint32_t)_aligned_dim);
+    this->_mixed_dist_cmp = get_mixed_distance_function<T>(_dist_cmp->get_metric());
 
     size_t npts_u64, nchunks_u64;
 #ifdef EXEC_ENV_OLS
     diskann::load_bin<uint8_t>(files, pq_compressed_vectors, this->data, npts_u64, nchunks_u64);
 #else
-    diskann::load_bin<uint8_t>(pq_compressed_vectors, this->data, npts_u64, nchunks_u64);
+    diskann::get_bin_metadata(pq_compressed_vectors, npts_u64, nchunks_u64);
+    const bool fast_scan_codes = _quantizer == nullptr && pq_file_num_centroids == NUM_PQ_CENTROIDS_FAST_SCAN;
+    if (!_shared_memory_name.empty())
+    {
+        // the segment holds the codes as searched, packed if fast-scan
+        const size_t codes_len =
+            npts_u64 * (fast_scan_codes ? DIV_ROUND_UP(nchunks_u64, 2) : nchunks_u64 * pq_code_size);
+        _pq_segment = std::make_unique<SharedSegment>(_shared_memory_name + "_pq", codes_len, [&](char *buf) {
+            if (!fast_scan_codes)
+            {
+                read_file_parallel(pq_compressed_vectors, buf, 2 * sizeof(int32_t), codes_len);
+                return;
+            }
+            LargeBuffer codes = alloc_large(npts_u64 * nchunks_u64, 1);
+            read_file_parallel(pq_compressed_vectors, (char *)codes.ptr, 2 * sizeof(int32_t), npts_u64 * nchunks_u64);
+            diskann::pack_fast_scan_codes((uint8_t *)codes.ptr, npts_u64, nchunks_u64, (uint8_t *)buf);
+            free_large(codes);
+        });
+        this->data = (uint8_t *)_pq_segment->data();
+    }
+    else if (_lazy_load && (_quantizer != nullptr || pq_file_num_centroids != NUM_PQ_CENTROIDS_FAST_SCAN) &&
+        !CompressedFile::is_compressed(pq_compressed_vectors))
+    {
+        // serve the codes from the page cache: pages searches touch first are
+        // read on demand, and a background thread reads in the others
+        _pq_mapping = std::make_unique<MemoryMapper>(pq_compressed_vectors);
+        if (_pq_mapping->getFileSize() < 2 * sizeof(int32_t) + npts_u64 * nchunks_u64 * pq_code_size)
+        {
+            throw ANNException("PQ codes file " + pq_compressed_vectors + " is truncated", -1, __FUNCSIG__,
+                               __FILE__, __LINE__);
+        }
+        this->data = (uint8_t *)_pq_mapping->getBuf() + 2 * sizeof(int32_t);
+#ifndef _WINDOWS
+        madvise(_pq_mapping->getBuf(), _pq_mapping->getFileSize(), MADV_WILLNEED);
+#endif
+        _pq_codes_resident = false;
+        _pq_populate_thread = std::thread([this]() { populate_pq_codes(); });
+    }
+    else
+    {
+        // read straight into a buffer allocated under the memory policy; the
+        // parallel read also spreads first touch of its pages over the threads
+        _pq_data_buffer = alloc_placed(npts_u64 * nchunks_u64 * pq_code_size, 1, _pq_codes_placement);
+        this->data = (uint8_t *)_pq_data_buffer.ptr;
+        read_file_parallel(pq_compressed_vectors, (char *)this->data, 2 * sizeof(int32_t),
+                           npts_u64 * nchunks_u64 * pq_code_size);
+    }
 #endif
 
     this->_num_points = npts_u64;
     this->_n_chunks = nchunks_u64;
+    this->_pq_code_len = nchunks_u64 * pq_code_size;
+    if (wide_pq)
+    {
+        _use_wide_pq = true;
+        diskann::cout << "Using PQ with " << pq_file_num_centroids << " centroids per chunk, " << _pq_code_len
+                      << " bytes per point in memory." << std::endl;
+    }
+    if (_quantizer != nullptr && _n_chunks != _quantizer->get_num_chunks())
+    {
+        throw ANNException("The codes in " + pq_compressed_vectors + " have " + std::to_string(_n_chunks) +
+                               " bytes, the quantizer " + std::to_string(_quantizer->get_num_chunks()),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#ifdef EXEC_ENV_OLS
+    const bool fast_scan_codes = _quantizer == nullptr && pq_file_num_centroids == NUM_PQ_CENTROIDS_FAST_SCAN;
+#endif
+    if (fast_scan_codes)
+    {
+        // 4-bit codes: keep two per byte and score them with the fast-scan kernel
+        _use_fast_scan_pq = true;
+        _pq_code_len = DIV_ROUND_UP(_n_chunks, 2);
+        if (_pq_segment == nullptr)
+        {
+            LargeBuffer packed = alloc_placed(_num_points * _pq_code_len, 1, _pq_codes_placement);
+            diskann::pack_fast_scan_codes(this->data, _num_points, _n_chunks, (uint8_t *)packed.ptr);
+            free_large(_pq_data_buffer);
+            _pq_data_buffer = packed;
+            this->data = (uint8_t *)_pq_data_buffer.ptr;
+        }
+        diskann::cout << "Using 4-bit fast-scan PQ, " << _pq_code_len << " bytes per point in memory." << std::endl;
+    }
 #ifdef EXEC_ENV_OLS
     if (files.fileExists(labels_file))
     {
@@ -848,6 +1681,12 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
 #endif
         parse_label_file(infile, num_pts_in_label_file);
         assert(num_pts_in_label_file == this->_num_points);
+        if (!_shared_memory_name.empty())
+            share_labels();
+        const uint64_t num_total_labels =
+            _num_points == 0 ? 0 : _pts_to_label_offsets[_num_points - 1] + _pts_to_label_counts[_num_points - 1];
+        if (_num_points > 0 && num_total_labels >= _num_points * defaults::LABEL_BITMAP_MIN_AVG_LABELS)
+            set_label_bitmap(true);
 
 #ifndef EXEC_ENV_OLS
         infile.close();
@@ -972,9 +1811,9 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
     }
 
 #ifdef EXEC_ENV_OLS
-    _pq_table.load_pq_centroid_bin(files, pq_table_bin.c_str(), nchunks_u64);
+    _pq_table.load_pq_centroid_bin(files, pq_table_bin.c_str(), _quantizer != nullptr ? 0 : nchunks_u64);
 #else
-    _pq_table.load_pq_centroid_bin(pq_table_bin.c_str(), nchunks_u64);
+    _pq_table.load_pq_centroid_bin(pq_table_bin.c_str(), _quantizer != nullptr ? 0 : nchunks_u64);
 #endif
 
     diskann::cout << "Loaded PQ centroids and in-memory compressed vectors. #points: " << _num_points
@@ -1053,16 +1892,6 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
     READ_U64(index_metadata, medoid_id_on_file);
     READ_U64(index_metadata, _max_node_len);
     READ_U64(index_metadata, _nnodes_per_sector);
-    _max_degree = ((_max_node_len - _disk_bytes_per_point) / sizeof(uint32_t)) - 1;
-
-    if (_max_degree > defaults::MAX_GRAPH_DEGREE)
-    {
-        std::stringstream stream;
-        stream << "Error loading index. Ensure that max graph degree (R) does "
-                  "not exceed "
-               << defaults::MAX_GRAPH_DEGREE << std::endl;
-        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
-    }
 
     // setting up concept of frozen points in disk index for streaming-DiskANN
     READ_U64(index_metadata, this->_num_frozen_points);
@@ -1088,12 +1917,124 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
         READ_U64(index_metadata, this->_reorder_data_start_sector);
         READ_U64(index_metadata, this->_ndims_reorder_vecs);
         READ_U64(index_metadata, this->_nvecs_per_sector);
+        // start sector 0 is the metadata sector, and stands for reorder data
+        // kept in a file of its own
+        if (this->_reorder_data_start_sector == 0)
+        {
+#ifdef EXEC_ENV_OLS
+            throw ANNException("Reorder data in a file of its own is not supported in this environment", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+#else
+#ifdef _WINDOWS
+            _vectors_reader.reset(new WindowsAlignedFileReader());
+#else
+            _vectors_reader.reset(new LinuxAlignedFileReader());
+#endif
+            _vectors_reader->open(get_disk_index_vectors_file(_disk_index_file));
+            diskann::cout << "Reorder data is read from " << get_disk_index_vectors_file(_disk_index_file)
+                          << std::endl;
+#endif
+        }
+    }
+
+    // the file size, then in an index with neighbor PQ codes in its nodes
+    // the number of PQ chunks of each code (or 0), then the length of the
+    // sectors, then the bits of each neighbor id if they are packed; each
+    // row is only present if it or a later one is not the default
+    const uint32_t rows_read = this->_reorder_data_exists ? 11 : 8;
+    if (nr > rows_read + 1)
+    {
+        uint64_t file_size;
+        READ_U64(index_metadata, file_size);
+        READ_U64(index_metadata, this->_inline_pq_chunks);
+        if (this->_inline_pq_chunks != 0 && (this->_use_wide_pq || this->_quantizer != nullptr))
+        {
+            throw ANNException("The neighbor PQ codes in " + _disk_index_file +
+                                   " are PQ codes of 256 centroids per chunk, which the search does not use",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        if (this->_inline_pq_chunks != 0 && this->_inline_pq_chunks != this->_n_chunks)
+        {
+            throw ANNException("The neighbor PQ codes in " + _disk_index_file + " have " +
+                                   std::to_string(this->_inline_pq_chunks) + " chunks, the PQ data " +
+                                   std::to_string(this->_n_chunks),
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+    if (nr > rows_read + 2)
+    {
+        READ_U64(index_metadata, this->_sector_len);
+        if (!is_valid_sector_len(this->_sector_len))
+        {
+            throw ANNException(_disk_index_file + " has sectors of " + std::to_string(this->_sector_len) +
+                                   " bytes, which is not one of 512, 1024, 2048 and 4096",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+    if (nr > rows_read + 3)
+    {
+        READ_U64(index_metadata, this->_nbr_id_bits);
+        if (this->_nbr_id_bits > 32)
+        {
+            throw ANNException(_disk_index_file + " has neighbor ids of " + std::to_string(this->_nbr_id_bits) +
+                                   " bits",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+    }
+    // a node is its coordinates, its number of neighbors, and max_degree
+    // neighbor ids, each followed in the same order by their PQ codes if any
+    const uint64_t nhood_len = _max_node_len - _disk_bytes_per_point - sizeof(uint32_t);
+    if (this->_nbr_id_bits == 0)
+    {
+        _max_degree = nhood_len / (sizeof(uint32_t) + this->_inline_pq_chunks);
+        _nbr_ids_len = _max_degree * sizeof(uint32_t);
+    }
+    else
+    {
+        // packed ids fill whole words, so this is the largest degree whose ids
+        // and codes fit
+        _max_degree = nhood_len * 8 / (this->_nbr_id_bits + 8 * this->_inline_pq_chunks);
+        while (_max_degree > 0 &&
+               get_packed_ids_len(_max_degree, (uint32_t)this->_nbr_id_bits) + _max_degree * _inline_pq_chunks >
+                   nhood_len)
+            _max_degree--;
+        _nbr_ids_len = get_packed_ids_len(_max_degree, (uint32_t)this->_nbr_id_bits);
+    }
+
+    if (_max_degree > defaults::MAX_GRAPH_DEGREE)
+    {
+        std::stringstream stream;
+        stream << "Error loading index. Ensure that max graph degree (R) does "
+                  "not exceed "
+               << defaults::MAX_GRAPH_DEGREE << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#ifndef EXEC_ENV_OLS
+    if (this->_inline_pq_chunks > 0 && _pq_mapping != nullptr)
+    {
+        // expansions score neighbors from their nodes, so the mapped codes
+        // are only read on demand, for the start points and cached nodes
+        _stop_populating = true;
+        if (_pq_populate_thread.joinable())
+            _pq_populate_thread.join();
+#ifndef _WINDOWS
+        madvise(_pq_mapping->getBuf(), _pq_mapping->getFileSize(), MADV_RANDOM);
+#endif
+        _pq_codes_resident = true;
     }
+#endif
 
     diskann::cout << "Disk-Index File Meta-data: ";
     diskann::cout << "# nodes per sector: " << _nnodes_per_sector;
     diskann::cout << ", max node len (bytes): " << _max_node_len;
-    diskann::cout << ", max node degree: " << _max_degree << std::endl;
+    diskann::cout << ", max node degree: " << _max_degree;
+    if (this->_inline_pq_chunks > 0)
+        diskann::cout << ", neighbor PQ codes in the nodes";
+    if (this->_sector_len != defaults::SECTOR_LEN)
+        diskann::cout << ", sector len (bytes): " << this->_sector_len;
+    if (this->_nbr_id_bits > 0)
+        diskann::cout << ", neighbor ids packed in " << this->_nbr_id_bits << " bits";
+    diskann::cout << std::endl;
 
 #ifdef EXEC_ENV_OLS
     delete[] bytes;
@@ -1107,6 +2048,8 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
     reader->open(index_fname);
     this->setup_thread_data(num_threads);
     this->_max_nthreads = num_threads;
+    if (_reorder_resident && _reorder_data_exists)
+        load_reorder_vectors();
 
 #endif
 
@@ -1172,8 +2115,6 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
         use_medoids_data_as_centroids();
     }
 
-    std::string norm_file = std::string(_disk_index_file) + "_max_base_norm.bin";
-
 #ifdef EXEC_ENV_OLS
     if (files.fileExists(norm_file) && metric == diskann::Metric::INNER_PRODUCT)
     {
@@ -1191,10 +2132,248 @@ int PQFlashIndex<T, LabelT>::load_from_separate_paths(uint32_t num_threads, cons
         diskann::cout << "Setting re-scaling factor of base vectors to " << this->_max_base_norm << std::endl;
         delete[] norm_val;
     }
+
+    // present if build_disk_index renumbered the nodes for sector locality
+    std::string layout_ids_file = std::string(_disk_index_file) + "_layout_ids.bin";
+#ifdef EXEC_ENV_OLS
+    if (files.fileExists(layout_ids_file))
+    {
+        uint32_t *layout_ids;
+        size_t num_ids, ids_dim;
+        diskann::load_bin<uint32_t>(files, layout_ids_file, layout_ids, num_ids, ids_dim);
+#else
+    if (file_exists(layout_ids_file))
+    {
+        uint32_t *layout_ids;
+        size_t num_ids, ids_dim;
+        diskann::load_bin<uint32_t>(layout_ids_file, layout_ids, num_ids, ids_dim);
+#endif
+        if (num_ids != _num_points || ids_dim != 1)
+        {
+            delete[] layout_ids;
+            throw diskann::ANNException("Layout id map does not match the number of points in the index", -1,
+                                        __FUNCSIG__, __FILE__, __LINE__);
+        }
+        _layout_ids.assign(layout_ids, layout_ids + num_ids);
+        delete[] layout_ids;
+        diskann::cout << "Loaded layout id map; results are translated to the original ids" << std::endl;
+    }
+
+    // present if build_disk_index collapsed duplicates, with the node of
+    // every original point
+    std::string duplicates_file = std::string(_disk_index_file) + "_duplicates.bin";
+#ifdef EXEC_ENV_OLS
+    if (files.fileExists(duplicates_file))
+    {
+        uint32_t *point_nodes;
+        size_t num_ids, ids_dim;
+        diskann::load_bin<uint32_t>(files, duplicates_file, point_nodes, num_ids, ids_dim);
+#else
+    if (file_exists(duplicates_file))
+    {
+        uint32_t *point_nodes;
+        size_t num_ids, ids_dim;
+        diskann::load_bin<uint32_t>(duplicates_file, point_nodes, num_ids, ids_dim);
+#endif
+        std::vector<uint32_t> offsets(_num_points + 1, 0);
+        bool valid = ids_dim == 1;
+        for (size_t i = 0; valid && i < num_ids; i++)
+        {
+            valid = point_nodes[i] < _num_points;
+            if (valid)
+                offsets[point_nodes[i] + 1]++;
+        }
+        if (!valid)
+        {
+            delete[] point_nodes;
+            throw diskann::ANNException("Duplicates map does not match the number of points in the index", -1,
+                                        __FUNCSIG__, __FILE__, __LINE__);
+        }
+        for (size_t i = 0; i < _num_points; i++)
+            offsets[i + 1] += offsets[i];
+        // points are placed in their order, so each node lists its
+        // representative, the first of its points, first
+        std::vector<uint32_t> ids(num_ids);
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < num_ids; i++)
+            ids[next[point_nodes[i]]++] = (uint32_t)i;
+        delete[] point_nodes;
+        _duplicate_offsets.swap(offsets);
+        _duplicate_ids.swap(ids);
+        diskann::cout << "Loaded duplicates map; results expand to the " << num_ids << " original points"
+                      << std::endl;
+    }
+
+#ifndef EXEC_ENV_OLS
+    // present if build_disk_index was asked for an entry layer
+    std::string entry_layer_file = std::string(_disk_index_file) + "_entry_layer.index";
+    if (file_exists(entry_layer_file))
+        load_entry_layer(entry_layer_file, num_threads);
+#endif
     diskann::cout << "done.." << std::endl;
     return 0;
 }
 
+template <typename T, typename LabelT>
+float PQFlashIndex<T, LabelT>::prepare_query(const T *query, T *aligned_query_T, PQScratch<T> *pq_query_scratch)
+{
+    float query_norm = 0;
+
+    // normalization step. for cosine, we simply normalize the query
+    // for mips, we normalize the first d-1 dims, and add a 0 for last dim, since an extra coordinate was used to
+    // convert MIPS to L2 search. native MIPS indices take the query as it is.
+    if ((metric == diskann::Metric::INNER_PRODUCT && !_native_mips) || metric == diskann::Metric::COSINE)
+    {
+        uint64_t inherent_dim = (metric == diskann::Metric::COSINE) ? this->_data_dim : (uint64_t)(this->_data_dim - 1);
+        for (size_t i = 0; i < inherent_dim; i++)
+        {
+            aligned_query_T[i] = query[i];
+            query_norm += query[i] * query[i];
+        }
+        if (metric == diskann::Metric::INNER_PRODUCT)
+            aligned_query_T[this->_data_dim - 1] = 0;
+
+        query_norm = std::sqrt(query_norm);
+
+        for (size_t i = 0; i < inherent_dim; i++)
+        {
+            aligned_query_T[i] = (T)(aligned_query_T[i] / query_norm);
+        }
+        pq_query_scratch->initialize(this->_data_dim, aligned_query_T);
+    }
+    else
+    {
+        for (size_t i = 0; i < this->_data_dim; i++)
+        {
+            aligned_query_T[i] = query[i];
+        }
+        pq_query_scratch->initialize(this->_data_dim, aligned_query_T);
+    }
+    return query_norm;
+}
+
+namespace
+{
+// value rounded to the nearest T, saturating for bytes
+template <typename T> T round_query_value(const float value)
+{
+    return (T)value;
+}
+template <> int8_t round_query_value(const float value)
+{
+    return (int8_t)std::round((std::min)((std::max)(value, -128.0f), 127.0f));
+}
+template <> uint8_t round_query_value(const float value)
+{
+    return (uint8_t)std::round((std::min)((std::max)(value, 0.0f), 255.0f));
+}
+} // namespace
+
+template <typename T, typename LabelT>
+const float *PQFlashIndex<T, LabelT>::prepare_float_query(const float *query, SSDQueryScratch<T> *query_scratch,
+                                                          float &query_norm)
+{
+    // normalized as prepare_query() does, but in float
+    const bool normalize = (metric == diskann::Metric::INNER_PRODUCT && !_native_mips) ||
+                           metric == diskann::Metric::COSINE;
+    const uint64_t inherent_dim =
+        (normalize && metric == diskann::Metric::INNER_PRODUCT) ? this->_data_dim - 1 : this->_data_dim;
+    query_norm = 0;
+    if (normalize)
+    {
+        for (size_t i = 0; i < inherent_dim; i++)
+            query_norm += query[i] * query[i];
+        query_norm = std::sqrt(query_norm);
+    }
+
+    T *aligned_query_T = query_scratch->aligned_query_T();
+    PQScratch<T> *pq_query_scratch = query_scratch->pq_scratch();
+    for (size_t i = 0; i < this->_data_dim; i++)
+    {
+        const float value = i >= inherent_dim ? 0.0f : normalize ? query[i] / query_norm : query[i];
+        query_scratch->float_query[i] = value;
+        pq_query_scratch->aligned_query_float[i] = value;
+        pq_query_scratch->rotated_query[i] = value;
+        aligned_query_T[i] = round_query_value<T>(value);
+    }
+    return _mixed_dist_cmp != nullptr ? query_scratch->float_query : nullptr;
+}
+
+#ifndef EXEC_ENV_OLS
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::load_entry_layer(const std::string &entry_layer_file, uint32_t num_threads)
+{
+    size_t ids_dim;
+    diskann::load_bin<uint32_t>(entry_layer_file + "_ids.bin", _entry_layer_ids, _num_entry_layer_points, ids_dim);
+    if (ids_dim != 1)
+    {
+        throw diskann::ANNException("Error loading entry layer ids. Expected bin format of m times 1 uint32_t.", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    for (size_t i = 0; i < _num_entry_layer_points; i++)
+    {
+        if (_entry_layer_ids[i] >= _num_points)
+        {
+            throw diskann::ANNException("Entry layer refers to a node outside the index", -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        }
+    }
+
+    _entry_layer = std::make_unique<Index<float, uint32_t, uint32_t>>(diskann::Metric::L2, _data_dim,
+                                                                      _num_entry_layer_points, nullptr, nullptr);
+    _entry_layer->load(entry_layer_file.c_str(), num_threads, defaults::ENTRY_LAYER_SEARCH_LIST_SIZE);
+    if (_entry_layer->get_num_points() != _num_entry_layer_points)
+    {
+        throw diskann::ANNException("Entry layer graph and ids file disagree on the number of points", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    diskann::cout << "Loaded entry layer over " << _num_entry_layer_points << " points" << std::endl;
+}
+#endif
+
+template <typename T, typename LabelT>
+uint32_t PQFlashIndex<T, LabelT>::get_start_points(const float *query_float, uint32_t *start_points)
+{
+    if (_entry_layer != nullptr)
+    {
+        uint32_t seeds[defaults::ENTRY_LAYER_NUM_SEEDS];
+        std::fill(seeds, seeds + defaults::ENTRY_LAYER_NUM_SEEDS, std::numeric_limits<uint32_t>::max());
+        _entry_layer->search(query_float, defaults::ENTRY_LAYER_NUM_SEEDS, defaults::ENTRY_LAYER_SEARCH_LIST_SIZE,
+                             seeds);
+
+        uint32_t num_start_points = 0;
+        for (uint32_t i = 0; i < defaults::ENTRY_LAYER_NUM_SEEDS; i++)
+        {
+            if (seeds[i] < _num_entry_layer_points)
+                start_points[num_start_points++] = _entry_layer_ids[seeds[i]];
+        }
+        if (num_start_points > 0)
+            return num_start_points;
+    }
+
+    // keep the medoids of the closest few centroids, nearest first
+    const uint32_t max_start_points = (uint32_t)(std::min)((size_t)defaults::ENTRY_LAYER_NUM_SEEDS, _num_medoids);
+    float start_dists[defaults::ENTRY_LAYER_NUM_SEEDS];
+    uint32_t num_start_points = 0;
+    for (uint64_t cur_m = 0; cur_m < _num_medoids; cur_m++)
+    {
+        float cur_expanded_dist =
+            _dist_cmp_float->compare(query_float, _centroid_data + _aligned_dim * cur_m, (uint32_t)_aligned_dim);
+        if (num_start_points == max_start_points && cur_expanded_dist >= start_dists[max_start_points - 1])
+            continue;
+
+        uint32_t pos = num_start_points < max_start_points ? num_start_points++ : max_start_points - 1;
+        for (; pos > 0 && start_dists[pos - 1] > cur_expanded_dist; pos--)
+        {
+            start_dists[pos] = start_dists[pos - 1];
+            start_points[pos] = start_points[pos - 1];
+        }
+        start_dists[pos] = cur_expanded_dist;
+        start_points[pos] = _medoids[cur_m];
+    }
+    return num_start_points;
+}
+
 #ifdef USE_BING_INFRA
 bool getNextCompletedRequest(std::shared_ptr<AlignedFileReader> &reader, IOContext &ctx, size_t size,
                              int &completedIndex)
@@ -1264,8 +2443,7 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                                                  const uint32_t io_limit, const bool use_reorder_data,
                                                  QueryStats *stats)
 {
-    LabelT dummy_filter = 0;
-    cached_beam_search(query1, k_search, l_search, indices, distances, beam_width, false, dummy_filter, io_limit,
+    cached_beam_search(query1, k_search, l_search, indices, distances, beam_width, LabelFilter<LabelT>(), io_limit,
                        use_reorder_data, stats);
 }
 
@@ -1276,13 +2454,133 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                                                  const uint32_t io_limit, const bool use_reorder_data,
                                                  QueryStats *stats)
 {
-
-    uint64_t num_sector_per_nodes = DIV_ROUND_UP(_max_node_len, defaults::SECTOR_LEN);
+    cached_beam_search(query1, k_search, l_search, indices, distances, beam_width,
+                       use_filter ? LabelFilter<LabelT>(filter_label) : LabelFilter<LabelT>(), io_limit,
+                       use_reorder_data, stats);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t k_search, const uint64_t l_search,
+                                                 uint64_t *indices, float *distances, const uint64_t beam_width,
+                                                 const LabelFilter<LabelT> &filter, const bool use_reorder_data,
+                                                 QueryStats *stats)
+{
+    cached_beam_search(query1, k_search, l_search, indices, distances, beam_width, filter,
+                       std::numeric_limits<uint32_t>::max(), use_reorder_data, stats);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t k_search, const uint64_t l_search,
+                                                 uint64_t *indices, float *distances, const uint64_t beam_width,
+                                                 const LabelFilter<LabelT> &filter, const uint32_t io_limit,
+                                                 const bool use_reorder_data, QueryStats *stats)
+{
+    if (!_collect_metrics)
+        return route_search(query1, k_search, l_search, indices, distances, beam_width, filter, io_limit,
+                            use_reorder_data, stats);
+
+    // searches without stats of their own are measured into local ones
+    QueryStats local_stats;
+    QueryStats *query_stats = stats != nullptr ? stats : &local_stats;
+    route_search(query1, k_search, l_search, indices, distances, beam_width, filter, io_limit, use_reorder_data,
+                 query_stats);
+    _metrics.record(*query_stats);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::cached_beam_search_float_query(const float *query, const uint64_t k_search,
+                                                             const uint64_t l_search, uint64_t *indices,
+                                                             float *distances, const uint64_t beam_width,
+                                                             const LabelFilter<LabelT> &filter,
+                                                             const bool use_reorder_data, QueryStats *stats)
+{
+    const uint32_t io_limit = std::numeric_limits<uint32_t>::max();
+    if (!_collect_metrics)
+        return route_search(nullptr, k_search, l_search, indices, distances, beam_width, filter, io_limit,
+                            use_reorder_data, stats, query);
+
+    QueryStats local_stats;
+    QueryStats *query_stats = stats != nullptr ? stats : &local_stats;
+    route_search(nullptr, k_search, l_search, indices, distances, beam_width, filter, io_limit, use_reorder_data,
+                 query_stats, query);
+    _metrics.record(*query_stats);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::route_search(const T *query1, const uint64_t k_search, const uint64_t l_search,
+                                           uint64_t *indices, float *distances, const uint64_t beam_width,
+                                           const LabelFilter<LabelT> &filter, const uint32_t io_limit,
+                                           const bool use_reorder_data, QueryStats *stats, const float *float_query)
+{
+    if (filter.empty() || (_filter_scan_max_points == 0 && _filter_post_min_fraction > 1.0f))
+        return filtered_beam_search(query1, k_search, l_search, indices, distances, beam_width, filter, false,
+                                    io_limit, use_reorder_data, stats, float_query);
+
+    // estimate the points that match: those of the most selective clause, or
+    // all but the excluded ones
+    auto label_count = [this](const LabelT &label) {
+        auto iter = _label_counts.find(label);
+        return iter == _label_counts.end() ? (uint64_t)0 : (uint64_t)iter->second;
+    };
+    const int64_t clause = filter.most_selective_clause(label_count);
+    uint64_t estimate = 0;
+    std::vector<LabelT> scan_labels;
+    if (clause >= 0)
+    {
+        scan_labels = filter.clauses[clause];
+        if (_use_universal_label)
+            scan_labels.push_back(_universal_filter_label);
+        for (const LabelT &label : scan_labels)
+            estimate += label_count(label);
+    }
+    else
+    {
+        estimate = _num_points;
+        for (const LabelT &label : filter.excluded)
+            estimate -= (std::min)(estimate, label_count(label));
+    }
+    estimate = (std::min)(estimate, _num_points);
+
+    if (clause >= 0 && estimate <= _filter_scan_max_points)
+    {
+        bool have_postings = true;
+        for (const LabelT &label : scan_labels)
+            have_postings = have_postings && (label_count(label) == 0 || _label_postings.count(label) > 0);
+        if (have_postings)
+            return scan_filtered_points(query1, k_search, l_search, indices, distances, filter, scan_labels, stats,
+                                        float_query);
+    }
+
+    const float fraction = _num_points == 0 ? 0.0f : (float)estimate / (float)_num_points;
+    if (fraction > 0 && fraction >= _filter_post_min_fraction)
+    {
+        // about l_search of the candidates of the wider search should match
+        const uint64_t post_l_search = (uint64_t)std::ceil((double)l_search / fraction);
+        return filtered_beam_search(query1, k_search, post_l_search, indices, distances, beam_width, filter, true,
+                                    io_limit, use_reorder_data, stats, float_query);
+    }
+    filtered_beam_search(query1, k_search, l_search, indices, distances, beam_width, filter, false, io_limit,
+                         use_reorder_data, stats, float_query);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::filtered_beam_search(const T *query1, const uint64_t k_search, const uint64_t l_search,
+                                                   uint64_t *indices, float *distances, const uint64_t beam_width,
+                                                   const LabelFilter<LabelT> &filter, const bool post_filter,
+                                                   const uint32_t io_limit, const bool use_reorder_data,
+                                                   QueryStats *stats, const float *float_query)
+{
+    const bool use_filter = !filter.empty() && !post_filter;
+    // a point and its dummy points have the labels of all of them, but only
+    // the part that has a single label is searched for it
+    const bool filter_all_parts = post_filter || !filter.is_single_label();
+
+    uint64_t num_sector_per_nodes = DIV_ROUND_UP(_max_node_len, _sector_len);
     if (beam_width > num_sector_per_nodes * defaults::MAX_N_SECTOR_READS)
         throw ANNException("Beamwidth can not be higher than defaults::MAX_N_SECTOR_READS", -1, __FUNCSIG__, __FILE__,
                            __LINE__);
 
-    ScratchStoreManager<SSDThreadData<T>> manager(this->_thread_data);
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
     auto data = manager.scratch_space();
     IOContext &ctx = data->ctx;
     auto query_scratch = &(data->scratch);
@@ -1293,41 +2591,15 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
 
     // copy query to thread specific aligned and allocated memory (for distance
     // calculations we need aligned data)
-    float query_norm = 0;
     T *aligned_query_T = query_scratch->aligned_query_T();
     float *query_float = pq_query_scratch->aligned_query_float;
     float *query_rotated = pq_query_scratch->rotated_query;
-
-    // normalization step. for cosine, we simply normalize the query
-    // for mips, we normalize the first d-1 dims, and add a 0 for last dim, since an extra coordinate was used to
-    // convert MIPS to L2 search
-    if (metric == diskann::Metric::INNER_PRODUCT || metric == diskann::Metric::COSINE)
-    {
-        uint64_t inherent_dim = (metric == diskann::Metric::COSINE) ? this->_data_dim : (uint64_t)(this->_data_dim - 1);
-        for (size_t i = 0; i < inherent_dim; i++)
-        {
-            aligned_query_T[i] = query1[i];
-            query_norm += query1[i] * query1[i];
-        }
-        if (metric == diskann::Metric::INNER_PRODUCT)
-            aligned_query_T[this->_data_dim - 1] = 0;
-
-        query_norm = std::sqrt(query_norm);
-
-        for (size_t i = 0; i < inherent_dim; i++)
-        {
-            aligned_query_T[i] = (T)(aligned_query_T[i] / query_norm);
-        }
-        pq_query_scratch->initialize(this->_data_dim, aligned_query_T);
-    }
+    float query_norm = 0;
+    const float *exact_query = nullptr;
+    if (float_query != nullptr)
+        exact_query = prepare_float_query(float_query, query_scratch, query_norm);
     else
-    {
-        for (size_t i = 0; i < this->_data_dim; i++)
-        {
-            aligned_query_T[i] = query1[i];
-        }
-        pq_query_scratch->initialize(this->_data_dim, aligned_query_T);
-    }
+        query_norm = prepare_query(query1, aligned_query_T, pq_query_scratch);
 
     // pointers to buffers for data
     T *data_buf = query_scratch->coord_scratch;
@@ -1337,51 +2609,69 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
     char *sector_scratch = query_scratch->sector_scratch;
     uint64_t &sector_scratch_idx = query_scratch->sector_idx;
     const uint64_t num_sectors_per_node =
-        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, defaults::SECTOR_LEN);
+        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
 
     // query <-> PQ chunk centers distances
-    _pq_table.preprocess_query(query_rotated); // center the query and rotate if
-                                               // we have a rotation matrix
     float *pq_dists = pq_query_scratch->aligned_pqtable_dist_scratch;
-    _pq_table.populate_chunk_distances(query_rotated, pq_dists);
+    FastScanLUT &fast_scan_lut = pq_query_scratch->fast_scan_lut;
+    if (_quantizer != nullptr)
+    {
+        _quantizer->preprocess_query(aligned_query_T, (uint32_t)_data_dim, *pq_query_scratch);
+    }
+    else
+    {
+        _pq_table.preprocess_query(query_rotated); // center the query and rotate if
+                                                   // we have a rotation matrix
+        populate_pq_dists(query_rotated, pq_dists);
+        if (_use_fast_scan_pq)
+            diskann::quantize_fast_scan_lut(pq_dists, _n_chunks, fast_scan_lut);
+    }
+    populate_disk_pq_dists(query_float, pq_dists);
 
     // query <-> neighbor list
     float *dist_scratch = pq_query_scratch->aligned_dist_scratch;
     uint8_t *pq_coord_scratch = pq_query_scratch->aligned_pq_coord_scratch;
 
     // lambda to batch compute query<-> node distances in PQ space
-    auto compute_dists = [this, pq_coord_scratch, pq_dists](const uint32_t *ids, const uint64_t n_ids,
-                                                            float *dists_out) {
-        diskann::aggregate_coords(ids, n_ids, this->data, this->_n_chunks, pq_coord_scratch);
-        diskann::pq_dist_lookup(pq_coord_scratch, n_ids, this->_n_chunks, pq_dists, dists_out);
+    auto compute_dists = [this, pq_query_scratch, pq_coord_scratch, pq_dists,
+                          &fast_scan_lut](const uint32_t *ids, const uint64_t n_ids, float *dists_out) {
+        if (_quantizer != nullptr)
+            compute_quantized_dists(ids, n_ids, pq_query_scratch, dists_out);
+        else
+            compute_pq_dists(ids, n_ids, pq_dists, fast_scan_lut, pq_coord_scratch, dists_out);
     };
     Timer query_timer, io_timer, cpu_timer;
 
-    tsl::robin_set<uint64_t> &visited = query_scratch->visited;
+    VisitedSet &visited = query_scratch->visited;
+    visited.reserve(_num_points, l_search * _max_degree);
     NeighborPriorityQueue &retset = query_scratch->retset;
     retset.reserve(l_search);
     std::vector<Neighbor> &full_retset = query_scratch->full_retset;
 
-    uint32_t best_medoid = 0;
-    float best_dist = (std::numeric_limits<float>::max)();
-    if (!use_filter)
+    uint32_t start_points[defaults::ENTRY_LAYER_NUM_SEEDS];
+    uint32_t num_start_points = 1;
+    const int64_t entry_clause = !use_filter ? -1 : filter.most_selective_clause([this](const LabelT &label) {
+        auto iter = _label_counts.find(label);
+        return iter == _label_counts.end() ? (uint64_t)0 : (uint64_t)iter->second;
+    });
+    if (entry_clause < 0)
     {
-        for (uint64_t cur_m = 0; cur_m < _num_medoids; cur_m++)
-        {
-            float cur_expanded_dist =
-                _dist_cmp_float->compare(query_float, _centroid_data + _aligned_dim * cur_m, (uint32_t)_aligned_dim);
-            if (cur_expanded_dist < best_dist)
-            {
-                best_medoid = _medoids[cur_m];
-                best_dist = cur_expanded_dist;
-            }
-        }
+        // no filter, or only excluded labels
+        num_start_points = get_start_points(query_float, start_points);
     }
     else
     {
-        if (_filter_to_medoid_ids.find(filter_label) != _filter_to_medoid_ids.end())
+        // start from the closest medoid of each label of the most selective
+        // clause, up to defaults::ENTRY_LAYER_NUM_SEEDS of them
+        std::vector<Neighbor> seeds;
+        for (const LabelT &label : filter.clauses[entry_clause])
         {
-            const auto &medoid_ids = _filter_to_medoid_ids[filter_label];
+            auto medoids_iter = _filter_to_medoid_ids.find(label);
+            if (medoids_iter == _filter_to_medoid_ids.end())
+                continue;
+            uint32_t best_medoid = 0;
+            float best_dist = (std::numeric_limits<float>::max)();
+            const auto &medoid_ids = medoids_iter->second;
             for (uint64_t cur_m = 0; cur_m < medoid_ids.size(); cur_m++)
             {
                 // for filtered index, we dont store global centroid data as for unfiltered index, so we use PQ distance
@@ -1394,20 +2684,56 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                     best_dist = cur_expanded_dist;
                 }
             }
+            if (!medoid_ids.empty() &&
+                std::find_if(seeds.begin(), seeds.end(), [&](const Neighbor &n) { return n.id == best_medoid; }) ==
+                    seeds.end())
+                seeds.emplace_back(best_medoid, best_dist);
         }
-        else
+        if (seeds.empty())
         {
             throw ANNException("Cannot find medoid for specified filter.", -1, __FUNCSIG__, __FILE__, __LINE__);
         }
+        std::sort(seeds.begin(), seeds.end());
+        num_start_points = (uint32_t)(std::min)(seeds.size(), (size_t)defaults::ENTRY_LAYER_NUM_SEEDS);
+        for (uint32_t i = 0; i < num_start_points; i++)
+            start_points[i] = seeds[i].id;
     }
 
-    compute_dists(&best_medoid, 1, dist_scratch);
-    retset.insert(Neighbor(best_medoid, dist_scratch[0]));
-    visited.insert(best_medoid);
+    compute_dists(start_points, num_start_points, dist_scratch);
+    for (uint32_t i = 0; i < num_start_points; i++)
+    {
+        retset.insert(Neighbor(start_points[i], dist_scratch[i]));
+        visited.insert(start_points[i]);
+    }
 
     uint32_t cmps = 0;
     uint32_t hops = 0;
     uint32_t num_ios = 0;
+    DISKANN_TRACE(QUERY_BEGIN, l_search, beam_width);
+
+    // In a filtered search, the unvisited neighbors of an expanded node are
+    // checked against the filter before any PQ distance is computed, so that
+    // only those that match are scored. Returns how many were scored.
+    uint32_t *filtered_nbrs = query_scratch->filtered_nbr_scratch;
+    auto score_matching_nbrs = [&](const uint32_t *node_nbrs, uint64_t nnbrs) {
+        uint64_t n_unvisited = 0;
+        for (uint64_t m = 0; m < nnbrs; ++m)
+        {
+            if (visited.insert(node_nbrs[m]))
+                filtered_nbrs[n_unvisited++] = node_nbrs[m];
+        }
+        const uint64_t n_matching = select_matching(filtered_nbrs, n_unvisited, filter, filter_all_parts);
+        compute_dists(filtered_nbrs, n_matching, dist_scratch);
+        for (uint64_t m = 0; m < n_matching; ++m)
+        {
+            cmps++;
+            retset.insert(Neighbor(filtered_nbrs[m], dist_scratch[m]));
+        }
+        return n_matching;
+    };
+
+    const bool trace_access = _access_trace != nullptr;
+    std::vector<uint32_t> expanded;
 
     // cleared every iteration
     std::vector<uint32_t> frontier;
@@ -1418,6 +2744,95 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
     frontier_read_reqs.reserve(2 * beam_width);
     std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t *>>> cached_nhoods;
     cached_nhoods.reserve(2 * beam_width);
+    // nodes whose sectors are already in memory, either in the sector cache or
+    // copied into sector scratch by the dynamic cache
+    std::vector<std::pair<uint32_t, char *>> sector_cached_nhoods;
+    sector_cached_nhoods.reserve(2 * beam_width);
+    DynamicSectorCache *dyn_cache = _dynamic_cache.get();
+
+    const bool score_colocated = _score_colocated_nodes && _nnodes_per_sector > 1;
+
+    // adaptive search state; cur_beam_width only moves when
+    // _adaptive_max_beam_width is set
+    const bool track_topk = _adaptive_max_beam_width > 0 || _early_stop_hops > 0;
+    uint64_t cur_beam_width = beam_width;
+    uint32_t stale_hops = 0;
+    std::vector<uint32_t> prev_topk;
+    if (track_topk)
+        prev_topk.reserve(k_search);
+
+#ifndef USE_BING_INFRA
+    const bool pipelined = _use_pipelined_search && reader->supports_async_reads();
+    std::vector<uint64_t> completed_reads;
+    completed_reads.reserve(2 * beam_width);
+#endif
+
+    char *mapped_index = reader->mapped_data();
+
+    // speculative reads of a hop land in one half of the speculative scratch
+    // (spec_cur), where the next hop looks for its nodes before reading them
+    const uint32_t no_spec = std::numeric_limits<uint32_t>::max();
+    const uint64_t spec_slots = _speculative_width > 0 && mapped_index == nullptr
+                                    ? defaults::MAX_SPECULATIVE_SECTORS / 2 / num_sectors_per_node
+                                    : 0;
+    std::vector<uint32_t> spec_ids(2 * spec_slots, no_spec);
+    uint64_t spec_cur = 0;
+    uint32_t spec_wasted = 0;
+    // the sector of a node read speculatively by the previous hop, or nullptr
+    auto find_speculative = [&](uint32_t id) -> char * {
+        const uint64_t prev = (spec_cur ^ 1) * spec_slots;
+        for (uint64_t s = prev; s < prev + spec_slots; s++)
+        {
+            if (spec_ids[s] == id)
+            {
+                spec_ids[s] = no_spec;
+                return query_scratch->speculative_scratch + s * num_sectors_per_node * _sector_len;
+            }
+        }
+        return nullptr;
+    };
+
+    // appends the reads of the sorted, distinct sectors, sectors[j] into
+    // buf + j * SECTOR_LEN, with one read per run of consecutive sectors
+    auto add_sector_reads = [&](const std::vector<uint64_t> &sectors, char *buf, std::vector<AlignedRead> &reqs) {
+        for (size_t j = 0; j < sectors.size();)
+        {
+            size_t run = 1;
+            while (j + run < sectors.size() && sectors[j + run] == sectors[j] + run)
+                run++;
+            reqs.emplace_back(sectors[j] * _sector_len, run * _sector_len,
+                              buf + j * _sector_len);
+            DISKANN_TRACE(READ, sectors[j], run * _sector_len);
+            if (stats != nullptr)
+            {
+                stats->n_4k++;
+                stats->n_ios++;
+                stats->read_size += (uint32_t)(run * _sector_len);
+            }
+            j += run;
+        }
+    };
+
+    // the reorder data is read through its own reader when it has a file of
+    // its own
+    AlignedFileReader *vectors_reader = _vectors_reader != nullptr ? _vectors_reader.get() : reader.get();
+    IOContext &vectors_ctx = _vectors_reader != nullptr ? data->vectors_ctx : ctx;
+    char *mapped_vectors = _vectors_reader != nullptr ? vectors_reader->mapped_data() : mapped_index;
+
+    // the last hop also reads the vectors to rerank into the reorder scratch,
+    // so that they need no round trip of their own after the search. Reads
+    // of a separate file are submitted alongside and reaped at the end.
+#ifdef USE_BING_INFRA
+    const bool reorder_prefetch = false;
+#else
+    const bool reorder_prefetch = use_reorder_data && _reorder_data_exists && mapped_vectors == nullptr &&
+                                  _reorder_buffer.ptr == nullptr &&
+                                  (_vectors_reader == nullptr || vectors_reader->supports_async_reads());
+#endif
+    tsl::robin_map<uint64_t, char *> reorder_sectors; // sector -> its copy in the reorder scratch
+    std::vector<uint64_t> prefetch_sectors;
+    std::vector<AlignedRead> prefetch_reqs;
+    uint64_t n_prefetch_in_flight = 0;
 
     while (retset.has_unexpanded_node() && num_ios < io_limit)
     {
@@ -1426,21 +2841,43 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
         frontier_nhoods.clear();
         frontier_read_reqs.clear();
         cached_nhoods.clear();
+        sector_cached_nhoods.clear();
         sector_scratch_idx = 0;
         // find new beam
         uint32_t num_seen = 0;
-        while (retset.has_unexpanded_node() && frontier.size() < beam_width && num_seen < beam_width)
+        while (retset.has_unexpanded_node() && frontier.size() < cur_beam_width && num_seen < cur_beam_width)
         {
             auto nbr = retset.closest_unexpanded();
             num_seen++;
-            auto iter = _nhood_cache.find(nbr.id);
-            if (iter != _nhood_cache.end())
+            if (trace_access)
+                expanded.push_back(nbr.id);
+            auto *cached_nhood = find_cached_nhood(nbr.id);
+            char *cached_sector = find_cached_sector(nbr.id);
+            char *spec_sector =
+                cached_nhood == nullptr && cached_sector == nullptr ? find_speculative(nbr.id) : nullptr;
+            if (cached_nhood != nullptr)
+            {
+                cached_nhoods.push_back(std::make_pair(nbr.id, *cached_nhood));
+                if (stats != nullptr)
+                {
+                    stats->n_cache_hits++;
+                }
+                DISKANN_TRACE(CACHE_HIT, nbr.id, 0);
+            }
+            else if (cached_sector != nullptr)
             {
-                cached_nhoods.push_back(std::make_pair(nbr.id, iter->second));
+                sector_cached_nhoods.push_back(std::make_pair(nbr.id, cached_sector));
                 if (stats != nullptr)
                 {
                     stats->n_cache_hits++;
                 }
+                DISKANN_TRACE(CACHE_HIT, nbr.id, 0);
+            }
+            else if (spec_sector != nullptr)
+            {
+                sector_cached_nhoods.push_back(std::make_pair(nbr.id, spec_sector));
+                if (stats != nullptr)
+                    stats->n_spec_hits++;
             }
             else
             {
@@ -1452,6 +2889,8 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
             }
         }
 
+        DISKANN_TRACE(HOP_BEGIN, hops, frontier.size() + cached_nhoods.size() + sector_cached_nhoods.size());
+
         // read nhoods of frontier ids
         if (!frontier.empty())
         {
@@ -1462,24 +2901,128 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                 auto id = frontier[i];
                 std::pair<uint32_t, char *> fnhood;
                 fnhood.first = id;
-                fnhood.second = sector_scratch + num_sectors_per_node * sector_scratch_idx * defaults::SECTOR_LEN;
+                if (mapped_index != nullptr)
+                {
+                    // a mapped index is expanded in place, with no read and no copy
+                    fnhood.second = mapped_index + get_node_sector((size_t)id) * _sector_len;
+                    sector_cached_nhoods.push_back(fnhood);
+                    DISKANN_TRACE(READ, get_node_sector((size_t)id), num_sectors_per_node * _sector_len);
+                    if (stats != nullptr)
+                    {
+                        stats->n_4k++;
+                        stats->n_ios++;
+                        stats->read_size += (uint32_t)(num_sectors_per_node * _sector_len);
+                    }
+                    num_ios++;
+                    continue;
+                }
+                fnhood.second = sector_scratch + num_sectors_per_node * sector_scratch_idx * _sector_len;
                 sector_scratch_idx++;
+                if (dyn_cache != nullptr && dyn_cache->lookup(get_node_sector((size_t)id), fnhood.second))
+                {
+                    sector_cached_nhoods.push_back(fnhood);
+                    if (stats != nullptr)
+                        stats->n_cache_hits++;
+                    DISKANN_TRACE(CACHE_HIT, id, 0);
+                    continue;
+                }
                 frontier_nhoods.push_back(fnhood);
-                frontier_read_reqs.emplace_back(get_node_sector((size_t)id) * defaults::SECTOR_LEN,
-                                                num_sectors_per_node * defaults::SECTOR_LEN, fnhood.second);
+                frontier_read_reqs.emplace_back(get_node_sector((size_t)id) * _sector_len,
+                                                num_sectors_per_node * _sector_len, fnhood.second);
+                DISKANN_TRACE(READ, get_node_sector((size_t)id), num_sectors_per_node * _sector_len);
                 if (stats != nullptr)
                 {
                     stats->n_4k++;
                     stats->n_ios++;
+                    stats->read_size += (uint32_t)(num_sectors_per_node * _sector_len);
                 }
                 num_ios++;
             }
+        }
+        if (spec_slots > 0 && (_max_wasted_speculative_reads == 0 || spec_wasted < _max_wasted_speculative_reads))
+        {
+            // read ahead the closest candidates the beam left out. Those the
+            // previous hop read already are carried over instead.
+            const uint64_t cur = spec_cur * spec_slots;
+            const uint64_t spec_width = (std::min)((uint64_t)_speculative_width, spec_slots);
+            uint64_t n_spec = 0;
+            for (size_t i = 0; i < retset.size() && n_spec < spec_width && num_ios < io_limit; i++)
+            {
+                const Neighbor nbr = retset[i];
+                if (nbr.expanded || find_cached_nhood(nbr.id) != nullptr || find_cached_sector(nbr.id) != nullptr)
+                    continue;
+                char *spec_buf =
+                    query_scratch->speculative_scratch + (cur + n_spec) * num_sectors_per_node * _sector_len;
+                char *prev_sector = find_speculative(nbr.id);
+                if (prev_sector != nullptr)
+                {
+                    memcpy(spec_buf, prev_sector, num_sectors_per_node * _sector_len);
+                }
+                else
+                {
+                    frontier_read_reqs.emplace_back(get_node_sector((size_t)nbr.id) * _sector_len,
+                                                    num_sectors_per_node * _sector_len, spec_buf);
+                    DISKANN_TRACE(READ, get_node_sector((size_t)nbr.id), num_sectors_per_node * _sector_len);
+                    if (stats != nullptr)
+                    {
+                        stats->n_spec_reads++;
+                        stats->n_4k++;
+                        stats->n_ios++;
+                        stats->read_size += (uint32_t)(num_sectors_per_node * _sector_len);
+                    }
+                    num_ios++;
+                }
+                spec_ids[cur + n_spec] = nbr.id;
+                n_spec++;
+            }
+        }
+        if (reorder_prefetch && (!retset.has_unexpanded_node() || num_ios >= io_limit) &&
+            reorder_sectors.size() < defaults::MAX_REORDER_PREFETCH_SECTORS)
+        {
+            // unless this hop adds closer candidates it is the last one, and
+            // the best of the expanded nodes are those the rerank will read
+            prefetch_sectors.clear();
+            const size_t n_best = (std::min)(retset.size(), (size_t)(k_search * FULL_PRECISION_REORDER_MULTIPLIER));
+            for (size_t i = 0; i < n_best; i++)
+            {
+                const uint64_t sector = VECTOR_SECTOR_NO((size_t)retset[i].id);
+                if (reorder_sectors.find(sector) == reorder_sectors.end())
+                    prefetch_sectors.push_back(sector);
+            }
+            std::sort(prefetch_sectors.begin(), prefetch_sectors.end());
+            prefetch_sectors.erase(std::unique(prefetch_sectors.begin(), prefetch_sectors.end()),
+                                   prefetch_sectors.end());
+            prefetch_sectors.resize(
+                (std::min)(prefetch_sectors.size(), defaults::MAX_REORDER_PREFETCH_SECTORS - reorder_sectors.size()));
+
+            char *buf = query_scratch->reorder_scratch + reorder_sectors.size() * _sector_len;
+            if (_vectors_reader == nullptr)
+            {
+                add_sector_reads(prefetch_sectors, buf, frontier_read_reqs);
+            }
+#ifndef USE_BING_INFRA
+            else if (!prefetch_sectors.empty())
+            {
+                prefetch_reqs.clear();
+                add_sector_reads(prefetch_sectors, buf, prefetch_reqs);
+                vectors_reader->submit_reads(prefetch_reqs, vectors_ctx);
+                n_prefetch_in_flight += prefetch_reqs.size();
+            }
+#endif
+            for (size_t j = 0; j < prefetch_sectors.size(); j++)
+                reorder_sectors[prefetch_sectors[j]] = buf + j * _sector_len;
+        }
+        if (!frontier_read_reqs.empty())
+        {
             io_timer.reset();
 #ifdef USE_BING_INFRA
             reader->read(frontier_read_reqs, ctx,
                          true); // asynhronous reader for Bing.
 #else
-            reader->read(frontier_read_reqs, ctx); // synchronous IO linux
+            if (pipelined)
+                reader->submit_reads(frontier_read_reqs, ctx); // returns immediately, reaped below
+            else
+                reader->read(frontier_read_reqs, ctx); // synchronous IO linux
 #endif
             if (stats != nullptr)
             {
@@ -1493,29 +3036,42 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
             auto global_cache_iter = _coord_cache.find(cached_nhood.first);
             T *node_fp_coords_copy = global_cache_iter->second;
             float cur_expanded_dist;
+            cpu_timer.reset();
             if (!_use_disk_index_pq)
             {
-                cur_expanded_dist = _dist_cmp->compare(aligned_query_T, node_fp_coords_copy, (uint32_t)_aligned_dim);
+                cur_expanded_dist = compare_query(exact_query, aligned_query_T, node_fp_coords_copy);
             }
             else
             {
-                if (metric == diskann::Metric::INNER_PRODUCT)
-                    cur_expanded_dist = _disk_pq_table.inner_product(query_float, (uint8_t *)node_fp_coords_copy);
-                else
-                    cur_expanded_dist = _disk_pq_table.l2_distance( // disk_pq does not support OPQ yet
-                        query_float, (uint8_t *)node_fp_coords_copy);
+                cur_expanded_dist = disk_pq_distance(pq_dists, node_fp_coords_copy);
             }
-            full_retset.push_back(Neighbor((uint32_t)cached_nhood.first, cur_expanded_dist));
+            if (stats != nullptr)
+                stats->fp_us += cpu_timer.elapsed_us_fractional();
+            if (!node_deleted((uint32_t)cached_nhood.first))
+                full_retset.push_back(Neighbor((uint32_t)cached_nhood.first, cur_expanded_dist));
 
             uint64_t nnbrs = cached_nhood.second.first;
             uint32_t *node_nbrs = cached_nhood.second.second;
+            DISKANN_TRACE(EXPAND, cached_nhood.first, nnbrs);
 
             // compute node_nbrs <-> query dists in PQ space
             cpu_timer.reset();
+            if (use_filter)
+            {
+                const uint64_t n_scored = score_matching_nbrs(node_nbrs, nnbrs);
+                if (stats != nullptr)
+                {
+                    stats->n_cmps += (uint32_t)n_scored;
+                    stats->pq_us += cpu_timer.elapsed_us_fractional();
+                    stats->cpu_us += (float)cpu_timer.elapsed();
+                }
+                continue;
+            }
             compute_dists(node_nbrs, nnbrs, dist_scratch);
             if (stats != nullptr)
             {
                 stats->n_cmps += (uint32_t)nnbrs;
+                stats->pq_us += cpu_timer.elapsed_us_fractional();
                 stats->cpu_us += (float)cpu_timer.elapsed();
             }
 
@@ -1523,13 +3079,9 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
             for (uint64_t m = 0; m < nnbrs; ++m)
             {
                 uint32_t id = node_nbrs[m];
-                if (visited.insert(id).second)
+                if (visited.insert(id))
                 {
-                    if (!use_filter && _dummy_pts.find(id) != _dummy_pts.end())
-                        continue;
-
-                    if (use_filter && !(point_has_label(id, filter_label)) &&
-                        (!_use_universal_label || !point_has_label(id, _universal_filter_label)))
+                    if (_dummy_pts.find(id) != _dummy_pts.end())
                         continue;
                     cmps++;
                     float dist = dist_scratch[m];
@@ -1538,61 +3090,67 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
                 }
             }
         }
-#ifdef USE_BING_INFRA
+
         // process each frontier nhood - compute distances to unvisited nodes
-        int completedIndex = -1;
-        long requestCount = static_cast<long>(frontier_read_reqs.size());
-        // If we issued read requests and if a read is complete or there are
-        // reads in wait state, then enter the while loop.
-        while (requestCount > 0 && getNextCompletedRequest(reader, ctx, requestCount, completedIndex))
-        {
-            assert(completedIndex >= 0);
-            auto &frontier_nhood = frontier_nhoods[completedIndex];
-            (*ctx.m_pRequestsStatus)[completedIndex] = IOContext::PROCESS_COMPLETE;
-#else
-        for (auto &frontier_nhood : frontier_nhoods)
-        {
-#endif
+        auto process_frontier_nhood = [&](std::pair<uint32_t, char *> &frontier_nhood) {
             char *node_disk_buf = offset_to_node(frontier_nhood.second, frontier_nhood.first);
             uint32_t *node_buf = offset_to_node_nhood(node_disk_buf);
             uint64_t nnbrs = (uint64_t)(*node_buf);
             T *node_fp_coords = offset_to_node_coords(node_disk_buf);
             memcpy(data_buf, node_fp_coords, _disk_bytes_per_point);
             float cur_expanded_dist;
+            cpu_timer.reset();
             if (!_use_disk_index_pq)
             {
-                cur_expanded_dist = _dist_cmp->compare(aligned_query_T, data_buf, (uint32_t)_aligned_dim);
+                cur_expanded_dist = compare_query(exact_query, aligned_query_T, data_buf);
             }
             else
             {
-                if (metric == diskann::Metric::INNER_PRODUCT)
-                    cur_expanded_dist = _disk_pq_table.inner_product(query_float, (uint8_t *)data_buf);
-                else
-                    cur_expanded_dist = _disk_pq_table.l2_distance(query_float, (uint8_t *)data_buf);
+                cur_expanded_dist = disk_pq_distance(pq_dists, data_buf);
             }
-            full_retset.push_back(Neighbor(frontier_nhood.first, cur_expanded_dist));
-            uint32_t *node_nbrs = (node_buf + 1);
-            // compute node_nbrs <-> query dist in PQ space
+            if (stats != nullptr)
+                stats->fp_us += cpu_timer.elapsed_us_fractional();
+            if (!node_deleted(frontier_nhood.first))
+                full_retset.push_back(Neighbor(frontier_nhood.first, cur_expanded_dist));
+            DISKANN_TRACE(EXPAND, frontier_nhood.first, nnbrs);
+            uint32_t *node_nbrs = node_nbr_ids(node_buf, query_scratch->nbr_scratch);
+            // compute node_nbrs <-> query dist in PQ space. Inline codes are
+            // looked up for all the neighbors, as that costs less than
+            // gathering the codes of those that match a filter.
             cpu_timer.reset();
-            compute_dists(node_nbrs, nnbrs, dist_scratch);
+            const bool filter_first = use_filter && _inline_pq_chunks == 0;
+            uint64_t n_scored = nnbrs;
+            if (filter_first)
+            {
+                n_scored = score_matching_nbrs(node_nbrs, nnbrs);
+            }
+            else if (_inline_pq_chunks > 0)
+            {
+                // from the codes that follow the neighbor ids in the node
+                diskann::pq_dist_lookup(node_nbr_codes(node_buf), nnbrs, _n_chunks, pq_dists, dist_scratch);
+            }
+            else
+            {
+                compute_dists(node_nbrs, nnbrs, dist_scratch);
+            }
             if (stats != nullptr)
             {
-                stats->n_cmps += (uint32_t)nnbrs;
+                stats->n_cmps += (uint32_t)n_scored;
+                stats->pq_us += cpu_timer.elapsed_us_fractional();
                 stats->cpu_us += (float)cpu_timer.elapsed();
             }
 
             cpu_timer.reset();
             // process prefetch-ed nhood
-            for (uint64_t m = 0; m < nnbrs; ++m)
+            for (uint64_t m = 0; !filter_first && m < nnbrs; ++m)
             {
                 uint32_t id = node_nbrs[m];
-                if (visited.insert(id).second)
+                if (visited.insert(id))
                 {
                     if (!use_filter && _dummy_pts.find(id) != _dummy_pts.end())
                         continue;
 
-                    if (use_filter && !(point_has_label(id, filter_label)) &&
-                        (!_use_universal_label || !point_has_label(id, _universal_filter_label)))
+                    if (use_filter && !point_matches_filter(id, filter, filter_all_parts))
                         continue;
                     cmps++;
                     float dist = dist_scratch[m];
@@ -1610,141 +3168,1811 @@ void PQFlashIndex<T, LabelT>::cached_beam_search(const T *query1, const uint64_t
             {
                 stats->cpu_us += (float)cpu_timer.elapsed();
             }
-        }
-
-        hops++;
-    }
 
-    // re-sort by distance
-    std::sort(full_retset.begin(), full_retset.end());
+            if (score_colocated)
+            {
+                // the other nodes in this sector come for free; score them at
+                // full precision and let the good ones compete in retset
+                uint64_t first_id = (get_node_sector(frontier_nhood.first) - 1) * _nnodes_per_sector;
+                for (uint64_t other = first_id; other < first_id + _nnodes_per_sector && other < _num_points;
+                     other++)
+                {
+                    if (other == frontier_nhood.first || !visited.insert(other))
+                        continue;
+                    if (!use_filter && _dummy_pts.find((uint32_t)other) != _dummy_pts.end())
+                        continue;
+                    if (use_filter && !point_matches_filter((uint32_t)other, filter, filter_all_parts))
+                        continue;
+                    char *other_disk_buf = offset_to_node(frontier_nhood.second, other);
+                    memcpy(data_buf, offset_to_node_coords(other_disk_buf), _disk_bytes_per_point);
+                    float other_dist;
+                    if (!_use_disk_index_pq)
+                        other_dist = compare_query(exact_query, aligned_query_T, data_buf);
+                    else
+                        other_dist = disk_pq_distance(pq_dists, data_buf);
+                    if (!node_deleted((uint32_t)other))
+                        full_retset.push_back(Neighbor((uint32_t)other, other_dist));
+                    retset.insert(Neighbor((uint32_t)other, other_dist));
+                    if (stats != nullptr)
+                        stats->n_cmps++;
+                }
+            }
+        };
 
-    if (use_reorder_data)
-    {
-        if (!(this->_reorder_data_exists))
+        for (auto &sector_cached_nhood : sector_cached_nhoods)
         {
-            throw ANNException("Requested use of reordering data which does "
-                               "not exist in index "
-                               "file",
-                               -1, __FUNCSIG__, __FILE__, __LINE__);
+            process_frontier_nhood(sector_cached_nhood);
         }
 
-        std::vector<AlignedRead> vec_read_reqs;
-
-        if (full_retset.size() > k_search * FULL_PRECISION_REORDER_MULTIPLIER)
-            full_retset.erase(full_retset.begin() + k_search * FULL_PRECISION_REORDER_MULTIPLIER, full_retset.end());
-
-        for (size_t i = 0; i < full_retset.size(); ++i)
+#ifdef USE_BING_INFRA
+        int completedIndex = -1;
+        long requestCount = static_cast<long>(frontier_read_reqs.size());
+        // If we issued read requests and if a read is complete or there are
+        // reads in wait state, then enter the while loop.
+        while (requestCount > 0 && getNextCompletedRequest(reader, ctx, requestCount, completedIndex))
         {
-            // MULTISECTORFIX
-            vec_read_reqs.emplace_back(VECTOR_SECTOR_NO(((size_t)full_retset[i].id)) * defaults::SECTOR_LEN,
-                                       defaults::SECTOR_LEN, sector_scratch + i * defaults::SECTOR_LEN);
-
-            if (stats != nullptr)
+            assert(completedIndex >= 0);
+            auto &frontier_nhood = frontier_nhoods[completedIndex];
+            (*ctx.m_pRequestsStatus)[completedIndex] = IOContext::PROCESS_COMPLETE;
+            process_frontier_nhood(frontier_nhood);
+        }
+#else
+        if (pipelined)
+        {
+            // expand sectors in completion order; the cached nhoods above were
+            // scored while these reads were in flight
+            uint64_t n_reaped = 0;
+            while (n_reaped < frontier_read_reqs.size())
             {
-                stats->n_4k++;
-                stats->n_ios++;
+                completed_reads.clear();
+                io_timer.reset();
+                reader->reap_reads(ctx, 1, frontier_read_reqs.size() - n_reaped, completed_reads);
+                if (stats != nullptr)
+                {
+                    stats->io_us += (float)io_timer.elapsed();
+                }
+                for (auto idx : completed_reads)
+                {
+                    // speculative and reorder reads follow those of the beam
+                    if (idx < frontier_nhoods.size())
+                        process_frontier_nhood(frontier_nhoods[idx]);
+                }
+                n_reaped += completed_reads.size();
+            }
+        }
+        else
+        {
+            for (auto &frontier_nhood : frontier_nhoods)
+            {
+                process_frontier_nhood(frontier_nhood);
             }
         }
-
-        io_timer.reset();
-#ifdef USE_BING_INFRA
-        reader->read(vec_read_reqs, ctx, true); // async reader windows.
-#else
-        reader->read(vec_read_reqs, ctx); // synchronous IO linux
 #endif
-        if (stats != nullptr)
+
+        if (dyn_cache != nullptr)
         {
-            stats->io_us += io_timer.elapsed();
+            for (auto &frontier_nhood : frontier_nhoods)
+                dyn_cache->admit(get_node_sector((size_t)frontier_nhood.first), frontier_nhood.second);
         }
 
-        for (size_t i = 0; i < full_retset.size(); ++i)
+        if (spec_slots > 0)
         {
+            // what the previous hop read ahead and this one did not use is wasted
+            const uint64_t prev = (spec_cur ^ 1) * spec_slots;
+            for (uint64_t s = prev; s < prev + spec_slots; s++)
+            {
+                if (spec_ids[s] != no_spec)
+                    spec_wasted++;
+                spec_ids[s] = no_spec;
+            }
+            spec_cur ^= 1;
+        }
+
+        DISKANN_TRACE(HOP_END, hops, frontier_read_reqs.size());
+        hops++;
+
+        if (track_topk)
+        {
+            // count how many of the PQ top-k this hop replaced
+            uint64_t topk = (std::min)((uint64_t)retset.size(), k_search);
+            uint64_t n_changed = 0;
+            for (uint64_t i = 0; i < topk; i++)
+            {
+                if (i >= prev_topk.size() || prev_topk[i] != retset[i].id)
+                    n_changed++;
+            }
+            prev_topk.resize(topk);
+            for (uint64_t i = 0; i < topk; i++)
+                prev_topk[i] = retset[i].id;
+
+            if (n_changed == 0)
+            {
+                stale_hops++;
+                if (_adaptive_max_beam_width > 0)
+                    cur_beam_width = (std::min)(2 * cur_beam_width, (uint64_t)_adaptive_max_beam_width);
+                if (_early_stop_hops > 0 && stale_hops >= _early_stop_hops)
+                    break;
+            }
+            else
+            {
+                stale_hops = 0;
+                if (_adaptive_max_beam_width > 0 && 2 * n_changed > topk && cur_beam_width > 1)
+                    cur_beam_width--;
+            }
+        }
+    }
+
+    // re-sort by distance
+    std::sort(full_retset.begin(), full_retset.end());
+
+    if (score_colocated)
+    {
+        // a co-located node can be expanded later and scored a second time
+        tsl::robin_set<uint32_t> seen;
+        auto last = std::remove_if(full_retset.begin(), full_retset.end(),
+                                   [&seen](const Neighbor &n) { return !seen.insert(n.id).second; });
+        full_retset.erase(last, full_retset.end());
+    }
+
+    if (!filter.empty())
+    {
+        // the start points need not match all of the filter, and a point and
+        // its dummy points can all match it
+        tsl::robin_set<uint32_t> seen_real;
+        auto last = std::remove_if(full_retset.begin(), full_retset.end(), [&](const Neighbor &n) {
+            if (!point_matches_filter(n.id, filter, filter_all_parts))
+                return true;
+            if (_dummy_pts.empty())
+                return false;
+            auto dummy_iter = _dummy_to_real_map.find(n.id);
+            return !seen_real.insert(dummy_iter == _dummy_to_real_map.end() ? n.id : dummy_iter->second).second;
+        });
+        full_retset.erase(last, full_retset.end());
+    }
+
+    if (use_reorder_data)
+    {
+        if (!(this->_reorder_data_exists))
+        {
+            throw ANNException("Requested use of reordering data which does "
+                               "not exist in index "
+                               "file",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+
+        if (full_retset.size() > k_search * FULL_PRECISION_REORDER_MULTIPLIER)
+            full_retset.erase(full_retset.begin() + k_search * FULL_PRECISION_REORDER_MULTIPLIER, full_retset.end());
+        if (_quantizer != nullptr)
+            drop_outranked_candidates(full_retset, k_search, pq_query_scratch);
+
+        auto rerank = [&](size_t i, const char *sector_buf) {
             auto id = full_retset[i].id;
             // MULTISECTORFIX
-            auto location = (sector_scratch + i * defaults::SECTOR_LEN) + VECTOR_SECTOR_OFFSET(id);
-            full_retset[i].distance = _dist_cmp->compare(aligned_query_T, (T *)location, (uint32_t)this->_data_dim);
+            auto location = sector_buf + VECTOR_SECTOR_OFFSET(id);
+            full_retset[i].distance =
+                exact_query != nullptr ? _mixed_dist_cmp(exact_query, (T *)location, (uint32_t)this->_data_dim)
+                                       : _dist_cmp->compare(aligned_query_T, (T *)location, (uint32_t)this->_data_dim);
+        };
+
+        // vectors that share a sector are read together, and those the last
+        // hop read are not read again
+        std::vector<std::pair<uint64_t, uint32_t>> pending; // (sector, index in full_retset)
+#ifndef USE_BING_INFRA
+        if (n_prefetch_in_flight > 0)
+        {
+            std::vector<uint64_t> completed;
+            io_timer.reset();
+            while (n_prefetch_in_flight > 0)
+            {
+                completed.clear();
+                vectors_reader->reap_reads(vectors_ctx, n_prefetch_in_flight, n_prefetch_in_flight, completed);
+                n_prefetch_in_flight -= completed.size();
+            }
+            if (stats != nullptr)
+                stats->io_us += io_timer.elapsed();
+        }
+#endif
+        cpu_timer.reset();
+        for (size_t i = 0; i < full_retset.size(); ++i)
+        {
+            const uint64_t sector = VECTOR_SECTOR_NO((size_t)full_retset[i].id);
+            auto iter = reorder_sectors.find(sector);
+            if (_reorder_buffer.ptr != nullptr)
+                rerank(i, (char *)_reorder_buffer.ptr + (sector - _reorder_first_sector) * _sector_len);
+            else if (mapped_vectors != nullptr)
+                rerank(i, mapped_vectors + sector * _sector_len);
+            else if (iter != reorder_sectors.end())
+                rerank(i, iter->second);
+            else
+                pending.emplace_back(sector, (uint32_t)i);
+        }
+        if (stats != nullptr)
+            stats->fp_us += cpu_timer.elapsed_us_fractional();
+        std::sort(pending.begin(), pending.end());
+
+        std::vector<uint64_t> sectors;
+        std::vector<AlignedRead> vec_read_reqs;
+        for (size_t start = 0; start < pending.size();)
+        {
+            // at most MAX_N_SECTOR_READS distinct sectors fit in sector scratch
+            sectors.clear();
+            size_t end = start;
+            for (; end < pending.size(); end++)
+            {
+                if (sectors.empty() || sectors.back() != pending[end].first)
+                {
+                    if (sectors.size() == defaults::MAX_N_SECTOR_READS)
+                        break;
+                    sectors.push_back(pending[end].first);
+                }
+            }
+
+            vec_read_reqs.clear();
+            add_sector_reads(sectors, sector_scratch, vec_read_reqs);
+            io_timer.reset();
+#ifdef USE_BING_INFRA
+            vectors_reader->read(vec_read_reqs, vectors_ctx, true); // async reader windows.
+#else
+            vectors_reader->read(vec_read_reqs, vectors_ctx); // synchronous IO linux
+#endif
+            if (stats != nullptr)
+            {
+                stats->io_us += io_timer.elapsed();
+            }
+
+            cpu_timer.reset();
+            size_t slot = 0;
+            for (size_t j = start; j < end; j++)
+            {
+                if (pending[j].first != sectors[slot])
+                    slot++;
+                rerank(pending[j].second, sector_scratch + slot * _sector_len);
+            }
+            if (stats != nullptr)
+                stats->fp_us += cpu_timer.elapsed_us_fractional();
+            start = end;
+        }
+
+        std::sort(full_retset.begin(), full_retset.end());
+    }
+
+    copy_results(full_retset, k_search, indices, distances, query_norm);
+    DISKANN_TRACE(QUERY_END, hops, num_ios);
+    if (trace_access)
+        append_access_trace(&expanded, 1);
+
+#ifdef USE_BING_INFRA
+    ctx.m_completeCount = 0;
+#endif
+
+    if (stats != nullptr)
+    {
+        stats->total_us = (float)query_timer.elapsed();
+    }
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::scan_filtered_points(const T *query1, const uint64_t k_search, const uint64_t l_search,
+                                                   uint64_t *indices, float *distances,
+                                                   const LabelFilter<LabelT> &filter,
+                                                   const std::vector<LabelT> &scan_labels, QueryStats *stats,
+                                                   const float *float_query)
+{
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    auto data = manager.scratch_space();
+    IOContext &ctx = data->ctx;
+    auto query_scratch = &(data->scratch);
+    auto pq_query_scratch = query_scratch->pq_scratch();
+    query_scratch->reset();
+
+    T *aligned_query_T = query_scratch->aligned_query_T();
+    float *query_float = pq_query_scratch->aligned_query_float;
+    float *query_rotated = pq_query_scratch->rotated_query;
+    float query_norm = 0;
+    const float *exact_query = nullptr;
+    if (float_query != nullptr)
+        exact_query = prepare_float_query(float_query, query_scratch, query_norm);
+    else
+        query_norm = prepare_query(query1, aligned_query_T, pq_query_scratch);
+    T *data_buf = query_scratch->coord_scratch;
+    char *sector_scratch = query_scratch->sector_scratch;
+    const uint64_t num_sectors_per_node =
+        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+
+    float *pq_dists = pq_query_scratch->aligned_pqtable_dist_scratch;
+    FastScanLUT &fast_scan_lut = pq_query_scratch->fast_scan_lut;
+    if (_quantizer != nullptr)
+    {
+        _quantizer->preprocess_query(aligned_query_T, (uint32_t)_data_dim, *pq_query_scratch);
+    }
+    else
+    {
+        _pq_table.preprocess_query(query_rotated);
+        populate_pq_dists(query_rotated, pq_dists);
+        if (_use_fast_scan_pq)
+            diskann::quantize_fast_scan_lut(pq_dists, _n_chunks, fast_scan_lut);
+    }
+    populate_disk_pq_dists(query_float, pq_dists);
+    float *dist_scratch = pq_query_scratch->aligned_dist_scratch;
+    uint8_t *pq_coord_scratch = pq_query_scratch->aligned_pq_coord_scratch;
+    Timer query_timer, io_timer, cpu_timer;
+
+    // the points that match, from the posting lists
+    std::vector<uint32_t> candidates;
+    for (const LabelT &label : scan_labels)
+    {
+        auto iter = _label_postings.find(label);
+        if (iter != _label_postings.end())
+            candidates.insert(candidates.end(), iter->second.begin(), iter->second.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [&](uint32_t id) {
+                                        return !point_matches_filter(id, filter, true) || node_deleted(id);
+                                    }),
+                     candidates.end());
+
+    // PQ distances to all of them, keeping the l_search closest
+    NeighborPriorityQueue &retset = query_scratch->retset;
+    retset.reserve(l_search);
+    for (size_t begin = 0; begin < candidates.size(); begin += _max_degree)
+    {
+        const size_t n = (std::min)((size_t)_max_degree, candidates.size() - begin);
+        if (_quantizer != nullptr)
+            compute_quantized_dists(candidates.data() + begin, n, pq_query_scratch, dist_scratch);
+        else
+            compute_pq_dists(candidates.data() + begin, n, pq_dists, fast_scan_lut, pq_coord_scratch, dist_scratch);
+        for (size_t j = 0; j < n; j++)
+            retset.insert(Neighbor(candidates[begin + j], dist_scratch[j]));
+    }
+    if (stats != nullptr)
+    {
+        stats->n_cmps += (uint32_t)candidates.size();
+        stats->pq_us += cpu_timer.elapsed_us_fractional();
+        stats->cpu_us += (float)cpu_timer.elapsed();
+    }
+
+    // re-rank them with the vectors stored in their nodes, read in batches
+    // that fit the sector scratch
+    std::vector<Neighbor> &full_retset = query_scratch->full_retset;
+    auto node_dist = [&](const T *coords) {
+        if (!_use_disk_index_pq)
+            return compare_query(exact_query, aligned_query_T, coords);
+        return disk_pq_distance(pq_dists, coords);
+    };
+    auto score_node = [&](uint32_t id, char *sector_buf) {
+        memcpy(data_buf, offset_to_node_coords(offset_to_node(sector_buf, id)), _disk_bytes_per_point);
+        full_retset.push_back(Neighbor(id, node_dist(data_buf)));
+    };
+
+    const uint64_t nodes_per_read = (std::max)((uint64_t)1, defaults::MAX_N_SECTOR_READS / num_sectors_per_node);
+    std::vector<AlignedRead> read_reqs;
+    std::vector<uint32_t> read_ids;
+    auto read_batch = [&]() {
+        if (read_reqs.empty())
+            return;
+        io_timer.reset();
+#ifdef USE_BING_INFRA
+        reader->read(read_reqs, ctx, true);
+#else
+        reader->read(read_reqs, ctx);
+#endif
+        if (stats != nullptr)
+            stats->io_us += (float)io_timer.elapsed();
+        for (size_t j = 0; j < read_ids.size(); j++)
+            score_node(read_ids[j], (char *)read_reqs[j].buf);
+        read_reqs.clear();
+        read_ids.clear();
+    };
+    for (size_t i = 0; i < retset.size(); i++)
+    {
+        const uint32_t id = retset[i].id;
+        T *cached_coords = find_cached_coords(id);
+        char *cached_sector = find_cached_sector(id);
+        if (cached_coords != nullptr)
+        {
+            full_retset.push_back(Neighbor(id, node_dist(cached_coords)));
+        }
+        else if (cached_sector != nullptr)
+        {
+            score_node(id, cached_sector);
+        }
+        else
+        {
+            read_reqs.emplace_back(get_node_sector((size_t)id) * _sector_len,
+                                   num_sectors_per_node * _sector_len,
+                                   sector_scratch + read_ids.size() * num_sectors_per_node * _sector_len);
+            read_ids.push_back(id);
+            if (stats != nullptr)
+            {
+                stats->n_4k++;
+                stats->n_ios++;
+                stats->read_size += (uint32_t)(num_sectors_per_node * _sector_len);
+            }
+            if (read_ids.size() == nodes_per_read)
+                read_batch();
+            continue;
+        }
+        if (stats != nullptr)
+            stats->n_cache_hits++;
+    }
+    read_batch();
+
+    // a point and its dummy points have the same vector
+    std::sort(full_retset.begin(), full_retset.end());
+    if (!_dummy_pts.empty())
+    {
+        tsl::robin_set<uint32_t> seen_real;
+        auto last = std::remove_if(full_retset.begin(), full_retset.end(), [&](const Neighbor &n) {
+            auto dummy_iter = _dummy_to_real_map.find(n.id);
+            return !seen_real.insert(dummy_iter == _dummy_to_real_map.end() ? n.id : dummy_iter->second).second;
+        });
+        full_retset.erase(last, full_retset.end());
+    }
+    copy_results(full_retset, k_search, indices, distances, query_norm);
+
+#ifdef USE_BING_INFRA
+    ctx.m_completeCount = 0;
+#endif
+
+    if (stats != nullptr)
+    {
+        stats->total_us = (float)query_timer.elapsed();
+    }
+}
+
+template <typename T, typename LabelT>
+uint32_t PQFlashIndex<T, LabelT>::unmapped_node_id(uint32_t node_id) const
+{
+    auto iter = _dummy_to_real_map.find(node_id);
+    if (iter != _dummy_to_real_map.end())
+        node_id = iter->second;
+    if (!_layout_ids.empty())
+        node_id = _layout_ids[node_id];
+    return node_id;
+}
+
+template <typename T, typename LabelT>
+uint64_t PQFlashIndex<T, LabelT>::num_result_ids(const std::vector<Neighbor> &results,
+                                                 const uint64_t num_results) const
+{
+    const uint64_t num_nodes = (std::min)(num_results, (uint64_t)results.size());
+    if (_duplicate_offsets.empty() && _num_deleted.load(std::memory_order_relaxed) == 0)
+        return num_nodes;
+    uint64_t num_ids = 0;
+    for (uint64_t i = 0; i < num_nodes; i++)
+    {
+        const uint32_t id = unmapped_node_id(results[i].id);
+        if (_duplicate_offsets.empty())
+        {
+            num_ids += id_deleted(id) ? 0 : 1;
+            continue;
+        }
+        for (uint32_t j = _duplicate_offsets[id]; j < _duplicate_offsets[id + 1]; j++)
+            num_ids += id_deleted(_duplicate_ids[j]) ? 0 : 1;
+    }
+    return num_ids;
+}
+
+template <typename T, typename LabelT>
+uint64_t PQFlashIndex<T, LabelT>::copy_results(const std::vector<Neighbor> &full_retset, const uint64_t k_search,
+                                               uint64_t *indices, float *distances, const float query_norm)
+{
+    uint64_t num_ids = 0;
+    for (uint64_t i = 0; num_ids < k_search && i < full_retset.size(); i++)
+    {
+        const uint32_t id = unmapped_node_id(full_retset[i].id);
+        float distance = full_retset[i].distance;
+        if (metric == diskann::Metric::INNER_PRODUCT)
+        {
+            // flip the sign to convert min to max
+            distance = (-distance);
+            // rescale to revert back to original norms (cancelling the
+            // effect of base and query pre-processing)
+            if (_max_base_norm != 0)
+                distance *= (_max_base_norm * query_norm);
+        }
+
+        if (_duplicate_offsets.empty())
+        {
+            if (id_deleted(id))
+                continue;
+            indices[num_ids] = id;
+            if (distances != nullptr)
+                distances[num_ids] = distance;
+            num_ids++;
+            continue;
+        }
+        for (uint32_t j = _duplicate_offsets[id]; j < _duplicate_offsets[id + 1] && num_ids < k_search; j++)
+        {
+            if (id_deleted(_duplicate_ids[j]))
+                continue;
+            indices[num_ids] = _duplicate_ids[j];
+            if (distances != nullptr)
+                distances[num_ids] = distance;
+            num_ids++;
+        }
+    }
+    return num_ids;
+}
+
+template <typename T, typename LabelT> uint64_t PQFlashIndex<T, LabelT>::num_point_ids() const
+{
+    return _duplicate_offsets.empty() ? _num_points - _dummy_pts.size() : _duplicate_ids.size();
+}
+
+template <typename T, typename LabelT> bool PQFlashIndex<T, LabelT>::id_deleted(const uint32_t id) const
+{
+    if (_num_deleted.load(std::memory_order_relaxed) == 0)
+        return false;
+    const std::atomic<uint64_t> *bits = _deleted_bits.load(std::memory_order_acquire);
+    return bits != nullptr && ((bits[id / 64].load(std::memory_order_relaxed) >> (id % 64)) & 1);
+}
+
+template <typename T, typename LabelT> bool PQFlashIndex<T, LabelT>::node_deleted(const uint32_t node_id) const
+{
+    if (_num_deleted.load(std::memory_order_relaxed) == 0)
+        return false;
+    const uint32_t id = unmapped_node_id(node_id);
+    if (_duplicate_offsets.empty())
+        return id_deleted(id);
+    for (uint32_t j = _duplicate_offsets[id]; j < _duplicate_offsets[id + 1]; j++)
+    {
+        if (!id_deleted(_duplicate_ids[j]))
+            return false;
+    }
+    return true;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::mark_deleted(const std::vector<uint32_t> &ids)
+{
+    const uint64_t num_ids = num_point_ids();
+    for (const uint32_t id : ids)
+    {
+        if (id >= num_ids)
+            throw ANNException("Cannot delete point " + std::to_string(id) + " of an index of " +
+                                   std::to_string(num_ids) + " points",
+                               -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    std::lock_guard<std::mutex> guard(_deleted_lock);
+    if (_deleted_words == nullptr)
+    {
+        const uint64_t num_words = DIV_ROUND_UP(num_ids, 64);
+        _deleted_words.reset(new std::atomic<uint64_t>[num_words]);
+        for (uint64_t w = 0; w < num_words; w++)
+            _deleted_words[w].store(0, std::memory_order_relaxed);
+        _deleted_bits.store(_deleted_words.get(), std::memory_order_release);
+    }
+    for (const uint32_t id : ids)
+    {
+        const uint64_t bit = (uint64_t)1 << (id % 64);
+        if ((_deleted_words[id / 64].fetch_or(bit, std::memory_order_relaxed) & bit) == 0)
+            _num_deleted.fetch_add(1, std::memory_order_release);
+    }
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::unmark_deleted(const std::vector<uint32_t> &ids)
+{
+    std::lock_guard<std::mutex> guard(_deleted_lock);
+    if (_deleted_words == nullptr)
+        return;
+    const uint64_t num_ids = num_point_ids();
+    for (const uint32_t id : ids)
+    {
+        if (id >= num_ids)
+            continue;
+        const uint64_t bit = (uint64_t)1 << (id % 64);
+        if ((_deleted_words[id / 64].fetch_and(~bit, std::memory_order_relaxed) & bit) != 0)
+            _num_deleted.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::load_delete_list(const std::string &filename)
+{
+    std::unique_ptr<uint32_t[]> ids;
+    size_t npts, ndims;
+    load_bin<uint32_t>(filename, ids, npts, ndims);
+    if (ndims != 1)
+        throw ANNException("Delete list " + filename + " has " + std::to_string(ndims) + " dimensions, expected 1", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    mark_deleted(std::vector<uint32_t>(ids.get(), ids.get() + npts));
+    diskann::cout << "Deleted " << npts << " points listed in " << filename << ", " << get_num_deleted()
+                  << " in all" << std::endl;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::save_delete_list(const std::string &filename)
+{
+    std::vector<uint32_t> ids;
+    {
+        std::lock_guard<std::mutex> guard(_deleted_lock);
+        const uint64_t num_ids = num_point_ids();
+        for (uint64_t id = 0; _deleted_words != nullptr && id < num_ids; id++)
+        {
+            if ((_deleted_words[id / 64].load(std::memory_order_relaxed) >> (id % 64)) & 1)
+                ids.push_back((uint32_t)id);
+        }
+    }
+    save_bin<uint32_t>(filename, ids.data(), ids.size(), 1);
+}
+
+template <typename T, typename LabelT> uint64_t PQFlashIndex<T, LabelT>::get_num_deleted()
+{
+    return _num_deleted.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::start_cursor(PQFlashSearchCursor<T> &cursor, const T *query)
+{
+    check_no_quantizer("paged and range search");
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    auto data = manager.scratch_space();
+    auto query_scratch = &(data->scratch);
+    auto pq_query_scratch = query_scratch->pq_scratch();
+    query_scratch->reset();
+
+    cursor.query_norm = prepare_query(query, cursor.aligned_query_T, pq_query_scratch);
+    memcpy(cursor.query_float, pq_query_scratch->aligned_query_float, _aligned_dim * sizeof(float));
+    float *query_rotated = pq_query_scratch->rotated_query;
+    _pq_table.preprocess_query(query_rotated);
+    populate_pq_dists(query_rotated, cursor.pq_dists);
+    if (_use_fast_scan_pq)
+        diskann::quantize_fast_scan_lut(cursor.pq_dists, _n_chunks, cursor.fast_scan_lut);
+    populate_disk_pq_dists(cursor.query_float, cursor.pq_dists);
+
+    float *dist_scratch = pq_query_scratch->aligned_dist_scratch;
+    uint32_t start_points[defaults::ENTRY_LAYER_NUM_SEEDS];
+    const uint32_t num_start_points = get_start_points(cursor.query_float, start_points);
+    compute_pq_dists(start_points, num_start_points, cursor.pq_dists, cursor.fast_scan_lut,
+                     pq_query_scratch->aligned_pq_coord_scratch, dist_scratch);
+    cursor.visited.reserve(_num_points, cursor.l_search * _max_degree);
+    for (uint32_t i = 0; i < num_start_points; i++)
+    {
+        if (!cursor.visited.insert(start_points[i]))
+            continue;
+        cursor.candidates.emplace_back(start_points[i], dist_scratch[i]);
+        cursor.seen_dists.push_back(dist_scratch[i]);
+    }
+    std::make_heap(cursor.candidates.begin(), cursor.candidates.end(),
+                   [](const Neighbor &a, const Neighbor &b) { return b < a; });
+}
+
+// Expands like a beam search with a list of l_search candidates, except that
+// candidates that fall out of the list are kept aside rather than dropped: a
+// later call with a larger l_search picks them up again, and nodes already
+// expanded are never read or scored twice.
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::expand_cursor(PQFlashSearchCursor<T> &cursor, const uint64_t l_search,
+                                            const uint64_t beam_width, QueryStats *stats)
+{
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    auto data = manager.scratch_space();
+    IOContext &ctx = data->ctx;
+    auto query_scratch = &(data->scratch);
+    auto pq_query_scratch = query_scratch->pq_scratch();
+    query_scratch->reset();
+
+    T *data_buf = query_scratch->coord_scratch;
+    char *sector_scratch = query_scratch->sector_scratch;
+    float *dist_scratch = pq_query_scratch->aligned_dist_scratch;
+    uint8_t *pq_coord_scratch = pq_query_scratch->aligned_pq_coord_scratch;
+    const uint64_t num_sectors_per_node =
+        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    const uint64_t max_beam_width =
+        (std::max)((std::min)(beam_width, defaults::MAX_N_SECTOR_READS / num_sectors_per_node), (uint64_t)1);
+    Timer io_timer, cpu_timer;
+
+    auto farther = [](const Neighbor &a, const Neighbor &b) { return b < a; };
+    auto add_to_closest = [&](float dist) {
+        if (cursor.closest_l.size() < cursor.bound_l)
+            cursor.closest_l.push(dist);
+        else if (dist < cursor.closest_l.top())
+        {
+            cursor.closest_l.pop();
+            cursor.closest_l.push(dist);
+        }
+    };
+    if (cursor.bound_l != l_search)
+    {
+        cursor.bound_l = l_search;
+        cursor.closest_l = std::priority_queue<float>();
+        for (const float dist : cursor.seen_dists)
+            add_to_closest(dist);
+    }
+    auto in_list = [&]() {
+        return !cursor.candidates.empty() && (cursor.closest_l.size() < cursor.bound_l ||
+                                              cursor.candidates.front().distance <= cursor.closest_l.top());
+    };
+
+    auto expand = [&](uint32_t id, const T *coords, uint64_t nnbrs, const uint32_t *node_nbrs) {
+        float cur_expanded_dist;
+        cpu_timer.reset();
+        if (!_use_disk_index_pq)
+            cur_expanded_dist = compare_full_precision(cursor.aligned_query_T, coords);
+        else
+            cur_expanded_dist = disk_pq_distance(cursor.pq_dists, coords);
+        if (stats != nullptr)
+            stats->fp_us += cpu_timer.elapsed_us_fractional();
+        if (!node_deleted(id))
+            cursor.results.push_back(Neighbor(id, cur_expanded_dist));
+
+        cpu_timer.reset();
+        compute_pq_dists(node_nbrs, nnbrs, cursor.pq_dists, cursor.fast_scan_lut, pq_coord_scratch, dist_scratch);
+        for (uint64_t m = 0; m < nnbrs; ++m)
+        {
+            const uint32_t nbr = node_nbrs[m];
+            if (!cursor.visited.insert(nbr) || _dummy_pts.find(nbr) != _dummy_pts.end())
+                continue;
+            cursor.candidates.emplace_back(nbr, dist_scratch[m]);
+            std::push_heap(cursor.candidates.begin(), cursor.candidates.end(), farther);
+            cursor.seen_dists.push_back(dist_scratch[m]);
+            add_to_closest(dist_scratch[m]);
+        }
+        if (stats != nullptr)
+        {
+            stats->n_cmps += (uint32_t)nnbrs;
+            stats->pq_us += cpu_timer.elapsed_us_fractional();
+            stats->cpu_us += (float)cpu_timer.elapsed();
+        }
+    };
+    auto expand_sector = [&](uint32_t id, char *sector_buf) {
+        char *node_disk_buf = offset_to_node(sector_buf, id);
+        uint32_t *node_buf = offset_to_node_nhood(node_disk_buf);
+        memcpy(data_buf, offset_to_node_coords(node_disk_buf), _disk_bytes_per_point);
+        expand(id, data_buf, *node_buf, node_nbr_ids(node_buf, query_scratch->nbr_scratch));
+    };
+
+    std::vector<uint32_t> cached_ids;
+    std::vector<std::pair<uint32_t, char *>> sector_cached;
+    std::vector<uint32_t> read_ids;
+    std::vector<AlignedRead> read_reqs;
+    while (in_list())
+    {
+        cached_ids.clear();
+        sector_cached.clear();
+        read_ids.clear();
+        read_reqs.clear();
+        while (in_list() && cached_ids.size() + sector_cached.size() + read_ids.size() < max_beam_width)
+        {
+            std::pop_heap(cursor.candidates.begin(), cursor.candidates.end(), farther);
+            const uint32_t id = cursor.candidates.back().id;
+            cursor.candidates.pop_back();
+            char *cached_sector = find_cached_sector(id);
+            if (find_cached_nhood(id) != nullptr)
+            {
+                cached_ids.push_back(id);
+            }
+            else if (cached_sector != nullptr)
+            {
+                sector_cached.emplace_back(id, cached_sector);
+            }
+            else
+            {
+                read_reqs.emplace_back(get_node_sector((size_t)id) * _sector_len,
+                                       num_sectors_per_node * _sector_len,
+                                       sector_scratch + read_ids.size() * num_sectors_per_node * _sector_len);
+                read_ids.push_back(id);
+                continue;
+            }
+            if (stats != nullptr)
+                stats->n_cache_hits++;
+        }
+
+        if (!read_reqs.empty())
+        {
+            if (stats != nullptr)
+            {
+                stats->n_hops++;
+                stats->n_4k += (uint32_t)read_reqs.size();
+                stats->n_ios += (uint32_t)read_reqs.size();
+                stats->read_size += (uint32_t)(read_reqs.size() * num_sectors_per_node * _sector_len);
+            }
+            io_timer.reset();
+#ifdef USE_BING_INFRA
+            reader->read(read_reqs, ctx, true);
+#else
+            reader->read(read_reqs, ctx);
+#endif
+            if (stats != nullptr)
+                stats->io_us += (float)io_timer.elapsed();
+        }
+        for (const uint32_t id : cached_ids)
+        {
+            auto &nhood = _nhood_cache[id];
+            expand(id, _coord_cache[id], nhood.first, nhood.second);
+        }
+        for (auto &cached : sector_cached)
+            expand_sector(cached.first, cached.second);
+        for (size_t i = 0; i < read_ids.size(); i++)
+            expand_sector(read_ids[i], (char *)read_reqs[i].buf);
+    }
+
+#ifdef USE_BING_INFRA
+    ctx.m_completeCount = 0;
+#endif
+}
+
+template <typename T, typename LabelT>
+std::unique_ptr<PQFlashSearchCursor<T>> PQFlashIndex<T, LabelT>::begin_paged_search(const T *query,
+                                                                                     const uint64_t l_search,
+                                                                                     const uint64_t beam_width)
+{
+    std::unique_ptr<PQFlashSearchCursor<T>> cursor(
+        new PQFlashSearchCursor<T>(_aligned_dim, _n_chunks, _pq_table.get_table_stride(), disk_pq_table_entries()));
+    cursor->l_search = l_search;
+    cursor->beam_width = beam_width;
+    start_cursor(*cursor, query);
+    return cursor;
+}
+
+template <typename T, typename LabelT>
+uint64_t PQFlashIndex<T, LabelT>::next_page(PQFlashSearchCursor<T> &cursor, const uint64_t k_search,
+                                            uint64_t *res_ids, float *res_dists, QueryStats *stats)
+{
+    Timer query_timer;
+    expand_cursor(cursor, (std::max)(cursor.l_search, k_search) + cursor.num_returned, cursor.beam_width, stats);
+
+    // the points of a node cut off at the end of the last page come first
+    uint64_t num_results = 0;
+    for (; num_results < k_search && !cursor.pending.empty(); num_results++)
+    {
+        res_ids[num_results] = cursor.pending.front().first;
+        if (res_dists != nullptr)
+            res_dists[num_results] = cursor.pending.front().second;
+        cursor.pending.pop_front();
+    }
+
+    // the results already returned were removed, so the closest remaining
+    // ones make the page
+    const uint64_t num_nodes = (std::min)((uint64_t)cursor.results.size(), k_search - num_results);
+    std::partial_sort(cursor.results.begin(), cursor.results.begin() + num_nodes, cursor.results.end());
+    std::vector<uint64_t> ids(num_result_ids(cursor.results, num_nodes));
+    std::vector<float> dists(ids.size());
+    // fewer if points were deleted meanwhile
+    ids.resize(copy_results(cursor.results, ids.size(), ids.data(), dists.data(), cursor.query_norm));
+    for (uint64_t i = 0; i < ids.size(); i++)
+    {
+        if (num_results == k_search)
+        {
+            cursor.pending.emplace_back(ids[i], dists[i]);
+            continue;
+        }
+        res_ids[num_results] = ids[i];
+        if (res_dists != nullptr)
+            res_dists[num_results] = dists[i];
+        num_results++;
+    }
+    cursor.results.erase(cursor.results.begin(), cursor.results.begin() + num_nodes);
+    cursor.num_returned += num_nodes;
+
+    if (stats != nullptr)
+        stats->total_us = (float)query_timer.elapsed();
+    return num_results;
+}
+
+// Range search expands the graph like a beam search whose candidate list
+// starts at min_l_search and doubles every round up to max_l_search. The
+// rounds share one cursor, so each picks up where the previous one stopped
+// and no node is read or scored twice. The search stops after a round that
+// found fewer than l_search / 2 points within range, when no candidates are
+// left, or when the PQ distance of the closest candidate left is beyond range
+// (except for inner product, whose PQ distances are not on the scale of
+// range).
+template <typename T, typename LabelT>
+uint32_t PQFlashIndex<T, LabelT>::range_search(const T *query1, const double range, const uint64_t min_l_search,
+                                               const uint64_t max_l_search, std::vector<uint64_t> &indices,
+                                               std::vector<float> &distances, const uint64_t min_beam_width,
+                                               QueryStats *stats)
+{
+    Timer query_timer;
+    PQFlashSearchCursor<T> cursor(_aligned_dim, _n_chunks, _pq_table.get_table_stride());
+    uint64_t l_search = (std::max)(min_l_search, (uint64_t)1);
+    cursor.l_search = l_search;
+    start_cursor(cursor, query1);
+
+    uint32_t res_count = 0;
+    while (true)
+    {
+        uint64_t beam_width = (std::max)(min_beam_width, l_search / 5);
+        beam_width = (std::min)(beam_width, (uint64_t)100);
+        expand_cursor(cursor, l_search, beam_width, stats);
+
+        // the points within range so far
+        std::sort(cursor.results.begin(), cursor.results.end());
+        indices.resize(num_result_ids(cursor.results, cursor.results.size()));
+        distances.resize(indices.size());
+        indices.resize(
+            copy_results(cursor.results, indices.size(), indices.data(), distances.data(), cursor.query_norm));
+        distances.resize(indices.size());
+        res_count = 0;
+        while (res_count < distances.size() && distances[res_count] <= (float)range)
+            res_count++;
+
+        if (res_count < (uint32_t)(l_search / 2.0) || cursor.candidates.empty())
+            break;
+        if (metric != diskann::Metric::INNER_PRODUCT && cursor.candidates.front().distance > (float)range)
+            break;
+        l_search *= 2;
+        if (l_search > max_l_search)
+            break;
+    }
+
+    indices.resize(res_count);
+    distances.resize(res_count);
+    if (stats != nullptr)
+        stats->total_us = (float)query_timer.elapsed();
+    return res_count;
+}
+
+// per-query state of batch_cached_beam_search; the thread scratch is shared by
+// the whole batch, so everything that must survive across rounds lives here
+template <typename T> struct BatchQueryState
+{
+    T *aligned_query_T = nullptr;
+    float *query_float = nullptr;
+    float *pq_dists = nullptr;
+    FastScanLUT fast_scan_lut;
+    float query_norm = 0;
+    bool done = false;
+    NeighborPriorityQueue retset;
+    VisitedSet visited;
+    std::vector<Neighbor> full_retset;
+
+    // pq_dists as in PQFlashSearchCursor
+    BatchQueryState(uint64_t aligned_dim, uint64_t n_chunks, uint64_t table_stride, uint64_t disk_pq_entries,
+                    uint64_t l_search, uint64_t max_degree)
+    {
+        diskann::alloc_aligned((void **)&aligned_query_T, aligned_dim * sizeof(T), 8 * sizeof(T));
+        diskann::alloc_aligned((void **)&query_float, aligned_dim * sizeof(float), 8 * sizeof(float));
+        diskann::alloc_aligned((void **)&pq_dists, (table_stride * n_chunks + disk_pq_entries) * sizeof(float), 256);
+        diskann::alloc_aligned((void **)&fast_scan_lut.lut,
+                               ROUND_UP(NUM_PQ_CENTROIDS_FAST_SCAN * ROUND_UP(n_chunks, 2), 256), 256);
+        memset(aligned_query_T, 0, aligned_dim * sizeof(T));
+        memset(query_float, 0, aligned_dim * sizeof(float));
+        retset.reserve(l_search);
+        visited.reserve_table(l_search * max_degree);
+    }
+
+    ~BatchQueryState()
+    {
+        diskann::aligned_free(aligned_query_T);
+        diskann::aligned_free(query_float);
+        diskann::aligned_free(pq_dists);
+        diskann::aligned_free(fast_scan_lut.lut);
+    }
+};
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::batch_cached_beam_search(const T *queries, const uint64_t nq,
+                                                       const uint64_t query_aligned_dim, const uint64_t k_search,
+                                                       const uint64_t l_search, uint64_t *res_ids, float *res_dists,
+                                                       const uint64_t beam_width, QueryStats *stats)
+{
+    batch_beam_search(queries, nq, query_aligned_dim, k_search, l_search, res_ids, res_dists, beam_width, stats,
+                      nullptr);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::batch_beam_search(const T *queries, const uint64_t nq, const uint64_t query_aligned_dim,
+                                                const uint64_t k_search, const uint64_t l_search, uint64_t *res_ids,
+                                                float *res_dists, const uint64_t beam_width, QueryStats *stats,
+                                                const std::function<void(uint32_t, const T *)> &on_expand,
+                                                const uint32_t *start_nodes)
+{
+    uint64_t num_sector_per_nodes = DIV_ROUND_UP(_max_node_len, _sector_len);
+    if (beam_width > num_sector_per_nodes * defaults::MAX_N_SECTOR_READS)
+        throw ANNException("Beamwidth can not be higher than defaults::MAX_N_SECTOR_READS", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    check_no_quantizer("batch_cached_beam_search");
+    if (nq == 0)
+        return;
+
+    std::vector<QueryStats> local_stats;
+    if (_collect_metrics && stats == nullptr)
+    {
+        local_stats.resize(nq);
+        stats = local_stats.data();
+    }
+
+    const bool trace_access = _access_trace != nullptr;
+    std::vector<std::vector<uint32_t>> expanded(trace_access ? nq : 0);
+
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    auto data = manager.scratch_space();
+    IOContext &ctx = data->ctx;
+    auto query_scratch = &(data->scratch);
+    auto pq_query_scratch = query_scratch->pq_scratch();
+    query_scratch->reset();
+
+    T *data_buf = query_scratch->coord_scratch;
+    float *dist_scratch = pq_query_scratch->aligned_dist_scratch;
+    uint8_t *pq_coord_scratch = pq_query_scratch->aligned_pq_coord_scratch;
+    const uint64_t num_sectors_per_node =
+        _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    const uint64_t node_read_len = num_sectors_per_node * _sector_len;
+
+    // the per-thread sector scratch only holds one beam, so the batch reads
+    // into its own buffer
+    char *batch_sector_buf = nullptr;
+    diskann::alloc_aligned((void **)&batch_sector_buf, nq * beam_width * node_read_len, defaults::SECTOR_LEN);
+
+    Timer query_timer, io_timer, cpu_timer;
+
+    // set up every query: normalize, build its PQ distance table and pick the
+    // start points (entry layer seeds or the closest medoids). The tables of
+    // all queries are built together, with one GEMM per chunk.
+    std::vector<std::unique_ptr<BatchQueryState<T>>> states(nq);
+    std::vector<float> rotated_queries(nq * _aligned_dim);
+    std::vector<float *> pq_tables(nq);
+    for (uint64_t q = 0; q < nq; q++)
+    {
+        states[q].reset(
+            new BatchQueryState<T>(_aligned_dim, _n_chunks, _pq_table.get_table_stride(),
+                                                disk_pq_table_entries(), l_search, _max_degree));
+        auto &st = *states[q];
+        st.query_norm = prepare_query(queries + q * query_aligned_dim, st.aligned_query_T, pq_query_scratch);
+        memcpy(st.query_float, pq_query_scratch->aligned_query_float, _aligned_dim * sizeof(float));
+
+        float *query_rotated = pq_query_scratch->rotated_query;
+        _pq_table.preprocess_query(query_rotated);
+        memcpy(rotated_queries.data() + q * _aligned_dim, query_rotated, _aligned_dim * sizeof(float));
+        pq_tables[q] = st.pq_dists;
+    }
+    if (metric == diskann::Metric::HAMMING)
+    {
+        for (uint64_t q = 0; q < nq; q++)
+            populate_pq_dists(rotated_queries.data() + q * _aligned_dim, pq_tables[q]);
+    }
+    else if (_native_mips)
+        _pq_table.populate_chunk_inner_products_batch(rotated_queries.data(), nq, _aligned_dim, pq_tables.data());
+    else
+        _pq_table.populate_chunk_distances_batch(rotated_queries.data(), nq, _aligned_dim, pq_tables.data());
+
+    for (uint64_t q = 0; q < nq; q++)
+    {
+        auto &st = *states[q];
+        if (_use_fast_scan_pq)
+            diskann::quantize_fast_scan_lut(st.pq_dists, _n_chunks, st.fast_scan_lut);
+        populate_disk_pq_dists(st.query_float, st.pq_dists);
+
+        uint32_t start_points[defaults::ENTRY_LAYER_NUM_SEEDS];
+        uint32_t num_start_points = 1;
+        if (start_nodes != nullptr)
+            start_points[0] = start_nodes[q];
+        else
+            num_start_points = get_start_points(st.query_float, start_points);
+        compute_pq_dists(start_points, num_start_points, st.pq_dists, st.fast_scan_lut, pq_coord_scratch,
+                         dist_scratch);
+        for (uint32_t i = 0; i < num_start_points; i++)
+        {
+            st.retset.insert(Neighbor(start_points[i], dist_scratch[i]));
+            st.visited.insert(start_points[i]);
+        }
+    }
+
+    // scores node_id for query q from its coords and pushes its unvisited
+    // neighbors into the query's candidate list
+    auto expand_node = [&](const uint64_t q, const uint32_t node_id, T *node_coords, const uint64_t nnbrs,
+                           uint32_t *node_nbrs) {
+        auto &st = *states[q];
+        float cur_expanded_dist;
+        cpu_timer.reset();
+        if (!_use_disk_index_pq)
+        {
+            cur_expanded_dist = compare_full_precision(st.aligned_query_T, node_coords);
+        }
+        else
+        {
+            cur_expanded_dist = disk_pq_distance(st.pq_dists, node_coords);
+        }
+        if (stats != nullptr)
+            stats[q].fp_us += cpu_timer.elapsed_us_fractional();
+        if (!node_deleted(node_id))
+            st.full_retset.push_back(Neighbor(node_id, cur_expanded_dist));
+        if (on_expand)
+            on_expand(node_id, node_coords);
+
+        cpu_timer.reset();
+        compute_pq_dists(node_nbrs, nnbrs, st.pq_dists, st.fast_scan_lut, pq_coord_scratch, dist_scratch);
+        for (uint64_t m = 0; m < nnbrs; ++m)
+        {
+            uint32_t id = node_nbrs[m];
+            if (st.visited.insert(id))
+            {
+                if (_dummy_pts.find(id) != _dummy_pts.end())
+                    continue;
+                st.retset.insert(Neighbor(id, dist_scratch[m]));
+            }
+        }
+        if (stats != nullptr)
+        {
+            stats[q].n_cmps += (uint32_t)nnbrs;
+            stats[q].pq_us += cpu_timer.elapsed_us_fractional();
+            stats[q].cpu_us += (float)cpu_timer.elapsed();
+        }
+    };
+
+    // cleared every round
+    std::vector<AlignedRead> round_reqs;
+    round_reqs.reserve(nq * beam_width);
+    tsl::robin_map<uint64_t, uint64_t> sector_to_req;
+    // (query, node id, index into round_reqs)
+    std::vector<std::tuple<uint64_t, uint32_t, uint64_t>> pending;
+    pending.reserve(nq * beam_width);
+    std::vector<std::pair<uint64_t, uint32_t>> cached;
+    cached.reserve(nq * beam_width);
+    std::vector<std::tuple<uint64_t, uint32_t, char *>> sector_cached;
+    sector_cached.reserve(nq * beam_width);
+    std::vector<uint8_t> hopped(nq);
+
+    uint64_t n_active = nq;
+    while (n_active > 0)
+    {
+        round_reqs.clear();
+        sector_to_req.clear();
+        pending.clear();
+        cached.clear();
+        sector_cached.clear();
+        std::fill(hopped.begin(), hopped.end(), 0);
+
+        // gather the beams of all live queries; a sector wanted by several
+        // of them is only read once
+        for (uint64_t q = 0; q < nq; q++)
+        {
+            auto &st = *states[q];
+            if (st.done)
+                continue;
+            if (!st.retset.has_unexpanded_node())
+            {
+                st.done = true;
+                n_active--;
+                if (stats != nullptr)
+                    stats[q].total_us = (float)query_timer.elapsed();
+                continue;
+            }
+
+            uint32_t num_seen = 0;
+            while (st.retset.has_unexpanded_node() && num_seen < beam_width)
+            {
+                auto nbr = st.retset.closest_unexpanded();
+                num_seen++;
+                if (trace_access)
+                    expanded[q].push_back(nbr.id);
+                char *cached_sector = find_cached_sector(nbr.id);
+                if (find_cached_nhood(nbr.id) != nullptr)
+                {
+                    cached.emplace_back(q, nbr.id);
+                    if (stats != nullptr)
+                        stats[q].n_cache_hits++;
+                }
+                else if (cached_sector != nullptr)
+                {
+                    sector_cached.emplace_back(q, nbr.id, cached_sector);
+                    if (stats != nullptr)
+                        stats[q].n_cache_hits++;
+                }
+                else
+                {
+                    uint64_t sector = get_node_sector((size_t)nbr.id);
+                    auto iter = sector_to_req.find(sector);
+                    uint64_t req_idx;
+                    if (iter == sector_to_req.end())
+                    {
+                        req_idx = round_reqs.size();
+                        round_reqs.emplace_back(sector * _sector_len, node_read_len,
+                                                batch_sector_buf + req_idx * node_read_len);
+                        sector_to_req.insert(std::make_pair(sector, req_idx));
+                        // the IO is charged to the first query that asked for it
+                        if (stats != nullptr)
+                        {
+                            stats[q].n_4k++;
+                            stats[q].n_ios++;
+                            stats[q].read_size += (uint32_t)node_read_len;
+                        }
+                    }
+                    else
+                    {
+                        req_idx = iter->second;
+                    }
+                    pending.emplace_back(q, nbr.id, req_idx);
+                    if (!hopped[q])
+                    {
+                        hopped[q] = 1;
+                        if (stats != nullptr)
+                            stats[q].n_hops++;
+                    }
+                }
+                if (this->_count_visited_nodes)
+                {
+                    reinterpret_cast<std::atomic<uint32_t> &>(this->_node_visit_counter[nbr.id].second).fetch_add(1);
+                }
+            }
+        }
+
+        if (!round_reqs.empty())
+        {
+            io_timer.reset();
+            reader->read(round_reqs, ctx);
+            float io_us = (float)io_timer.elapsed();
+            if (stats != nullptr)
+            {
+                for (uint64_t q = 0; q < nq; q++)
+                    if (hopped[q])
+                        stats[q].io_us += io_us;
+            }
         }
 
-        std::sort(full_retset.begin(), full_retset.end());
+        for (auto &c : cached)
+        {
+            auto nhood = _nhood_cache.find(c.second)->second;
+            expand_node(c.first, c.second, _coord_cache.find(c.second)->second, nhood.first, nhood.second);
+        }
+
+        auto expand_sector = [&](const uint64_t q, const uint32_t node_id, char *sector_buf) {
+            char *node_disk_buf = offset_to_node(sector_buf, node_id);
+            uint32_t *node_buf = offset_to_node_nhood(node_disk_buf);
+            memcpy(data_buf, offset_to_node_coords(node_disk_buf), _disk_bytes_per_point);
+            expand_node(q, node_id, data_buf, (uint64_t)(*node_buf),
+                        node_nbr_ids(node_buf, query_scratch->nbr_scratch));
+        };
+        for (auto &c : sector_cached)
+        {
+            expand_sector(std::get<0>(c), std::get<1>(c), std::get<2>(c));
+        }
+        for (auto &p : pending)
+        {
+            expand_sector(std::get<0>(p), std::get<1>(p), (char *)round_reqs[std::get<2>(p)].buf);
+        }
+    }
+
+    diskann::aligned_free(batch_sector_buf);
+
+    for (uint64_t q = 0; q < nq && res_ids != nullptr; q++)
+    {
+        auto &st = *states[q];
+        std::sort(st.full_retset.begin(), st.full_retset.end());
+        uint64_t *indices = res_ids + q * k_search;
+        float *distances = res_dists != nullptr ? res_dists + q * k_search : nullptr;
+        copy_results(st.full_retset, k_search, indices, distances, st.query_norm);
+    }
+
+    if (trace_access)
+        append_access_trace(expanded.data(), nq);
+
+    if (_collect_metrics)
+    {
+        for (uint64_t q = 0; q < nq; q++)
+            _metrics.record(stats[q]);
+    }
+}
+
+template <typename T, typename LabelT>
+uint64_t PQFlashIndex<T, LabelT>::multi_vector_search(const T *queries, const uint64_t nq,
+                                                      const uint64_t query_aligned_dim, const uint32_t *doc_ids,
+                                                      const uint64_t k_search, const uint64_t l_search,
+                                                      uint32_t *res_docs, float *res_scores, const uint64_t beam_width,
+                                                      QueryStats *stats)
+{
+    if (_use_disk_index_pq)
+    {
+        throw ANNException("Multi-vector search needs the full-precision vectors on disk", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+    if (metric == diskann::Metric::HAMMING)
+        throw ANNException("Multi-vector search does not support the Hamming metric", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    if (nq == 0 || k_search == 0)
+        return 0;
+
+    // the inherent dimensions; MIPS indices append one to the vectors
+    const uint64_t dim =
+        metric == diskann::Metric::INNER_PRODUCT && !_native_mips ? this->_data_dim - 1 : this->_data_dim;
+    std::vector<float> query_floats(nq * dim);
+    for (uint64_t q = 0; q < nq; q++)
+    {
+        float *query_float = query_floats.data() + q * dim;
+        float norm = 0;
+        for (uint64_t i = 0; i < dim; i++)
+        {
+            query_float[i] = (float)queries[q * query_aligned_dim + i];
+            norm += query_float[i] * query_float[i];
+        }
+        if (metric == diskann::Metric::COSINE && norm > 0)
+        {
+            norm = std::sqrt(norm);
+            for (uint64_t i = 0; i < dim; i++)
+                query_float[i] /= norm;
+        }
+    }
+
+    // the points expanded by any of the vectors, once each
+    tsl::robin_set<uint32_t> read;
+    std::vector<uint32_t> read_ids;
+    std::vector<float> read_vectors;
+    auto on_expand = [&](uint32_t node_id, const T *node_coords) {
+        node_id = unmapped_node_id(node_id);
+        if (!read.insert(node_id).second)
+            return;
+        // every point collapsed into the node has its vector
+        const uint32_t first = _duplicate_offsets.empty() ? node_id : _duplicate_offsets[node_id];
+        const uint32_t last = _duplicate_offsets.empty() ? node_id + 1 : _duplicate_offsets[node_id + 1];
+        for (uint32_t j = first; j < last; j++)
+        {
+            const uint32_t point = _duplicate_offsets.empty() ? j : _duplicate_ids[j];
+            if (id_deleted(point))
+                continue;
+            read_ids.push_back(point);
+            for (uint64_t i = 0; i < dim; i++)
+                read_vectors.push_back((float)node_coords[i]);
+        }
+    };
+    batch_beam_search(queries, nq, query_aligned_dim, 0, l_search, nullptr, nullptr, beam_width, stats, on_expand);
+
+    // the similarities of every point read to every vector
+    const uint64_t num_read = read_ids.size();
+    std::vector<float> sims(num_read * nq);
+    if (num_read > 0)
+    {
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, (MKL_INT)num_read, (MKL_INT)nq, (MKL_INT)dim, 1.0f,
+                    read_vectors.data(), (MKL_INT)dim, query_floats.data(), (MKL_INT)dim, 0.0f, sims.data(),
+                    (MKL_INT)nq);
+    }
+    if (metric == diskann::Metric::INNER_PRODUCT && !_native_mips && _max_base_norm != 0)
+    {
+        // the vectors on disk were scaled down by _max_base_norm
+        for (auto &sim : sims)
+            sim *= _max_base_norm;
+    }
+    else if (metric == diskann::Metric::L2)
+    {
+        std::vector<float> query_norms(nq, 0.0f);
+        for (uint64_t q = 0; q < nq; q++)
+            for (uint64_t i = 0; i < dim; i++)
+                query_norms[q] += query_floats[q * dim + i] * query_floats[q * dim + i];
+        for (uint64_t p = 0; p < num_read; p++)
+        {
+            float point_norm = 0;
+            for (uint64_t i = 0; i < dim; i++)
+                point_norm += read_vectors[p * dim + i] * read_vectors[p * dim + i];
+            for (uint64_t q = 0; q < nq; q++)
+                sims[p * nq + q] = 2 * sims[p * nq + q] - query_norms[q] - point_norm;
+        }
+    }
+
+    // MaxSim: the best similarity of each vector to the points of a document
+    tsl::robin_map<uint32_t, uint64_t> doc_rows;
+    std::vector<uint32_t> docs;
+    std::vector<float> doc_max_sims;
+    for (uint64_t p = 0; p < num_read; p++)
+    {
+        const uint32_t doc = doc_ids != nullptr ? doc_ids[read_ids[p]] : read_ids[p];
+        auto iter = doc_rows.find(doc);
+        uint64_t row;
+        if (iter == doc_rows.end())
+        {
+            row = docs.size();
+            doc_rows.insert(std::make_pair(doc, row));
+            docs.push_back(doc);
+            doc_max_sims.resize(doc_max_sims.size() + nq, std::numeric_limits<float>::lowest());
+        }
+        else
+        {
+            row = iter->second;
+        }
+        for (uint64_t q = 0; q < nq; q++)
+            doc_max_sims[row * nq + q] = (std::max)(doc_max_sims[row * nq + q], sims[p * nq + q]);
+    }
+
+    std::vector<std::pair<float, uint32_t>> doc_scores(docs.size());
+    for (uint64_t row = 0; row < docs.size(); row++)
+    {
+        float score = 0;
+        for (uint64_t q = 0; q < nq; q++)
+            score += doc_max_sims[row * nq + q];
+        doc_scores[row] = std::make_pair(score, docs[row]);
+    }
+    const uint64_t num_results = (std::min)((uint64_t)doc_scores.size(), k_search);
+    std::partial_sort(doc_scores.begin(), doc_scores.begin() + num_results, doc_scores.end(),
+                      [](const std::pair<float, uint32_t> &a, const std::pair<float, uint32_t> &b) {
+                          return a.first > b.first || (a.first == b.first && a.second < b.second);
+                      });
+    for (uint64_t i = 0; i < num_results; i++)
+    {
+        res_docs[i] = doc_scores[i].second;
+        if (res_scores != nullptr)
+            res_scores[i] = doc_scores[i].first;
+    }
+    return num_results;
+}
+
+template <typename T, typename LabelT>
+uint64_t PQFlashIndex<T, LabelT>::knn_self_join(const uint64_t K, const uint64_t l_search, const uint64_t beam_width,
+                                                const uint32_t num_threads, std::vector<uint32_t> &knn_ids,
+                                                std::vector<float> &knn_dists)
+{
+    if (_use_disk_index_pq)
+    {
+        throw ANNException("A self-join needs the full-precision vectors on disk", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
     }
+    if (K == 0 || K >= l_search)
+        throw ANNException("Set l_search to more than K, and K to at least 1", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    const uint64_t num_rows = _duplicate_offsets.empty() ? _num_points - _dummy_pts.size() : _duplicate_ids.size();
+    knn_ids.assign(num_rows * K, std::numeric_limits<uint32_t>::max());
+    knn_dists.assign(num_rows * K, std::numeric_limits<float>::max());
 
-    // copy k_search values
-    for (uint64_t i = 0; i < k_search; i++)
+    // the vectors of MIPS indices were scaled down by _max_base_norm on disk
+    const bool scaled = metric == diskann::Metric::INNER_PRODUCT && !_native_mips && _max_base_norm != 0;
+    const uint64_t batch_size = defaults::KNN_SELF_JOIN_BATCH_SIZE;
+    const int64_t num_batches = (int64_t)DIV_ROUND_UP(_num_points, batch_size);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (int64_t b = 0; b < num_batches; b++)
     {
-        indices[i] = full_retset[i].id;
-        auto key = (uint32_t)indices[i];
-        if (_dummy_pts.find(key) != _dummy_pts.end())
+        // the nodes of the batch, other than filter replicas, and their
+        // vectors as the queries
+        std::vector<uint32_t> nodes;
+        for (uint64_t node = b * batch_size; node < (std::min)((uint64_t)_num_points, (b + 1) * batch_size); node++)
+        {
+            if (_dummy_pts.find((uint32_t)node) == _dummy_pts.end())
+                nodes.push_back((uint32_t)node);
+        }
+        const uint64_t nq = nodes.size();
+        if (nq == 0)
+            continue;
+        std::vector<T> queries(nq * _aligned_dim, 0);
+        std::vector<T *> coord_buffers(nq);
+        std::vector<std::pair<uint32_t, uint32_t *>> nbr_buffers(nq, std::make_pair(0, nullptr));
+        for (uint64_t q = 0; q < nq; q++)
+            coord_buffers[q] = queries.data() + q * _aligned_dim;
+        read_nodes(nodes, coord_buffers, nbr_buffers);
+        if (scaled)
         {
-            indices[i] = _dummy_to_real_map[key];
+            for (auto &value : queries)
+                value = (T)(value * _max_base_norm);
         }
 
-        if (distances != nullptr)
+        // each search also finds the points collapsed into its own node
+        uint64_t max_points_per_node = 1;
+        for (const uint32_t node : nodes)
         {
-            distances[i] = full_retset[i].distance;
-            if (metric == diskann::Metric::INNER_PRODUCT)
+            const uint32_t id = unmapped_node_id(node);
+            if (!_duplicate_offsets.empty())
             {
-                // flip the sign to convert min to max
-                distances[i] = (-distances[i]);
-                // rescale to revert back to original norms (cancelling the
-                // effect of base and query pre-processing)
-                if (_max_base_norm != 0)
-                    distances[i] *= (_max_base_norm * query_norm);
+                max_points_per_node =
+                    (std::max)(max_points_per_node, (uint64_t)(_duplicate_offsets[id + 1] - _duplicate_offsets[id]));
+            }
+        }
+        const uint64_t k_search = K + max_points_per_node;
+        std::vector<uint64_t> res_ids(nq * k_search, std::numeric_limits<uint64_t>::max());
+        std::vector<float> res_dists(nq * k_search);
+        batch_beam_search(queries.data(), nq, _aligned_dim, k_search, (std::max)(l_search, k_search),
+                          res_ids.data(), res_dists.data(), beam_width, nullptr, nullptr, nodes.data());
+
+        for (uint64_t q = 0; q < nq; q++)
+        {
+            const uint32_t id = unmapped_node_id(nodes[q]);
+            const uint32_t first = _duplicate_offsets.empty() ? id : _duplicate_offsets[id];
+            const uint32_t last = _duplicate_offsets.empty() ? id + 1 : _duplicate_offsets[id + 1];
+            for (uint32_t j = first; j < last; j++)
+            {
+                const uint32_t point = _duplicate_offsets.empty() ? j : _duplicate_ids[j];
+                uint32_t *row_ids = knn_ids.data() + (uint64_t)point * K;
+                float *row_dists = knn_dists.data() + (uint64_t)point * K;
+                uint64_t pos = 0;
+                for (uint64_t r = 0; r < k_search && pos < K; r++)
+                {
+                    const uint64_t result = res_ids[q * k_search + r];
+                    if (result == point || result >= num_rows)
+                        continue;
+                    row_ids[pos] = (uint32_t)result;
+                    row_dists[pos] = res_dists[q * k_search + r];
+                    pos++;
+                }
             }
         }
     }
+    return num_rows;
+}
 
-#ifdef USE_BING_INFRA
-    ctx.m_completeCount = 0;
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_access_trace(const std::string &filename)
+{
+    if (_access_trace != nullptr)
+    {
+        _access_trace->close();
+        _access_trace.reset();
+    }
+    if (filename.empty())
+        return;
+    if (!_load_flag)
+    {
+        throw ANNException("Load the index before starting an access trace", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    auto out = std::make_unique<std::ofstream>(filename, std::ios::binary | std::ios::out);
+    if (!out->is_open())
+    {
+        throw ANNException("Could not open access trace " + filename, -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    uint64_t header[TRACE_NUM_FIELDS];
+    header[TRACE_NUM_POINTS] = _num_points;
+    header[TRACE_NNODES_PER_SECTOR] = _nnodes_per_sector;
+    header[TRACE_SECTORS_PER_NODE] = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    header[TRACE_SECTOR_LEN] = _sector_len;
+    header[TRACE_MAX_NODE_LEN] = _max_node_len;
+    out->write((char *)header, sizeof(header));
+    _access_trace = std::move(out);
+    diskann::cout << "Recording the nodes expanded by each query to " << filename << std::endl;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::append_access_trace(const std::vector<uint32_t> *expanded, const uint64_t num_queries)
+{
+    std::lock_guard<std::mutex> guard(_access_trace_lock);
+    for (uint64_t q = 0; q < num_queries; q++)
+    {
+        uint32_t count = (uint32_t)expanded[q].size();
+        _access_trace->write((char *)&count, sizeof(count));
+        _access_trace->write((char *)expanded[q].data(), count * sizeof(uint32_t));
+    }
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_collect_metrics(bool enable)
+{
+    _collect_metrics = enable;
+}
+
+template <typename T, typename LabelT> SearchMetrics &PQFlashIndex<T, LabelT>::get_metrics()
+{
+    return _metrics;
+}
+
+template <typename T, typename LabelT> MemoryUsage PQFlashIndex<T, LabelT>::get_memory_usage()
+{
+    MemoryUsage usage;
+    // mapped codes are in the page cache, not counted here
+    usage.add("pq_codes", _pq_data_buffer.len);
+    usage.add("pq_table", _pq_table.memory_size() + _disk_pq_table.memory_size());
+    usage.add("medoids", _num_medoids * sizeof(uint32_t) +
+                             (_centroid_data != nullptr ? _num_medoids * _aligned_dim * sizeof(float) : 0));
+    if (_entry_layer != nullptr)
+        usage.add("entry_layer", _entry_layer->get_memory_usage().total() + _num_entry_layer_points * sizeof(uint32_t));
+    if (_static_cache_ready.load(std::memory_order_acquire))
+    {
+        usage.add("node_cache", _nhood_cache_buffer.len + _coord_cache_buffer.len + _far_nhood_cache_buffer.len +
+                                    _far_coord_cache_buffer.len + hash_table_bytes(_nhood_cache) +
+                                    hash_table_bytes(_coord_cache) + vector_bytes(_cache_list));
+        usage.add("sector_cache", _sector_cache.memory_size());
+    }
+    if (_dynamic_cache != nullptr)
+        usage.add("dynamic_cache", _dynamic_cache->memory_size());
+    if (_deleted_bits.load(std::memory_order_acquire) != nullptr)
+        usage.add("delete_list", DIV_ROUND_UP(num_point_ids(), 64) * sizeof(uint64_t));
+
+    uint64_t label_bytes = _label_bitmap.memory_size() + hash_table_bytes(_label_counts) +
+                           hash_table_bytes(_label_postings) + node_hash_table_bytes(_filter_to_medoid_ids) +
+                           hash_table_bytes(_dummy_pts) + hash_table_bytes(_has_dummy_pts) +
+                           hash_table_bytes(_dummy_to_real_map) + hash_table_bytes(_real_to_dummy_map) +
+                           node_hash_table_bytes(_label_map);
+    if (_pts_to_label_offsets != nullptr && _num_points > 0 && _labels_segment == nullptr)
+    {
+        const uint64_t num_labels =
+            _pts_to_label_offsets[_num_points - 1] + _pts_to_label_counts[_num_points - 1];
+        label_bytes += 2 * _num_points * sizeof(uint32_t) + num_labels * sizeof(LabelT);
+    }
+    for (const auto &postings : _label_postings)
+        label_bytes += vector_bytes(postings.second);
+    for (const auto &medoids : _filter_to_medoid_ids)
+        label_bytes += vector_bytes(medoids.second);
+    for (const auto &dummies : _real_to_dummy_map)
+        label_bytes += vector_bytes(dummies.second);
+    usage.add("labels", label_bytes);
+
+    usage.add("reorder_vectors", _reorder_buffer.len);
+    usage.add("layout_ids", vector_bytes(_layout_ids));
+    usage.add("duplicates", vector_bytes(_duplicate_offsets) + vector_bytes(_duplicate_ids));
+    usage.add("visit_counter", vector_bytes(_node_visit_counter));
+    if (!_use_search_host)
+        usage.add("scratch", _thread_data.memory_size());
+    // mapped by every process serving the index, but held once
+    uint64_t shared_bytes = 0;
+    for (auto segment : {_pq_segment.get(), _cache_segment.get(), _labels_segment.get()})
+        shared_bytes += segment != nullptr ? segment->size() : 0;
+    usage.add("shared_memory", shared_bytes);
+    return usage;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_search_host(std::shared_ptr<SSDSearchHost<T>> host)
+{
+    if (_load_flag)
+    {
+        throw ANNException("Set the search host before loading the index", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _search_host = host;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_shared_memory(const std::string &name)
+{
+    if (_load_flag)
+    {
+        throw ANNException("Set the shared memory before loading the index", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+#ifdef _WINDOWS
+    throw ANNException("Shared memory is not supported on Windows", -1, __FUNCSIG__, __FILE__, __LINE__);
+#else
+    _shared_memory_name = name;
 #endif
+}
 
-    if (stats != nullptr)
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::free_labels()
+{
+    if (_labels_buffer.ptr != nullptr)
+        free_large(_labels_buffer);
+    else
+        delete[] _pts_to_labels;
+    _pts_to_labels = nullptr;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::share_labels()
+{
+    const uint64_t num_labels =
+        _num_points == 0 ? 0 : _pts_to_label_offsets[_num_points - 1] + _pts_to_label_counts[_num_points - 1];
+    const size_t points_len = _num_points * sizeof(uint32_t);
+    _labels_segment = std::make_unique<SharedSegment>(
+        _shared_memory_name + "_labels", 2 * points_len + num_labels * sizeof(LabelT), [&](char *buf) {
+            memcpy(buf, _pts_to_label_offsets, points_len);
+            memcpy(buf + points_len, _pts_to_label_counts, points_len);
+            memcpy(buf + 2 * points_len, _pts_to_labels, num_labels * sizeof(LabelT));
+        });
+    delete[] _pts_to_label_offsets;
+    delete[] _pts_to_label_counts;
+    free_labels();
+    _pts_to_label_offsets = (uint32_t *)_labels_segment->data();
+    _pts_to_label_counts = (uint32_t *)(_labels_segment->data() + points_len);
+    _pts_to_labels = (LabelT *)(_labels_segment->data() + 2 * points_len);
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_executor(std::shared_ptr<Executor> executor)
+{
+    _executor = executor;
+}
+
+template <typename T, typename LabelT> uint64_t PQFlashIndex<T, LabelT>::get_cache_bytes_per_node()
+{
+    if (_use_sector_cache)
     {
-        stats->total_us = (float)query_timer.elapsed();
+        // a node that shares no sector with other cached nodes takes all of
+        // its sectors, and its slot
+        const uint64_t num_sectors_per_node = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+        return num_sectors_per_node * _sector_len + 2 * sizeof(uint32_t);
+    }
+    // the neighbour and coordinate rows, the entries of both hash maps, at
+    // half load, and of the cache list
+    const uint64_t map_entry_bytes =
+        sizeof(std::pair<uint32_t, std::pair<uint32_t, uint32_t *>>) + sizeof(std::pair<uint32_t, T *>);
+    return (_max_degree + 1) * sizeof(uint32_t) + _aligned_dim * sizeof(T) + 2 * map_entry_bytes +
+           sizeof(std::pair<uint32_t, uint32_t>);
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_pipelined_search(bool enable)
+{
+#ifndef USE_BING_INFRA
+    if (enable && !reader->supports_async_reads())
+    {
+        diskann::cerr << "Reader does not support asynchronous reads; pipelined search stays disabled." << std::endl;
+        return;
     }
+#endif
+    _use_pipelined_search = enable;
 }
 
-// range search returns results of all neighbors within distance of range.
-// indices and distances need to be pre-allocated of size l_search and the
-// return value is the number of matching hits.
 template <typename T, typename LabelT>
-uint32_t PQFlashIndex<T, LabelT>::range_search(const T *query1, const double range, const uint64_t min_l_search,
-                                               const uint64_t max_l_search, std::vector<uint64_t> &indices,
-                                               std::vector<float> &distances, const uint64_t min_beam_width,
-                                               QueryStats *stats)
+void PQFlashIndex<T, LabelT>::set_speculative_reads(uint32_t width, uint32_t max_wasted)
 {
-    uint32_t res_count = 0;
+#ifdef USE_BING_INFRA
+    if (width > 0)
+    {
+        diskann::cerr << "Speculative reads are not supported by this reader; they stay disabled." << std::endl;
+        return;
+    }
+#endif
+    uint64_t num_sectors_per_node = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    uint64_t width_limit = defaults::MAX_SPECULATIVE_SECTORS / 2 / num_sectors_per_node;
+    if (width > width_limit)
+    {
+        diskann::cerr << "Speculative reads capped at " << width_limit << " per hop to fit the speculative scratch."
+                      << std::endl;
+        width = (uint32_t)width_limit;
+    }
+    _speculative_width = width;
+    _max_wasted_speculative_reads = max_wasted;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_adaptive_search(uint32_t max_beam_width, uint32_t early_stop_hops)
+{
+    uint64_t num_sectors_per_node = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    uint64_t beam_limit = defaults::MAX_N_SECTOR_READS / num_sectors_per_node;
+    if (max_beam_width > beam_limit)
+    {
+        diskann::cerr << "Adaptive beam width capped at " << beam_limit << " to fit the sector scratch." << std::endl;
+        max_beam_width = (uint32_t)beam_limit;
+    }
+    _adaptive_max_beam_width = max_beam_width;
+    _early_stop_hops = early_stop_hops;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_score_colocated_nodes(bool enable)
+{
+    _score_colocated_nodes = enable;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_dynamic_cache_budget(uint64_t budget_bytes)
+{
+    if (budget_bytes == 0)
+    {
+        _dynamic_cache.reset();
+        return;
+    }
+    uint64_t num_sectors_per_node = _nnodes_per_sector > 0 ? 1 : DIV_ROUND_UP(_max_node_len, _sector_len);
+    _dynamic_cache.reset(new DynamicSectorCache(budget_bytes, num_sectors_per_node * _sector_len));
+    diskann::cout << "Dynamic node cache holds up to " << _dynamic_cache->capacity() << " records." << std::endl;
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::set_label_bitmap(bool enable)
+{
+    if (!enable || _pts_to_labels == nullptr)
+    {
+        _label_bitmap.clear();
+        return;
+    }
+    if (!_label_bitmap.empty())
+        return;
+    _label_bitmap.build(_num_points, _pts_to_label_offsets, _pts_to_label_counts, _pts_to_labels);
+    diskann::cout << "Label bitmap: " << _label_bitmap.num_dense_labels() << " dense and "
+                  << _label_bitmap.num_sparse_labels() << " sparse labels in "
+                  << _label_bitmap.memory_size() / (1024 * 1024) << "MB" << std::endl;
+}
 
-    bool stop_flag = false;
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_filter_planner(uint32_t scan_max_points, float post_filter_min_fraction)
+{
+    _filter_scan_max_points = scan_max_points;
+    _filter_post_min_fraction = post_filter_min_fraction;
 
-    uint32_t l_search = (uint32_t)min_l_search; // starting size of the candidate list
-    while (!stop_flag)
+    // posting lists of the labels that few enough points have to be scanned
+    _label_postings.clear();
+    if (_pts_to_labels == nullptr || scan_max_points == 0)
+        return;
+    for (const auto &label_count : _label_counts)
     {
-        indices.resize(l_search);
-        distances.resize(l_search);
-        uint64_t cur_bw = min_beam_width > (l_search / 5) ? min_beam_width : l_search / 5;
-        cur_bw = (cur_bw > 100) ? 100 : cur_bw;
-        for (auto &x : distances)
-            x = std::numeric_limits<float>::max();
-        this->cached_beam_search(query1, l_search, l_search, indices.data(), distances.data(), cur_bw, false, stats);
-        for (uint32_t i = 0; i < l_search; i++)
+        if (label_count.second <= scan_max_points)
+            _label_postings[label_count.first].reserve(label_count.second);
+    }
+    for (uint32_t i = 0; i < _num_points; i++)
+    {
+        const LabelT *lbls = _pts_to_labels + _pts_to_label_offsets[i];
+        for (uint32_t j = 0; j < _pts_to_label_counts[i]; j++)
         {
-            if (distances[i] > (float)range)
-            {
-                res_count = i;
-                break;
-            }
-            else if (i == l_search - 1)
-                res_count = l_search;
+            auto iter = _label_postings.find(lbls[j]);
+            if (iter != _label_postings.end() && (iter->second.empty() || iter->second.back() != i))
+                iter.value().push_back(i);
         }
-        if (res_count < (uint32_t)(l_search / 2.0))
-            stop_flag = true;
-        l_search = l_search * 2;
-        if (l_search > max_l_search)
-            stop_flag = true;
     }
-    indices.resize(res_count);
-    distances.resize(res_count);
-    return res_count;
+    diskann::cout << "Filter planner: scanning filters of up to " << scan_max_points << " points ("
+                  << _label_postings.size() << " labels), post-filtering those of at least "
+                  << post_filter_min_fraction * 100 << "% of the points" << std::endl;
+}
+
+template <typename T, typename LabelT> DynamicSectorCache *PQFlashIndex<T, LabelT>::get_dynamic_cache()
+{
+    return _dynamic_cache.get();
 }
 
 template <typename T, typename LabelT> uint64_t PQFlashIndex<T, LabelT>::get_data_dim()
@@ -1760,7 +4988,8 @@ template <typename T, typename LabelT> diskann::Metric PQFlashIndex<T, LabelT>::
 #ifdef EXEC_ENV_OLS
 template <typename T, typename LabelT> char *PQFlashIndex<T, LabelT>::getHeaderBytes()
 {
-    IOContext &ctx = reader->get_ctx();
+    ScratchStoreManager<SSDThreadData<T>> manager(thread_data());
+    IOContext &ctx = manager.scratch_space()->ctx;
     AlignedRead readReq;
     readReq.buf = new char[PQFlashIndex<T, LabelT>::HEADER_SIZE];
     readReq.len = PQFlashIndex<T, LabelT>::HEADER_SIZE;
@@ -1775,11 +5004,140 @@ template <typename T, typename LabelT> char *PQFlashIndex<T, LabelT>::getHeaderB
 }
 #endif
 
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::populate_pq_dists(const float *query_rotated, float *pq_dists)
+{
+    if (metric == diskann::Metric::HAMMING)
+        _pq_table.populate_chunk_hamming_distances(query_rotated, pq_dists);
+    else if (_native_mips)
+        _pq_table.populate_chunk_inner_products(query_rotated, pq_dists);
+    else
+        _pq_table.populate_chunk_distances(query_rotated, pq_dists);
+}
+
+template <typename T, typename LabelT> uint64_t PQFlashIndex<T, LabelT>::disk_pq_table_entries() const
+{
+    return _use_disk_index_pq ? NUM_PQ_CENTROIDS * _disk_pq_n_chunks : 0;
+}
+
+// the disk PQ is trained without centering or rotation, so the query needs
+// neither
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::populate_disk_pq_dists(const float *query_float, float *pq_dists)
+{
+    if (!_use_disk_index_pq)
+        return;
+    float *disk_pq_dists = pq_dists + _n_chunks * _pq_table.get_table_stride();
+    if (metric == diskann::Metric::INNER_PRODUCT)
+        _disk_pq_table.populate_chunk_inner_products(query_float, disk_pq_dists);
+    else
+        _disk_pq_table.populate_chunk_distances(query_float, disk_pq_dists);
+}
+
+// with the gather kernel of the in-memory PQ, as point 0 of codes
+template <typename T, typename LabelT>
+float PQFlashIndex<T, LabelT>::disk_pq_distance(const float *pq_dists, const T *codes)
+{
+    const uint32_t first = 0;
+    float dist;
+    diskann::gather_pq_dist_lookup(&first, 1, (const uint8_t *)codes, _disk_pq_n_chunks,
+                                   pq_dists + _n_chunks * _pq_table.get_table_stride(), &dist);
+    return dist;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::compute_pq_dists(const uint32_t *ids, const uint64_t n_ids, const float *pq_dists,
+                                               const FastScanLUT &fast_scan_lut, uint8_t *pq_coord_scratch,
+                                               float *dists_out)
+{
+    if (_use_fast_scan_pq)
+    {
+        diskann::aggregate_coords(ids, n_ids, this->data, this->_pq_code_len, pq_coord_scratch);
+        diskann::fast_scan_dist_lookup(pq_coord_scratch, n_ids, this->_n_chunks, fast_scan_lut, dists_out);
+    }
+    else if (_use_wide_pq)
+    {
+        diskann::gather_pq_dist_lookup_wide(ids, n_ids, (const uint16_t *)this->data, this->_n_chunks,
+                                            _pq_table.get_table_stride(), pq_dists, dists_out);
+    }
+    else
+    {
+        diskann::gather_pq_dist_lookup(ids, n_ids, this->data, this->_n_chunks, pq_dists, dists_out);
+    }
+}
+
+template <typename T, typename LabelT>
+bool PQFlashIndex<T, LabelT>::compute_quantized_dists(const uint32_t *ids, const uint64_t n_ids,
+                                                      PQScratch<T> *pq_scratch, float *dists_out, float *errors_out)
+{
+    diskann::aggregate_coords(ids, n_ids, this->data, this->_pq_code_len, pq_scratch->aligned_pq_coord_scratch);
+    if (errors_out != nullptr)
+        return _quantizer->preprocessed_distance_bounds(*pq_scratch, (uint32_t)n_ids, dists_out, errors_out);
+    _quantizer->preprocessed_distance(*pq_scratch, (uint32_t)n_ids, dists_out);
+    return true;
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::drop_outranked_candidates(std::vector<Neighbor> &candidates, const uint64_t k_search,
+                                                        PQScratch<T> *pq_scratch)
+{
+    if (k_search == 0 || candidates.size() <= k_search)
+        return;
+    std::vector<uint32_t> ids(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++)
+        ids[i] = candidates[i].id;
+    std::vector<float> dists(ids.size()), errors(ids.size());
+    for (size_t begin = 0; begin < ids.size(); begin += defaults::MAX_GRAPH_DEGREE)
+    {
+        const size_t n = (std::min)((size_t)defaults::MAX_GRAPH_DEGREE, ids.size() - begin);
+        if (!compute_quantized_dists(ids.data() + begin, n, pq_scratch, dists.data() + begin, errors.data() + begin))
+            return;
+    }
+
+    // a candidate whose lower bound exceeds k upper bounds is not in the top k
+    std::vector<float> upper(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        upper[i] = dists[i] + errors[i];
+    std::nth_element(upper.begin(), upper.begin() + (k_search - 1), upper.end());
+    const float kth_upper = upper[k_search - 1];
+    size_t kept = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (dists[i] - errors[i] <= kth_upper)
+            candidates[kept++] = candidates[i];
+    }
+    candidates.resize(kept);
+}
+
+template <typename T, typename LabelT> void PQFlashIndex<T, LabelT>::check_no_quantizer(const char *search) const
+{
+    if (_quantizer != nullptr)
+    {
+        throw ANNException(std::string(search) + ": set_quantizer() is not supported", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+    }
+}
+
+template <typename T, typename LabelT>
+void PQFlashIndex<T, LabelT>::set_quantizer(std::unique_ptr<QuantizedDistance<T>> quantizer)
+{
+    if (_load_flag)
+        throw ANNException("set_quantizer() must be called before load()", -1, __FUNCSIG__, __FILE__, __LINE__);
+    _quantizer = std::move(quantizer);
+}
+
 template <typename T, typename LabelT>
 std::vector<std::uint8_t> PQFlashIndex<T, LabelT>::get_pq_vector(std::uint64_t vid)
 {
-    std::uint8_t *pqVec = &this->data[vid * this->_n_chunks];
-    return std::vector<std::uint8_t>(pqVec, pqVec + this->_n_chunks);
+    std::uint8_t *pqVec = &this->data[vid * this->_pq_code_len];
+    if (_use_fast_scan_pq)
+    {
+        std::vector<std::uint8_t> codes(this->_n_chunks);
+        diskann::unpack_fast_scan_codes(pqVec, this->_n_chunks, codes.data());
+        return codes;
+    }
+    // with wide PQ, the bytes of the uint16 codes
+    return std::vector<std::uint8_t>(pqVec, pqVec + this->_pq_code_len);
 }
 
 template <typename T, typename LabelT> std::uint64_t PQFlashIndex<T, LabelT>::get_num_points()
@@ -1790,9 +5148,13 @@ template <typename T, typename LabelT> std::uint64_t PQFlashIndex<T, LabelT>::ge
 // instantiations
 template class PQFlashIndex<uint8_t>;
 template class PQFlashIndex<int8_t>;
+template class PQFlashIndex<float16>;
+template class PQFlashIndex<bfloat16>;
 template class PQFlashIndex<float>;
 template class PQFlashIndex<uint8_t, uint16_t>;
 template class PQFlashIndex<int8_t, uint16_t>;
+template class PQFlashIndex<float16, uint16_t>;
+template class PQFlashIndex<bfloat16, uint16_t>;
 template class PQFlashIndex<float, uint16_t>;
 
 } // namespace diskann
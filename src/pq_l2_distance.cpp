@@ -278,6 +278,8 @@ void PQL2Distance<data_t>::prepopulate_chunkwise_distances(const float *query_ve
 }
 
 template DISKANN_DLLEXPORT class PQL2Distance<int8_t>;
+template DISKANN_DLLEXPORT class PQL2Distance<float16>;
+template DISKANN_DLLEXPORT class PQL2Distance<bfloat16>;
 template DISKANN_DLLEXPORT class PQL2Distance<uint8_t>;
 template DISKANN_DLLEXPORT class PQL2Distance<float>;
 
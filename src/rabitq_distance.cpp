@@ -0,0 +1,442 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cmath>
+#include <fstream>
+#include <random>
+
+#include "rabitq_distance.h"
+#include "pq_scratch.h"
+#include "simd_utils.h"
+#include "utils.h"
+
+// bits per dimension of the quantized query
+#define RABITQ_QUERY_BITS 4
+// floats ahead of the query bit planes in aligned_pqtable_dist_scratch:
+// residual norm, quantization step, lowest value and sum of the rotated query
+#define RABITQ_QUERY_HEADER_FLOATS 8
+// confidence parameter of the error bound, as in the RaBitQ paper
+#define RABITQ_EPSILON0 1.9f
+// rows of the data file read at a time when encoding
+#define RABITQ_BLOCK_SIZE 100000
+
+namespace diskann
+{
+namespace
+{
+inline uint64_t popcount64(uint64_t x)
+{
+#ifdef _WINDOWS
+    return __popcnt64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+void rotate_vector(const float *rotation, const size_t padded_dim, const float *vec, float *rotated)
+{
+    for (size_t i = 0; i < padded_dim; i++)
+    {
+        const float *row = rotation + i * padded_dim;
+        float sum = 0;
+        for (size_t j = 0; j < padded_dim; j++)
+            sum += row[j] * vec[j];
+        rotated[i] = sum;
+    }
+}
+
+// sum over the query bit planes j of 2^j * popcount(code & plane j), and the
+// popcount of the code
+void rabitq_binary_ip(const uint64_t *code, const uint64_t *planes, const size_t nwords, uint64_t &ip, uint64_t &ones)
+{
+    size_t w = 0;
+    ip = 0;
+    ones = 0;
+#ifdef USE_AVX2
+    // popcounts of 4 words at a time, by nibble lookups summed with sad
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+                                            2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    auto popcount_words = [&](__m256i v) {
+        const __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+        const __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+        return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+    };
+    __m256i acc_ip = zero, acc_ones = zero;
+    for (; w + 4 <= nwords; w += 4)
+    {
+        const __m256i c = _mm256_loadu_si256((const __m256i *)(code + w));
+        const __m256i p0 = _mm256_loadu_si256((const __m256i *)(planes + w));
+        const __m256i p1 = _mm256_loadu_si256((const __m256i *)(planes + nwords + w));
+        const __m256i p2 = _mm256_loadu_si256((const __m256i *)(planes + 2 * nwords + w));
+        const __m256i p3 = _mm256_loadu_si256((const __m256i *)(planes + 3 * nwords + w));
+        acc_ones = _mm256_add_epi64(acc_ones, popcount_words(c));
+        acc_ip = _mm256_add_epi64(acc_ip, popcount_words(_mm256_and_si256(c, p0)));
+        acc_ip = _mm256_add_epi64(acc_ip, _mm256_slli_epi64(popcount_words(_mm256_and_si256(c, p1)), 1));
+        acc_ip = _mm256_add_epi64(acc_ip, _mm256_slli_epi64(popcount_words(_mm256_and_si256(c, p2)), 2));
+        acc_ip = _mm256_add_epi64(acc_ip, _mm256_slli_epi64(popcount_words(_mm256_and_si256(c, p3)), 3));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256((__m256i *)lanes, acc_ip);
+    ip = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_si256((__m256i *)lanes, acc_ones);
+    ones = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(USE_NEON)
+    // popcounts of 2 words at a time, by byte counts widened to 64 bits
+    auto popcount_words = [](uint8x16_t v) { return vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vcntq_u8(v)))); };
+    auto load_words = [](const uint64_t *p) { return vreinterpretq_u8_u64(vld1q_u64(p)); };
+    uint64x2_t acc_ip = vdupq_n_u64(0), acc_ones = vdupq_n_u64(0);
+    for (; w + 2 <= nwords; w += 2)
+    {
+        const uint8x16_t c = load_words(code + w);
+        acc_ones = vaddq_u64(acc_ones, popcount_words(c));
+        acc_ip = vaddq_u64(acc_ip, popcount_words(vandq_u8(c, load_words(planes + w))));
+        acc_ip = vaddq_u64(acc_ip, vshlq_n_u64(popcount_words(vandq_u8(c, load_words(planes + nwords + w))), 1));
+        acc_ip = vaddq_u64(acc_ip, vshlq_n_u64(popcount_words(vandq_u8(c, load_words(planes + 2 * nwords + w))), 2));
+        acc_ip = vaddq_u64(acc_ip, vshlq_n_u64(popcount_words(vandq_u8(c, load_words(planes + 3 * nwords + w))), 3));
+    }
+    ip = vaddvq_u64(acc_ip);
+    ones = vaddvq_u64(acc_ones);
+#endif
+    for (; w < nwords; w++)
+    {
+        ones += popcount64(code[w]);
+        for (size_t j = 0; j < RABITQ_QUERY_BITS; j++)
+            ip += popcount64(code[w] & planes[j * nwords + w]) << j;
+    }
+}
+
+// errors_out may be null
+void rabitq_distances(const float *query, const uint8_t *codes, const size_t n_ids, const size_t padded_dim,
+                      float *dists_out, float *errors_out)
+{
+    const size_t nwords = padded_dim / 64;
+    const size_t code_len = padded_dim / 8 + 2 * sizeof(float);
+    const float q_norm = query[0], delta = query[1], lo = query[2], sum = query[3];
+    const uint64_t *planes = (const uint64_t *)(query + RABITQ_QUERY_HEADER_FLOATS);
+    const float inv_sqrt_dim = 1.0f / std::sqrt((float)padded_dim);
+    const float error_scale = RABITQ_EPSILON0 / std::sqrt((float)(padded_dim - 1));
+
+    for (size_t i = 0; i < n_ids; i++)
+    {
+        const uint8_t *code = codes + i * code_len;
+        uint64_t ip, ones;
+        rabitq_binary_ip((const uint64_t *)code, planes, nwords, ip, ones);
+        float norm, ip_code;
+        memcpy(&norm, code + padded_dim / 8, sizeof(float));
+        memcpy(&ip_code, code + padded_dim / 8 + sizeof(float), sizeof(float));
+
+        // <code vector, rotated query> from the quantized query, then
+        // <residual, query> / |residual| |query| divided by <code vector, residual>
+        const float ip_bits = delta * (float)ip + lo * (float)ones;
+        const float estimate = (2 * ip_bits - sum) * inv_sqrt_dim / ip_code;
+        const float scale = 2 * norm * q_norm;
+        dists_out[i] = norm * norm + q_norm * q_norm - scale * estimate;
+        if (errors_out != nullptr)
+            errors_out[i] =
+                scale * std::sqrt((std::max)(0.0f, 1 - ip_code * ip_code)) / ip_code * error_scale;
+    }
+}
+} // namespace
+
+template <typename data_t> bool RaBitQDistance<data_t>::is_opq() const
+{
+    return false;
+}
+
+template <typename data_t>
+std::string RaBitQDistance<data_t>::get_quantized_vectors_filename(const std::string &prefix) const
+{
+    return prefix + "_rabitq_compressed.bin";
+}
+
+template <typename data_t>
+std::string RaBitQDistance<data_t>::get_pivot_data_filename(const std::string &prefix) const
+{
+    return prefix + "_rabitq_pivots.bin";
+}
+
+template <typename data_t>
+std::string RaBitQDistance<data_t>::get_rotation_matrix_suffix(const std::string &pivots_filename) const
+{
+    return pivots_filename + "_rotation_matrix.bin";
+}
+
+#ifdef EXEC_ENV_OLS
+template <typename data_t>
+void RaBitQDistance<data_t>::load_pivot_data(MemoryMappedFiles &files, const std::string &pivots_file,
+                                             size_t num_chunks)
+{
+    size_t nr, nc;
+    float *centroid = nullptr, *rotation = nullptr;
+    diskann::load_bin<float>(files, pivots_file, centroid, nr, nc);
+#else
+template <typename data_t>
+void RaBitQDistance<data_t>::load_pivot_data(const std::string &pivots_file, size_t num_chunks)
+{
+    size_t nr, nc;
+    std::unique_ptr<float[]> centroid, rotation;
+    diskann::load_bin<float>(pivots_file, centroid, nr, nc);
+#endif
+    if (nc != 1)
+    {
+        throw diskann::ANNException("Error reading the centroid from " + pivots_file, -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+    _dim = nr;
+    _padded_dim = ROUND_UP(_dim, 64);
+    _centroid.assign(&centroid[0], &centroid[0] + _dim);
+
+    const std::string rotation_file = get_rotation_matrix_suffix(pivots_file);
+#ifdef EXEC_ENV_OLS
+    diskann::load_bin<float>(files, rotation_file, rotation, nr, nc);
+#else
+    diskann::load_bin<float>(rotation_file, rotation, nr, nc);
+#endif
+    if (nr != _padded_dim || nc != _padded_dim)
+    {
+        throw diskann::ANNException("The rotation in " + rotation_file + " is not " + std::to_string(_padded_dim) +
+                                        " x " + std::to_string(_padded_dim),
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _rotation.assign(&rotation[0], &rotation[0] + _padded_dim * _padded_dim);
+    diskann::cout << "Loaded RaBitQ pivots: #dims: " << _dim << ", " << get_num_chunks() << " bytes per code"
+                  << std::endl;
+}
+
+template <typename data_t> uint32_t RaBitQDistance<data_t>::get_num_chunks() const
+{
+    return static_cast<uint32_t>(_padded_dim / 8 + 2 * sizeof(float));
+}
+
+template <typename data_t> void RaBitQDistance<data_t>::rotate(const float *vec, float *rotated) const
+{
+    rotate_vector(_rotation.data(), _padded_dim, vec, rotated);
+}
+
+template <typename data_t>
+void RaBitQDistance<data_t>::preprocess_query(const data_t *aligned_query, uint32_t query_dim,
+                                              PQScratch<data_t> &pq_scratch)
+{
+    std::vector<float> residual(_padded_dim, 0), rotated(_padded_dim);
+    float norm_sq = 0;
+    for (size_t d = 0; d < _dim && d < query_dim; d++)
+    {
+        residual[d] = static_cast<float>(aligned_query[d]) - _centroid[d];
+        norm_sq += residual[d] * residual[d];
+    }
+    const float q_norm = std::sqrt(norm_sq);
+    if (q_norm > 0)
+    {
+        for (size_t d = 0; d < _dim; d++)
+            residual[d] /= q_norm;
+    }
+    rotate(residual.data(), rotated.data());
+
+    float lo = rotated[0], hi = rotated[0], sum = 0;
+    for (size_t i = 0; i < _padded_dim; i++)
+    {
+        lo = (std::min)(lo, rotated[i]);
+        hi = (std::max)(hi, rotated[i]);
+        sum += rotated[i];
+    }
+    const float delta = (hi - lo) / ((1 << RABITQ_QUERY_BITS) - 1);
+
+    float *query = pq_scratch.aligned_pqtable_dist_scratch;
+    query[0] = q_norm;
+    query[1] = delta;
+    query[2] = lo;
+    query[3] = sum;
+    const size_t nwords = _padded_dim / 64;
+    uint64_t *planes = (uint64_t *)(query + RABITQ_QUERY_HEADER_FLOATS);
+    memset(planes, 0, RABITQ_QUERY_BITS * nwords * sizeof(uint64_t));
+    for (size_t i = 0; i < _padded_dim; i++)
+    {
+        const uint32_t q = delta > 0 ? (uint32_t)((rotated[i] - lo) / delta + 0.5f) : 0;
+        for (size_t j = 0; j < RABITQ_QUERY_BITS; j++)
+        {
+            if ((q >> j) & 1)
+                planes[j * nwords + i / 64] |= 1ULL << (i % 64);
+        }
+    }
+}
+
+template <typename data_t>
+void RaBitQDistance<data_t>::preprocessed_distance(PQScratch<data_t> &pq_scratch, const uint32_t n_ids,
+                                                   float *dists_out)
+{
+    rabitq_distances(pq_scratch.aligned_pqtable_dist_scratch, pq_scratch.aligned_pq_coord_scratch, n_ids,
+                     _padded_dim, dists_out, nullptr);
+}
+
+template <typename data_t>
+void RaBitQDistance<data_t>::preprocessed_distance(PQScratch<data_t> &pq_scratch, const uint32_t n_ids,
+                                                   std::vector<float> &dists_out)
+{
+    dists_out.resize(n_ids);
+    preprocessed_distance(pq_scratch, n_ids, dists_out.data());
+}
+
+template <typename data_t>
+bool RaBitQDistance<data_t>::preprocessed_distance_bounds(PQScratch<data_t> &pq_scratch, const uint32_t n_ids,
+                                                          float *dists_out, float *errors_out)
+{
+    rabitq_distances(pq_scratch.aligned_pqtable_dist_scratch, pq_scratch.aligned_pq_coord_scratch, n_ids,
+                     _padded_dim, dists_out, errors_out);
+    return true;
+}
+
+template <typename data_t> float RaBitQDistance<data_t>::brute_force_distance(const float *query_vec, uint8_t *base_vec)
+{
+    std::vector<float> residual(_padded_dim, 0), rotated(_padded_dim);
+    float norm_sq = 0;
+    for (size_t d = 0; d < _dim; d++)
+    {
+        residual[d] = query_vec[d] - _centroid[d];
+        norm_sq += residual[d] * residual[d];
+    }
+    rotate(residual.data(), rotated.data());
+
+    float ip = 0;
+    for (size_t i = 0; i < _padded_dim; i++)
+        ip += ((base_vec[i / 8] >> (i % 8)) & 1) ? rotated[i] : -rotated[i];
+    ip /= std::sqrt((float)_padded_dim);
+    float norm, ip_code;
+    memcpy(&norm, base_vec + _padded_dim / 8, sizeof(float));
+    memcpy(&ip_code, base_vec + _padded_dim / 8 + sizeof(float), sizeof(float));
+    return norm * norm + norm_sq - 2 * norm * ip / ip_code;
+}
+
+template <typename T>
+void generate_rabitq_data(const std::string &data_file, const std::string &pivots_path,
+                          const std::string &compressed_path)
+{
+    size_t npts, dim;
+    diskann::get_bin_metadata(data_file, npts, dim);
+    const size_t padded_dim = ROUND_UP(dim, 64);
+    const size_t code_len = padded_dim / 8 + 2 * sizeof(float);
+    const size_t block_size = (std::min)(npts, (size_t)RABITQ_BLOCK_SIZE);
+    std::vector<T> block(block_size * dim);
+
+    std::ifstream reader(data_file, std::ios::binary);
+    reader.seekg(2 * sizeof(uint32_t), reader.beg);
+    std::vector<double> sums(dim, 0);
+    for (size_t start = 0; start < npts; start += block_size)
+    {
+        const size_t n = (std::min)(block_size, npts - start);
+        reader.read((char *)block.data(), n * dim * sizeof(T));
+        for (size_t i = 0; i < n; i++)
+            for (size_t d = 0; d < dim; d++)
+                sums[d] += static_cast<float>(block[i * dim + d]);
+    }
+    std::vector<float> centroid(dim);
+    for (size_t d = 0; d < dim; d++)
+        centroid[d] = (float)(sums[d] / (std::max)((size_t)1, npts));
+    diskann::save_bin<float>(pivots_path, centroid.data(), dim, 1);
+
+    // a random rotation: the rows of a gaussian matrix, orthonormalized by
+    // modified Gram-Schmidt
+    std::mt19937 rng(0x5eed);
+    std::normal_distribution<double> gaussian(0.0, 1.0);
+    std::vector<double> basis(padded_dim * padded_dim);
+    for (double &x : basis)
+        x = gaussian(rng);
+    for (size_t i = 0; i < padded_dim; i++)
+    {
+        double *row = basis.data() + i * padded_dim;
+        for (size_t k = 0; k < i; k++)
+        {
+            const double *prev = basis.data() + k * padded_dim;
+            double proj = 0;
+            for (size_t j = 0; j < padded_dim; j++)
+                proj += row[j] * prev[j];
+            for (size_t j = 0; j < padded_dim; j++)
+                row[j] -= proj * prev[j];
+        }
+        double norm = 0;
+        for (size_t j = 0; j < padded_dim; j++)
+            norm += row[j] * row[j];
+        norm = std::sqrt(norm);
+        for (size_t j = 0; j < padded_dim; j++)
+            row[j] /= norm;
+    }
+    std::vector<float> rotation(basis.begin(), basis.end());
+    diskann::save_bin<float>(pivots_path + "_rotation_matrix.bin", rotation.data(), padded_dim, padded_dim);
+
+    std::ofstream writer(compressed_path, std::ios::binary);
+    const uint32_t npts_u32 = (uint32_t)npts, code_len_u32 = (uint32_t)code_len;
+    writer.write((char *)&npts_u32, sizeof(uint32_t));
+    writer.write((char *)&code_len_u32, sizeof(uint32_t));
+
+    reader.clear();
+    reader.seekg(2 * sizeof(uint32_t), reader.beg);
+    std::vector<uint8_t> codes(block_size * code_len);
+    const float inv_sqrt_dim = 1.0f / std::sqrt((float)padded_dim);
+    for (size_t start = 0; start < npts; start += block_size)
+    {
+        const size_t n = (std::min)(block_size, npts - start);
+        reader.read((char *)block.data(), n * dim * sizeof(T));
+        std::memset(codes.data(), 0, n * code_len);
+#pragma omp parallel
+        {
+            std::vector<float> residual(padded_dim, 0), rotated(padded_dim);
+#pragma omp for schedule(static)
+            for (int64_t i = 0; i < (int64_t)n; i++)
+            {
+                float norm_sq = 0;
+                for (size_t d = 0; d < dim; d++)
+                {
+                    residual[d] = static_cast<float>(block[i * dim + d]) - centroid[d];
+                    norm_sq += residual[d] * residual[d];
+                }
+                const float norm = std::sqrt(norm_sq);
+                uint8_t *code = codes.data() + i * code_len;
+                // a point at the centroid has distance |query| whatever its bits
+                float ip_code = 1;
+                if (norm > 0)
+                {
+                    for (size_t d = 0; d < dim; d++)
+                        residual[d] /= norm;
+                    rotate_vector(rotation.data(), padded_dim, residual.data(), rotated.data());
+                    float abs_sum = 0;
+                    for (size_t j = 0; j < padded_dim; j++)
+                    {
+                        if (rotated[j] > 0)
+                            code[j / 8] |= (uint8_t)(1 << (j % 8));
+                        abs_sum += std::fabs(rotated[j]);
+                    }
+                    ip_code = abs_sum * inv_sqrt_dim;
+                }
+                memcpy(code + padded_dim / 8, &norm, sizeof(float));
+                memcpy(code + padded_dim / 8 + sizeof(float), &ip_code, sizeof(float));
+            }
+        }
+        writer.write((char *)codes.data(), n * code_len);
+    }
+    diskann::cout << "Wrote the " << code_len << " byte RaBitQ codes of " << npts << " points to " << compressed_path
+                  << std::endl;
+}
+
+template DISKANN_DLLEXPORT class RaBitQDistance<int8_t>;
+template DISKANN_DLLEXPORT class RaBitQDistance<float16>;
+template DISKANN_DLLEXPORT class RaBitQDistance<bfloat16>;
+template DISKANN_DLLEXPORT class RaBitQDistance<uint8_t>;
+template DISKANN_DLLEXPORT class RaBitQDistance<float>;
+
+template DISKANN_DLLEXPORT void generate_rabitq_data<int8_t>(const std::string &data_file,
+                                                             const std::string &pivots_path,
+                                                             const std::string &compressed_path);
+template DISKANN_DLLEXPORT void generate_rabitq_data<float16>(const std::string &data_file,
+                                                              const std::string &pivots_path,
+                                                              const std::string &compressed_path);
+template DISKANN_DLLEXPORT void generate_rabitq_data<bfloat16>(const std::string &data_file,
+                                                               const std::string &pivots_path,
+                                                               const std::string &compressed_path);
+template DISKANN_DLLEXPORT void generate_rabitq_data<uint8_t>(const std::string &data_file,
+                                                              const std::string &pivots_path,
+                                                              const std::string &compressed_path);
+template DISKANN_DLLEXPORT void generate_rabitq_data<float>(const std::string &data_file,
+                                                            const std::string &pivots_path,
+                                                            const std::string &compressed_path);
+} // namespace diskann
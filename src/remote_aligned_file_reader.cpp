@@ -0,0 +1,534 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "remote_aligned_file_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <strings.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+#include "ann_exception.h"
+#include "defaults.h"
+#include "logger.h"
+#include "tsl/robin_map.h"
+#include "utils.h"
+
+// attempts at each ranged GET before a read fails
+#define REMOTE_GET_ATTEMPTS 3
+
+struct RemoteAlignedFileReader::Session
+{
+    CURLM *multi = nullptr;
+    // reused across reads, so that their connections stay open
+    std::vector<CURL *> handles;
+};
+
+class RemoteAlignedFileReader::BlockCache
+{
+  public:
+    BlockCache(uint64_t block_bytes, uint64_t capacity, const std::string &file)
+        : _block_bytes(block_bytes), _block_in_slot(capacity, EMPTY), _referenced(capacity, false)
+    {
+        if (file.empty())
+        {
+            _mem.reset(new char[capacity * block_bytes]);
+            return;
+        }
+        _fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (_fd == -1 || ftruncate(_fd, (off_t)(capacity * block_bytes)) != 0)
+        {
+            std::string error = ::strerror(errno);
+            if (_fd != -1)
+                ::close(_fd);
+            throw diskann::ANNException("Cannot create the cache file " + file + ": " + error, -1, __FUNCSIG__,
+                                        __FILE__, __LINE__);
+        }
+    }
+
+    ~BlockCache()
+    {
+        if (_fd != -1)
+            ::close(_fd);
+    }
+
+    // copies len bytes at offset in block to dst, if the block is cached
+    bool copy(uint64_t block, uint64_t offset, uint64_t len, char *dst)
+    {
+        std::lock_guard<std::mutex> lock(_mut);
+        auto iter = _slot_of.find(block);
+        if (iter == _slot_of.end())
+            return false;
+        const uint64_t slot = iter->second;
+        _referenced[slot] = true;
+        const uint64_t at = slot * _block_bytes + offset;
+        if (_fd == -1)
+            memcpy(dst, _mem.get() + at, len);
+        else if (pread(_fd, dst, len, (off_t)at) != (ssize_t)len)
+            throw diskann::ANNException("Cannot read the cache file", -1, __FUNCSIG__, __FILE__, __LINE__);
+        return true;
+    }
+
+    // caches the len bytes of block at data, evicting the block of a slot
+    // not read since the clock hand last passed it if the cache is full
+    void insert(uint64_t block, const char *data, uint64_t len)
+    {
+        std::lock_guard<std::mutex> lock(_mut);
+        if (_slot_of.find(block) != _slot_of.end())
+            return;
+        while (_block_in_slot[_hand] != EMPTY && _referenced[_hand])
+        {
+            _referenced[_hand] = false;
+            _hand = (_hand + 1) % _block_in_slot.size();
+        }
+        const uint64_t slot = _hand;
+        _hand = (_hand + 1) % _block_in_slot.size();
+        if (_block_in_slot[slot] != EMPTY)
+            _slot_of.erase(_block_in_slot[slot]);
+
+        const uint64_t at = slot * _block_bytes;
+        if (_fd == -1)
+            memcpy(_mem.get() + at, data, len);
+        else if (pwrite(_fd, data, len, (off_t)at) != (ssize_t)len)
+            throw diskann::ANNException("Cannot write the cache file", -1, __FUNCSIG__, __FILE__, __LINE__);
+        _block_in_slot[slot] = block;
+        _referenced[slot] = false;
+        _slot_of[block] = slot;
+    }
+
+  private:
+    static constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max();
+
+    uint64_t _block_bytes;
+    std::mutex _mut;
+    tsl::robin_map<uint64_t, uint64_t> _slot_of;
+    // the block in each slot, or EMPTY, and whether it was read since the
+    // clock hand last passed it
+    std::vector<uint64_t> _block_in_slot;
+    std::vector<bool> _referenced;
+    uint64_t _hand = 0;
+    // the slots, in RAM or in a file
+    std::unique_ptr<char[]> _mem;
+    int _fd = -1;
+};
+
+namespace
+{
+// the destination of the body of one GET
+struct Transfer
+{
+    char *buf;
+    uint64_t len;
+    uint64_t received;
+    uint64_t object_size; // from the Content-Range header, if any
+};
+
+std::string manifest_path(const std::string &index_file)
+{
+    return index_file + ".remote";
+}
+
+size_t write_body(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    Transfer *t = (Transfer *)userdata;
+    const uint64_t n = (uint64_t)size * nmemb;
+    // a longer body than the range asked for means the server ignored the
+    // range; taking less than n fails the transfer
+    if (t->received + n > t->len)
+        return 0;
+    memcpy(t->buf + t->received, ptr, n);
+    t->received += n;
+    return n;
+}
+
+size_t read_header(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    Transfer *t = (Transfer *)userdata;
+    const size_t n = size * nmemb;
+    // Content-Range: bytes <first>-<last>/<object size>
+    const std::string header(ptr, n);
+    const size_t slash = header.find('/');
+    if (strncasecmp(header.c_str(), "Content-Range:", 14) == 0 && slash != std::string::npos)
+        t->object_size = std::strtoull(header.c_str() + slash + 1, nullptr, 10);
+    return n;
+}
+
+void init_curl()
+{
+    static std::once_flag once;
+    static CURLcode ret = CURLE_OK;
+    std::call_once(once, [] { ret = curl_global_init(CURL_GLOBAL_DEFAULT); });
+    if (ret != CURLE_OK)
+    {
+        throw diskann::ANNException(std::string("curl_global_init() failed: ") + curl_easy_strerror(ret), -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+}
+
+// sets up handle to GET bytes [offset, offset + t.len) of url into t
+void prepare_get(CURL *handle, const std::string &url, uint64_t offset, Transfer &t)
+{
+    const std::string range = std::to_string(offset) + "-" + std::to_string(offset + t.len - 1);
+    curl_easy_reset(handle);
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle, CURLOPT_RANGE, range.c_str());
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_body);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &t);
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, read_header);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, &t);
+    curl_easy_setopt(handle, CURLOPT_PRIVATE, &t);
+}
+
+// why the GET on handle into t failed, or "" if it succeeded. A server
+// answers a range with 206, or with 200 when the range is the whole object.
+std::string get_error(CURL *handle, CURLcode result, const Transfer &t)
+{
+    long status = 0;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+    if (result != CURLE_OK)
+        return curl_easy_strerror(result);
+    if (status != 206 && status != 200)
+        return "HTTP status " + std::to_string(status);
+    if (t.received != t.len)
+        return "got " + std::to_string(t.received) + " of " + std::to_string(t.len) + " bytes";
+    return "";
+}
+} // namespace
+
+RemoteAlignedFileReader::RemoteAlignedFileReader()
+{
+}
+
+RemoteAlignedFileReader::~RemoteAlignedFileReader()
+{
+    deregister_all_threads();
+    close();
+}
+
+bool RemoteAlignedFileReader::is_remote(const std::string &index_file)
+{
+    return file_exists(manifest_path(index_file));
+}
+
+RemoteAlignedFileReader::Session *RemoteAlignedFileReader::to_session(IOContext &ctx)
+{
+    return reinterpret_cast<Session *>(ctx);
+}
+
+RemoteAlignedFileReader::Session *RemoteAlignedFileReader::new_session()
+{
+    init_curl();
+    Session *session = new Session();
+    session->multi = curl_multi_init();
+    if (session->multi == nullptr)
+    {
+        delete session;
+        throw diskann::ANNException("curl_multi_init() failed", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    curl_multi_setopt(session->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)diskann::defaults::REMOTE_MAX_CONNECTIONS);
+    return session;
+}
+
+void RemoteAlignedFileReader::destroy_session(IOContext ctx)
+{
+    Session *session = to_session(ctx);
+    for (CURL *handle : session->handles)
+        curl_easy_cleanup(handle);
+    curl_multi_cleanup(session->multi);
+    delete session;
+}
+
+IOContext &RemoteAlignedFileReader::get_ctx()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    auto iter = ctx_map.find(std::this_thread::get_id());
+    if (iter == ctx_map.end())
+    {
+        lk.unlock();
+        register_thread();
+        lk.lock();
+        iter = ctx_map.find(std::this_thread::get_id());
+    }
+    if (iter == ctx_map.end())
+    {
+        std::cerr << "bad thread access; returning -1 as io_context_t" << std::endl;
+        return this->bad_ctx;
+    }
+    return iter.value();
+}
+
+IOContext RemoteAlignedFileReader::create_ctx()
+{
+    Session *session = new_session();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    owned_ctxs.push_back(reinterpret_cast<IOContext>(session));
+    return reinterpret_cast<IOContext>(session);
+}
+
+void RemoteAlignedFileReader::register_thread()
+{
+    auto my_id = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    if (ctx_map.find(my_id) != ctx_map.end())
+    {
+        std::cerr << "multiple calls to register_thread from the same thread" << std::endl;
+        return;
+    }
+    ctx_map[my_id] = reinterpret_cast<IOContext>(new_session());
+}
+
+void RemoteAlignedFileReader::deregister_thread()
+{
+    auto my_id = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    auto iter = ctx_map.find(my_id);
+    if (iter == ctx_map.end())
+        return;
+    destroy_session(iter->second);
+    ctx_map.erase(iter);
+    std::cerr << "returned ctx from thread-id:" << my_id << std::endl;
+}
+
+void RemoteAlignedFileReader::deregister_all_threads()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    for (auto x = ctx_map.begin(); x != ctx_map.end(); x++)
+    {
+        destroy_session(x.value());
+    }
+    ctx_map.clear();
+    for (IOContext ctx : owned_ctxs)
+        destroy_session(ctx);
+    owned_ctxs.clear();
+}
+
+void RemoteAlignedFileReader::open(const std::string &fname)
+{
+    std::ifstream manifest(manifest_path(fname));
+    if (!std::getline(manifest, _url) || _url.empty())
+        throw diskann::ANNException("No object URL in " + manifest_path(fname), -1, __FUNCSIG__, __FILE__, __LINE__);
+    uint64_t cache_mb = diskann::defaults::REMOTE_CACHE_MB;
+    uint64_t block_sectors = diskann::defaults::REMOTE_BLOCK_SECTORS;
+    std::string cache_file;
+    _readahead_blocks = diskann::defaults::REMOTE_READAHEAD_BLOCKS;
+    std::string key;
+    while (manifest >> key)
+    {
+        if (key == "cache_mb")
+            manifest >> cache_mb;
+        else if (key == "cache_file")
+            manifest >> cache_file;
+        else if (key == "block_sectors")
+            manifest >> block_sectors;
+        else if (key == "readahead_blocks")
+            manifest >> _readahead_blocks;
+        else
+            throw diskann::ANNException("Unknown setting " + key + " in " + manifest_path(fname), -1, __FUNCSIG__,
+                                        __FILE__, __LINE__);
+        if (!manifest)
+            throw diskann::ANNException("Bad value of " + key + " in " + manifest_path(fname), -1, __FUNCSIG__,
+                                        __FILE__, __LINE__);
+    }
+    if (cache_mb == 0 || block_sectors == 0)
+    {
+        throw diskann::ANNException("cache_mb and block_sectors must be positive in " + manifest_path(fname), -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _block_bytes = block_sectors * diskann::defaults::SECTOR_LEN;
+
+    // the size of the object, from the Content-Range of a one-byte GET. The
+    // URL is left out of errors, as it often carries a signature or token.
+    init_curl();
+    CURL *handle = curl_easy_init();
+    if (handle == nullptr)
+        throw diskann::ANNException("curl_easy_init() failed", -1, __FUNCSIG__, __FILE__, __LINE__);
+    char first_byte;
+    Transfer t;
+    std::string error;
+    for (uint32_t attempt = 0; attempt < REMOTE_GET_ATTEMPTS && (attempt == 0 || !error.empty()); attempt++)
+    {
+        t = {&first_byte, 1, 0, 0};
+        prepare_get(handle, _url, 0, t);
+        error = get_error(handle, curl_easy_perform(handle), t);
+    }
+    curl_easy_cleanup(handle);
+    if (!error.empty() || t.object_size == 0)
+    {
+        throw diskann::ANNException("Cannot read the size of the remote index of " + fname + ": " +
+                                        (error.empty() ? "no Content-Range in the response" : error),
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _size = t.object_size;
+
+    const uint64_t capacity = (std::max)((uint64_t)1, cache_mb * 1024 * 1024 / _block_bytes);
+    _cache.reset(new BlockCache(_block_bytes, capacity, cache_file));
+    diskann::cout << "Opened the remote index of " << fname << ", " << _size << " bytes, with a " << cache_mb
+                  << " MB cache " << (cache_file.empty() ? "in RAM" : "in " + cache_file) << std::endl;
+}
+
+void RemoteAlignedFileReader::close()
+{
+    _cache.reset();
+    _url.clear();
+    _size = 0;
+}
+
+void RemoteAlignedFileReader::fetch(Session *session, std::vector<Run> &runs)
+{
+    std::vector<Transfer> transfers(runs.size());
+    std::vector<uint64_t> pending;
+    for (uint64_t r = 0; r < runs.size(); r++)
+    {
+        const uint64_t offset = runs[r].first * _block_bytes;
+        runs[r].data.resize((std::min)(runs[r].count * _block_bytes, _size - offset));
+        pending.push_back(r);
+    }
+    while (session->handles.size() < runs.size())
+    {
+        CURL *handle = curl_easy_init();
+        if (handle == nullptr)
+            throw diskann::ANNException("curl_easy_init() failed", -1, __FUNCSIG__, __FILE__, __LINE__);
+        session->handles.push_back(handle);
+    }
+
+    for (uint32_t attempt = 1; !pending.empty(); attempt++)
+    {
+        for (uint64_t j = 0; j < pending.size(); j++)
+        {
+            Run &run = runs[pending[j]];
+            Transfer &t = transfers[pending[j]];
+            t = {run.data.data(), run.data.size(), 0, 0};
+            prepare_get(session->handles[j], _url, run.first * _block_bytes, t);
+            curl_multi_add_handle(session->multi, session->handles[j]);
+        }
+
+        int running = 1;
+        CURLMcode mc = CURLM_OK;
+        while (running > 0 && mc == CURLM_OK)
+        {
+            mc = curl_multi_perform(session->multi, &running);
+            if (mc == CURLM_OK && running > 0)
+                mc = curl_multi_poll(session->multi, nullptr, 0, 1000, nullptr);
+        }
+
+        std::vector<uint64_t> failed;
+        std::string error;
+        CURLMsg *msg;
+        int left;
+        while (mc == CURLM_OK && (msg = curl_multi_info_read(session->multi, &left)) != nullptr)
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            char *priv = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+            Transfer *t = (Transfer *)priv;
+            std::string get = get_error(msg->easy_handle, msg->data.result, *t);
+            if (!get.empty())
+            {
+                failed.push_back((uint64_t)(t - transfers.data()));
+                error = get;
+            }
+        }
+        for (uint64_t j = 0; j < pending.size(); j++)
+            curl_multi_remove_handle(session->multi, session->handles[j]);
+
+        if (mc != CURLM_OK)
+        {
+            throw diskann::ANNException(std::string("curl_multi_perform() failed: ") + curl_multi_strerror(mc), -1,
+                                        __FUNCSIG__, __FILE__, __LINE__);
+        }
+        if (!failed.empty() && attempt == REMOTE_GET_ATTEMPTS)
+        {
+            throw diskann::ANNException("Ranged GET of the remote index failed " + std::to_string(attempt) +
+                                            " times: " + error,
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        if (!failed.empty())
+            diskann::cerr << "Retrying " << failed.size() << " ranged GETs: " << error << std::endl;
+        pending.swap(failed);
+    }
+}
+
+void RemoteAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
+{
+    // the parts of the requests, one per block they touch, the cache missed
+    struct Miss
+    {
+        uint64_t block;
+        uint64_t offset; // in the block
+        uint64_t len;
+        char *dst;
+    };
+    std::vector<Miss> misses;
+    for (AlignedRead &req : read_reqs)
+    {
+        if (req.offset + req.len > _size)
+        {
+            throw diskann::ANNException("Read of " + std::to_string(req.len) + " bytes at " +
+                                            std::to_string(req.offset) + " is past the end of the remote index",
+                                        -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        uint64_t offset = req.offset;
+        uint64_t left = req.len;
+        char *dst = (char *)req.buf;
+        while (left > 0)
+        {
+            const uint64_t block = offset / _block_bytes;
+            const uint64_t in_block = offset % _block_bytes;
+            const uint64_t len = (std::min)(left, _block_bytes - in_block);
+            if (!_cache->copy(block, in_block, len, dst))
+                misses.push_back({block, in_block, len, dst});
+            offset += len;
+            dst += len;
+            left -= len;
+        }
+    }
+    if (misses.empty())
+        return;
+
+    // one GET per run of missed blocks, each extended by the readahead;
+    // misses the readahead of a run reaches join it
+    std::vector<uint64_t> blocks;
+    for (const Miss &miss : misses)
+        blocks.push_back(miss.block);
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    std::vector<Run> runs;
+    for (uint64_t block : blocks)
+    {
+        if (!runs.empty() && block <= runs.back().first + runs.back().count + _readahead_blocks)
+            runs.back().count = block - runs.back().first + 1;
+        else
+            runs.push_back({block, 1, {}});
+    }
+    const uint64_t num_blocks = DIV_ROUND_UP(_size, _block_bytes);
+    for (Run &run : runs)
+        run.count = (std::min)(run.count + _readahead_blocks, num_blocks - run.first);
+
+    fetch(to_session(ctx), runs);
+
+    for (const Miss &miss : misses)
+    {
+        auto run = std::upper_bound(runs.begin(), runs.end(), miss.block,
+                                    [](uint64_t block, const Run &r) { return block < r.first; }) -
+                   1;
+        memcpy(miss.dst, run->data.data() + (miss.block - run->first) * _block_bytes + miss.offset, miss.len);
+    }
+    for (const Run &run : runs)
+    {
+        for (uint64_t b = 0; b < run.count; b++)
+        {
+            const uint64_t at = b * _block_bytes;
+            _cache->insert(run.first + b, run.data.data() + at, (std::min)(_block_bytes, run.data.size() - at));
+        }
+    }
+}
@@ -1,10 +1,14 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <cmath>
 #include <ctime>
+#include <algorithm>
 #include <iomanip>
+#include <limits>
 #include <omp.h>
 
+#include "memory_policy.h"
 #include "utils.h"
 #include <restapi/search_wrapper.h>
 
@@ -13,6 +17,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include "linux_aligned_file_reader.h"
+#include "striped_aligned_file_reader.h"
+#ifdef USE_REMOTE_STORAGE
+#include "remote_aligned_file_reader.h"
+#endif
 #else
 #ifdef USE_BING_INFRA
 #include "bing_aligned_file_reader.h"
@@ -50,6 +58,261 @@ SearchResult::SearchResult(unsigned int K, unsigned int elapsed_time_in_ms, cons
         this->_partitions_enabled = false;
 }
 
+QueryResultCache::QueryResultCache(const ResultCacheParameters &params) : _params(params)
+{
+    if (_params.num_shards == 0)
+        _params.num_shards = 1;
+    _shard_capacity = std::max<size_t>(1, DIV_ROUND_UP(_params.capacity, _params.num_shards));
+    for (uint32_t i = 0; i < _params.num_shards; i++)
+        _shards.emplace_back(new Shard());
+}
+
+template <typename T>
+std::string QueryResultCache::make_key(const T *query, const unsigned int dimensions, const unsigned int K,
+                                       const unsigned int Ls) const
+{
+    std::string key;
+    key.append((const char *)&K, sizeof(K));
+    key.append((const char *)&Ls, sizeof(Ls));
+    if (_params.quantization_step <= 0)
+    {
+        key.append((const char *)query, dimensions * sizeof(T));
+        return key;
+    }
+    for (unsigned int d = 0; d < dimensions; d++)
+    {
+        const int64_t level = (int64_t)std::floor((float)query[d] / _params.quantization_step + 0.5f);
+        key.append((const char *)&level, sizeof(level));
+    }
+    return key;
+}
+
+QueryResultCache::Shard &QueryResultCache::shard_of(const std::string &key)
+{
+    return *_shards[std::hash<std::string>()(key) % _shards.size()];
+}
+
+std::shared_ptr<const SearchResult> QueryResultCache::lookup(const std::string &key)
+{
+    Shard &shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto iter = shard.entries.find(key);
+    if (iter == shard.entries.end())
+    {
+        _misses++;
+        return nullptr;
+    }
+    if (_params.ttl_seconds != 0 && Clock::now() - iter->second->inserted > std::chrono::seconds(_params.ttl_seconds))
+    {
+        shard.lru.erase(iter->second);
+        shard.entries.erase(iter);
+        _misses++;
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    _hits++;
+    return iter->second->result;
+}
+
+void QueryResultCache::insert(const std::string &key, std::shared_ptr<const SearchResult> result)
+{
+    Shard &shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto iter = shard.entries.find(key);
+    if (iter != shard.entries.end())
+    {
+        shard.lru.erase(iter->second);
+        shard.entries.erase(iter);
+    }
+    shard.lru.push_front(Entry{key, std::move(result), Clock::now()});
+    shard.entries[key] = shard.lru.begin();
+    while (shard.lru.size() > _shard_capacity)
+    {
+        shard.entries.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+    }
+}
+
+void QueryResultCache::clear()
+{
+    for (auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        shard->lru.clear();
+        shard->entries.clear();
+    }
+}
+
+template <typename T>
+SearchBatcher<T>::SearchBatcher(const BatchingParameters &params, BatchFn batch_fn)
+    : _params(params), _batch_fn(std::move(batch_fn))
+{
+    _params.max_batch_size = std::max(_params.max_batch_size, 1u);
+    _params.num_dispatchers = std::max(_params.num_dispatchers, 1u);
+    for (uint32_t i = 0; i < _params.num_dispatchers; i++)
+        _dispatchers.emplace_back([this]() { dispatch(); });
+}
+
+template <typename T> SearchBatcher<T>::~SearchBatcher()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+    }
+    _arrived.notify_all();
+    for (auto &dispatcher : _dispatchers)
+        dispatcher.join();
+}
+
+template <typename T>
+void SearchBatcher<T>::search(const T *query, const unsigned int dimensions, const unsigned int K,
+                              const unsigned int Ls, uint64_t *ids, float *distances)
+{
+    Request request;
+    request.query = query;
+    request.dimensions = dimensions;
+    request.K = K;
+    request.Ls = Ls;
+    request.ids = ids;
+    request.distances = distances;
+
+    std::unique_lock<std::mutex> guard(_lock);
+    _queue.push_back(&request);
+    _arrived.notify_all();
+    _finished.wait(guard, [&request]() { return request.done; });
+    if (request.error != nullptr)
+        std::rethrow_exception(request.error);
+}
+
+template <typename T> void SearchBatcher<T>::dispatch()
+{
+    std::vector<Request *> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _arrived.wait(guard, [this]() { return _stopping || !_queue.empty(); });
+            if (_queue.empty())
+                return;
+            // the first query waits at most max_wait_us for the batch to fill
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(_params.max_wait_us);
+            _arrived.wait_until(guard, deadline,
+                                [this]() { return _stopping || _queue.size() >= _params.max_batch_size; });
+            const size_t count = std::min(_queue.size(), (size_t)_params.max_batch_size);
+            batch.assign(_queue.begin(), _queue.begin() + count);
+            _queue.erase(_queue.begin(), _queue.begin() + count);
+        }
+
+        // one batched search per dimensions, K and Ls
+        auto key = [](const Request *r) { return std::make_tuple(r->dimensions, r->K, r->Ls); };
+        std::sort(batch.begin(), batch.end(), [&key](const Request *a, const Request *b) { return key(a) < key(b); });
+        for (size_t begin = 0; begin < batch.size();)
+        {
+            size_t end = begin + 1;
+            while (end < batch.size() && key(batch[end]) == key(batch[begin]))
+                end++;
+            search_group(batch.data() + begin, batch.data() + end);
+            begin = end;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (auto request : batch)
+                request->done = true;
+        }
+        _finished.notify_all();
+    }
+}
+
+template <typename T> void SearchBatcher<T>::search_group(Request **first, Request **last)
+{
+    const size_t num_queries = last - first;
+    const Request &head = **first;
+    const size_t stride = ROUND_UP(head.dimensions, 8);
+    try
+    {
+        std::vector<T> queries(num_queries * stride, 0);
+        std::vector<uint64_t> ids(num_queries * head.K);
+        std::vector<float> distances(num_queries * head.K);
+        for (size_t i = 0; i < num_queries; i++)
+            std::memcpy(queries.data() + i * stride, first[i]->query, head.dimensions * sizeof(T));
+        _batch_fn(queries.data(), num_queries, stride, head.K, head.Ls, ids.data(), distances.data());
+        for (size_t i = 0; i < num_queries; i++)
+        {
+            std::copy(ids.begin() + i * head.K, ids.begin() + (i + 1) * head.K, first[i]->ids);
+            std::copy(distances.begin() + i * head.K, distances.begin() + (i + 1) * head.K, first[i]->distances);
+        }
+    }
+    catch (...)
+    {
+        for (size_t i = 0; i < num_queries; i++)
+            first[i]->error = std::current_exception();
+    }
+}
+
+UpdateQueue::UpdateQueue()
+{
+    _worker = std::thread([this]() { run(); });
+}
+
+UpdateQueue::~UpdateQueue()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+    }
+    _queued.notify_all();
+    _worker.join();
+}
+
+uint64_t UpdateQueue::submit(ApplyFn apply)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _pending.push_back(std::move(apply));
+    _queued.notify_all();
+    return ++_status.queued;
+}
+
+UpdateStatus UpdateQueue::get_status()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _status;
+}
+
+void UpdateQueue::run()
+{
+    while (true)
+    {
+        ApplyFn apply;
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _queued.wait(guard, [this]() { return _stopping || !_pending.empty(); });
+            if (_pending.empty())
+                return;
+            apply = std::move(_pending.front());
+            _pending.pop_front();
+        }
+
+        UpdateStatus delta;
+        try
+        {
+            apply(delta);
+        }
+        catch (const std::exception &ex)
+        {
+            diskann::cerr << "Update batch " << _status.applied + 1 << " failed: " << ex.what() << std::endl;
+            delta.failed_batches++;
+        }
+
+        std::lock_guard<std::mutex> guard(_lock);
+        _status.applied++;
+        _status.failed_batches += delta.failed_batches;
+        _status.inserted += delta.inserted;
+        _status.deleted += delta.deleted;
+        _status.rejected += delta.rejected;
+    }
+}
+
 BaseSearch::BaseSearch(const std::string &tagsFile)
 {
     if (tagsFile.size() != 0)
@@ -93,29 +356,149 @@ void BaseSearch::lookup_tags(const unsigned K, const unsigned *indices, std::str
     }
 }
 
+void BaseSearch::enable_result_cache(const ResultCacheParameters &params)
+{
+    if (params.capacity == 0)
+    {
+        _result_cache.reset();
+        return;
+    }
+    _result_cache.reset(new QueryResultCache(params));
+    std::cout << "Caching up to " << params.capacity << " search results" << std::endl;
+}
+
+void BaseSearch::invalidate_result_cache()
+{
+    if (_result_cache != nullptr)
+        _result_cache->clear();
+}
+
+template <typename T, typename SearchFn>
+SearchResult BaseSearch::cached_search(const T *query, const unsigned int dimensions, const unsigned int K,
+                                       const unsigned int Ls, SearchFn &&search_fn)
+{
+    bool exact = true;
+    if (_result_cache == nullptr)
+        return search_fn(exact);
+
+    const std::string key = _result_cache->make_key(query, dimensions, K, Ls);
+    auto cached = _result_cache->lookup(key);
+    if (cached != nullptr)
+        return *cached;
+    auto result = std::make_shared<const SearchResult>(search_fn(exact));
+    // a search cut short by admission control or its budget is not kept
+    if (exact)
+        _result_cache->insert(key, result);
+    return *result;
+}
+
+BaseSearch::AdmissionTicket::AdmissionTicket(BaseSearch &search, const unsigned int K, const unsigned int Ls)
+    : Ls(Ls), _search(search)
+{
+    const uint32_t in_flight = ++_search._in_flight;
+    const AdmissionParameters &params = _search._admission;
+    if (params.max_in_flight != 0 && in_flight > params.max_in_flight)
+    {
+        --_search._in_flight;
+        throw SearchOverloadedException();
+    }
+    if (params.degrade_in_flight != 0 && in_flight > params.degrade_in_flight)
+        this->Ls = std::max(K, (unsigned int)((uint64_t)Ls * params.degrade_in_flight / in_flight));
+}
+
+BaseSearch::AdmissionTicket::~AdmissionTicket()
+{
+    --_search._in_flight;
+}
+
 template <typename T>
 InMemorySearch<T>::InMemorySearch(const std::string &baseFile, const std::string &indexFile,
-                                  const std::string &tagsFile, Metric m, uint32_t num_threads, uint32_t search_l)
+                                  const std::string &tagsFile, Metric m, uint32_t num_threads, uint32_t search_l,
+                                  const UpdateParameters &update_params)
     : BaseSearch(tagsFile)
 {
     size_t dimensions, total_points = 0;
     diskann::get_bin_metadata(baseFile, total_points, dimensions);
-    auto search_params = diskann::IndexSearchParams(search_l, num_threads);
-    _index = std::unique_ptr<diskann::Index<T>>(
-        new diskann::Index<T>(m, dimensions, total_points, nullptr, search_params, 0, false));
+    _dimensions = (unsigned int)dimensions;
+    auto search_params = std::make_shared<diskann::IndexSearchParams>(search_l, num_threads);
+    if (update_params.max_points == 0)
+    {
+        _index = std::unique_ptr<diskann::Index<T>>(
+            new diskann::Index<T>(m, dimensions, total_points, nullptr, search_params, 0, false));
+        _index->load(indexFile.c_str(), num_threads, search_l);
+        return;
+    }
 
+    if (!tagsFile.empty())
+        throw ANNException("An index that takes updates returns its own tags; do not pass a tags file", -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    if (update_params.max_points < total_points)
+        throw ANNException("The index has " + std::to_string(total_points) + " points, more than max_points " +
+                               std::to_string(update_params.max_points),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    const uint32_t insert_threads = update_params.num_threads != 0 ? update_params.num_threads : omp_get_num_procs();
+    _write_params = std::make_shared<IndexWriteParameters>(
+        IndexWriteParametersBuilder(update_params.insert_l, update_params.max_degree)
+            .with_alpha(update_params.alpha)
+            .with_num_threads(insert_threads)
+            .build());
+    _consolidate_after = update_params.consolidate_after;
+    const size_t num_frozen_pts = Index<T>::get_graph_num_frozen_points(indexFile);
+    _index = std::unique_ptr<diskann::Index<T>>(new diskann::Index<T>(m, dimensions, update_params.max_points,
+                                                                      _write_params, search_params, num_frozen_pts,
+                                                                      true, true, true));
     _index->load(indexFile.c_str(), num_threads, search_l);
+    _index->enable_delete();
+    _updates.reset(new UpdateQueue());
+    std::cout << "Taking updates of up to " << update_params.max_points << " points" << std::endl;
 }
 
 template <typename T>
 SearchResult InMemorySearch<T>::search(const T *query, const unsigned int dimensions, const unsigned int K,
-                                       const unsigned int Ls)
+                                       const unsigned int Ls, const unsigned int budget_ms)
+{
+    return cached_search(query, dimensions, K, Ls,
+                         [&](bool &exact) { return search_index(query, dimensions, K, Ls, budget_ms, exact); });
+}
+
+template <typename T>
+SearchResult InMemorySearch<T>::search_index(const T *query, const unsigned int dimensions, const unsigned int K,
+                                             const unsigned int Ls, const unsigned int budget_ms, bool &exact)
 {
+    AdmissionTicket ticket(*this, K, Ls);
+    unsigned int L = ticket.Ls;
+    if (budget_ms != 0)
+        L = std::min(L, std::max(K, (unsigned int)(budget_ms * 1000.0f / _us_per_l.load())));
+    exact = L == Ls;
+
     unsigned int *indices = new unsigned int[K];
     float *distances = new float[K];
 
     auto startTime = std::chrono::high_resolution_clock::now();
-    _index->search(query, K, Ls, indices, distances);
+    unsigned int count = K;
+    if (_updates != nullptr)
+    {
+        // the tags of the points, which do not move as points come and go
+        std::vector<T *> no_vectors;
+        count = (unsigned int)_index->search_with_tags(query, K, L, indices, distances, no_vectors);
+    }
+    else if (_batcher != nullptr)
+    {
+        std::vector<uint64_t> indices_u64(K);
+        _batcher->search(query, dimensions, K, L, indices_u64.data(), distances);
+        for (unsigned k = 0; k < K; ++k)
+            indices[k] = (unsigned)indices_u64[k];
+    }
+    if (_batcher == nullptr)
+    {
+        if (_updates == nullptr)
+            _index->search(query, K, L, indices, distances);
+        // batched searches also wait for their batch, so only these count
+        const float elapsed_us = (float)std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::high_resolution_clock::now() - startTime)
+                                     .count();
+        _us_per_l.store(0.9f * _us_per_l.load() + 0.1f * std::max(elapsed_us / L, 0.01f));
+    }
     auto duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime)
             .count();
@@ -127,63 +510,234 @@ SearchResult InMemorySearch<T>::search(const T *query, const unsigned int dimens
         lookup_tags(K, indices, tags);
     }
 
-    SearchResult result(K, (unsigned int)duration, indices, distances, tags);
+    SearchResult result(count, (unsigned int)duration, indices, distances, tags);
 
     delete[] indices;
     delete[] distances;
     return result;
 }
 
+template <typename T> void InMemorySearch<T>::enable_batching(const BatchingParameters &params)
+{
+    _batcher.reset();
+    if (params.max_batch_size <= 1)
+        return;
+    if (_updates != nullptr)
+    {
+        std::cout << "Not batching searches of an index that takes updates" << std::endl;
+        return;
+    }
+    const uint32_t interleave = std::min(params.max_batch_size, 8u);
+    _batcher.reset(new SearchBatcher<T>(params, [this, interleave](const T *queries, size_t num_queries,
+                                                                   size_t stride, unsigned int K, unsigned int Ls,
+                                                                   uint64_t *ids, float *distances) {
+        _index->batch_search(queries, num_queries, stride, K, Ls, ids, distances, 1, interleave);
+    }));
+}
+
+template <typename T> bool InMemorySearch<T>::collect_memory_usage(MemoryUsage &usage)
+{
+    usage.add(_index->get_memory_usage());
+    return true;
+}
+
+template <typename T>
+uint64_t InMemorySearch<T>::queue_insert(const T *vectors, const uint32_t *tags, const size_t num_points,
+                                         const unsigned int dimensions)
+{
+    if (_updates == nullptr)
+        return BaseSearch::queue_insert(vectors, tags, num_points, dimensions);
+    if (dimensions != _dimensions)
+        throw std::invalid_argument("Points have " + std::to_string(dimensions) + " dimensions, the index has " +
+                                    std::to_string(_dimensions));
+
+    auto points = std::make_shared<std::vector<T>>(vectors, vectors + num_points * dimensions);
+    auto point_tags = std::make_shared<std::vector<uint32_t>>(tags, tags + num_points);
+    return _updates->submit([this, points, point_tags](UpdateStatus &delta) {
+        std::vector<int> retvals;
+        const size_t inserted = _index->insert_points(points->data(), point_tags->data(), point_tags->size(), retvals);
+        delta.inserted += inserted;
+        delta.rejected += point_tags->size() - inserted;
+        invalidate_result_cache();
+    });
+}
+
+template <typename T> uint64_t InMemorySearch<T>::queue_delete(std::vector<uint32_t> tags)
+{
+    if (_updates == nullptr)
+        return BaseSearch::queue_delete(std::move(tags));
+
+    auto delete_tags = std::make_shared<std::vector<uint32_t>>(std::move(tags));
+    return _updates->submit([this, delete_tags](UpdateStatus &delta) {
+        std::vector<uint32_t> failed_tags;
+        _index->lazy_delete(*delete_tags, failed_tags);
+        const size_t deleted = delete_tags->size() - failed_tags.size();
+        delta.deleted += deleted;
+        delta.rejected += failed_tags.size();
+        invalidate_result_cache();
+
+        _unconsolidated += deleted;
+        if (_consolidate_after != 0 && _unconsolidated >= _consolidate_after)
+        {
+            _index->consolidate_deletes(*_write_params);
+            _unconsolidated = 0;
+        }
+    });
+}
+
+template <typename T> bool InMemorySearch<T>::get_update_status(UpdateStatus &status)
+{
+    if (_updates == nullptr)
+        return false;
+    status = _updates->get_status();
+    return true;
+}
+
 template <typename T> InMemorySearch<T>::~InMemorySearch()
 {
 }
 
 template <typename T>
 PQFlashSearch<T>::PQFlashSearch(const std::string &indexPrefix, const unsigned num_nodes_to_cache,
-                                const unsigned num_threads, const std::string &tagsFile, Metric m)
+                                const unsigned num_threads, const std::string &tagsFile, Metric m,
+                                const bool numa_replicas, const bool lazy_load,
+                                std::shared_ptr<SSDSearchHost<T>> host, const uint64_t memory_quota)
     : BaseSearch(tagsFile)
 {
+    if (host != nullptr && numa_replicas)
+        throw ANNException("NUMA replicas cannot share the scratch of a search host", -1, __FUNCSIG__, __FILE__,
+                           __LINE__);
+
+    std::string index_prefix_path(indexPrefix);
+    std::string disk_index_file = index_prefix_path + "_disk.index";
+    std::string warmup_query_file = index_prefix_path + "_sample_data.bin";
+
+    // every replica is loaded, and its cache read, by a thread pinned to its
+    // node, so that its buffers and scratch space are local to the node
+    auto load_replica = [&](uint32_t replica) {
+        std::shared_ptr<AlignedFileReader> reader;
 #ifdef _WINDOWS
 #ifndef USE_BING_INFRA
-    reader.reset(new WindowsAlignedFileReader());
+        reader.reset(new WindowsAlignedFileReader());
 #else
-    reader.reset(new diskann::BingAlignedFileReader());
+        reader.reset(new diskann::BingAlignedFileReader());
 #endif
 #else
-    auto ptr = new LinuxAlignedFileReader();
-    reader.reset(ptr);
+        if (StripedAlignedFileReader::is_striped(disk_index_file))
+            reader.reset(new StripedAlignedFileReader());
+        else
+            reader.reset(new LinuxAlignedFileReader());
+#ifdef USE_REMOTE_STORAGE
+        // an index in an object store is fetched from there
+        if (RemoteAlignedFileReader::is_remote(disk_index_file))
+            reader.reset(new RemoteAlignedFileReader());
 #endif
+#endif
+        _replicas[replica] = std::unique_ptr<diskann::PQFlashIndex<T>>(new diskann::PQFlashIndex<T>(reader, m));
+        _replicas[replica]->set_lazy_load(lazy_load);
+        if (host != nullptr)
+            _replicas[replica]->set_search_host(host);
 
-    std::string index_prefix_path(indexPrefix);
-    std::string disk_index_file = index_prefix_path + "_disk.index";
-    std::string warmup_query_file = index_prefix_path + "_sample_data.bin";
+        int res = _replicas[replica]->load(num_threads, index_prefix_path.c_str());
 
-    _index = std::unique_ptr<diskann::PQFlashIndex<T>>(new diskann::PQFlashIndex<T>(reader, m));
+        if (res != 0)
+        {
+            std::cerr << "Unable to load index. Status code: " << res << "." << std::endl;
+        }
 
-    int res = _index->load(num_threads, index_prefix_path.c_str());
+        auto *index = _replicas[replica].get();
+        uint32_t num_nodes = num_nodes_to_cache;
+        if (memory_quota > 0)
+        {
+            const uint64_t used = index->get_memory_usage().total();
+            if (used > memory_quota)
+                throw ANNException("Index " + index_prefix_path + " needs " + std::to_string(used) +
+                                       " bytes, over its quota of " + std::to_string(memory_quota),
+                                   -1, __FUNCSIG__, __FILE__, __LINE__);
+            const uint64_t fits = (memory_quota - used) / index->get_cache_bytes_per_node();
+            if (fits < num_nodes)
+            {
+                std::cout << "Caching " << fits << " nodes instead of " << num_nodes << " to fit the quota of "
+                          << memory_quota << " bytes" << std::endl;
+                num_nodes = (uint32_t)fits;
+            }
+        }
 
-    if (res != 0)
+        std::cout << "Caching " << num_nodes << " BFS nodes around medoid(s)" << std::endl;
+        if (lazy_load)
+        {
+            // the thread inherits the replica's NUMA pinning
+            index->load_cache_list_async([index, num_nodes](std::vector<uint32_t> &node_list) {
+                index->cache_bfs_levels(num_nodes, node_list);
+            });
+        }
+        else
+        {
+            std::vector<uint32_t> node_list;
+            index->cache_bfs_levels(num_nodes, node_list);
+            index->load_cache_list(node_list);
+        }
+        _replicas[replica]->set_collect_metrics(true);
+        _replicas[replica]->reader->enable_io_metrics();
+    };
+
+    if (numa_replicas && diskann::get_num_numa_nodes() > 1)
     {
-        std::cerr << "Unable to load index. Status code: " << res << "." << std::endl;
+        _replicas.resize(diskann::get_num_numa_nodes());
+        std::cout << "Loading one replica of the index on each of " << _replicas.size() << " NUMA nodes"
+                  << std::endl;
+        diskann::run_on_each_numa_node(load_replica);
+    }
+    else
+    {
+        _replicas.resize(1);
+        load_replica(0);
     }
-
-    std::vector<uint32_t> node_list;
-    std::cout << "Caching " << num_nodes_to_cache << " BFS nodes around medoid(s)" << std::endl;
-    _index->cache_bfs_levels(num_nodes_to_cache, node_list);
-    _index->load_cache_list(node_list);
     omp_set_num_threads(num_threads);
 }
 
 template <typename T>
 SearchResult PQFlashSearch<T>::search(const T *query, const unsigned int dimensions, const unsigned int K,
-                                      const unsigned int Ls)
+                                      const unsigned int Ls, const unsigned int budget_ms)
+{
+    return cached_search(query, dimensions, K, Ls,
+                         [&](bool &exact) { return search_index(query, dimensions, K, Ls, budget_ms, exact); });
+}
+
+template <typename T>
+SearchResult PQFlashSearch<T>::search_index(const T *query, const unsigned int dimensions, const unsigned int K,
+                                            const unsigned int Ls, const unsigned int budget_ms, bool &exact)
 {
+    AdmissionTicket ticket(*this, K, Ls);
+    exact = ticket.Ls == Ls;
+
     uint64_t *indices_u64 = new uint64_t[K];
     unsigned *indices = new unsigned[K];
     float *distances = new float[K];
 
     auto startTime = std::chrono::high_resolution_clock::now();
-    _index->cached_beam_search(query, K, Ls, indices_u64, distances, DEFAULT_W);
+    if (_batcher != nullptr)
+    {
+        _batcher->search(query, dimensions, K, ticket.Ls, indices_u64, distances);
+    }
+    else
+    {
+        uint32_t io_limit = std::numeric_limits<uint32_t>::max();
+        if (budget_ms != 0)
+            io_limit = std::max(1u, (uint32_t)(budget_ms * 1000.0f / _us_per_io.load()));
+        QueryStats stats;
+        auto &index = _replicas[diskann::get_current_numa_node() % _replicas.size()];
+        index->cached_beam_search(query, K, ticket.Ls, indices_u64, distances, DEFAULT_W, io_limit, false, &stats);
+        if (stats.n_ios >= io_limit)
+            exact = false;
+        if (stats.n_ios > 0)
+        {
+            const float elapsed_us = (float)std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::high_resolution_clock::now() - startTime)
+                                         .count();
+            _us_per_io.store(0.9f * _us_per_io.load() + 0.1f * elapsed_us / stats.n_ios);
+        }
+    }
     auto duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime)
             .count();
@@ -203,10 +757,56 @@ SearchResult PQFlashSearch<T>::search(const T *query, const unsigned int dimensi
     return result;
 }
 
+template <typename T> void PQFlashSearch<T>::enable_batching(const BatchingParameters &params)
+{
+    _batcher.reset();
+    if (params.max_batch_size <= 1)
+        return;
+    _batcher.reset(new SearchBatcher<T>(params, [this](const T *queries, size_t num_queries, size_t stride,
+                                                       unsigned int K, unsigned int Ls, uint64_t *ids,
+                                                       float *distances) {
+        auto &index = _replicas[diskann::get_current_numa_node() % _replicas.size()];
+        index->batch_cached_beam_search(queries, num_queries, stride, K, Ls, ids, distances, DEFAULT_W);
+    }));
+}
+
+template <typename T> bool PQFlashSearch<T>::collect_metrics(SearchMetrics &metrics) const
+{
+    for (auto &replica : _replicas)
+        metrics.add(replica->get_metrics());
+    return true;
+}
+
+template <typename T> bool PQFlashSearch<T>::collect_io_metrics(IOMetrics &metrics) const
+{
+    bool sampled = false;
+    for (auto &replica : _replicas)
+    {
+        const IOMetrics *replica_metrics = replica->reader->get_io_metrics();
+        if (replica_metrics != nullptr)
+        {
+            metrics.add(*replica_metrics);
+            sampled = true;
+        }
+    }
+    return sampled;
+}
+
+template <typename T> bool PQFlashSearch<T>::collect_memory_usage(MemoryUsage &usage)
+{
+    for (auto &replica : _replicas)
+        usage.add(replica->get_memory_usage());
+    return true;
+}
+
 template <typename T> PQFlashSearch<T>::~PQFlashSearch()
 {
 }
 
+template class SearchBatcher<float>;
+template class SearchBatcher<int8_t>;
+template class SearchBatcher<uint8_t>;
+
 template class InMemorySearch<float>;
 template class InMemorySearch<int8_t>;
 template class InMemorySearch<uint8_t>;
@@ -6,26 +6,37 @@
 #include <iomanip>
 #include <string>
 #include <cstdlib>
+#include <cstring>
 #include <codecvt>
 #include <limits>
+#include <queue>
+#include <sstream>
 
 #include <restapi/server.h>
 
+#include "async_logger.h"
+
 namespace diskann
 {
 
 Server::Server(web::uri &uri, std::vector<std::unique_ptr<diskann::BaseSearch>> &multi_searcher,
-               const std::string &typestring)
-    : _multi_search(multi_searcher.size() > 1 ? true : false)
+               const std::string &typestring, const unsigned shard_threads, const unsigned shard_deadline_ms)
+    : _multi_search(multi_searcher.size() > 1 ? true : false), _shard_deadline_ms(shard_deadline_ms)
 {
     for (auto &searcher : multi_searcher)
         _multi_searcher.push_back(std::move(searcher));
+    if (_multi_search)
+    {
+        const unsigned num_threads = shard_threads != 0 ? shard_threads : std::thread::hardware_concurrency();
+        _shard_pool.reset(new ShardPool(std::max(num_threads, 1u)));
+    }
 
     _listener = std::unique_ptr<web::http::experimental::listener::http_listener>(
         new web::http::experimental::listener::http_listener(uri));
     if (typestring == std::string("float"))
     {
-        _listener->support(std::bind(&Server::handle_post<float>, this, std::placeholders::_1));
+        _listener->support(web::http::methods::POST,
+                           std::bind(&Server::handle_post<float>, this, std::placeholders::_1));
     }
     else if (typestring == std::string("int8_t"))
     {
@@ -41,6 +52,7 @@ Server::Server(web::uri &uri, std::vector<std::unique_ptr<diskann::BaseSearch>>
     {
         throw "Unsupported type in server constuctor";
     }
+    _listener->support(web::http::methods::GET, std::bind(&Server::handle_get, this, std::placeholders::_1));
 }
 
 Server::~Server()
@@ -56,61 +68,239 @@ pplx::task<void> Server::close()
     return _listener->close();
 }
 
-diskann::SearchResult Server::aggregate_results(const unsigned K, const std::vector<diskann::SearchResult> &results)
+diskann::SearchResult Server::aggregate_results(const unsigned K,
+                                                const std::vector<const diskann::SearchResult *> &results)
 {
-    if (_multi_search)
+    if (!_multi_search)
+        return *results[0];
+
+    auto best_indices = new unsigned[K];
+    auto best_distances = new float[K];
+    auto best_partitions = new unsigned[K];
+    bool tags_enabled = false;
+    for (auto result : results)
+        tags_enabled = tags_enabled || (result != nullptr && result->tags_enabled());
+    auto best_tags = tags_enabled ? new std::string[K] : nullptr;
+
+    // k-way merge of the sorted results of the shards: the heap holds the
+    // next result of each shard
+    using Head = std::pair<float, std::pair<unsigned, size_t>>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    unsigned int max_time = 0;
+    for (unsigned i = 0; i < results.size(); ++i)
     {
-        auto best_indices = new unsigned[K];
-        auto best_distances = new float[K];
-        auto best_partitions = new unsigned[K];
-        auto best_tags = results[0].tags_enabled() ? new std::string[K] : nullptr;
+        if (results[i] == nullptr)
+            continue;
+        max_time = std::max(max_time, results[i]->get_time());
+        if (!results[i]->get_distances().empty())
+            heads.push(Head(results[i]->get_distances()[0], std::make_pair(i, (size_t)0)));
+    }
 
-        auto numsearchers = _multi_searcher.size();
-        std::vector<size_t> pos(numsearchers, 0);
+    unsigned count = 0;
+    while (count < K && !heads.empty())
+    {
+        const unsigned partition = heads.top().second.first;
+        const size_t pos = heads.top().second.second;
+        heads.pop();
+        const diskann::SearchResult &result = *results[partition];
+        best_distances[count] = result.get_distances()[pos];
+        best_indices[count] = result.get_indices()[pos];
+        best_partitions[count] = partition;
+        if (best_tags != nullptr && result.tags_enabled())
+            best_tags[count] = result.get_tags()[pos];
+        count++;
+        if (pos + 1 < result.get_distances().size())
+            heads.push(Head(result.get_distances()[pos + 1], std::make_pair(partition, pos + 1)));
+    }
 
-        for (size_t k = 0; k < K; ++k)
-        {
-            float best_distance = std::numeric_limits<float>::max();
-            unsigned best_partition = 0;
+    diskann::SearchResult merged =
+        SearchResult(count, max_time, best_indices, best_distances, best_tags, best_partitions);
+
+    delete[] best_indices;
+    delete[] best_distances;
+    delete[] best_partitions;
+    delete[] best_tags;
+
+    return merged;
+}
+
+template <class T>
+bool Server::search_shards(const T *query, const unsigned dimensions, const unsigned K, const unsigned Ls,
+                           std::vector<std::unique_ptr<diskann::SearchResult>> &results, const unsigned budget_ms)
+{
+    results.clear();
+    if (!_multi_search)
+    {
+        results.emplace_back(
+            new diskann::SearchResult(_multi_searcher[0]->search(query, dimensions, K, Ls, budget_ms)));
+        return true;
+    }
+
+    // shared with the tasks, which may outlive the request if it times out
+    struct Pending
+    {
+        std::mutex lock;
+        std::condition_variable done;
+        std::vector<T> query;
+        std::vector<std::unique_ptr<diskann::SearchResult>> results;
+        std::exception_ptr error;
+        size_t remaining;
+    };
+    auto pending = std::make_shared<Pending>();
+    pending->query.assign(query, query + ROUND_UP(dimensions, 8));
+    pending->results.resize(_multi_searcher.size());
+    pending->remaining = _multi_searcher.size();
 
-            for (size_t i = 0; i < numsearchers; ++i)
+    for (size_t i = 0; i < _multi_searcher.size(); ++i)
+    {
+        diskann::BaseSearch *searcher = _multi_searcher[i].get();
+        _shard_pool->submit([pending, searcher, i, dimensions, K, Ls, budget_ms]() {
+            std::unique_ptr<diskann::SearchResult> result;
+            std::exception_ptr error;
+            try
             {
-                if (results[i].get_distances()[pos[i]] < best_distance)
-                {
-                    best_distance = results[i].get_distances()[pos[i]];
-                    best_partition = i;
-                }
+                result.reset(
+                    new diskann::SearchResult(searcher->search(pending->query.data(), dimensions, K, Ls, budget_ms)));
             }
-            best_distances[k] = best_distance;
-            best_indices[k] = results[best_partition].get_indices()[pos[best_partition]];
-            best_partitions[k] = best_partition;
-            if (results[best_partition].tags_enabled())
-                best_tags[k] = results[best_partition].get_tags()[pos[best_partition]];
-            std::cout << best_partition << " " << pos[best_partition] << std::endl;
-            pos[best_partition]++;
-        }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> guard(pending->lock);
+            pending->results[i] = std::move(result);
+            if (error != nullptr && pending->error == nullptr)
+                pending->error = error;
+            pending->remaining--;
+            pending->done.notify_all();
+        });
+    }
 
-        unsigned int total_time = 0;
-        for (size_t i = 0; i < numsearchers; ++i)
-            total_time += results[i].get_time();
-        diskann::SearchResult result =
-            SearchResult(K, total_time, best_indices, best_distances, best_tags, best_partitions);
+    std::unique_lock<std::mutex> guard(pending->lock);
+    auto all_done = [&]() { return pending->remaining == 0; };
+    if (_shard_deadline_ms == 0)
+        pending->done.wait(guard, all_done);
+    else
+        pending->done.wait_for(guard, std::chrono::milliseconds(_shard_deadline_ms), all_done);
+    if (pending->error != nullptr)
+        std::rethrow_exception(pending->error);
 
-        delete[] best_indices;
-        delete[] best_distances;
-        delete[] best_partitions;
-        delete[] best_tags;
+    // late shards still write into pending, so their slots stay empty
+    bool complete = true;
+    for (auto &result : pending->results)
+    {
+        complete = complete && result != nullptr;
+        results.push_back(std::move(result));
+    }
+    return complete;
+}
 
-        return result;
+void Server::handle_get(web::http::http_request message)
+{
+    if (message.relative_uri().path() == U("/memory"))
+    {
+        handle_get_memory(message);
+        return;
     }
-    else
+    if (message.relative_uri().path() == U("/updates"))
+    {
+        handle_get_updates(message);
+        return;
+    }
+    if (message.relative_uri().path() != U("/metrics"))
+    {
+        message.reply(web::http::status_codes::NotFound);
+        return;
+    }
+
+    // one set of metrics per searcher, labelled with its shard if there are
+    // several
+    std::vector<std::unique_ptr<SearchMetrics>> metrics;
+    std::vector<std::pair<std::string, const SearchMetrics *>> sets;
+    std::vector<std::unique_ptr<IOMetrics>> io_metrics;
+    std::vector<std::pair<std::string, const IOMetrics *>> io_sets;
+    for (size_t i = 0; i < _multi_searcher.size(); i++)
     {
-        return results[0];
+        const std::string labels = _multi_search ? "shard=\"" + std::to_string(i) + "\"" : "";
+        metrics.emplace_back(new SearchMetrics());
+        if (_multi_searcher[i]->collect_metrics(*metrics.back()))
+            sets.emplace_back(labels, metrics.back().get());
+        io_metrics.emplace_back(new IOMetrics());
+        if (_multi_searcher[i]->collect_io_metrics(*io_metrics.back()))
+            io_sets.emplace_back(labels, io_metrics.back().get());
     }
+
+    auto accept = message.headers().find(web::http::header_names::accept);
+    const bool openmetrics = accept != message.headers().end() &&
+                             utility::conversions::to_utf8string(accept->second).find("application/openmetrics-text") !=
+                                 std::string::npos;
+    std::ostringstream body;
+    SearchMetrics::write_text(body, sets, "diskann_search", openmetrics, io_sets.empty());
+    if (!io_sets.empty())
+        IOMetrics::write_text(body, io_sets, "diskann_io", openmetrics);
+    message.reply(web::http::status_codes::OK, body.str(),
+                  openmetrics ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+                              : "text/plain; version=0.0.4; charset=utf-8");
+}
+
+void Server::handle_get_memory(web::http::http_request message)
+{
+    // the usage of the one searcher, or of each shard under "shards"
+    MemoryUsage total;
+    std::vector<std::string> shards;
+    for (auto &searcher : _multi_searcher)
+    {
+        MemoryUsage usage;
+        if (searcher->collect_memory_usage(usage))
+        {
+            total.add(usage);
+            shards.push_back(usage.to_json());
+        }
+    }
+
+    std::string body = total.to_json();
+    if (_multi_search)
+    {
+        body.pop_back();
+        body += ",\"shards\":[";
+        for (size_t i = 0; i < shards.size(); i++)
+            body += (i == 0 ? "" : ",") + shards[i];
+        body += "]}";
+    }
+    message.reply(web::http::status_codes::OK, body, "application/json");
+}
+
+void Server::handle_get_updates(web::http::http_request message)
+{
+    UpdateStatus status;
+    if (_multi_search || !_multi_searcher[0]->get_update_status(status))
+    {
+        message.reply(web::http::status_codes::NotFound);
+        return;
+    }
+    web::json::value response = web::json::value::object();
+    response[U("queued")] = web::json::value::number(status.queued);
+    response[U("applied")] = web::json::value::number(status.applied);
+    response[U("failed_batches")] = web::json::value::number(status.failed_batches);
+    response[U("inserted")] = web::json::value::number(status.inserted);
+    response[U("deleted")] = web::json::value::number(status.deleted);
+    response[U("rejected")] = web::json::value::number(status.rejected);
+    message.reply(web::http::status_codes::OK, response);
 }
 
 template <class T> void Server::handle_post(web::http::http_request message)
 {
+    const auto path = message.relative_uri().path();
+    if (path == U("/insert") || path == U("/delete"))
+    {
+        handle_update<T>(message);
+        return;
+    }
+    if (message.headers().content_type().find(U("application/octet-stream")) == 0)
+    {
+        handle_binary_post<T>(message);
+        return;
+    }
+
     message.extract_string(true)
         .then([=](utility::string_t body) {
             int64_t queryId = -1;
@@ -120,16 +310,29 @@ template <class T> void Server::handle_post(web::http::http_request message)
                 T *queryVector = nullptr;
                 unsigned int dimensions = 0;
                 unsigned int Ls;
-                parseJson(body, K, queryId, queryVector, dimensions, Ls);
+                unsigned int budget_ms;
+                parseJson(body, K, queryId, queryVector, dimensions, Ls, budget_ms);
 
                 auto startTime = std::chrono::high_resolution_clock::now();
-                std::vector<diskann::SearchResult> results;
-
-                for (auto &searcher : _multi_searcher)
-                    results.push_back(searcher->search(queryVector, dimensions, (unsigned int)K, Ls));
-                diskann::SearchResult result = aggregate_results(K, results);
+                std::vector<std::unique_ptr<diskann::SearchResult>> results;
+                bool complete;
+                try
+                {
+                    complete = search_shards(queryVector, dimensions, (unsigned int)K, Ls, results, budget_ms);
+                }
+                catch (...)
+                {
+                    diskann::aligned_free(queryVector);
+                    throw;
+                }
                 diskann::aligned_free(queryVector);
+                std::vector<const diskann::SearchResult *> answered;
+                for (auto &shard_result : results)
+                    answered.push_back(shard_result.get());
+                diskann::SearchResult result = aggregate_results(K, answered);
                 web::json::value response = prepareResponse(queryId, K);
+                if (!complete)
+                    response[PARTIAL_KEY] = web::json::value::boolean(true);
                 response[INDICES_KEY] = idsToJsonArray(result);
                 response[DISTANCES_KEY] = distancesToJsonArray(result);
                 if (result.tags_enabled())
@@ -141,19 +344,26 @@ template <class T> void Server::handle_post(web::http::http_request message)
                                                std::chrono::high_resolution_clock::now() - startTime)
                                                .count();
 
-                std::cout << "Responding to: " << queryId << std::endl;
+                DISKANN_LOG(Debug) << "Responding to: " << queryId;
                 return std::make_pair(web::http::status_codes::OK, response);
             }
+            catch (const diskann::SearchOverloadedException &ex)
+            {
+                DISKANN_LOG_EVERY_MS(Warning, 1000) << "Rejected query: " << queryId << ":" << ex.what();
+                web::json::value response = prepareResponse(queryId, K);
+                response[ERROR_MESSAGE_KEY] = web::json::value::string(ex.what());
+                return std::make_pair(web::http::status_codes::ServiceUnavailable, response);
+            }
             catch (const std::exception &ex)
             {
-                std::cerr << "Exception while processing query: " << queryId << ":" << ex.what() << std::endl;
+                DISKANN_LOG(Error) << "Exception while processing query: " << queryId << ":" << ex.what();
                 web::json::value response = prepareResponse(queryId, K);
                 response[ERROR_MESSAGE_KEY] = web::json::value::string(ex.what());
                 return std::make_pair(web::http::status_codes::InternalError, response);
             }
             catch (...)
             {
-                std::cerr << "Uncaught exception while processing query: " << queryId;
+                DISKANN_LOG(Error) << "Uncaught exception while processing query: " << queryId;
                 web::json::value response = prepareResponse(queryId, K);
                 response[ERROR_MESSAGE_KEY] = web::json::value::string(UNKNOWN_ERROR);
                 return std::make_pair(web::http::status_codes::InternalError, response);
@@ -166,7 +376,215 @@ template <class T> void Server::handle_post(web::http::http_request message)
             }
             catch (const std::exception &ex)
             {
-                std::cerr << "Exception while processing reply: " << ex.what() << std::endl;
+                DISKANN_LOG(Error) << "Exception while processing reply: " << ex.what();
+            };
+        });
+}
+
+template <class T>
+std::vector<unsigned char> Server::search_binary(const std::vector<unsigned char> &request, int64_t &num_queries)
+{
+    BinaryRequestHeader header;
+    if (request.size() < sizeof(header))
+        throw std::invalid_argument("Binary request is shorter than its header.");
+    std::memcpy(&header, request.data(), sizeof(header));
+    num_queries = header.num_queries;
+    if (header.k == 0 || header.k > header.Ls)
+        throw std::invalid_argument("Num of expected NN (k) must be greater than zero and less than or "
+                                    "equal to Ls.");
+    if (header.dimensions == 0)
+        throw std::invalid_argument("Query vector has zero elements.");
+    if (request.size() != sizeof(header) + (size_t)header.num_queries * header.dimensions * sizeof(T))
+        throw std::invalid_argument("Binary request size does not match its number of queries and dimensions.");
+
+    const size_t aligned_dim = ROUND_UP(header.dimensions, 8);
+    T *query = nullptr;
+    diskann::alloc_aligned((void **)&query, aligned_dim * sizeof(T), 8 * sizeof(T));
+    std::memset(query, 0, aligned_dim * sizeof(T));
+
+    std::vector<unsigned char> response(sizeof(BinaryResponseHeader));
+    auto append = [&response](const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        response.insert(response.end(), bytes, bytes + size);
+    };
+    uint32_t flags = 0;
+    try
+    {
+        std::vector<std::unique_ptr<diskann::SearchResult>> results;
+        std::vector<const diskann::SearchResult *> answered;
+        for (uint32_t q = 0; q < header.num_queries; q++)
+        {
+            std::memcpy(query, request.data() + sizeof(header) + (size_t)q * header.dimensions * sizeof(T),
+                        header.dimensions * sizeof(T));
+            if (!search_shards(query, header.dimensions, header.k, header.Ls, results))
+                flags |= BINARY_PARTIAL;
+            answered.clear();
+            for (auto &shard_result : results)
+                answered.push_back(shard_result.get());
+            diskann::SearchResult result = aggregate_results(header.k, answered);
+
+            const uint32_t count = (uint32_t)result.get_indices().size();
+            append(&count, sizeof(count));
+            append(result.get_indices().data(), count * sizeof(uint32_t));
+            append(result.get_distances().data(), count * sizeof(float));
+            if (result.partitions_enabled())
+            {
+                flags |= BINARY_HAS_PARTITIONS;
+                append(result.get_partitions().data(), count * sizeof(uint32_t));
+            }
+            if (result.tags_enabled())
+            {
+                flags |= BINARY_HAS_TAGS;
+                for (const std::string &tag : result.get_tags())
+                {
+                    const uint32_t length = (uint32_t)tag.size();
+                    append(&length, sizeof(length));
+                    append(tag.data(), length);
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        diskann::aligned_free(query);
+        throw;
+    }
+    diskann::aligned_free(query);
+
+    BinaryResponseHeader response_header{header.num_queries, header.k, flags};
+    std::memcpy(response.data(), &response_header, sizeof(response_header));
+    return response;
+}
+
+template <class T> void Server::handle_binary_post(web::http::http_request message)
+{
+    message.extract_vector()
+        .then([=](std::vector<unsigned char> body) {
+            web::http::http_response response;
+            int64_t num_queries = -1;
+            try
+            {
+                response.set_status_code(web::http::status_codes::OK);
+                response.set_body(search_binary<T>(body, num_queries));
+            }
+            catch (const std::invalid_argument &ex)
+            {
+                DISKANN_LOG(Warning) << "Invalid batch of " << num_queries << " queries: " << ex.what();
+                response.set_status_code(web::http::status_codes::BadRequest);
+                response.set_body(std::string(ex.what()));
+            }
+            catch (const diskann::SearchOverloadedException &ex)
+            {
+                DISKANN_LOG_EVERY_MS(Warning, 1000)
+                    << "Rejected a batch of " << num_queries << " queries: " << ex.what();
+                response.set_status_code(web::http::status_codes::ServiceUnavailable);
+                response.set_body(std::string(ex.what()));
+            }
+            catch (const std::exception &ex)
+            {
+                DISKANN_LOG(Error) << "Exception while processing a batch of " << num_queries
+                                   << " queries: " << ex.what();
+                response.set_status_code(web::http::status_codes::InternalError);
+                response.set_body(std::string(ex.what()));
+            }
+            catch (...)
+            {
+                DISKANN_LOG(Error) << "Uncaught exception while processing a batch of " << num_queries
+                                   << " queries";
+                response.set_status_code(web::http::status_codes::InternalError);
+                response.set_body(UNKNOWN_ERROR);
+            }
+            return response;
+        })
+        .then([=](web::http::http_response response) {
+            try
+            {
+                message.reply(response).wait();
+            }
+            catch (const std::exception &ex)
+            {
+                DISKANN_LOG(Error) << "Exception while processing reply: " << ex.what();
+            };
+        });
+}
+
+template <class T> uint64_t Server::queue_insert_binary(const std::vector<unsigned char> &request)
+{
+    BinaryInsertHeader header;
+    if (request.size() < sizeof(header))
+        throw std::invalid_argument("Insert request is shorter than its header.");
+    std::memcpy(&header, request.data(), sizeof(header));
+    if (header.num_points == 0 || header.dimensions == 0)
+        throw std::invalid_argument("Insert request has no points or zero dimensions.");
+    if (request.size() !=
+        sizeof(header) + (size_t)header.num_points * (sizeof(uint32_t) + header.dimensions * sizeof(T)))
+        throw std::invalid_argument("Insert request size does not match its number of points and dimensions.");
+
+    // the body is not aligned for T, so the searcher copies out of it
+    std::vector<uint32_t> tags(header.num_points);
+    std::memcpy(tags.data(), request.data() + sizeof(header), tags.size() * sizeof(uint32_t));
+    std::vector<T> vectors((size_t)header.num_points * header.dimensions);
+    std::memcpy(vectors.data(), request.data() + sizeof(header) + tags.size() * sizeof(uint32_t),
+                vectors.size() * sizeof(T));
+    return _multi_searcher[0]->queue_insert(vectors.data(), tags.data(), header.num_points, header.dimensions);
+}
+
+uint64_t Server::queue_delete_binary(const std::vector<unsigned char> &request)
+{
+    uint32_t count;
+    if (request.size() < sizeof(count))
+        throw std::invalid_argument("Delete request is shorter than its count.");
+    std::memcpy(&count, request.data(), sizeof(count));
+    if (request.size() != sizeof(count) + (size_t)count * sizeof(uint32_t))
+        throw std::invalid_argument("Delete request size does not match its number of tags.");
+    std::vector<uint32_t> tags(count);
+    std::memcpy(tags.data(), request.data() + sizeof(count), count * sizeof(uint32_t));
+    return _multi_searcher[0]->queue_delete(std::move(tags));
+}
+
+template <class T> void Server::handle_update(web::http::http_request message)
+{
+    const bool insert = message.relative_uri().path() == U("/insert");
+    message.extract_vector()
+        .then([=](std::vector<unsigned char> body) {
+            web::http::http_response response;
+            try
+            {
+                if (_multi_search)
+                    throw std::invalid_argument("Updates go to the server of their shard.");
+                const uint64_t sequence = insert ? queue_insert_binary<T>(body) : queue_delete_binary(body);
+                web::json::value ack = web::json::value::object();
+                ack[SEQUENCE_KEY] = web::json::value::number(sequence);
+                response.set_status_code(web::http::status_codes::Accepted);
+                response.set_body(ack);
+            }
+            catch (const std::invalid_argument &ex)
+            {
+                DISKANN_LOG(Warning) << "Invalid update: " << ex.what();
+                response.set_status_code(web::http::status_codes::BadRequest);
+                response.set_body(std::string(ex.what()));
+            }
+            catch (const std::logic_error &ex)
+            {
+                response.set_status_code(web::http::status_codes::NotImplemented);
+                response.set_body(std::string(ex.what()));
+            }
+            catch (const std::exception &ex)
+            {
+                DISKANN_LOG(Error) << "Exception while queueing an update: " << ex.what();
+                response.set_status_code(web::http::status_codes::InternalError);
+                response.set_body(std::string(ex.what()));
+            }
+            return response;
+        })
+        .then([=](web::http::http_response response) {
+            try
+            {
+                message.reply(response).wait();
+            }
+            catch (const std::exception &ex)
+            {
+                DISKANN_LOG(Error) << "Exception while processing reply: " << ex.what();
             };
         });
 }
@@ -182,13 +600,14 @@ web::json::value Server::prepareResponse(const int64_t &queryId, const int k)
 
 template <class T>
 void Server::parseJson(const utility::string_t &body, unsigned int &k, int64_t &queryId, T *&queryVector,
-                       unsigned int &dimensions, unsigned &Ls)
+                       unsigned int &dimensions, unsigned &Ls, unsigned &budget_ms)
 {
-    std::cout << body << std::endl;
+    DISKANN_LOG(Debug) << body;
     web::json::value val = web::json::value::parse(body);
     web::json::array queryArr = val.at(VECTOR_KEY).as_array();
     queryId = val.has_field(QUERY_ID_KEY) ? val.at(QUERY_ID_KEY).as_number().to_int64() : -1;
     Ls = val.has_field(L_KEY) ? val.at(L_KEY).as_number().to_uint32() : DEFAULT_L;
+    budget_ms = val.has_field(BUDGET_KEY) ? val.at(BUDGET_KEY).as_number().to_uint32() : 0;
     k = val.at(K_KEY).as_integer();
 
     if (k <= 0 || k > Ls)
@@ -232,7 +651,7 @@ web::json::value Server::idsToJsonArray(const diskann::SearchResult &result)
         auto idVal = web::json::value::number(ids[i]);
         idArray[i] = idVal;
     }
-    std::cout << "Vector size: " << ids.size() << std::endl;
+    DISKANN_LOG(Debug) << "Vector size: " << ids.size();
     return idArray;
 }
 
@@ -2,10 +2,10 @@
 // Licensed under the MIT license.
 
 #include <vector>
-#include <boost/dynamic_bitset.hpp>
 
 #include "scratch.h"
 #include "pq_scratch.h"
+#include "memory_usage.h"
 
 namespace diskann
 {
@@ -34,11 +34,15 @@ InMemQueryScratch<T>::InMemQueryScratch(uint32_t search_l, uint32_t indexing_l,
         this->_pq_scratch = nullptr;
 
     _occlude_factor.reserve(maxc);
-    _inserted_into_pool_bs = new boost::dynamic_bitset<>();
+    _occlude_ids.reserve(maxc);
+    _occlude_positions.reserve(maxc);
+    _occlude_distances.reserve(maxc);
+    _occlude_bounds.reserve(maxc);
     _id_scratch.reserve((size_t)std::ceil(1.5 * defaults::GRAPH_SLACK_FACTOR * _R));
     _dist_scratch.reserve((size_t)std::ceil(1.5 * defaults::GRAPH_SLACK_FACTOR * _R));
 
     resize_for_new_L(std::max(search_l, indexing_l));
+    _aligned_query_size = aligned_dim * sizeof(T);
 }
 
 template <typename T> void InMemQueryScratch<T>::clear()
@@ -46,9 +50,12 @@ template <typename T> void InMemQueryScratch<T>::clear()
     _pool.clear();
     _best_l_nodes.clear();
     _occlude_factor.clear();
+    _occlude_ids.clear();
+    _occlude_positions.clear();
+    _occlude_distances.clear();
+    _occlude_bounds.clear();
 
-    _inserted_into_pool_rs.clear();
-    _inserted_into_pool_bs->reset();
+    _inserted_into_pool.clear();
 
     _id_scratch.clear();
     _dist_scratch.clear();
@@ -65,11 +72,27 @@ template <typename T> void InMemQueryScratch<T>::resize_for_new_L(uint32_t new_l
         _L = new_l;
         _pool.reserve(3 * _L + _R);
         _best_l_nodes.reserve(_L);
-
-        _inserted_into_pool_rs.reserve(20 * _L);
     }
 }
 
+template <typename T> void InMemQueryScratch<T>::grow_for_new_L(uint32_t new_l)
+{
+    if (new_l > _L)
+        resize_for_new_L(std::max(new_l, 2 * _L));
+}
+
+template <typename T> size_t InMemQueryScratch<T>::memory_size() const
+{
+    size_t size = sizeof(*this) + _aligned_query_size + vector_bytes(_pool) + _best_l_nodes.memory_size() +
+                  vector_bytes(_occlude_factor) + vector_bytes(_occlude_ids) + vector_bytes(_occlude_positions) +
+                  vector_bytes(_occlude_distances) + vector_bytes(_occlude_bounds) + _inserted_into_pool.memory_size() +
+                  vector_bytes(_id_scratch) + vector_bytes(_dist_scratch) + hash_table_bytes(_expanded_nodes_set) +
+                  vector_bytes(_expanded_nghrs_vec) + vector_bytes(_occlude_list_output);
+    if (this->_pq_scratch != nullptr)
+        size += this->_pq_scratch->memory_size();
+    return size;
+}
+
 template <typename T> InMemQueryScratch<T>::~InMemQueryScratch()
 {
     if (this->_aligned_query_T != nullptr)
@@ -79,7 +102,6 @@ template <typename T> InMemQueryScratch<T>::~InMemQueryScratch()
     }
 
     delete this->_pq_scratch;
-    delete _inserted_into_pool_bs;
 }
 
 //
@@ -100,22 +122,45 @@ template <typename T> SSDQueryScratch<T>::SSDQueryScratch(size_t aligned_dim, si
     diskann::alloc_aligned((void **)&coord_scratch, coord_alloc_size, 256);
     diskann::alloc_aligned((void **)&sector_scratch, defaults::MAX_N_SECTOR_READS * defaults::SECTOR_LEN,
                            defaults::SECTOR_LEN);
+    diskann::alloc_aligned((void **)&speculative_scratch, defaults::MAX_SPECULATIVE_SECTORS * defaults::SECTOR_LEN,
+                           defaults::SECTOR_LEN);
+    diskann::alloc_aligned((void **)&reorder_scratch, defaults::MAX_REORDER_PREFETCH_SECTORS * defaults::SECTOR_LEN,
+                           defaults::SECTOR_LEN);
+    diskann::alloc_aligned((void **)&nbr_scratch, defaults::MAX_GRAPH_DEGREE * sizeof(uint32_t), 32);
+    diskann::alloc_aligned((void **)&filtered_nbr_scratch, defaults::MAX_GRAPH_DEGREE * sizeof(uint32_t), 64);
     diskann::alloc_aligned((void **)&this->_aligned_query_T, aligned_dim * sizeof(T), 8 * sizeof(T));
+    diskann::alloc_aligned((void **)&float_query, aligned_dim * sizeof(float), 8 * sizeof(float));
 
     this->_pq_scratch = new PQScratch<T>(defaults::MAX_GRAPH_DEGREE, aligned_dim);
 
     memset(coord_scratch, 0, coord_alloc_size);
     memset(this->_aligned_query_T, 0, aligned_dim * sizeof(T));
+    memset(float_query, 0, aligned_dim * sizeof(float));
 
-    visited.reserve(visited_reserve);
     full_retset.reserve(visited_reserve);
+    _buffer_size = coord_alloc_size +
+                   (defaults::MAX_N_SECTOR_READS + defaults::MAX_SPECULATIVE_SECTORS +
+                    defaults::MAX_REORDER_PREFETCH_SECTORS) *
+                       defaults::SECTOR_LEN +
+                   2 * defaults::MAX_GRAPH_DEGREE * sizeof(uint32_t) + aligned_dim * (sizeof(T) + sizeof(float));
+}
+
+template <typename T> size_t SSDQueryScratch<T>::memory_size() const
+{
+    return sizeof(*this) + _buffer_size + this->_pq_scratch->memory_size() + visited.memory_size() +
+           retset.memory_size() + vector_bytes(full_retset);
 }
 
 template <typename T> SSDQueryScratch<T>::~SSDQueryScratch()
 {
     diskann::aligned_free((void *)coord_scratch);
     diskann::aligned_free((void *)sector_scratch);
+    diskann::aligned_free((void *)speculative_scratch);
+    diskann::aligned_free((void *)reorder_scratch);
+    diskann::aligned_free((void *)nbr_scratch);
+    diskann::aligned_free((void *)filtered_nbr_scratch);
     diskann::aligned_free((void *)this->_aligned_query_T);
+    diskann::aligned_free((void *)float_query);
 
     delete this->_pq_scratch;
 }
@@ -134,13 +179,19 @@ template <typename T> PQScratch<T>::PQScratch(size_t graph_degree, size_t aligne
 {
     diskann::alloc_aligned((void **)&aligned_pq_coord_scratch,
                            (size_t)graph_degree * (size_t)MAX_PQ_CHUNKS * sizeof(uint8_t), 256);
-    diskann::alloc_aligned((void **)&aligned_pqtable_dist_scratch, 256 * (size_t)MAX_PQ_CHUNKS * sizeof(float), 256);
+    _pq_table_entries = NUM_PQ_CENTROIDS * (size_t)MAX_PQ_CHUNKS;
+    diskann::alloc_aligned((void **)&aligned_pqtable_dist_scratch, _pq_table_entries * sizeof(float), 256);
     diskann::alloc_aligned((void **)&aligned_dist_scratch, (size_t)graph_degree * sizeof(float), 256);
     diskann::alloc_aligned((void **)&aligned_query_float, aligned_dim * sizeof(float), 8 * sizeof(float));
     diskann::alloc_aligned((void **)&rotated_query, aligned_dim * sizeof(float), 8 * sizeof(float));
+    diskann::alloc_aligned((void **)&fast_scan_lut.lut, NUM_PQ_CENTROIDS_FAST_SCAN * (size_t)MAX_PQ_CHUNKS, 256);
 
     memset(aligned_query_float, 0, aligned_dim * sizeof(float));
     memset(rotated_query, 0, aligned_dim * sizeof(float));
+
+    _memory_size = graph_degree * MAX_PQ_CHUNKS * sizeof(uint8_t) + 256 * MAX_PQ_CHUNKS * sizeof(float) +
+                   graph_degree * sizeof(float) + 2 * aligned_dim * sizeof(float) +
+                   NUM_PQ_CENTROIDS_FAST_SCAN * MAX_PQ_CHUNKS;
 }
 
 template <typename T> PQScratch<T>::~PQScratch()
@@ -150,6 +201,17 @@ template <typename T> PQScratch<T>::~PQScratch()
     diskann::aligned_free((void *)aligned_dist_scratch);
     diskann::aligned_free((void *)aligned_query_float);
     diskann::aligned_free((void *)rotated_query);
+    diskann::aligned_free((void *)fast_scan_lut.lut);
+}
+
+template <typename T> void PQScratch<T>::reserve_pq_table(size_t n_entries)
+{
+    if (n_entries <= _pq_table_entries)
+        return;
+    diskann::aligned_free((void *)aligned_pqtable_dist_scratch);
+    diskann::alloc_aligned((void **)&aligned_pqtable_dist_scratch, n_entries * sizeof(float), 256);
+    _memory_size += (n_entries - _pq_table_entries) * sizeof(float);
+    _pq_table_entries = n_entries;
 }
 
 template <typename T> void PQScratch<T>::initialize(size_t dim, const T *query, const float norm)
@@ -164,18 +226,26 @@ template <typename T> void PQScratch<T>::initialize(size_t dim, const T *query,
 }
 
 template DISKANN_DLLEXPORT class InMemQueryScratch<int8_t>;
+template DISKANN_DLLEXPORT class InMemQueryScratch<float16>;
+template DISKANN_DLLEXPORT class InMemQueryScratch<bfloat16>;
 template DISKANN_DLLEXPORT class InMemQueryScratch<uint8_t>;
 template DISKANN_DLLEXPORT class InMemQueryScratch<float>;
 
 template DISKANN_DLLEXPORT class SSDQueryScratch<int8_t>;
+template DISKANN_DLLEXPORT class SSDQueryScratch<float16>;
+template DISKANN_DLLEXPORT class SSDQueryScratch<bfloat16>;
 template DISKANN_DLLEXPORT class SSDQueryScratch<uint8_t>;
 template DISKANN_DLLEXPORT class SSDQueryScratch<float>;
 
 template DISKANN_DLLEXPORT class PQScratch<int8_t>;
+template DISKANN_DLLEXPORT class PQScratch<float16>;
+template DISKANN_DLLEXPORT class PQScratch<bfloat16>;
 template DISKANN_DLLEXPORT class PQScratch<uint8_t>;
 template DISKANN_DLLEXPORT class PQScratch<float>;
 
 template DISKANN_DLLEXPORT class SSDThreadData<int8_t>;
+template DISKANN_DLLEXPORT class SSDThreadData<float16>;
+template DISKANN_DLLEXPORT class SSDThreadData<bfloat16>;
 template DISKANN_DLLEXPORT class SSDThreadData<uint8_t>;
 template DISKANN_DLLEXPORT class SSDThreadData<float>;
 
@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cmath>
+
+#include "ann_exception.h"
+#include "search_budget.h"
+#include "utils.h"
+
+namespace diskann
+{
+// L, K, warmup_hops and multiplier, then the weights, as one row of floats
+static const size_t SEARCH_BUDGET_MODEL_FLOATS = 4 + SEARCH_BUDGET_FEATURES;
+
+float SearchBudgetModel::predicted_hops(const float *features) const
+{
+    float log_hops = 0;
+    for (size_t f = 0; f < SEARCH_BUDGET_FEATURES; f++)
+        log_hops += weights[f] * features[f];
+    return std::exp(log_hops);
+}
+
+uint32_t SearchBudgetModel::budget(const float *features) const
+{
+    const double hops = (double)multiplier * predicted_hops(features);
+    if (!(hops < (double)std::numeric_limits<uint32_t>::max()))
+        return std::numeric_limits<uint32_t>::max();
+    return (std::max)(warmup_hops, (uint32_t)std::ceil(hops));
+}
+
+void SearchBudgetModel::save(const std::string &path) const
+{
+    float row[SEARCH_BUDGET_MODEL_FLOATS] = {(float)L, (float)K, (float)warmup_hops, multiplier};
+    std::copy(weights, weights + SEARCH_BUDGET_FEATURES, row + 4);
+    save_bin<float>(path, row, 1, SEARCH_BUDGET_MODEL_FLOATS);
+}
+
+SearchBudgetModel SearchBudgetModel::load(const std::string &path)
+{
+    std::unique_ptr<float[]> row;
+    size_t npts, ndims;
+    load_bin<float>(path, row, npts, ndims);
+    if (npts != 1 || ndims != SEARCH_BUDGET_MODEL_FLOATS)
+        throw ANNException("Not a search budget model: " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    SearchBudgetModel model;
+    model.L = (uint32_t)row[0];
+    model.K = (uint32_t)row[1];
+    model.warmup_hops = (uint32_t)row[2];
+    model.multiplier = row[3];
+    std::copy(row.get() + 4, row.get() + SEARCH_BUDGET_MODEL_FLOATS, model.weights);
+    return model;
+}
+
+void SearchBudgetModel::fit_weights(const std::vector<float> &features, const std::vector<uint32_t> &hops,
+                                    float *weights)
+{
+    const size_t F = SEARCH_BUDGET_FEATURES;
+    const size_t n = hops.size();
+
+    // normal equations, in double, with a small ridge on all but the constant
+    double a[F][F + 1] = {};
+    for (size_t i = 0; i < n; i++)
+    {
+        const float *x = features.data() + i * F;
+        const double y = std::log((double)(std::max)(hops[i], (uint32_t)1));
+        for (size_t r = 0; r < F; r++)
+        {
+            for (size_t c = 0; c < F; c++)
+                a[r][c] += (double)x[r] * x[c];
+            a[r][F] += (double)x[r] * y;
+        }
+    }
+    for (size_t r = 1; r < F; r++)
+        a[r][r] += 1e-3 * (double)(std::max)(n, (size_t)1);
+
+    // Gaussian elimination with partial pivoting
+    for (size_t col = 0; col < F; col++)
+    {
+        size_t pivot = col;
+        for (size_t r = col + 1; r < F; r++)
+        {
+            if (std::abs(a[r][col]) > std::abs(a[pivot][col]))
+                pivot = r;
+        }
+        std::swap(a[col], a[pivot]);
+        if (a[col][col] == 0)
+            continue;
+        for (size_t r = 0; r < F; r++)
+        {
+            if (r == col)
+                continue;
+            const double factor = a[r][col] / a[col][col];
+            for (size_t c = col; c <= F; c++)
+                a[r][c] -= factor * a[col][c];
+        }
+    }
+    for (size_t f = 0; f < F; f++)
+        weights[f] = a[f][f] != 0 ? (float)(a[f][F] / a[f][f]) : 0.0f;
+}
+
+float SearchBudget::kth_distance(const NeighborPriorityQueue &candidates) const
+{
+    return candidates[(std::min)((size_t)K, candidates.size()) - 1].distance;
+}
+
+void SearchBudget::begin(const NeighborPriorityQueue &candidates)
+{
+    has_features = false;
+    if (candidates.size() > 0)
+        _entry_distance = candidates[0].distance;
+}
+
+void SearchBudget::after_hop(const uint32_t hops, const NeighborPriorityQueue &candidates)
+{
+    if (warmup_hops == 0 || hops > warmup_hops)
+        return;
+    if (hops == (warmup_hops + 1) / 2)
+        _half_warmup_kth = kth_distance(candidates);
+    if (hops < warmup_hops)
+        return;
+
+    const float scale = (std::max)(std::abs(_entry_distance), std::numeric_limits<float>::min());
+    const float kth = kth_distance(candidates);
+    const size_t top = (std::min)((size_t)K, candidates.size());
+    size_t expanded = 0;
+    for (size_t i = 0; i < top; i++)
+        expanded += candidates[i].expanded ? 1 : 0;
+
+    features[0] = 1.0f;
+    features[1] = std::log(scale);
+    features[2] = candidates[0].distance / scale;
+    features[3] = kth / scale;
+    features[4] = (_half_warmup_kth - kth) / scale;
+    features[5] = (float)expanded / (float)top;
+    has_features = true;
+
+    if (model != nullptr)
+        max_hops = (std::min)(max_hops, model->budget(features));
+}
+} // namespace diskann
@@ -0,0 +1,268 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "logger.h"
+#include "search_metrics.h"
+
+namespace diskann
+{
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+uint64_t LatencyHistogram::highest_value_of(uint32_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    const uint32_t msb = (bucket - SUB_BUCKETS) / (SUB_BUCKETS / 2) + SUB_BUCKET_BITS;
+    const uint64_t top = (bucket - SUB_BUCKETS) % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2;
+    return ((top + 1) << (msb - (SUB_BUCKET_BITS - 1))) - 1;
+}
+
+uint64_t LatencyHistogram::value_at_quantile(double quantile) const
+{
+    const uint64_t total = count();
+    if (total == 0)
+        return 0;
+    quantile = (std::min)((std::max)(quantile, 0.0), 1.0);
+    const uint64_t rank = (std::max)((uint64_t)std::ceil(quantile * (double)total), (uint64_t)1);
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+    {
+        seen += _counts[b].load(std::memory_order_relaxed);
+        // the last bucket also holds the values past its range
+        if (seen >= rank)
+            return b == NUM_BUCKETS - 1 ? max() : (std::min)(highest_value_of(b), max());
+    }
+    return max();
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other)
+{
+    for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+    {
+        const uint64_t n = other._counts[b].load(std::memory_order_relaxed);
+        if (n != 0)
+            _counts[b].fetch_add(n, std::memory_order_relaxed);
+    }
+    _count.fetch_add(other.count(), std::memory_order_relaxed);
+    _sum.fetch_add(other.sum(), std::memory_order_relaxed);
+    const uint64_t other_max = other.max();
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (other_max > max && !_max.compare_exchange_weak(max, other_max, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &count : _counts)
+        count.store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+void SearchMetrics::record(const QueryStats &stats)
+{
+    auto us = [](float value) { return value > 0 ? (uint64_t)std::llround(value) : (uint64_t)0; };
+    _histograms[TOTAL_US].record(us(stats.total_us));
+    _histograms[IO_US].record(us(stats.io_us));
+    _histograms[PQ_US].record(us(stats.pq_us));
+    _histograms[FP_US].record(us(stats.fp_us));
+    _histograms[HOPS].record(stats.n_hops);
+    _histograms[IOS].record(stats.n_ios);
+    _histograms[BYTES_READ].record(stats.read_size);
+    _cache_hits.fetch_add(stats.n_cache_hits, std::memory_order_relaxed);
+}
+
+void SearchMetrics::add(const SearchMetrics &other)
+{
+    for (uint32_t s = 0; s < NUM_SERIES; s++)
+        _histograms[s].add(other._histograms[s]);
+    _cache_hits.fetch_add(other.num_cache_hits(), std::memory_order_relaxed);
+}
+
+void SearchMetrics::reset()
+{
+    for (auto &histogram : _histograms)
+        histogram.reset();
+    _cache_hits.store(0, std::memory_order_relaxed);
+}
+
+double SearchMetrics::cache_hit_rate() const
+{
+    const uint64_t hits = num_cache_hits();
+    const uint64_t reads = _histograms[IOS].sum();
+    return hits + reads == 0 ? 0.0 : (double)hits / (double)(hits + reads);
+}
+
+void SearchMetrics::write_text(std::ostream &out,
+                               const std::vector<std::pair<std::string, const SearchMetrics *>> &sets,
+                               const std::string &prefix, const bool openmetrics, const bool write_eof)
+{
+    static const char *const SERIES_NAMES[NUM_SERIES] = {"total_us", "io_us", "pq_us",     "fp_us",
+                                                         "hops",     "ios",   "bytes_read"};
+    static const char *const SERIES_HELP[NUM_SERIES] = {
+        "Time to process a query in microseconds.",
+        "Time a query waited for reads in microseconds.",
+        "Time a query spent on PQ distances in microseconds.",
+        "Time a query spent on full precision distances in microseconds.",
+        "Rounds of reads of a query.",
+        "Reads of a query.",
+        "Bytes read by a query."};
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    static const char *const QUANTILE_NAMES[] = {"0.5", "0.9", "0.99", "0.999"};
+
+    // the labels of a sample, with extra appended to those of its set
+    auto labels_of = [](const std::string &set_labels, const std::string &extra) {
+        std::string labels = set_labels;
+        if (!labels.empty() && !extra.empty())
+            labels += ",";
+        labels += extra;
+        return labels.empty() ? labels : "{" + labels + "}";
+    };
+
+    for (uint32_t s = 0; s < NUM_SERIES; s++)
+    {
+        const std::string name = prefix + "_" + SERIES_NAMES[s];
+        out << "# TYPE " << name << " summary\n";
+        out << "# HELP " << name << " " << SERIES_HELP[s] << "\n";
+        for (const auto &set : sets)
+        {
+            const LatencyHistogram &histogram = set.second->histogram((Series)s);
+            for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++)
+            {
+                out << name << labels_of(set.first, std::string("quantile=\"") + QUANTILE_NAMES[q] + "\"") << " "
+                    << histogram.value_at_quantile(QUANTILES[q]) << "\n";
+            }
+            out << name << "_sum" << labels_of(set.first, "") << " " << histogram.sum() << "\n";
+            out << name << "_count" << labels_of(set.first, "") << " " << histogram.count() << "\n";
+        }
+    }
+
+    // OpenMetrics names the counter family without its _total suffix
+    const std::string hits_name = prefix + "_cache_hits";
+    const std::string hits_family = openmetrics ? hits_name : hits_name + "_total";
+    out << "# TYPE " << hits_family << " counter\n";
+    out << "# HELP " << hits_family << " Nodes expanded from a cache instead of a read.\n";
+    for (const auto &set : sets)
+        out << hits_name << "_total" << labels_of(set.first, "") << " " << set.second->num_cache_hits() << "\n";
+
+    const std::string rate_name = prefix + "_cache_hit_rate";
+    out << "# TYPE " << rate_name << " gauge\n";
+    out << "# HELP " << rate_name << " Share of the expanded nodes that came from a cache.\n";
+    for (const auto &set : sets)
+        out << rate_name << labels_of(set.first, "") << " " << set.second->cache_hit_rate() << "\n";
+
+    if (openmetrics && write_eof)
+        out << "# EOF\n";
+}
+
+void IOMetrics::set_slow_read_alert(uint64_t threshold_us, std::function<void(uint64_t latency_us)> alert)
+{
+    std::lock_guard<std::mutex> guard(_alert_mut);
+    _alert = std::move(alert);
+    _slow_read_us.store(threshold_us, std::memory_order_relaxed);
+}
+
+void IOMetrics::slow_read(uint64_t latency_us)
+{
+    _slow_reads.fetch_add(1, std::memory_order_relaxed);
+    std::function<void(uint64_t)> alert;
+    {
+        std::lock_guard<std::mutex> guard(_alert_mut);
+        if (!_alert)
+        {
+            const uint64_t now_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                        std::chrono::steady_clock::now().time_since_epoch())
+                                        .count();
+            if (_last_warning_us != 0 && now_us - _last_warning_us < 1000000)
+                return;
+            _last_warning_us = now_us;
+        }
+        alert = _alert;
+    }
+    if (alert)
+        alert(latency_us);
+    else
+        diskann::cerr << "Slow read: " << latency_us << "us, over the threshold of "
+                      << _slow_read_us.load(std::memory_order_relaxed) << "us; " << num_slow_reads()
+                      << " slow reads so far" << std::endl;
+}
+
+void IOMetrics::add(const IOMetrics &other)
+{
+    for (uint32_t s = 0; s < NUM_SERIES; s++)
+        _histograms[s].add(other._histograms[s]);
+    _in_flight.fetch_add(other.in_flight(), std::memory_order_relaxed);
+    _slow_reads.fetch_add(other.num_slow_reads(), std::memory_order_relaxed);
+}
+
+void IOMetrics::reset()
+{
+    for (auto &histogram : _histograms)
+        histogram.reset();
+    _slow_reads.store(0, std::memory_order_relaxed);
+}
+
+void IOMetrics::write_text(std::ostream &out, const std::vector<std::pair<std::string, const IOMetrics *>> &sets,
+                           const std::string &prefix, const bool openmetrics, const bool write_eof)
+{
+    static const char *const SERIES_NAMES[NUM_SERIES] = {"read_latency_us", "device_queue_depth",
+                                                         "context_queue_depth"};
+    static const char *const SERIES_HELP[NUM_SERIES] = {
+        "Time from submitting a read to reaping its completion in microseconds.",
+        "Reads in flight on the file reader after each submission.",
+        "Reads in flight on the submitting IO context after each submission."};
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    static const char *const QUANTILE_NAMES[] = {"0.5", "0.9", "0.99", "0.999"};
+
+    auto labels_of = [](const std::string &set_labels, const std::string &extra) {
+        std::string labels = set_labels;
+        if (!labels.empty() && !extra.empty())
+            labels += ",";
+        labels += extra;
+        return labels.empty() ? labels : "{" + labels + "}";
+    };
+
+    for (uint32_t s = 0; s < NUM_SERIES; s++)
+    {
+        const std::string name = prefix + "_" + SERIES_NAMES[s];
+        out << "# TYPE " << name << " summary\n";
+        out << "# HELP " << name << " " << SERIES_HELP[s] << "\n";
+        for (const auto &set : sets)
+        {
+            const LatencyHistogram &histogram = set.second->histogram((Series)s);
+            for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++)
+            {
+                out << name << labels_of(set.first, std::string("quantile=\"") + QUANTILE_NAMES[q] + "\"") << " "
+                    << histogram.value_at_quantile(QUANTILES[q]) << "\n";
+            }
+            out << name << "_sum" << labels_of(set.first, "") << " " << histogram.sum() << "\n";
+            out << name << "_count" << labels_of(set.first, "") << " " << histogram.count() << "\n";
+        }
+    }
+
+    const std::string slow_name = prefix + "_slow_reads";
+    const std::string slow_family = openmetrics ? slow_name : slow_name + "_total";
+    out << "# TYPE " << slow_family << " counter\n";
+    out << "# HELP " << slow_family << " Reads slower than the alert threshold.\n";
+    for (const auto &set : sets)
+        out << slow_name << "_total" << labels_of(set.first, "") << " " << set.second->num_slow_reads() << "\n";
+
+    const std::string in_flight_name = prefix + "_reads_in_flight";
+    out << "# TYPE " << in_flight_name << " gauge\n";
+    out << "# HELP " << in_flight_name << " Reads submitted and not yet reaped.\n";
+    for (const auto &set : sets)
+        out << in_flight_name << labels_of(set.first, "") << " " << set.second->in_flight() << "\n";
+
+    if (openmetrics && write_eof)
+        out << "# EOF\n";
+}
+} // namespace diskann
@@ -0,0 +1,163 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ann_exception.h"
+#include "search_trace.h"
+
+namespace diskann
+{
+std::atomic<bool> SearchTrace::_enabled{false};
+
+namespace
+{
+struct TraceEvent
+{
+    uint64_t ts_ns;
+    TraceEventType type;
+    uint64_t a;
+    uint64_t b;
+};
+
+// The events of one thread. Only that thread writes it; head counts the
+// events ever written and the last capacity of them are kept.
+struct ThreadTraceBuffer
+{
+    uint32_t tid;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head{0};
+};
+
+// buffers outlive their threads so that a dump after the search threads exit
+// still has their events
+struct TraceRegistry
+{
+    std::mutex lock;
+    std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers;
+    uint64_t capacity = 1 << 16;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+TraceRegistry &registry()
+{
+    static TraceRegistry instance;
+    return instance;
+}
+
+ThreadTraceBuffer *register_thread()
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.buffers.emplace_back(new ThreadTraceBuffer());
+    ThreadTraceBuffer *buffer = reg.buffers.back().get();
+    buffer->tid = (uint32_t)reg.buffers.size();
+    buffer->events.resize(reg.capacity);
+    return buffer;
+}
+
+// how each event type is written: its name, Chrome trace phase and the names
+// of its arguments, in the order of TraceEventType
+struct TraceEventFormat
+{
+    const char *name;
+    const char *phase;
+    const char *a_name;
+    const char *b_name;
+};
+const TraceEventFormat EVENT_FORMATS[] = {{"query", "B", "L", "beam_width"},   {"query", "E", "hops", "reads"},
+                                          {"hop", "B", "hop", "beam"},         {"hop", "E", "hop", "reads"},
+                                          {"expand", "i", "node", "distances"}, {"read", "i", "sector", "bytes"},
+                                          {"cache_hit", "i", "node", nullptr}};
+} // namespace
+
+void SearchTrace::set_enabled(bool enable)
+{
+    // start the clock before the first event
+    registry();
+    _enabled.store(enable, std::memory_order_relaxed);
+}
+
+void SearchTrace::set_buffer_capacity(uint64_t num_events)
+{
+    uint64_t capacity = 1;
+    while (capacity < num_events)
+        capacity <<= 1;
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.capacity = capacity;
+}
+
+uint64_t SearchTrace::buffer_capacity()
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    return reg.capacity;
+}
+
+void SearchTrace::record(TraceEventType type, uint64_t a, uint64_t b)
+{
+    thread_local ThreadTraceBuffer *buffer = register_thread();
+    const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer->events[head & (buffer->events.size() - 1)];
+    event.ts_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                 registry().start)
+                      .count();
+    event.type = type;
+    event.a = a;
+    event.b = b;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void SearchTrace::clear()
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (auto &buffer : reg.buffers)
+        buffer->head.store(0, std::memory_order_relaxed);
+}
+
+void SearchTrace::write_chrome_trace(std::ostream &out)
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto &buffer : reg.buffers)
+    {
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+        const uint64_t capacity = buffer->events.size();
+        const uint64_t begin = head > capacity ? head - capacity : 0;
+        for (uint64_t i = begin; i < head; i++)
+        {
+            const TraceEvent &event = buffer->events[i & (capacity - 1)];
+            const TraceEventFormat &format = EVENT_FORMATS[(uint32_t)event.type];
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\":\"" << format.name << "\",\"cat\":\"search\",\"ph\":\"" << format.phase
+                << "\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << event.ts_ns / 1000 << "."
+                << std::to_string(1000 + event.ts_ns % 1000).substr(1);
+            // instant events are scoped to their thread
+            if (format.phase[0] == 'i')
+                out << ",\"s\":\"t\"";
+            out << ",\"args\":{\"" << format.a_name << "\":" << event.a;
+            if (format.b_name != nullptr)
+                out << ",\"" << format.b_name << "\":" << event.b;
+            out << "}}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+void SearchTrace::write_chrome_trace(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+        throw ANNException("Cannot open trace file " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    write_chrome_trace(out);
+}
+} // namespace diskann
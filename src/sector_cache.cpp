@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "sector_cache.h"
+#include "defaults.h"
+#include "utils.h"
+
+namespace diskann
+{
+SectorCache::~SectorCache()
+{
+    free_arena();
+}
+
+void SectorCache::free_arena()
+{
+    free_large(_buffer);
+    _arena = nullptr;
+}
+
+void SectorCache::reset(uint64_t num_records, uint64_t record_len, uint64_t num_keys)
+{
+    free_arena();
+    _table.clear();
+    _num_keys = 0;
+    _record_len = record_len;
+    _num_records = num_records;
+
+    if (num_records > 0)
+    {
+        // huge pages and NUMA placement follow the memory policy
+        _buffer = alloc_large(num_records * record_len, defaults::SECTOR_LEN);
+        _arena = (char *)_buffer.ptr;
+    }
+
+    // keep the table at most half full so probe sequences stay short
+    uint64_t table_size = 16;
+    while (table_size < 2 * num_keys)
+        table_size <<= 1;
+    _table.assign(table_size, Entry{EMPTY_KEY, 0});
+    _mask = table_size - 1;
+}
+
+void SectorCache::insert(uint32_t node_id, uint32_t slot)
+{
+    if (2 * (_num_keys + 1) > _table.size())
+        throw diskann::ANNException("SectorCache index is full", -1, __FUNCSIG__, __FILE__, __LINE__);
+
+    uint64_t pos = hash(node_id) & _mask;
+    while (_table[pos].node_id != EMPTY_KEY)
+    {
+        if (_table[pos].node_id == node_id)
+        {
+            _table[pos].slot = slot;
+            return;
+        }
+        pos = (pos + 1) & _mask;
+    }
+    _table[pos] = Entry{node_id, slot};
+    _num_keys++;
+}
+} // namespace diskann
@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "shard_pool.h"
+
+namespace diskann
+{
+ShardPool::ShardPool(unsigned num_threads)
+{
+    for (unsigned i = 0; i < num_threads; i++)
+        _threads.emplace_back([this]() { run(); });
+}
+
+ShardPool::~ShardPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+        _tasks.clear();
+    }
+    _cv.notify_all();
+    for (auto &thread : _threads)
+        thread.join();
+}
+
+void ShardPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+void ShardPool::run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _cv.wait(guard, [this]() { return _stopping || !_tasks.empty(); });
+            if (_stopping)
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+} // namespace diskann
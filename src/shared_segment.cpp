@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "shared_segment.h"
+#include "ann_exception.h"
+#include "logger.h"
+
+namespace diskann
+{
+#ifndef _WINDOWS
+namespace
+{
+const uint64_t SEGMENT_MAGIC = 0x4449534b414e4e53; // "DISKANNS"
+
+// at the start of the segment; the buffer follows at SEGMENT_HEADER_LEN, so
+// that it is aligned for any element type the indices keep in it
+struct SegmentHeader
+{
+    uint64_t magic;
+    uint64_t size;
+    // set once the buffer is filled
+    std::atomic<uint32_t> ready;
+};
+const size_t SEGMENT_HEADER_LEN = 64;
+static_assert(sizeof(SegmentHeader) <= SEGMENT_HEADER_LEN, "header must fit before the buffer");
+
+std::string shm_name(const std::string &name)
+{
+    return name.size() > 0 && name[0] == '/' ? name : "/" + name;
+}
+} // namespace
+#endif
+
+SharedSegment::SharedSegment(const std::string &name, size_t size, const std::function<void(char *)> &fill)
+    : _size(size)
+{
+#ifdef _WINDOWS
+    throw ANNException("Shared memory segments are not supported on Windows", -1, __FUNCSIG__, __FILE__, __LINE__);
+#else
+    int fd = shm_open(shm_name(name).c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        throw ANNException("Cannot open shared memory segment " + name + ": errno " + std::to_string(errno), -1,
+                           __FUNCSIG__, __FILE__, __LINE__);
+    }
+    // the lock is held while the buffer is filled; it is released if the
+    // process dies, and whoever takes it next finds the buffer not ready
+    if (flock(fd, LOCK_EX) != 0)
+    {
+        close(fd);
+        throw ANNException("Cannot lock shared memory segment " + name, -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    _mapping_len = SEGMENT_HEADER_LEN + size;
+    struct stat st;
+    fstat(fd, &st);
+    if (st.st_size != 0 && (size_t)st.st_size != _mapping_len)
+    {
+        close(fd);
+        throw ANNException("Shared memory segment " + name + " holds " + std::to_string(st.st_size) +
+                               " bytes, not the " + std::to_string(_mapping_len) +
+                               " of this index; remove it if it is left from another index",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (st.st_size == 0 && ftruncate(fd, _mapping_len) != 0)
+    {
+        close(fd);
+        throw ANNException("Cannot size shared memory segment " + name + " to " + std::to_string(_mapping_len) +
+                               " bytes",
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _mapping = mmap(nullptr, _mapping_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (_mapping == MAP_FAILED)
+    {
+        _mapping = nullptr;
+        close(fd);
+        throw ANNException("Cannot map shared memory segment " + name, -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _data = (char *)_mapping + SEGMENT_HEADER_LEN;
+
+    auto header = (SegmentHeader *)_mapping;
+    if (header->ready.load() == 0 || header->magic != SEGMENT_MAGIC || header->size != size)
+    {
+        try
+        {
+            memset(_data, 0, size);
+            fill(_data);
+        }
+        catch (...)
+        {
+            munmap(_mapping, _mapping_len);
+            close(fd);
+            throw;
+        }
+        header->magic = SEGMENT_MAGIC;
+        header->size = size;
+        header->ready.store(1);
+        _filled_here = true;
+        diskann::cout << "Filled shared memory segment " << name << " of " << size << " bytes" << std::endl;
+    }
+    else
+    {
+        diskann::cout << "Attached to shared memory segment " << name << " of " << size << " bytes" << std::endl;
+    }
+    // the buffer is read only from here on
+    mprotect(_mapping, _mapping_len, PROT_READ);
+    flock(fd, LOCK_UN);
+    close(fd);
+#endif
+}
+
+SharedSegment::~SharedSegment()
+{
+#ifndef _WINDOWS
+    if (_mapping != nullptr)
+        munmap(_mapping, _mapping_len);
+#endif
+}
+
+void SharedSegment::remove(const std::string &name)
+{
+#ifndef _WINDOWS
+    shm_unlink(shm_name(name).c_str());
+#endif
+}
+} // namespace diskann
@@ -0,0 +1,370 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "spdk_aligned_file_reader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include <spdk/env.h>
+#include <spdk/nvme.h>
+
+#include "ann_exception.h"
+#include "defaults.h"
+#include "logger.h"
+#include "utils.h"
+
+// commands each queue pair keeps outstanding, each reading into its own slot
+// of the bounce buffer
+#define SPDK_SLOTS MAX_IO_DEPTH
+// the largest read a slot takes; longer requests are split into pieces
+#define SPDK_SLOT_SECTORS 8
+
+struct SpdkAlignedFileReader::QueuePair
+{
+    struct Slot
+    {
+        QueuePair *qp;
+        char *bounce;
+        char *dst;
+        uint64_t len;
+        uint64_t request;
+    };
+
+    spdk_nvme_qpair *qpair = nullptr;
+    char *bounce = nullptr;
+    Slot slots[SPDK_SLOTS];
+    std::vector<uint32_t> free_slots;
+    // pieces still in flight for each request of the last submission
+    std::vector<uint32_t> in_flight;
+    // requests of the last submission that have completed, in order; those
+    // before next_done have been handed out by reap_reads()
+    std::vector<uint64_t> done;
+    uint64_t next_done = 0;
+    // status of a failed command, reported by the next poll()
+    bool failed = false;
+    int status_type = 0;
+    int status_code = 0;
+};
+
+namespace
+{
+std::string location_path(const std::string &index_file)
+{
+    return index_file + ".spdk";
+}
+
+void throw_spdk_error(const std::string &call, int64_t ret)
+{
+    std::stringstream stream;
+    stream << call << " failed; returned " << ret;
+    if (ret < 0)
+        stream << ", " << ::strerror((int)-ret);
+    throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+// the SPDK environment (hugepage memory, PCI access) is set up once per process
+void init_spdk_env()
+{
+    static std::once_flag once;
+    static int ret = 0;
+    std::call_once(once, [] {
+        struct spdk_env_opts opts;
+        spdk_env_opts_init(&opts);
+        opts.name = "diskann";
+        ret = spdk_env_init(&opts);
+    });
+    if (ret < 0)
+        throw_spdk_error("spdk_env_init()", ret);
+}
+} // namespace
+
+SpdkAlignedFileReader::~SpdkAlignedFileReader()
+{
+    close();
+}
+
+SpdkAlignedFileReader::QueuePair *SpdkAlignedFileReader::to_qpair(IOContext &ctx)
+{
+    return reinterpret_cast<QueuePair *>(ctx);
+}
+
+SpdkAlignedFileReader::QueuePair *SpdkAlignedFileReader::new_qpair()
+{
+    if (_ctrlr == nullptr)
+    {
+        throw diskann::ANNException("SpdkAlignedFileReader contexts need open() first", -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+    QueuePair *qp = new QueuePair();
+    qp->qpair = spdk_nvme_ctrlr_alloc_io_qpair(_ctrlr, nullptr, 0);
+    if (qp->qpair == nullptr)
+    {
+        delete qp;
+        throw diskann::ANNException("spdk_nvme_ctrlr_alloc_io_qpair() failed", -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    qp->bounce = (char *)spdk_zmalloc(SPDK_SLOTS * _slot_bytes, diskann::defaults::SECTOR_LEN, nullptr,
+                                      SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+    if (qp->bounce == nullptr)
+    {
+        spdk_nvme_ctrlr_free_io_qpair(qp->qpair);
+        delete qp;
+        throw diskann::ANNException("Cannot allocate a DMA bounce buffer; are enough hugepages reserved?", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    for (uint32_t s = 0; s < SPDK_SLOTS; s++)
+    {
+        qp->slots[s] = {qp, qp->bounce + s * _slot_bytes, nullptr, 0, 0};
+        qp->free_slots.push_back(s);
+    }
+    return qp;
+}
+
+void SpdkAlignedFileReader::destroy_qpair(IOContext ctx)
+{
+    QueuePair *qp = to_qpair(ctx);
+    spdk_nvme_ctrlr_free_io_qpair(qp->qpair);
+    spdk_free(qp->bounce);
+    delete qp;
+}
+
+IOContext &SpdkAlignedFileReader::get_ctx()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    auto iter = ctx_map.find(std::this_thread::get_id());
+    if (iter == ctx_map.end())
+    {
+        lk.unlock();
+        register_thread();
+        lk.lock();
+        iter = ctx_map.find(std::this_thread::get_id());
+    }
+    if (iter == ctx_map.end())
+    {
+        std::cerr << "bad thread access; returning -1 as io_context_t" << std::endl;
+        return this->bad_ctx;
+    }
+    return iter.value();
+}
+
+IOContext SpdkAlignedFileReader::create_ctx()
+{
+    QueuePair *qp = new_qpair();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    owned_ctxs.push_back(reinterpret_cast<IOContext>(qp));
+    return reinterpret_cast<IOContext>(qp);
+}
+
+void SpdkAlignedFileReader::register_thread()
+{
+    auto my_id = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    if (ctx_map.find(my_id) != ctx_map.end())
+    {
+        std::cerr << "multiple calls to register_thread from the same thread" << std::endl;
+        return;
+    }
+
+    QueuePair *qp = new_qpair();
+    diskann::cout << "allocating NVMe queue pair: " << qp << " to thread-id:" << my_id << std::endl;
+    ctx_map[my_id] = reinterpret_cast<IOContext>(qp);
+}
+
+void SpdkAlignedFileReader::deregister_thread()
+{
+    auto my_id = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    auto iter = ctx_map.find(my_id);
+    if (iter == ctx_map.end())
+        return;
+    destroy_qpair(iter->second);
+    ctx_map.erase(iter);
+    std::cerr << "returned ctx from thread-id:" << my_id << std::endl;
+}
+
+void SpdkAlignedFileReader::deregister_all_threads()
+{
+    std::unique_lock<std::mutex> lk(ctx_mut);
+    for (auto x = ctx_map.begin(); x != ctx_map.end(); x++)
+    {
+        destroy_qpair(x.value());
+    }
+    ctx_map.clear();
+    for (IOContext ctx : owned_ctxs)
+        destroy_qpair(ctx);
+    owned_ctxs.clear();
+}
+
+void SpdkAlignedFileReader::reset_after_fork()
+{
+    throw diskann::ANNException("SPDK readers cannot be used after fork(); load the index in the child process", -1,
+                                __FUNCSIG__, __FILE__, __LINE__);
+}
+
+void SpdkAlignedFileReader::open(const std::string &fname)
+{
+    std::ifstream location(location_path(fname));
+    std::string trid_str;
+    uint32_t nsid = 0;
+    if (!std::getline(location, trid_str) || !(location >> nsid >> _base_offset))
+    {
+        throw diskann::ANNException("No valid NVMe location at " + location_path(fname), -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+
+    init_spdk_env();
+    struct spdk_nvme_transport_id trid;
+    memset(&trid, 0, sizeof(trid));
+    if (spdk_nvme_transport_id_parse(&trid, trid_str.c_str()) != 0)
+    {
+        throw diskann::ANNException("Cannot parse the SPDK transport id \"" + trid_str + "\"", -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+    }
+    _ctrlr = spdk_nvme_connect(&trid, nullptr, 0);
+    if (_ctrlr == nullptr)
+    {
+        throw diskann::ANNException("Cannot attach the NVMe controller at \"" + trid_str +
+                                        "\"; is it bound to vfio-pci or uio?",
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    _ns = spdk_nvme_ctrlr_get_ns(_ctrlr, nsid);
+    if (_ns == nullptr || !spdk_nvme_ns_is_active(_ns))
+    {
+        close();
+        throw diskann::ANNException("No active namespace " + std::to_string(nsid) + " at \"" + trid_str + "\"", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _block_size = spdk_nvme_ns_get_sector_size(_ns);
+    if (_base_offset % _block_size != 0 || diskann::defaults::SECTOR_LEN % _block_size != 0)
+    {
+        close();
+        throw diskann::ANNException("The index offset and sector size must be multiples of the namespace block size " +
+                                        std::to_string(_block_size),
+                                    -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    _slot_bytes = (std::min)((uint64_t)SPDK_SLOT_SECTORS * diskann::defaults::SECTOR_LEN,
+                             (uint64_t)spdk_nvme_ns_get_max_io_xfer_size(_ns));
+    _slot_bytes -= _slot_bytes % _block_size;
+
+    diskann::cout << "Opened " << fname << " on namespace " << nsid << " of " << trid_str << " at offset "
+                  << _base_offset << std::endl;
+}
+
+void SpdkAlignedFileReader::close()
+{
+    // queue pairs do not outlive their controller
+    deregister_all_threads();
+    if (_ctrlr != nullptr)
+        spdk_nvme_detach(_ctrlr);
+    _ctrlr = nullptr;
+    _ns = nullptr;
+}
+
+void SpdkAlignedFileReader::poll(QueuePair *qp)
+{
+    int32_t ret = spdk_nvme_qpair_process_completions(qp->qpair, 0);
+    if (ret < 0)
+        throw_spdk_error("spdk_nvme_qpair_process_completions()", ret);
+    if (qp->failed)
+    {
+        qp->failed = false;
+        std::stringstream stream;
+        stream << "NVMe read failed; status code type " << qp->status_type << ", status code " << qp->status_code;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+}
+
+void SpdkAlignedFileReader::submit(std::vector<AlignedRead> &read_reqs, QueuePair *qp)
+{
+    auto on_read_done = [](void *arg, const struct spdk_nvme_cpl *cpl) {
+        QueuePair::Slot *slot = (QueuePair::Slot *)arg;
+        QueuePair *qp = slot->qp;
+        if (spdk_nvme_cpl_is_error(cpl))
+        {
+            qp->failed = true;
+            qp->status_type = cpl->status.sct;
+            qp->status_code = cpl->status.sc;
+        }
+        else
+        {
+            memcpy(slot->dst, slot->bounce, slot->len);
+        }
+        qp->free_slots.push_back((uint32_t)(slot - qp->slots));
+        if (--qp->in_flight[slot->request] == 0)
+            qp->done.push_back(slot->request);
+    };
+
+    qp->done.clear();
+    qp->next_done = 0;
+    qp->in_flight.resize(read_reqs.size());
+    for (uint64_t r = 0; r < read_reqs.size(); r++)
+    {
+        if (read_reqs[r].offset % _block_size != 0 || read_reqs[r].len % _block_size != 0)
+        {
+            throw diskann::ANNException("NVMe reads must be aligned to the namespace block size", -1, __FUNCSIG__,
+                                        __FILE__, __LINE__);
+        }
+        // counted up front, as polling for a free slot can complete the
+        // first pieces of a request before the rest are queued
+        qp->in_flight[r] = (uint32_t)DIV_ROUND_UP(read_reqs[r].len, _slot_bytes);
+        if (qp->in_flight[r] == 0)
+            qp->done.push_back(r);
+    }
+
+    for (uint64_t r = 0; r < read_reqs.size(); r++)
+    {
+        AlignedRead &req = read_reqs[r];
+        for (uint64_t piece = 0; piece < req.len; piece += _slot_bytes)
+        {
+            while (qp->free_slots.empty())
+                poll(qp);
+            QueuePair::Slot *slot = &qp->slots[qp->free_slots.back()];
+            qp->free_slots.pop_back();
+            slot->dst = (char *)req.buf + piece;
+            slot->len = (std::min)(_slot_bytes, req.len - piece);
+            slot->request = r;
+
+            const uint64_t lba = (_base_offset + req.offset + piece) / _block_size;
+            int ret;
+            while ((ret = spdk_nvme_ns_cmd_read(_ns, qp->qpair, slot->bounce, lba, (uint32_t)(slot->len / _block_size),
+                                                on_read_done, slot, 0)) == -ENOMEM)
+                poll(qp);
+            if (ret != 0)
+                throw_spdk_error("spdk_nvme_ns_cmd_read()", ret);
+        }
+    }
+}
+
+void SpdkAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
+{
+    QueuePair *qp = to_qpair(ctx);
+    submit(read_reqs, qp);
+    while (qp->done.size() < read_reqs.size())
+        poll(qp);
+}
+
+void SpdkAlignedFileReader::submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx)
+{
+    submit(read_reqs, to_qpair(ctx));
+}
+
+void SpdkAlignedFileReader::reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                                       std::vector<uint64_t> &completed)
+{
+    QueuePair *qp = to_qpair(ctx);
+    min_completions = (std::min)(min_completions, max_completions);
+    min_completions = (std::min)(min_completions, (uint64_t)qp->in_flight.size() - qp->next_done);
+
+    // completions are polled, so waiting for them is spinning on the queue pair
+    do
+    {
+        poll(qp);
+    } while (qp->done.size() - qp->next_done < min_completions);
+
+    for (uint64_t n = 0; n < max_completions && qp->next_done < qp->done.size(); n++)
+        completed.push_back(qp->done[qp->next_done++]);
+}
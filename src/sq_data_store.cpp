@@ -0,0 +1,592 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cmath>
+#include <limits>
+
+#include "abstract_scratch.h"
+#include "sq_data_store.h"
+#include "pq_scratch.h"
+#include "simd_utils.h"
+#include "defaults.h"
+#include "utils.h"
+#include "memory_usage.h"
+
+namespace diskann
+{
+
+//
+// Query to code distances. The query is in float; for L2 it has already been
+// shifted by the per-dimension minimum, so each dimension contributes
+// (q - code * scale)^2, while inner product decodes min + code * scale. Both
+// return smaller-is-closer values, inner product negated as elsewhere.
+//
+template <uint32_t Bits> static inline uint32_t sq_code_at(const uint8_t *code, size_t d)
+{
+    if (Bits == 8)
+        return code[d];
+    return (code[d / 2] >> (4 * (d % 2))) & 0x0F;
+}
+
+template <uint32_t Bits, bool InnerProduct>
+static float sq_distance_tail(const float *query, const uint8_t *code, const float *min, const float *scale,
+                              size_t begin, size_t dim)
+{
+    float result = 0;
+    for (size_t d = begin; d < dim; d++)
+    {
+        float c = (float)sq_code_at<Bits>(code, d);
+        if (InnerProduct)
+        {
+            result += query[d] * (min[d] + c * scale[d]);
+        }
+        else
+        {
+            float diff = query[d] - c * scale[d];
+            result += diff * diff;
+        }
+    }
+    return result;
+}
+
+template <uint32_t Bits, bool InnerProduct>
+static float sq_distance(const float *query, const uint8_t *code, const float *min, const float *scale, size_t dim)
+{
+    float result = sq_distance_tail<Bits, InnerProduct>(query, code, min, scale, 0, dim);
+    return InnerProduct ? -result : result;
+}
+
+#ifdef USE_AVX2
+template <bool InnerProduct>
+static inline __m256 sq_accumulate(__m256 acc, __m256i codes_epi32, const float *query, const float *min,
+                                   const float *scale)
+{
+    __m256 c = _mm256_cvtepi32_ps(codes_epi32);
+    if (InnerProduct)
+    {
+        __m256 value = _mm256_fmadd_ps(c, _mm256_loadu_ps(scale), _mm256_loadu_ps(min));
+        return _mm256_fmadd_ps(_mm256_loadu_ps(query), value, acc);
+    }
+    __m256 diff = _mm256_fnmadd_ps(c, _mm256_loadu_ps(scale), _mm256_loadu_ps(query));
+    return _mm256_fmadd_ps(diff, diff, acc);
+}
+
+// 8 dimensions per step from 8 code bytes
+template <bool InnerProduct>
+static float sq8_distance_avx2(const float *query, const uint8_t *code, const float *min, const float *scale,
+                               size_t dim)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t d = 0;
+    for (; d + 16 <= dim; d += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(code + d));
+        acc0 = sq_accumulate<InnerProduct>(acc0, _mm256_cvtepu8_epi32(bytes), query + d, min + d, scale + d);
+        acc1 = sq_accumulate<InnerProduct>(acc1, _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), query + d + 8,
+                                           min + d + 8, scale + d + 8);
+    }
+    for (; d + 8 <= dim; d += 8)
+    {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)(code + d));
+        acc0 = sq_accumulate<InnerProduct>(acc0, _mm256_cvtepu8_epi32(bytes), query + d, min + d, scale + d);
+    }
+    float result = _mm256_reduce_add_ps(_mm256_add_ps(acc0, acc1)) +
+                   sq_distance_tail<8, InnerProduct>(query, code, min, scale, d, dim);
+    return InnerProduct ? -result : result;
+}
+
+// 16 dimensions per step from 8 code bytes, low nibble first
+template <bool InnerProduct>
+static float sq4_distance_avx2(const float *query, const uint8_t *code, const float *min, const float *scale,
+                               size_t dim)
+{
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t d = 0;
+    for (; d + 16 <= dim; d += 16)
+    {
+        __m128i packed = _mm_loadl_epi64((const __m128i *)(code + d / 2));
+        __m128i lo = _mm_and_si128(packed, nibble_mask);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), nibble_mask);
+        __m128i bytes = _mm_unpacklo_epi8(lo, hi);
+        acc0 = sq_accumulate<InnerProduct>(acc0, _mm256_cvtepu8_epi32(bytes), query + d, min + d, scale + d);
+        acc1 = sq_accumulate<InnerProduct>(acc1, _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), query + d + 8,
+                                           min + d + 8, scale + d + 8);
+    }
+    float result = _mm256_reduce_add_ps(_mm256_add_ps(acc0, acc1)) +
+                   sq_distance_tail<4, InnerProduct>(query, code, min, scale, d, dim);
+    return InnerProduct ? -result : result;
+}
+#endif
+
+template <typename data_t>
+SQDataStore<data_t>::SQDataStore(size_t dim, location_t num_points, uint32_t num_bits,
+                                 std::unique_ptr<Distance<data_t>> distance_fn)
+    : AbstractDataStore<data_t>(num_points, dim), _num_bits(num_bits), _distance_metric(distance_fn->get_metric()),
+      _distance_fn(std::move(distance_fn))
+{
+    if (_num_bits != 8 && _num_bits != 4)
+    {
+        throw diskann::ANNException("ERROR: scalar quantization supports 8 or 4 bits per dimension", -1, __FUNCSIG__,
+                                    __FILE__, __LINE__);
+    }
+    if (_distance_metric != diskann::Metric::L2 && _distance_metric != diskann::Metric::INNER_PRODUCT)
+    {
+        throw diskann::ANNException("ERROR: scalar quantization supports only the L2 and inner product metrics", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    const bool inner_product = _distance_metric == diskann::Metric::INNER_PRODUCT;
+    if (_num_bits == 8)
+        _code_distance = inner_product ? &sq_distance<8, true> : &sq_distance<8, false>;
+    else
+        _code_distance = inner_product ? &sq_distance<4, true> : &sq_distance<4, false>;
+#ifdef USE_AVX2
+    if (Avx2SupportedCPU)
+    {
+        if (_num_bits == 8)
+            _code_distance = inner_product ? &sq8_distance_avx2<true> : &sq8_distance_avx2<false>;
+        else
+            _code_distance = inner_product ? &sq4_distance_avx2<true> : &sq4_distance_avx2<false>;
+    }
+#endif
+
+    _code_len = DIV_ROUND_UP(dim * _num_bits, 8);
+    _min.resize(dim, 0);
+    _scale.resize(dim, 0);
+    alloc_aligned(((void **)&_codes), this->_capacity * _code_len, 8);
+    std::memset(_codes, 0, this->_capacity * _code_len);
+}
+
+template <typename data_t> SQDataStore<data_t>::~SQDataStore()
+{
+    if (_codes != nullptr)
+    {
+        aligned_free(_codes);
+        _codes = nullptr;
+    }
+}
+
+template <typename data_t> void SQDataStore<data_t>::encode(const data_t *vector, uint8_t *code) const
+{
+    const float max_code = (float)((1U << _num_bits) - 1);
+    memset(code, 0, _code_len);
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        float c = _scale[d] > 0 ? std::round(((float)vector[d] - _min[d]) / _scale[d]) : 0;
+        uint32_t value = (uint32_t)(std::min)((std::max)(c, 0.0f), max_code);
+        if (_num_bits == 8)
+            code[d] = (uint8_t)value;
+        else
+            code[d / 2] |= (uint8_t)(value << (4 * (d % 2)));
+    }
+}
+
+template <typename data_t> void SQDataStore<data_t>::decode(const uint8_t *code, float *vector) const
+{
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        uint32_t c = _num_bits == 8 ? sq_code_at<8>(code, d) : sq_code_at<4>(code, d);
+        vector[d] = _min[d] + (float)c * _scale[d];
+    }
+}
+
+template <typename data_t> location_t SQDataStore<data_t>::load(const std::string &filename)
+{
+    return load_impl(filename);
+}
+
+template <typename data_t> location_t SQDataStore<data_t>::load_impl(const std::string &filename)
+{
+    size_t params_rows, params_dim;
+    std::unique_ptr<float[]> params;
+    diskann::load_bin<float>(get_params_filename(filename), params, params_rows, params_dim);
+    if (params_rows != 2 || params_dim != this->_dim)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << get_params_filename(filename) << " holds " << params_rows << "x" << params_dim
+               << " floats, but the data store expects 2x" << this->_dim << "." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    std::copy(params.get(), params.get() + this->_dim, _min.begin());
+    std::copy(params.get() + this->_dim, params.get() + 2 * this->_dim, _scale.begin());
+
+    size_t file_num_points, file_code_len;
+    std::unique_ptr<uint8_t[]> codes;
+    diskann::load_bin<uint8_t>(filename, codes, file_num_points, file_code_len);
+    if (file_code_len != _code_len)
+    {
+        std::stringstream stream;
+        stream << "ERROR: " << filename << " holds " << file_code_len << " byte codes, but the data store uses "
+               << _code_len << " byte codes." << std::endl;
+        diskann::cerr << stream.str() << std::endl;
+        throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    if (file_num_points > this->capacity())
+    {
+        this->resize((location_t)file_num_points);
+    }
+    memcpy(_codes, codes.get(), file_num_points * _code_len);
+
+    return (location_t)file_num_points;
+}
+
+template <typename data_t> size_t SQDataStore<data_t>::save(const std::string &filename, const location_t num_points)
+{
+    std::vector<float> params(_min);
+    params.insert(params.end(), _scale.begin(), _scale.end());
+    size_t bytes_written = diskann::save_bin<float>(get_params_filename(filename), params.data(), 2, this->_dim);
+    return bytes_written + diskann::save_bin<uint8_t>(filename, _codes, num_points, _code_len);
+}
+
+template <typename data_t> size_t SQDataStore<data_t>::get_aligned_dim() const
+{
+    return this->get_dims();
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::update_range(const data_t *vectors, const location_t num_pts, std::vector<float> &max)
+{
+    for (location_t i = 0; i < num_pts; i++)
+    {
+        for (size_t d = 0; d < this->_dim; d++)
+        {
+            float value = (float)vectors[i * this->_dim + d];
+            _min[d] = (std::min)(_min[d], value);
+            max[d] = (std::max)(max[d], value);
+        }
+    }
+}
+
+template <typename data_t> void SQDataStore<data_t>::set_scale(std::vector<float> &max, const location_t num_pts)
+{
+    const float max_code = (float)((1U << _num_bits) - 1);
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        if (num_pts == 0)
+            _min[d] = max[d] = 0;
+        _scale[d] = (max[d] - _min[d]) / max_code;
+    }
+}
+
+template <typename data_t> void SQDataStore<data_t>::populate_data(const data_t *vectors, const location_t num_pts)
+{
+    std::vector<float> max(this->_dim, std::numeric_limits<float>::lowest());
+    std::fill(_min.begin(), _min.end(), (std::numeric_limits<float>::max)());
+    update_range(vectors, num_pts, max);
+    set_scale(max, num_pts);
+
+    for (location_t i = 0; i < num_pts; i++)
+    {
+        encode(vectors + i * this->_dim, _codes + i * _code_len);
+    }
+}
+
+template <typename data_t> void SQDataStore<data_t>::populate_data(const std::string &filename, const size_t offset)
+{
+    size_t npts, ndim;
+    diskann::get_bin_metadata(filename, npts, ndim, offset);
+
+    if ((location_t)npts > this->capacity())
+    {
+        std::stringstream ss;
+        ss << "Number of points in the file: " << filename
+           << " is greater than the capacity of data store: " << this->capacity()
+           << ". Must invoke resize before calling populate_data()" << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+
+    if (ndim != this->get_dims())
+    {
+        std::stringstream ss;
+        ss << "Number of dimensions of a point in the file: " << filename
+           << " is not equal to dimensions of data store: " << this->get_dims() << "." << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+
+    // two passes over the file a block at a time, one for the range of each
+    // dimension and one to encode, so the full vectors are never all in memory
+    const size_t block_size =
+        (std::max)((size_t)1, defaults::MMAP_BUILD_BATCH_SIZE / (this->_dim * sizeof(data_t)));
+    std::vector<data_t> block((std::min)(block_size, npts) * this->_dim);
+    std::ifstream reader(filename, std::ios::binary);
+    std::vector<float> max(this->_dim, std::numeric_limits<float>::lowest());
+    std::fill(_min.begin(), _min.end(), (std::numeric_limits<float>::max)());
+    for (uint32_t pass = 0; pass < 2; pass++)
+    {
+        reader.seekg(offset + 2 * sizeof(uint32_t), std::ios::beg);
+        for (size_t start = 0; start < npts; start += block_size)
+        {
+            const size_t count = (std::min)(block_size, npts - start);
+            reader.read((char *)block.data(), count * this->_dim * sizeof(data_t));
+            if (!reader)
+                throw diskann::ANNException("ERROR: could not read the vectors of " + filename, -1, __FUNCSIG__,
+                                            __FILE__, __LINE__);
+            if (pass == 0)
+            {
+                update_range(block.data(), (location_t)count, max);
+                continue;
+            }
+            for (size_t i = 0; i < count; i++)
+                encode(block.data() + i * this->_dim, _codes + (start + i) * _code_len);
+        }
+        if (pass == 0)
+            set_scale(max, (location_t)npts);
+    }
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::extract_data_to_bin(const std::string &filename, const location_t num_pts)
+{
+    std::vector<data_t> vectors((size_t)num_pts * this->_dim);
+    for (location_t i = 0; i < num_pts; i++)
+    {
+        get_vector(i, vectors.data() + i * this->_dim);
+    }
+    diskann::save_bin<data_t>(filename, vectors.data(), num_pts, this->_dim);
+}
+
+template <typename data_t> void SQDataStore<data_t>::get_vector(const location_t i, data_t *target) const
+{
+    std::vector<float> decoded(this->_dim);
+    decode(_codes + i * _code_len, decoded.data());
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        target[d] = (data_t)decoded[d];
+    }
+}
+
+template <typename data_t> void SQDataStore<data_t>::set_vector(const location_t i, const data_t *const vector)
+{
+    encode(vector, _codes + i * _code_len);
+}
+
+template <typename data_t> void SQDataStore<data_t>::prefetch_vector(const location_t loc)
+{
+    diskann::prefetch_vector((const char *)(_codes + (size_t)loc * _code_len), _code_len);
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::move_vectors(const location_t old_location_start, const location_t new_location_start,
+                                       const location_t num_points)
+{
+    if (num_points == 0 || old_location_start == new_location_start)
+    {
+        return;
+    }
+    memmove(_codes + new_location_start * _code_len, _codes + old_location_start * _code_len,
+            num_points * _code_len);
+
+    // clear the codes in the old range that the new range does not cover
+    location_t mem_clear_loc_start = old_location_start;
+    location_t mem_clear_loc_end_limit = old_location_start + num_points;
+    if (new_location_start < old_location_start)
+    {
+        if (mem_clear_loc_start < new_location_start + num_points)
+            mem_clear_loc_start = new_location_start + num_points;
+    }
+    else if (mem_clear_loc_end_limit > new_location_start)
+    {
+        mem_clear_loc_end_limit = new_location_start;
+    }
+    memset(_codes + mem_clear_loc_start * _code_len, 0,
+           (size_t)(mem_clear_loc_end_limit - mem_clear_loc_start) * _code_len);
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::copy_vectors(const location_t from_loc, const location_t to_loc, const location_t num_points)
+{
+    memcpy(_codes + to_loc * _code_len, _codes + from_loc * _code_len, num_points * _code_len);
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::preprocess_query(const data_t *query, AbstractScratch<data_t> *scratch) const
+{
+    if (scratch == nullptr)
+    {
+        throw diskann::ANNException("Scratch space is null", -1);
+    }
+
+    PQScratch<data_t> *pq_scratch = scratch->pq_scratch();
+    if (pq_scratch == nullptr)
+    {
+        throw diskann::ANNException("PQScratch space has not been set in the scratch object.", -1);
+    }
+
+    const bool inner_product = _distance_metric == diskann::Metric::INNER_PRODUCT;
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        pq_scratch->aligned_query_float[d] = inner_product ? (float)query[d] : (float)query[d] - _min[d];
+    }
+}
+
+template <typename data_t> float SQDataStore<data_t>::get_distance(const data_t *query, const location_t loc) const
+{
+    std::vector<float> decoded(this->_dim);
+    decode(_codes + loc * _code_len, decoded.data());
+    float result = 0;
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        if (_distance_metric == diskann::Metric::INNER_PRODUCT)
+            result -= (float)query[d] * decoded[d];
+        else
+            result += ((float)query[d] - decoded[d]) * ((float)query[d] - decoded[d]);
+    }
+    return result;
+}
+
+template <typename data_t> float SQDataStore<data_t>::get_distance(const location_t loc1, const location_t loc2) const
+{
+    std::vector<float> decoded1(this->_dim), decoded2(this->_dim);
+    decode(_codes + loc1 * _code_len, decoded1.data());
+    decode(_codes + loc2 * _code_len, decoded2.data());
+    float result = 0;
+    for (size_t d = 0; d < this->_dim; d++)
+    {
+        if (_distance_metric == diskann::Metric::INNER_PRODUCT)
+            result -= decoded1[d] * decoded2[d];
+        else
+            result += (decoded1[d] - decoded2[d]) * (decoded1[d] - decoded2[d]);
+    }
+    return result;
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::get_distance(const data_t *preprocessed_query, const location_t *locations,
+                                       const uint32_t location_count, float *distances,
+                                       AbstractScratch<data_t> *scratch_space) const
+{
+    if (scratch_space == nullptr || scratch_space->pq_scratch() == nullptr)
+    {
+        throw diskann::ANNException("PQScratch not set in scratch space.", -1);
+    }
+    const float *query = scratch_space->pq_scratch()->aligned_query_float;
+
+    const uint32_t ahead = (std::min)(location_count, defaults::DISTANCE_PREFETCH_AHEAD);
+    for (uint32_t i = 0; i < ahead; i++)
+    {
+        diskann::prefetch_vector((const char *)(_codes + locations[i] * _code_len), _code_len);
+    }
+    for (uint32_t i = 0; i < location_count; i++)
+    {
+        if (i + defaults::DISTANCE_PREFETCH_AHEAD < location_count)
+        {
+            location_t next = locations[i + defaults::DISTANCE_PREFETCH_AHEAD];
+            diskann::prefetch_vector((const char *)(_codes + next * _code_len), _code_len);
+        }
+        distances[i] = _code_distance(query, _codes + locations[i] * _code_len, _min.data(), _scale.data(),
+                                      this->_dim);
+    }
+}
+
+template <typename data_t>
+void SQDataStore<data_t>::get_distance(const data_t *preprocessed_query, const std::vector<location_t> &ids,
+                                       std::vector<float> &distances, AbstractScratch<data_t> *scratch_space) const
+{
+    if (distances.size() < ids.size())
+    {
+        distances.resize(ids.size());
+    }
+    SQDataStore<data_t>::get_distance(preprocessed_query, ids.data(), (uint32_t)ids.size(), distances.data(),
+                                      scratch_space);
+}
+
+template <typename data_t> Distance<data_t> *SQDataStore<data_t>::get_dist_fn() const
+{
+    return _distance_fn.get();
+}
+
+// Returns the point whose decoded vector is closest to the mean of all the
+// decoded vectors
+template <typename data_t> location_t SQDataStore<data_t>::calculate_medoid() const
+{
+    std::vector<float> center(this->_dim, 0), decoded(this->_dim);
+    for (location_t i = 0; i < this->capacity(); i++)
+    {
+        decode(_codes + i * _code_len, decoded.data());
+        for (size_t d = 0; d < this->_dim; d++)
+            center[d] += decoded[d];
+    }
+    for (size_t d = 0; d < this->_dim; d++)
+        center[d] /= (float)this->capacity();
+
+    location_t min_idx = 0;
+    float min_dist = (std::numeric_limits<float>::max)();
+    for (location_t i = 0; i < this->capacity(); i++)
+    {
+        decode(_codes + i * _code_len, decoded.data());
+        float dist = 0;
+        for (size_t d = 0; d < this->_dim; d++)
+            dist += (decoded[d] - center[d]) * (decoded[d] - center[d]);
+        if (dist < min_dist)
+        {
+            min_idx = i;
+            min_dist = dist;
+        }
+    }
+    return min_idx;
+}
+
+template <typename data_t> size_t SQDataStore<data_t>::get_alignment_factor() const
+{
+    return 1;
+}
+
+template <typename data_t> size_t SQDataStore<data_t>::memory_size() const
+{
+    return this->capacity() * _code_len + vector_bytes(_min) + vector_bytes(_scale);
+}
+
+template <typename data_t> void SQDataStore<data_t>::reallocate_codes(const location_t new_size)
+{
+    uint8_t *new_codes;
+    alloc_aligned((void **)&new_codes, (size_t)new_size * _code_len, 8);
+    memset(new_codes, 0, (size_t)new_size * _code_len);
+    memcpy(new_codes, _codes, (size_t)(std::min)(new_size, this->capacity()) * _code_len);
+    aligned_free(_codes);
+    _codes = new_codes;
+    this->_capacity = new_size;
+}
+
+template <typename data_t> location_t SQDataStore<data_t>::expand(const location_t new_size)
+{
+    if (new_size == this->capacity())
+    {
+        return this->capacity();
+    }
+    else if (new_size < this->capacity())
+    {
+        std::stringstream ss;
+        ss << "Cannot 'expand' datastore when new capacity (" << new_size << ") < existing capacity("
+           << this->capacity() << ")" << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+    reallocate_codes(new_size);
+    return this->_capacity;
+}
+
+template <typename data_t> location_t SQDataStore<data_t>::shrink(const location_t new_size)
+{
+    if (new_size == this->capacity())
+    {
+        return this->capacity();
+    }
+    else if (new_size > this->capacity())
+    {
+        std::stringstream ss;
+        ss << "Cannot 'shrink' datastore when new capacity (" << new_size << ") > existing capacity("
+           << this->capacity() << ")" << std::endl;
+        throw diskann::ANNException(ss.str(), -1);
+    }
+    reallocate_codes(new_size);
+    return this->_capacity;
+}
+
+template DISKANN_DLLEXPORT class SQDataStore<int8_t>;
+template DISKANN_DLLEXPORT class SQDataStore<float16>;
+template DISKANN_DLLEXPORT class SQDataStore<bfloat16>;
+template DISKANN_DLLEXPORT class SQDataStore<float>;
+template DISKANN_DLLEXPORT class SQDataStore<uint8_t>;
+
+} // namespace diskann
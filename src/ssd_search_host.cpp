@@ -0,0 +1,112 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <vector>
+
+#include "ssd_search_host.h"
+#include "pq_scratch.h"
+#include "ann_exception.h"
+#include "logger.h"
+#ifndef _WINDOWS
+#include "linux_aligned_file_reader.h"
+#endif
+
+namespace diskann
+{
+// the scratch has room for the extra dimension MIPS indices search on
+template <typename T>
+SSDSearchHost<T>::SSDSearchHost(uint32_t num_threads, size_t max_dim)
+    : _num_threads(num_threads), _max_aligned_dim(ROUND_UP(max_dim + 1, 8))
+{
+#ifdef _WINDOWS
+    throw ANNException("Shared search scratch is not supported on Windows", -1, __FUNCSIG__, __FILE__, __LINE__);
+#else
+    if (num_threads < 2)
+        throw ANNException("A search host needs at least 2 threads", -1, __FUNCSIG__, __FILE__, __LINE__);
+    diskann::cout << "Setting up shared scratch and IO contexts for " << num_threads
+                  << " concurrent searches of up to " << max_dim << " dimensions" << std::endl;
+    _ctx_reader.reset(new LinuxAlignedFileReader());
+    for (uint32_t thread = 0; thread < num_threads; thread++)
+    {
+        SSDThreadData<T> *data = new SSDThreadData<T>(_max_aligned_dim, 4096);
+        data->ctx = _ctx_reader->create_ctx();
+        _thread_data.push(data);
+    }
+#endif
+}
+
+template <typename T> SSDSearchHost<T>::~SSDSearchHost()
+{
+    _thread_data.destroy();
+    if (_ctx_reader != nullptr)
+        _ctx_reader->deregister_all_threads();
+}
+
+template <typename T> void SSDSearchHost<T>::reserve(size_t aligned_dim, size_t pq_table_entries, bool vectors_ctx)
+{
+    if (aligned_dim > _max_aligned_dim)
+    {
+        throw ANNException("An index of " + std::to_string(aligned_dim) +
+                               " dimensions does not fit the scratch of the search host, of " +
+                               std::to_string(_max_aligned_dim),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    // take every scratch, so that none is grown while a search uses it
+    std::lock_guard<std::mutex> guard(_reserve_lock);
+    const bool add_vectors_ctx = vectors_ctx && !_has_vectors_ctx;
+    std::vector<uint32_t> taken;
+    taken.reserve(_num_threads);
+    for (uint32_t i = 0; i < _num_threads; i++)
+    {
+        uint32_t index;
+        SSDThreadData<T> *data = _thread_data.acquire(index);
+        data->scratch.pq_scratch()->reserve_pq_table(pq_table_entries);
+        if (add_vectors_ctx)
+            data->vectors_ctx = _ctx_reader->create_ctx();
+        taken.push_back(index);
+    }
+    for (uint32_t index : taken)
+        _thread_data.release(index);
+    _has_vectors_ctx = _has_vectors_ctx || vectors_ctx;
+}
+
+template <typename T> void SSDSearchHost<T>::reset_after_fork()
+{
+    if (_ctx_reader == nullptr)
+        return;
+    std::lock_guard<std::mutex> guard(_reserve_lock);
+    _ctx_reader->reset_after_fork();
+    std::vector<uint32_t> taken;
+    taken.reserve(_num_threads);
+    for (uint32_t i = 0; i < _num_threads; i++)
+    {
+        uint32_t index;
+        SSDThreadData<T> *data = _thread_data.try_acquire(index);
+        if (data == nullptr)
+        {
+            throw ANNException("A search was running at fork(); the child cannot search on the host", -1,
+                               __FUNCSIG__, __FILE__, __LINE__);
+        }
+        data->ctx = _ctx_reader->create_ctx();
+        if (_has_vectors_ctx)
+            data->vectors_ctx = _ctx_reader->create_ctx();
+        taken.push_back(index);
+    }
+    for (uint32_t index : taken)
+        _thread_data.release(index);
+}
+
+template <typename T> MemoryUsage SSDSearchHost<T>::get_memory_usage()
+{
+    MemoryUsage usage;
+    usage.add("shared_scratch", _thread_data.memory_size());
+    return usage;
+}
+
+template class SSDSearchHost<uint8_t>;
+template class SSDSearchHost<int8_t>;
+template class SSDSearchHost<float16>;
+template class SSDSearchHost<bfloat16>;
+template class SSDSearchHost<float>;
+} // namespace diskann
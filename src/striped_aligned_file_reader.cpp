@@ -0,0 +1,277 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "striped_aligned_file_reader.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "ann_exception.h"
+#include "logger.h"
+#include "tsl/robin_map.h"
+#include "utils.h"
+
+// the depth of the contexts set up by LinuxAlignedFileReader
+#define MAX_EVENTS 1024
+
+namespace
+{
+typedef struct io_event io_event_t;
+typedef struct iocb iocb_t;
+
+// pieces still in flight for each request of the reads submitted on each
+// context of this thread. A context is used by one thread at a time, and its
+// user reaps all its reads before handing it on.
+std::vector<uint32_t> &pieces_in_flight(io_context_t ctx)
+{
+    thread_local tsl::robin_map<io_context_t, std::vector<uint32_t>> in_flight;
+    return in_flight[ctx];
+}
+
+std::string manifest_path(const std::string &index_file)
+{
+    return index_file + ".stripes";
+}
+
+void throw_io_error(const std::string &call, int64_t ret)
+{
+    std::stringstream stream;
+    stream << call << " failed; returned " << ret;
+    if (ret < 0)
+        stream << ", " << ::strerror((int)-ret);
+    throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+} // namespace
+
+StripedAlignedFileReader::~StripedAlignedFileReader()
+{
+    close();
+}
+
+void StripedAlignedFileReader::stripe_file(const std::string &index_file, const std::vector<std::string> &stripe_paths,
+                                           uint64_t stripe_sectors, bool truncate_original)
+{
+    if (stripe_paths.empty() || stripe_sectors == 0)
+    {
+        throw diskann::ANNException("Striping needs at least one stripe file and a non-zero stripe unit", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    std::ifstream in(index_file, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        throw diskann::ANNException("Cannot open " + index_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+    const uint64_t file_size = (uint64_t)in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    std::vector<std::unique_ptr<std::ofstream>> stripes;
+    for (const std::string &path : stripe_paths)
+    {
+        stripes.emplace_back(new std::ofstream(path, std::ios::binary | std::ios::trunc));
+        if (!stripes.back()->is_open())
+            throw diskann::ANNException("Cannot create stripe " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    const uint64_t stripe_bytes = stripe_sectors * diskann::defaults::SECTOR_LEN;
+    std::vector<char> unit(stripe_bytes);
+    for (uint64_t offset = 0, u = 0; offset < file_size; offset += stripe_bytes, u++)
+    {
+        const uint64_t len = (std::min)(stripe_bytes, file_size - offset);
+        in.read(unit.data(), len);
+        std::ofstream &out = *stripes[u % stripes.size()];
+        out.write(unit.data(), len);
+        if (!in || !out)
+        {
+            throw diskann::ANNException("Failed to copy " + index_file + " into its stripes", -1, __FUNCSIG__,
+                                        __FILE__, __LINE__);
+        }
+    }
+    for (size_t i = 0; i < stripes.size(); i++)
+    {
+        stripes[i]->close();
+        if (stripes[i]->fail())
+            throw diskann::ANNException("Failed to write " + stripe_paths[i], -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    in.close();
+
+    std::ofstream manifest(manifest_path(index_file));
+    manifest << stripe_sectors << "\n";
+    for (const std::string &path : stripe_paths)
+        manifest << path << "\n";
+    manifest.close();
+    if (manifest.fail())
+    {
+        throw diskann::ANNException("Failed to write " + manifest_path(index_file), -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+
+    if (truncate_original && truncate(index_file.c_str(), (off_t)diskann::defaults::SECTOR_LEN) != 0)
+        throw diskann::ANNException("Failed to truncate " + index_file, -1, __FUNCSIG__, __FILE__, __LINE__);
+    diskann::cout << "Striped " << file_size << " bytes of " << index_file << " over " << stripe_paths.size()
+                  << " files in units of " << stripe_sectors << " sectors" << std::endl;
+}
+
+bool StripedAlignedFileReader::is_striped(const std::string &index_file)
+{
+    return file_exists(manifest_path(index_file));
+}
+
+void StripedAlignedFileReader::open(const std::string &fname)
+{
+    std::ifstream manifest(manifest_path(fname));
+    uint64_t stripe_sectors = 0;
+    if (!(manifest >> stripe_sectors) || stripe_sectors == 0)
+    {
+        throw diskann::ANNException("No valid stripe list at " + manifest_path(fname), -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+    _stripe_bytes = stripe_sectors * diskann::defaults::SECTOR_LEN;
+
+    std::string path;
+    while (std::getline(manifest, path))
+    {
+        if (path.empty())
+            continue;
+        int fd = ::open(path.c_str(), O_DIRECT | O_RDONLY | O_LARGEFILE);
+        if (fd == -1)
+        {
+            std::string error = ::strerror(errno);
+            close();
+            throw diskann::ANNException("Cannot open stripe " + path + ": " + error, -1, __FUNCSIG__, __FILE__,
+                                        __LINE__);
+        }
+        _fds.push_back(fd);
+    }
+    if (_fds.empty())
+        throw diskann::ANNException(manifest_path(fname) + " lists no stripes", -1, __FUNCSIG__, __FILE__, __LINE__);
+    diskann::cout << "Opened " << fname << " striped over " << _fds.size() << " files" << std::endl;
+}
+
+void StripedAlignedFileReader::close()
+{
+    for (int fd : _fds)
+        ::close(fd);
+    _fds.clear();
+}
+
+void StripedAlignedFileReader::split(std::vector<AlignedRead> &read_reqs, std::vector<Piece> &pieces) const
+{
+    const uint64_t num_stripes = _fds.size();
+    for (uint64_t r = 0; r < read_reqs.size(); r++)
+    {
+        uint64_t offset = read_reqs[r].offset;
+        uint64_t left = read_reqs[r].len;
+        char *buf = (char *)read_reqs[r].buf;
+        while (left > 0)
+        {
+            const uint64_t unit = offset / _stripe_bytes;
+            const uint64_t in_unit = offset % _stripe_bytes;
+            const uint64_t len = (std::min)(left, _stripe_bytes - in_unit);
+            pieces.push_back({_fds[unit % num_stripes], (unit / num_stripes) * _stripe_bytes + in_unit, len, buf, r});
+            offset += len;
+            buf += len;
+            left -= len;
+        }
+    }
+}
+
+void StripedAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
+{
+    std::vector<Piece> pieces;
+    split(read_reqs, pieces);
+
+    std::vector<iocb_t> cb;
+    std::vector<iocb_t *> cbs;
+    std::vector<io_event_t> evts;
+    for (uint64_t start = 0; start < pieces.size(); start += MAX_EVENTS)
+    {
+        const uint64_t n_ops = (std::min)((uint64_t)pieces.size() - start, (uint64_t)MAX_EVENTS);
+        cb.resize(n_ops);
+        cbs.resize(n_ops);
+        evts.resize(n_ops);
+        for (uint64_t j = 0; j < n_ops; j++)
+        {
+            const Piece &piece = pieces[start + j];
+            io_prep_pread(cb.data() + j, piece.fd, piece.buf, piece.len, piece.offset);
+            cbs[j] = cb.data() + j;
+        }
+
+        int64_t ret = io_submit(ctx, (int64_t)n_ops, cbs.data());
+        if (ret != (int64_t)n_ops)
+            throw_io_error("io_submit()", ret);
+        uint64_t n_reaped = 0;
+        while (n_reaped < n_ops)
+        {
+            ret = io_getevents(ctx, (int64_t)(n_ops - n_reaped), (int64_t)(n_ops - n_reaped), evts.data(), nullptr);
+            if (ret == -EINTR)
+                continue;
+            if (ret <= 0)
+                throw_io_error("io_getevents()", ret);
+            for (int64_t i = 0; i < ret; i++)
+            {
+                if ((int64_t)evts[i].res < 0)
+                    throw_io_error("striped read", (int64_t)evts[i].res);
+            }
+            n_reaped += (uint64_t)ret;
+        }
+    }
+}
+
+void StripedAlignedFileReader::submit_reads(std::vector<AlignedRead> &read_reqs, IOContext &ctx)
+{
+    std::vector<Piece> pieces;
+    split(read_reqs, pieces);
+    if (pieces.size() > MAX_EVENTS)
+    {
+        throw diskann::ANNException("submit_reads() supports at most MAX_EVENTS outstanding pieces", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    std::vector<uint32_t> &in_flight = pieces_in_flight(ctx);
+    in_flight.assign(read_reqs.size(), 0);
+    std::vector<iocb_t> cb(pieces.size());
+    std::vector<iocb_t *> cbs(pieces.size());
+    for (uint64_t j = 0; j < pieces.size(); j++)
+    {
+        const Piece &piece = pieces[j];
+        io_prep_pread(cb.data() + j, piece.fd, piece.buf, piece.len, piece.offset);
+        cb[j].data = (void *)piece.request;
+        cbs[j] = cb.data() + j;
+        in_flight[piece.request]++;
+    }
+
+    int64_t ret = io_submit(ctx, (int64_t)pieces.size(), cbs.data());
+    if (ret != (int64_t)pieces.size())
+        throw_io_error("io_submit()", ret);
+}
+
+void StripedAlignedFileReader::reap_reads(IOContext &ctx, uint64_t min_completions, uint64_t max_completions,
+                                          std::vector<uint64_t> &completed)
+{
+    io_event_t evts[MAX_IO_DEPTH];
+    max_completions = (std::min)(max_completions, (uint64_t)MAX_IO_DEPTH);
+    min_completions = (std::min)(min_completions, max_completions);
+
+    // each piece completes at most one request, so asking for no more pieces
+    // than requests still wanted never overshoots max_completions
+    std::vector<uint32_t> &in_flight = pieces_in_flight(ctx);
+    uint64_t n_completed = 0;
+    while (n_completed < min_completions)
+    {
+        int64_t ret = io_getevents(ctx, 1, (int64_t)(max_completions - n_completed), evts, nullptr);
+        if (ret == -EINTR)
+            continue;
+        if (ret < 0)
+            throw_io_error("io_getevents()", ret);
+        for (int64_t i = 0; i < ret; i++)
+        {
+            if ((int64_t)evts[i].res < 0)
+                throw_io_error("async striped read", (int64_t)evts[i].res);
+            const uint64_t request = (uint64_t)evts[i].data;
+            if (--in_flight[request] == 0)
+            {
+                completed.push_back(request);
+                n_completed++;
+            }
+        }
+    }
+}
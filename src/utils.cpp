@@ -61,19 +61,104 @@ bool cpuHasAvx2Support()
     return false;
 }
 
+// AVX-512 also needs the OS to save the opmask and ZMM state (XCR0 bits 5-7)
+bool cpuHasAvx512Support(bool require_vnni)
+{
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    if (!(cpuInfo[2] & (1 << 27)))
+        return false;
+    if ((_xgetbv(_XCR_XFEATURE_ENABLED_MASK) & 0xe6) != 0xe6)
+        return false;
+
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] < 7)
+        return false;
+    __cpuidex(cpuInfo, 7, 0);
+    const int avx512Mask = (1 << 16) | (1 << 30) | (1 << 31); // F, BW, VL
+    if ((cpuInfo[1] & avx512Mask) != avx512Mask)
+        return false;
+    return !require_vnni || (cpuInfo[2] & (1 << 11));
+}
+
+bool cpuHasAvx512Bf16Support()
+{
+    if (!cpuHasAvx512Support(false))
+        return false;
+    int cpuInfo[4];
+    __cpuidex(cpuInfo, 7, 1);
+    return (cpuInfo[0] & (1 << 5)) != 0;
+}
+
+bool cpuHasAvx512PopcntSupport()
+{
+    if (!cpuHasAvx512Support(false))
+        return false;
+    int cpuInfo[4];
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[2] & (1 << 14)) != 0;
+}
+
 bool AvxSupportedCPU = cpuHasAvxSupport();
 bool Avx2SupportedCPU = cpuHasAvx2Support();
+bool Avx512SupportedCPU = cpuHasAvx512Support(false);
+bool Avx512VnniSupportedCPU = cpuHasAvx512Support(true);
+bool Avx512Bf16SupportedCPU = cpuHasAvx512Bf16Support();
+bool Avx512PopcntSupportedCPU = cpuHasAvx512PopcntSupport();
+bool SveSupportedCPU = false;
+
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+
+// NEON is part of AArch64 and needs no check; SVE is optional (Graviton3 and
+// Neoverse V1/V2 have it, Graviton2 and Ampere Altra do not)
+bool AvxSupportedCPU = false;
+bool Avx2SupportedCPU = false;
+bool Avx512SupportedCPU = false;
+bool Avx512VnniSupportedCPU = false;
+bool Avx512Bf16SupportedCPU = false;
+bool Avx512PopcntSupportedCPU = false;
+bool SveSupportedCPU = (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
 
 #else
 
+bool cpuHasAvx512Support(bool require_vnni)
+{
+    // runs from a static initializer, possibly before libgcc has set up the
+    // cpu model
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512bw") ||
+        !__builtin_cpu_supports("avx512vl"))
+        return false;
+    return !require_vnni || __builtin_cpu_supports("avx512vnni");
+}
+
+bool cpuHasAvx512Bf16Support()
+{
+    return cpuHasAvx512Support(false) && __builtin_cpu_supports("avx512bf16");
+}
+
+bool cpuHasAvx512PopcntSupport()
+{
+    return cpuHasAvx512Support(false) && __builtin_cpu_supports("avx512vpopcntdq");
+}
+
 bool Avx2SupportedCPU = true;
 bool AvxSupportedCPU = false;
+bool Avx512SupportedCPU = cpuHasAvx512Support(false);
+bool Avx512VnniSupportedCPU = cpuHasAvx512Support(true);
+bool Avx512Bf16SupportedCPU = cpuHasAvx512Bf16Support();
+bool Avx512PopcntSupportedCPU = cpuHasAvx512PopcntSupport();
+bool SveSupportedCPU = false;
 #endif
 
 namespace diskann
 {
 
-void block_convert(std::ofstream &writr, std::ifstream &readr, float *read_buf, size_t npts, size_t ndims)
+void block_convert(std::ofstream &writr, cached_ifstream &readr, float *read_buf, size_t npts, size_t ndims)
 {
     readr.read((char *)read_buf, npts * ndims * sizeof(float));
     uint32_t ndims_u32 = (uint32_t)ndims;
@@ -96,7 +181,7 @@ void block_convert(std::ofstream &writr, std::ifstream &readr, float *read_buf,
 
 void normalize_data_file(const std::string &inFileName, const std::string &outFileName)
 {
-    std::ifstream readr(inFileName, std::ios::binary);
+    cached_ifstream readr(inFileName, 64 * 1024 * 1024);
     std::ofstream writr(outFileName, std::ios::binary);
 
     int npts_s32, ndims_s32;
@@ -427,6 +512,10 @@ template DISKANN_DLLEXPORT void load_bin<uint8_t>(AlignedFileReader &reader, std
                                                   size_t &npts, size_t &ndim, size_t offset);
 template DISKANN_DLLEXPORT void load_bin<int8_t>(AlignedFileReader &reader, std::unique_ptr<int8_t[]> &data,
                                                  size_t &npts, size_t &ndim, size_t offset);
+template DISKANN_DLLEXPORT void load_bin<float16>(AlignedFileReader &reader, std::unique_ptr<float16[]> &data,
+                                                  size_t &npts, size_t &ndim, size_t offset);
+template DISKANN_DLLEXPORT void load_bin<bfloat16>(AlignedFileReader &reader, std::unique_ptr<bfloat16[]> &data,
+                                                   size_t &npts, size_t &ndim, size_t offset);
 template DISKANN_DLLEXPORT void load_bin<uint32_t>(AlignedFileReader &reader, std::unique_ptr<uint32_t[]> &data,
                                                    size_t &npts, size_t &ndim, size_t offset);
 template DISKANN_DLLEXPORT void load_bin<uint64_t>(AlignedFileReader &reader, std::unique_ptr<uint64_t[]> &data,
@@ -453,6 +542,12 @@ template DISKANN_DLLEXPORT void copy_aligned_data_from_file<uint8_t>(AlignedFile
 template DISKANN_DLLEXPORT void copy_aligned_data_from_file<int8_t>(AlignedFileReader &reader, int8_t *&data,
                                                                     size_t &npts, size_t &dim,
                                                                     const size_t &rounded_dim, size_t offset);
+template DISKANN_DLLEXPORT void copy_aligned_data_from_file<float16>(AlignedFileReader &reader, float16 *&data,
+                                                                     size_t &npts, size_t &dim,
+                                                                     const size_t &rounded_dim, size_t offset);
+template DISKANN_DLLEXPORT void copy_aligned_data_from_file<bfloat16>(AlignedFileReader &reader, bfloat16 *&data,
+                                                                      size_t &npts, size_t &dim,
+                                                                      const size_t &rounded_dim, size_t offset);
 template DISKANN_DLLEXPORT void copy_aligned_data_from_file<float>(AlignedFileReader &reader, float *&data,
                                                                    size_t &npts, size_t &dim, const size_t &rounded_dim,
                                                                    size_t offset);
@@ -462,12 +557,18 @@ template DISKANN_DLLEXPORT void read_array<char>(AlignedFileReader &reader, char
 template DISKANN_DLLEXPORT void read_array<uint8_t>(AlignedFileReader &reader, uint8_t *data, size_t size,
                                                     size_t offset);
 template DISKANN_DLLEXPORT void read_array<int8_t>(AlignedFileReader &reader, int8_t *data, size_t size, size_t offset);
+template DISKANN_DLLEXPORT void read_array<float16>(
+    AlignedFileReader &reader, float16 *data, size_t size, size_t offset);
+template DISKANN_DLLEXPORT void read_array<bfloat16>(
+    AlignedFileReader &reader, bfloat16 *data, size_t size, size_t offset);
 template DISKANN_DLLEXPORT void read_array<uint32_t>(AlignedFileReader &reader, uint32_t *data, size_t size,
                                                      size_t offset);
 template DISKANN_DLLEXPORT void read_array<float>(AlignedFileReader &reader, float *data, size_t size, size_t offset);
 
 template DISKANN_DLLEXPORT void read_value<uint8_t>(AlignedFileReader &reader, uint8_t &value, size_t offset);
 template DISKANN_DLLEXPORT void read_value<int8_t>(AlignedFileReader &reader, int8_t &value, size_t offset);
+template DISKANN_DLLEXPORT void read_value<float16>(AlignedFileReader &reader, float16 &value, size_t offset);
+template DISKANN_DLLEXPORT void read_value<bfloat16>(AlignedFileReader &reader, bfloat16 &value, size_t offset);
 template DISKANN_DLLEXPORT void read_value<float>(AlignedFileReader &reader, float &value, size_t offset);
 template DISKANN_DLLEXPORT void read_value<uint32_t>(AlignedFileReader &reader, uint32_t &value, size_t offset);
 template DISKANN_DLLEXPORT void read_value<uint64_t>(AlignedFileReader &reader, uint64_t &value, size_t offset);
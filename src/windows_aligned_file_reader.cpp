@@ -28,16 +28,12 @@ void WindowsAlignedFileReader::close()
         IOContext ctx = ctx_map[k_v.first];
         CloseHandle(ctx.fhandle);
     }
+    for (IOContext &ctx : owned_ctxs)
+        CloseHandle(ctx.fhandle);
 }
 
-void WindowsAlignedFileReader::register_thread()
+IOContext WindowsAlignedFileReader::open_ctx()
 {
-    std::unique_lock<std::mutex> lk(this->ctx_mut);
-    if (this->ctx_map.find(std::this_thread::get_id()) != ctx_map.end())
-    {
-        diskann::cout << "Warning:: Duplicate registration for thread_id : " << std::this_thread::get_id() << std::endl;
-    }
-
     IOContext ctx;
     ctx.fhandle = CreateFile(
         m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
@@ -68,6 +64,17 @@ void WindowsAlignedFileReader::register_thread()
         // os.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
         ctx.reqs.push_back(os);
     }
+    return ctx;
+}
+
+void WindowsAlignedFileReader::register_thread()
+{
+    IOContext ctx = open_ctx();
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    if (this->ctx_map.find(std::this_thread::get_id()) != ctx_map.end())
+    {
+        diskann::cout << "Warning:: Duplicate registration for thread_id : " << std::this_thread::get_id() << std::endl;
+    }
     this->ctx_map.insert(std::make_pair(std::this_thread::get_id(), ctx));
 }
 
@@ -76,15 +83,23 @@ IOContext &WindowsAlignedFileReader::get_ctx()
     std::unique_lock<std::mutex> lk(this->ctx_mut);
     if (ctx_map.find(std::this_thread::get_id()) == ctx_map.end())
     {
-        std::stringstream stream;
-        stream << "unable to find IOContext for thread_id : " << std::this_thread::get_id() << "\n";
-        throw diskann::ANNException(stream.str(), -2, __FUNCSIG__, __FILE__, __LINE__);
+        lk.unlock();
+        register_thread();
+        lk.lock();
     }
     IOContext &ctx = ctx_map[std::this_thread::get_id()];
     lk.unlock();
     return ctx;
 }
 
+IOContext WindowsAlignedFileReader::create_ctx()
+{
+    IOContext ctx = open_ctx();
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    owned_ctxs.push_back(ctx);
+    return ctx;
+}
+
 void WindowsAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
 {
     using namespace std::chrono_literals;
@@ -121,9 +136,10 @@ void WindowsAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOConte
             uint64_t offset = req.offset;
             uint64_t nbytes = req.len;
             char *read_buf = (char *)req.buf;
-            assert(IS_ALIGNED(read_buf, SECTOR_LEN));
-            assert(IS_ALIGNED(offset, SECTOR_LEN));
-            assert(IS_ALIGNED(nbytes, SECTOR_LEN));
+            // disk indices may be laid out in sectors as short as 512 bytes
+            assert(IS_512_ALIGNED(read_buf));
+            assert(IS_512_ALIGNED(offset));
+            assert(IS_512_ALIGNED(nbytes));
 
             // fill in OVERLAPPED struct
             os.Offset = offset & 0xffffffff;
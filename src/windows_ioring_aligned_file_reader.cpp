@@ -0,0 +1,268 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#if defined(_WINDOWS) && !defined(USE_BING_INFRA) && defined(USE_IORING)
+#include "windows_ioring_aligned_file_reader.h"
+#include <sstream>
+#include "ann_exception.h"
+#include "utils.h"
+
+struct WindowsIoRingAlignedFileReader::RingContext
+{
+    HIORING ring = nullptr;
+    char *fixed_buf = nullptr;
+    size_t fixed_len = 0;
+};
+
+namespace
+{
+[[noreturn]] void throw_hresult(const std::string &call, HRESULT hr, const char *func, const char *file, int line)
+{
+    std::stringstream stream;
+    stream << call << " failed with HRESULT 0x" << std::hex << (uint32_t)hr;
+    diskann::cerr << stream.str() << std::endl;
+    throw diskann::ANNException(stream.str(), -1, func, file, line);
+}
+
+// submits the operations queued in ring and waits for the first num_ops of
+// them, which must complete without error
+void submit_and_wait(HIORING ring, uint32_t num_ops, const std::vector<AlignedRead> *read_reqs, uint64_t first_req)
+{
+    uint32_t submitted = 0;
+    HRESULT hr = SubmitIoRing(ring, num_ops, INFINITE, &submitted);
+    if (FAILED(hr))
+        throw_hresult("SubmitIoRing()", hr, __FUNCSIG__, __FILE__, __LINE__);
+
+    uint32_t n_complete = 0;
+    IORING_CQE cqe;
+    while (n_complete < num_ops)
+    {
+        hr = PopIoRingCompletion(ring, &cqe);
+        if (hr == S_FALSE)
+        {
+            // the wait above returns once num_ops completions are queued,
+            // but ask again rather than rely on it
+            hr = SubmitIoRing(ring, num_ops - n_complete, INFINITE, &submitted);
+            if (FAILED(hr))
+                throw_hresult("SubmitIoRing()", hr, __FUNCSIG__, __FILE__, __LINE__);
+            continue;
+        }
+        if (FAILED(hr))
+            throw_hresult("PopIoRingCompletion()", hr, __FUNCSIG__, __FILE__, __LINE__);
+        if (FAILED(cqe.ResultCode))
+        {
+            std::stringstream stream;
+            stream << "I/O failed";
+            if (read_reqs != nullptr)
+                stream << ", offset: " << (*read_reqs)[first_req + cqe.UserData].offset;
+            stream << " with HRESULT 0x" << std::hex << (uint32_t)cqe.ResultCode;
+            throw diskann::ANNException(stream.str(), -1, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        n_complete++;
+    }
+}
+} // namespace
+
+WindowsIoRingAlignedFileReader::~WindowsIoRingAlignedFileReader()
+{
+    deregister_all_threads();
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+}
+
+bool WindowsIoRingAlignedFileReader::is_supported()
+{
+    // the first version has the reads and registrations used here
+    IORING_CAPABILITIES caps;
+    return SUCCEEDED(QueryIoRingCapabilities(&caps)) && caps.MaxVersion >= IORING_VERSION_1;
+}
+
+WindowsIoRingAlignedFileReader::RingContext *WindowsIoRingAlignedFileReader::to_ring(IOContext &ctx)
+{
+    return reinterpret_cast<RingContext *>(ctx.ring);
+}
+
+void WindowsIoRingAlignedFileReader::open(const std::string &fname)
+{
+    if (!is_supported())
+    {
+        throw diskann::ANNException("This system does not support IoRing; use WindowsAlignedFileReader", -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+    IORING_CAPABILITIES caps;
+    QueryIoRingCapabilities(&caps);
+    m_version = caps.MaxVersion;
+
+#ifdef UNICODE
+    m_filename = std::wstring(fname.begin(), fname.end());
+#else
+    m_filename = fname;
+#endif
+    m_file = CreateFile(m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_READONLY | FILE_FLAG_NO_BUFFERING | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        throw diskann::ANNException("Error opening " + fname + " -- error=" + std::to_string(GetLastError()), -1,
+                                    __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    this->register_thread();
+}
+
+void WindowsIoRingAlignedFileReader::close()
+{
+    deregister_all_threads();
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+IOContext WindowsIoRingAlignedFileReader::new_ctx()
+{
+    RingContext *rctx = new RingContext();
+    IORING_CREATE_FLAGS flags;
+    flags.Required = IORING_CREATE_REQUIRED_FLAGS_NONE;
+    flags.Advisory = IORING_CREATE_ADVISORY_FLAGS_NONE;
+    HRESULT hr = CreateIoRing(m_version, flags, MAX_IO_DEPTH, 2 * MAX_IO_DEPTH, &rctx->ring);
+    if (FAILED(hr))
+    {
+        delete rctx;
+        throw_hresult("CreateIoRing()", hr, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    // reads then refer to the file as index 0 of the ring
+    hr = BuildIoRingRegisterFileHandles(rctx->ring, 1, &m_file, 0);
+    if (FAILED(hr))
+    {
+        CloseIoRing(rctx->ring);
+        delete rctx;
+        throw_hresult("BuildIoRingRegisterFileHandles()", hr, __FUNCSIG__, __FILE__, __LINE__);
+    }
+    submit_and_wait(rctx->ring, 1, nullptr, 0);
+
+    IOContext ctx;
+    ctx.ring = rctx;
+    return ctx;
+}
+
+void WindowsIoRingAlignedFileReader::destroy_ctx(IOContext &ctx)
+{
+    RingContext *rctx = to_ring(ctx);
+    if (rctx == nullptr)
+        return;
+    CloseIoRing(rctx->ring);
+    delete rctx;
+    ctx.ring = nullptr;
+}
+
+void WindowsIoRingAlignedFileReader::register_thread()
+{
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    if (this->ctx_map.find(std::this_thread::get_id()) != ctx_map.end())
+    {
+        diskann::cout << "Warning:: Duplicate registration for thread_id : " << std::this_thread::get_id() << std::endl;
+        return;
+    }
+    this->ctx_map.insert(std::make_pair(std::this_thread::get_id(), new_ctx()));
+}
+
+void WindowsIoRingAlignedFileReader::deregister_thread()
+{
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    auto iter = ctx_map.find(std::this_thread::get_id());
+    if (iter == ctx_map.end())
+        return;
+    destroy_ctx(iter.value());
+    ctx_map.erase(iter);
+}
+
+void WindowsIoRingAlignedFileReader::deregister_all_threads()
+{
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    for (auto iter = ctx_map.begin(); iter != ctx_map.end(); ++iter)
+        destroy_ctx(iter.value());
+    ctx_map.clear();
+    for (IOContext &ctx : owned_ctxs)
+        destroy_ctx(ctx);
+    owned_ctxs.clear();
+}
+
+IOContext &WindowsIoRingAlignedFileReader::get_ctx()
+{
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    if (ctx_map.find(std::this_thread::get_id()) == ctx_map.end())
+    {
+        lk.unlock();
+        register_thread();
+        lk.lock();
+    }
+    return ctx_map[std::this_thread::get_id()];
+}
+
+IOContext WindowsIoRingAlignedFileReader::create_ctx()
+{
+    IOContext ctx = new_ctx();
+    std::unique_lock<std::mutex> lk(this->ctx_mut);
+    owned_ctxs.push_back(ctx);
+    return ctx;
+}
+
+void WindowsIoRingAlignedFileReader::register_buffer(IOContext &ctx, void *buf, size_t len)
+{
+    RingContext *rctx = to_ring(ctx);
+    if (rctx == nullptr || rctx->fixed_buf != nullptr || len > UINT32_MAX)
+        return;
+
+    IORING_BUFFER_INFO info;
+    info.Address = buf;
+    info.Length = (UINT32)len;
+    HRESULT hr = BuildIoRingRegisterBuffers(rctx->ring, 1, &info, 0);
+    if (FAILED(hr))
+    {
+        diskann::cerr << "BuildIoRingRegisterBuffers() failed with HRESULT 0x" << std::hex << (uint32_t)hr
+                      << std::dec << ". Reading into unregistered buffers." << std::endl;
+        return;
+    }
+    submit_and_wait(rctx->ring, 1, nullptr, 0);
+    rctx->fixed_buf = (char *)buf;
+    rctx->fixed_len = len;
+}
+
+void WindowsIoRingAlignedFileReader::read(std::vector<AlignedRead> &read_reqs, IOContext &ctx, bool async)
+{
+    RingContext *rctx = to_ring(ctx);
+    if (rctx == nullptr)
+    {
+        throw diskann::ANNException("The context was not created by this reader", -1, __FUNCSIG__, __FILE__,
+                                    __LINE__);
+    }
+
+    const IORING_HANDLE_REF file_ref = IoRingHandleRefFromIndex(0);
+    const uint64_t n_reqs = read_reqs.size();
+    for (uint64_t batch_start = 0; batch_start < n_reqs; batch_start += MAX_IO_DEPTH)
+    {
+        const uint64_t batch_size = (std::min)(n_reqs - batch_start, (uint64_t)MAX_IO_DEPTH);
+        for (uint64_t j = 0; j < batch_size; j++)
+        {
+            AlignedRead &req = read_reqs[batch_start + j];
+            // disk indices may be laid out in sectors as short as 512 bytes
+            assert(IS_512_ALIGNED(req.buf));
+            assert(IS_512_ALIGNED(req.offset));
+            assert(IS_512_ALIGNED(req.len));
+
+            char *buf = (char *)req.buf;
+            const bool fixed = rctx->fixed_buf != nullptr && buf >= rctx->fixed_buf &&
+                               buf + req.len <= rctx->fixed_buf + rctx->fixed_len;
+            const IORING_BUFFER_REF buf_ref =
+                fixed ? IoRingBufferRefFromIndexAndOffset(0, (UINT32)(buf - rctx->fixed_buf))
+                      : IoRingBufferRefFromPointer(buf);
+            // the index of the read in the batch comes back with its completion
+            HRESULT hr = BuildIoRingReadFile(rctx->ring, file_ref, buf_ref, (UINT32)req.len, req.offset, (UINT_PTR)j,
+                                             IOSQE_FLAGS_NONE);
+            if (FAILED(hr))
+                throw_hresult("BuildIoRingReadFile()", hr, __FUNCSIG__, __FILE__, __LINE__);
+        }
+        submit_and_wait(rctx->ring, (uint32_t)batch_size, &read_reqs, batch_start);
+    }
+}
+#endif
@@ -0,0 +1,301 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#ifdef _WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ann_exception.h"
+#include "write_ahead_log.h"
+
+namespace diskann
+{
+namespace
+{
+const uint64_t WAL_MAGIC = 0x314c41574e4e4144ULL; // "DANNWAL1"
+const uint32_t WAL_VERSION = 1;
+
+struct WalFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct WalRecordHeader
+{
+    uint32_t type;
+    uint32_t bytes;
+    uint32_t checksum;
+};
+
+// FNV-1a over the type and size of a record and its payload
+uint32_t record_checksum(uint32_t type, const char *payload, uint32_t bytes)
+{
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const char *data, size_t size) {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= (uint8_t)data[i];
+            hash *= 16777619u;
+        }
+    };
+    mix((const char *)&type, sizeof(type));
+    mix((const char *)&bytes, sizeof(bytes));
+    mix(payload, bytes);
+    return hash;
+}
+
+// Calls apply, if set, on each intact record of the log at path, and returns
+// the number of them. valid_bytes is set to the length of the file up to the
+// first torn or corrupt record.
+uint64_t scan_log(const std::string &path, const std::function<void(uint32_t, const char *, uint32_t)> *apply,
+                  uint64_t &valid_bytes)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        throw ANNException("Cannot open write-ahead log " + path, -1, __FUNCSIG__, __FILE__, __LINE__);
+    const uint64_t file_size = (uint64_t)in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    WalFileHeader header;
+    if (!in.read((char *)&header, sizeof(header)) || header.magic != WAL_MAGIC)
+        throw ANNException(path + " is not a write-ahead log", -1, __FUNCSIG__, __FILE__, __LINE__);
+    if (header.version != WAL_VERSION)
+    {
+        throw ANNException("Write-ahead log " + path + " has unsupported version " + std::to_string(header.version),
+                           -1, __FUNCSIG__, __FILE__, __LINE__);
+    }
+
+    valid_bytes = sizeof(header);
+    uint64_t num_records = 0;
+    std::vector<char> payload;
+    WalRecordHeader record;
+    while (valid_bytes + sizeof(record) <= file_size && in.read((char *)&record, sizeof(record)))
+    {
+        if (record.bytes > file_size - valid_bytes - sizeof(record))
+            break;
+        payload.resize(record.bytes);
+        if (!in.read(payload.data(), record.bytes) ||
+            record_checksum(record.type, payload.data(), record.bytes) != record.checksum)
+            break;
+        if (apply != nullptr)
+            (*apply)(record.type, payload.data(), record.bytes);
+        valid_bytes += sizeof(record) + record.bytes;
+        num_records++;
+    }
+    return num_records;
+}
+
+bool file_exists_at(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return in.is_open();
+}
+
+// makes what has been written to file durable
+bool sync_stream(FILE *file)
+{
+    if (std::fflush(file) != 0)
+        return false;
+#ifdef _WINDOWS
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool truncate_stream(FILE *file, uint64_t size)
+{
+    if (std::fflush(file) != 0)
+        return false;
+#ifdef _WINDOWS
+    return _chsize_s(_fileno(file), (__int64)size) == 0 && std::fseek(file, 0, SEEK_END) == 0;
+#else
+    return ftruncate(fileno(file), (off_t)size) == 0 && std::fseek(file, 0, SEEK_END) == 0;
+#endif
+}
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string &path, const WriteAheadLogOptions &options)
+    : _path(path), _options(options)
+{
+    if (file_exists_at(path))
+    {
+        uint64_t valid_bytes = 0;
+        scan_log(path, nullptr, valid_bytes);
+        _file = std::fopen(path.c_str(), "r+b");
+        // appended records would be unreachable after a torn one
+        if (_file == nullptr || !truncate_stream(_file, valid_bytes))
+            close_and_throw("Cannot open write-ahead log " + path);
+    }
+    else
+    {
+        _file = std::fopen(path.c_str(), "w+b");
+        const WalFileHeader header{WAL_MAGIC, WAL_VERSION, 0};
+        if (_file == nullptr || std::fwrite(&header, sizeof(header), 1, _file) != 1 || !sync_stream(_file))
+            close_and_throw("Cannot create write-ahead log " + path);
+    }
+    _writer = std::thread([this] { run(); });
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+        _sync_requested = _appended;
+    }
+    _wake.notify_one();
+    _writer.join();
+    std::fclose(_file);
+}
+
+uint64_t WriteAheadLog::append(uint32_t type, const void *payload, uint32_t bytes)
+{
+    const WalRecordHeader record{type, bytes, record_checksum(type, (const char *)payload, bytes)};
+
+    std::unique_lock<std::mutex> guard(_lock);
+    throw_if_failed();
+    _pending.insert(_pending.end(), (const char *)&record, (const char *)&record + sizeof(record));
+    _pending.insert(_pending.end(), (const char *)payload, (const char *)payload + bytes);
+    const uint64_t seq = ++_appended;
+    const bool wake = _options.sync == WalSync::Commit || _pending.size() >= defaults::WAL_GROUP_COMMIT_BYTES;
+    guard.unlock();
+
+    if (wake)
+        _wake.notify_one();
+    return seq;
+}
+
+void WriteAheadLog::wait(uint64_t seq)
+{
+    if (_options.sync != WalSync::Commit)
+        return;
+    std::unique_lock<std::mutex> guard(_lock);
+    _committed.wait(guard, [&] { return _durable >= seq || !_error.empty(); });
+    throw_if_failed();
+}
+
+void WriteAheadLog::flush()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    const uint64_t target = _appended;
+    _sync_requested = (std::max)(_sync_requested, target);
+    _wake.notify_one();
+    _committed.wait(guard, [&] { return _synced >= target || !_error.empty(); });
+    throw_if_failed();
+}
+
+void WriteAheadLog::reset()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    _committed.wait(guard, [&] { return !_writing; });
+    throw_if_failed();
+    _pending.clear();
+    if (!truncate_stream(_file, sizeof(WalFileHeader)) || !sync_stream(_file))
+        _error = "Cannot truncate write-ahead log " + _path;
+    _durable = _synced = _sync_requested = _appended;
+    _committed.notify_all();
+    throw_if_failed();
+}
+
+void WriteAheadLog::run()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    while (true)
+    {
+        auto ready = [&] {
+            return _stopping || _sync_requested > _synced || _pending.size() >= defaults::WAL_GROUP_COMMIT_BYTES ||
+                   (_options.sync == WalSync::Commit && !_pending.empty());
+        };
+        if (_options.sync == WalSync::Commit)
+            _wake.wait(guard, ready);
+        else
+            _wake.wait_for(guard, std::chrono::microseconds(_options.group_commit_us), ready);
+
+        const bool sync = _options.sync != WalSync::None || _sync_requested > _synced;
+        if (_pending.empty() && _sync_requested <= _synced)
+        {
+            if (_stopping)
+                break;
+            continue;
+        }
+
+        // Records appended while this group is written form the next one
+        std::vector<char> batch;
+        batch.swap(_pending);
+        const uint64_t last = _appended;
+        const bool failed = !_error.empty();
+        _writing = true;
+        guard.unlock();
+
+        const std::string error = failed ? std::string() : write_batch(batch, sync);
+
+        guard.lock();
+        _writing = false;
+        if (!error.empty() && _error.empty())
+            _error = error;
+        _durable = last;
+        if (sync)
+            _synced = last;
+        _committed.notify_all();
+    }
+}
+
+std::string WriteAheadLog::write_batch(const std::vector<char> &batch, bool sync)
+{
+    if (!batch.empty() && std::fwrite(batch.data(), 1, batch.size(), _file) != batch.size())
+        return "Cannot write to write-ahead log " + _path;
+    if (sync ? !sync_stream(_file) : std::fflush(_file) != 0)
+        return "Cannot sync write-ahead log " + _path;
+    return std::string();
+}
+
+void WriteAheadLog::close_and_throw(const std::string &message)
+{
+    if (_file != nullptr)
+        std::fclose(_file);
+    throw ANNException(message, -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+void WriteAheadLog::throw_if_failed()
+{
+    if (!_error.empty())
+        throw ANNException(_error, -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+
+uint64_t WriteAheadLog::replay(const std::string &path,
+                               const std::function<void(uint32_t, const char *, uint32_t)> &apply)
+{
+    if (!file_exists_at(path))
+        return 0;
+    uint64_t valid_bytes = 0;
+    return scan_log(path, &apply, valid_bytes);
+}
+
+void WriteAheadLog::sync_file(const std::string &path)
+{
+#ifdef _WINDOWS
+    const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    const bool synced = fd >= 0 && _commit(fd) == 0;
+    if (fd >= 0)
+        _close(fd);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    const bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0)
+        close(fd);
+#endif
+    if (!synced)
+        throw ANNException("Cannot sync " + path + " to storage", -1, __FUNCSIG__, __FILE__, __LINE__);
+}
+} // namespace diskann